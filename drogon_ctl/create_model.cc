@@ -236,6 +236,7 @@ void create_model::createModelClassFromPG(
     data["dbName"] = dbname_;
     data["rdbms"] = std::string("postgresql");
     data["convertMethods"] = convertMethods;
+    data["generateViews"] = generateViews_;
     // Start with user-configured relationships (mutable copy)
     std::vector<Relationship> allRelationships(relationships);
     if (schema != "public")
@@ -558,6 +559,7 @@ void create_model::createModelClassFromMysql(
     data["dbName"] = dbname_;
     data["rdbms"] = std::string("mysql");
     data["convertMethods"] = convertMethods;
+    data["generateViews"] = generateViews_;
     // Start with user-configured relationships (mutable copy)
     std::vector<Relationship> allRelationships(relationships);
     std::vector<ColumnInfo> cols;
@@ -767,6 +769,7 @@ void create_model::createModelClassFromSqlite3(
     data["dbName"] = std::string("sqlite3");
     data["rdbms"] = std::string("sqlite3");
     data["convertMethods"] = convertMethods;
+    data["generateViews"] = generateViews_;
     // Start with user-configured relationships (mutable copy)
     std::vector<Relationship> allRelationships(relationships);
     std::vector<ColumnInfo> cols;
@@ -969,6 +972,7 @@ void create_model::createModel(const std::string &path,
     auto restfulApiConfig = config["restful_api_controllers"];
     auto relationships = getRelationships(config["relationships"]);
     auto convertMethods = getConvertMethods(config["convert"]);
+    generateViews_ = config.get("generate_views", false).asBool();
 
     drogon::utils::createPath(path);
 
@@ -431,5 +431,6 @@ class create_model : public DrObject<create_model>, public CommandHandler
     bool forceOverwrite_{false};
     std::string outputPath_;
     bool cleanupDirectory_{false};
+    bool generateViews_{false};
 };
 }  // namespace drogon_ctl
@@ -17,6 +17,7 @@
 #include <drogon/utils/Utilities.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <algorithm>
 #include <regex>
@@ -30,6 +31,14 @@ static const std::string cxx_val_start = "[[";
 static const std::string cxx_val_end = "]]";
 static const std::string sub_view_start = "<%view";
 static const std::string sub_view_end = "%>";
+// The members of the Params struct of a typed view, which is rendered with
+// renderTo(output, params). [[ member ]] outputs a member of the parameters,
+// and the code of the view accesses them with the params variable.
+static const std::string cxx_params = "<%params";
+static const std::string cache_start = "<%cache";
+static const std::string cache_end = "<%endcache%>";
+// Marks the lines of static text in the generated code, to be coalesced.
+static const char static_text_mark = '\x01';
 
 using namespace drogon_ctl;
 
@@ -54,7 +63,42 @@ static std::string &replace_all(std::string &str,
     return str;
 }
 
-static void parseCxxLine(std::ofstream &oSrcFile,
+// Read the content of the first block starting with the tag, and rewind the
+// file.
+static bool readBlock(std::ifstream &infile,
+                      const std::string &tag,
+                      std::string &content)
+{
+    bool found{false};
+    bool inBlock{false};
+    for (std::string buffer; std::getline(infile, buffer);)
+    {
+        std::string::size_type pos(0);
+        if (!inBlock)
+        {
+            std::string lowerBuffer = buffer;
+            std::transform(lowerBuffer.begin(),
+                           lowerBuffer.end(),
+                           lowerBuffer.begin(),
+                           [](unsigned char c) { return tolower(c); });
+            if ((pos = lowerBuffer.find(tag)) == std::string::npos)
+                continue;
+            found = inBlock = true;
+            buffer = buffer.substr(pos + tag.length());
+        }
+        if ((pos = buffer.find(cxx_end)) != std::string::npos)
+        {
+            content.append(buffer, 0, pos).append("\n");
+            break;
+        }
+        content.append(buffer).append("\n");
+    }
+    infile.clear();
+    infile.seekg(0, std::ifstream::beg);
+    return found;
+}
+
+static void parseCxxLine(std::ostream &oSrcFile,
                          const std::string &line,
                          const std::string &streamName,
                          const std::string &viewDataName)
@@ -68,7 +112,7 @@ static void parseCxxLine(std::ofstream &oSrcFile,
     }
 }
 
-static void outputVal(std::ofstream &oSrcFile,
+static void outputVal(std::ostream &oSrcFile,
                       const std::string &streamName,
                       const std::string &viewDataName,
                       const std::string &keyName)
@@ -88,7 +132,7 @@ static void outputVal(std::ofstream &oSrcFile,
     oSrcFile << "}\n";
 }
 
-static void outputSubView(std::ofstream &oSrcFile,
+static void outputSubView(std::ostream &oSrcFile,
                           const std::string &streamName,
                           const std::string &viewDataName,
                           const std::string &keyName)
@@ -97,13 +141,83 @@ static void outputSubView(std::ofstream &oSrcFile,
     oSrcFile << "    auto templ=DrTemplateBase::newTemplate(\"" << keyName
              << "\");\n";
     oSrcFile << "    if(templ){\n";
-    oSrcFile << "      " << streamName << "<< templ->genText(" << viewDataName
-             << ");\n";
+    oSrcFile << "      templ->renderTo(" << streamName << ".str(), "
+             << viewDataName << ");\n";
     oSrcFile << "    }\n";
     oSrcFile << "}\n";
 }
 
-static void parseLine(std::ofstream &oSrcFile,
+// <%cache key ttl%>: the key is a c++ expression convertible to a string,
+// the block is rendered again when its fragment is older than ttl seconds.
+static void outputCacheStart(std::ostream &oSrcFile,
+                             const std::string &streamName,
+                             const std::string &args)
+{
+    auto end = args.find_last_not_of(" \t");
+    auto pos = end == std::string::npos ? end : args.find_last_of(" \t", end);
+    auto start = args.find_first_not_of(" \t");
+    if (pos == std::string::npos || start >= pos)
+    {
+        std::cerr << "format err! <%cache key ttl%> expected" << std::endl;
+        exit(1);
+    }
+    std::string key = args.substr(start, pos - start);
+    std::string ttl = args.substr(pos + 1, end - pos);
+    oSrcFile << "{\n";
+    oSrcFile << "std::string " << streamName << "_cache_key{" << key
+             << "};\n";
+    oSrcFile << "if(!" << streamName << "_cache.appendTo(" << streamName
+             << "_cache_key, " << streamName << ".str()))\n{\n";
+    oSrcFile << "const double " << streamName << "_cache_ttl = " << ttl
+             << ";\n";
+    oSrcFile << "const size_t " << streamName << "_cache_start = "
+             << streamName << ".str().length();\n";
+}
+
+static void outputCacheEnd(std::ostream &oSrcFile,
+                           const std::string &streamName)
+{
+    oSrcFile << streamName << "_cache.store(std::move(" << streamName
+             << "_cache_key), " << streamName << ".str().substr("
+             << streamName << "_cache_start), " << streamName
+             << "_cache_ttl);\n";
+    oSrcFile << "}\n}\n";
+}
+
+// Merge the consecutive lines of static text in a single literal, which is
+// appended at once.
+static void coalesceStaticText(std::ostream &oSrcFile,
+                               const std::string &code,
+                               const std::string &streamName)
+{
+    const std::string prefix = std::string(1, static_text_mark) + "\t" +
+                               streamName + " << ";
+    std::istringstream input(code);
+    bool inText{false};
+    for (std::string line; std::getline(input, line);)
+    {
+        if (line.compare(0, prefix.length(), prefix) == 0)
+        {
+            // "text";
+            std::string literal = line.substr(
+                prefix.length(), line.length() - prefix.length() - 1);
+            if (inText)
+                oSrcFile << "\n\t\t" << literal;
+            else
+                oSrcFile << "\t" << streamName << " << " << literal;
+            inText = true;
+            continue;
+        }
+        if (inText)
+            oSrcFile << ";\n";
+        inText = false;
+        oSrcFile << line << "\n";
+    }
+    if (inText)
+        oSrcFile << ";\n";
+}
+
+static void parseLine(std::ostream &oSrcFile,
                       std::string &line,
                       const std::string &streamName,
                       const std::string &viewDataName,
@@ -121,7 +235,8 @@ static void parseLine(std::ofstream &oSrcFile,
         // std::cout<<"blank line!"<<std::endl;
         // std::cout<<streamName<<"<<\"\\n\";\n";
         if (returnFlag && !cxx_flag)
-            oSrcFile << streamName << "<<\"\\n\";\n";
+            oSrcFile << static_text_mark << "\t" << streamName
+                     << " << \"\\n\";\n";
         return;
     }
     if (cxx_flag == 0)
@@ -177,6 +292,46 @@ static void parseLine(std::ofstream &oSrcFile,
                     exit(1);
                 }
             }
+            else if ((pos = line.find(cache_start)) != std::string::npos)
+            {
+                std::string oldLine = line.substr(0, pos);
+                parseLine(
+                    oSrcFile, oldLine, streamName, viewDataName, cxx_flag, 0);
+                std::string newLine = line.substr(pos + cache_start.length());
+                if ((pos = newLine.find(cxx_end)) != std::string::npos)
+                {
+                    outputCacheStart(oSrcFile,
+                                     streamName,
+                                     newLine.substr(0, pos));
+                    std::string tailLine =
+                        newLine.substr(pos + cxx_end.length());
+                    parseLine(oSrcFile,
+                              tailLine,
+                              streamName,
+                              viewDataName,
+                              cxx_flag,
+                              returnFlag);
+                }
+                else
+                {
+                    std::cerr << "format err!" << std::endl;
+                    exit(1);
+                }
+            }
+            else if ((pos = line.find(cache_end)) != std::string::npos)
+            {
+                std::string oldLine = line.substr(0, pos);
+                parseLine(
+                    oSrcFile, oldLine, streamName, viewDataName, cxx_flag, 0);
+                outputCacheEnd(oSrcFile, streamName);
+                std::string tailLine = line.substr(pos + cache_end.length());
+                parseLine(oSrcFile,
+                          tailLine,
+                          streamName,
+                          viewDataName,
+                          cxx_flag,
+                          returnFlag);
+            }
             else if ((pos = line.find(sub_view_start)) != std::string::npos)
             {
                 std::string oldLine = line.substr(0, pos);
@@ -212,12 +367,10 @@ static void parseLine(std::ofstream &oSrcFile,
             }
             else
             {
-                if (line.length() > 0)
-                {
-                    replace_all(line, "\\", "\\\\");
-                    replace_all(line, "\"", "\\\"");
-                    oSrcFile << "\t" << streamName << " << \"" << line;
-                }
+                replace_all(line, "\\", "\\\\");
+                replace_all(line, "\"", "\\\"");
+                oSrcFile << static_text_mark << "\t" << streamName << " << \""
+                         << line;
                 if (returnFlag)
                     oSrcFile << "\\n\";\n";
                 else
@@ -365,7 +518,7 @@ int create_view::createViewFile(const std::string &script_filename)
                 return -1;
             }
 
-            newViewHeaderFile(oHeadFile, className);
+            newViewHeaderFile(oHeadFile, className, infile);
             newViewSourceFile(oSourceFile, className, npPrefix, infile);
         }
         else
@@ -380,11 +533,21 @@ int create_view::createViewFile(const std::string &script_filename)
 }
 
 void create_view::newViewHeaderFile(std::ofstream &file,
-                                    const std::string &className)
+                                    const std::string &className,
+                                    std::ifstream &infile)
 {
+    // The typed views declare their parameters, the types must be included
+    // by the header then.
+    std::string params;
+    std::string includes;
+    bool typed = readBlock(infile, cxx_params, params);
+    if (typed)
+        readBlock(infile, cxx_include, includes);
     file << "//this file is generated by program automatically,don't modify "
             "it!\n";
+    file << "#pragma once\n";
     file << "#include <drogon/DrTemplate.h>\n";
+    file << includes;
     for (auto &np : namespaces_)
     {
         file << "namespace " << np << "\n";
@@ -392,10 +555,23 @@ void create_view::newViewHeaderFile(std::ofstream &file,
     }
     file << "class " << className << ":public drogon::DrTemplate<" << className
          << ">\n";
-    file << "{\npublic:\n\t" << className << "(){};\n\tvirtual ~" << className
+    file << "{\npublic:\n";
+    if (typed)
+        file << "\tstruct Params\n\t{\n" << params << "\t};\n";
+    file << "\t" << className << "(){};\n\tvirtual ~" << className
          << "(){};\n\t"
             "virtual std::string genText(const drogon::DrTemplateData &) "
-            "override;\n};\n";
+            "override;\n\t"
+            "virtual void renderTo(std::string &, "
+            "const drogon::DrTemplateData &) override;\n";
+    if (typed)
+    {
+        file << "\tstd::string genText(const Params &, "
+                "const drogon::DrTemplateData & = drogon::DrTemplateData());\n"
+                "\tvoid renderTo(std::string &, const Params &, "
+                "const drogon::DrTemplateData & = drogon::DrTemplateData());\n";
+    }
+    file << "};\n";
     for (std::size_t i = 0; i < namespaces_.size(); ++i)
     {
         file << "}\n";
@@ -412,6 +588,8 @@ void create_view::newViewSourceFile(std::ofstream &file,
     file << "#include \"" << namespacePrefix << className << ".h\"\n";
     file << "#include <drogon/utils/OStringStream.h>\n";
     file << "#include <drogon/utils/Utilities.h>\n";
+    file << "#include <drogon/ViewFragmentCache.h>\n";
+    file << "#include <atomic>\n";
     file << "#include <string>\n";
     file << "#include <map>\n";
     file << "#include <vector>\n";
@@ -424,6 +602,11 @@ void create_view::newViewSourceFile(std::ofstream &file,
     file << "#include <deque>\n";
     file << "#include <queue>\n";
 
+    std::string params;
+    bool typed = readBlock(infile, cxx_params, params);
+    std::string cacheArgs;
+    bool cached = readBlock(infile, cache_start, cacheArgs);
+
     // Find layout tag
     std::string layoutName;
     std::regex layoutReg("<%layout[ \\t]+(((?!%\\}).)*[^ \\t])[ \\t]*%>");
@@ -442,6 +625,10 @@ void create_view::newViewSourceFile(std::ofstream &file,
     infile.clear();
     infile.seekg(0, std::ifstream::beg);
     bool import_flag{false};
+    // The includes of the typed views are in their headers.
+    std::ostringstream headerIncludes;
+    std::ostream &incFile =
+        typed ? static_cast<std::ostream &>(headerIncludes) : file;
     for (std::string buffer; std::getline(infile, buffer);)
     {
         std::string::size_type pos(0);
@@ -461,12 +648,12 @@ void create_view::newViewSourceFile(std::ofstream &file,
                 if ((pos = newLine.find(cxx_end)) != std::string::npos)
                 {
                     newLine = newLine.substr(0, pos);
-                    file << newLine << "\n";
+                    incFile << newLine << "\n";
                     break;
                 }
                 else
                 {
-                    file << newLine << "\n";
+                    incFile << newLine << "\n";
                 }
             }
         }
@@ -476,13 +663,13 @@ void create_view::newViewSourceFile(std::ofstream &file,
             if ((pos = buffer.find(cxx_end)) != std::string::npos)
             {
                 std::string newLine = buffer.substr(0, pos);
-                file << newLine << "\n";
+                incFile << newLine << "\n";
                 break;
             }
             else
             {
                 // std::cout<<"to source file"<<buffer<<endl;
-                file << buffer << "\n";
+                incFile << buffer << "\n";
             }
         }
     }
@@ -511,18 +698,72 @@ void create_view::newViewSourceFile(std::ofstream &file,
     }
     file << "using namespace drogon;\n";
     std::string viewDataName = className + "_view_data";
-    // virtual std::string genText(const DrTemplateData &)
+    std::string outputName = className + "_output";
+    std::string streamName = className + "_tmp_stream";
+    std::string lengthName = className + "_last_length";
     file << "std::string " << className << "::genText(const DrTemplateData& "
          << viewDataName << ")\n{\n";
-    // std::string bodyName=className+"_bodystr";
-    std::string streamName = className + "_tmp_stream";
-
-    // oSrcFile <<"\tstd::string "<<bodyName<<";\n";
+    file << "\tstd::string " << outputName << ";\n";
+    file << "\trenderTo(" << outputName << ", " << viewDataName << ");\n";
+    file << "\treturn " << outputName << ";\n}\n";
+    file << "void " << className << "::renderTo(std::string& " << outputName
+         << ", const DrTemplateData& " << viewDataName << ")\n{\n";
+    if (typed)
+    {
+        // Rendered by name, the parameters are in the view data.
+        file << "\trenderTo(" << outputName << ", " << viewDataName
+             << ".get<Params>(\"params\"), " << viewDataName << ");\n}\n";
+        file << "std::string " << className
+             << "::genText(const Params& params, const DrTemplateData& "
+             << viewDataName << ")\n{\n";
+        file << "\tstd::string " << outputName << ";\n";
+        file << "\trenderTo(" << outputName << ", params, " << viewDataName
+             << ");\n";
+        file << "\treturn " << outputName << ";\n}\n";
+        file << "void " << className << "::renderTo(std::string& "
+             << outputName
+             << ", const Params& params, const DrTemplateData& "
+             << viewDataName << ")\n{\n";
+    }
+    // The buffer is reserved with the length of the previous rendering, the
+    // text is appended to the output directly without a layout.
+    file << "\tstatic std::atomic<size_t> " << lengthName << "{0};\n";
     file << "\tdrogon::OStringStream " << streamName << ";\n";
+    if (layoutName.empty())
+        file << "\t" << streamName << ".str().swap(" << outputName << ");\n";
+    file << "\tconst size_t " << className << "_start = " << streamName
+         << ".str().length();\n";
+    file << "\t" << streamName << ".reserve(" << className << "_start + "
+         << lengthName << ".load(std::memory_order_relaxed));\n";
     file << "\tstd::string layoutName{\"" << layoutName << "\"};\n";
+    if (cached)
+    {
+        file << "\tstatic drogon::ViewFragmentCache " << streamName
+             << "_cache;\n";
+    }
+    std::ostringstream body;
     int cxx_flag = 0;
+    bool params_flag{false};
+    std::regex memberReg(
+        "\\[\\[[ \\t]*([A-Za-z_][A-Za-z0-9_.]*)[ \\t]*\\]\\]");
     for (std::string buffer; std::getline(infile, buffer);)
     {
+        if (typed)
+        {
+            // Skip the lines of the parameters block, and output the
+            // parameters directly.
+            if (!params_flag && buffer.find(cxx_params) != std::string::npos)
+                params_flag = true;
+            if (params_flag)
+            {
+                if (buffer.find(cxx_end) != std::string::npos)
+                    params_flag = false;
+                continue;
+            }
+            buffer = std::regex_replace(buffer,
+                                        memberReg,
+                                        "<%c++$$$$<<params.$1;%>");
+        }
         if (buffer.length() > 0)
         {
             std::smatch results;
@@ -537,20 +778,28 @@ void create_view::newViewSourceFile(std::ofstream &file,
             std::regex re("\\{%[ \\t]*(((?!%\\}).)*[^ \\t])[ \\t]*%\\}");
             buffer = std::regex_replace(buffer, re, "<%c++$$$$<<$1;%>");
         }
-        parseLine(file, buffer, streamName, viewDataName, cxx_flag);
+        parseLine(body, buffer, streamName, viewDataName, cxx_flag);
+    }
+    coalesceStaticText(file, body.str(), streamName);
+    file << lengthName << ".store(" << streamName << ".str().length() - "
+         << className << "_start, std::memory_order_relaxed);\n";
+    if (layoutName.empty())
+    {
+        file << outputName << ".swap(" << streamName << ".str());\n";
+        file << "}\n";
+    }
+    else
+    {
+        file << "auto templ = DrTemplateBase::newTemplate(layoutName);\n";
+        file << "if(!templ) return;\n";
+        file << "HttpViewData data = " << viewDataName << ";\n";
+        file << "auto str = std::move(" << streamName << ".str());\n";
+        file << "if(!str.empty() && str[str.length()-1] == '\\n') "
+                "str.resize(str.length()-1);\n";
+        file << "data[\"\"] = std::move(str);\n";
+        file << "templ->renderTo(" << outputName << ", data);\n";
+        file << "}\n";
     }
-    file << "if(layoutName.empty())\n{\n";
-    file << "std::string ret{std::move(" << streamName << ".str())};\n";
-    file << "return ret;\n}else\n{\n";
-    file << "auto templ = DrTemplateBase::newTemplate(layoutName);\n";
-    file << "if(!templ) return \"\";\n";
-    file << "HttpViewData data = " << viewDataName << ";\n";
-    file << "auto str = std::move(" << streamName << ".str());\n";
-    file << "if(!str.empty() && str[str.length()-1] == '\\n') "
-            "str.resize(str.length()-1);\n";
-    file << "data[\"\"] = std::move(str);\n";
-    file << "return templ->genText(data);\n";
-    file << "}\n}\n";
 }
 
 // See create.cc for rationale.
@@ -36,7 +36,9 @@ class create_view : public DrObject<create_view>, public CommandHandler
     bool pathToNamespaceFlag_{false};
     void createViewFiles(std::vector<std::string> &cspFileNames);
     int createViewFile(const std::string &script_filename);
-    void newViewHeaderFile(std::ofstream &file, const std::string &className);
+    void newViewHeaderFile(std::ofstream &file,
+                           const std::string &className,
+                           std::ifstream &infile);
     void newViewSourceFile(std::ofstream &file,
                            const std::string &className,
                            const std::string &namespacePrefix,
@@ -23,6 +23,8 @@
 #include <fstream>
 #include <string>
 #include <unordered_map>
+#include <algorithm>
+#include <cmath>
 #ifndef _WIN32
 #include <unistd.h>
 #endif
@@ -36,11 +38,42 @@ std::string press::detail()
            "  -n num    number of requests(default : 1)\n"
            "  -t num    number of threads(default : 1)\n"
            "  -c num    concurrent connections(default : 1)\n"
+           "  -r num    requests per second of all the connections, the "
+           "requests are sent\n"
+           "            at this rate whether the previous ones are answered or "
+           "not, and the\n"
+           "            latencies are measured from the scheduled send times"
+           "(default: send\n"
+           "            a request when the previous one is answered)\n"
+           "  -p num    pipelining depth of the connections(default: 0)\n"
+           "  -K        close the connection after every response"
+           "(default: keep-alive)\n"
+           "  -H file   write the latency distribution in the HdrHistogram "
+           "format\n"
            "  -k        disable SSL certificate validation(default: enable)\n"
            "  -f        customize http request json file(default: disenable)\n"
            "  -q        no progress indication(default: show)\n\n"
+           "A ws:// or wss:// url tests a WebSocket server, which must answer "
+           "every\n"
+           "message with one message. The bodies of the requests of the json "
+           "file are\n"
+           "the messages.\n\n"
+           "The json file may contain a scenario, the requests of the "
+           "\"requests\" array\n"
+           "are sent in order on every connection, repeated by their "
+           "\"weight\":\n"
+           "{\n"
+           "    \"requests\": [\n"
+           "        {\"method\": \"POST\", \"path\": \"/login\", "
+           "\"body\": {\"account\": \"10001\"}},\n"
+           "        {\"method\": \"GET\", \"path\": \"/items\", "
+           "\"weight\": 10}\n"
+           "    ]\n"
+           "}\n\n"
            "example: drogon_ctl press -n 10000 -c 100 -t 4 -q "
-           "http://localhost:8080/index.html -f ./http_request.json\n";
+           "http://localhost:8080/index.html -f ./http_request.json\n"
+           "         drogon_ctl press -n 60000 -c 100 -r 1000 "
+           "-H ./latency.hgrm http://localhost:8080/index.html\n";
 }
 
 void outputErrorAndExit(const std::string_view &err)
@@ -49,6 +82,21 @@ void outputErrorAndExit(const std::string_view &err)
     exit(1);
 }
 
+// Return the value of the option, given either as "-x value" or as "-xvalue"
+static std::string optionValue(std::vector<std::string>::iterator &iter,
+                               const std::vector<std::string> &parameters,
+                               const std::string_view &error)
+{
+    if (iter->length() > 2)
+        return iter->substr(2);
+    ++iter;
+    if (iter == parameters.end())
+    {
+        outputErrorAndExit(error);
+    }
+    return *iter;
+}
+
 void press::handleCommand(std::vector<std::string> &parameters)
 {
     for (auto iter = parameters.begin(); iter != parameters.end(); iter++)
@@ -174,6 +222,47 @@ void press::handleCommand(std::vector<std::string> &parameters)
                 continue;
             }
         }
+        else if (param.find("-r") == 0)
+        {
+            auto num = optionValue(iter, parameters, "No request rate!");
+            try
+            {
+                rate_ = std::stod(num);
+            }
+            catch (...)
+            {
+                outputErrorAndExit("Invalid request rate!");
+            }
+            if (rate_ <= 0)
+            {
+                outputErrorAndExit("Invalid request rate!");
+            }
+            continue;
+        }
+        else if (param.find("-p") == 0)
+        {
+            auto num = optionValue(iter, parameters, "No pipelining depth!");
+            try
+            {
+                pipeliningDepth_ = std::stoll(num);
+            }
+            catch (...)
+            {
+                outputErrorAndExit("Invalid pipelining depth!");
+            }
+            continue;
+        }
+        else if (param.find("-H") == 0)
+        {
+            histogramFile_ =
+                optionValue(iter, parameters, "No histogram file!");
+            continue;
+        }
+        else if (param == "-K")
+        {
+            keepAlive_ = false;
+            continue;
+        }
         else if (param == "-k")
         {
             certValidation_ = false;
@@ -188,19 +277,17 @@ void press::handleCommand(std::vector<std::string> &parameters)
             url_ = param;
         }
     }
-    // std::cout << "n=" << numOfRequests_ << std::endl;
-    // std::cout << "t=" << numOfThreads_ << std::endl;
-    // std::cout << "c=" << numOfConnections_ << std::endl;
-    // std::cout << "q=" << processIndication_ << std::endl;
-    // std::cout << "url=" << url_ << std::endl;
-    if (url_.empty() || url_.compare(0, 4, "http") != 0 ||
-        (url_.compare(4, 3, "://") != 0 && url_.compare(4, 4, "s://") != 0))
+    auto pos = url_.find("://");
+    auto scheme = url_.substr(0, pos);
+    if (pos == std::string::npos ||
+        (scheme != "http" && scheme != "https" && scheme != "ws" &&
+         scheme != "wss"))
     {
         outputErrorAndExit("Invalid URL");
     }
     else
     {
-        auto pos = url_.find("://");
+        webSocket_ = scheme == "ws" || scheme == "wss";
         auto posOfPath = url_.find('/', pos + 3);
         if (posOfPath == std::string::npos)
         {
@@ -238,109 +325,156 @@ void press::handleCommand(std::vector<std::string> &parameters)
         }
         httpRequestFile >> httpRequestJson;
 
-        if (!httpRequestJson.isMember("method"))
+        if (httpRequestJson.isMember("requests"))
         {
-            outputErrorAndExit("No contain method");
-        }
-
-        auto methodStr = httpRequestJson["method"].asString();
-        std::transform(methodStr.begin(),
-                       methodStr.end(),
-                       methodStr.begin(),
-                       ::toupper);
-
-        auto toHttpMethod = [&]() -> drogon::HttpMethod {
-            if (methodStr == "GET")
-            {
-                return drogon::HttpMethod::Get;
-            }
-            else if (methodStr == "POST")
-            {
-                return drogon::HttpMethod::Post;
-            }
-            else if (methodStr == "HEAD")
+            auto &requests = httpRequestJson["requests"];
+            if (!requests.isArray() || requests.empty())
             {
-                return drogon::HttpMethod::Head;
+                outputErrorAndExit("Invalid requests");
             }
-            else if (methodStr == "PUT")
+            for (auto &request : requests)
             {
-                return drogon::HttpMethod::Put;
+                auto weight = request.get("weight", 1).asUInt();
+                steps_.push_back(parseStep(request));
+                stepOrder_.insert(stepOrder_.end(), weight, steps_.size() - 1);
             }
-            else if (methodStr == "DELETE")
+            if (stepOrder_.empty())
             {
-                return drogon::HttpMethod::Delete;
+                outputErrorAndExit("Invalid weights");
             }
-            else if (methodStr == "OPTIONS")
-            {
-                return drogon::HttpMethod::Options;
-            }
-            else if (methodStr == "PATCH")
+        }
+        else
+        {
+            steps_.push_back(parseStep(httpRequestJson));
+            stepOrder_.push_back(0);
+        }
+    }
+    else
+    {
+        Step step;
+        step.path = path_;
+        if (webSocket_)
+            step.body = "drogon_ctl press";
+        steps_.push_back(std::move(step));
+        stepOrder_.push_back(0);
+    }
+
+    doTesting();
+}
+
+press::Step press::parseStep(const Json::Value &json) const
+{
+    if (!json.isMember("method") && !webSocket_)
+    {
+        outputErrorAndExit("No contain method");
+    }
+
+    auto methodStr = json.get("method", "GET").asString();
+    std::transform(methodStr.begin(),
+                   methodStr.end(),
+                   methodStr.begin(),
+                   ::toupper);
+
+    auto toHttpMethod = [&]() -> drogon::HttpMethod {
+        if (methodStr == "GET")
+        {
+            return drogon::HttpMethod::Get;
+        }
+        else if (methodStr == "POST")
+        {
+            return drogon::HttpMethod::Post;
+        }
+        else if (methodStr == "HEAD")
+        {
+            return drogon::HttpMethod::Head;
+        }
+        else if (methodStr == "PUT")
+        {
+            return drogon::HttpMethod::Put;
+        }
+        else if (methodStr == "DELETE")
+        {
+            return drogon::HttpMethod::Delete;
+        }
+        else if (methodStr == "OPTIONS")
+        {
+            return drogon::HttpMethod::Options;
+        }
+        else if (methodStr == "PATCH")
+        {
+            return drogon::HttpMethod::Patch;
+        }
+        else
+        {
+            outputErrorAndExit("invalid method");
+        }
+        return drogon::HttpMethod::Get;
+    };
+
+    Step step;
+    step.method = toHttpMethod();
+    step.path = json.get("path", path_).asString();
+    if (json.isMember("header"))
+    {
+        auto &jsonValue = json["header"];
+        for (const auto &key : jsonValue.getMemberNames())
+        {
+            if (jsonValue[key].isString())
             {
-                return drogon::HttpMethod::Patch;
+                step.header[key] = jsonValue[key].asString();
             }
             else
             {
-                outputErrorAndExit("invalid method");
+                step.header[key] = jsonValue[key].toStyledString();
             }
-            return drogon::HttpMethod::Get;
-        };
+        }
+    }
 
-        std::unordered_map<std::string, std::string> header;
-        if (httpRequestJson.isMember("header"))
+    if (json.isMember("body"))
+    {
+        if (webSocket_ && json["body"].isString())
         {
-            auto &jsonValue = httpRequestJson["header"];
-            for (const auto &key : jsonValue.getMemberNames())
-            {
-                if (jsonValue[key].isString())
-                {
-                    header[key] = jsonValue[key].asString();
-                }
-                else
-                {
-                    header[key] = jsonValue[key].toStyledString();
-                }
-            }
+            step.body = json["body"].asString();
         }
-
-        std::string body;
-        if (httpRequestJson.isMember("body"))
+        else
         {
             Json::FastWriter fastWriter;
-            body = fastWriter.write(httpRequestJson["body"]);
-        }
-
-        createHttpRequestFunc_ = [this,
-                                  method = toHttpMethod(),
-                                  body = std::move(body),
-                                  header =
-                                      std::move(header)]() -> HttpRequestPtr {
-            auto request = HttpRequest::newHttpRequest();
-            request->setPath(path_);
-            request->setMethod(method);
-            for (const auto &[field, val] : header)
-                request->addHeader(field, val);
-            if (!body.empty())
-                request->setBody(body);
-            return request;
-        };
+            step.body = fastWriter.write(json["body"]);
+        }
     }
-
-    // std::cout << "host=" << host_ << std::endl;
-    // std::cout << "path=" << path_ << std::endl;
-    doTesting();
+    return step;
 }
 
 void press::doTesting()
 {
     createRequestAndClients();
-    if (clients_.empty())
+    if (connections_.empty())
     {
         outputErrorAndExit("No connection!");
     }
     statistics_.startDate_ = trantor::Date::now();
-    for (auto &client : clients_)
+    for (auto &connPtr : connections_)
     {
-        sendRequest(client);
+        auto conn = connPtr.get();
+        if (!webSocket_)
+        {
+            conn->loop->queueInLoop([this, conn]() { start(conn); });
+            continue;
+        }
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath(path_);
+        conn->wsClient->connectToServer(
+            req,
+            [this, conn](ReqResult r,
+                         const HttpResponsePtr &,
+                         const WebSocketClientPtr &) {
+                if (r != ReqResult::Ok)
+                {
+                    outputErrorAndExit("Failed to connect to the WebSocket "
+                                       "server!");
+                }
+                start(conn);
+            });
     }
     loopPool_->wait();
 }
@@ -351,93 +485,190 @@ void press::createRequestAndClients()
     loopPool_->start();
     for (size_t i = 0; i < numOfConnections_; ++i)
     {
-        auto client = HttpClient::newHttpClient(host_,
-                                                loopPool_->getNextLoop(),
-                                                false,
-                                                certValidation_);
-        client->enableCookies();
-        clients_.push_back(client);
+        auto conn = std::make_unique<Connection>();
+        conn->index = i;
+        conn->loop = loopPool_->getNextLoop();
+        if (webSocket_)
+        {
+            conn->wsClient = WebSocketClient::newWebSocketClient(
+                host_, conn->loop, false, certValidation_);
+            auto connPtr = conn.get();
+            conn->wsClient->setMessageHandler(
+                [this, connPtr](std::string &&message,
+                                const WebSocketClientPtr &,
+                                const WebSocketMessageType &type) {
+                    if (type != WebSocketMessageType::Text &&
+                        type != WebSocketMessageType::Binary)
+                        return;
+                    if (connPtr->pending.empty())
+                        return;
+                    auto intendedDate = connPtr->pending.front();
+                    connPtr->pending.pop_front();
+                    onResponse(connPtr, true, message.length(), intendedDate);
+                });
+            conn->wsClient->setConnectionClosedHandler(
+                [](const WebSocketClientPtr &) {
+                    outputErrorAndExit("The WebSocket connection is closed!");
+                });
+        }
+        else
+        {
+            conn->httpClient = HttpClient::newHttpClient(host_,
+                                                         conn->loop,
+                                                         false,
+                                                         certValidation_);
+            conn->httpClient->enableCookies();
+            if (pipeliningDepth_ > 0)
+                conn->httpClient->setPipeliningDepth(pipeliningDepth_);
+        }
+        connections_.push_back(std::move(conn));
     }
 }
 
-void press::sendRequest(const HttpClientPtr &client)
+void press::start(Connection *conn)
+{
+    if (rate_ > 0)
+    {
+        // The connections take turns, one request every 1/rate seconds.
+        conn->nextDate = statistics_.startDate_.after(conn->index / rate_);
+        scheduleRequest(conn);
+        return;
+    }
+    // Keep as many requests in flight as the pipelining allows.
+    auto inFlight = (std::max)(pipeliningDepth_, size_t(1));
+    for (size_t i = 0; i < inFlight; ++i)
+    {
+        if (!sendRequest(conn, trantor::Date::now()))
+            break;
+    }
+}
+
+void press::scheduleRequest(Connection *conn)
+{
+    conn->loop->runAt(conn->nextDate, [this, conn]() {
+        // Sent late when the loop falls behind, the latency still counts
+        // from the scheduled date, so a slow server can't hide the requests
+        // it delays.
+        if (!sendRequest(conn, conn->nextDate))
+            return;
+        conn->nextDate = conn->nextDate.after(numOfConnections_ / rate_);
+        scheduleRequest(conn);
+    });
+}
+
+bool press::sendRequest(Connection *conn, const trantor::Date &intendedDate)
 {
     auto numOfRequest = statistics_.numOfRequestsSent_++;
     if (numOfRequest >= numOfRequests_)
     {
-        return;
+        return false;
     }
 
-    HttpRequestPtr request;
-    if (createHttpRequestFunc_)
+    auto &step = steps_[stepOrder_[conn->step]];
+    conn->step = (conn->step + 1) % stepOrder_.size();
+    if (webSocket_)
     {
-        request = createHttpRequestFunc_();
+        conn->pending.push_back(intendedDate);
+        conn->wsClient->getConnection()->send(step.body);
+        return true;
     }
-    else
+
+    auto request = HttpRequest::newHttpRequest();
+    request->setPath(step.path);
+    request->setMethod(step.method);
+    for (const auto &[field, val] : step.header)
+        request->addHeader(field, val);
+    if (!step.body.empty())
+        request->setBody(step.body);
+    if (!keepAlive_)
     {
-        request = HttpRequest::newHttpRequest();
-        request->setPath(path_);
-        request->setMethod(Get);
+        // The client sets the keep-alive header unless the request is
+        // passed through as it is.
+        request->setPassThrough(true);
+        request->addHeader("connection", "close");
     }
 
     // std::cout << "send!" << std::endl;
-    client->sendRequest(
+    conn->httpClient->sendRequest(
         request,
-        [this, client, request](ReqResult r, const HttpResponsePtr &resp) {
-            size_t goodNum, badNum;
-            if (r == ReqResult::Ok)
-            {
-                // std::cout << "OK" << std::endl;
-                goodNum = ++statistics_.numOfGoodResponse_;
-                badNum = statistics_.numOfBadResponse_;
-                statistics_.bytesRecieved_ += resp->body().length();
-                auto delay = trantor::Date::now().microSecondsSinceEpoch() -
-                             request->creationDate().microSecondsSinceEpoch();
-                statistics_.totalDelay_ += delay;
-            }
-            else
-            {
-                goodNum = statistics_.numOfGoodResponse_;
-                badNum = ++statistics_.numOfBadResponse_;
-                if (badNum > numOfRequests_ / 10)
-                {
-                    outputErrorAndExit("Too many errors");
-                }
-            }
-            if (goodNum + badNum >= numOfRequests_)
-            {
-                outputResults();
-            }
-            if (r == ReqResult::Ok)
-                sendRequest(client);
+        [this, conn, intendedDate](ReqResult r, const HttpResponsePtr &resp) {
+            bool ok = r == ReqResult::Ok;
+            onResponse(conn, ok, ok ? resp->body().length() : 0, intendedDate);
+            if (rate_ > 0)
+                return;
+            if (ok)
+                sendRequest(conn, trantor::Date::now());
             else
             {
-                client->getLoop()->runAfter(1, [this, client]() {
-                    sendRequest(client);
+                conn->loop->runAfter(1, [this, conn]() {
+                    sendRequest(conn, trantor::Date::now());
                 });
             }
-
-            if (processIndication_)
-            {
-                auto rec = goodNum + badNum;
-                if (rec % 100000 == 0)
-                {
-                    std::cout << rec << " responses are received" << std::endl
-                              << std::endl;
-                }
-            }
         });
+    return true;
+}
+
+void press::onResponse(Connection *conn,
+                       bool ok,
+                       size_t bytes,
+                       const trantor::Date &intendedDate)
+{
+    size_t goodNum, badNum;
+    if (ok)
+    {
+        // std::cout << "OK" << std::endl;
+        goodNum = ++statistics_.numOfGoodResponse_;
+        badNum = statistics_.numOfBadResponse_;
+        statistics_.bytesRecieved_ += bytes;
+        auto delay = trantor::Date::now().microSecondsSinceEpoch() -
+                     intendedDate.microSecondsSinceEpoch();
+        if (delay < 0)
+            delay = 0;
+        statistics_.totalDelay_ += delay;
+        statistics_.latencies_.record(delay);
+    }
+    else
+    {
+        goodNum = statistics_.numOfGoodResponse_;
+        badNum = ++statistics_.numOfBadResponse_;
+        if (badNum > numOfRequests_ / 10)
+        {
+            outputErrorAndExit("Too many errors");
+        }
+    }
+    if (goodNum + badNum >= numOfRequests_)
+    {
+        outputResults();
+    }
+    if (webSocket_ && rate_ <= 0)
+        sendRequest(conn, trantor::Date::now());
+
+    if (processIndication_)
+    {
+        auto rec = goodNum + badNum;
+        if (rec % 100000 == 0)
+        {
+            std::cout << rec << " responses are received" << std::endl
+                      << std::endl;
+        }
+    }
 }
 
 void press::outputResults()
 {
     size_t totalSent = 0;
     size_t totalRecv = 0;
-    for (auto &client : clients_)
+    for (auto &conn : connections_)
     {
-        totalSent += client->bytesSent();
-        totalRecv += client->bytesReceived();
+        if (!conn->httpClient)
+            continue;
+        totalSent += conn->httpClient->bytesSent();
+        totalRecv += conn->httpClient->bytesReceived();
     }
+    // The frames of the WebSocket connections aren't counted.
+    auto overhead = totalRecv > statistics_.bytesRecieved_
+                        ? totalRecv - statistics_.bytesRecieved_
+                        : 0;
     auto now = trantor::Date::now();
     auto microSecs = now.microSecondsSinceEpoch() -
                      statistics_.startDate_.microSecondsSinceEpoch();
@@ -451,12 +682,9 @@ void press::outputResults()
 
     std::cout << "TRAFFIC:  "
               << statistics_.bytesRecieved_ / statistics_.numOfGoodResponse_
-              << " avg bytes, "
-              << (totalRecv - statistics_.bytesRecieved_) /
-                     statistics_.numOfGoodResponse_
+              << " avg bytes, " << overhead / statistics_.numOfGoodResponse_
               << " avg overhead, " << statistics_.bytesRecieved_ << " bytes, "
-              << totalRecv - statistics_.bytesRecieved_ << " overhead"
-              << std::endl;
+              << overhead << " overhead" << std::endl;
 
     std::cout << std::setiosflags(std::ios::fixed) << std::setprecision(3)
               << "TIMING:   " << seconds << " seconds, " << rps << " rps, "
@@ -464,12 +692,112 @@ void press::outputResults()
                      statistics_.numOfGoodResponse_ / 1000
               << " ms avg req time" << std::endl;
 
+    auto &latencies = statistics_.latencies_;
+    std::cout << "LATENCY:  "
+              << latencies.valueAtPercentile(50) / 1000.0 << " ms p50, "
+              << latencies.valueAtPercentile(90) / 1000.0 << " ms p90, "
+              << latencies.valueAtPercentile(99) / 1000.0 << " ms p99, "
+              << latencies.valueAtPercentile(99.9) / 1000.0 << " ms p99.9, "
+              << latencies.max() / 1000.0 << " ms max"
+              << (rate_ > 0 ? " (from the scheduled send times)" : "")
+              << std::endl;
+
     std::cout << "SPEED:    download " << totalRecv / seconds / 1000
               << " kBps, upload " << totalSent / seconds / 1000 << " kBps"
               << std::endl
               << std::endl;
+    if (!histogramFile_.empty())
+    {
+        std::ofstream histogram(histogramFile_);
+        if (!histogram.is_open())
+        {
+            outputErrorAndExit(std::string{"Can't write "} + histogramFile_);
+        }
+        latencies.outputPercentileDistribution(histogram);
+    }
     exit(0);
 }
 
+void LatencyHistogram::record(uint64_t microseconds)
+{
+    ++counts_[indexOf(microseconds)];
+    ++count_;
+    auto max = max_.load();
+    while (microseconds > max && !max_.compare_exchange_weak(max, microseconds))
+    {
+    }
+}
+
+size_t LatencyHistogram::indexOf(uint64_t value)
+{
+    if (value < kExactValues)
+        return value;
+    // The value over 2^shift is in [64, 128)
+    size_t shift = 1;
+    while ((value >> shift) >= 2 * kSubBuckets)
+        ++shift;
+    auto index = kExactValues + (shift - 1) * kSubBuckets +
+                 (value >> shift) - kSubBuckets;
+    return (std::min)(index, kBuckets - 1);
+}
+
+uint64_t LatencyHistogram::valueOf(size_t index)
+{
+    if (index < kExactValues)
+        return index;
+    auto shift = (index - kExactValues) / kSubBuckets + 1;
+    auto sub = (index - kExactValues) % kSubBuckets + kSubBuckets;
+    return ((uint64_t(sub) + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::valueAtPercentile(double percentile) const
+{
+    size_t total = count_;
+    if (total == 0)
+        return 0;
+    auto target = static_cast<size_t>(std::ceil(percentile / 100.0 * total));
+    target = (std::max)(target, size_t(1));
+    size_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i)
+    {
+        seen += counts_[i];
+        if (seen >= target)
+            return (std::min)(valueOf(i), max());
+    }
+    return max();
+}
+
+void LatencyHistogram::outputPercentileDistribution(std::ostream &os) const
+{
+    size_t total = count_;
+    os << "       Value     Percentile TotalCount 1/(1-Percentile)\n\n";
+    os << std::setiosflags(std::ios::fixed);
+    size_t seen = 0;
+    double sum = 0;
+    for (size_t i = 0; i < kBuckets && seen < total; ++i)
+    {
+        size_t count = counts_[i];
+        if (count == 0)
+            continue;
+        seen += count;
+        auto value = (std::min)(valueOf(i), max());
+        sum += double(value) * count;
+        double percentile = double(seen) / total;
+        os << std::setw(12) << std::setprecision(3) << value / 1000.0 << " "
+           << std::setw(14) << std::setprecision(12) << percentile << " "
+           << std::setw(10) << seen;
+        if (seen < total)
+        {
+            os << " " << std::setw(14) << std::setprecision(2)
+               << 1.0 / (1.0 - percentile);
+        }
+        os << "\n";
+    }
+    os << std::setprecision(3) << "#[Mean    = " << std::setw(12)
+       << (total ? sum / total / 1000.0 : 0.0) << "]\n"
+       << "#[Max     = " << std::setw(12) << max() / 1000.0
+       << ", Total count    = " << std::setw(12) << total << "]\n";
+}
+
 // See create.cc for rationale.
 template class drogon::DrObject<drogon_ctl::press>;
@@ -18,18 +18,60 @@
 #include <drogon/DrObject.h>
 #include <drogon/HttpAppFramework.h>
 #include <drogon/HttpClient.h>
+#include <drogon/WebSocketClient.h>
 #include <trantor/utils/Date.h>
 #include <trantor/net/EventLoopThreadPool.h>
-#include <functional>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <ostream>
 #include <string>
 #include <atomic>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 using namespace drogon;
 
 namespace drogon_ctl
 {
+/**
+ * @brief The latencies in microseconds, counted in buckets narrower than 1/64
+ * of their values like in HdrHistogram, so the percentiles are exact to 2%
+ * without keeping every latency.
+ */
+class LatencyHistogram
+{
+  public:
+    void record(uint64_t microseconds);
+
+    /// The highest latency under which the percentage of the latencies is
+    uint64_t valueAtPercentile(double percentile) const;
+
+    uint64_t max() const
+    {
+        return max_;
+    }
+
+    /// Output the distribution in the percentile format of HdrHistogram, in
+    /// milliseconds, which can be read by its plotter.
+    void outputPercentileDistribution(std::ostream &os) const;
+
+  private:
+    static constexpr size_t kExactValues = 128;
+    static constexpr size_t kSubBuckets = 64;
+    // Up to 2^40 microseconds
+    static constexpr size_t kBuckets = kExactValues + 34 * kSubBuckets;
+
+    static size_t indexOf(uint64_t value);
+    // The highest value counted in the bucket
+    static uint64_t valueOf(size_t index);
+
+    std::array<std::atomic_size_t, kBuckets> counts_{};
+    std::atomic<uint64_t> max_{0};
+    std::atomic_size_t count_{0};
+};
+
 struct Statistics
 {
     std::atomic_size_t numOfRequestsSent_{0};
@@ -37,6 +79,7 @@ struct Statistics
     std::atomic_size_t numOfGoodResponse_{0};
     std::atomic_size_t numOfBadResponse_{0};
     std::atomic_size_t totalDelay_{0};
+    LatencyHistogram latencies_;
     trantor::Date startDate_;
     trantor::Date endDate_;
 };
@@ -60,22 +103,63 @@ class press : public DrObject<press>, public CommandHandler
     std::string detail() override;
 
   private:
+    // A request of the scenario, or a message for the WebSocket connections
+    struct Step
+    {
+        HttpMethod method{Get};
+        std::string path;
+        std::unordered_map<std::string, std::string> header;
+        std::string body;
+    };
+
+    struct Connection
+    {
+        size_t index{0};
+        trantor::EventLoop *loop{nullptr};
+        HttpClientPtr httpClient;
+        WebSocketClientPtr wsClient;
+        // The position in stepOrder_
+        size_t step{0};
+        // The date the next request is scheduled at, in open-loop mode
+        trantor::Date nextDate;
+        // The dates of the WebSocket messages waiting for their answers
+        std::deque<trantor::Date> pending;
+    };
+
     size_t numOfThreads_{1};
     size_t numOfRequests_{1};
     size_t numOfConnections_{1};
+    // The requests per second of all the connections, 0 to send a request
+    // as soon as the previous one is answered.
+    double rate_{0.0};
+    size_t pipeliningDepth_{0};
+    bool keepAlive_{true};
+    std::string histogramFile_;
     std::string httpRequestJsonFile_;
-    std::function<HttpRequestPtr()> createHttpRequestFunc_;
     bool certValidation_{true};
     bool processIndication_{true};
+    bool webSocket_{false};
     std::string url_;
     std::string host_;
     std::string path_;
+    std::vector<Step> steps_;
+    // The indexes in steps_ repeated by their weights, every connection goes
+    // through them in order.
+    std::vector<size_t> stepOrder_;
+    Step parseStep(const Json::Value &json) const;
     void doTesting();
     void createRequestAndClients();
-    void sendRequest(const HttpClientPtr &client);
+    void start(Connection *conn);
+    void scheduleRequest(Connection *conn);
+    // Return false when all the requests are sent.
+    bool sendRequest(Connection *conn, const trantor::Date &intendedDate);
+    void onResponse(Connection *conn,
+                    bool ok,
+                    size_t bytes,
+                    const trantor::Date &intendedDate);
     void outputResults();
     std::unique_ptr<trantor::EventLoopThreadPool> loopPool_;
-    std::vector<HttpClientPtr> clients_;
+    std::vector<std::unique_ptr<Connection>> connections_;
     Statistics statistics_;
 };
 }  // namespace drogon_ctl
@@ -0,0 +1,79 @@
+#include "../../lib/src/CharScan.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+using namespace drogon::internal;
+
+// The headers of a typical browser request, scanned line by line the way
+// HttpRequestParser does, once with the generic algorithms it used to call
+// and once with the SIMD scanning of CharScan.h.
+static const std::string headers =
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 "
+    "Firefox/115.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/"
+    "avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: JSESSIONID=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "\r\n";
+
+static const char crlfChars[] = "\r\n";
+
+static size_t scanGeneric(const char *begin, const char *end)
+{
+    size_t colons = 0;
+    while (true)
+    {
+        const char *crlf = std::search(begin, end, crlfChars, crlfChars + 2);
+        if (crlf == end || crlf == begin)
+            return colons;
+        colons += std::find(begin, crlf, ':') - begin;
+        begin = crlf + 2;
+    }
+}
+
+static size_t scanSimd(const char *begin, const char *end)
+{
+    size_t colons = 0;
+    while (true)
+    {
+        const char *colon = findEither(begin, end, ':', '\r');
+        if (colon == end || *colon == '\r')
+            return colons;
+        colons += colon - begin;
+        const char *crlf = findCRLF(colon + 1, end);
+        if (!crlf)
+            return colons;
+        begin = crlf + 2;
+    }
+}
+
+template <typename Scan>
+static double run(Scan scan, size_t iterations, size_t &result)
+{
+    const char *begin = headers.data();
+    const char *end = begin + headers.size();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+        result += scan(begin, end);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return (double)(iterations * headers.size()) / elapsed.count() / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    // Accumulated so the scans can't be optimized away.
+    size_t result = 0;
+    auto generic = run(scanGeneric, iterations, result);
+    auto simd = run(scanSimd, iterations, result);
+    std::cout << "generic (MB/s)\tsimd (MB/s)\n"
+              << generic << "\t" << simd << "\n";
+    return result == 0 ? 1 : 0;
+}
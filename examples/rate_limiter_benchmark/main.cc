@@ -0,0 +1,68 @@
+#include <drogon/RateLimiter.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace drogon;
+
+// Measures how the rate limiters scale when several threads share one
+// limiter, like the global limiter of the Hodor plugin. The capacity is high
+// enough that every request is allowed, so only the cost of the atomic
+// updates (or of the mutex, with SafeRateLimiter) is measured.
+static double run(const RateLimiterPtr &limiter,
+                  size_t threadsNum,
+                  size_t iterations)
+{
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < threadsNum; ++i)
+    {
+        threads.emplace_back([&limiter, iterations]() {
+            for (size_t j = 0; j < iterations; ++j)
+                limiter->isAllowed();
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return (double)(threadsNum * iterations) / elapsed.count();
+}
+
+int main(int argc, char *argv[])
+{
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    size_t maxThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+    const std::pair<const char *, RateLimiterType> types[] = {
+        {"fixed_window", RateLimiterType::kFixedWindow},
+        {"sliding_window", RateLimiterType::kSlidingWindow},
+        {"token_bucket", RateLimiterType::kTokenBucket}};
+    std::cout << "algorithm\tthreads\tlock-free (ops/s)\tmutex (ops/s)\n";
+    for (auto &type : types)
+    {
+        for (size_t threadsNum = 1; threadsNum <= maxThreads; threadsNum *= 2)
+        {
+            // The capacity is stored in 24 bits by the sliding window.
+            size_t capacity = 1 << 23;
+            auto lockFree = run(RateLimiter::newRateLimiter(
+                                    type.second,
+                                    capacity,
+                                    std::chrono::milliseconds(100)),
+                                threadsNum,
+                                iterations);
+            auto locked = run(std::make_shared<SafeRateLimiter>(
+                                  RateLimiter::newRateLimiter(
+                                      type.second,
+                                      capacity,
+                                      std::chrono::milliseconds(100))),
+                              threadsNum,
+                              iterations);
+            std::cout << type.first << "\t" << threadsNum << "\t"
+                      << (size_t)lockFree << "\t" << (size_t)locked << "\n";
+        }
+    }
+    return 0;
+}
@@ -14,8 +14,10 @@
 
 #pragma once
 
+#include <drogon/exports.h>
 #include <trantor/net/EventLoop.h>
 #include <trantor/utils/Logger.h>
+#include <trantor/utils/NonCopyable.h>
 #include <atomic>
 #include <deque>
 #include <map>
@@ -58,6 +60,52 @@ using WeakCallbackEntryPtr = std::weak_ptr<CallbackEntry>;
 using CallbackBucket = std::unordered_set<CallbackEntryPtr>;
 using CallbackBucketQueue = std::deque<CallbackBucket>;
 
+/**
+ * @brief The timer which advances the wheels of the CacheMaps. The CacheMaps
+ * of an event loop with the same tick interval share one ticker, so one timer
+ * advances the wheels of all of them at each tick, instead of a timer for each
+ * cache, which matters when there are thousands of them (e.g. a cache for
+ * each tenant).
+ */
+class DROGON_EXPORT CacheMapTicker : public trantor::NonCopyable
+{
+  public:
+    /**
+     * @brief Get the ticker of the loop and the tick interval, it's created
+     * if no CacheMap uses it, and stopped when the last one releases it.
+     */
+    static std::shared_ptr<CacheMapTicker> get(trantor::EventLoop *loop,
+                                               double tickInterval);
+
+    ~CacheMapTicker();
+
+    /**
+     * @brief Add a callback called in the loop at each tick.
+     *
+     * @return The id to remove the callback.
+     * @note The callback may still be called once by a tick running in the
+     * loop while it's removed from another thread.
+     */
+    uint64_t add(std::function<void()> callback);
+
+    void remove(uint64_t id);
+
+    /// The number of callbacks.
+    size_t size() const;
+
+  private:
+    CacheMapTicker(trantor::EventLoop *loop, double tickInterval);
+    void tick();
+
+    trantor::EventLoop *loop_;
+    double tickInterval_;
+    trantor::TimerId timerId_{0};
+    mutable std::mutex mutex_;
+    bool loopEnded_{false};
+    uint64_t nextId_{0};
+    std::map<uint64_t, std::shared_ptr<std::function<void()>>> callbacks_;
+};
+
 /**
  * @brief Cache Map
  *
@@ -66,6 +114,8 @@ using CallbackBucketQueue = std::deque<CallbackBucket>;
  * @note
  * Four wheels with 200 buckets per wheel means the cache map can work with a
  * timeout up to 200^4 seconds (about 50 years).
+ * The wheels of the cache maps of a loop with the same tick interval are
+ * advanced by a shared timer, see CacheMapTicker.
  */
 template <typename T1, typename T2>
 class CacheMap
@@ -109,34 +159,30 @@ class CacheMap
         }
         if (tickInterval_ > 0 && wheelsNumber_ > 0 && bucketsNumPerWheel_ > 0)
         {
-            timerId_ = loop_->runEvery(
-                tickInterval_, [this, ctrlBlockPtr = ctrlBlockPtr_]() {
-                    std::lock_guard<std::mutex> lock(ctrlBlockPtr->mtx);
-                    if (ctrlBlockPtr->destructed)
-                        return;
-
-                    size_t t = ++ticksCounter_;
-                    size_t pow = 1;
-                    for (size_t i = 0; i < wheelsNumber_; ++i)
+            tickerPtr_ = CacheMapTicker::get(loop_, tickInterval_);
+            tickId_ = tickerPtr_->add([this, ctrlBlockPtr = ctrlBlockPtr_]() {
+                std::lock_guard<std::mutex> lock(ctrlBlockPtr->mtx);
+                if (ctrlBlockPtr->destructed)
+                    return;
+
+                size_t t = ++ticksCounter_;
+                size_t pow = 1;
+                for (size_t i = 0; i < wheelsNumber_; ++i)
+                {
+                    if ((t % pow) == 0)
                     {
-                        if ((t % pow) == 0)
+                        CallbackBucket tmp;
                         {
-                            CallbackBucket tmp;
-                            {
-                                std::lock_guard<std::mutex> lock(bucketMutex_);
-                                // use tmp val to make this critical area as
-                                // short as possible.
-                                wheels_[i].front().swap(tmp);
-                                wheels_[i].pop_front();
-                                wheels_[i].push_back(CallbackBucket());
-                            }
+                            std::lock_guard<std::mutex> lock(bucketMutex_);
+                            // use tmp val to make this critical area as
+                            // short as possible.
+                            wheels_[i].front().swap(tmp);
+                            wheels_[i].pop_front();
+                            wheels_[i].push_back(CallbackBucket());
                         }
-                        pow = pow * bucketsNumPerWheel_;
                     }
-                });
-            loop_->runOnQuit([ctrlBlockPtr = ctrlBlockPtr_] {
-                std::lock_guard<std::mutex> lock(ctrlBlockPtr->mtx);
-                ctrlBlockPtr->loopEnded = true;
+                    pow = pow * bucketsNumPerWheel_;
+                }
             });
         }
         else
@@ -150,9 +196,9 @@ class CacheMap
         std::lock_guard<std::mutex> lock(ctrlBlockPtr_->mtx);
         ctrlBlockPtr_->destructed = true;
         map_.clear();
-        if (!ctrlBlockPtr_->loopEnded)
+        if (tickerPtr_)
         {
-            loop_->invalidateTimer(timerId_);
+            tickerPtr_->remove(tickId_);
         }
         for (auto iter = wheels_.rbegin(); iter != wheels_.rend(); ++iter)
         {
@@ -426,24 +472,37 @@ class CacheMap
         insertEntry(delay, std::make_shared<CallbackEntry>(task));
     }
 
+    /**
+     * @brief Put the entry into the wheels, the callback of the entry is
+     * called when it's released by the wheels, i.e. after at least 'delay'
+     * seconds. Scheduling an entry which is still in the wheels postpones the
+     * callback.
+     *
+     * @note Nothing is done if the cache has no wheels.
+     */
+    void scheduleEntry(size_t delay, CallbackEntryPtr entryPtr)
+    {
+        if (noWheels_)
+            return;
+        std::lock_guard<std::mutex> lock(bucketMutex_);
+        insertEntry(delay, std::move(entryPtr));
+    }
+
   private:
     /**
      * @brief ControlBlock in a internal structure that deals with synchronizing
-     * CacheMap destructing, event loop destructing and updating the CacheMap.
-     * It is possible that the EventLoop destructed before the CacheMap (ex:
-     * both CacheMap and the EventLoop being globals, the order of destruction
-     * is not defined), thus we shouldn't invalidate the time. Or CacheMap
-     * destructed before the event loop but the timer is still active. Thus we
-     * should avoid updating the CacheMap.
+     * CacheMap destructing and updating the CacheMap. The CacheMap may be
+     * destructed while a tick of the shared ticker is running, thus we should
+     * avoid updating the CacheMap. The ticker deals with the event loop
+     * destructing before the CacheMap.
      */
     struct ControlBlock
     {
-        ControlBlock() : destructed(false), loopEnded(false)
+        ControlBlock() : destructed(false)
         {
         }
 
         bool destructed;
-        bool loopEnded;
         std::mutex mtx;
     };
 
@@ -455,7 +514,8 @@ class CacheMap
 
     std::mutex mtx_;
     std::mutex bucketMutex_;
-    trantor::TimerId timerId_;
+    std::shared_ptr<CacheMapTicker> tickerPtr_;
+    uint64_t tickId_{0};
     trantor::EventLoop *loop_;
 
     float tickInterval_;
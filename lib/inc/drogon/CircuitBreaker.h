@@ -0,0 +1,115 @@
+/**
+ *
+ *  @file CircuitBreaker.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+namespace drogon
+{
+/**
+ * @brief A circuit breaker failing the calls to a server fast while it's
+ * down, instead of letting them wait for a connection or a timeout.
+ *
+ * The outcomes of the calls are counted in a window of time, the circuit
+ * opens when the failure rate of the window reaches the threshold, the calls
+ * with a latency over the slow call threshold counting as failures. The calls
+ * are rejected while the circuit is open, then a few probe calls are let
+ * through (the half-open state): the circuit closes again if they all
+ * succeed and opens again at the first failure.
+ *
+ * A breaker is given to the clients with HttpClient::setCircuitBreaker(),
+ * orm::DbClient::setCircuitBreaker() or nosql::RedisClient::setCircuitBreaker()
+ * and can be shared by several clients of the same server. It can be used
+ * for other calls too, with allow() and record().
+ */
+class DROGON_EXPORT CircuitBreaker
+{
+  public:
+    enum class State
+    {
+        Closed,
+        Open,
+        HalfOpen
+    };
+
+    struct Options
+    {
+        /// The rate of failed calls in the window which opens the circuit.
+        double failureRateThreshold{0.5};
+        /// The calls taking this number of seconds or more count as failed,
+        /// 0 means the latency isn't checked.
+        double slowCallThreshold{0.0};
+        /// The circuit isn't opened before this number of calls in the
+        /// window.
+        size_t minimumCalls{20};
+        /// The length of the window, in seconds.
+        double window{10.0};
+        /// The number of seconds the circuit stays open.
+        double openDuration{5.0};
+        /// The number of probe calls in the half-open state, at least 1.
+        size_t halfOpenProbes{3};
+    };
+
+    CircuitBreaker();
+    explicit CircuitBreaker(const Options &options);
+
+    /**
+     * @brief Check if a call is allowed.
+     *
+     * @return false if the circuit is open, or half-open with all the probe
+     * calls in progress. The outcome of every allowed call must then be given
+     * to record().
+     */
+    bool allow();
+
+    /**
+     * @brief Record the outcome of a call allowed by allow().
+     *
+     * @param success false if the call failed because of the server, e.g. a
+     * network error or a timeout.
+     * @param latency The duration of the call in seconds.
+     */
+    void record(bool success, double latency);
+
+    State state() const;
+
+    const Options &options() const
+    {
+        return options_;
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    void open(Clock::time_point now);
+    void close(Clock::time_point now);
+
+    Options options_;
+    mutable std::mutex mutex_;
+    State state_{State::Closed};
+    Clock::time_point windowStart_;
+    size_t calls_{0};
+    size_t failures_{0};
+    Clock::time_point openUntil_;
+    size_t probesAllowed_{0};
+    size_t probesRecorded_{0};
+};
+
+using CircuitBreakerPtr = std::shared_ptr<CircuitBreaker>;
+}  // namespace drogon
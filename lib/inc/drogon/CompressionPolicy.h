@@ -0,0 +1,96 @@
+/**
+ *
+ *  @file CompressionPolicy.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by the MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/HttpTypes.h>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace drogon
+{
+enum class CompressionEncoding
+{
+    kGzip,
+    kBrotli,
+    kZstd
+};
+
+inline const char *compressionEncodingToString(CompressionEncoding encoding)
+{
+    switch (encoding)
+    {
+        case CompressionEncoding::kBrotli:
+            return "br";
+        case CompressionEncoding::kZstd:
+            return "zstd";
+        case CompressionEncoding::kGzip:
+        default:
+            return "gzip";
+    }
+}
+
+/**
+ * @brief The way the bodies of responses are compressed. A policy can be set
+ * for the paths with a prefix by HttpAppFramework::setCompressionPolicy() or
+ * for a single response by HttpResponse::setCompressionPolicy(), so that for
+ * example dynamic JSON is compressed with a fast level and cacheable bodies
+ * with a slow one.
+ */
+struct CompressionPolicy
+{
+    /**
+     * The encodings in the order of preference, the first one accepted by the
+     * client is used. Encodings drogon is built without are skipped.
+     */
+    std::vector<CompressionEncoding> encodings{CompressionEncoding::kBrotli,
+                                              CompressionEncoding::kGzip};
+    /// From 1 (best speed) to 9 (best compression), -1 means the zlib default
+    int gzipLevel{-1};
+    /// From 0 (best speed) to 11 (best compression)
+    int brotliQuality{5};
+    /// From 1 (best speed) to 19 (best compression)
+    int zstdLevel{3};
+    /// Bodies shorter than this are not compressed
+    size_t minSize{1024};
+    /**
+     * The content types to compress, the empty list means all the types which
+     * are not binary.
+     */
+    std::vector<ContentType> contentTypes;
+
+    bool shouldCompress(ContentType type) const
+    {
+        if (contentTypes.empty())
+            return type < CT_APPLICATION_OCTET_STREAM;
+        return std::find(contentTypes.begin(), contentTypes.end(), type) !=
+               contentTypes.end();
+    }
+
+    /// Return the level of the encoding set by the above members
+    int level(CompressionEncoding encoding) const
+    {
+        switch (encoding)
+        {
+            case CompressionEncoding::kBrotli:
+                return brotliQuality;
+            case CompressionEncoding::kZstd:
+                return zstdLevel;
+            case CompressionEncoding::kGzip:
+            default:
+                return gzipLevel;
+        }
+    }
+};
+}  // namespace drogon
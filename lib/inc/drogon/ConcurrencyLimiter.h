@@ -0,0 +1,140 @@
+/**
+ *
+ *  @file ConcurrencyLimiter.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/HttpMiddleware.h>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief A middleware limiting the number of requests handled at the same
+ * time by each handler.
+ *
+ * The requests over the limit of their handler wait in a queue and the ones
+ * which can't be queued, or wait longer than the maximum queue time, get a
+ * 503 response with a Retry-After header. A limit on the requests in flight
+ * across all the handlers can be set too.
+ *
+ * When the adaptive option is set, the limit of a handler moves between the
+ * minimum and the maximum with the gradient of its latencies: the ratio of
+ * the long-term average latency to the recent one. The limit goes down when
+ * the latency rises, so that the overload is shed early instead of piling up
+ * in the queue, and goes up again when the latency recovers.
+ *
+ * The handlers are identified by their path pattern. Use the name
+ * "drogon::ConcurrencyLimiter" to add it to handlers, and
+ * DrClassMap::getSingleInstance<ConcurrencyLimiter>() to configure it.
+ */
+class DROGON_EXPORT ConcurrencyLimiter
+    : public HttpMiddleware<ConcurrencyLimiter>
+{
+  public:
+    struct Options
+    {
+        /// The maximum number of requests in flight, 0 means no limit.
+        size_t maxInflight{0};
+        /// The maximum number of waiting requests.
+        size_t maxQueue{0};
+        /// The waiting requests are rejected after this number of seconds.
+        double maxQueueTime{1.0};
+        /// Adapt the limit to the latencies, with maxInflight as its upper
+        /// bound, 1000 if it is 0.
+        bool adaptive{false};
+        /// The lower bound of the adaptive limit.
+        size_t minInflight{1};
+    };
+
+    ConcurrencyLimiter() = default;
+
+    void invoke(const HttpRequestPtr &req,
+                MiddlewareNextCallback &&nextCb,
+                MiddlewareCallback &&mcb) override;
+
+    /// Set the options of the handlers which have none of their own.
+    void setDefaultOptions(const Options &options);
+
+    /// Set the options of the handler of the path pattern.
+    void setOptions(const std::string &pathPattern, const Options &options);
+
+    /// The maximum number of requests in flight for all the handlers, 0 by
+    /// default for no limit. The requests over it are rejected at once.
+    void setMaxTotalInflight(size_t maxTotalInflight)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxTotalInflight_ = maxTotalInflight;
+    }
+
+    /// The number of requests in flight for the path pattern
+    size_t inflight(const std::string &pathPattern) const;
+
+    /// The number of waiting requests for the path pattern
+    size_t queued(const std::string &pathPattern) const;
+
+    /// The current limit for the path pattern, 0 if there is none
+    size_t limit(const std::string &pathPattern) const;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Waiter
+    {
+        HttpRequestPtr req;
+        MiddlewareNextCallback nextCb;
+        MiddlewareCallback mcb;
+        Clock::time_point enqueuedAt;
+        // Set when the waiter was either run or rejected.
+        bool done{false};
+    };
+    using WaiterPtr = std::shared_ptr<Waiter>;
+
+    struct Route
+    {
+        Options options;
+        size_t inflight{0};
+        double limit{0.0};
+        // The smoothed latencies, in seconds.
+        double shortLatency{0.0};
+        double longLatency{0.0};
+        std::deque<WaiterPtr> queue;
+    };
+
+    Route &route(const std::string &pathPattern);
+    void run(const std::string &pathPattern,
+             MiddlewareNextCallback &&nextCb,
+             MiddlewareCallback &&mcb);
+    void onComplete(const std::string &pathPattern, double latency);
+    void updateLimit(Route &route, double latency);
+    void dropExpired(Route &route, std::vector<WaiterPtr> &expired);
+    void expire(const std::string &pathPattern, const WaiterPtr &waiter);
+    static void reject(const HttpRequestPtr &req,
+                       const MiddlewareCallback &mcb);
+
+    mutable std::mutex mutex_;
+    Options defaultOptions_;
+    size_t maxTotalInflight_{0};
+    size_t totalInflight_{0};
+    // The options set by setOptions(), kept for the routes created later.
+    std::unordered_map<std::string, Options> routeOptions_;
+    std::unordered_map<std::string, Route> routes_;
+};
+}  // namespace drogon
@@ -20,6 +20,7 @@
 #include <cctype>
 #include <string>
 #include <limits>
+#include <memory>
 #include <optional>
 #include <string_view>
 
@@ -58,6 +59,7 @@ class DROGON_EXPORT Cookie
     void setExpiresDate(const trantor::Date &date)
     {
         expiresDate_ = date;
+        attributesString_.reset();
     }
 
     /**
@@ -66,6 +68,7 @@ class DROGON_EXPORT Cookie
     void setHttpOnly(bool only)
     {
         httpOnly_ = only;
+        attributesString_.reset();
     }
 
     /**
@@ -74,6 +77,7 @@ class DROGON_EXPORT Cookie
     void setSecure(bool secure)
     {
         secure_ = secure;
+        attributesString_.reset();
     }
 
     /**
@@ -82,6 +86,7 @@ class DROGON_EXPORT Cookie
     void setDomain(const std::string &domain)
     {
         domain_ = domain;
+        attributesString_.reset();
     }
 
     /**
@@ -90,6 +95,7 @@ class DROGON_EXPORT Cookie
     void setDomain(std::string &&domain)
     {
         domain_ = std::move(domain);
+        attributesString_.reset();
     }
 
     /**
@@ -98,6 +104,7 @@ class DROGON_EXPORT Cookie
     void setPath(const std::string &path)
     {
         path_ = path;
+        attributesString_.reset();
     }
 
     /**
@@ -106,6 +113,7 @@ class DROGON_EXPORT Cookie
     void setPath(std::string &&path)
     {
         path_ = std::move(path);
+        attributesString_.reset();
     }
 
     /**
@@ -146,6 +154,7 @@ class DROGON_EXPORT Cookie
     void setMaxAge(int value)
     {
         maxAge_ = value;
+        attributesString_.reset();
     }
 
     /**
@@ -154,6 +163,7 @@ class DROGON_EXPORT Cookie
     void setSameSite(SameSite sameSite)
     {
         sameSite_ = sameSite;
+        attributesString_.reset();
     }
 
     /**
@@ -162,12 +172,25 @@ class DROGON_EXPORT Cookie
     void setPartitioned(bool partitioned)
     {
         partitioned_ = partitioned;
+        attributesString_.reset();
         if (partitioned)
         {
             setSecure(true);
         }
     }
 
+    /**
+     * @brief Serialize the attributes of the cookie (all but its key and its
+     * value) once, they are then shared by the copies of the cookie. This is
+     * for cookies which only differ by their values, e.g. the session
+     * cookie. Setting an attribute drops the serialized string.
+     */
+    void freezeAttributes()
+    {
+        attributesString_ =
+            std::make_shared<const std::string>(makeAttributesString());
+    }
+
     /**
      * @brief Get the string value of the cookie
      */
@@ -414,6 +437,9 @@ class DROGON_EXPORT Cookie
     }
 
   private:
+    // "; Path=/; HttpOnly\r\n", the part of cookieString() after the value
+    std::string makeAttributesString() const;
+
     trantor::Date expiresDate_{(std::numeric_limits<int64_t>::max)()};
     bool httpOnly_{true};
     bool secure_{false};
@@ -424,6 +450,7 @@ class DROGON_EXPORT Cookie
     std::string value_;
     std::optional<int> maxAge_;
     SameSite sameSite_{SameSite::kNull};
+    std::shared_ptr<const std::string> attributesString_;
 };
 
 }  // namespace drogon
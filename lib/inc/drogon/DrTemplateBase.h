@@ -51,6 +51,22 @@ class DROGON_EXPORT DrTemplateBase : public virtual DrObjectBase
     virtual std::string genText(
         const DrTemplateData &data = DrTemplateData()) = 0;
 
+    /// Append the generated text to the output
+    /**
+     * The views created by drogon_ctl render straight into the output,
+     * reserving the length of their previous rendering, and their sub-views
+     * and layouts append to the same buffer. The other templates append the
+     * string returned by genText().
+     */
+    virtual void renderTo(std::string &output,
+                          const DrTemplateData &data = DrTemplateData())
+    {
+        if (output.empty())
+            output = genText(data);
+        else
+            output.append(genText(data));
+    }
+
     virtual ~DrTemplateBase(){};
     DrTemplateBase(){};
 };
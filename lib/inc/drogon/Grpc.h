@@ -0,0 +1,373 @@
+/**
+ *
+ *  @file Grpc.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief The gRPC protocol over the HTTP/2 support of HttpServer and
+ * HttpClient (https://github.com/grpc/grpc/blob/master/doc/PROTOCOL-HTTP2.md).
+ *
+ * The messages are the serialized bytes, or any type with the API of the
+ * protobuf messages (ByteSizeLong(), SerializeToArray() and
+ * ParseFromArray()), which are serialized directly into the buffers of the
+ * requests and the responses. Drogon doesn't depend on protobuf itself.
+ *
+ * The methods are registered as handlers of POST requests, so they go
+ * through the middlewares and the AOP advices like the other handlers:
+ * @code
+   grpc::registerUnaryMethod<HelloRequest, HelloReply>(
+       "/helloworld.Greeter/SayHello",
+       [](const HttpRequestPtr &req,
+          HelloRequest &&request,
+          grpc::UnaryCallback<HelloReply> &&callback) {
+           HelloReply reply;
+           reply.set_message("Hello " + request.name());
+           callback({}, reply);
+       });
+   ...
+   auto client = HttpClient::newHttpClient("http://127.0.0.1:50051");
+   client->enableHttp2(true, true);
+   grpc::call<HelloReply>(client,
+                          "/helloworld.Greeter/SayHello",
+                          request,
+                          [](const grpc::Status &status,
+                             HelloReply &&reply) { ... });
+   @endcode
+ *
+ * @note The messages compressed by the peers (with the compressed flag set)
+ * and the client streaming calls aren't supported, and the calls must use
+ * HTTP/2. The streamed responses are received whole by the clients.
+ */
+namespace grpc
+{
+/// The status codes of gRPC
+enum class StatusCode
+{
+    Ok = 0,
+    Cancelled = 1,
+    Unknown = 2,
+    InvalidArgument = 3,
+    DeadlineExceeded = 4,
+    NotFound = 5,
+    AlreadyExists = 6,
+    PermissionDenied = 7,
+    ResourceExhausted = 8,
+    FailedPrecondition = 9,
+    Aborted = 10,
+    OutOfRange = 11,
+    Unimplemented = 12,
+    Internal = 13,
+    Unavailable = 14,
+    DataLoss = 15,
+    Unauthenticated = 16
+};
+
+struct Status
+{
+    StatusCode code{StatusCode::Ok};
+    std::string message;
+
+    bool ok() const
+    {
+        return code == StatusCode::Ok;
+    }
+};
+
+namespace internal
+{
+template <typename T, typename = void>
+struct IsMessage : std::false_type
+{
+};
+
+template <typename T>
+struct IsMessage<
+    T,
+    std::void_t<decltype(std::declval<const T &>().ByteSizeLong()),
+                decltype(std::declval<const T &>().SerializeToArray(
+                    std::declval<void *>(),
+                    0)),
+                decltype(std::declval<T &>().ParseFromArray(
+                    std::declval<const void *>(),
+                    0))>> : std::true_type
+{
+};
+
+DROGON_EXPORT char *appendPrefix(std::string &out, size_t length);
+}  // namespace internal
+
+/// Append the message to the body, prefixed by its length.
+DROGON_EXPORT void appendMessage(std::string &out, std::string_view message);
+
+/// Serialize the message into the body, prefixed by its length.
+template <typename T,
+          std::enable_if_t<internal::IsMessage<T>::value, int> = 0>
+void appendMessage(std::string &out, const T &message)
+{
+    auto length = static_cast<size_t>(message.ByteSizeLong());
+    auto data = internal::appendPrefix(out, length);
+    message.SerializeToArray(data, static_cast<int>(length));
+}
+
+/**
+ * @brief Split the body into its messages, which are views of the body.
+ * Return false if the body is truncated, or if a message is compressed.
+ */
+DROGON_EXPORT bool parseMessages(std::string_view body,
+                                 std::vector<std::string_view> &messages);
+
+template <typename T>
+bool parseMessage(std::string_view data, T &message)
+{
+    if constexpr (internal::IsMessage<T>::value)
+        return message.ParseFromArray(data.data(),
+                                      static_cast<int>(data.length()));
+    else
+    {
+        message.assign(data.data(), data.length());
+        return true;
+    }
+}
+
+/**
+ * @brief Create the response of a call, made of the body of framed
+ * messages (see appendMessage()) and the status, which is sent in the
+ * trailers.
+ */
+DROGON_EXPORT HttpResponsePtr newResponse(std::string body,
+                                          const Status &status = {});
+
+/// Create the response of a failed call.
+DROGON_EXPORT HttpResponsePtr newErrorResponse(const Status &status);
+
+template <typename T>
+HttpResponsePtr newMessageResponse(const T &message)
+{
+    std::string body;
+    appendMessage(body, message);
+    return newResponse(std::move(body));
+}
+
+/// Percent-encode the status message for the grpc-message trailer.
+DROGON_EXPORT std::string encodeStatusMessage(std::string_view message);
+DROGON_EXPORT std::string decodeStatusMessage(std::string_view message);
+
+/**
+ * @brief Get the status of a call from its response, the grpc-status field
+ * of the trailers, or of the headers if the response only has headers, or
+ * from the HTTP status if there is none.
+ */
+DROGON_EXPORT Status statusOf(const HttpResponsePtr &response);
+
+/**
+ * @brief The writer of the messages of a server streaming call. The status
+ * is sent when finish() is called, or when the writer is destroyed.
+ */
+class DROGON_EXPORT ServerWriter
+{
+  public:
+    ServerWriter(ResponseStreamPtr stream, std::weak_ptr<HttpResponse> resp);
+    ~ServerWriter();
+
+    /// Return false if the message can't be sent, e.g. when the client is
+    /// gone.
+    bool write(std::string_view message);
+
+    template <typename T,
+              std::enable_if_t<internal::IsMessage<T>::value, int> = 0>
+    bool write(const T &message)
+    {
+        std::string data;
+        appendMessage(data, message);
+        return writeFramed(data);
+    }
+
+    void finish(const Status &status = {});
+
+  private:
+    bool writeFramed(const std::string &data);
+
+    ResponseStreamPtr stream_;
+    std::weak_ptr<HttpResponse> response_;
+};
+
+using ServerWriterPtr = std::unique_ptr<ServerWriter>;
+
+/// Create the response of a server streaming call, the messages are written
+/// by the writer given to the callback.
+DROGON_EXPORT HttpResponsePtr
+newStreamResponse(const std::function<void(ServerWriterPtr)> &callback);
+
+template <typename Response>
+using UnaryCallback =
+    std::function<void(const Status &status, const Response &response)>;
+
+namespace internal
+{
+// Parse the only message of the request, or respond with an error.
+template <typename Request>
+bool parseRequest(const HttpRequestPtr &req,
+                  Request &request,
+                  std::function<void(const HttpResponsePtr &)> &callback)
+{
+    if (req->getHeader("content-type").rfind("application/grpc", 0) != 0)
+    {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(k415UnsupportedMediaType);
+        callback(resp);
+        return false;
+    }
+    std::vector<std::string_view> messages;
+    if (!parseMessages(req->body(), messages) || messages.size() != 1 ||
+        !parseMessage(messages[0], request))
+    {
+        callback(newErrorResponse(
+            {StatusCode::InvalidArgument, "Bad request message"}));
+        return false;
+    }
+    return true;
+}
+}  // namespace internal
+
+/**
+ * @brief Register a unary method.
+ *
+ * @param path The path of the method, "/<package>.<service>/<method>".
+ * @param constraints The middlewares of the method, see
+ * HttpAppFramework::registerHandler().
+ */
+template <typename Request, typename Response>
+void registerUnaryMethod(
+    const std::string &path,
+    std::function<void(const HttpRequestPtr &,
+                       Request &&,
+                       UnaryCallback<Response> &&)> handler,
+    std::vector<drogon::internal::HttpConstraint> constraints = {})
+{
+    constraints.emplace_back(Post);
+    app().registerHandler(
+        path,
+        [handler = std::move(handler)](
+            const HttpRequestPtr &req,
+            std::function<void(const HttpResponsePtr &)> &&callback) {
+            Request request;
+            if (!internal::parseRequest(req, request, callback))
+                return;
+            handler(req,
+                    std::move(request),
+                    [callback = std::move(callback)](const Status &status,
+                                                     const Response &resp) {
+                        if (!status.ok())
+                        {
+                            callback(newErrorResponse(status));
+                            return;
+                        }
+                        callback(newMessageResponse(resp));
+                    });
+        },
+        constraints);
+}
+
+/// Register a server streaming method, whose messages are written by the
+/// writer given to the handler.
+template <typename Request>
+void registerServerStreamingMethod(
+    const std::string &path,
+    std::function<void(const HttpRequestPtr &, Request &&, ServerWriterPtr)>
+        handler,
+    std::vector<drogon::internal::HttpConstraint> constraints = {})
+{
+    constraints.emplace_back(Post);
+    app().registerHandler(
+        path,
+        [handler = std::move(handler)](
+            const HttpRequestPtr &req,
+            std::function<void(const HttpResponsePtr &)> &&callback) {
+            auto request = std::make_shared<Request>();
+            if (!internal::parseRequest(req, *request, callback))
+                return;
+            callback(newStreamResponse(
+                [handler, req, request](ServerWriterPtr writer) {
+                    handler(req, std::move(*request), std::move(writer));
+                }));
+        },
+        constraints);
+}
+
+/**
+ * @brief Call a method with the body of framed messages, the callback is
+ * called with the status and all the messages of the response.
+ *
+ * @param timeout The timeout of the call in seconds, 0 means no timeout.
+ */
+DROGON_EXPORT void callRaw(
+    const HttpClientPtr &client,
+    const std::string &path,
+    std::string body,
+    std::function<void(const Status &status,
+                       const std::vector<std::string_view> &messages)>
+        callback,
+    double timeout = 0);
+
+/// Call a unary method.
+template <typename Response, typename Request>
+void call(const HttpClientPtr &client,
+          const std::string &path,
+          const Request &request,
+          std::function<void(const Status &status, Response &&response)>
+              callback,
+          double timeout = 0)
+{
+    std::string body;
+    appendMessage(body, request);
+    callRaw(client,
+            path,
+            std::move(body),
+            [callback = std::move(callback)](
+                const Status &status,
+                const std::vector<std::string_view> &messages) {
+                Response response{};
+                if (!status.ok())
+                {
+                    callback(status, std::move(response));
+                    return;
+                }
+                if (messages.size() != 1 ||
+                    !parseMessage(messages[0], response))
+                {
+                    callback({StatusCode::Internal, "Bad response message"},
+                             std::move(response));
+                    return;
+                }
+                callback(status, std::move(response));
+            },
+            timeout);
+}
+}  // namespace grpc
+}  // namespace drogon
@@ -22,6 +22,7 @@
 #include <drogon/DrObject.h>
 #include <drogon/HttpBinder.h>
 #include <drogon/HttpFilter.h>
+#include <drogon/JsonEngine.h>
 #include <drogon/MultiPart.h>
 #include <drogon/NotFound.h>
 #include <drogon/drogon_callbacks.h>
@@ -33,6 +34,7 @@
 #include <drogon/orm/DbConfig.h>
 #include <drogon/nosql/RedisClient.h>
 #include <drogon/Cookie.h>
+#include <drogon/SessionStore.h>
 #include <trantor/net/Resolver.h>
 #include <trantor/net/EventLoop.h>
 #include <trantor/utils/NonCopyable.h>
@@ -79,6 +81,24 @@ using DefaultHandler =
                        std::function<void(const HttpResponsePtr &)> &&)>;
 using HttpHandlerInfo = std::tuple<std::string, HttpMethod, std::string>;
 
+/// The ways the new connections are distributed over the IO loops
+enum class ConnectionBalancing
+{
+    // Hashed by the kernel with SO_REUSEPORT, or round robin where the
+    // connections are accepted by a listening thread.
+    kKernel,
+    // Most of the new connections go to the loops with the fewest
+    // connections.
+    kLeastConnections,
+    // Most of the new connections go to the loops whose tasks wait the
+    // least time in their queues.
+    kLeastLag,
+    // The new connections go to the loop pinned to the CPU which received
+    // them, see HttpAppFramework::setIoLoopCpus(). The loops are pinned to
+    // the CPUs in order when no CPUs are set.
+    kLocalCpu
+};
+
 #ifdef __cpp_impl_coroutine
 class HttpAppFramework;
 
@@ -144,9 +164,34 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
      * @note
      * This method can be called in any thread and anywhere.
      * This method should not be called before calling run().
+     * When a graceful shutdown timeout is set, the connections are drained
+     * first, see setGracefulShutdownTimeout().
      */
     virtual void quit() = 0;
 
+    /// Set the time given to the connections to finish on quit()
+    /**
+     * @param timeout The number of seconds, 0 by default to close the
+     * connections at once. Otherwise the framework keeps serving after quit()
+     * is called, every response is sent with "connection: close", and it
+     * quits when all the connections are closed or the timeout expires.
+     *
+     * Along with the reuse port mode, this lets a new process listen on the
+     * same ports before the old one is told to quit, so the deployments don't
+     * lose the requests in flight.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     * The listening sockets can't be handed over to the new process, the
+     * connections the kernel queues for the old one while it drains are
+     * served by it with one request each.
+     */
+    virtual HttpAppFramework &setGracefulShutdownTimeout(double timeout) = 0;
+    virtual double getGracefulShutdownTimeout() const = 0;
+
+    /// Return true from the call to quit() until the connections are drained
+    virtual bool isDraining() const = 0;
+
     /// Get the main event loop of the framework;
     /**
      * @note
@@ -277,6 +322,16 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
     virtual HttpAppFramework &registerBeginningAdvice(
         const std::function<void()> &advice) = 0;
 
+    /// Register a warmup task
+    /**
+     * @param task is called in the main event loop after the beginning
+     * advices, with a callback it must call once when it is done, from any
+     * thread. The listeners start accepting the connections when all the
+     * tasks are done, so the caches can be filled before the first requests.
+     */
+    virtual HttpAppFramework &registerWarmupTask(
+        const std::function<void(std::function<void()> &&done)> &task) = 0;
+
     /// Register an advice for new connections
     /**
      * @param advice is called immediately when a new connection is
@@ -479,6 +534,41 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
     virtual HttpAppFramework &loadConfigJson(Json::Value &&data) noexcept(
         false) = 0;
 
+    /// Reload the configuration file when it's changed, without a restart.
+    /**
+     * @param checkInterval The number of seconds between the checks of the
+     * modification time of the file loaded by loadConfigFile().
+     * @note Only the options which can be changed safely while running are
+     * applied: log.log_level, static_files_cache_time and
+     * static_file_stat_cache_time of the app section (the stat cache must be
+     * enabled at startup to be used). The changes of the other options, e.g.
+     * the listeners or the database clients, need a restart and are ignored.
+     * A file which can't be parsed is ignored with an error log, the current
+     * options are kept. The options can also be reloaded by the callbacks
+     * registered with registerConfigReloadCallback().
+     * The "config_reload_interval" option of the app section in the
+     * configuration file enables it too.
+     */
+    virtual HttpAppFramework &enableConfigReload(
+        double checkInterval = 1.0) = 0;
+
+    /// Reload the configuration file now, e.g. on a signal.
+    /**
+     * @note This method is thread-safe, the file is reloaded in the main
+     * event loop.
+     */
+    virtual void reloadConfig() = 0;
+
+    /// Register a callback called with the new configuration when it's
+    /// reloaded.
+    /**
+     * @note The callback is called in the main event loop, it may be
+     * registered by the plugins in their initAndStart(). getCustomConfig()
+     * keeps returning the configuration loaded at startup.
+     */
+    virtual HttpAppFramework &registerConfigReloadCallback(
+        const std::function<void(const Json::Value &)> &callback) = 0;
+
     /// Register a HttpSimpleController object into the framework.
     /**
      * @param pathName When the path of a http request is equal to the
@@ -487,7 +577,8 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
      * @param ctrlName is the name of the controller. It includes the namespace
      * to which the controller belongs.
      * @param constraints is a vector containing Http methods or middleware
-     names
+     names, and the Offload constraint to run the controller in the pool of
+     the handler threads.
      *
      *   Example:
      * @code
@@ -556,6 +647,15 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
             {
                 validMethods.push_back(constraint.getHttpMethod());
             }
+            else if (constraint.type() == internal::ConstraintType::Offload)
+            {
+                binder->setOffloaded(true);
+            }
+            else if (constraint.type() ==
+                     internal::ConstraintType::LowPriority)
+            {
+                binder->setLowPriority(true);
+            }
             else
             {
                 LOG_ERROR << "Invalid controller constraint type";
@@ -607,6 +707,15 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
             {
                 validMethods.push_back(constraint.getHttpMethod());
             }
+            else if (constraint.type() == internal::ConstraintType::Offload)
+            {
+                binder->setOffloaded(true);
+            }
+            else if (constraint.type() ==
+                     internal::ConstraintType::LowPriority)
+            {
+                binder->setLowPriority(true);
+            }
             else
             {
                 LOG_ERROR << "Invalid controller constraint type";
@@ -762,6 +871,23 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
         std::function<void(const HttpResponsePtr &)> &&callback,
         const std::string &hostString = "",
         double timeout = 0) = 0;
+
+    /// Set the options of the connection pools of forward().
+    /**
+     * The requests forwarded to a host are sent over a HttpClientPool of
+     * keep-alive connections in every IO loop, which is created by the first
+     * request to the host.
+     *
+     * @param connectionsPerHost The maximum number of connections to each
+     * host in each IO loop, 4 by default.
+     * @param idleTimeout The connections idle for this number of seconds are
+     * closed, 60 by default. 0 keeps them forever.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setForwardPoolOptions(size_t connectionsPerHost,
+                                                    double idleTimeout) = 0;
 #ifdef __cpp_impl_coroutine
     /**
      * @brief Forward the http request, this is the coroutine version of the
@@ -804,6 +930,21 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
     /// Get the number of threads for IO event loops
     virtual size_t getThreadNum() const = 0;
 
+    /// Set the number of threads running the handlers registered with the
+    /// Offload constraint
+    /**
+     * @param threadNum the number of threads
+     * The default value is 0, which means the number of CPU cores. The
+     * threads are started when the first of these handlers is called.
+     *
+     * @note
+     * This number can be configured in the configuration file.
+     */
+    virtual HttpAppFramework &setHandlerThreadNum(size_t threadNum) = 0;
+
+    /// Get the number of threads running the offloaded handlers
+    virtual size_t getHandlerThreadNum() const = 0;
+
     /// Set the global cert file and private key file for https
     /// These options can be configured in the configuration file.
     virtual HttpAppFramework &setSSLFiles(const std::string &certPath,
@@ -871,6 +1012,24 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
         const std::vector<std::pair<std::string, std::string>> &sslConfCmds =
             {}) = 0;
 
+    /// Add a listener for http service on a unix domain socket
+    /**
+     * @param path is the path of the socket file, a socket file left at the
+     * path is replaced, the file is removed when the application quits.
+     * @param mode is the permissions of the socket file, the processes
+     * connecting to the socket need the write permission.
+     *
+     * @note
+     * The connections are accepted by one thread and handled by the IO loops.
+     * The peer addresses of the connections aren't IP addresses, so the
+     * limit of the connections from one IP address applies to all the
+     * connections to the socket together.
+     * Not supported on Windows.
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &addUnixListener(const std::string &path,
+                                              int mode = 0660) = 0;
+
     /// Enable sessions supporting.
     /**
      * @param timeout The number of seconds which is the timeout of a session
@@ -934,6 +1093,43 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
      */
     virtual HttpAppFramework &disableSession() = 0;
 
+    /// Find sessions lazily when they are accessed for the first time.
+    /**
+     * @param enable If true, the session of a request is found by the first
+     * call to HttpRequest::session(). Requests that never access their
+     * sessions don't create new sessions, don't refresh the timeout of their
+     * sessions and don't send session cookies.
+     *
+     * @note
+     * When a session store is used, the sessions of the requests with
+     * session cookies which aren't cached locally are still loaded from the
+     * store before the requests are handled, since they can't be loaded
+     * synchronously. They are only used if they are accessed, like the
+     * others.
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &enableLazySession(bool enable = true) = 0;
+
+    /// Store sessions in an external session store.
+    /**
+     * @param store The session store, e.g. a RedisSessionStore.
+     * @param localCacheTimeout The number of seconds for which a session is
+     * cached locally after its last access. Sessions changed by other nodes
+     * may be seen after this time.
+     * @param writeBehindInterval The interval in seconds at which the changed
+     * sessions are written back to the store.
+     *
+     * @note
+     * This method must be called before the framework is run, and sessions
+     * must be enabled by the enableSession() method. Session data is shared
+     * by all the nodes using the same store, so they can run without sticky
+     * load balancing.
+     */
+    virtual HttpAppFramework &setSessionStore(
+        SessionStorePtr store,
+        size_t localCacheTimeout = 5,
+        double writeBehindInterval = 0.5) = 0;
+
     /// Set the root path of HTTP document, default path is ./
     /**
      * @note
@@ -1046,6 +1242,28 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
     virtual HttpAppFramework &setMaxConnectionNumPerIP(
         size_t maxConnectionsPerIP) = 0;
 
+    /// Set the soft limit of the memory held by the HTTP connections
+    /**
+     * @param limit The number of bytes, 0 by default for no limit. The
+     * request bodies stored in memory, the input waiting to be parsed and the
+     * output queued in the sockets beyond 64KB per connection are counted.
+     *
+     * While the limit is reached the input of the connections isn't parsed,
+     * so no handler is called for it, and the new connections are closed
+     * right away. It resumes when the responses have been sent and the
+     * requests released, bursts are slowed down instead of exhausting the
+     * memory.
+     *
+     * @note
+     * The bytes are still read from the sockets while the input is held, it
+     * is bounded by what the clients send without getting a response. The
+     * bodies stored in temporary files are not counted, see
+     * setClientMaxMemoryBodySize().
+     *
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setMemorySoftLimit(size_t limit) = 0;
+
     /// Make the application run as a daemon.
     /**
      * Disabled by default.
@@ -1074,6 +1292,34 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
      */
     virtual HttpAppFramework &enableRelaunchOnError() = 0;
 
+    /**
+     * @brief Run the application in worker processes forked by the process
+     * calling run(), which supervises them.
+     *
+     * Nothing is shared between the workers: each one has its own IO loops,
+     * listeners, database clients, plugins and caches. The listeners of the
+     * workers bind the same ports with the reuse port option, which is
+     * enabled in the workers, so the kernel balances the new connections
+     * between them on Linux. A worker which crashes is forked again, and the
+     * SIGTERM and SIGINT signals received by the supervisor are forwarded to
+     * the workers. The workers write their logs to their own files, suffixed
+     * with their index.
+     *
+     * @param num The number of workers, 0 or 1 to run in one process.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     * Not supported on Windows. Each worker serves its own metrics, e.g. to
+     * the PromExporter plugin, they aren't aggregated between the workers.
+     */
+    virtual HttpAppFramework &setWorkerProcessNum(size_t num) = 0;
+
+    /// Get the number of worker processes set by setWorkerProcessNum().
+    virtual size_t getWorkerProcessNum() const = 0;
+
+    /// The index of the current worker process from 0, 0 without workers.
+    virtual size_t getWorkerIndex() const = 0;
+
     /**
      * @brief Set the output path of logs.
      * @param logPath The path to logs - logs to console if empty.
@@ -1161,6 +1407,57 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
     /// Return true if brotli is enabled.
     virtual bool isBrotliEnabled() const = 0;
 
+    /// Set the compression policy of the paths with the prefix.
+    /**
+     * @param pathPrefix the prefix of the request paths, for example "/api".
+     * The longest matching prefix is used.
+     * @param policy the encodings in the order of preference, their levels,
+     * the minimum size and the content types to compress.
+     *
+     * @note
+     * This operation can be performed by the compression_policies option in
+     * the configuration file. The paths without a policy use the encodings
+     * enabled by enableBrotli() and enableGzip(). The policy of a response set
+     * by HttpResponse::setCompressionPolicy() takes precedence.
+     */
+    virtual HttpAppFramework &setCompressionPolicy(
+        const std::string &pathPrefix,
+        const CompressionPolicy &policy) = 0;
+
+    /// Enable HTTP/2.
+    /**
+     * @param enable if the parameter is true, clients can talk HTTP/2 to the
+     * server. HTTP/2 is negotiated by ALPN on HTTPS listeners, and is used on
+     * plain listeners when the client starts with the HTTP/2 connection preface
+     * (prior knowledge). The h2c upgrade from HTTP/1.1 is not supported.
+     * The default value is false.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &enableHttp2(bool enable) = 0;
+
+    /// Return true if HTTP/2 is enabled.
+    virtual bool isHttp2Enabled() const = 0;
+
+    /// Enable the zero copy mode of request headers.
+    /**
+     * @param enable if the parameter is true, the headers of a HTTP/1.x
+     * request are kept in one buffer which is reused with the request object,
+     * and a std::string for a header is only created when the header is got by
+     * HttpRequest::getHeader(); all headers are copied out when
+     * HttpRequest::headers() is called or the headers are modified. This saves
+     * a few allocations per header for applications that only look at a
+     * small part of the headers. The default value is false.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &enableZeroCopyHeaders(bool enable) = 0;
+
+    /// Return true if the zero copy mode of request headers is enabled.
+    virtual bool isZeroCopyHeadersEnabled() const = 0;
+
     /// Set the time in which the static file response is cached in memory.
     /**
      * @param cacheTime in seconds. 0 means always cached, negative means no
@@ -1174,6 +1471,34 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
     /// Get the time set by the above method.
     virtual int staticFilesCacheTime() const = 0;
 
+    /// Set the maximum total size of the static files cached in memory.
+    /**
+     * @param maxSize in bytes. 0 means no limit. The least recently used files
+     * are evicted when the limit is exceeded. The cache is shared by all IO
+     * threads.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setStaticFilesCacheMaxSize(size_t maxSize) = 0;
+
+    /// Get the size set by the above method.
+    virtual size_t staticFilesCacheMaxSize() const = 0;
+
+    /// Set the time in which the stat() results of static files are cached.
+    /**
+     * @param cacheTime in seconds. 0 (the default) means no cache. The results
+     * (including the missing files) are kept in each IO thread, the static
+     * file requests which are not answered from the response cache, e.g. the
+     * range requests, don't call stat() for them then, and the files sent by
+     * sendfile are only opened to be sent. A file changed in the meantime is
+     * seen when its result expires.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setStaticFileStatCacheTime(double cacheTime) = 0;
+
     /// Set the lifetime of the connection without read or write
     /**
      * @param timeout in seconds. 60 by default. Setting the timeout to 0 means
@@ -1199,6 +1524,53 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
         return setIdleConnectionTimeout((size_t)timeout.count());
     }
 
+    /// Release the memory held by the idle connections
+    /**
+     * @param timeout in seconds. 0 by default for never. The send buffer, the
+     * request objects pooled for the next requests and the buffers of the
+     * pipeline of a connection without read for this number of seconds are
+     * released, they are allocated again when the connection gets a request.
+     * It bounds the memory of the mostly idle keep-alive and WebSocket
+     * connections.
+     *
+     * The memory of the connections is exported by the PromExporter plugin
+     * with its built-in metrics.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setIdleMemoryTrimTimeout(size_t timeout) = 0;
+
+    /// Get the timeout set by the above method.
+    virtual size_t getIdleMemoryTrimTimeout() const = 0;
+
+    /// Set the deadline of the requests
+    /**
+     * @param timeout The number of seconds from the reception of a request
+     * to its deadline, 0 by default for no deadline.
+     * @param header The name of a request header giving the number of
+     * seconds the client waits for the response, e.g. "x-request-timeout",
+     * empty by default. A shorter timeout in it brings the deadline forward,
+     * and the HTTP clients send their timeouts in it.
+     *
+     * The handler isn't called when the deadline of the request has passed,
+     * and a 504 response is sent instead. The timeouts of the database, redis
+     * and HTTP clients are bounded by the deadline in the handler, see
+     * RequestDeadline.
+     *
+     * @note
+     * This operation can be performed by options in the configuration file.
+     */
+    virtual HttpAppFramework &setRequestDeadline(
+        double timeout,
+        const std::string &header = "") = 0;
+
+    /// The number of seconds set by setRequestDeadline()
+    virtual double getRequestDeadline() const = 0;
+
+    /// The header set by setRequestDeadline()
+    virtual const std::string &getRequestDeadlineHeader() const = 0;
+
     /// Set the 'server' header field in each response sent by drogon.
     /**
      * @param server empty string by default with which the 'server' header
@@ -1210,6 +1582,18 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
     virtual HttpAppFramework &setServerHeaderField(
         const std::string &server) = 0;
 
+    /**
+     * @brief Set the 'alt-svc' header field (rfc7838) sent in each response,
+     * e.g. 'h3=":443"; ma=86400' to move the clients to the HTTP/3 service of
+     * a QUIC terminating proxy in front of the application. The field isn't
+     * sent by default.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setAltSvcHeaderField(
+        const std::string &altSvc) = 0;
+
     /// Control if the 'Server' header is added to each HTTP response.
     /**
      * @note
@@ -1273,6 +1657,35 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
      */
     virtual HttpAppFramework &setBrStatic(bool useGzipStatic) = 0;
 
+    /// Set the mmap_static option.
+    /**
+     * If it is set to true, static files which are not sent by sendfile are
+     * mapped into memory once and sent from the mapping instead of being read
+     * into every response, the mapping is renewed when the size or the
+     * modification time of the file changes. Files should be replaced by
+     * renaming rather than rewritten in place when the option is enabled. The
+     * default value is false.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setMmapStatic(bool useMmapStatic) = 0;
+
+    /// Set the precompress_static option.
+    /**
+     * If it is set to true, a static file without a ".br" or ".gz" file beside
+     * it is compressed in the background with the best compression level the
+     * first time it is requested, the compressed variants are kept in memory
+     * and sent to the clients accepting them until the file is modified. Only
+     * the encodings enabled by the gzip_static and br_static options are
+     * made. The default value is false.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setPrecompressStatic(
+        bool usePrecompressStatic) = 0;
+
     /// Set the max body size of the requests received by drogon.
     /**
      * The default value is 1M.
@@ -1301,6 +1714,19 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
     virtual HttpAppFramework &setClientMaxWebSocketMessageSize(
         size_t maxSize) = 0;
 
+    /// Enable the permessage-deflate extension of WebSocket (RFC 7692).
+    /**
+     * If the extension is enabled and offered by a client, the messages of the
+     * connection are compressed. The default value is false.
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &enableWebSocketCompression(
+        bool enable = true) = 0;
+
+    /// Return true if the permessage-deflate extension is enabled.
+    virtual bool isWebSocketCompressionEnabled() const = 0;
+
     // Set the HTML file of the home page, the default value is "index.html"
     /**
      * If there isn't any handler registered to the path "/", the home page file
@@ -1471,6 +1897,20 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
      */
     virtual const std::pair<unsigned int, std::string> &
     getFloatPrecisionInJson() const noexcept = 0;
+
+    /**
+     * @brief Set the engine parsing and serializing the JSON bodies of the
+     * requests and responses and the JSON messages of the websockets.
+     *
+     * @param engine The engine, e.g. one built on simdjson. By default, the
+     * bodies are parsed by jsoncpp and serialized by a JsonWriter.
+     * @note This method must be called before running the application.
+     */
+    virtual HttpAppFramework &setJsonEngine(JsonEnginePtr engine) = 0;
+
+    /// Get the engine set by the above method.
+    virtual const JsonEnginePtr &getJsonEngine() const noexcept = 0;
+
     /// Create a database client
     /**
      * @param dbType The database type is one of
@@ -1511,8 +1951,10 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
 
     /// Create a redis client
     /**
-     * @param ip IP of redis server.
-     * @param port The port on which the redis server is listening.
+     * @param ip IP of redis server, or the path of its unix socket after the
+     * "unix:" prefix, e.g. "unix:/run/redis/redis.sock".
+     * @param port The port on which the redis server is listening, not used
+     * with a unix socket.
      * @param name The client name.
      * @param username Username for redis server
      * @param password Password for the redis server
@@ -1585,6 +2027,68 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
      */
     virtual bool reusePort() const = 0;
 
+    /**
+     * @brief Share the TLS sessions of each https listener between the IO
+     * loops.
+     *
+     * On Linux every IO loop listens on a socket of its own, with its own TLS
+     * session cache and session ticket key, so a client can only resume its
+     * session when its new connection reaches the same loop. When this is
+     * enabled, the connections of the https listeners are accepted by one
+     * thread and spread over the IO loops, and the sessions are resumed in
+     * all of them. This costs the one accepting thread, the connection
+     * balancing doesn't apply to these listeners. It is disabled by default,
+     * it is always the case on other platforms.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &enableTlsSessionSharing(bool enable = true) = 0;
+    virtual bool isTlsSessionSharingEnabled() const = 0;
+
+    /**
+     * @brief Set the way the new connections are distributed over the IO
+     * loops. By default, the kernel spreads them evenly, which leaves some
+     * loops busier than the others when the connections have very different
+     * loads, e.g. the long-lived WebSockets and the short HTTP exchanges.
+     * The other ways favor the loops with fewer connections or a shorter
+     * queue of tasks.
+     *
+     * @note
+     * The other ways are only available on Linux, and not in the ReusePort
+     * mode because the sockets of the other processes share the port. In the
+     * kLocalCpu way, the IO loops are pinned to the CPUs set with
+     * setIoLoopCpus(), or else the loop i to the CPU i, which suits one IO
+     * loop per CPU.
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setConnectionBalancing(
+        ConnectionBalancing balancing) = 0;
+
+    virtual ConnectionBalancing getConnectionBalancing() const = 0;
+
+    /**
+     * @brief Pin the IO loops to CPUs, the loop i to the CPU
+     * cpus[i % cpus.size()]. Not pinned by default.
+     *
+     * On a machine with several NUMA nodes, the memory the loops allocate
+     * once pinned, e.g. the requests and their pools, the responses and the
+     * buffers of the connections and of the fast database clients, is taken
+     * from the node of their CPU by the first-touch policy of the kernel. The
+     * data of an IOThreadStorage can be set in its loop for the same reason.
+     * The kLocalCpu connection balancing hands a new connection to the loop
+     * of the CPU which received it, so it stays on the node of its network
+     * queue.
+     *
+     * @note
+     * Only available on Linux. This operation can be performed by an option
+     * in the configuration file.
+     */
+    virtual HttpAppFramework &setIoLoopCpus(
+        const std::vector<size_t> &cpus) = 0;
+
+    virtual const std::vector<size_t> &getIoLoopCpus() const = 0;
+
     /**
      * @brief handler will be called upon an exception escapes a request handler
      */
@@ -1602,8 +2106,31 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
         const std::string &ext,
         const std::string &mime) = 0;
 
+    /**
+     * @brief Decompress the bodies of the requests with a gzip or br
+     * Content-Encoding header before they are handled.
+     *
+     * @note In the request stream mode (see enableRequestStream()), the body
+     * is decompressed as it is received, and the request fails as soon as the
+     * decompressed body exceeds the client max body size.
+     */
     virtual HttpAppFramework &enableCompressedRequest(bool enable = true) = 0;
     virtual bool isCompressedRequestEnabled() const = 0;
+
+    /**
+     * @brief Enable the entity tags of the dynamic responses.
+     *
+     * @param enable If true, the 200 responses of the GET and HEAD requests
+     * get a weak ETag header hashed from their body unless they have one, and
+     * a 304 Not Modified response is sent in place of them when the
+     * If-None-Match header of the request matches, before the body is
+     * compressed. The streamed responses, the files and the responses with a
+     * Last-Modified header are left as they are.
+     * @note The body is hashed for every response, the option is disabled by
+     * default.
+     */
+    virtual HttpAppFramework &enableDynamicETag(bool enable = true) = 0;
+    virtual bool isDynamicETagEnabled() const = 0;
     /*
      * @brief get the number of active connections.
      */
@@ -1625,6 +2152,28 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
     virtual HttpAppFramework &setAfterAcceptSockOptCallback(
         std::function<void(int)> cb) = 0;
 
+    /**
+     * @brief Trade CPU time for latency on the connections accepted on the
+     * port.
+     *
+     * The connections are set with TCP_NODELAY and TCP_QUICKACK, and with
+     * SO_BUSY_POLL on Linux, so reading them polls the device queue for the
+     * number of microseconds instead of waiting for the interrupt. Setting a
+     * time above the net.core.busy_read sysctl requires CAP_NET_ADMIN. The
+     * IO loops wait in epoll_wait(), which busy-polls the queues of their
+     * connections too when the net.core.busy_poll sysctl is set.
+     *
+     * @param port The port of the listeners
+     * @param busyPollMicroseconds 0 not to busy-poll
+     *
+     * @note
+     * This operation can be performed by an option of the listeners in the
+     * configuration file.
+     */
+    virtual HttpAppFramework &enableLowLatency(
+        uint16_t port,
+        size_t busyPollMicroseconds = 50) = 0;
+
     /**
      * @brief Set the client disconnect or connect callback.
      *
@@ -1637,6 +2186,49 @@ class DROGON_EXPORT HttpAppFramework : public trantor::NonCopyable
     virtual HttpAppFramework &enableRequestStream(bool enable = true) = 0;
     virtual bool isRequestStreamEnabled() const = 0;
 
+    /**
+     * @brief Set the time the addresses resolved for the HTTP and WebSocket
+     * clients are cached.
+     *
+     * @param ttl The number of seconds, 600 by default. The addresses of a
+     * host name are shared by all the clients of the application, and are
+     * queried again after this time or when none of them can be connected.
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setDnsCacheTtl(double ttl) = 0;
+    virtual double getDnsCacheTtl() const = 0;
+
+    /**
+     * @brief Cork the output of the HTTP/1.x connections.
+     *
+     * When enabled, the responses produced for a connection during one
+     * iteration of its event loop are rendered in one buffer and sent with a
+     * single write at the end of the iteration, instead of one write for each
+     * of them. The big bodies, files and streams are still sent on their own,
+     * after the buffered responses. It is disabled by default.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &enableOutputCorking(bool enable = true) = 0;
+    virtual bool isOutputCorkingEnabled() const = 0;
+
+    /**
+     * @brief Log the SQL commands of the database clients which take longer
+     * than the threshold.
+     *
+     * @param threshold The number of seconds, 0 by default to log none. The
+     * commands are logged at the warn level with their statement normalized
+     * (see the db_statements option of the PromExporter plugin), without the
+     * values of their parameters, and with the route pattern of the request
+     * being handled when they were sent. The fast clients are included.
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setSlowQueryThreshold(double threshold) = 0;
+    virtual double getSlowQueryThreshold() const = 0;
+
   private:
     virtual void registerHttpController(
         const std::string &pathPattern,
@@ -23,10 +23,13 @@
 #include <drogon/utils/FunctionTraits.h>
 #include <drogon/utils/Utilities.h>
 #include <drogon/HttpRequest.h>
-#include <deque>
+#include <charconv>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace drogon
 {
@@ -155,20 +158,140 @@ inline long double getHandlerArgumentValue<long double>(std::string &&p)
     return std::stold(p);
 }
 
+// The types converted like std::stoi() and so on, see parseNumber()
+template <typename T>
+struct IsFastConvertible
+{
+    static constexpr bool value =
+        std::is_same_v<T, int> || std::is_same_v<T, long> ||
+        std::is_same_v<T, long long> || std::is_same_v<T, unsigned long> ||
+        std::is_same_v<T, unsigned long long> || std::is_floating_point_v<T>;
+};
+
+/**
+ * @brief Convert the characters to a number without the locale, like
+ * std::stoi() and so on, the leading whitespaces and the characters after
+ * the number are ignored.
+ *
+ * @note Unlike std::stoul() and std::stoull(), a negative number is rejected
+ * for the unsigned types instead of wrapping around.
+ *
+ * @throw std::invalid_argument if the characters don't start with a number.
+ * @throw std::out_of_range if the number is out of the range of the type.
+ */
+template <typename T>
+T parseNumber(std::string_view p)
+{
+    // std::from_chars() accepts neither of them.
+    auto start = p.find_first_not_of(" \t\n\v\f\r");
+    p.remove_prefix(start == std::string_view::npos ? p.length() : start);
+    if (p.length() > 1 && p[0] == '+' && p[1] != '-')
+        p.remove_prefix(1);
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    constexpr bool useFromChars = true;
+#else
+    // The floating point numbers aren't converted by std::from_chars() in the
+    // standard library
+    constexpr bool useFromChars = std::is_integral_v<T>;
+#endif
+    T value{};
+    if constexpr (useFromChars)
+    {
+        auto [ptr, ec] = std::from_chars(p.data(), p.data() + p.size(), value);
+        (void)ptr;
+        if (ec == std::errc::invalid_argument)
+            throw std::invalid_argument("Not a number: " + std::string(p));
+        if (ec == std::errc::result_out_of_range)
+            throw std::out_of_range("Number out of range: " + std::string(p));
+    }
+    else
+    {
+        std::string str(p);
+        if constexpr (std::is_same_v<T, float>)
+            value = std::stof(str);
+        else if constexpr (std::is_same_v<T, double>)
+            value = std::stod(str);
+        else
+            value = std::stold(str);
+    }
+    return value;
+}
+
+/**
+ * @brief Convert a routing parameter without copying it for the strings and
+ * the numbers, the other types are converted by the overloads above.
+ *
+ * A std::string_view argument refers to the routing parameters of the
+ * request, it is valid as long as the request.
+ */
+template <typename T>
+T getHandlerArgumentValue(std::string_view p)
+{
+    if constexpr (std::is_same_v<T, std::string_view>)
+    {
+        return p;
+    }
+    else if constexpr (std::is_same_v<T, std::string>)
+    {
+        return std::string(p);
+    }
+    else if constexpr (IsFastConvertible<T>::value)
+    {
+        return parseNumber<T>(p);
+    }
+    else
+    {
+        return getHandlerArgumentValue<T>(std::string(p));
+    }
+}
+
 class HttpBinderBase
 {
   public:
+    /**
+     * @brief Call the handler with the routing parameters of the request.
+     *
+     * @note Up to 1.9.13, the parameters were passed in a
+     * std::deque<std::string>. They are now read from
+     * HttpRequest::getRoutingParameters(), so the callers set them in the
+     * request instead.
+     */
     virtual void handleHttpRequest(
-        std::deque<std::string> &pathArguments,
         const HttpRequestPtr &req,
         std::function<void(const HttpResponsePtr &)> &&callback) = 0;
     virtual size_t paramCount() = 0;
     virtual const std::string &handlerName() const = 0;
     virtual bool isStreamHandler() = 0;
 
+    /// Run the handler in the pool of the handler threads, see Offload
+    void setOffloaded(bool offloaded)
+    {
+        offloaded_ = offloaded;
+    }
+
+    bool isOffloaded() const
+    {
+        return offloaded_;
+    }
+
+    /// Defer the handler behind the other requests, see LowPriority
+    void setLowPriority(bool lowPriority)
+    {
+        lowPriority_ = lowPriority;
+    }
+
+    bool isLowPriority() const
+    {
+        return lowPriority_;
+    }
+
     virtual ~HttpBinderBase()
     {
     }
+
+  private:
+    bool offloaded_{false};
+    bool lowPriority_{false};
 };
 
 template <typename T>
@@ -197,21 +320,10 @@ class HttpBinder : public HttpBinderBase
     using FunctionType = FUNCTION;
 
     void handleHttpRequest(
-        std::deque<std::string> &pathArguments,
         const HttpRequestPtr &req,
         std::function<void(const HttpResponsePtr &)> &&callback) override
     {
-        if (!pathArguments.empty())
-        {
-            std::vector<std::string> args;
-            args.reserve(pathArguments.size());
-            for (auto &arg : pathArguments)
-            {
-                args.emplace_back(arg);
-            }
-            req->setRoutingParameters(std::move(args));
-        }
-        run(pathArguments, req, std::move(callback));
+        run(req->getRoutingParameters(), req, std::move(callback));
     }
 
     size_t paramCount() override
@@ -274,7 +386,7 @@ class HttpBinder : public HttpBinderBase
               std::size_t Boundary = argument_count,
               bool isStreamHandler = traits::isStreamHandler,
               bool isCoroutine = traits::isCoroutine>
-    void run(std::deque<std::string> &pathArguments,
+    void run(const std::vector<std::string> &pathArguments,
              const HttpRequestPtr &req,
              std::function<void(const HttpResponsePtr &)> &&callback,
              Values &&...values)
@@ -289,16 +401,14 @@ class HttpBinder : public HttpBinderBase
                 "reference type or right reference type");
             using ValueType = std::remove_cv_t<
                 std::remove_reference_t<nth_argument_type<sizeof...(Values)>>>;
-            if (!pathArguments.empty())
+            if (sizeof...(Values) < pathArguments.size())
             {
-                std::string v{std::move(pathArguments.front())};
-                pathArguments.pop_front();
+                std::string_view v{pathArguments[sizeof...(Values)]};
                 try
                 {
                     if (!v.empty())
                     {
-                        auto value =
-                            getHandlerArgumentValue<ValueType>(std::move(v));
+                        auto value = getHandlerArgumentValue<ValueType>(v);
                         run(pathArguments,
                             req,
                             std::move(callback),
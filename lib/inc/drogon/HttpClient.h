@@ -15,10 +15,12 @@
 #pragma once
 
 #include <drogon/exports.h>
+#include <drogon/CircuitBreaker.h>
 #include <drogon/HttpTypes.h>
 #include <drogon/drogon_callbacks.h>
 #include <drogon/HttpResponse.h>
 #include <drogon/HttpRequest.h>
+#include <drogon/RequestStream.h>
 #include <trantor/utils/NonCopyable.h>
 #include <trantor/net/EventLoop.h>
 #include <cstddef>
@@ -56,6 +58,75 @@ struct HttpRespAwaiter : public CallbackAwaiter<HttpResponsePtr>
 }  // namespace internal
 #endif
 
+/**
+ * @brief The body of a request sent by HttpClient::sendStreamRequest(),
+ * written in pieces while the request is on the wire. The pieces are sent
+ * with the chunked transfer encoding, without being stored on disk or in the
+ * whole body. The methods can be called in any thread.
+ */
+class DROGON_EXPORT RequestBodyStream
+{
+  public:
+    virtual ~RequestBodyStream() = default;
+
+    /// Send a piece of the body, return false if the request failed or the
+    /// stream is closed.
+    virtual bool send(const char *data, size_t length) = 0;
+
+    bool send(std::string_view data)
+    {
+        return send(data.data(), data.length());
+    }
+
+    /// End the body, the response is passed to the callback of the request
+    /// as usual.
+    virtual void close() = 0;
+
+    /// Abort the request, its callback is called with ReqResult::Cancelled
+    /// and the connection is closed if the request was sent.
+    virtual void abort() = 0;
+
+    /// The number of bytes passed to send() and not yet written to the
+    /// connection.
+    virtual size_t bufferedBytes() const = 0;
+
+    /// Set the callback called in the loop of the client whenever the
+    /// connection has written all the bytes sent, to send more without
+    /// buffering them.
+    virtual void setDrainCallback(std::function<void()> cb) = 0;
+
+    /**
+     * @brief Create a reader of a request stream (see
+     * HttpAppFramework::enableRequestStream()) forwarding the body to the
+     * stream, e.g. to proxy an upload to an object storage without saving it.
+     *
+     * @param body The body of the request sent to the upstream server.
+     * @param maxBufferedBytes The upstream request is aborted when more bytes
+     * than this wait to be written to its connection.
+     *
+     * @code
+       auto upstreamReq = HttpRequest::newHttpRequest();
+       upstreamReq->setMethod(Put);
+       upstreamReq->setPath("/bucket/" + name);
+       auto body = client->sendStreamRequest(
+           upstreamReq,
+           [callback](ReqResult result, const HttpResponsePtr &resp) {
+               callback(HttpResponse::newHttpResponse(
+                   result == ReqResult::Ok && resp->statusCode() == k200OK
+                       ? k201Created
+                       : k502BadGateway,
+                   CT_NONE));
+           });
+       stream->setStreamReader(RequestBodyStream::newForwardReader(body));
+       @endcode
+     */
+    static RequestStreamReaderPtr newForwardReader(
+        std::shared_ptr<RequestBodyStream> body,
+        size_t maxBufferedBytes = 16 * 1024 * 1024);
+};
+
+using RequestBodyStreamPtr = std::shared_ptr<RequestBodyStream>;
+
 /// Asynchronous http client
 /**
  * HttpClient implementation object uses the HttpAppFramework's event loop by
@@ -112,6 +183,54 @@ class DROGON_EXPORT HttpClient : public trantor::NonCopyable
                              HttpReqCallback &&callback,
                              double timeout = 0) = 0;
 
+    /**
+     * @brief Send a request whose body is written afterwards by the returned
+     * stream.
+     *
+     * @param req The request sent to the server, its body is ignored.
+     * @param callback The callback is called when the response is received
+     * from the server, which may be before the end of the body.
+     * @param timeout In seconds, as in sendRequest(), counted from the call
+     * including the time spent writing the body.
+     *
+     * @return The stream writing the body, it must be closed or aborted.
+     *
+     * @note The body is sent with the chunked transfer encoding, so the
+     * streamed requests need HTTP/1.1 connections, they fail on the HTTP/2
+     * ones. The requests sent after a streamed one on the same client wait for
+     * the end of its body.
+     */
+    virtual RequestBodyStreamPtr sendStreamRequest(const HttpRequestPtr &req,
+                                                   HttpReqCallback &&callback,
+                                                   double timeout = 0) = 0;
+
+    using ResponseDataCallback = std::function<void(const char *, size_t)>;
+    using ResponseFinishCallback = std::function<void(ReqResult)>;
+
+    /**
+     * @brief Send a request and receive the body of its response in pieces
+     * as they arrive, instead of in the response object.
+     *
+     * @param req The request sent to the server.
+     * @param callback The callback is called with the response as soon as its
+     * headers are received, its body is empty. It's called with the error and
+     * an empty response if the headers can't be received.
+     * @param dataCallback The callback is called with each piece of the body,
+     * still in its content encoding.
+     * @param finishCallback The callback is called at the end of the body,
+     * with ReqResult::Ok or the error which ended it, if the headers were
+     * received.
+     * @param timeout In seconds, the time to receive the headers.
+     *
+     * @note The callbacks are called in the loop of the client. The streamed
+     * responses are only received on HTTP/1.1 connections.
+     */
+    virtual void sendRequestForStream(const HttpRequestPtr &req,
+                                      HttpReqCallback &&callback,
+                                      ResponseDataCallback dataCallback,
+                                      ResponseFinishCallback finishCallback,
+                                      double timeout = 0) = 0;
+
     /**
      * @brief Send a request synchronously to the server and return the
      * response.
@@ -200,6 +319,20 @@ class DROGON_EXPORT HttpClient : public trantor::NonCopyable
      */
     virtual void setPipeliningDepth(size_t depth) = 0;
 
+    /// Enable HTTP/2 for the client
+    /**
+     * @param flag if the parameter is true, h2 is offered to the server by ALPN
+     * on HTTPS connections. When the server selects it, the requests are
+     * multiplexed on the connection as concurrent streams, the pipelining
+     * depth is ignored, and the timeout of a request only resets its own
+     * stream. HTTP/2 is disabled by default.
+     * @param priorKnowledge if the parameter is true, plain HTTP connections
+     * use HTTP/2 from the start (h2c with prior knowledge, rfc7540-3.4), e.g.
+     * for the gRPC calls to a server known to support it. Otherwise they keep
+     * using HTTP/1.1.
+     */
+    virtual void enableHttp2(bool flag = true, bool priorKnowledge = false) = 0;
+
     /// Enable cookies for the client
     /**
      * @param flag if the parameter is true, all requests sent by the client
@@ -208,6 +341,27 @@ class DROGON_EXPORT HttpClient : public trantor::NonCopyable
      */
     virtual void enableCookies(bool flag = true) = 0;
 
+    /// Let the concurrent identical GET and HEAD requests share one request
+    /**
+     * @param flag if the parameter is true, the requests with the same method,
+     * path, query, headers, cookies and body sent while one of them is in
+     * progress are not sent, they get its response. The response object is
+     * shared by all their callbacks and the timeout of the first request
+     * applies to them. It's disabled by default.
+     */
+    virtual void enableRequestCoalescing(bool flag = true) = 0;
+
+    /// Fail the requests fast while the server is down
+    /**
+     * @param breaker The requests failing with a network error or a timeout,
+     * or getting a 5xx response, are recorded by the circuit breaker. While
+     * it is open, the callbacks of the requests are called at once with
+     * ReqResult::CircuitOpen. The breaker can be shared by the clients of the
+     * same server, nullptr removes it. It should be set before the client is
+     * used.
+     */
+    virtual void setCircuitBreaker(CircuitBreakerPtr breaker) = 0;
+
     /// Add a cookie to the client
     /**
      * @note
@@ -0,0 +1,128 @@
+/**
+ *
+ *  @file HttpClientPool.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by the MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/HttpClient.h>
+#include <trantor/utils/NonCopyable.h>
+#include <trantor/net/EventLoop.h>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace drogon
+{
+class HttpClientPool;
+using HttpClientPoolPtr = std::shared_ptr<HttpClientPool>;
+
+/**
+ * @brief The options of a HttpClientPool
+ */
+struct HttpClientPoolConfig
+{
+    /// The upstream hosts, the format of each host is the same as the
+    /// hostString parameter of HttpClient::newHttpClient(), requests are
+    /// balanced over all of them.
+    std::vector<std::string> hosts;
+    /// The maximum number of connections to each host in each event loop.
+    size_t connectionsPerHost{4};
+    /// The pipelining depth of every connection, see
+    /// HttpClient::setPipeliningDepth().
+    size_t pipeliningDepth{0};
+    /// See HttpClient::enableHttp2().
+    bool enableHttp2{false};
+    /// Connections without outstanding requests for the time (in seconds) are
+    /// closed, the zero value keeps them forever.
+    double idleTimeout{60.0};
+    bool useOldTLS{false};
+    bool validateCert{true};
+};
+
+/// A pool of keep-alive connections to a set of upstream hosts
+/**
+ * Every event loop of the pool has its own connections, so requests sent from
+ * a loop of the pool (for example in a request handler) never cross threads.
+ * Requests are dispatched to the connection with the least outstanding
+ * requests, a new connection is opened when all existing ones are busy and the
+ * limit of connections to the host is not reached.
+ */
+class DROGON_EXPORT HttpClientPool : public trantor::NonCopyable
+{
+  public:
+    /**
+     * @brief Send a request asynchronously to one of the hosts
+     *
+     * @param req The request sent to the server.
+     * @param callback The callback is called when the response is received from
+     * the server.
+     * @param timeout In seconds. If the response is not received within the
+     * timeout, the callback is called with `ReqResult::Timeout` and an empty
+     * response. The zero value by default disables the timeout.
+     */
+    virtual void sendRequest(const HttpRequestPtr &req,
+                             HttpReqCallback &&callback,
+                             double timeout = 0) = 0;
+
+    void sendRequest(const HttpRequestPtr &req,
+                     const HttpReqCallback &callback,
+                     double timeout = 0)
+    {
+        HttpReqCallback cb = callback;
+        sendRequest(req, std::move(cb), timeout);
+    }
+
+    /**
+     * @brief Send a request synchronously and return the response.
+     *
+     * @note Never call this function in an event loop of the pool, otherwise
+     * the thread will be blocked forever.
+     */
+    std::pair<ReqResult, HttpResponsePtr> sendRequest(const HttpRequestPtr &req,
+                                                      double timeout = 0)
+    {
+        std::promise<std::pair<ReqResult, HttpResponsePtr>> prom;
+        auto f = prom.get_future();
+        sendRequest(
+            req,
+            [&prom](ReqResult r, const HttpResponsePtr &resp) {
+                prom.set_value({r, resp});
+            },
+            timeout);
+        return f.get();
+    }
+
+    /**
+     * @brief Get the total number of outstanding requests of all connections
+     * in the pool.
+     */
+    virtual size_t outstandingRequests() const = 0;
+
+    /**
+     * @brief Create a new pool.
+     *
+     * @param config The options of the pool.
+     * @param loops The event loops of the pool, if it is empty, the IO loops
+     * of the framework are used, so the pool must be created after the
+     * framework is running (for example in the initAndStart() method of a
+     * plugin).
+     */
+    static HttpClientPoolPtr newHttpClientPool(
+        const HttpClientPoolConfig &config,
+        std::vector<trantor::EventLoop *> loops = {});
+
+    virtual ~HttpClientPool() = default;
+};
+}  // namespace drogon
@@ -19,6 +19,9 @@
 #include <drogon/HttpRequest.h>
 #include <drogon/HttpResponse.h>
 #include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 #ifdef __cpp_impl_coroutine
 #include <drogon/utils/coroutine.h>
@@ -148,6 +151,104 @@ class HttpCoroMiddleware : public DrObject<T>, public HttpMiddlewareBase
 
 #endif
 
+namespace internal
+{
+template <typename M, typename = void>
+struct HasDirectInvoke : std::false_type
+{
+};
+
+// The middlewares declaring the invoke() of HttpMiddlewareBase, which can be
+// called without virtual dispatch, unlike the coroutine ones.
+template <typename M>
+struct HasDirectInvoke<
+    M,
+    std::void_t<decltype(std::declval<M &>().M::invoke(
+        std::declval<const HttpRequestPtr &>(),
+        std::declval<MiddlewareNextCallback &&>(),
+        std::declval<MiddlewareCallback &&>()))>> : std::true_type
+{
+};
+}  // namespace internal
+
+/**
+ * @brief A middleware made of the middlewares of its template parameters,
+ * invoked in their order like the middlewares of a route.
+ *
+ * The chain is built at compile time: the middlewares are not looked up by
+ * name for each route, and they are called directly by their type instead of
+ * through the virtual function, so the calls can be inlined. The middlewares
+ * are the singletons of their types.
+ *
+ * Example:
+ * @code
+   class ApiMiddlewares
+       : public drogon::HttpMiddlewareChain<ApiMiddlewares,
+                                            AuthMiddleware,
+                                            CorsMiddleware,
+                                            LogMiddleware>
+   {
+   };
+   // The chain is added to a route by its name
+   ADD_METHOD_TO(ApiController::get, "/api/{id}", Get, "ApiMiddlewares");
+   @endcode
+ *
+ * @note The middlewares following one which calls nextCb in another thread
+ * run in that thread, the handler is still called in the IO loop of the
+ * request.
+ */
+template <typename T, typename... Middlewares>
+class HttpMiddlewareChain : public HttpMiddleware<T>
+{
+  public:
+    HttpMiddlewareChain()
+        : middlewares_(DrClassMap::getSingleInstance<Middlewares>()...)
+    {
+    }
+
+    void invoke(const HttpRequestPtr &req,
+                MiddlewareNextCallback &&nextCb,
+                MiddlewareCallback &&mcb) override
+    {
+        invokeFrom<0>(req, std::move(nextCb), std::move(mcb));
+    }
+
+  private:
+    template <size_t I>
+    void invokeFrom(const HttpRequestPtr &req,
+                    MiddlewareNextCallback &&nextCb,
+                    MiddlewareCallback &&mcb)
+    {
+        if constexpr (I == sizeof...(Middlewares))
+        {
+            nextCb(std::move(mcb));
+        }
+        else
+        {
+            using M = std::tuple_element_t<I, std::tuple<Middlewares...>>;
+            MiddlewareNextCallback next =
+                [this, req, nextCb = std::move(nextCb)](
+                    MiddlewareCallback &&postCb) mutable {
+                    invokeFrom<I + 1>(req,
+                                      std::move(nextCb),
+                                      std::move(postCb));
+                };
+            auto &middleware = *std::get<I>(middlewares_);
+            if constexpr (internal::HasDirectInvoke<M>::value)
+            {
+                middleware.M::invoke(req, std::move(next), std::move(mcb));
+            }
+            else
+            {
+                static_cast<HttpMiddlewareBase &>(middleware)
+                    .invoke(req, std::move(next), std::move(mcb));
+            }
+        }
+    }
+
+    std::tuple<std::shared_ptr<Middlewares>...> middlewares_;
+};
+
 /**
  * @brief Simple middleware that tags OPTIONS requests
  * @details It adds the attribute "drogon.customCORShandling" to the request, so
@@ -15,9 +15,12 @@
 #pragma once
 
 #include <drogon/exports.h>
+#include <drogon/utils/JsonReflect.h>
 #include <drogon/utils/Utilities.h>
+#include <drogon/utils/MonotonicArena.h>
 #include <drogon/DrClassMap.h>
 #include <drogon/HttpTypes.h>
+#include <drogon/RequestTrace.h>
 #include <drogon/Session.h>
 #include <drogon/Attribute.h>
 #include <drogon/UploadFile.h>
@@ -25,10 +28,12 @@
 #include <trantor/net/InetAddress.h>
 #include <trantor/net/Certificate.h>
 #include <trantor/utils/Date.h>
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <optional>
+#include <stdexcept>
 #include <string_view>
 #include <trantor/net/TcpConnection.h>
 
@@ -39,15 +44,12 @@ using HttpRequestPtr = std::shared_ptr<HttpRequest>;
 
 /**
  * @brief This template is used to convert a request object to a custom
- * type object. Users must specialize the template for a particular type.
+ * type object. Users must specialize the template for a particular type,
+ * except for the types reflected by DROGON_REFLECT (or containers of them)
+ * which are read from the JSON body.
  */
 template <typename T>
-T fromRequest(const HttpRequest &)
-{
-    LOG_ERROR << "You must specialize the fromRequest template for the type of "
-              << DrClassMap::demangle(typeid(T).name());
-    exit(1);
-}
+T fromRequest(const HttpRequest &req);
 
 /**
  * @brief This template is used to create a request object from a custom
@@ -306,6 +308,23 @@ class DROGON_EXPORT HttpRequest
         return attributes();
     }
 
+    /// Get the memory arena of the request
+    /**
+     * Small temporary allocations made while handling the request can be
+     * served by the arena instead of the global allocator. All memory of the
+     * arena is released at once when the request object is destroyed or
+     * recycled by the framework, so it must never be used by objects that
+     * outlive the request, such as data captured by callbacks of other
+     * requests or sessions. See MonotonicArena and ArenaAllocator.
+     */
+    virtual MonotonicArena &arena() const = 0;
+
+    /// Get the memory arena of the request
+    MonotonicArena &getArena() const
+    {
+        return arena();
+    }
+
     /// Get parameters of the request.
     virtual const SafeStringMap<std::string> &parameters() const = 0;
 
@@ -318,6 +337,18 @@ class DROGON_EXPORT HttpRequest
     /// Get a parameter identified by the @param key
     virtual const std::string &getParameter(const std::string &key) const = 0;
 
+    /**
+     * @brief Get a parameter identified by the @p key without parsing all the
+     * parameters. Only the parameters with the key are decoded, the value
+     * points into the query or the body of the request when it needs no
+     * decoding.
+     *
+     * @return The value, valid as long as the request, or an empty optional
+     * object if there is no such parameter.
+     */
+    virtual std::optional<std::string_view> getParameterView(
+        std::string_view key) const = 0;
+
     /**
      * @brief Get the optional parameter identified by the @p key. if the
      * parameter doesn't exist, or the original parameter can't be converted to
@@ -330,14 +361,13 @@ class DROGON_EXPORT HttpRequest
     template <typename T>
     std::optional<T> getOptionalParameter(const std::string &key)
     {
-        auto &params = getParameters();
-        auto it = params.find(key);
-        if (it != params.end())
+        auto value = getParameterView(key);
+        if (value)
         {
             try
             {
                 return std::optional<T>(
-                    drogon::utils::fromString<T>(it->second));
+                    drogon::utils::fromString<T>(std::string(*value)));
             }
             catch (const std::exception &e)
             {
@@ -383,6 +413,57 @@ class DROGON_EXPORT HttpRequest
         return peerCertificate();
     }
 
+    /// Return the trace of the request, or nullptr if it isn't sampled.
+    virtual const RequestTracePtr &trace() const = 0;
+
+    /**
+     * @brief Return the deadline of the request, a date of 0 microseconds if
+     * it has none.
+     *
+     * It is set by the framework from the request_deadline option and the
+     * request_deadline_header header. The calls of the database, redis and
+     * HTTP clients made while handling the request are bounded by it, see
+     * RequestDeadline.
+     */
+    virtual const trantor::Date &deadline() const = 0;
+
+    /// Set the deadline of the request, e.g. in an advice before the handler
+    /// is called.
+    virtual void setDeadline(const trantor::Date &deadline) = 0;
+
+    /**
+     * @brief Return true if the client closed the connection, or reset the
+     * HTTP/2 stream, before the response was sent. The work done for the
+     * request can be abandoned then, e.g. between the steps of a coroutine
+     * handler.
+     *
+     * The database, redis and HTTP client calls made while handling a
+     * cancelled request fail at once, see RequestDeadline.
+     */
+    virtual bool isCancelled() const noexcept = 0;
+
+    /**
+     * @brief Register a callback called once when the request is cancelled,
+     * in the IO loop of its connection, or at once if it already is. The
+     * callbacks are dropped when the request is destroyed.
+     */
+    virtual void onCancel(std::function<void()> &&callback) = 0;
+
+    /**
+     * @brief Send a 103 Early Hints response with the Link headers before the
+     * response of the request, so the client can start to fetch the resources
+     * of a page while it is rendered, e.g. in a handler or a middleware:
+     * @code
+       req->sendEarlyHints({"</style.css>; rel=preload; as=style",
+                            "</app.js>; rel=preload; as=script"});
+       @endcode
+     *
+     * The hints are dropped if the response is already sent, for HTTP/1.0
+     * requests, or when the request is pipelined behind other requests whose
+     * responses haven't been sent yet.
+     */
+    virtual void sendEarlyHints(const std::vector<std::string> &links) = 0;
+
     /// Get the Json object of the request
     /**
      * The content type of the request must be 'application/json',
@@ -510,6 +591,47 @@ class DROGON_EXPORT HttpRequest
     static HttpRequestPtr newFileUploadRequest(
         const std::vector<UploadFile> &files);
 
+    /**
+     * @brief Create a request sending a file as its body, the file is sent by
+     * the HTTP client without being loaded in memory.
+     * Method: Post
+     * Version: Http1.1
+     *
+     * @param fullPath The full path of the file.
+     * @param offset The offset of the body in the file.
+     * @param length The length of the body, 0 for the rest of the file.
+     * @param type The content type code, if it is CT_NONE the content type is
+     * given by the file extension or the typeString parameter.
+     * @param typeString The MIME string of the content type.
+     * @note The file is sent with the content length it has when the request
+     * is created, and only on HTTP/1.1 connections.
+     */
+    static HttpRequestPtr newFileRequest(const std::string &fullPath,
+                                         size_t offset = 0,
+                                         size_t length = 0,
+                                         ContentType type = CT_NONE,
+                                         const std::string &typeString = "");
+
+    /**
+     * @brief Create a request whose body is pulled from a callback while the
+     * connection can take more, and sent with the chunked transfer encoding.
+     * Method: Post
+     * Version: Http1.1
+     *
+     * @param callback The callback fills the buffer with at most the given
+     * number of bytes and returns the number of bytes written, 0 at the end of
+     * the body. It's called with a null buffer when the body is done or the
+     * connection is closed, as the callback of
+     * HttpResponse::newStreamResponse().
+     * @param type The content type code, application/octet-stream by default.
+     * @param typeString The MIME string of the content type.
+     * @note The streamed requests are only sent on HTTP/1.1 connections.
+     */
+    static HttpRequestPtr newStreamRequest(
+        const std::function<std::size_t(char *, std::size_t)> &callback,
+        ContentType type = CT_NONE,
+        const std::string &typeString = "");
+
     /**
      * @brief Create a custom HTTP request object. For using this template,
      * users must specialize the toRequest template.
@@ -577,6 +699,31 @@ inline HttpRequestPtr toRequest(Json::Value &&pJson)
     return HttpRequest::newHttpJsonRequest(std::move(pJson));
 }
 
+template <typename T>
+T fromRequest(const HttpRequest &req)
+{
+    if constexpr (internal::canBeReadFromJsonRequest<T>)
+    {
+        if (req.contentType() != CT_APPLICATION_JSON &&
+            req.getHeader("content-type").find("application/json") ==
+                std::string::npos)
+            throw std::invalid_argument("content type error");
+        T object{};
+        JsonReader reader(req.body(), JsonReader::appStackLimit());
+        if (!readJson(reader, object) || !reader.finish())
+            throw std::invalid_argument(reader.error());
+        return object;
+    }
+    else
+    {
+        (void)req;
+        LOG_ERROR
+            << "You must specialize the fromRequest template for the type of "
+            << DrClassMap::demangle(typeid(T).name());
+        exit(1);
+    }
+}
+
 template <>
 inline std::shared_ptr<Json::Value> fromRequest(const HttpRequest &req)
 {
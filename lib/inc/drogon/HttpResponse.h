@@ -17,11 +17,13 @@
 #include <trantor/net/Certificate.h>
 #include <trantor/net/callbacks.h>
 #include <trantor/net/AsyncStream.h>
+#include <drogon/CompressionPolicy.h>
 #include <drogon/DrClassMap.h>
 #include <drogon/Cookie.h>
 #include <drogon/HttpRequest.h>
 #include <drogon/HttpTypes.h>
 #include <drogon/HttpViewData.h>
+#include <drogon/utils/JsonReflect.h>
 #include <drogon/utils/Utilities.h>
 #include <json/json.h>
 #include <memory>
@@ -50,15 +52,11 @@ T fromResponse(const HttpResponse &)
 /**
  * @brief This template is used to create a response object from a custom
  * type object by calling the newCustomHttpResponse(). Users must specialize
- * the template for a particular type.
+ * the template for a particular type, except for the types reflected by
+ * DROGON_REFLECT and the ORM models which are written as JSON.
  */
 template <typename T>
-HttpResponsePtr toResponse(T &&)
-{
-    LOG_ERROR << "You must specialize the toResponse template for the type of "
-              << DrClassMap::demangle(typeid(T).name());
-    exit(1);
-}
+HttpResponsePtr toResponse(T &&obj);
 
 template <>
 HttpResponsePtr toResponse<const Json::Value &>(const Json::Value &pJson);
@@ -71,47 +69,179 @@ inline HttpResponsePtr toResponse<Json::Value &>(Json::Value &pJson)
     return toResponse((const Json::Value &)pJson);
 }
 
+class StreamCompressor;
+
+namespace internal
+{
+class OutputWatermark;
+}
+
 class DROGON_EXPORT ResponseStream
 {
   public:
-    explicit ResponseStream(trantor::AsyncStreamPtr asyncStream)
-        : asyncStream_(std::move(asyncStream))
-    {
-    }
+    explicit ResponseStream(trantor::AsyncStreamPtr asyncStream);
+    /// The connection is used by setBackpressure().
+    ResponseStream(trantor::AsyncStreamPtr asyncStream,
+                   std::weak_ptr<trantor::TcpConnection> connection);
+    ~ResponseStream();
+
+    /**
+     * @brief Send the data as a chunk. If the response is compressed by the
+     * framework, the data is compressed and flushed first.
+     */
+    bool send(const std::string &data);
+
+    /**
+     * @brief Send the data as a chunk, without copying it into a string
+     * first.
+     */
+    bool send(const char *data, size_t length);
+
+    void close();
 
-    ~ResponseStream()
+    /**
+     * @brief Bound the output queued in the connection for a slow client,
+     * like WebSocketConnection::setBackpressure().
+     *
+     * With the Drop policy, send() returns false without sending the data
+     * while the output exceeds the mark, e.g. to skip the events of a live
+     * stream. The callback is called in the IO loop of the connection. It is
+     * only supported over HTTP/1.x connections.
+     */
+    void setBackpressure(
+        size_t highWaterMark,
+        BackpressurePolicy policy,
+        std::function<void(bool writable)> callback = nullptr);
+
+    /// Return false while the output queued exceeds the high water mark set
+    /// by the above method.
+    bool writable() const;
+
+  private:
+    friend class HttpResponseImpl;
+    friend class SseStream;
+
+    bool sendChunk(const char *data, size_t length);
+    // Send a chunk made by frameChunk(), which may be shared by several
+    // streams. It's compressed again if the response is compressed.
+    bool sendFramedChunk(const std::string &chunk);
+    static std::string frameChunk(const char *data, size_t length);
+
+    trantor::AsyncStreamPtr asyncStream_;
+    std::unique_ptr<StreamCompressor> compressor_;
+    std::weak_ptr<trantor::TcpConnection> connection_;
+    std::shared_ptr<internal::OutputWatermark> watermark_;
+};
+
+using ResponseStreamPtr = std::unique_ptr<ResponseStream>;
+
+/**
+ * @brief The stream of a response made of a JSON array, whose elements are
+ * written as they are produced and sent in chunks of about flushSize bytes,
+ * so a large result never sits in memory. The response is compressed like
+ * the other async stream responses.
+ */
+class DROGON_EXPORT JsonArrayStream
+{
+  public:
+    explicit JsonArrayStream(ResponseStreamPtr stream,
+                             size_t flushSize = 16 * 1024);
+    ~JsonArrayStream();
+
+    /**
+     * @brief Append an element, of any type accepted by writeJson(). Returns
+     * false once the response can't be sent any more, e.g. when the client
+     * is gone.
+     */
+    template <typename T>
+    bool append(const T &element)
     {
-        close();
+        return appendWith([&element](JsonWriter &writer) {
+            writeJson(writer, element);
+        });
     }
 
-    bool send(const std::string &data)
+    /**
+     * @brief Append an element written by a callable taking the JsonWriter,
+     * which must write exactly one value.
+     */
+    template <typename Callable>
+    bool appendWith(Callable &&writeElement)
     {
-        if (!asyncStream_)
-        {
+        if (!good_)
             return false;
-        }
-        std::ostringstream oss;
-        oss << std::hex << data.length() << "\r\n";
-        oss << data << "\r\n";
-        return asyncStream_->send(oss.str());
+        writeElement(writer_);
+        if (buffer_.length() >= flushSize_)
+            return flush();
+        return true;
     }
 
-    void close()
-    {
-        if (asyncStream_)
-        {
-            static std::string closeStream{"0\r\n\r\n"};
-            asyncStream_->send(closeStream);
-            asyncStream_->close();
-            asyncStream_.reset();
-        }
-    }
+    /// Send the elements appended so far.
+    bool flush();
+
+    /// Write the end of the array and close the response.
+    void close();
 
   private:
-    trantor::AsyncStreamPtr asyncStream_;
+    ResponseStreamPtr stream_;
+    std::string buffer_;
+    JsonWriter writer_;
+    size_t flushSize_;
+    bool good_{true};
 };
 
-using ResponseStreamPtr = std::unique_ptr<ResponseStream>;
+using JsonArrayStreamPtr = std::unique_ptr<JsonArrayStream>;
+
+/**
+ * @brief The stream of a Server-Sent Events response (text/event-stream),
+ * see HttpResponse::newSseResponse(). The methods return false once the
+ * events can't be sent any more, e.g. when the client is gone.
+ */
+class DROGON_EXPORT SseStream
+{
+  public:
+    explicit SseStream(ResponseStreamPtr stream);
+    ~SseStream();
+
+    /**
+     * @brief Send an event.
+     *
+     * @param data The data of the event, which may have several lines.
+     * @param event The type of the event, "message" if empty.
+     * @param id The ID of the event, which the client sends back in the
+     * Last-Event-ID header when it reconnects.
+     */
+    bool send(std::string_view data,
+              std::string_view event = {},
+              std::string_view id = {});
+
+    /// Send a comment, which is ignored by the client, e.g. to keep the
+    /// connection alive.
+    bool sendComment(std::string_view comment = {});
+
+    /// Set the time the client waits before reconnecting, in milliseconds.
+    bool sendRetry(size_t milliseconds);
+
+    void close();
+
+    /// Format an event in the text/event-stream format. The line breaks of
+    /// the event type and ID are removed.
+    static std::string formatEvent(std::string_view data,
+                                   std::string_view event = {},
+                                   std::string_view id = {});
+
+  private:
+    friend class SseBroadcaster;
+
+    bool sendText(const std::string &text);
+    // See ResponseStream::sendFramedChunk()
+    bool sendFramedChunk(const std::string &chunk);
+    static std::string frameChunk(const std::string &text);
+
+    ResponseStreamPtr stream_;
+};
+
+using SseStreamPtr = std::unique_ptr<SseStream>;
 
 class DROGON_EXPORT HttpResponse
 {
@@ -167,6 +297,12 @@ class DROGON_EXPORT HttpResponse
     /// Get whether the response allow compression.
     virtual bool allowCompression() const = 0;
 
+    /**
+     * @brief Set the compression policy of the response, it takes precedence
+     * over the policies set by HttpAppFramework::setCompressionPolicy().
+     */
+    virtual void setCompressionPolicy(const CompressionPolicy &policy) = 0;
+
     /// Get the creation timestamp of the response.
     virtual const trantor::Date &creationDate() const = 0;
 
@@ -268,6 +404,25 @@ class DROGON_EXPORT HttpResponse
     virtual void addHeader(std::string field, const std::string &value) = 0;
     virtual void addHeader(std::string field, std::string &&value) = 0;
 
+    /**
+     * @brief Add a trailer field, which is sent after the body, such as the
+     * status of a gRPC call.
+     *
+     * @note The trailers are only sent over HTTP/2 connections. They can be
+     * added to a streamed response until its stream is closed.
+     */
+    virtual void addTrailer(std::string field, std::string value) = 0;
+
+    /**
+     * @brief Get the trailer identified by the key, which is case
+     * insensitive. The trailers received by the HTTP/2 clients are kept
+     * there too.
+     */
+    virtual const std::string &getTrailer(std::string key) const = 0;
+
+    /// Get all the trailers of the response
+    virtual const SafeStringMap<std::string> &trailers() const = 0;
+
     /// Add a cookie
     virtual void addCookie(const std::string &key,
                            const std::string &value) = 0;
@@ -301,6 +456,16 @@ class DROGON_EXPORT HttpResponse
     /// Set the response body(content).
     virtual void setBody(std::string &&body) = 0;
 
+    /**
+     * @brief Use the memory kept alive by the owner as the body, without
+     * copying it. For example, the value of a Redis reply shared by
+     * RedisResult::shareString().
+     *
+     * @note The memory must not be modified while the owner is alive.
+     */
+    virtual void setSharedBody(std::shared_ptr<const void> owner,
+                               std::string_view body) = 0;
+
     /// Set the response body(content).
     template <int N>
     void setBody(const char (&body)[N])
@@ -354,6 +519,25 @@ class DROGON_EXPORT HttpResponse
     /// Get the expiration time of the response.
     virtual ssize_t expiredTime() const = 0;
 
+    /**
+     * @brief Make the response immutable, e.g. an error page sent to many
+     * requests. Its complete bytes (the status line, the headers and the
+     * body) are rendered once here and sent by reference, only the date is
+     * updated once a second.
+     *
+     * Like a cached response (the expiration time is set to 0), it is copied
+     * when a request needs to change it, e.g. to add a session cookie or to
+     * compress it. Unlike one, it isn't kept in the cache of the handler
+     * which returns it.
+     *
+     * @note The response must not be changed afterwards, setExpiredTime()
+     * makes it mutable again.
+     */
+    virtual void setImmutable() = 0;
+
+    /// Return true if the response is made immutable by setImmutable().
+    virtual bool isImmutable() const = 0;
+
     ssize_t getExpiredTime() const
     {
         return expiredTime();
@@ -390,6 +574,20 @@ class DROGON_EXPORT HttpResponse
      */
     virtual void setPassThrough(bool flag) = 0;
 
+    /**
+     * @brief Freeze the response as the template of responses which only
+     * differ by their bodies, e.g. the responses of an API endpoint. The
+     * status line and the headers (including the content type) are rendered
+     * once here, the responses created by newHttpResponse(templateResp, body)
+     * share these bytes and only the content-length and the date header are
+     * rendered for each of them.
+     *
+     * @note The template must not be changed after it is frozen, then it can
+     * be shared by threads. The responses created from it can be changed,
+     * they are rendered as usual when their headers or status change.
+     */
+    virtual void freezeAsTemplate() = 0;
+
     /**
      * @brief Get the certificate of the peer, if any.
      * @return The certificate of the peer. nullptr is none.
@@ -410,6 +608,12 @@ class DROGON_EXPORT HttpResponse
     /// Create a response with a status code and a content type
     static HttpResponsePtr newHttpResponse(HttpStatusCode code,
                                            ContentType type);
+    /// Create a response with the status, the headers, the content type and
+    /// the cookies of a template frozen by freezeAsTemplate(), and the body.
+    /// The response creation advices are not called, the template went
+    /// through them when it was created.
+    static HttpResponsePtr newHttpResponse(const HttpResponsePtr &templateResp,
+                                           std::string body);
     /// Create a response which returns a 404 page.
     static HttpResponsePtr newNotFoundResponse(
         const HttpRequestPtr &req = HttpRequestPtr());
@@ -419,6 +623,22 @@ class DROGON_EXPORT HttpResponse
     /// Create a response which returns a json object. Its content-type is set
     /// to application/json.
     static HttpResponsePtr newHttpJsonResponse(Json::Value &&data);
+    /**
+     * @brief Create a response which returns a struct reflected by
+     * DROGON_REFLECT, an ORM model or a container of them, written as JSON
+     * straight into the body. Its content-type is set to application/json.
+     */
+    template <typename T,
+              std::enable_if_t<internal::canBeJsonResponse<T>, int> = 0>
+    static HttpResponsePtr newHttpJsonResponse(const T &data)
+    {
+        std::string body;
+        JsonWriter writer(body, JsonWriter::appOptions());
+        writeJson(writer, data);
+        auto resp = newHttpResponse(k200OK, CT_APPLICATION_JSON);
+        resp->setBody(std::move(body));
+        return resp;
+    }
     /// Create a response that returns a page rendered by a view named
     /// viewName.
     /**
@@ -451,6 +671,8 @@ class DROGON_EXPORT HttpResponse
      * content type is set by drogon based on the file extension and typeString.
      * Set it to CT_CUSTOM when no drogon internal content type matches.
      * @param typeString the MIME string of the content type.
+     * @note The file is sent by sendfile(2) on plain connections. On TLS
+     * connections it is read and encrypted in user space.
      */
     static HttpResponsePtr newFileResponse(
         const std::string &fullPath,
@@ -486,6 +708,28 @@ class DROGON_EXPORT HttpResponse
         const std::string &typeString = "",
         const HttpRequestPtr &req = HttpRequestPtr());
 
+    /// Create a response that returns several parts of a file to the client.
+    /**
+     * @brief The response is a multipart/byteranges body (rfc7233-4.1) whose
+     * parts are sent from the file one after the other, by sendfile(2) when
+     * it is enabled, without reading them in memory. It's the same as the
+     * single range newFileResponse() if there is only one range. If a range
+     * can not be satisfied, statusCode will be set to
+     * k416RequestedRangeNotSatisfiable.
+     *
+     * @param fullPath is the full path to the file.
+     * @param ranges are the offsets and the lengths of the parts, in bytes.
+     * The lengths must not be 0.
+     * @param type the content type code of the parts, see newFileResponse().
+     * @param typeString the MIME string of the content type of the parts.
+     */
+    static HttpResponsePtr newFileResponse(
+        const std::string &fullPath,
+        const std::vector<std::pair<size_t, size_t>> &ranges,
+        ContentType type = CT_NONE,
+        const std::string &typeString = "",
+        const HttpRequestPtr &req = HttpRequestPtr());
+
     /// Create a response that returns a file to the client from buffer in
     /// memory/stack
     /**
@@ -548,6 +792,46 @@ class DROGON_EXPORT HttpResponse
         const std::function<void(ResponseStreamPtr)> &callback,
         bool disableKickoffTimeout = false);
 
+    /**
+     * @brief Create an async stream response made of a JSON array, whose
+     * elements are appended to the JsonArrayStream given to the callback.
+     * Its content-type is set to application/json.
+     *
+     * @code
+       return HttpResponse::newJsonArrayStreamResponse(
+           [](JsonArrayStreamPtr stream) {
+               for (auto &user : loadUsers())
+                   if (!stream->append(user))
+                       break;
+               stream->close();
+           });
+       @endcode
+     * @note The status code can't be changed once the callback has been
+     * called, an error while producing the elements can only end the array
+     * early.
+     */
+    static HttpResponsePtr newJsonArrayStreamResponse(
+        const std::function<void(JsonArrayStreamPtr)> &callback,
+        bool disableKickoffTimeout = false);
+
+    /**
+     * @brief Create a Server-Sent Events response, whose events are sent with
+     * the SseStream given to the callback. The callback is called in the IO
+     * loop of the connection.
+     *
+     * @code
+       return HttpResponse::newSseResponse([](SseStreamPtr stream) {
+           stream->send(R"({"price":42})", "quote");
+           ...
+       });
+       @endcode
+     * @note The response isn't compressed, the kickoff timeout of the
+     * connection is disabled and the proxies are asked not to buffer it. See
+     * SseBroadcaster to send the same events to many clients.
+     */
+    static HttpResponsePtr newSseResponse(
+        const std::function<void(SseStreamPtr)> &callback);
+
     /**
      * @brief Create a custom HTTP response object. For using this template,
      * users must specialize the toResponse template.
@@ -746,6 +1030,24 @@ class DROGON_EXPORT HttpResponse
                                      size_t messageLength) = 0;
 };
 
+template <typename T>
+HttpResponsePtr toResponse(T &&obj)
+{
+    // The reflected structs and the ORM models are written as JSON.
+    if constexpr (internal::canBeJsonResponse<std::decay_t<T>>)
+    {
+        return HttpResponse::newHttpJsonResponse(obj);
+    }
+    else
+    {
+        (void)obj;
+        LOG_ERROR
+            << "You must specialize the toResponse template for the type of "
+            << DrClassMap::demangle(typeid(T).name());
+        exit(1);
+    }
+}
+
 template <>
 inline HttpResponsePtr toResponse<const Json::Value &>(const Json::Value &pJson)
 {
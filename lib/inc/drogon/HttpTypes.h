@@ -212,6 +212,10 @@ enum class ReqResult
     HandshakeError,
     InvalidCertificate,
     EncryptionFailure,
+    // The request being handled by the caller was cancelled.
+    Cancelled,
+    // Not sent, the circuit breaker of the client is open.
+    CircuitOpen,
 };
 
 enum class WebSocketMessageType
@@ -224,6 +228,19 @@ enum class WebSocketMessageType
     Unknown
 };
 
+/// What is done when the output queued in a connection for a slow peer
+/// reaches the high water mark, see WebSocketConnection::setBackpressure()
+/// and ResponseStream::setBackpressure().
+enum class BackpressurePolicy
+{
+    // The producer is told to stop, and to resume once the output is sent.
+    Pause = 0,
+    // The messages sent above the mark are dropped until the output is sent.
+    Drop,
+    // The connection is closed.
+    Close
+};
+
 inline std::string_view to_string_view(drogon::ReqResult result)
 {
     switch (result)
@@ -244,6 +261,10 @@ inline std::string_view to_string_view(drogon::ReqResult result)
             return "Invalid certificate";
         case ReqResult::EncryptionFailure:
             return "Unrecoverable encryption failure";
+        case ReqResult::Cancelled:
+            return "Cancelled";
+        case ReqResult::CircuitOpen:
+            return "Circuit breaker open";
         default:
             return "Unknown error";
     }
@@ -149,23 +149,12 @@ class DROGON_EXPORT HttpViewData
         return htmlTranslate(str.data(), str.length());
     }
 
-    static bool needTranslation(const std::string_view &str)
-    {
-        for (auto const &c : str)
-        {
-            switch (c)
-            {
-                case '"':
-                case '&':
-                case '<':
-                case '>':
-                    return true;
-                default:
-                    continue;
-            }
-        }
-        return false;
-    }
+    /// Append the translation of the string to the output, without a
+    /// temporary string.
+    static void appendHtmlTranslation(std::string &output,
+                                      const std::string_view &str);
+
+    static bool needTranslation(const std::string_view &str);
 
   protected:
     using ViewDataMap = std::unordered_map<std::string, std::any>;
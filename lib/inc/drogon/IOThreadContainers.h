@@ -0,0 +1,203 @@
+/**
+ *
+ *  @file IOThreadContainers.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/IOThreadStorage.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * The containers sharded by event loop, built on IOThreadStorage: every
+ * loop (the IO loops and the main loop) works on a shard of its own without
+ * any lock, the shards are aggregated on demand.
+ *
+ * Like IOThreadStorage, they must be created after the number of IO threads
+ * is set and only be used in the threads of the loops, e.g. in the request
+ * handlers.
+ */
+namespace drogon
+{
+/**
+ * @brief A counter updated by the loops, each one adds to its own cell.
+ */
+class IOThreadCounter : public trantor::NonCopyable
+{
+  public:
+    IOThreadCounter() = default;
+
+    /// Add to the cell of the current loop.
+    void add(int64_t value)
+    {
+        // The cell is only written by its loop.
+        auto &cell = cells_.getThreadData().value;
+        cell.store(cell.load(std::memory_order_relaxed) + value,
+                   std::memory_order_relaxed);
+    }
+
+    void increment()
+    {
+        add(1);
+    }
+
+    /// The sum of the cells, it may be read in any thread.
+    int64_t value() const
+    {
+        int64_t sum = 0;
+        for (size_t i = 0; i < cells_.size(); ++i)
+            sum += cells_.at(i).value.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+  private:
+    struct Cell
+    {
+        Cell() = default;
+
+        // Only copied when the storage is created
+        Cell(const Cell &other) : value(other.value.load())
+        {
+        }
+
+        std::atomic<int64_t> value{0};
+    };
+
+    IOThreadStorage<Cell> cells_;
+};
+
+/**
+ * @brief A hash map sharded by loop, each loop reads and writes its own
+ * map, e.g. the per-loop statistics of the keys.
+ */
+template <typename Key,
+          typename Value,
+          typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class IOThreadMap : public trantor::NonCopyable
+{
+  public:
+    using MapType = std::unordered_map<Key, Value, Hash, KeyEqual>;
+
+    /// The map of the current loop.
+    MapType &local()
+    {
+        return maps_.getThreadData();
+    }
+
+    /**
+     * @brief Merge the maps of all the loops, each one is read in its loop.
+     *
+     * @param combine Called with the merged value and the value of another
+     * loop when the key is in several maps.
+     * @param done Called with the merged map in the main loop.
+     *
+     * @note The map must outlive the merge.
+     */
+    void merge(std::function<void(Value &, const Value &)> combine,
+               std::function<void(MapType &&)> done)
+    {
+        maps_.aggregate(
+            MapType{},
+            [combine = std::move(combine)](MapType &merged,
+                                           const MapType &map) {
+                for (auto &item : map)
+                {
+                    auto [iter, inserted] =
+                        merged.try_emplace(item.first, item.second);
+                    if (!inserted)
+                        combine(iter->second, item.second);
+                }
+            },
+            std::move(done));
+    }
+
+  private:
+    IOThreadStorage<MapType> maps_;
+};
+
+/**
+ * @brief A pool of reusable objects for each loop, so the objects are taken
+ * and given back without any lock.
+ *
+ * A released object goes back to the pool of the loop which took it, or is
+ * deleted if that pool is full. The objects are reused as they are, the
+ * users reset them.
+ */
+template <typename T>
+class IOThreadObjectPool : public trantor::NonCopyable
+{
+  public:
+    using Factory = std::function<std::unique_ptr<T>()>;
+
+    explicit IOThreadObjectPool(
+        size_t maxObjectsPerLoop = 64,
+        Factory factory = []() { return std::make_unique<T>(); })
+        : state_(std::make_shared<State>(maxObjectsPerLoop,
+                                         std::move(factory)))
+    {
+    }
+
+    /// Take an object from the pool of the current loop, or a new one.
+    std::shared_ptr<T> acquire()
+    {
+        auto index = app().getCurrentThreadIndex();
+        auto &pool = state_->pools.getThreadData();
+        T *object;
+        if (pool.empty())
+        {
+            object = state_->factory().release();
+        }
+        else
+        {
+            object = pool.back().release();
+            pool.pop_back();
+        }
+        std::weak_ptr<State> weakState = state_;
+        return std::shared_ptr<T>(object, [weakState, index](T *object) {
+            auto state = weakState.lock();
+            if (!state)
+            {
+                delete object;
+                return;
+            }
+            getIOThreadStorageLoop(index)->runInLoop([state, object]() {
+                auto &pool = state->pools.getThreadData();
+                if (pool.size() < state->maxObjectsPerLoop)
+                    pool.emplace_back(object);
+                else
+                    delete object;
+            });
+        });
+    }
+
+  private:
+    struct State
+    {
+        State(size_t maxObjects, Factory &&objectFactory)
+            : maxObjectsPerLoop(maxObjects), factory(std::move(objectFactory))
+        {
+        }
+
+        IOThreadStorage<std::vector<std::unique_ptr<T>>> pools;
+        size_t maxObjectsPerLoop;
+        Factory factory;
+    };
+
+    std::shared_ptr<State> state_;
+};
+}  // namespace drogon
@@ -20,9 +20,25 @@
 #include <vector>
 #include <limits>
 #include <functional>
+#include <utility>
 
 namespace drogon
 {
+/**
+ * @brief Get the loop of the thread storage slot given by the index, the
+ * slot after the ones of the IO loops is the one of the main loop.
+ */
+inline trantor::EventLoop *getIOThreadStorageLoop(size_t index) noexcept(false)
+{
+    if (index > drogon::app().getThreadNum())
+    {
+        throw std::out_of_range("Event loop index is out of range");
+    }
+    if (index == drogon::app().getThreadNum())
+        return drogon::app().getLoop();
+    return drogon::app().getIOLoop(index);
+}
+
 /**
  * @brief Utility class for thread storage handling
  *
@@ -55,6 +71,9 @@ namespace drogon
  *      IOThreadStorage<MyThreadData> storage_;
  * };
  * @endcode
+ *
+ * Each value is aligned on a cache line of its own, so the values written by
+ * different threads don't share a cache line.
  */
 template <typename C>
 class IOThreadStorage : public trantor::NonCopyable
@@ -77,7 +96,7 @@ class IOThreadStorage : public trantor::NonCopyable
 
         for (size_t i = 0; i <= numThreads; ++i)
         {
-            storage_.emplace_back(std::forward<Args>(args)...);
+            storage_.emplace_back(std::in_place, std::forward<Args>(args)...);
         }
     }
 
@@ -85,10 +104,55 @@ class IOThreadStorage : public trantor::NonCopyable
     {
         for (size_t i = 0; i < storage_.size(); ++i)
         {
-            initCB(storage_[i], i);
+            initCB(storage_[i].value, i);
         }
     }
 
+    /**
+     * @brief The number of values, the number of IO loops plus one for the
+     * main loop.
+     */
+    size_t size() const
+    {
+        return storage_.size();
+    }
+
+    /**
+     * @brief Get the value of a loop by its index, see
+     * getIOThreadStorageLoop().
+     *
+     * @note The value is not synchronized with its loop.
+     */
+    ValueType &at(size_t index)
+    {
+        assert(index < storage_.size());
+        return storage_[index].value;
+    }
+
+    const ValueType &at(size_t index) const
+    {
+        assert(index < storage_.size());
+        return storage_[index].value;
+    }
+
+    /**
+     * @brief Fold the values into the result, each one in the thread of its
+     * loop, then call the callback with the result in the main loop.
+     *
+     * The loops are visited one after the other, so the values which are
+     * only used in their loops are aggregated without any lock.
+     *
+     * @note The storage must outlive the aggregation.
+     */
+    template <typename T, typename Fold, typename Done>
+    void aggregate(T init, Fold &&fold, Done &&done)
+    {
+        aggregateFrom<T>(0,
+                         std::make_shared<T>(std::move(init)),
+                         std::forward<Fold>(fold),
+                         std::forward<Done>(done));
+    }
+
     /**
      * @brief Get the thread storage associate with the current thread
      *
@@ -98,14 +162,14 @@ class IOThreadStorage : public trantor::NonCopyable
     {
         size_t idx = app().getCurrentThreadIndex();
         assert(idx < storage_.size());
-        return storage_[idx];
+        return storage_[idx].value;
     }
 
     inline const ValueType &getThreadData() const
     {
         size_t idx = app().getCurrentThreadIndex();
         assert(idx < storage_.size());
-        return storage_[idx];
+        return storage_[idx].value;
     }
 
     /**
@@ -117,21 +181,21 @@ class IOThreadStorage : public trantor::NonCopyable
     {
         size_t idx = app().getCurrentThreadIndex();
         assert(idx < storage_.size());
-        storage_[idx] = newData;
+        storage_[idx].value = newData;
     }
 
     inline void setThreadData(ValueType &&newData)
     {
         size_t idx = app().getCurrentThreadIndex();
         assert(idx < storage_.size());
-        storage_[idx] = std::move(newData);
+        storage_[idx].value = std::move(newData);
     }
 
     inline ValueType *operator->()
     {
         size_t idx = app().getCurrentThreadIndex();
         assert(idx < storage_.size());
-        return &storage_[idx];
+        return &storage_[idx].value;
     }
 
     inline ValueType &operator*()
@@ -143,7 +207,7 @@ class IOThreadStorage : public trantor::NonCopyable
     {
         size_t idx = app().getCurrentThreadIndex();
         assert(idx < storage_.size());
-        return &storage_[idx];
+        return &storage_[idx].value;
     }
 
     inline const ValueType &operator*() const
@@ -152,17 +216,42 @@ class IOThreadStorage : public trantor::NonCopyable
     }
 
   private:
-    std::vector<ValueType> storage_;
-};
+    struct alignas(64) Slot
+    {
+        template <typename... Args>
+        explicit Slot(std::in_place_t, Args &&...args)
+            : value(std::forward<Args>(args)...)
+        {
+        }
 
-inline trantor::EventLoop *getIOThreadStorageLoop(size_t index) noexcept(false)
-{
-    if (index > drogon::app().getThreadNum())
+        ValueType value;
+    };
+
+    template <typename T>
+    void aggregateFrom(size_t index,
+                       std::shared_ptr<T> result,
+                       std::function<void(T &, const ValueType &)> fold,
+                       std::function<void(T &&)> done)
     {
-        throw std::out_of_range("Event loop index is out of range");
+        if (index == storage_.size())
+        {
+            done(std::move(*result));
+            return;
+        }
+        getIOThreadStorageLoop(index)->runInLoop(
+            [this,
+             index,
+             result = std::move(result),
+             fold = std::move(fold),
+             done = std::move(done)]() mutable {
+                fold(*result, storage_[index].value);
+                aggregateFrom(index + 1,
+                              std::move(result),
+                              std::move(fold),
+                              std::move(done));
+            });
     }
-    if (index == drogon::app().getThreadNum())
-        return drogon::app().getLoop();
-    return drogon::app().getIOLoop(index);
-}
+
+    std::vector<Slot> storage_;
+};
 }  // namespace drogon
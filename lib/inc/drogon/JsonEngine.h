@@ -0,0 +1,62 @@
+/**
+ *
+ *  @file JsonEngine.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <json/value.h>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace drogon
+{
+/**
+ * @brief The parser and the serializer of the JSON bodies of the requests and
+ * the responses, and of the JSON messages of the websockets.
+ *
+ * The default engine parses with jsoncpp and serializes with JsonWriter. An
+ * application can install another one with app().setJsonEngine(), e.g. one
+ * parsing with simdjson into the Json::Value objects the handlers use.
+ */
+class DROGON_EXPORT JsonEngine
+{
+  public:
+    virtual ~JsonEngine() = default;
+
+    /**
+     * @brief Parse the JSON text.
+     *
+     * @param text The text to parse.
+     * @param value The parsed value.
+     * @param errors The description of the errors if the text is invalid.
+     * @return false if the text is invalid.
+     * @note This method is called by several threads at once.
+     */
+    virtual bool parse(std::string_view text,
+                       Json::Value &value,
+                       std::string &errors) = 0;
+
+    /**
+     * @brief Append the compact JSON text of the value to the output.
+     * @note This method is called by several threads at once.
+     */
+    virtual void serialize(const Json::Value &value, std::string &output) = 0;
+
+    /// The engine used when the application doesn't set one
+    static std::shared_ptr<JsonEngine> newDefaultEngine();
+};
+
+using JsonEnginePtr = std::shared_ptr<JsonEngine>;
+}  // namespace drogon
@@ -17,6 +17,9 @@
 #include "drogon/utils/Utilities.h"
 #include <drogon/exports.h>
 #include <drogon/HttpRequest.h>
+#include <drogon/RequestStream.h>
+#include <exception>
+#include <functional>
 #include <unordered_map>
 #include <string>
 #include <vector>
@@ -110,6 +113,12 @@ class DROGON_EXPORT HttpFile
     /// Return the md5 string of the file
     std::string getMd5() const noexcept;
 
+    /// Return the sha256 string of the file
+    std::string getSha256() const noexcept;
+
+    /// Return the sha3-256 string of the file
+    std::string getSha3() const noexcept;
+
     /// Return the content transfer encoding of the file.
     const std::string &getContentTransferEncoding() const noexcept;
 
@@ -174,7 +183,56 @@ class DROGON_EXPORT MultiPartParser
     /// Parse the http request stream to get files and parameters.
     int parse(const HttpRequestPtr &req);
 
+    using StreamCallback =
+        std::function<void(MultiPartParser &&parser, std::exception_ptr ex)>;
+
+    /// The digests of the files computed by the stream reader while they are
+    /// received, returned by HttpFile::getMd5(), getSha256() and getSha3()
+    /// without reading the files again.
+    enum StreamDigest
+    {
+        kDigestNone = 0,
+        kDigestMd5 = 1,
+        kDigestSha256 = 2,
+        kDigestSha3 = 4
+    };
+
+    /**
+     * @brief Create a reader of the request stream (see
+     * HttpAppFramework::enableRequestStream()) parsing the multipart body as
+     * it arrives, so that the whole body is never held in memory.
+     *
+     * The files are written to temporary files in the upload path while they
+     * are received, saving them moves the temporary files to their
+     * destination, and the unsaved ones are removed. The parser is passed to
+     * the callback when the body is received, or with the error.
+     *
+     * @param digests The digests computed while receiving the files, a
+     * combination of the StreamDigest flags. The others are computed from the
+     * files when they are asked for.
+     *
+     * @code
+       stream->setStreamReader(MultiPartParser::newStreamReader(
+           req,
+           [](MultiPartParser &&parser, std::exception_ptr ex) {
+               if (ex)
+                   return;
+               for (auto &file : parser.getFiles())
+               {
+                   LOG_INFO << file.getFileName() << ": " << file.getSha256();
+                   file.save();
+               }
+           },
+           MultiPartParser::kDigestSha256));
+       @endcode
+     */
+    static RequestStreamReaderPtr newStreamReader(const HttpRequestPtr &req,
+                                                  StreamCallback callback,
+                                                  int digests = kDigestNone);
+
   protected:
+    friend class MultiPartStreamReader;
+
     std::vector<HttpFile> files_;
     SafeStringMap<std::string> parameters_;
     int parse(const HttpRequestPtr &req,
@@ -14,13 +14,18 @@
 
 #pragma once
 
+#include <trantor/net/EventLoop.h>
 #include <trantor/utils/NonCopyable.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <functional>
 #include <mutex>
 #include <shared_mutex>
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace drogon
 {
@@ -29,6 +34,18 @@ using SubscriberID = uint64_t;
 /**
  * @brief This class template presents an unnamed topic.
  *
+ * The subscribers are kept in an immutable snapshot which is replaced by every
+ * subscription change, so publishers never wait for each other, for the
+ * subscribers or for the subscription changes.
+ *
+ * A subscriber may be bound to an event loop, e.g. the one of its WebSocket
+ * connection, its handler is then invoked in the loop. A publish() runs one
+ * task in every loop with subscribers, which invokes all of them, the message
+ * is copied once for all the loops.
+ *
+ * @note A handler may still be invoked by a publish() which started before
+ * the handler is unsubscribed, or after that in its loop.
+ *
  * @tparam MessageType
  */
 template <typename MessageType>
@@ -49,10 +66,26 @@ class Topic : public trantor::NonCopyable
      */
     void publish(const MessageType &message) const
     {
-        std::shared_lock<SharedMutex> lock(mutex_);
-        for (auto &pair : handlersMap_)
+        auto handlers = loadHandlers();
+        if (!handlers->loops.empty())
+        {
+            auto messagePtr = std::make_shared<const MessageType>(message);
+            for (auto &pair : handlers->loops)
+            {
+                // Invoked at once if the publisher runs in the loop
+                pair.first->runInLoop(
+                    [messagePtr, loopHandlers = pair.second]() {
+                        for (auto &handler : *loopHandlers)
+                        {
+                            (*handler)(*messagePtr);
+                        }
+                    });
+            }
+        }
+        for (auto &subscriber : handlers->subscribers)
         {
-            pair.second(message);
+            if (!subscriber.loop)
+                (*subscriber.handler)(message);
         }
     }
 
@@ -64,9 +97,7 @@ class Topic : public trantor::NonCopyable
      */
     SubscriberID subscribe(const MessageHandler &handler)
     {
-        std::unique_lock<SharedMutex> lock(mutex_);
-        handlersMap_[++id_] = handler;
-        return id_;
+        return subscribe(MessageHandler(handler));
     }
 
     /**
@@ -77,8 +108,33 @@ class Topic : public trantor::NonCopyable
      */
     SubscriberID subscribe(MessageHandler &&handler)
     {
-        std::unique_lock<SharedMutex> lock(mutex_);
-        handlersMap_[++id_] = std::move(handler);
+        return subscribe(nullptr, std::move(handler));
+    }
+
+    /**
+     * @brief Subscribe to the topic in an event loop.
+     *
+     * @param loop The loop in which the handler is invoked, nullptr to invoke
+     * it in the thread of the publisher.
+     * @param handler is invoked when a message arrives.
+     * @return SubscriberID
+     */
+    SubscriberID subscribe(trantor::EventLoop *loop,
+                           const MessageHandler &handler)
+    {
+        return subscribe(loop, MessageHandler(handler));
+    }
+
+    SubscriberID subscribe(trantor::EventLoop *loop, MessageHandler &&handler)
+    {
+        auto handlerPtr =
+            std::make_shared<const MessageHandler>(std::move(handler));
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Only the pointers of the handlers are copied
+        auto subscribers = loadHandlers()->subscribers;
+        // The IDs are increasing, so the handlers are sorted by the IDs
+        subscribers.push_back({++id_, loop, std::move(handlerPtr)});
+        storeHandlers(makeHandlers(std::move(subscribers)));
         return id_;
     }
 
@@ -87,8 +143,24 @@ class Topic : public trantor::NonCopyable
      */
     void unsubscribe(SubscriberID id)
     {
-        std::unique_lock<SharedMutex> lock(mutex_);
-        handlersMap_.erase(id);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto current = loadHandlers();
+        auto &currentSubscribers = current->subscribers;
+        auto iter = std::lower_bound(currentSubscribers.begin(),
+                                     currentSubscribers.end(),
+                                     id,
+                                     [](const auto &item, SubscriberID id) {
+                                         return item.id < id;
+                                     });
+        if (iter == currentSubscribers.end() || iter->id != id)
+            return;
+        std::vector<Subscriber> subscribers;
+        subscribers.reserve(currentSubscribers.size() - 1);
+        subscribers.insert(subscribers.end(), currentSubscribers.begin(), iter);
+        subscribers.insert(subscribers.end(),
+                           iter + 1,
+                           currentSubscribers.end());
+        storeHandlers(makeHandlers(std::move(subscribers)));
     }
 
     /**
@@ -99,8 +171,7 @@ class Topic : public trantor::NonCopyable
      */
     bool empty() const
     {
-        std::shared_lock<SharedMutex> lock(mutex_);
-        return handlersMap_.empty();
+        return loadHandlers()->subscribers.empty();
     }
 
     /**
@@ -109,13 +180,83 @@ class Topic : public trantor::NonCopyable
      */
     void clear()
     {
-        std::unique_lock<SharedMutex> lock(mutex_);
-        handlersMap_.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        storeHandlers(std::make_shared<const Handlers>());
     }
 
   private:
-    std::unordered_map<SubscriberID, MessageHandler> handlersMap_;
-    mutable SharedMutex mutex_;
+    struct Subscriber
+    {
+        SubscriberID id;
+        trantor::EventLoop *loop;
+        std::shared_ptr<const MessageHandler> handler;
+    };
+
+    using LoopHandlers = std::vector<std::shared_ptr<const MessageHandler>>;
+    using LoopHandlersPtr = std::shared_ptr<const LoopHandlers>;
+
+    struct Handlers
+    {
+        // Sorted by the IDs
+        std::vector<Subscriber> subscribers;
+        // The handlers of the subscribers bound to every loop
+        std::vector<std::pair<trantor::EventLoop *, LoopHandlersPtr>> loops;
+    };
+
+    static std::shared_ptr<const Handlers> makeHandlers(
+        std::vector<Subscriber> &&subscribers)
+    {
+        auto handlers = std::make_shared<Handlers>();
+        std::unordered_map<trantor::EventLoop *, std::shared_ptr<LoopHandlers>>
+            loops;
+        for (auto &subscriber : subscribers)
+        {
+            if (!subscriber.loop)
+                continue;
+            auto &loopHandlers = loops[subscriber.loop];
+            if (!loopHandlers)
+            {
+                loopHandlers = std::make_shared<LoopHandlers>();
+                handlers->loops.emplace_back(subscriber.loop, loopHandlers);
+            }
+            loopHandlers->push_back(subscriber.handler);
+        }
+        handlers->subscribers = std::move(subscribers);
+        return handlers;
+    }
+
+#ifdef __cpp_lib_atomic_shared_ptr
+    std::shared_ptr<const Handlers> loadHandlers() const
+    {
+        return handlers_.load(std::memory_order_acquire);
+    }
+
+    void storeHandlers(std::shared_ptr<const Handlers> handlers)
+    {
+        handlers_.store(std::move(handlers), std::memory_order_release);
+    }
+
+    std::atomic<std::shared_ptr<const Handlers>> handlers_{
+        std::make_shared<const Handlers>()};
+#else
+    std::shared_ptr<const Handlers> loadHandlers() const
+    {
+        return std::atomic_load_explicit(&handlers_,
+                                         std::memory_order_acquire);
+    }
+
+    void storeHandlers(std::shared_ptr<const Handlers> handlers)
+    {
+        std::atomic_store_explicit(&handlers_,
+                                   std::move(handlers),
+                                   std::memory_order_release);
+    }
+
+    std::shared_ptr<const Handlers> handlers_{
+        std::make_shared<const Handlers>()};
+#endif
+    // Serializes the subscription changes
+    std::mutex mutex_;
     SubscriberID id_{0};
 };
 
@@ -123,6 +264,10 @@ class Topic : public trantor::NonCopyable
  * @brief This class template implements a publish-subscribe pattern with
  * multiple named topics.
  *
+ * The topics are distributed over several shards by the hash values of their
+ * names, so operations on different topics rarely contend for the same lock.
+ * The locks are never held while the handlers are invoked.
+ *
  * @tparam MessageType The message type.
  */
 template <typename MessageType>
@@ -143,20 +288,9 @@ class PubSubService : public trantor::NonCopyable
      */
     void publish(const std::string &topicName, const MessageType &message) const
     {
-        std::shared_ptr<Topic<MessageType>> topicPtr;
-        {
-            std::shared_lock<SharedMutex> lock(mutex_);
-            auto iter = topicMap_.find(topicName);
-            if (iter != topicMap_.end())
-            {
-                topicPtr = iter->second;
-            }
-            else
-            {
-                return;
-            }
-        }
-        topicPtr->publish(message);
+        auto topicPtr = findTopic(topicName);
+        if (topicPtr)
+            topicPtr->publish(message);
     }
 
     /**
@@ -189,6 +323,21 @@ class PubSubService : public trantor::NonCopyable
         return subscribeToTopic(topicName, std::move(topicHandler));
     }
 
+    /**
+     * @brief Subscribe to a topic in an event loop, the handler is invoked in
+     * the loop, see Topic::subscribe().
+     */
+    SubscriberID subscribe(const std::string &topicName,
+                           trantor::EventLoop *loop,
+                           MessageHandler handler)
+    {
+        auto topicHandler = [topicName, handler = std::move(handler)](
+                                const MessageType &message) {
+            handler(topicName, message);
+        };
+        return subscribeToTopic(topicName, loop, std::move(topicHandler));
+    }
+
     /**
      * @brief Unsubscribe from a topic.
      *
@@ -197,10 +346,11 @@ class PubSubService : public trantor::NonCopyable
      */
     void unsubscribe(const std::string &topicName, SubscriberID id)
     {
+        auto &shard = shardOf(topicName);
         {
-            std::shared_lock<SharedMutex> lock(mutex_);
-            auto iter = topicMap_.find(topicName);
-            if (iter == topicMap_.end())
+            std::shared_lock<SharedMutex> lock(shard.mutex);
+            auto iter = shard.topicMap.find(topicName);
+            if (iter == shard.topicMap.end())
             {
                 return;
             }
@@ -208,14 +358,14 @@ class PubSubService : public trantor::NonCopyable
             if (!iter->second->empty())
                 return;
         }
-        std::unique_lock<SharedMutex> lock(mutex_);
-        auto iter = topicMap_.find(topicName);
-        if (iter == topicMap_.end())
+        std::unique_lock<SharedMutex> lock(shard.mutex);
+        auto iter = shard.topicMap.find(topicName);
+        if (iter == shard.topicMap.end())
         {
             return;
         }
         if (iter->second->empty())
-            topicMap_.erase(iter);
+            shard.topicMap.erase(iter);
     }
 
     /**
@@ -223,8 +373,13 @@ class PubSubService : public trantor::NonCopyable
      */
     size_t size() const
     {
-        std::shared_lock<SharedMutex> lock(mutex_);
-        return topicMap_.size();
+        size_t total{0};
+        for (auto &shard : shards_)
+        {
+            std::shared_lock<SharedMutex> lock(shard.mutex);
+            total += shard.topicMap.size();
+        }
+        return total;
     }
 
     /**
@@ -232,8 +387,11 @@ class PubSubService : public trantor::NonCopyable
      */
     void clear()
     {
-        std::unique_lock<SharedMutex> lock(mutex_);
-        topicMap_.clear();
+        for (auto &shard : shards_)
+        {
+            std::unique_lock<SharedMutex> lock(shard.mutex);
+            shard.topicMap.clear();
+        }
     }
 
     /**
@@ -242,8 +400,9 @@ class PubSubService : public trantor::NonCopyable
      */
     void removeTopic(const std::string &topicName)
     {
-        std::unique_lock<SharedMutex> lock(mutex_);
-        topicMap_.erase(topicName);
+        auto &shard = shardOf(topicName);
+        std::unique_lock<SharedMutex> lock(shard.mutex);
+        shard.topicMap.erase(topicName);
     }
 
     /**
@@ -255,49 +414,73 @@ class PubSubService : public trantor::NonCopyable
      */
     bool isTopicEmpty(const std::string &topicName) const
     {
-        std::shared_ptr<Topic<MessageType>> topicPtr;
+        auto topicPtr = findTopic(topicName);
+        return !topicPtr || topicPtr->empty();
+    }
+
+  private:
+    struct TopicShard
+    {
+        std::unordered_map<std::string, std::shared_ptr<Topic<MessageType>>>
+            topicMap;
+        mutable SharedMutex mutex;
+    };
+    static constexpr size_t kShardsNum = 16;
+    std::array<TopicShard, kShardsNum> shards_;
+
+    TopicShard &shardOf(const std::string &topicName)
+    {
+        return shards_[std::hash<std::string>{}(topicName) % kShardsNum];
+    }
+
+    const TopicShard &shardOf(const std::string &topicName) const
+    {
+        return shards_[std::hash<std::string>{}(topicName) % kShardsNum];
+    }
+
+    std::shared_ptr<Topic<MessageType>> findTopic(
+        const std::string &topicName) const
+    {
+        auto &shard = shardOf(topicName);
+        std::shared_lock<SharedMutex> lock(shard.mutex);
+        auto iter = shard.topicMap.find(topicName);
+        if (iter != shard.topicMap.end())
         {
-            std::shared_lock<SharedMutex> lock(mutex_);
-            auto iter = topicMap_.find(topicName);
-            if (iter != topicMap_.end())
-            {
-                topicPtr = iter->second;
-            }
-            else
-            {
-                return true;
-            }
+            return iter->second;
         }
-        return topicPtr->empty();
+        return nullptr;
     }
 
-  private:
-    std::unordered_map<std::string, std::shared_ptr<Topic<MessageType>>>
-        topicMap_;
-    mutable SharedMutex mutex_;
-    SubscriberID subID_ = 0;
+    SubscriberID subscribeToTopic(
+        const std::string &topicName,
+        typename Topic<MessageType>::MessageHandler &&handler)
+    {
+        return subscribeToTopic(topicName, nullptr, std::move(handler));
+    }
 
     SubscriberID subscribeToTopic(
         const std::string &topicName,
+        trantor::EventLoop *loop,
         typename Topic<MessageType>::MessageHandler &&handler)
     {
+        auto &shard = shardOf(topicName);
         {
-            std::shared_lock<SharedMutex> lock(mutex_);
-            auto iter = topicMap_.find(topicName);
-            if (iter != topicMap_.end())
+            std::shared_lock<SharedMutex> lock(shard.mutex);
+            auto iter = shard.topicMap.find(topicName);
+            if (iter != shard.topicMap.end())
             {
-                return iter->second->subscribe(std::move(handler));
+                return iter->second->subscribe(loop, std::move(handler));
             }
         }
-        std::unique_lock<SharedMutex> lock(mutex_);
-        auto iter = topicMap_.find(topicName);
-        if (iter != topicMap_.end())
+        std::unique_lock<SharedMutex> lock(shard.mutex);
+        auto iter = shard.topicMap.find(topicName);
+        if (iter != shard.topicMap.end())
         {
-            return iter->second->subscribe(std::move(handler));
+            return iter->second->subscribe(loop, std::move(handler));
         }
         auto topicPtr = std::make_shared<Topic<MessageType>>();
-        auto id = topicPtr->subscribe(std::move(handler));
-        topicMap_[topicName] = std::move(topicPtr);
+        auto id = topicPtr->subscribe(loop, std::move(handler));
+        shard.topicMap[topicName] = std::move(topicPtr);
         return id;
     }
 };
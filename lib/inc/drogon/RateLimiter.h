@@ -28,6 +28,8 @@ using RateLimiterPtr = std::shared_ptr<RateLimiter>;
 /**
  * @brief This class is used to limit the number of requests per second
  *
+ * @note The rate limiters created by newRateLimiter() are lock-free and can be
+ * shared by several threads without a SafeRateLimiter.
  * */
 class DROGON_EXPORT RateLimiter
 {
@@ -53,6 +55,10 @@ class DROGON_EXPORT RateLimiter
     virtual ~RateLimiter() noexcept = default;
 };
 
+/**
+ * @brief A wrapper which makes a rate limiter that isn't thread-safe, e.g. a
+ * custom one, usable by several threads.
+ */
 class DROGON_EXPORT SafeRateLimiter : public RateLimiter
 {
   public:
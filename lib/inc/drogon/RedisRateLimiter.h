@@ -0,0 +1,89 @@
+/**
+ *
+ *  @file RedisRateLimiter.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/RateLimiter.h>
+#include <drogon/nosql/RedisClient.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace drogon
+{
+/**
+ * @brief A rate limiter shared by several application nodes through redis.
+ *
+ * The token bucket lives in a redis key and is updated by a Lua script, each
+ * node leases a batch of tokens from it and consumes them locally, so only
+ * one request per batch causes a redis call and isAllowed() never waits for
+ * redis. A new batch is leased in the background when the local tokens drop
+ * to half a batch. Since every node may hold up to about one and a half
+ * unused batches, the lease size should be small compared to the capacity.
+ *
+ * Before the first lease is answered a node consumes one batch on credit,
+ * which is paid back from the first lease. If redis can't be reached, a local
+ * token bucket with the same capacity is used until a lease succeeds again.
+ *
+ * @note Objects of this class must be created by std::make_shared, they are
+ * thread-safe and don't have to be wrapped in a SafeRateLimiter.
+ */
+class DROGON_EXPORT RedisRateLimiter
+    : public RateLimiter,
+      public std::enable_shared_from_this<RedisRateLimiter>
+{
+  public:
+    /**
+     * @param client The redis client.
+     * @param key The redis key of the token bucket, all the nodes using the
+     * same key share the limit.
+     * @param capacity The maximum number of requests in the time unit.
+     * @param timeUnit The time unit of the rate limiter.
+     * @param leaseSize The number of tokens leased from redis at a time, 0
+     * means a tenth of the capacity.
+     */
+    RedisRateLimiter(nosql::RedisClientPtr client,
+                     std::string key,
+                     size_t capacity,
+                     std::chrono::duration<double> timeUnit =
+                         std::chrono::seconds(60),
+                     size_t leaseSize = 0);
+
+    bool isAllowed() override;
+    ~RedisRateLimiter() noexcept override = default;
+
+  private:
+    void lease();
+    void onLeased(int64_t granted);
+    void onLeaseFailed();
+
+    nosql::RedisClientPtr client_;
+    std::string key_;
+    size_t capacity_;
+    std::chrono::duration<double> timeUnit_;
+    size_t leaseSize_;
+    std::mutex mutex_;
+    // The local balance, it becomes negative if the credit taken before the
+    // first lease isn't fully covered.
+    int64_t tokens_;
+    int64_t credit_;
+    bool leasing_{false};
+    bool redisFailed_{false};
+    std::chrono::steady_clock::time_point nextLeaseTime_;
+    RateLimiterPtr fallbackLimiter_;
+};
+}  // namespace drogon
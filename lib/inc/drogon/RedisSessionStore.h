@@ -0,0 +1,76 @@
+/**
+ *
+ *  @file RedisSessionStore.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/SessionStore.h>
+#include <drogon/nosql/RedisClient.h>
+#include <functional>
+#include <string>
+
+namespace drogon
+{
+/**
+ * @brief A session store keeping the sessions in redis, one string value per
+ * session.
+ *
+ * The default codec serializes the session data to JSON, it supports values
+ * of the std::string, bool, int, unsigned int, int64_t, uint64_t, double and
+ * Json::Value types. Values of other types are not stored, a custom codec can
+ * be given for them.
+ *
+ * For example:
+ * @code
+   app().enableSession(1200min).setSessionStore(
+       std::make_shared<RedisSessionStore>(
+           nosql::RedisClient::newRedisClient(
+               trantor::InetAddress("127.0.0.1", 6379))));
+   @endcode
+ */
+class DROGON_EXPORT RedisSessionStore : public SessionStore
+{
+  public:
+    using Encoder = std::function<std::string(const Session::SessionMap &)>;
+    using Decoder =
+        std::function<bool(const std::string &, Session::SessionMap &)>;
+
+    /**
+     * @param client The redis client.
+     * @param keyPrefix The prefix of the redis keys of the sessions.
+     * @param encoder The function which serializes the session data.
+     * @param decoder The function which deserializes the session data. It
+     * returns false if the data is invalid.
+     */
+    explicit RedisSessionStore(nosql::RedisClientPtr client,
+                               std::string keyPrefix = "drogon:session:",
+                               Encoder encoder = defaultEncoder,
+                               Decoder decoder = defaultDecoder);
+
+    void load(const std::string &sessionId, LoadCallback &&callback) override;
+    void save(std::vector<SessionData> &&sessions, size_t timeout) override;
+    void touch(std::vector<std::string> &&sessionIds, size_t timeout) override;
+    void erase(const std::string &sessionId) override;
+
+    static std::string defaultEncoder(const Session::SessionMap &data);
+    static bool defaultDecoder(const std::string &str,
+                               Session::SessionMap &data);
+
+  private:
+    nosql::RedisClientPtr client_;
+    std::string keyPrefix_;
+    Encoder encoder_;
+    Decoder decoder_;
+};
+}  // namespace drogon
@@ -0,0 +1,112 @@
+/**
+ *
+ *  @file RequestDeadline.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <trantor/utils/Date.h>
+#include <memory>
+#include <utility>
+
+namespace drogon
+{
+class HttpRequest;
+
+/**
+ * @brief The deadline of the request being handled by the thread.
+ *
+ * The framework makes the deadline of a request (see HttpRequest::deadline())
+ * current while its handler is called, along with the request itself for its
+ * cancellation (see HttpRequest::isCancelled()). The database, redis and HTTP
+ * clients bound the timeouts of the calls made while a deadline is current by
+ * the time left before it, fail them at once when it has passed or the
+ * request is cancelled, and keep the deadline current in their callbacks, so
+ * that the calls made by these callbacks are bounded too.
+ */
+class DROGON_EXPORT RequestDeadline
+{
+  public:
+    /**
+     * @brief Make the deadline the current one of the thread until the scope
+     * ends. A date of 0 microseconds clears it.
+     *
+     * @param request The request whose cancellation is checked, if any.
+     */
+    class DROGON_EXPORT Scope
+    {
+      public:
+        explicit Scope(const trantor::Date &deadline,
+                       std::weak_ptr<HttpRequest> request = {});
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+      private:
+        trantor::Date previousDeadline_;
+        std::weak_ptr<HttpRequest> previousRequest_;
+    };
+
+    /// The deadline that is current in this thread, a date of 0
+    /// microseconds if there is none.
+    static const trantor::Date &current();
+
+    /// True if a deadline or a live request is current in this thread.
+    static bool hasCurrent();
+
+    /// True if the current request of the thread is cancelled.
+    static bool cancelled();
+
+    /**
+     * @brief The timeout of a call made now, in seconds: the smaller of the
+     * timeout and the time left before the current deadline.
+     *
+     * @param timeout The timeout of the client, 0 or a negative number for
+     * none.
+     * @return 0 if there is neither a timeout nor a current deadline, a
+     * negative number if the deadline has passed.
+     */
+    static double clampTimeout(double timeout);
+
+    /// Make the current deadline and request, if any, current while the
+    /// callbacks run.
+    template <typename... Callbacks>
+    static void propagate(Callbacks &...callbacks)
+    {
+        if (!hasCurrent())
+            return;
+        auto deadline = current();
+        auto request = currentRequest();
+        (wrap(deadline, request, callbacks), ...);
+    }
+
+    /// The request being handled by the thread, if any.
+    static std::weak_ptr<HttpRequest> currentRequest();
+
+  private:
+
+    template <typename Callback>
+    static void wrap(const trantor::Date &deadline,
+                     const std::weak_ptr<HttpRequest> &request,
+                     Callback &callback)
+    {
+        if (!callback)
+            return;
+        callback = [deadline, request, cb = std::move(callback)](
+                       const auto &...args) {
+            Scope scope(deadline, request);
+            cb(args...);
+        };
+    }
+};
+}  // namespace drogon
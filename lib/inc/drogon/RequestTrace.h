@@ -0,0 +1,189 @@
+/**
+ *  @file RequestTrace.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+
+#include <drogon/exports.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief The trace of a sampled request.
+ *
+ * The framework records the time every stage of the request starts, and the
+ * database and redis clients record a span for every call made while the
+ * trace is current (see RequestTrace::Scope). The ids are compatible with the
+ * W3C trace context, so the trace continues the one of an incoming
+ * `traceparent` header and can be propagated to other services with
+ * traceParent(). Requests aren't traced unless a trace exporter, such as the
+ * TraceExporter plugin, is enabled.
+ */
+class DROGON_EXPORT RequestTrace
+    : public std::enable_shared_from_this<RequestTrace>
+{
+  public:
+    /// The stages of a request, in the order they are passed.
+    enum class Stage : uint8_t
+    {
+        // The request is parsed.
+        Received = 0,
+        // The session is loaded and the pre-routing advices are passed.
+        Routing,
+        // The request is routed to a handler and its body is received.
+        PostRouting,
+        // The post-routing advices are passed.
+        Middlewares,
+        // The middlewares are passed.
+        PreHandling,
+        // The pre-handling advices are passed, the handler is called.
+        Handling,
+        // The response is received from the handler (or an earlier stage).
+        Response,
+        // The response is rendered and queued for sending.
+        Sent,
+        Count
+    };
+
+    struct Span
+    {
+        std::string name;
+        std::string spanId;
+        // In microseconds since the epoch.
+        int64_t start{0};
+        int64_t end{0};
+        bool error{false};
+        std::vector<std::pair<std::string, std::string>> attributes;
+    };
+
+    /**
+     * @brief Make the trace the current one of the thread until the scope
+     * ends, so that the calls of the database and redis clients are recorded
+     * in it.
+     */
+    class DROGON_EXPORT Scope
+    {
+      public:
+        explicit Scope(std::shared_ptr<RequestTrace> trace);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+      private:
+        std::shared_ptr<RequestTrace> previous_;
+    };
+
+    /**
+     * @brief Create the trace of a request if it is sampled.
+     *
+     * @param traceParent The `traceparent` header of the request. A valid one
+     * decides the sampling instead of the ratio.
+     * @param sampleRatio The ratio of the other requests to sample.
+     * @return nullptr if the request isn't sampled.
+     */
+    static std::shared_ptr<RequestTrace> sample(std::string_view traceParent,
+                                                double sampleRatio);
+
+    /// The trace that is current in this thread, if any.
+    static const std::shared_ptr<RequestTrace> &current();
+
+    /// The 32 hex digits id of the trace.
+    const std::string &traceId() const
+    {
+        return traceId_;
+    }
+
+    /// The 16 hex digits id of the span of the request.
+    const std::string &spanId() const
+    {
+        return spanId_;
+    }
+
+    /// The id of the span of the caller, empty if the trace starts here.
+    const std::string &parentSpanId() const
+    {
+        return parentSpanId_;
+    }
+
+    /// The `traceparent` header to add to the requests sent to other services.
+    std::string traceParent() const;
+
+    void mark(Stage stage)
+    {
+        timestamps_[(size_t)stage] = now();
+    }
+
+    /// The time the stage started in microseconds since the epoch, 0 if the
+    /// request didn't reach it.
+    int64_t timestamp(Stage stage) const
+    {
+        return timestamps_[(size_t)stage];
+    }
+
+    /// The name of the span from the start of the stage to the start of the
+    /// next stage the request reached.
+    static const char *stageName(Stage stage);
+
+    /// Create a span starting now, record it with endSpan() when it finishes.
+    Span startSpan(std::string name) const;
+
+    void endSpan(Span &&span);
+
+    /**
+     * @brief Record a span when one of the callbacks of an asynchronous call
+     * is called. The error flag is set if it is the exception callback.
+     */
+    template <typename ResultCallback, typename ExceptionCallback>
+    void traceCallbacks(Span &&span,
+                        ResultCallback &resultCallback,
+                        ExceptionCallback &exceptionCallback)
+    {
+        auto spanPtr = std::make_shared<Span>(std::move(span));
+        auto thisPtr = shared_from_this();
+        resultCallback = [thisPtr, spanPtr, cb = std::move(resultCallback)](
+                             const auto &result) {
+            thisPtr->endSpan(std::move(*spanPtr));
+            cb(result);
+        };
+        exceptionCallback = [thisPtr,
+                             spanPtr,
+                             cb = std::move(exceptionCallback)](
+                                const auto &exception) {
+            spanPtr->error = true;
+            thisPtr->endSpan(std::move(*spanPtr));
+            cb(exception);
+        };
+    }
+
+    /// The spans recorded so far.
+    std::vector<Span> spans() const;
+
+    static int64_t now();
+
+  private:
+    std::string traceId_;
+    std::string spanId_;
+    std::string parentSpanId_;
+    std::array<int64_t, (size_t)Stage::Count> timestamps_{};
+    mutable std::mutex mutex_;
+    std::vector<Span> spans_;
+};
+
+using RequestTracePtr = std::shared_ptr<RequestTrace>;
+}  // namespace drogon
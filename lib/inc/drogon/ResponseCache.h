@@ -0,0 +1,109 @@
+/**
+ *
+ *  @file ResponseCache.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/HttpMiddleware.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief A middleware caching the responses of the GET and HEAD requests.
+ *
+ * A response is cached when its Cache-Control header has a max-age or
+ * s-maxage directive and none of no-store, no-cache and private, its status
+ * is cacheable by default (e.g. 200 or 404) and it has no Set-Cookie header.
+ * Responses are keyed by the method, the path, the query and the request
+ * headers named by their Vary header. The cached responses share their body
+ * and are sent without calling the handler, with an Age header.
+ *
+ * When the response has a stale-while-revalidate directive, it is still sent
+ * for this number of seconds after its expiry while the handler is called
+ * once in the background to refresh it.
+ *
+ * The requests with a Cache-Control: no-cache header bypass the cache. Use
+ * the name "drogon::ResponseCache" to add it to handlers, and
+ * DrClassMap::getSingleInstance<ResponseCache>() to configure it.
+ */
+class DROGON_EXPORT ResponseCache : public HttpMiddleware<ResponseCache>
+{
+  public:
+    ResponseCache() = default;
+
+    void invoke(const HttpRequestPtr &req,
+                MiddlewareNextCallback &&nextCb,
+                MiddlewareCallback &&mcb) override;
+
+    /// The maximum number of cached responses, 10000 by default. The least
+    /// recently used ones are dropped first.
+    void setMaxEntries(size_t maxEntries)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxEntries_ = maxEntries;
+    }
+
+    /// The responses with a larger body are not cached, 1MB by default.
+    void setMaxBodySize(size_t maxBodySize)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxBodySize_ = maxBodySize;
+    }
+
+    /// Drop all the cached responses.
+    void clear();
+
+    /// Drop the cached responses of the path, for all the methods, queries
+    /// and varying headers.
+    void erase(std::string_view path);
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+  private:
+    struct Entry
+    {
+        std::string key;
+        HttpResponsePtr response;
+        double storedAt;
+        double maxAge;
+        double staleWhileRevalidate;
+        bool refreshing{false};
+    };
+    using EntryList = std::list<Entry>;
+
+    std::string makeKey(const HttpRequestPtr &req,
+                        const std::vector<std::string> &varyHeaders) const;
+    void store(const HttpRequestPtr &req, const HttpResponsePtr &resp);
+
+    mutable std::mutex mutex_;
+    size_t maxEntries_{10000};
+    size_t maxBodySize_{1024 * 1024};
+    // The most recently used entries first.
+    EntryList entries_;
+    std::unordered_map<std::string_view, EntryList::iterator> entriesMap_;
+    // The request headers named by the Vary header of the last response of
+    // each method, path and query.
+    std::unordered_map<std::string, std::vector<std::string>> varyHeaders_;
+};
+}  // namespace drogon
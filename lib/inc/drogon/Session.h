@@ -114,6 +114,7 @@ class Session
             if (typeid(T) == it->second.type())
             {
                 handler(*(std::any_cast<T>(&(it->second))));
+                dirty_ = true;
             }
             else
             {
@@ -125,6 +126,7 @@ class Session
             auto item = T();
             handler(item);
             sessionMap_.insert(std::make_pair(key, std::any(std::move(item))));
+            dirty_ = true;
         }
     }
 
@@ -142,6 +144,7 @@ class Session
     {
         std::lock_guard<std::mutex> lck(mutex_);
         handler(sessionMap_);
+        dirty_ = true;
     }
 
     /**
@@ -156,6 +159,7 @@ class Session
     {
         std::lock_guard<std::mutex> lck(mutex_);
         sessionMap_.insert(std::make_pair(key, obj));
+        dirty_ = true;
     }
 
     /**
@@ -170,6 +174,7 @@ class Session
     {
         std::lock_guard<std::mutex> lck(mutex_);
         sessionMap_.insert(std::make_pair(key, std::move(obj)));
+        dirty_ = true;
     }
 
     /**
@@ -179,6 +184,7 @@ class Session
     {
         std::lock_guard<std::mutex> lck(mutex_);
         sessionMap_.erase(key);
+        dirty_ = true;
     }
 
     /**
@@ -201,6 +207,7 @@ class Session
     {
         std::lock_guard<std::mutex> lck(mutex_);
         sessionMap_.clear();
+        dirty_ = true;
     }
 
     /**
@@ -231,6 +238,8 @@ class Session
     std::string sessionId_;
     bool needToSet_{false};
     bool needToChange_{false};
+    // Set when the data is changed, used by session stores
+    bool dirty_{false};
     friend class SessionManager;
     friend class HttpAppFrameworkImpl;
 
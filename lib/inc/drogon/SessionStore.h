@@ -0,0 +1,72 @@
+/**
+ *
+ *  @file SessionStore.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/Session.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief The interface of the external storage of sessions, which lets
+ * several application nodes share their sessions.
+ *
+ * When a store is set by the HttpAppFramework::setSessionStore() method,
+ * sessions are cached locally for a short time, sessions missing from the
+ * local cache are loaded from the store, and changed sessions are written
+ * back to the store in batches. All the methods are called in the main loop
+ * of the application or in the IO loops, so they must not block.
+ */
+class DROGON_EXPORT SessionStore
+{
+  public:
+    /**
+     * @brief The callback of the load() method, the found parameter is false
+     * if the session doesn't exist in the store or can't be loaded.
+     */
+    using LoadCallback =
+        std::function<void(bool found, Session::SessionMap &&data)>;
+    using SessionData = std::pair<std::string, Session::SessionMap>;
+
+    /// Load the data of a session, the callback can be called in any thread.
+    virtual void load(const std::string &sessionId,
+                      LoadCallback &&callback) = 0;
+
+    /**
+     * @brief Save the data of the changed sessions.
+     *
+     * @param sessions The IDs and the data of the sessions.
+     * @param timeout The sessions expire after not being accessed for the
+     * timeout seconds, 0 means they never expire.
+     */
+    virtual void save(std::vector<SessionData> &&sessions, size_t timeout) = 0;
+
+    /// Postpone the expiration of the accessed but unchanged sessions.
+    virtual void touch(std::vector<std::string> &&sessionIds,
+                       size_t timeout) = 0;
+
+    /// Remove a session from the store.
+    virtual void erase(const std::string &sessionId) = 0;
+
+    virtual ~SessionStore() = default;
+};
+
+using SessionStorePtr = std::shared_ptr<SessionStore>;
+}  // namespace drogon
@@ -0,0 +1,437 @@
+/**
+ *
+ *  @file ShardedCacheMap.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/CacheMap.h>
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/NonCopyable.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief A cache map which distributes its keys over several shards.
+ *
+ * Every shard has its own mutex and its own timing wheels (see CacheMap), so
+ * accesses to keys in different shards don't contend with each other. The
+ * interface is the same as the one of CacheMap.
+ *
+ * Optionally, the number of entries can be bounded, the least recently used
+ * entries are evicted from a shard when it's full. Evicted entries are
+ * treated as erased, the erase function is called but the timeout callbacks
+ * are not.
+ *
+ * @tparam T1 The keyword type.
+ * @tparam T2 The value type.
+ * @tparam Hash The hash function of the keyword type.
+ */
+template <typename T1, typename T2, typename Hash = std::hash<T1>>
+class ShardedCacheMap : public trantor::NonCopyable
+{
+  public:
+    /// constructor
+    /**
+     * @param loop
+     * eventloop pointer
+     * @param tickInterval
+     * second
+     * @param wheelsNum
+     * number of wheels
+     * @param bucketsNumPerWheel
+     * buckets number per wheel
+     * @param fnOnInsert
+     * function to execute on insertion
+     * @param fnOnErase
+     * function to execute on erase
+     * @param maxEntries
+     * the max number of entries, 0 means no limit. Every shard holds at most
+     * maxEntries/shardsNum entries (rounded up).
+     * @param shardsNum
+     * number of shards
+     */
+    ShardedCacheMap(trantor::EventLoop *loop,
+                    float tickInterval = TICK_INTERVAL,
+                    size_t wheelsNum = WHEELS_NUM,
+                    size_t bucketsNumPerWheel = BUCKET_NUM_PER_WHEEL,
+                    std::function<void(const T1 &)> fnOnInsert = nullptr,
+                    std::function<void(const T1 &)> fnOnErase = nullptr,
+                    size_t maxEntries = 0,
+                    size_t shardsNum = 16)
+        : loop_(loop),
+          noWheels_(tickInterval <= 0 || wheelsNum == 0 ||
+                    bucketsNumPerWheel == 0),
+          fnOnInsert_(std::move(fnOnInsert)),
+          fnOnErase_(std::move(fnOnErase))
+    {
+        if (shardsNum == 0)
+            shardsNum = 1;
+        maxEntriesPerShard_ = (maxEntries + shardsNum - 1) / shardsNum;
+        shards_.reserve(shardsNum);
+        for (size_t i = 0; i < shardsNum; ++i)
+        {
+            shards_.push_back(std::make_unique<Shard>(loop,
+                                                      tickInterval,
+                                                      wheelsNum,
+                                                      bucketsNumPerWheel));
+        }
+    }
+
+    ~ShardedCacheMap()
+    {
+        // Clear the maps before the wheels are destroyed, so the timeout
+        // callbacks find nothing to erase.
+        for (auto &shard : shards_)
+        {
+            std::lock_guard<std::mutex> lock(shard->mtx);
+            shard->map.clear();
+            shard->lru.clear();
+        }
+        shards_.clear();
+    }
+
+    /**
+     * @brief Insert a key-value pair into the cache, the old value of the key
+     * is replaced.
+     *
+     * @param key The key
+     * @param value The value
+     * @param timeout The timeout in seconds, if timeout > 0, the value will be
+     * erased within the 'timeout' seconds after the last access. If the timeout
+     * is zero, the value exists until being removed explicitly.
+     * @param timeoutCallback is called when the timeout expires.
+     */
+    void insert(const T1 &key,
+                T2 &&value,
+                size_t timeout = 0,
+                std::function<void()> timeoutCallback = std::function<void()>())
+    {
+        insertValue(key,
+                    std::move(value),
+                    timeout,
+                    std::move(timeoutCallback));
+    }
+
+    void insert(const T1 &key,
+                const T2 &value,
+                size_t timeout = 0,
+                std::function<void()> timeoutCallback = std::function<void()>())
+    {
+        insertValue(key, value, timeout, std::move(timeoutCallback));
+    }
+
+    /**
+     * @brief Return a copy of the value of the keyword, a default T2 type
+     * value is returned if the data is not found.
+     */
+    T2 operator[](const T1 &key)
+    {
+        auto &shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto iter = shard.map.find(key);
+        if (iter != shard.map.end())
+        {
+            touch(shard, iter);
+            return iter->second.value_;
+        }
+        return T2();
+    }
+
+    /**
+     * @brief Modify or visit the data identified by the key parameter.
+     *
+     * @note If the data identified by the key doesn't exist, a new one is
+     * created and passed to the handler and stored in the cache with the
+     * timeout parameter. The handler is called with the mutex of the shard
+     * locked.
+     */
+    template <typename Callable>
+    void modify(const T1 &key, Callable &&handler, size_t timeout = 0)
+    {
+        std::vector<T1> evictedKeys;
+        auto &shard = shardOf(key);
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            auto iter = shard.map.find(key);
+            if (iter != shard.map.end())
+            {
+                handler(iter->second.value_);
+                touch(shard, iter);
+                return;
+            }
+            iter = shard.map.emplace(key, MapValue()).first;
+            iter->second.timeout_ = timeout;
+            handler(iter->second.value_);
+            addNode(shard, iter, evictedKeys);
+        }
+        if (fnOnInsert_)
+            fnOnInsert_(key);
+        onEvicted(evictedKeys);
+    }
+
+    /// Check if the value of the keyword exists
+    bool find(const T1 &key)
+    {
+        auto &shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto iter = shard.map.find(key);
+        if (iter == shard.map.end())
+            return false;
+        touch(shard, iter);
+        return true;
+    }
+
+    /// Atomically find and get the value of a keyword
+    /**
+     * Return true when the value is found, and the value
+     * is assigned to the value argument.
+     */
+    bool findAndFetch(const T1 &key, T2 &value)
+    {
+        auto &shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto iter = shard.map.find(key);
+        if (iter == shard.map.end())
+            return false;
+        touch(shard, iter);
+        value = iter->second.value_;
+        return true;
+    }
+
+    /// Erase the value of the keyword.
+    /**
+     * @param key the keyword.
+     * @note This function does not cause the timeout callback to be executed.
+     */
+    void erase(const T1 &key)
+    {
+        {
+            auto &shard = shardOf(key);
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            auto iter = shard.map.find(key);
+            if (iter != shard.map.end())
+                removeNode(shard, iter);
+        }
+        if (fnOnErase_)
+            fnOnErase_(key);
+    }
+
+    /// Return the number of entries in the cache.
+    size_t size() const
+    {
+        size_t total{0};
+        for (auto &shard : shards_)
+        {
+            std::lock_guard<std::mutex> lock(shard->mtx);
+            total += shard->map.size();
+        }
+        return total;
+    }
+
+    /**
+     * @brief Get the event loop object
+     *
+     * @return trantor::EventLoop*
+     */
+    trantor::EventLoop *getLoop()
+    {
+        return loop_;
+    }
+
+    /**
+     * @brief run the task function after a period of time, see
+     * CacheMap::runAfter().
+     */
+    void runAfter(size_t delay, std::function<void()> &&task)
+    {
+        shards_[0]->wheels.runAfter(delay, std::move(task));
+    }
+
+    void runAfter(size_t delay, const std::function<void()> &task)
+    {
+        shards_[0]->wheels.runAfter(delay, task);
+    }
+
+  private:
+    struct MapValue
+    {
+        T2 value_;
+        size_t timeout_{0};
+        std::function<void()> timeoutCallback_;
+        WeakCallbackEntryPtr weakEntryPtr_;
+        // The position in the LRU list, only used when the size is limited
+        typename std::list<T1>::iterator lruIter_;
+    };
+
+    using Map = std::unordered_map<T1, MapValue, Hash>;
+
+    struct Shard
+    {
+        Shard(trantor::EventLoop *loop,
+              float tickInterval,
+              size_t wheelsNum,
+              size_t bucketsNumPerWheel)
+            : wheels(loop, tickInterval, wheelsNum, bucketsNumPerWheel)
+        {
+        }
+
+        mutable std::mutex mtx;
+        Map map;
+        // The most recently used keys are in the front
+        std::list<T1> lru;
+        // Only the timing wheels of the cache map are used. It's declared
+        // last to be destroyed first, the callbacks of its entries access the
+        // members above.
+        CacheMap<T1, char> wheels;
+    };
+
+    trantor::EventLoop *loop_;
+    bool noWheels_;
+    size_t maxEntriesPerShard_{0};
+    std::function<void(const T1 &)> fnOnInsert_;
+    std::function<void(const T1 &)> fnOnErase_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    Shard &shardOf(const T1 &key)
+    {
+        return *shards_[Hash{}(key) % shards_.size()];
+    }
+
+    template <typename V>
+    void insertValue(const T1 &key,
+                     V &&value,
+                     size_t timeout,
+                     std::function<void()> &&timeoutCallback)
+    {
+        std::vector<T1> evictedKeys;
+        auto &shard = shardOf(key);
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            auto iter = shard.map.find(key);
+            bool existing = (iter != shard.map.end());
+            if (!existing)
+                iter = shard.map.emplace(key, MapValue()).first;
+            auto &mapValue = iter->second;
+            mapValue.value_ = std::forward<V>(value);
+            mapValue.timeout_ = timeout;
+            mapValue.timeoutCallback_ = std::move(timeoutCallback);
+            if (existing)
+                touch(shard, iter);
+            else
+                addNode(shard, iter, evictedKeys);
+        }
+        if (fnOnInsert_)
+            fnOnInsert_(key);
+        onEvicted(evictedKeys);
+    }
+
+    // The methods below are called with the mutex of the shard locked
+    void addNode(Shard &shard,
+                 typename Map::iterator iter,
+                 std::vector<T1> &evictedKeys)
+    {
+        if (maxEntriesPerShard_ > 0)
+        {
+            shard.lru.push_front(iter->first);
+            iter->second.lruIter_ = shard.lru.begin();
+        }
+        if (iter->second.timeout_ > 0)
+            eraseAfter(shard, iter);
+        while (maxEntriesPerShard_ > 0 &&
+               shard.map.size() > maxEntriesPerShard_)
+        {
+            evictedKeys.push_back(shard.lru.back());
+            removeNode(shard, shard.map.find(shard.lru.back()));
+        }
+    }
+
+    void touch(Shard &shard, typename Map::iterator iter)
+    {
+        if (maxEntriesPerShard_ > 0)
+        {
+            shard.lru.splice(shard.lru.begin(),
+                             shard.lru,
+                             iter->second.lruIter_);
+        }
+        if (iter->second.timeout_ > 0)
+            eraseAfter(shard, iter);
+    }
+
+    void removeNode(Shard &shard, typename Map::iterator iter)
+    {
+        if (maxEntriesPerShard_ > 0)
+            shard.lru.erase(iter->second.lruIter_);
+        shard.map.erase(iter);
+    }
+
+    void eraseAfter(Shard &shard, typename Map::iterator iter)
+    {
+        // Entries are never released with the mutex locked if there are no
+        // wheels to keep them.
+        if (noWheels_)
+            return;
+        auto entryPtr = iter->second.weakEntryPtr_.lock();
+        if (!entryPtr)
+        {
+            entryPtr = std::make_shared<CallbackEntry>(
+                [this, shardPtr = &shard, key = iter->first]() {
+                    onTimeout(*shardPtr, key);
+                });
+            iter->second.weakEntryPtr_ = entryPtr;
+        }
+        shard.wheels.scheduleEntry(iter->second.timeout_, std::move(entryPtr));
+    }
+
+    void onTimeout(Shard &shard, const T1 &key)
+    {
+        bool erased{false};
+        std::function<void()> timeoutCallback;
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            auto iter = shard.map.find(key);
+            if (iter != shard.map.end())
+            {
+                auto &value = iter->second;
+                // The value may be replaced by a new one with another entry
+                if (value.timeout_ > 0 && !value.weakEntryPtr_.lock())
+                {
+                    erased = true;
+                    timeoutCallback = std::move(value.timeoutCallback_);
+                    removeNode(shard, iter);
+                }
+            }
+        }
+        if (erased && fnOnErase_)
+            fnOnErase_(key);
+        if (erased && timeoutCallback)
+            timeoutCallback();
+    }
+
+    void onEvicted(const std::vector<T1> &evictedKeys)
+    {
+        if (!fnOnErase_)
+            return;
+        for (auto &key : evictedKeys)
+        {
+            fnOnErase_(key);
+        }
+    }
+};
+
+}  // namespace drogon
@@ -0,0 +1,150 @@
+/**
+ *
+ *  @file SharedMemoryCache.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <trantor/utils/NonCopyable.h>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace drogon
+{
+/**
+ * @brief A cache of string values in a named shared memory segment, shared
+ * by all the processes of the host which open it, e.g. the processes of an
+ * application started several times with the reuse_port option, which then
+ * keep one copy of the values and see the values cached by each other.
+ *
+ * The segment holds a hash table of buckets of 8 entries and the memory of
+ * the keys and values, allocated in slabs: every page of the memory is
+ * given to a size class (64 bytes, 128 bytes, ... up to the page size) and
+ * divided into chunks of this size. When a bucket or the memory of a size
+ * class is full, an entry is evicted, the ones expiring first in a bucket.
+ *
+ * The lookups take no lock, they copy the value and check that the entry
+ * wasn't changed meanwhile (a seqlock). The changes are made under a lock
+ * in the segment, so the cache fits the values read far more often than
+ * written. A process dying while holding the lock doesn't block the other
+ * ones, the lock is taken back from it.
+ *
+ * @code
+   static drogon::SharedMemoryCache cache("myapp_cache");
+   if (auto value = cache.find(key))
+       ...
+   else
+       cache.insert(key, makeValue(), 60);
+   @endcode
+ *
+ * @note The segment is created by the first process opening it, with its
+ * options, and kept after the processes exit, so it stays warm across the
+ * restarts; remove() deletes it. The values expire a fixed time after they
+ * are inserted, not after their last access as in CacheMap. Objects of this
+ * class are thread-safe. Shared memory segments are not supported on
+ * Windows, the constructor throws there.
+ */
+class DROGON_EXPORT SharedMemoryCache : public trantor::NonCopyable
+{
+  public:
+    struct Options
+    {
+        /// The number of bytes of the memory of the keys and values.
+        size_t memorySize{64 * 1024 * 1024};
+        /// The maximum number of entries.
+        size_t maxEntries{65536};
+        /// The size of the pages given to the size classes, rounded up to a
+        /// power of 2, a key and its value larger than it are not cached.
+        size_t pageSize{1024 * 1024};
+    };
+
+    /**
+     * @brief Open the segment of the name, or create it.
+     *
+     * @param name The name of the segment, a short identifier.
+     * @note std::runtime_error is thrown if the segment can't be opened or
+     * is not a segment of this cache.
+     */
+    explicit SharedMemoryCache(const std::string &name);
+    SharedMemoryCache(const std::string &name, const Options &options);
+    ~SharedMemoryCache();
+
+    /**
+     * @brief Insert the value of the key, or replace it.
+     *
+     * @param timeout The number of seconds the value is kept, if it's 0,
+     * the value exists until being removed or evicted.
+     * @return false if the key and the value are larger than the page size
+     * or no memory can be freed for them.
+     */
+    bool insert(std::string_view key,
+                std::string_view value,
+                double timeout = 0);
+
+    /// The value of the key, std::nullopt if it isn't cached.
+    std::optional<std::string> find(std::string_view key) const;
+
+    /**
+     * @brief Find and get the value of the key. Return true when the value
+     * is found, and the value is assigned to the value argument.
+     */
+    bool findAndFetch(std::string_view key, std::string &value) const;
+
+    /// Erase the value of the key, return false if it isn't cached.
+    bool erase(std::string_view key);
+
+    /// Erase all the values.
+    void clear();
+
+    /// The number of values, including the expired ones not evicted yet.
+    size_t size() const;
+
+    /// The options of the segment, set by the process which created it.
+    const Options &options() const
+    {
+        return options_;
+    }
+
+    /// Delete the segment of the name, the processes which opened it keep
+    /// using it until they close it.
+    static void remove(const std::string &name);
+
+  private:
+    struct Header;
+    struct Entry;
+
+    Entry *entryAt(size_t index) const;
+    size_t bucketOf(uint64_t hash) const;
+    bool readEntry(const Entry &entry,
+                   uint64_t hash,
+                   std::string_view key,
+                   std::string *value) const;
+    bool matchesKey(const Entry &entry,
+                    uint64_t hash,
+                    std::string_view key) const;
+    void lock();
+    void unlock();
+    void recoverAfterDeadWriter();
+    bool allocate(uint32_t sizeClass, size_t keep, uint64_t &offset);
+    void freeChunk(uint32_t sizeClass, uint64_t offset);
+    void clearEntry(Entry &entry);
+
+    Options options_;
+    Header *header_{nullptr};
+    char *segment_{nullptr};
+    size_t segmentSize_{0};
+};
+}  // namespace drogon
@@ -0,0 +1,118 @@
+/**
+ *
+ *  @file SseBroadcaster.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/NonCopyable.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace drogon
+{
+/**
+ * @brief A channel of Server-Sent Events, broadcast to all the clients
+ * connected to it.
+ *
+ * A broadcast event is formatted and framed once, and the chunk is shared by
+ * all the streams. The streams are kept by the IO loops they belong to, so
+ * one task is queued in every loop for each event, like in
+ * WebSocketConnectionGroup. The last events are kept to be sent again to the
+ * clients reconnecting with a Last-Event-ID header, and a comment is sent
+ * periodically to keep the idle connections alive.
+ *
+ * For example:
+ * @code
+   SseBroadcaster quotes_;
+   void QuoteController::subscribe(
+       const HttpRequestPtr &req,
+       std::function<void(const HttpResponsePtr &)> &&callback)
+   {
+       callback(quotes_.newResponse(req));
+   }
+   ...
+   quotes_.broadcast(R"({"price":42})", "quote");
+   @endcode
+ *
+ * @note All the methods are thread safe. The streams whose client is gone
+ * are removed automatically.
+ */
+class DROGON_EXPORT SseBroadcaster : public trantor::NonCopyable
+{
+  public:
+    struct Options
+    {
+        /// The number of events kept for the reconnecting clients, 0 to
+        /// keep none.
+        size_t replayEvents{1000};
+        /// The number of seconds between the heartbeat comments, 0 to send
+        /// none.
+        double heartbeatInterval{15.0};
+        /// The reconnection time in milliseconds sent to the clients, 0 to
+        /// let them use their default.
+        size_t retry{0};
+    };
+
+    SseBroadcaster();
+    explicit SseBroadcaster(const Options &options);
+    ~SseBroadcaster();
+
+    /**
+     * @brief Create the response of a client joining the channel. The events
+     * after the one identified by the Last-Event-ID header of the request are
+     * sent first, all the events kept if that one isn't kept any more.
+     */
+    HttpResponsePtr newResponse(const HttpRequestPtr &req);
+
+    /**
+     * @brief Add a stream made by HttpResponse::newSseResponse() to the
+     * channel, in the IO loop of its connection.
+     *
+     * @param lastEventId The ID of the last event received by the client,
+     * empty if it's a new client.
+     */
+    void add(SseStreamPtr stream, const std::string &lastEventId = {});
+
+    /**
+     * @brief Send the event to all the streams of the channel.
+     *
+     * @return The ID of the event, the sequence number of the event if the
+     * id is empty.
+     */
+    std::string broadcast(std::string_view data,
+                          std::string_view event = {},
+                          std::string_view id = {});
+
+    /// Return the number of streams in the channel
+    size_t size() const;
+
+    const Options &options() const
+    {
+        return options_;
+    }
+
+  private:
+    struct LoopStreams;
+    struct State;
+
+    Options options_;
+    std::shared_ptr<State> state_;
+    trantor::TimerId heartbeatTimerId_{trantor::InvalidTimerId};
+};
+}  // namespace drogon
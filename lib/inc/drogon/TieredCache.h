@@ -0,0 +1,232 @@
+/**
+ *
+ *  @file TieredCache.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/ShardedCacheMap.h>
+#include <drogon/nosql/RedisClient.h>
+#include <drogon/utils/SingleFlight.h>
+#include <trantor/utils/NonCopyable.h>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#ifdef __cpp_impl_coroutine
+#include <drogon/utils/coroutine.h>
+#endif
+
+namespace drogon
+{
+/**
+ * @brief A cache of string values with two tiers: a bounded in-process map
+ * (sharded, see ShardedCacheMap) in front of redis, which is shared by all
+ * the nodes of the application.
+ *
+ * get() looks the key up in the local map, then in redis, and calls the
+ * loader of the value (e.g. a database query) only if neither has it. The
+ * concurrent lookups of a key missing from the local map are merged, so one
+ * loader call (or redis query) serves all of them. The value found by the
+ * loader is stored in both tiers, a missing value (std::nullopt) is cached
+ * too for a shorter time, so the lookups of keys which don't exist don't
+ * reach the loader each. The TTLs are extended by a random part, the values
+ * cached at the same time don't expire together.
+ *
+ * @code
+   auto cache = std::make_shared<TieredCache>(app().getRedisClient());
+   cache->get(
+       "user:" + id,
+       [id](auto &&done, auto &&fail) {
+           // Load the value, then call done(value) or done(std::nullopt) if
+           // there is none, or fail(exception).
+       },
+       [callback](const TieredCache::Value &value) { ... },
+       [callback](const std::exception_ptr &e) { ... });
+   @endcode
+ *
+ * @note Objects of this class must be created by std::make_shared, they are
+ * thread-safe. The callbacks of a local hit are called before get() returns,
+ * the other ones in the thread which found the value, e.g. the one of the
+ * redis client. The client may be nullptr to use the local tier only.
+ * Changing a value with set() or erase() only updates the local tier of the
+ * node doing it, the other nodes see the change when their local copy
+ * expires (or when eraseLocal() is called by them, e.g. on a notification).
+ */
+class DROGON_EXPORT TieredCache
+    : public trantor::NonCopyable,
+      public std::enable_shared_from_this<TieredCache>
+{
+  public:
+    struct Options
+    {
+        /// The maximum number of values in the local tier, the least
+        /// recently used ones are evicted. 0 means no limit.
+        size_t maxLocalEntries{10000};
+        /// The number of shards of the local tier.
+        size_t localShards{16};
+        /// The number of seconds a value is kept in the local tier, 0
+        /// disables the local tier.
+        double localTtl{5.0};
+        /// The number of seconds a value is kept in redis.
+        double ttl{300.0};
+        /// The number of seconds a missing value is cached in both tiers, 0
+        /// disables the negative caching.
+        double negativeTtl{30.0};
+        /// The TTLs are extended by a random part of up to this fraction of
+        /// them.
+        double ttlJitter{0.1};
+        /// The prefix of the redis keys.
+        std::string keyPrefix;
+    };
+
+    /// The cached value, std::nullopt if the loader found none.
+    using Value = std::optional<std::string>;
+    using ValueCallback = std::function<void(const Value &)>;
+    using ExceptionCallback = std::function<void(const std::exception_ptr &)>;
+    /// A loader calls one of the callbacks once, the exceptions aren't
+    /// cached.
+    using Loader =
+        std::function<void(ValueCallback &&done, ExceptionCallback &&fail)>;
+
+    explicit TieredCache(nosql::RedisClientPtr client);
+    TieredCache(nosql::RedisClientPtr client, const Options &options);
+
+    /**
+     * @brief Get the value of the key, loaded by the loader if it's in
+     * neither tier.
+     *
+     * The redis errors are handled as misses, the loader is called instead.
+     */
+    void get(const std::string &key,
+             Loader loader,
+             ValueCallback callback,
+             ExceptionCallback exceptionCallback);
+
+#ifdef __cpp_impl_coroutine
+    /// The coroutine version of get(), the exceptions of the loader are
+    /// thrown.
+    Task<Value> getCoro(std::string key, std::function<Task<Value>()> loader);
+#endif
+
+    /// Store the value in both tiers, e.g. after the data it's built from is
+    /// changed.
+    void set(const std::string &key, std::string value);
+
+    /// Remove the value from both tiers.
+    void erase(const std::string &key);
+
+    /// Remove the value from the local tier only.
+    void eraseLocal(const std::string &key);
+
+    /// The number of values in the local tier, including the expired ones
+    /// not evicted yet.
+    size_t localSize() const
+    {
+        return local_ ? local_->size() : 0;
+    }
+
+    const Options &options() const
+    {
+        return options_;
+    }
+
+    /// The string stored in redis for a value.
+    static std::string encode(const Value &value);
+
+    /// Decode the string stored in redis, return false if it's not a value
+    /// encoded by encode().
+    static bool decode(const std::string &str, Value &value);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct LocalEntry
+    {
+        Value value;
+        Clock::time_point expiry;
+    };
+
+    using LocalEntryPtr = std::shared_ptr<const LocalEntry>;
+    using ValuePtr = std::shared_ptr<const Value>;
+    using Flights = SingleFlight<ValuePtr, std::exception_ptr>;
+
+    void fetch(const std::string &key,
+               Loader &&loader,
+               Flights::Callback &&done);
+    void load(const std::string &key,
+              Loader &&loader,
+              Flights::Callback &&done);
+    void store(const std::string &key, const Value &value);
+    void storeLocal(const std::string &key, const Value &value);
+    double jitter(double ttl) const;
+
+    nosql::RedisClientPtr client_;
+    Options options_;
+    std::unique_ptr<ShardedCacheMap<std::string, LocalEntryPtr>> local_;
+    Flights flights_;
+};
+
+using TieredCachePtr = std::shared_ptr<TieredCache>;
+
+#ifdef __cpp_impl_coroutine
+namespace internal
+{
+struct TieredCacheAwaiter : public CallbackAwaiter<TieredCache::Value>
+{
+    TieredCacheAwaiter(TieredCache *cache,
+                       std::string key,
+                       TieredCache::Loader loader)
+        : cache_(cache), key_(std::move(key)), loader_(std::move(loader))
+    {
+    }
+
+    void await_suspend(std::coroutine_handle<> handle);
+
+  private:
+    TieredCache *cache_;
+    std::string key_;
+    TieredCache::Loader loader_;
+};
+}  // namespace internal
+
+inline Task<TieredCache::Value> TieredCache::getCoro(
+    std::string key,
+    std::function<Task<Value>()> loader)
+{
+    co_return co_await internal::TieredCacheAwaiter(
+        this,
+        std::move(key),
+        [loader = std::move(loader)](ValueCallback &&done,
+                                     ExceptionCallback &&fail) {
+            [](std::function<Task<Value>()> loader,
+               ValueCallback done,
+               ExceptionCallback fail) -> AsyncTask {
+                Value value;
+                try
+                {
+                    value = co_await loader();
+                }
+                catch (...)
+                {
+                    fail(std::current_exception());
+                    co_return;
+                }
+                done(value);
+            }(loader, std::move(done), std::move(fail));
+        });
+}
+#endif
+}  // namespace drogon
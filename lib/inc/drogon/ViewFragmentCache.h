@@ -0,0 +1,59 @@
+/**
+ *
+ *  @file ViewFragmentCache.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace drogon
+{
+/**
+ * @brief The rendered fragments of a view, shared by all the requests.
+ *
+ * The views created by drogon_ctl keep one for their <%cache key ttl%>
+ * blocks, the text between the tag and <%endcache%> is rendered once per key
+ * and appended from the cache until it expires. The keys should come from a
+ * bounded set of values, the entries are only replaced when they expire.
+ */
+class DROGON_EXPORT ViewFragmentCache
+{
+  public:
+    /// Append the fragment of the key to the output, return false if there
+    /// is none or it has expired.
+    bool appendTo(const std::string &key, std::string &output) const;
+
+    /// Cache the fragment for ttl seconds, forever if ttl is 0 or negative.
+    void store(std::string key, std::string fragment, double ttl);
+
+    void clear();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::shared_ptr<const std::string> fragment;
+        Clock::time_point expiry;
+        bool expires{false};
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+}  // namespace drogon
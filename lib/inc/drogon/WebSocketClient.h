@@ -115,6 +115,13 @@ class DROGON_EXPORT WebSocketClient
         const std::vector<std::pair<std::string, std::string>>
             &sslConfCmds) = 0;
 
+    /**
+     * @brief Offer the permessage-deflate extension (RFC 7692) to the server,
+     * the messages are compressed if the server accepts it. It must be called
+     * before connecting to the server.
+     */
+    virtual void enableCompression(bool enable = true) = 0;
+
 #ifdef __cpp_impl_coroutine
     /**
      * @brief Set messages handler. When a message is received from the server,
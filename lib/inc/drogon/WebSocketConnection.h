@@ -15,6 +15,7 @@
 #pragma once
 
 #include <json/value.h>
+#include <functional>
 #include <memory>
 #include <string>
 #include <drogon/HttpTypes.h>
@@ -228,6 +229,65 @@ class WebSocketConnection
      */
     virtual void disablePing() = 0;
 
+    /**
+     * @brief Bound the output queued in the connection for a slow peer.
+     *
+     * @param highWaterMark The number of bytes queued above which the policy
+     * applies.
+     * @param policy Drop the messages or close the connection above the mark,
+     * or only call the callback to pause the producer, see
+     * BackpressurePolicy. The control frames are never dropped.
+     * @param callback Called in the IO loop of the connection with false when
+     * the queue exceeds the mark, and with true when it has been sent, e.g.
+     * to stop and resume a broadcast. The low water mark is the empty queue.
+     * @note Call it before sending messages in other threads, such as when
+     * the connection is established.
+     */
+    virtual void setBackpressure(
+        size_t highWaterMark,
+        BackpressurePolicy policy,
+        std::function<void(bool writable)> callback = nullptr) = 0;
+
+    /// Return false while the output queued exceeds the high water mark set
+    /// by the above method.
+    virtual bool writable() const = 0;
+
+    using MessageViewHandler =
+        std::function<void(std::string_view message,
+                           const std::shared_ptr<WebSocketConnection> &,
+                           const WebSocketMessageType &)>;
+    using MessagePieceHandler =
+        std::function<void(std::string_view piece,
+                           const std::shared_ptr<WebSocketConnection> &,
+                           const WebSocketMessageType &,
+                           bool isLast)>;
+
+    /**
+     * @brief Receive the text and binary messages as views instead of the
+     * strings given to the message handler of the controller or the client.
+     *
+     * A message sent in one uncompressed frame is unmasked in the receive
+     * buffer and not copied. The view is only valid in the handler. The
+     * control messages are still given to the message handler.
+     * @note Call it in the IO loop of the connection before the messages
+     * arrive, such as when the connection is established.
+     */
+    virtual void setMessageViewHandler(MessageViewHandler handler) = 0;
+
+    /**
+     * @brief Receive the text and binary messages in pieces, as their frames
+     * arrive, instead of whole messages, e.g. to write large uploads to a
+     * file without buffering them.
+     *
+     * The last piece of a message is given with isLast set to true. The
+     * streamed messages aren't limited by the maximum size of the WebSocket
+     * messages, the handler can close the connection instead. The clients
+     * compressing their messages with permessage-deflate send them in one
+     * piece after decompression. This handler takes precedence over the
+     * view handler, and it's called in the same way.
+     */
+    virtual void setMessagePieceHandler(MessagePieceHandler handler) = 0;
+
   private:
     std::shared_ptr<void> contextPtr_;
 };
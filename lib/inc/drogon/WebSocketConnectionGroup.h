@@ -0,0 +1,80 @@
+/**
+ *
+ *  @file WebSocketConnectionGroup.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by the MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/WebSocketConnection.h>
+#include <trantor/utils/NonCopyable.h>
+#include <trantor/net/EventLoop.h>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief A group of WebSocket connections to which messages can be broadcast.
+ *
+ * A broadcast message is framed once, and the frame is shared by all the
+ * connections of the group. The connections are kept by the IO loops they
+ * belong to, so one task is queued in every loop for each message instead of
+ * one for each connection. The connections using the permessage-deflate
+ * extension compress the message themselves.
+ *
+ * For example:
+ * @code
+   void ChatController::handleNewConnection(const HttpRequestPtr &,
+                                            const WebSocketConnectionPtr &conn)
+   {
+       group_.add(conn);
+   }
+   void ChatController::handleNewMessage(const WebSocketConnectionPtr &,
+                                         std::string &&message,
+                                         const WebSocketMessageType &type)
+   {
+       group_.broadcast(message, type);
+   }
+   @endcode
+ *
+ * @note All the methods are thread safe. The closed connections are not
+ * removed when they close but by the next broadcast, size() counts them until
+ * then. Call remove() in handleConnectionClosed() to remove them at once.
+ */
+class DROGON_EXPORT WebSocketConnectionGroup : public trantor::NonCopyable
+{
+  public:
+    WebSocketConnectionGroup() = default;
+    ~WebSocketConnectionGroup();
+
+    void add(const WebSocketConnectionPtr &conn);
+    void remove(const WebSocketConnectionPtr &conn);
+
+    /// Return the number of connections in the group
+    size_t size() const;
+
+    /// Send the message to all the connections in the group
+    void broadcast(std::string_view message,
+                   WebSocketMessageType type = WebSocketMessageType::Text);
+
+  private:
+    struct LoopConnections;
+    std::shared_ptr<LoopConnections> loopConnections(trantor::EventLoop *loop);
+    std::shared_ptr<LoopConnections> findLoopConnections(
+        trantor::EventLoop *loop) const;
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<LoopConnections>> loops_;
+};
+}  // namespace drogon
@@ -0,0 +1,88 @@
+/**
+ *
+ *  @file WebSocketTopicRegistry.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by the MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/WebSocketConnection.h>
+#include <trantor/utils/NonCopyable.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief A registry of WebSocket connections subscribing to named topics.
+ *
+ * The subscriptions are sharded by the IO loops of the connections, and every
+ * shard is only accessed in its own loop, so no lock is shared by the loops.
+ * A published message is framed once and one task is queued in every loop
+ * which has subscribers, see WebSocketConnectionGroup.
+ *
+ * For example:
+ * @code
+   // A member of the controller
+   WebSocketTopicRegistry registry_;
+
+   void NotifyController::handleNewConnection(
+       const HttpRequestPtr &req,
+       const WebSocketConnectionPtr &conn)
+   {
+       registry_.subscribe(req->getParameter("user"), conn);
+   }
+   void NotifyController::handleConnectionClosed(
+       const WebSocketConnectionPtr &conn)
+   {
+       registry_.unsubscribeAll(conn);
+   }
+   // In any thread
+   registry_.publish("user1", R"({"type":"presence"})");
+   @endcode
+ *
+ * @note The registry must be created after the number of IO threads is set,
+ * like IOThreadStorage. All the methods are thread safe, closed connections
+ * are removed when messages are published to their topics.
+ */
+class DROGON_EXPORT WebSocketTopicRegistry : public trantor::NonCopyable
+{
+  public:
+    WebSocketTopicRegistry();
+    ~WebSocketTopicRegistry();
+
+    void subscribe(const std::string &topic,
+                   const WebSocketConnectionPtr &conn);
+    void unsubscribe(const std::string &topic,
+                     const WebSocketConnectionPtr &conn);
+
+    /// Remove the connection from all the topics it subscribes to.
+    void unsubscribeAll(const WebSocketConnectionPtr &conn);
+
+    /// Send the message to all the subscribers of the topic.
+    void publish(const std::string &topic,
+                 std::string_view message,
+                 WebSocketMessageType type = WebSocketMessageType::Text);
+
+    /// Return the number of subscriptions of all the topics.
+    size_t size() const;
+
+  private:
+    struct Shard;
+    std::shared_ptr<Shard> shardOf(const WebSocketConnectionPtr &conn);
+
+    // One shard for every IO loop and the main loop, indexed by the index of
+    // the loop.
+    std::vector<std::shared_ptr<Shard>> shards_;
+};
+}  // namespace drogon
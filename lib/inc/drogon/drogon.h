@@ -22,6 +22,7 @@
 #include <drogon/CacheMap.h>
 #include <drogon/HttpAppFramework.h>
 #include <drogon/HttpClient.h>
+#include <drogon/HttpClientPool.h>
 #include <drogon/HttpController.h>
 #include <drogon/HttpSimpleController.h>
 #include <drogon/utils/Utilities.h>
@@ -38,6 +39,7 @@
 #include <drogon/LocalHostFilter.h>
 #include <drogon/Cookie.h>
 #include <drogon/Session.h>
+#include <drogon/IOThreadContainers.h>
 #include <drogon/IOThreadStorage.h>
 #include <drogon/UploadFile.h>
 #include <drogon/orm/DbClient.h>
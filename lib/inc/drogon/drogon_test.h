@@ -9,6 +9,18 @@
 #include <atomic>
 #include <string_view>
 #include <cstddef>
+#include <exception>
+#include <functional>
+#include <string>
+#include <type_traits>
+#ifdef __cpp_impl_coroutine
+#include <drogon/utils/coroutine.h>
+#endif
+
+namespace trantor
+{
+class EventLoop;
+}
 
 /**
  * @brief Drogon Test is a minimal effort test framework developed because the
@@ -379,6 +391,129 @@ struct TestCase : public CaseBase
     virtual void doTest_(std::shared_ptr<Case>) = 0;
 };
 
+/**
+ * @brief The options of a benchmark, see BENCHMARK().
+ */
+struct BenchmarkOptions
+{
+    // The iterations run before the measured ones.
+    size_t warmup{100};
+    // The iterations of a repetition, run one after the other.
+    size_t iterations{1000};
+    // The repetition with the median time is reported.
+    size_t repetitions{5};
+    // The test case fails if an iteration takes more nanoseconds, 0 to not
+    // check.
+    double maxNsPerOp{0};
+    // The test case fails if an iteration allocates more times, a negative
+    // value to not check. The allocations are only counted if the test
+    // application counts them by drogon::AllocationCounter.
+    double maxAllocsPerOp{-1};
+    // The loop running the body, which must not be the loop of the calling
+    // thread. A loop is started for the benchmark if it is null.
+    trantor::EventLoop *loop{nullptr};
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    BenchmarkOptions options;
+    // The times and the allocations of the reported repetition, the
+    // allocations are the ones of the thread of the loop.
+    double nsPerOp{0};
+    double allocsPerOp{0};
+    double bytesPerOp{0};
+    // Set if the body threw, the benchmark is stopped then.
+    std::exception_ptr exception;
+};
+
+namespace internal
+{
+using BenchmarkDone = std::function<void(std::exception_ptr)>;
+
+DROGON_EXPORT BenchmarkResult
+runSyncBenchmark(std::string name,
+                 const BenchmarkOptions &options,
+                 const std::function<void()> &body);
+DROGON_EXPORT BenchmarkResult
+runAsyncBenchmark(std::string name,
+                  const BenchmarkOptions &options,
+                  const std::function<void(BenchmarkDone)> &body);
+DROGON_EXPORT void reportBenchmark(const std::shared_ptr<Case> &ctx,
+                                   const BenchmarkResult &result,
+                                   const char *file,
+                                   int line);
+
+#ifdef __cpp_impl_coroutine
+template <typename F>
+AsyncTask runBenchmarkCoroutine(F &body, BenchmarkDone done)
+{
+    try
+    {
+        co_await body();
+    }
+    catch (...)
+    {
+        done(std::current_exception());
+        co_return;
+    }
+    done(nullptr);
+}
+#endif
+}  // namespace internal
+
+/**
+ * @brief Run the body of a benchmark in a loop, see BENCHMARK(). The body is
+ * one of:
+ * - a function without parameter, e.g. [&]() { parse(request); },
+ * - a function called with a function to call when the iteration is done,
+ *   e.g. [&](std::function<void()> done) { client->sendRequest(...); },
+ * - a function returning an awaitable, e.g.
+ *   [&]() -> Task<> { co_await redis->execCommandCoro("PING"); }.
+ * The iterations of the asynchronous bodies run one after the other, from
+ * the loop.
+ */
+template <typename F>
+BenchmarkResult runBenchmark(std::string name,
+                             const BenchmarkOptions &options,
+                             F &&body)
+{
+    if constexpr (std::is_invocable_v<F &, std::function<void()>>)
+    {
+        return internal::runAsyncBenchmark(
+            std::move(name), options, [&body](internal::BenchmarkDone done) {
+                body(std::function<void()>(
+                    [done = std::move(done)]() { done(nullptr); }));
+            });
+    }
+    else if constexpr (std::is_void_v<std::invoke_result_t<F &>>)
+    {
+        return internal::runSyncBenchmark(std::move(name), options, body);
+    }
+    else
+    {
+#ifdef __cpp_impl_coroutine
+        static_assert(is_awaitable_v<std::invoke_result_t<F &>>,
+                      "The body should return void or an awaitable");
+        return internal::runAsyncBenchmark(
+            std::move(name), options, [&body](internal::BenchmarkDone done) {
+                internal::runBenchmarkCoroutine(body, std::move(done));
+            });
+#else
+        static_assert(std::is_void_v<std::invoke_result_t<F &>>,
+                      "The body should return void");
+#endif
+    }
+}
+
+template <typename F>
+BenchmarkResult runBenchmark(std::string name, F &&body)
+{
+    return runBenchmark(std::move(name),
+                        BenchmarkOptions{},
+                        std::forward<F>(body));
+}
+
 DROGON_EXPORT void printTestStats();
 DROGON_EXPORT int run(int argc, char **argv);
 }  // namespace test
@@ -714,6 +849,28 @@ DROGON_EXPORT int run(int argc, char **argv);
         drogon::test::internal::numCorrectAssertions++;                      \
     } while (0)
 
+/**
+ * Run a benchmark and print the time and the allocations of an iteration,
+ * the arguments are a name, the options (optional) and the body of
+ * drogon::test::runBenchmark(), e.g.
+ * @code
+   BenchmarkOptions options;
+   options.maxNsPerOp = 2000;
+   BENCHMARK("parse", options, [&]() { parser.parse(&buffer); });
+   @endcode
+ * It is an assertion which fails if the body throws or exceeds a threshold
+ * of the options.
+ */
+#define BENCHMARK(name, ...)                                   \
+    do                                                         \
+    {                                                          \
+        drogon::test::internal::reportBenchmark(               \
+            TEST_CTX,                                          \
+            drogon::test::runBenchmark(name, __VA_ARGS__),     \
+            __FILE__,                                          \
+            __LINE__);                                         \
+    } while (0)
+
 #define DROGON_TEST_CLASS_NAME_(test_name) \
     DROGON_TEST_CONCAT(DROGON_TESTCASE_PREIX_, test_name)
 
@@ -9,7 +9,12 @@
 #include <drogon/HttpRequest.h>
 #include <drogon/HttpResponse.h>
 #include <drogon/plugins/Plugin.h>
+#include <trantor/net/EventLoopThread.h>
 #include <trantor/utils/AsyncFileLogger.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <regex>
 
@@ -38,6 +43,14 @@ namespace plugin
             // "custom_time_format": "",
             // "use_real_ip": false
             // "path_exempt": ""
+            // "json_lines": false,
+            // "async": false,
+            // "async_queue_size": 8192,
+            // "async_flush_interval": 0.1,
+            // "sample_ratio": 1.0,
+            // "route_sample_ratios": {},
+            // "always_log_status": 500,
+            // "always_log_slower_than": 0.0
       }
    }
    @endcode
@@ -104,6 +117,37 @@ namespace plugin
  * (for matching the path of a request) or a regular expression list for URLs
  * that don't have to be logged.
  *
+ * json_lines: Log every request as a json object on its own line, whose keys
+ * are the placeholders of log_format without the '$', the other characters of
+ * log_format are ignored. False by default.
+ *
+ * async: Only copy the fields used by log_format in the IO threads, into a
+ * ring buffer of each thread, and format and write them in batches from a
+ * thread of the plugin. False by default.
+ *
+ * async_queue_size: The number of entries of the ring buffer of each thread
+ * in the async mode, rounded up to a power of 2. The requests are not logged
+ * when the ring buffer is full, the number of them is logged instead. 8192 by
+ * default.
+ *
+ * async_flush_interval: The interval in seconds between two batches in the
+ * async mode. 0.1 by default.
+ *
+ * sample_ratio: The ratio of the requests logged, 1.0 by default.
+ *
+ * route_sample_ratios: An object mapping routes to the ratio of their
+ * requests logged, instead of sample_ratio. The keys are the path patterns of
+ * the handlers (e.g. "/api/users/{id}"), or the paths of the requests which
+ * were not routed to a handler (e.g. "/favicon.ico").
+ *
+ * always_log_status: The responses with a status code greater than or equal
+ * to this one are always logged, whatever the sample ratio is. 500 by
+ * default, 0 disables it.
+ *
+ * always_log_slower_than: The requests whose processing time (see
+ * $processing_time) is greater than this number of seconds are always
+ * logged, whatever the sample ratio is. 0 by default, which disables it.
+ *
  */
 class DROGON_EXPORT AccessLogger : public drogon::Plugin<AccessLogger>
 {
@@ -116,6 +160,53 @@ class DROGON_EXPORT AccessLogger : public drogon::Plugin<AccessLogger>
     void shutdown() override;
 
   private:
+    // The fields of a request used by the log functions, copied when the
+    // response is sent.
+    struct LogRecord
+    {
+        // The time the response is sent.
+        trantor::Date date;
+        trantor::Date requestDate;
+        const char *method{""};
+        const char *version{""};
+        std::string path;
+        std::string query;
+        trantor::InetAddress remoteAddr;
+        trantor::InetAddress localAddr;
+        size_t requestLength{0};
+        size_t responseLength{0};
+        uint64_t threadId{0};
+        int statusCode{0};
+        std::string contentType;
+        // The headers and cookies of the placeholders, in the order of
+        // headerFields_.
+        std::vector<std::string> fields;
+    };
+
+    // A ring buffer written by one thread and read by the thread of the
+    // plugin, the slots are reused so that the strings keep their capacity.
+    struct RecordRing
+    {
+        explicit RecordRing(size_t size) : records(size)
+        {
+        }
+
+        std::vector<LogRecord> records;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+    };
+
+    struct HeaderField
+    {
+        enum Source
+        {
+            kRequestHeader,
+            kCookie,
+            kResponseHeader
+        } source;
+        std::string name;
+    };
+
     trantor::AsyncFileLogger asyncFileLogger_;
     int logIndex_{0};
     bool useLocalTime_{true};
@@ -125,97 +216,74 @@ class DROGON_EXPORT AccessLogger : public drogon::Plugin<AccessLogger>
     static bool useRealIp_;
     std::regex exemptRegex_;
     bool regexFlag_{false};
+    bool jsonLines_{false};
+
+    // Sampling
+    bool sampling_{false};
+    double sampleRatio_{1.0};
+    std::map<std::string, double, std::less<>> routeSampleRatios_;
+    int alwaysLogStatus_{500};
+    double alwaysLogSlowerThan_{0};
+    bool useContentType_{false};
+    std::vector<HeaderField> headerFields_;
+
+    // The async mode
+    bool async_{false};
+    size_t ringSize_{8192};
+    uint64_t id_{0};
+    std::mutex ringsMutex_;
+    std::vector<std::unique_ptr<RecordRing>> rings_;
+    std::atomic<size_t> droppedRecords_{0};
+    std::unique_ptr<trantor::EventLoopThread> threadPtr_;
+    trantor::TimerId timerId_{trantor::InvalidTimerId};
+    std::string batch_;
 
-    using LogFunction = std::function<void(trantor::LogStream &,
-                                           const drogon::HttpRequestPtr &,
-                                           const drogon::HttpResponsePtr &)>;
+    using LogFunction = std::function<void(std::string &, const LogRecord &)>;
     std::vector<LogFunction> logFunctions_;
-    void logging(trantor::LogStream &stream,
+    bool sampled(const drogon::HttpRequestPtr &req,
+                 const drogon::HttpResponsePtr &resp) const;
+    void record(const drogon::HttpRequestPtr &req,
+                const drogon::HttpResponsePtr &resp);
+    void capture(LogRecord &record,
                  const drogon::HttpRequestPtr &req,
-                 const drogon::HttpResponsePtr &resp);
+                 const drogon::HttpResponsePtr &resp) const;
+    void format(std::string &line, const LogRecord &record) const;
+    RecordRing *threadRing();
+    void writeRecords();
     void createLogFunctions(std::string format);
     LogFunction newLogFunction(const std::string &placeholder);
     std::map<std::string, LogFunction> logFunctionMap_;
+    std::string formatDate(const trantor::Date &date) const;
     //$request_path
-    static void outputReqPath(trantor::LogStream &,
-                              const drogon::HttpRequestPtr &,
-                              const drogon::HttpResponsePtr &);
+    static void outputReqPath(std::string &, const LogRecord &);
     //$request_query
-    static void outputReqQuery(trantor::LogStream &,
-                               const drogon::HttpRequestPtr &,
-                               const drogon::HttpResponsePtr &);
+    static void outputReqQuery(std::string &, const LogRecord &);
     //$request_url
-    static void outputReqURL(trantor::LogStream &,
-                             const drogon::HttpRequestPtr &,
-                             const drogon::HttpResponsePtr &);
+    static void outputReqURL(std::string &, const LogRecord &);
     //$version
-    static void outputVersion(trantor::LogStream &,
-                              const drogon::HttpRequestPtr &,
-                              const drogon::HttpResponsePtr &);
+    static void outputVersion(std::string &, const LogRecord &);
     //$request
-    static void outputReqLine(trantor::LogStream &,
-                              const drogon::HttpRequestPtr &,
-                              const drogon::HttpResponsePtr &);
-    //$date
-    void outputDate(trantor::LogStream &,
-                    const drogon::HttpRequestPtr &,
-                    const drogon::HttpResponsePtr &) const;
-    //$request_date
-    void outputReqDate(trantor::LogStream &,
-                       const drogon::HttpRequestPtr &,
-                       const drogon::HttpResponsePtr &) const;
+    static void outputReqLine(std::string &, const LogRecord &);
     //$remote_addr
-    static void outputRemoteAddr(trantor::LogStream &,
-                                 const drogon::HttpRequestPtr &,
-                                 const drogon::HttpResponsePtr &);
+    static void outputRemoteAddr(std::string &, const LogRecord &);
     //$local_addr
-    static void outputLocalAddr(trantor::LogStream &,
-                                const drogon::HttpRequestPtr &,
-                                const drogon::HttpResponsePtr &);
+    static void outputLocalAddr(std::string &, const LogRecord &);
     //$request_len $body_bytes_received
-    static void outputReqLength(trantor::LogStream &,
-                                const drogon::HttpRequestPtr &,
-                                const drogon::HttpResponsePtr &);
+    static void outputReqLength(std::string &, const LogRecord &);
     //$response_len $body_bytes_sent
-    static void outputRespLength(trantor::LogStream &,
-                                 const drogon::HttpRequestPtr &,
-                                 const drogon::HttpResponsePtr &);
+    static void outputRespLength(std::string &, const LogRecord &);
     //$method
-    static void outputMethod(trantor::LogStream &,
-                             const drogon::HttpRequestPtr &,
-                             const drogon::HttpResponsePtr &);
+    static void outputMethod(std::string &, const LogRecord &);
     //$thread
-    static void outputThreadNumber(trantor::LogStream &,
-                                   const drogon::HttpRequestPtr &,
-                                   const drogon::HttpResponsePtr &);
-    //$http_[header_name]
-    static void outputReqHeader(trantor::LogStream &stream,
-                                const drogon::HttpRequestPtr &req,
-                                const std::string &headerName);
-    //$cookie_[cookie_name]
-    static void outputReqCookie(trantor::LogStream &stream,
-                                const drogon::HttpRequestPtr &req,
-                                const std::string &cookie);
-    //$upstream_http_[header_name]
-    static void outputRespHeader(trantor::LogStream &stream,
-                                 const drogon::HttpResponsePtr &resp,
-                                 const std::string &headerName);
+    static void outputThreadNumber(std::string &, const LogRecord &);
     //$status
-    static void outputStatusString(trantor::LogStream &,
-                                   const drogon::HttpRequestPtr &,
-                                   const drogon::HttpResponsePtr &);
+    static void outputStatusString(std::string &, const LogRecord &);
     //$status_code
-    static void outputStatusCode(trantor::LogStream &,
-                                 const drogon::HttpRequestPtr &,
-                                 const drogon::HttpResponsePtr &);
+    static void outputStatusCode(std::string &, const LogRecord &);
     //$processing_time
-    static void outputProcessingTime(trantor::LogStream &,
-                                     const drogon::HttpRequestPtr &,
-                                     const drogon::HttpResponsePtr &);
+    static void outputProcessingTime(std::string &, const LogRecord &);
     //$upstream_http_content-type $upstream_http_content_type
-    static void outputRespContentType(trantor::LogStream &,
-                                      const drogon::HttpRequestPtr &,
-                                      const drogon::HttpResponsePtr &);
+    static void outputRespContentType(std::string &, const LogRecord &);
 };
 }  // namespace plugin
 }  // namespace drogon
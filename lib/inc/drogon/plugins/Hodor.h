@@ -15,7 +15,7 @@
 #include <drogon/plugins/Plugin.h>
 #include <drogon/plugins/RealIpResolver.h>
 #include <drogon/HttpAppFramework.h>
-#include <drogon/CacheMap.h>
+#include <drogon/ShardedCacheMap.h>
 #include <regex>
 #include <optional>
 
@@ -56,9 +56,6 @@ the default value 0 means no limit.
 request. if this option is true, the RealIpResolver plugin should be added to
 the dependencies list. the default value is false.
         "use_real_ip_resolver": false,
-        // Multiple threads mode: the default value is true. if this option is
-true, some mutexes are used for thread-safe.
-        "multi_threads": true,
         // The message body of the response when the request is rejected.
         "rejection_message": "Too many requests",
         // In seconds, the minimum expiration time of the limiters for different
@@ -74,6 +71,16 @@ IPs or users. the default value is 600.
         ],
         // Trusted proxy ip or cidr
         "trust_ips": ["127.0.0.1", "172.16.0.0/12"],
+        // The name of a redis client (see the redis_clients option). If it's
+not empty, the limits are shared by all the nodes using the same redis server
+and key prefix, the algorithm option is ignored in this case. See
+RedisRateLimiter for details. the default value is "".
+        "redis_client": "",
+        // The prefix of the redis keys of the limiters.
+        "redis_key_prefix": "drogon:hodor:",
+        // The number of tokens a node leases from redis at a time, the default
+value 0 means a tenth of the capacity.
+        "redis_lease_size": 0
      }
   }
   @endcode
@@ -121,25 +128,30 @@ class DROGON_EXPORT Hodor : public drogon::Plugin<Hodor>
         size_t ipCapacity{0};
         size_t userCapacity{0};
         bool regexFlag{false};
+        std::string redisKeyPrefix;
         RateLimiterPtr globalLimiterPtr;
-        std::unique_ptr<CacheMap<std::string, RateLimiterPtr>> ipLimiterMapPtr;
-        std::unique_ptr<CacheMap<std::string, RateLimiterPtr>>
+        std::unique_ptr<ShardedCacheMap<std::string, RateLimiterPtr>>
+            ipLimiterMapPtr;
+        std::unique_ptr<ShardedCacheMap<std::string, RateLimiterPtr>>
             userLimiterMapPtr;
     };
 
     LimitStrategy makeLimitStrategy(const Json::Value &config);
+    RateLimiterPtr newLimiter(size_t capacity, const std::string &key) const;
     std::vector<LimitStrategy> limitStrategies_;
     RateLimiterType algorithm_{RateLimiterType::kTokenBucket};
     std::chrono::duration<double> timeUnit_{1.0};
-    bool multiThreads_{true};
     bool useRealIpResolver_{false};
     size_t limiterExpireTime_{600};
+    nosql::RedisClientPtr redisClient_;
+    std::string redisKeyPrefix_;
+    size_t redisLeaseSize_{0};
     std::function<std::optional<std::string>(const drogon::HttpRequestPtr &)>
         userIdGetter_;
     std::function<HttpResponsePtr(const drogon::HttpRequestPtr &)>
         rejectResponseFactory_;
 
-    RealIpResolver::CIDRs trustCIDRs_;
+    CidrSet trustCIDRs_;
 
     void onHttpRequest(const drogon::HttpRequestPtr &,
                        AdviceCallback &&,
@@ -0,0 +1,94 @@
+/**
+ *  @file LoopWatchdog.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+#include <drogon/plugins/Plugin.h>
+#include <drogon/utils/monitoring/Counter.h>
+#include <drogon/utils/monitoring/ExponentialHistogram.h>
+#include <trantor/net/EventLoopThread.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace drogon
+{
+namespace plugin
+{
+/**
+ * @brief The LoopWatchdog plugin measures how long the tasks queued in every
+ * IO loop wait before they run, and reports the loops blocked by a task.
+ *
+ * A probe task is queued in every IO loop periodically from a thread of the
+ * plugin, so that a blocked loop is detected while it is still blocked. Slow
+ * handlers are also logged with the route they serve when they return.
+ * The json configuration is as follows:
+ *
+ * @code
+  {
+     "name": "drogon::plugin::LoopWatchdog",
+     // Add "drogon::plugin::PromExporter" if export_metrics is true.
+     "dependencies": [],
+     "config": {
+        // The interval in seconds between two probes. the default value is
+1.0.
+        "interval": 1.0,
+        // A loop which doesn't run a probe for this number of seconds is
+reported as stalled. the default value is 0.1.
+        "stall_threshold": 0.1,
+        // The handlers whose synchronous part runs longer than this number of
+seconds are logged, 0 disables the check. the default value is 0.1.
+        "slow_handler_threshold": 0.1,
+        // Export the delays of the probes and the number of stalls by the
+PromExporter plugin, as drogon_event_loop_delay_seconds and
+drogon_event_loop_stalls_total. the default value is false.
+        "export_metrics": false
+     }
+  }
+  @endcode
+ *
+ * @note A stall is detected but the stack of the blocking task can't be
+ * captured portably, the slow handler log names the route instead.
+ * */
+class DROGON_EXPORT LoopWatchdog : public drogon::Plugin<LoopWatchdog>
+{
+  public:
+    LoopWatchdog()
+    {
+    }
+
+    void initAndStart(const Json::Value &config) override;
+    void shutdown() override;
+
+  private:
+    struct LoopState
+    {
+        trantor::EventLoop *loop{nullptr};
+        size_t index{0};
+        // The time the pending probe was queued, in nanoseconds since the
+        // epoch of the steady clock, 0 if no probe is pending.
+        std::atomic<int64_t> probeTime{0};
+        // Only used by the watchdog thread.
+        bool stallReported{false};
+        std::shared_ptr<monitoring::ExponentialHistogram> delay;
+        std::shared_ptr<monitoring::Counter> stalls;
+    };
+
+    void check();
+
+    double interval_{1.0};
+    double stallThreshold_{0.1};
+    std::vector<std::shared_ptr<LoopState>> loops_;
+    std::unique_ptr<trantor::EventLoopThread> threadPtr_;
+    trantor::TimerId timerId_{trantor::InvalidTimerId};
+};
+}  // namespace plugin
+}  // namespace drogon
@@ -0,0 +1,89 @@
+/**
+ *  @file Profiler.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+
+#include <drogon/plugins/Plugin.h>
+#include <drogon/utils/CidrSet.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <functional>
+#include <string>
+
+namespace drogon
+{
+namespace plugin
+{
+/**
+ * @brief The Profiler plugin takes the cpu and heap profiles of a running
+ * application on demand, in formats read by pprof.
+ *
+ * GET {path}/profile?seconds=30 samples the stacks of the IO threads on their
+ * cpu time for the given seconds, the samples are labeled with the thread
+ * ("io-0", ...) and with the pattern of the route being handled, e.g.
+ * @code
+   go tool pprof -http=:8000 -tagfocus=route=/api/users/{id} \
+       ./app http://127.0.0.1/debug/pprof/profile?seconds=30
+   @endcode
+ * GET {path}/heap returns the heap profile of jemalloc, if the application
+ * is linked with a jemalloc built with --enable-prof and runs with
+ * MALLOC_CONF=prof:true.
+ *
+ * The json configuration is as follows:
+ *
+ * @code
+  {
+     "name": "drogon::plugin::Profiler",
+     "dependencies": [],
+     "config": {
+        // The path prefix of the routes. the default value is "/debug/pprof".
+        "path": "/debug/pprof",
+        // The number of samples per second of cpu time of a thread. the
+default value is 99.
+        "frequency": 99,
+        // The longest cpu profile in seconds. the default value is 60.
+        "max_seconds": 60,
+        // The addresses or CIDR blocks allowed to take the profiles. the
+default value is ["127.0.0.1", "::1"].
+        "allow_ips": ["127.0.0.1", "::1"]
+     }
+  }
+  @endcode
+ *
+ * @note The cpu profiles are only supported on Linux, the samples are taken
+ * with SIGPROF, so other profilers using the signal (e.g. gperftools) must
+ * not run meanwhile. The handlers running in the handler thread pool are not
+ * sampled.
+ * */
+class DROGON_EXPORT Profiler : public drogon::Plugin<Profiler>
+{
+  public:
+    Profiler()
+    {
+    }
+
+    void initAndStart(const Json::Value &config) override;
+    void shutdown() override;
+
+  private:
+    void handleProfile(const HttpRequestPtr &req,
+                       std::function<void(const HttpResponsePtr &)> &&callback);
+    void handleHeap(const HttpRequestPtr &req,
+                    std::function<void(const HttpResponsePtr &)> &&callback);
+
+    std::string path_{"/debug/pprof"};
+    int frequency_{99};
+    int maxSeconds_{60};
+    CidrSet allowIps_;
+};
+}  // namespace plugin
+}  // namespace drogon
@@ -15,8 +15,11 @@
 #include <drogon/plugins/Plugin.h>
 #include <drogon/utils/monitoring/Registry.h>
 #include <drogon/utils/monitoring/Collector.h>
+#include <trantor/net/EventLoop.h>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <vector>
 
 namespace drogon
 {
@@ -41,12 +44,38 @@ namespace plugin
                "help": "The total number of http requests",
                // The type of the collector. The default value is "counter".
                // The other possible value is as following:
-               // "gauge", "histogram".
+               // "gauge", "histogram", "exponential_histogram".
                "type": "counter",
                // The labels of the collector.
                "labels": ["method", "status"]
             }
-         ]
+         ],
+         // The built-in metrics of the framework, they are disabled if this
+         // option is absent.
+         "builtin_metrics": {
+            // Requests count and latency by method and route pattern, the
+            // number of requests in flight, the parse errors and the depth
+            // of the pipelines. the default value is true.
+            "http": true,
+            // The interval in seconds between two measurements of the lag of
+            // the task queues of the IO loops. 0 disables the measurement.
+            // the default value is 5.
+            "event_loop_lag_interval": 5,
+            // The names of the database clients and the redis clients whose
+            // connections are reported. Fast clients are not supported.
+            "db_clients": ["default"],
+            "redis_clients": ["default"],
+            // The latency, the rows and the errors of the SQL commands of
+            // all the database clients by normalized statement, whose
+            // literals and parameters are replaced by ?. the default value
+            // is false.
+            "db_statements": false,
+            // The cpu time of the handlers and of the sending of their
+            // responses by route pattern, and their allocations if the
+            // application counts them with drogon::AllocationCounter. the
+            // default value is false.
+            "route_costs": false
+         }
       }
     }
     @endcode
@@ -63,9 +92,7 @@ class DROGON_EXPORT PromExporter
 
     void initAndStart(const Json::Value &config) override;
 
-    void shutdown() override
-    {
-    }
+    void shutdown() override;
 
     ~PromExporter() override
     {
@@ -92,7 +119,12 @@ class DROGON_EXPORT PromExporter
                        std::shared_ptr<drogon::monitoring::CollectorBase>>
         collectors_;
     std::string path_{"/metrics"};
+    std::vector<std::string> dbClientNames_;
+    std::vector<std::string> redisClientNames_;
+    trantor::TimerId lagTimerId_{trantor::InvalidTimerId};
     std::string exportMetrics();
+    void enableBuiltinMetrics(const Json::Value &config);
+    void updateClientMetrics();
 };
 }  // namespace plugin
 }  // namespace drogon
@@ -7,9 +7,9 @@
 #pragma once
 
 #include <drogon/plugins/Plugin.h>
+#include <drogon/utils/CidrSet.h>
 #include <trantor/net/InetAddress.h>
 #include <drogon/HttpRequest.h>
-#include <vector>
 
 namespace drogon
 {
@@ -17,8 +17,6 @@ namespace plugin
 {
 /**
 * @brief This plugin is used to resolve client real ip from HTTP request.
-* @note This plugin currently supports only ipv4 address or cidr.
-*
 * The json configuration is as follows:
 *
 * @code
@@ -27,7 +25,7 @@ namespace plugin
      "dependencies": [],
      "config": {
         // Trusted proxy ip or cidr
-        "trust_ips": ["127.0.0.1", "172.16.0.0/12"],
+        "trust_ips": ["127.0.0.1", "172.16.0.0/12", "fc00::/7"],
         // Which header to parse ip form. Default is x-forwarded-for
         "from_header": "x-forwarded-for",
         // The result will be inserted to HttpRequest attribute map with this
@@ -58,19 +56,11 @@ class DROGON_EXPORT RealIpResolver : public drogon::Plugin<RealIpResolver>
     const trantor::InetAddress &getRealAddr(
         const drogon::HttpRequestPtr &req) const;
 
-    struct CIDR
-    {
-        explicit CIDR(const std::string &ipOrCidr);
-        in_addr_t addr_{0};
-        in_addr_t mask_{32};
-    };
-
-    using CIDRs = std::vector<CIDR>;
     static bool matchCidr(const trantor::InetAddress &addr,
-                          const CIDRs &trustCIDRs);
+                          const CidrSet &trustCIDRs);
 
     friend class Hodor;
-    CIDRs trustCIDRs_;
+    CidrSet trustCIDRs_;
     std::string fromHeader_;
     std::string attributeKey_;
     bool useXForwardedFor_{false};
@@ -0,0 +1,109 @@
+/**
+ *  @file RequestBatcher.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+#include <drogon/plugins/Plugin.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace drogon
+{
+namespace plugin
+{
+/**
+ * @brief The RequestBatcher plugin adds an endpoint which handles a list of
+ * sub-requests in one request, e.g. all the API calls of a screen of a
+ * mobile client.
+ *
+ * The sub-requests are handled concurrently by the application itself (see
+ * HttpAppFramework::forward() with an empty host), they go through the
+ * advices, the middlewares and the handlers as the other requests but
+ * without any network hop. The body of the batch request is a json object:
+ * @code
+   {
+       "requests": [
+           {"method": "GET", "path": "/api/v1/user?id=1"},
+           {
+               "method": "POST",
+               "path": "/api/v1/events",
+               "headers": {"content-type": "application/json"},
+               "body": "{\"name\": \"open\"}"
+           }
+       ]
+   }
+   @endcode
+ * and the body of the response has the responses of the sub-requests in the
+ * same order:
+ * @code
+   {
+       "responses": [
+           {"status": 200, "headers": {...}, "body": "..."},
+           ...
+       ]
+   }
+   @endcode
+ * The bodies of the responses sent from files or streamed are not included.
+ *
+ * The json configuration is as follows:
+ *
+ * @code
+  {
+     "name": "drogon::plugin::RequestBatcher",
+     "dependencies": [],
+     "config": {
+        // The path of the batch requests. the default value is "/batch".
+        "path": "/batch",
+        // The maximum number of sub-requests in a batch request. the default
+value is 20.
+        "max_requests": 20,
+        // The headers of the batch request which are copied to the
+sub-requests which don't set them. the default value is ["authorization"].
+        "forward_headers": ["authorization"],
+        // Copy the cookies of the batch request to the sub-requests. the
+default value is true.
+        "forward_cookies": true
+     }
+  }
+  @endcode
+ *
+ * Enable the plugin by adding the configuration to the list of plugins in the
+ * configuration file.
+ * */
+class DROGON_EXPORT RequestBatcher : public drogon::Plugin<RequestBatcher>
+{
+  public:
+    RequestBatcher()
+    {
+    }
+
+    void initAndStart(const Json::Value &config) override;
+    void shutdown() override;
+
+  private:
+    void handleBatch(const HttpRequestPtr &req,
+                     std::function<void(const HttpResponsePtr &)> &&callback);
+    // Return the sub-request, or nullptr with the error message set.
+    HttpRequestPtr makeSubRequest(const HttpRequestPtr &batchReq,
+                                  const Json::Value &item,
+                                  std::string &error) const;
+    static Json::Value toJson(const HttpResponsePtr &resp);
+
+    std::string path_{"/batch"};
+    size_t maxRequests_{20};
+    std::vector<std::string> forwardHeaders_{"authorization"};
+    bool forwardCookies_{true};
+};
+}  // namespace plugin
+}  // namespace drogon
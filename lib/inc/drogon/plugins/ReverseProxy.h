@@ -0,0 +1,171 @@
+/**
+ *  @file ReverseProxy.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+#include <drogon/plugins/Plugin.h>
+#include <drogon/HttpClient.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/IOThreadStorage.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace drogon
+{
+namespace plugin
+{
+/**
+ * @brief The ReverseProxy plugin forwards the requests to a set of upstream
+ * servers, over keep-alive connections opened in every IO loop.
+ *
+ * The bodies of the responses are relayed to the clients piece by piece as
+ * they arrive from the upstream servers, and the bodies of the requests too
+ * when the request stream is enabled (see
+ * HttpAppFramework::enableRequestStream()), instead of being stored in whole
+ * in memory. The idempotent requests are retried on another upstream server
+ * after an error. An upstream server which fails is not used for a while,
+ * and the servers can be checked periodically.
+ * The json configuration is as follows:
+ *
+ * @code
+  {
+     "name": "drogon::plugin::ReverseProxy",
+     "dependencies": [],
+     "config": {
+        // The upstream servers, in the format of the hostString parameter of
+HttpClient::newHttpClient().
+        "upstreams": ["http://127.0.0.1:8848"],
+        // Only the requests whose path starts with the prefix are proxied,
+the other ones are handled by the application. All the requests are proxied
+by default.
+        "path_prefix": "",
+        // Remove the prefix from the path sent to the upstream servers. the
+default value is false.
+        "strip_prefix": false,
+        // The maximum number of connections to each upstream server in each
+IO loop. the default value is 4.
+        "connections_per_upstream": 4,
+        // The pipelining depth of the connections. the default value is 0.
+        "pipelining": 0,
+        // Send the requests from a client IP to the same upstream server
+while it is available. the default value is false.
+        "same_client_to_same_backend": false,
+        // The time in seconds to receive the headers of a response, 0 for no
+limit. the default value is 60.
+        "timeout": 60,
+        // The number of times an idempotent request whose body isn't
+streamed is sent to another upstream server after an error or a timeout. the
+default value is 1.
+        "retries": 1,
+        // An upstream server failing max_fails times in a row isn't used for
+fail_timeout seconds. the default values are 1 and 10.
+        "max_fails": 1,
+        "fail_timeout": 10,
+        // Append the client IP to the x-forwarded-for header. the default
+value is true.
+        "x_forwarded_for": true,
+        // Check the upstream servers periodically, the servers which don't
+answer the GET request for the path with a 2xx or 3xx response aren't used
+until they do. Disabled when the path is empty, by default.
+        "health_check": {
+            "path": "/health",
+            // In seconds. the default value is 5.
+            "interval": 5,
+            // In seconds. the default value is 2.
+            "timeout": 2
+        }
+     }
+  }
+  @endcode
+ *
+ * The requests keep the host header sent by the clients.
+ *
+ * @note Requests and responses are relayed through the HTTP parsers of the
+ * framework, the bytes can't be spliced between the sockets. The streamed
+ * responses are sent with the chunked transfer encoding, and the streamed
+ * requests with the chunked transfer encoding over HTTP/1.1 connections.
+ * */
+class DROGON_EXPORT ReverseProxy : public drogon::Plugin<ReverseProxy>
+{
+  public:
+    ReverseProxy()
+    {
+    }
+
+    void initAndStart(const Json::Value &config) override;
+    void shutdown() override;
+
+  private:
+    struct Upstream
+    {
+        explicit Upstream(std::string addr) : address(std::move(addr))
+        {
+        }
+
+        std::string address;
+        // Set by the health checks.
+        std::atomic<bool> healthy{true};
+        // The failures in a row.
+        std::atomic<size_t> fails{0};
+        // Not used until the time, in microseconds since the epoch.
+        std::atomic<int64_t> downUntil{0};
+        // Only used in the main loop.
+        HttpClientPtr checker;
+    };
+
+    // The connections to every upstream server, in every IO loop
+    struct LoopData
+    {
+        std::vector<std::vector<HttpClientPtr>> clients;
+        size_t next{0};
+    };
+
+    void preRouting(const HttpRequestPtr &req,
+                    AdviceCallback &&callback,
+                    AdviceChainCallback &&pass);
+    void forward(const HttpRequestPtr &req,
+                 AdviceCallback &&callback,
+                 size_t attempt);
+    void forwardStreamedBody(const HttpRequestPtr &req,
+                             AdviceCallback &&callback);
+    // Return the index of the upstream server, -1 if none is available.
+    int selectUpstream(const HttpRequestPtr &req, size_t attempt);
+    HttpClientPtr selectClient(size_t upstream);
+    void reportResult(size_t upstream, ReqResult result);
+    void checkHealth();
+
+    bool isAvailable(const Upstream &upstream) const;
+    bool shouldRetry(const HttpRequestPtr &req,
+                     size_t attempt,
+                     ReqResult result) const;
+    void prepareRequest(const HttpRequestPtr &req) const;
+
+    std::vector<std::unique_ptr<Upstream>> upstreams_;
+    std::unique_ptr<IOThreadStorage<LoopData>> loopData_;
+    std::string pathPrefix_;
+    bool stripPrefix_{false};
+    size_t connectionsPerUpstream_{4};
+    size_t pipeliningDepth_{0};
+    bool sameClientToSameBackend_{false};
+    double timeout_{60.0};
+    size_t retries_{1};
+    size_t maxFails_{1};
+    double failTimeout_{10.0};
+    bool xForwardedFor_{true};
+    std::string healthCheckPath_;
+    double healthCheckInterval_{5.0};
+    double healthCheckTimeout_{2.0};
+    trantor::TimerId healthCheckTimer_{trantor::InvalidTimerId};
+};
+}  // namespace plugin
+}  // namespace drogon
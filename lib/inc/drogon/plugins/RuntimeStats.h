@@ -0,0 +1,104 @@
+/**
+ *  @file RuntimeStats.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+
+#include <drogon/plugins/Plugin.h>
+#include <drogon/utils/CidrSet.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <functional>
+#include <string>
+
+namespace drogon
+{
+namespace plugin
+{
+/**
+ * @brief The RuntimeStats plugin reports the state of every IO loop and of
+ * the database and redis clients as a json object, to find the imbalanced
+ * loops and the leaks of a running application.
+ *
+ * GET {path} returns e.g.
+ * @code
+  {
+     "connections": 3,
+     "loops": [
+        {
+           "loop": 0,
+           // The time in seconds the task collecting the stats of the loop
+           // waited in its queue.
+           "queue_delay": 0.000012,
+           "connections": 2,
+           "http2_connections": 0,
+           "websocket_connections": 1,
+           // The requests waiting for their responses.
+           "pipelined_requests": 1,
+           // The requests kept by the parsers of the connections for reuse.
+           "pooled_requests": 2,
+           // The responses not flushed yet, the input held under memory
+           // pressure and the output beyond the watermarks of the
+           // connections.
+           "buffered_bytes": 0,
+           // An estimate of the memory used by the connections.
+           "memory_usage": 9216
+        }, ...
+     ],
+     "db_clients": {
+        "default": {"busy": 1, "idle": 3, "pending": 0}
+     },
+     "redis_clients": {
+        "default": {"connected": 4, "total": 4, "pending": 0}
+     }
+  }
+  @endcode
+ *
+ * The json configuration is as follows:
+ *
+ * @code
+  {
+     "name": "drogon::plugin::RuntimeStats",
+     "dependencies": [],
+     "config": {
+        // The path of the route. the default value is "/debug/stats".
+        "path": "/debug/stats",
+        // The addresses or CIDR blocks allowed to get the stats. the default
+value is ["127.0.0.1", "::1"].
+        "allow_ips": ["127.0.0.1", "::1"]
+     }
+  }
+  @endcode
+ *
+ * @note The stats of a loop are collected by a task queued in the loop, so
+ * the response waits for the blocked loops. The number of timers and queued
+ * tasks of a loop are not exposed by trantor, the queue delay shows how busy
+ * it is instead. The fast database and redis clients are not reported.
+ * */
+class DROGON_EXPORT RuntimeStats : public drogon::Plugin<RuntimeStats>
+{
+  public:
+    RuntimeStats()
+    {
+    }
+
+    void initAndStart(const Json::Value &config) override;
+    void shutdown() override;
+
+  private:
+    void handleStats(const HttpRequestPtr &req,
+                     std::function<void(const HttpResponsePtr &)> &&callback);
+
+    std::string path_{"/debug/stats"};
+    CidrSet allowIps_;
+};
+}  // namespace plugin
+}  // namespace drogon
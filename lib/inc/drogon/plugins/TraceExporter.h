@@ -0,0 +1,116 @@
+/**
+ *  @file TraceExporter.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+#include <drogon/plugins/Plugin.h>
+#include <drogon/HttpClient.h>
+#include <drogon/RequestTrace.h>
+#include <trantor/net/EventLoopThread.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace drogon
+{
+namespace plugin
+{
+/**
+ * @brief The TraceExporter plugin samples the requests and exports their
+ * traces to an OpenTelemetry collector, with the OTLP/HTTP protocol in json.
+ *
+ * Every sampled request is exported as a server span named after its method
+ * and route, with a child span for every stage the request passed (see
+ * RequestTrace::Stage) and a client span for every database or redis call
+ * made by the synchronous part of its handler. The spans are sent in batches
+ * from a thread of the plugin.
+ * The json configuration is as follows:
+ *
+ * @code
+  {
+     "name": "drogon::plugin::TraceExporter",
+     "dependencies": [],
+     "config": {
+        // The url of the collector. the default value is
+"http://127.0.0.1:4318".
+        "endpoint": "http://127.0.0.1:4318",
+        // The path the spans are posted to. the default value is
+"/v1/traces".
+        "path": "/v1/traces",
+        // The service.name attribute of the spans. the default value is
+"drogon".
+        "service_name": "drogon",
+        // The ratio of the requests sampled, unless the sampling is decided
+by the traceparent header of the request. the default value is 0.01.
+        "sample_ratio": 0.01,
+        // The spans are sent as soon as this number of spans is pending. the
+default value is 512.
+        "batch_size": 512,
+        // The interval in seconds between two sends. the default value is
+5.0.
+        "flush_interval": 5.0,
+        // The maximum number of pending spans, the spans beyond are dropped.
+the default value is 4096.
+        "max_queue_size": 4096,
+        // The timeout in seconds of the requests to the collector. the
+default value is 10.0.
+        "timeout": 10.0
+     }
+  }
+  @endcode
+ *
+ * @note The calls made after the first suspension of a coroutine handler,
+ * or from other callbacks, are recorded only if the trace of the request is
+ * made current with RequestTrace::Scope.
+ * */
+class DROGON_EXPORT TraceExporter : public drogon::Plugin<TraceExporter>
+{
+  public:
+    TraceExporter()
+    {
+    }
+
+    void initAndStart(const Json::Value &config) override;
+    void shutdown() override;
+
+  private:
+    // Shared with the exporter of the framework, which may still be called by
+    // the IO loops while the plugin is destroyed.
+    struct State
+    {
+        std::mutex mutex;
+        std::vector<Json::Value> spans;
+        bool flushQueued{false};
+        bool stopped{false};
+        size_t droppedSpans{0};
+        size_t batchSize{512};
+        size_t maxQueueSize{4096};
+        trantor::EventLoop *loop{nullptr};
+        std::function<void()> flush;
+    };
+
+    static void record(const std::shared_ptr<State> &state,
+                       const HttpRequestPtr &req,
+                       const HttpResponsePtr &resp,
+                       const RequestTrace &trace);
+    void flush();
+
+    std::string path_{"/v1/traces"};
+    std::string serviceName_{"drogon"};
+    double timeout_{10.0};
+    std::shared_ptr<State> state_;
+    HttpClientPtr client_;
+    std::unique_ptr<trantor::EventLoopThread> threadPtr_;
+    trantor::TimerId timerId_{trantor::InvalidTimerId};
+};
+}  // namespace plugin
+}  // namespace drogon
@@ -0,0 +1,55 @@
+/**
+ *
+ *  @file AllocationCounter.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace drogon
+{
+/**
+ * @brief The per-thread counters of the memory allocations, read by the
+ * route costs of the PromExporter plugin.
+ *
+ * The framework doesn't replace the allocator, the application counts its
+ * allocations by calling record() from its own hooks, e.g.
+ * @code
+   void *operator new(size_t size)
+   {
+       drogon::AllocationCounter::record(size);
+       if (auto *p = std::malloc(size))
+           return p;
+       throw std::bad_alloc();
+   }
+   @endcode
+ * Without a hook the counters stay 0.
+ */
+class DROGON_EXPORT AllocationCounter
+{
+  public:
+    struct Counts
+    {
+        uint64_t allocations{0};
+        uint64_t bytes{0};
+    };
+
+    /// Count an allocation of the calling thread, it never allocates.
+    static void record(size_t bytes) noexcept;
+
+    /// The allocations of the calling thread since it started.
+    static Counts current() noexcept;
+};
+}  // namespace drogon
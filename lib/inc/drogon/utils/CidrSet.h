@@ -0,0 +1,91 @@
+/**
+ *
+ *  @file CidrSet.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <trantor/net/InetAddress.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief A set of IPv4 and IPv6 CIDR blocks, e.g. the trusted proxies or
+ * the whitelists of the plugins.
+ *
+ * The blocks are stored in path-compressed binary tries (one for each
+ * address family), so looking an address up takes at most one step per
+ * 32 or 128 bits of the address, not one per block. The IPv4-mapped IPv6
+ * addresses (::ffff:a.b.c.d) are looked up in the IPv4 blocks.
+ *
+ * @code
+   CidrSet trusted;
+   trusted.add("10.0.0.0/8");
+   trusted.add("2001:db8::/32");
+   if (trusted.contains(req->getPeerAddr())) { ... }
+   @endcode
+ *
+ * @note The set is built once and then only read, it can be shared by
+ * threads.
+ */
+class DROGON_EXPORT CidrSet
+{
+  public:
+    CidrSet();
+
+    /**
+     * @brief Add an address ("10.1.2.3", "::1") or a CIDR block
+     * ("172.16.0.0/12", "fc00::/7").
+     *
+     * @throw std::runtime_error if the string is neither.
+     */
+    void add(const std::string &ipOrCidr);
+
+    bool contains(const trantor::InetAddress &addr) const;
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    /// The number of blocks added, including the covered ones.
+    size_t size() const
+    {
+        return size_;
+    }
+
+  private:
+    // An address is 128 bits, the IPv4 ones only use the first 32 bits of
+    // hi. The key of a node is the prefix it stands for, masked to its
+    // length.
+    struct Node
+    {
+        uint64_t hi{0};
+        uint64_t lo{0};
+        uint32_t children[2]{0, 0};
+        uint8_t length{0};
+        bool terminal{false};
+    };
+
+    void insert(uint32_t root, uint64_t hi, uint64_t lo, uint8_t length);
+    bool find(uint32_t root, uint64_t hi, uint64_t lo, uint8_t bits) const;
+
+    // nodes_[0] is the root of the IPv4 trie, nodes_[1] of the IPv6 one, 0
+    // is also used for no child as the roots aren't children.
+    std::vector<Node> nodes_;
+    size_t size_{0};
+};
+}  // namespace drogon
@@ -25,7 +25,17 @@ enum class ConstraintType
 {
     None,
     HttpMethod,
-    HttpMiddleware
+    HttpMiddleware,
+    Offload,
+    LowPriority
+};
+
+struct OffloadConstraint
+{
+};
+
+struct LowPriorityConstraint
+{
 };
 
 class HttpConstraint
@@ -47,6 +57,14 @@ class HttpConstraint
     {
     }
 
+    HttpConstraint(OffloadConstraint) : type_(ConstraintType::Offload)
+    {
+    }
+
+    HttpConstraint(LowPriorityConstraint) : type_(ConstraintType::LowPriority)
+    {
+    }
+
     ConstraintType type() const
     {
         return type_;
@@ -68,4 +86,34 @@ class HttpConstraint
     std::string middlewareName_;
 };
 }  // namespace internal
+
+/**
+ * @brief The constraint which runs a handler in the pool of the handler
+ * threads instead of the IO loop of its connection, for the handlers which
+ * use the CPU for a long time, e.g.
+ * @code
+   ADD_METHOD_TO(Image::resize, "/resize", Post, Offload);
+   @endcode
+ * The response is sent in the IO loop of the connection. The things bound to
+ * the IO loops, like the fast database clients, can't be used in these
+ * handlers. The number of the threads is set by the
+ * HttpAppFramework::setHandlerThreadNum() method.
+ */
+inline constexpr internal::OffloadConstraint Offload{};
+
+/**
+ * @brief The constraint of the handlers of low priority work, e.g. batch or
+ * report calls, which shouldn't delay the health checks and the interactive
+ * requests:
+ * @code
+   ADD_METHOD_TO(Report::build, "/report", Post, LowPriority);
+   @endcode
+ * The handler of such a request is called after the handlers of the other
+ * requests parsed in the same round of the IO events of its loop, and only a
+ * few low priority handlers are called in each round, so a burst of them is
+ * interleaved with the other requests instead of going first. They still
+ * make progress in every round while the loop is busy. The cached responses
+ * are sent immediately.
+ */
+inline constexpr internal::LowPriorityConstraint LowPriority{};
 }  // namespace drogon
@@ -0,0 +1,180 @@
+/**
+ *
+ *  @file JsonReader.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <json/value.h>
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace drogon
+{
+/**
+ * @brief A pull reader of JSON text, reading the values one by one in the
+ * order of the document without building a Json::Value tree.
+ *
+ * @code
+   JsonReader reader(text);
+   std::string key;
+   if (reader.startObject())
+   {
+       while (reader.nextMember(key))
+       {
+           if (key == "id")
+               reader.readInteger(id);
+           else
+               reader.skipValue();
+       }
+   }
+   if (!reader.finish())
+       LOG_ERROR << reader.error();
+   @endcode
+ *
+ * After the first error, all the methods return false and the error() method
+ * returns its description.
+ */
+class DROGON_EXPORT JsonReader
+{
+  public:
+    enum class Token
+    {
+        kNull,
+        kBool,
+        kNumber,
+        kString,
+        kArray,
+        kObject,
+        kInvalid
+    };
+
+    /**
+     * @param text The JSON text, which must outlive the reader.
+     * @param stackLimit The maximum depth of the nested arrays and objects.
+     */
+    explicit JsonReader(std::string_view text, size_t stackLimit = 1000)
+        : text_(text), stackLimit_(stackLimit)
+    {
+    }
+
+    /// The stack limit set for the JSON text of the framework
+    static size_t appStackLimit();
+
+    /// The type of the next value, kInvalid at the end of the text
+    Token peek();
+
+    bool readNull();
+    bool readBool(bool &value);
+
+    /// Read an integer, fails on the numbers with a fraction or an exponent
+    /// and on the ones which don't fit in T.
+    template <typename T,
+              std::enable_if_t<std::is_integral_v<T> &&
+                                   !std::is_same_v<T, bool>,
+                               int> = 0>
+    bool readInteger(T &value)
+    {
+        std::string_view number;
+        bool isInteger;
+        if (!readNumber(number, isInteger))
+            return false;
+        if (!isInteger)
+            return fail("expected an integer");
+        auto result = std::from_chars(number.data(),
+                                      number.data() + number.length(),
+                                      value);
+        if (result.ec != std::errc() ||
+            result.ptr != number.data() + number.length())
+            return fail("integer out of range");
+        return true;
+    }
+
+    bool readDouble(double &value);
+    bool readString(std::string &value);
+
+    /**
+     * @brief Read the next value whatever its type, for the members of
+     * Json::Value type.
+     */
+    bool readValue(Json::Value &value);
+
+    bool skipValue();
+
+    /**
+     * @brief Enter an object, the members are then read by calling
+     * nextMember() until it returns false.
+     */
+    bool startObject();
+
+    /**
+     * @brief Read the key of the next member of the current object, the
+     * caller must then read or skip its value. Returns false at the end of
+     * the object or on an error.
+     */
+    bool nextMember(std::string &key);
+
+    /**
+     * @brief Enter an array, the elements are then read by calling
+     * nextElement() until it returns false.
+     */
+    bool startArray();
+
+    /**
+     * @brief Move to the next element of the current array, the caller must
+     * then read or skip it. Returns false at the end of the array or on an
+     * error.
+     */
+    bool nextElement();
+
+    /// Check that only whitespace remains after the document
+    bool finish();
+
+    /// Set the error, e.g. when a value doesn't have the expected type
+    bool fail(std::string_view message);
+
+    bool good() const
+    {
+        return error_.empty();
+    }
+
+    const std::string &error() const
+    {
+        return error_;
+    }
+
+  private:
+    void skipWhitespace()
+    {
+        while (pos_ < text_.length() &&
+               (text_[pos_] == ' ' || text_[pos_] == '\n' ||
+                text_[pos_] == '\r' || text_[pos_] == '\t'))
+            ++pos_;
+    }
+
+    bool readNumber(std::string_view &number, bool &isInteger);
+    bool readLiteral(std::string_view literal);
+    bool closeContainer(char close);
+
+    std::string_view text_;
+    size_t pos_{0};
+    size_t stackLimit_;
+    size_t depth_{0};
+    // No member or element read yet in the current container
+    bool first_{false};
+    std::string error_;
+};
+}  // namespace drogon
@@ -0,0 +1,510 @@
+/**
+ *
+ *  @file JsonReflect.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/utils/JsonReader.h>
+#include <drogon/utils/JsonWriter.h>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Map the public members of a struct to the members of a JSON object,
+ * so the struct is written by writeJson() and read by readJson() without a
+ * Json::Value tree. It must be used in the namespace of the struct.
+ *
+ * @code
+   namespace api
+   {
+   struct User
+   {
+       int64_t id{0};
+       std::string name;
+       std::vector<std::string> tags;
+       std::optional<double> score;
+   };
+   DROGON_REFLECT(User, id, name, tags, score)
+   }  // namespace api
+   @endcode
+ *
+ * A reflected struct can then be returned by
+ * HttpResponse::newHttpJsonResponse() and converted from a request with a
+ * JSON body, e.g. by declaring a handler parameter of its type. At most 32
+ * members are supported.
+ */
+#define DROGON_REFLECT(Type, ...)                                      \
+    template <typename Visitor>                                        \
+    inline void drogonReflect(Type &object, Visitor &&visitor)         \
+    {                                                                  \
+        DROGON_REFLECT_FOR_EACH(DROGON_REFLECT_MEMBER, __VA_ARGS__)    \
+    }                                                                  \
+    template <typename Visitor>                                        \
+    inline void drogonReflect(const Type &object, Visitor &&visitor)   \
+    {                                                                  \
+        DROGON_REFLECT_FOR_EACH(DROGON_REFLECT_MEMBER, __VA_ARGS__)    \
+    }
+
+#define DROGON_REFLECT_MEMBER(name) visitor(#name, object.name);
+#define DROGON_REFLECT_EXPAND(x) x
+#define DROGON_REFLECT_FE_1(m, x) m(x)
+#define DROGON_REFLECT_FE_2(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_1(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_3(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_2(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_4(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_3(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_5(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_4(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_6(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_5(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_7(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_6(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_8(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_7(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_9(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_8(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_10(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_9(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_11(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_10(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_12(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_11(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_13(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_12(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_14(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_13(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_15(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_14(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_16(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_15(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_17(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_16(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_18(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_17(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_19(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_18(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_20(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_19(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_21(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_20(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_22(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_21(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_23(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_22(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_24(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_23(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_25(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_24(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_26(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_25(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_27(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_26(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_28(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_27(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_29(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_28(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_30(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_29(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_31(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_30(m, __VA_ARGS__))
+#define DROGON_REFLECT_FE_32(m, x, ...) \
+    m(x) DROGON_REFLECT_EXPAND(DROGON_REFLECT_FE_31(m, __VA_ARGS__))
+#define DROGON_REFLECT_GET_FE(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, \
+    _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, \
+    _26, _27, _28, _29, _30, _31, _32, name, ...) name
+#define DROGON_REFLECT_FOR_EACH(m, ...) \
+    DROGON_REFLECT_EXPAND(DROGON_REFLECT_GET_FE(__VA_ARGS__, \
+    DROGON_REFLECT_FE_32, DROGON_REFLECT_FE_31, DROGON_REFLECT_FE_30, \
+    DROGON_REFLECT_FE_29, DROGON_REFLECT_FE_28, DROGON_REFLECT_FE_27, \
+    DROGON_REFLECT_FE_26, DROGON_REFLECT_FE_25, DROGON_REFLECT_FE_24, \
+    DROGON_REFLECT_FE_23, DROGON_REFLECT_FE_22, DROGON_REFLECT_FE_21, \
+    DROGON_REFLECT_FE_20, DROGON_REFLECT_FE_19, DROGON_REFLECT_FE_18, \
+    DROGON_REFLECT_FE_17, DROGON_REFLECT_FE_16, DROGON_REFLECT_FE_15, \
+    DROGON_REFLECT_FE_14, DROGON_REFLECT_FE_13, DROGON_REFLECT_FE_12, \
+    DROGON_REFLECT_FE_11, DROGON_REFLECT_FE_10, DROGON_REFLECT_FE_9, \
+    DROGON_REFLECT_FE_8, DROGON_REFLECT_FE_7, DROGON_REFLECT_FE_6, \
+    DROGON_REFLECT_FE_5, DROGON_REFLECT_FE_4, DROGON_REFLECT_FE_3, \
+    DROGON_REFLECT_FE_2, DROGON_REFLECT_FE_1)(m, __VA_ARGS__))
+
+namespace drogon
+{
+namespace internal
+{
+struct ReflectProbe
+{
+    template <typename M>
+    void operator()(const char *, M &) const;
+};
+
+template <typename T, typename = void>
+struct IsReflected : std::false_type
+{
+};
+
+template <typename T>
+struct IsReflected<T,
+                   std::void_t<decltype(drogonReflect(
+                       std::declval<T &>(), std::declval<ReflectProbe &>()))>>
+    : std::true_type
+{
+};
+
+// The types writing themselves, e.g. the ORM models
+template <typename T, typename = void>
+struct HasWriteJson : std::false_type
+{
+};
+
+template <typename T>
+struct HasWriteJson<T,
+                    std::void_t<decltype(std::declval<const T &>().writeJson(
+                        std::declval<JsonWriter &>()))>> : std::true_type
+{
+};
+
+template <typename T>
+struct IsOptional : std::false_type
+{
+};
+
+template <typename T>
+struct IsOptional<std::optional<T>> : std::true_type
+{
+};
+
+template <typename T>
+struct IsSmartPointer : std::false_type
+{
+};
+
+template <typename T>
+struct IsSmartPointer<std::shared_ptr<T>> : std::true_type
+{
+};
+
+template <typename T>
+struct IsSmartPointer<std::unique_ptr<T>> : std::true_type
+{
+};
+
+template <typename T, typename = void>
+struct IsStringMap : std::false_type
+{
+};
+
+template <typename T>
+struct IsStringMap<T,
+                   std::void_t<typename T::key_type, typename T::mapped_type>>
+    : std::is_convertible<typename T::key_type, std::string_view>
+{
+};
+
+template <typename T, typename = void>
+struct IsRange : std::false_type
+{
+};
+
+template <typename T>
+struct IsRange<T,
+               std::void_t<typename T::value_type,
+                           decltype(std::begin(std::declval<const T &>())),
+                           decltype(std::end(std::declval<const T &>()))>>
+    : std::true_type
+{
+};
+
+template <typename T, typename = void>
+struct HasPushBack : std::false_type
+{
+};
+
+template <typename T>
+struct HasPushBack<T,
+                   std::void_t<decltype(std::declval<T &>().push_back(
+                       std::declval<typename T::value_type>()))>>
+    : std::true_type
+{
+};
+
+template <typename T>
+constexpr bool isJsonScalar =
+    std::is_same_v<T, bool> || std::is_same_v<T, std::nullptr_t> ||
+    std::is_floating_point_v<T> ||
+    (std::is_integral_v<T> && !std::is_same_v<T, char>) ||
+    std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view> ||
+    std::is_same_v<T, const char *> || std::is_same_v<T, Json::Value>;
+
+template <typename T>
+using EnumInteger =
+    std::conditional_t<std::is_signed_v<std::underlying_type_t<T>>,
+                       int64_t,
+                       uint64_t>;
+
+template <typename T>
+constexpr bool isJsonObjectType =
+    IsReflected<T>::value || HasWriteJson<T>::value;
+
+template <typename T, typename = void>
+struct IsJsonObjectRange : std::false_type
+{
+};
+
+template <typename T>
+struct IsJsonObjectRange<T, std::enable_if_t<IsRange<T>::value>>
+    : std::bool_constant<isJsonObjectType<typename T::value_type>>
+{
+};
+
+/// The types which HttpResponse::newHttpJsonResponse() accepts besides
+/// Json::Value: the reflected structs and the models, or ranges of them.
+template <typename T>
+constexpr bool canBeJsonResponse =
+    isJsonObjectType<T> || IsJsonObjectRange<T>::value;
+
+template <typename T, typename = void>
+struct IsReflectedRange : std::false_type
+{
+};
+
+template <typename T>
+struct IsReflectedRange<
+    T,
+    std::enable_if_t<IsRange<T>::value && !IsStringMap<T>::value>>
+    : IsReflected<typename T::value_type>
+{
+};
+
+/// The types converted from the JSON bodies of the requests
+template <typename T>
+constexpr bool canBeReadFromJsonRequest =
+    IsReflected<T>::value || IsReflectedRange<T>::value;
+
+template <typename T>
+constexpr bool alwaysFalse = false;
+}  // namespace internal
+
+/**
+ * @brief Write a value as JSON: the scalars, the strings, Json::Value, the
+ * reflected structs, the types with a writeJson(JsonWriter &) method,
+ * std::optional and the smart pointers (null when empty), the maps with
+ * string keys (objects) and the other containers (arrays).
+ */
+template <typename T>
+void writeJson(JsonWriter &writer, const T &value)
+{
+    if constexpr (internal::HasWriteJson<T>::value)
+    {
+        value.writeJson(writer);
+    }
+    else if constexpr (internal::IsReflected<T>::value)
+    {
+        writer.startObject();
+        drogonReflect(value, [&writer](const char *name, const auto &member) {
+            writer.key(name);
+            writeJson(writer, member);
+        });
+        writer.endObject();
+    }
+    else if constexpr (internal::isJsonScalar<T>)
+    {
+        writer.value(value);
+    }
+    else if constexpr (std::is_enum_v<T>)
+    {
+        writer.value(static_cast<internal::EnumInteger<T>>(value));
+    }
+    else if constexpr (internal::IsOptional<T>::value ||
+                       internal::IsSmartPointer<T>::value)
+    {
+        if (value)
+            writeJson(writer, *value);
+        else
+            writer.null();
+    }
+    else if constexpr (internal::IsStringMap<T>::value)
+    {
+        writer.startObject();
+        for (const auto &member : value)
+        {
+            writer.key(member.first);
+            writeJson(writer, member.second);
+        }
+        writer.endObject();
+    }
+    else if constexpr (internal::IsRange<T>::value)
+    {
+        writer.startArray();
+        // The cast reads the proxies of std::vector<bool>
+        for (const auto &element : value)
+            writeJson(writer,
+                      static_cast<const typename T::value_type &>(element));
+        writer.endArray();
+    }
+    else
+    {
+        static_assert(internal::alwaysFalse<T>,
+                      "The type can't be written as JSON, define a "
+                      "writeJson(JsonWriter &) method or use DROGON_REFLECT");
+    }
+}
+
+/**
+ * @brief Read a value written by writeJson(). The members of a reflected
+ * struct missing in the object keep their values, the members of the object
+ * which aren't in the struct are skipped.
+ *
+ * @return false on an error, described by reader.error().
+ */
+template <typename T>
+bool readJson(JsonReader &reader, T &value)
+{
+    if constexpr (internal::IsReflected<T>::value)
+    {
+        if (!reader.startObject())
+            return false;
+        std::string key;
+        while (reader.nextMember(key))
+        {
+            bool found = false;
+            drogonReflect(value, [&](const char *name, auto &member) {
+                if (!found && key == name)
+                {
+                    found = true;
+                    readJson(reader, member);
+                }
+            });
+            if (!found)
+                reader.skipValue();
+        }
+        return reader.good();
+    }
+    else if constexpr (std::is_same_v<T, bool>)
+    {
+        return reader.readBool(value);
+    }
+    else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, char>)
+    {
+        return reader.readInteger(value);
+    }
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        double d;
+        if (!reader.readDouble(d))
+            return false;
+        value = static_cast<T>(d);
+        return true;
+    }
+    else if constexpr (std::is_enum_v<T>)
+    {
+        internal::EnumInteger<T> n;
+        if (!reader.readInteger(n))
+            return false;
+        value = static_cast<T>(n);
+        return true;
+    }
+    else if constexpr (std::is_same_v<T, std::string>)
+    {
+        return reader.readString(value);
+    }
+    else if constexpr (std::is_same_v<T, Json::Value>)
+    {
+        return reader.readValue(value);
+    }
+    else if constexpr (internal::IsOptional<T>::value ||
+                       internal::IsSmartPointer<T>::value)
+    {
+        if (reader.peek() == JsonReader::Token::kNull)
+        {
+            value.reset();
+            return reader.readNull();
+        }
+        if constexpr (internal::IsOptional<T>::value)
+            value.emplace();
+        else
+            value.reset(new typename T::element_type());
+        return readJson(reader, *value);
+    }
+    else if constexpr (internal::IsStringMap<T>::value)
+    {
+        value.clear();
+        if (!reader.startObject())
+            return false;
+        std::string key;
+        while (reader.nextMember(key))
+        {
+            if (!readJson(reader, value[key]))
+                return false;
+        }
+        return reader.good();
+    }
+    else if constexpr (internal::IsRange<T>::value)
+    {
+        value.clear();
+        if (!reader.startArray())
+            return false;
+        while (reader.nextElement())
+        {
+            typename T::value_type element{};
+            if (!readJson(reader, element))
+                return false;
+            if constexpr (internal::HasPushBack<T>::value)
+                value.push_back(std::move(element));
+            else
+                value.insert(std::move(element));
+        }
+        return reader.good();
+    }
+    else
+    {
+        static_assert(internal::alwaysFalse<T>,
+                      "The type can't be read from JSON, use DROGON_REFLECT");
+    }
+}
+
+/// Write a value as compact JSON text, see writeJson().
+template <typename T>
+std::string toJsonString(const T &value,
+                         const JsonWriter::Options &options = {})
+{
+    std::string output;
+    JsonWriter writer(output, options);
+    writeJson(writer, value);
+    return output;
+}
+
+/**
+ * @brief Read a value from JSON text, see readJson().
+ *
+ * @param errors The description of the error if the text is invalid.
+ * @return false if the text is invalid.
+ */
+template <typename T>
+bool fromJsonString(std::string_view text,
+                    T &value,
+                    std::string *errors = nullptr)
+{
+    JsonReader reader(text);
+    if (readJson(reader, value) && reader.finish())
+        return true;
+    if (errors)
+        *errors = reader.error();
+    return false;
+}
+}  // namespace drogon
@@ -0,0 +1,207 @@
+/**
+ *
+ *  @file JsonWriter.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <json/value.h>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace drogon
+{
+/**
+ * @brief A writer of compact JSON text appended straight to a string, without
+ * building a Json::Value tree. The output matches the one of the jsoncpp
+ * writers configured by the framework.
+ *
+ * @code
+   std::string body;
+   JsonWriter writer(body);
+   writer.startObject();
+   writer.member("id", 42);
+   writer.key("tags");
+   writer.startArray();
+   writer.value("a");
+   writer.endArray();
+   writer.endObject();
+   @endcode
+ *
+ * The writer doesn't check the structure of the document, the caller must
+ * balance the start and end calls and write a key before every member.
+ */
+class DROGON_EXPORT JsonWriter
+{
+  public:
+    struct Options
+    {
+        // Escape the non-ASCII characters of the strings as \uXXXX
+        bool escapeUnicode{true};
+        // The precision of the floating point numbers, 0 for the default
+        unsigned int precision{0};
+        // Count the precision as the digits after the decimal point instead
+        // of the significant digits
+        bool decimalPrecision{false};
+    };
+
+    explicit JsonWriter(std::string &output, const Options &options)
+        : output_(output), options_(options)
+    {
+    }
+
+    explicit JsonWriter(std::string &output) : output_(output)
+    {
+    }
+
+    /// The options set for the JSON text of the framework by the application
+    static Options appOptions();
+
+    void startObject()
+    {
+        separate();
+        output_.push_back('{');
+        needComma_ = false;
+    }
+
+    void endObject()
+    {
+        output_.push_back('}');
+        needComma_ = true;
+    }
+
+    void startArray()
+    {
+        separate();
+        output_.push_back('[');
+        needComma_ = false;
+    }
+
+    void endArray()
+    {
+        output_.push_back(']');
+        needComma_ = true;
+    }
+
+    /// Write the key of the next member of an object.
+    void key(std::string_view name)
+    {
+        separate();
+        writeString(name);
+        output_.push_back(':');
+        needComma_ = false;
+    }
+
+    void null()
+    {
+        separate();
+        output_.append("null", 4);
+        needComma_ = true;
+    }
+
+    void value(std::nullptr_t)
+    {
+        null();
+    }
+
+    void value(bool b)
+    {
+        separate();
+        if (b)
+            output_.append("true", 4);
+        else
+            output_.append("false", 5);
+        needComma_ = true;
+    }
+
+    template <typename T,
+              std::enable_if_t<std::is_integral_v<T> &&
+                                   !std::is_same_v<T, bool> &&
+                                   !std::is_same_v<T, char>,
+                               int> = 0>
+    void value(T number)
+    {
+        separate();
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+        output_.append(buffer, result.ptr - buffer);
+        needComma_ = true;
+    }
+
+    void value(double number);
+
+    void value(float number)
+    {
+        value(static_cast<double>(number));
+    }
+
+    void value(std::string_view str)
+    {
+        separate();
+        writeString(str);
+        needComma_ = true;
+    }
+
+    void value(const char *str)
+    {
+        value(std::string_view(str));
+    }
+
+    void value(const std::string &str)
+    {
+        value(std::string_view(str));
+    }
+
+    void value(const Json::Value &json);
+
+    /// Write a member of an object.
+    template <typename T>
+    void member(std::string_view name, const T &v)
+    {
+        key(name);
+        value(v);
+    }
+
+    /**
+     * @brief Append a value which is already JSON text, e.g. a cached part of
+     * a document.
+     */
+    void raw(std::string_view json)
+    {
+        separate();
+        output_.append(json.data(), json.length());
+        needComma_ = true;
+    }
+
+    std::string &output()
+    {
+        return output_;
+    }
+
+  private:
+    void separate()
+    {
+        if (needComma_)
+            output_.push_back(',');
+    }
+
+    void writeString(std::string_view str);
+
+    std::string &output_;
+    Options options_;
+    bool needComma_{false};
+};
+}  // namespace drogon
@@ -0,0 +1,221 @@
+/**
+ *
+ *  MonotonicArena.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/utils/NonCopyable.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace drogon
+{
+/**
+ * @brief A monotonic memory arena. Memory is carved from big blocks by bumping
+ * a pointer, deallocation does nothing, and all memory is released at once by
+ * reset() or the destructor. The largest block is kept by reset(), so an arena
+ * which is reused for similar workloads stops calling malloc after warming up.
+ *
+ * Objects created in the arena are never destructed, so only trivially
+ * destructible objects can be created by create(); containers using
+ * ArenaAllocator must be destroyed before the arena is reset.
+ *
+ * @note This class is not thread safe.
+ */
+class MonotonicArena : public trantor::NonCopyable
+{
+  public:
+    explicit MonotonicArena(size_t blockSize = 4096) : blockSize_(blockSize)
+    {
+    }
+
+    ~MonotonicArena()
+    {
+        while (head_)
+        {
+            auto next = head_->next;
+            std::free(head_);
+            head_ = next;
+        }
+    }
+
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        auto p = alignUp(current_, alignment);
+        if (!head_ || p > end_ || static_cast<size_t>(end_ - p) < bytes)
+        {
+            newBlock(bytes + alignment);
+            p = alignUp(current_, alignment);
+        }
+        current_ = p + bytes;
+        bytesAllocated_ += bytes;
+        return p;
+    }
+
+    template <typename T, typename... Args>
+    T *create(Args &&...args)
+    {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "Objects in the arena are never destructed");
+        return new (allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Copy the string to the arena, the returned view is valid until
+     * the arena is reset.
+     */
+    std::string_view copy(std::string_view str)
+    {
+        if (str.empty())
+            return {};
+        auto p = static_cast<char *>(allocate(str.size(), 1));
+        memcpy(p, str.data(), str.size());
+        return std::string_view(p, str.size());
+    }
+
+    /**
+     * @brief Release all memory allocated from the arena. The largest block
+     * is kept for later allocations.
+     */
+    void reset()
+    {
+        Block *largest = head_;
+        for (auto b = head_; b; b = b->next)
+        {
+            if (b->size > largest->size)
+                largest = b;
+        }
+        while (head_)
+        {
+            auto next = head_->next;
+            if (head_ != largest)
+                std::free(head_);
+            head_ = next;
+        }
+        head_ = largest;
+        if (head_)
+        {
+            head_->next = nullptr;
+            current_ = head_->data();
+            end_ = current_ + head_->size;
+        }
+        bytesAllocated_ = 0;
+    }
+
+    /// Return the number of bytes allocated since the last reset
+    size_t bytesAllocated() const
+    {
+        return bytesAllocated_;
+    }
+
+  private:
+    struct Block
+    {
+        Block *next;
+        size_t size;
+
+        char *data()
+        {
+            return reinterpret_cast<char *>(this) + sizeof(Block);
+        }
+    };
+
+    static char *alignUp(char *p, size_t alignment)
+    {
+        auto v = reinterpret_cast<uintptr_t>(p);
+        v = (v + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        return reinterpret_cast<char *>(v);
+    }
+
+    void newBlock(size_t minSize)
+    {
+        // Blocks grow geometrically so that a busy arena uses few blocks
+        auto size = (std::max)(minSize, blockSize_);
+        if (head_)
+            size = (std::max)(size, head_->size * 2);
+        auto block = static_cast<Block *>(std::malloc(sizeof(Block) + size));
+        if (!block)
+            throw std::bad_alloc();
+        block->next = head_;
+        block->size = size;
+        head_ = block;
+        current_ = block->data();
+        end_ = current_ + size;
+    }
+
+    size_t blockSize_;
+    Block *head_{nullptr};
+    char *current_{nullptr};
+    char *end_{nullptr};
+    size_t bytesAllocated_{0};
+};
+
+/**
+ * @brief A std allocator allocating from a MonotonicArena, for example:
+ * @code
+   std::vector<int, ArenaAllocator<int>> v(ArenaAllocator<int>(req->arena()));
+   @endcode
+ */
+template <typename T>
+class ArenaAllocator
+{
+  public:
+    using value_type = T;
+
+    explicit ArenaAllocator(MonotonicArena &arena) noexcept : arena_(&arena)
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+        : arena_(other.arena())
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, size_t) noexcept
+    {
+    }
+
+    MonotonicArena *arena() const noexcept
+    {
+        return arena_;
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const noexcept
+    {
+        return arena_ == other.arena();
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const noexcept
+    {
+        return arena_ != other.arena();
+    }
+
+  private:
+    MonotonicArena *arena_;
+};
+}  // namespace drogon
@@ -0,0 +1,104 @@
+/**
+ *
+ *  @file SingleFlight.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief Share one execution among the concurrent calls with the same key.
+ *
+ * The first call of a key starts an execution, the calls of the key arriving
+ * before it's done only add their callbacks, and all the callbacks are called
+ * with its results. The calls arriving after that start a new execution,
+ * nothing is cached.
+ *
+ * @code
+   SingleFlight<ReqResult, const HttpResponsePtr &> flights;
+   flights.run(key, std::move(callback), [client, req](auto &&done) {
+       client->sendRequest(req, std::move(done));
+   });
+   @endcode
+ *
+ * @note The object is thread-safe, each execution may outlive it. The
+ * callbacks are called by the thread finishing the execution and share the
+ * same results, which they shouldn't modify.
+ */
+template <typename... Results>
+class SingleFlight
+{
+  public:
+    using Callback = std::function<void(Results...)>;
+
+    /**
+     * @brief Start the execution of a key, or wait for the one in progress.
+     *
+     * @param start Called with the callback to call exactly once when the
+     * execution is done, only if no execution of the key is in progress.
+     * @return true if the call started a new execution.
+     */
+    template <typename Start>
+    bool run(const std::string &key, Callback &&callback, Start &&start)
+    {
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            auto iter = state_->flights.find(key);
+            if (iter != state_->flights.end())
+            {
+                iter->second.emplace_back(std::move(callback));
+                return false;
+            }
+            state_->flights[key].emplace_back(std::move(callback));
+        }
+        start(Callback([state = state_, key](Results... results) {
+            std::vector<Callback> callbacks;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                auto iter = state->flights.find(key);
+                if (iter == state->flights.end())
+                    return;
+                callbacks = std::move(iter->second);
+                state->flights.erase(iter);
+            }
+            for (auto &cb : callbacks)
+                cb(results...);
+        }));
+        return true;
+    }
+
+    /// The number of executions in progress.
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->flights.size();
+    }
+
+  private:
+    struct State
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::vector<Callback>> flights;
+    };
+
+    std::shared_ptr<State> state_{std::make_shared<State>()};
+};
+}  // namespace drogon
@@ -340,6 +340,20 @@ inline std::string joinStringViews(const std::set<std::string_view> &strs,
 /// Get UUID string.
 DROGON_EXPORT std::string getUuid(bool lowercase = true);
 
+/**
+ * @brief Get a random (version 4) UUID string made by secureRandomBytes(),
+ * without a system call for most UUIDs unlike getUuid().
+ */
+DROGON_EXPORT std::string getUuidV4(bool lowercase = true);
+
+/**
+ * @brief Get a time-ordered (version 7, rfc9562) UUID string. The UUIDs made
+ * by a process are strictly increasing, so they keep the indexes of the
+ * primary keys compact. Their first 48 bits are the creation time in
+ * milliseconds, don't use them where the time must not be disclosed.
+ */
+DROGON_EXPORT std::string getUuidV7(bool lowercase = true);
+
 /// Get the encoded length of base64.
 constexpr size_t base64EncodedLength(size_t in_len, bool padded = true)
 {
@@ -492,6 +506,15 @@ inline std::string getBlake2b(const std::string &originalString)
 DROGON_EXPORT std::string gzipCompress(const char *data, const size_t ndata);
 DROGON_EXPORT std::string gzipDecompress(const char *data, const size_t ndata);
 
+/// Compress data using gzip lib with the compression level.
+/**
+ * @param level from 1 (best speed) to 9 (best compression), -1 means the
+ * default level.
+ */
+DROGON_EXPORT std::string gzipCompress(const char *data,
+                                       const size_t ndata,
+                                       int level);
+
 /// Compress or decompress data using brotli lib.
 /**
  * @param data the input data
@@ -501,6 +524,27 @@ DROGON_EXPORT std::string brotliCompress(const char *data, const size_t ndata);
 DROGON_EXPORT std::string brotliDecompress(const char *data,
                                            const size_t ndata);
 
+/// Compress data using brotli lib with the quality.
+/**
+ * @param quality from 0 (best speed) to 11 (best compression), the quality
+ * used by the above method is 5.
+ */
+DROGON_EXPORT std::string brotliCompress(const char *data,
+                                         const size_t ndata,
+                                         int quality);
+
+/// Compress or decompress data using zstd lib.
+/**
+ * @param data the input data
+ * @param ndata the input data length
+ * @param level from 1 (best speed) to 19 (best compression), 3 is the default
+ * level of zstd.
+ */
+DROGON_EXPORT std::string zstdCompress(const char *data,
+                                       const size_t ndata,
+                                       int level = 3);
+DROGON_EXPORT std::string zstdDecompress(const char *data, const size_t ndata);
+
 /// Get the http full date string
 /**
  * rfc2616-3.3.1
@@ -656,6 +700,9 @@ DROGON_EXPORT void replaceAll(std::string &s,
 /**
  * @brief Generates cryptographically secure random bytes.
  *
+ * The bytes come from a ChaCha20 generator of the current thread which is
+ * seeded from the OS, so small requests don't make a system call.
+ *
  * @param ptr the pointer which the random bytes are stored to
  * @param size number of bytes to generate
  *
@@ -23,9 +23,14 @@
 #include <coroutine>
 #include <exception>
 #include <future>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
 #include <type_traits>
 #include <optional>
+#include <utility>
+#include <vector>
 
 namespace drogon
 {
@@ -87,6 +92,144 @@ struct is_awaitable<
 template <typename T>
 constexpr bool is_awaitable_v = is_awaitable<T>::value;
 
+namespace internal
+{
+// DROGON_CORO_FRAME_POOL is defined for the whole build by the drogon target,
+// see the USE_CORO_FRAME_POOL option, since every translation unit must agree
+// on the operator new and delete of the promise types. The frames use the
+// global allocator when it is not defined.
+#ifndef DROGON_CORO_FRAME_POOL
+#define DROGON_CORO_FRAME_POOL 0
+#endif
+
+/**
+ * @brief Per-thread free lists of coroutine frames, by size classes of 64
+ * bytes up to 2KB.
+ *
+ * The frames of Task and AsyncTask are allocated from the lists of the current
+ * thread and returned to the lists of the thread destroying them, up to 64
+ * frames per class. The larger frames use the global allocator.
+ */
+class CoroFramePool
+{
+  public:
+    static void *allocate(size_t size)
+    {
+        auto index = classIndex(size);
+        if (index >= kClassCount)
+            return ::operator new(size);
+        // The blocks of a class are always allocated with its full size,
+        // since deallocate() may put them in the list of another thread.
+        auto pool = local();
+        if (pool == nullptr)
+            return ::operator new((index + 1) * kGranularity);
+        auto &freeList = pool->freeLists_[index];
+        if (freeList.head)
+        {
+            auto block = freeList.head;
+            freeList.head = block->next;
+            --freeList.count;
+            return block;
+        }
+        return ::operator new((index + 1) * kGranularity);
+    }
+
+    static void deallocate(void *ptr, size_t size) noexcept
+    {
+        auto index = classIndex(size);
+        auto pool = local();
+        if (index >= kClassCount || pool == nullptr ||
+            pool->freeLists_[index].count >= kMaxFreeFrames)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+        auto &freeList = pool->freeLists_[index];
+        auto block = static_cast<Block *>(ptr);
+        block->next = freeList.head;
+        freeList.head = block;
+        ++freeList.count;
+    }
+
+    /// False if the frames always use the global allocator.
+    static bool enabled() noexcept
+    {
+        return local() != nullptr;
+    }
+
+    ~CoroFramePool()
+    {
+        destroyed() = true;
+        for (auto &freeList : freeLists_)
+        {
+            while (freeList.head)
+            {
+                auto block = freeList.head;
+                freeList.head = block->next;
+                ::operator delete(block);
+            }
+        }
+    }
+
+  private:
+    static constexpr size_t kGranularity = 64;
+    static constexpr size_t kClassCount = 32;
+    static constexpr size_t kMaxFreeFrames = 64;
+
+    struct Block
+    {
+        Block *next;
+    };
+
+    struct FreeList
+    {
+        Block *head{nullptr};
+        size_t count{0};
+    };
+
+    static size_t classIndex(size_t size) noexcept
+    {
+        return size == 0 ? 0 : (size - 1) / kGranularity;
+    }
+
+    // The frames destroyed after the pool of the thread (e.g. by other
+    // thread_local objects) go to the global allocator.
+    static bool &destroyed() noexcept
+    {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    static CoroFramePool *local() noexcept
+    {
+#if DROGON_CORO_FRAME_POOL
+        if (destroyed())
+            return nullptr;
+        static thread_local CoroFramePool pool;
+        return &pool;
+#else
+        return nullptr;
+#endif
+    }
+
+    FreeList freeLists_[kClassCount];
+};
+
+/// The base of the promise types, allocating their frames from the pool.
+struct PooledFrame
+{
+    static void *operator new(size_t size)
+    {
+        return CoroFramePool::allocate(size);
+    }
+
+    static void operator delete(void *ptr, size_t size) noexcept
+    {
+        CoroFramePool::deallocate(ptr, size);
+    }
+};
+}  // namespace internal
+
 /**
  * @struct final_awaiter
  * @brief An awaiter for `Task::promise_type::final_suspend()`. Transfer
@@ -194,7 +337,7 @@ struct [[nodiscard]] Task
         return *this;
     }
 
-    struct promise_type
+    struct promise_type : internal::PooledFrame
     {
         Task<T> get_return_object()
         {
@@ -298,7 +441,7 @@ struct [[nodiscard]] Task<void>
         return *this;
     }
 
-    struct promise_type
+    struct promise_type : internal::PooledFrame
     {
         Task<> get_return_object()
         {
@@ -382,7 +525,7 @@ struct AsyncTask
         return *this;
     }
 
-    struct promise_type
+    struct promise_type : internal::PooledFrame
     {
         AsyncTask get_return_object() noexcept
         {
@@ -773,6 +916,17 @@ std::function<void()> async_func(Coro &&coro)
     };
 }
 
+/**
+ * @brief Thrown by the awaiters of timeoutCoro() when the task is too slow.
+ */
+class TimeoutException final : public std::runtime_error
+{
+  public:
+    TimeoutException() : std::runtime_error("Timeout")
+    {
+    }
+};
+
 namespace internal
 {
 template <typename T>
@@ -986,6 +1140,175 @@ struct WhenAllAwaiter<std::vector<Task<void>>> : public CallbackAwaiter<void>
     std::atomic<size_t> counter_;
     std::atomic_flag exceptionFlag_;
 };
+
+template <typename T>
+using when_any_result_t =
+    std::conditional_t<std::is_void_v<T>, size_t, std::pair<size_t, T>>;
+
+template <typename T>
+struct [[nodiscard]] WhenAnyAwaiter
+    : public CallbackAwaiter<when_any_result_t<T>>
+{
+    WhenAnyAwaiter(std::vector<Task<T>> &&tasks,
+                   std::shared_ptr<std::atomic<bool>> &&cancelled)
+        : tasks_(std::move(tasks)), cancelled_(std::move(cancelled))
+    {
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        if (tasks_.empty())
+        {
+            this->setException(std::make_exception_ptr(
+                std::invalid_argument("when_any() needs at least one task")));
+            handle.resume();
+            return;
+        }
+        auto state = std::make_shared<State>();
+        state->awaiter = this;
+        state->handle = handle;
+        state->remaining = tasks_.size();
+        state->cancelled = std::move(cancelled_);
+        // The winner may resume the caller and destroy this before the last
+        // task is started.
+        auto tasks = std::move(tasks_);
+        for (size_t i = 0; i < tasks.size(); ++i)
+            run(state, std::move(tasks[i]), i);
+    }
+
+  private:
+    // Shared with the tasks, the losers may outlive the awaiter.
+    struct State
+    {
+        WhenAnyAwaiter *awaiter{nullptr};
+        std::coroutine_handle<> handle;
+        // The tasks which haven't failed.
+        std::atomic<size_t> remaining{0};
+        std::atomic_flag done = ATOMIC_FLAG_INIT;
+        std::atomic_flag failed = ATOMIC_FLAG_INIT;
+        std::exception_ptr exception;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+    static AsyncTask run(std::shared_ptr<State> state,
+                         Task<T> task,
+                         size_t index)
+    {
+        std::optional<void_to_false_t<T>> result;
+        std::exception_ptr exception;
+        try
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                co_await task;
+                result.emplace();
+            }
+            else
+            {
+                result.emplace(co_await task);
+            }
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        if (result)
+        {
+            if (state->done.test_and_set(std::memory_order_acq_rel))
+                co_return;
+            if (state->cancelled)
+                state->cancelled->store(true, std::memory_order_release);
+            if constexpr (std::is_void_v<T>)
+                state->awaiter->setValue(index);
+            else
+                state->awaiter->setValue(
+                    std::make_pair(index, std::move(*result)));
+            state->handle.resume();
+            co_return;
+        }
+        if (!state->failed.test_and_set(std::memory_order_acq_rel))
+            state->exception = exception;
+        if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+            !state->done.test_and_set(std::memory_order_acq_rel))
+        {
+            state->awaiter->setException(state->exception);
+            state->handle.resume();
+        }
+    }
+
+    std::vector<Task<T>> tasks_;
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+template <typename T>
+struct [[nodiscard]] TimeoutAwaiter : public CallbackAwaiter<T>
+{
+    TimeoutAwaiter(trantor::EventLoop *loop, double delay, Task<T> &&task)
+        : loop_(loop), delay_(delay), task_(std::move(task))
+    {
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        auto state = std::make_shared<State>();
+        state->awaiter = this;
+        state->handle = handle;
+        state->loop = loop_;
+        // Started first so that the task can invalidate it when it's done.
+        state->timerId = loop_->runAfter(delay_, [state]() {
+            if (state->done.test_and_set(std::memory_order_acq_rel))
+                return;
+            state->awaiter->setException(
+                std::make_exception_ptr(TimeoutException()));
+            state->handle.resume();
+        });
+        run(state, std::move(task_));
+    }
+
+  private:
+    struct State
+    {
+        TimeoutAwaiter *awaiter{nullptr};
+        std::coroutine_handle<> handle;
+        trantor::EventLoop *loop{nullptr};
+        trantor::TimerId timerId{};
+        std::atomic_flag done = ATOMIC_FLAG_INIT;
+    };
+
+    static AsyncTask run(std::shared_ptr<State> state, Task<T> task)
+    {
+        std::optional<void_to_false_t<T>> result;
+        std::exception_ptr exception;
+        try
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                co_await task;
+                result.emplace();
+            }
+            else
+            {
+                result.emplace(co_await task);
+            }
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        if (state->done.test_and_set(std::memory_order_acq_rel))
+            co_return;
+        state->loop->invalidateTimer(state->timerId);
+        if (exception)
+            state->awaiter->setException(exception);
+        else if constexpr (!std::is_void_v<T>)
+            state->awaiter->setValue(std::move(*result));
+        state->handle.resume();
+    }
+
+    trantor::EventLoop *loop_;
+    double delay_;
+    Task<T> task_;
+};
 }  // namespace internal
 
 /**
@@ -1175,6 +1498,278 @@ class Mutex final
     CoroMutexAwaiter *waiters_;
 };
 
+/**
+ * @brief An asynchronous counting semaphore, to bound the number of tasks
+ * doing something concurrently.
+ *
+ * @code
+   static Semaphore semaphore(16);
+   co_await semaphore.acquire();
+   auto resp = co_await client->sendRequestCoro(req);
+   semaphore.release();
+   @endcode
+ *
+ * The waiters are resumed in their order of arrival, in the event loop given
+ * to acquire() if any. The object is thread-safe.
+ */
+class Semaphore final
+{
+    class SemaphoreAwaiter;
+
+  public:
+    explicit Semaphore(size_t count) noexcept : count_(count)
+    {
+    }
+
+    Semaphore(const Semaphore &) = delete;
+    Semaphore(Semaphore &&) = delete;
+    Semaphore &operator=(const Semaphore &) = delete;
+    Semaphore &operator=(Semaphore &&) = delete;
+
+    ~Semaphore()
+    {
+        assert(head_ == nullptr);
+    }
+
+    bool try_acquire() noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ == 0)
+            return false;
+        --count_;
+        return true;
+    }
+
+    [[nodiscard]] SemaphoreAwaiter acquire(
+        trantor::EventLoop *loop =
+            trantor::EventLoop::getEventLoopOfCurrentThread()) noexcept
+    {
+        return SemaphoreAwaiter(*this, loop);
+    }
+
+    void release() noexcept
+    {
+        SemaphoreAwaiter *waiter;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (head_ == nullptr)
+            {
+                ++count_;
+                return;
+            }
+            // The permit is handed over to the first waiter.
+            waiter = head_;
+            head_ = waiter->next_;
+            if (head_ == nullptr)
+                tail_ = nullptr;
+        }
+        if (waiter->loop_)
+        {
+            auto handle = waiter->handle_;
+            waiter->loop_->runInLoop([handle] { handle.resume(); });
+        }
+        else
+        {
+            waiter->handle_.resume();
+        }
+    }
+
+    /// The number of permits which can be acquired without waiting.
+    size_t available() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count_;
+    }
+
+  private:
+    class SemaphoreAwaiter
+    {
+      public:
+        SemaphoreAwaiter(Semaphore &semaphore,
+                         trantor::EventLoop *loop) noexcept
+            : semaphore_(semaphore), loop_(loop)
+        {
+        }
+
+        bool await_ready() noexcept
+        {
+            return semaphore_.try_acquire();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+            handle_ = handle;
+            return semaphore_.enqueue(this);
+        }
+
+        void await_resume() noexcept
+        {
+        }
+
+      private:
+        friend class Semaphore;
+
+        Semaphore &semaphore_;
+        trantor::EventLoop *loop_;
+        std::coroutine_handle<> handle_;
+        SemaphoreAwaiter *next_{nullptr};
+    };
+
+    // Returns false if a permit was released in the meantime.
+    bool enqueue(SemaphoreAwaiter *awaiter) noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ > 0)
+        {
+            --count_;
+            return false;
+        }
+        if (tail_)
+            tail_->next_ = awaiter;
+        else
+            head_ = awaiter;
+        tail_ = awaiter;
+        return true;
+    }
+
+    mutable std::mutex mutex_;
+    size_t count_;
+    SemaphoreAwaiter *head_{nullptr};
+    SemaphoreAwaiter *tail_{nullptr};
+};
+
+/**
+ * @brief Run tasks concurrently with a bounded concurrency, and wait for all
+ * of them.
+ *
+ * @code
+   TaskGroup group(8);
+   for (auto &url : urls)
+       group.spawn(fetch(url));
+   co_await group.wait();
+   @endcode
+ *
+ * The spawned tasks are started at once while fewer than maxConcurrency of
+ * them are running, and queued otherwise. wait() resumes when all of them are
+ * done and rethrows the first exception they threw. Only one coroutine may
+ * wait at a time, the tasks may outlive the group.
+ */
+class TaskGroup final
+{
+    class WaitAwaiter;
+
+  public:
+    explicit TaskGroup(
+        size_t maxConcurrency = (std::numeric_limits<size_t>::max)())
+        : state_(std::make_shared<State>(maxConcurrency))
+    {
+        assert(maxConcurrency > 0);
+    }
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    void spawn(Task<> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            ++state_->pending;
+        }
+        run(state_, std::move(task));
+    }
+
+    [[nodiscard]] WaitAwaiter wait() noexcept
+    {
+        return WaitAwaiter(*state_);
+    }
+
+    /// The number of the tasks which are not done yet.
+    size_t pending() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->pending;
+    }
+
+  private:
+    struct State
+    {
+        explicit State(size_t maxConcurrency) : semaphore(maxConcurrency)
+        {
+        }
+
+        Semaphore semaphore;
+        std::mutex mutex;
+        size_t pending{0};
+        std::exception_ptr exception;
+        std::coroutine_handle<> waiter;
+    };
+
+    class WaitAwaiter
+    {
+      public:
+        explicit WaitAwaiter(State &state) noexcept : state_(state)
+        {
+        }
+
+        bool await_ready() noexcept
+        {
+            std::lock_guard<std::mutex> lock(state_.mutex);
+            return state_.pending == 0;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+            std::lock_guard<std::mutex> lock(state_.mutex);
+            if (state_.pending == 0)
+                return false;
+            assert(!state_.waiter);
+            state_.waiter = handle;
+            return true;
+        }
+
+        void await_resume() noexcept(false)
+        {
+            std::exception_ptr exception;
+            {
+                std::lock_guard<std::mutex> lock(state_.mutex);
+                exception = std::exchange(state_.exception, nullptr);
+            }
+            if (exception)
+                std::rethrow_exception(exception);
+        }
+
+      private:
+        State &state_;
+    };
+
+    static AsyncTask run(std::shared_ptr<State> state, Task<> task)
+    {
+        co_await state->semaphore.acquire();
+        std::exception_ptr exception;
+        try
+        {
+            co_await task;
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        state->semaphore.release();
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (exception && !state->exception)
+                state->exception = exception;
+            if (--state->pending == 0)
+                waiter = std::exchange(state->waiter, nullptr);
+        }
+        if (waiter)
+            waiter.resume();
+    }
+
+    std::shared_ptr<State> state_;
+};
+
 template <typename... Tasks>
 internal::WhenAllAwaiter<Tasks...> when_all(Tasks... tasks)
 {
@@ -1194,4 +1789,55 @@ inline internal::WhenAllAwaiter<std::vector<Task<void>>> when_all(
     return internal::WhenAllAwaiter(std::move(tasks));
 }
 
+/**
+ * @brief Run the tasks concurrently and resume with the first one to succeed.
+ *
+ * @return The index of the first task to succeed, with its result unless the
+ * tasks return void. The exception of the first task to fail is thrown if all
+ * of them fail.
+ * @param cancelled If not null, set to true when a task has succeeded.
+ * The other tasks keep running and their results are dropped, they may check
+ * the flag to stop early, e.g. to issue hedged requests:
+ * @code
+   auto cancelled = std::make_shared<std::atomic<bool>>(false);
+   std::vector<Task<HttpResponsePtr>> tasks;
+   for (auto &client : replicas)
+       tasks.push_back(fetch(client, req, cancelled));
+   auto [index, resp] = co_await when_any(std::move(tasks), cancelled);
+   @endcode
+ */
+template <typename T>
+internal::WhenAnyAwaiter<T> when_any(
+    std::vector<Task<T>> tasks,
+    std::shared_ptr<std::atomic<bool>> cancelled = nullptr)
+{
+    return internal::WhenAnyAwaiter<T>(std::move(tasks), std::move(cancelled));
+}
+
+/**
+ * @brief Await a task with a time limit, TimeoutException is thrown if it
+ * isn't done after the delay.
+ *
+ * The task keeps running after a timeout and its result is dropped. The
+ * coroutine is resumed by the thread of the task, or by the loop on timeout.
+ */
+template <typename T>
+internal::TimeoutAwaiter<T> timeoutCoro(
+    trantor::EventLoop *loop,
+    const std::chrono::duration<double> &delay,
+    Task<T> task)
+{
+    assert(loop);
+    return internal::TimeoutAwaiter<T>(loop, delay.count(), std::move(task));
+}
+
+template <typename T>
+internal::TimeoutAwaiter<T> timeoutCoro(trantor::EventLoop *loop,
+                                        double delay,
+                                        Task<T> task)
+{
+    assert(loop);
+    return internal::TimeoutAwaiter<T>(loop, delay, std::move(task));
+}
+
 }  // namespace drogon
@@ -21,6 +21,7 @@
 #include <string_view>
 #include <vector>
 #include <mutex>
+#include <shared_mutex>
 #include <map>
 #include <algorithm>
 #include <memory>
@@ -71,7 +72,16 @@ class Collector : public CollectorBase
                 "The number of label values is not equal to the number of "
                 "label names!");
         }
-        std::lock_guard<std::mutex> guard(mutex_);
+        {
+            // Metrics are rarely added, so lookups share the lock.
+            std::shared_lock<std::shared_mutex> guard(mutex_);
+            auto iter = metrics_.find(labelValues);
+            if (iter != metrics_.end())
+            {
+                return iter->second;
+            }
+        }
+        std::lock_guard<std::shared_mutex> guard(mutex_);
         auto iter = metrics_.find(labelValues);
         if (iter != metrics_.end())
         {
@@ -85,7 +95,7 @@ class Collector : public CollectorBase
 
     std::vector<SamplesGroup> collect() const override
     {
-        std::lock_guard<std::mutex> guard(mutex_);
+        std::shared_lock<std::shared_mutex> guard(mutex_);
         std::vector<SamplesGroup> samples;
         for (auto &pair : metrics_)
         {
@@ -129,7 +139,7 @@ class Collector : public CollectorBase
     const std::string help_;
     const std::vector<std::string> labelsNames_;
     std::map<std::vector<std::string>, std::shared_ptr<T>> metrics_;
-    mutable std::mutex mutex_;
+    mutable std::shared_mutex mutex_;
 };
 }  // namespace monitoring
 }  // namespace drogon
@@ -14,15 +14,17 @@
 
 #pragma once
 #include <drogon/utils/monitoring/Metric.h>
+#include <drogon/utils/monitoring/ThreadCells.h>
 #include <string_view>
-#include <mutex>
 
 namespace drogon
 {
 namespace monitoring
 {
 /**
- * This class is used to collect samples for a counter metric.
+ * This class is used to collect samples for a counter metric. Increments
+ * don't take any lock, the value is summed up from per-thread cells when the
+ * counter is collected.
  * */
 class Counter : public Metric
 {
@@ -38,10 +40,7 @@ class Counter : public Metric
     {
         Sample s;
         s.name = name_;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            s.value = value_;
-        }
+        s.value = cells_.sum();
         return {s};
     }
 
@@ -50,8 +49,7 @@ class Counter : public Metric
      * */
     void increment()
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        value_++;
+        cells_.add(uint64_t(1));
     }
 
     /**
@@ -59,14 +57,12 @@ class Counter : public Metric
      * */
     void increment(double value)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        value_ += value;
+        cells_.add(value);
     }
 
     void reset()
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        value_ = 0;
+        cells_.reset();
     }
 
     static std::string_view type()
@@ -75,8 +71,7 @@ class Counter : public Metric
     }
 
   private:
-    mutable std::mutex mutex_;
-    double value_{0};
+    internal::ThreadCells cells_;
 };
 }  // namespace monitoring
 }  // namespace drogon
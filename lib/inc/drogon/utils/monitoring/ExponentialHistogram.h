@@ -0,0 +1,95 @@
+/**
+ *
+ *  ExponentialHistogram.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+#include <drogon/exports.h>
+#include <drogon/utils/monitoring/Metric.h>
+#include <drogon/utils/monitoring/ThreadCells.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+namespace drogon
+{
+namespace monitoring
+{
+/**
+ * @brief A histogram whose buckets grow exponentially, like the native
+ * histograms of Prometheus, so the relative error of the quantiles is the
+ * same for all values.
+ *
+ * The upper bound of the bucket i is minValue * 2^(i / 2^schema), e.g. with
+ * the default schema 3 every bucket is about 9% wider than the previous one.
+ * Values not greater than minValue are counted in the first bucket and values
+ * greater than maxValue in the +Inf bucket. Observations are counted in
+ * per-thread cells without any lock and the cells are merged when the
+ * histogram is collected. Only the non-empty buckets are exported, a bucket
+ * never becomes empty again since the counts are cumulative.
+ *
+ * For example, a collector of latencies in seconds:
+ * @code
+   auto collector = std::make_shared<Collector<ExponentialHistogram>>(
+       "request_latency_seconds", "The latency of the requests",
+       std::vector<std::string>{"route"});
+   collector->metric({"/api/users"}, 3, 1e-6, 100.0)->observe(0.0042);
+   @endcode
+ */
+class DROGON_EXPORT ExponentialHistogram : public Metric
+{
+  public:
+    ExponentialHistogram(const std::string &name,
+                         const std::vector<std::string> &labelNames,
+                         const std::vector<std::string> &labelValues,
+                         int schema = 3,
+                         double minValue = 1e-6,
+                         double maxValue = 1e3) noexcept(false);
+    ~ExponentialHistogram() override;
+
+    void observe(double value);
+
+    /**
+     * @brief Get the upper bound of the bucket containing the given quantile
+     * of the observations, e.g. 0.99 for the p99, or 0 if nothing has been
+     * observed.
+     */
+    double quantile(double q) const;
+
+    std::vector<Sample> collect() const override;
+
+    static std::string_view type()
+    {
+        return "histogram";
+    }
+
+  private:
+    struct alignas(64) Cell
+    {
+        // Allocated by the first observation of the thread.
+        std::atomic<std::atomic<uint64_t> *> buckets{nullptr};
+        std::atomic<uint64_t> count{0};
+        std::atomic<double> sum{0};
+    };
+
+    std::array<Cell, internal::kThreadCellsNum> cells_;
+    const double minValue_;
+    const double scale_;
+    // The finite buckets, the last one counts the values above the maximum.
+    const size_t bucketsCount_;
+
+    double upperBound(size_t index) const;
+    std::vector<uint64_t> mergedBuckets() const;
+};
+}  // namespace monitoring
+}  // namespace drogon
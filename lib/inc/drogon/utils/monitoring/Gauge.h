@@ -14,6 +14,7 @@
 
 #pragma once
 #include <drogon/utils/monitoring/Metric.h>
+#include <drogon/utils/monitoring/ThreadCells.h>
 #include <string_view>
 #include <atomic>
 
@@ -40,10 +41,10 @@ class Gauge : public Metric
     std::vector<Sample> collect() const override
     {
         Sample s;
-        std::lock_guard<std::mutex> lock(mutex_);
         s.name = name_;
-        s.value = value_;
-        s.timestamp = timestamp_;
+        s.value = base_.load(std::memory_order_relaxed) + cells_.sum();
+        s.timestamp =
+            trantor::Date(timestamp_.load(std::memory_order_relaxed));
         return {s};
     }
 
@@ -52,20 +53,17 @@ class Gauge : public Metric
      * */
     void increment()
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        value_ += 1;
+        cells_.add(1.0);
     }
 
     void decrement()
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        value_ -= 1;
+        cells_.add(-1.0);
     }
 
     void decrement(double value)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        value_ -= value;
+        cells_.add(-value);
     }
 
     /**
@@ -73,20 +71,19 @@ class Gauge : public Metric
      * */
     void increment(double value)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        value_ += value;
+        cells_.add(value);
     }
 
     void reset()
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        value_ = 0;
+        set(0);
     }
 
     void set(double value)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        value_ = value;
+        // The increments made before setting the value are discarded.
+        cells_.reset();
+        base_.store(value, std::memory_order_relaxed);
     }
 
     static std::string_view type()
@@ -96,14 +93,14 @@ class Gauge : public Metric
 
     void setToCurrentTime()
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        timestamp_ = trantor::Date::now();
+        timestamp_.store(trantor::Date::now().microSecondsSinceEpoch(),
+                         std::memory_order_relaxed);
     }
 
   private:
-    mutable std::mutex mutex_;
-    double value_{0};
-    trantor::Date timestamp_{0};
+    std::atomic<double> base_{0};
+    internal::ThreadCells cells_;
+    std::atomic<int64_t> timestamp_{0};
 };
 }  // namespace monitoring
 }  // namespace drogon
@@ -15,9 +15,12 @@
 #pragma once
 #include <drogon/exports.h>
 #include <drogon/utils/monitoring/Metric.h>
+#include <drogon/utils/monitoring/ThreadCells.h>
 #include <trantor/net/EventLoopThread.h>
 #include <string_view>
+#include <array>
 #include <atomic>
+#include <deque>
 #include <mutex>
 
 namespace drogon
@@ -25,7 +28,9 @@ namespace drogon
 namespace monitoring
 {
 /**
- * This class is used to collect samples for a counter metric.
+ * This class is used to collect samples for a histogram metric. Observations
+ * don't take any lock, they are counted in per-thread cells which are summed
+ * up when the histogram is collected.
  * */
 class DROGON_EXPORT Histogram : public Metric
 {
@@ -67,8 +72,11 @@ class DROGON_EXPORT Histogram : public Metric
                     "timeBucketsCount must be greater than 0");
             }
         }
-        timeBuckets_.emplace_back();
-        timeBuckets_.back().buckets.resize(bucketBoundaries.size() + 1);
+        for (auto &cell : cells_)
+        {
+            cell.buckets = std::vector<std::atomic<uint64_t>>(
+                bucketBoundaries.size() + 1);
+        }
         // check the bucket boundaries are sorted
         for (size_t i = 1; i < bucketBoundaries.size(); i++)
         {
@@ -97,27 +105,29 @@ class DROGON_EXPORT Histogram : public Metric
     }
 
   private:
+    struct alignas(64) Cell
+    {
+        std::vector<std::atomic<uint64_t>> buckets;
+        std::atomic<uint64_t> count{0};
+        std::atomic<double> sum{0};
+    };
+
+    // The cells only grow, the totals at the ends of the last time buckets
+    // are kept so that the expired observations can be subtracted.
+    std::array<Cell, internal::kThreadCellsNum> cells_;
     std::deque<TimeBucket> timeBuckets_;
     std::unique_ptr<trantor::EventLoopThread> loopThreadPtr_;
     trantor::EventLoop *loopPtr_{nullptr};
     mutable std::mutex mutex_;
+    std::atomic<bool> timerStarted_{false};
     std::chrono::duration<double> maxAge_;
     trantor::TimerId timerId_{trantor::InvalidTimerId};
     size_t timeBucketCount_{0};
     const std::vector<double> bucketBoundaries_;
 
-    void rotateTimeBuckets()
-    {
-        std::lock_guard<std::mutex> guard(mutex_);
-        TimeBucket bucket;
-        bucket.buckets.resize(bucketBoundaries_.size() + 1);
-        timeBuckets_.emplace_back(std::move(bucket));
-        if (timeBuckets_.size() > timeBucketCount_)
-        {
-            auto expiredTimeBucket = timeBuckets_.front();
-            timeBuckets_.erase(timeBuckets_.begin());
-        }
-    }
+    void startTimer();
+    TimeBucket totals() const;
+    void rotateTimeBuckets();
 };
 }  // namespace monitoring
 }  // namespace drogon
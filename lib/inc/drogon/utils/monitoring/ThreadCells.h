@@ -0,0 +1,102 @@
+/**
+ *
+ *  ThreadCells.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace drogon
+{
+namespace monitoring
+{
+namespace internal
+{
+/**
+ * The metrics keep their values in several cells, each thread updates its
+ * own cell with relaxed atomic operations, and the cells are summed up when
+ * the metrics are collected. This avoids both locks and the contention on a
+ * single cache line when many threads update the same metric.
+ */
+constexpr size_t kThreadCellsNum = 16;
+
+inline size_t threadCellIndex()
+{
+    static std::atomic<size_t> nextIndex{0};
+    thread_local size_t index =
+        nextIndex.fetch_add(1, std::memory_order_relaxed) % kThreadCellsNum;
+    return index;
+}
+
+inline void atomicAdd(std::atomic<double> &target, double value)
+{
+    auto current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current,
+                                         current + value,
+                                         std::memory_order_relaxed))
+    {
+    }
+}
+
+/**
+ * A sum of integral and fractional increments, integral ones are a single
+ * fetch_add.
+ */
+class ThreadCells
+{
+  public:
+    void add(uint64_t value)
+    {
+        cells_[threadCellIndex()].count.fetch_add(value,
+                                                  std::memory_order_relaxed);
+    }
+
+    void add(double value)
+    {
+        atomicAdd(cells_[threadCellIndex()].value, value);
+    }
+
+    double sum() const
+    {
+        double sum{0};
+        for (auto &cell : cells_)
+        {
+            sum += (double)cell.count.load(std::memory_order_relaxed) +
+                   cell.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    void reset()
+    {
+        for (auto &cell : cells_)
+        {
+            cell.count.store(0, std::memory_order_relaxed);
+            cell.value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+  private:
+    struct alignas(64) Cell
+    {
+        std::atomic<uint64_t> count{0};
+        std::atomic<double> value{0};
+    };
+
+    std::array<Cell, kThreadCellsNum> cells_;
+};
+}  // namespace internal
+}  // namespace monitoring
+}  // namespace drogon
@@ -16,7 +16,10 @@
 #include <drogon/drogon.h>
 #include <drogon/plugins/AccessLogger.h>
 #include <drogon/plugins/RealIpResolver.h>
+#include <cstdio>
+#include <random>
 #include <regex>
+#include <set>
 #include <thread>
 #if !defined _WIN32 && !defined __HAIKU__
 #include <unistd.h>
@@ -70,19 +73,17 @@ void AccessLogger::initAndStart(const Json::Value &config)
     useCustomTimeFormat_ = !timeFormat_.empty();
     useRealIp_ = config.get("use_real_ip", false).asBool();
 
+    jsonLines_ = config.get("json_lines", false).asBool();
+
     logFunctionMap_ = {{"$request_path", outputReqPath},
                        {"$path", outputReqPath},
                        {"$date",
-                        [this](trantor::LogStream &stream,
-                               const drogon::HttpRequestPtr &req,
-                               const drogon::HttpResponsePtr &resp) {
-                            outputDate(stream, req, resp);
+                        [this](std::string &line, const LogRecord &record) {
+                            line.append(formatDate(record.date));
                         }},
                        {"$request_date",
-                        [this](trantor::LogStream &stream,
-                               const drogon::HttpRequestPtr &req,
-                               const drogon::HttpResponsePtr &resp) {
-                            outputReqDate(stream, req, resp);
+                        [this](std::string &line, const LogRecord &record) {
+                            line.append(formatDate(record.requestDate));
                         }},
                        {"$request_query", outputReqQuery},
                        {"$request_url", outputReqURL},
@@ -262,6 +263,39 @@ void AccessLogger::initAndStart(const Json::Value &config)
         auto maxFiles = config.get("max_files", 0).asUInt();
         asyncFileLogger_.setMaxFiles(maxFiles);
     }
+    sampleRatio_ = config.get("sample_ratio", 1.0).asDouble();
+    const auto &routeRatios = config["route_sample_ratios"];
+    if (routeRatios.isObject())
+    {
+        for (auto iter = routeRatios.begin(); iter != routeRatios.end();
+             ++iter)
+        {
+            routeSampleRatios_[iter.name()] = iter->asDouble();
+        }
+    }
+    else if (!routeRatios.isNull())
+    {
+        LOG_ERROR << "route_sample_ratios must be an object!";
+    }
+    alwaysLogStatus_ = config.get("always_log_status", 500).asInt();
+    alwaysLogSlowerThan_ = config.get("always_log_slower_than", 0.0).asDouble();
+    sampling_ = sampleRatio_ < 1.0 || !routeSampleRatios_.empty();
+
+    async_ = config.get("async", false).asBool();
+    if (async_)
+    {
+        auto queueSize = config.get("async_queue_size", 8192).asUInt64();
+        ringSize_ = 1;
+        while (ringSize_ < queueSize)
+            ringSize_ <<= 1;
+        static std::atomic<uint64_t> instances{0};
+        id_ = ++instances;
+        threadPtr_ = std::make_unique<trantor::EventLoopThread>("AccessLogger");
+        threadPtr_->run();
+        timerId_ = threadPtr_->getLoop()->runEvery(
+            config.get("async_flush_interval", 0.1).asDouble(),
+            [this]() { writeRecords(); });
+    }
     drogon::app().registerPreSendingAdvice(
         [this](const drogon::HttpRequestPtr &req,
                const drogon::HttpResponsePtr &resp) {
@@ -269,32 +303,265 @@ void AccessLogger::initAndStart(const Json::Value &config)
             {
                 if (!std::regex_match(req->path(), exemptRegex_))
                 {
-                    logging(LOG_RAW_TO(logIndex_), req, resp);
+                    record(req, resp);
                 }
             }
             else
             {
-                logging(LOG_RAW_TO(logIndex_), req, resp);
+                record(req, resp);
             }
         });
 }
 
 void AccessLogger::shutdown()
 {
+    if (threadPtr_)
+    {
+        threadPtr_->getLoop()->invalidateTimer(timerId_);
+        threadPtr_.reset();
+        // The thread of the plugin has quit, write the last records here.
+        writeRecords();
+    }
+}
+
+bool AccessLogger::sampled(const drogon::HttpRequestPtr &req,
+                           const drogon::HttpResponsePtr &resp) const
+{
+    if (alwaysLogStatus_ > 0 && resp->getStatusCode() >= alwaysLogStatus_)
+        return true;
+    if (alwaysLogSlowerThan_ > 0)
+    {
+        auto duration = trantor::Date::now().microSecondsSinceEpoch() -
+                        req->creationDate().microSecondsSinceEpoch();
+        if ((double)duration / 1000000.0 > alwaysLogSlowerThan_)
+            return true;
+    }
+    auto ratio = sampleRatio_;
+    if (!routeSampleRatios_.empty())
+    {
+        auto route = req->matchedPathPattern();
+        auto iter = routeSampleRatios_.find(route.empty() ? req->path()
+                                                          : route);
+        if (iter != routeSampleRatios_.end())
+            ratio = iter->second;
+    }
+    if (ratio >= 1.0)
+        return true;
+    if (ratio <= 0.0)
+        return false;
+    static thread_local std::minstd_rand generator{std::random_device{}()};
+    return std::uniform_real_distribution<double>(0, 1)(generator) < ratio;
+}
+
+void AccessLogger::record(const drogon::HttpRequestPtr &req,
+                          const drogon::HttpResponsePtr &resp)
+{
+    if (sampling_ && !sampled(req, resp))
+        return;
+    if (!async_)
+    {
+        static thread_local LogRecord threadRecord;
+        static thread_local std::string line;
+        capture(threadRecord, req, resp);
+        line.clear();
+        format(line, threadRecord);
+        LOG_RAW_TO(logIndex_) << line;
+        return;
+    }
+    auto ring = threadRing();
+    auto head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) == ringSize_)
+    {
+        droppedRecords_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    capture(ring->records[head & (ringSize_ - 1)], req, resp);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+AccessLogger::RecordRing *AccessLogger::threadRing()
+{
+    // The ring of the calling thread, registered by its first record.
+    static thread_local uint64_t ownerId{0};
+    static thread_local RecordRing *ring{nullptr};
+    if (ownerId != id_)
+    {
+        auto newRing = std::make_unique<RecordRing>(ringSize_);
+        ring = newRing.get();
+        ownerId = id_;
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings_.emplace_back(std::move(newRing));
+    }
+    return ring;
 }
 
-void AccessLogger::logging(trantor::LogStream &stream,
+void AccessLogger::writeRecords()
+{
+    // Enough records for a few buffers of the file logger at once.
+    static constexpr size_t kBatchSize = 256;
+    std::vector<RecordRing *> rings;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings.reserve(rings_.size());
+        for (auto &ring : rings_)
+            rings.push_back(ring.get());
+    }
+    for (auto ring : rings)
+    {
+        auto tail = ring->tail.load(std::memory_order_relaxed);
+        auto head = ring->head.load(std::memory_order_acquire);
+        while (tail != head)
+        {
+            batch_.clear();
+            for (size_t i = 0; i < kBatchSize && tail != head; ++i, ++tail)
+            {
+                format(batch_, ring->records[tail & (ringSize_ - 1)]);
+            }
+            // Release the slots before writing, they aren't read any more.
+            ring->tail.store(tail, std::memory_order_release);
+            LOG_RAW_TO(logIndex_) << batch_;
+        }
+    }
+    auto dropped = droppedRecords_.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+        LOG_RAW_TO(logIndex_) << dropped
+                              << " requests were not logged since the access "
+                                 "log queue was full\n";
+    }
+}
+
+static uint64_t currentThreadId()
+{
+#ifdef __linux__
+    static thread_local pid_t threadId_{0};
+#else
+    static thread_local uint64_t threadId_{0};
+#endif
+#ifdef __linux__
+    if (threadId_ == 0)
+        threadId_ = static_cast<pid_t>(::syscall(SYS_gettid));
+#elif defined __FreeBSD__
+    if (threadId_ == 0)
+    {
+        threadId_ = pthread_getthreadid_np();
+    }
+#elif defined __OpenBSD__
+    if (threadId_ == 0)
+    {
+        threadId_ = getthrid();
+    }
+#elif defined _WIN32 || defined __HAIKU__
+    if (threadId_ == 0)
+    {
+        std::stringstream ss;
+        ss << std::this_thread::get_id();
+        threadId_ = std::stoull(ss.str());
+    }
+#else
+    if (threadId_ == 0)
+    {
+        pthread_threadid_np(NULL, &threadId_);
+    }
+#endif
+    return threadId_;
+}
+
+void AccessLogger::capture(LogRecord &record,
                            const drogon::HttpRequestPtr &req,
-                           const drogon::HttpResponsePtr &resp)
+                           const drogon::HttpResponsePtr &resp) const
+{
+    record.date = trantor::Date::now();
+    record.requestDate = req->creationDate();
+    record.method = req->methodString();
+    record.version = req->versionString();
+    // The strings of a reused record keep their capacity, they are not
+    // reallocated once the record has held a long enough value.
+    record.path.assign(req->path());
+    record.query.assign(req->query());
+    record.remoteAddr =
+        useRealIp_ ? RealIpResolver::GetRealAddr(req) : req->peerAddr();
+    record.localAddr = req->localAddr();
+    record.requestLength = req->body().length();
+    record.responseLength = resp->body().length();
+    record.threadId = currentThreadId();
+    record.statusCode = resp->getStatusCode();
+    if (useContentType_)
+    {
+        record.contentType.assign(resp->contentTypeString());
+    }
+    record.fields.resize(headerFields_.size());
+    for (size_t i = 0; i < headerFields_.size(); ++i)
+    {
+        auto &field = headerFields_[i];
+        switch (field.source)
+        {
+            case HeaderField::kRequestHeader:
+                record.fields[i].assign(req->getHeader(field.name));
+                break;
+            case HeaderField::kCookie:
+                record.fields[i].assign(req->getCookie(field.name));
+                break;
+            case HeaderField::kResponseHeader:
+                record.fields[i].assign(resp->getHeader(field.name));
+                break;
+        }
+    }
+}
+
+void AccessLogger::format(std::string &line, const LogRecord &record) const
 {
     for (auto &func : logFunctions_)
     {
-        func(stream, req, resp);
+        func(line, record);
     }
 }
 
+// Escape the characters of the line from the position for a json string.
+static void escapeJson(std::string &line, size_t pos)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t i = pos;
+    while (i < line.size() && (unsigned char)line[i] >= 0x20 &&
+           line[i] != '"' && line[i] != '\\')
+        ++i;
+    if (i == line.size())
+        return;
+    auto first = i;
+    std::string escaped;
+    for (; i < line.size(); ++i)
+    {
+        auto c = (unsigned char)line[i];
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += (char)c;
+        }
+        else if (c < 0x20)
+        {
+            escaped += "\\u00";
+            escaped += hex[c >> 4];
+            escaped += hex[c & 0xf];
+        }
+        else
+        {
+            escaped += (char)c;
+        }
+    }
+    line.resize(first);
+    line.append(escaped);
+}
+
 void AccessLogger::createLogFunctions(std::string format)
 {
+    // The numbers are not quoted in the json lines.
+    static const std::set<std::string> numbers{"$request_len",
+                                               "$body_bytes_received",
+                                               "$response_len",
+                                               "$body_bytes_sent",
+                                               "$thread",
+                                               "$status_code",
+                                               "$processing_time"};
     std::string rawString;
     while (!format.empty())
     {
@@ -309,17 +576,40 @@ void AccessLogger::createLogFunctions(std::string format)
             std::smatch m;
             if (std::regex_search(format, m, e))
             {
+                std::string placeholder = m[0];
+                if (jsonLines_)
+                {
+                    auto key = (logFunctions_.empty() ? "{\"" : ",\"") +
+                               placeholder.substr(1) + "\":";
+                    logFunctions_.emplace_back(
+                        [key = std::move(key),
+                         func = newLogFunction(placeholder),
+                         quoted = numbers.find(placeholder) == numbers.end()](
+                            std::string &line, const LogRecord &record) {
+                            line.append(key);
+                            if (!quoted)
+                            {
+                                func(line, record);
+                                return;
+                            }
+                            line += '"';
+                            auto valuePos = line.size();
+                            func(line, record);
+                            escapeJson(line, valuePos);
+                            line += '"';
+                        });
+                    rawString.clear();
+                    format = m.suffix().str();
+                    continue;
+                }
                 if (!rawString.empty())
                 {
                     logFunctions_.emplace_back(
-                        [rawString](trantor::LogStream &stream,
-                                    const drogon::HttpRequestPtr &,
-                                    const drogon::HttpResponsePtr &) {
-                            stream << rawString;
+                        [rawString](std::string &line, const LogRecord &) {
+                            line.append(rawString);
                         });
                     rawString.clear();
                 }
-                auto placeholder = m[0];
                 logFunctions_.emplace_back(newLogFunction(placeholder));
                 format = m.suffix().str();
             }
@@ -335,22 +625,24 @@ void AccessLogger::createLogFunctions(std::string format)
             break;
         }
     }
-    if (!rawString.empty())
+    if (jsonLines_)
+    {
+        auto end = logFunctions_.empty() ? "{}\n" : "}\n";
+        logFunctions_.emplace_back(
+            [end](std::string &line, const LogRecord &) { line.append(end); });
+    }
+    else if (!rawString.empty())
     {
         logFunctions_.emplace_back(
-            [rawString =
-                 std::move(rawString)](trantor::LogStream &stream,
-                                       const drogon::HttpRequestPtr &,
-                                       const drogon::HttpResponsePtr &) {
-                stream << rawString << "\n";
+            [rawString = std::move(rawString)](std::string &line,
+                                               const LogRecord &) {
+                line.append(rawString).append("\n");
             });
     }
     else
     {
         logFunctions_.emplace_back(
-            [](trantor::LogStream &stream,
-               const drogon::HttpRequestPtr &,
-               const drogon::HttpResponsePtr &) { stream << "\n"; });
+            [](std::string &line, const LogRecord &) { line += '\n'; });
     }
 }
 
@@ -360,302 +652,175 @@ AccessLogger::LogFunction AccessLogger::newLogFunction(
     auto iter = logFunctionMap_.find(placeholder);
     if (iter != logFunctionMap_.end())
     {
+        if (placeholder == "$upstream_http_content-type" ||
+            placeholder == "$upstream_http_content_type")
+        {
+            useContentType_ = true;
+        }
         return iter->second;
     }
+    auto addField = [this](HeaderField::Source source, std::string name) {
+        headerFields_.push_back({source, std::move(name)});
+        return headerFields_.size() - 1;
+    };
+    // The json lines have the name of the header or the cookie in the key.
+    bool withName = !jsonLines_;
     if (placeholder.find("$http_") == 0 && placeholder.size() > 6)
     {
         auto headerName = placeholder.substr(6);
-        return [headerName =
-                    std::move(headerName)](trantor::LogStream &stream,
-                                           const drogon::HttpRequestPtr &req,
-                                           const drogon::HttpResponsePtr &) {
-            outputReqHeader(stream, req, headerName);
+        auto index = addField(HeaderField::kRequestHeader, headerName);
+        return [headerName = std::move(headerName), index, withName](
+                   std::string &line, const LogRecord &record) {
+            if (withName)
+                line.append(headerName).append(": ");
+            line.append(record.fields[index]);
         };
     }
     if (placeholder.find("$cookie_") == 0 && placeholder.size() > 8)
     {
         auto cookieName = placeholder.substr(8);
-        return [cookieName =
-                    std::move(cookieName)](trantor::LogStream &stream,
-                                           const drogon::HttpRequestPtr &req,
-                                           const drogon::HttpResponsePtr &) {
-            outputReqCookie(stream, req, cookieName);
+        auto index = addField(HeaderField::kCookie, cookieName);
+        return [cookieName = std::move(cookieName), index, withName](
+                   std::string &line, const LogRecord &record) {
+            if (withName)
+                line.append("(cookie)").append(cookieName).append("=");
+            line.append(record.fields[index]);
         };
     }
     if (placeholder.find("$upstream_http_") == 0 && placeholder.size() > 15)
     {
         auto headerName = placeholder.substr(15);
-        return [headerName = std::move(
-                    headerName)](trantor::LogStream &stream,
-                                 const drogon::HttpRequestPtr &,
-                                 const drogon::HttpResponsePtr &resp) {
-            outputRespHeader(stream, resp, headerName);
+        auto index = addField(HeaderField::kResponseHeader, headerName);
+        return [headerName = std::move(headerName), index, withName](
+                   std::string &line, const LogRecord &record) {
+            if (withName)
+                line.append(headerName).append(": ");
+            line.append(record.fields[index]);
         };
     }
-    return [placeholder](trantor::LogStream &stream,
-                         const drogon::HttpRequestPtr &,
-                         const drogon::HttpResponsePtr &) {
-        stream << placeholder;
+    return [placeholder](std::string &line, const LogRecord &) {
+        line.append(placeholder);
     };
 }
 
-void AccessLogger::outputReqPath(trantor::LogStream &stream,
-                                 const drogon::HttpRequestPtr &req,
-                                 const drogon::HttpResponsePtr &)
+void AccessLogger::outputReqPath(std::string &line, const LogRecord &record)
 {
-    stream << req->path();
+    line.append(record.path);
 }
 
-void AccessLogger::outputDate(trantor::LogStream &stream,
-                              const drogon::HttpRequestPtr &,
-                              const drogon::HttpResponsePtr &) const
+std::string AccessLogger::formatDate(const trantor::Date &date) const
 {
     if (useCustomTimeFormat_)
     {
         if (useLocalTime_)
         {
-            stream << trantor::Date::now().toCustomFormattedStringLocal(
-                timeFormat_, showMicroseconds_);
-        }
-        else
-        {
-            stream << trantor::Date::now().toCustomFormattedString(
-                timeFormat_, showMicroseconds_);
+            return date.toCustomFormattedStringLocal(timeFormat_,
+                                                     showMicroseconds_);
         }
+        return date.toCustomFormattedString(timeFormat_, showMicroseconds_);
     }
-    else
+    if (useLocalTime_)
     {
-        if (useLocalTime_)
-        {
-            stream << trantor::Date::now().toFormattedStringLocal(
-                showMicroseconds_);
-        }
-        else
-        {
-            stream << trantor::Date::now().toFormattedString(showMicroseconds_);
-        }
-    }
-}
-
-void AccessLogger::outputReqDate(trantor::LogStream &stream,
-                                 const drogon::HttpRequestPtr &req,
-                                 const drogon::HttpResponsePtr &) const
-{
-    if (useCustomTimeFormat_)
-    {
-        if (useLocalTime_)
-        {
-            stream << req->creationDate().toCustomFormattedStringLocal(
-                timeFormat_, showMicroseconds_);
-        }
-        else
-        {
-            stream << req->creationDate().toCustomFormattedString(
-                timeFormat_, showMicroseconds_);
-        }
-    }
-    else
-    {
-        if (useLocalTime_)
-        {
-            stream << req->creationDate().toFormattedStringLocal(
-                showMicroseconds_);
-        }
-        else
-        {
-            stream << req->creationDate().toFormattedString(showMicroseconds_);
-        }
+        return date.toFormattedStringLocal(showMicroseconds_);
     }
+    return date.toFormattedString(showMicroseconds_);
 }
 
 //$request_query
-void AccessLogger::outputReqQuery(trantor::LogStream &stream,
-                                  const drogon::HttpRequestPtr &req,
-                                  const drogon::HttpResponsePtr &)
+void AccessLogger::outputReqQuery(std::string &line, const LogRecord &record)
 {
-    stream << req->query();
+    line.append(record.query);
 }
 
 //$request_url
-void AccessLogger::outputReqURL(trantor::LogStream &stream,
-                                const drogon::HttpRequestPtr &req,
-                                const drogon::HttpResponsePtr &)
+void AccessLogger::outputReqURL(std::string &line, const LogRecord &record)
 {
-    auto &query = req->query();
-    if (query.empty())
-    {
-        stream << req->path();
-    }
-    else
+    line.append(record.path);
+    if (!record.query.empty())
     {
-        stream << req->path() << '?' << query;
+        line.append("?").append(record.query);
     }
 }
 
 //$request_version
-void AccessLogger::outputVersion(trantor::LogStream &stream,
-                                 const drogon::HttpRequestPtr &req,
-                                 const drogon::HttpResponsePtr &)
+void AccessLogger::outputVersion(std::string &line, const LogRecord &record)
 {
-    stream << req->versionString();
+    line.append(record.version);
 }
 
 //$request
-void AccessLogger::outputReqLine(trantor::LogStream &stream,
-                                 const drogon::HttpRequestPtr &req,
-                                 const drogon::HttpResponsePtr &)
-{
-    auto &query = req->query();
-    if (query.empty())
-    {
-        stream << req->methodString() << " " << req->path() << " "
-               << req->versionString();
-    }
-    else
-    {
-        stream << req->methodString() << " " << req->path() << '?' << query
-               << " " << req->versionString();
-    }
-}
-
-void AccessLogger::outputRemoteAddr(trantor::LogStream &stream,
-                                    const drogon::HttpRequestPtr &req,
-                                    const drogon::HttpResponsePtr &)
+void AccessLogger::outputReqLine(std::string &line, const LogRecord &record)
 {
-    if (useRealIp_)
-    {
-        stream << RealIpResolver::GetRealAddr(req).toIpPort();
-    }
-    else
-    {
-        stream << req->peerAddr().toIpPort();
-    }
+    line.append(record.method).append(" ");
+    outputReqURL(line, record);
+    line.append(" ").append(record.version);
 }
 
-void AccessLogger::outputLocalAddr(trantor::LogStream &stream,
-                                   const drogon::HttpRequestPtr &req,
-                                   const drogon::HttpResponsePtr &)
+void AccessLogger::outputRemoteAddr(std::string &line,
+                                    const LogRecord &record)
 {
-    stream << req->localAddr().toIpPort();
+    line.append(record.remoteAddr.toIpPort());
 }
 
-void AccessLogger::outputReqLength(trantor::LogStream &stream,
-                                   const drogon::HttpRequestPtr &req,
-                                   const drogon::HttpResponsePtr &)
+void AccessLogger::outputLocalAddr(std::string &line, const LogRecord &record)
 {
-    stream << req->body().length();
+    line.append(record.localAddr.toIpPort());
 }
 
-void AccessLogger::outputRespLength(trantor::LogStream &stream,
-                                    const drogon::HttpRequestPtr &,
-                                    const drogon::HttpResponsePtr &resp)
+void AccessLogger::outputReqLength(std::string &line, const LogRecord &record)
 {
-    stream << resp->body().length();
-}
-
-void AccessLogger::outputMethod(trantor::LogStream &stream,
-                                const drogon::HttpRequestPtr &req,
-                                const drogon::HttpResponsePtr &)
-{
-    stream << req->methodString();
-}
-
-void AccessLogger::outputThreadNumber(trantor::LogStream &stream,
-                                      const drogon::HttpRequestPtr &,
-                                      const drogon::HttpResponsePtr &)
-{
-#ifdef __linux__
-    static thread_local pid_t threadId_{0};
-#else
-    static thread_local uint64_t threadId_{0};
-#endif
-#ifdef __linux__
-    if (threadId_ == 0)
-        threadId_ = static_cast<pid_t>(::syscall(SYS_gettid));
-#elif defined __FreeBSD__
-    if (threadId_ == 0)
-    {
-        threadId_ = pthread_getthreadid_np();
-    }
-#elif defined __OpenBSD__
-    if (threadId_ == 0)
-    {
-        threadId_ = getthrid();
-    }
-#elif defined _WIN32 || defined __HAIKU__
-    if (threadId_ == 0)
-    {
-        std::stringstream ss;
-        ss << std::this_thread::get_id();
-        threadId_ = std::stoull(ss.str());
-    }
-#else
-    if (threadId_ == 0)
-    {
-        pthread_threadid_np(NULL, &threadId_);
-    }
-#endif
-    stream << threadId_;
+    line.append(std::to_string(record.requestLength));
 }
 
-//$http_[header_name]
-void AccessLogger::outputReqHeader(trantor::LogStream &stream,
-                                   const drogon::HttpRequestPtr &req,
-                                   const std::string &headerName)
+void AccessLogger::outputRespLength(std::string &line,
+                                    const LogRecord &record)
 {
-    stream << headerName << ": " << req->getHeader(headerName);
+    line.append(std::to_string(record.responseLength));
 }
 
-//$cookie_[cookie_name]
-void AccessLogger::outputReqCookie(trantor::LogStream &stream,
-                                   const drogon::HttpRequestPtr &req,
-                                   const std::string &cookie)
+void AccessLogger::outputMethod(std::string &line, const LogRecord &record)
 {
-    stream << "(cookie)" << cookie << "=" << req->getCookie(cookie);
+    line.append(record.method);
 }
 
-//$upstream_http_[header_name]
-void AccessLogger::outputRespHeader(trantor::LogStream &stream,
-                                    const drogon::HttpResponsePtr &resp,
-                                    const std::string &headerName)
+void AccessLogger::outputThreadNumber(std::string &line,
+                                      const LogRecord &record)
 {
-    stream << headerName << ": " << resp->getHeader(headerName);
+    line.append(std::to_string(record.threadId));
 }
 
 //$status
-void AccessLogger::outputStatusString(trantor::LogStream &stream,
-                                      const drogon::HttpRequestPtr &,
-                                      const drogon::HttpResponsePtr &resp)
+void AccessLogger::outputStatusString(std::string &line,
+                                      const LogRecord &record)
 {
-    int code = resp->getStatusCode();
-    stream << code << " " << statusCodeToString(code);
+    line.append(std::to_string(record.statusCode))
+        .append(" ")
+        .append(statusCodeToString(record.statusCode));
 }
 
 //$status_code
-void AccessLogger::outputStatusCode(trantor::LogStream &stream,
-                                    const drogon::HttpRequestPtr &,
-                                    const drogon::HttpResponsePtr &resp)
+void AccessLogger::outputStatusCode(std::string &line,
+                                    const LogRecord &record)
 {
-    stream << resp->getStatusCode();
+    line.append(std::to_string(record.statusCode));
 }
 
 //$processing_time
-void AccessLogger::outputProcessingTime(trantor::LogStream &stream,
-                                        const drogon::HttpRequestPtr &req,
-                                        const drogon::HttpResponsePtr &)
+void AccessLogger::outputProcessingTime(std::string &line,
+                                        const LogRecord &record)
 {
-    auto start = req->creationDate();
-    auto end = trantor::Date::now();
-    auto duration =
-        end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch();
+    auto duration = record.date.microSecondsSinceEpoch() -
+                    record.requestDate.microSecondsSinceEpoch();
     auto seconds = static_cast<double>(duration) / 1000000.0;
-    stream << seconds;
+    // The same format as trantor::LogStream
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.12g", seconds);
+    line.append(buf);
 }
 
 //$upstream_http_content-type $upstream_http_content_type
-void AccessLogger::outputRespContentType(trantor::LogStream &stream,
-                                         const drogon::HttpRequestPtr &,
-                                         const drogon::HttpResponsePtr &resp)
+void AccessLogger::outputRespContentType(std::string &line,
+                                         const LogRecord &record)
 {
-    stream << resp->contentTypeString();
+    line.append(record.contentType);
 }
@@ -0,0 +1,32 @@
+/**
+ *
+ *  @file AllocationCounter.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/utils/AllocationCounter.h>
+
+using namespace drogon;
+
+// Constant-initialized, so record() may be called by the allocations made
+// before main() and while the thread exits.
+static thread_local AllocationCounter::Counts counts;
+
+void AllocationCounter::record(size_t bytes) noexcept
+{
+    ++counts.allocations;
+    counts.bytes += bytes;
+}
+
+AllocationCounter::Counts AllocationCounter::current() noexcept
+{
+    return counts;
+}
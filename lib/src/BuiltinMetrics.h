@@ -0,0 +1,66 @@
+/**
+ *
+ *  @file BuiltinMetrics.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/utils/monitoring/Collector.h>
+#include <drogon/utils/monitoring/Counter.h>
+#include <drogon/utils/monitoring/ExponentialHistogram.h>
+#include <drogon/utils/monitoring/Gauge.h>
+#include <drogon/utils/monitoring/Histogram.h>
+#include <memory>
+
+namespace drogon
+{
+/**
+ * @brief The metrics updated by the internals of the framework.
+ *
+ * They are created by the PromExporter plugin when its built-in metrics are
+ * enabled, before the listeners start, and are never changed afterwards, so
+ * the framework only pays for a null check when they are disabled.
+ */
+struct BuiltinMetrics
+{
+    std::shared_ptr<monitoring::Gauge> inFlightRequests;
+    std::shared_ptr<monitoring::Counter> parseErrors;
+    std::shared_ptr<monitoring::Histogram> pipelineDepth;
+    // By IO loop, set by the sweeps of the idle connections.
+    std::shared_ptr<monitoring::Collector<monitoring::Gauge>> connections;
+    std::shared_ptr<monitoring::Collector<monitoring::Gauge>>
+        connectionMemory;
+    std::shared_ptr<monitoring::Counter> trimmedConnections;
+    // Set by the LoopWatchdog plugin. Handlers running longer than this
+    // number of seconds in an IO loop are logged, 0 disables the check.
+    double slowHandlerThreshold{0};
+    // By database system and normalized statement, see recordSqlStats().
+    std::shared_ptr<monitoring::Collector<monitoring::ExponentialHistogram>>
+        sqlDuration;
+    std::shared_ptr<monitoring::Collector<monitoring::Counter>> sqlRows;
+    std::shared_ptr<monitoring::Collector<monitoring::Counter>> sqlErrors;
+    // By route pattern, see RouteCostScope.
+    std::shared_ptr<monitoring::Collector<monitoring::Counter>> routeCpuTime;
+    std::shared_ptr<monitoring::Collector<monitoring::Counter>>
+        routeAllocations;
+    std::shared_ptr<monitoring::Collector<monitoring::Counter>>
+        routeAllocatedBytes;
+    // Set by HttpAppFramework::setSlowQueryThreshold(), 0 disables the log.
+    double slowQueryThreshold{0};
+
+    static BuiltinMetrics &instance()
+    {
+        static BuiltinMetrics metrics;
+        return metrics;
+    }
+};
+}  // namespace drogon
@@ -0,0 +1,125 @@
+/**
+ *
+ *  @file CacheMap.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/CacheMap.h>
+
+using namespace drogon;
+
+namespace
+{
+using TickerKey = std::pair<trantor::EventLoop *, double>;
+
+std::mutex &registryMutex()
+{
+    static std::mutex mtx;
+    return mtx;
+}
+
+std::map<TickerKey, std::weak_ptr<CacheMapTicker>> &registry()
+{
+    static std::map<TickerKey, std::weak_ptr<CacheMapTicker>> tickers;
+    return tickers;
+}
+}  // namespace
+
+std::shared_ptr<CacheMapTicker> CacheMapTicker::get(trantor::EventLoop *loop,
+                                                    double tickInterval)
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto &weakPtr = registry()[TickerKey(loop, tickInterval)];
+    auto tickerPtr = weakPtr.lock();
+    if (tickerPtr)
+    {
+        std::lock_guard<std::mutex> tickerLock(tickerPtr->mutex_);
+        if (!tickerPtr->loopEnded_)
+            return tickerPtr;
+    }
+    // The ticker of a loop which has quit is not reused, its timer doesn't
+    // run any more.
+    tickerPtr = std::shared_ptr<CacheMapTicker>(
+        new CacheMapTicker(loop, tickInterval));
+    std::weak_ptr<CacheMapTicker> weakTicker = tickerPtr;
+    tickerPtr->timerId_ = loop->runEvery(tickInterval, [weakTicker]() {
+        if (auto ticker = weakTicker.lock())
+            ticker->tick();
+    });
+    loop->runOnQuit([weakTicker]() {
+        if (auto ticker = weakTicker.lock())
+        {
+            std::lock_guard<std::mutex> lock(ticker->mutex_);
+            ticker->loopEnded_ = true;
+        }
+    });
+    weakPtr = tickerPtr;
+    return tickerPtr;
+}
+
+CacheMapTicker::CacheMapTicker(trantor::EventLoop *loop, double tickInterval)
+    : loop_(loop), tickInterval_(tickInterval)
+{
+}
+
+CacheMapTicker::~CacheMapTicker()
+{
+    {
+        // It is possible that the EventLoop destructed before the ticker (ex:
+        // both CacheMap and the EventLoop being globals), thus we shouldn't
+        // invalidate the timer.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!loopEnded_)
+            loop_->invalidateTimer(timerId_);
+    }
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto iter = registry().find(TickerKey(loop_, tickInterval_));
+    if (iter != registry().end() && iter->second.expired())
+        registry().erase(iter);
+}
+
+uint64_t CacheMapTicker::add(std::function<void()> callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto id = ++nextId_;
+    callbacks_.emplace(id,
+                       std::make_shared<std::function<void()>>(
+                           std::move(callback)));
+    return id;
+}
+
+void CacheMapTicker::remove(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    callbacks_.erase(id);
+}
+
+size_t CacheMapTicker::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return callbacks_.size();
+}
+
+void CacheMapTicker::tick()
+{
+    // The callbacks are called out of the lock, the caches add and remove
+    // their callbacks while holding their own locks, which the callbacks
+    // take.
+    std::vector<std::shared_ptr<std::function<void()>>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callbacks.reserve(callbacks_.size());
+        for (auto &callback : callbacks_)
+            callbacks.push_back(callback.second);
+    }
+    for (auto &callback : callbacks)
+        (*callback)();
+}
@@ -0,0 +1,211 @@
+/**
+ *
+ *  @file CharScan.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DROGON_CHAR_SCAN_SSE2
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define DROGON_CHAR_SCAN_NEON
+#endif
+
+namespace drogon
+{
+namespace internal
+{
+/**
+ * @brief The delimiter scanning of the HTTP parsers, 16 bytes at a time with
+ * SSE2 or NEON, which are always available on x86-64 and arm64, so no runtime
+ * dispatch is needed. Single bytes are searched by memchr, which the C
+ * libraries vectorize with the widest instructions of the CPU.
+ */
+
+/// The first c in [begin, end), or end.
+inline const char *findChar(const char *begin, const char *end, char c)
+{
+    auto p = static_cast<const char *>(memchr(begin, c, end - begin));
+    return p ? p : end;
+}
+
+/// The first CRLF in [begin, end), or nullptr.
+inline const char *findCRLF(const char *begin, const char *end)
+{
+    while (begin < end)
+    {
+        auto cr = static_cast<const char *>(memchr(begin, '\r', end - begin));
+        if (!cr || cr + 1 == end)
+            return nullptr;
+        if (cr[1] == '\n')
+            return cr;
+        begin = cr + 1;
+    }
+    return nullptr;
+}
+
+/// The scalar version of findEither(), used for the tails of the SIMD loops.
+inline const char *findEitherScalar(const char *begin,
+                                    const char *end,
+                                    char a,
+                                    char b)
+{
+    for (; begin < end; ++begin)
+    {
+        if (*begin == a || *begin == b)
+            return begin;
+    }
+    return end;
+}
+
+/// The first a or b in [begin, end), or end.
+inline const char *findEither(const char *begin,
+                              const char *end,
+                              char a,
+                              char b)
+{
+#if defined(DROGON_CHAR_SCAN_SSE2)
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    for (; end - begin >= 16; begin += 16)
+    {
+        __m128i chunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, va),
+                                                  _mm_cmpeq_epi8(chunk, vb)));
+        if (mask != 0)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long index;
+            _BitScanForward(&index, static_cast<unsigned long>(mask));
+            return begin + index;
+#else
+            return begin + __builtin_ctz(static_cast<unsigned int>(mask));
+#endif
+        }
+    }
+#elif defined(DROGON_CHAR_SCAN_NEON)
+    const uint8x16_t va = vdupq_n_u8(static_cast<uint8_t>(a));
+    const uint8x16_t vb = vdupq_n_u8(static_cast<uint8_t>(b));
+    for (; end - begin >= 16; begin += 16)
+    {
+        uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(begin));
+        uint8x16_t matches =
+            vorrq_u8(vceqq_u8(chunk, va), vceqq_u8(chunk, vb));
+        // Narrow every byte to 4 bits, one 64 bits word holds the 16 flags.
+        uint64_t flags = vget_lane_u64(
+            vreinterpret_u64_u8(
+                vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)),
+            0);
+        if (flags != 0)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long index;
+            _BitScanForward64(&index, flags);
+            return begin + (index >> 2);
+#else
+            return begin + (__builtin_ctzll(flags) >> 2);
+#endif
+        }
+    }
+#endif
+    return findEitherScalar(begin, end, a, b);
+}
+
+/// The scalar version of findHtmlSpecial().
+inline const char *findHtmlSpecialScalar(const char *begin, const char *end)
+{
+    for (; begin < end; ++begin)
+    {
+        switch (*begin)
+        {
+            case '"':
+            case '&':
+            case '<':
+            case '>':
+                return begin;
+            default:
+                break;
+        }
+    }
+    return end;
+}
+
+/// The first of the characters escaped in HTML, '"', '&', '<' or '>', in
+/// [begin, end), or end.
+inline const char *findHtmlSpecial(const char *begin, const char *end)
+{
+#if defined(DROGON_CHAR_SCAN_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    for (; end - begin >= 16; begin += 16)
+    {
+        __m128i chunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        __m128i matches =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                      _mm_cmpeq_epi8(chunk, amp)),
+                         _mm_or_si128(_mm_cmpeq_epi8(chunk, lt),
+                                      _mm_cmpeq_epi8(chunk, gt)));
+        int mask = _mm_movemask_epi8(matches);
+        if (mask != 0)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long index;
+            _BitScanForward(&index, static_cast<unsigned long>(mask));
+            return begin + index;
+#else
+            return begin + __builtin_ctz(static_cast<unsigned int>(mask));
+#endif
+        }
+    }
+#elif defined(DROGON_CHAR_SCAN_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t amp = vdupq_n_u8('&');
+    const uint8x16_t lt = vdupq_n_u8('<');
+    const uint8x16_t gt = vdupq_n_u8('>');
+    for (; end - begin >= 16; begin += 16)
+    {
+        uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(begin));
+        uint8x16_t matches =
+            vorrq_u8(vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, amp)),
+                     vorrq_u8(vceqq_u8(chunk, lt), vceqq_u8(chunk, gt)));
+        uint64_t flags = vget_lane_u64(
+            vreinterpret_u64_u8(
+                vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)),
+            0);
+        if (flags != 0)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long index;
+            _BitScanForward64(&index, flags);
+            return begin + (index >> 2);
+#else
+            return begin + (__builtin_ctzll(flags) >> 2);
+#endif
+        }
+    }
+#endif
+    return findHtmlSpecialScalar(begin, end);
+}
+}  // namespace internal
+}  // namespace drogon
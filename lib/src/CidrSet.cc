@@ -0,0 +1,206 @@
+/**
+ *
+ *  @file CidrSet.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/utils/CidrSet.h>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace drogon;
+
+static constexpr uint32_t kIpV4Root = 0;
+static constexpr uint32_t kIpV6Root = 1;
+
+static uint8_t bitAt(uint64_t hi, uint64_t lo, uint8_t index)
+{
+    if (index < 64)
+        return (hi >> (63 - index)) & 1;
+    return (lo >> (127 - index)) & 1;
+}
+
+static void maskKey(uint64_t &hi, uint64_t &lo, uint8_t length)
+{
+    if (length <= 64)
+    {
+        hi = length == 0 ? 0 : hi & (~0ULL << (64 - length));
+        lo = 0;
+        return;
+    }
+    lo &= ~0ULL << (128 - length);
+}
+
+static uint8_t commonLength(uint64_t hi1,
+                            uint64_t lo1,
+                            uint64_t hi2,
+                            uint64_t lo2,
+                            uint8_t maxLength)
+{
+    uint8_t length = 0;
+    while (length < maxLength &&
+           bitAt(hi1, lo1, length) == bitAt(hi2, lo2, length))
+        ++length;
+    return length;
+}
+
+static void ipV6Key(const trantor::InetAddress &addr,
+                    uint64_t &hi,
+                    uint64_t &lo)
+{
+    auto words = addr.ip6NetEndian();
+    hi = (static_cast<uint64_t>(ntohl(words[0])) << 32) | ntohl(words[1]);
+    lo = (static_cast<uint64_t>(ntohl(words[2])) << 32) | ntohl(words[3]);
+}
+
+CidrSet::CidrSet() : nodes_(2)
+{
+}
+
+void CidrSet::add(const std::string &ipOrCidr)
+{
+    auto pos = ipOrCidr.find('/');
+    auto ip = ipOrCidr.substr(0, pos);
+    bool isIpV6 = ip.find(':') != std::string::npos;
+    uint8_t bits = isIpV6 ? 128 : 32;
+    uint8_t length = bits;
+    if (pos != std::string::npos)
+    {
+        auto prefix = ipOrCidr.substr(pos + 1);
+        if (prefix.empty() || prefix.length() > 3 ||
+            !std::all_of(prefix.begin(), prefix.end(), [](unsigned char c) {
+                return c >= '0' && c <= '9';
+            }) ||
+            std::stoi(prefix) > bits)
+        {
+            throw std::runtime_error("Bad CIDR block: " + ipOrCidr);
+        }
+        length = static_cast<uint8_t>(std::stoi(prefix));
+    }
+    trantor::InetAddress addr(ip, 0, isIpV6);
+    if (addr.isUnspecified())
+    {
+        throw std::runtime_error("Bad ip address: " + ip);
+    }
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+    if (isIpV6)
+        ipV6Key(addr, hi, lo);
+    else
+        hi = static_cast<uint64_t>(ntohl(addr.ipNetEndian())) << 32;
+    maskKey(hi, lo, length);
+    insert(isIpV6 ? kIpV6Root : kIpV4Root, hi, lo, length);
+    ++size_;
+}
+
+bool CidrSet::contains(const trantor::InetAddress &addr) const
+{
+    if (!addr.isIpV6())
+    {
+        return find(kIpV4Root,
+                    static_cast<uint64_t>(ntohl(addr.ipNetEndian())) << 32,
+                    0,
+                    32);
+    }
+    uint64_t hi;
+    uint64_t lo;
+    ipV6Key(addr, hi, lo);
+    if (hi == 0 && (lo >> 32) == 0xffff)
+    {
+        // ::ffff:a.b.c.d, e.g. the IPv4 peers of a dual-stack listener
+        return find(kIpV4Root, lo << 32, 0, 32);
+    }
+    return find(kIpV6Root, hi, lo, 128);
+}
+
+void CidrSet::insert(uint32_t root, uint64_t hi, uint64_t lo, uint8_t length)
+{
+    auto newNode = [this, hi, lo](uint8_t nodeLength, bool terminal) {
+        Node node;
+        node.hi = hi;
+        node.lo = lo;
+        maskKey(node.hi, node.lo, nodeLength);
+        node.length = nodeLength;
+        node.terminal = terminal;
+        nodes_.push_back(node);
+        return static_cast<uint32_t>(nodes_.size() - 1);
+    };
+    // The nodes are referred to by their indices, as nodes_ grows here.
+    auto node = root;
+    while (true)
+    {
+        if (nodes_[node].terminal)
+        {
+            // Covered by a shorter block
+            return;
+        }
+        if (nodes_[node].length == length)
+        {
+            // The block covers the longer ones below it, which are dropped.
+            nodes_[node].terminal = true;
+            nodes_[node].children[0] = 0;
+            nodes_[node].children[1] = 0;
+            return;
+        }
+        auto bit = bitAt(hi, lo, nodes_[node].length);
+        auto child = nodes_[node].children[bit];
+        if (child == 0)
+        {
+            auto leaf = newNode(length, true);
+            nodes_[node].children[bit] = leaf;
+            return;
+        }
+        auto childHi = nodes_[child].hi;
+        auto childLo = nodes_[child].lo;
+        auto childLength = nodes_[child].length;
+        auto common = commonLength(
+            hi, lo, childHi, childLo, (std::min)(length, childLength));
+        if (common == childLength)
+        {
+            node = child;
+            continue;
+        }
+        // Split the edge to the child where the keys differ, or where the
+        // block ends.
+        auto middle = newNode(common, common == length);
+        if (common != length)
+        {
+            auto leaf = newNode(length, true);
+            nodes_[middle].children[bitAt(hi, lo, common)] = leaf;
+            nodes_[middle].children[bitAt(childHi, childLo, common)] = child;
+        }
+        nodes_[node].children[bit] = middle;
+        return;
+    }
+}
+
+bool CidrSet::find(uint32_t root, uint64_t hi, uint64_t lo, uint8_t bits) const
+{
+    auto node = root;
+    while (true)
+    {
+        const auto &current = nodes_[node];
+        if (current.terminal)
+            return true;
+        if (current.length == bits)
+            return false;
+        auto child = current.children[bitAt(hi, lo, current.length)];
+        if (child == 0)
+            return false;
+        const auto &next = nodes_[child];
+        auto keyHi = hi;
+        auto keyLo = lo;
+        maskKey(keyHi, keyLo, next.length);
+        if (keyHi != next.hi || keyLo != next.lo)
+            return false;
+        node = child;
+    }
+}
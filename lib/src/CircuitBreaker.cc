@@ -0,0 +1,126 @@
+/**
+ *
+ *  @file CircuitBreaker.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/CircuitBreaker.h>
+#include <trantor/utils/Logger.h>
+
+using namespace drogon;
+
+CircuitBreaker::CircuitBreaker() : CircuitBreaker(Options())
+{
+}
+
+CircuitBreaker::CircuitBreaker(const Options &options)
+    : options_(options), windowStart_(Clock::now())
+{
+    if (options_.halfOpenProbes == 0)
+        options_.halfOpenProbes = 1;
+}
+
+bool CircuitBreaker::allow()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    switch (state_)
+    {
+        case State::Closed:
+            return true;
+        case State::Open:
+            if (Clock::now() < openUntil_)
+                return false;
+            state_ = State::HalfOpen;
+            probesAllowed_ = 0;
+            probesRecorded_ = 0;
+            [[fallthrough]];
+        case State::HalfOpen:
+            if (probesAllowed_ >= options_.halfOpenProbes)
+                return false;
+            ++probesAllowed_;
+            return true;
+    }
+    return true;
+}
+
+void CircuitBreaker::record(bool success, double latency)
+{
+    if (options_.slowCallThreshold > 0.0 &&
+        latency >= options_.slowCallThreshold)
+        success = false;
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    switch (state_)
+    {
+        case State::Closed:
+        {
+            if (now - windowStart_ >= std::chrono::duration<double>(
+                                          options_.window))
+            {
+                windowStart_ = now;
+                calls_ = 0;
+                failures_ = 0;
+            }
+            ++calls_;
+            if (!success)
+                ++failures_;
+            if (calls_ >= options_.minimumCalls &&
+                static_cast<double>(failures_) >=
+                    options_.failureRateThreshold *
+                        static_cast<double>(calls_))
+                open(now);
+            break;
+        }
+        case State::Open:
+            // A call allowed before the circuit opened
+            break;
+        case State::HalfOpen:
+            // The calls allowed before the circuit opened aren't probes.
+            if (probesRecorded_ >= probesAllowed_)
+                break;
+            ++probesRecorded_;
+            if (!success)
+                open(now);
+            else if (probesRecorded_ >= options_.halfOpenProbes)
+                close(now);
+            break;
+    }
+}
+
+CircuitBreaker::State CircuitBreaker::state() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ == State::Open && Clock::now() >= openUntil_)
+        return State::HalfOpen;
+    return state_;
+}
+
+void CircuitBreaker::open(Clock::time_point now)
+{
+    if (state_ == State::Closed)
+    {
+        LOG_WARN << "The circuit breaker opens after " << failures_
+                 << " failed calls out of " << calls_;
+    }
+    state_ = State::Open;
+    openUntil_ =
+        now + std::chrono::duration_cast<Clock::duration>(
+                  std::chrono::duration<double>(options_.openDuration));
+}
+
+void CircuitBreaker::close(Clock::time_point now)
+{
+    LOG_INFO << "The circuit breaker closes";
+    state_ = State::Closed;
+    windowStart_ = now;
+    calls_ = 0;
+    failures_ = 0;
+}
@@ -0,0 +1,300 @@
+/**
+ *
+ *  @file ConcurrencyLimiter.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "HttpRequestImpl.h"
+#include <drogon/ConcurrencyLimiter.h>
+#include <drogon/HttpAppFramework.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace drogon;
+
+namespace
+{
+// The upper bound of the adaptive limits without a maximum.
+constexpr size_t kDefaultAdaptiveMax = 1000;
+
+ConcurrencyLimiter::Options normalize(ConcurrencyLimiter::Options options)
+{
+    if (options.adaptive && options.maxInflight == 0)
+        options.maxInflight = kDefaultAdaptiveMax;
+    options.minInflight =
+        std::max<size_t>(1, std::min(options.minInflight, options.maxInflight));
+    return options;
+}
+
+// Run the function in the IO loop of the request, the queued requests are
+// resumed by the completion of others, maybe in other loops.
+void runInLoop(const HttpRequestPtr &req, std::function<void()> &&func)
+{
+    auto loop = static_cast<HttpRequestImpl *>(req.get())->getLoop();
+    if (loop && !loop->isInLoopThread())
+        loop->queueInLoop(std::move(func));
+    else
+        func();
+}
+
+bool hasRoom(size_t inflight, double limit)
+{
+    return limit <= 0.0 || static_cast<double>(inflight) < std::floor(limit);
+}
+}  // namespace
+
+void ConcurrencyLimiter::setDefaultOptions(const Options &options)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    defaultOptions_ = normalize(options);
+    for (auto &[pathPattern, route] : routes_)
+    {
+        if (routeOptions_.find(pathPattern) != routeOptions_.end())
+            continue;
+        route.options = defaultOptions_;
+        route.limit = static_cast<double>(route.options.maxInflight);
+    }
+}
+
+void ConcurrencyLimiter::setOptions(const std::string &pathPattern,
+                                    const Options &options)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto normalized = normalize(options);
+    routeOptions_[pathPattern] = normalized;
+    auto iter = routes_.find(pathPattern);
+    if (iter != routes_.end())
+    {
+        iter->second.options = normalized;
+        iter->second.limit = static_cast<double>(normalized.maxInflight);
+    }
+}
+
+ConcurrencyLimiter::Route &ConcurrencyLimiter::route(
+    const std::string &pathPattern)
+{
+    auto iter = routes_.find(pathPattern);
+    if (iter != routes_.end())
+        return iter->second;
+    auto &route = routes_[pathPattern];
+    auto optionsIter = routeOptions_.find(pathPattern);
+    route.options = optionsIter == routeOptions_.end() ? defaultOptions_
+                                                       : optionsIter->second;
+    route.limit = static_cast<double>(route.options.maxInflight);
+    return route;
+}
+
+void ConcurrencyLimiter::invoke(const HttpRequestPtr &req,
+                                MiddlewareNextCallback &&nextCb,
+                                MiddlewareCallback &&mcb)
+{
+    std::string pathPattern{req->matchedPathPattern()};
+    std::vector<WaiterPtr> expired;
+    WaiterPtr waiter;
+    double maxQueueTime{0.0};
+    bool rejected{false};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &route = this->route(pathPattern);
+        dropExpired(route, expired);
+        if (maxTotalInflight_ != 0 && totalInflight_ >= maxTotalInflight_)
+        {
+            rejected = true;
+        }
+        else if (route.queue.empty() && hasRoom(route.inflight, route.limit))
+        {
+            ++route.inflight;
+            ++totalInflight_;
+        }
+        else if (route.queue.size() < route.options.maxQueue)
+        {
+            waiter = std::make_shared<Waiter>(
+                Waiter{req, std::move(nextCb), std::move(mcb), Clock::now()});
+            route.queue.push_back(waiter);
+            maxQueueTime = route.options.maxQueueTime;
+        }
+        else
+        {
+            rejected = true;
+        }
+    }
+    for (auto &w : expired)
+    {
+        runInLoop(w->req,
+                  [w]() { ConcurrencyLimiter::reject(w->req, w->mcb); });
+    }
+    if (rejected)
+    {
+        reject(req, mcb);
+        return;
+    }
+    if (waiter)
+    {
+        // Rejected by a timer if no request completes in time, the queue is
+        // only checked on the arrivals and the completions otherwise.
+        auto loop = static_cast<HttpRequestImpl *>(req.get())->getLoop();
+        if (loop)
+        {
+            std::weak_ptr<Waiter> weakWaiter = waiter;
+            loop->runAfter(maxQueueTime, [this, pathPattern, weakWaiter]() {
+                if (auto w = weakWaiter.lock())
+                    expire(pathPattern, w);
+            });
+        }
+        return;
+    }
+    run(pathPattern, std::move(nextCb), std::move(mcb));
+}
+
+void ConcurrencyLimiter::run(const std::string &pathPattern,
+                             MiddlewareNextCallback &&nextCb,
+                             MiddlewareCallback &&mcb)
+{
+    auto start = Clock::now();
+    nextCb([this, pathPattern, start, mcb = std::move(mcb)](
+               const HttpResponsePtr &resp) {
+        std::chrono::duration<double> latency = Clock::now() - start;
+        mcb(resp);
+        onComplete(pathPattern, latency.count());
+    });
+}
+
+void ConcurrencyLimiter::onComplete(const std::string &pathPattern,
+                                    double latency)
+{
+    std::vector<WaiterPtr> expired;
+    std::vector<WaiterPtr> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &route = this->route(pathPattern);
+        if (route.inflight > 0)
+            --route.inflight;
+        if (totalInflight_ > 0)
+            --totalInflight_;
+        if (route.options.adaptive)
+            updateLimit(route, latency);
+        dropExpired(route, expired);
+        while (!route.queue.empty() && hasRoom(route.inflight, route.limit) &&
+               (maxTotalInflight_ == 0 || totalInflight_ < maxTotalInflight_))
+        {
+            auto waiter = std::move(route.queue.front());
+            route.queue.pop_front();
+            waiter->done = true;
+            ++route.inflight;
+            ++totalInflight_;
+            ready.emplace_back(std::move(waiter));
+        }
+    }
+    for (auto &waiter : expired)
+    {
+        runInLoop(waiter->req, [waiter]() {
+            ConcurrencyLimiter::reject(waiter->req, waiter->mcb);
+        });
+    }
+    for (auto &waiter : ready)
+    {
+        runInLoop(waiter->req, [this, pathPattern, waiter]() {
+            run(pathPattern, std::move(waiter->nextCb), std::move(waiter->mcb));
+        });
+    }
+}
+
+void ConcurrencyLimiter::updateLimit(Route &route, double latency)
+{
+    // The gradient limit: the limit follows the ratio of the long-term
+    // latency to the short-term one, plus a queue allowance of its square
+    // root letting it grow while the latency is stable.
+    if (route.longLatency <= 0.0)
+    {
+        route.shortLatency = latency;
+        route.longLatency = latency;
+        return;
+    }
+    route.shortLatency = route.shortLatency * 0.8 + latency * 0.2;
+    route.longLatency = route.longLatency * 0.99 + latency * 0.01;
+    // The latency recovered, forget the old slow requests faster.
+    if (route.longLatency > route.shortLatency * 2.0)
+        route.longLatency *= 0.95;
+    double gradient =
+        route.shortLatency > 0.0 ? route.longLatency / route.shortLatency : 1.0;
+    gradient = std::clamp(gradient, 0.5, 1.0);
+    double newLimit = route.limit * gradient + std::sqrt(route.limit);
+    // Don't grow while the handler doesn't use half of the limit.
+    if (static_cast<double>(route.inflight) * 2.0 < route.limit)
+        newLimit = std::min(newLimit, route.limit);
+    route.limit = std::clamp(route.limit * 0.8 + newLimit * 0.2,
+                             static_cast<double>(route.options.minInflight),
+                             static_cast<double>(route.options.maxInflight));
+}
+
+void ConcurrencyLimiter::dropExpired(Route &route,
+                                     std::vector<WaiterPtr> &expired)
+{
+    // Like CoDel, the requests waiting longer than the target are dropped
+    // from the head of the queue.
+    auto now = Clock::now();
+    while (!route.queue.empty())
+    {
+        auto &waiter = route.queue.front();
+        std::chrono::duration<double> waited = now - waiter->enqueuedAt;
+        if (waited.count() < route.options.maxQueueTime)
+            break;
+        waiter->done = true;
+        expired.emplace_back(std::move(waiter));
+        route.queue.pop_front();
+    }
+}
+
+void ConcurrencyLimiter::expire(const std::string &pathPattern,
+                                const WaiterPtr &waiter)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (waiter->done)
+            return;
+        waiter->done = true;
+        auto &queue = route(pathPattern).queue;
+        queue.erase(std::remove(queue.begin(), queue.end(), waiter),
+                    queue.end());
+    }
+    reject(waiter->req, waiter->mcb);
+}
+
+void ConcurrencyLimiter::reject(const HttpRequestPtr &req,
+                                const MiddlewareCallback &mcb)
+{
+    auto resp = app().getCustomErrorHandler()(k503ServiceUnavailable, req);
+    resp->addHeader("retry-after", "1");
+    mcb(resp);
+}
+
+size_t ConcurrencyLimiter::inflight(const std::string &pathPattern) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = routes_.find(pathPattern);
+    return iter == routes_.end() ? 0 : iter->second.inflight;
+}
+
+size_t ConcurrencyLimiter::queued(const std::string &pathPattern) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = routes_.find(pathPattern);
+    return iter == routes_.end() ? 0 : iter->second.queue.size();
+}
+
+size_t ConcurrencyLimiter::limit(const std::string &pathPattern) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = routes_.find(pathPattern);
+    if (iter == routes_.end())
+        return 0;
+    return static_cast<size_t>(iter->second.limit);
+}
@@ -14,7 +14,10 @@
 
 #include "ConfigLoader.h"
 #include "HttpAppFrameworkImpl.h"
+#include "HttpUtils.h"
+#include "StaticFileRouter.h"
 #include <drogon/config.h>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -155,17 +158,8 @@ ConfigLoader::~ConfigLoader()
 {
 }
 
-static void loadLogSetting(const Json::Value &log)
+static void loadLogLevel(const Json::Value &log)
 {
-    if (!log)
-        return;
-    auto useSpdlog = log.get("use_spdlog", false).asBool();
-    auto logPath = log.get("log_path", "").asString();
-    auto baseName = log.get("logfile_base_name", "").asString();
-    auto logSize = log.get("log_size_limit", 100000000).asUInt64();
-    auto maxFiles = log.get("max_files", 0).asUInt();
-    HttpAppFrameworkImpl::instance().setLogPath(
-        logPath, baseName, logSize, maxFiles, useSpdlog);
     auto logLevel = log.get("log_level", "DEBUG").asString();
     if (logLevel == "TRACE")
     {
@@ -183,6 +177,20 @@ static void loadLogSetting(const Json::Value &log)
     {
         trantor::Logger::setLogLevel(trantor::Logger::kWarn);
     }
+}
+
+static void loadLogSetting(const Json::Value &log)
+{
+    if (!log)
+        return;
+    auto useSpdlog = log.get("use_spdlog", false).asBool();
+    auto logPath = log.get("log_path", "").asString();
+    auto baseName = log.get("logfile_base_name", "").asString();
+    auto logSize = log.get("log_size_limit", 100000000).asUInt64();
+    auto maxFiles = log.get("max_files", 0).asUInt();
+    HttpAppFrameworkImpl::instance().setLogPath(
+        logPath, baseName, logSize, maxFiles, useSpdlog);
+    loadLogLevel(log);
     auto localTime = log.get("display_local_time", false).asBool();
     trantor::Logger::setDisplayLocalTime(localTime);
 }
@@ -263,6 +271,9 @@ static void loadApp(const Json::Value &app)
     if (threadsNum < 1)
         threadsNum = 1;
     drogon::app().setThreadNum(threadsNum);
+    // The threads of the handlers registered with the Offload constraint
+    drogon::app().setHandlerThreadNum(
+        app.get("number_of_handler_threads", 0).asUInt64());
     // session
     auto enableSession = app.get("enable_session", false).asBool();
     if (enableSession)
@@ -275,6 +286,8 @@ static void loadApp(const Json::Value &app)
                                     Cookie::convertString2SameSite(sameSite),
                                     cookieKey,
                                     maxAge);
+        drogon::app().enableLazySession(
+            app.get("session_lazy_loading", false).asBool());
     }
     else
         drogon::app().disableSession();
@@ -384,6 +397,11 @@ static void loadApp(const Json::Value &app)
     {
         drogon::app().setMaxConnectionNumPerIP(maxConnsPerIP);
     }
+    drogon::app().setForwardPoolOptions(
+        app.get("forward_connections_per_host", 4).asUInt64(),
+        app.get("forward_idle_timeout", 60.0).asDouble());
+    drogon::app().setMemorySoftLimit(
+        app.get("memory_soft_limit", 0).asUInt64());
 #if !defined(_WIN32) && !TARGET_OS_IOS
     // dynamic views
     auto enableDynamicViews = app.get("load_dynamic_views", false).asBool();
@@ -438,21 +456,97 @@ static void loadApp(const Json::Value &app)
     {
         drogon::app().enableRelaunchOnError();
     }
+    auto workers = app.get("worker_processes", 0).asUInt64();
+    drogon::app().setWorkerProcessNum(workers);
     auto useSendfile = app.get("use_sendfile", true).asBool();
     drogon::app().enableSendfile(useSendfile);
     auto useGzip = app.get("use_gzip", true).asBool();
     drogon::app().enableGzip(useGzip);
     auto useBr = app.get("use_brotli", false).asBool();
     drogon::app().enableBrotli(useBr);
+    if (app.isMember("compression_policies"))
+    {
+        auto &policies = app["compression_policies"];
+        if (!policies.isArray())
+        {
+            throw std::runtime_error(
+                "The compression_policies option must be an array");
+        }
+        for (auto &item : policies)
+        {
+            auto prefix = item.get("path_prefix", "").asString();
+            if (prefix.empty())
+                continue;
+            CompressionPolicy policy;
+            if (item.isMember("encodings"))
+            {
+                policy.encodings.clear();
+                for (auto &encoding : item["encodings"])
+                {
+                    auto name = encoding.asString();
+                    auto &encodings = policy.encodings;
+                    if (name == "br")
+                        encodings.push_back(CompressionEncoding::kBrotli);
+                    else if (name == "gzip")
+                        encodings.push_back(CompressionEncoding::kGzip);
+                    else if (name == "zstd")
+                        encodings.push_back(CompressionEncoding::kZstd);
+                    else
+                        throw std::runtime_error("Unknown encoding " + name +
+                                                 " of the compression policy");
+                }
+            }
+            policy.gzipLevel = item.get("gzip_level", policy.gzipLevel).asInt();
+            policy.brotliQuality =
+                item.get("brotli_quality", policy.brotliQuality).asInt();
+            policy.zstdLevel = item.get("zstd_level", policy.zstdLevel).asInt();
+            policy.minSize = item.get("min_size", Json::UInt64(policy.minSize))
+                                 .asUInt64();
+            for (auto &type : item["content_types"])
+            {
+                auto contentType = parseContentType(type.asString());
+                if (contentType == CT_NONE || contentType == CT_CUSTOM)
+                {
+                    throw std::runtime_error("Unknown content type " +
+                                             type.asString() +
+                                             " of the compression policy");
+                }
+                policy.contentTypes.push_back(contentType);
+            }
+            drogon::app().setCompressionPolicy(prefix, policy);
+        }
+    }
+    auto useHttp2 = app.get("enable_http2", false).asBool();
+    drogon::app().enableHttp2(useHttp2);
+    auto zeroCopyHeaders = app.get("zero_copy_headers", false).asBool();
+    drogon::app().enableZeroCopyHeaders(zeroCopyHeaders);
     auto staticFilesCacheTime = app.get("static_files_cache_time", 5).asInt();
     drogon::app().setStaticFilesCacheTime(staticFilesCacheTime);
+    auto staticFilesCacheMaxSize =
+        app.get("static_files_cache_max_size", 0).asUInt64();
+    drogon::app().setStaticFilesCacheMaxSize(staticFilesCacheMaxSize);
+    auto staticFileStatCacheTime =
+        app.get("static_file_stat_cache_time", 0.0).asDouble();
+    drogon::app().setStaticFileStatCacheTime(staticFileStatCacheTime);
+    auto configReloadInterval =
+        app.get("config_reload_interval", 0.0).asDouble();
+    if (configReloadInterval > 0)
+        drogon::app().enableConfigReload(configReloadInterval);
     loadControllers(app["simple_controllers_map"]);
     // Kick off idle connections
     auto kickOffTimeout = app.get("idle_connection_timeout", 60).asUInt64();
     drogon::app().setIdleConnectionTimeout(kickOffTimeout);
+    drogon::app().setIdleMemoryTrimTimeout(
+        app.get("idle_memory_trim_timeout", 0).asUInt64());
+    drogon::app().setRequestDeadline(
+        app.get("request_deadline", 0.0).asDouble(),
+        app.get("request_deadline_header", "").asString());
     auto server = app.get("server_header_field", "").asString();
     if (!server.empty())
         drogon::app().setServerHeaderField(server);
+    auto altSvc = app.get("alt_svc_header_field", "").asString();
+    if (!altSvc.empty())
+        drogon::app().setAltSvcHeaderField(altSvc);
     auto sendServerHeader = app.get("enable_server_header", true).asBool();
     drogon::app().enableServerHeader(sendServerHeader);
     auto sendDateHeader = app.get("enable_date_header", true).asBool();
@@ -465,6 +559,10 @@ static void loadApp(const Json::Value &app)
     drogon::app().setGzipStatic(useGzipStatic);
     auto useBrStatic = app.get("br_static", true).asBool();
     drogon::app().setBrStatic(useBrStatic);
+    auto useMmapStatic = app.get("mmap_static", false).asBool();
+    drogon::app().setMmapStatic(useMmapStatic);
+    auto usePrecompressStatic = app.get("precompress_static", false).asBool();
+    drogon::app().setPrecompressStatic(usePrecompressStatic);
     auto maxBodySize = app.get("client_max_body_size", "1M").asString();
     size_t size;
     if (bytesSize(maxBodySize, size))
@@ -496,7 +594,41 @@ static void loadApp(const Json::Value &app)
         throw std::runtime_error(
             "Error format of client_max_websocket_message_size");
     }
+    drogon::app().enableWebSocketCompression(
+        app.get("enable_websocket_compression", false).asBool());
     drogon::app().enableReusePort(app.get("reuse_port", false).asBool());
+    auto balancing = app.get("connection_balancing", "kernel").asString();
+    if (balancing == "kernel")
+    {
+        drogon::app().setConnectionBalancing(ConnectionBalancing::kKernel);
+    }
+    else if (balancing == "least_connections")
+    {
+        drogon::app().setConnectionBalancing(
+            ConnectionBalancing::kLeastConnections);
+    }
+    else if (balancing == "least_lag")
+    {
+        drogon::app().setConnectionBalancing(ConnectionBalancing::kLeastLag);
+    }
+    else if (balancing == "local_cpu")
+    {
+        drogon::app().setConnectionBalancing(ConnectionBalancing::kLocalCpu);
+    }
+    else
+    {
+        throw std::runtime_error("Invalid connection_balancing: " + balancing);
+    }
+    const auto &cpus = app["io_loop_cpus"];
+    if (cpus.isArray() && !cpus.empty())
+    {
+        std::vector<size_t> loopCpus;
+        for (auto const &cpu : cpus)
+        {
+            loopCpus.push_back(cpu.asUInt64());
+        }
+        drogon::app().setIoLoopCpus(loopCpus);
+    }
     drogon::app().setHomePage(app.get("home_page", "index.html").asString());
     drogon::app().setImplicitPageEnable(
         app.get("use_implicit_page", true).asBool());
@@ -525,9 +657,18 @@ static void loadApp(const Json::Value &app)
     bool enableCompressedRequests =
         app.get("enabled_compressed_request", false).asBool();
     drogon::app().enableCompressedRequest(enableCompressedRequests);
+    drogon::app().enableDynamicETag(
+        app.get("enable_dynamic_etag", false).asBool());
 
     drogon::app().enableRequestStream(
         app.get("enable_request_stream", false).asBool());
+    drogon::app().setDnsCacheTtl(app.get("dns_cache_ttl", 600.0).asDouble());
+    drogon::app().enableOutputCorking(
+        app.get("enable_output_corking", false).asBool());
+    drogon::app().setGracefulShutdownTimeout(
+        app.get("graceful_shutdown_timeout", 0.0).asDouble());
+    drogon::app().setSlowQueryThreshold(
+        app.get("slow_query_threshold", 0.0).asDouble());
 }
 
 static void loadDbClients(const Json::Value &dbClients)
@@ -571,6 +712,42 @@ static void loadDbClients(const Json::Value &dbClients)
         auto connectOptions = client.get("connect_options", Json::Value());
         auto timeout = client.get("timeout", -1.0).asDouble();
         auto autoBatch = client.get("auto_batch", false).asBool();
+        auto binaryResults = client.get("binary_results", false).asBool();
+        auto maxPreparedStatements =
+            client.get("max_prepared_statements", 0).asUInt64();
+        auto prepareThreshold = client.get("prepare_threshold", 1).asUInt();
+        auto preparedStatements =
+            client.get("prepared_statements", false).asBool();
+        std::vector<orm::ReplicaConfig> replicas;
+        for (auto const &replica : client["replicas"])
+        {
+            replicas.push_back(
+                {replica.get("host", "").asString(),
+                 static_cast<unsigned short>(replica.get("port", 0).asUInt())});
+        }
+        auto maxReplicaLag = client.get("max_replica_lag", -1.0).asDouble();
+        auto maxConnNum = client.get("max_number_of_connections", 0).asUInt();
+        auto idleConnTimeout =
+            client.get("idle_connection_timeout", 60.0).asDouble();
+        std::vector<std::string> warmupStatements;
+        for (auto const &statement : client["warmup_statements"])
+        {
+            warmupStatements.push_back(statement.asString());
+        }
+        if (type == "sqlite3")
+        {
+            orm::Sqlite3Config config{connNum, filename, name, timeout};
+            config.journalMode = client.get("journal_mode", "").asString();
+            config.busyTimeout = client.get("busy_timeout", 0).asUInt();
+            config.mmapSize = client.get("mmap_size", 0).asUInt64();
+            config.cacheSize = client.get("cache_size", 0).asInt();
+            config.synchronous = client.get("synchronous", "").asString();
+            config.tempStore = client.get("temp_store", "").asString();
+            config.immutable = client.get("immutable", false).asBool();
+            config.maxPreparedStatements = maxPreparedStatements;
+            HttpAppFrameworkImpl::instance().addDbClient(config);
+            continue;
+        }
 
         std::unordered_map<std::string, std::string> options;
         if (connectOptions.isObject() && !connectOptions.empty())
@@ -581,20 +758,30 @@ static void loadDbClients(const Json::Value &dbClients)
             }
         }
 
-        HttpAppFrameworkImpl::instance().addDbClient(type,
-                                                     host,
-                                                     port,
-                                                     dbname,
-                                                     user,
-                                                     password,
-                                                     connNum,
-                                                     filename,
-                                                     name,
-                                                     isFast,
-                                                     characterSet,
-                                                     timeout,
-                                                     autoBatch,
-                                                     std::move(options));
+        HttpAppFrameworkImpl::instance().addDbClient(
+            type,
+            host,
+            port,
+            dbname,
+            user,
+            password,
+            connNum,
+            filename,
+            name,
+            isFast,
+            characterSet,
+            timeout,
+            autoBatch,
+            std::move(options),
+            binaryResults,
+            maxPreparedStatements,
+            prepareThreshold,
+            std::move(replicas),
+            maxReplicaLag,
+            maxConnNum,
+            idleConnTimeout,
+            preparedStatements,
+            std::move(warmupStatements));
     }
 }
 
@@ -647,6 +834,22 @@ static void loadListeners(const Json::Value &listeners)
     LOG_TRACE << "Has " << listeners.size() << " listeners";
     for (auto const &listener : listeners)
     {
+        if (listener.isMember("unix_socket"))
+        {
+            auto path = listener["unix_socket"].asString();
+            auto modeStr = listener.get("unix_socket_mode", "0660").asString();
+            char *end{nullptr};
+            auto mode = strtol(modeStr.c_str(), &end, 8);
+            if (modeStr.empty() || *end != '\0' || mode < 0 || mode > 07777)
+            {
+                LOG_FATAL << "Invalid unix_socket_mode '" << modeStr
+                          << "', it should be an octal number like \"0660\"";
+                abort();
+            }
+            LOG_TRACE << "Add unix listener:" << path;
+            drogon::app().addUnixListener(path, static_cast<int>(mode));
+            continue;
+        }
         auto addr = listener.get("address", "0.0.0.0").asString();
         auto port = (uint16_t)listener.get("port", 0).asUInt();
         auto useSSL = listener.get("https", false).asBool();
@@ -671,6 +874,11 @@ static void loadListeners(const Json::Value &listeners)
         LOG_TRACE << "Add listener:" << addr << ":" << port;
         drogon::app().addListener(
             addr, port, useSSL, cert, key, useOldTLS, sslConfCmds);
+        if (listener.get("low_latency", false).asBool())
+        {
+            drogon::app().enableLowLatency(
+                port, listener.get("busy_poll", 50).asUInt64());
+        }
     }
 }
 
@@ -681,6 +889,8 @@ static void loadSSL(const Json::Value &sslConf)
     auto key = sslConf.get("key", "").asString();
     auto cert = sslConf.get("cert", "").asString();
     drogon::app().setSSLFiles(cert, key);
+    drogon::app().enableTlsSessionSharing(
+        sslConf.get("share_sessions", false).asBool());
     std::vector<std::pair<std::string, std::string>> sslConfCmds;
     if (sslConf.isMember("conf"))
     {
@@ -708,3 +918,16 @@ void ConfigLoader::load()
     loadDbClients(configJsonRoot_["db_clients"]);
     loadRedisClients(configJsonRoot_["redis_clients"]);
 }
+
+void ConfigLoader::reload()
+{
+    // Only the options which can be changed while the application runs
+    const auto &app = configJsonRoot_["app"];
+    if (app["log"])
+        loadLogLevel(app["log"]);
+    auto staticFilesCacheTime = app.get("static_files_cache_time", 5).asInt();
+    StaticFileRouter::instance().setStaticFilesCacheTime(staticFilesCacheTime);
+    auto staticFileStatCacheTime =
+        app.get("static_file_stat_cache_time", 0.0).asDouble();
+    StaticFileRouter::instance().setFileStatCacheTime(staticFileStatCacheTime);
+}
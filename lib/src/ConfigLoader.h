@@ -35,6 +35,10 @@ class ConfigLoader : public trantor::NonCopyable
 
     void load() noexcept(false);
 
+    /// Apply the options which can be changed while the application runs,
+    /// see HttpAppFramework::enableConfigReload().
+    void reload();
+
   private:
     std::string configFile_;
     Json::Value configJsonRoot_;
@@ -0,0 +1,280 @@
+/**
+ *
+ *  @file ConnectionBalancer.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "ConnectionBalancer.h"
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <chrono>
+#ifdef __linux__
+#include <linux/filter.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+using namespace drogon;
+
+// The number of seconds between the updates of the weights
+static constexpr double kUpdateInterval = 0.1;
+// The lags shorter than this number of nanoseconds are not told apart.
+static constexpr int64_t kLagUnit = 100'000;
+
+static int64_t steadyNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void ConnectionBalancer::init(ConnectionBalancing balancing,
+                              const std::vector<trantor::EventLoop *> &ioLoops)
+{
+    balancing_ = balancing;
+    ioLoops_ = ioLoops;
+    loopNum_ = ioLoops.size();
+    loads_ = std::make_unique<LoopLoad[]>(loopNum_);
+    enabled_ = false;
+    if (balancing == ConnectionBalancing::kKernel || ioLoops.size() < 2)
+        return;
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    if (app().reusePort())
+    {
+        LOG_WARN << "The connections are balanced by the kernel in the "
+                    "ReusePort mode";
+        return;
+    }
+    if (balancing == ConnectionBalancing::kLocalCpu)
+    {
+        auto &cpus = app().getIoLoopCpus();
+        if (cpus.empty())
+        {
+            LOG_WARN << "The connections are balanced by the kernel, the IO "
+                        "loops are not pinned to CPUs";
+            return;
+        }
+        for (size_t i = 0; i < loopNum_; ++i)
+            loopCpus_.push_back(cpus[i % cpus.size()]);
+    }
+    enabled_ = true;
+#else
+    LOG_WARN << "The connections are balanced by the kernel on this platform";
+#endif
+}
+
+void ConnectionBalancer::addListenSocket(int fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    fds_.push_back(fd);
+}
+
+void ConnectionBalancer::start(trantor::EventLoop *loop)
+{
+    if (!enabled_)
+        return;
+    if (balancing_ == ConnectionBalancing::kLocalCpu)
+    {
+        // The program doesn't depend on the loads.
+        update();
+        return;
+    }
+    timerLoop_ = loop;
+    timerId_ = loop->runEvery(kUpdateInterval, [this]() {
+        if (balancing_ == ConnectionBalancing::kLeastLag)
+            probe();
+        update();
+    });
+}
+
+void ConnectionBalancer::stop()
+{
+    if (timerLoop_)
+    {
+        timerLoop_->invalidateTimer(timerId_);
+        timerLoop_ = nullptr;
+    }
+}
+
+void ConnectionBalancer::probe()
+{
+    auto now = steadyNow();
+    for (size_t i = 0; i < loopNum_; ++i)
+    {
+        auto &load = loads_[i];
+        auto probeTime = load.probeTime.load(std::memory_order_acquire);
+        if (probeTime != 0)
+        {
+            // The previous probe is still waiting.
+            load.lag.store(std::max(load.lag.load(std::memory_order_relaxed),
+                                    now - probeTime),
+                           std::memory_order_relaxed);
+            continue;
+        }
+        load.probeTime.store(now, std::memory_order_release);
+        ioLoops_[i]->queueInLoop([&load]() {
+            auto probeTime = load.probeTime.load(std::memory_order_acquire);
+            load.lag.store(steadyNow() - probeTime,
+                           std::memory_order_relaxed);
+            load.probeTime.store(0, std::memory_order_release);
+        });
+    }
+}
+
+std::vector<uint32_t> ConnectionBalancer::computeBounds(
+    const std::vector<uint64_t> &loads)
+{
+    std::vector<uint32_t> bounds(loads.size(), kBuckets);
+    if (loads.empty())
+        return bounds;
+    uint64_t maxLoad = *std::max_element(loads.begin(), loads.end());
+    uint64_t sum = 0;
+    for (auto load : loads)
+        sum += load;
+    uint64_t mean = sum / loads.size();
+    std::vector<uint64_t> weights;
+    weights.reserve(loads.size());
+    uint64_t total = 0;
+    for (auto load : loads)
+    {
+        weights.push_back(maxLoad - load + mean + 1);
+        total += weights.back();
+    }
+    uint64_t cumulated = 0;
+    for (size_t i = 0; i + 1 < loads.size(); ++i)
+    {
+        cumulated += weights[i];
+        bounds[i] = static_cast<uint32_t>(cumulated * kBuckets / total);
+    }
+    return bounds;
+}
+
+std::vector<uint32_t> ConnectionBalancer::computeCpuLoops(
+    const std::vector<size_t> &loopCpus)
+{
+    std::vector<uint32_t> cpuLoops;
+    if (loopCpus.empty())
+        return cpuLoops;
+    auto cpuNum = *std::max_element(loopCpus.begin(), loopCpus.end()) + 1;
+    std::vector<bool> assigned(cpuNum, false);
+    cpuLoops.resize(cpuNum);
+    for (size_t cpu = 0; cpu < cpuNum; ++cpu)
+        cpuLoops[cpu] = static_cast<uint32_t>(cpu % loopCpus.size());
+    for (size_t i = 0; i < loopCpus.size(); ++i)
+    {
+        auto cpu = loopCpus[i];
+        if (assigned[cpu])
+            continue;
+        assigned[cpu] = true;
+        cpuLoops[cpu] = static_cast<uint32_t>(i);
+    }
+    return cpuLoops;
+}
+
+void ConnectionBalancer::update()
+{
+    if (balancing_ == ConnectionBalancing::kLocalCpu)
+    {
+        attachLocalCpuProgram();
+        return;
+    }
+    std::vector<uint64_t> loads;
+    loads.reserve(loopNum_);
+    for (size_t i = 0; i < loopNum_; ++i)
+    {
+        if (balancing_ == ConnectionBalancing::kLeastLag)
+            loads.push_back(static_cast<uint64_t>(
+                loads_[i].lag.load(std::memory_order_relaxed) / kLagUnit));
+        else
+            loads.push_back(
+                loads_[i].connections.load(std::memory_order_relaxed));
+    }
+    auto bounds = computeBounds(loads);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bounds == bounds_ && attachedFds_ == fds_.size())
+        return;
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    // A = random() % kBuckets, then the index of the first bound above A.
+    std::vector<sock_filter> code;
+    code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                            static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_RANDOM)));
+    code.push_back(BPF_STMT(BPF_ALU | BPF_AND | BPF_K, kBuckets - 1));
+    for (size_t i = 0; i + 1 < bounds.size(); ++i)
+    {
+        code.push_back(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, bounds[i], 1, 0));
+        code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(i)));
+    }
+    code.push_back(
+        BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(bounds.size() - 1)));
+    sock_fprog program;
+    program.len = static_cast<unsigned short>(code.size());
+    program.filter = code.data();
+    for (auto fd : fds_)
+    {
+        if (setsockopt(fd,
+                       SOL_SOCKET,
+                       SO_ATTACH_REUSEPORT_CBPF,
+                       &program,
+                       sizeof(program)) != 0)
+        {
+            LOG_ERROR << "Failed to balance the connections: "
+                      << strerror(errno);
+            enabled_ = false;
+            stop();
+            return;
+        }
+    }
+#endif
+    bounds_ = std::move(bounds);
+    attachedFds_ = fds_.size();
+}
+
+void ConnectionBalancer::attachLocalCpuProgram()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    // A = the CPU, then the loop of the CPU, or A % the number of loops for
+    // the CPUs above the table.
+    auto cpuLoops = computeCpuLoops(loopCpus_);
+    std::vector<sock_filter> code;
+    code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                            static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+    for (size_t cpu = 0; cpu < cpuLoops.size(); ++cpu)
+    {
+        code.push_back(BPF_JUMP(
+            BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(cpu), 0, 1));
+        code.push_back(BPF_STMT(BPF_RET | BPF_K, cpuLoops[cpu]));
+    }
+    code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K,
+                            static_cast<uint32_t>(loopNum_)));
+    code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+    sock_fprog program;
+    program.len = static_cast<unsigned short>(code.size());
+    program.filter = code.data();
+    for (auto fd : fds_)
+    {
+        if (setsockopt(fd,
+                       SOL_SOCKET,
+                       SO_ATTACH_REUSEPORT_CBPF,
+                       &program,
+                       sizeof(program)) != 0)
+        {
+            LOG_ERROR << "Failed to steer the connections to the local CPUs: "
+                      << strerror(errno);
+            enabled_ = false;
+            return;
+        }
+    }
+#endif
+    attachedFds_ = fds_.size();
+}
@@ -0,0 +1,123 @@
+/**
+ *
+ *  @file ConnectionBalancer.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/HttpAppFramework.h>
+#include <trantor/utils/NonCopyable.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief Steers the new connections to the IO loops with the lowest loads.
+ *
+ * On Linux, every IO loop has its own listening socket in the SO_REUSEPORT
+ * group of each port, at the index of the loop when they listen in the order
+ * of the loops. A classic BPF program attached to the group picks the socket
+ * of a new connection at random, with the weights of the loops computed from
+ * their loads, and is replaced periodically as the loads change. In the
+ * kLocalCpu way, the program picks the socket of the loop pinned to the CPU
+ * which received the connection, and is never replaced.
+ */
+class ConnectionBalancer : public trantor::NonCopyable
+{
+  public:
+    static ConnectionBalancer &instance()
+    {
+        static ConnectionBalancer balancer;
+        return balancer;
+    }
+
+    // Called before the listeners are created.
+    void init(ConnectionBalancing balancing,
+              const std::vector<trantor::EventLoop *> &ioLoops);
+
+    bool enabled() const
+    {
+        return enabled_;
+    }
+
+    // Called in the IO loops with a listening socket of each port.
+    void addListenSocket(int fd);
+
+    // Called after all the sockets listen.
+    void start(trantor::EventLoop *loop);
+    void stop();
+
+    void connectionOpened(trantor::EventLoop *loop)
+    {
+        auto index = loop->index();
+        if (index < loopNum_)
+            loads_[index].connections.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void connectionClosed(trantor::EventLoop *loop)
+    {
+        auto index = loop->index();
+        if (index < loopNum_)
+            loads_[index].connections.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static constexpr uint32_t kBuckets = 1024;
+
+    /**
+     * @brief Return the upper bounds of the ranges of random numbers in
+     * [0, kBuckets) sending the connections to each loop. The loads above the
+     * mean get proportionally fewer of them, equal loads get the same number.
+     */
+    static std::vector<uint32_t> computeBounds(
+        const std::vector<uint64_t> &loads);
+
+    /**
+     * @brief Return the loop of each CPU from 0 to the highest CPU the loops
+     * are pinned to, the first loop pinned to the CPU, or the CPU modulo the
+     * number of loops for the CPUs without a loop.
+     */
+    static std::vector<uint32_t> computeCpuLoops(
+        const std::vector<size_t> &loopCpus);
+
+  private:
+    struct LoopLoad
+    {
+        std::atomic<size_t> connections{0};
+        // The time the last probe waited in the queue of the loop, and the
+        // time the pending one was queued, in nanoseconds.
+        std::atomic<int64_t> lag{0};
+        std::atomic<int64_t> probeTime{0};
+    };
+
+    void update();
+    void probe();
+    void attachLocalCpuProgram();
+
+    ConnectionBalancing balancing_{ConnectionBalancing::kKernel};
+    bool enabled_{false};
+    std::vector<trantor::EventLoop *> ioLoops_;
+    std::unique_ptr<LoopLoad[]> loads_;
+    size_t loopNum_{0};
+    std::mutex mutex_;
+    std::vector<int> fds_;
+    size_t attachedFds_{0};
+    std::vector<uint32_t> bounds_;
+    // The CPUs of the loops, in the kLocalCpu way
+    std::vector<size_t> loopCpus_;
+    trantor::EventLoop *timerLoop_{nullptr};
+    trantor::TimerId timerId_{0};
+};
+}  // namespace drogon
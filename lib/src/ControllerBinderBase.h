@@ -36,6 +36,10 @@ struct ControllerBinderBase
     IOThreadStorage<HttpResponsePtr> responseCache_;
     std::shared_ptr<std::string> corsMethods_;
     bool isCORS_{false};
+    // Run in the pool of the handler threads, see the Offload constraint
+    bool offloaded_{false};
+    // Deferred behind the other requests of the loop, see LowPriority
+    bool lowPriority_{false};
 
     virtual ~ControllerBinderBase() = default;
     virtual void handleRequest(
@@ -21,67 +21,78 @@ std::string Cookie::cookieString() const
 {
     constexpr std::string_view prefix = "Set-Cookie: ";
     std::string ret;
+    if (attributesString_)
+    {
+        ret.reserve(prefix.size() + key_.size() + value_.size() + 1 +
+                    attributesString_->size());
+        ret = prefix;
+        ret.append(key_).append("=").append(value_).append(*attributesString_);
+        return ret;
+    }
     // reserve space to reduce frequency allocation
     ret.reserve(prefix.size() + key_.size() + value_.size() + 30);
     ret = prefix;
-    ret.append(key_).append("=").append(value_).append("; ");
+    ret.append(key_).append("=").append(value_);
+    ret.append(makeAttributesString());
+    return ret;
+}
+
+std::string Cookie::makeAttributesString() const
+{
+    std::string ret;
     if (expiresDate_.microSecondsSinceEpoch() !=
             (std::numeric_limits<int64_t>::max)() &&
         expiresDate_.microSecondsSinceEpoch() >= 0)
     {
-        ret.append("Expires=")
-            .append(utils::getHttpFullDateStr(expiresDate_))
-            .append("; ");
+        ret.append("; Expires=")
+            .append(utils::getHttpFullDateStr(expiresDate_));
     }
     if (maxAge_.has_value())
     {
-        ret.append("Max-Age=")
-            .append(std::to_string(maxAge_.value()))
-            .append("; ");
+        ret.append("; Max-Age=").append(std::to_string(maxAge_.value()));
     }
     if (!domain_.empty())
     {
-        ret.append("Domain=").append(domain_).append("; ");
+        ret.append("; Domain=").append(domain_);
     }
     if (!path_.empty())
     {
-        ret.append("Path=").append(path_).append("; ");
+        ret.append("; Path=").append(path_);
     }
     if (sameSite_ != SameSite::kNull)
     {
         switch (sameSite_)
         {
             case SameSite::kLax:
-                ret.append("SameSite=Lax; ");
+                ret.append("; SameSite=Lax");
                 break;
             case SameSite::kStrict:
-                ret.append("SameSite=Strict; ");
+                ret.append("; SameSite=Strict");
                 break;
             case SameSite::kNone:
-                ret.append("SameSite=None; ");
+                ret.append("; SameSite=None");
                 // Cookies with SameSite=None must now also specify the Secure
                 // attribute (they require a secure context/HTTPS).
-                ret.append("Secure; ");
+                ret.append("; Secure");
                 break;
             default:
                 // Lax replaced None as the default value to ensure that users
                 // have reasonably robust defense against some CSRF attacks
-                ret.append("SameSite=Lax; ");
+                ret.append("; SameSite=Lax");
         }
     }
     if ((secure_ && sameSite_ != SameSite::kNone) || partitioned_)
     {
-        ret.append("Secure; ");
+        ret.append("; Secure");
     }
     if (httpOnly_)
     {
-        ret.append("HttpOnly; ");
+        ret.append("; HttpOnly");
     }
     if (partitioned_)
     {
-        ret.append("Partitioned; ");
+        ret.append("; Partitioned");
     }
-    ret.resize(ret.length() - 2);  // delete last semicolon
     ret.append("\r\n");
     return ret;
 }
@@ -0,0 +1,493 @@
+/**
+ *
+ *  @file CpuProfiler.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "CpuProfiler.h"
+#include <drogon/utils/Utilities.h>
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#ifdef __linux__
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+using namespace drogon::internal;
+
+namespace
+{
+constexpr int kMaxDepth = 32;
+
+struct Sample
+{
+    int thread;
+    int depth;
+    // The expirations of the timer the sample stands for
+    int weight;
+    const char *route;
+    size_t routeLength;
+    void *frames[kMaxDepth];
+};
+
+/**
+ * The state shared with the signal handler, which only touches the
+ * atomics and the sample its index refers to.
+ */
+struct Session
+{
+    std::atomic<bool> sampling{false};
+    std::atomic<int> writers{0};
+    std::atomic<size_t> count{0};
+    std::vector<Sample> samples;
+    int frequency{0};
+    std::chrono::system_clock::time_point startTime;
+    // Guarded by mutex
+    bool running{false};
+    uint64_t generation{0};
+#ifdef __linux__
+    std::vector<timer_t> timers;
+#endif
+    std::mutex mutex;
+};
+
+Session session;
+
+/**
+ * The subset of the protocol buffers encoding needed by the profile.proto
+ * messages of pprof.
+ */
+class ProtoWriter
+{
+  public:
+    void varint(int field, uint64_t value)
+    {
+        if (value == 0)
+            return;
+        key(field, 0);
+        writeVarint(value);
+    }
+
+    void bytes(int field, std::string_view value)
+    {
+        key(field, 2);
+        writeVarint(value.length());
+        buffer_.append(value);
+    }
+
+    void message(int field, const ProtoWriter &writer)
+    {
+        bytes(field, writer.buffer_);
+    }
+
+    void append(const ProtoWriter &writer)
+    {
+        buffer_.append(writer.buffer_);
+    }
+
+    void packed(int field, const std::vector<uint64_t> &values)
+    {
+        ProtoWriter writer;
+        for (auto value : values)
+            writer.writeVarint(value);
+        bytes(field, writer.buffer_);
+    }
+
+    const std::string &buffer() const
+    {
+        return buffer_;
+    }
+
+  private:
+    void key(int field, int wireType)
+    {
+        writeVarint((static_cast<uint64_t>(field) << 3) | wireType);
+    }
+
+    void writeVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            buffer_.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        buffer_.push_back(static_cast<char>(value));
+    }
+
+    std::string buffer_;
+};
+
+class StringTable
+{
+  public:
+    StringTable()
+    {
+        index("");
+    }
+
+    uint64_t index(const std::string &str)
+    {
+        auto iter = indices_.find(str);
+        if (iter != indices_.end())
+            return iter->second;
+        indices_.emplace(str, strings_.size());
+        strings_.push_back(str);
+        return strings_.size() - 1;
+    }
+
+    const std::vector<std::string> &strings() const
+    {
+        return strings_;
+    }
+
+  private:
+    std::unordered_map<std::string, uint64_t> indices_;
+    std::vector<std::string> strings_;
+};
+
+struct Mapping
+{
+    uint64_t start;
+    uint64_t limit;
+    uint64_t offset;
+    std::string file;
+};
+
+// The executable mappings of the process
+std::vector<Mapping> readMappings()
+{
+    std::vector<Mapping> mappings;
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        std::istringstream fields(line);
+        std::string range, perms, offset, device, inode, file;
+        fields >> range >> perms >> offset >> device >> inode;
+        std::getline(fields >> std::ws, file);
+        auto dash = range.find('-');
+        if (perms.size() < 3 || perms[2] != 'x' || dash == std::string::npos)
+            continue;
+        Mapping mapping;
+        mapping.start = std::stoull(range.substr(0, dash), nullptr, 16);
+        mapping.limit = std::stoull(range.substr(dash + 1), nullptr, 16);
+        mapping.offset = std::stoull(offset, nullptr, 16);
+        mapping.file = std::move(file);
+        mappings.push_back(std::move(mapping));
+    }
+    return mappings;
+}
+
+std::string encodeProfile(const Sample *samples,
+                          size_t count,
+                          int frequency,
+                          std::chrono::system_clock::time_point startTime)
+{
+    ProtoWriter profile;
+    StringTable strings;
+    auto valueType = [&strings](const char *type, const char *unit) {
+        ProtoWriter writer;
+        writer.varint(1, strings.index(type));
+        writer.varint(2, strings.index(unit));
+        return writer;
+    };
+    // Profile.sample_type
+    profile.message(1, valueType("samples", "count"));
+    profile.message(1, valueType("cpu", "nanoseconds"));
+    const int64_t period = 1000000000 / frequency;
+
+    // The identical samples are merged
+    std::unordered_map<std::string, std::pair<const Sample *, uint64_t>>
+        stacks;
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto &sample = samples[i];
+        std::string key(sample.route ? sample.route : "",
+                        sample.route ? sample.routeLength : 0);
+        key.push_back('\0');
+        key.append(reinterpret_cast<const char *>(&sample.thread),
+                   sizeof(sample.thread));
+        key.append(reinterpret_cast<const char *>(sample.frames),
+                   sample.depth * sizeof(void *));
+        auto &stack = stacks[key];
+        stack.first = &sample;
+        stack.second += sample.weight;
+    }
+
+    auto mappings = readMappings();
+    std::unordered_map<uint64_t, uint64_t> locations;
+    ProtoWriter locationsWriter;
+    auto locationId = [&](uint64_t address) {
+        auto iter = locations.find(address);
+        if (iter != locations.end())
+            return iter->second;
+        uint64_t id = locations.size() + 1;
+        locations.emplace(address, id);
+        ProtoWriter location;
+        location.varint(1, id);
+        for (size_t m = 0; m < mappings.size(); ++m)
+        {
+            if (address >= mappings[m].start && address < mappings[m].limit)
+            {
+                location.varint(2, m + 1);
+                break;
+            }
+        }
+        location.varint(3, address);
+        locationsWriter.message(4, location);
+        return id;
+    };
+
+    for (auto &item : stacks)
+    {
+        auto &sample = *item.second.first;
+        auto hits = item.second.second;
+        std::vector<uint64_t> ids;
+        ids.reserve(sample.depth);
+        for (int i = 0; i < sample.depth; ++i)
+        {
+            auto address = reinterpret_cast<uint64_t>(sample.frames[i]);
+            // The callers are return addresses, the call is just before.
+            if (i > 0 && address > 0)
+                --address;
+            ids.push_back(locationId(address));
+        }
+        ProtoWriter writer;
+        writer.packed(1, ids);
+        writer.packed(2, {hits, hits * static_cast<uint64_t>(period)});
+        auto label = [&writer, &strings](const char *key,
+                                         const std::string &value) {
+            ProtoWriter labelWriter;
+            labelWriter.varint(1, strings.index(key));
+            labelWriter.varint(2, strings.index(value));
+            writer.message(3, labelWriter);
+        };
+        label("thread", "io-" + std::to_string(sample.thread));
+        if (sample.route && sample.routeLength > 0)
+            label("route", std::string(sample.route, sample.routeLength));
+        profile.message(2, writer);
+    }
+
+    for (size_t m = 0; m < mappings.size(); ++m)
+    {
+        ProtoWriter mapping;
+        mapping.varint(1, m + 1);
+        mapping.varint(2, mappings[m].start);
+        mapping.varint(3, mappings[m].limit);
+        mapping.varint(4, mappings[m].offset);
+        mapping.varint(5, strings.index(mappings[m].file));
+        profile.message(3, mapping);
+    }
+    // The fields may come in any order, the repeated ones are appended.
+    profile.append(locationsWriter);
+    auto periodType = valueType("cpu", "nanoseconds");
+    // All the strings are known here
+    for (auto &str : strings.strings())
+        profile.bytes(6, str);
+    profile.varint(9,
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       startTime.time_since_epoch())
+                       .count());
+    profile.varint(10,
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::system_clock::now() - startTime)
+                       .count());
+    profile.message(11, periodType);
+    profile.varint(12, period);
+    auto &result = profile.buffer();
+    return drogon::utils::gzipCompress(result.data(), result.size());
+}
+
+#ifdef __linux__
+void onSignal(int, siginfo_t *info, void *)
+{
+    auto savedErrno = errno;
+    // Sequentially consistent with stop(), which clears sampling and then
+    // waits until no handler is running.
+    session.writers.fetch_add(1);
+    auto &state = CpuProfiler::threadState();
+    if (session.sampling.load() && state.index >= 0)
+    {
+        auto index = session.count.fetch_add(1, std::memory_order_relaxed);
+        if (index < session.samples.size())
+        {
+            auto &sample = session.samples[index];
+            sample.thread = state.index;
+            // The CPU timers expire at the ticks of the scheduler at most,
+            // the missed expirations are counted as overruns.
+            sample.weight = 1 + (info->si_overrun > 0 ? info->si_overrun : 0);
+            sample.route = state.route;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            sample.routeLength = state.routeLength;
+            // The handler and the signal trampoline are skipped
+            void *frames[kMaxDepth + 2];
+            auto depth = backtrace(frames, kMaxDepth + 2);
+            sample.depth = depth > 2 ? depth - 2 : 0;
+            memcpy(sample.frames, frames + 2, sample.depth * sizeof(void *));
+        }
+    }
+    session.writers.fetch_sub(1);
+    errno = savedErrno;
+}
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+// Called in the thread of the loop
+void startTimer(int index, int frequency, uint64_t generation)
+{
+    CpuProfiler::threadState().index = index;
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock) != 0)
+    {
+        LOG_ERROR << "pthread_getcpuclockid error!";
+        return;
+    }
+    sigevent event;
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+    std::lock_guard<std::mutex> lock(session.mutex);
+    if (!session.running || session.generation != generation)
+        return;
+    timer_t timer;
+    if (timer_create(clock, &event, &timer) != 0)
+    {
+        LOG_ERROR << "timer_create error: " << strerror(errno);
+        return;
+    }
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_nsec = 1000000000 / frequency;
+    spec.it_value = spec.it_interval;
+    timer_settime(timer, 0, &spec, nullptr);
+    session.timers.push_back(timer);
+}
+#endif
+}  // namespace
+
+CpuProfiler &CpuProfiler::instance()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+bool CpuProfiler::running() const
+{
+    std::lock_guard<std::mutex> lock(session.mutex);
+    return session.running;
+}
+
+bool CpuProfiler::start(const std::vector<trantor::EventLoop *> &loops,
+                        int frequency,
+                        size_t maxSamples)
+{
+#ifdef __linux__
+    if (frequency <= 0 || frequency > 1000)
+        return false;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        if (session.running)
+            return false;
+        session.running = true;
+        generation = ++session.generation;
+    }
+    static std::once_flag once;
+    std::call_once(once, []() {
+        // The first call of backtrace() loads the unwinder, which must not
+        // happen in the signal handler.
+        void *frames[1];
+        (void)backtrace(frames, 1);
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = onSignal;
+        action.sa_flags = SA_RESTART | SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        // The handler stays, a pending signal may arrive after a profile.
+        sigaction(SIGPROF, &action, nullptr);
+    });
+    session.samples.assign(maxSamples, Sample{});
+    session.count.store(0, std::memory_order_relaxed);
+    session.frequency = frequency;
+    session.startTime = std::chrono::system_clock::now();
+    session.sampling.store(true);
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        loops[i]->runInLoop([index = static_cast<int>(i),
+                             frequency,
+                             generation]() {
+            startTimer(index, frequency, generation);
+        });
+    }
+    return true;
+#else
+    (void)loops;
+    (void)frequency;
+    (void)maxSamples;
+    return false;
+#endif
+}
+
+std::string CpuProfiler::stop()
+{
+#ifdef __linux__
+    {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        if (!session.running)
+            return {};
+        for (auto timer : session.timers)
+            timer_delete(timer);
+        session.timers.clear();
+        // The timers of the loops which haven't started theirs yet aren't
+        // created any more.
+        ++session.generation;
+    }
+    session.sampling.store(false);
+    // Wait for the handlers running in the other threads
+    while (session.writers.load() != 0)
+        std::this_thread::yield();
+    auto count = (std::min)(session.count.load(std::memory_order_relaxed),
+                            session.samples.size());
+    if (count < session.count.load(std::memory_order_relaxed))
+    {
+        LOG_WARN << "The profile is full, "
+                 << session.count.load(std::memory_order_relaxed) - count
+                 << " samples were dropped";
+    }
+    auto profile = encodeProfile(session.samples.data(),
+                                 count,
+                                 session.frequency,
+                                 session.startTime);
+    session.samples.clear();
+    session.samples.shrink_to_fit();
+    std::lock_guard<std::mutex> lock(session.mutex);
+    session.running = false;
+    return profile;
+#else
+    return {};
+#endif
+}
@@ -0,0 +1,122 @@
+/**
+ *
+ *  @file CpuProfiler.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/NonCopyable.h>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace drogon
+{
+namespace internal
+{
+/**
+ * @brief Samples the stacks of the IO threads on their CPU time and encodes
+ * them as a pprof profile, for the Profiler plugin.
+ *
+ * Each sampled thread gets a timer on its own CPU clock, which sends SIGPROF
+ * to it. The signal handler only copies the stack and the route of the
+ * thread into a buffer allocated beforehand, the samples are aggregated when
+ * the profile is stopped. The addresses are symbolized by pprof with the
+ * binaries of the mappings.
+ *
+ * Only one profile is taken at a time. Sampling is only supported on Linux.
+ */
+class CpuProfiler : public trantor::NonCopyable
+{
+  public:
+    static CpuProfiler &instance();
+
+    /**
+     * @brief Record the route in the samples of the thread while the scope
+     * lives, e.g. the pattern of the handler running in an IO loop.
+     *
+     * @note The route must outlive the profiles, as the pattern strings of
+     * the routers do.
+     */
+    class RouteScope
+    {
+      public:
+        explicit RouteScope(std::string_view route)
+            : previous_(threadState().route),
+              previousLength_(threadState().routeLength)
+        {
+            set(route.data(), route.length());
+        }
+
+        ~RouteScope()
+        {
+            set(previous_, previousLength_);
+        }
+
+        RouteScope(const RouteScope &) = delete;
+        RouteScope &operator=(const RouteScope &) = delete;
+
+      private:
+        static void set(const char *route, size_t length)
+        {
+            auto &state = threadState();
+            // Read by the signal handler of the thread
+            state.route = nullptr;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            state.routeLength = length;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            state.route = route;
+        }
+
+        const char *previous_;
+        size_t previousLength_;
+    };
+
+    /**
+     * @brief Start sampling the threads of the loops, at the frequency in
+     * Hz of their CPU time.
+     *
+     * @param maxSamples The samples beyond it are dropped.
+     * @return false if a profile is being taken or sampling is not
+     * supported.
+     */
+    bool start(const std::vector<trantor::EventLoop *> &loops,
+               int frequency,
+               size_t maxSamples);
+
+    /// Stop sampling and return the gzipped pprof profile.
+    std::string stop();
+
+    bool running() const;
+
+    struct ThreadState
+    {
+        // The index of the loop of the thread, -1 for the other threads.
+        int index{-1};
+        const char *route{nullptr};
+        size_t routeLength{0};
+    };
+
+    static ThreadState &threadState()
+    {
+        // Constant-initialized, so it can be read in the signal handler.
+        static thread_local ThreadState state;
+        return state;
+    }
+
+  private:
+    CpuProfiler() = default;
+};
+}  // namespace internal
+}  // namespace drogon
@@ -22,6 +22,7 @@
 #include <trantor/net/EventLoop.h>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace drogon
 {
@@ -50,6 +51,16 @@ class DbClientManager : public trantor::NonCopyable
     void addDbClient(const DbConfig &config);
     bool areAllDbClientsAvailable() const noexcept;
 
+    // The names of the clients which are not fast ones.
+    std::vector<std::string> dbClientNames() const
+    {
+        std::vector<std::string> names;
+        names.reserve(dbClientsMap_.size());
+        for (auto &item : dbClientsMap_)
+            names.push_back(item.first);
+        return names;
+    }
+
   private:
     std::map<std::string, DbClientPtr> dbClientsMap_;
 
@@ -57,6 +68,7 @@ class DbClientManager : public trantor::NonCopyable
     {
         std::string connectionInfo_;
         DbConfig config_;
+        std::vector<std::string> replicaConnectionInfos_;
     };
 
     std::vector<DbInfo> dbInfos_;
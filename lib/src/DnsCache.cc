@@ -0,0 +1,167 @@
+/**
+ *
+ *  @file DnsCache.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "DnsCache.h"
+#include <trantor/utils/Logger.h>
+
+using namespace drogon;
+using namespace drogon::internal;
+
+static void dispatch(trantor::EventLoop *loop,
+                     DnsCache::Callback &&callback,
+                     const std::vector<trantor::InetAddress> &addresses)
+{
+    // Always queued, the callers expect the callback after the call returns.
+    loop->queueInLoop([callback = std::move(callback), addresses]() {
+        callback(addresses);
+    });
+}
+
+void DnsCache::resolve(const std::string &hostname,
+                       trantor::EventLoop *loop,
+                       Callback callback)
+{
+    std::vector<trantor::InetAddress> addresses;
+    bool startQuery{false};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &entry = entries_[hostname];
+        if (entry.addresses.empty() || entry.expiry <= trantor::Date::now())
+        {
+            entry.waiters.push_back({loop, std::move(callback)});
+            if (entry.resolving)
+                return;
+            entry.resolving = true;
+            if (!threadPtr_)
+            {
+                threadPtr_ = std::make_unique<trantor::EventLoopThread>("DNS");
+                threadPtr_->run();
+            }
+            startQuery = true;
+        }
+        else
+        {
+            addresses = entry.addresses;
+        }
+    }
+    if (startQuery)
+    {
+        query(hostname);
+        return;
+    }
+    dispatch(loop, std::move(callback), addresses);
+}
+
+void DnsCache::query(const std::string &hostname)
+{
+    threadPtr_->getLoop()->queueInLoop([this, hostname]() {
+        if (!resolverPtr_)
+        {
+            // The cache of the resolver is left short, the addresses are
+            // kept here.
+            resolverPtr_ =
+                trantor::Resolver::newResolver(threadPtr_->getLoop(), 1);
+        }
+        resolverPtr_->resolve(
+            hostname,
+            trantor::Resolver::ResolverResultsCallback(
+                [this, hostname](
+                    const std::vector<trantor::InetAddress> &addresses) {
+                    onResolved(hostname, addresses);
+                }));
+    });
+}
+
+void DnsCache::onResolved(const std::string &hostname,
+                          const std::vector<trantor::InetAddress> &addresses)
+{
+    std::vector<Waiter> waiters;
+    std::vector<trantor::InetAddress> result;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &entry = entries_[hostname];
+        entry.resolving = false;
+        waiters.swap(entry.waiters);
+        if (!addresses.empty())
+        {
+            entry.addresses = sortForConnection(addresses);
+            entry.expiry = trantor::Date::now().after(ttl_);
+        }
+        else if (!entry.addresses.empty())
+        {
+            // The expired addresses are better than none while the DNS
+            // server is unreachable, they are queried again next time.
+            LOG_WARN << "Failed to resolve " << hostname
+                     << ", the expired addresses are used";
+        }
+        result = entry.addresses;
+        if (result.empty())
+            entries_.erase(hostname);
+    }
+    for (auto &waiter : waiters)
+    {
+        dispatch(waiter.loop, std::move(waiter.callback), result);
+    }
+}
+
+void DnsCache::invalidate(const std::string &hostname)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = entries_.find(hostname);
+    if (iter == entries_.end())
+        return;
+    if (iter->second.resolving)
+        iter->second.addresses.clear();
+    else
+        entries_.erase(iter);
+}
+
+void DnsCache::setTtl(double ttl)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ttl_ = ttl;
+}
+
+double DnsCache::ttl() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ttl_;
+}
+
+std::vector<trantor::InetAddress> DnsCache::sortForConnection(
+    std::vector<trantor::InetAddress> addresses)
+{
+    if (addresses.empty())
+        return addresses;
+    bool firstIsV6 = addresses.front().isIpV6();
+    std::vector<trantor::InetAddress> preferred;
+    std::vector<trantor::InetAddress> others;
+    for (auto &addr : addresses)
+    {
+        if (addr.isIpV6() == firstIsV6)
+            preferred.push_back(std::move(addr));
+        else
+            others.push_back(std::move(addr));
+    }
+    std::vector<trantor::InetAddress> sorted;
+    sorted.reserve(preferred.size() + others.size());
+    for (size_t i = 0; i < preferred.size() || i < others.size(); ++i)
+    {
+        if (i < preferred.size())
+            sorted.push_back(std::move(preferred[i]));
+        if (i < others.size())
+            sorted.push_back(std::move(others[i]));
+    }
+    return sorted;
+}
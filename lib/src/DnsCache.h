@@ -0,0 +1,112 @@
+/**
+ *
+ *  @file DnsCache.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <trantor/net/EventLoop.h>
+#include <trantor/net/EventLoopThread.h>
+#include <trantor/net/InetAddress.h>
+#include <trantor/net/Resolver.h>
+#include <trantor/utils/Date.h>
+#include <trantor/utils/NonCopyable.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace drogon
+{
+namespace internal
+{
+/**
+ * @brief The addresses of the host names resolved by the clients, shared by
+ * all the clients of the process.
+ *
+ * The addresses are kept for the TTL set by
+ * HttpAppFramework::setDnsCacheTtl(), the concurrent queries of a host name
+ * are merged into one, so the clients reconnecting at the same time don't
+ * query the DNS server each. The queries are run by a resolver in a thread of
+ * the cache.
+ */
+class DROGON_EXPORT DnsCache : public trantor::NonCopyable
+{
+  public:
+    using Callback =
+        std::function<void(const std::vector<trantor::InetAddress> &)>;
+
+    static DnsCache &instance()
+    {
+        static DnsCache cache;
+        return cache;
+    }
+
+    /**
+     * @brief Resolve the host name.
+     *
+     * @param callback The callback is called in the loop with the addresses
+     * ordered for the connection attempts, not all of them from the same
+     * family in a row (RFC 8305 section 4), or an empty list if the name
+     * can't be resolved. The port of the addresses is 0.
+     */
+    void resolve(const std::string &hostname,
+                 trantor::EventLoop *loop,
+                 Callback callback);
+
+    /// Forget the addresses of the host name, e.g. when none of them can be
+    /// connected.
+    void invalidate(const std::string &hostname);
+
+    /// The time in seconds the addresses are kept, 0 to keep them only for
+    /// the queries in progress.
+    void setTtl(double ttl);
+    double ttl() const;
+
+    /// Interleave the address families, starting with the family of the first
+    /// address, which is preferred by the resolver.
+    static std::vector<trantor::InetAddress> sortForConnection(
+        std::vector<trantor::InetAddress> addresses);
+
+  private:
+    DnsCache() = default;
+
+    struct Waiter
+    {
+        trantor::EventLoop *loop;
+        Callback callback;
+    };
+
+    struct Entry
+    {
+        std::vector<trantor::InetAddress> addresses;
+        trantor::Date expiry;
+        bool resolving{false};
+        std::vector<Waiter> waiters;
+    };
+
+    void query(const std::string &hostname);
+    void onResolved(const std::string &hostname,
+                    const std::vector<trantor::InetAddress> &addresses);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    double ttl_{600.0};
+    // Only used in the loop of the thread, destroyed after the thread ends.
+    std::shared_ptr<trantor::Resolver> resolverPtr_;
+    std::unique_ptr<trantor::EventLoopThread> threadPtr_;
+};
+}  // namespace internal
+}  // namespace drogon
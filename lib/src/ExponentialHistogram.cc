@@ -0,0 +1,166 @@
+#include <drogon/utils/monitoring/ExponentialHistogram.h>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+using namespace drogon;
+using namespace drogon::monitoring;
+
+// Neighbouring bounds differ by less than 0.3% with the highest schema, so
+// std::to_string() isn't precise enough.
+static std::string boundToString(double bound)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", bound);
+    return buf;
+}
+
+ExponentialHistogram::ExponentialHistogram(
+    const std::string &name,
+    const std::vector<std::string> &labelNames,
+    const std::vector<std::string> &labelValues,
+    int schema,
+    double minValue,
+    double maxValue) noexcept(false)
+    : Metric(name, labelNames, labelValues),
+      minValue_(minValue),
+      scale_(std::ldexp(1.0, schema)),
+      bucketsCount_(minValue > 0 && maxValue > minValue
+                        ? (size_t)std::ceil(std::log2(maxValue / minValue) *
+                                            std::ldexp(1.0, schema)) +
+                              1
+                        : 0)
+{
+    if (schema < -4 || schema > 8)
+    {
+        throw std::runtime_error("The schema must be between -4 and 8");
+    }
+    if (bucketsCount_ == 0)
+    {
+        throw std::runtime_error(
+            "The minimum value must be positive and less than the maximum "
+            "value");
+    }
+}
+
+ExponentialHistogram::~ExponentialHistogram()
+{
+    for (auto &cell : cells_)
+    {
+        delete[] cell.buckets.load(std::memory_order_relaxed);
+    }
+}
+
+double ExponentialHistogram::upperBound(size_t index) const
+{
+    return minValue_ * std::exp2((double)index / scale_);
+}
+
+void ExponentialHistogram::observe(double value)
+{
+    size_t index{0};
+    if (value > minValue_)
+    {
+        auto position = std::ceil(std::log2(value / minValue_) * scale_);
+        index = position < (double)bucketsCount_ ? (size_t)position
+                                                 : bucketsCount_;
+    }
+    auto &cell = cells_[internal::threadCellIndex()];
+    auto buckets = cell.buckets.load(std::memory_order_acquire);
+    if (!buckets)
+    {
+        // Several threads can share a cell, only one allocation wins.
+        auto newBuckets = new std::atomic<uint64_t>[bucketsCount_ + 1]();
+        if (cell.buckets.compare_exchange_strong(buckets,
+                                                 newBuckets,
+                                                 std::memory_order_acq_rel))
+        {
+            buckets = newBuckets;
+        }
+        else
+        {
+            delete[] newBuckets;
+        }
+    }
+    buckets[index].fetch_add(1, std::memory_order_relaxed);
+    cell.count.fetch_add(1, std::memory_order_relaxed);
+    internal::atomicAdd(cell.sum, value);
+}
+
+std::vector<uint64_t> ExponentialHistogram::mergedBuckets() const
+{
+    std::vector<uint64_t> merged(bucketsCount_ + 1);
+    for (auto &cell : cells_)
+    {
+        auto buckets = cell.buckets.load(std::memory_order_acquire);
+        if (!buckets)
+            continue;
+        for (size_t i = 0; i <= bucketsCount_; ++i)
+        {
+            merged[i] += buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    return merged;
+}
+
+double ExponentialHistogram::quantile(double q) const
+{
+    auto buckets = mergedBuckets();
+    uint64_t total{0};
+    for (auto count : buckets)
+        total += count;
+    if (total == 0)
+        return 0;
+    auto rank = (uint64_t)std::ceil(q * (double)total);
+    if (rank == 0)
+        rank = 1;
+    uint64_t count{0};
+    for (size_t i = 0; i < bucketsCount_; ++i)
+    {
+        count += buckets[i];
+        if (count >= rank)
+            return upperBound(i);
+    }
+    return INFINITY;
+}
+
+std::vector<Sample> ExponentialHistogram::collect() const
+{
+    auto buckets = mergedBuckets();
+    std::vector<Sample> samples;
+    uint64_t count{0};
+    for (size_t i = 0; i < bucketsCount_; ++i)
+    {
+        if (buckets[i] == 0)
+            continue;
+        count += buckets[i];
+        Sample sample;
+        sample.name = name_ + "_bucket";
+        sample.exLabels.emplace_back("le", boundToString(upperBound(i)));
+        sample.value = (double)count;
+        samples.emplace_back(std::move(sample));
+    }
+    count += buckets.back();
+    Sample sample;
+    sample.name = name_ + "_bucket";
+    sample.exLabels.emplace_back("le", "+Inf");
+    sample.value = (double)count;
+    samples.emplace_back(std::move(sample));
+    double sum{0};
+    uint64_t totalCount{0};
+    for (auto &cell : cells_)
+    {
+        sum += cell.sum.load(std::memory_order_relaxed);
+        totalCount += cell.count.load(std::memory_order_relaxed);
+    }
+    Sample sumSample;
+    sumSample.name = name_ + "_sum";
+    sumSample.value = sum;
+    samples.emplace_back(std::move(sumSample));
+    Sample countSample;
+    countSample.name = name_ + "_count";
+    countSample.value = (double)totalCount;
+    samples.emplace_back(std::move(countSample));
+    return samples;
+}
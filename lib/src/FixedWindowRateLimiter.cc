@@ -1,12 +1,13 @@
 #include "FixedWindowRateLimiter.h"
+#include <algorithm>
 
 using namespace drogon;
 
 FixedWindowRateLimiter::FixedWindowRateLimiter(
     size_t capacity,
     std::chrono::duration<double> timeUnit)
-    : capacity_(capacity),
-      lastTime_(std::chrono::steady_clock::now()),
+    : capacity_((std::min)(capacity, size_t(UINT32_MAX))),
+      startTime_(std::chrono::steady_clock::now()),
       timeUnit_(timeUnit)
 {
 }
@@ -16,17 +17,27 @@ FixedWindowRateLimiter::FixedWindowRateLimiter(
 bool FixedWindowRateLimiter::isAllowed()
 {
     auto now = std::chrono::steady_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::duration<double>>(
-        now - lastTime_);
-    if (duration >= timeUnit_)
+    auto window = (uint32_t)(uint64_t)(
+        std::chrono::duration_cast<std::chrono::duration<double>>(now -
+                                                                  startTime_) /
+        timeUnit_);
+    auto state = state_.load(std::memory_order_relaxed);
+    for (;;)
     {
-        currentRequests_ = 0;
-        lastTime_ = now;
+        auto stateWindow = (uint32_t)(state >> 32);
+        uint64_t requests = 0;
+        // Another thread may have seen a later time, don't step back.
+        if ((int32_t)(window - stateWindow) <= 0)
+        {
+            window = stateWindow;
+            requests = state & UINT32_MAX;
+        }
+        if (requests >= capacity_)
+            return false;
+        auto newState = ((uint64_t)window << 32) | (requests + 1);
+        if (state_.compare_exchange_weak(state,
+                                         newState,
+                                         std::memory_order_relaxed))
+            return true;
     }
-    if (currentRequests_ < capacity_)
-    {
-        currentRequests_++;
-        return true;
-    }
-    return false;
 }
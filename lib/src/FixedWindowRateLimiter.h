@@ -1,7 +1,9 @@
 #pragma once
 
 #include <drogon/RateLimiter.h>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 
 namespace drogon
 {
@@ -15,8 +17,10 @@ class FixedWindowRateLimiter : public RateLimiter
 
   private:
     size_t capacity_;
-    size_t currentRequests_{0};
-    std::chrono::steady_clock::time_point lastTime_;
+    std::chrono::steady_clock::time_point startTime_;
     std::chrono::duration<double> timeUnit_;
+    // The index of the current window in the high 32 bits and the number of
+    // requests in it in the low 32 bits, so both are updated by one CAS.
+    std::atomic<uint64_t> state_{0};
 };
 }  // namespace drogon
@@ -0,0 +1,293 @@
+/**
+ *
+ *  @file Grpc.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/Grpc.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+using namespace drogon;
+using namespace drogon::grpc;
+
+static constexpr size_t kPrefixLength = 5;
+
+char *grpc::internal::appendPrefix(std::string &out, size_t length)
+{
+    // The compressed flag, then the length in big endian
+    auto offset = out.length();
+    out.resize(offset + kPrefixLength + length);
+    auto prefix = &out[offset];
+    prefix[0] = 0;
+    prefix[1] = static_cast<char>((length >> 24) & 0xff);
+    prefix[2] = static_cast<char>((length >> 16) & 0xff);
+    prefix[3] = static_cast<char>((length >> 8) & 0xff);
+    prefix[4] = static_cast<char>(length & 0xff);
+    return prefix + kPrefixLength;
+}
+
+void grpc::appendMessage(std::string &out, std::string_view message)
+{
+    auto data = internal::appendPrefix(out, message.length());
+    if (!message.empty())
+        memcpy(data, message.data(), message.length());
+}
+
+bool grpc::parseMessages(std::string_view body,
+                         std::vector<std::string_view> &messages)
+{
+    while (!body.empty())
+    {
+        if (body.length() < kPrefixLength || body[0] != 0)
+            return false;
+        size_t length = 0;
+        for (size_t i = 1; i < kPrefixLength; ++i)
+            length = (length << 8) | static_cast<unsigned char>(body[i]);
+        if (body.length() - kPrefixLength < length)
+            return false;
+        messages.push_back(body.substr(kPrefixLength, length));
+        body.remove_prefix(kPrefixLength + length);
+    }
+    return true;
+}
+
+std::string grpc::encodeStatusMessage(std::string_view message)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string encoded;
+    encoded.reserve(message.length());
+    for (auto c : message)
+    {
+        auto byte = static_cast<unsigned char>(c);
+        if (byte >= 0x20 && byte <= 0x7e && byte != '%')
+        {
+            encoded += c;
+            continue;
+        }
+        encoded += '%';
+        encoded += hex[byte >> 4];
+        encoded += hex[byte & 0x0f];
+    }
+    return encoded;
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+std::string grpc::decodeStatusMessage(std::string_view message)
+{
+    std::string decoded;
+    decoded.reserve(message.length());
+    for (size_t i = 0; i < message.length(); ++i)
+    {
+        if (message[i] == '%' && i + 2 < message.length() &&
+            hexValue(message[i + 1]) >= 0 && hexValue(message[i + 2]) >= 0)
+        {
+            decoded += static_cast<char>(hexValue(message[i + 1]) * 16 +
+                                         hexValue(message[i + 2]));
+            i += 2;
+            continue;
+        }
+        // Invalid escapes are kept as they are.
+        decoded += message[i];
+    }
+    return decoded;
+}
+
+static void setStatus(HttpResponse &resp, const Status &status)
+{
+    resp.addTrailer("grpc-status",
+                    std::to_string(static_cast<int>(status.code)));
+    if (!status.message.empty())
+        resp.addTrailer("grpc-message", encodeStatusMessage(status.message));
+}
+
+static HttpResponsePtr newGrpcResponse()
+{
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setContentTypeCodeAndCustomString(CT_CUSTOM, "application/grpc");
+    // The peers expect the messages themselves to be compressed, if any.
+    resp->setAllowCompression(false);
+    return resp;
+}
+
+HttpResponsePtr grpc::newResponse(std::string body, const Status &status)
+{
+    auto resp = newGrpcResponse();
+    resp->setBody(std::move(body));
+    setStatus(*resp, status);
+    return resp;
+}
+
+HttpResponsePtr grpc::newErrorResponse(const Status &status)
+{
+    return newResponse({}, status);
+}
+
+static StatusCode statusOfHttpCode(HttpStatusCode code)
+{
+    // https://github.com/grpc/grpc/blob/master/doc/http-grpc-status-mapping.md
+    switch (code)
+    {
+        case k400BadRequest:
+            return StatusCode::Internal;
+        case k401Unauthorized:
+            return StatusCode::Unauthenticated;
+        case k403Forbidden:
+            return StatusCode::PermissionDenied;
+        case k404NotFound:
+            return StatusCode::Unimplemented;
+        case k429TooManyRequests:
+        case k502BadGateway:
+        case k503ServiceUnavailable:
+        case k504GatewayTimeout:
+            return StatusCode::Unavailable;
+        default:
+            return StatusCode::Unknown;
+    }
+}
+
+Status grpc::statusOf(const HttpResponsePtr &response)
+{
+    if (response->statusCode() != k200OK)
+    {
+        return {statusOfHttpCode(response->statusCode()),
+                "HTTP status " +
+                    std::to_string(static_cast<int>(response->statusCode()))};
+    }
+    // A response without message may only have headers.
+    auto *code = &response->getTrailer("grpc-status");
+    auto *message = &response->getTrailer("grpc-message");
+    if (code->empty())
+    {
+        code = &response->getHeader("grpc-status");
+        message = &response->getHeader("grpc-message");
+    }
+    if (code->empty())
+        return {StatusCode::Unknown, "No grpc-status"};
+    char *end;
+    auto value = strtol(code->c_str(), &end, 10);
+    if (*end != '\0' || value < 0 || value > 16)
+        return {StatusCode::Unknown, "Bad grpc-status " + *code};
+    return {static_cast<StatusCode>(value), decodeStatusMessage(*message)};
+}
+
+ServerWriter::ServerWriter(ResponseStreamPtr stream,
+                           std::weak_ptr<HttpResponse> resp)
+    : stream_(std::move(stream)), response_(std::move(resp))
+{
+}
+
+ServerWriter::~ServerWriter()
+{
+    finish();
+}
+
+bool ServerWriter::write(std::string_view message)
+{
+    std::string data;
+    appendMessage(data, message);
+    return writeFramed(data);
+}
+
+bool ServerWriter::writeFramed(const std::string &data)
+{
+    return stream_ && stream_->send(data);
+}
+
+void ServerWriter::finish(const Status &status)
+{
+    if (!stream_)
+        return;
+    // The trailers are sent when the stream is closed.
+    if (auto resp = response_.lock())
+        setStatus(*resp, status);
+    stream_->close();
+    stream_.reset();
+}
+
+HttpResponsePtr grpc::newStreamResponse(
+    const std::function<void(ServerWriterPtr)> &callback)
+{
+    // The writer adds the status to the trailers of the response, which is
+    // kept by the connection until the stream is closed.
+    auto weakResp = std::make_shared<std::weak_ptr<HttpResponse>>();
+    auto resp = HttpResponse::newAsyncStreamResponse(
+        [callback, weakResp](ResponseStreamPtr stream) {
+            callback(
+                std::make_unique<ServerWriter>(std::move(stream), *weakResp));
+        },
+        true);
+    *weakResp = resp;
+    resp->setContentTypeCodeAndCustomString(CT_CUSTOM, "application/grpc");
+    resp->setAllowCompression(false);
+    return resp;
+}
+
+void grpc::callRaw(
+    const HttpClientPtr &client,
+    const std::string &path,
+    std::string body,
+    std::function<void(const Status &status,
+                       const std::vector<std::string_view> &messages)>
+        callback,
+    double timeout)
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setMethod(Post);
+    req->setPath(path);
+    req->setContentTypeString("application/grpc");
+    req->addHeader("te", "trailers");
+    if (timeout > 0)
+    {
+        // In milliseconds, rounded up
+        req->addHeader("grpc-timeout",
+                       std::to_string(static_cast<int64_t>(timeout * 1000) +
+                                      1) +
+                           "m");
+    }
+    req->setBody(std::move(body));
+    client->sendRequest(
+        req,
+        [callback = std::move(callback)](ReqResult result,
+                                         const HttpResponsePtr &resp) {
+            static const std::vector<std::string_view> noMessages;
+            if (result != ReqResult::Ok)
+            {
+                callback({result == ReqResult::Timeout
+                              ? StatusCode::DeadlineExceeded
+                              : StatusCode::Unavailable,
+                          std::string(to_string_view(result))},
+                         noMessages);
+                return;
+            }
+            auto status = statusOf(resp);
+            std::vector<std::string_view> messages;
+            if (status.ok() && !parseMessages(resp->body(), messages))
+            {
+                callback({StatusCode::Internal, "Bad response messages"},
+                         noMessages);
+                return;
+            }
+            callback(status, messages);
+        },
+        timeout);
+}
@@ -4,48 +4,95 @@ using namespace drogon::monitoring;
 
 void Histogram::observe(double value)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
     if (maxAge_ > std::chrono::seconds(0) &&
-        timerId_ == trantor::InvalidTimerId)
+        !timerStarted_.load(std::memory_order_acquire))
     {
-        std::weak_ptr<Histogram> weakPtr =
-            std::dynamic_pointer_cast<Histogram>(shared_from_this());
-        timerId_ = loopPtr_->runEvery(maxAge_ / timeBucketCount_, [weakPtr]() {
-            auto thisPtr = weakPtr.lock();
-            if (!thisPtr)
-                return;
-            thisPtr->rotateTimeBuckets();
-        });
+        startTimer();
     }
-    auto &currentBucket = timeBuckets_.back();
-    currentBucket.sum += value;
-    currentBucket.count += 1;
+    size_t index = bucketBoundaries_.size();
     for (size_t i = 0; i < bucketBoundaries_.size(); i++)
     {
         if (value <= bucketBoundaries_[i])
         {
-            currentBucket.buckets[i] += 1;
+            index = i;
             break;
         }
     }
-    if (value > bucketBoundaries_.back())
+    auto &cell = cells_[internal::threadCellIndex()];
+    cell.buckets[index].fetch_add(1, std::memory_order_relaxed);
+    cell.count.fetch_add(1, std::memory_order_relaxed);
+    internal::atomicAdd(cell.sum, value);
+}
+
+void Histogram::startTimer()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (timerId_ != trantor::InvalidTimerId)
+        return;
+    std::weak_ptr<Histogram> weakPtr =
+        std::dynamic_pointer_cast<Histogram>(shared_from_this());
+    timerId_ = loopPtr_->runEvery(maxAge_ / timeBucketCount_, [weakPtr]() {
+        auto thisPtr = weakPtr.lock();
+        if (!thisPtr)
+            return;
+        thisPtr->rotateTimeBuckets();
+    });
+    timerStarted_.store(true, std::memory_order_release);
+}
+
+Histogram::TimeBucket Histogram::totals() const
+{
+    TimeBucket totals;
+    totals.buckets.resize(bucketBoundaries_.size() + 1);
+    for (auto &cell : cells_)
     {
-        currentBucket.buckets.back() += 1;
+        for (size_t i = 0; i < totals.buckets.size(); i++)
+        {
+            totals.buckets[i] +=
+                cell.buckets[i].load(std::memory_order_relaxed);
+        }
+        totals.count += cell.count.load(std::memory_order_relaxed);
+        totals.sum += cell.sum.load(std::memory_order_relaxed);
+    }
+    return totals;
+}
+
+void Histogram::rotateTimeBuckets()
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    timeBuckets_.emplace_back(totals());
+    if (timeBuckets_.size() > timeBucketCount_)
+    {
+        timeBuckets_.pop_front();
     }
 }
 
 std::vector<Sample> Histogram::collect() const
 {
+    TimeBucket current;
+    {
+        // Only the observations made in the last timeBucketCount_ time
+        // buckets are reported. The totals are read under the lock so that
+        // they are never older than the kept ones.
+        std::lock_guard<std::mutex> guard(mutex_);
+        current = totals();
+        if (timeBucketCount_ > 0 && timeBuckets_.size() == timeBucketCount_)
+        {
+            auto &expired = timeBuckets_.front();
+            for (size_t i = 0; i < current.buckets.size(); i++)
+            {
+                current.buckets[i] -= expired.buckets[i];
+            }
+            current.count -= expired.count;
+            current.sum -= expired.sum;
+        }
+    }
     std::vector<Sample> samples;
-    std::lock_guard<std::mutex> guard(mutex_);
-    size_t count{0};
+    uint64_t count{0};
     for (size_t i = 0; i < bucketBoundaries_.size(); i++)
     {
         Sample sample;
-        for (auto &bucket : timeBuckets_)
-        {
-            count += bucket.buckets[i];
-        }
+        count += current.buckets[i];
         sample.name = name_ + "_bucket";
         sample.exLabels.emplace_back("le",
                                      std::to_string(bucketBoundaries_[i]));
@@ -53,28 +100,18 @@ std::vector<Sample> Histogram::collect() const
         samples.emplace_back(std::move(sample));
     }
     Sample sample;
-    for (auto &bucket : timeBuckets_)
-    {
-        count += bucket.buckets.back();
-    }
+    count += current.buckets.back();
     sample.name = name_ + "_bucket";
     sample.exLabels.emplace_back("le", "+Inf");
     sample.value = count;
     samples.emplace_back(std::move(sample));
-    double sum{0};
-    uint64_t totalCount{0};
-    for (auto &bucket : timeBuckets_)
-    {
-        sum += bucket.sum;
-        totalCount += bucket.count;
-    }
     Sample sumSample;
     sumSample.name = name_ + "_sum";
-    sumSample.value = sum;
+    sumSample.value = current.sum;
     samples.emplace_back(std::move(sumSample));
     Sample countSample;
     countSample.name = name_ + "_count";
-    countSample.value = totalCount;
+    countSample.value = current.count;
     samples.emplace_back(std::move(countSample));
     return samples;
 }
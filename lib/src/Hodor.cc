@@ -1,11 +1,25 @@
 #include <drogon/plugins/Hodor.h>
 #include <drogon/plugins/RealIpResolver.h>
+#include <drogon/RedisRateLimiter.h>
 
 using namespace drogon::plugin;
 
+drogon::RateLimiterPtr Hodor::newLimiter(size_t capacity,
+                                         const std::string &key) const
+{
+    if (redisClient_)
+    {
+        return std::make_shared<RedisRateLimiter>(
+            redisClient_, key, capacity, timeUnit_, redisLeaseSize_);
+    }
+    return RateLimiter::newRateLimiter(algorithm_, capacity, timeUnit_);
+}
+
 Hodor::LimitStrategy Hodor::makeLimitStrategy(const Json::Value &config)
 {
     LimitStrategy strategy;
+    strategy.redisKeyPrefix = redisKeyPrefix_ +
+                              std::to_string(limitStrategies_.size()) + ":";
     strategy.capacity = config.get("capacity", 0).asUInt();
     if (config.isMember("urls") && config["urls"].isArray())
     {
@@ -25,26 +39,14 @@ Hodor::LimitStrategy Hodor::makeLimitStrategy(const Json::Value &config)
 
     if (strategy.capacity > 0)
     {
-        if (multiThreads_)
-        {
-            strategy.globalLimiterPtr = std::make_shared<SafeRateLimiter>(
-                RateLimiter::newRateLimiter(algorithm_,
-                                            strategy.capacity,
-                                            timeUnit_));
-        }
-        else
-        {
-            strategy.globalLimiterPtr =
-                RateLimiter::newRateLimiter(algorithm_,
-                                            strategy.capacity,
-                                            timeUnit_);
-        }
+        strategy.globalLimiterPtr =
+            newLimiter(strategy.capacity, strategy.redisKeyPrefix + "global");
     }
     strategy.ipCapacity = config.get("ip_capacity", 0).asUInt();
     if (strategy.ipCapacity > 0)
     {
         strategy.ipLimiterMapPtr =
-            std::make_unique<CacheMap<std::string, RateLimiterPtr>>(
+            std::make_unique<ShardedCacheMap<std::string, RateLimiterPtr>>(
                 drogon::app().getLoop(),
                 float(timeUnit_.count() / 60 < 1 ? 1 : timeUnit_.count() / 60),
                 2,
@@ -55,7 +57,7 @@ Hodor::LimitStrategy Hodor::makeLimitStrategy(const Json::Value &config)
     if (strategy.userCapacity > 0)
     {
         strategy.userLimiterMapPtr =
-            std::make_unique<CacheMap<std::string, RateLimiterPtr>>(
+            std::make_unique<ShardedCacheMap<std::string, RateLimiterPtr>>(
                 drogon::app().getLoop(),
                 float(timeUnit_.count() / 60 < 1 ? 1 : timeUnit_.count() / 60),
                 2,
@@ -70,7 +72,19 @@ void Hodor::initAndStart(const Json::Value &config)
         config.get("algorithm", "token_bucket").asString());
     timeUnit_ = std::chrono::seconds(config.get("time_unit", 60).asUInt());
 
-    multiThreads_ = config.get("multi_threads", true).asBool();
+    auto redisClientName = config.get("redis_client", "").asString();
+    if (!redisClientName.empty())
+    {
+        redisClient_ = app().getRedisClient(redisClientName);
+        if (!redisClient_)
+        {
+            throw std::runtime_error("Hodor: no redis client named " +
+                                     redisClientName);
+        }
+        redisKeyPrefix_ =
+            config.get("redis_key_prefix", "drogon:hodor:").asString();
+        redisLeaseSize_ = config.get("redis_lease_size", 0).asUInt();
+    }
 
     useRealIpResolver_ = config.get("use_real_ip_resolver", false).asBool();
     rejectResponse_ = HttpResponse::newHttpResponse();
@@ -113,7 +127,7 @@ void Hodor::initAndStart(const Json::Value &config)
     }
     for (const auto &ipOrCidr : trustIps)
     {
-        trustCIDRs_.emplace_back(ipOrCidr.asString());
+        trustCIDRs_.add(ipOrCidr.asString());
     }
 
     app().registerPreHandlingAdvice([this](const drogon::HttpRequestPtr &req,
@@ -156,22 +170,12 @@ bool Hodor::checkLimit(const drogon::HttpRequestPtr &req,
         RateLimiterPtr limiterPtr;
         strategy.ipLimiterMapPtr->modify(
             ip.toIpNetEndian(),
-            [this, &limiterPtr, &strategy](RateLimiterPtr &ptr) {
+            [this, &limiterPtr, &strategy, &ip](RateLimiterPtr &ptr) {
                 if (!ptr)
                 {
-                    if (multiThreads_)
-                    {
-                        ptr = std::make_shared<SafeRateLimiter>(
-                            RateLimiter::newRateLimiter(algorithm_,
-                                                        strategy.ipCapacity,
-                                                        timeUnit_));
-                    }
-                    else
-                    {
-                        ptr = RateLimiter::newRateLimiter(algorithm_,
-                                                          strategy.ipCapacity,
-                                                          timeUnit_);
-                    }
+                    ptr = newLimiter(strategy.ipCapacity,
+                                     strategy.redisKeyPrefix + "ip:" +
+                                         ip.toIp());
                 }
                 limiterPtr = ptr;
             },
@@ -190,22 +194,12 @@ bool Hodor::checkLimit(const drogon::HttpRequestPtr &req,
         RateLimiterPtr limiterPtr;
         strategy.userLimiterMapPtr->modify(
             *userId,
-            [this, &strategy, &limiterPtr](RateLimiterPtr &ptr) {
+            [this, &strategy, &limiterPtr, &userId](RateLimiterPtr &ptr) {
                 if (!ptr)
                 {
-                    if (multiThreads_)
-                    {
-                        ptr = std::make_shared<SafeRateLimiter>(
-                            RateLimiter::newRateLimiter(algorithm_,
-                                                        strategy.userCapacity,
-                                                        timeUnit_));
-                    }
-                    else
-                    {
-                        ptr = RateLimiter::newRateLimiter(algorithm_,
-                                                          strategy.userCapacity,
-                                                          timeUnit_);
-                    }
+                    ptr = newLimiter(strategy.userCapacity,
+                                     strategy.redisKeyPrefix + "user:" +
+                                         *userId);
                 }
                 limiterPtr = ptr;
             },
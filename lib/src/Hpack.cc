@@ -0,0 +1,602 @@
+/**
+ *
+ *  @file Hpack.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "Hpack.h"
+#include <array>
+#include <mutex>
+
+using namespace drogon;
+
+namespace
+{
+struct HuffmanCode
+{
+    uint32_t code;
+    uint8_t length;
+};
+
+// rfc7541 Appendix B, the last one is EOS
+constexpr HuffmanCode kHuffmanCodes[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12}, {0x1ff9, 13}, {0x15, 6},
+    {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6}, {0x0, 5}, {0x1, 5}, {0x2, 5},
+    {0x19, 6}, {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6}, {0x1e, 6},
+    {0x1f, 6}, {0x5c, 7}, {0xfb, 8}, {0x7ffc, 15}, {0x20, 6}, {0xffb, 12},
+    {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7}, {0x5f, 7},
+    {0x60, 7}, {0x61, 7}, {0x62, 7}, {0x63, 7}, {0x64, 7}, {0x65, 7},
+    {0x66, 7}, {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7}, {0x6b, 7},
+    {0x6c, 7}, {0x6d, 7}, {0x6e, 7}, {0x6f, 7}, {0x70, 7}, {0x71, 7},
+    {0x72, 7}, {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19},
+    {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6}, {0x7ffd, 15}, {0x3, 5}, {0x23, 6},
+    {0x4, 5}, {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5},
+    {0x74, 7}, {0x75, 7}, {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6},
+    {0x76, 7}, {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+    {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22},
+    {0xfffe7, 20}, {0xfffe8, 20}, {0x3fffd3, 22}, {0x3fffd4, 22},
+    {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+    {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23},
+    {0xffffeb, 24}, {0x7fffdf, 23}, {0xffffec, 24}, {0xffffed, 24},
+    {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+    {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21},
+    {0x3fffd8, 22}, {0x7fffe5, 23}, {0x3fffd9, 22}, {0x7fffe6, 23},
+    {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+    {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23},
+    {0x7fffe9, 23}, {0x1fffde, 21}, {0x7fffea, 23}, {0x3fffdd, 22},
+    {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+    {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21},
+    {0x3fffe0, 22}, {0x1fffe2, 21}, {0x7fffed, 23}, {0x3fffe1, 22},
+    {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+    {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22},
+    {0x3fffe6, 22}, {0x7ffff1, 23}, {0x3ffffe0, 26}, {0x3ffffe1, 26},
+    {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+    {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26},
+    {0x3ffffe4, 26}, {0x7ffffde, 27}, {0x7ffffdf, 27}, {0x3ffffe5, 26},
+    {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+    {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26},
+    {0x7ffffe2, 27}, {0xfffff2, 24}, {0x1fffe4, 21}, {0x1fffe5, 21},
+    {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+    {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24},
+    {0xfffed, 20}, {0x1fffe6, 21}, {0x3fffe9, 22}, {0x1fffe7, 21},
+    {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+    {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24},
+    {0x3ffffea, 26}, {0x7ffff4, 23}, {0x3ffffeb, 26}, {0x7ffffe6, 27},
+    {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+    {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28},
+    {0x7ffffec, 27}, {0x7ffffed, 27}, {0x7ffffee, 27}, {0x7ffffef, 27},
+    {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30}
+};
+
+struct StaticEntry
+{
+    std::string_view name;
+    std::string_view value;
+};
+
+// rfc7541 Appendix A
+constexpr StaticEntry kStaticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+constexpr size_t kStaticTableSize = sizeof(kStaticTable) / sizeof(StaticEntry);
+constexpr size_t kEntryOverhead = 32;
+// Reject integers which don't fit into 32 bits
+constexpr uint32_t kMaxInteger = (1u << 31) - 1;
+
+/**
+ * A binary tree built from the huffman code table, leaves hold symbols.
+ */
+struct HuffmanTree
+{
+    struct Node
+    {
+        int16_t children[2]{-1, -1};
+        int16_t symbol{-1};
+    };
+
+    HuffmanTree()
+    {
+        nodes.reserve(513);
+        nodes.emplace_back();
+        for (int16_t sym = 0; sym < 257; ++sym)
+        {
+            auto &hc = kHuffmanCodes[sym];
+            size_t cur = 0;
+            for (int bit = hc.length - 1; bit >= 0; --bit)
+            {
+                auto b = (hc.code >> bit) & 1;
+                if (nodes[cur].children[b] < 0)
+                {
+                    nodes[cur].children[b] = static_cast<int16_t>(nodes.size());
+                    nodes.emplace_back();
+                }
+                cur = static_cast<size_t>(nodes[cur].children[b]);
+            }
+            nodes[cur].symbol = sym;
+        }
+    }
+
+    std::vector<Node> nodes;
+};
+
+const HuffmanTree &huffmanTree()
+{
+    static const HuffmanTree tree;
+    return tree;
+}
+
+bool decodeInteger(const uint8_t *&p,
+                   const uint8_t *end,
+                   uint8_t prefixBits,
+                   uint32_t &value)
+{
+    if (p >= end)
+        return false;
+    uint32_t mask = (1u << prefixBits) - 1;
+    value = *p & mask;
+    ++p;
+    if (value < mask)
+        return true;
+    uint32_t shift = 0;
+    while (p < end)
+    {
+        uint8_t b = *p++;
+        if (shift > 28)
+            return false;
+        uint64_t add = static_cast<uint64_t>(b & 0x7f) << shift;
+        if (value + add > kMaxInteger)
+            return false;
+        value += static_cast<uint32_t>(add);
+        if ((b & 0x80) == 0)
+            return true;
+        shift += 7;
+    }
+    return false;
+}
+
+void encodeInteger(uint32_t value,
+                   uint8_t prefixBits,
+                   uint8_t firstByteFlags,
+                   std::string &output)
+{
+    uint32_t mask = (1u << prefixBits) - 1;
+    if (value < mask)
+    {
+        output.push_back(static_cast<char>(firstByteFlags | value));
+        return;
+    }
+    output.push_back(static_cast<char>(firstByteFlags | mask));
+    value -= mask;
+    while (value >= 128)
+    {
+        output.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    output.push_back(static_cast<char>(value));
+}
+
+bool decodeString(const uint8_t *&p, const uint8_t *end, std::string &output)
+{
+    if (p >= end)
+        return false;
+    bool huffman = (*p & 0x80) != 0;
+    uint32_t length;
+    if (!decodeInteger(p, end, 7, length))
+        return false;
+    if (static_cast<size_t>(end - p) < length)
+        return false;
+    output.clear();
+    if (huffman)
+    {
+        if (!hpack::huffmanDecode(p, length, output))
+            return false;
+    }
+    else
+    {
+        output.assign(reinterpret_cast<const char *>(p), length);
+    }
+    p += length;
+    return true;
+}
+
+void encodeString(std::string_view str, std::string &output)
+{
+    auto huffmanLength = hpack::huffmanEncodedLength(str);
+    if (huffmanLength < str.length())
+    {
+        encodeInteger(static_cast<uint32_t>(huffmanLength), 7, 0x80, output);
+        hpack::huffmanEncode(str, output);
+    }
+    else
+    {
+        encodeInteger(static_cast<uint32_t>(str.length()), 7, 0, output);
+        output.append(str.data(), str.length());
+    }
+}
+
+// Fields which are useless or harmful to keep in the dynamic table
+bool shouldNotIndex(std::string_view name)
+{
+    return name == "content-length" || name == "date" || name == ":path" ||
+           name == "etag" || name == "last-modified" || name == "age" ||
+           name == "content-range" || name == "location";
+}
+
+bool isSensitive(std::string_view name)
+{
+    return name == "authorization" || name == "cookie" ||
+           name == "set-cookie" || name == "proxy-authorization";
+}
+}  // namespace
+
+bool hpack::huffmanDecode(const uint8_t *data,
+                          size_t length,
+                          std::string &output)
+{
+    const auto &nodes = huffmanTree().nodes;
+    size_t cur = 0;
+    // bits consumed since the last emitted symbol and whether they are all 1
+    size_t pendingBits = 0;
+    bool allOnes = true;
+    output.reserve(output.size() + length * 8 / 5);
+    for (size_t i = 0; i < length; ++i)
+    {
+        uint8_t byte = data[i];
+        for (int bit = 7; bit >= 0; --bit)
+        {
+            auto b = (byte >> bit) & 1;
+            auto next = nodes[cur].children[b];
+            if (next < 0)
+                return false;
+            cur = static_cast<size_t>(next);
+            ++pendingBits;
+            allOnes = allOnes && b;
+            auto sym = nodes[cur].symbol;
+            if (sym >= 0)
+            {
+                if (sym == 256)
+                {
+                    // EOS in the string is a decoding error
+                    return false;
+                }
+                output.push_back(static_cast<char>(sym));
+                cur = 0;
+                pendingBits = 0;
+                allOnes = true;
+            }
+        }
+    }
+    // Padding must be shorter than 8 bits and consist of 1s (rfc7541-5.2)
+    return pendingBits < 8 && allOnes;
+}
+
+size_t hpack::huffmanEncodedLength(std::string_view input)
+{
+    size_t bits = 0;
+    for (unsigned char c : input)
+    {
+        bits += kHuffmanCodes[c].length;
+    }
+    return (bits + 7) / 8;
+}
+
+void hpack::huffmanEncode(std::string_view input, std::string &output)
+{
+    uint64_t buffer = 0;
+    size_t bits = 0;
+    for (unsigned char c : input)
+    {
+        auto &hc = kHuffmanCodes[c];
+        buffer = (buffer << hc.length) | hc.code;
+        bits += hc.length;
+        while (bits >= 8)
+        {
+            bits -= 8;
+            output.push_back(static_cast<char>(buffer >> bits));
+        }
+    }
+    if (bits > 0)
+    {
+        // Pad with the most significant bits of EOS
+        buffer = (buffer << (8 - bits)) | (0xff >> bits);
+        output.push_back(static_cast<char>(buffer));
+    }
+}
+
+bool HpackDecoder::getEntry(size_t index,
+                            std::string &name,
+                            std::string *value) const
+{
+    if (index == 0)
+        return false;
+    if (index <= kStaticTableSize)
+    {
+        auto &entry = kStaticTable[index - 1];
+        name.assign(entry.name.data(), entry.name.length());
+        if (value)
+            value->assign(entry.value.data(), entry.value.length());
+        return true;
+    }
+    index -= kStaticTableSize + 1;
+    if (index >= dynamicTable_.size())
+        return false;
+    auto &entry = dynamicTable_[index];
+    name = entry.first;
+    if (value)
+        *value = entry.second;
+    return true;
+}
+
+void HpackDecoder::evict()
+{
+    while (tableSize_ > maxTableSize_ && !dynamicTable_.empty())
+    {
+        auto &entry = dynamicTable_.back();
+        tableSize_ -= entry.first.length() + entry.second.length() +
+                      kEntryOverhead;
+        dynamicTable_.pop_back();
+    }
+}
+
+void HpackDecoder::addEntry(std::string name, std::string value)
+{
+    auto size = name.length() + value.length() + kEntryOverhead;
+    if (size > maxTableSize_)
+    {
+        // rfc7541-4.4, an entry larger than the table empties the table
+        dynamicTable_.clear();
+        tableSize_ = 0;
+        return;
+    }
+    tableSize_ += size;
+    dynamicTable_.emplace_front(std::move(name), std::move(value));
+    evict();
+}
+
+bool HpackDecoder::decode(const uint8_t *data,
+                          size_t length,
+                          HpackHeaders &headers)
+{
+    const uint8_t *p = data;
+    const uint8_t *end = data + length;
+    bool fieldSeen = false;
+    while (p < end)
+    {
+        uint8_t b = *p;
+        if (b & 0x80)
+        {
+            // Indexed header field
+            uint32_t index;
+            if (!decodeInteger(p, end, 7, index))
+                return false;
+            std::string name, value;
+            if (!getEntry(index, name, &value))
+                return false;
+            headers.emplace_back(std::move(name), std::move(value));
+            fieldSeen = true;
+        }
+        else if ((b & 0xe0) == 0x20)
+        {
+            // Dynamic table size update, only allowed at the beginning of a
+            // header block
+            uint32_t size;
+            if (fieldSeen || !decodeInteger(p, end, 5, size) ||
+                size > tableSizeLimit_)
+                return false;
+            maxTableSize_ = size;
+            evict();
+        }
+        else
+        {
+            bool indexing = (b & 0xc0) == 0x40;
+            uint32_t index;
+            if (!decodeInteger(p, end, indexing ? 6 : 4, index))
+                return false;
+            std::string name, value;
+            if (index > 0)
+            {
+                if (!getEntry(index, name, nullptr))
+                    return false;
+            }
+            else if (!decodeString(p, end, name))
+            {
+                return false;
+            }
+            if (!decodeString(p, end, value))
+                return false;
+            if (indexing)
+                addEntry(name, value);
+            headers.emplace_back(std::move(name), std::move(value));
+            fieldSeen = true;
+        }
+    }
+    return true;
+}
+
+void HpackEncoder::setMaxTableSize(size_t size)
+{
+    // We never use a table larger than the default one
+    size = (std::min)(size, static_cast<size_t>(4096));
+    if (size == maxTableSize_)
+        return;
+    maxTableSize_ = size;
+    pendingSizeUpdate_ = true;
+    while (tableSize_ > maxTableSize_ && !dynamicTable_.empty())
+    {
+        auto &entry = dynamicTable_.back();
+        tableSize_ -= entry.first.length() + entry.second.length() +
+                      kEntryOverhead;
+        dynamicTable_.pop_back();
+    }
+}
+
+size_t HpackEncoder::findEntry(std::string_view name,
+                               std::string_view value,
+                               bool &nameOnly) const
+{
+    size_t nameIndex = 0;
+    for (size_t i = 0; i < kStaticTableSize; ++i)
+    {
+        if (kStaticTable[i].name == name)
+        {
+            if (kStaticTable[i].value == value)
+            {
+                nameOnly = false;
+                return i + 1;
+            }
+            if (nameIndex == 0)
+                nameIndex = i + 1;
+        }
+    }
+    for (size_t i = 0; i < dynamicTable_.size(); ++i)
+    {
+        auto &entry = dynamicTable_[i];
+        if (entry.first == name)
+        {
+            if (entry.second == value)
+            {
+                nameOnly = false;
+                return kStaticTableSize + 1 + i;
+            }
+            if (nameIndex == 0)
+                nameIndex = kStaticTableSize + 1 + i;
+        }
+    }
+    nameOnly = true;
+    return nameIndex;
+}
+
+void HpackEncoder::addEntry(std::string_view name, std::string_view value)
+{
+    auto size = name.length() + value.length() + kEntryOverhead;
+    if (size > maxTableSize_)
+    {
+        dynamicTable_.clear();
+        tableSize_ = 0;
+        return;
+    }
+    tableSize_ += size;
+    dynamicTable_.emplace_front(std::string(name), std::string(value));
+    while (tableSize_ > maxTableSize_)
+    {
+        auto &entry = dynamicTable_.back();
+        tableSize_ -= entry.first.length() + entry.second.length() +
+                      kEntryOverhead;
+        dynamicTable_.pop_back();
+    }
+}
+
+void HpackEncoder::encode(std::string_view name,
+                          std::string_view value,
+                          std::string &output)
+{
+    if (pendingSizeUpdate_)
+    {
+        pendingSizeUpdate_ = false;
+        encodeInteger(static_cast<uint32_t>(maxTableSize_), 5, 0x20, output);
+    }
+    bool nameOnly{true};
+    auto index = findEntry(name, value, nameOnly);
+    if (index > 0 && !nameOnly)
+    {
+        encodeInteger(static_cast<uint32_t>(index), 7, 0x80, output);
+        return;
+    }
+    if (isSensitive(name))
+    {
+        // Literal never indexed
+        encodeInteger(static_cast<uint32_t>(index), 4, 0x10, output);
+    }
+    else if (shouldNotIndex(name) || maxTableSize_ == 0)
+    {
+        // Literal without indexing
+        encodeInteger(static_cast<uint32_t>(index), 4, 0x00, output);
+    }
+    else
+    {
+        // Literal with incremental indexing
+        encodeInteger(static_cast<uint32_t>(index), 6, 0x40, output);
+        addEntry(name, value);
+    }
+    if (index == 0)
+        encodeString(name, output);
+    encodeString(value, output);
+}
@@ -0,0 +1,111 @@
+/**
+ *
+ *  @file Hpack.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <trantor/utils/NonCopyable.h>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace drogon
+{
+using HpackHeaders = std::vector<std::pair<std::string, std::string>>;
+
+namespace hpack
+{
+/**
+ * @brief Decode a huffman encoded string (rfc7541-5.2), return false if the
+ * input is malformed.
+ */
+DROGON_EXPORT bool huffmanDecode(const uint8_t *data,
+                                 size_t length,
+                                 std::string &output);
+DROGON_EXPORT void huffmanEncode(std::string_view input, std::string &output);
+DROGON_EXPORT size_t huffmanEncodedLength(std::string_view input);
+}  // namespace hpack
+
+/**
+ * @brief HPACK header block decoder (rfc7541). One decoder is used per
+ * direction of a HTTP/2 connection.
+ */
+class DROGON_EXPORT HpackDecoder : public trantor::NonCopyable
+{
+  public:
+    /**
+     * @param maxTableSize The SETTINGS_HEADER_TABLE_SIZE value sent to the
+     * peer.
+     */
+    explicit HpackDecoder(size_t maxTableSize = 4096)
+        : maxTableSize_(maxTableSize), tableSizeLimit_(maxTableSize)
+    {
+    }
+
+    /**
+     * @brief Decode a complete header block, the decoded fields are appended
+     * to headers.
+     *
+     * @return false if a compression error occurs, the connection must be
+     * closed with COMPRESSION_ERROR in this case.
+     */
+    bool decode(const uint8_t *data, size_t length, HpackHeaders &headers);
+
+  private:
+    bool getEntry(size_t index, std::string &name, std::string *value) const;
+    void addEntry(std::string name, std::string value);
+    void evict();
+
+    std::deque<std::pair<std::string, std::string>> dynamicTable_;
+    size_t tableSize_{0};
+    size_t maxTableSize_;
+    size_t tableSizeLimit_;
+};
+
+/**
+ * @brief HPACK header block encoder (rfc7541).
+ */
+class DROGON_EXPORT HpackEncoder : public trantor::NonCopyable
+{
+  public:
+    /**
+     * @brief Encode one header field and append the representation to output.
+     * The name must be in lower case.
+     */
+    void encode(std::string_view name,
+                std::string_view value,
+                std::string &output);
+
+    /**
+     * @brief Called when the peer sends the SETTINGS_HEADER_TABLE_SIZE
+     * parameter. A dynamic table size update is emitted at the beginning of
+     * the next header block.
+     */
+    void setMaxTableSize(size_t size);
+
+  private:
+    // return 0 if not found, nameOnly is set if only the name matches
+    size_t findEntry(std::string_view name,
+                     std::string_view value,
+                     bool &nameOnly) const;
+    void addEntry(std::string_view name, std::string_view value);
+
+    std::deque<std::pair<std::string, std::string>> dynamicTable_;
+    size_t tableSize_{0};
+    size_t maxTableSize_{4096};
+    bool pendingSizeUpdate_{false};
+};
+}  // namespace drogon
@@ -0,0 +1,682 @@
+/**
+ *
+ *  @file Http2ClientConnection.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "Http2ClientConnection.h"
+#include "HttpRequestImpl.h"
+#include "HttpResponseImpl.h"
+#include <trantor/utils/Logger.h>
+#include <cassert>
+#include <cstdlib>
+
+using namespace drogon;
+using namespace drogon::http2;
+
+namespace
+{
+constexpr uint32_t kStreamRecvWindow = 1024 * 1024;
+constexpr uint32_t kConnRecvWindow = 16 * 1024 * 1024;
+constexpr size_t kMaxHeaderBlockSize = 64 * 1024;
+
+bool isConnectionSpecificHeader(std::string_view field)
+{
+    return field == "connection" || field == "keep-alive" ||
+           field == "proxy-connection" || field == "transfer-encoding" ||
+           field == "upgrade" || field == "host";
+}
+
+/**
+ * Convert the request to HTTP/2 header fields and body. The request is
+ * rendered in the HTTP/1.1 form first so that the path encoding, parameters,
+ * multipart bodies and cookies are handled the same way for both versions.
+ */
+bool makeHttp2Request(const HttpRequestImpl &req,
+                      bool secure,
+                      HpackHeaders &fields,
+                      std::string &body)
+{
+    trantor::MsgBuffer buffer;
+    req.appendToBuffer(&buffer);
+    std::string_view message(buffer.peek(), buffer.readableBytes());
+    auto lineEnd = message.find("\r\n");
+    auto headersEnd = message.find("\r\n\r\n");
+    if (lineEnd == std::string_view::npos ||
+        headersEnd == std::string_view::npos)
+        return false;
+    auto requestLine = message.substr(0, lineEnd);
+    auto space1 = requestLine.find(' ');
+    auto space2 = requestLine.rfind(' ');
+    if (space1 == std::string_view::npos || space1 == space2)
+        return false;
+    fields.emplace_back(":method", requestLine.substr(0, space1));
+    fields.emplace_back(":scheme", secure ? "https" : "http");
+    fields.emplace_back(":authority", req.getHeaderBy("host"));
+    fields.emplace_back(":path",
+                        requestLine.substr(space1 + 1, space2 - space1 - 1));
+
+    auto headers = message.substr(lineEnd + 2, headersEnd - lineEnd);
+    size_t pos = 0;
+    std::string field;
+    while (pos < headers.length())
+    {
+        auto crlf = headers.find("\r\n", pos);
+        if (crlf == std::string_view::npos)
+            break;
+        auto line = headers.substr(pos, crlf - pos);
+        pos = crlf + 2;
+        auto colon = line.find(':');
+        if (colon == std::string_view::npos)
+            continue;
+        field.assign(line.data(), colon);
+        std::transform(field.begin(),
+                       field.end(),
+                       field.begin(),
+                       [](unsigned char c) { return tolower(c); });
+        if (isConnectionSpecificHeader(field))
+            continue;
+        auto value = line.substr(colon + 1);
+        while (!value.empty() && value.front() == ' ')
+            value.remove_prefix(1);
+        if (field == "te" && value != "trailers")
+            continue;
+        fields.emplace_back(field, value);
+    }
+    body.assign(message.substr(headersEnd + 4));
+    return true;
+}
+}  // namespace
+
+Http2ClientConnection::Http2ClientConnection(
+    const trantor::TcpConnectionPtr &conn)
+    : conn_(conn)
+{
+}
+
+void Http2ClientConnection::start()
+{
+    sendBuffer_.append(kConnectionPreface.data(), kConnectionPreface.length());
+    appendFrameHeader(sendBuffer_, 18, FrameType::Settings, 0, 0);
+    appendSetting(sendBuffer_, SettingsId::EnablePush, 0);
+    appendSetting(sendBuffer_,
+                  SettingsId::InitialWindowSize,
+                  kStreamRecvWindow);
+    appendSetting(sendBuffer_,
+                  SettingsId::MaxHeaderListSize,
+                  static_cast<uint32_t>(kMaxHeaderBlockSize));
+    appendWindowUpdate(sendBuffer_, 0, kConnRecvWindow - kDefaultWindowSize);
+    flush();
+}
+
+bool Http2ClientConnection::canSendRequest() const
+{
+    return !goAwayReceived_ && !closed_ &&
+           streams_.size() < peerMaxConcurrentStreams_ &&
+           nextStreamId_ < kMaxWindowSize;
+}
+
+void Http2ClientConnection::sendRequest(const HttpRequestPtr &req,
+                                        bool secure,
+                                        ResponseCallback &&callback)
+{
+    assert(canSendRequest());
+    HpackHeaders fields;
+    std::string body;
+    if (!makeHttp2Request(*static_cast<HttpRequestImpl *>(req.get()),
+                          secure,
+                          fields,
+                          body))
+    {
+        LOG_ERROR << "Unsupported request for HTTP/2";
+        callback(ReqResult::BadResponse, nullptr);
+        return;
+    }
+    std::string block;
+    for (auto &[name, value] : fields)
+    {
+        encoder_.encode(name, value, block);
+    }
+    auto streamId = nextStreamId_;
+    nextStreamId_ += 2;
+    appendHeaderBlock(
+        sendBuffer_, streamId, block, body.empty(), peerMaxFrameSize_);
+    auto &stream = streams_[streamId];
+    stream.request = req;
+    stream.callback = std::move(callback);
+    stream.isHeadMethod = (req->method() == Head);
+    stream.sendWindow = peerInitialWindowSize_;
+    if (!body.empty())
+    {
+        stream.requestBody = std::move(body);
+        sendingStreams_.push_back(streamId);
+    }
+    flushStreams();
+}
+
+void Http2ClientConnection::cancelRequest(const HttpRequestPtr &req)
+{
+    for (auto &[id, stream] : streams_)
+    {
+        if (stream.request == req)
+        {
+            auto streamId = id;
+            appendRstStream(sendBuffer_, streamId, ErrorCode::Cancel);
+            finishStream(streamId, ReqResult::Timeout);
+            flush();
+            return;
+        }
+    }
+}
+
+void Http2ClientConnection::onMessage(trantor::MsgBuffer *buf)
+{
+    if (closed_)
+    {
+        buf->retrieveAll();
+        return;
+    }
+    // Keep this object alive while the callbacks of the streams run
+    auto thisPtr = shared_from_this();
+    while (buf->readableBytes() >= kFrameHeaderLength)
+    {
+        auto header = parseFrameHeader(buf->peek());
+        if (header.length > kDefaultMaxFrameSize)
+        {
+            connectionError(ErrorCode::FrameSizeError);
+            buf->retrieveAll();
+            return;
+        }
+        if (buf->readableBytes() < kFrameHeaderLength + header.length)
+            break;
+        bool ok = handleFrame(header, buf->peek() + kFrameHeaderLength);
+        buf->retrieve(kFrameHeaderLength + header.length);
+        if (!ok || closed_)
+        {
+            buf->retrieveAll();
+            return;
+        }
+    }
+    flushStreams();
+}
+
+void Http2ClientConnection::onClose(ReqResult result)
+{
+    closed_ = true;
+    sendingStreams_.clear();
+    while (!streams_.empty())
+    {
+        finishStream(streams_.begin()->first, result);
+    }
+}
+
+bool Http2ClientConnection::handleFrame(const FrameHeader &header,
+                                        const char *payload)
+{
+    if (continuationStreamId_ != 0 &&
+        (header.type != FrameType::Continuation ||
+         header.streamId != continuationStreamId_))
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    switch (header.type)
+    {
+        case FrameType::Data:
+            return handleData(header, payload);
+        case FrameType::Headers:
+            return handleHeaders(header, payload);
+        case FrameType::Continuation:
+            if (continuationStreamId_ == 0)
+            {
+                connectionError(ErrorCode::ProtocolError);
+                return false;
+            }
+            headerBlock_.append(payload, header.length);
+            if (headerBlock_.length() > kMaxHeaderBlockSize)
+            {
+                connectionError(ErrorCode::EnhanceYourCalm);
+                return false;
+            }
+            if (header.flags & flags::kEndHeaders)
+                return processHeaderBlock();
+            return true;
+        case FrameType::RstStream:
+            if (header.streamId == 0 || header.length != 4)
+            {
+                connectionError(ErrorCode::ProtocolError);
+                return false;
+            }
+            LOG_TRACE << "Stream " << header.streamId
+                      << " reset by server, error code: "
+                      << readUint32(payload);
+            finishStream(header.streamId, ReqResult::BadResponse);
+            return true;
+        case FrameType::Settings:
+            return handleSettings(header, payload);
+        case FrameType::PushPromise:
+            // Push is disabled in our settings
+            connectionError(ErrorCode::ProtocolError);
+            return false;
+        case FrameType::Ping:
+            if (header.streamId != 0 || header.length != 8)
+            {
+                connectionError(header.streamId != 0
+                                    ? ErrorCode::ProtocolError
+                                    : ErrorCode::FrameSizeError);
+                return false;
+            }
+            if (!(header.flags & flags::kAck))
+            {
+                appendFrameHeader(
+                    sendBuffer_, 8, FrameType::Ping, flags::kAck, 0);
+                sendBuffer_.append(payload, 8);
+            }
+            return true;
+        case FrameType::GoAway:
+            return handleGoAway(header, payload);
+        case FrameType::WindowUpdate:
+            return handleWindowUpdate(header, payload);
+        default:
+            // PRIORITY and unknown frames are ignored
+            return true;
+    }
+}
+
+bool Http2ClientConnection::handleData(const FrameHeader &header,
+                                       const char *payload)
+{
+    if (header.streamId == 0)
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    connRecvUnacked_ += header.length;
+    if (connRecvUnacked_ >= kConnRecvWindow / 2)
+    {
+        appendWindowUpdate(sendBuffer_, 0, connRecvUnacked_);
+        connRecvUnacked_ = 0;
+    }
+    size_t length = header.length;
+    if (header.flags & flags::kPadded)
+    {
+        if (length < 1 || static_cast<uint8_t>(payload[0]) >= length)
+        {
+            connectionError(ErrorCode::ProtocolError);
+            return false;
+        }
+        length -= 1 + static_cast<uint8_t>(payload[0]);
+        ++payload;
+    }
+    auto iter = streams_.find(header.streamId);
+    if (iter == streams_.end())
+    {
+        // Cancelled or finished stream
+        return true;
+    }
+    auto &stream = iter->second;
+    if (!stream.gotHeaders)
+    {
+        resetStream(header.streamId, ErrorCode::ProtocolError);
+        return true;
+    }
+    stream.body.append(payload, length);
+    if (header.flags & flags::kEndStream)
+    {
+        finishStream(header.streamId, ReqResult::Ok);
+        return true;
+    }
+    stream.recvUnacked += header.length;
+    if (stream.recvUnacked >= kStreamRecvWindow / 2)
+    {
+        appendWindowUpdate(sendBuffer_, header.streamId, stream.recvUnacked);
+        stream.recvUnacked = 0;
+    }
+    return true;
+}
+
+bool Http2ClientConnection::handleHeaders(const FrameHeader &header,
+                                          const char *payload)
+{
+    if (header.streamId == 0)
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    size_t length = header.length;
+    size_t padLength = 0;
+    if (header.flags & flags::kPadded)
+    {
+        if (length < 1)
+        {
+            connectionError(ErrorCode::ProtocolError);
+            return false;
+        }
+        padLength = static_cast<uint8_t>(payload[0]);
+        ++payload;
+        --length;
+    }
+    if (header.flags & flags::kPriority)
+    {
+        if (length < 5)
+        {
+            connectionError(ErrorCode::ProtocolError);
+            return false;
+        }
+        payload += 5;
+        length -= 5;
+    }
+    if (padLength > length)
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    headerBlock_.assign(payload, length - padLength);
+    continuationStreamId_ = header.streamId;
+    continuationEndStream_ = (header.flags & flags::kEndStream) != 0;
+    if (header.flags & flags::kEndHeaders)
+        return processHeaderBlock();
+    return true;
+}
+
+bool Http2ClientConnection::processHeaderBlock()
+{
+    auto streamId = continuationStreamId_;
+    bool endStream = continuationEndStream_;
+    continuationStreamId_ = 0;
+    HpackHeaders fields;
+    // The decoder state must be updated even if the stream is gone
+    if (!decoder_.decode(reinterpret_cast<const uint8_t *>(headerBlock_.data()),
+                         headerBlock_.length(),
+                         fields))
+    {
+        connectionError(ErrorCode::CompressionError);
+        return false;
+    }
+    headerBlock_.clear();
+    auto iter = streams_.find(streamId);
+    if (iter == streams_.end())
+        return true;
+    auto &stream = iter->second;
+    if (stream.gotHeaders)
+    {
+        // Trailers
+        if (!endStream)
+        {
+            resetStream(streamId, ErrorCode::ProtocolError);
+            return true;
+        }
+        for (auto &[name, value] : fields)
+        {
+            if (!name.empty() && name[0] != ':')
+                stream.response->addTrailer(name, value);
+        }
+        finishStream(streamId, ReqResult::Ok);
+        return true;
+    }
+
+    auto resp = std::make_shared<HttpResponseImpl>();
+    resp->setVersion(Version::kHttp11);
+    int status = 0;
+    std::string line;
+    for (auto &[name, value] : fields)
+    {
+        if (name == ":status")
+        {
+            status = atoi(value.c_str());
+            continue;
+        }
+        if (!name.empty() && name[0] == ':')
+            continue;
+        line.assign(name).append(":").append(value);
+        resp->addHeader(line.data(),
+                        line.data() + name.size(),
+                        line.data() + line.size());
+    }
+    if (status < 100 || status > 999)
+    {
+        resetStream(streamId, ErrorCode::ProtocolError);
+        return true;
+    }
+    if (status < 200)
+    {
+        // Informational response, the final response follows
+        return true;
+    }
+    resp->setStatusCode(static_cast<HttpStatusCode>(status));
+    if (auto conn = conn_.lock())
+    {
+        resp->setPeerCertificate(conn->peerCertificate());
+    }
+    stream.response = std::move(resp);
+    stream.gotHeaders = true;
+    if (endStream)
+    {
+        finishStream(streamId, ReqResult::Ok);
+    }
+    return true;
+}
+
+bool Http2ClientConnection::handleSettings(const FrameHeader &header,
+                                           const char *payload)
+{
+    if (header.streamId != 0)
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    if (header.flags & flags::kAck)
+        return true;
+    if (header.length % 6 != 0)
+    {
+        connectionError(ErrorCode::FrameSizeError);
+        return false;
+    }
+    for (size_t i = 0; i < header.length; i += 6)
+    {
+        auto id = static_cast<SettingsId>(readUint16(payload + i));
+        auto value = readUint32(payload + i + 2);
+        switch (id)
+        {
+            case SettingsId::HeaderTableSize:
+                encoder_.setMaxTableSize(value);
+                break;
+            case SettingsId::MaxConcurrentStreams:
+                peerMaxConcurrentStreams_ = value;
+                break;
+            case SettingsId::InitialWindowSize:
+            {
+                if (value > kMaxWindowSize)
+                {
+                    connectionError(ErrorCode::FlowControlError);
+                    return false;
+                }
+                auto delta = static_cast<int64_t>(value) -
+                             static_cast<int64_t>(peerInitialWindowSize_);
+                for (auto &[id, stream] : streams_)
+                {
+                    (void)id;
+                    stream.sendWindow += delta;
+                }
+                peerInitialWindowSize_ = value;
+                break;
+            }
+            case SettingsId::MaxFrameSize:
+                if (value < kDefaultMaxFrameSize || value > kMaxFrameSizeLimit)
+                {
+                    connectionError(ErrorCode::ProtocolError);
+                    return false;
+                }
+                peerMaxFrameSize_ = value;
+                break;
+            default:
+                break;
+        }
+    }
+    appendFrameHeader(sendBuffer_, 0, FrameType::Settings, flags::kAck, 0);
+    return true;
+}
+
+bool Http2ClientConnection::handleWindowUpdate(const FrameHeader &header,
+                                               const char *payload)
+{
+    if (header.length != 4)
+    {
+        connectionError(ErrorCode::FrameSizeError);
+        return false;
+    }
+    auto increment = readUint32(payload) & 0x7fffffff;
+    if (header.streamId == 0)
+    {
+        if (increment == 0 || connSendWindow_ + increment > kMaxWindowSize)
+        {
+            connectionError(increment == 0 ? ErrorCode::ProtocolError
+                                           : ErrorCode::FlowControlError);
+            return false;
+        }
+        connSendWindow_ += increment;
+        return true;
+    }
+    auto iter = streams_.find(header.streamId);
+    if (iter == streams_.end())
+        return true;
+    if (increment == 0 ||
+        iter->second.sendWindow + increment > kMaxWindowSize)
+    {
+        resetStream(header.streamId,
+                    increment == 0 ? ErrorCode::ProtocolError
+                                   : ErrorCode::FlowControlError);
+        return true;
+    }
+    iter->second.sendWindow += increment;
+    return true;
+}
+
+bool Http2ClientConnection::handleGoAway(const FrameHeader &header,
+                                         const char *payload)
+{
+    if (header.streamId != 0 || header.length < 8)
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    auto lastStreamId = readUint32(payload) & 0x7fffffff;
+    LOG_TRACE << "GOAWAY received, last stream: " << lastStreamId
+              << ", error code: " << readUint32(payload + 4);
+    goAwayReceived_ = true;
+    // Streams above the last stream id are not processed by the server
+    while (!streams_.empty() && streams_.rbegin()->first > lastStreamId)
+    {
+        finishStream(streams_.rbegin()->first, ReqResult::NetworkFailure);
+    }
+    return true;
+}
+
+void Http2ClientConnection::finishStream(uint32_t streamId, ReqResult result)
+{
+    auto iter = streams_.find(streamId);
+    if (iter == streams_.end())
+        return;
+    auto callback = std::move(iter->second.callback);
+    auto resp = std::move(iter->second.response);
+    if (result == ReqResult::Ok && resp)
+    {
+        if (!iter->second.body.empty() && !iter->second.isHeadMethod)
+            resp->setBody(std::move(iter->second.body));
+    }
+    else
+    {
+        resp.reset();
+        if (result == ReqResult::Ok)
+            result = ReqResult::BadResponse;
+    }
+    streams_.erase(iter);
+    callback(result, resp);
+}
+
+void Http2ClientConnection::resetStream(uint32_t streamId, ErrorCode code)
+{
+    appendRstStream(sendBuffer_, streamId, code);
+    finishStream(streamId, ReqResult::BadResponse);
+}
+
+void Http2ClientConnection::connectionError(ErrorCode code)
+{
+    LOG_DEBUG << "HTTP/2 connection error: " << static_cast<uint32_t>(code);
+    if (closed_)
+        return;
+    appendGoAway(sendBuffer_, 0, code);
+    flush();
+    onClose(ReqResult::BadResponse);
+    if (auto conn = conn_.lock())
+    {
+        conn->shutdown();
+    }
+}
+
+void Http2ClientConnection::flushStreams()
+{
+    auto count = sendingStreams_.size();
+    while (count-- > 0 && connSendWindow_ > 0)
+    {
+        auto streamId = sendingStreams_.front();
+        sendingStreams_.pop_front();
+        auto iter = streams_.find(streamId);
+        if (iter == streams_.end())
+            continue;
+        auto &stream = iter->second;
+        while (connSendWindow_ > 0 && stream.sendWindow > 0 &&
+               stream.requestBodyOffset < stream.requestBody.length())
+        {
+            auto len = static_cast<size_t>(
+                (std::min)({connSendWindow_,
+                            stream.sendWindow,
+                            static_cast<int64_t>(peerMaxFrameSize_)}));
+            len = (std::min)(len,
+                             stream.requestBody.length() -
+                                 stream.requestBodyOffset);
+            bool end = stream.requestBodyOffset + len ==
+                       stream.requestBody.length();
+            appendFrameHeader(sendBuffer_,
+                              static_cast<uint32_t>(len),
+                              FrameType::Data,
+                              end ? flags::kEndStream : 0,
+                              streamId);
+            sendBuffer_.append(stream.requestBody.data() +
+                                   stream.requestBodyOffset,
+                               len);
+            stream.requestBodyOffset += len;
+            connSendWindow_ -= static_cast<int64_t>(len);
+            stream.sendWindow -= static_cast<int64_t>(len);
+        }
+        if (stream.requestBodyOffset < stream.requestBody.length())
+        {
+            sendingStreams_.push_back(streamId);
+        }
+        else
+        {
+            std::string().swap(stream.requestBody);
+        }
+    }
+    flush();
+}
+
+void Http2ClientConnection::flush()
+{
+    if (sendBuffer_.readableBytes() == 0)
+        return;
+    auto conn = conn_.lock();
+    if (conn && conn->connected())
+    {
+        bytesSent_ += sendBuffer_.readableBytes();
+        conn->send(sendBuffer_);
+    }
+    sendBuffer_.retrieveAll();
+}
@@ -0,0 +1,159 @@
+/**
+ *
+ *  @file Http2ClientConnection.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include "Hpack.h"
+#include "Http2Frame.h"
+#include "impl_forwards.h"
+#include <drogon/HttpTypes.h>
+#include <trantor/net/TcpConnection.h>
+#include <trantor/utils/MsgBuffer.h>
+#include <trantor/utils/NonCopyable.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace drogon
+{
+/**
+ * @brief The client side of a HTTP/2 connection (rfc7540), used by
+ * HttpClientImpl when the server selects h2 by ALPN. Every request is sent on
+ * its own stream, so responses are delivered as soon as they are complete
+ * regardless of the order of the requests.
+ *
+ * All methods must be called in the IO loop of the connection.
+ */
+class Http2ClientConnection
+    : public trantor::NonCopyable,
+      public std::enable_shared_from_this<Http2ClientConnection>
+{
+  public:
+    using ResponseCallback =
+        std::function<void(ReqResult, const HttpResponseImplPtr &)>;
+
+    explicit Http2ClientConnection(const trantor::TcpConnectionPtr &conn);
+
+    /**
+     * @brief Send the client connection preface, must be called once when
+     * the connection is established.
+     */
+    void start();
+
+    void onMessage(trantor::MsgBuffer *buf);
+
+    /**
+     * @brief Fail all pending streams with the result, called when the
+     * connection is closed.
+     */
+    void onClose(ReqResult result);
+
+    /**
+     * @brief Return true if a new stream can be opened, it's false when the
+     * peer limit of concurrent streams is reached or the connection is going
+     * away.
+     */
+    bool canSendRequest() const;
+
+    /**
+     * @brief Send the request on a new stream. The callback is called exactly
+     * once, with the response or with the reason of the failure.
+     */
+    void sendRequest(const HttpRequestPtr &req,
+                     bool secure,
+                     ResponseCallback &&callback);
+
+    /**
+     * @brief Reset the stream of the request with CANCEL, the callback of
+     * the request is called with ReqResult::Timeout. The connection stays
+     * usable for other requests.
+     */
+    void cancelRequest(const HttpRequestPtr &req);
+
+    size_t numberOfStreams() const
+    {
+        return streams_.size();
+    }
+
+    // true if the peer sent GOAWAY
+    bool isGoingAway() const
+    {
+        return goAwayReceived_ || closed_;
+    }
+
+    size_t bytesSent() const
+    {
+        return bytesSent_;
+    }
+
+  private:
+    struct Stream
+    {
+        HttpRequestPtr request;
+        ResponseCallback callback;
+        HttpResponseImplPtr response;
+        bool isHeadMethod{false};
+        bool gotHeaders{false};
+        std::string body;
+        // outgoing request body
+        std::string requestBody;
+        size_t requestBodyOffset{0};
+        int64_t sendWindow{http2::kDefaultWindowSize};
+        uint32_t recvUnacked{0};
+    };
+
+    bool handleFrame(const http2::FrameHeader &header, const char *payload);
+    bool handleData(const http2::FrameHeader &header, const char *payload);
+    bool handleHeaders(const http2::FrameHeader &header, const char *payload);
+    bool handleSettings(const http2::FrameHeader &header, const char *payload);
+    bool handleWindowUpdate(const http2::FrameHeader &header,
+                            const char *payload);
+    bool handleGoAway(const http2::FrameHeader &header, const char *payload);
+    bool processHeaderBlock();
+    void finishStream(uint32_t streamId, ReqResult result);
+    void resetStream(uint32_t streamId, http2::ErrorCode code);
+    void connectionError(http2::ErrorCode code);
+    void flushStreams();
+    void flush();
+
+    std::weak_ptr<trantor::TcpConnection> conn_;
+    HpackDecoder decoder_;
+    HpackEncoder encoder_;
+    bool goAwayReceived_{false};
+    bool closed_{false};
+
+    uint32_t nextStreamId_{1};
+    // Ordered by stream id, requests are answered in the order they were sent
+    // when the connection fails.
+    std::map<uint32_t, Stream> streams_;
+    // streams with request body waiting for flow control window
+    std::deque<uint32_t> sendingStreams_;
+
+    // Header block being received with CONTINUATION frames
+    uint32_t continuationStreamId_{0};
+    bool continuationEndStream_{false};
+    std::string headerBlock_;
+
+    // peer settings
+    uint32_t peerMaxConcurrentStreams_{100};
+    uint32_t peerInitialWindowSize_{http2::kDefaultWindowSize};
+    uint32_t peerMaxFrameSize_{http2::kDefaultMaxFrameSize};
+    int64_t connSendWindow_{http2::kDefaultWindowSize};
+    uint32_t connRecvUnacked_{0};
+
+    trantor::MsgBuffer sendBuffer_;
+    size_t bytesSent_{0};
+};
+}  // namespace drogon
@@ -0,0 +1,227 @@
+/**
+ *
+ *  @file Http2Frame.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/utils/MsgBuffer.h>
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+
+namespace drogon
+{
+namespace http2
+{
+// rfc7540-3.5
+constexpr std::string_view kConnectionPreface{
+    "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"};
+constexpr size_t kFrameHeaderLength = 9;
+constexpr uint32_t kDefaultWindowSize = 65535;
+constexpr uint32_t kMaxWindowSize = 0x7fffffff;
+constexpr uint32_t kDefaultMaxFrameSize = 16384;
+constexpr uint32_t kMaxFrameSizeLimit = 16777215;
+
+enum class FrameType : uint8_t
+{
+    Data = 0x0,
+    Headers = 0x1,
+    Priority = 0x2,
+    RstStream = 0x3,
+    Settings = 0x4,
+    PushPromise = 0x5,
+    Ping = 0x6,
+    GoAway = 0x7,
+    WindowUpdate = 0x8,
+    Continuation = 0x9
+};
+
+namespace flags
+{
+constexpr uint8_t kEndStream = 0x1;
+constexpr uint8_t kAck = 0x1;
+constexpr uint8_t kEndHeaders = 0x4;
+constexpr uint8_t kPadded = 0x8;
+constexpr uint8_t kPriority = 0x20;
+}  // namespace flags
+
+enum class SettingsId : uint16_t
+{
+    HeaderTableSize = 0x1,
+    EnablePush = 0x2,
+    MaxConcurrentStreams = 0x3,
+    InitialWindowSize = 0x4,
+    MaxFrameSize = 0x5,
+    MaxHeaderListSize = 0x6
+};
+
+enum class ErrorCode : uint32_t
+{
+    NoError = 0x0,
+    ProtocolError = 0x1,
+    InternalError = 0x2,
+    FlowControlError = 0x3,
+    SettingsTimeout = 0x4,
+    StreamClosed = 0x5,
+    FrameSizeError = 0x6,
+    RefusedStream = 0x7,
+    Cancel = 0x8,
+    CompressionError = 0x9,
+    ConnectError = 0xa,
+    EnhanceYourCalm = 0xb,
+    InadequateSecurity = 0xc,
+    Http11Required = 0xd
+};
+
+struct FrameHeader
+{
+    uint32_t length{0};
+    FrameType type{FrameType::Data};
+    uint8_t flags{0};
+    uint32_t streamId{0};
+};
+
+inline uint32_t readUint32(const char *p)
+{
+    auto u = reinterpret_cast<const uint8_t *>(p);
+    return (static_cast<uint32_t>(u[0]) << 24) |
+           (static_cast<uint32_t>(u[1]) << 16) |
+           (static_cast<uint32_t>(u[2]) << 8) | static_cast<uint32_t>(u[3]);
+}
+
+inline uint16_t readUint16(const char *p)
+{
+    auto u = reinterpret_cast<const uint8_t *>(p);
+    return static_cast<uint16_t>((u[0] << 8) | u[1]);
+}
+
+/**
+ * @brief Parse the 9 bytes frame header at the beginning of data, the caller
+ * must make sure that there are at least kFrameHeaderLength bytes.
+ */
+inline FrameHeader parseFrameHeader(const char *data)
+{
+    auto u = reinterpret_cast<const uint8_t *>(data);
+    FrameHeader header;
+    header.length = (static_cast<uint32_t>(u[0]) << 16) |
+                    (static_cast<uint32_t>(u[1]) << 8) |
+                    static_cast<uint32_t>(u[2]);
+    header.type = static_cast<FrameType>(u[3]);
+    header.flags = u[4];
+    header.streamId = readUint32(data + 5) & 0x7fffffff;
+    return header;
+}
+
+inline void appendUint32(trantor::MsgBuffer &buffer, uint32_t value)
+{
+    char bytes[4] = {static_cast<char>(value >> 24),
+                     static_cast<char>(value >> 16),
+                     static_cast<char>(value >> 8),
+                     static_cast<char>(value)};
+    buffer.append(bytes, 4);
+}
+
+/**
+ * @brief Write the 9 bytes frame header to dst.
+ */
+inline void writeFrameHeader(char *dst,
+                             uint32_t length,
+                             FrameType type,
+                             uint8_t frameFlags,
+                             uint32_t streamId)
+{
+    dst[0] = static_cast<char>(length >> 16);
+    dst[1] = static_cast<char>(length >> 8);
+    dst[2] = static_cast<char>(length);
+    dst[3] = static_cast<char>(type);
+    dst[4] = static_cast<char>(frameFlags);
+    dst[5] = static_cast<char>(streamId >> 24);
+    dst[6] = static_cast<char>(streamId >> 16);
+    dst[7] = static_cast<char>(streamId >> 8);
+    dst[8] = static_cast<char>(streamId);
+}
+
+inline void appendFrameHeader(trantor::MsgBuffer &buffer,
+                              uint32_t length,
+                              FrameType type,
+                              uint8_t frameFlags,
+                              uint32_t streamId)
+{
+    char bytes[kFrameHeaderLength];
+    writeFrameHeader(bytes, length, type, frameFlags, streamId);
+    buffer.append(bytes, kFrameHeaderLength);
+}
+
+inline void appendSetting(trantor::MsgBuffer &buffer,
+                          SettingsId id,
+                          uint32_t value)
+{
+    char bytes[2] = {static_cast<char>(static_cast<uint16_t>(id) >> 8),
+                     static_cast<char>(static_cast<uint16_t>(id))};
+    buffer.append(bytes, 2);
+    appendUint32(buffer, value);
+}
+
+inline void appendWindowUpdate(trantor::MsgBuffer &buffer,
+                               uint32_t streamId,
+                               uint32_t increment)
+{
+    appendFrameHeader(buffer, 4, FrameType::WindowUpdate, 0, streamId);
+    appendUint32(buffer, increment & 0x7fffffff);
+}
+
+inline void appendRstStream(trantor::MsgBuffer &buffer,
+                            uint32_t streamId,
+                            ErrorCode code)
+{
+    appendFrameHeader(buffer, 4, FrameType::RstStream, 0, streamId);
+    appendUint32(buffer, static_cast<uint32_t>(code));
+}
+
+inline void appendGoAway(trantor::MsgBuffer &buffer,
+                         uint32_t lastStreamId,
+                         ErrorCode code)
+{
+    appendFrameHeader(buffer, 8, FrameType::GoAway, 0, 0);
+    appendUint32(buffer, lastStreamId & 0x7fffffff);
+    appendUint32(buffer, static_cast<uint32_t>(code));
+}
+
+/**
+ * @brief Append a header block as a HEADERS frame followed by CONTINUATION
+ * frames if it doesn't fit into one frame.
+ */
+inline void appendHeaderBlock(trantor::MsgBuffer &buffer,
+                              uint32_t streamId,
+                              std::string_view block,
+                              bool endStream,
+                              uint32_t maxFrameSize)
+{
+    auto type = FrameType::Headers;
+    do
+    {
+        auto len =
+            (std::min)(block.length(), static_cast<size_t>(maxFrameSize));
+        uint8_t frameFlags = 0;
+        if (type == FrameType::Headers && endStream)
+            frameFlags |= flags::kEndStream;
+        if (len == block.length())
+            frameFlags |= flags::kEndHeaders;
+        appendFrameHeader(
+            buffer, static_cast<uint32_t>(len), type, frameFlags, streamId);
+        buffer.append(block.data(), len);
+        block.remove_prefix(len);
+        type = FrameType::Continuation;
+    } while (!block.empty());
+}
+}  // namespace http2
+}  // namespace drogon
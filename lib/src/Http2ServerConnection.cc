@@ -0,0 +1,1056 @@
+/**
+ *
+ *  @file Http2ServerConnection.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "Http2ServerConnection.h"
+#include "HttpAppFrameworkImpl.h"
+#include "HttpRequestImpl.h"
+#include "HttpResponseImpl.h"
+#include <trantor/net/AsyncStream.h>
+#include <trantor/utils/Logger.h>
+#include <cstdio>
+#include <cstring>
+
+using namespace drogon;
+using namespace drogon::http2;
+
+namespace
+{
+constexpr uint32_t kMaxConcurrentStreams = 100;
+// Receive windows advertised to the client, large enough to not throttle
+// uploads on high-latency links.
+constexpr uint32_t kStreamRecvWindow = 1024 * 1024;
+constexpr uint32_t kConnRecvWindow = 16 * 1024 * 1024;
+// The limit for a header block, same as the limit of HTTP/1.x headers
+constexpr size_t kMaxHeaderBlockSize = 64 * 1024;
+// Bytes of DATA frames written before waiting for the socket to drain
+constexpr size_t kMaxBytesPerRound = 256 * 1024;
+
+/**
+ * Adapts the chunked data produced by ResponseStream to DATA frames.
+ * ResponseStream always sends exactly one chunk per send() call.
+ */
+class Http2AsyncStream : public trantor::AsyncStream
+{
+  public:
+    Http2AsyncStream(std::weak_ptr<Http2ServerConnection> conn,
+                     trantor::EventLoop *loop,
+                     uint32_t streamId)
+        : conn_(std::move(conn)), loop_(loop), streamId_(streamId)
+    {
+    }
+
+    ~Http2AsyncStream() override
+    {
+        close();
+    }
+
+    using trantor::AsyncStream::send;
+
+    bool send(const char *data, size_t len) override
+    {
+        if (closed_)
+            return false;
+        std::string_view chunk(data, len);
+        auto pos = chunk.find("\r\n");
+        if (pos == std::string_view::npos)
+            return false;
+        auto length = std::strtoul(std::string(chunk.substr(0, pos)).c_str(),
+                                   nullptr,
+                                   16);
+        if (length == 0)
+        {
+            close();
+            return true;
+        }
+        chunk.remove_prefix(pos + 2);
+        if (chunk.length() < length)
+            return false;
+        post(std::string(chunk.substr(0, length)), false);
+        return true;
+    }
+
+    void close() override
+    {
+        if (closed_)
+            return;
+        closed_ = true;
+        post(std::string{}, true);
+    }
+
+  private:
+    void post(std::string &&data, bool end)
+    {
+        auto task = [conn = conn_,
+                     streamId = streamId_,
+                     data = std::move(data),
+                     end]() mutable {
+            if (auto connPtr = conn.lock())
+                connPtr->appendStreamData(streamId, std::move(data), end);
+        };
+        if (loop_->isInLoopThread())
+            task();
+        else
+            loop_->queueInLoop(std::move(task));
+    }
+
+    std::weak_ptr<Http2ServerConnection> conn_;
+    trantor::EventLoop *loop_;
+    uint32_t streamId_;
+    bool closed_{false};
+};
+
+// Reads the parts of a multipart/byteranges body, their headers and their
+// ranges of the file, one after the other.
+std::function<size_t(char *, size_t)> partsDataSource(
+    std::shared_ptr<FILE> file,
+    std::vector<HttpResponseImpl::SendfilePart> parts)
+{
+    return [file = std::move(file),
+            parts = std::move(parts),
+            index = size_t{0},
+            offset = size_t{0}](char *buf, size_t len) mutable {
+        size_t n{0};
+        while (n < len && index < parts.size())
+        {
+            auto &part = parts[index];
+            auto headerLength = part.header.length();
+            if (offset < headerLength)
+            {
+                auto count = (std::min)(len - n, headerLength - offset);
+                memcpy(buf + n, part.header.data() + offset, count);
+                n += count;
+                offset += count;
+                if (offset == headerLength && part.length > 0)
+                    fseek(file.get(), (long)part.offset, SEEK_SET);
+                continue;
+            }
+            auto left = headerLength + part.length - offset;
+            if (left == 0)
+            {
+                ++index;
+                offset = 0;
+                continue;
+            }
+            auto count =
+                fread(buf + n, 1, (std::min)(len - n, left), file.get());
+            if (count == 0)
+                break;
+            n += count;
+            offset += count;
+        }
+        return n;
+    };
+}
+}  // namespace
+
+Http2ServerConnection::Http2ServerConnection(
+    const trantor::TcpConnectionPtr &conn,
+    RequestCallback callback)
+    : conn_(conn),
+      loop_(conn->getLoop()),
+      requestCallback_(std::move(callback))
+{
+}
+
+void Http2ServerConnection::start()
+{
+    auto conn = conn_.lock();
+    if (!conn)
+        return;
+    conn->setWriteCompleteCallback(
+        [weakPtr = weak_from_this()](const trantor::TcpConnectionPtr &) {
+            auto thisPtr = weakPtr.lock();
+            if (thisPtr && thisPtr->waitingForWriteComplete_)
+            {
+                thisPtr->waitingForWriteComplete_ = false;
+                thisPtr->flushStreams();
+            }
+        });
+    // Server connection preface (rfc7540-3.5)
+    appendFrameHeader(sendBuffer_, 18, FrameType::Settings, 0, 0);
+    appendSetting(sendBuffer_,
+                  SettingsId::MaxConcurrentStreams,
+                  kMaxConcurrentStreams);
+    appendSetting(sendBuffer_,
+                  SettingsId::InitialWindowSize,
+                  kStreamRecvWindow);
+    appendSetting(sendBuffer_,
+                  SettingsId::MaxHeaderListSize,
+                  static_cast<uint32_t>(kMaxHeaderBlockSize));
+    appendWindowUpdate(sendBuffer_, 0, kConnRecvWindow - kDefaultWindowSize);
+    flush();
+}
+
+void Http2ServerConnection::onMessage(trantor::MsgBuffer *buf)
+{
+    if (closed_)
+    {
+        buf->retrieveAll();
+        return;
+    }
+    if (!prefaceReceived_)
+    {
+        if (buf->readableBytes() < kConnectionPreface.length())
+            return;
+        if (memcmp(buf->peek(),
+                   kConnectionPreface.data(),
+                   kConnectionPreface.length()) != 0)
+        {
+            connectionError(ErrorCode::ProtocolError);
+            buf->retrieveAll();
+            return;
+        }
+        buf->retrieve(kConnectionPreface.length());
+        prefaceReceived_ = true;
+    }
+    while (buf->readableBytes() >= kFrameHeaderLength)
+    {
+        auto header = parseFrameHeader(buf->peek());
+        if (header.length > kDefaultMaxFrameSize)
+        {
+            connectionError(ErrorCode::FrameSizeError);
+            buf->retrieveAll();
+            return;
+        }
+        if (buf->readableBytes() < kFrameHeaderLength + header.length)
+            break;
+        bool ok = handleFrame(header, buf->peek() + kFrameHeaderLength);
+        buf->retrieve(kFrameHeaderLength + header.length);
+        if (!ok)
+        {
+            buf->retrieveAll();
+            return;
+        }
+    }
+    flushStreams();
+}
+
+void Http2ServerConnection::onClose()
+{
+    closed_ = true;
+    std::vector<HttpRequestImplPtr> pending;
+    for (auto &[id, stream] : streams_)
+    {
+        (void)id;
+        if (stream.hasDataSource && !stream.lengthKnown && stream.dataSource)
+        {
+            // Let user stream callbacks release their resources
+            stream.dataSource(nullptr, 0);
+        }
+        if (stream.request && !stream.responded)
+            pending.emplace_back(std::move(stream.request));
+    }
+    streams_.clear();
+    sendingStreams_.clear();
+    for (auto &req : pending)
+        req->cancel();
+}
+
+bool Http2ServerConnection::handleFrame(const FrameHeader &header,
+                                        const char *payload)
+{
+    if (continuationStreamId_ != 0 &&
+        (header.type != FrameType::Continuation ||
+         header.streamId != continuationStreamId_))
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    switch (header.type)
+    {
+        case FrameType::Data:
+            return handleData(header, payload);
+        case FrameType::Headers:
+            return handleHeaders(header, payload);
+        case FrameType::Continuation:
+            if (continuationStreamId_ == 0)
+            {
+                connectionError(ErrorCode::ProtocolError);
+                return false;
+            }
+            headerBlock_.append(payload, header.length);
+            if (headerBlock_.length() > kMaxHeaderBlockSize)
+            {
+                connectionError(ErrorCode::EnhanceYourCalm);
+                return false;
+            }
+            if (header.flags & flags::kEndHeaders)
+                return processHeaderBlock();
+            return true;
+        case FrameType::Priority:
+            if (header.streamId == 0 || header.length != 5)
+            {
+                connectionError(ErrorCode::ProtocolError);
+                return false;
+            }
+            // Priorities are advisory, we serve streams round-robin
+            return true;
+        case FrameType::RstStream:
+            if (header.streamId == 0 || header.length != 4)
+            {
+                connectionError(ErrorCode::ProtocolError);
+                return false;
+            }
+            LOG_TRACE << "Stream " << header.streamId << " reset by peer";
+            if (streams_.find(header.streamId) != streams_.end())
+            {
+                // The peer closed the stream, don't reply with RST_STREAM
+                streams_[header.streamId].remoteClosed = true;
+                closeStream(header.streamId);
+            }
+            return true;
+        case FrameType::Settings:
+            return handleSettings(header, payload);
+        case FrameType::PushPromise:
+            // Clients can't push
+            connectionError(ErrorCode::ProtocolError);
+            return false;
+        case FrameType::Ping:
+            if (header.streamId != 0 || header.length != 8)
+            {
+                connectionError(header.streamId != 0
+                                    ? ErrorCode::ProtocolError
+                                    : ErrorCode::FrameSizeError);
+                return false;
+            }
+            if (!(header.flags & flags::kAck))
+            {
+                appendFrameHeader(
+                    sendBuffer_, 8, FrameType::Ping, flags::kAck, 0);
+                sendBuffer_.append(payload, 8);
+            }
+            return true;
+        case FrameType::GoAway:
+            LOG_TRACE << "GOAWAY received, error code: "
+                      << (header.length >= 8 ? readUint32(payload + 4) : 0);
+            goAwayReceived_ = true;
+            return true;
+        case FrameType::WindowUpdate:
+            return handleWindowUpdate(header, payload);
+        default:
+            // Unknown frame types must be ignored (rfc7540-4.1)
+            return true;
+    }
+}
+
+bool Http2ServerConnection::handleData(const FrameHeader &header,
+                                       const char *payload)
+{
+    if (header.streamId == 0)
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    // The whole frame counts against flow control, including padding
+    connRecvUnacked_ += header.length;
+    if (connRecvUnacked_ >= kConnRecvWindow / 2)
+    {
+        appendWindowUpdate(sendBuffer_, 0, connRecvUnacked_);
+        connRecvUnacked_ = 0;
+    }
+    size_t length = header.length;
+    if (header.flags & flags::kPadded)
+    {
+        if (length < 1 || static_cast<uint8_t>(payload[0]) >= length)
+        {
+            connectionError(ErrorCode::ProtocolError);
+            return false;
+        }
+        length -= 1 + static_cast<uint8_t>(payload[0]);
+        ++payload;
+    }
+    auto iter = streams_.find(header.streamId);
+    if (iter == streams_.end())
+    {
+        if (header.streamId > lastStreamId_)
+        {
+            connectionError(ErrorCode::ProtocolError);
+            return false;
+        }
+        // Data of a stream we have reset, ignore it
+        return true;
+    }
+    auto &stream = iter->second;
+    if (stream.remoteClosed || !stream.request)
+    {
+        resetStream(header.streamId, ErrorCode::StreamClosed);
+        return true;
+    }
+    if (stream.request->realContentLength() + length >
+        HttpAppFrameworkImpl::instance().getClientMaxBodySize())
+    {
+        respondWithStatus(header.streamId, k413RequestEntityTooLarge);
+        return true;
+    }
+    if (length > 0)
+        stream.request->appendToBody(payload, length);
+    stream.recvUnacked += header.length;
+    bool endStream = (header.flags & flags::kEndStream) != 0;
+    if (!endStream && stream.recvUnacked >= kStreamRecvWindow / 2)
+    {
+        appendWindowUpdate(sendBuffer_, header.streamId, stream.recvUnacked);
+        stream.recvUnacked = 0;
+    }
+    if (endStream)
+    {
+        stream.remoteClosed = true;
+        dispatchRequest(header.streamId, stream);
+    }
+    return true;
+}
+
+bool Http2ServerConnection::handleHeaders(const FrameHeader &header,
+                                          const char *payload)
+{
+    if (header.streamId == 0 || (header.streamId & 1) == 0)
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    size_t length = header.length;
+    size_t padLength = 0;
+    if (header.flags & flags::kPadded)
+    {
+        if (length < 1)
+        {
+            connectionError(ErrorCode::ProtocolError);
+            return false;
+        }
+        padLength = static_cast<uint8_t>(payload[0]);
+        ++payload;
+        --length;
+    }
+    if (header.flags & flags::kPriority)
+    {
+        if (length < 5)
+        {
+            connectionError(ErrorCode::ProtocolError);
+            return false;
+        }
+        payload += 5;
+        length -= 5;
+    }
+    if (padLength > length)
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    length -= padLength;
+    headerBlock_.assign(payload, length);
+    continuationStreamId_ = header.streamId;
+    continuationEndStream_ = (header.flags & flags::kEndStream) != 0;
+    if (header.flags & flags::kEndHeaders)
+        return processHeaderBlock();
+    return true;
+}
+
+bool Http2ServerConnection::processHeaderBlock()
+{
+    auto streamId = continuationStreamId_;
+    bool endStream = continuationEndStream_;
+    continuationStreamId_ = 0;
+    HpackHeaders fields;
+    // The decoder state must be updated even if the stream is refused
+    if (!decoder_.decode(reinterpret_cast<const uint8_t *>(headerBlock_.data()),
+                         headerBlock_.length(),
+                         fields))
+    {
+        connectionError(ErrorCode::CompressionError);
+        return false;
+    }
+    headerBlock_.clear();
+
+    auto iter = streams_.find(streamId);
+    if (iter != streams_.end())
+    {
+        // Trailers
+        auto &stream = iter->second;
+        if (stream.remoteClosed || !endStream)
+        {
+            resetStream(streamId, ErrorCode::ProtocolError);
+            return true;
+        }
+        stream.remoteClosed = true;
+        dispatchRequest(streamId, stream);
+        return true;
+    }
+    if (streamId <= lastStreamId_)
+    {
+        connectionError(ErrorCode::StreamClosed);
+        return false;
+    }
+    lastStreamId_ = streamId;
+    if (goAwayReceived_)
+        return true;
+    if (streams_.size() >= kMaxConcurrentStreams)
+    {
+        resetStream(streamId, ErrorCode::RefusedStream);
+        return true;
+    }
+
+    auto conn = conn_.lock();
+    if (!conn)
+        return false;
+    auto req = std::make_shared<HttpRequestImpl>(loop_);
+    // HTTP/2 keeps the semantics of HTTP/1.1, the version is only relevant
+    // when the request is forwarded with a HTTP/1.1 client.
+    req->setVersion(Version::kHttp11);
+    bool hasMethod{false}, hasPath{false}, hasScheme{false};
+    std::string line;
+    for (auto &[name, value] : fields)
+    {
+        if (!name.empty() && name[0] == ':')
+        {
+            if (name == ":method")
+            {
+                if (!req->setMethod(value.data(), value.data() + value.size()))
+                {
+                    respondWithStatus(streamId, k405MethodNotAllowed);
+                    return true;
+                }
+                hasMethod = true;
+            }
+            else if (name == ":path")
+            {
+                auto begin = value.data();
+                auto end = begin + value.size();
+                auto question = std::find(begin, end, '?');
+                auto slash = std::find(begin, question, '/');
+                if (slash != question)
+                    req->setPath(slash, question);
+                else
+                    req->setPath("/");
+                if (question != end)
+                    req->setQuery(question + 1, end);
+                hasPath = true;
+            }
+            else if (name == ":scheme")
+            {
+                hasScheme = true;
+            }
+            else if (name == ":authority")
+            {
+                req->addHeader("host", value);
+            }
+            else
+            {
+                resetStream(streamId, ErrorCode::ProtocolError);
+                return true;
+            }
+            continue;
+        }
+        line.reserve(name.size() + value.size() + 1);
+        line.assign(name).append(":").append(value);
+        req->addHeader(line.data(),
+                       line.data() + name.size(),
+                       line.data() + line.size());
+    }
+    if (!hasMethod || !hasPath || !hasScheme)
+    {
+        resetStream(streamId, ErrorCode::ProtocolError);
+        return true;
+    }
+    req->setPeerAddr(conn->peerAddr());
+    req->setLocalAddr(conn->localAddr());
+    req->setCreationDate(trantor::Date::date());
+    req->setSecure(conn->isSSLConnection());
+    req->setPeerCertificate(conn->peerCertificate());
+    req->setConnectionPtr(conn);
+    req->setHttp2StreamId(streamId);
+
+    auto &stream = streams_[streamId];
+    stream.request = std::move(req);
+    stream.sendWindow = peerInitialWindowSize_;
+    if (endStream)
+    {
+        stream.remoteClosed = true;
+        dispatchRequest(streamId, stream);
+    }
+    return true;
+}
+
+bool Http2ServerConnection::handleSettings(const FrameHeader &header,
+                                           const char *payload)
+{
+    if (header.streamId != 0)
+    {
+        connectionError(ErrorCode::ProtocolError);
+        return false;
+    }
+    if (header.flags & flags::kAck)
+    {
+        if (header.length != 0)
+        {
+            connectionError(ErrorCode::FrameSizeError);
+            return false;
+        }
+        return true;
+    }
+    if (header.length % 6 != 0)
+    {
+        connectionError(ErrorCode::FrameSizeError);
+        return false;
+    }
+    for (size_t i = 0; i < header.length; i += 6)
+    {
+        auto id = static_cast<SettingsId>(readUint16(payload + i));
+        auto value = readUint32(payload + i + 2);
+        switch (id)
+        {
+            case SettingsId::HeaderTableSize:
+                encoder_.setMaxTableSize(value);
+                break;
+            case SettingsId::EnablePush:
+                if (value > 1)
+                {
+                    connectionError(ErrorCode::ProtocolError);
+                    return false;
+                }
+                break;
+            case SettingsId::InitialWindowSize:
+            {
+                if (value > kMaxWindowSize)
+                {
+                    connectionError(ErrorCode::FlowControlError);
+                    return false;
+                }
+                // rfc7540-6.9.2, adjust the windows of all open streams
+                auto delta = static_cast<int64_t>(value) -
+                             static_cast<int64_t>(peerInitialWindowSize_);
+                for (auto &[id, stream] : streams_)
+                {
+                    (void)id;
+                    stream.sendWindow += delta;
+                }
+                peerInitialWindowSize_ = value;
+                break;
+            }
+            case SettingsId::MaxFrameSize:
+                if (value < kDefaultMaxFrameSize || value > kMaxFrameSizeLimit)
+                {
+                    connectionError(ErrorCode::ProtocolError);
+                    return false;
+                }
+                peerMaxFrameSize_ = value;
+                break;
+            default:
+                break;
+        }
+    }
+    appendFrameHeader(sendBuffer_, 0, FrameType::Settings, flags::kAck, 0);
+    return true;
+}
+
+bool Http2ServerConnection::handleWindowUpdate(const FrameHeader &header,
+                                               const char *payload)
+{
+    if (header.length != 4)
+    {
+        connectionError(ErrorCode::FrameSizeError);
+        return false;
+    }
+    auto increment = readUint32(payload) & 0x7fffffff;
+    if (header.streamId == 0)
+    {
+        if (increment == 0 || connSendWindow_ + increment > kMaxWindowSize)
+        {
+            connectionError(increment == 0 ? ErrorCode::ProtocolError
+                                           : ErrorCode::FlowControlError);
+            return false;
+        }
+        connSendWindow_ += increment;
+        return true;
+    }
+    auto iter = streams_.find(header.streamId);
+    if (iter == streams_.end())
+        return true;
+    if (increment == 0)
+    {
+        resetStream(header.streamId, ErrorCode::ProtocolError);
+        return true;
+    }
+    auto &stream = iter->second;
+    if (stream.sendWindow + increment > kMaxWindowSize)
+    {
+        resetStream(header.streamId, ErrorCode::FlowControlError);
+        return true;
+    }
+    stream.sendWindow += increment;
+    return true;
+}
+
+void Http2ServerConnection::dispatchRequest(uint32_t streamId, Stream &stream)
+{
+    auto &req = stream.request;
+    if (req->bodyLength() > 0 && req->getHeaderBy("content-length").empty())
+    {
+        req->addHeader("content-length",
+                       std::to_string(req->realContentLength()));
+    }
+    requestCallback_(shared_from_this(), streamId, req);
+}
+
+void Http2ServerConnection::respondWithStatus(uint32_t streamId,
+                                              HttpStatusCode code)
+{
+    auto iter = streams_.find(streamId);
+    if (iter == streams_.end())
+    {
+        // The stream is not created yet
+        streams_[streamId].sendWindow = peerInitialWindowSize_;
+    }
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(code);
+    sendResponse(streamId, resp, false);
+}
+
+void Http2ServerConnection::sendResponse(uint32_t streamId,
+                                         const HttpResponsePtr &response,
+                                         bool isHeadMethod)
+{
+    loop_->assertInLoopThread();
+    if (closed_)
+        return;
+    auto iter = streams_.find(streamId);
+    if (iter == streams_.end() || iter->second.responded)
+        return;
+    auto &stream = iter->second;
+    stream.responded = true;
+    // Kept for the trailers, which can be added to streamed responses.
+    stream.response = response;
+
+    auto respImpl = static_cast<HttpResponseImpl *>(response.get());
+    HpackHeaders fields;
+    respImpl->makeHttp2Headers(fields);
+    std::string block;
+    for (auto &[name, value] : fields)
+    {
+        encoder_.encode(name, value, block);
+    }
+
+    bool hasBody = !isHeadMethod && respImpl->contentLengthIsAllowed();
+    if (hasBody)
+    {
+        if (respImpl->asyncStreamCallback())
+        {
+            stream.asyncStream = true;
+        }
+        else if (respImpl->streamCallback())
+        {
+            stream.dataSource = respImpl->streamCallback();
+        }
+        else if (!respImpl->sendfileName().empty())
+        {
+            auto &range = respImpl->sendfileRange();
+            std::shared_ptr<FILE> file(
+                fopen(respImpl->sendfileName().c_str(), "rb"), [](FILE *fp) {
+                    if (fp)
+                        fclose(fp);
+                });
+            if (!file || fseek(file.get(), (long)range.first, SEEK_SET) != 0)
+            {
+                LOG_ERROR << "Failed to open " << respImpl->sendfileName();
+                resetStream(streamId, ErrorCode::InternalError);
+                return;
+            }
+            size_t length = range.second;
+            if (!respImpl->sendfileParts().empty())
+            {
+                stream.dataSource =
+                    partsDataSource(std::move(file), respImpl->sendfileParts());
+            }
+            else
+            {
+                if (length == 0)
+                {
+                    fseek(file.get(), 0, SEEK_END);
+                    length =
+                        static_cast<size_t>(ftell(file.get())) - range.first;
+                    fseek(file.get(), (long)range.first, SEEK_SET);
+                }
+                stream.dataSource = [file = std::move(file)](char *buf,
+                                                             size_t len) {
+                    return fread(buf, 1, len, file.get());
+                };
+            }
+            stream.lengthKnown = true;
+            stream.remainingLength = length;
+            hasBody = length > 0;
+        }
+        else
+        {
+            auto body = respImpl->getBody();
+            if (body.empty())
+            {
+                hasBody = false;
+            }
+            else
+            {
+                stream.dataSource = [response,
+                                     body,
+                                     offset = size_t{0}](char *buf,
+                                                         size_t len) mutable {
+                    auto n = (std::min)(len, body.length() - offset);
+                    memcpy(buf, body.data() + offset, n);
+                    offset += n;
+                    return n;
+                };
+                stream.lengthKnown = true;
+                stream.remainingLength = body.length();
+            }
+        }
+    }
+    bool hasTrailers = !response->trailers().empty();
+    appendHeaderBlock(sendBuffer_,
+                      streamId,
+                      block,
+                      !hasBody && !hasTrailers,
+                      peerMaxFrameSize_);
+    if (!hasBody)
+    {
+        if (hasTrailers)
+            appendTrailers(streamId, *response);
+        closeStream(streamId);
+        flush();
+        return;
+    }
+    stream.hasDataSource = true;
+    if (stream.asyncStream)
+    {
+        respImpl->asyncStreamCallback()(std::make_unique<ResponseStream>(
+            std::make_unique<Http2AsyncStream>(weak_from_this(),
+                                               loop_,
+                                               streamId)));
+        // appendStreamData() may have been called synchronously
+        flush();
+        return;
+    }
+    sendingStreams_.push_back(streamId);
+    flushStreams();
+}
+
+void Http2ServerConnection::sendEarlyHints(
+    uint32_t streamId,
+    const std::vector<std::string> &links)
+{
+    loop_->assertInLoopThread();
+    if (closed_)
+        return;
+    auto iter = streams_.find(streamId);
+    if (iter == streams_.end() || iter->second.responded)
+        return;
+    std::string block;
+    encoder_.encode(":status", "103", block);
+    for (auto &link : links)
+    {
+        encoder_.encode("link", link, block);
+    }
+    appendHeaderBlock(sendBuffer_, streamId, block, false, peerMaxFrameSize_);
+    flush();
+}
+
+void Http2ServerConnection::appendStreamData(uint32_t streamId,
+                                             std::string &&data,
+                                             bool end)
+{
+    auto iter = streams_.find(streamId);
+    if (iter == streams_.end() || closed_)
+        return;
+    auto &stream = iter->second;
+    if (!data.empty())
+        stream.pushedData.push_back(std::move(data));
+    if (end)
+        stream.pushEnded = true;
+    if (std::find(sendingStreams_.begin(), sendingStreams_.end(), streamId) ==
+        sendingStreams_.end())
+    {
+        sendingStreams_.push_back(streamId);
+    }
+    flushStreams();
+}
+
+bool Http2ServerConnection::writeStreamData(uint32_t streamId, Stream &stream)
+{
+    size_t written = 0;
+    while (connSendWindow_ > 0 && stream.sendWindow > 0 &&
+           written < kMaxBytesPerRound)
+    {
+        auto avail = static_cast<size_t>(
+            (std::min)({connSendWindow_,
+                        stream.sendWindow,
+                        static_cast<int64_t>(peerMaxFrameSize_)}));
+        size_t n = 0;
+        bool end = false;
+        sendBuffer_.ensureWritableBytes(kFrameHeaderLength + avail);
+        char *dataStart = sendBuffer_.beginWrite() + kFrameHeaderLength;
+        if (stream.asyncStream)
+        {
+            if (stream.pushedData.empty())
+            {
+                if (!stream.pushEnded)
+                    return false;
+                end = true;
+            }
+            else
+            {
+                auto &front = stream.pushedData.front();
+                n = (std::min)(avail, front.length() - stream.pushedOffset);
+                memcpy(dataStart, front.data() + stream.pushedOffset, n);
+                stream.pushedOffset += n;
+                if (stream.pushedOffset == front.length())
+                {
+                    stream.pushedData.pop_front();
+                    stream.pushedOffset = 0;
+                }
+                end = stream.pushEnded && stream.pushedData.empty();
+            }
+        }
+        else
+        {
+            if (stream.lengthKnown)
+                avail = (std::min)(avail, stream.remainingLength);
+            n = stream.dataSource(dataStart, avail);
+            if (stream.lengthKnown)
+            {
+                stream.remainingLength -= n;
+                end = (stream.remainingLength == 0 || n == 0);
+            }
+            else
+            {
+                end = (n == 0);
+            }
+        }
+        // The trailers end the stream instead of the last DATA frame.
+        bool withTrailers =
+            end && stream.response && !stream.response->trailers().empty();
+        if (n > 0 || !withTrailers)
+        {
+            writeFrameHeader(sendBuffer_.beginWrite(),
+                             static_cast<uint32_t>(n),
+                             FrameType::Data,
+                             end && !withTrailers ? flags::kEndStream : 0,
+                             streamId);
+            sendBuffer_.hasWritten(kFrameHeaderLength + n);
+        }
+        connSendWindow_ -= static_cast<int64_t>(n);
+        stream.sendWindow -= static_cast<int64_t>(n);
+        written += n;
+        if (end)
+        {
+            if (withTrailers)
+                appendTrailers(streamId, *stream.response);
+            return true;
+        }
+    }
+    if (written >= kMaxBytesPerRound)
+        waitingForWriteComplete_ = true;
+    return false;
+}
+
+void Http2ServerConnection::flushStreams()
+{
+    if (!waitingForWriteComplete_ && !closed_)
+    {
+        auto count = sendingStreams_.size();
+        while (count-- > 0 && connSendWindow_ > 0 && !waitingForWriteComplete_)
+        {
+            auto streamId = sendingStreams_.front();
+            sendingStreams_.pop_front();
+            auto iter = streams_.find(streamId);
+            if (iter == streams_.end())
+                continue;
+            if (writeStreamData(streamId, iter->second))
+            {
+                closeStream(streamId);
+            }
+            else
+            {
+                sendingStreams_.push_back(streamId);
+            }
+        }
+    }
+    flush();
+}
+
+void Http2ServerConnection::resetStream(uint32_t streamId, ErrorCode code)
+{
+    appendRstStream(sendBuffer_, streamId, code);
+    auto iter = streams_.find(streamId);
+    if (iter != streams_.end())
+    {
+        // Don't send another RST_STREAM in closeStream()
+        iter->second.remoteClosed = true;
+        closeStream(streamId);
+    }
+}
+
+void Http2ServerConnection::appendTrailers(uint32_t streamId,
+                                          const HttpResponse &response)
+{
+    std::string block;
+    for (auto &[name, value] : response.trailers())
+    {
+        encoder_.encode(name, value, block);
+    }
+    appendHeaderBlock(sendBuffer_, streamId, block, true, peerMaxFrameSize_);
+}
+
+void Http2ServerConnection::closeStream(uint32_t streamId)
+{
+    auto iter = streams_.find(streamId);
+    if (iter == streams_.end())
+        return;
+    auto &stream = iter->second;
+    if (!stream.remoteClosed)
+    {
+        // We have responded before the request was complete (rfc7540-8.1)
+        appendRstStream(sendBuffer_, streamId, ErrorCode::NoError);
+    }
+    if (stream.hasDataSource && !stream.lengthKnown && stream.dataSource)
+    {
+        stream.dataSource(nullptr, 0);
+    }
+    // Reset before the response, the handler can stop early.
+    HttpRequestImplPtr cancelled;
+    if (stream.request && !stream.responded)
+        cancelled = std::move(stream.request);
+    streams_.erase(iter);
+    if (cancelled)
+        cancelled->cancel();
+}
+
+void Http2ServerConnection::connectionError(ErrorCode code)
+{
+    LOG_DEBUG << "HTTP/2 connection error: " << static_cast<uint32_t>(code);
+    if (closed_)
+        return;
+    appendGoAway(sendBuffer_, lastStreamId_, code);
+    flush();
+    closed_ = true;
+    if (auto conn = conn_.lock())
+    {
+        conn->shutdown();
+    }
+}
+
+void Http2ServerConnection::flush()
+{
+    if (sendBuffer_.readableBytes() == 0)
+        return;
+    auto conn = conn_.lock();
+    if (conn && conn->connected())
+    {
+        conn->send(sendBuffer_);
+    }
+    sendBuffer_.retrieveAll();
+}
@@ -0,0 +1,162 @@
+/**
+ *
+ *  @file Http2ServerConnection.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include "Hpack.h"
+#include "Http2Frame.h"
+#include "impl_forwards.h"
+#include <drogon/HttpResponse.h>
+#include <trantor/net/TcpConnection.h>
+#include <trantor/utils/MsgBuffer.h>
+#include <trantor/utils/NonCopyable.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief The server side of a HTTP/2 connection (rfc7540). It demultiplexes
+ * the frames received on one TCP connection into HttpRequestImpl objects and
+ * multiplexes the responses back with per-stream and connection-level flow
+ * control. Requests are dispatched through the same advice/middleware chain as
+ * HTTP/1.x requests by HttpServer.
+ *
+ * All methods must be called in the IO loop of the connection.
+ */
+class Http2ServerConnection
+    : public trantor::NonCopyable,
+      public std::enable_shared_from_this<Http2ServerConnection>
+{
+  public:
+    using RequestCallback =
+        std::function<void(const std::shared_ptr<Http2ServerConnection> &,
+                           uint32_t streamId,
+                           const HttpRequestImplPtr &)>;
+
+    Http2ServerConnection(const trantor::TcpConnectionPtr &conn,
+                          RequestCallback callback);
+
+    /**
+     * @brief Send the server connection preface, must be called once right
+     * after the connection is switched to HTTP/2.
+     */
+    void start();
+
+    void onMessage(trantor::MsgBuffer *buf);
+    void onClose();
+
+    /**
+     * @brief Send the response of the stream, the response is dropped if the
+     * stream was reset by the peer in the meantime.
+     */
+    void sendResponse(uint32_t streamId,
+                      const HttpResponsePtr &response,
+                      bool isHeadMethod);
+
+    /// Send a 103 Early Hints response with the link fields, before the
+    /// response of the stream.
+    void sendEarlyHints(uint32_t streamId,
+                        const std::vector<std::string> &links);
+
+    trantor::EventLoop *getLoop() const
+    {
+        return loop_;
+    }
+
+    size_t numberOfStreams() const
+    {
+        return streams_.size();
+    }
+
+    // Used by the async stream adapter in Http2ServerConnection.cc
+    void appendStreamData(uint32_t streamId, std::string &&data, bool end);
+
+  private:
+    // Fills the buffer with up to len bytes, returns the number of bytes
+    // written, 0 means the end of the body.
+    using DataSource = std::function<size_t(char *, size_t)>;
+
+    struct Stream
+    {
+        HttpRequestImplPtr request;
+        HttpResponsePtr response;
+        bool remoteClosed{false};
+        bool responded{false};
+        int64_t sendWindow{http2::kDefaultWindowSize};
+        uint32_t recvUnacked{0};
+        // outgoing body
+        DataSource dataSource;
+        bool hasDataSource{false};
+        // bytes left if the body length is known in advance
+        size_t remainingLength{0};
+        bool lengthKnown{false};
+        // data pushed by async streams
+        std::deque<std::string> pushedData;
+        size_t pushedOffset{0};
+        bool pushEnded{false};
+        bool asyncStream{false};
+    };
+
+    bool handleFrame(const http2::FrameHeader &header, const char *payload);
+    bool handleData(const http2::FrameHeader &header, const char *payload);
+    bool handleHeaders(const http2::FrameHeader &header, const char *payload);
+    bool handleSettings(const http2::FrameHeader &header, const char *payload);
+    bool handleWindowUpdate(const http2::FrameHeader &header,
+                            const char *payload);
+    bool processHeaderBlock();
+    void dispatchRequest(uint32_t streamId, Stream &stream);
+    void respondWithStatus(uint32_t streamId, HttpStatusCode code);
+    void resetStream(uint32_t streamId, http2::ErrorCode code);
+    void connectionError(http2::ErrorCode code);
+    void closeStream(uint32_t streamId);
+    // The trailers end the stream.
+    void appendTrailers(uint32_t streamId, const HttpResponse &response);
+    void flushStreams();
+    // return true if the stream is finished
+    bool writeStreamData(uint32_t streamId, Stream &stream);
+    void flush();
+
+    std::weak_ptr<trantor::TcpConnection> conn_;
+    trantor::EventLoop *loop_;
+    RequestCallback requestCallback_;
+    HpackDecoder decoder_;
+    HpackEncoder encoder_;
+    bool prefaceReceived_{false};
+    bool goAwayReceived_{false};
+    bool closed_{false};
+
+    uint32_t lastStreamId_{0};
+    std::unordered_map<uint32_t, Stream> streams_;
+    // streams which have data waiting for flow control window
+    std::deque<uint32_t> sendingStreams_;
+
+    // Header block being received with CONTINUATION frames
+    uint32_t continuationStreamId_{0};
+    bool continuationEndStream_{false};
+    std::string headerBlock_;
+
+    // peer settings
+    uint32_t peerInitialWindowSize_{http2::kDefaultWindowSize};
+    uint32_t peerMaxFrameSize_{http2::kDefaultMaxFrameSize};
+    int64_t connSendWindow_{http2::kDefaultWindowSize};
+    uint32_t connRecvUnacked_{0};
+
+    trantor::MsgBuffer sendBuffer_;
+    bool waitingForWriteComplete_{false};
+};
+}  // namespace drogon
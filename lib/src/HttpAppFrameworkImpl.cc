@@ -22,10 +22,13 @@
 #include <trantor/utils/AsyncFileLogger.h>
 #include <algorithm>
 #include "AOPAdvice.h"
+#include "BuiltinMetrics.h"
 #include "ConfigLoader.h"
 #include "DbClientManager.h"
+#include "DnsCache.h"
 #include "HttpClientImpl.h"
 #include "HttpConnectionLimit.h"
+#include "MemoryPressure.h"
 #include "HttpControllersRouter.h"
 #include "HttpRequestImpl.h"
 #include "HttpResponseImpl.h"
@@ -37,9 +40,14 @@
 #include "SessionManager.h"
 #include "SharedLibManager.h"
 #include "StaticFileRouter.h"
+#include "WorkStealingThreadPool.h"
 
+#include <cerrno>
+#include <csignal>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
@@ -50,6 +58,10 @@
 #ifndef _WIN32
 #include <sys/wait.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 #define os_access access
 #elif !defined(_WIN32) || defined(__MINGW32__)
 #include <sys/file.h>
@@ -165,6 +177,33 @@ static void godaemon()
     return;
 }
 
+static void pinCurrentThread(size_t cpu)
+{
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    auto err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (err != 0)
+    {
+        LOG_ERROR << "Failed to pin the IO thread to the CPU " << cpu << ": "
+                  << strerror(err);
+    }
+#else
+    (void)cpu;
+    LOG_WARN << "The IO threads can't be pinned to CPUs on this platform";
+#endif
+}
+
+#ifndef _WIN32
+static volatile sig_atomic_t supervisorSignal = 0;
+
+static void supervisorSignalHandler(int sig)
+{
+    supervisorSignal = sig;
+}
+#endif
+
 static void TERMFunction(int sig)
 {
     if (sig == SIGTERM)
@@ -188,6 +227,7 @@ HttpAppFrameworkImpl::~HttpAppFrameworkImpl() noexcept
     sharedLibManagerPtr_.reset();
 #endif
     sessionManagerPtr_.reset();
+    handlerThreadPool_.reset();
 }
 
 HttpAppFramework &HttpAppFrameworkImpl::setStaticFilesCacheTime(int cacheTime)
@@ -201,6 +241,65 @@ int HttpAppFrameworkImpl::staticFilesCacheTime() const
     return StaticFileRouter::instance().staticFilesCacheTime();
 }
 
+HttpAppFramework &HttpAppFrameworkImpl::setStaticFilesCacheMaxSize(
+    size_t maxSize)
+{
+    StaticFileRouter::instance().setStaticFilesCacheCapacity(maxSize);
+    return *this;
+}
+
+size_t HttpAppFrameworkImpl::staticFilesCacheMaxSize() const
+{
+    return StaticFileRouter::instance().staticFilesCacheCapacity();
+}
+
+HttpAppFramework &HttpAppFrameworkImpl::setStaticFileStatCacheTime(
+    double cacheTime)
+{
+    assert(!running_);
+    StaticFileRouter::instance().setFileStatCacheTime(cacheTime);
+    return *this;
+}
+
+void HttpAppFrameworkImpl::updateDefaultCompressionPolicy()
+{
+    auto &encodings = defaultCompressionPolicy_.encodings;
+    encodings.clear();
+    if (useBrotli_)
+        encodings.push_back(CompressionEncoding::kBrotli);
+    if (useGzip_)
+        encodings.push_back(CompressionEncoding::kGzip);
+}
+
+HttpAppFramework &HttpAppFrameworkImpl::setCompressionPolicy(
+    const std::string &pathPrefix,
+    const CompressionPolicy &policy)
+{
+    assert(!running_);
+    auto iter = std::find_if(compressionPolicies_.begin(),
+                             compressionPolicies_.end(),
+                             [&pathPrefix](const auto &item) {
+                                 return item.first.length() <=
+                                        pathPrefix.length();
+                             });
+    if (iter != compressionPolicies_.end() && iter->first == pathPrefix)
+        iter->second = policy;
+    else
+        compressionPolicies_.emplace(iter, pathPrefix, policy);
+    return *this;
+}
+
+const CompressionPolicy &HttpAppFrameworkImpl::compressionPolicy(
+    const std::string &path) const
+{
+    for (auto &item : compressionPolicies_)
+    {
+        if (path.compare(0, item.first.length(), item.first) == 0)
+            return item.second;
+    }
+    return defaultCompressionPolicy_;
+}
+
 HttpAppFramework &HttpAppFrameworkImpl::setGzipStatic(bool useGzipStatic)
 {
     StaticFileRouter::instance().setGzipStatic(useGzipStatic);
@@ -213,6 +312,19 @@ HttpAppFramework &HttpAppFrameworkImpl::setBrStatic(bool useGzipStatic)
     return *this;
 }
 
+HttpAppFramework &HttpAppFrameworkImpl::setMmapStatic(bool useMmapStatic)
+{
+    StaticFileRouter::instance().setMmapStatic(useMmapStatic);
+    return *this;
+}
+
+HttpAppFramework &HttpAppFrameworkImpl::setPrecompressStatic(
+    bool usePrecompressStatic)
+{
+    StaticFileRouter::instance().setPrecompressStatic(usePrecompressStatic);
+    return *this;
+}
+
 HttpAppFramework &HttpAppFrameworkImpl::setImplicitPageEnable(
     bool useImplicitPage)
 {
@@ -345,6 +457,22 @@ void HttpAppFrameworkImpl::registerHttpControllerViaRegex(
         regExp, binder, validMethods, middlewareNames, handlerName);
 }
 
+size_t HttpAppFrameworkImpl::getHandlerThreadNum() const
+{
+    if (handlerThreadNum_ == 0)
+        return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    return handlerThreadNum_;
+}
+
+WorkStealingThreadPool &HttpAppFrameworkImpl::handlerThreadPool()
+{
+    std::call_once(handlerThreadPoolOnce_, [this]() {
+        handlerThreadPool_ =
+            std::make_unique<WorkStealingThreadPool>(getHandlerThreadNum());
+    });
+    return *handlerThreadPool_;
+}
+
 HttpAppFramework &HttpAppFrameworkImpl::setThreadNum(size_t threadNum)
 {
     if (threadNum == 0)
@@ -412,6 +540,14 @@ HttpAppFramework &HttpAppFrameworkImpl::addListener(
     return *this;
 }
 
+HttpAppFramework &HttpAppFrameworkImpl::addUnixListener(const std::string &path,
+                                                        int mode)
+{
+    assert(!running_);
+    listenerManagerPtr_->addUnixListener(path, mode);
+    return *this;
+}
+
 HttpAppFramework &HttpAppFrameworkImpl::setMaxConnectionNum(
     size_t maxConnections)
 {
@@ -427,12 +563,20 @@ HttpAppFramework &HttpAppFrameworkImpl::setMaxConnectionNumPerIP(
     return *this;
 }
 
+HttpAppFramework &HttpAppFrameworkImpl::setMemorySoftLimit(size_t limit)
+{
+    assert(!running_);
+    MemoryPressure::instance().setSoftLimit(limit);
+    return *this;
+}
+
 HttpAppFramework &HttpAppFrameworkImpl::loadConfigFile(
     const std::string &fileName)
 {
     ConfigLoader loader(fileName);
     loader.load();
     jsonConfig_ = loader.jsonValue();
+    configFile_ = fileName;
     return *this;
 }
 
@@ -452,6 +596,89 @@ HttpAppFramework &HttpAppFrameworkImpl::loadConfigJson(Json::Value &&data)
     return *this;
 }
 
+HttpAppFramework &HttpAppFrameworkImpl::setForwardPoolOptions(
+    size_t connectionsPerHost,
+    double idleTimeout)
+{
+    assert(!running_);
+    forwardConnectionsPerHost_ = connectionsPerHost;
+    forwardIdleTimeout_ = idleTimeout;
+    return *this;
+}
+
+HttpAppFramework &HttpAppFrameworkImpl::enableConfigReload(
+    double checkInterval)
+{
+    assert(!running_);
+    configReloadInterval_ = checkInterval;
+    return *this;
+}
+
+HttpAppFramework &HttpAppFrameworkImpl::registerConfigReloadCallback(
+    const std::function<void(const Json::Value &)> &callback)
+{
+    configReloadCallbacks_.push_back(callback);
+    return *this;
+}
+
+void HttpAppFrameworkImpl::reloadConfig()
+{
+    getLoop()->runInLoop([this]() { reloadConfigInLoop(); });
+}
+
+void HttpAppFrameworkImpl::reloadConfigInLoop()
+{
+    if (configFile_.empty())
+    {
+        LOG_WARN << "No configuration file to reload";
+        return;
+    }
+    try
+    {
+        ConfigLoader loader(configFile_);
+        loader.reload();
+        LOG_INFO << "The configuration file " << configFile_
+                 << " is reloaded";
+        for (auto &callback : configReloadCallbacks_)
+        {
+            callback(loader.jsonValue());
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR << "Failed to reload the configuration, the current one is "
+                     "kept: "
+                  << e.what();
+    }
+}
+
+void HttpAppFrameworkImpl::watchConfigFile()
+{
+    if (configReloadInterval_ <= 0)
+        return;
+    if (configFile_.empty())
+    {
+        LOG_WARN << "The configuration isn't loaded from a file, it can't be "
+                    "reloaded";
+        return;
+    }
+    auto path = utils::toNativePath(configFile_);
+    std::error_code err;
+    auto lastWriteTime = std::filesystem::last_write_time(path, err);
+    getLoop()->runEvery(
+        configReloadInterval_,
+        [this, path = std::move(path), lastWriteTime]() mutable {
+            // An editor may replace the file, so it may be missing for a
+            // moment.
+            std::error_code err;
+            auto writeTime = std::filesystem::last_write_time(path, err);
+            if (err || writeTime == lastWriteTime)
+                return;
+            lastWriteTime = writeTime;
+            reloadConfigInLoop();
+        });
+}
+
 HttpAppFramework &HttpAppFrameworkImpl::setLogPath(
     const std::string &logPath,
     const std::string &logfileBaseName,
@@ -569,6 +796,24 @@ void HttpAppFrameworkImpl::run()
         getLoop()->resetTimerQueue();
 #endif
         getLoop()->resetAfterFork();
+#endif
+    }
+    if (workerProcessNum_ > 1)
+    {
+#ifndef _WIN32
+        if (!forkWorkers())
+            return;
+#ifdef __linux__
+        getLoop()->resetTimerQueue();
+#endif
+        getLoop()->resetAfterFork();
+        // The workers listen on the same ports.
+        reusePort_ = true;
+        if (logfileBaseName_.empty())
+            logfileBaseName_ = "drogon";
+        logfileBaseName_ += "_" + std::to_string(workerIndex_);
+#else
+        LOG_ERROR << "The worker processes aren't supported on Windows";
 #endif
     }
     if (handleSigterm_)
@@ -613,9 +858,26 @@ void HttpAppFrameworkImpl::run()
         std::make_unique<trantor::EventLoopThreadPool>(threadNum_,
                                                        "DrogonIoLoop");
     std::vector<trantor::EventLoop *> ioLoops = ioLoopThreadPool_->getLoops();
+    if (ioLoopCpus_.empty() &&
+        connectionBalancing_ == ConnectionBalancing::kLocalCpu)
+    {
+        // The connections are steered to the loops by the CPU which received
+        // them, the loops need CPUs of their own.
+        size_t cpuNum = (std::max)(std::thread::hardware_concurrency(), 1u);
+        for (size_t i = 0; i < threadNum_; ++i)
+        {
+            ioLoopCpus_.push_back(i % cpuNum);
+        }
+    }
     for (size_t i = 0; i < threadNum_; ++i)
     {
         ioLoops[i]->setIndex(i);
+        if (!ioLoopCpus_.empty())
+        {
+            // Queued first, so the loop allocates its data once pinned.
+            auto cpu = ioLoopCpus_[i % ioLoopCpus_.size()];
+            ioLoops[i]->queueInLoop([cpu]() { pinCurrentThread(cpu); });
+        }
     }
     getLoop()->setIndex(threadNum_);
 
@@ -637,7 +899,10 @@ void HttpAppFrameworkImpl::run()
                                              sessionTimeout_,
                                              sessionStartAdvices_,
                                              sessionDestroyAdvices_,
-                                             sessionIdGeneratorCallback_);
+                                             sessionIdGeneratorCallback_,
+                                             sessionStore_,
+                                             sessionLocalCacheTimeout_,
+                                             sessionWriteBehindInterval_);
     }
     // now start running!!
     running_ = true;
@@ -671,14 +936,14 @@ void HttpAppFrameworkImpl::run()
     routersInit_ = true;
     HttpControllersRouter::instance().init(ioLoops);
     StaticFileRouter::instance().init(ioLoops);
+    watchConfigFile();
     getLoop()->queueInLoop([this]() {
         for (auto &adv : beginningAdvices_)
         {
             adv();
         }
         beginningAdvices_.clear();
-        // Let listener event loops run when everything is ready.
-        listenerManagerPtr_->startListening();
+        runWarmupTasks();
     });
     // start all loops
     // TODO: when should IOLoops start?
@@ -689,6 +954,90 @@ void HttpAppFrameworkImpl::run()
     getLoop()->loop();
 }
 
+bool HttpAppFrameworkImpl::forkWorkers()
+{
+#ifndef _WIN32
+    std::vector<pid_t> workers(workerProcessNum_, 0);
+    auto spawn = [this, &workers](size_t index) {
+        auto pid = fork();
+        if (pid < 0)
+        {
+            LOG_ERROR << "fork error";
+            abort();
+        }
+        if (pid == 0)
+        {
+            workerIndex_ = index;
+            signal(SIGTERM, SIG_DFL);
+            signal(SIGINT, SIG_DFL);
+            return true;
+        }
+        workers[index] = pid;
+        return false;
+    };
+
+    // Without SA_RESTART, so the sleeps are woken up by the signals.
+    struct sigaction sa;
+    sa.sa_handler = supervisorSignalHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        if (spawn(i))
+            return true;
+    }
+    LOG_INFO << "Started " << workers.size() << " worker processes";
+
+    size_t alive = workers.size();
+    bool forwarded = false;
+    while (alive > 0)
+    {
+        if (supervisorSignal != 0 && !forwarded)
+        {
+            LOG_INFO << "Stopping the worker processes";
+            for (auto pid : workers)
+            {
+                if (pid > 0)
+                    kill(pid, supervisorSignal);
+            }
+            forwarded = true;
+        }
+        int status = 0;
+        auto pid = waitpid(-1, &status, WNOHANG);
+        if (pid == 0 || (pid < 0 && errno == EINTR))
+        {
+            usleep(100000);
+            continue;
+        }
+        if (pid < 0)
+        {
+            LOG_SYSERR << "waitpid";
+            break;
+        }
+        auto iter = std::find(workers.begin(), workers.end(), pid);
+        if (iter == workers.end())
+            continue;
+        *iter = 0;
+        --alive;
+        // The workers which quit normally are not restarted.
+        if (supervisorSignal != 0 ||
+            (WIFEXITED(status) && WEXITSTATUS(status) == 0))
+        {
+            continue;
+        }
+        LOG_ERROR << "The worker process " << pid << " exited abnormally";
+        sleep(1);
+        LOG_INFO << "start new worker process";
+        if (spawn(static_cast<size_t>(iter - workers.begin())))
+            return true;
+        ++alive;
+    }
+#endif
+    return false;
+}
+
 HttpAppFramework &HttpAppFrameworkImpl::setUploadPath(
     const std::string &uploadPath)
 {
@@ -704,20 +1053,55 @@ HttpAppFramework &HttpAppFrameworkImpl::setUploadPath(
     return *this;
 }
 
-void HttpAppFrameworkImpl::findSessionForRequest(const HttpRequestImplPtr &req)
+bool HttpAppFrameworkImpl::findSessionForRequest(const HttpRequestImplPtr &req)
 {
-    if (useSession_)
+    if (!useSession_)
+        return true;
+    // The session is already loaded from the session store
+    if (req->resolvedSession())
+        return true;
+    if (lazySession_ && (!sessionManagerPtr_->hasStore() ||
+                         req->getCookie(sessionCookieKey_).empty()))
     {
-        std::string sessionId = req->getCookie(sessionCookieKey_);
-        bool needSetSessionid = false;
-        if (sessionId.empty())
-        {
-            sessionId = sessionIdGeneratorCallback_();
-            needSetSessionid = true;
-        }
-        req->setSession(
-            sessionManagerPtr_->getSession(sessionId, needSetSessionid));
+        req->setSessionPending();
+        return true;
     }
+    auto sessionPtr = resolveSessionForRequest(*req);
+    if (!sessionPtr)
+        return false;
+    // The session found in the local cache is only used if it's accessed,
+    // the ones not cached are loaded from the store before routing since
+    // session() can't wait for the store.
+    if (lazySession_)
+        req->setSessionPending(std::move(sessionPtr));
+    else
+        req->setSession(sessionPtr);
+    return true;
+}
+
+SessionPtr HttpAppFrameworkImpl::resolveSessionForRequest(
+    const HttpRequestImpl &req)
+{
+    std::string sessionId = req.getCookie(sessionCookieKey_);
+    bool needSetSessionid = false;
+    if (sessionId.empty())
+    {
+        sessionId = sessionIdGeneratorCallback_();
+        needSetSessionid = true;
+    }
+    return sessionManagerPtr_->findSession(sessionId, needSetSessionid);
+}
+
+void HttpAppFrameworkImpl::loadSessionForRequest(
+    const HttpRequestImplPtr &req,
+    std::function<void()> &&callback)
+{
+    sessionManagerPtr_->loadSession(
+        req->getCookie(sessionCookieKey_),
+        [req, callback = std::move(callback)](const SessionPtr &sessionPtr) {
+            req->setSession(sessionPtr);
+            callback();
+        });
 }
 
 std::vector<HttpHandlerInfo> HttpAppFrameworkImpl::getHandlersInfo() const
@@ -731,11 +1115,13 @@ HttpResponsePtr HttpAppFrameworkImpl::handleSessionForResponse(
 {
     if (useSession_)
     {
-        auto &sessionPtr = req->getSession();
+        // Sessions never accessed by lazy loading are left untouched
+        auto &sessionPtr = req->resolvedSession();
         if (!sessionPtr)
         {
             return resp;
         }
+        sessionManagerPtr_->sessionAccessed(sessionPtr);
         if (sessionPtr->needToChangeSessionId())
         {
             sessionManagerPtr_->changeSessionId(sessionPtr);
@@ -747,12 +1133,8 @@ HttpResponsePtr HttpAppFrameworkImpl::handleSessionForResponse(
                 auto newResp = std::make_shared<HttpResponseImpl>(
                     *static_cast<HttpResponseImpl *>(resp.get()));
                 newResp->setExpiredTime(-1);  // make it temporary
-                auto sessionid =
-                    Cookie(sessionCookieKey_, sessionPtr->sessionId());
-                sessionid.setPath("/");
-                sessionid.setSameSite(sessionSameSite_);
-                if (sessionMaxAge_ >= 0)
-                    sessionid.setMaxAge(sessionMaxAge_);
+                auto sessionid = sessionCookie_;
+                sessionid.setValue(sessionPtr->sessionId());
                 newResp->addCookie(std::move(sessionid));
                 sessionPtr->hasSet();
 
@@ -760,12 +1142,8 @@ HttpResponsePtr HttpAppFrameworkImpl::handleSessionForResponse(
             }
             else
             {
-                auto sessionid =
-                    Cookie(sessionCookieKey_, sessionPtr->sessionId());
-                sessionid.setPath("/");
-                sessionid.setSameSite(sessionSameSite_);
-                if (sessionMaxAge_ >= 0)
-                    sessionid.setMaxAge(sessionMaxAge_);
+                auto sessionid = sessionCookie_;
+                sessionid.setValue(sessionPtr->sessionId());
                 resp->addCookie(std::move(sessionid));
                 sessionPtr->hasSet();
 
@@ -856,29 +1234,24 @@ void HttpAppFrameworkImpl::forward(
     }
     else
     {
-        /// A tiny implementation of a reverse proxy.
-        static std::unordered_map<std::string, HttpClientImplPtr> clientsMap;
-        HttpClientImplPtr clientPtr;
-        static std::mutex mtx;
+        /// A tiny implementation of a reverse proxy, the requests are sent
+        /// over the keep-alive connections of the IO loop handling them.
+        HttpClientPoolPtr pool;
         {
-            std::lock_guard<std::mutex> lock(mtx);
-            auto iter = clientsMap.find(hostString);
-            if (iter != clientsMap.end())
-            {
-                clientPtr = iter->second;
-            }
-            else
+            std::lock_guard<std::mutex> lock(forwardPoolsMutex_);
+            auto &poolRef = forwardPools_[hostString];
+            if (!poolRef)
             {
-                clientPtr = std::make_shared<HttpClientImpl>(
-                    trantor::EventLoop::getEventLoopOfCurrentThread()
-                        ? trantor::EventLoop::getEventLoopOfCurrentThread()
-                        : getLoop(),
-                    hostString);
-                clientsMap[hostString] = clientPtr;
+                HttpClientPoolConfig config;
+                config.hosts.push_back(hostString);
+                config.connectionsPerHost = forwardConnectionsPerHost_;
+                config.idleTimeout = forwardIdleTimeout_;
+                poolRef = HttpClientPool::newHttpClientPool(config);
             }
+            pool = poolRef;
         }
         req->setPassThrough(true);
-        clientPtr->sendRequest(
+        pool->sendRequest(
             req,
             [callback = std::move(callback), req](ReqResult result,
                                                   const HttpResponsePtr &resp) {
@@ -966,7 +1339,16 @@ void HttpAppFrameworkImpl::addDbClient(
     const std::string &characterSet,
     double timeout,
     bool autoBatch,
-    std::unordered_map<std::string, std::string> options)
+    std::unordered_map<std::string, std::string> options,
+    bool binaryResults,
+    size_t maxPreparedStatements,
+    unsigned int prepareThreshold,
+    std::vector<orm::ReplicaConfig> replicas,
+    double maxReplicaLag,
+    size_t maxConnectionNum,
+    double idleConnectionTimeout,
+    bool preparedStatements,
+    std::vector<std::string> warmupStatements)
 {
     if (dbType == "postgresql" || dbType == "postgres")
     {
@@ -981,7 +1363,15 @@ void HttpAppFrameworkImpl::addDbClient(
                                         characterSet,
                                         timeout,
                                         autoBatch,
-                                        std::move(options)});
+                                        std::move(options),
+                                        binaryResults,
+                                        maxPreparedStatements,
+                                        prepareThreshold,
+                                        std::move(replicas),
+                                        maxReplicaLag,
+                                        maxConnectionNum,
+                                        idleConnectionTimeout,
+                                        std::move(warmupStatements)});
     }
     else if (dbType == "mysql")
     {
@@ -994,11 +1384,21 @@ void HttpAppFrameworkImpl::addDbClient(
                                      name,
                                      isFast,
                                      characterSet,
-                                     timeout});
+                                     timeout,
+                                     std::move(replicas),
+                                     maxReplicaLag,
+                                     maxConnectionNum,
+                                     idleConnectionTimeout,
+                                     autoBatch,
+                                     preparedStatements,
+                                     maxPreparedStatements,
+                                     prepareThreshold,
+                                     std::move(warmupStatements)});
     }
     else if (dbType == "sqlite3")
     {
-        addDbClient(orm::Sqlite3Config{connectionNum, filename, name, timeout});
+        addDbClient(
+            orm::Sqlite3Config{connectionNum, filename, name, timeout});
     }
     else
     {
@@ -1031,29 +1431,93 @@ HttpAppFramework &HttpAppFrameworkImpl::createRedisClient(
     return *this;
 }
 
+void HttpAppFrameworkImpl::runWarmupTasks()
+{
+    if (warmupTasks_.empty())
+    {
+        // Let listener event loops run when everything is ready.
+        listenerManagerPtr_->startListening();
+        return;
+    }
+    LOG_INFO << "Running " << warmupTasks_.size() << " warmup tasks";
+    auto remaining = std::make_shared<size_t>(warmupTasks_.size());
+    auto tasks = std::move(warmupTasks_);
+    warmupTasks_.clear();
+    for (auto &task : tasks)
+    {
+        task([this, remaining]() {
+            getLoop()->runInLoop([this, remaining]() {
+                if (--*remaining > 0 || !running_)
+                    return;
+                LOG_INFO << "Warmup done, start listening";
+                listenerManagerPtr_->startListening();
+            });
+        });
+    }
+}
+
 void HttpAppFrameworkImpl::quit()
 {
     if (getLoop()->isRunning() && running_.exchange(false))
     {
         getLoop()->queueInLoop([this]() {
-            // Release members in the reverse order of initialization
-            listenerManagerPtr_->stopListening();
-            listenerManagerPtr_.reset();
-            StaticFileRouter::instance().reset();
-            HttpControllersRouter::instance().reset();
-            pluginsManagerPtr_.reset();
-            redisClientManagerPtr_.reset();
-            dbClientManagerPtr_.reset();
-            getLoop()->quit();
-            for (trantor::EventLoop *loop : ioLoopThreadPool_->getLoops())
+            if (gracefulShutdownTimeout_ <= 0.0)
             {
-                loop->quit();
+                stopAll();
+                return;
             }
-            ioLoopThreadPool_->wait();
+            LOG_INFO << "Draining " << getConnectionCount()
+                     << " connections before quitting";
+            draining_ = true;
+            waitForConnections(
+                trantor::Date::now().after(gracefulShutdownTimeout_));
         });
     }
 }
 
+void HttpAppFrameworkImpl::waitForConnections(const trantor::Date &deadline)
+{
+    if (getConnectionCount() == 0)
+    {
+        stopAll();
+        return;
+    }
+    if (trantor::Date::now() >= deadline)
+    {
+        LOG_WARN << getConnectionCount()
+                 << " connections are closed by the graceful shutdown timeout";
+        stopAll();
+        return;
+    }
+    getLoop()->runAfter(0.1,
+                        [this, deadline]() { waitForConnections(deadline); });
+}
+
+void HttpAppFrameworkImpl::stopAll()
+{
+    // Release members in the reverse order of initialization
+    listenerManagerPtr_->stopListening();
+    listenerManagerPtr_.reset();
+    StaticFileRouter::instance().reset();
+    HttpControllersRouter::instance().reset();
+    pluginsManagerPtr_.reset();
+    if (sessionManagerPtr_ && sessionManagerPtr_->hasStore())
+        sessionManagerPtr_->flush();
+    redisClientManagerPtr_.reset();
+    dbClientManagerPtr_.reset();
+    {
+        std::lock_guard<std::mutex> lock(forwardPoolsMutex_);
+        forwardPools_.clear();
+    }
+    getLoop()->quit();
+    for (trantor::EventLoop *loop : ioLoopThreadPool_->getLoops())
+    {
+        loop->quit();
+    }
+    ioLoopThreadPool_->wait();
+    draining_ = false;
+}
+
 const HttpResponsePtr &HttpAppFrameworkImpl::getCustom404Page()
 {
     if (!custom404_)
@@ -1071,6 +1535,8 @@ const HttpResponsePtr &HttpAppFrameworkImpl::getCustom404Page()
                 [this](HttpResponsePtr &resp, size_t /*index*/) {
                     resp = std::make_shared<HttpResponseImpl>(
                         *static_cast<HttpResponseImpl *>(custom404_.get()));
+                    // Rendered once for each thread
+                    resp->setImmutable();
                 });
         });
         return thread404Pages.getThreadData();
@@ -1112,6 +1578,16 @@ bool HttpAppFrameworkImpl::areAllDbClientsAvailable() const noexcept
     return dbClientManagerPtr_->areAllDbClientsAvailable();
 }
 
+std::vector<std::string> HttpAppFrameworkImpl::getDbClientNames() const
+{
+    return dbClientManagerPtr_->dbClientNames();
+}
+
+std::vector<std::string> HttpAppFrameworkImpl::getRedisClientNames() const
+{
+    return redisClientManagerPtr_->redisClientNames();
+}
+
 HttpAppFramework &HttpAppFrameworkImpl::setCustomErrorHandler(
     std::function<HttpResponsePtr(HttpStatusCode, const HttpRequestPtr &req)>
         &&resp_generator)
@@ -1262,6 +1738,39 @@ bool HttpAppFrameworkImpl::isRequestStreamEnabled() const
     return enableRequestStream_;
 }
 
+HttpAppFramework &HttpAppFrameworkImpl::setDnsCacheTtl(double ttl)
+{
+    internal::DnsCache::instance().setTtl(ttl);
+    return *this;
+}
+
+double HttpAppFrameworkImpl::getDnsCacheTtl() const
+{
+    return internal::DnsCache::instance().ttl();
+}
+
+HttpAppFramework &HttpAppFrameworkImpl::setSlowQueryThreshold(double threshold)
+{
+    BuiltinMetrics::instance().slowQueryThreshold = threshold;
+    return *this;
+}
+
+double HttpAppFrameworkImpl::getSlowQueryThreshold() const
+{
+    return BuiltinMetrics::instance().slowQueryThreshold;
+}
+
+HttpAppFramework &HttpAppFrameworkImpl::enableOutputCorking(bool enable)
+{
+    outputCorking_ = enable;
+    return *this;
+}
+
+bool HttpAppFrameworkImpl::isOutputCorkingEnabled() const
+{
+    return outputCorking_;
+}
+
 // AOP registration methods
 
 HttpAppFramework &HttpAppFrameworkImpl::registerNewConnectionAdvice(
@@ -1367,6 +1876,15 @@ HttpAppFramework &HttpAppFrameworkImpl::setAfterAcceptSockOptCallback(
     return *this;
 }
 
+HttpAppFramework &HttpAppFrameworkImpl::enableLowLatency(
+    uint16_t port,
+    size_t busyPollMicroseconds)
+{
+    assert(!running_);
+    listenerManagerPtr_->enableLowLatency(port, busyPollMicroseconds);
+    return *this;
+}
+
 HttpAppFramework &HttpAppFrameworkImpl::setConnectionCallback(
     std::function<void(const trantor::TcpConnectionPtr &)> cb)
 {
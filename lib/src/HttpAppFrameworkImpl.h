@@ -15,11 +15,15 @@
 #pragma once
 
 #include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClientPool.h>
 #include <drogon/config.h>
 #include <json/json.h>
+#include <algorithm>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "SessionManager.h"
 #include "drogon/utils/Utilities.h"
@@ -72,6 +76,8 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         bool useOldTLS,
         const std::vector<std::pair<std::string, std::string>> &sslConfCmds)
         override;
+    HttpAppFramework &addUnixListener(const std::string &path,
+                                      int mode) override;
     HttpAppFramework &setThreadNum(size_t threadNum) override;
 
     size_t getThreadNum() const override
@@ -79,6 +85,18 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return threadNum_;
     }
 
+    HttpAppFramework &setHandlerThreadNum(size_t threadNum) override
+    {
+        assert(!running_);
+        handlerThreadNum_ = threadNum;
+        return *this;
+    }
+
+    size_t getHandlerThreadNum() const override;
+
+    // The pool running the offloaded handlers, started on the first use.
+    WorkStealingThreadPool &handlerThreadPool();
+
     HttpAppFramework &setSSLConfigCommands(
         const std::vector<std::pair<std::string, std::string>> &sslConfCmds)
         override;
@@ -136,6 +154,14 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return *this;
     }
 
+    HttpAppFramework &registerWarmupTask(
+        const std::function<void(std::function<void()> &&done)> &task)
+        override
+    {
+        warmupTasks_.emplace_back(task);
+        return *this;
+    }
+
     HttpAppFramework &registerNewConnectionAdvice(
         const std::function<bool(const trantor::InetAddress &,
                                  const trantor::InetAddress &)> &advice)
@@ -194,9 +220,15 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     {
         useSession_ = true;
         sessionTimeout_ = timeout;
-        sessionSameSite_ = sameSite;
         sessionCookieKey_ = cookieKey;
-        sessionMaxAge_ = maxAge;
+        // Only the value of the session cookie changes, its attributes are
+        // serialized once.
+        sessionCookie_ = Cookie(cookieKey, "");
+        sessionCookie_.setPath("/");
+        sessionCookie_.setSameSite(sameSite);
+        if (maxAge >= 0)
+            sessionCookie_.setMaxAge(maxAge);
+        sessionCookie_.freezeAttributes();
         return setSessionIdGenerator(idGeneratorCallback);
     }
 
@@ -205,7 +237,7 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     {
         sessionIdGeneratorCallback_ =
             idGeneratorCallback ? idGeneratorCallback
-                                : []() { return utils::getUuid(true); };
+                                : []() { return utils::getUuidV4(true); };
         return *this;
     }
 
@@ -215,6 +247,23 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return *this;
     }
 
+    HttpAppFramework &enableLazySession(bool enable) override
+    {
+        lazySession_ = enable;
+        return *this;
+    }
+
+    HttpAppFramework &setSessionStore(SessionStorePtr store,
+                                      size_t localCacheTimeout,
+                                      double writeBehindInterval) override
+    {
+        assert(!running_);
+        sessionStore_ = std::move(store);
+        sessionLocalCacheTimeout_ = localCacheTimeout;
+        sessionWriteBehindInterval_ = writeBehindInterval;
+        return *this;
+    }
+
     HttpAppFramework &registerSessionStartAdvice(
         const AdviceStartSessionCallback &advice) override
     {
@@ -275,12 +324,19 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     HttpAppFramework &setMaxConnectionNum(size_t maxConnections) override;
     HttpAppFramework &setMaxConnectionNumPerIP(
         size_t maxConnectionsPerIP) override;
+    HttpAppFramework &setMemorySoftLimit(size_t limit) override;
     HttpAppFramework &loadConfigFile(const std::string &fileName) noexcept(
         false) override;
     HttpAppFramework &loadConfigJson(const Json::Value &data) noexcept(
         false) override;
     HttpAppFramework &loadConfigJson(Json::Value &&data) noexcept(
         false) override;
+    HttpAppFramework &setForwardPoolOptions(size_t connectionsPerHost,
+                                            double idleTimeout) override;
+    HttpAppFramework &enableConfigReload(double checkInterval) override;
+    void reloadConfig() override;
+    HttpAppFramework &registerConfigReloadCallback(
+        const std::function<void(const Json::Value &)> &callback) override;
 
     HttpAppFramework &enableRunAsDaemon() override
     {
@@ -300,6 +356,23 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return *this;
     }
 
+    HttpAppFramework &setWorkerProcessNum(size_t num) override
+    {
+        assert(!running_);
+        workerProcessNum_ = num;
+        return *this;
+    }
+
+    size_t getWorkerProcessNum() const override
+    {
+        return workerProcessNum_;
+    }
+
+    size_t getWorkerIndex() const override
+    {
+        return workerIndex_;
+    }
+
     HttpAppFramework &setLogPath(const std::string &logPath,
                                  const std::string &logfileBaseName,
                                  size_t logfileSize,
@@ -317,6 +390,7 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     HttpAppFramework &enableGzip(bool useGzip) override
     {
         useGzip_ = useGzip;
+        updateDefaultCompressionPolicy();
         return *this;
     }
 
@@ -328,6 +402,7 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     HttpAppFramework &enableBrotli(bool useBrotli) override
     {
         useBrotli_ = useBrotli;
+        updateDefaultCompressionPolicy();
         return *this;
     }
 
@@ -336,8 +411,40 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return useBrotli_;
     }
 
+    HttpAppFramework &setCompressionPolicy(
+        const std::string &pathPrefix,
+        const CompressionPolicy &policy) override;
+
+    /// Return the policy of the longest prefix of the path
+    const CompressionPolicy &compressionPolicy(const std::string &path) const;
+
+    HttpAppFramework &enableHttp2(bool enable) override
+    {
+        useHttp2_ = enable;
+        return *this;
+    }
+
+    bool isHttp2Enabled() const override
+    {
+        return useHttp2_;
+    }
+
+    HttpAppFramework &enableZeroCopyHeaders(bool enable) override
+    {
+        zeroCopyHeaders_ = enable;
+        return *this;
+    }
+
+    bool isZeroCopyHeadersEnabled() const override
+    {
+        return zeroCopyHeaders_;
+    }
+
     HttpAppFramework &setStaticFilesCacheTime(int cacheTime) override;
     int staticFilesCacheTime() const override;
+    HttpAppFramework &setStaticFilesCacheMaxSize(size_t maxSize) override;
+    size_t staticFilesCacheMaxSize() const override;
+    HttpAppFramework &setStaticFileStatCacheTime(double cacheTime) override;
 
     HttpAppFramework &setIdleConnectionTimeout(size_t timeout) override
     {
@@ -350,6 +457,40 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return idleConnectionTimeout_;
     }
 
+    HttpAppFramework &setIdleMemoryTrimTimeout(size_t timeout) override
+    {
+        idleMemoryTrimTimeout_ = timeout;
+        return *this;
+    }
+
+    size_t getIdleMemoryTrimTimeout() const override
+    {
+        return idleMemoryTrimTimeout_;
+    }
+
+    HttpAppFramework &setRequestDeadline(double timeout,
+                                         const std::string &header) override
+    {
+        assert(!running_);
+        requestDeadline_ = timeout;
+        requestDeadlineHeader_ = header;
+        std::transform(requestDeadlineHeader_.begin(),
+                       requestDeadlineHeader_.end(),
+                       requestDeadlineHeader_.begin(),
+                       [](unsigned char c) { return tolower(c); });
+        return *this;
+    }
+
+    double getRequestDeadline() const override
+    {
+        return requestDeadline_;
+    }
+
+    const std::string &getRequestDeadlineHeader() const override
+    {
+        return requestDeadlineHeader_;
+    }
+
     HttpAppFramework &setKeepaliveRequestsNumber(const size_t number) override
     {
         keepaliveRequestsNumber_ = number;
@@ -364,6 +505,8 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
 
     HttpAppFramework &setGzipStatic(bool useGzipStatic) override;
     HttpAppFramework &setBrStatic(bool useGzipStatic) override;
+    HttpAppFramework &setMmapStatic(bool useMmapStatic) override;
+    HttpAppFramework &setPrecompressStatic(bool usePrecompressStatic) override;
 
     HttpAppFramework &setClientMaxBodySize(size_t maxSize) override
     {
@@ -383,6 +526,17 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return *this;
     }
 
+    HttpAppFramework &enableWebSocketCompression(bool enable) override
+    {
+        webSocketCompression_ = enable;
+        return *this;
+    }
+
+    bool isWebSocketCompressionEnabled() const override
+    {
+        return webSocketCompression_;
+    }
+
     HttpAppFramework &setHomePage(const std::string &homePageFile) override
     {
         homePageFile_ = homePageFile;
@@ -494,12 +648,41 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return floatPrecisionInJson_;
     }
 
+    HttpAppFramework &setJsonEngine(JsonEnginePtr engine) override
+    {
+        assert(!running_);
+        assert(engine);
+        jsonEngine_ = std::move(engine);
+        return *this;
+    }
+
+    const JsonEnginePtr &getJsonEngine() const noexcept override
+    {
+        return jsonEngine_;
+    }
+
     trantor::EventLoop *getLoop() const override;
 
     trantor::EventLoop *getIOLoop(size_t id) const override;
 
     void quit() override;
 
+    HttpAppFramework &setGracefulShutdownTimeout(double timeout) override
+    {
+        gracefulShutdownTimeout_ = timeout;
+        return *this;
+    }
+
+    double getGracefulShutdownTimeout() const override
+    {
+        return gracefulShutdownTimeout_;
+    }
+
+    bool isDraining() const override
+    {
+        return draining_;
+    }
+
     HttpAppFramework &setServerHeaderField(const std::string &server) override
     {
         assert(!running_);
@@ -508,6 +691,19 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return *this;
     }
 
+    HttpAppFramework &setAltSvcHeaderField(const std::string &altSvc) override
+    {
+        assert(!running_);
+        assert(altSvc.find("\r\n") == std::string::npos);
+        altSvc_ = altSvc;
+        return *this;
+    }
+
+    const std::string &getAltSvcHeaderField() const
+    {
+        return altSvc_;
+    }
+
     HttpAppFramework &enableServerHeader(bool flag) override
     {
         enableServerHeader_ = flag;
@@ -565,7 +761,16 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
                      const std::string &characterSet,
                      double timeout,
                      bool autoBatch,
-                     std::unordered_map<std::string, std::string> options);
+                     std::unordered_map<std::string, std::string> options,
+                     bool binaryResults = false,
+                     size_t maxPreparedStatements = 0,
+                     unsigned int prepareThreshold = 1,
+                     std::vector<orm::ReplicaConfig> replicas = {},
+                     double maxReplicaLag = -1.0,
+                     size_t maxConnectionNum = 0,
+                     double idleConnectionTimeout = 60.0,
+                     bool preparedStatements = false,
+                     std::vector<std::string> warmupStatements = {});
     HttpAppFramework &addDbClient(const orm::DbConfig &config) override;
 
     HttpAppFramework &createRedisClient(const std::string &ip,
@@ -608,6 +813,10 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     }
 
     bool areAllDbClientsAvailable() const noexcept override;
+
+    std::vector<std::string> getDbClientNames() const;
+    std::vector<std::string> getRedisClientNames() const;
+
     const std::function<HttpResponsePtr(HttpStatusCode,
                                         const HttpRequestPtr &req)> &
     getCustomErrorHandler() const override;
@@ -627,6 +836,42 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return reusePort_;
     }
 
+    HttpAppFramework &enableTlsSessionSharing(bool enable) override
+    {
+        tlsSessionSharing_ = enable;
+        return *this;
+    }
+
+    bool isTlsSessionSharingEnabled() const override
+    {
+        return tlsSessionSharing_;
+    }
+
+    HttpAppFramework &setConnectionBalancing(
+        ConnectionBalancing balancing) override
+    {
+        assert(!running_);
+        connectionBalancing_ = balancing;
+        return *this;
+    }
+
+    ConnectionBalancing getConnectionBalancing() const override
+    {
+        return connectionBalancing_;
+    }
+
+    HttpAppFramework &setIoLoopCpus(const std::vector<size_t> &cpus) override
+    {
+        assert(!running_);
+        ioLoopCpus_ = cpus;
+        return *this;
+    }
+
+    const std::vector<size_t> &getIoLoopCpus() const override
+    {
+        return ioLoopCpus_;
+    }
+
     HttpAppFramework &setExceptionHandler(ExceptionHandler handler) override
     {
         exceptionHandler_ = std::move(handler);
@@ -649,6 +894,17 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         return enableCompressedRequest_;
     }
 
+    HttpAppFramework &enableDynamicETag(bool enable) override
+    {
+        enableDynamicETag_ = enable;
+        return *this;
+    }
+
+    bool isDynamicETagEnabled() const override
+    {
+        return enableDynamicETag_;
+    }
+
     HttpAppFramework &registerCustomExtensionMime(
         const std::string &ext,
         const std::string &mime) override;
@@ -657,7 +913,12 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     int64_t getConnectionCount() const override;
 
     // TODO: move session related codes to its own singleton class
-    void findSessionForRequest(const HttpRequestImplPtr &req);
+    // Return false if the session must be loaded by loadSessionForRequest()
+    bool findSessionForRequest(const HttpRequestImplPtr &req);
+    void loadSessionForRequest(const HttpRequestImplPtr &req,
+                               std::function<void()> &&callback);
+    // Return nullptr if the session must be loaded from the session store
+    SessionPtr resolveSessionForRequest(const HttpRequestImpl &req);
     HttpResponsePtr handleSessionForResponse(const HttpRequestImplPtr &req,
                                              const HttpResponsePtr &resp);
 
@@ -665,13 +926,30 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
         std::function<void(int)> cb) override;
     HttpAppFramework &setAfterAcceptSockOptCallback(
         std::function<void(int)> cb) override;
+    HttpAppFramework &enableLowLatency(uint16_t port,
+                                       size_t busyPollMicroseconds) override;
     HttpAppFramework &setConnectionCallback(
         std::function<void(const trantor::TcpConnectionPtr &)> cb) override;
 
     HttpAppFramework &enableRequestStream(bool enable) override;
     bool isRequestStreamEnabled() const override;
+    HttpAppFramework &setDnsCacheTtl(double ttl) override;
+    double getDnsCacheTtl() const override;
+    HttpAppFramework &enableOutputCorking(bool enable) override;
+    bool isOutputCorkingEnabled() const override;
+    HttpAppFramework &setSlowQueryThreshold(double threshold) override;
+    double getSlowQueryThreshold() const override;
 
   private:
+    void updateDefaultCompressionPolicy();
+    void runWarmupTasks();
+    void watchConfigFile();
+    void reloadConfigInLoop();
+    // Fork the worker processes and supervise them, return true in the
+    // workers and false in the supervisor when all the workers exited.
+    bool forkWorkers();
+    void waitForConnections(const trantor::Date &deadline);
+    void stopAll();
     void registerHttpController(const std::string &pathPattern,
                                 const internal::HttpBinderBasePtr &binder,
                                 const std::vector<HttpMethod> &validMethods,
@@ -688,13 +966,17 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     // set sessionTimeout_=0 to make location session valid forever based on
     // cookies;
     size_t sessionTimeout_{0};
-    Cookie::SameSite sessionSameSite_{Cookie::SameSite::kNull};
     std::string sessionCookieKey_{"JSESSIONID"};
-    int sessionMaxAge_{-1};
+    Cookie sessionCookie_;
     size_t idleConnectionTimeout_{60};
+    size_t idleMemoryTrimTimeout_{0};
+    double requestDeadline_{0.0};
+    std::string requestDeadlineHeader_;
     bool useSession_{false};
+    bool lazySession_{false};
     std::string serverHeader_{"server: drogon/" + drogon::getVersion() +
                               "\r\n"};
+    std::string altSvc_;
 
     std::unique_ptr<ListenerManager> listenerManagerPtr_;
     std::unique_ptr<PluginsManager> pluginsManagerPtr_;
@@ -704,10 +986,15 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     std::string rootPath_{"./"};
     std::string uploadPath_;
     std::atomic_bool running_{false};
+    std::atomic_bool draining_{false};
+    double gracefulShutdownTimeout_{0.0};
     std::atomic_bool routersInit_{false};
 
     size_t threadNum_{1};
     std::unique_ptr<trantor::EventLoopThreadPool> ioLoopThreadPool_;
+    size_t handlerThreadNum_{0};
+    std::once_flag handlerThreadPoolOnce_;
+    std::unique_ptr<WorkStealingThreadPool> handlerThreadPool_;
 
 #if !defined(_WIN32) && !TARGET_OS_IOS
     std::vector<std::string> libFilePaths_;
@@ -722,6 +1009,8 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     bool runAsDaemon_{false};
     bool handleSigterm_{true};
     bool relaunchOnError_{false};
+    size_t workerProcessNum_{0};
+    size_t workerIndex_{0};
     bool logWithSpdlog_{false};
     std::string logPath_;
     std::string logfileBaseName_;
@@ -733,13 +1022,20 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     bool useSendfile_{true};
     bool useGzip_{true};
     bool useBrotli_{false};
+    CompressionPolicy defaultCompressionPolicy_{{CompressionEncoding::kGzip}};
+    // Sorted by the length of the prefixes in descending order
+    std::vector<std::pair<std::string, CompressionPolicy>> compressionPolicies_;
+    bool useHttp2_{false};
+    bool zeroCopyHeaders_{false};
     bool usingUnicodeEscaping_{true};
     std::pair<unsigned int, std::string> floatPrecisionInJson_{0,
                                                                "significant"};
+    JsonEnginePtr jsonEngine_{JsonEngine::newDefaultEngine()};
     bool usingCustomErrorHandler_{false};
     size_t clientMaxBodySize_{1024 * 1024};
     size_t clientMaxMemoryBodySize_{64 * 1024};
     size_t clientMaxWebSocketMessageSize_{128 * 1024};
+    bool webSocketCompression_{false};
     std::string homePageFile_{"index.html"};
     std::function<void()> termSignalHandler_{[]() { app().quit(); }};
     std::function<void()> intSignalHandler_{[]() { app().quit(); }};
@@ -747,9 +1043,20 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     std::vector<AdviceStartSessionCallback> sessionStartAdvices_;
     std::vector<AdviceDestroySessionCallback> sessionDestroyAdvices_;
     SessionManager::IdGeneratorCallback sessionIdGeneratorCallback_;
+    SessionStorePtr sessionStore_;
+    size_t sessionLocalCacheTimeout_{5};
+    double sessionWriteBehindInterval_{0.5};
     std::shared_ptr<trantor::AsyncFileLogger> asyncFileLoggerPtr_;
     Json::Value jsonConfig_;
     Json::Value jsonRuntimeConfig_;
+    std::string configFile_;
+    size_t forwardConnectionsPerHost_{4};
+    double forwardIdleTimeout_{60.0};
+    std::mutex forwardPoolsMutex_;
+    std::unordered_map<std::string, HttpClientPoolPtr> forwardPools_;
+    double configReloadInterval_{0};
+    std::vector<std::function<void(const Json::Value &)>>
+        configReloadCallbacks_;
     HttpResponsePtr custom404_;
     std::function<HttpResponsePtr(HttpStatusCode, const HttpRequestPtr &req)>
         customErrorHandler_ = &defaultErrorHandler;
@@ -757,12 +1064,18 @@ class HttpAppFrameworkImpl final : public HttpAppFramework
     bool enableServerHeader_{true};
     bool enableDateHeader_{true};
     bool reusePort_{false};
+    bool tlsSessionSharing_{false};
+    ConnectionBalancing connectionBalancing_{ConnectionBalancing::kKernel};
+    std::vector<size_t> ioLoopCpus_;
     std::vector<std::function<void()>> beginningAdvices_;
+    std::vector<std::function<void(std::function<void()> &&)>> warmupTasks_;
 
     ExceptionHandler exceptionHandler_{defaultExceptionHandler};
     bool enableCompressedRequest_{false};
+    bool enableDynamicETag_{false};
 
     bool enableRequestStream_{false};
+    bool outputCorking_{false};
 };
 
 }  // namespace drogon
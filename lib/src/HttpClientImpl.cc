@@ -13,29 +13,61 @@
  */
 
 #include "HttpClientImpl.h"
+#include "DnsCache.h"
 #include "HttpAppFrameworkImpl.h"
 #include "HttpRequestImpl.h"
 #include "HttpResponseImpl.h"
 #include "HttpResponseParser.h"
 
 #include <drogon/config.h>
+#include <drogon/RequestDeadline.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <chrono>
 
 using namespace trantor;
 using namespace drogon;
 using namespace std::placeholders;
 
-namespace trantor
+// The delay before the connection to the next address of the server is
+// attempted while the previous ones are still in progress (RFC 8305 section
+// 5).
+static const double kConnectionAttemptDelay{0.25};
+
+static bool isValidIpAddr(const trantor::InetAddress &addr)
 {
-static const size_t kDefaultDNSTimeout{600};
+    if (addr.portNetEndian() == 0)
+    {
+        return false;
+    }
+    if (!addr.isIpV6())
+    {
+        return addr.ipNetEndian() != 0;
+    }
+    // Is ipv6
+    auto ipaddr = addr.ip6NetEndian();
+    for (int i = 0; i < 4; ++i)
+    {
+        if (ipaddr[i] != 0)
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 void HttpClientImpl::createTcpClient()
 {
-    LOG_TRACE << "New TcpClient," << serverAddr_.toIpPort();
-    tcpClientPtr_ =
-        std::make_shared<trantor::TcpClient>(loop_, serverAddr_, "httpClient");
+    tcpClientPtr_ = newTcpClient(serverAddr_);
+    tcpClientPtr_->connect();
+}
+
+std::shared_ptr<trantor::TcpClient> HttpClientImpl::newTcpClient(
+    const trantor::InetAddress &addr)
+{
+    LOG_TRACE << "New TcpClient," << addr.toIpPort();
+    auto tcpClientPtr =
+        std::make_shared<trantor::TcpClient>(loop_, addr, "httpClient");
 
     if (useSSL_ && utils::supportsTls())
     {
@@ -48,46 +80,58 @@ void HttpClientImpl::createTcpClient()
             .setConfCmds(sslConfCmds_)
             .setCertPath(clientCertPath_)
             .setKeyPath(clientKeyPath_);
-        tcpClientPtr_->enableSSL(std::move(policy));
+        if (enableHttp2_)
+        {
+            policy->setAlpnProtocols({"h2", "http/1.1"});
+        }
+        tcpClientPtr->enableSSL(std::move(policy));
     }
 
     auto thisPtr = shared_from_this();
     std::weak_ptr<HttpClientImpl> weakPtr = thisPtr;
-    tcpClientPtr_->setSockOptCallback([weakPtr](int fd) {
+    auto client = tcpClientPtr.get();
+    tcpClientPtr->setSockOptCallback([weakPtr](int fd) {
         auto thisPtr = weakPtr.lock();
         if (!thisPtr)
             return;
         if (thisPtr->sockOptCallback_)
             thisPtr->sockOptCallback_(fd);
     });
-    tcpClientPtr_->setConnectionCallback(
-        [weakPtr](const trantor::TcpConnectionPtr &connPtr) {
+    tcpClientPtr->setConnectionCallback(
+        [weakPtr, client](const trantor::TcpConnectionPtr &connPtr) {
             auto thisPtr = weakPtr.lock();
-            if (!thisPtr)
+            // Ignore the clients replaced or losing the race.
+            if (!thisPtr || !thisPtr->isInUse(client))
                 return;
             if (connPtr->connected())
             {
+                if (thisPtr->isRacer(client))
+                    thisPtr->winConnectRace(client, connPtr->peerAddr());
+                if (thisPtr->enableHttp2_ &&
+                    (connPtr->applicationProtocol() == "h2" ||
+                     (!thisPtr->useSSL_ && thisPtr->http2PriorKnowledge_)))
+                {
+                    LOG_TRACE << "HTTP/2 connection established!";
+                    thisPtr->http2ConnPtr_ =
+                        std::make_shared<Http2ClientConnection>(connPtr);
+                    thisPtr->http2ConnPtr_->start();
+                    thisPtr->sendBufferedRequestsHttp2();
+                    return;
+                }
                 connPtr->setContext(
                     std::make_shared<HttpResponseParser>(connPtr));
                 // send request;
                 LOG_TRACE << "Connection established!";
-                while (thisPtr->pipeliningCallbacks_.size() <=
-                           thisPtr->pipeliningDepth_ &&
-                       !thisPtr->requestsBuffer_.empty())
-                {
-                    thisPtr->sendReq(connPtr,
-                                     thisPtr->requestsBuffer_.front().first);
-                    thisPtr->pipeliningCallbacks_.push(
-                        std::move(thisPtr->requestsBuffer_.front()));
-                    thisPtr->pipeliningCallbacksSize_.fetch_add(
-                        1, std::memory_order_relaxed);
-
-                    thisPtr->popFrontRequest();
-                }
+                thisPtr->sendBufferedRequests(connPtr);
             }
             else
             {
                 LOG_TRACE << "connection disconnect";
+                if (thisPtr->http2ConnPtr_)
+                {
+                    thisPtr->onError(ReqResult::NetworkFailure);
+                    return;
+                }
                 auto responseParser = connPtr->getContext<HttpResponseParser>();
                 if (responseParser && responseParser->parseResponseOnClose() &&
                     responseParser->gotAll())
@@ -112,14 +156,25 @@ void HttpClientImpl::createTcpClient()
                 thisPtr->onError(ReqResult::NetworkFailure);
             }
         });
-    tcpClientPtr_->setConnectionErrorCallback([weakPtr]() {
+    tcpClientPtr->setWriteCompleteCallback(
+        [weakPtr](const trantor::TcpConnectionPtr &) {
+            auto thisPtr = weakPtr.lock();
+            if (thisPtr && thisPtr->bodyStreamPtr_)
+                thisPtr->bodyStreamPtr_->onWriteComplete();
+        });
+    tcpClientPtr->setConnectionErrorCallback([weakPtr, client]() {
         auto thisPtr = weakPtr.lock();
-        if (!thisPtr)
+        if (!thisPtr || !thisPtr->isInUse(client))
+            return;
+        if (thisPtr->isRacer(client))
+        {
+            thisPtr->onRacerFailed(client);
             return;
+        }
         // can't connect to server
         thisPtr->onError(ReqResult::BadServerAddress);
     });
-    tcpClientPtr_->setMessageCallback(
+    tcpClientPtr->setMessageCallback(
         [weakPtr](const trantor::TcpConnectionPtr &connPtr,
                   trantor::MsgBuffer *msg) {
             auto thisPtr = weakPtr.lock();
@@ -128,10 +183,14 @@ void HttpClientImpl::createTcpClient()
                 thisPtr->onRecvMessage(connPtr, msg);
             }
         });
-    tcpClientPtr_->setSSLErrorCallback([weakPtr](SSLError err) {
+    tcpClientPtr->setSSLErrorCallback([weakPtr, client](SSLError err) {
         auto thisPtr = weakPtr.lock();
-        if (!thisPtr)
+        if (!thisPtr || !thisPtr->isInUse(client))
             return;
+        // The certificate and the protocol of the server don't depend on its
+        // address, the other attempts are given up.
+        if (thisPtr->isRacer(client))
+            thisPtr->endConnectRace();
         if (err == trantor::SSLError::kSSLHandshakeError)
             thisPtr->onError(ReqResult::HandshakeError);
         else if (err == trantor::SSLError::kSSLInvalidCertificate)
@@ -144,7 +203,144 @@ void HttpClientImpl::createTcpClient()
             abort();
         }
     });
-    tcpClientPtr_->connect();
+    return tcpClientPtr;
+}
+
+bool HttpClientImpl::isRacer(const trantor::TcpClient *client) const
+{
+    for (auto &racer : racers_)
+    {
+        if (racer.get() == client)
+            return true;
+    }
+    return false;
+}
+
+bool HttpClientImpl::isInUse(const trantor::TcpClient *client) const
+{
+    return tcpClientPtr_.get() == client || isRacer(client);
+}
+
+void HttpClientImpl::onResolved(
+    const std::vector<trantor::InetAddress> &addresses)
+{
+    // Retrieve port from old serverAddr_
+    auto port = serverAddr_.portNetEndian();
+    std::vector<trantor::InetAddress> validAddresses;
+    for (auto addr : addresses)
+    {
+        addr.setPortNetEndian(port);
+        if (isValidIpAddr(addr))
+            validAddresses.push_back(addr);
+    }
+    if (validAddresses.empty())
+    {
+        dns_ = false;
+        // DNS fail to get valid ip address,
+        // respond all requests with BadServerAddress
+        while (!requestsBuffer_.empty())
+        {
+            auto cb = std::move(requestsBuffer_.front().second);
+            popFrontRequest();
+            cb(ReqResult::BadServerAddress, nullptr);
+        }
+        return;
+    }
+    LOG_TRACE << "dns:domain=" << domain_
+              << ";ip=" << validAddresses.front().toIp() << " and "
+              << validAddresses.size() - 1 << " other addresses";
+    if (validAddresses.size() == 1)
+    {
+        dns_ = false;
+        serverAddr_ = validAddresses.front();
+        createTcpClient();
+        return;
+    }
+    // The connections to the addresses are attempted one after the other
+    // without waiting for the previous ones to fail, the first one
+    // established is used (RFC 8305).
+    raceAddresses_ = std::move(validAddresses);
+    raceNext_ = 0;
+    connectNextRacer();
+}
+
+void HttpClientImpl::connectNextRacer()
+{
+    assert(raceNext_ < raceAddresses_.size());
+    auto client = newTcpClient(raceAddresses_[raceNext_++]);
+    racers_.push_back(client);
+    client->connect();
+    if (raceNext_ == raceAddresses_.size())
+        return;
+    std::weak_ptr<HttpClientImpl> weakPtr = shared_from_this();
+    raceTimerId_ = loop_->runAfter(kConnectionAttemptDelay, [weakPtr]() {
+        auto thisPtr = weakPtr.lock();
+        if (!thisPtr)
+            return;
+        thisPtr->raceTimerId_ = trantor::InvalidTimerId;
+        thisPtr->connectNextRacer();
+    });
+}
+
+void HttpClientImpl::winConnectRace(const trantor::TcpClient *client,
+                                    const trantor::InetAddress &addr)
+{
+    for (auto &racer : racers_)
+    {
+        if (racer.get() == client)
+        {
+            tcpClientPtr_ = racer;
+            break;
+        }
+    }
+    serverAddr_ = addr;
+    endConnectRace();
+}
+
+void HttpClientImpl::onRacerFailed(const trantor::TcpClient *client)
+{
+    auto iter = std::find_if(racers_.begin(),
+                             racers_.end(),
+                             [client](const auto &racer) {
+                                 return racer.get() == client;
+                             });
+    assert(iter != racers_.end());
+    // The client can't be destroyed in its own callback.
+    loop_->queueInLoop([racer = std::move(*iter)]() {});
+    racers_.erase(iter);
+    if (raceNext_ < raceAddresses_.size())
+    {
+        // Don't wait for the delay after a failure.
+        if (raceTimerId_ != trantor::InvalidTimerId)
+        {
+            loop_->invalidateTimer(raceTimerId_);
+            raceTimerId_ = trantor::InvalidTimerId;
+        }
+        connectNextRacer();
+        return;
+    }
+    if (!racers_.empty())
+        return;
+    endConnectRace();
+    // The addresses may be out of date.
+    internal::DnsCache::instance().invalidate(domain_);
+    // can't connect to server
+    onError(ReqResult::BadServerAddress);
+}
+
+void HttpClientImpl::endConnectRace()
+{
+    if (raceTimerId_ != trantor::InvalidTimerId)
+    {
+        loop_->invalidateTimer(raceTimerId_);
+        raceTimerId_ = trantor::InvalidTimerId;
+    }
+    // The clients can't be destroyed in their own callbacks.
+    loop_->queueInLoop([racers = std::move(racers_)]() {});
+    racers_.clear();
+    raceAddresses_.clear();
+    raceNext_ = 0;
+    dns_ = false;
 }
 
 HttpClientImpl::HttpClientImpl(trantor::EventLoop *loop,
@@ -262,27 +458,84 @@ HttpClientImpl::HttpClientImpl(trantor::EventLoop *loop,
 HttpClientImpl::~HttpClientImpl()
 {
     LOG_TRACE << "Deconstruction HttpClient";
-    if (resolverPtr_ && !(loop_->isInLoopThread()))
+}
+
+// Bound the timeout by the deadline of the request being handled, if any,
+// and fail at once if the request is cancelled.
+static bool applyDeadline(const HttpRequestPtr &req,
+                          HttpReqCallback &callback,
+                          double &timeout)
+{
+    if (!RequestDeadline::hasCurrent())
+        return true;
+    if (RequestDeadline::cancelled())
+    {
+        callback(ReqResult::Cancelled, nullptr);
+        return false;
+    }
+    timeout = RequestDeadline::clampTimeout(timeout);
+    if (timeout < 0.0)
     {
-        // Make sure the resolverPtr_ is destroyed in the correct thread.
-        loop_->queueInLoop([resolverPtr = std::move(resolverPtr_)]() {});
+        callback(ReqResult::Timeout, nullptr);
+        return false;
     }
+    RequestDeadline::propagate(callback);
+    return true;
+}
+
+// Fail at once while the circuit is open, and record the outcome of the
+// request otherwise.
+bool HttpClientImpl::applyCircuitBreaker(HttpReqCallback &callback) const
+{
+    if (!circuitBreakerPtr_)
+        return true;
+    if (!circuitBreakerPtr_->allow())
+    {
+        callback(ReqResult::CircuitOpen, nullptr);
+        return false;
+    }
+    callback = [breaker = circuitBreakerPtr_,
+                start = std::chrono::steady_clock::now(),
+                callback = std::move(callback)](ReqResult result,
+                                                const HttpResponsePtr &resp) {
+        std::chrono::duration<double> latency =
+            std::chrono::steady_clock::now() - start;
+        bool success{false};
+        if (result == ReqResult::Ok)
+            success = resp->statusCode() < k500InternalServerError;
+        else  // A cancellation by the caller isn't a failure of the server.
+            success = result == ReqResult::Cancelled;
+        breaker->record(success, latency.count());
+        callback(result, resp);
+    };
+    return true;
 }
 
 void HttpClientImpl::sendRequest(const drogon::HttpRequestPtr &req,
                                  const drogon::HttpReqCallback &callback,
                                  double timeout)
 {
+    auto cb = callback;
+    if (!applyDeadline(req, cb, timeout) || !applyCircuitBreaker(cb))
+        return;
+    if (coalesceRequests_ && sendCoalescedRequest(req, cb, timeout))
+        return;
     auto thisPtr = shared_from_this();
-    loop_->runInLoop([thisPtr, req, callback = callback, timeout]() mutable {
-        thisPtr->sendRequestInLoop(req, std::move(callback), timeout);
-    });
+    loop_->runInLoop(
+        [thisPtr, req, callback = std::move(cb), timeout]() mutable {
+            thisPtr->sendRequestInLoop(req, std::move(callback), timeout);
+        });
 }
 
 void HttpClientImpl::sendRequest(const drogon::HttpRequestPtr &req,
                                  drogon::HttpReqCallback &&callback,
                                  double timeout)
 {
+    if (!applyDeadline(req, callback, timeout) ||
+        !applyCircuitBreaker(callback))
+        return;
+    if (coalesceRequests_ && sendCoalescedRequest(req, callback, timeout))
+        return;
     auto thisPtr = shared_from_this();
     loop_->runInLoop(
         [thisPtr, req, callback = std::move(callback), timeout]() mutable {
@@ -290,6 +543,290 @@ void HttpClientImpl::sendRequest(const drogon::HttpRequestPtr &req,
         });
 }
 
+RequestBodyStreamPtr HttpClientImpl::sendStreamRequest(
+    const HttpRequestPtr &req,
+    HttpReqCallback &&callback,
+    double timeout)
+{
+    auto stream = std::make_shared<internal::ClientBodyStream>(
+        loop_, std::weak_ptr<HttpClientImpl>(shared_from_this()));
+    static_cast<HttpRequestImpl *>(req.get())->setBodyStream(stream);
+    HttpReqCallback cb = [stream, callback = std::move(callback)](
+                             ReqResult result, const HttpResponsePtr &resp) {
+        if (result != ReqResult::Ok)
+            stream->fail();
+        callback(result, resp);
+    };
+    // Never coalesced, each request has its own body.
+    if (!applyDeadline(req, cb, timeout) || !applyCircuitBreaker(cb))
+        return stream;
+    auto thisPtr = shared_from_this();
+    loop_->runInLoop(
+        [thisPtr, req, callback = std::move(cb), timeout]() mutable {
+            thisPtr->sendRequestInLoop(req, std::move(callback), timeout);
+        });
+    return stream;
+}
+
+void HttpClientImpl::sendRequestForStream(const HttpRequestPtr &req,
+                                          HttpReqCallback &&callback,
+                                          ResponseDataCallback dataCallback,
+                                          ResponseFinishCallback finishCallback,
+                                          double timeout)
+{
+    auto state = std::make_shared<internal::ResponseStreamState>();
+    state->dataCallback = std::move(dataCallback);
+    state->finishCallback = std::move(finishCallback);
+    static_cast<HttpRequestImpl *>(req.get())->setResponseStream(state);
+    // Called once, with the headers or the error which came first, the
+    // timeout included.
+    HttpReqCallback cb = [state, callback = std::move(callback)](
+                             ReqResult result, const HttpResponsePtr &resp) {
+        if (result == ReqResult::Ok)
+            state->headersReceived = true;
+        else
+            state->failed = true;
+        callback(result, resp);
+    };
+    if (!applyDeadline(req, cb, timeout) || !applyCircuitBreaker(cb))
+        return;
+    auto thisPtr = shared_from_this();
+    loop_->runInLoop(
+        [thisPtr, req, callback = std::move(cb), timeout]() mutable {
+            thisPtr->sendRequestInLoop(req, std::move(callback), timeout);
+        });
+}
+
+// Pass the result of a request to its callback, or to the finish callback of
+// its streamed response once the headers were passed.
+static void finishRequest(
+    const std::pair<HttpRequestPtr, HttpReqCallback> &reqAndCb,
+    ReqResult result,
+    const HttpResponsePtr &resp)
+{
+    auto &responseStream =
+        static_cast<HttpRequestImpl *>(reqAndCb.first.get())->responseStream();
+    if (!responseStream || !responseStream->headersReceived)
+    {
+        reqAndCb.second(result, resp);
+    }
+    else if (!responseStream->failed)
+    {
+        responseStream->failed = result != ReqResult::Ok;
+        if (responseStream->finishCallback)
+            responseStream->finishCallback(result);
+    }
+}
+
+bool internal::ClientBodyStream::send(const char *data, size_t length)
+{
+    if (closed_.load(std::memory_order_acquire) ||
+        failed_.load(std::memory_order_acquire))
+        return false;
+    // An empty chunk would end the body
+    if (length == 0)
+        return true;
+    char head[32];
+    auto headLength = snprintf(head, sizeof(head), "%zx\r\n", length);
+    std::string chunk;
+    chunk.reserve(headLength + length + 2);
+    chunk.append(head, headLength).append(data, length).append("\r\n");
+    bufferedBytes_.fetch_add(chunk.length(), std::memory_order_relaxed);
+    // Queued even in the loop, to keep the order of the pieces sent in
+    // different threads.
+    loop_->queueInLoop(
+        [thisPtr = shared_from_this(), chunk = std::move(chunk)]() mutable {
+            thisPtr->sendInLoop(std::move(chunk));
+        });
+    return true;
+}
+
+void internal::ClientBodyStream::close()
+{
+    if (closed_.exchange(true, std::memory_order_acq_rel))
+        return;
+    loop_->queueInLoop([thisPtr = shared_from_this()]() {
+        thisPtr->ending_ = true;
+        thisPtr->sendInLoop(std::string("0\r\n\r\n"));
+        if (thisPtr->attached_)
+        {
+            if (auto client = thisPtr->client_.lock())
+                client->onBodyStreamEnd(thisPtr.get());
+        }
+    });
+}
+
+void internal::ClientBodyStream::abort()
+{
+    if (closed_.exchange(true, std::memory_order_acq_rel))
+        return;
+    loop_->queueInLoop([thisPtr = shared_from_this()]() {
+        if (thisPtr->failed_.load(std::memory_order_acquire))
+            return;
+        thisPtr->fail();
+        if (auto client = thisPtr->client_.lock())
+            client->abortStreamRequest(thisPtr.get());
+    });
+}
+
+void internal::ClientBodyStream::setDrainCallback(std::function<void()> cb)
+{
+    loop_->runInLoop(
+        [thisPtr = shared_from_this(), cb = std::move(cb)]() mutable {
+            thisPtr->drainCallback_ = std::move(cb);
+        });
+}
+
+void internal::ClientBodyStream::sendInLoop(std::string &&chunk)
+{
+    if (failed_.load(std::memory_order_acquire))
+    {
+        pending_.clear();
+        return;
+    }
+    if (!attached_)
+    {
+        pending_.append(chunk);
+        return;
+    }
+    auto connPtr = connPtr_.lock();
+    if (!connPtr || !connPtr->connected())
+        return;
+    writtenBytes_ += chunk.length();
+    connPtr->send(std::move(chunk));
+}
+
+void internal::ClientBodyStream::attach(
+    const trantor::TcpConnectionPtr &connPtr)
+{
+    if (failed_.load(std::memory_order_acquire))
+        return;
+    attached_ = true;
+    connPtr_ = connPtr;
+    if (!pending_.empty())
+    {
+        writtenBytes_ += pending_.length();
+        connPtr->send(std::move(pending_));
+        pending_.clear();
+    }
+    if (ending_)
+    {
+        if (auto client = client_.lock())
+            client->onBodyStreamEnd(this);
+    }
+}
+
+void internal::ClientBodyStream::onWriteComplete()
+{
+    bufferedBytes_.fetch_sub(writtenBytes_, std::memory_order_relaxed);
+    writtenBytes_ = 0;
+    if (drainCallback_ && !failed_.load(std::memory_order_acquire))
+        drainCallback_();
+}
+
+void internal::ClientBodyStream::fail()
+{
+    failed_.store(true, std::memory_order_release);
+}
+
+namespace drogon
+{
+/**
+ * Forwards the body of a request stream to the body of a request sent by a
+ * client.
+ */
+class ForwardStreamReader : public RequestStreamReader
+{
+  public:
+    ForwardStreamReader(RequestBodyStreamPtr body, size_t maxBufferedBytes)
+        : body_(std::move(body)), maxBufferedBytes_(maxBufferedBytes)
+    {
+    }
+
+    void onStreamData(const char *data, size_t length) override
+    {
+        if (failed_)
+            return;
+        if (body_->bufferedBytes() + length > maxBufferedBytes_)
+        {
+            LOG_WARN << "The upstream connection is too slow, the forwarded "
+                        "request is aborted";
+            failed_ = true;
+            body_->abort();
+            return;
+        }
+        if (!body_->send(data, length))
+            failed_ = true;
+    }
+
+    void onStreamFinish(std::exception_ptr ex) override
+    {
+        if (failed_)
+            return;
+        if (ex)
+            body_->abort();
+        else
+            body_->close();
+    }
+
+  private:
+    RequestBodyStreamPtr body_;
+    size_t maxBufferedBytes_;
+    bool failed_{false};
+};
+}  // namespace drogon
+
+RequestStreamReaderPtr RequestBodyStream::newForwardReader(
+    RequestBodyStreamPtr body,
+    size_t maxBufferedBytes)
+{
+    return std::make_shared<ForwardStreamReader>(std::move(body),
+                                                 maxBufferedBytes);
+}
+
+bool HttpClientImpl::sendCoalescedRequest(const HttpRequestPtr &req,
+                                          HttpReqCallback &callback,
+                                          double timeout)
+{
+    if ((req->method() != Get && req->method() != Head) ||
+        static_cast<HttpRequestImpl *>(req.get())->hasExternalBody())
+        return false;
+    // The headers and cookies are sorted, their order doesn't change the
+    // request.
+    auto appendSorted = [](std::string &key,
+                           const SafeStringMap<std::string> &map,
+                           char separator) {
+        std::vector<const std::pair<const std::string, std::string> *> items;
+        items.reserve(map.size());
+        for (auto &item : map)
+            items.push_back(&item);
+        std::sort(items.begin(), items.end(), [](auto a, auto b) {
+            return a->first < b->first;
+        });
+        for (auto item : items)
+        {
+            key.append(item->first).append(1, '=').append(item->second);
+            key.append(1, separator);
+        }
+    };
+    std::string key{req->methodString()};
+    key.append(1, ' ').append(req->path());
+    key.append(1, '?').append(req->query()).append(1, '\n');
+    appendSorted(key, req->headers(), '\n');
+    appendSorted(key, req->cookies(), ';');
+    key.append(1, '\n').append(req->body());
+    flights_.run(
+        key,
+        std::move(callback),
+        [thisPtr = shared_from_this(), &req, timeout](HttpReqCallback &&done) {
+            thisPtr->loop_->runInLoop(
+                [thisPtr, req, done = std::move(done), timeout]() mutable {
+                    thisPtr->sendRequestInLoop(req, std::move(done), timeout);
+                });
+        });
+    return true;
+}
+
 struct RequestCallbackParams
 {
     RequestCallbackParams(HttpReqCallback &&cb,
@@ -316,6 +853,12 @@ void HttpClientImpl::sendRequestInLoop(const HttpRequestPtr &req,
         sendRequestInLoop(req, std::move(callback));
         return;
     }
+    // The timeout is passed on to the server in the deadline header, added
+    // after the coalescing of the identical requests which it would defeat.
+    const auto &header =
+        HttpAppFrameworkImpl::instance().getRequestDeadlineHeader();
+    if (!header.empty() && req->getHeader(header).empty())
+        req->addHeader(header, std::to_string(timeout));
 
     auto callbackParamsPtr =
         std::make_shared<RequestCallbackParams>(std::move(callback),
@@ -337,6 +880,7 @@ void HttpClientImpl::sendRequestInLoop(const HttpRequestPtr &req,
 
                 callbackParamsPtr->timeoutFlag = true;
 
+                bool buffered = false;
                 for (auto iter = thisPtr->requestsBuffer_.begin();
                      iter != thisPtr->requestsBuffer_.end();
                      ++iter)
@@ -344,9 +888,16 @@ void HttpClientImpl::sendRequestInLoop(const HttpRequestPtr &req,
                     if (iter->first == callbackParamsPtr->requestPtr)
                     {
                         thisPtr->eraseRequest(iter);
+                        buffered = true;
                         break;
                     }
                 }
+                if (!buffered && thisPtr->http2ConnPtr_)
+                {
+                    // Only the stream of the request is reset
+                    thisPtr->http2ConnPtr_->cancelRequest(
+                        callbackParamsPtr->requestPtr);
+                }
 
                 (callbackParamsPtr->callback)(ReqResult::Timeout, nullptr);
             }
@@ -363,28 +914,6 @@ void HttpClientImpl::sendRequestInLoop(const HttpRequestPtr &req,
                       });
 }
 
-static bool isValidIpAddr(const trantor::InetAddress &addr)
-{
-    if (addr.portNetEndian() == 0)
-    {
-        return false;
-    }
-    if (!addr.isIpV6())
-    {
-        return addr.ipNetEndian() != 0;
-    }
-    // Is ipv6
-    auto ipaddr = addr.ip6NetEndian();
-    for (int i = 0; i < 4; ++i)
-    {
-        if (ipaddr[i] != 0)
-        {
-            return true;
-        }
-    }
-    return false;
-}
-
 void HttpClientImpl::sendRequestInLoop(const drogon::HttpRequestPtr &req,
                                        drogon::HttpReqCallback &&callback)
 {
@@ -452,41 +981,15 @@ void HttpClientImpl::sendRequestInLoop(const drogon::HttpRequestPtr &req,
             return;
         }
 
-        // Always do dns query when (re)connects a domain.
+        // Always do dns query when (re)connects a domain, the answers are
+        // cached for all the clients.
         dns_ = true;
-        if (!resolverPtr_)
-        {
-            resolverPtr_ =
-                trantor::Resolver::newResolver(loop_, kDefaultDNSTimeout);
-        }
         auto thisPtr = shared_from_this();
-        resolverPtr_->resolve(
-            domain_, [thisPtr](const trantor::InetAddress &addr) {
-                thisPtr->loop_->runInLoop([thisPtr, addr]() {
-                    // Retrieve port from old serverAddr_
-                    auto port = thisPtr->serverAddr_.portNetEndian();
-                    thisPtr->serverAddr_ = addr;
-                    thisPtr->serverAddr_.setPortNetEndian(port);
-                    LOG_TRACE << "dns:domain=" << thisPtr->domain_
-                              << ";ip=" << thisPtr->serverAddr_.toIp();
-                    thisPtr->dns_ = false;
-
-                    if (isValidIpAddr(thisPtr->serverAddr_))
-                    {
-                        thisPtr->createTcpClient();
-                        return;
-                    }
-
-                    // DNS fail to get valid ip address,
-                    // respond all requests with BadServerAddress
-                    while (!(thisPtr->requestsBuffer_).empty())
-                    {
-                        auto &reqAndCb = (thisPtr->requestsBuffer_).front();
-                        reqAndCb.second(ReqResult::BadServerAddress, nullptr);
-
-                        thisPtr->popFrontRequest();
-                    }
-                });
+        internal::DnsCache::instance().resolve(
+            domain_,
+            loop_,
+            [thisPtr](const std::vector<trantor::InetAddress> &addresses) {
+                thisPtr->onResolved(addresses);
             });
 
         return;
@@ -507,9 +1010,21 @@ void HttpClientImpl::sendRequestInLoop(const drogon::HttpRequestPtr &req,
         return;
     }
 
+    if (http2ConnPtr_)
+    {
+        // The request waits in the buffer if the stream limit is reached
+        enqueueRequest(req,
+                       [thisPtr, callback = std::move(callback)](
+                           ReqResult result, const HttpResponsePtr &response) {
+                           callback(result, response);
+                       });
+        sendBufferedRequestsHttp2();
+        return;
+    }
+
     // Connected, send request now
     if (pipeliningCallbacks_.size() <= pipeliningDepth_ &&
-        requestsBuffer_.empty())
+        requestsBuffer_.empty() && !bodyStreamPtr_)
     {
         sendReq(connPtr, req);
         pipeliningCallbacks_.push(
@@ -542,14 +1057,87 @@ void HttpClientImpl::sendReq(const trantor::TcpConnectionPtr &connPtr,
               << std::string(buffer.peek(), buffer.readableBytes());
     bytesSent_ += buffer.readableBytes();
     connPtr->send(std::move(buffer));
+    // The file and stream bodies are read by the connection when it can take
+    // more, so they are never all in memory.
+    if (!implPtr->sendfileName().empty())
+    {
+        auto &range = implPtr->sendfileRange();
+        bytesSent_ += range.second;
+        connPtr->sendFile(implPtr->sendfileName().c_str(),
+                          range.first,
+                          range.second);
+    }
+    else if (auto &streamCallback = implPtr->streamCallback())
+    {
+        // In the pass-through mode the chunks are framed by the callback
+        // unless the header asks for them.
+        if (!implPtr->passThrough() ||
+            req->getHeader("transfer-encoding") == "chunked")
+            connPtr->sendStream(chunkedStreamCallback(streamCallback));
+        else
+            connPtr->sendStream(streamCallback);
+    }
+    else if (auto &bodyStream = implPtr->bodyStream())
+    {
+        bodyStreamPtr_ = bodyStream;
+        bodyStream->attach(connPtr);
+    }
 }
 
-void HttpClientImpl::handleResponse(
-    const HttpResponseImplPtr &resp,
-    std::pair<HttpRequestPtr, HttpReqCallback> &&reqAndCb,
+void HttpClientImpl::sendBufferedRequests(
     const trantor::TcpConnectionPtr &connPtr)
 {
-    assert(!pipeliningCallbacks_.empty());
+    while (pipeliningCallbacks_.size() <= pipeliningDepth_ &&
+           !requestsBuffer_.empty() && !bodyStreamPtr_)
+    {
+        auto reqAndCb = std::move(requestsBuffer_.front());
+        popFrontRequest();
+        pipeliningCallbacks_.push(std::move(reqAndCb));
+        pipeliningCallbacksSize_.fetch_add(1, std::memory_order_relaxed);
+        sendReq(connPtr, pipeliningCallbacks_.back().first);
+    }
+}
+
+void HttpClientImpl::onBodyStreamEnd(internal::ClientBodyStream *stream)
+{
+    if (bodyStreamPtr_.get() != stream)
+        return;
+    bodyStreamPtr_.reset();
+    // Not in the middle of sendReq(), which may be called in a loop over the
+    // buffered requests.
+    loop_->queueInLoop([thisPtr = shared_from_this()]() {
+        if (!thisPtr->tcpClientPtr_ || thisPtr->http2ConnPtr_)
+            return;
+        auto connPtr = thisPtr->tcpClientPtr_->connection();
+        if (connPtr && connPtr->connected())
+            thisPtr->sendBufferedRequests(connPtr);
+    });
+}
+
+void HttpClientImpl::abortStreamRequest(internal::ClientBodyStream *stream)
+{
+    if (bodyStreamPtr_.get() == stream)
+    {
+        // The body was partly sent, the connection can't be used anymore.
+        onError(ReqResult::Cancelled);
+        return;
+    }
+    for (auto iter = requestsBuffer_.begin(); iter != requestsBuffer_.end();
+         ++iter)
+    {
+        auto implPtr = static_cast<HttpRequestImpl *>(iter->first.get());
+        if (implPtr->bodyStream().get() == stream)
+        {
+            auto callback = std::move(iter->second);
+            eraseRequest(iter);
+            callback(ReqResult::Cancelled, nullptr);
+            return;
+        }
+    }
+}
+
+static void decompressResponse(const HttpResponseImplPtr &resp)
+{
     auto &coding = resp->getHeaderBy("content-encoding");
     if (coding == "gzip")
     {
@@ -561,11 +1149,109 @@ void HttpClientImpl::handleResponse(
         resp->brDecompress();
     }
 #endif
+}
+
+void HttpClientImpl::sendBufferedRequestsHttp2()
+{
+    while (http2ConnPtr_ && http2ConnPtr_->canSendRequest() &&
+           !requestsBuffer_.empty())
+    {
+        auto reqAndCb = std::move(requestsBuffer_.front());
+        popFrontRequest();
+        auto implPtr = static_cast<HttpRequestImpl *>(reqAndCb.first.get());
+        if (implPtr->hasExternalBody() || implPtr->responseStream())
+        {
+            LOG_ERROR << "The streamed requests need an HTTP/1.1 connection";
+            if (implPtr->bodyStream())
+                implPtr->bodyStream()->fail();
+            reqAndCb.second(ReqResult::NetworkFailure, nullptr);
+            continue;
+        }
+        pipeliningCallbacksSize_.fetch_add(1, std::memory_order_relaxed);
+        // Keep a copy of the connection, the callback may be called
+        // synchronously and reset the member.
+        auto http2Conn = http2ConnPtr_;
+        http2Conn->sendRequest(
+            reqAndCb.first,
+            useSSL_,
+            [thisPtr = shared_from_this(),
+             callback = std::move(reqAndCb.second)](
+                ReqResult result, const HttpResponseImplPtr &resp) {
+                thisPtr->handleHttp2Response(result, resp, callback);
+            });
+    }
+}
+
+void HttpClientImpl::handleHttp2Response(ReqResult result,
+                                         const HttpResponseImplPtr &resp,
+                                         const HttpReqCallback &callback)
+{
+    pipeliningCallbacksSize_.fetch_sub(1, std::memory_order_relaxed);
+    if (result == ReqResult::Ok)
+    {
+        decompressResponse(resp);
+        handleCookies(resp);
+    }
+    callback(result, resp);
+    if (!http2ConnPtr_)
+        return;
+    if (http2ConnPtr_->isGoingAway())
+    {
+        // Open a new connection for the buffered requests once all streams
+        // on the old one are done
+        if (http2ConnPtr_->numberOfStreams() == 0)
+        {
+            resetHttp2Connection();
+            tcpClientPtr_.reset();
+            if (!requestsBuffer_.empty())
+            {
+                createTcpClient();
+            }
+        }
+        return;
+    }
+    sendBufferedRequestsHttp2();
+}
+
+void HttpClientImpl::resetHttp2Connection()
+{
+    if (http2ConnPtr_)
+    {
+        bytesSent_ += http2ConnPtr_->bytesSent();
+        http2ConnPtr_.reset();
+    }
+}
+
+void HttpClientImpl::handleResponse(
+    const HttpResponseImplPtr &resp,
+    std::pair<HttpRequestPtr, HttpReqCallback> &&reqAndCb,
+    const trantor::TcpConnectionPtr &connPtr)
+{
+    assert(!pipeliningCallbacks_.empty());
     auto cb = std::move(reqAndCb);
     pipeliningCallbacks_.pop();
     pipeliningCallbacksSize_.fetch_sub(1, std::memory_order_relaxed);
-    handleCookies(resp);
-    cb.second(ReqResult::Ok, resp);
+    auto implPtr = static_cast<HttpRequestImpl *>(cb.first.get());
+    // The headers of the streamed responses were handled on their arrival.
+    if (!implPtr->responseStream())
+    {
+        decompressResponse(resp);
+        handleCookies(resp);
+    }
+    auto &bodyStream = implPtr->bodyStream();
+    if (bodyStream && bodyStream == bodyStreamPtr_)
+    {
+        // The response came before the end of the body, the connection is
+        // closed with the rest of it.
+        bodyStream->fail();
+        finishRequest(cb, ReqResult::Ok, resp);
+        bodyStreamPtr_.reset();
+        tcpClientPtr_.reset();
+        if (!requestsBuffer_.empty())
+            createTcpClient();
+        return;
+    }
+    finishRequest(cb, ReqResult::Ok, resp);
 
     // LOG_TRACE << "pipelining buffer size=" <<
     // pipeliningCallbacks_.size(); LOG_TRACE << "requests buffer size="
@@ -575,11 +1261,7 @@ void HttpClientImpl::handleResponse(
     {
         if (!requestsBuffer_.empty())
         {
-            auto &reqAndCallback = requestsBuffer_.front();
-            sendReq(connPtr, reqAndCallback.first);
-            pipeliningCallbacks_.push(std::move(reqAndCallback));
-            pipeliningCallbacksSize_.fetch_add(1, std::memory_order_relaxed);
-            popFrontRequest();
+            sendBufferedRequests(connPtr);
         }
         else
         {
@@ -596,7 +1278,7 @@ void HttpClientImpl::handleResponse(
             auto cb = std::move(pipeliningCallbacks_.front());
             pipeliningCallbacks_.pop();
             pipeliningCallbacksSize_.fetch_sub(1, std::memory_order_relaxed);
-            cb.second(ReqResult::NetworkFailure, nullptr);
+            finishRequest(cb, ReqResult::NetworkFailure, nullptr);
         }
     }
 }
@@ -604,6 +1286,12 @@ void HttpClientImpl::handleResponse(
 void HttpClientImpl::onRecvMessage(const trantor::TcpConnectionPtr &connPtr,
                                    trantor::MsgBuffer *msg)
 {
+    if (http2ConnPtr_)
+    {
+        bytesReceived_ += msg->readableBytes();
+        http2ConnPtr_->onMessage(msg);
+        return;
+    }
     auto responseParser = connPtr->getContext<HttpResponseParser>();
 
     // LOG_TRACE << "###:" << msg->readableBytes();
@@ -621,12 +1309,43 @@ void HttpClientImpl::onRecvMessage(const trantor::TcpConnectionPtr &connPtr,
         {
             responseParser->setForHeadMethod();
         }
+        auto &responseStream =
+            static_cast<HttpRequestImpl *>(firstReq.first.get())
+                ->responseStream();
+        if (responseStream && !responseParser->hasBodyCallback())
+        {
+            responseParser->setBodyCallback(
+                [responseStream](const char *data, size_t length) {
+                    if (!responseStream->failed &&
+                        responseStream->dataCallback)
+                        responseStream->dataCallback(data, length);
+                });
+        }
         if (!responseParser->parseResponse(msg))
         {
             onError(ReqResult::BadResponse);
             bytesReceived_ += (msgSize - msg->readableBytes());
             return;
         }
+        if (responseStream && !responseStream->headersParsed &&
+            responseParser->headersComplete())
+        {
+            // The parser stopped after the headers, the body follows.
+            responseStream->headersParsed = true;
+            if (!responseStream->failed)
+            {
+                auto resp = responseParser->responseImpl();
+                resp->setPeerCertificate(connPtr->peerCertificate());
+                handleCookies(resp);
+                firstReq.second(ReqResult::Ok, resp);
+            }
+            if (!responseParser->gotAll())
+            {
+                bytesReceived_ += (msgSize - msg->readableBytes());
+                msgSize = msg->readableBytes();
+                continue;
+            }
+        }
         if (responseParser->gotAll())
         {
             auto resp = responseParser->responseImpl();
@@ -674,12 +1393,23 @@ HttpClientPtr HttpClient::newHttpClient(const std::string &hostString,
 
 void HttpClientImpl::onError(ReqResult result)
 {
+    if (bodyStreamPtr_)
+    {
+        bodyStreamPtr_->fail();
+        bodyStreamPtr_.reset();
+    }
+    if (http2ConnPtr_)
+    {
+        auto http2Conn = http2ConnPtr_;
+        resetHttp2Connection();
+        http2Conn->onClose(result);
+    }
     while (!pipeliningCallbacks_.empty())
     {
         auto cb = std::move(pipeliningCallbacks_.front());
         pipeliningCallbacks_.pop();
         pipeliningCallbacksSize_.fetch_sub(1, std::memory_order_relaxed);
-        cb.second(result, nullptr);
+        finishRequest(cb, result, nullptr);
     }
     while (!requestsBuffer_.empty())
     {
@@ -16,8 +16,8 @@
 
 #include <drogon/Cookie.h>
 #include <drogon/HttpClient.h>
+#include <drogon/utils/SingleFlight.h>
 #include <trantor/net/EventLoop.h>
-#include <trantor/net/Resolver.h>
 #include <trantor/net/TcpClient.h>
 #include <atomic>
 #include <cstddef>
@@ -27,10 +27,85 @@
 #include <mutex>
 #include <queue>
 #include <vector>
+#include "Http2ClientConnection.h"
 #include "impl_forwards.h"
 
 namespace drogon
 {
+class HttpClientImpl;
+
+namespace internal
+{
+/**
+ * @brief The body stream of a request sent by HttpClientImpl. The pieces are
+ * framed as chunks and passed to the loop of the client, where they wait
+ * until the request is sent on a connection.
+ */
+class ClientBodyStream final
+    : public RequestBodyStream,
+      public std::enable_shared_from_this<ClientBodyStream>
+{
+  public:
+    ClientBodyStream(trantor::EventLoop *loop,
+                     std::weak_ptr<HttpClientImpl> client)
+        : loop_(loop), client_(std::move(client))
+    {
+    }
+
+    bool send(const char *data, size_t length) override;
+    void close() override;
+    void abort() override;
+
+    size_t bufferedBytes() const override
+    {
+        return bufferedBytes_.load(std::memory_order_relaxed);
+    }
+
+    void setDrainCallback(std::function<void()> cb) override;
+
+    // The methods below are called in the loop of the client.
+
+    /// The request was sent on the connection, write the body to it.
+    void attach(const trantor::TcpConnectionPtr &connPtr);
+    /// The connection wrote all the bytes sent.
+    void onWriteComplete();
+    /// The request failed or got its response, drop the rest of the body.
+    void fail();
+
+  private:
+    void sendInLoop(std::string &&chunk);
+
+    trantor::EventLoop *loop_;
+    std::weak_ptr<HttpClientImpl> client_;
+    std::weak_ptr<trantor::TcpConnection> connPtr_;
+    // The chunks sent before the request.
+    std::string pending_;
+    std::atomic<size_t> bufferedBytes_{0};
+    // The bytes written to the connection since it last drained.
+    size_t writtenBytes_{0};
+    // Set by close() and abort(), no more pieces are accepted.
+    std::atomic<bool> closed_{false};
+    std::atomic<bool> failed_{false};
+    bool attached_{false};
+    // Set when the last chunk was passed to the loop.
+    bool ending_{false};
+    std::function<void()> drainCallback_;
+};
+
+/// The callbacks of a response received in pieces.
+struct ResponseStreamState
+{
+    HttpClient::ResponseDataCallback dataCallback;
+    HttpClient::ResponseFinishCallback finishCallback;
+    // Set when the response with the headers was passed to the callback of
+    // the request, or the error which ended it.
+    bool headersReceived{false};
+    bool failed{false};
+    // Set when the parser got the headers.
+    bool headersParsed{false};
+};
+}  // namespace internal
+
 class HttpClientImpl final : public HttpClient,
                              public std::enable_shared_from_this<HttpClientImpl>
 {
@@ -50,6 +125,14 @@ class HttpClientImpl final : public HttpClient,
     void sendRequest(const HttpRequestPtr &req,
                      HttpReqCallback &&callback,
                      double timeout = 0) override;
+    RequestBodyStreamPtr sendStreamRequest(const HttpRequestPtr &req,
+                                           HttpReqCallback &&callback,
+                                           double timeout = 0) override;
+    void sendRequestForStream(const HttpRequestPtr &req,
+                              HttpReqCallback &&callback,
+                              ResponseDataCallback dataCallback,
+                              ResponseFinishCallback finishCallback,
+                              double timeout = 0) override;
 
     trantor::EventLoop *getLoop() override
     {
@@ -61,6 +144,12 @@ class HttpClientImpl final : public HttpClient,
         pipeliningDepth_ = depth;
     }
 
+    void enableHttp2(bool flag = true, bool priorKnowledge = false) override
+    {
+        enableHttp2_ = flag;
+        http2PriorKnowledge_ = flag && priorKnowledge;
+    }
+
     ~HttpClientImpl();
 
     void enableCookies(bool flag = true) override
@@ -68,6 +157,16 @@ class HttpClientImpl final : public HttpClient,
         enableCookies_ = flag;
     }
 
+    void enableRequestCoalescing(bool flag = true) override
+    {
+        coalesceRequests_ = flag;
+    }
+
+    void setCircuitBreaker(CircuitBreakerPtr breaker) override
+    {
+        circuitBreakerPtr_ = std::move(breaker);
+    }
+
     void addCookie(const std::string &key, const std::string &value) override
     {
         validCookies_.emplace_back(Cookie(key, value));
@@ -80,7 +179,7 @@ class HttpClientImpl final : public HttpClient,
 
     size_t bytesSent() const override
     {
-        return bytesSent_;
+        return bytesSent_ + (http2ConnPtr_ ? http2ConnPtr_->bytesSent() : 0);
     }
 
     size_t bytesReceived() const override
@@ -155,6 +254,12 @@ class HttpClientImpl final : public HttpClient,
         requestsBufferSize_.fetch_sub(1, std::memory_order_relaxed);
     }
 
+    /// Called by the body stream of the request being sent when its last
+    /// chunk was written, the next requests can be sent.
+    void onBodyStreamEnd(internal::ClientBodyStream *stream);
+    /// Called by a body stream aborted by the user.
+    void abortStreamRequest(internal::ClientBodyStream *stream);
+
   private:
     std::shared_ptr<trantor::TcpClient> tcpClientPtr_;
     trantor::EventLoop *loop_;
@@ -165,6 +270,10 @@ class HttpClientImpl final : public HttpClient,
                  const HttpRequestPtr &req);
     void sendRequestInLoop(const HttpRequestPtr &req,
                            HttpReqCallback &&callback);
+    // Returns false if the request can't be coalesced.
+    bool sendCoalescedRequest(const HttpRequestPtr &req,
+                              HttpReqCallback &callback,
+                              double timeout);
     void sendRequestInLoop(const HttpRequestPtr &req,
                            HttpReqCallback &&callback,
                            double timeout);
@@ -172,7 +281,28 @@ class HttpClientImpl final : public HttpClient,
     void handleResponse(const HttpResponseImplPtr &resp,
                         std::pair<HttpRequestPtr, HttpReqCallback> &&reqAndCb,
                         const trantor::TcpConnectionPtr &connPtr);
+    void sendBufferedRequestsHttp2();
+    void handleHttp2Response(ReqResult result,
+                             const HttpResponseImplPtr &resp,
+                             const HttpReqCallback &callback);
+    void resetHttp2Connection();
     void createTcpClient();
+    std::shared_ptr<trantor::TcpClient> newTcpClient(
+        const trantor::InetAddress &addr);
+    void onResolved(const std::vector<trantor::InetAddress> &addresses);
+    // The connections to the addresses of the server race, the first one
+    // established is kept and the other ones are closed.
+    void connectNextRacer();
+    void winConnectRace(const trantor::TcpClient *client,
+                        const trantor::InetAddress &addr);
+    void onRacerFailed(const trantor::TcpClient *client);
+    void endConnectRace();
+    bool isRacer(const trantor::TcpClient *client) const;
+    // Returns false for the clients replaced or losing the race.
+    bool isInUse(const trantor::TcpClient *client) const;
+    // Send the buffered requests on the HTTP/1.1 connection as far as the
+    // pipelining depth and the body stream being sent allow.
+    void sendBufferedRequests();
     std::queue<std::pair<HttpRequestPtr, HttpReqCallback>> pipeliningCallbacks_;
     std::list<std::pair<HttpRequestPtr, HttpReqCallback>> requestsBuffer_;
     void onRecvMessage(const trantor::TcpConnectionPtr &, trantor::MsgBuffer *);
@@ -182,12 +312,28 @@ class HttpClientImpl final : public HttpClient,
     std::atomic<std::size_t> requestsBufferSize_{0};
     std::atomic<std::size_t> pipeliningCallbacksSize_{0};
     size_t pipeliningDepth_{0};
+    bool enableHttp2_{false};
+    bool http2PriorKnowledge_{false};
+    // Set when the server selects h2 by ALPN, requests are multiplexed on it
+    // instead of being pipelined.
+    Http2ClientConnectionPtr http2ConnPtr_;
+    // The body stream of the request being sent, no other request is sent
+    // on the connection until its end.
+    std::shared_ptr<internal::ClientBodyStream> bodyStreamPtr_;
     bool enableCookies_{false};
+    std::atomic<bool> coalesceRequests_{false};
+    SingleFlight<ReqResult, const HttpResponsePtr &> flights_;
+    CircuitBreakerPtr circuitBreakerPtr_;
+    bool applyCircuitBreaker(HttpReqCallback &callback) const;
     std::vector<Cookie> validCookies_;
     size_t bytesSent_{0};
     size_t bytesReceived_{0};
+    // Set from the dns query to the end of the connection race.
     bool dns_{false};
-    std::shared_ptr<trantor::Resolver> resolverPtr_;
+    std::vector<trantor::InetAddress> raceAddresses_;
+    size_t raceNext_{0};
+    std::vector<std::shared_ptr<trantor::TcpClient>> racers_;
+    trantor::TimerId raceTimerId_{trantor::InvalidTimerId};
     bool useOldTLS_{false};
     std::string userAgent_{"DrogonClient"};
     std::vector<std::pair<std::string, std::string>> sslConfCmds_;
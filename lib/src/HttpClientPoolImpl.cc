@@ -0,0 +1,221 @@
+/**
+ *
+ *  @file HttpClientPoolImpl.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by the MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "HttpClientPoolImpl.h"
+#include <drogon/HttpAppFramework.h>
+#include <trantor/utils/Logger.h>
+#include <cassert>
+#include <limits>
+
+using namespace drogon;
+
+HttpClientPoolImpl::HttpClientPoolImpl(const HttpClientPoolConfig &config,
+                                       std::vector<trantor::EventLoop *> loops)
+    : config_(config)
+{
+    if (config_.connectionsPerHost == 0)
+        config_.connectionsPerHost = 1;
+    for (auto loop : loops)
+    {
+        auto data = std::make_unique<LoopData>(loop);
+        data->connections.resize(config_.hosts.size());
+        loops_.push_back(std::move(data));
+    }
+}
+
+HttpClientPoolImpl::~HttpClientPoolImpl()
+{
+    for (auto &data : loops_)
+    {
+        if (data->evictionTimer != 0)
+            data->loop->invalidateTimer(data->evictionTimer);
+        if (!data->loop->isInLoopThread())
+        {
+            // Make sure the clients are destroyed in their own loop.
+            data->loop->queueInLoop(
+                [connections = std::move(data->connections)]() {});
+        }
+    }
+}
+
+void HttpClientPoolImpl::init()
+{
+    if (config_.idleTimeout <= 0)
+        return;
+    std::weak_ptr<HttpClientPoolImpl> weakPtr = shared_from_this();
+    auto interval = (std::max)(config_.idleTimeout / 2, 1.0);
+    for (auto &data : loops_)
+    {
+        auto dataPtr = data.get();
+        data->evictionTimer =
+            data->loop->runEvery(interval, [weakPtr, dataPtr]() {
+                auto thisPtr = weakPtr.lock();
+                if (!thisPtr)
+                    return;
+                thisPtr->evictIdleConnections(*dataPtr);
+            });
+    }
+}
+
+HttpClientPoolImpl::LoopData *HttpClientPoolImpl::findLoopData(
+    trantor::EventLoop *loop)
+{
+    for (auto &data : loops_)
+    {
+        if (data->loop == loop)
+            return data.get();
+    }
+    return nullptr;
+}
+
+void HttpClientPoolImpl::sendRequest(const HttpRequestPtr &req,
+                                     HttpReqCallback &&callback,
+                                     double timeout)
+{
+    if (loops_.empty() || config_.hosts.empty())
+    {
+        LOG_ERROR << "No event loop or host in the client pool";
+        callback(ReqResult::BadServerAddress, nullptr);
+        return;
+    }
+    outstandingRequests_.fetch_add(1, std::memory_order_relaxed);
+    auto data =
+        findLoopData(trantor::EventLoop::getEventLoopOfCurrentThread());
+    if (data)
+    {
+        sendRequestInLoop(*data, req, std::move(callback), timeout);
+        return;
+    }
+    // Called from a thread out of the pool, pick a loop round-robin
+    auto index =
+        nextLoop_.fetch_add(1, std::memory_order_relaxed) % loops_.size();
+    data = loops_[index].get();
+    data->loop->queueInLoop([thisPtr = shared_from_this(),
+                             data,
+                             req,
+                             callback = std::move(callback),
+                             timeout]() mutable {
+        thisPtr->sendRequestInLoop(*data, req, std::move(callback), timeout);
+    });
+}
+
+void HttpClientPoolImpl::sendRequestInLoop(LoopData &data,
+                                           const HttpRequestPtr &req,
+                                           HttpReqCallback &&callback,
+                                           double timeout)
+{
+    data.loop->assertInLoopThread();
+    auto &conn = selectConnection(data);
+    conn.lastActive = trantor::Date::now();
+    conn.client->sendRequest(
+        req,
+        [thisPtr = shared_from_this(), callback = std::move(callback)](
+            ReqResult result, const HttpResponsePtr &resp) {
+            thisPtr->outstandingRequests_.fetch_sub(1,
+                                                    std::memory_order_relaxed);
+            callback(result, resp);
+        },
+        timeout);
+}
+
+HttpClientPoolImpl::Connection &HttpClientPoolImpl::selectConnection(
+    LoopData &data)
+{
+    // Start from a different host every time so that idle connections of all
+    // hosts are used evenly.
+    auto hostsNum = data.connections.size();
+    auto start = data.nextHost++ % hostsNum;
+    Connection *best = nullptr;
+    size_t bestLoad = (std::numeric_limits<size_t>::max)();
+    size_t hostWithRoom = hostsNum;
+    for (size_t i = 0; i < hostsNum; ++i)
+    {
+        auto hostIndex = (start + i) % hostsNum;
+        auto &connections = data.connections[hostIndex];
+        if (hostWithRoom == hostsNum &&
+            connections.size() < config_.connectionsPerHost)
+        {
+            hostWithRoom = hostIndex;
+        }
+        for (auto &conn : connections)
+        {
+            auto load = conn.client->outstandingRequests();
+            if (load < bestLoad)
+            {
+                best = &conn;
+                bestLoad = load;
+            }
+        }
+    }
+    if (best && (bestLoad == 0 || hostWithRoom == hostsNum))
+    {
+        return *best;
+    }
+    // All connections are busy, open a new one if it is allowed. Without any
+    // connection, every host has room since connectionsPerHost is at least 1.
+    assert(hostWithRoom < hostsNum);
+    auto &connections = data.connections[hostWithRoom];
+    connections.push_back({newClient(data.loop, hostWithRoom), {}});
+    LOG_TRACE << "New connection to " << config_.hosts[hostWithRoom]
+              << ", connections: " << connections.size();
+    return connections.back();
+}
+
+HttpClientPtr HttpClientPoolImpl::newClient(trantor::EventLoop *loop,
+                                            size_t hostIndex)
+{
+    auto client = HttpClient::newHttpClient(config_.hosts[hostIndex],
+                                            loop,
+                                            config_.useOldTLS,
+                                            config_.validateCert);
+    client->setPipeliningDepth(config_.pipeliningDepth);
+    client->enableHttp2(config_.enableHttp2);
+    return client;
+}
+
+void HttpClientPoolImpl::evictIdleConnections(LoopData &data)
+{
+    auto now = trantor::Date::now();
+    for (auto &connections : data.connections)
+    {
+        for (auto iter = connections.begin(); iter != connections.end();)
+        {
+            if (iter->client->outstandingRequests() == 0 &&
+                iter->lastActive.after(config_.idleTimeout) < now)
+            {
+                iter = connections.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+}
+
+HttpClientPoolPtr HttpClientPool::newHttpClientPool(
+    const HttpClientPoolConfig &config,
+    std::vector<trantor::EventLoop *> loops)
+{
+    if (loops.empty())
+    {
+        auto threadNum = app().getThreadNum();
+        for (size_t i = 0; i < threadNum; ++i)
+        {
+            loops.push_back(app().getIOLoop(i));
+        }
+    }
+    auto pool = std::make_shared<HttpClientPoolImpl>(config, std::move(loops));
+    pool->init();
+    return pool;
+}
@@ -0,0 +1,81 @@
+/**
+ *
+ *  @file HttpClientPoolImpl.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by the MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/HttpClientPool.h>
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/Date.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace drogon
+{
+class HttpClientPoolImpl final
+    : public HttpClientPool,
+      public std::enable_shared_from_this<HttpClientPoolImpl>
+{
+  public:
+    HttpClientPoolImpl(const HttpClientPoolConfig &config,
+                       std::vector<trantor::EventLoop *> loops);
+    ~HttpClientPoolImpl() override;
+
+    void init();
+
+    using HttpClientPool::sendRequest;
+    void sendRequest(const HttpRequestPtr &req,
+                     HttpReqCallback &&callback,
+                     double timeout) override;
+
+    size_t outstandingRequests() const override
+    {
+        return outstandingRequests_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct Connection
+    {
+        HttpClientPtr client;
+        trantor::Date lastActive;
+    };
+
+    // Only accessed in the loop
+    struct LoopData
+    {
+        explicit LoopData(trantor::EventLoop *l) : loop(l)
+        {
+        }
+
+        trantor::EventLoop *loop;
+        // connections of every host
+        std::vector<std::vector<Connection>> connections;
+        size_t nextHost{0};
+        trantor::TimerId evictionTimer{0};
+    };
+
+    LoopData *findLoopData(trantor::EventLoop *loop);
+    void sendRequestInLoop(LoopData &data,
+                           const HttpRequestPtr &req,
+                           HttpReqCallback &&callback,
+                           double timeout);
+    Connection &selectConnection(LoopData &data);
+    HttpClientPtr newClient(trantor::EventLoop *loop, size_t hostIndex);
+    void evictIdleConnections(LoopData &data);
+
+    HttpClientPoolConfig config_;
+    std::vector<std::unique_ptr<LoopData>> loops_;
+    std::atomic<size_t> nextLoop_{0};
+    std::atomic<size_t> outstandingRequests_{0};
+};
+}  // namespace drogon
@@ -27,6 +27,23 @@ void HttpConnectionLimit::setMaxConnectionNumPerIP(size_t num)
     maxConnectionNumPerIP_ = num;
 }
 
+std::string HttpConnectionLimit::ipKey(const trantor::InetAddress &addr)
+{
+    if (addr.isIpV6())
+    {
+        return std::string(reinterpret_cast<const char *>(addr.ip6NetEndian()),
+                           16);
+    }
+    auto ip = addr.ipNetEndian();
+    return std::string(reinterpret_cast<const char *>(&ip), sizeof(ip));
+}
+
+HttpConnectionLimit::Shard &HttpConnectionLimit::shardOf(
+    const std::string &key)
+{
+    return shards_[std::hash<std::string>{}(key) % kShardsNum];
+}
+
 bool HttpConnectionLimit::tryAddConnection(
     const trantor::TcpConnectionPtr &conn)
 {
@@ -38,11 +55,12 @@ bool HttpConnectionLimit::tryAddConnection(
     }
     if (maxConnectionNumPerIP_ > 0)
     {
-        std::string ip = conn->peerAddr().toIp();
+        auto ip = ipKey(conn->peerAddr());
+        auto &shard = shardOf(ip);
         size_t numOnThisIp;
         {
-            std::lock_guard<std::mutex> lock(mutex_);
-            numOnThisIp = (++ipConnectionsMap_[ip]);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            numOnThisIp = (++shard.ipConnectionsMap[ip]);
         }
         if (numOnThisIp > maxConnectionNumPerIP_)
         {
@@ -60,14 +78,15 @@ void HttpConnectionLimit::releaseConnection(
     connectionNum_.fetch_sub(1, std::memory_order_relaxed);
     if (maxConnectionNumPerIP_ > 0)
     {
-        std::string ip = conn->peerAddr().toIp();
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto iter = ipConnectionsMap_.find(ip);
-        if (iter != ipConnectionsMap_.end())
+        auto ip = ipKey(conn->peerAddr());
+        auto &shard = shardOf(ip);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto iter = shard.ipConnectionsMap.find(ip);
+        if (iter != shard.ipConnectionsMap.end())
         {
             if (--iter->second <= 0)
             {
-                ipConnectionsMap_.erase(iter);
+                shard.ipConnectionsMap.erase(iter);
             }
         }
     }
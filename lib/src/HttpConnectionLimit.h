@@ -16,6 +16,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <array>
 #include <atomic>
 #include <cstddef>
 #include <mutex>
@@ -45,12 +46,25 @@ class HttpConnectionLimit
     void releaseConnection(const trantor::TcpConnectionPtr &conn);
 
   private:
-    std::mutex mutex_;
+    // The connections of each IP are counted in one of the shards, chosen by
+    // the hash of the IP, so the IO loops accepting or closing connections
+    // of different IPs rarely wait for the same lock.
+    static constexpr size_t kShardsNum = 64;
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, size_t> ipConnectionsMap;
+    };
+
+    // The bytes of the address, which are cheaper to get than its text.
+    static std::string ipKey(const trantor::InetAddress &addr);
+    Shard &shardOf(const std::string &key);
 
     size_t maxConnectionNum_{100000};
     std::atomic<size_t> connectionNum_{0};
 
     size_t maxConnectionNumPerIP_{0};
-    std::unordered_map<std::string, size_t> ipConnectionsMap_;
+    std::array<Shard, kShardsNum> shards_;
 };
 }  // namespace drogon
@@ -13,6 +13,7 @@
  */
 
 #include "HttpControllerBinder.h"
+#include "HttpAppFrameworkImpl.h"
 #include "HttpResponseImpl.h"
 #include <drogon/HttpSimpleController.h>
 #include <drogon/WebSocketController.h>
@@ -48,9 +49,7 @@ void HttpControllerBinder::handleRequest(
     const HttpRequestImplPtr &req,
     std::function<void(const HttpResponsePtr &)> &&callback) const
 {
-    auto &paramsVector = req->getRoutingParameters();
-    std::deque<std::string> params(paramsVector.begin(), paramsVector.end());
-    binderPtr_->handleHttpRequest(params, req, std::move(callback));
+    binderPtr_->handleHttpRequest(req, std::move(callback));
 }
 
 void WebsocketControllerBinder::handleRequest(
@@ -68,6 +67,15 @@ void WebsocketControllerBinder::handleRequest(
     resp->addHeader("Upgrade", "websocket");
     resp->addHeader("Connection", "Upgrade");
     resp->addHeader("Sec-WebSocket-Accept", base64Key);
+    auto &extensions = req->getHeaderBy("sec-websocket-extensions");
+    if (!extensions.empty() &&
+        HttpAppFrameworkImpl::instance().isWebSocketCompressionEnabled())
+    {
+        WebSocketDeflateParams params;
+        std::string agreed;
+        if (params.negotiate(extensions, agreed))
+            resp->addHeader("Sec-WebSocket-Extensions", agreed);
+    }
     callback(resp);
 }
 
@@ -23,6 +23,45 @@
 
 using namespace drogon;
 
+static constexpr std::string_view kPlaceholderPattern{"([^/]*)"};
+
+// Split a path into its segments, "/api/v1/" -> {"api", "v1", ""}
+static void splitPathSegments(std::string_view path,
+                              std::vector<std::string_view> &segments)
+{
+    assert(!path.empty() && path[0] == '/');
+    size_t start = 1;
+    while (true)
+    {
+        auto pos = path.find('/', start);
+        if (pos == std::string_view::npos)
+        {
+            segments.emplace_back(path.substr(start));
+            return;
+        }
+        segments.emplace_back(path.substr(start, pos - start));
+        start = pos + 1;
+    }
+}
+
+// A pattern can be put into the path trie only if every segment is either a
+// plain literal or a whole placeholder generated by addHttpPath().
+static bool isTrieCompatiblePattern(const std::string &pattern)
+{
+    if (pattern.empty() || pattern[0] != '/')
+        return false;
+    std::vector<std::string_view> segments;
+    splitPathSegments(pattern, segments);
+    for (auto &seg : segments)
+    {
+        if (seg == kPlaceholderPattern)
+            continue;
+        if (seg.find_first_of("\\^$.|?*+()[]{}") != std::string_view::npos)
+            return false;
+    }
+    return true;
+}
+
 void HttpControllersRouter::init(
     const std::vector<trantor::EventLoop *> & /*ioLoops*/)
 {
@@ -68,19 +107,121 @@ void HttpControllersRouter::init(
         initMiddlewaresAndCorsMethods(router);
     }
 
+    // The regexes are only compiled for the routes which the path trie
+    // can't match, see buildPathTrie(), the paths of ctrlMap_ are matched
+    // as they are.
     for (auto &router : ctrlVector_)
     {
-        router.regex_ = std::regex(router.pathParameterPattern_,
-                                   std::regex_constants::icase);
         initMiddlewaresAndCorsMethods(router);
     }
 
     for (auto &p : ctrlMap_)
     {
-        auto &router = p.second;
-        router.regex_ = std::regex(router.pathParameterPattern_,
-                                   std::regex_constants::icase);
-        initMiddlewaresAndCorsMethods(router);
+        initMiddlewaresAndCorsMethods(p.second);
+    }
+    buildPathTrie();
+}
+
+void HttpControllersRouter::buildPathTrie()
+{
+    pathTrie_ = PathTrieNode{};
+    regexOnlyItems_.clear();
+    for (size_t i = 0; i < ctrlVector_.size(); ++i)
+    {
+        auto &pattern = ctrlVector_[i].pathParameterPattern_;
+        if (!isTrieCompatiblePattern(pattern))
+        {
+            ctrlVector_[i].regex_ =
+                std::regex(pattern, std::regex_constants::icase);
+            regexOnlyItems_.push_back(i);
+            continue;
+        }
+        std::string loweredPattern(pattern.length(), 0);
+        std::transform(pattern.begin(),
+                       pattern.end(),
+                       loweredPattern.begin(),
+                       [](unsigned char c) { return tolower(c); });
+        std::vector<std::string_view> segments;
+        splitPathSegments(loweredPattern, segments);
+        auto *node = &pathTrie_;
+        for (auto &seg : segments)
+        {
+            std::unique_ptr<PathTrieNode> *child;
+            if (seg == kPlaceholderPattern)
+            {
+                child = &node->wildcard_;
+            }
+            else
+            {
+                auto iter = node->children_.find(seg);
+                if (iter == node->children_.end())
+                {
+                    iter = node->children_.emplace(std::string(seg), nullptr)
+                               .first;
+                }
+                child = &iter->second;
+            }
+            if (!*child)
+            {
+                *child = std::make_unique<PathTrieNode>();
+            }
+            node = child->get();
+        }
+        node->items_.push_back(i);
+    }
+    LOG_TRACE << ctrlVector_.size() - regexOnlyItems_.size()
+              << " regex routes compiled into the path trie, "
+              << regexOnlyItems_.size() << " routes require std::regex";
+}
+
+void HttpControllersRouter::matchPathTrie(
+    const PathTrieNode &node,
+    const std::vector<std::string_view> &segments,
+    size_t depth,
+    HttpMethod method,
+    std::vector<std::string_view> &captures,
+    size_t &bestIndex,
+    std::vector<std::string_view> &bestCaptures) const
+{
+    if (depth == segments.size())
+    {
+        // items_ is in ascending order
+        for (auto index : node.items_)
+        {
+            if (index >= bestIndex)
+                break;
+            if (ctrlVector_[index].binders_[method])
+            {
+                bestIndex = index;
+                bestCaptures = captures;
+                break;
+            }
+        }
+        return;
+    }
+    auto &seg = segments[depth];
+    auto iter = node.children_.find(seg);
+    if (iter != node.children_.end())
+    {
+        matchPathTrie(*iter->second,
+                      segments,
+                      depth + 1,
+                      method,
+                      captures,
+                      bestIndex,
+                      bestCaptures);
+    }
+    if (node.wildcard_)
+    {
+        captures.push_back(seg);
+        matchPathTrie(*node.wildcard_,
+                      segments,
+                      depth + 1,
+                      method,
+                      captures,
+                      bestIndex,
+                      bestCaptures);
+        captures.pop_back();
     }
 }
 
@@ -89,6 +230,8 @@ void HttpControllersRouter::reset()
     simpleCtrlMap_.clear();
     ctrlMap_.clear();
     ctrlVector_.clear();
+    pathTrie_ = PathTrieNode{};
+    regexOnlyItems_.clear();
     wsCtrlMap_.clear();
     wsCtrlVector_.clear();
 }
@@ -188,6 +331,8 @@ struct SimpleControllerProcessResult
     std::string lowerPath;
     std::vector<HttpMethod> validMethods;
     std::vector<std::string> middlewares;
+    bool offloaded{false};
+    bool lowPriority{false};
 };
 
 static SimpleControllerProcessResult processSimpleControllerParams(
@@ -201,6 +346,8 @@ static SimpleControllerProcessResult processSimpleControllerParams(
                    [](unsigned char c) { return tolower(c); });
     std::vector<HttpMethod> validMethods;
     std::vector<std::string> middlewareNames;
+    bool offloaded = false;
+    bool lowPriority = false;
     for (const auto &constraint : constraints)
     {
         if (constraint.type() == internal::ConstraintType::HttpMiddleware)
@@ -211,6 +358,14 @@ static SimpleControllerProcessResult processSimpleControllerParams(
         {
             validMethods.push_back(constraint.getHttpMethod());
         }
+        else if (constraint.type() == internal::ConstraintType::Offload)
+        {
+            offloaded = true;
+        }
+        else if (constraint.type() == internal::ConstraintType::LowPriority)
+        {
+            lowPriority = true;
+        }
         else
         {
             LOG_ERROR << "Invalid controller constraint type";
@@ -221,6 +376,8 @@ static SimpleControllerProcessResult processSimpleControllerParams(
         std::move(path),
         std::move(validMethods),
         std::move(middlewareNames),
+        offloaded,
+        lowPriority,
     };
 }
 
@@ -240,6 +397,8 @@ void HttpControllersRouter::registerHttpSimpleController(
     auto binder = std::make_shared<HttpSimpleControllerBinder>();
     binder->handlerName_ = ctrlName;
     binder->middlewareNames_ = result.middlewares;
+    binder->offloaded_ = result.offloaded;
+    binder->lowPriority_ = result.lowPriority;
     drogon::app().getLoop()->queueInLoop([this, binder, ctrlName, path]() {
         auto &object_ = DrClassMap::getSingleInstance(ctrlName);
         auto controller =
@@ -266,6 +425,12 @@ void HttpControllersRouter::registerWebSocketController(
     assert(!pathName.empty());
     assert(!ctrlName.empty());
     auto result = processSimpleControllerParams(pathName, constraints);
+    if (result.offloaded || result.lowPriority)
+    {
+        LOG_WARN << "The Offload and LowPriority constraints of the websocket "
+                    "controller "
+                 << ctrlName << " are ignored";
+    }
     std::string path = std::move(result.lowerPath);
 
     auto &item = wsCtrlMap_[path];
@@ -297,6 +462,12 @@ void HttpControllersRouter::registerWebSocketControllerRegex(
     assert(!regExp.empty());
     assert(!ctrlName.empty());
     auto result = processSimpleControllerParams(regExp, constraints);
+    if (result.offloaded || result.lowPriority)
+    {
+        LOG_WARN << "The Offload and LowPriority constraints of the websocket "
+                    "controller "
+                 << ctrlName << " are ignored";
+    }
     auto binder = std::make_shared<WebsocketControllerBinder>();
     binder->handlerName_ = ctrlName;
     binder->middlewareNames_ = result.middlewares;
@@ -324,6 +495,8 @@ void HttpControllersRouter::addHttpRegex(
     binderInfo->middlewareNames_ = middlewareNames;
     binderInfo->handlerName_ = handlerName;
     binderInfo->binderPtr_ = binder;
+    binderInfo->offloaded_ = binder->isOffloaded();
+    binderInfo->lowPriority_ = binder->isLowPriority();
     drogon::app().getLoop()->queueInLoop([binderInfo]() {
         // Recreate this with the correct number of threads.
         binderInfo->responseCache_ = IOThreadStorage<HttpResponsePtr>();
@@ -552,6 +725,8 @@ void HttpControllersRouter::addHttpPath(
     binderInfo->middlewareNames_ = middlewareNames;
     binderInfo->handlerName_ = handlerName;
     binderInfo->binderPtr_ = binder;
+    binderInfo->offloaded_ = binder->isOffloaded();
+    binderInfo->lowPriority_ = binder->isLowPriority();
     binderInfo->parameterPlaces_ = std::move(places);
     binderInfo->queryParametersPlaces_ = std::move(parametersPlaces);
     drogon::app().getLoop()->queueInLoop([binderInfo]() {
@@ -623,25 +798,48 @@ RouteResult HttpControllersRouter::route(const HttpRequestImplPtr &req)
     // Find http controller
     HttpControllerRouterItem *routerItemPtr = nullptr;
     std::smatch result;
+    std::vector<std::string_view> trieCaptures;
+    bool matchedByRegex{false};
     auto it = ctrlMap_.find(loweredPath);
-    // Try to find a controller in the hash map. If can't linear search
-    // with regex.
+    // Try to find a controller in the hash map. If can't, look up the path
+    // trie and then try the routes which can only be matched by regex. The
+    // first registered matching route wins, same as a linear search.
     if (it != ctrlMap_.end())
     {
         routerItemPtr = &it->second;
     }
-    else
+    else if (!ctrlVector_.empty())
     {
-        for (auto &item : ctrlVector_)
+        size_t bestIndex = ctrlVector_.size();
+        {
+            std::vector<std::string_view> segments;
+            std::vector<std::string_view> captures;
+            splitPathSegments(loweredPath, segments);
+            matchPathTrie(pathTrie_,
+                          segments,
+                          0,
+                          req->method(),
+                          captures,
+                          bestIndex,
+                          trieCaptures);
+        }
+        for (auto index : regexOnlyItems_)
         {
-            const auto &ctrlRegex = item.regex_;
+            if (index >= bestIndex)
+                break;
+            auto &item = ctrlVector_[index];
             if (item.binders_[req->method()] &&
-                std::regex_match(req->path(), result, ctrlRegex))
+                std::regex_match(req->path(), result, item.regex_))
             {
-                routerItemPtr = &item;
+                bestIndex = index;
+                matchedByRegex = true;
                 break;
             }
         }
+        if (bestIndex < ctrlVector_.size())
+        {
+            routerItemPtr = &ctrlVector_[bestIndex];
+        }
     }
 
     // No handler found
@@ -658,10 +856,7 @@ RouteResult HttpControllersRouter::route(const HttpRequestImplPtr &req)
         return {RouteResult::MethodNotAllowed, nullptr};
     }
     std::vector<std::string> params;
-    for (size_t j = 1; j < result.size(); ++j)
-    {
-        if (!result[j].matched)
-            continue;
+    auto placeParameter = [&params, &binder](size_t j, std::string_view para) {
         size_t place = j;
         if (j <= binder->parameterPlaces_.size())
         {
@@ -669,8 +864,30 @@ RouteResult HttpControllersRouter::route(const HttpRequestImplPtr &req)
         }
         if (place > params.size())
             params.resize(place);
-        params[place - 1] = result[j].str();
+        params[place - 1] = std::string(para);
         LOG_TRACE << "place=" << place << " para:" << params[place - 1];
+    };
+    if (matchedByRegex)
+    {
+        for (size_t j = 1; j < result.size(); ++j)
+        {
+            if (!result[j].matched)
+                continue;
+            placeParameter(j, result[j].str());
+        }
+    }
+    else
+    {
+        // Captures point into loweredPath, take the original characters
+        const auto &path = req->path();
+        for (size_t j = 0; j < trieCaptures.size(); ++j)
+        {
+            auto offset =
+                static_cast<size_t>(trieCaptures[j].data() - loweredPath.data());
+            placeParameter(j + 1,
+                           std::string_view(path.data() + offset,
+                                            trieCaptures[j].length()));
+        }
     }
 
     if (!binder->queryParametersPlaces_.empty())
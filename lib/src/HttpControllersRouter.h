@@ -17,9 +17,11 @@
 #include "impl_forwards.h"
 #include "ControllerBinderBase.h"
 #include <trantor/utils/NonCopyable.h>
+#include <map>
 #include <memory>
 #include <regex>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
@@ -74,6 +76,7 @@ class HttpControllersRouter : public trantor::NonCopyable
         const std::string &pathPattern,
         const std::string &pathParameterPattern,
         const std::vector<HttpMethod> &methods);
+    void buildPathTrie();
 
     struct SimpleControllerRouterItem
     {
@@ -84,6 +87,7 @@ class HttpControllersRouter : public trantor::NonCopyable
     {
         std::string pathParameterPattern_;
         std::string pathPattern_;
+        // Only compiled for the routes the path trie can't match
         std::regex regex_;
         std::shared_ptr<HttpControllerBinder> binders_[Invalid]{nullptr};
     };
@@ -100,9 +104,34 @@ class HttpControllersRouter : public trantor::NonCopyable
         std::shared_ptr<WebsocketControllerBinder> binders_[Invalid]{nullptr};
     };
 
+    /**
+     * @brief A path-segment trie compiled from the parameterized routes in
+     * ctrlVector_. Literal segments are children_ keys (lower case), a
+     * placeholder segment ("([^/]*)") is the wildcard_ child. Items remember
+     * their index in ctrlVector_ so the registration order is respected.
+     */
+    struct PathTrieNode
+    {
+        std::map<std::string, std::unique_ptr<PathTrieNode>, std::less<>>
+            children_;
+        std::unique_ptr<PathTrieNode> wildcard_;
+        std::vector<size_t> items_;
+    };
+
+    void matchPathTrie(const PathTrieNode &node,
+                       const std::vector<std::string_view> &segments,
+                       size_t depth,
+                       HttpMethod method,
+                       std::vector<std::string_view> &captures,
+                       size_t &bestIndex,
+                       std::vector<std::string_view> &bestCaptures) const;
+
     std::unordered_map<std::string, SimpleControllerRouterItem> simpleCtrlMap_;
     std::unordered_map<std::string, HttpControllerRouterItem> ctrlMap_;
     std::vector<HttpControllerRouterItem> ctrlVector_;  // for regexp path
+    PathTrieNode pathTrie_;
+    // indices of ctrlVector_ items which can't be matched by pathTrie_
+    std::vector<size_t> regexOnlyItems_;
     std::unordered_map<std::string, WebSocketControllerRouterItem> wsCtrlMap_;
     std::vector<RegExWebSocketControllerRouterItem> wsCtrlVector_;
 };
@@ -23,6 +23,25 @@
 
 using namespace drogon;
 
+HttpFileImpl::~HttpFileImpl()
+{
+    if (ownsFile_)
+    {
+        mappedFile_.reset();
+        std::error_code err;
+        std::filesystem::remove(utils::toNativePath(filePath_), err);
+    }
+}
+
+void HttpFileImpl::mapFile() const noexcept
+{
+    mappedFile_ = MappedFile::open(filePath_);
+    if (mappedFile_)
+        fileContent_ = mappedFile_->data();
+    else
+        LOG_ERROR << "Can't map the uploaded file " << filePath_;
+}
+
 int HttpFileImpl::save() const noexcept
 {
     return save(HttpAppFrameworkImpl::instance().getUploadPath());
@@ -113,6 +132,36 @@ int HttpFileImpl::saveTo(
 {
     LOG_TRACE << "save uploaded file:" << pathAndFileName;
     auto wPath = utils::toNativePath(pathAndFileName.native());
+    if (!filePath_.empty())
+    {
+        // The contents are on disk already, the temporary file is moved, or
+        // the file saved before is copied.
+        std::error_code err;
+        std::filesystem::path source(utils::toNativePath(filePath_));
+        if (ownsFile_)
+        {
+            std::filesystem::rename(source, wPath, err);
+            if (!err)
+            {
+                filePath_ = utils::fromNativePath(wPath);
+                ownsFile_ = false;
+                return 0;
+            }
+            // On another file system
+            err.clear();
+        }
+        std::filesystem::copy_file(
+            source,
+            wPath,
+            std::filesystem::copy_options::overwrite_existing,
+            err);
+        if (err)
+        {
+            LOG_ERROR << "save failed! " << err.message();
+            return -1;
+        }
+        return 0;
+    }
     std::ofstream file(wPath, std::ios::binary);
     if (file.is_open())
     {
@@ -129,17 +178,26 @@ int HttpFileImpl::saveTo(
 
 std::string HttpFileImpl::getMd5() const noexcept
 {
-    return utils::getMd5(fileContent_.data(), fileContent_.size());
+    if (!md5_.empty())
+        return md5_;
+    auto &content = fileContent();
+    return utils::getMd5(content.data(), content.size());
 }
 
 std::string HttpFileImpl::getSha256() const noexcept
 {
-    return utils::getSha256(fileContent_.data(), fileContent_.size());
+    if (!sha256_.empty())
+        return sha256_;
+    auto &content = fileContent();
+    return utils::getSha256(content.data(), content.size());
 }
 
 std::string HttpFileImpl::getSha3() const noexcept
 {
-    return utils::getSha3(fileContent_.data(), fileContent_.size());
+    if (!sha3_.empty())
+        return sha3_;
+    auto &content = fileContent();
+    return utils::getSha3(content.data(), content.size());
 }
 
 const std::string &HttpFile::getFileName() const noexcept
@@ -202,6 +260,16 @@ std::string HttpFile::getMd5() const noexcept
     return implPtr_->getMd5();
 }
 
+std::string HttpFile::getSha256() const noexcept
+{
+    return implPtr_->getSha256();
+}
+
+std::string HttpFile::getSha3() const noexcept
+{
+    return implPtr_->getSha3();
+}
+
 const std::string &HttpFile::getContentTransferEncoding() const noexcept
 {
     return implPtr_->getContentTransferEncoding();
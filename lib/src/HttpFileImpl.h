@@ -14,6 +14,7 @@
 
 #pragma once
 #include "HttpUtils.h"
+#include "MappedFile.h"
 #include <drogon/HttpRequest.h>
 
 #include <map>
@@ -28,6 +29,11 @@ namespace drogon
 class HttpFileImpl
 {
   public:
+    HttpFileImpl() = default;
+    HttpFileImpl(const HttpFileImpl &) = delete;
+    HttpFileImpl &operator=(const HttpFileImpl &) = delete;
+    ~HttpFileImpl();
+
     /// Return the file name;
     const std::string &getFileName() const noexcept
     {
@@ -58,6 +64,27 @@ class HttpFileImpl
         fileContent_ = std::string_view{data, length};
     }
 
+    /// Set the temporary file holding the contents, written by the stream
+    /// reader of MultiPartParser. It is moved to its destination by the
+    /// first saving, and removed with this object if it is never saved.
+    void setTmpFile(std::string path, size_t length) noexcept
+    {
+        filePath_ = std::move(path);
+        fileLength_ = length;
+        ownsFile_ = true;
+    }
+
+    /// Set the digests computed while the file was received, the empty ones
+    /// are computed when they are asked for.
+    void setDigests(std::string md5,
+                    std::string sha256,
+                    std::string sha3) noexcept
+    {
+        md5_ = std::move(md5);
+        sha256_ = std::move(sha256);
+        sha3_ = std::move(sha3);
+    }
+
     /// Save the file to the file system.
     /**
      * The folder saving the file is app().getUploadPath().
@@ -85,16 +112,21 @@ class HttpFileImpl
     /// Return the file length.
     size_t fileLength() const noexcept
     {
+        if (!filePath_.empty())
+            return fileLength_;
         return fileContent_.length();
     }
 
     const char *fileData() const noexcept
     {
-        return fileContent_.data();
+        return fileContent().data();
     }
 
+    /// The contents of a file on disk are mapped at the first call.
     const std::string_view &fileContent() const noexcept
     {
+        if (!filePath_.empty() && !mappedFile_ && fileLength_ > 0)
+            mapFile();
         return fileContent_;
     }
 
@@ -165,11 +197,22 @@ class HttpFileImpl
     }
 
   private:
+    void mapFile() const noexcept;
+
     std::string fileName_;
     std::string itemName_;
     std::string transferEncoding_;
-    std::string_view fileContent_;
+    mutable std::string_view fileContent_;
     HttpRequestPtr requestPtr_;
     drogon::ContentType contentType_{drogon::CT_NONE};
+    // The file on disk holding the contents, if any, and whether it is the
+    // temporary one to be moved or removed.
+    mutable std::string filePath_;
+    size_t fileLength_{0};
+    mutable bool ownsFile_{false};
+    mutable std::shared_ptr<MappedFile> mappedFile_;
+    std::string md5_;
+    std::string sha256_;
+    std::string sha3_;
 };
 }  // namespace drogon
@@ -26,10 +26,11 @@ class HttpMessageBody
     {
         kNone = 0,
         kString,
-        kStringView
+        kStringView,
+        kShared
     };
 
-    BodyType bodyType()
+    BodyType bodyType() const
     {
         return type_;
     }
@@ -142,4 +143,50 @@ class HttpMessageStringViewBody : public HttpMessageBody
     std::string_view body_;
 };
 
+/**
+ * @brief An immutable body shared by many messages, for example the cached
+ * responses of a static file in all IO loops. The body is a view of the
+ * memory kept alive by the owner, such as a string or a mapped file.
+ */
+class HttpMessageSharedBody : public HttpMessageBody
+{
+  public:
+    explicit HttpMessageSharedBody(std::shared_ptr<const std::string> body)
+        : body_(*body), owner_(std::move(body))
+    {
+        type_ = BodyType::kShared;
+    }
+
+    HttpMessageSharedBody(std::shared_ptr<const void> owner,
+                          std::string_view body)
+        : body_(body), owner_(std::move(owner))
+    {
+        type_ = BodyType::kShared;
+    }
+
+    const char *data() const override
+    {
+        return body_.data();
+    }
+
+    char *data() override
+    {
+        return const_cast<char *>(body_.data());
+    }
+
+    size_t length() const override
+    {
+        return body_.length();
+    }
+
+    std::string_view getString() const override
+    {
+        return body_;
+    }
+
+  private:
+    std::string_view body_;
+    std::shared_ptr<const void> owner_;
+};
+
 }  // namespace drogon
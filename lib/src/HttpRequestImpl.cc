@@ -13,10 +13,15 @@
  */
 
 #include "HttpRequestImpl.h"
+#include "BuiltinMetrics.h"
 #include "HttpFileUploadRequest.h"
 #include "HttpAppFrameworkImpl.h"
+#include "HttpServer.h"
+#include "MemoryPressure.h"
+#include "ZlibStreams.h"
 
 #include <drogon/utils/Utilities.h>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #ifndef _WIN32
@@ -39,20 +44,9 @@ void HttpRequestImpl::parseJson() const
         getHeaderBy("content-type").find("application/json") !=
             std::string::npos)
     {
-        static std::once_flag once;
-        static Json::CharReaderBuilder builder;
-        std::call_once(once, []() {
-            builder["collectComments"] = false;
-            builder["stackLimit"] = static_cast<Json::UInt>(
-                drogon::app().getJsonParserStackLimit());
-        });
         jsonPtr_ = std::make_shared<Json::Value>();
-        JSONCPP_STRING errs;
-        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-        if (!reader->parse(input.data(),
-                           input.data() + input.size(),
-                           jsonPtr_.get(),
-                           &errs))
+        std::string errs;
+        if (!app().getJsonEngine()->parse(input, *jsonPtr_, errs))
         {
             LOG_DEBUG << errs;
             jsonPtr_.reset();
@@ -72,122 +66,98 @@ void HttpRequestImpl::parseJson() const
     }
 }
 
-void HttpRequestImpl::parseParameters() const
+/**
+ * @brief Call the callback with the raw key and value of every parameter of
+ * an urlencoded string, the leading spaces of the keys are removed.
+ */
+template <typename Callback>
+static void forEachParameter(std::string_view input, const Callback &callback)
 {
-    auto input = queryView();
-    if (!input.empty())
+    std::string_view::size_type pos = 0;
+    while (pos < input.length() &&
+           (input[pos] == '?' ||
+            isspace(static_cast<unsigned char>(input[pos]))))
     {
-        std::string_view::size_type pos = 0;
-        while ((input[pos] == '?' ||
-                isspace(static_cast<unsigned char>(input[pos]))) &&
-               pos < input.length())
+        ++pos;
+    }
+    input.remove_prefix(pos);
+    while (!input.empty())
+    {
+        auto end = input.find('&');
+        auto coo = input.substr(0, end);
+        auto epos = coo.find('=');
+        if (epos != std::string_view::npos)
         {
-            ++pos;
+            auto key = coo.substr(0, epos);
+            std::string_view::size_type cpos = 0;
+            while (cpos < key.length() &&
+                   isspace(static_cast<unsigned char>(key[cpos])))
+                ++cpos;
+            key.remove_prefix(cpos);
+            callback(key, coo.substr(epos + 1));
         }
-        auto value = input.substr(pos);
-        while ((pos = value.find('&')) != std::string_view::npos)
+        else
         {
-            auto coo = value.substr(0, pos);
-            auto epos = coo.find('=');
-            if (epos != std::string_view::npos)
-            {
-                auto key = coo.substr(0, epos);
-                std::string_view::size_type cpos = 0;
-                while (cpos < key.length() &&
-                       isspace(static_cast<unsigned char>(key[cpos])))
-                    ++cpos;
-                key.remove_prefix(cpos);
-                auto pvalue = coo.substr(epos + 1);
-                parameters_[utils::urlDecode(key)] = utils::urlDecode(pvalue);
-            }
-            else
-            {
-                parameters_[utils::urlDecode(coo)];
-            }
-            value.remove_prefix(pos + 1);
-        }
-        if (value.length() > 0)
-        {
-            auto &coo = value;
-            auto epos = coo.find('=');
-            if (epos != std::string_view::npos)
-            {
-                auto key = coo.substr(0, epos);
-                std::string_view::size_type cpos = 0;
-                while (cpos < key.length() &&
-                       isspace(static_cast<unsigned char>(key[cpos])))
-                    ++cpos;
-                key.remove_prefix(cpos);
-                auto pvalue = coo.substr(epos + 1);
-                parameters_[utils::urlDecode(key)] = utils::urlDecode(pvalue);
-            }
-            else
-            {
-                parameters_[utils::urlDecode(coo)];
-            }
+            callback(coo, std::string_view{});
         }
+        if (end == std::string_view::npos)
+            break;
+        input.remove_prefix(end + 1);
     }
+}
 
-    input = contentView();
-    if (input.empty())
-        return;
+static bool needDecoding(std::string_view str)
+{
+    return utils::needUrlDecoding(str.data(), str.data() + str.length());
+}
+
+bool HttpRequestImpl::hasFormParameters() const
+{
+    if (contentView().empty())
+        return false;
     std::string type = getHeaderBy("content-type");
     std::transform(type.begin(), type.end(), type.begin(), [](unsigned char c) {
         return tolower(c);
     });
-    if (type.empty() ||
-        type.find("application/x-www-form-urlencoded") != std::string::npos)
+    return type.empty() ||
+           type.find("application/x-www-form-urlencoded") != std::string::npos;
+}
+
+void HttpRequestImpl::parseParameters() const
+{
+    auto addParameter = [this](std::string_view key, std::string_view value) {
+        parameters_[utils::urlDecode(key)] = utils::urlDecode(value);
+    };
+    forEachParameter(queryView(), addParameter);
+    if (hasFormParameters())
+        forEachParameter(contentView(), addParameter);
+}
+
+std::optional<std::string_view> HttpRequestImpl::getParameterView(
+    std::string_view key) const
+{
+    if (flagForParsingParameters_)
     {
-        std::string_view::size_type pos = 0;
-        while ((input[pos] == '?' ||
-                isspace(static_cast<unsigned char>(input[pos]))) &&
-               pos < input.length())
-        {
-            ++pos;
-        }
-        auto value = input.substr(pos);
-        while ((pos = value.find('&')) != std::string_view::npos)
-        {
-            auto coo = value.substr(0, pos);
-            auto epos = coo.find('=');
-            if (epos != std::string_view::npos)
-            {
-                auto key = coo.substr(0, epos);
-                std::string_view::size_type cpos = 0;
-                while (cpos < key.length() &&
-                       isspace(static_cast<unsigned char>(key[cpos])))
-                    ++cpos;
-                key.remove_prefix(cpos);
-                auto pvalue = coo.substr(epos + 1);
-                parameters_[utils::urlDecode(key)] = utils::urlDecode(pvalue);
-            }
-            else
-            {
-                parameters_[utils::urlDecode(coo)];
-            }
-            value.remove_prefix(pos + 1);
-        }
-        if (value.length() > 0)
-        {
-            auto &coo = value;
-            auto epos = coo.find('=');
-            if (epos != std::string_view::npos)
-            {
-                auto key = coo.substr(0, epos);
-                std::string_view::size_type cpos = 0;
-                while (cpos < key.length() &&
-                       isspace(static_cast<unsigned char>(key[cpos])))
-                    ++cpos;
-                key.remove_prefix(cpos);
-                auto pvalue = coo.substr(epos + 1);
-                parameters_[utils::urlDecode(key)] = utils::urlDecode(pvalue);
-            }
-            else
-            {
-                parameters_[utils::urlDecode(coo)];
-            }
-        }
+        auto iter = parameters_.find(std::string(key));
+        if (iter == parameters_.end())
+            return std::nullopt;
+        return std::string_view(iter->second);
     }
+    // The last one wins like in parameters(), and the body comes after the
+    // query.
+    std::optional<std::string_view> found;
+    auto findParameter = [key, &found](std::string_view rawKey,
+                                       std::string_view value) {
+        if (needDecoding(rawKey) ? utils::urlDecode(rawKey) == key
+                                 : rawKey == key)
+            found = value;
+    };
+    forEachParameter(queryView(), findParameter);
+    if (hasFormParameters())
+        forEachParameter(contentView(), findParameter);
+    if (!found || !needDecoding(*found))
+        return found;
+    return arena().copy(utils::urlDecode(*found));
 }
 
 void HttpRequestImpl::appendToBuffer(trantor::MsgBuffer *output) const
@@ -381,7 +351,33 @@ void HttpRequestImpl::appendToBuffer(trantor::MsgBuffer *output) const
     assert(!(!content_.empty() && !cachedBody.empty()));
     if (!passThrough_)
     {
-        if (!content.empty() || !content_.empty() || !cachedBody.empty())
+        if (hasExternalBody())
+        {
+            // The body is sent by the client after the header, in chunks
+            // unless it's a file.
+            if (sendfileName_.empty())
+            {
+                output->append("transfer-encoding: chunked\r\n");
+            }
+            else
+            {
+                char buf[64];
+                auto len =
+                    snprintf(buf,
+                             sizeof(buf),
+                             contentLengthFormatString<size_t>(),
+                             sendfileRange_.second);
+                output->append(buf, len);
+            }
+            if (contentTypeString_.empty())
+            {
+                auto &type = contentTypeToMime(contentType_);
+                output->append("content-type: ");
+                output->append(type.data(), type.length());
+                output->append("\r\n");
+            }
+        }
+        else if (!content.empty() || !content_.empty() || !cachedBody.empty())
         {
             char buf[64];
             auto len = snprintf(
@@ -410,6 +406,18 @@ void HttpRequestImpl::appendToBuffer(trantor::MsgBuffer *output) const
             output->append("\r\n");
         }
     }
+    materializeHeaders();
+    for (size_t i = 0; i < knownHeaders_.size(); ++i)
+    {
+        if (knownHeadersMask_ & (1u << i))
+        {
+            output->append(knownHeaderNames_[i].data(),
+                           knownHeaderNames_[i].length());
+            output->append(": ");
+            output->append(knownHeaders_[i]);
+            output->append("\r\n");
+        }
+    }
     for (auto it = headers_.begin(); it != headers_.end(); ++it)
     {
         output->append(it->first);
@@ -417,6 +425,7 @@ void HttpRequestImpl::appendToBuffer(trantor::MsgBuffer *output) const
         output->append(it->second);
         output->append("\r\n");
     }
+    parseCookies();
     if (cookies_.size() > 0)
     {
         output->append("cookie: ");
@@ -444,103 +453,250 @@ void HttpRequestImpl::addHeader(const char *start,
                                 const char *colon,
                                 const char *end)
 {
+    const char *valueStart = colon + 1;
+    while (valueStart < end && isspace(static_cast<unsigned char>(*valueStart)))
+    {
+        ++valueStart;
+    }
+    const char *valueEnd = end;
+    while (valueEnd > valueStart &&
+           isspace(static_cast<unsigned char>(*(valueEnd - 1))))
+    {
+        --valueEnd;
+    }
+    if (useHeaderViews_)
+    {
+        // Copy the header to the raw buffer which keeps its capacity when the
+        // request object is reused, so no allocation is made in most cases.
+        HeaderView view;
+        view.fieldOffset = static_cast<uint32_t>(rawHeaders_.size());
+        view.fieldLength = static_cast<uint32_t>(colon - start);
+        for (auto p = start; p < colon; ++p)
+        {
+            rawHeaders_.push_back(static_cast<char>(
+                tolower(static_cast<unsigned char>(*p))));
+        }
+        view.valueOffset = static_cast<uint32_t>(rawHeaders_.size());
+        view.valueLength = static_cast<uint32_t>(valueEnd - valueStart);
+        rawHeaders_.append(valueStart, valueEnd);
+        auto field = fieldOf(view);
+        if (field.length() == 6 && field == "cookie")
+        {
+            addCookieHeader(valueOf(view));
+            rawHeaders_.resize(view.fieldOffset);
+            return;
+        }
+        processSpecialHeader(field, valueOf(view));
+        auto index = knownHeaderIndex(field);
+        if (index >= 0 && !knownHeadersMerged_)
+        {
+            // Keep the first one of duplicated headers like headers_ does.
+            if (!(knownHeadersMask_ & (1u << index)))
+                setKnownHeader(index, valueOf(view));
+            rawHeaders_.resize(view.fieldOffset);
+            return;
+        }
+        headerViews_.push_back(view);
+        return;
+    }
     std::string field(start, colon);
     // Field name is case-insensitive.so we transform it to lower;(rfc2616-4.2)
     std::transform(field.begin(),
                    field.end(),
                    field.begin(),
                    [](unsigned char c) { return tolower(c); });
-    ++colon;
-    while (colon < end && isspace(static_cast<unsigned char>(*colon)))
+    std::string value(valueStart, valueEnd);
+    if (field.length() == 6 && field == "cookie")
     {
-        ++colon;
+        addCookieHeader(value);
     }
-    std::string value(colon, end);
-    while (!value.empty() &&
-           isspace(static_cast<unsigned char>(value[value.size() - 1])))
+    else
     {
-        value.resize(value.size() - 1);
+        processSpecialHeader(field, value);
+        auto index = knownHeaderIndex(field);
+        if (index < 0 || knownHeadersMerged_)
+        {
+            headers_.emplace(std::move(field), std::move(value));
+        }
+        else if (!(knownHeadersMask_ & (1u << index)))
+        {
+            setKnownHeader(index, std::move(value));
+        }
     }
-    if (field.length() == 6 && field == "cookie")
+}
+
+const std::string_view HttpRequestImpl::knownHeaderNames_[] = {
+    "host",
+    "range",
+    "origin",
+    "expect",
+    "upgrade",
+    "connection",
+    "content-type",
+    "if-none-match",
+    "content-length",
+    "accept-encoding",
+    "content-encoding",
+    "transfer-encoding",
+    "if-modified-since"};
+
+int HttpRequestImpl::knownHeaderIndex(std::string_view lowerField)
+{
+    // The length and the first character of the names are a perfect hash.
+    KnownHeader header;
+    switch (lowerField.length())
+    {
+        case 4:
+            header = KnownHeader::kHost;
+            break;
+        case 5:
+            header = KnownHeader::kRange;
+            break;
+        case 6:
+            header = lowerField[0] == 'o' ? KnownHeader::kOrigin
+                                          : KnownHeader::kExpect;
+            break;
+        case 7:
+            header = KnownHeader::kUpgrade;
+            break;
+        case 10:
+            header = KnownHeader::kConnection;
+            break;
+        case 12:
+            header = KnownHeader::kContentType;
+            break;
+        case 13:
+            header = KnownHeader::kIfNoneMatch;
+            break;
+        case 14:
+            header = KnownHeader::kContentLength;
+            break;
+        case 15:
+            header = KnownHeader::kAcceptEncoding;
+            break;
+        case 16:
+            header = KnownHeader::kContentEncoding;
+            break;
+        case 17:
+            header = lowerField[0] == 't' ? KnownHeader::kTransferEncoding
+                                          : KnownHeader::kIfModifiedSince;
+            break;
+        default:
+            return -1;
+    }
+    auto index = static_cast<int>(header);
+    return lowerField == knownHeaderNames_[index] ? index : -1;
+}
+
+void HttpRequestImpl::mergeKnownHeaders() const
+{
+    if (knownHeadersMerged_)
+        return;
+    for (size_t i = 0; i < knownHeaders_.size(); ++i)
     {
-        LOG_TRACE << "cookies!!!:" << value;
-        std::string::size_type pos;
-        while ((pos = value.find(';')) != std::string::npos)
+        if (knownHeadersMask_ & (1u << i))
         {
-            std::string coo = value.substr(0, pos);
-            auto epos = coo.find('=');
-            if (epos != std::string::npos)
-            {
-                std::string cookie_name = coo.substr(0, epos);
-                std::string::size_type cpos = 0;
-                while (cpos < cookie_name.length() &&
-                       isspace(static_cast<unsigned char>(cookie_name[cpos])))
-                    ++cpos;
-                cookie_name = cookie_name.substr(cpos);
-                std::string cookie_value = coo.substr(epos + 1);
-                cpos = 0;
-                while (cpos < cookie_value.length() &&
-                       isspace(static_cast<unsigned char>(cookie_value[cpos])))
-                    ++cpos;
-                cookie_value = cookie_value.substr(cpos);
-                cookies_[std::move(cookie_name)] = std::move(cookie_value);
-            }
-            value = value.substr(pos + 1);
+            headers_[std::string(knownHeaderNames_[i])] =
+                std::move(knownHeaders_[i]);
+            knownHeaders_[i].clear();
         }
-        if (value.length() > 0)
+    }
+    knownHeadersMask_ = 0;
+    knownHeadersMerged_ = true;
+}
+
+void HttpRequestImpl::materializeHeaders() const
+{
+    if (headerViews_.empty())
+        return;
+    for (auto &view : headerViews_)
+    {
+        // Keep the first one of duplicated headers like addHeader() does.
+        headers_.emplace(std::string(fieldOf(view)),
+                         std::string(valueOf(view)));
+    }
+    headerViews_.clear();
+}
+
+void HttpRequestImpl::addCookieHeader(std::string_view value)
+{
+    if (flagForParsingCookies_)
+    {
+        // Added after the cookies were looked up
+        cookieHeader_.assign(value.data(), value.length());
+        flagForParsingCookies_ = false;
+        parseCookies();
+        return;
+    }
+    if (!cookieHeader_.empty())
+        cookieHeader_.append("; ");
+    cookieHeader_.append(value.data(), value.length());
+}
+
+void HttpRequestImpl::parseCookies() const
+{
+    if (flagForParsingCookies_)
+        return;
+    flagForParsingCookies_ = true;
+    if (cookieHeader_.empty())
+        return;
+    LOG_TRACE << "cookies!!!:" << cookieHeader_;
+    std::string_view value{cookieHeader_};
+    auto ltrim = [](std::string_view str) {
+        size_t pos = 0;
+        while (pos < str.length() &&
+               isspace(static_cast<unsigned char>(str[pos])))
+            ++pos;
+        return str.substr(pos);
+    };
+    while (!value.empty())
+    {
+        auto pos = value.find(';');
+        auto coo = value.substr(0, pos);
+        auto epos = coo.find('=');
+        if (epos != std::string_view::npos)
         {
-            std::string &coo = value;
-            auto epos = coo.find('=');
-            if (epos != std::string::npos)
-            {
-                std::string cookie_name = coo.substr(0, epos);
-                std::string::size_type cpos = 0;
-                while (cpos < cookie_name.length() &&
-                       isspace(static_cast<unsigned char>(cookie_name[cpos])))
-                    ++cpos;
-                cookie_name = cookie_name.substr(cpos);
-                std::string cookie_value = coo.substr(epos + 1);
-                cpos = 0;
-                while (cpos < cookie_value.length() &&
-                       isspace(static_cast<unsigned char>(cookie_value[cpos])))
-                    ++cpos;
-                cookie_value = cookie_value.substr(cpos);
-                cookies_[std::move(cookie_name)] = std::move(cookie_value);
-            }
+            auto cookieName = ltrim(coo.substr(0, epos));
+            auto cookieValue = ltrim(coo.substr(epos + 1));
+            cookies_[std::string(cookieName)] = std::string(cookieValue);
         }
+        if (pos == std::string_view::npos)
+            break;
+        value = value.substr(pos + 1);
     }
-    else
+}
+
+void HttpRequestImpl::processSpecialHeader(std::string_view field,
+                                           std::string_view value)
+{
+    switch (field.length())
     {
-        switch (field.length())
+        case 6:
+            if (field == "expect")
+            {
+                expectPtr_ = std::make_unique<std::string>(value);
+            }
+            break;
+        case 10:
         {
-            case 6:
-                if (field == "expect")
+            if (field == "connection")
+            {
+                if (version_ == Version::kHttp11)
                 {
-                    expectPtr_ = std::make_unique<std::string>(value);
+                    if (value.length() == 5 && value == "close")
+                        keepAlive_ = false;
                 }
-                break;
-            case 10:
-            {
-                if (field == "connection")
+                else if (value.length() == 10 &&
+                         (value == "Keep-Alive" || value == "keep-alive"))
                 {
-                    if (version_ == Version::kHttp11)
-                    {
-                        if (value.length() == 5 && value == "close")
-                            keepAlive_ = false;
-                    }
-                    else if (value.length() == 10 &&
-                             (value == "Keep-Alive" || value == "keep-alive"))
-                    {
-                        keepAlive_ = true;
-                    }
+                    keepAlive_ = true;
                 }
             }
-            break;
-
-            default:
-                break;
         }
-        headers_.emplace(std::move(field), std::move(value));
+        break;
+
+        default:
+            break;
     }
 }
 
@@ -564,27 +720,13 @@ HttpRequestPtr HttpRequest::newHttpFormPostRequest()
 
 HttpRequestPtr HttpRequest::newHttpJsonRequest(const Json::Value &data)
 {
-    static std::once_flag once;
-    static Json::StreamWriterBuilder builder;
-    std::call_once(once, []() {
-        builder["commentStyle"] = "None";
-        builder["indentation"] = "";
-        if (!app().isUnicodeEscapingUsedInJson())
-        {
-            builder["emitUTF8"] = true;
-        }
-        auto &precision = app().getFloatPrecisionInJson();
-        if (precision.first != 0)
-        {
-            builder["precision"] = precision.first;
-            builder["precisionType"] = precision.second;
-        }
-    });
     auto req = std::make_shared<HttpRequestImpl>(nullptr);
     req->setMethod(drogon::Get);
     req->setVersion(drogon::Version::kHttp11);
     req->contentType_ = CT_APPLICATION_JSON;
-    req->setContent(writeString(builder, data));
+    std::string content;
+    app().getJsonEngine()->serialize(data, content);
+    req->setContent(std::move(content));
     req->flagForParsingContentType_ = true;
     return req;
 }
@@ -595,6 +737,67 @@ HttpRequestPtr HttpRequest::newFileUploadRequest(
     return std::make_shared<HttpFileUploadRequest>(files);
 }
 
+static void setBodyContentType(HttpRequestImpl &req,
+                               ContentType type,
+                               const std::string &typeString,
+                               ContentType defaultType)
+{
+    if (type != CT_NONE)
+        req.setContentTypeCode(type);
+    else if (!typeString.empty())
+        req.setContentTypeString(typeString.data(), typeString.length());
+    else
+        req.setContentTypeCode(defaultType);
+}
+
+HttpRequestPtr HttpRequest::newFileRequest(const std::string &fullPath,
+                                           size_t offset,
+                                           size_t length,
+                                           ContentType type,
+                                           const std::string &typeString)
+{
+    auto req = std::make_shared<HttpRequestImpl>(nullptr);
+    req->setMethod(drogon::Post);
+    req->setVersion(drogon::Version::kHttp11);
+    std::error_code ec;
+    auto fileSize = static_cast<size_t>(
+        std::filesystem::file_size(utils::toNativePath(fullPath), ec));
+    if (ec || offset > fileSize)
+    {
+        LOG_ERROR << fullPath << " not found";
+        return req;
+    }
+    if (length == 0 || length > fileSize - offset)
+        length = fileSize - offset;
+    req->setSendfile(fullPath, offset, length);
+    setBodyContentType(*req, type, typeString, getContentType(fullPath));
+    return req;
+}
+
+HttpRequestPtr HttpRequest::newStreamRequest(
+    const std::function<std::size_t(char *, std::size_t)> &callback,
+    ContentType type,
+    const std::string &typeString)
+{
+    auto req = std::make_shared<HttpRequestImpl>(nullptr);
+    req->setMethod(drogon::Post);
+    req->setVersion(drogon::Version::kHttp11);
+    req->setStreamCallback(callback);
+    setBodyContentType(*req, type, typeString, CT_APPLICATION_OCTET_STREAM);
+    return req;
+}
+
+void HttpRequestImpl::resolveSession() const
+{
+    std::lock_guard<std::mutex> lock(sessionMutex_);
+    if (!sessionPending_.load(std::memory_order_relaxed))
+        return;
+    if (!sessionPtr_)
+        sessionPtr_ =
+            HttpAppFrameworkImpl::instance().resolveSessionForRequest(*this);
+    sessionPending_.store(false, std::memory_order_release);
+}
+
 void HttpRequestImpl::swap(HttpRequestImpl &that) noexcept
 {
     using std::swap;
@@ -608,17 +811,31 @@ void HttpRequestImpl::swap(HttpRequestImpl &that) noexcept
     swap(pathEncode_, that.pathEncode_);
     swap(query_, that.query_);
     swap(headers_, that.headers_);
+    swap(rawHeaders_, that.rawHeaders_);
+    swap(headerViews_, that.headerViews_);
+    swap(knownHeaders_, that.knownHeaders_);
+    swap(knownHeadersMask_, that.knownHeadersMask_);
+    swap(knownHeadersMerged_, that.knownHeadersMerged_);
+    swap(useHeaderViews_, that.useHeaderViews_);
     swap(cookies_, that.cookies_);
+    swap(cookieHeader_, that.cookieHeader_);
+    swap(flagForParsingCookies_, that.flagForParsingCookies_);
     swap(contentLengthHeaderValue_, that.contentLengthHeaderValue_);
     swap(realContentLength_, that.realContentLength_);
     swap(parameters_, that.parameters_);
+    swap(lookedUpParameters_, that.lookedUpParameters_);
     swap(jsonPtr_, that.jsonPtr_);
     swap(sessionPtr_, that.sessionPtr_);
+    auto sessionPending = sessionPending_.load();
+    sessionPending_ = that.sessionPending_.load();
+    that.sessionPending_ = sessionPending;
     swap(attributesPtr_, that.attributesPtr_);
+    swap(arenaPtr_, that.arenaPtr_);
     swap(cacheFilePtr_, that.cacheFilePtr_);
     swap(peer_, that.peer_);
     swap(local_, that.local_);
     swap(creationDate_, that.creationDate_);
+    swap(tracePtr_, that.tracePtr_);
     swap(content_, that.content_);
     swap(expectPtr_, that.expectPtr_);
     swap(contentType_, that.contentType_);
@@ -631,8 +848,15 @@ void HttpRequestImpl::swap(HttpRequestImpl &that) noexcept
     // stream
     swap(streamStatus_, that.streamStatus_);
     swap(streamReaderPtr_, that.streamReaderPtr_);
+    swap(bodyStream_, that.bodyStream_);
+    swap(sendfileName_, that.sendfileName_);
+    swap(sendfileRange_, that.sendfileRange_);
+    swap(streamCallback_, that.streamCallback_);
+    swap(responseStream_, that.responseStream_);
     swap(streamFinishCb_, that.streamFinishCb_);
     swap(streamExceptionPtr_, that.streamExceptionPtr_);
+    swap(streamDecompressor_, that.streamDecompressor_);
+    swap(streamDecompressStatus_, that.streamDecompressStatus_);
     swap(startProcessing_, that.startProcessing_);
     swap(connPtr_, that.connPtr_);
 }
@@ -804,6 +1028,66 @@ bool HttpRequestImpl::setMethod(const char *start, const char *end)
 
 HttpRequestImpl::~HttpRequestImpl()
 {
+    releaseBodyMemory();
+    endDispatch();
+}
+
+void HttpRequestImpl::startDispatch(bool isHeadMethod)
+{
+    dispatchedAsHead_ = isHeadMethod;
+    responseSent_.store(false, std::memory_order_relaxed);
+    if (auto &inFlight = BuiltinMetrics::instance().inFlightRequests)
+    {
+        inFlight->increment();
+        inFlight_.store(true, std::memory_order_relaxed);
+    }
+}
+
+bool HttpRequestImpl::claimResponse()
+{
+    if (responseSent_.exchange(true, std::memory_order_acq_rel))
+        return false;
+    endDispatch();
+    return true;
+}
+
+void HttpRequestImpl::sendEarlyHints(const std::vector<std::string> &links)
+{
+    if (links.empty() || version_ == Version::kHttp10 || responseClaimed())
+        return;
+    auto conn = connPtr_.lock();
+    if (!conn || !conn->connected())
+        return;
+    HttpServer::sendEarlyHints(conn, this, links);
+}
+
+void HttpRequestImpl::endDispatch()
+{
+    // The request is in flight until its response is accepted, or until it
+    // is released without one.
+    if (inFlight_.exchange(false, std::memory_order_acq_rel))
+        BuiltinMetrics::instance().inFlightRequests->decrement();
+}
+
+void HttpRequestImpl::accountBodyMemory()
+{
+    auto &pressure = MemoryPressure::instance();
+    if (!pressure.enabled())
+        return;
+    auto held = content_.length();
+    if (held > accountedBodyMemory_)
+        pressure.add(held - accountedBodyMemory_);
+    else if (held < accountedBodyMemory_)
+        pressure.release(accountedBodyMemory_ - held);
+    accountedBodyMemory_ = held;
+}
+
+void HttpRequestImpl::releaseBodyMemory()
+{
+    if (accountedBodyMemory_ == 0)
+        return;
+    MemoryPressure::instance().release(accountedBodyMemory_);
+    accountedBodyMemory_ = 0;
 }
 
 void HttpRequestImpl::reserveBodySize(size_t length)
@@ -825,6 +1109,7 @@ void HttpRequestImpl::reserveBodySize(size_t length)
         {
             cacheFilePtr_->append(content_);
             content_.clear();
+            accountBodyMemory();
         }
     }
 }
@@ -832,6 +1117,16 @@ void HttpRequestImpl::reserveBodySize(size_t length)
 void HttpRequestImpl::appendToBody(const char *data, size_t length)
 {
     assert(loop_->isInLoopThread());
+    if (streamDecompressor_)
+    {
+        decompressToBody(data, length);
+        return;
+    }
+    storeBody(data, length);
+}
+
+void HttpRequestImpl::storeBody(const char *data, size_t length)
+{
     realContentLength_ += length;
     if (streamReaderPtr_)
     {
@@ -856,13 +1151,14 @@ void HttpRequestImpl::appendToBody(const char *data, size_t length)
             cacheFilePtr_->append(data, length);
             content_.clear();
         }
+        accountBodyMemory();
     }
 }
 
 void HttpRequestImpl::createTmpFile()
 {
     auto tmpfile = HttpAppFrameworkImpl::instance().getUploadPath();
-    auto fileName = utils::getUuid(false);
+    auto fileName = utils::getUuidV4(false);
     tmpfile.append("/tmp/")
         .append(1, fileName[0])
         .append(1, fileName[1])
@@ -997,25 +1293,15 @@ StreamDecompressStatus HttpRequestImpl::decompressBodyGzip() noexcept
         compressed = contentHolder;
     }
 
-    z_stream strm = {nullptr,
-                     0,
-                     0,
-                     nullptr,
-                     0,
-                     0,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     0,
-                     0,
-                     0};
+    auto &streams = utils::internal::ZlibStreams::instance();
+    auto strmPtr = streams.inflater();
+    if (!strmPtr)
+    {
+        return StreamDecompressStatus::DecompressError;
+    }
+    auto &strm = *strmPtr;
     strm.next_in = (Bytef *)compressed.data();
     strm.avail_in = static_cast<uInt>(compressed.size());
-    strm.total_out = 0;
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
     setBody("");
     const size_t maxBodySize =
         HttpAppFrameworkImpl::instance().getClientMaxBodySize();
@@ -1026,10 +1312,6 @@ StreamDecompressStatus HttpRequestImpl::decompressBodyGzip() noexcept
     strm.next_out = (Bytef *)decompressed.data();
     strm.avail_out = static_cast<uInt>(decompressed.size());
     size_t lastOut = 0;
-    if (inflateInit2(&strm, (15 + 32)) != Z_OK)
-    {
-        return StreamDecompressStatus::DecompressError;
-    }
 
     StreamDecompressStatus status = StreamDecompressStatus::Ok;
     while (true)
@@ -1067,14 +1349,70 @@ StreamDecompressStatus HttpRequestImpl::decompressBodyGzip() noexcept
             strm.avail_out = static_cast<uInt>(decompressed.size());
         }
     }
-    if (inflateEnd(&strm) != Z_OK)
+    strm.next_in = nullptr;
+    strm.next_out = nullptr;
+    if (status != StreamDecompressStatus::Ok)
+        streams.discardInflater();
+    return status;
+}
+
+StreamDecompressStatus HttpRequestImpl::startStreamDecompression()
+{
+    assert(isStreamMode());
+    auto &contentEncoding = getHeaderBy("content-encoding");
+    if (contentEncoding.empty() || contentEncoding == "identity")
+    {
+        removeHeaderBy("content-encoding");
+        return StreamDecompressStatus::Ok;
+    }
+    auto decompressor = StreamDecompressor::newDecompressor(contentEncoding);
+    if (!decompressor)
     {
-        setBody("");
-        if (status == StreamDecompressStatus::Ok)
-            status = StreamDecompressStatus::DecompressError;
-        return status;
+        return StreamDecompressStatus::NotSupported;
     }
-    return status;
+    removeHeaderBy("content-encoding");
+    std::unique_ptr<CacheFile> cacheFileHolder;
+    std::string contentHolder;
+    std::string_view compressed;
+    if (cacheFilePtr_)
+    {
+        cacheFileHolder = std::move(cacheFilePtr_);
+        compressed = cacheFileHolder->getStringView();
+    }
+    else
+    {
+        contentHolder = std::move(content_);
+        content_.clear();
+        compressed = contentHolder;
+    }
+    // From now on the decompressed data is counted
+    realContentLength_ = 0;
+    streamDecompressor_ = std::move(decompressor);
+    if (!compressed.empty())
+        decompressToBody(compressed.data(), compressed.length());
+    return streamDecompressStatus(streamStatus_ >= ReqStreamStatus::Finish);
+}
+
+void HttpRequestImpl::decompressToBody(const char *data, size_t length)
+{
+    if (streamDecompressStatus_ != StreamDecompressStatus::Ok)
+        return;
+    const size_t maxBodySize =
+        HttpAppFrameworkImpl::instance().getClientMaxBodySize();
+    // The limit is checked for each piece, the decompressed body is never
+    // kept beyond it.
+    auto ok = streamDecompressor_->decompress(
+        data, length, [this, maxBodySize](const char *out, size_t outLength) {
+            if (realContentLength_ + outLength > maxBodySize)
+            {
+                streamDecompressStatus_ = StreamDecompressStatus::TooLarge;
+                return false;
+            }
+            storeBody(out, outLength);
+            return true;
+        });
+    if (!ok && streamDecompressStatus_ == StreamDecompressStatus::Ok)
+        streamDecompressStatus_ = StreamDecompressStatus::DecompressError;
 }
 
 void HttpRequestImpl::setStreamReader(RequestStreamReaderPtr reader)
@@ -16,6 +16,7 @@
 
 #include "HttpUtils.h"
 #include "CacheFile.h"
+#include "StreamDecompressor.h"
 #include "impl_forwards.h"
 #include <drogon/utils/Utilities.h>
 #include <drogon/HttpRequest.h>
@@ -29,11 +30,16 @@
 #include <trantor/utils/NonCopyable.h>
 #include <trantor/net/TcpConnection.h>
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <future>
 #include <unordered_map>
+#include <vector>
 #include <assert.h>
 #include <stdio.h>
 
@@ -42,6 +48,34 @@ class HttpRequestImplCacheFileTestAccess;
 
 namespace drogon
 {
+namespace internal
+{
+class ClientBodyStream;
+struct ResponseStreamState;
+}  // namespace internal
+
+/**
+ * @brief The request headers looked up by the framework itself, which are
+ * stored in fixed slots of the request instead of the header map.
+ */
+enum class KnownHeader : uint8_t
+{
+    kHost = 0,
+    kRange,
+    kOrigin,
+    kExpect,
+    kUpgrade,
+    kConnection,
+    kContentType,
+    kIfNoneMatch,
+    kContentLength,
+    kAcceptEncoding,
+    kContentEncoding,
+    kTransferEncoding,
+    kIfModifiedSince,
+    kCount
+};
+
 enum class StreamDecompressStatus
 {
     TooLarge,
@@ -76,7 +110,12 @@ class HttpRequestImpl : public HttpRequest
         version_ = Version::kUnknown;
         flagForParsingJson_ = false;
         headers_.clear();
+        rawHeaders_.clear();
+        headerViews_.clear();
+        clearKnownHeaders();
         cookies_.clear();
+        cookieHeader_.clear();
+        flagForParsingCookies_ = false;
         contentLengthHeaderValue_.reset();
         realContentLength_ = 0;
         flagForParsingParameters_ = false;
@@ -86,9 +125,13 @@ class HttpRequestImpl : public HttpRequest
         matchedPathPattern_ = "";
         query_.clear();
         parameters_.clear();
+        lookedUpParameters_.clear();
         jsonPtr_.reset();
         sessionPtr_.reset();
+        sessionPending_ = false;
         attributesPtr_.reset();
+        if (arenaPtr_)
+            arenaPtr_->reset();
         cacheFilePtr_.reset();
         expectPtr_.reset();
         content_.clear();
@@ -98,14 +141,30 @@ class HttpRequestImpl : public HttpRequest
         keepAlive_ = true;
         jsonParsingErrorPtr_.reset();
         peerCertificate_.reset();
+        tracePtr_.reset();
+        deadline_ = trantor::Date();
+        cancelled_.store(false, std::memory_order_relaxed);
+        cancelCallbacks_.clear();
         routingParams_.clear();
         // stream
         streamStatus_ = ReqStreamStatus::None;
         streamReaderPtr_.reset();
         streamFinishCb_ = nullptr;
         streamExceptionPtr_ = nullptr;
+        streamDecompressor_.reset();
+        streamDecompressStatus_ = StreamDecompressStatus::Ok;
         startProcessing_ = false;
         connPtr_.reset();
+        http2StreamId_ = 0;
+        bodyStream_.reset();
+        sendfileName_.clear();
+        sendfileRange_ = {0, 0};
+        streamCallback_ = nullptr;
+        responseStream_.reset();
+        releaseBodyMemory();
+        endDispatch();
+        responseSent_.store(false, std::memory_order_relaxed);
+        dispatchedAsHead_ = false;
     }
 
     trantor::EventLoop *getLoop()
@@ -204,13 +263,27 @@ class HttpRequestImpl : public HttpRequest
     const std::string &getParameter(const std::string &key) const override
     {
         static const std::string defaultVal;
-        parseParametersOnce();
-        auto iter = parameters_.find(key);
-        if (iter != parameters_.end())
+        if (flagForParsingParameters_)
+        {
+            auto iter = parameters_.find(key);
+            if (iter != parameters_.end())
+                return iter->second;
+            return defaultVal;
+        }
+        // Don't parse all the parameters for one of them
+        auto iter = lookedUpParameters_.find(key);
+        if (iter != lookedUpParameters_.end())
             return iter->second;
-        return defaultVal;
+        auto value = getParameterView(key);
+        if (!value)
+            return defaultVal;
+        return lookedUpParameters_.emplace(key, std::string(*value))
+            .first->second;
     }
 
+    std::optional<std::string_view> getParameterView(
+        std::string_view key) const override;
+
     const std::string &path() const override
     {
         return path_;
@@ -315,6 +388,72 @@ class HttpRequestImpl : public HttpRequest
         return peerCertificate_;
     }
 
+    const RequestTracePtr &trace() const override
+    {
+        return tracePtr_;
+    }
+
+    void setTrace(RequestTracePtr &&trace)
+    {
+        tracePtr_ = std::move(trace);
+    }
+
+    const trantor::Date &deadline() const override
+    {
+        return deadline_;
+    }
+
+    void setDeadline(const trantor::Date &deadline) override
+    {
+        deadline_ = deadline;
+    }
+
+    bool isCancelled() const noexcept override
+    {
+        return cancelled_.load(std::memory_order_acquire);
+    }
+
+    void onCancel(std::function<void()> &&callback) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(cancelMutex_);
+            if (!cancelled_.load(std::memory_order_relaxed))
+            {
+                cancelCallbacks_.emplace_back(std::move(callback));
+                return;
+            }
+        }
+        callback();
+    }
+
+    // Called by the server in the IO loop when the connection is closed, or
+    // the stream reset, before the response is sent.
+    void cancel()
+    {
+        std::vector<std::function<void()>> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(cancelMutex_);
+            if (cancelled_.exchange(true, std::memory_order_acq_rel))
+                return;
+            callbacks.swap(cancelCallbacks_);
+        }
+        for (auto &callback : callbacks)
+            callback();
+    }
+
+    // Called by the server before the request is handled. The state of the
+    // dispatch is kept in the pooled request, so handling a request doesn't
+    // allocate it.
+    void startDispatch(bool isHeadMethod);
+
+    // Return false if a response has already been accepted for the request.
+    bool claimResponse();
+
+    bool dispatchedAsHead() const
+    {
+        return dispatchedAsHead_;
+    }
+
     void setCreationDate(const trantor::Date &date)
     {
         creationDate_ = date;
@@ -340,8 +479,61 @@ class HttpRequestImpl : public HttpRequest
         connPtr_ = ptr;
     }
 
+    // The stream of the request, 0 if it's not received with HTTP/2.
+    void setHttp2StreamId(uint32_t streamId)
+    {
+        http2StreamId_ = streamId;
+    }
+
+    uint32_t http2StreamId() const
+    {
+        return http2StreamId_;
+    }
+
+    // Return true if a response has already been accepted for the request.
+    bool responseClaimed() const
+    {
+        return responseSent_.load(std::memory_order_acquire);
+    }
+
+    void sendEarlyHints(const std::vector<std::string> &links) override;
+
     void addHeader(const char *start, const char *colon, const char *end);
 
+    /**
+     * @brief In the zero copy mode, the headers parsed by addHeader() are kept
+     * in one raw buffer and the std::string objects of a header are only
+     * created when it is looked up by getHeader(), or all at once when the
+     * header map is accessed or modified.
+     */
+    void useHeaderViews(bool flag)
+    {
+        useHeaderViews_ = flag;
+    }
+
+    /**
+     * @brief Return the value of the header without materializing it, the
+     * view is valid until the headers of the request are modified.
+     */
+    std::string_view getHeaderView(std::string_view lowerField) const
+    {
+        auto index = knownHeaderIndex(lowerField);
+        if (index >= 0 && !knownHeadersMerged_)
+            return getKnownHeader(static_cast<KnownHeader>(index));
+        for (auto &view : headerViews_)
+        {
+            if (fieldOf(view) == lowerField)
+                return valueOf(view);
+        }
+        if (!headers_.empty())
+        {
+            auto it = headers_.find(std::string(lowerField));
+            if (it != headers_.end())
+                return it->second;
+        }
+        return emptySv_;
+    }
+
     void removeHeader(std::string key) override
     {
         transform(key.begin(), key.end(), key.begin(), [](unsigned char c) {
@@ -352,12 +544,21 @@ class HttpRequestImpl : public HttpRequest
 
     void removeHeaderBy(const std::string &lowerKey)
     {
+        auto index = knownHeaderIndex(lowerKey);
+        if (index >= 0 && !knownHeadersMerged_)
+        {
+            knownHeadersMask_ &= ~(1u << index);
+            return;
+        }
+        materializeHeaders();
         headers_.erase(lowerKey);
     }
 
     void clearHeaders() override
     {
         headers_.clear();
+        headerViews_.clear();
+        clearKnownHeaders();
     }
 
     const std::string &getHeader(std::string field) const override
@@ -372,17 +573,50 @@ class HttpRequestImpl : public HttpRequest
     const std::string &getHeaderBy(const std::string &lowerField) const
     {
         static const std::string defaultVal;
+        auto index = knownHeaderIndex(lowerField);
+        if (index >= 0 && !knownHeadersMerged_)
+            return getKnownHeader(static_cast<KnownHeader>(index));
         auto it = headers_.find(lowerField);
         if (it != headers_.end())
         {
             return it->second;
         }
+        for (auto &view : headerViews_)
+        {
+            if (fieldOf(view) == lowerField)
+            {
+                return headers_.emplace(lowerField, valueOf(view))
+                    .first->second;
+            }
+        }
         return defaultVal;
     }
 
+    /**
+     * @brief Return the value of a well-known header without hashing or
+     * comparing its name.
+     */
+    const std::string &getKnownHeader(KnownHeader header) const
+    {
+        static const std::string defaultVal;
+        auto index = static_cast<size_t>(header);
+        if (knownHeadersMerged_)
+            return getHeaderBy(std::string(knownHeaderNames_[index]));
+        if (knownHeadersMask_ & (1u << index))
+            return knownHeaders_[index];
+        return defaultVal;
+    }
+
+    /**
+     * @brief The slot index of a well-known header, or -1 if the lowercase
+     * name isn't one of them.
+     */
+    static int knownHeaderIndex(std::string_view lowerField);
+
     const std::string &getCookie(const std::string &field) const override
     {
         static const std::string defaultVal;
+        parseCookies();
         auto it = cookies_.find(field);
         if (it != cookies_.end())
         {
@@ -393,11 +627,14 @@ class HttpRequestImpl : public HttpRequest
 
     const SafeStringMap<std::string> &headers() const override
     {
+        materializeHeaders();
+        mergeKnownHeaders();
         return headers_;
     }
 
     const SafeStringMap<std::string> &cookies() const override
     {
+        parseCookies();
         return cookies_;
     }
 
@@ -466,6 +703,13 @@ class HttpRequestImpl : public HttpRequest
                   field.end(),
                   field.begin(),
                   [](unsigned char c) { return tolower(c); });
+        auto index = knownHeaderIndex(field);
+        if (index >= 0 && !knownHeadersMerged_)
+        {
+            setKnownHeader(index, value);
+            return;
+        }
+        materializeHeaders();
         headers_[std::move(field)] = value;
     }
 
@@ -475,11 +719,19 @@ class HttpRequestImpl : public HttpRequest
                   field.end(),
                   field.begin(),
                   [](unsigned char c) { return tolower(c); });
+        auto index = knownHeaderIndex(field);
+        if (index >= 0 && !knownHeadersMerged_)
+        {
+            setKnownHeader(index, std::move(value));
+            return;
+        }
+        materializeHeaders();
         headers_[std::move(field)] = std::move(value);
     }
 
     void addCookie(std::string key, std::string value) override
     {
+        parseCookies();
         cookies_[std::move(key)] = std::move(value);
     }
 
@@ -495,14 +747,98 @@ class HttpRequestImpl : public HttpRequest
 
     void appendToBuffer(trantor::MsgBuffer *output) const;
 
+    /// Set the stream writing the body of the request sent by HttpClient,
+    /// the body is sent with the chunked transfer encoding.
+    void setBodyStream(std::shared_ptr<internal::ClientBodyStream> stream)
+    {
+        bodyStream_ = std::move(stream);
+    }
+
+    const std::shared_ptr<internal::ClientBodyStream> &bodyStream() const
+    {
+        return bodyStream_;
+    }
+
+    void setSendfile(std::string fileName, size_t offset, size_t length)
+    {
+        sendfileName_ = std::move(fileName);
+        sendfileRange_ = {offset, length};
+    }
+
+    /// The file sent as the body by newFileRequest()
+    const std::string &sendfileName() const
+    {
+        return sendfileName_;
+    }
+
+    /// The offset and the length of the body in the file
+    const std::pair<size_t, size_t> &sendfileRange() const
+    {
+        return sendfileRange_;
+    }
+
+    void setStreamCallback(
+        const std::function<std::size_t(char *, std::size_t)> &callback)
+    {
+        streamCallback_ = callback;
+    }
+
+    /// The callback of the body of newStreamRequest()
+    const std::function<std::size_t(char *, std::size_t)> &streamCallback()
+        const
+    {
+        return streamCallback_;
+    }
+
+    /// Set the callbacks receiving the body of the response in pieces
+    void setResponseStream(
+        std::shared_ptr<internal::ResponseStreamState> responseStream)
+    {
+        responseStream_ = std::move(responseStream);
+    }
+
+    const std::shared_ptr<internal::ResponseStreamState> &responseStream()
+        const
+    {
+        return responseStream_;
+    }
+
+    /// Whether the body is not in the request but sent from elsewhere by the
+    /// client.
+    bool hasExternalBody() const
+    {
+        return bodyStream_ || streamCallback_ || !sendfileName_.empty();
+    }
+
     const SessionPtr &session() const override
     {
+        // The handlers may access the session out of the IO loop, e.g. when
+        // they are offloaded to a thread pool.
+        if (sessionPending_.load(std::memory_order_acquire))
+            resolveSession();
         return sessionPtr_;
     }
 
     void setSession(const SessionPtr &session)
     {
         sessionPtr_ = session;
+        sessionPending_.store(false, std::memory_order_relaxed);
+    }
+
+    /// The session is used when it's accessed for the first time, it's the
+    /// given one if it's already found, or it's found then.
+    void setSessionPending(SessionPtr session = nullptr)
+    {
+        sessionPtr_ = std::move(session);
+        sessionPending_.store(true, std::memory_order_relaxed);
+    }
+
+    /// Return the session if it has been accessed, without finding it.
+    const SessionPtr &resolvedSession() const
+    {
+        static const SessionPtr noSession;
+        return sessionPending_.load(std::memory_order_acquire) ? noSession
+                                                               : sessionPtr_;
     }
 
     const AttributesPtr &attributes() const override
@@ -514,6 +850,17 @@ class HttpRequestImpl : public HttpRequest
         return attributesPtr_;
     }
 
+    MonotonicArena &arena() const override
+    {
+        // Created once for a pooled request object and reset when it is
+        // recycled, so the blocks of the arena are reused by later requests.
+        if (!arenaPtr_)
+        {
+            arenaPtr_ = std::make_unique<MonotonicArena>();
+        }
+        return *arenaPtr_;
+    }
+
     const std::shared_ptr<Json::Value> &jsonObject() const override
     {
         // Not multi-thread safe but good, because we basically call this
@@ -624,6 +971,23 @@ class HttpRequestImpl : public HttpRequest
 
     StreamDecompressStatus decompressBody();
 
+    /**
+     * @brief Decompress the body of the stream mode request as it is
+     * received, instead of at once by decompressBody(). The part of the body
+     * received with the header is decompressed here.
+     */
+    StreamDecompressStatus startStreamDecompression();
+
+    /// The status of the decompression started by startStreamDecompression(),
+    /// a truncated body is an error once all of it is received.
+    StreamDecompressStatus streamDecompressStatus(bool gotAll) const
+    {
+        if (streamDecompressStatus_ == StreamDecompressStatus::Ok && gotAll &&
+            streamDecompressor_ && !streamDecompressor_->finished())
+            return StreamDecompressStatus::DecompressError;
+        return streamDecompressStatus_;
+    }
+
     // Stream mode api
     ReqStreamStatus streamStatus() const
     {
@@ -700,7 +1064,67 @@ class HttpRequestImpl : public HttpRequest
     }
 
   private:
+    void resolveSession() const;
+
+    // The offsets of a header in rawHeaders_
+    struct HeaderView
+    {
+        uint32_t fieldOffset;
+        uint32_t fieldLength;
+        uint32_t valueOffset;
+        uint32_t valueLength;
+    };
+
+    std::string_view fieldOf(const HeaderView &view) const
+    {
+        return std::string_view(rawHeaders_.data() + view.fieldOffset,
+                                view.fieldLength);
+    }
+
+    std::string_view valueOf(const HeaderView &view) const
+    {
+        return std::string_view(rawHeaders_.data() + view.valueOffset,
+                                view.valueLength);
+    }
+
+    void materializeHeaders() const;
+
+    void setKnownHeader(int index, std::string_view value)
+    {
+        knownHeaders_[index].assign(value.data(), value.length());
+        knownHeadersMask_ |= 1u << index;
+    }
+
+    void setKnownHeader(int index, std::string &&value)
+    {
+        knownHeaders_[index] = std::move(value);
+        knownHeadersMask_ |= 1u << index;
+    }
+
+    void clearKnownHeaders()
+    {
+        // The strings keep their capacity for the next request.
+        for (size_t i = 0; i < knownHeaders_.size(); ++i)
+        {
+            if (knownHeadersMask_ & (1u << i))
+                knownHeaders_[i].clear();
+        }
+        knownHeadersMask_ = 0;
+        knownHeadersMerged_ = false;
+    }
+
+    // Move the well-known headers to headers_ when the whole map is needed,
+    // they are then looked up in the map until the headers are cleared.
+    void mergeKnownHeaders() const;
+    // The cookie headers are kept as they are until a cookie is looked up,
+    // most handlers never do.
+    void addCookieHeader(std::string_view value);
+    void parseCookies() const;
+    void processSpecialHeader(std::string_view field, std::string_view value);
+
     void parseParameters() const;
+    // True if the body holds urlencoded parameters
+    bool hasFormParameters() const;
 
     void parseParametersOnce() const
     {
@@ -714,11 +1138,19 @@ class HttpRequestImpl : public HttpRequest
     }
 
     void createTmpFile();
+    // Count the body received in memory, see
+    // HttpAppFramework::setMemorySoftLimit().
+    void accountBodyMemory();
+    void releaseBodyMemory();
+    // Stop counting the request in flight.
+    void endDispatch();
     void parseJson() const;
 #ifdef USE_BROTLI
     StreamDecompressStatus decompressBodyBrotli() noexcept;
 #endif
     StreamDecompressStatus decompressBodyGzip() noexcept;
+    void decompressToBody(const char *data, size_t length);
+    void storeBody(const char *data, size_t length);
 
     static constexpr const std::string_view emptySv_{""};
 
@@ -735,18 +1167,44 @@ class HttpRequestImpl : public HttpRequest
     bool pathEncode_{true};
     std::string_view matchedPathPattern_{""};
     std::string query_;
-    SafeStringMap<std::string> headers_;
-    SafeStringMap<std::string> cookies_;
+    // Also caches the headers looked up in the zero copy mode
+    mutable SafeStringMap<std::string> headers_;
+    // The lowercase field names and the values of the headers not yet copied
+    // to headers_ in the zero copy mode
+    std::string rawHeaders_;
+    mutable std::vector<HeaderView> headerViews_;
+    static const std::string_view
+        knownHeaderNames_[static_cast<size_t>(KnownHeader::kCount)];
+    mutable std::array<std::string, static_cast<size_t>(KnownHeader::kCount)>
+        knownHeaders_;
+    // The bits of the slots holding a header
+    mutable uint32_t knownHeadersMask_{0};
+    mutable bool knownHeadersMerged_{false};
+    bool useHeaderViews_{false};
+    mutable SafeStringMap<std::string> cookies_;
+    // The values of the cookie headers joined by "; " (rfc6265-5.4)
+    std::string cookieHeader_;
+    mutable bool flagForParsingCookies_{false};
     std::optional<size_t> contentLengthHeaderValue_;
     size_t realContentLength_{0};
     mutable SafeStringMap<std::string> parameters_;
+    // The values returned by getParameter() before parsing all of them
+    mutable SafeStringMap<std::string> lookedUpParameters_;
     mutable std::shared_ptr<Json::Value> jsonPtr_;
-    SessionPtr sessionPtr_;
+    mutable SessionPtr sessionPtr_;
+    mutable std::atomic<bool> sessionPending_{false};
+    mutable std::mutex sessionMutex_;
     mutable AttributesPtr attributesPtr_;
+    mutable std::unique_ptr<MonotonicArena> arenaPtr_;
     trantor::InetAddress peer_;
     trantor::InetAddress local_;
     trantor::Date creationDate_;
     trantor::CertificatePtr peerCertificate_;
+    RequestTracePtr tracePtr_;
+    trantor::Date deadline_;
+    std::atomic<bool> cancelled_{false};
+    std::mutex cancelMutex_;
+    std::vector<std::function<void()>> cancelCallbacks_;
     std::unique_ptr<CacheFile> cacheFilePtr_;
     mutable std::unique_ptr<std::string> jsonParsingErrorPtr_;
     std::unique_ptr<std::string> expectPtr_;
@@ -759,8 +1217,21 @@ class HttpRequestImpl : public HttpRequest
     std::function<void()> streamFinishCb_;
     RequestStreamReaderPtr streamReaderPtr_;
     std::exception_ptr streamExceptionPtr_;
+    std::unique_ptr<StreamDecompressor> streamDecompressor_;
+    StreamDecompressStatus streamDecompressStatus_{StreamDecompressStatus::Ok};
     bool startProcessing_{false};
     std::weak_ptr<trantor::TcpConnection> connPtr_;
+    uint32_t http2StreamId_{0};
+    std::shared_ptr<internal::ClientBodyStream> bodyStream_;
+    std::string sendfileName_;
+    std::pair<size_t, size_t> sendfileRange_{0, 0};
+    std::function<std::size_t(char *, std::size_t)> streamCallback_;
+    std::shared_ptr<internal::ResponseStreamState> responseStream_;
+    // The bytes of the body counted by MemoryPressure.
+    size_t accountedBodyMemory_{0};
+    std::atomic<bool> responseSent_{false};
+    std::atomic<bool> inFlight_{false};
+    bool dispatchedAsHead_{false};
 
   protected:
     std::string content_;
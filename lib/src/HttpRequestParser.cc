@@ -16,11 +16,14 @@
 #include <drogon/HttpTypes.h>
 #include <trantor/utils/Logger.h>
 #include <trantor/utils/MsgBuffer.h>
+#include <charconv>
 #include <iostream>
+#include "CharScan.h"
 #include "HttpAppFrameworkImpl.h"
 #include "HttpRequestImpl.h"
 #include "HttpResponseImpl.h"
 #include "HttpUtils.h"
+#include "MemoryPressure.h"
 
 using namespace trantor;
 using namespace drogon;
@@ -29,6 +32,24 @@ static constexpr size_t CRLF_LEN = 2;            // strlen("crlf")
 static constexpr size_t METHOD_MAX_LEN = 7;      // strlen("OPTIONS")
 static constexpr size_t TRUNK_LEN_MAX_LEN = 16;  // 0xFFFFFFFF,FFFFFFFF
 
+// The error of the body decompressed as it is received in stream mode, see
+// HttpRequestImpl::startStreamDecompression(), 0 if none.
+static int streamDecompressError(const HttpRequestImpl &req, bool gotAll)
+{
+    switch (req.streamDecompressStatus(gotAll))
+    {
+        case StreamDecompressStatus::TooLarge:
+            return -k413RequestEntityTooLarge;
+        case StreamDecompressStatus::DecompressError:
+            return -k422UnprocessableEntity;
+        case StreamDecompressStatus::NotSupported:
+            return -k415UnsupportedMediaType;
+        case StreamDecompressStatus::Ok:
+            break;
+    }
+    return 0;
+}
+
 HttpRequestParser::HttpRequestParser(const trantor::TcpConnectionPtr &connPtr)
     : status_(HttpRequestParseStatus::kExpectMethod),
       loop_(connPtr->getLoop()),
@@ -40,16 +61,16 @@ bool HttpRequestParser::processRequestLine(const char *begin, const char *end)
 {
     bool succeed = false;
     const char *start = begin;
-    const char *space = std::find(start, end, ' ');
+    const char *space = internal::findChar(start, end, ' ');
     if (space != end)
     {
-        const char *slash = std::find(start, space, '/');
+        const char *slash = internal::findChar(start, space, '/');
         if (slash != start && slash + 1 < space && *(slash + 1) == '/')
         {
             // scheme precedents
-            slash = std::find(slash + 2, space, '/');
+            slash = internal::findChar(slash + 2, space, '/');
         }
-        const char *question = std::find(slash, space, '?');
+        const char *question = internal::findChar(slash, space, '?');
         if (slash != space)
         {
             request_->setPath(slash, question);
@@ -89,7 +110,7 @@ HttpRequestImplPtr HttpRequestParser::makeRequestForPool(HttpRequestImpl *ptr)
     return std::shared_ptr<HttpRequestImpl>(
         ptr, [weakPtr = weak_from_this()](HttpRequestImpl *p) {
             auto thisPtr = weakPtr.lock();
-            if (thisPtr)
+            if (thisPtr && !thisPtr->releasingPool_)
             {
                 if (thisPtr->loop_->isInLoopThread())
                 {
@@ -118,6 +139,7 @@ void HttpRequestParser::reset()
 {
     assert(loop_->isInLoopThread());
     remainContentLength_ = 0;
+    currentChunkLength_ = 0;
     status_ = HttpRequestParseStatus::kExpectMethod;
     if (requestsPool_.empty())
     {
@@ -130,6 +152,114 @@ void HttpRequestParser::reset()
         request_ = std::move(req);
         request_->setCreationDate(trantor::Date::now());
     }
+    request_->useHeaderViews(
+        HttpAppFrameworkImpl::instance().isZeroCopyHeadersEnabled());
+}
+
+bool HttpRequestParser::trimMemory()
+{
+    assert(loop_->isInLoopThread());
+    if (trimmed_ || status_ != HttpRequestParseStatus::kExpectMethod ||
+        !requestPipelining_.empty() || sendBuffer_.readableBytes() > 0 ||
+        flushQueued_)
+        return false;
+    releasingPool_ = true;
+    requestsPool_.clear();
+    requestsPool_.shrink_to_fit();
+    // The request waiting for the next request line may have grown with the
+    // previous ones.
+    request_.reset();
+    releasingPool_ = false;
+    reset();
+    sendBuffer_ = trantor::MsgBuffer();
+    if (responseBuffer_ && responseBuffer_->empty())
+        responseBuffer_.reset();
+    if (requestBuffer_ && requestBuffer_->empty())
+        requestBuffer_.reset();
+    trimmed_ = true;
+    return true;
+}
+
+void HttpRequestParser::watchOutput(const trantor::TcpConnectionPtr &conn,
+                                    size_t mark)
+{
+    assert(loop_->isInLoopThread());
+    if (watchedMark_ != 0 && watchedMark_ <= mark)
+        return;
+    if (watchedMark_ == 0)
+    {
+        conn->setWriteCompleteCallback([](const TcpConnectionPtr &conn) {
+            auto requestParser = conn->getContext<HttpRequestParser>();
+            if (requestParser)
+                requestParser->onOutputDrained();
+        });
+    }
+    watchedMark_ = mark;
+    conn->setHighWaterMarkCallback(
+        [](const TcpConnectionPtr &conn, size_t bytes) {
+            auto requestParser = conn->getContext<HttpRequestParser>();
+            // HTTP/2 connections have their own flow control.
+            if (requestParser && !requestParser->http2Conn())
+                requestParser->onOutputQueued(conn, bytes);
+        },
+        mark);
+}
+
+void HttpRequestParser::addOutputWatermark(
+    const trantor::TcpConnectionPtr &conn,
+    const std::shared_ptr<internal::OutputWatermark> &watermark)
+{
+    assert(loop_->isInLoopThread());
+    watermarks_.emplace_back(watermark);
+    watchOutput(conn, watermark->highWaterMark());
+}
+
+void HttpRequestParser::onOutputQueued(const trantor::TcpConnectionPtr &conn,
+                                       size_t bytes)
+{
+    auto &pressure = MemoryPressure::instance();
+    if (pressure.enabled() && bytes > kAccountedOutputMark &&
+        bytes > accountedOutput_)
+    {
+        pressure.add(bytes - accountedOutput_);
+        accountedOutput_ = bytes;
+    }
+    for (auto iter = watermarks_.begin(); iter != watermarks_.end();)
+    {
+        auto watermark = iter->lock();
+        if (!watermark)
+        {
+            iter = watermarks_.erase(iter);
+            continue;
+        }
+        watermark->onQueued(conn, bytes);
+        ++iter;
+    }
+}
+
+void HttpRequestParser::onOutputDrained()
+{
+    MemoryPressure::instance().release(accountedOutput_);
+    accountedOutput_ = 0;
+    for (auto &weakWatermark : watermarks_)
+    {
+        if (auto watermark = weakWatermark.lock())
+            watermark->onDrained();
+    }
+}
+
+size_t HttpRequestParser::memoryUsage() const
+{
+    size_t usage = sizeof(*this) + sendBuffer_.readableBytes() +
+                   sendBuffer_.writableBytes() +
+                   requestsPool_.capacity() * sizeof(HttpRequestImplPtr) +
+                   (requestsPool_.size() + 1) * sizeof(HttpRequestImpl);
+    if (responseBuffer_)
+        usage += responseBuffer_->capacity() *
+                 sizeof(std::pair<HttpResponsePtr, bool>);
+    if (requestBuffer_)
+        usage += requestBuffer_->capacity() * sizeof(HttpRequestImplPtr);
+    return usage;
 }
 
 /**
@@ -148,9 +278,9 @@ int HttpRequestParser::parseRequest(MsgBuffer *buf)
         {
             case (HttpRequestParseStatus::kExpectMethod):
             {
-                auto *space = std::find(buf->peek(),
-                                        (const char *)buf->beginWrite(),
-                                        ' ');
+                auto *space = internal::findChar(buf->peek(),
+                                                 buf->beginWrite(),
+                                                 ' ');
                 // no space in buffer
                 if (space == buf->beginWrite())
                 {
@@ -171,7 +301,8 @@ int HttpRequestParser::parseRequest(MsgBuffer *buf)
             }
             case HttpRequestParseStatus::kExpectRequestLine:
             {
-                const char *crlf = buf->findCRLF();
+                const char *crlf =
+                    internal::findCRLF(buf->peek(), buf->beginWrite());
                 if (!crlf)
                 {
                     if (buf->readableBytes() >= 64 * 1024)
@@ -194,7 +325,30 @@ int HttpRequestParser::parseRequest(MsgBuffer *buf)
             }
             case HttpRequestParseStatus::kExpectHeaders:
             {
-                const char *crlf = buf->findCRLF();
+                // Find the colon and the end of the line in one pass, the
+                // colon of the header is always before its CRLF.
+                const char *end = buf->beginWrite();
+                const char *colon = end;
+                const char *crlf = nullptr;
+                const char *pos = buf->peek();
+                while (true)
+                {
+                    pos = internal::findEither(pos, end, ':', '\r');
+                    if (pos == end || pos + 1 == end)
+                        break;
+                    if (*pos == ':')
+                    {
+                        colon = pos;
+                        crlf = internal::findCRLF(pos + 1, end);
+                        break;
+                    }
+                    if (pos[1] == '\n')
+                    {
+                        crlf = pos;
+                        break;
+                    }
+                    ++pos;
+                }
                 if (!crlf)
                 {
                     if (buf->readableBytes() >= 64 * 1024)
@@ -206,9 +360,8 @@ int HttpRequestParser::parseRequest(MsgBuffer *buf)
                     return 0;
                 }
 
-                const char *colon = std::find(buf->peek(), crlf, ':');
                 // found colon
-                if (colon != crlf)
+                if (colon != end)
                 {
                     request_->addHeader(buf->peek(), colon, crlf);
                     buf->retrieveUntil(crlf + CRLF_LEN);
@@ -221,15 +374,14 @@ int HttpRequestParser::parseRequest(MsgBuffer *buf)
                 // and maintainability.
 
                 // process header information
-                auto &len = request_->getHeaderBy("content-length");
+                auto &len =
+                    request_->getKnownHeader(KnownHeader::kContentLength);
                 if (!len.empty())
                 {
-                    try
-                    {
-                        remainContentLength_ =
-                            static_cast<size_t>(std::stoull(len));
-                    }
-                    catch (...)
+                    auto result = std::from_chars(len.data(),
+                                                  len.data() + len.size(),
+                                                  remainContentLength_);
+                    if (result.ec != std::errc())
                     {
                         return -k400BadRequest;
                     }
@@ -246,8 +398,8 @@ int HttpRequestParser::parseRequest(MsgBuffer *buf)
                 }
                 else
                 {
-                    const std::string &encode =
-                        request_->getHeaderBy("transfer-encoding");
+                    auto &encode = request_->getKnownHeader(
+                        KnownHeader::kTransferEncoding);
                     if (encode.empty())
                     {
                         // no content-length and no transfer-encoding,
@@ -343,6 +495,11 @@ int HttpRequestParser::parseRequest(MsgBuffer *buf)
                     buf->retrieve(bytesToConsume);
                     remainContentLength_ -= bytesToConsume;
                 }
+                if (auto error = streamDecompressError(
+                        *request_, remainContentLength_ == 0))
+                {
+                    return error;
+                }
 
                 if (remainContentLength_ == 0)
                 {
@@ -355,7 +512,8 @@ int HttpRequestParser::parseRequest(MsgBuffer *buf)
             }
             case HttpRequestParseStatus::kExpectChunkLen:
             {
-                const char *crlf = buf->findCRLF();
+                const char *crlf =
+                    internal::findCRLF(buf->peek(), buf->beginWrite());
                 if (!crlf)
                 {
                     if (buf->readableBytes() > TRUNK_LEN_MAX_LEN + CRLF_LEN)
@@ -386,20 +544,44 @@ int HttpRequestParser::parseRequest(MsgBuffer *buf)
             }
             case HttpRequestParseStatus::kExpectChunkBody:
             {
-                if (buf->readableBytes() < (currentChunkLength_ + CRLF_LEN))
+                // The data of the chunk is handed over as it is received,
+                // straight from the buffer, so a large chunk is neither held
+                // in the buffer nor moved when the buffer grows.
+                size_t bytesToConsume =
+                    currentChunkLength_ <= buf->readableBytes()
+                        ? currentChunkLength_
+                        : buf->readableBytes();
+                if (bytesToConsume == 0)
+                {
+                    return 0;
+                }
+                request_->appendToBody(buf->peek(), bytesToConsume);
+                if (auto error = streamDecompressError(*request_, false))
+                {
+                    return error;
+                }
+                buf->retrieve(bytesToConsume);
+                remainContentLength_ += bytesToConsume;
+                currentChunkLength_ -= bytesToConsume;
+                if (currentChunkLength_ != 0)
+                {
+                    return 0;
+                }
+                status_ = HttpRequestParseStatus::kExpectChunkEnd;
+                continue;
+            }
+            case HttpRequestParseStatus::kExpectChunkEnd:
+            {
+                if (buf->readableBytes() < CRLF_LEN)
                 {
                     return 0;
                 }
-                if (*(buf->peek() + currentChunkLength_) != '\r' ||
-                    *(buf->peek() + currentChunkLength_ + 1) != '\n')
+                if (*(buf->peek()) != '\r' || *(buf->peek() + 1) != '\n')
                 {
                     // error!
                     return -k400BadRequest;
                 }
-                request_->appendToBody(buf->peek(), currentChunkLength_);
-                buf->retrieve(currentChunkLength_ + CRLF_LEN);
-                remainContentLength_ += currentChunkLength_;
-                currentChunkLength_ = 0;
+                buf->retrieve(CRLF_LEN);
                 status_ = HttpRequestParseStatus::kExpectChunkLen;
                 continue;
             }
@@ -416,6 +598,10 @@ int HttpRequestParser::parseRequest(MsgBuffer *buf)
                     return -k400BadRequest;
                 }
                 buf->retrieve(CRLF_LEN);
+                if (auto error = streamDecompressError(*request_, true))
+                {
+                    return error;
+                }
 
                 if (!request_->isStreamMode())
                 {
@@ -479,6 +665,20 @@ bool HttpRequestParser::pushResponseToPipelining(const HttpRequestPtr &req,
     return false;
 }
 
+void HttpRequestParser::cancelPendingRequests()
+{
+    assert(loop_->isInLoopThread());
+    std::vector<HttpRequestPtr> pending;
+    for (auto &item : requestPipelining_)
+    {
+        if (!item.second.first)
+            pending.push_back(item.first);
+    }
+    // The callbacks may touch the pipelining.
+    for (auto &req : pending)
+        static_cast<HttpRequestImpl *>(req.get())->cancel();
+}
+
 void HttpRequestParser::popReadyResponses(
     std::vector<std::pair<HttpResponsePtr, bool>> &buffer)
 {
@@ -16,12 +16,14 @@
 
 #include <drogon/HttpTypes.h>
 #include <trantor/net/TcpConnection.h>
+#include <trantor/utils/Date.h>
 #include <trantor/utils/MsgBuffer.h>
 #include <trantor/utils/NonCopyable.h>
 #include <deque>
 #include <memory>
 #include <mutex>
 #include "impl_forwards.h"
+#include "OutputWatermark.h"
 
 namespace drogon
 {
@@ -37,12 +39,16 @@ class HttpRequestParser : public trantor::NonCopyable,
         kExpectBody,
         kExpectChunkLen,
         kExpectChunkBody,
+        kExpectChunkEnd,
         kExpectLastEmptyChunk,
         kGotAll,
     };
 
     explicit HttpRequestParser(const trantor::TcpConnectionPtr &connPtr);
 
+    // The output queued in the socket beyond it is counted by MemoryPressure.
+    static constexpr size_t kAccountedOutputMark = 64 * 1024;
+
     int parseRequest(trantor::MsgBuffer *buf);
 
     bool gotAll() const
@@ -77,10 +83,30 @@ class HttpRequestParser : public trantor::NonCopyable,
         websockConnPtr_ = conn;
     }
 
+    const Http2ServerConnectionPtr &http2Conn() const
+    {
+        return http2ConnPtr_;
+    }
+
+    void setHttp2Connection(const Http2ServerConnectionPtr &conn)
+    {
+        http2ConnPtr_ = conn;
+    }
+
+    // true if nothing has been parsed on the connection yet
+    bool isExpectingFirstRequest() const
+    {
+        return requestsCounter_ == 0 &&
+               status_ == HttpRequestParseStatus::kExpectMethod;
+    }
+
     // to support request pipelining(rfc2616-8.1.2.2)
     void pushRequestToPipelining(const HttpRequestPtr &, bool isHeadMethod);
     bool pushResponseToPipelining(const HttpRequestPtr &, HttpResponsePtr);
     void popReadyResponses(std::vector<std::pair<HttpResponsePtr, bool>> &);
+    // Cancel the requests waiting for their response, when the connection is
+    // closed.
+    void cancelPendingRequests();
 
     size_t numberOfRequestsInPipelining() const
     {
@@ -92,6 +118,14 @@ class HttpRequestParser : public trantor::NonCopyable,
         return requestPipelining_.empty();
     }
 
+    // true if the request is the first one waiting for its response, the
+    // responses of the requests before it have been sent.
+    bool isFirstInPipelining(const HttpRequest *req) const
+    {
+        return !requestPipelining_.empty() &&
+               requestPipelining_.front().first.get() == req;
+    }
+
     bool isStop() const
     {
         return stopWorking_;
@@ -112,6 +146,30 @@ class HttpRequestParser : public trantor::NonCopyable,
         return sendBuffer_;
     }
 
+    // Set while the server dispatches the requests parsed from the input,
+    // the responses given synchronously are sent together afterwards.
+    bool dispatching() const
+    {
+        return dispatching_;
+    }
+
+    void setDispatching(bool dispatching)
+    {
+        dispatching_ = dispatching;
+    }
+
+    // Set while the send buffer is due to be flushed at the end of the loop
+    // iteration, see HttpAppFramework::enableOutputCorking().
+    bool flushQueued() const
+    {
+        return flushQueued_;
+    }
+
+    void setFlushQueued(bool queued)
+    {
+        flushQueued_ = queued;
+    }
+
     std::vector<std::pair<HttpResponsePtr, bool>> &getResponseBuffer()
     {
         assert(loop_->isInLoopThread());
@@ -124,6 +182,92 @@ class HttpRequestParser : public trantor::NonCopyable,
         return *responseBuffer_;
     }
 
+    // The input kept while the memory of the connections is under pressure,
+    // see HttpAppFramework::setMemorySoftLimit(). Allocated only then.
+    trantor::MsgBuffer *heldInput() const
+    {
+        return heldInput_.get();
+    }
+
+    trantor::MsgBuffer &holdInput()
+    {
+        if (!heldInput_)
+            heldInput_ = std::make_unique<trantor::MsgBuffer>();
+        return *heldInput_;
+    }
+
+    void releaseHeldInput()
+    {
+        heldInput_.reset();
+    }
+
+    // Set while the connection waits for the memory pressure to go down.
+    bool inputPaused() const
+    {
+        return inputPaused_;
+    }
+
+    void setInputPaused(bool paused)
+    {
+        inputPaused_ = paused;
+    }
+
+    // Watch the output queued in the socket beyond the mark, for the memory
+    // accounting and the watermarks of the WebSocket connection and of the
+    // response streams. Called in the loop.
+    void watchOutput(const trantor::TcpConnectionPtr &conn, size_t mark);
+    void addOutputWatermark(
+        const trantor::TcpConnectionPtr &conn,
+        const std::shared_ptr<internal::OutputWatermark> &watermark);
+
+    // The bytes of the held input and of the output queued in the socket
+    // counted by MemoryPressure.
+    size_t &accountedInput()
+    {
+        return accountedInput_;
+    }
+
+    size_t &accountedOutput()
+    {
+        return accountedOutput_;
+    }
+
+    // The time of the last read on the connection, see
+    // HttpAppFramework::setIdleMemoryTrimTimeout().
+    const trantor::Date &lastActive() const
+    {
+        return lastActive_;
+    }
+
+    void setLastActive(const trantor::Date &date)
+    {
+        lastActive_ = date;
+        trimmed_ = false;
+    }
+
+    // Release the buffers and the pooled requests while no request is being
+    // parsed or sent, return false if they can't be released now or were
+    // already released since the last read.
+    bool trimMemory();
+
+    // An estimate of the bytes allocated for the parser and its buffers.
+    size_t memoryUsage() const;
+
+    size_t numberOfPooledRequests() const
+    {
+        return requestsPool_.size();
+    }
+
+    // The bytes of the responses waiting to be flushed and of the input
+    // held by the memory pressure limit, and the output queued in the
+    // connection beyond its watched mark.
+    size_t bufferedBytes() const
+    {
+        return sendBuffer_.readableBytes() +
+               (heldInput_ ? heldInput_->readableBytes() : 0) +
+               accountedOutput_;
+    }
+
     std::vector<HttpRequestImplPtr> &getRequestBuffer()
     {
         assert(loop_->isInLoopThread());
@@ -137,22 +281,38 @@ class HttpRequestParser : public trantor::NonCopyable,
 
   private:
     HttpRequestImplPtr makeRequestForPool(HttpRequestImpl *p);
+    void onOutputQueued(const trantor::TcpConnectionPtr &conn, size_t bytes);
+    void onOutputDrained();
     bool processRequestLine(const char *begin, const char *end);
     HttpRequestParseStatus status_;
     trantor::EventLoop *loop_;
     HttpRequestImplPtr request_;
     bool firstRequest_{true};
     WebSocketConnectionImplPtr websockConnPtr_;
+    Http2ServerConnectionPtr http2ConnPtr_;
     std::deque<std::pair<HttpRequestPtr, std::pair<HttpResponsePtr, bool>>>
         requestPipelining_;
     size_t requestsCounter_{0};
     std::weak_ptr<trantor::TcpConnection> conn_;
     bool stopWorking_{false};
     trantor::MsgBuffer sendBuffer_;
+    bool flushQueued_{false};
+    bool dispatching_{false};
     std::unique_ptr<std::vector<std::pair<HttpResponsePtr, bool>>>
         responseBuffer_;
     std::unique_ptr<std::vector<HttpRequestImplPtr>> requestBuffer_;
     std::vector<HttpRequestImplPtr> requestsPool_;
+    // Set while the pool is released, the requests are deleted instead of
+    // being put back in it.
+    bool releasingPool_{false};
+    bool trimmed_{false};
+    std::unique_ptr<trantor::MsgBuffer> heldInput_;
+    bool inputPaused_{false};
+    size_t accountedInput_{0};
+    size_t accountedOutput_{0};
+    size_t watchedMark_{0};
+    std::vector<std::weak_ptr<internal::OutputWatermark>> watermarks_;
+    trantor::Date lastActive_{trantor::Date::now()};
     size_t currentChunkLength_{0};
     size_t remainContentLength_{0};
 };
@@ -16,13 +16,19 @@
 #include "AOPAdvice.h"
 #include "HttpAppFrameworkImpl.h"
 #include "HttpUtils.h"
+#include "MappedFile.h"
 #include <drogon/HttpViewData.h>
 #include <drogon/IOThreadStorage.h>
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <cstdio>
+#include <cstring>
 #include <string>
+#include <vector>
 #include <sys/stat.h>
 #include <trantor/utils/Logger.h>
 
@@ -47,7 +53,9 @@ static inline HttpResponsePtr genHttpResponse(const std::string &viewName,
     if (templ)
     {
         auto res = HttpResponse::newHttpResponse();
-        res->setBody(templ->genText(data));
+        std::string body;
+        templ->renderTo(body, data);
+        res->setBody(std::move(body));
         return res;
     }
     return drogon::HttpResponse::newNotFoundResponse(req);
@@ -64,9 +72,157 @@ bool HttpResponseImpl::allowCompression() const
     return allowCompression_;
 }
 
+namespace
+{
+// The upper limit of idle responses kept in the pool of an event loop
+constexpr size_t kMaxPooledResponses = 1024;
+
+// Recycles the responses created in an event loop, like the request pool of
+// HttpRequestParser does for requests. The pool is detached from its loop when
+// the loop quits, the responses released later are deleted.
+class ResponsePool : public std::enable_shared_from_this<ResponsePool>
+{
+  public:
+    explicit ResponsePool(trantor::EventLoop *loop) : loop_(loop)
+    {
+    }
+
+    ~ResponsePool()
+    {
+        for (auto p : responses_)
+            delete p;
+    }
+
+    trantor::EventLoop *loop() const
+    {
+        return loop_.load(std::memory_order_relaxed);
+    }
+
+    // Called in the loop thread when the loop quits.
+    void detach()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loop_ = nullptr;
+    }
+
+    HttpResponseImplPtr get()
+    {
+        HttpResponseImpl *p;
+        if (responses_.empty())
+        {
+            p = new HttpResponseImpl;
+        }
+        else
+        {
+            p = responses_.back();
+            responses_.pop_back();
+        }
+        return HttpResponseImplPtr(
+            p, [weakPtr = weak_from_this()](HttpResponseImpl *p) {
+                auto thisPtr = weakPtr.lock();
+                if (!thisPtr)
+                {
+                    delete p;
+                    return;
+                }
+                thisPtr->release(p);
+            });
+    }
+
+  private:
+    void release(HttpResponseImpl *p)
+    {
+        // The loop is only compared here, it may be gone.
+        auto loop = loop_.load(std::memory_order_acquire);
+        if (loop && trantor::EventLoop::getEventLoopOfCurrentThread() == loop)
+        {
+            recycle(p);
+            return;
+        }
+        // The loop isn't destroyed while it is used under the lock, it is
+        // detached first.
+        std::lock_guard<std::mutex> lock(mutex_);
+        loop = loop_.load(std::memory_order_relaxed);
+        if (!loop)
+        {
+            delete p;
+            return;
+        }
+        loop->queueInLoop([thisPtr = shared_from_this(), p]() {
+            thisPtr->recycle(p);
+        });
+    }
+
+    void recycle(HttpResponseImpl *p)
+    {
+        if (responses_.size() >= kMaxPooledResponses || !loop())
+        {
+            delete p;
+            return;
+        }
+        p->recycle();
+        responses_.push_back(p);
+    }
+
+    std::mutex mutex_;
+    std::atomic<trantor::EventLoop *> loop_;
+    std::vector<HttpResponseImpl *> responses_;
+};
+}  // namespace
+
+HttpResponseImplPtr HttpResponseImpl::newPooledResponse(HttpStatusCode code,
+                                                        ContentType type)
+{
+    // The pool of the loop running in this thread, a thread may run several
+    // loops one after another.
+    static thread_local std::shared_ptr<ResponsePool> pool;
+    auto loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    if (!loop)
+        return std::make_shared<HttpResponseImpl>(code, type);
+    if (!pool || pool->loop() != loop)
+    {
+        pool = std::make_shared<ResponsePool>(loop);
+        loop->runOnQuit([weakPool = std::weak_ptr<ResponsePool>(pool)]() {
+            auto quitPool = weakPool.lock();
+            if (!quitPool)
+                return;
+            quitPool->detach();
+            if (pool == quitPool)
+                pool.reset();
+        });
+    }
+    auto resp = pool->get();
+    resp->statusCode_ = code;
+    resp->statusMessage_ = statusCodeToString(code);
+    resp->creationDate_ = trantor::Date::now();
+    resp->contentType_ = type;
+    resp->flagForParsingContentType_ = true;
+    resp->contentTypeString_ = contentTypeToMime(type);
+    return resp;
+}
+
+HttpResponseImplPtr HttpResponseImpl::newResponseFromTemplate(
+    const HttpResponseImpl &templateResp,
+    std::string &&body)
+{
+    auto resp = newPooledResponse(templateResp.statusCode_,
+                                  templateResp.contentType_);
+    resp->customStatusCode_ = templateResp.customStatusCode_;
+    resp->statusMessage_ = templateResp.statusMessage_;
+    resp->version_ = templateResp.version_;
+    resp->closeConnection_ = templateResp.closeConnection_;
+    resp->passThrough_ = templateResp.passThrough_;
+    resp->contentTypeString_ = templateResp.contentTypeString_;
+    resp->headers_ = templateResp.headers_;
+    resp->cookies_ = templateResp.cookies_;
+    resp->templateHeaderString_ = templateResp.templateHeaderString_;
+    resp->bodyPtr_ = std::make_shared<HttpMessageStringBody>(std::move(body));
+    return resp;
+}
+
 HttpResponsePtr HttpResponse::newHttpResponse()
 {
-    auto res = std::make_shared<HttpResponseImpl>(k200OK, CT_TEXT_HTML);
+    auto res = HttpResponseImpl::newPooledResponse(k200OK, CT_TEXT_HTML);
     AopAdvice::instance().passResponseCreationAdvices(res);
     return res;
 }
@@ -74,14 +230,24 @@ HttpResponsePtr HttpResponse::newHttpResponse()
 HttpResponsePtr HttpResponse::newHttpResponse(HttpStatusCode code,
                                               ContentType type)
 {
-    auto res = std::make_shared<HttpResponseImpl>(code, type);
+    auto res = HttpResponseImpl::newPooledResponse(code, type);
     AopAdvice::instance().passResponseCreationAdvices(res);
     return res;
 }
 
+HttpResponsePtr HttpResponse::newHttpResponse(
+    const HttpResponsePtr &templateResp,
+    std::string body)
+{
+    return HttpResponseImpl::newResponseFromTemplate(
+        *static_cast<const HttpResponseImpl *>(templateResp.get()),
+        std::move(body));
+}
+
 HttpResponsePtr HttpResponse::newHttpJsonResponse(const Json::Value &data)
 {
-    auto res = std::make_shared<HttpResponseImpl>(k200OK, CT_APPLICATION_JSON);
+    auto res =
+        HttpResponseImpl::newPooledResponse(k200OK, CT_APPLICATION_JSON);
     res->setJsonObject(data);
     AopAdvice::instance().passResponseCreationAdvices(res);
     return res;
@@ -89,7 +255,8 @@ HttpResponsePtr HttpResponse::newHttpJsonResponse(const Json::Value &data)
 
 HttpResponsePtr HttpResponse::newHttpJsonResponse(Json::Value &&data)
 {
-    auto res = std::make_shared<HttpResponseImpl>(k200OK, CT_APPLICATION_JSON);
+    auto res =
+        HttpResponseImpl::newPooledResponse(k200OK, CT_APPLICATION_JSON);
     res->setJsonObject(std::move(data));
     AopAdvice::instance().passResponseCreationAdvices(res);
     return res;
@@ -121,24 +288,9 @@ void HttpResponseImpl::generateBodyFromJson() const
         return;
     }
     flagForSerializingJson_ = true;
-    static std::once_flag once;
-    static Json::StreamWriterBuilder builder;
-    std::call_once(once, []() {
-        builder["commentStyle"] = "None";
-        builder["indentation"] = "";
-        if (!app().isUnicodeEscapingUsedInJson())
-        {
-            builder["emitUTF8"] = true;
-        }
-        auto &precision = app().getFloatPrecisionInJson();
-        if (precision.first != 0)
-        {
-            builder["precision"] = precision.first;
-            builder["precisionType"] = precision.second;
-        }
-    });
-    bodyPtr_ = std::make_shared<HttpMessageStringBody>(
-        writeString(builder, *jsonPtr_));
+    std::string body;
+    app().getJsonEngine()->serialize(*jsonPtr_, body);
+    bodyPtr_ = std::make_shared<HttpMessageStringBody>(std::move(body));
 }
 
 HttpResponsePtr HttpResponse::newNotFoundResponse(const HttpRequestPtr &req)
@@ -176,7 +328,7 @@ HttpResponsePtr HttpResponse::newNotFoundResponse(const HttpRequestPtr &req)
                     resp = HttpResponse::newHttpViewResponse("drogon::NotFound",
                                                              data);
                     resp->setStatusCode(k404NotFound);
-                    resp->setExpiredTime(0);
+                    resp->setImmutable();
                 });
             });
             LOG_TRACE << "Use cached 404 response";
@@ -278,6 +430,101 @@ HttpResponsePtr HttpResponse::newFileResponse(
         fullPath, 0, 0, false, attachmentFileName, type, typeString, req);
 }
 
+namespace drogon
+{
+static HttpResponsePtr newRangeNotSatisfiableResponse(size_t filesize,
+                                                      bool setContentRange)
+{
+    auto resp = std::make_shared<HttpResponseImpl>();
+    resp->setStatusCode(k416RequestedRangeNotSatisfiable);
+    if (setContentRange)
+    {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "bytes */%zu", filesize);
+        resp->addHeader("Content-Range", std::string(buf));
+    }
+    return resp;
+}
+
+// Set the status code, the content type and the headers of a response of
+// which the body is the given range of a file.
+static void setFileResponseHeaders(HttpResponseImpl &resp,
+                                   const std::string &fullPath,
+                                   size_t filesize,
+                                   size_t offset,
+                                   size_t length,
+                                   bool setContentRange,
+                                   const std::string &attachmentFileName,
+                                   ContentType type,
+                                   const std::string &typeString)
+{
+    // Set correct status code
+    if (length < filesize)
+    {
+        resp.setStatusCode(k206PartialContent);
+    }
+    else
+    {
+        resp.setStatusCode(k200OK);
+    }
+
+    // Infer content type
+    if (type == CT_NONE)
+    {
+        if (!typeString.empty())
+        {
+            auto r = static_cast<HttpResponse *>(&resp);
+            if (type == CT_NONE)
+                type = parseContentType(typeString);
+            if (type == CT_NONE)
+                type = CT_CUSTOM;  // XXX: Is this Ok?
+            r->setContentTypeCodeAndCustomString(type, typeString);
+        }
+        else if (!attachmentFileName.empty())
+        {
+            resp.setContentTypeCode(
+                drogon::getContentType(attachmentFileName));
+        }
+        else
+        {
+            resp.setContentTypeCode(drogon::getContentType(fullPath));
+        }
+    }
+    else
+    {
+        if (typeString.empty())
+            resp.setContentTypeCode(type);
+        else
+        {
+            auto r = static_cast<HttpResponse *>(&resp);
+            if (type == CT_NONE)
+                type = parseContentType(typeString);
+            if (type == CT_NONE)
+                type = CT_CUSTOM;  // XXX: Is this Ok?
+            r->setContentTypeCodeAndCustomString(type, typeString);
+        }
+    }
+
+    // Set headers
+    if (!attachmentFileName.empty())
+    {
+        resp.addHeader("Content-Disposition",
+                       "attachment; filename=" + attachmentFileName);
+    }
+    if (setContentRange && length > 0)
+    {
+        char buf[128];
+        snprintf(buf,
+                 sizeof(buf),
+                 "bytes %zu-%zu/%zu",
+                 offset,
+                 offset + length - 1,
+                 filesize);
+        resp.addHeader("Content-Range", std::string(buf));
+    }
+}
+}  // namespace drogon
+
 HttpResponsePtr HttpResponse::newFileResponse(
     const std::string &fullPath,
     size_t offset,
@@ -296,21 +543,13 @@ HttpResponsePtr HttpResponse::newFileResponse(
         auto resp = HttpResponse::newNotFoundResponse(req);
         return resp;
     }
-    auto resp = std::make_shared<HttpResponseImpl>();
     std::streambuf *pbuf = infile.rdbuf();
     size_t filesize =
         static_cast<size_t>(pbuf->pubseekoff(0, std::ifstream::end));
     if (offset > filesize || length > filesize ||  // in case of overflow
         offset + length > filesize)
     {
-        resp->setStatusCode(k416RequestedRangeNotSatisfiable);
-        if (setContentRange)
-        {
-            char buf[64];
-            snprintf(buf, sizeof(buf), "bytes */%zu", filesize);
-            resp->addHeader("Content-Range", std::string(buf));
-        }
-        return resp;
+        return newRangeNotSatisfiableResponse(filesize, setContentRange);
     }
     if (length == 0)
     {
@@ -318,8 +557,9 @@ HttpResponsePtr HttpResponse::newFileResponse(
     }
     pbuf->pubseekoff(offset, std::ifstream::beg);  // rewind
 
-    if (HttpAppFrameworkImpl::instance().useSendfile() && length > 1024 * 200)
-    // TODO : Is 200k an appropriate value? Or set it to be configurable
+    auto resp = std::make_shared<HttpResponseImpl>();
+    if (HttpAppFrameworkImpl::instance().useSendfile() &&
+        length > HttpResponseImpl::kMinSendfileLength)
     {
         // The advantages of sendfile() can only be reflected in sending large
         // files.
@@ -336,71 +576,193 @@ HttpResponsePtr HttpResponse::newFileResponse(
         resp->setBody(std::move(str));
         resp->setSendfileRange(offset, length);
     }
+    setFileResponseHeaders(*resp,
+                           fullPath,
+                           filesize,
+                           offset,
+                           length,
+                           setContentRange,
+                           attachmentFileName,
+                           type,
+                           typeString);
+    AopAdvice::instance().passResponseCreationAdvices(resp);
+    return resp;
+}
 
-    // Set correct status code
-    if (length < filesize)
+HttpResponsePtr HttpResponse::newFileResponse(
+    const std::string &fullPath,
+    const std::vector<std::pair<size_t, size_t>> &ranges,
+    ContentType type,
+    const std::string &typeString,
+    const HttpRequestPtr &req)
+{
+    if (ranges.size() == 1)
     {
-        resp->setStatusCode(k206PartialContent);
+        return newFileResponse(fullPath,
+                               ranges[0].first,
+                               ranges[0].second,
+                               true,
+                               "",
+                               type,
+                               typeString,
+                               req);
     }
-    else
+    std::ifstream infile(utils::toNativePath(fullPath), std::ifstream::binary);
+    if (!infile)
     {
-        resp->setStatusCode(k200OK);
+        return HttpResponse::newNotFoundResponse(req);
     }
-
-    // Infer content type
-    if (type == CT_NONE)
+    std::streambuf *pbuf = infile.rdbuf();
+    size_t filesize =
+        static_cast<size_t>(pbuf->pubseekoff(0, std::ifstream::end));
+    size_t total{0};
+    for (auto &[offset, length] : ranges)
     {
-        if (!typeString.empty())
+        if (length == 0 || offset > filesize || length > filesize ||
+            offset + length > filesize)
         {
-            auto r = static_cast<HttpResponse *>(resp.get());
-            if (type == CT_NONE)
-                type = parseContentType(typeString);
-            if (type == CT_NONE)
-                type = CT_CUSTOM;  // XXX: Is this Ok?
-            r->setContentTypeCodeAndCustomString(type, typeString);
-        }
-        else if (!attachmentFileName.empty())
-        {
-            resp->setContentTypeCode(
-                drogon::getContentType(attachmentFileName));
-        }
-        else
-        {
-            resp->setContentTypeCode(drogon::getContentType(fullPath));
+            return newRangeNotSatisfiableResponse(filesize, true);
         }
+        total += length;
+    }
+    std::string partType = typeString;
+    if (partType.empty())
+    {
+        partType = std::string(type != CT_NONE
+                                   ? contentTypeToMime(type)
+                                   : fileNameToContentTypeAndMime(fullPath)
+                                         .second);
+        if (partType.empty())
+            partType = "application/octet-stream";
+    }
+
+    // rfc7233-4.1, the parts are separated by the boundary and have their
+    // own content type and content range.
+    auto boundary = utils::genRandomString(32);
+    std::vector<HttpResponseImpl::SendfilePart> parts;
+    parts.reserve(ranges.size() + 1);
+    char buf[128];
+    for (auto &[offset, length] : ranges)
+    {
+        HttpResponseImpl::SendfilePart part;
+        part.header.reserve(boundary.length() + partType.length() + 96);
+        part.header.append(parts.empty() ? "--" : "\r\n--")
+            .append(boundary)
+            .append("\r\nContent-Type: ")
+            .append(partType);
+        snprintf(buf,
+                 sizeof(buf),
+                 "\r\nContent-Range: bytes %zu-%zu/%zu\r\n\r\n",
+                 offset,
+                 offset + length - 1,
+                 filesize);
+        part.header.append(buf);
+        part.offset = offset;
+        part.length = length;
+        parts.emplace_back(std::move(part));
+    }
+    HttpResponseImpl::SendfilePart end;
+    end.header.append("\r\n--").append(boundary).append("--\r\n");
+    parts.emplace_back(std::move(end));
+
+    auto resp = std::make_shared<HttpResponseImpl>();
+    resp->setStatusCode(k206PartialContent);
+    static_cast<HttpResponse *>(resp.get())
+        ->setContentTypeCodeAndCustomString(
+            CT_CUSTOM, "multipart/byteranges; boundary=" + boundary);
+    // The ranges of the representation, not of an encoding of it
+    resp->setAllowCompression(false);
+    if (HttpAppFrameworkImpl::instance().useSendfile() &&
+        total > HttpResponseImpl::kMinSendfileLength)
+    {
+        resp->setSendfile(fullPath);
+        resp->setSendfileParts(std::move(parts));
     }
     else
     {
-        if (typeString.empty())
-            resp->setContentTypeCode(type);
-        else
+        std::string body;
+        for (auto &part : parts)
         {
-            auto r = static_cast<HttpResponse *>(resp.get());
-            if (type == CT_NONE)
-                type = parseContentType(typeString);
-            if (type == CT_NONE)
-                type = CT_CUSTOM;  // XXX: Is this Ok?
-            r->setContentTypeCodeAndCustomString(type, typeString);
+            body.append(part.header);
+            if (part.length == 0)
+                continue;
+            auto pos = body.length();
+            body.resize(pos + part.length);
+            pbuf->pubseekoff(part.offset, std::ifstream::beg);
+            pbuf->sgetn(&body[pos], part.length);
         }
+        resp->setBody(std::move(body));
     }
+    AopAdvice::instance().passResponseCreationAdvices(resp);
+    return resp;
+}
 
-    // Set headers
-    if (!attachmentFileName.empty())
+HttpResponsePtr HttpResponseImpl::newSendfileResponse(
+    const std::string &fullPath,
+    size_t filesize,
+    size_t offset,
+    size_t length,
+    bool setContentRange,
+    ContentType type,
+    const std::string &typeString)
+{
+    if (offset > filesize || length > filesize ||  // in case of overflow
+        offset + length > filesize)
     {
-        resp->addHeader("Content-Disposition",
-                        "attachment; filename=" + attachmentFileName);
+        return newRangeNotSatisfiableResponse(filesize, setContentRange);
     }
-    if (setContentRange && length > 0)
+    if (length == 0)
     {
-        char buf[128];
-        snprintf(buf,
-                 sizeof(buf),
-                 "bytes %zu-%zu/%zu",
-                 offset,
-                 offset + length - 1,
-                 filesize);
-        resp->addHeader("Content-Range", std::string(buf));
+        length = filesize - offset;
+    }
+    auto resp = std::make_shared<HttpResponseImpl>();
+    resp->setSendfile(fullPath);
+    resp->setSendfileRange(offset, length);
+    setFileResponseHeaders(*resp,
+                           fullPath,
+                           filesize,
+                           offset,
+                           length,
+                           setContentRange,
+                           "",
+                           type,
+                           typeString);
+    AopAdvice::instance().passResponseCreationAdvices(resp);
+    return resp;
+}
+
+HttpResponsePtr HttpResponseImpl::newMappedFileResponse(
+    const std::string &fullPath,
+    std::shared_ptr<const MappedFile> file,
+    size_t offset,
+    size_t length,
+    bool setContentRange,
+    ContentType type,
+    const std::string &typeString)
+{
+    auto filesize = file->size();
+    if (offset > filesize || length > filesize ||  // in case of overflow
+        offset + length > filesize)
+    {
+        return newRangeNotSatisfiableResponse(filesize, setContentRange);
     }
+    if (length == 0)
+    {
+        length = filesize - offset;
+    }
+    auto resp = std::make_shared<HttpResponseImpl>();
+    auto body = file->data().substr(offset, length);
+    resp->setSharedBody(std::move(file), body);
+    resp->setSendfileRange(offset, length);
+    setFileResponseHeaders(*resp,
+                           fullPath,
+                           filesize,
+                           offset,
+                           length,
+                           setContentRange,
+                           "",
+                           type,
+                           typeString);
     AopAdvice::instance().passResponseCreationAdvices(resp);
     return resp;
 }
@@ -483,6 +845,45 @@ HttpResponsePtr HttpResponse::newAsyncStreamResponse(
     return resp;
 }
 
+HttpResponsePtr HttpResponse::newJsonArrayStreamResponse(
+    const std::function<void(JsonArrayStreamPtr)> &callback,
+    bool disableKickoffTimeout)
+{
+    if (!callback)
+    {
+        return HttpResponse::newNotFoundResponse();
+    }
+    auto resp = newAsyncStreamResponse(
+        [callback](ResponseStreamPtr stream) {
+            callback(std::make_unique<JsonArrayStream>(std::move(stream)));
+        },
+        disableKickoffTimeout);
+    resp->setContentTypeCode(CT_APPLICATION_JSON);
+    return resp;
+}
+
+HttpResponsePtr HttpResponse::newSseResponse(
+    const std::function<void(SseStreamPtr)> &callback)
+{
+    if (!callback)
+    {
+        return HttpResponse::newNotFoundResponse();
+    }
+    auto resp = newAsyncStreamResponse(
+        [callback](ResponseStreamPtr stream) {
+            callback(std::make_unique<SseStream>(std::move(stream)));
+        },
+        true);
+    resp->setContentTypeCodeAndCustomString(CT_CUSTOM,
+                                            "text/event-stream");
+    resp->addHeader("cache-control", "no-cache");
+    resp->addHeader("x-accel-buffering", "no");
+    // The events are sent one by one, and the broadcast events are framed
+    // once for all the streams.
+    resp->setAllowCompression(false);
+    return resp;
+}
+
 HttpResponsePtr HttpResponse::newOptionsResponse(
     const HttpRequestPtr &request,
     const std::function<bool(std::string_view)> &originValidator,
@@ -687,7 +1088,8 @@ void HttpResponse::addCorsHeaders(
         removeHeader("Access-Control-Allow-Credentials");
 }
 
-void HttpResponseImpl::makeHeaderString(trantor::MsgBuffer &buffer)
+void HttpResponseImpl::makeHeaderString(trantor::MsgBuffer &buffer,
+                                        bool withContentLength)
 {
     buffer.ensureWritableBytes(128);
     int len{0};
@@ -734,47 +1136,8 @@ void HttpResponseImpl::makeHeaderString(trantor::MsgBuffer &buffer)
     generateBodyFromJson();
     if (!passThrough_)
     {
-        buffer.ensureWritableBytes(64);
-        if (!contentLengthIsAllowed())
-        {
-            len = 0;
-            if ((bodyPtr_ && bodyPtr_->length() > 0) ||
-                !sendfileName_.empty() || streamCallback_ ||
-                asyncStreamCallback_)
-            {
-                LOG_ERROR << "The body should be empty when the content-length "
-                             "is not allowed!";
-            }
-        }
-        else if (streamCallback_ || asyncStreamCallback_)
-        {
-            // When the headers are created, it is time to set the transfer
-            // encoding to chunked if the contents size is not specified
-            if (version_ != Version::kHttp10 &&
-                headers_.find("content-length") == headers_.end())
-            {
-                LOG_DEBUG << "send stream with transfer-encoding chunked";
-                headers_["transfer-encoding"] = "chunked";
-            }
-            len = 0;
-        }
-        else if (sendfileName_.empty())
-        {
-            auto bodyLength = bodyPtr_ ? bodyPtr_->length() : 0;
-            len = snprintf(buffer.beginWrite(),
-                           buffer.writableBytes(),
-                           contentLengthFormatString<decltype(bodyLength)>(),
-                           bodyLength);
-        }
-        else
-        {
-            auto bodyLength = sendfileRange_.second;
-            len = snprintf(buffer.beginWrite(),
-                           buffer.writableBytes(),
-                           contentLengthFormatString<decltype(bodyLength)>(),
-                           bodyLength);
-        }
-        buffer.hasWritten(len);
+        if (withContentLength)
+            appendContentLength(buffer);
         if (headers_.find("connection") == headers_.end())
         {
             if (closeConnection_)
@@ -798,6 +1161,13 @@ void HttpResponseImpl::makeHeaderString(trantor::MsgBuffer &buffer)
             buffer.append(
                 HttpAppFrameworkImpl::instance().getServerHeaderString());
         }
+        auto &altSvc = HttpAppFrameworkImpl::instance().getAltSvcHeaderField();
+        if (!altSvc.empty() && headers_.find("alt-svc") == headers_.end())
+        {
+            buffer.append("alt-svc: ");
+            buffer.append(altSvc);
+            buffer.append("\r\n");
+        }
     }
 
     for (auto it = headers_.begin(); it != headers_.end(); ++it)
@@ -809,23 +1179,167 @@ void HttpResponseImpl::makeHeaderString(trantor::MsgBuffer &buffer)
     }
 }
 
-void HttpResponseImpl::renderToBuffer(trantor::MsgBuffer &buffer)
+void HttpResponseImpl::appendContentLength(trantor::MsgBuffer &buffer)
 {
-    if (expriedTime_ >= 0)
+    int len{0};
+    buffer.ensureWritableBytes(64);
+    if (!contentLengthIsAllowed())
     {
-        auto strPtr = renderToBuffer();
-        buffer.append(strPtr->peek(), strPtr->readableBytes());
-        return;
+        if ((bodyPtr_ && bodyPtr_->length() > 0) || !sendfileName_.empty() ||
+            streamCallback_ || asyncStreamCallback_)
+        {
+            LOG_ERROR << "The body should be empty when the content-length "
+                         "is not allowed!";
+        }
     }
-
-    if (!fullHeaderString_)
+    else if (streamCallback_ || asyncStreamCallback_)
     {
-        makeHeaderString(buffer);
+        // When the headers are created, it is time to set the transfer
+        // encoding to chunked if the contents size is not specified
+        if (version_ != Version::kHttp10 &&
+            headers_.find("content-length") == headers_.end())
+        {
+            LOG_DEBUG << "send stream with transfer-encoding chunked";
+            headers_["transfer-encoding"] = "chunked";
+        }
+    }
+    else if (sendfileName_.empty())
+    {
+        auto bodyLength = bodyPtr_ ? bodyPtr_->length() : 0;
+        len = snprintf(buffer.beginWrite(),
+                       buffer.writableBytes(),
+                       contentLengthFormatString<decltype(bodyLength)>(),
+                       bodyLength);
     }
     else
+    {
+        auto bodyLength = sendfileRange_.second;
+        len = snprintf(buffer.beginWrite(),
+                       buffer.writableBytes(),
+                       contentLengthFormatString<decltype(bodyLength)>(),
+                       bodyLength);
+    }
+    buffer.hasWritten(len);
+}
+
+void HttpResponseImpl::appendHeaderString(trantor::MsgBuffer &buffer)
+{
+    if (fullHeaderString_)
     {
         buffer.append(*fullHeaderString_);
     }
+    else if (templateHeaderString_)
+    {
+        buffer.append(*templateHeaderString_);
+        if (!passThrough_)
+        {
+            generateBodyFromJson();
+            appendContentLength(buffer);
+        }
+    }
+    else
+    {
+        makeHeaderString(buffer);
+    }
+}
+
+void HttpResponseImpl::makeHttp2Headers(
+    std::vector<std::pair<std::string, std::string>> &fields)
+{
+    generateBodyFromJson();
+    fields.emplace_back(":status",
+                        std::to_string(customStatusCode_ >= 0
+                                           ? customStatusCode_
+                                           : static_cast<int>(statusCode_)));
+    bool hasContentLength{false};
+    if (!passThrough_)
+    {
+        if (contentLengthIsAllowed() && !streamCallback_ &&
+            !asyncStreamCallback_)
+        {
+            if (sendfileName_.empty())
+            {
+                fields.emplace_back("content-length",
+                                    std::to_string(
+                                        bodyPtr_ ? bodyPtr_->length() : 0));
+                hasContentLength = true;
+            }
+            else if (sendfileRange_.second > 0)
+            {
+                fields.emplace_back("content-length",
+                                    std::to_string(sendfileRange_.second));
+                hasContentLength = true;
+            }
+        }
+        if (!contentTypeString_.empty())
+        {
+            fields.emplace_back("content-type", contentTypeString_);
+        }
+        if (HttpAppFrameworkImpl::instance().sendServerHeader())
+        {
+            // "server: xxx\r\n"
+            std::string_view server =
+                HttpAppFrameworkImpl::instance().getServerHeaderString();
+            if (server.length() > 10)
+            {
+                fields.emplace_back("server",
+                                    server.substr(8, server.length() - 10));
+            }
+        }
+        auto &altSvc = HttpAppFrameworkImpl::instance().getAltSvcHeaderField();
+        if (!altSvc.empty() && headers_.find("alt-svc") == headers_.end())
+        {
+            fields.emplace_back("alt-svc", altSvc);
+        }
+    }
+    for (auto &[field, value] : headers_)
+    {
+        if (field == "connection" || field == "keep-alive" ||
+            field == "transfer-encoding" || field == "upgrade" ||
+            field == "proxy-connection" ||
+            (field == "content-length" && hasContentLength))
+        {
+            continue;
+        }
+        fields.emplace_back(field, value);
+    }
+    for (auto &[name, cookie] : cookies_)
+    {
+        (void)name;
+        // "Set-Cookie: xxx\r\n"
+        auto cookieStr = cookie.cookieString();
+        auto colon = cookieStr.find(':');
+        if (colon == std::string::npos || cookieStr.length() < colon + 4)
+            continue;
+        fields.emplace_back("set-cookie",
+                            cookieStr.substr(colon + 2,
+                                             cookieStr.length() - colon - 4));
+    }
+    if (!passThrough_ &&
+        drogon::HttpAppFrameworkImpl::instance().sendDateHeader())
+    {
+        fields.emplace_back("date",
+                            utils::getHttpFullDateStr(trantor::Date::date()));
+    }
+}
+
+void HttpResponseImpl::renderToBuffer(trantor::MsgBuffer &buffer)
+{
+    if (expriedTime_ >= 0)
+    {
+        auto strPtr = renderToBuffer();
+        buffer.append(strPtr->peek(), strPtr->readableBytes());
+        return;
+    }
+
+    renderHeaderToBuffer(buffer);
+    if (bodyPtr_ && contentLengthIsAllowed())
+        buffer.append(bodyPtr_->data(), bodyPtr_->length());
+}
+
+void HttpResponseImpl::renderHeaderToBuffer(trantor::MsgBuffer &buffer)
+{
+    appendHeaderString(buffer);
 
     // output cookies
     if (!cookies_.empty())
@@ -848,8 +1362,17 @@ void HttpResponseImpl::renderToBuffer(trantor::MsgBuffer &buffer)
     {
         buffer.append("\r\n");
     }
-    if (bodyPtr_ && contentLengthIsAllowed())
-        buffer.append(bodyPtr_->data(), bodyPtr_->length());
+}
+
+std::string_view HttpResponseImpl::bodyToSendSeparately() const
+{
+    // Only the shared bodies, which are never copied, otherwise the responses
+    // cached by expiredTime keep the whole rendered buffer. The other bodies
+    // are rendered after the header, trantor copies the data it can't write
+    // at once into its own buffer anyway.
+    if (!contentLengthIsAllowed() || !hasSharedBody())
+        return {};
+    return std::string_view(bodyPtr_->data(), bodyPtr_->length());
 }
 
 std::shared_ptr<trantor::MsgBuffer> HttpResponseImpl::renderToBuffer()
@@ -889,15 +1412,34 @@ std::shared_ptr<trantor::MsgBuffer> HttpResponseImpl::renderToBuffer()
                 return httpString_;
         }
     }
-    auto httpString = std::make_shared<trantor::MsgBuffer>(256);
-    if (!fullHeaderString_)
+    std::shared_ptr<trantor::MsgBuffer> httpString;
+    // A response shared by several loops may be rendered by them at once,
+    // only one of them uses the buffer of the last rendering at a time, the
+    // others make a new one.
+    if (!renderBufferInUse_.exchange(true, std::memory_order_acquire))
     {
-        makeHeaderString(*httpString);
+        if (renderBuffer_ && renderBuffer_.use_count() == 1)
+        {
+            // Nobody else holds the buffer of the last rendering, reuse it
+            // after the last uses of the connections which released it.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            renderBuffer_->retrieveAll();
+            httpString = renderBuffer_;
+        }
+        else
+        {
+            httpString = std::make_shared<trantor::MsgBuffer>(256);
+            renderBuffer_ = httpString;
+        }
+        // It is held by httpString, so it isn't reused by another rendering
+        // until the connection releases it.
+        renderBufferInUse_.store(false, std::memory_order_release);
     }
     else
     {
-        httpString->append(*fullHeaderString_);
+        httpString = std::make_shared<trantor::MsgBuffer>(256);
     }
+    appendHeaderString(*httpString);
 
     // output cookies
     if (!cookies_.empty())
@@ -939,38 +1481,7 @@ std::shared_ptr<trantor::MsgBuffer> HttpResponseImpl::
     renderHeaderForHeadMethod()
 {
     auto httpString = std::make_shared<trantor::MsgBuffer>(256);
-    if (!fullHeaderString_)
-    {
-        makeHeaderString(*httpString);
-    }
-    else
-    {
-        httpString->append(*fullHeaderString_);
-    }
-
-    // output cookies
-    if (!cookies_.empty())
-    {
-        for (auto it = cookies_.begin(); it != cookies_.end(); ++it)
-        {
-            httpString->append(it->second.cookieString());
-        }
-    }
-
-    // output Date header
-    if (!passThrough_ &&
-        drogon::HttpAppFrameworkImpl::instance().sendDateHeader())
-    {
-        httpString->append("date: ");
-        httpString->append(utils::getHttpFullDate(trantor::Date::date()),
-                           httpFullDateStringLength);
-        httpString->append("\r\n\r\n");
-    }
-    else
-    {
-        httpString->append("\r\n");
-    }
-
+    renderHeaderToBuffer(*httpString);
     return httpString;
 }
 
@@ -979,6 +1490,7 @@ void HttpResponseImpl::addHeader(const char *start,
                                  const char *end)
 {
     fullHeaderString_.reset();
+    templateHeaderString_.reset();
     std::string field(start, colon);
     transform(field.begin(), field.end(), field.begin(), [](unsigned char c) {
         return tolower(c);
@@ -1096,11 +1608,14 @@ void HttpResponseImpl::swap(HttpResponseImpl &that) noexcept
     swap(flagForParsingContentType_, that.flagForParsingContentType_);
     swap(flagForParsingJson_, that.flagForParsingJson_);
     swap(sendfileName_, that.sendfileName_);
+    swap(sendfileParts_, that.sendfileParts_);
     swap(streamCallback_, that.streamCallback_);
     swap(asyncStreamCallback_, that.asyncStreamCallback_);
     jsonPtr_.swap(that.jsonPtr_);
     fullHeaderString_.swap(that.fullHeaderString_);
+    templateHeaderString_.swap(that.templateHeaderString_);
     httpString_.swap(that.httpString_);
+    renderBuffer_.swap(that.renderBuffer_);
     swap(datePos_, that.datePos_);
     swap(jsonParsingErrorPtr_, that.jsonParsingErrorPtr_);
 }
@@ -1111,8 +1626,10 @@ void HttpResponseImpl::clear()
     version_ = Version::kHttp11;
     statusMessage_ = std::string_view{};
     fullHeaderString_.reset();
+    templateHeaderString_.reset();
     jsonParsingErrorPtr_.reset();
     sendfileName_.clear();
+    sendfileParts_.clear();
     if (streamCallback_)
     {
         LOG_TRACE << "Cleanup HttpResponse stream callback";
@@ -1125,33 +1642,51 @@ void HttpResponseImpl::clear()
         asyncStreamCallback_ = {};
     }
     headers_.clear();
+    trailers_.clear();
     cookies_.clear();
     bodyPtr_.reset();
     jsonPtr_.reset();
     expriedTime_ = -1;
+    immutable_ = false;
     datePos_ = std::string::npos;
     flagForParsingContentType_ = false;
     flagForParsingJson_ = false;
 }
 
+void HttpResponseImpl::recycle()
+{
+    clear();
+    allowCompression_ = true;
+    compressionPolicy_.reset();
+    customStatusCode_ = -1;
+    closeConnection_ = false;
+    sendfileRange_ = {0, 0};
+    asyncStreamDisableKickoff_ = false;
+    peerCertificate_.reset();
+    httpString_.reset();
+    httpStringDate_ = -1;
+    flagForSerializingJson_ = true;
+    contentType_ = CT_TEXT_PLAIN;
+    contentTypeString_ = "text/html; charset=utf-8";
+    passThrough_ = false;
+    // Don't keep big buffers in the pool
+    if (renderBuffer_ && (renderBuffer_.use_count() > 1 ||
+                          renderBuffer_->readableBytes() > 64 * 1024))
+    {
+        renderBuffer_.reset();
+    }
+}
+
 void HttpResponseImpl::parseJson() const
 {
-    static std::once_flag once;
-    static Json::CharReaderBuilder builder;
-    std::call_once(once, []() {
-        builder["collectComments"] = false;
-        builder["stackLimit"] =
-            static_cast<Json::UInt>(drogon::app().getJsonParserStackLimit());
-    });
-    JSONCPP_STRING errs;
-    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
     if (bodyPtr_)
     {
         jsonPtr_ = std::make_shared<Json::Value>();
-        if (!reader->parse(bodyPtr_->data(),
-                           bodyPtr_->data() + bodyPtr_->length(),
-                           jsonPtr_.get(),
-                           &errs))
+        std::string errs;
+        if (!app().getJsonEngine()->parse(
+                std::string_view(bodyPtr_->data(), bodyPtr_->length()),
+                *jsonPtr_,
+                errs))
         {
             LOG_ERROR << errs;
             LOG_ERROR << "body: " << bodyPtr_->getString();
@@ -1172,7 +1707,8 @@ void HttpResponseImpl::parseJson() const
     }
 }
 
-bool HttpResponseImpl::shouldBeCompressed() const
+bool HttpResponseImpl::shouldBeCompressed(
+    const CompressionPolicy &policy) const
 {
     // If the developer said "No" stop immediately.
     if (!allowCompression_)
@@ -1181,8 +1717,8 @@ bool HttpResponseImpl::shouldBeCompressed() const
     }
 
     if (streamCallback_ || asyncStreamCallback_ || !sendfileName_.empty() ||
-        contentType() >= CT_APPLICATION_OCTET_STREAM ||
-        getBody().length() < 1024 ||
+        !policy.shouldCompress(contentType()) ||
+        getBody().length() < policy.minSize ||
         !(getHeaderBy("content-encoding").empty()) || !contentLengthIsAllowed())
     {
         return false;
@@ -1190,6 +1726,117 @@ bool HttpResponseImpl::shouldBeCompressed() const
     return true;
 }
 
+bool HttpResponseImpl::streamShouldBeCompressed(
+    const CompressionPolicy &policy) const
+{
+    if (!allowCompression_ || (!streamCallback_ && !asyncStreamCallback_))
+    {
+        return false;
+    }
+    // The length given by the developer is not the compressed length
+    if (!policy.shouldCompress(contentType()) ||
+        !(getHeaderBy("content-encoding").empty()) ||
+        !(getHeaderBy("content-length").empty()) || !contentLengthIsAllowed())
+    {
+        return false;
+    }
+    return true;
+}
+
+namespace
+{
+// Pulls the data of a stream callback and returns it compressed
+struct CompressedStreamSource
+{
+    std::function<std::size_t(char *, std::size_t)> source;
+    std::unique_ptr<StreamCompressor> compressor;
+    std::string input;
+    std::string output;
+    size_t outputOffset{0};
+    bool finished{false};
+
+    std::size_t read(char *buffer, std::size_t length)
+    {
+        if (buffer == nullptr)
+        {
+            // Cleanup
+            if (source)
+            {
+                source(nullptr, 0);
+                source = {};
+            }
+            return 0;
+        }
+        // The compressor may take some input without any output
+        while (outputOffset == output.size())
+        {
+            output.clear();
+            outputOffset = 0;
+            if (finished)
+                return 0;
+            input.resize(16 * 1024);
+            auto n = source(&input[0], input.size());
+            bool ok;
+            if (n == 0)
+            {
+                finished = true;
+                ok = compressor->finish(output);
+            }
+            else
+            {
+                ok = compressor->compress(input.data(), n, false, output);
+            }
+            if (!ok)
+            {
+                LOG_ERROR << "Failed to compress the stream";
+                finished = true;
+                output.clear();
+                return 0;
+            }
+        }
+        auto n = (std::min)(length, output.size() - outputOffset);
+        memcpy(buffer, output.data() + outputOffset, n);
+        outputOffset += n;
+        return n;
+    }
+};
+}  // namespace
+
+bool HttpResponseImpl::compressStream(CompressionEncoding encoding, int level)
+{
+    if (streamCallback_)
+    {
+        auto compressor = StreamCompressor::newCompressor(encoding, level);
+        if (!compressor)
+            return false;
+        auto ctx = std::make_shared<CompressedStreamSource>();
+        ctx->source = std::move(streamCallback_);
+        ctx->compressor = std::move(compressor);
+        streamCallback_ = [ctx](char *buffer, std::size_t length) {
+            return ctx->read(buffer, length);
+        };
+    }
+    else if (asyncStreamCallback_)
+    {
+        // Check the encoding before the stream is created
+        if (!StreamCompressor::newCompressor(encoding, level))
+            return false;
+        asyncStreamCallback_ = [callback = std::move(asyncStreamCallback_),
+                                encoding,
+                                level](ResponseStreamPtr stream) {
+            stream->compressor_ =
+                StreamCompressor::newCompressor(encoding, level);
+            callback(std::move(stream));
+        };
+    }
+    else
+    {
+        return false;
+    }
+    addHeader("content-encoding", compressionEncodingToString(encoding));
+    return true;
+}
+
 void HttpResponseImpl::setContentTypeString(const char *typeString,
                                             size_t typeStringLength)
 {
@@ -1200,4 +1847,5 @@ void HttpResponseImpl::setContentTypeString(const char *typeString,
     contentType_ = contentType;
     contentTypeString_ = std::string(sv);
     flagForParsingContentType_ = true;
+    templateHeaderString_.reset();
 }
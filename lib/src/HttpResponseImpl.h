@@ -16,6 +16,7 @@
 
 #include "HttpUtils.h"
 #include "HttpMessageBody.h"
+#include "StreamCompressor.h"
 #include <drogon/exports.h>
 #include <drogon/HttpResponse.h>
 #include <drogon/utils/Utilities.h>
@@ -27,9 +28,30 @@
 #include <string>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
 
 namespace drogon
 {
+class MappedFile;
+
+// An atomic flag which starts cleared in the copies, so the responses stay
+// copyable.
+struct RenderBufferFlag : std::atomic<bool>
+{
+    RenderBufferFlag() : std::atomic<bool>(false)
+    {
+    }
+
+    RenderBufferFlag(const RenderBufferFlag &) : std::atomic<bool>(false)
+    {
+    }
+
+    RenderBufferFlag &operator=(const RenderBufferFlag &)
+    {
+        return *this;
+    }
+};
+
 class DROGON_EXPORT HttpResponseImpl : public HttpResponse
 {
     friend class HttpResponseParser;
@@ -52,6 +74,14 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
     void setPassThrough(bool flag) override
     {
         passThrough_ = flag;
+        templateHeaderString_.reset();
+    }
+
+    void freezeAsTemplate() override
+    {
+        auto headerString = std::make_shared<trantor::MsgBuffer>(128);
+        makeHeaderString(*headerString, false);
+        templateHeaderString_ = std::move(headerString);
     }
 
     HttpStatusCode statusCode() const override
@@ -68,14 +98,22 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
     {
         statusCode_ = code;
         setStatusMessage(statusCodeToString(code));
+        templateHeaderString_.reset();
     }
 
     void setVersion(const Version v) override
     {
-        version_ = v;
-        if (version_ == Version::kHttp10)
+        // Cached responses are sent by many threads, nothing is written if
+        // nothing changes.
+        if (version_ != v)
+        {
+            version_ = v;
+            templateHeaderString_.reset();
+        }
+        if (version_ == Version::kHttp10 && !closeConnection_)
         {
             closeConnection_ = true;
+            templateHeaderString_.reset();
         }
     }
 
@@ -88,7 +126,11 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
 
     void setCloseConnection(bool on) override
     {
-        closeConnection_ = on;
+        if (closeConnection_ != on)
+        {
+            closeConnection_ = on;
+            templateHeaderString_.reset();
+        }
     }
 
     bool ifCloseConnection() const override
@@ -102,6 +144,7 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
         auto ct = contentTypeToMime(type);
         contentTypeString_ = std::string(ct.data(), ct.size());
         flagForParsingContentType_ = true;
+        templateHeaderString_.reset();
     }
 
     //  void setContentTypeCodeAndCharacterSet(ContentType type, const
@@ -152,12 +195,14 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
     void removeHeaderBy(const std::string &lowerKey)
     {
         fullHeaderString_.reset();
+        templateHeaderString_.reset();
         headers_.erase(lowerKey);
     }
 
     void addHeader(std::string field, const std::string &value) override
     {
         fullHeaderString_.reset();
+        templateHeaderString_.reset();
         transform(field.begin(),
                   field.end(),
                   field.begin(),
@@ -168,6 +213,7 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
     void addHeader(std::string field, std::string &&value) override
     {
         fullHeaderString_.reset();
+        templateHeaderString_.reset();
         transform(field.begin(),
                   field.end(),
                   field.begin(),
@@ -177,6 +223,32 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
 
     void addHeader(const char *start, const char *colon, const char *end);
 
+    void addTrailer(std::string field, std::string value) override
+    {
+        transform(field.begin(),
+                  field.end(),
+                  field.begin(),
+                  [](unsigned char c) { return tolower(c); });
+        trailers_[std::move(field)] = std::move(value);
+    }
+
+    const std::string &getTrailer(std::string key) const override
+    {
+        static const std::string defaultVal;
+        transform(key.begin(), key.end(), key.begin(), [](unsigned char c) {
+            return tolower(c);
+        });
+        auto iter = trailers_.find(key);
+        if (iter == trailers_.end())
+            return defaultVal;
+        return iter->second;
+    }
+
+    const SafeStringMap<std::string> &trailers() const override
+    {
+        return trailers_;
+    }
+
     void addCookie(const std::string &key, const std::string &value) override
     {
         cookies_[key] = Cookie(key, value);
@@ -231,6 +303,41 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
         }
     }
 
+    /**
+     * @brief Use an immutable string shared with other responses as the
+     * body. The body is sent by reference and never copied into the rendered
+     * buffer.
+     */
+    void setSharedBody(std::shared_ptr<const std::string> body)
+    {
+        bodyPtr_ = std::make_shared<HttpMessageSharedBody>(std::move(body));
+        if (passThrough_)
+        {
+            addHeader("content-length", std::to_string(bodyPtr_->length()));
+        }
+    }
+
+    /**
+     * @brief Use the memory kept alive by the owner as the body, the memory
+     * must not be modified while the owner is alive.
+     */
+    void setSharedBody(std::shared_ptr<const void> owner,
+                       std::string_view body) override
+    {
+        bodyPtr_ = std::make_shared<HttpMessageSharedBody>(std::move(owner),
+                                                           body);
+        if (passThrough_)
+        {
+            addHeader("content-length", std::to_string(bodyPtr_->length()));
+        }
+    }
+
+    bool hasSharedBody() const
+    {
+        return bodyPtr_ &&
+               bodyPtr_->bodyType() == HttpMessageBody::BodyType::kShared;
+    }
+
     void redirect(const std::string &url)
     {
         headers_["location"] = url;
@@ -239,15 +346,82 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
     std::shared_ptr<trantor::MsgBuffer> renderToBuffer();
     void renderToBuffer(trantor::MsgBuffer &buffer);
     std::shared_ptr<trantor::MsgBuffer> renderHeaderForHeadMethod();
+    void renderHeaderToBuffer(trantor::MsgBuffer &buffer);
+
+    /**
+     * @brief Return the body if it is shared, to be sent right after the
+     * header rendered by renderHeaderForHeadMethod() instead of being copied
+     * into the rendered buffer, otherwise return an empty view.
+     *
+     * @note The view is valid until the body of the response is changed.
+     */
+    std::string_view bodyToSendSeparately() const;
     void clear() override;
 
+    /**
+     * @brief Restore the state of a newly constructed response for reuse by
+     * the response pool, the containers and the render buffer keep their
+     * capacity.
+     */
+    void recycle();
+
+    /**
+     * @brief Get a response from the pool of the current event loop, a new
+     * object is created when the pool is empty or the current thread is not
+     * an event loop thread. The response goes back to the pool of its loop
+     * when the last reference is released.
+     */
+    static std::shared_ptr<HttpResponseImpl> newPooledResponse(
+        HttpStatusCode code,
+        ContentType type);
+
+    /**
+     * @brief Get a response from the pool with the status, the headers and
+     * the header string of the frozen template, and the body.
+     */
+    static std::shared_ptr<HttpResponseImpl> newResponseFromTemplate(
+        const HttpResponseImpl &templateResp,
+        std::string &&body);
+
+    // Files longer than this are sent by sendfile() if it is enabled.
+    // TODO : Is 200k an appropriate value? Or set it to be configurable
+    static constexpr size_t kMinSendfileLength = 1024 * 200;
+
+    /**
+     * @brief Create a response of which the body is the range of the mapped
+     * file, the same as newFileResponse() does for the file on disk.
+     */
+    static HttpResponsePtr newMappedFileResponse(
+        const std::string &fullPath,
+        std::shared_ptr<const MappedFile> file,
+        size_t offset,
+        size_t length,
+        bool setContentRange,
+        ContentType type,
+        const std::string &typeString);
+
+    /**
+     * @brief Create a response of which the body is the range of the file
+     * sent by sendfile(), the same as newFileResponse() does, without opening
+     * the file whose size is known.
+     */
+    static HttpResponsePtr newSendfileResponse(const std::string &fullPath,
+                                               size_t filesize,
+                                               size_t offset,
+                                               size_t length,
+                                               bool setContentRange,
+                                               ContentType type,
+                                               const std::string &typeString);
+
     void setExpiredTime(ssize_t expiredTime) override
     {
         expriedTime_ = expiredTime;
+        immutable_ = false;
         datePos_ = std::string::npos;
         if (expriedTime_ < 0 && version_ == Version::kHttp10)
         {
             fullHeaderString_.reset();
+            templateHeaderString_.reset();
         }
     }
 
@@ -256,6 +430,18 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
         return expriedTime_;
     }
 
+    void setImmutable() override
+    {
+        setExpiredTime(0);
+        immutable_ = true;
+        renderToBuffer();
+    }
+
+    bool isImmutable() const override
+    {
+        return immutable_;
+    }
+
     const char *getBodyData() const override
     {
         if (!flagForSerializingJson_ && jsonPtr_)
@@ -313,7 +499,25 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
         jsonPtr_ = std::make_shared<Json::Value>(std::move(pJson));
     }
 
-    bool shouldBeCompressed() const;
+    bool shouldBeCompressed(const CompressionPolicy &policy) const;
+
+    /// Return true if the stream or async stream body should be compressed
+    bool streamShouldBeCompressed(const CompressionPolicy &policy) const;
+
+    /// Return the policy set by setCompressionPolicy(), or nullptr
+    const std::shared_ptr<const CompressionPolicy> &compressionPolicy() const
+    {
+        return compressionPolicy_;
+    }
+
+    /**
+     * @brief Compress the stream or async stream body chunk by chunk while it
+     * is sent, and set the content-encoding header.
+     *
+     * @return false if the encoding is not supported.
+     */
+    bool compressStream(CompressionEncoding encoding, int level);
+
     void generateBodyFromJson() const;
 
     const std::string &sendfileName() const override
@@ -347,6 +551,31 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
         sendfileRange_.second = len;
     }
 
+    // A part of a multipart/byteranges body, the header is sent before the
+    // range of the sendfile file. The last part is the closing boundary.
+    struct SendfilePart
+    {
+        std::string header;
+        size_t offset{0};
+        size_t length{0};
+    };
+
+    // The body is sent from the parts instead of one range of the file, the
+    // length of the sendfile range is the length of the body then.
+    const std::vector<SendfilePart> &sendfileParts() const
+    {
+        return sendfileParts_;
+    }
+
+    void setSendfileParts(std::vector<SendfilePart> &&parts)
+    {
+        size_t length{0};
+        for (auto &part : parts)
+            length += part.header.length() + part.length;
+        sendfileParts_ = std::move(parts);
+        sendfileRange_ = {0, length};
+    }
+
     const std::function<std::size_t(char *, std::size_t)> &streamCallback()
         const override
     {
@@ -384,6 +613,14 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
         makeHeaderString(*fullHeaderString_);
     }
 
+    /**
+     * @brief Make the header fields of a HTTP/2 response, including the
+     * :status pseudo header and cookies. Connection-specific headers are
+     * omitted (rfc7540-8.1.2.2).
+     */
+    void makeHttp2Headers(
+        std::vector<std::pair<std::string, std::string>> &fields);
+
     std::string contentTypeString() const override
     {
         parseContentTypeAndString();
@@ -429,7 +666,13 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
     ~HttpResponseImpl() override = default;
 
   protected:
-    void makeHeaderString(trantor::MsgBuffer &headerString);
+    // The content-length header is left to appendContentLength() when
+    // withContentLength is false.
+    void makeHeaderString(trantor::MsgBuffer &headerString,
+                          bool withContentLength = true);
+    void appendContentLength(trantor::MsgBuffer &buffer);
+    // Append the cached header string, the one of the template or a new one.
+    void appendHeaderString(trantor::MsgBuffer &buffer);
 
     void parseContentTypeAndString() const
     {
@@ -464,11 +707,17 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
 
   private:
     bool allowCompression_{true};
+    std::shared_ptr<const CompressionPolicy> compressionPolicy_;
 
     void setAllowCompression(bool allow) override;
 
     bool allowCompression() const override;
 
+    void setCompressionPolicy(const CompressionPolicy &policy) override
+    {
+        compressionPolicy_ = std::make_shared<CompressionPolicy>(policy);
+    }
+
     void setBody(const char *body, size_t len) override
     {
         bodyPtr_ = std::make_shared<HttpMessageStringViewBody>(body, len);
@@ -484,6 +733,7 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
     {
         contentType_ = type;
         flagForParsingContentType_ = true;
+        templateHeaderString_.reset();
 
         std::string_view sv(typeString, typeStringLength);
         bool haveHeader = sv.find("content-type: ") == 0;
@@ -508,9 +758,11 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
         assert(code >= 0);
         customStatusCode_ = code;
         statusMessage_ = std::string_view{message, messageLength};
+        templateHeaderString_.reset();
     }
 
     SafeStringMap<std::string> headers_;
+    SafeStringMap<std::string> trailers_;
     SafeStringMap<Cookie> cookies_;
 
     int customStatusCode_{-1};
@@ -522,8 +774,10 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
     bool closeConnection_{false};
     mutable std::shared_ptr<HttpMessageBody> bodyPtr_;
     ssize_t expriedTime_{-1};
+    bool immutable_{false};
     std::string sendfileName_;
     SendfileRange sendfileRange_{0, 0};
+    std::vector<SendfilePart> sendfileParts_;
     std::function<std::size_t(char *, std::size_t)> streamCallback_;
     std::function<void(ResponseStreamPtr)> asyncStreamCallback_;
     bool asyncStreamDisableKickoff_{false};
@@ -531,8 +785,16 @@ class DROGON_EXPORT HttpResponseImpl : public HttpResponse
     mutable std::shared_ptr<Json::Value> jsonPtr_;
 
     std::shared_ptr<trantor::MsgBuffer> fullHeaderString_;
+    // The status line and the headers but the content-length of the frozen
+    // template, shared by the responses created from it.
+    std::shared_ptr<const trantor::MsgBuffer> templateHeaderString_;
     trantor::CertificatePtr peerCertificate_;
     mutable std::shared_ptr<trantor::MsgBuffer> httpString_;
+    // The buffer of the last rendering, reused once it is released by the
+    // connection.
+    std::shared_ptr<trantor::MsgBuffer> renderBuffer_;
+    // Set while a rendering uses renderBuffer_, see renderToBuffer().
+    RenderBufferFlag renderBufferInUse_;
     mutable size_t datePos_{static_cast<size_t>(-1)};
     mutable int64_t httpStringDate_{-1};
     mutable bool flagForParsingJson_{false};
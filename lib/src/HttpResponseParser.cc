@@ -30,6 +30,22 @@ void HttpResponseParser::reset()
     parseResponseForHeadMethod_ = false;
     leftBodyLength_ = 0;
     currentChunkLength_ = 0;
+    bodyCallback_ = nullptr;
+}
+
+void HttpResponseParser::appendBody(const char *data, size_t length)
+{
+    if (bodyCallback_)
+    {
+        if (length > 0)
+            bodyCallback_(data, length);
+        return;
+    }
+    if (!responsePtr_->bodyPtr_)
+    {
+        responsePtr_->bodyPtr_ = std::make_shared<HttpMessageStringBody>();
+    }
+    responsePtr_->bodyPtr_->append(data, length);
 }
 
 HttpResponseParser::HttpResponseParser(const trantor::TcpConnectionPtr &connPtr)
@@ -124,6 +140,17 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
                 {
                     responsePtr_->addHeader(buf->peek(), colon, crlf);
                 }
+                else if (responsePtr_->statusCode() >= k100Continue &&
+                         responsePtr_->statusCode() < k200OK &&
+                         responsePtr_->statusCode() != k101SwitchingProtocols)
+                {
+                    // Informational response (e.g. 103 Early Hints), the
+                    // final response follows
+                    buf->retrieveUntil(crlf + 2);
+                    responsePtr_.reset(new HttpResponseImpl);
+                    status_ = HttpResponseParseStatus::kExpectResponseLine;
+                    continue;
+                }
                 else
                 {
                     const std::string &len =
@@ -189,6 +216,16 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
                         status_ = HttpResponseParseStatus::kGotAll;
                         hasMore = false;
                     }
+                    if (bodyCallback_)
+                    {
+                        // Let the headers be handled before the body
+                        if (status_ == HttpResponseParseStatus::kExpectBody &&
+                            leftBodyLength_ == 0)
+                        {
+                            status_ = HttpResponseParseStatus::kGotAll;
+                        }
+                        hasMore = false;
+                    }
                 }
                 buf->retrieveUntil(crlf + 2);
             }
@@ -209,22 +246,16 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
                 }
                 break;
             }
-            if (!responsePtr_->bodyPtr_)
-            {
-                responsePtr_->bodyPtr_ =
-                    std::make_shared<HttpMessageStringBody>();
-            }
             if (leftBodyLength_ >= buf->readableBytes())
             {
                 leftBodyLength_ -= buf->readableBytes();
 
-                responsePtr_->bodyPtr_->append(buf->peek(),
-                                               buf->readableBytes());
+                appendBody(buf->peek(), buf->readableBytes());
                 buf->retrieveAll();
             }
             else
             {
-                responsePtr_->bodyPtr_->append(buf->peek(), leftBodyLength_);
+                appendBody(buf->peek(), leftBodyLength_);
                 buf->retrieve(leftBodyLength_);
                 leftBodyLength_ = 0;
             }
@@ -239,12 +270,7 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
         }
         else if (status_ == HttpResponseParseStatus::kExpectClose)
         {
-            if (!responsePtr_->bodyPtr_)
-            {
-                responsePtr_->bodyPtr_ =
-                    std::make_shared<HttpMessageStringBody>();
-            }
-            responsePtr_->bodyPtr_->append(buf->peek(), buf->readableBytes());
+            appendBody(buf->peek(), buf->readableBytes());
             buf->retrieveAll();
             break;
         }
@@ -283,18 +309,22 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
         {
             // LOG_TRACE<<"expect chunk
             // len="<<currentChunkLength_;
+            if (bodyCallback_ && currentChunkLength_ > 0)
+            {
+                // Pass on the part of the chunk received, a chunk may be as
+                // large as the whole body.
+                auto length =
+                    (std::min)(buf->readableBytes(), currentChunkLength_);
+                appendBody(buf->peek(), length);
+                buf->retrieve(length);
+                currentChunkLength_ -= length;
+            }
             if (buf->readableBytes() >= (currentChunkLength_ + 2))
             {
                 if (*(buf->peek() + currentChunkLength_) == '\r' &&
                     *(buf->peek() + currentChunkLength_ + 1) == '\n')
                 {
-                    if (!responsePtr_->bodyPtr_)
-                    {
-                        responsePtr_->bodyPtr_ =
-                            std::make_shared<HttpMessageStringBody>();
-                    }
-                    responsePtr_->bodyPtr_->append(buf->peek(),
-                                                   currentChunkLength_);
+                    appendBody(buf->peek(), currentChunkLength_);
                     buf->retrieve(currentChunkLength_ + 2);
                     currentChunkLength_ = 0;
                     status_ = HttpResponseParseStatus::kExpectChunkLen;
@@ -319,10 +349,13 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
             {
                 buf->retrieveUntil(crlf + 2);
                 status_ = HttpResponseParseStatus::kGotAll;
-                responsePtr_->addHeader("content-length",
-                                        std::to_string(
-                                            responsePtr_->getBody().length()));
-                responsePtr_->removeHeaderBy("transfer-encoding");
+                if (!bodyCallback_)
+                {
+                    responsePtr_->addHeader(
+                        "content-length",
+                        std::to_string(responsePtr_->getBody().length()));
+                    responsePtr_->removeHeaderBy("transfer-encoding");
+                }
                 break;
             }
             else
@@ -18,6 +18,7 @@
 #include <trantor/utils/NonCopyable.h>
 #include <trantor/net/TcpConnection.h>
 #include <trantor/utils/MsgBuffer.h>
+#include <functional>
 #include <list>
 #include <mutex>
 
@@ -58,6 +59,23 @@ class HttpResponseParser : public trantor::NonCopyable
 
     void reset();
 
+    /// Pass the body to the callback instead of storing it in the response.
+    /// The parsing stops once after the headers, see headersComplete().
+    void setBodyCallback(std::function<void(const char *, size_t)> callback)
+    {
+        bodyCallback_ = std::move(callback);
+    }
+
+    bool hasBodyCallback() const
+    {
+        return static_cast<bool>(bodyCallback_);
+    }
+
+    bool headersComplete() const
+    {
+        return status_ > HttpResponseParseStatus::kExpectHeaders;
+    }
+
     const HttpResponseImplPtr &responseImpl() const
     {
         return responsePtr_;
@@ -65,6 +83,7 @@ class HttpResponseParser : public trantor::NonCopyable
 
   private:
     bool processResponseLine(const char *begin, const char *end);
+    void appendBody(const char *data, size_t length);
 
     HttpResponseParseStatus status_;
     HttpResponseImplPtr responsePtr_;
@@ -72,6 +91,7 @@ class HttpResponseParser : public trantor::NonCopyable
     size_t leftBodyLength_{0};
     size_t currentChunkLength_{0};
     std::weak_ptr<trantor::TcpConnection> conn_;
+    std::function<void(const char *, size_t)> bodyCallback_;
 };
 
 }  // namespace drogon
@@ -14,22 +14,39 @@
 
 #include "HttpServer.h"
 #include <drogon/HttpResponse.h>
+#include <drogon/RequestDeadline.h>
 #include <drogon/utils/Utilities.h>
 #include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <optional>
+#include <unordered_set>
 #include <utility>
 #include "AOPAdvice.h"
+#include "BuiltinMetrics.h"
+#include "ConnectionBalancer.h"
+#include "CpuProfiler.h"
 #include "MiddlewaresFunction.h"
+#include "RequestTracing.h"
+#include "RouteCost.h"
 #include "HttpAppFrameworkImpl.h"
 #include "HttpConnectionLimit.h"
+#include "Http2ServerConnection.h"
 #include "HttpControllerBinder.h"
 #include "HttpRequestImpl.h"
 #include "HttpRequestParser.h"
 #include "HttpResponseImpl.h"
 #include "HttpControllersRouter.h"
+#include "MemoryPressure.h"
+#include "Probes.h"
 #include "StaticFileRouter.h"
 #include "WebSocketConnectionImpl.h"
+#include "WorkStealingThreadPool.h"
 #include "impl_forwards.h"
 
 #if COZ_PROFILING
@@ -57,7 +74,28 @@ static inline HttpResponsePtr getCompressedResponse(
     const HttpRequestImplPtr &req,
     const HttpResponsePtr &response,
     bool isHeadMethod);
-
+static inline HttpResponsePtr getConditionalResponse(
+    const HttpRequestImplPtr &req,
+    const HttpResponsePtr &response);
+
+static inline void sampleRequest(const HttpRequestImplPtr &req);
+static inline void setDeadline(const HttpRequestImplPtr &req);
+static inline void markTrace(const HttpRequestImplPtr &req,
+                             RequestTrace::Stage stage);
+static inline void exportTrace(const HttpRequestImplPtr &req,
+                               const HttpResponsePtr &resp);
+static inline void probeHandlerEnd(const HttpRequestImplPtr &req,
+                                   const HttpResponsePtr &resp);
+static inline void probeResponseSend(const HttpRequestImplPtr &req,
+                                     const HttpResponsePtr &resp);
+
+static void flushSendBuffer(const TcpConnectionPtr &conn,
+                            HttpRequestParser &requestParser);
+static void sendFileBody(const TcpConnectionPtr &conn,
+                         const HttpResponseImpl &resp);
+static void watchIdleConnection(EventLoop *loop,
+                                HttpRequestParser *requestParser);
+static void unwatchIdleConnection(HttpRequestParser *requestParser);
 static void handleInvalidHttpMethod(
     const HttpRequestImplPtr &req,
     std::function<void(const HttpResponsePtr &)> &&callback);
@@ -116,12 +154,24 @@ void HttpServer::onConnection(const TcpConnectionPtr &conn)
         auto parser = std::make_shared<HttpRequestParser>(conn);
         parser->reset();
         conn->setContext(parser);
+        watchIdleConnection(conn->getLoop(), parser.get());
+        // Released with the connection limit when the connection is closed
+        ConnectionBalancer::instance().connectionOpened(conn->getLoop());
         if (!HttpConnectionLimit::instance().tryAddConnection(conn))
         {
             LOG_ERROR << "too much connections!force close!";
             conn->forceClose();
             return;
         }
+        auto &pressure = MemoryPressure::instance();
+        if (pressure.underPressure())
+        {
+            LOG_DEBUG << "The memory is under pressure, connection closed";
+            conn->forceClose();
+            return;
+        }
+        if (pressure.enabled())
+            parser->watchOutput(conn, HttpRequestParser::kAccountedOutputMark);
         if (!AopAdvice::instance().passNewConnectionAdvices(conn))
         {
             conn->forceClose();
@@ -138,10 +188,23 @@ void HttpServer::onConnection(const TcpConnectionPtr &conn)
             // `releaseConnection()` for conn with context.
             // Never call `conn->clearContext()` in other places
             HttpConnectionLimit::instance().releaseConnection(conn);
+            ConnectionBalancer::instance().connectionClosed(conn->getLoop());
+            unwatchIdleConnection(requestParser.get());
+            auto &pressure = MemoryPressure::instance();
+            pressure.release(requestParser->accountedInput());
+            pressure.release(requestParser->accountedOutput());
+            requestParser->accountedInput() = 0;
+            requestParser->accountedOutput() = 0;
+            // The handlers of the requests still running can stop early.
+            requestParser->cancelPendingRequests();
             if (requestParser->webSocketConn())
             {
                 requestParser->webSocketConn()->onClose();
             }
+            else if (requestParser->http2Conn())
+            {
+                requestParser->http2Conn()->onClose();
+            }
             else if (requestParser->requestImpl()->streamStatus() ==
                      ReqStreamStatus::Open)
             {
@@ -162,12 +225,53 @@ void HttpServer::onMessage(const TcpConnectionPtr &conn, MsgBuffer *buf)
     auto requestParser = conn->getContext<HttpRequestParser>();
     if (!requestParser)
         return;
+    requestParser->setLastActive(trantor::Date::now());
+    if (MemoryPressure::instance().enabled() &&
+        buf != requestParser->heldInput())
+    {
+        auto *heldInput = requestParser->heldInput();
+        if (MemoryPressure::instance().underPressure() ||
+            (heldInput && heldInput->readableBytes() > 0))
+        {
+            // The input already held goes first.
+            holdInput(conn, buf, requestParser);
+            return;
+        }
+    }
     if (requestParser->webSocketConn())
     {
         // Websocket payload
         requestParser->webSocketConn()->onNewMessage(conn, buf);
         return;
     }
+    if (requestParser->http2Conn())
+    {
+        requestParser->http2Conn()->onMessage(buf);
+        return;
+    }
+    if (HttpAppFrameworkImpl::instance().isHttp2Enabled() &&
+        requestParser->isExpectingFirstRequest())
+    {
+        // HTTP/2 with prior knowledge (rfc7540-3.4), or negotiated by ALPN
+        // (rfc7540-3.3). Both start with the client connection preface.
+        auto len = (std::min)(buf->readableBytes(),
+                              http2::kConnectionPreface.length());
+        if (memcmp(buf->peek(), http2::kConnectionPreface.data(), len) == 0)
+        {
+            if (len < http2::kConnectionPreface.length())
+            {
+                // Wait for the rest of the preface
+                return;
+            }
+            LOG_TRACE << "Switch to HTTP/2";
+            auto http2Conn =
+                std::make_shared<Http2ServerConnection>(conn, onHttp2Request);
+            requestParser->setHttp2Connection(http2Conn);
+            http2Conn->start();
+            http2Conn->onMessage(buf);
+            return;
+        }
+    }
 
     auto &requests = requestParser->getRequestBuffer();
     // With the pipelining feature or web socket, it is possible to receive
@@ -187,6 +291,11 @@ void HttpServer::onMessage(const TcpConnectionPtr &conn, MsgBuffer *buf)
         int parseRes = requestParser->parseRequest(buf);
         if (parseRes < 0)
         {
+            if (auto &parseErrors = BuiltinMetrics::instance().parseErrors)
+            {
+                parseErrors->increment();
+            }
+            flushSendBuffer(conn, *requestParser);
             if (req->isStreamMode() && req->isProcessingStarted())
             {
                 // After entering stream mode, if request matches a non-stream
@@ -248,29 +357,95 @@ void HttpServer::onMessage(const TcpConnectionPtr &conn, MsgBuffer *buf)
     }
 }
 
-struct CallbackParamPack
+};
+
+// The connections of the IO loop of the thread waiting for the memory pressure
+// to go down.
+struct HeldConnections
 {
-    CallbackParamPack(trantor::TcpConnectionPtr conn,
-                      HttpRequestImplPtr req,
-                      std::shared_ptr<bool> loopFlag,
-                      std::shared_ptr<HttpRequestParser> requestParser,
-                      bool isHeadMethod)
-        : conn_(std::move(conn)),
-          req_(std::move(req)),
-          loopFlag_(std::move(loopFlag)),
-          requestParser_(std::move(requestParser)),
-          isHeadMethod_(isHeadMethod)
-    {
-    }
-
-    trantor::TcpConnectionPtr conn_;
-    HttpRequestImplPtr req_;
-    std::shared_ptr<bool> loopFlag_;
-    std::shared_ptr<HttpRequestParser> requestParser_;
-    bool isHeadMethod_;
-    std::atomic<bool> responseSent_{false};
+    std::vector<std::weak_ptr<TcpConnection>> connections;
+    bool retrying{false};
 };
 
+static thread_local HeldConnections heldConnections;
+
+void HttpServer::holdInput(
+    const TcpConnectionPtr &conn,
+    MsgBuffer *buf,
+    const std::shared_ptr<HttpRequestParser> &requestParser)
+{
+    // The bytes are still read from the socket, trantor can't stop reading
+    // it, but they aren't parsed and no handler is called for them.
+    auto &input = requestParser->holdInput();
+    auto &pressure = MemoryPressure::instance();
+    pressure.add(buf->readableBytes());
+    requestParser->accountedInput() += buf->readableBytes();
+    input.append(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+    if (!pressure.underPressure())
+    {
+        resumeInput(conn, requestParser);
+        return;
+    }
+    if (requestParser->inputPaused())
+        return;
+    requestParser->setInputPaused(true);
+    heldConnections.connections.emplace_back(conn);
+    if (heldConnections.retrying)
+        return;
+    heldConnections.retrying = true;
+    auto loop = conn->getLoop();
+    loop->runAfter(0.01, [loop]() { resumeHeldConnections(loop); });
+}
+
+void HttpServer::resumeInput(
+    const TcpConnectionPtr &conn,
+    const std::shared_ptr<HttpRequestParser> &requestParser)
+{
+    requestParser->setInputPaused(false);
+    MemoryPressure::instance().release(requestParser->accountedInput());
+    requestParser->accountedInput() = 0;
+    auto *input = requestParser->heldInput();
+    if (!input)
+        return;
+    if (input->readableBytes() > 0)
+        onMessage(conn, input);
+    if (input->readableBytes() == 0)
+        requestParser->releaseHeldInput();
+}
+
+void HttpServer::resumeHeldConnections(EventLoop *loop)
+{
+    if (MemoryPressure::instance().underPressure())
+    {
+        loop->runAfter(0.01, [loop]() { resumeHeldConnections(loop); });
+        return;
+    }
+    heldConnections.retrying = false;
+    auto connections = std::move(heldConnections.connections);
+    heldConnections.connections.clear();
+    for (auto &weakConn : connections)
+    {
+        auto conn = weakConn.lock();
+        if (!conn || !conn->connected())
+            continue;
+        if (MemoryPressure::instance().underPressure())
+        {
+            // Raised again by the input of the connections resumed before.
+            heldConnections.connections.push_back(std::move(weakConn));
+            continue;
+        }
+        auto requestParser = conn->getContext<HttpRequestParser>();
+        if (requestParser)
+            resumeInput(conn, requestParser);
+    }
+    if (!heldConnections.connections.empty() && !heldConnections.retrying)
+    {
+        heldConnections.retrying = true;
+        loop->runAfter(0.01, [loop]() { resumeHeldConnections(loop); });
+    }
+}
+
 void HttpServer::onRequests(
     const TcpConnectionPtr &conn,
     const std::vector<HttpRequestImplPtr> &requests,
@@ -302,6 +477,12 @@ void HttpServer::onRequests(
                         AopAdvice::instance().passPreSendingAdvices(req, resp);
                         if (resp->statusCode() == k101SwitchingProtocols)
                         {
+                            WebSocketDeflateParams params;
+                            if (params.parse(resp->getHeaderBy(
+                                    "sec-websocket-extensions")))
+                            {
+                                wsConn->enableDeflate(params);
+                            }
                             requestParser->setWebsockConnection(wsConn);
                         }
                         auto httpString =
@@ -330,6 +511,7 @@ void HttpServer::onRequests(
             HttpAppFrameworkImpl::instance().keepaliveRequestsNumber())
     {
         requestParser->stop();
+        flushSendBuffer(conn, *requestParser);
         conn->shutdown();
         return;
     }
@@ -338,6 +520,7 @@ void HttpServer::onRequests(
             HttpAppFrameworkImpl::instance().pipeliningRequestsNumber())
     {
         requestParser->stop();
+        flushSendBuffer(conn, *requestParser);
         conn->shutdown();
         return;
     }
@@ -345,11 +528,16 @@ void HttpServer::onRequests(
     {
         return;
     }
-    auto loopFlagPtr = std::make_shared<bool>(true);
-
+    requestParser->setDispatching(true);
     for (auto &req : requests)
     {
         req->startProcessing();
+        DROGON_PROBE3(request__parsed,
+                      req.get(),
+                      req->methodString(),
+                      req->path().c_str());
+        sampleRequest(req);
+        setDeadline(req);
         bool isHeadMethod = (req->method() == Head);
         if (isHeadMethod)
         {
@@ -360,22 +548,27 @@ void HttpServer::onRequests(
         {
             requestParser->pushRequestToPipelining(req, isHeadMethod);
             reqPipelined = true;
+            if (auto &depth = BuiltinMetrics::instance().pipelineDepth)
+            {
+                depth->observe(
+                    (double)requestParser->numberOfRequestsInPipelining());
+            }
         }
         if (!passSyncAdvices(req, requestParser, reqPipelined, isHeadMethod))
         {
             continue;
         }
 
-        // Optimization: Avoids dynamic allocation when copying the callback in
-        // handlers (ex: copying callback into lambda captures in DB calls)
+        // The state of the dispatch is kept in the pooled request, the
+        // callback only holds the request and is cheap to copy in handlers
+        // (ex: copying callback into lambda captures in DB calls)
         bool respReady{false};
-        auto paramPack = std::make_shared<CallbackParamPack>(
-            conn, req, loopFlagPtr, requestParser, isHeadMethod);
+        req->startDispatch(isHeadMethod);
 
         auto errResp = tryDecompressRequest(req);
         if (errResp)
         {
-            handleResponse(errResp, paramPack, &respReady);
+            handleResponse(errResp, req, &respReady);
         }
         else
         {
@@ -389,9 +582,8 @@ void HttpServer::onRequests(
             // `respReady` variable.
             onHttpRequest(req,
                           [respReadyPtr = &respReady,
-                           paramPack = std::move(paramPack)](
-                              const HttpResponsePtr &response) {
-                              handleResponse(response, paramPack, respReadyPtr);
+                           req](const HttpResponsePtr &response) {
+                              handleResponse(response, req, respReadyPtr);
                           });
         }
         if (!reqPipelined && !respReady)
@@ -399,7 +591,7 @@ void HttpServer::onRequests(
             requestParser->pushRequestToPipelining(req, isHeadMethod);
         }
     }
-    *loopFlagPtr = false;
+    requestParser->setDispatching(false);
     if (conn->connected() && !requestParser->getResponseBuffer().empty())
     {
         sendResponses(conn,
@@ -409,6 +601,84 @@ void HttpServer::onRequests(
     }
 }
 
+void HttpServer::onHttp2Request(const Http2ServerConnectionPtr &http2Conn,
+                                uint32_t streamId,
+                                const HttpRequestImplPtr &req)
+{
+    req->startProcessing();
+    DROGON_PROBE3(request__parsed,
+                  req.get(),
+                  req->methodString(),
+                  req->path().c_str());
+    sampleRequest(req);
+    setDeadline(req);
+    bool isHeadMethod = (req->method() == Head);
+    if (isHeadMethod)
+    {
+        req->setMethod(Get);
+    }
+    // Streams are independent of each other, responses are sent as soon as
+    // they are ready, no pipelining queue is needed.
+    auto sendResp = [weakConn = std::weak_ptr<Http2ServerConnection>(
+                         http2Conn),
+                     streamId,
+                     isHeadMethod](const HttpResponsePtr &resp) {
+        auto connPtr = weakConn.lock();
+        if (!connPtr)
+            return;
+        auto loop = connPtr->getLoop();
+        if (loop->isInLoopThread())
+        {
+            connPtr->sendResponse(streamId, resp, isHeadMethod);
+            return;
+        }
+        loop->queueInLoop([connPtr = std::move(connPtr),
+                           streamId,
+                           resp,
+                           isHeadMethod]() {
+            connPtr->sendResponse(streamId, resp, isHeadMethod);
+        });
+    };
+    if (auto resp = AopAdvice::instance().passSyncAdvices(req))
+    {
+        // Rejected by sync advice
+        resp->setVersion(req->getVersion());
+        sendResp(getCompressedResponse(req, resp, isHeadMethod));
+        return;
+    }
+    req->startDispatch(isHeadMethod);
+    auto callback = [req, isHeadMethod, sendResp = std::move(sendResp)](
+                        const HttpResponsePtr &response) {
+        if (!response)
+            return;
+        if (!req->claimResponse())
+        {
+            LOG_ERROR << "Sending more than 1 response for request. "
+                         "Ignoring later response";
+            return;
+        }
+        markTrace(req, RequestTrace::Stage::Response);
+        probeHandlerEnd(req, response);
+        auto resp =
+            HttpAppFrameworkImpl::instance().handleSessionForResponse(req,
+                                                                      response);
+        resp->setVersion(req->getVersion());
+        AopAdvice::instance().passPreSendingAdvices(req, resp);
+        resp = getConditionalResponse(req, resp);
+        auto newResp = getCompressedResponse(req, resp, isHeadMethod);
+        exportTrace(req, newResp);
+        probeResponseSend(req, newResp);
+        sendResp(newResp);
+    };
+    auto errResp = tryDecompressRequest(req);
+    if (errResp)
+    {
+        callback(errResp);
+        return;
+    }
+    onHttpRequest(req, std::move(callback));
+}
+
 void HttpServer::onHttpRequest(
     const HttpRequestImplPtr &req,
     std::function<void(const HttpResponsePtr &)> &&callback)
@@ -428,7 +698,16 @@ void HttpServer::onHttpRequest(
     }
 
     // TODO: move session related codes to its own singleton class
-    HttpAppFrameworkImpl::instance().findSessionForRequest(req);
+    auto &appImpl = HttpAppFrameworkImpl::instance();
+    if (!appImpl.findSessionForRequest(req))
+    {
+        // Continue when the session is loaded from the session store
+        appImpl.loadSessionForRequest(
+            req, [req, callback = std::move(callback)]() mutable {
+                onHttpRequest(req, std::move(callback));
+            });
+        return;
+    }
     // pre-routing aop
     auto &aop = AopAdvice::instance();
     aop.passPreRoutingObservers(req);
@@ -456,6 +735,7 @@ void HttpServer::httpRequestRouting(
     const HttpRequestImplPtr &req,
     std::function<void(const HttpResponsePtr &)> &&callback)
 {
+    markTrace(req, RequestTrace::Stage::Routing);
     // How to access router here?? Make router class singleton?
     RouteResult result = HttpControllersRouter::instance().route(req);
     if (result.result == RouteResult::Success)
@@ -525,6 +805,11 @@ void HttpServer::requestPostRouting(const HttpRequestImplPtr &req, Pack &&pack)
         }
     }
 
+    DROGON_PROBE3(route__matched,
+                  req.get(),
+                  req->matchedPathPatternData(),
+                  req->matchedPathPatternLength());
+    markTrace(req, RequestTrace::Stage::PostRouting);
     // post-routing aop
     auto &aop = AopAdvice::instance();
     aop.passPostRoutingObservers(req);
@@ -552,6 +837,7 @@ template <typename Pack>
 void HttpServer::requestPassMiddlewares(const HttpRequestImplPtr &req,
                                         Pack &&pack)
 {
+    markTrace(req, RequestTrace::Stage::Middlewares);
     // pass middlewares
     auto &middlewares = pack.binderPtr->middlewares_;
     if (middlewares.empty())
@@ -577,6 +863,7 @@ void HttpServer::requestPassMiddlewares(const HttpRequestImplPtr &req,
 template <typename Pack>
 void HttpServer::requestPreHandling(const HttpRequestImplPtr &req, Pack &&pack)
 {
+    markTrace(req, RequestTrace::Stage::PreHandling);
     // Handle CORS preflight request, except when custom handling is desired
     if (req->method() == Options)
     {
@@ -637,11 +924,109 @@ void HttpServer::requestPreHandling(const HttpRequestImplPtr &req, Pack &&pack)
         });
 }
 
+// The handlers of the LowPriority routes waiting in the IO loop of the thread.
+struct LowPriorityHandlers
+{
+    std::deque<std::function<void()>> handlers;
+    bool scheduled{false};
+    bool running{false};
+};
+
+static thread_local LowPriorityHandlers lowPriorityHandlers;
+static constexpr size_t kLowPriorityHandlersPerRound = 4;
+
+static void runLowPriorityHandlers(EventLoop *loop)
+{
+    auto &queue = lowPriorityHandlers;
+    queue.running = true;
+    for (size_t i = 0;
+         i < kLowPriorityHandlersPerRound && !queue.handlers.empty();
+         ++i)
+    {
+        auto handler = std::move(queue.handlers.front());
+        queue.handlers.pop_front();
+        handler();
+    }
+    queue.running = false;
+    if (queue.handlers.empty())
+    {
+        queue.scheduled = false;
+        return;
+    }
+    // A timer fires in the next round, after its IO events. The functors
+    // queued now would be run before them.
+    loop->runAfter(0, [loop]() { runLowPriorityHandlers(loop); });
+}
+
+static void deferLowPriorityHandler(EventLoop *loop,
+                                    std::function<void()> &&handler)
+{
+    auto &queue = lowPriorityHandlers;
+    queue.handlers.push_back(std::move(handler));
+    if (queue.scheduled)
+        return;
+    queue.scheduled = true;
+    // Run after the requests parsed in this round of the IO events.
+    loop->queueInLoop([loop]() { runLowPriorityHandlers(loop); });
+}
+
+// Call the handler of the binder in the current thread, within the scopes
+// of the request, and warn if its synchronous part blocked the thread for
+// too long.
+static void callHandler(const HttpRequestImplPtr &req,
+                        ControllerBinderBase &binder,
+                        std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    auto slowHandlerThreshold = BuiltinMetrics::instance().slowHandlerThreshold;
+    std::chrono::steady_clock::time_point handlingStart;
+    if (slowHandlerThreshold > 0)
+    {
+        handlingStart = std::chrono::steady_clock::now();
+    }
+    // The database and redis calls made by the synchronous part of the
+    // handler are recorded in the trace of the request and bounded by its
+    // deadline.
+    std::optional<RequestTrace::Scope> traceScope;
+    if (req->trace())
+    {
+        traceScope.emplace(req->trace());
+    }
+    {
+        RequestDeadline::Scope deadlineScope(req->deadline(), req);
+        // The samples of the cpu profiles taken meanwhile carry the route
+        internal::CpuProfiler::RouteScope routeScope(
+            req->matchedPathPattern());
+        RouteCostScope costScope(req->matchedPathPattern());
+        binder.handleRequest(req, std::move(callback));
+    }
+    traceScope.reset();
+    if (slowHandlerThreshold > 0)
+    {
+        // Only the synchronous part of the handler blocks the thread.
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - handlingStart;
+        if (elapsed.count() > slowHandlerThreshold)
+        {
+            LOG_WARN << "The handler of " << req->methodString() << " "
+                     << req->matchedPathPattern() << " (" << req->path()
+                     << ") blocked "
+                     << (binder.offloaded_ ? "a handler thread"
+                                           : "the IO loop")
+                     << " for " << elapsed.count() * 1000 << "ms";
+        }
+    }
+}
+
 void HttpServer::httpRequestHandling(
     const HttpRequestImplPtr &req,
     std::shared_ptr<ControllerBinderBase> &&binderPtr,
     std::function<void(const HttpResponsePtr &)> &&callback)
 {
+    markTrace(req, RequestTrace::Stage::Handling);
+    DROGON_PROBE3(handler__start,
+                  req.get(),
+                  req->matchedPathPatternData(),
+                  req->matchedPathPatternLength());
     // Check cached response
     auto &cachedResp = *(binderPtr->responseCache_);
     if (cachedResp)
@@ -665,33 +1050,94 @@ void HttpServer::httpRequestHandling(
         }
     }
 
-    auto &binderRef = *binderPtr;
-    binderRef.handleRequest(
-        req,
-        // This is the actual callback being passed to controller
-        [req, binderPtr = std::move(binderPtr), callback = std::move(callback)](
-            const HttpResponsePtr &resp) mutable {
-            // Check if we need to cache the response
-            if (resp->expiredTime() >= 0 && resp->statusCode() != k404NotFound)
+    if (req->isCancelled())
+    {
+        // The connection is closed, the response is dropped anyway.
+        callback(HttpResponse::newHttpResponse(k503ServiceUnavailable,
+                                               CT_TEXT_PLAIN));
+        return;
+    }
+    if (req->deadline().microSecondsSinceEpoch() > 0 &&
+        req->deadline() < trantor::Date::now())
+    {
+        // The client doesn't wait for the response anymore.
+        auto resp = app().getCustomErrorHandler()(k504GatewayTimeout, req);
+        AopAdvice::instance().passPostHandlingAdvices(req, resp);
+        callback(resp);
+        return;
+    }
+
+    if (binderPtr->lowPriority_ && !lowPriorityHandlers.running)
+    {
+        auto loop = req->getLoop();
+        if (loop && loop->isInLoopThread())
+        {
+            // The cancellation and the deadline are checked again then.
+            deferLowPriorityHandler(
+                loop,
+                [req,
+                 binderPtr = std::move(binderPtr),
+                 callback = std::move(callback)]() mutable {
+                    httpRequestHandling(req,
+                                        std::move(binderPtr),
+                                        std::move(callback));
+                });
+            return;
+        }
+    }
+
+    // This is the actual callback being passed to controller
+    auto handlerCallback = [req, binderPtr, callback = std::move(callback)](
+                               const HttpResponsePtr &resp) mutable {
+        RouteCostScope costScope(req->matchedPathPattern());
+        // Check if we need to cache the response
+        if (resp->expiredTime() >= 0 && !resp->isImmutable() &&
+            resp->statusCode() != k404NotFound)
+        {
+            static_cast<HttpResponseImpl *>(resp.get())->makeHeaderString();
+            auto loop = req->getLoop();
+            if (loop->isInLoopThread())
             {
-                static_cast<HttpResponseImpl *>(resp.get())->makeHeaderString();
-                auto loop = req->getLoop();
-                if (loop->isInLoopThread())
-                {
+                binderPtr->responseCache_.setThreadData(resp);
+            }
+            else
+            {
+                loop->queueInLoop([binderPtr = std::move(binderPtr), resp]() {
                     binderPtr->responseCache_.setThreadData(resp);
-                }
-                else
-                {
-                    loop->queueInLoop(
-                        [binderPtr = std::move(binderPtr), resp]() {
-                            binderPtr->responseCache_.setThreadData(resp);
-                        });
-                }
+                });
             }
-            // post-handling aop
-            AopAdvice::instance().passPostHandlingAdvices(req, resp);
-            callback(resp);
-        });
+        }
+        // post-handling aop
+        AopAdvice::instance().passPostHandlingAdvices(req, resp);
+        callback(resp);
+    };
+    if (binderPtr->offloaded_)
+    {
+        // The handler runs in a thread of the pool, the response is handled
+        // in the IO loop of the request. The task owns the binder.
+        HttpAppFrameworkImpl::instance().handlerThreadPool().runTask(
+            [req,
+             binderPtr = std::move(binderPtr),
+             handlerCallback = std::move(handlerCallback)]() mutable {
+                callHandler(
+                    req,
+                    *binderPtr,
+                    [loop = req->getLoop(),
+                     handlerCallback = std::move(handlerCallback)](
+                        const HttpResponsePtr &resp) mutable {
+                        if (loop->isInLoopThread())
+                        {
+                            handlerCallback(resp);
+                            return;
+                        }
+                        loop->queueInLoop(
+                            [handlerCallback = std::move(handlerCallback),
+                             resp]() mutable { handlerCallback(resp); });
+                    });
+            });
+        return;
+    }
+    callHandler(req, *binderPtr, std::move(handlerCallback));
 }
 
 void HttpServer::onWebsocketRequest(
@@ -699,7 +1145,17 @@ void HttpServer::onWebsocketRequest(
     std::function<void(const HttpResponsePtr &)> &&callback,
     WebSocketConnectionImplPtr &&wsConnPtr)
 {
-    HttpAppFrameworkImpl::instance().findSessionForRequest(req);
+    auto &appImpl = HttpAppFrameworkImpl::instance();
+    if (!appImpl.findSessionForRequest(req))
+    {
+        auto onLoaded = [req,
+                         callback = std::move(callback),
+                         wsConnPtr = std::move(wsConnPtr)]() mutable {
+            onWebsocketRequest(req, std::move(callback), std::move(wsConnPtr));
+        };
+        appImpl.loadSessionForRequest(req, std::move(onLoaded));
+        return;
+    }
     // pre-routing aop
     auto &aop = AopAdvice::instance();
     aop.passPreRoutingObservers(req);
@@ -770,39 +1226,43 @@ void HttpServer::websocketRequestHandling(
         ->handleNewConnection(req, wsConnPtr);
 }
 
-void HttpServer::handleResponse(
-    const HttpResponsePtr &response,
-    const std::shared_ptr<CallbackParamPack> &paramPack,
-    bool *respReadyPtr)
+void HttpServer::handleResponse(const HttpResponsePtr &response,
+                                const HttpRequestImplPtr &req,
+                                bool *respReadyPtr)
 {
-    auto &conn = paramPack->conn_;
-    auto &req = paramPack->req_;
-    auto &requestParser = paramPack->requestParser_;
-    auto &loopFlagPtr = paramPack->loopFlag_;
-    const bool isHeadMethod = paramPack->isHeadMethod_;
-
     if (!response)
         return;
-    if (!conn->connected())
+    auto conn = req->getConnectionPtr().lock();
+    if (!conn || !conn->connected())
         return;
+    const bool isHeadMethod = req->dispatchedAsHead();
 
-    if (paramPack->responseSent_.exchange(true, std::memory_order_acq_rel))
+    if (!req->claimResponse())
     {
         LOG_ERROR << "Sending more than 1 response for request. "
                      "Ignoring later response";
         return;
     }
+    markTrace(req, RequestTrace::Stage::Response);
+    probeHandlerEnd(req, response);
 
     auto resp =
         HttpAppFrameworkImpl::instance().handleSessionForResponse(req,
                                                                   response);
     resp->setVersion(req->getVersion());
-    resp->setCloseConnection(!req->keepAlive());
+    resp->setCloseConnection(!req->keepAlive() ||
+                             HttpAppFrameworkImpl::instance().isDraining());
     AopAdvice::instance().passPreSendingAdvices(req, resp);
+    resp = getConditionalResponse(req, resp);
 
     auto newResp = getCompressedResponse(req, resp, isHeadMethod);
+    exportTrace(req, newResp);
+    probeResponseSend(req, newResp);
     if (conn->getLoop()->isInLoopThread())
     {
+        auto requestParser = conn->getContext<HttpRequestParser>();
+        if (!requestParser)
+            return;
         /*
          * A client that supports persistent connections MAY
          * "pipeline" its requests (i.e., send multiple requests
@@ -813,7 +1273,7 @@ void HttpServer::handleResponse(
         if (requestParser->emptyPipelining())
         {
             // response must have arrived synchronously
-            assert(*loopFlagPtr);
+            assert(requestParser->dispatching());
             // TODO: change to weakPtr to be sure. But may drop performance.
             *respReadyPtr = true;
             requestParser->getResponseBuffer().emplace_back(std::move(newResp),
@@ -824,7 +1284,7 @@ void HttpServer::handleResponse(
         {
             auto &responseBuffer = requestParser->getResponseBuffer();
             requestParser->popReadyResponses(responseBuffer);
-            if (!*loopFlagPtr)
+            if (!requestParser->dispatching())
             {
                 // We have passed the point where `onRequests()` sends
                 // responses. So, at here we should send ready responses from
@@ -837,11 +1297,14 @@ void HttpServer::handleResponse(
     else
     {
         conn->getLoop()->queueInLoop(
-            [conn, req, requestParser, newResp = std::move(newResp)]() mutable {
+            [conn, req, newResp = std::move(newResp)]() mutable {
                 if (!conn->connected())
                 {
                     return;
                 }
+                auto requestParser = conn->getContext<HttpRequestParser>();
+                if (!requestParser)
+                    return;
                 if (requestParser->pushResponseToPipelining(req,
                                                             std::move(newResp)))
                 {
@@ -853,121 +1316,76 @@ void HttpServer::handleResponse(
     }
 }
 
-struct ChunkingParams
+void HttpServer::sendEarlyHintsInLoop(const TcpConnectionPtr &conn,
+                                      const HttpRequestImpl *req,
+                                      uint32_t http2StreamId,
+                                      const std::vector<std::string> &links,
+                                      bool requestAlive)
 {
-    using DataCallback = std::function<std::size_t(char *, std::size_t)>;
-
-    explicit ChunkingParams(DataCallback cb) : dataCallback(std::move(cb))
+    if (!conn->connected())
+        return;
+    auto requestParser = conn->getContext<HttpRequestParser>();
+    if (!requestParser)
+        return;
+    if (auto &http2Conn = requestParser->http2Conn())
     {
+        if (http2StreamId != 0)
+            http2Conn->sendEarlyHints(http2StreamId, links);
+        return;
     }
-
-    DataCallback dataCallback;
-    bool bFinished{false};
-#ifndef NDEBUG  // defined by CMake for release build
-    std::size_t nDataReturned{0};
-#endif
-};
-
-static std::size_t chunkingCallback(
-    const std::shared_ptr<ChunkingParams> &cbParams,
-    char *pBuffer,
-    std::size_t nSize)
-{
-    if (!cbParams)
-        return 0;
-    // Cleanup
-    if (pBuffer == nullptr)
+    if (requestParser->isFirstInPipelining(req))
     {
-        LOG_TRACE << "Chunking callback cleanup";
-        if (cbParams && cbParams->dataCallback)
-        {
-            cbParams->dataCallback(pBuffer, nSize);
-            cbParams->dataCallback = {};
-        }
-        return 0;
+        // Its response isn't ready, the responses before it have been sent.
     }
-    // Terminal chunk already returned
-    if (cbParams->bFinished)
+    else if (requestAlive && requestParser->dispatching() &&
+             requestParser->emptyPipelining() && !req->responseClaimed())
     {
-        LOG_TRACE << "Chunking callback has no more data";
-#ifndef NDEBUG  // defined by CMake for release build
-        LOG_TRACE << "Chunking callback: total data returned: "
-                  << cbParams->nDataReturned << " bytes";
-#endif
-        return 0;
+        // The request is being dispatched synchronously, the ready
+        // responses of the requests before it go first.
+        auto &responseBuffer = requestParser->getResponseBuffer();
+        sendResponses(conn, responseBuffer, requestParser->getBuffer());
+        responseBuffer.clear();
+        if (!conn->connected())
+            return;
     }
-
-    // Reserve size to prepend the chunk size & append cr/lf, and get data
-    struct
+    else
     {
-        std::size_t operator()(std::size_t n)
-        {
-            return n == 0 ? 0 : 1 + (*this)(n >> 4);
-        }
-    } neededDigits;
+        // Behind other requests, an interim response can't be sent
+        // before their responses.
+        return;
+    }
+    std::string hints = "HTTP/1.1 103 Early Hints\r\n";
+    for (auto &link : links)
+    {
+        hints.append("link: ").append(link).append("\r\n");
+    }
+    hints.append("\r\n");
+    auto &buffer = requestParser->getBuffer();
+    if (buffer.readableBytes() > 0)
+    {
+        // After the responses corked in the buffer, whose flush is queued
+        buffer.append(hints);
+        return;
+    }
+    conn->send(std::move(hints));
+}
 
-    auto nHeaderSize = neededDigits(nSize) + 2;
-    auto nDataSize =
-        cbParams->dataCallback(pBuffer + nHeaderSize, nSize - nHeaderSize - 2);
-    if (nDataSize == 0)
+void HttpServer::sendEarlyHints(const TcpConnectionPtr &conn,
+                                const HttpRequestImpl *req,
+                                const std::vector<std::string> &links)
+{
+    auto loop = conn->getLoop();
+    if (loop->isInLoopThread())
     {
-        // Terminal chunk + cr/lf
-        cbParams->bFinished = true;
-#ifdef _WIN32
-        memcpy_s(pBuffer, nSize, "0\r\n\r\n", 5);
-#else
-        memcpy(pBuffer, "0\r\n\r\n", 5);
-#endif
-        LOG_TRACE << "Chunking callback: no more data, return last chunk of "
-                     "size 0 & end of message";
-        return 5;
-    }
-    // Non-terminal chunks
-    pBuffer[nHeaderSize + nDataSize] = '\r';
-    pBuffer[nHeaderSize + nDataSize + 1] = '\n';
-    // The spec does not say if the chunk size is allowed tohave leading zeroes
-    // Use a fixed size header with leading zeroes
-    // (tested to work with Chrome, Firefox, Safari, Edge, wget, curl and VLC)
-#ifdef _WIN32
-    char pszFormat[]{"%04llx\r"};
-#else
-    char pszFormat[]{"%04lx\r"};
-#endif
-    pszFormat[2] = '0' + char(nHeaderSize - 2);
-    snprintf(pBuffer, nHeaderSize, pszFormat, nDataSize);
-    pBuffer[nHeaderSize - 1] = '\n';
-    LOG_TRACE << "Chunking callback: return chunk of size " << nDataSize;
-#ifndef NDEBUG  // defined by CMake for release build
-    cbParams->nDataReturned += nDataSize;
-#endif
-    return nHeaderSize + nDataSize + 2;
-    // Alternative code if there are client software that do not support chunk
-    // size with leading zeroes
-    //    auto nHeaderLen =
-    // #ifdef _WIN32
-    //    sprintf_s(pBuffer,
-    //    nHeaderSize, "%llx\r",
-    //    nDataSize);
-    // #else
-    //    sprintf(pBuffer, "%lx\r",
-    //    nDataSize);
-    // #endif
-    //    pBuffer[nHeaderLen++] = '\n';
-    //    if (nHeaderLen < nHeaderSize)  // smaller that what was reserved ->
-    //    move data
-    // #ifdef _WIN32
-    //    memmove_s(pBuffer +
-    //    nHeaderLen,
-    //              nSize - nHeaderLen,
-    //              pBuffer +
-    //              nHeaderSize,
-    //              nDataSize + 2);
-    // #else
-    //    memmove(pBuffer + nHeaderLen,
-    //            pBuffer + nHeaderSize,
-    //            nDataSize + 2);
-    // #endif
-    //    return nHeaderLen + nDataSize + 2;
+        sendEarlyHintsInLoop(conn, req, req->http2StreamId(), links, true);
+        return;
+    }
+    // The request may be gone when this is run, it's only compared with
+    // the requests in the pipelining then.
+    loop->queueInLoop(
+        [conn, req, http2StreamId = req->http2StreamId(), links]() {
+            sendEarlyHintsInLoop(conn, req, http2StreamId, links, false);
+        });
 }
 
 void HttpServer::sendResponse(const TcpConnectionPtr &conn,
@@ -978,8 +1396,20 @@ void HttpServer::sendResponse(const TcpConnectionPtr &conn,
     auto respImplPtr = static_cast<HttpResponseImpl *>(response.get());
     if (!isHeadMethod)
     {
-        auto httpString = respImplPtr->renderToBuffer();
-        conn->send(httpString);
+        auto body = respImplPtr->bodyToSendSeparately();
+        if (body.empty())
+        {
+            auto httpString = respImplPtr->renderToBuffer();
+            conn->send(httpString);
+        }
+        else
+        {
+            // Send the shared body from where it is instead of copying it
+            // after the header, it's only copied if the socket can't take it
+            // all.
+            conn->send(respImplPtr->renderHeaderForHeadMethod());
+            conn->send(body.data(), body.size());
+        }
         if (!respImplPtr->contentLengthIsAllowed())
             return;
         auto &asyncStreamCallback = respImplPtr->asyncStreamCallback();
@@ -987,9 +1417,10 @@ void HttpServer::sendResponse(const TcpConnectionPtr &conn,
         {
             if (respImplPtr->version() != Version::kHttp10)
             {
-                asyncStreamCallback(
-                    std::make_unique<ResponseStream>(conn->sendAsyncStream(
-                        respImplPtr->asyncStreamKickoffDisabled())));
+                asyncStreamCallback(std::make_unique<ResponseStream>(
+                    conn->sendAsyncStream(
+                        respImplPtr->asyncStreamKickoffDisabled()),
+                    conn));
             }
             else
             {
@@ -1011,19 +1442,14 @@ void HttpServer::sendResponse(const TcpConnectionPtr &conn,
                     (headers.at("transfer-encoding") == "chunked");
                 if (bChunked)
                 {
-                    conn->sendStream(
-                        [ctx = std::make_shared<ChunkingParams>(
-                             streamCallback)](char *buffer, size_t len) {
-                            return chunkingCallback(ctx, buffer, len);
-                        });
+                    conn->sendStream(chunkedStreamCallback(streamCallback));
                 }
                 else
                     conn->sendStream(streamCallback);
             }
             else
             {
-                const auto &range = respImplPtr->sendfileRange();
-                conn->sendFile(sendfileName.c_str(), range.first, range.second);
+                sendFileBody(conn, *respImplPtr);
             }
         }
         COZ_PROGRESS
@@ -1050,7 +1476,10 @@ void HttpServer::sendResponses(
     conn->getLoop()->assertInLoopThread();
     if (responses.empty())
         return;
-    if (responses.size() == 1)
+    // When corking, the responses are rendered in the buffer and it is sent
+    // once at the end of the loop iteration.
+    bool corking = HttpAppFrameworkImpl::instance().isOutputCorkingEnabled();
+    if (responses.size() == 1 && !corking)
     {
         sendResponse(conn, responses[0].first, responses[0].second);
         return;
@@ -1061,7 +1490,18 @@ void HttpServer::sendResponses(
         if (!resp.second)
         {
             // Not HEAD method
-            respImplPtr->renderToBuffer(buffer);
+            auto body = respImplPtr->bodyToSendSeparately();
+            if (body.empty())
+            {
+                respImplPtr->renderToBuffer(buffer);
+            }
+            else
+            {
+                respImplPtr->renderHeaderToBuffer(buffer);
+                conn->send(buffer);
+                buffer.retrieveAll();
+                conn->send(body.data(), body.size());
+            }
             if (!respImplPtr->contentLengthIsAllowed())
                 continue;
             auto &asyncStreamCallback = respImplPtr->asyncStreamCallback();
@@ -1071,9 +1511,10 @@ void HttpServer::sendResponses(
                 buffer.retrieveAll();
                 if (respImplPtr->version() != Version::kHttp10)
                 {
-                    asyncStreamCallback(
-                        std::make_unique<ResponseStream>(conn->sendAsyncStream(
-                            respImplPtr->asyncStreamKickoffDisabled())));
+                    asyncStreamCallback(std::make_unique<ResponseStream>(
+                        conn->sendAsyncStream(
+                            respImplPtr->asyncStreamKickoffDisabled()),
+                        conn));
                 }
                 else
                 {
@@ -1098,20 +1539,14 @@ void HttpServer::sendResponses(
                     if (bChunked)
                     {
                         conn->sendStream(
-                            [ctx = std::make_shared<ChunkingParams>(
-                                 streamCallback)](char *buffer, size_t len) {
-                                return chunkingCallback(ctx, buffer, len);
-                            });
+                            chunkedStreamCallback(streamCallback));
                     }
                     else
                         conn->sendStream(streamCallback);
                 }
                 else
                 {
-                    const auto &range = respImplPtr->sendfileRange();
-                    conn->sendFile(sendfileName.c_str(),
-                                   range.first,
-                                   range.second);
+                    sendFileBody(conn, *respImplPtr);
                 }
                 COZ_PROGRESS
             }
@@ -1135,28 +1570,167 @@ void HttpServer::sendResponses(
     }
     if (conn->connected() && buffer.readableBytes() > 0)
     {
+        if (corking)
+        {
+            auto requestParser = conn->getContext<HttpRequestParser>();
+            if (!requestParser->flushQueued())
+            {
+                requestParser->setFlushQueued(true);
+                conn->getLoop()->queueInLoop([conn, requestParser]() {
+                    requestParser->setFlushQueued(false);
+                    flushSendBuffer(conn, *requestParser);
+                });
+            }
+            return;
+        }
         conn->send(buffer);
         COZ_PROGRESS
     }
     buffer.retrieveAll();
 }
 
+// Send the body of a sendfile response, the parts of a multipart/byteranges
+// body are sent one after the other, each from its range of the file.
+static void sendFileBody(const TcpConnectionPtr &conn,
+                         const HttpResponseImpl &resp)
+{
+    auto &sendfileName = resp.sendfileName();
+    auto &parts = resp.sendfileParts();
+    if (parts.empty())
+    {
+        const auto &range = resp.sendfileRange();
+        conn->sendFile(sendfileName.c_str(), range.first, range.second);
+        return;
+    }
+    for (auto &part : parts)
+    {
+        conn->send(part.header);
+        if (part.length > 0)
+            conn->sendFile(sendfileName.c_str(), part.offset, part.length);
+    }
+}
+
+// Send the responses buffered for the connection by the output corking
+static void flushSendBuffer(const TcpConnectionPtr &conn,
+                            HttpRequestParser &requestParser)
+{
+    auto &buffer = requestParser.getBuffer();
+    if (conn->connected() && buffer.readableBytes() > 0)
+    {
+        conn->send(buffer);
+        COZ_PROGRESS
+    }
+    buffer.retrieveAll();
+}
+
+// The connections of the IO loop of the thread, swept periodically to release
+// the memory of the idle ones and to export their memory usage if it is
+// enabled.
+struct IdleConnections
+{
+    std::unordered_set<HttpRequestParser *> parsers;
+    bool sweeping{false};
+    std::string loopIndex;
+};
+
+static thread_local IdleConnections idleConnections;
+
+static void sweepIdleConnections()
+{
+    auto trimTimeout =
+        HttpAppFrameworkImpl::instance().getIdleMemoryTrimTimeout();
+    const auto &metrics = BuiltinMetrics::instance();
+    auto idleSince = trantor::Date::now().after(-(double)trimTimeout);
+    size_t memory{0};
+    for (auto *requestParser : idleConnections.parsers)
+    {
+        if (trimTimeout > 0 && requestParser->lastActive() < idleSince &&
+            requestParser->trimMemory())
+        {
+            if (metrics.trimmedConnections)
+                metrics.trimmedConnections->increment();
+        }
+        if (metrics.connectionMemory)
+            memory += requestParser->memoryUsage();
+    }
+    if (metrics.connectionMemory)
+    {
+        metrics.connectionMemory->metric({idleConnections.loopIndex})
+            ->set((double)memory);
+        metrics.connections->metric({idleConnections.loopIndex})
+            ->set((double)idleConnections.parsers.size());
+    }
+}
+
+static void watchIdleConnection(EventLoop *loop,
+                                HttpRequestParser *requestParser)
+{
+    // Also counted by HttpServer::loopStats()
+    idleConnections.parsers.insert(requestParser);
+    auto trimTimeout =
+        HttpAppFrameworkImpl::instance().getIdleMemoryTrimTimeout();
+    if (trimTimeout == 0 && !BuiltinMetrics::instance().connectionMemory)
+        return;
+    if (idleConnections.sweeping)
+        return;
+    idleConnections.sweeping = true;
+    auto &app = HttpAppFrameworkImpl::instance();
+    for (size_t i = 0; i < app.getThreadNum(); ++i)
+    {
+        if (app.getIOLoop(i) == loop)
+        {
+            idleConnections.loopIndex = std::to_string(i);
+            break;
+        }
+    }
+    // An idle connection is trimmed between 1 and 1.5 times the timeout
+    // after its last read, the metrics are updated every 5 seconds without
+    // trimming.
+    double interval =
+        trimTimeout > 0 ? (std::max)(1.0, (double)trimTimeout / 2) : 5.0;
+    loop->runEvery(interval, sweepIdleConnections);
+}
+
+static void unwatchIdleConnection(HttpRequestParser *requestParser)
+{
+    idleConnections.parsers.erase(requestParser);
+}
+
+HttpServer::LoopStats HttpServer::loopStats()
+{
+    LoopStats stats;
+    stats.connections = idleConnections.parsers.size();
+    for (auto *requestParser : idleConnections.parsers)
+    {
+        if (requestParser->webSocketConn())
+            ++stats.webSocketConnections;
+        else if (requestParser->http2Conn())
+            ++stats.http2Connections;
+        stats.pipelinedRequests +=
+            requestParser->numberOfRequestsInPipelining();
+        stats.pooledRequests += requestParser->numberOfPooledRequests();
+        stats.bufferedBytes += requestParser->bufferedBytes();
+        stats.memoryUsage += requestParser->memoryUsage();
+    }
+    return stats;
+}
+
 static inline bool isWebSocket(const HttpRequestImplPtr &req)
 {
     if (req->method() != Get)
         return false;
 
-    auto &headers = req->headers();
-    if (headers.find("upgrade") == headers.end() ||
-        headers.find("connection") == headers.end())
+    // Don't look at headers(), which would copy all the headers to the map.
+    if (req->getKnownHeader(KnownHeader::kUpgrade).empty() ||
+        req->getKnownHeader(KnownHeader::kConnection).empty())
         return false;
 
-    auto connectionField = req->getHeaderBy("connection");
+    auto connectionField = req->getKnownHeader(KnownHeader::kConnection);
     std::transform(connectionField.begin(),
                    connectionField.end(),
                    connectionField.begin(),
                    [](unsigned char c) { return tolower(c); });
-    auto upgradeField = req->getHeaderBy("upgrade");
+    auto upgradeField = req->getKnownHeader(KnownHeader::kUpgrade);
     std::transform(upgradeField.begin(),
                    upgradeField.end(),
                    upgradeField.begin(),
@@ -1171,8 +1745,8 @@ static inline bool isWebSocket(const HttpRequestImplPtr &req)
 }
 
 /**
- * @brief calling req->decompressBody(), if not success, generate corresponding
- * error response
+ * @brief calling req->decompressBody() or req->startStreamDecompression(), if
+ * not success, generate corresponding error response
  */
 static inline HttpResponsePtr tryDecompressRequest(
     const HttpRequestImplPtr &req)
@@ -1182,7 +1756,10 @@ static inline HttpResponsePtr tryDecompressRequest(
     {
         return nullptr;
     }
-    auto status = req->decompressBody();
+    // The body of a stream mode request is mostly still to be received, it
+    // is decompressed piece by piece then.
+    auto status = req->isStreamMode() ? req->startStreamDecompression()
+                                      : req->decompressBody();
     if (status == StreamDecompressStatus::Ok)
     {
         return nullptr;
@@ -1238,69 +1815,256 @@ static inline bool passSyncAdvices(
     return true;
 }
 
+static const CompressionPolicy &compressionPolicyOf(
+    const HttpRequestImplPtr &req,
+    const HttpResponsePtr &response)
+{
+    auto &policy =
+        static_cast<HttpResponseImpl *>(response.get())->compressionPolicy();
+    if (policy)
+        return *policy;
+    return HttpAppFrameworkImpl::instance().compressionPolicy(req->path());
+}
+
+/**
+ * @brief Select the first encoding of the policy which is supported and
+ * accepted by the client. Return false if there is no such encoding.
+ */
+static bool selectEncoding(const HttpRequestImplPtr &req,
+                           const CompressionPolicy &policy,
+                           CompressionEncoding &encoding)
+{
+    const auto &acceptEncoding =
+        req->getKnownHeader(KnownHeader::kAcceptEncoding);
+    for (auto e : policy.encodings)
+    {
+#ifndef USE_BROTLI
+        if (e == CompressionEncoding::kBrotli)
+            continue;
+#endif
+#ifndef USE_ZSTD
+        if (e == CompressionEncoding::kZstd)
+            continue;
+#endif
+        if (acceptEncoding.find(compressionEncodingToString(e)) !=
+            std::string::npos)
+        {
+            encoding = e;
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::string compressBody(CompressionEncoding encoding,
+                                int level,
+                                const std::string_view &body)
+{
+    switch (encoding)
+    {
+        case CompressionEncoding::kBrotli:
+            return drogon::utils::brotliCompress(body.data(),
+                                                 body.length(),
+                                                 level);
+        case CompressionEncoding::kZstd:
+            return drogon::utils::zstdCompress(body.data(),
+                                               body.length(),
+                                               level);
+        case CompressionEncoding::kGzip:
+        default:
+            return drogon::utils::gzipCompress(body.data(),
+                                               body.length(),
+                                               level);
+    }
+}
+
+static HttpResponsePtr getCompressedStreamResponse(
+    const HttpRequestImplPtr &req,
+    const HttpResponsePtr &response,
+    const CompressionPolicy &policy)
+{
+    CompressionEncoding encoding;
+    if (!selectEncoding(req, policy, encoding))
+    {
+        return response;
+    }
+    auto newResp = std::static_pointer_cast<HttpResponseImpl>(response);
+    if (response->expiredTime() >= 0)
+    {
+        // cached response,we need to make a clone
+        newResp = std::make_shared<HttpResponseImpl>(*newResp);
+        newResp->setExpiredTime(-1);
+    }
+    if (!newResp->compressStream(encoding, policy.level(encoding)))
+    {
+        LOG_ERROR << "Failed to create the stream compressor";
+        return response;
+    }
+    return newResp;
+}
+
 static inline HttpResponsePtr getCompressedResponse(
     const HttpRequestImplPtr &req,
     const HttpResponsePtr &response,
     bool isHeadMethod)
 {
-    if (isHeadMethod ||
-        !static_cast<HttpResponseImpl *>(response.get())->shouldBeCompressed())
+    if (isHeadMethod)
     {
         return response;
     }
-#ifdef USE_BROTLI
-    if (app().isBrotliEnabled() &&
-        req->getHeaderBy("accept-encoding").find("br") != std::string::npos)
+    auto respImpl = static_cast<HttpResponseImpl *>(response.get());
+    const auto &policy = compressionPolicyOf(req, response);
+    if (respImpl->streamShouldBeCompressed(policy))
     {
-        auto newResp = response;
-        auto strCompress =
-            drogon::utils::brotliCompress(response->getBody().data(),
-                                          response->getBody().length());
-        if (!strCompress.empty())
-        {
-            if (response->expiredTime() >= 0)
-            {
-                // cached response,we need to make a clone
-                newResp = std::make_shared<HttpResponseImpl>(
-                    *static_cast<HttpResponseImpl *>(response.get()));
-                newResp->setExpiredTime(-1);
-            }
-            newResp->setBody(std::move(strCompress));
-            newResp->addHeader("Content-Encoding", "br");
-        }
-        else
-        {
-            LOG_ERROR << "brotli got 0 length result";
-        }
-        return newResp;
+        return getCompressedStreamResponse(req, response, policy);
     }
-#endif
-    if (app().isGzipEnabled() &&
-        req->getHeaderBy("accept-encoding").find("gzip") != std::string::npos)
-    {
-        auto newResp = response;
-        auto strCompress =
-            drogon::utils::gzipCompress(response->getBody().data(),
-                                        response->getBody().length());
-        if (!strCompress.empty())
+    CompressionEncoding encoding;
+    if (!respImpl->shouldBeCompressed(policy) ||
+        !selectEncoding(req, policy, encoding))
+    {
+        return response;
+    }
+    auto newResp = response;
+    auto strCompress =
+        compressBody(encoding, policy.level(encoding), response->getBody());
+    if (!strCompress.empty())
+    {
+        if (response->expiredTime() >= 0)
         {
-            if (response->expiredTime() >= 0)
-            {
-                // cached response,we need to make a clone
-                newResp = std::make_shared<HttpResponseImpl>(
-                    *static_cast<HttpResponseImpl *>(response.get()));
-                newResp->setExpiredTime(-1);
-            }
-            newResp->setBody(std::move(strCompress));
-            newResp->addHeader("Content-Encoding", "gzip");
+            // cached response,we need to make a clone
+            newResp = std::make_shared<HttpResponseImpl>(*respImpl);
+            newResp->setExpiredTime(-1);
         }
-        else
+        newResp->setBody(std::move(strCompress));
+        newResp->addHeader("Content-Encoding",
+                           compressionEncodingToString(encoding));
+    }
+    else
+    {
+        LOG_ERROR << compressionEncodingToString(encoding)
+                  << " got 0 length result";
+    }
+    return newResp;
+}
+
+static inline HttpResponsePtr getConditionalResponse(
+    const HttpRequestImplPtr &req,
+    const HttpResponsePtr &response)
+{
+    // HEAD requests are handled as GET ones.
+    if (!HttpAppFrameworkImpl::instance().isDynamicETagEnabled() ||
+        req->method() != Get || response->statusCode() != k200OK)
+    {
+        return response;
+    }
+    auto respImpl = static_cast<HttpResponseImpl *>(response.get());
+    if (respImpl->streamCallback() || respImpl->asyncStreamCallback() ||
+        !respImpl->sendfileName().empty() ||
+        !response->getHeader("last-modified").empty())
+    {
+        return response;
+    }
+    auto newResp = response;
+    std::string etag = response->getHeader("etag");
+    if (etag.empty())
+    {
+        etag = bodyETag(response->body());
+        if (response->expiredTime() >= 0)
         {
-            LOG_ERROR << "gzip got 0 length result";
+            // cached response,we need to make a clone
+            newResp = std::make_shared<HttpResponseImpl>(*respImpl);
+            newResp->setExpiredTime(-1);
         }
+        newResp->addHeader("etag", etag);
+    }
+    const auto &ifNoneMatch = req->getHeader("if-none-match");
+    if (ifNoneMatch.empty() || !etagMatches(ifNoneMatch, etag))
         return newResp;
+    auto notModified = std::make_shared<HttpResponseImpl>();
+    notModified->setStatusCode(k304NotModified);
+    notModified->setContentTypeCode(CT_NONE);
+    notModified->setVersion(response->version());
+    notModified->setCloseConnection(response->ifCloseConnection());
+    // The headers a 200 response would have, rfc9110-15.4.5
+    for (const char *name :
+         {"etag", "cache-control", "content-location", "expires", "vary"})
+    {
+        const auto &value = newResp->getHeader(name);
+        if (!value.empty())
+            notModified->addHeader(name, value);
     }
-    return response;
+    for (const auto &cookie : response->cookies())
+        notModified->addCookie(cookie.second);
+    return notModified;
+}
+
+static inline void sampleRequest(const HttpRequestImplPtr &req)
+{
+    auto &tracing = RequestTracing::instance();
+    if (tracing.exporter)
+    {
+        req->setTrace(RequestTrace::sample(req->getHeader("traceparent"),
+                                           tracing.sampleRatio));
+    }
+}
+
+static inline void setDeadline(const HttpRequestImplPtr &req)
+{
+    auto &appImpl = HttpAppFrameworkImpl::instance();
+    double timeout = appImpl.getRequestDeadline();
+    const auto &header = appImpl.getRequestDeadlineHeader();
+    if (!header.empty())
+    {
+        // The number of seconds the client waits for the response, the
+        // invalid values are ignored.
+        auto value = req->getHeaderView(header);
+        double clientTimeout =
+            value.empty() ? 0.0 : atof(std::string(value).c_str());
+        if (clientTimeout > 0.0 && (timeout <= 0.0 || clientTimeout < timeout))
+            timeout = clientTimeout;
+    }
+    if (timeout > 0.0)
+        req->setDeadline(req->creationDate().after(timeout));
+}
+
+static inline void markTrace(const HttpRequestImplPtr &req,
+                             RequestTrace::Stage stage)
+{
+    if (auto &trace = req->trace())
+    {
+        trace->mark(stage);
+    }
+}
+
+static inline void exportTrace(const HttpRequestImplPtr &req,
+                               const HttpResponsePtr &resp)
+{
+    if (auto &trace = req->trace())
+    {
+        trace->mark(RequestTrace::Stage::Sent);
+        RequestTracing::instance().exporter(req, resp, *trace);
+    }
+}
+
+static inline void probeHandlerEnd(
+    [[maybe_unused]] const HttpRequestImplPtr &req,
+    [[maybe_unused]] const HttpResponsePtr &resp)
+{
+    DROGON_PROBE4(handler__end,
+                  req.get(),
+                  static_cast<int>(resp->statusCode()),
+                  req->matchedPathPatternData(),
+                  req->matchedPathPatternLength());
+}
+
+static inline void probeResponseSend(
+    [[maybe_unused]] const HttpRequestImplPtr &req,
+    [[maybe_unused]] const HttpResponsePtr &resp)
+{
+    DROGON_PROBE3(response__send,
+                  req.get(),
+                  static_cast<int>(resp->statusCode()),
+                  resp->body().length());
 }
 
 static void handleInvalidHttpMethod(
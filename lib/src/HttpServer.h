@@ -21,8 +21,6 @@
 #include <vector>
 #include "impl_forwards.h"
 
-struct CallbackParamPack;
-
 namespace drogon
 {
 struct ControllerBinderBase;
@@ -44,6 +42,11 @@ class HttpServer : trantor::NonCopyable
     void start();
     void stop();
 
+    trantor::EventLoop *getLoop() const
+    {
+        return server_.getLoop();
+    }
+
     void enableSSL(trantor::TLSPolicyPtr policy)
     {
         server_.enableSSL(std::move(policy));
@@ -69,21 +72,54 @@ class HttpServer : trantor::NonCopyable
         afterAcceptSetSockOptCallback_ = std::move(cb);
     }
 
+    // The state of the connections of the IO loop of the calling thread, of
+    // all the listeners.
+    struct LoopStats
+    {
+        size_t connections{0};
+        size_t http2Connections{0};
+        size_t webSocketConnections{0};
+        // The requests waiting for their responses
+        size_t pipelinedRequests{0};
+        size_t pooledRequests{0};
+        size_t bufferedBytes{0};
+        size_t memoryUsage{0};
+    };
+
+    static LoopStats loopStats();
+
     void setConnectionCallback(
         std::function<void(const trantor::TcpConnectionPtr &)> cb)
     {
         connectionCallback_ = std::move(cb);
     }
 
+    // Send the 103 Early Hints response of the request on its connection,
+    // see HttpRequest::sendEarlyHints().
+    static void sendEarlyHints(const trantor::TcpConnectionPtr &conn,
+                               const HttpRequestImpl *req,
+                               const std::vector<std::string> &links);
+
   private:
     friend class HttpInternalForwardHelper;
 
     static void onConnection(const trantor::TcpConnectionPtr &conn);
     static void onMessage(const trantor::TcpConnectionPtr &,
                           trantor::MsgBuffer *);
+    // Keep the input of the connection until the memory pressure goes down,
+    // see HttpAppFramework::setMemorySoftLimit().
+    static void holdInput(const trantor::TcpConnectionPtr &,
+                          trantor::MsgBuffer *,
+                          const std::shared_ptr<HttpRequestParser> &);
+    static void resumeInput(const trantor::TcpConnectionPtr &,
+                            const std::shared_ptr<HttpRequestParser> &);
+    static void resumeHeldConnections(trantor::EventLoop *loop);
     static void onRequests(const trantor::TcpConnectionPtr &,
                            const std::vector<HttpRequestImplPtr> &,
                            const std::shared_ptr<HttpRequestParser> &);
+    static void onHttp2Request(const Http2ServerConnectionPtr &,
+                               uint32_t streamId,
+                               const HttpRequestImplPtr &);
 
     struct HttpRequestParamPack
     {
@@ -134,13 +170,18 @@ class HttpServer : trantor::NonCopyable
     static void requestPreHandling(const HttpRequestImplPtr &req, Pack &&pack);
 
     // Response buffering and sending
-    static void handleResponse(
-        const HttpResponsePtr &response,
-        const std::shared_ptr<CallbackParamPack> &paramPack,
-        bool *respReadyPtr);
+    static void handleResponse(const HttpResponsePtr &response,
+                               const HttpRequestImplPtr &req,
+                               bool *respReadyPtr);
     static void sendResponse(const trantor::TcpConnectionPtr &,
                              const HttpResponsePtr &,
                              bool isHeadMethod);
+    // requestAlive is false when the request may have been destroyed.
+    static void sendEarlyHintsInLoop(const trantor::TcpConnectionPtr &conn,
+                                     const HttpRequestImpl *req,
+                                     uint32_t http2StreamId,
+                                     const std::vector<std::string> &links,
+                                     bool requestAlive);
     static void sendResponses(
         const trantor::TcpConnectionPtr &conn,
         const std::vector<std::pair<HttpResponsePtr, bool>> &responses,
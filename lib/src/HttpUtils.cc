@@ -15,7 +15,12 @@
 #include "HttpUtils.h"
 #include <drogon/utils/Utilities.h>
 #include <trantor/utils/Logger.h>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <mutex>
 
@@ -124,109 +129,233 @@ static const std::unordered_map<
         {CT_VIDEO_X_MSVIDEO, {{"video/x-msvideo"}, ""}},
     };
 
-static const std::unordered_map<std::string_view,
-                                std::pair<FileType, ContentType>>
-    fileTypeDatabase_{
-        {"", {FT_UNKNOWN, CT_CUSTOM}},
-        {"aac", {FT_AUDIO, CT_AUDIO_AAC}},
-        {"ac3", {FT_AUDIO, CT_AUDIO_AC3}},
-        {"aif", {FT_AUDIO, CT_AUDIO_AIFF}},
-        {"aifc", {FT_AUDIO, CT_AUDIO_AIFF}},
-        {"aiff", {FT_AUDIO, CT_AUDIO_AIFF}},
-        {"apg", {FT_AUDIO, CT_VIDEO_APG}},
-        {"ape", {FT_AUDIO, CT_AUDIO_X_APE}},
-        {"apng", {FT_IMAGE, CT_IMAGE_APNG}},
-        {"av1", {FT_MEDIA, CT_VIDEO_AV1}},
-        {"avi", {FT_MEDIA, CT_VIDEO_X_MSVIDEO}},
-        {"avif", {FT_IMAGE, CT_IMAGE_AVIF}},
-        {"bmp", {FT_IMAGE, CT_IMAGE_BMP}},
-        {"bz", {FT_ARCHIVE, CT_APPLICATION_X_BZIP}},
-        {"bz2", {FT_ARCHIVE, CT_APPLICATION_X_BZIP2}},
-        {"css", {FT_DOCUMENT, CT_TEXT_CSS}},
-        {"csv", {FT_DOCUMENT, CT_TEXT_CSV}},
-        {"doc", {FT_DOCUMENT, CT_APPLICATION_MSWORD}},
-        {"docx", {FT_DOCUMENT, CT_APPLICATION_MSWORDX}},
-        {"eot", {FT_DOCUMENT, CT_APPLICATION_VND_MS_FONTOBJ}},
-        {"flac", {FT_AUDIO, CT_AUDIO_FLAC}},
-        {"gif", {FT_MEDIA, CT_IMAGE_GIF}},
-        {"gz", {FT_ARCHIVE, CT_APPLICATION_GZIP}},
-        {"htm", {FT_DOCUMENT, CT_TEXT_HTML}},
-        {"html", {FT_DOCUMENT, CT_TEXT_HTML}},
-        {"icns", {FT_IMAGE, CT_IMAGE_ICNS}},
-        {"ico", {FT_IMAGE, CT_IMAGE_XICON}},
-        {"j2k", {FT_IMAGE, CT_IMAGE_JP2}},
-        {"jar", {FT_DOCUMENT, CT_APPLICATION_JAVA_ARCHIVE}},
-        {"j2c", {FT_IMAGE, CT_IMAGE_JP2}},
-        {"jp2", {FT_IMAGE, CT_IMAGE_JP2}},
-        {"jpeg", {FT_IMAGE, CT_IMAGE_JPG}},
-        {"jpc", {FT_IMAGE, CT_IMAGE_JP2}},
-        {"jpf", {FT_IMAGE, CT_IMAGE_JP2}},
-        {"jpg", {FT_IMAGE, CT_IMAGE_JPG}},
-        {"jpg2", {FT_IMAGE, CT_IMAGE_JP2}},
-        {"jpm", {FT_IMAGE, CT_IMAGE_JP2}},
-        {"jpx", {FT_IMAGE, CT_IMAGE_JP2}},
-        {"js", {FT_DOCUMENT, CT_TEXT_JAVASCRIPT}},
-        {"json", {FT_DOCUMENT, CT_APPLICATION_JSON}},
-        {"lzma", {FT_ARCHIVE, CT_APPLICATION_X_XZ}},
-        {"m1a", {FT_AUDIO, CT_AUDIO_MPEG}},
-        {"m1v", {FT_MEDIA, CT_VIDEO_MPEG}},
-        {"m2a", {FT_AUDIO, CT_AUDIO_MPEG}},
-        {"m2ts", {FT_MEDIA, CT_VIDEO_MPEG2TS}},
-        {"m2v", {FT_MEDIA, CT_VIDEO_MPEG}},
-        {"m4a", {FT_AUDIO, CT_AUDIO_MPEG4}},
-        {"m4v", {FT_MEDIA, CT_VIDEO_X_M4V}},
-        {"mjs", {FT_DOCUMENT, CT_TEXT_JAVASCRIPT}},
-        {"mka", {FT_AUDIO, CT_AUDIO_MATROSKA}},
-        {"mkv", {FT_MEDIA, CT_VIDEO_MATROSKA}},
-        {"mng", {FT_MEDIA, CT_IMAGE_X_MNG}},
-        {"mov", {FT_MEDIA, CT_VIDEO_QUICKTIME}},
-        {"mp1", {FT_AUDIO, CT_AUDIO_MPEG}},
-        {"mp2", {FT_AUDIO, CT_AUDIO_MPEG}},
-        {"mp3", {FT_AUDIO, CT_AUDIO_MPEG}},
-        {"mp4", {FT_MEDIA, CT_VIDEO_MP4}},
-        {"mpa", {FT_AUDIO, CT_AUDIO_MPEG}},
-        {"mpe", {FT_MEDIA, CT_VIDEO_MPEG}},
-        {"mpeg", {FT_MEDIA, CT_VIDEO_MPEG}},
-        {"mpg", {FT_MEDIA, CT_VIDEO_MPEG}},
-        {"mpv", {FT_MEDIA, CT_VIDEO_MPEG}},
-        {"oga", {FT_AUDIO, CT_AUDIO_OGG}},
-        {"ogg", {FT_AUDIO, CT_AUDIO_OGG}},
-        {"ogv", {FT_MEDIA, CT_VIDEO_OGG}},
-        {"otf", {FT_DOCUMENT, CT_APPLICATION_X_FONT_OPENTYPE}},
-        {"pdf", {FT_DOCUMENT, CT_APPLICATION_PDF}},
-        {"php", {FT_DOCUMENT, CT_APPLICATION_X_HTTPD_PHP}},
-        {"png", {FT_IMAGE, CT_IMAGE_PNG}},
-        {"rar", {FT_ARCHIVE, CT_APPLICATION_VND_RAR}},
-        {"svg", {FT_IMAGE, CT_IMAGE_SVG_XML}},
-        {"tar", {FT_ARCHIVE, CT_APPLICATION_X_TAR}},
-        {"targa", {FT_IMAGE, CT_IMAGE_X_TGA}},
-        {"tif", {FT_IMAGE, CT_IMAGE_TIFF}},
-        {"tiff", {FT_IMAGE, CT_IMAGE_TIFF}},
-        {"tga", {FT_IMAGE, CT_IMAGE_X_TGA}},
-        {"tgz", {FT_ARCHIVE, CT_APPLICATION_X_TGZ}},
-        {"ts", {FT_MEDIA, CT_VIDEO_MPEG2TS}},
-        {"tta", {FT_AUDIO, CT_AUDIO_X_TTA}},
-        {"ttf", {FT_DOCUMENT, CT_APPLICATION_X_FONT_TRUETYPE}},
-        {"txt", {FT_DOCUMENT, CT_TEXT_PLAIN}},
-        {"w64", {FT_AUDIO, CT_AUDIO_WAVE}},
-        {"wav", {FT_AUDIO, CT_AUDIO_WAVE}},
-        {"wave", {FT_AUDIO, CT_AUDIO_WAVE}},
-        {"wasm", {FT_DOCUMENT, CT_APPLICATION_WASM}},
-        {"weba", {FT_AUDIO, CT_AUDIO_WEBM}},
-        {"webm", {FT_MEDIA, CT_VIDEO_WEBM}},
-        {"webp", {FT_IMAGE, CT_IMAGE_WEBP}},
-        {"wma", {FT_AUDIO, CT_AUDIO_X_MS_WMA}},
-        {"woff", {FT_DOCUMENT, CT_APPLICATION_FONT_WOFF}},
-        {"woff2", {FT_DOCUMENT, CT_APPLICATION_FONT_WOFF2}},
-        {"wv", {FT_AUDIO, CT_AUDIO_X_WAVPACK}},
-        {"xht", {FT_DOCUMENT, CT_APPLICATION_XHTML}},
-        {"xhtml", {FT_DOCUMENT, CT_APPLICATION_XHTML}},
-        {"xml", {FT_DOCUMENT, CT_APPLICATION_XML}},
-        {"xsl", {FT_DOCUMENT, CT_TEXT_XSL}},
-        {"xz", {FT_ARCHIVE, CT_APPLICATION_X_XZ}},
-        {"zip", {FT_ARCHIVE, CT_APPLICATION_ZIP}},
-        {"7z", {FT_ARCHIVE, CT_APPLICATION_X_7Z}},
-    };
+namespace
+{
+struct FileTypeEntry
+{
+    std::string_view extension;
+    FileType fileType;
+    ContentType contentType;
+};
+}  // namespace
+
+static constexpr FileTypeEntry fileTypeDatabase_[] = {
+    {"", FT_UNKNOWN, CT_CUSTOM},
+    {"aac", FT_AUDIO, CT_AUDIO_AAC},
+    {"ac3", FT_AUDIO, CT_AUDIO_AC3},
+    {"aif", FT_AUDIO, CT_AUDIO_AIFF},
+    {"aifc", FT_AUDIO, CT_AUDIO_AIFF},
+    {"aiff", FT_AUDIO, CT_AUDIO_AIFF},
+    {"apg", FT_AUDIO, CT_VIDEO_APG},
+    {"ape", FT_AUDIO, CT_AUDIO_X_APE},
+    {"apng", FT_IMAGE, CT_IMAGE_APNG},
+    {"av1", FT_MEDIA, CT_VIDEO_AV1},
+    {"avi", FT_MEDIA, CT_VIDEO_X_MSVIDEO},
+    {"avif", FT_IMAGE, CT_IMAGE_AVIF},
+    {"bmp", FT_IMAGE, CT_IMAGE_BMP},
+    {"bz", FT_ARCHIVE, CT_APPLICATION_X_BZIP},
+    {"bz2", FT_ARCHIVE, CT_APPLICATION_X_BZIP2},
+    {"css", FT_DOCUMENT, CT_TEXT_CSS},
+    {"csv", FT_DOCUMENT, CT_TEXT_CSV},
+    {"doc", FT_DOCUMENT, CT_APPLICATION_MSWORD},
+    {"docx", FT_DOCUMENT, CT_APPLICATION_MSWORDX},
+    {"eot", FT_DOCUMENT, CT_APPLICATION_VND_MS_FONTOBJ},
+    {"flac", FT_AUDIO, CT_AUDIO_FLAC},
+    {"gif", FT_MEDIA, CT_IMAGE_GIF},
+    {"gz", FT_ARCHIVE, CT_APPLICATION_GZIP},
+    {"htm", FT_DOCUMENT, CT_TEXT_HTML},
+    {"html", FT_DOCUMENT, CT_TEXT_HTML},
+    {"icns", FT_IMAGE, CT_IMAGE_ICNS},
+    {"ico", FT_IMAGE, CT_IMAGE_XICON},
+    {"j2k", FT_IMAGE, CT_IMAGE_JP2},
+    {"jar", FT_DOCUMENT, CT_APPLICATION_JAVA_ARCHIVE},
+    {"j2c", FT_IMAGE, CT_IMAGE_JP2},
+    {"jp2", FT_IMAGE, CT_IMAGE_JP2},
+    {"jpeg", FT_IMAGE, CT_IMAGE_JPG},
+    {"jpc", FT_IMAGE, CT_IMAGE_JP2},
+    {"jpf", FT_IMAGE, CT_IMAGE_JP2},
+    {"jpg", FT_IMAGE, CT_IMAGE_JPG},
+    {"jpg2", FT_IMAGE, CT_IMAGE_JP2},
+    {"jpm", FT_IMAGE, CT_IMAGE_JP2},
+    {"jpx", FT_IMAGE, CT_IMAGE_JP2},
+    {"js", FT_DOCUMENT, CT_TEXT_JAVASCRIPT},
+    {"json", FT_DOCUMENT, CT_APPLICATION_JSON},
+    {"lzma", FT_ARCHIVE, CT_APPLICATION_X_XZ},
+    {"m1a", FT_AUDIO, CT_AUDIO_MPEG},
+    {"m1v", FT_MEDIA, CT_VIDEO_MPEG},
+    {"m2a", FT_AUDIO, CT_AUDIO_MPEG},
+    {"m2ts", FT_MEDIA, CT_VIDEO_MPEG2TS},
+    {"m2v", FT_MEDIA, CT_VIDEO_MPEG},
+    {"m4a", FT_AUDIO, CT_AUDIO_MPEG4},
+    {"m4v", FT_MEDIA, CT_VIDEO_X_M4V},
+    {"mjs", FT_DOCUMENT, CT_TEXT_JAVASCRIPT},
+    {"mka", FT_AUDIO, CT_AUDIO_MATROSKA},
+    {"mkv", FT_MEDIA, CT_VIDEO_MATROSKA},
+    {"mng", FT_MEDIA, CT_IMAGE_X_MNG},
+    {"mov", FT_MEDIA, CT_VIDEO_QUICKTIME},
+    {"mp1", FT_AUDIO, CT_AUDIO_MPEG},
+    {"mp2", FT_AUDIO, CT_AUDIO_MPEG},
+    {"mp3", FT_AUDIO, CT_AUDIO_MPEG},
+    {"mp4", FT_MEDIA, CT_VIDEO_MP4},
+    {"mpa", FT_AUDIO, CT_AUDIO_MPEG},
+    {"mpe", FT_MEDIA, CT_VIDEO_MPEG},
+    {"mpeg", FT_MEDIA, CT_VIDEO_MPEG},
+    {"mpg", FT_MEDIA, CT_VIDEO_MPEG},
+    {"mpv", FT_MEDIA, CT_VIDEO_MPEG},
+    {"oga", FT_AUDIO, CT_AUDIO_OGG},
+    {"ogg", FT_AUDIO, CT_AUDIO_OGG},
+    {"ogv", FT_MEDIA, CT_VIDEO_OGG},
+    {"otf", FT_DOCUMENT, CT_APPLICATION_X_FONT_OPENTYPE},
+    {"pdf", FT_DOCUMENT, CT_APPLICATION_PDF},
+    {"php", FT_DOCUMENT, CT_APPLICATION_X_HTTPD_PHP},
+    {"png", FT_IMAGE, CT_IMAGE_PNG},
+    {"rar", FT_ARCHIVE, CT_APPLICATION_VND_RAR},
+    {"svg", FT_IMAGE, CT_IMAGE_SVG_XML},
+    {"tar", FT_ARCHIVE, CT_APPLICATION_X_TAR},
+    {"targa", FT_IMAGE, CT_IMAGE_X_TGA},
+    {"tif", FT_IMAGE, CT_IMAGE_TIFF},
+    {"tiff", FT_IMAGE, CT_IMAGE_TIFF},
+    {"tga", FT_IMAGE, CT_IMAGE_X_TGA},
+    {"tgz", FT_ARCHIVE, CT_APPLICATION_X_TGZ},
+    {"ts", FT_MEDIA, CT_VIDEO_MPEG2TS},
+    {"tta", FT_AUDIO, CT_AUDIO_X_TTA},
+    {"ttf", FT_DOCUMENT, CT_APPLICATION_X_FONT_TRUETYPE},
+    {"txt", FT_DOCUMENT, CT_TEXT_PLAIN},
+    {"w64", FT_AUDIO, CT_AUDIO_WAVE},
+    {"wav", FT_AUDIO, CT_AUDIO_WAVE},
+    {"wave", FT_AUDIO, CT_AUDIO_WAVE},
+    {"wasm", FT_DOCUMENT, CT_APPLICATION_WASM},
+    {"weba", FT_AUDIO, CT_AUDIO_WEBM},
+    {"webm", FT_MEDIA, CT_VIDEO_WEBM},
+    {"webp", FT_IMAGE, CT_IMAGE_WEBP},
+    {"wma", FT_AUDIO, CT_AUDIO_X_MS_WMA},
+    {"woff", FT_DOCUMENT, CT_APPLICATION_FONT_WOFF},
+    {"woff2", FT_DOCUMENT, CT_APPLICATION_FONT_WOFF2},
+    {"wv", FT_AUDIO, CT_AUDIO_X_WAVPACK},
+    {"xht", FT_DOCUMENT, CT_APPLICATION_XHTML},
+    {"xhtml", FT_DOCUMENT, CT_APPLICATION_XHTML},
+    {"xml", FT_DOCUMENT, CT_APPLICATION_XML},
+    {"xsl", FT_DOCUMENT, CT_TEXT_XSL},
+    {"xz", FT_ARCHIVE, CT_APPLICATION_X_XZ},
+    {"zip", FT_ARCHIVE, CT_APPLICATION_ZIP},
+    {"7z", FT_ARCHIVE, CT_APPLICATION_X_7Z},
+};
+
+// The built-in extensions are looked up by a perfect hash: an extension of up
+// to 8 characters is packed in 64 bits, lowercased, and the slot is the high
+// bits of its product by a multiplier. The multiplier is searched at compile
+// time so that no two extensions share a slot.
+static constexpr size_t kMaxPackedExtensionLength = 8;
+static constexpr int kFileTypeSlotBits = 11;
+static constexpr uint8_t kNoFileType = 0xff;
+static_assert(std::size(fileTypeDatabase_) < kNoFileType);
+
+static constexpr uint64_t packExtension(std::string_view extension)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < extension.length(); ++i)
+    {
+        auto c = static_cast<unsigned char>(extension[i]);
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        key |= static_cast<uint64_t>(c) << (8 * i);
+    }
+    return key;
+}
+
+static constexpr size_t fileTypeSlotOf(uint64_t key, uint64_t multiplier)
+{
+    return static_cast<size_t>((key * multiplier) >> (64 - kFileTypeSlotBits));
+}
+
+static constexpr uint64_t findFileTypeMultiplier()
+{
+    constexpr size_t kSlots = size_t{1} << kFileTypeSlotBits;
+    for (uint64_t seed = 1;; ++seed)
+    {
+        auto multiplier = (seed * 0x9e3779b97f4a7c15ULL) | 1;
+        uint64_t used[kSlots / 64]{};
+        bool collision = false;
+        for (auto &entry : fileTypeDatabase_)
+        {
+            auto slot =
+                fileTypeSlotOf(packExtension(entry.extension), multiplier);
+            auto bit = uint64_t{1} << (slot % 64);
+            if (used[slot / 64] & bit)
+            {
+                collision = true;
+                break;
+            }
+            used[slot / 64] |= bit;
+        }
+        if (!collision)
+            return multiplier;
+    }
+}
+
+struct FileTypeSlots
+{
+    uint64_t multiplier{0};
+    uint8_t slots[size_t{1} << kFileTypeSlotBits]{};
+};
+
+static constexpr FileTypeSlots makeFileTypeSlots()
+{
+    FileTypeSlots result;
+    result.multiplier = findFileTypeMultiplier();
+    for (auto &slot : result.slots)
+        slot = kNoFileType;
+    for (size_t i = 0; i < std::size(fileTypeDatabase_); ++i)
+    {
+        auto key = packExtension(fileTypeDatabase_[i].extension);
+        result.slots[fileTypeSlotOf(key, result.multiplier)] =
+            static_cast<uint8_t>(i);
+    }
+    return result;
+}
+
+static constexpr FileTypeSlots fileTypeSlots_ = makeFileTypeSlots();
+
+static const FileTypeEntry *findFileType(std::string_view extension)
+{
+    if (extension.length() > kMaxPackedExtensionLength)
+        return nullptr;
+    auto key = packExtension(extension);
+    auto index =
+        fileTypeSlots_.slots[fileTypeSlotOf(key, fileTypeSlots_.multiplier)];
+    if (index == kNoFileType)
+        return nullptr;
+    auto &entry = fileTypeDatabase_[index];
+    if (entry.extension.length() != extension.length() ||
+        packExtension(entry.extension) != key)
+        return nullptr;
+    return &entry;
+}
+
+// The extension of the file name, empty if there is none.
+static std::string_view extensionOf(std::string_view fileName)
+{
+    auto pos = fileName.rfind('.');
+    if (pos == std::string_view::npos)
+        return {};
+    return fileName.substr(pos + 1);
+}
+
+// The custom extensions are registered in lowercase.
+static const std::string *findCustomMime(std::string_view extension)
+{
+    if (customMime.empty())
+        return nullptr;
+    std::string extName(extension);
+    transform(extName.begin(),
+              extName.end(),
+              extName.begin(),
+              [](unsigned char c) { return tolower(c); });
+    auto it = customMime.find(extName);
+    if (it == customMime.end())
+        return nullptr;
+    return &it->second;
+}
 
 const std::string_view &statusCodeToString(int code)
 {
@@ -583,19 +712,8 @@ const std::string_view &statusCodeToString(int code)
 
 ContentType getContentType(const std::string &fileName)
 {
-    std::string extName;
-    auto pos = fileName.rfind('.');
-    if (pos != std::string::npos)
-    {
-        extName = fileName.substr(pos + 1);
-        transform(extName.begin(),
-                  extName.end(),
-                  extName.begin(),
-                  [](unsigned char c) { return tolower(c); });
-    }
-    auto it = fileTypeDatabase_.find(extName);
-    return (it == fileTypeDatabase_.end()) ? CT_APPLICATION_OCTET_STREAM
-                                           : it->second.second;
+    auto entry = findFileType(extensionOf(fileName));
+    return entry ? entry->contentType : CT_APPLICATION_OCTET_STREAM;
 }
 
 ContentType parseContentType(const std::string_view &contentType)
@@ -624,13 +742,8 @@ ContentType parseContentType(const std::string_view &contentType)
 
 FileType parseFileType(const std::string_view &fileExtension)
 {
-    std::string extName(fileExtension);
-    transform(extName.begin(),
-              extName.end(),
-              extName.begin(),
-              [](unsigned char c) { return tolower(c); });
-    auto it = fileTypeDatabase_.find(extName);
-    return (it == fileTypeDatabase_.end()) ? FT_CUSTOM : it->second.first;
+    auto entry = findFileType(fileExtension);
+    return entry ? entry->fileType : FT_CUSTOM;
 }
 
 FileType getFileType(ContentType contentType)
@@ -641,7 +754,7 @@ FileType getFileType(ContentType contentType)
     static std::once_flag flag;
     std::call_once(flag, []() {
         for (const auto &e : fileTypeDatabase_)
-            fileTypeMap_[e.second.second] = e.second.first;
+            fileTypeMap_[e.contentType] = e.fileType;
         fileTypeMap_[CT_NONE] = FT_UNKNOWN;
         fileTypeMap_[CT_CUSTOM] = FT_CUSTOM;
     });
@@ -663,7 +776,12 @@ void registerCustomExtensionMime(const std::string &ext,
 {
     if (ext.empty())
         return;
-    auto &mimeStr = customMime[ext];
+    std::string extName(ext);
+    transform(extName.begin(),
+              extName.end(),
+              extName.begin(),
+              [](unsigned char c) { return tolower(c); });
+    auto &mimeStr = customMime[extName];
     if (!mimeStr.empty())
     {
         LOG_WARN << ext << " has already been registered as type " << mime
@@ -674,47 +792,27 @@ void registerCustomExtensionMime(const std::string &ext,
 
 const std::string_view fileNameToMime(const std::string &fileName)
 {
-    ContentType internalContentType = getContentType(fileName);
-    if (internalContentType != CT_APPLICATION_OCTET_STREAM)
-        return contentTypeToMime(internalContentType);
-
-    std::string extName;
-    auto pos = fileName.rfind('.');
-    if (pos != std::string::npos)
-    {
-        extName = fileName.substr(pos + 1);
-        transform(extName.begin(),
-                  extName.end(),
-                  extName.begin(),
-                  [](unsigned char c) { return tolower(c); });
-    }
-    auto it = customMime.find(extName);
-    if (it == customMime.end())
+    auto extension = extensionOf(fileName);
+    auto entry = findFileType(extension);
+    if (entry && entry->contentType != CT_APPLICATION_OCTET_STREAM)
+        return contentTypeToMime(entry->contentType);
+    auto mime = findCustomMime(extension);
+    if (!mime)
         return "";
-    return it->second;
+    return *mime;
 }
 
 std::pair<ContentType, const std::string_view> fileNameToContentTypeAndMime(
     const std::string &fileName)
 {
-    ContentType internalContentType = getContentType(fileName);
-    if (internalContentType != CT_APPLICATION_OCTET_STREAM)
-        return {internalContentType, contentTypeToMime(internalContentType)};
-
-    std::string extName;
-    auto pos = fileName.rfind('.');
-    if (pos != std::string::npos)
-    {
-        extName = fileName.substr(pos + 1);
-        transform(extName.begin(),
-                  extName.end(),
-                  extName.begin(),
-                  [](unsigned char c) { return tolower(c); });
-    }
-    auto it = customMime.find(extName);
-    if (it == customMime.end())
+    auto extension = extensionOf(fileName);
+    auto entry = findFileType(extension);
+    if (entry && entry->contentType != CT_APPLICATION_OCTET_STREAM)
+        return {entry->contentType, contentTypeToMime(entry->contentType)};
+    auto mime = findCustomMime(extension);
+    if (!mime)
         return {CT_NONE, ""};
-    return {CT_CUSTOM, it->second};
+    return {CT_CUSTOM, *mime};
 }
 
 const std::vector<std::string_view> &getFileExtensions(ContentType contentType)
@@ -727,8 +825,8 @@ const std::vector<std::string_view> &getFileExtensions(ContentType contentType)
     static std::once_flag flag;
     std::call_once(flag, []() {
         for (const auto &e : fileTypeDatabase_)
-            if (!e.first.empty())
-                extensionMap_[e.second.second].push_back(e.first);
+            if (!e.extension.empty())
+                extensionMap_[e.contentType].push_back(e.extension);
         // Add deprecated
         extensionMap_[CT_APPLICATION_X_JAVASCRIPT] =
             extensionMap_[CT_TEXT_JAVASCRIPT];
@@ -740,4 +838,199 @@ const std::vector<std::string_view> &getFileExtensions(ContentType contentType)
     return it->second;
 }
 
+static inline uint64_t rotateLeft(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t mixBlock(uint64_t k)
+{
+    k *= 0x87c37b91114253d5ULL;
+    k = rotateLeft(k, 31);
+    return k * 0x4cf5ad432745937fULL;
+}
+
+// A single lane of MurmurHash3, 8 bytes per round.
+static uint64_t hashBody(std::string_view body)
+{
+    auto data = body.data();
+    auto len = body.length();
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+    for (; len >= 8; data += 8, len -= 8)
+    {
+        uint64_t k;
+        memcpy(&k, data, 8);
+        h ^= mixBlock(k);
+        h = rotateLeft(h, 27) * 5 + 0x52dce729;
+    }
+    if (len > 0)
+    {
+        uint64_t k = 0;
+        memcpy(&k, data, len);
+        h ^= mixBlock(k);
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+std::string bodyETag(std::string_view body)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    auto h = hashBody(body);
+    std::string etag{"W/\"0000000000000000\""};
+    for (size_t i = 18; i >= 3; --i, h >>= 4)
+        etag[i] = hexDigits[h & 0xf];
+    return etag;
+}
+
+static inline std::string_view opaqueTag(std::string_view etag)
+{
+    if (etag.size() >= 2 && etag[0] == 'W' && etag[1] == '/')
+        etag.remove_prefix(2);
+    return etag;
+}
+
+bool etagMatches(std::string_view ifNoneMatch, std::string_view etag)
+{
+    auto tag = opaqueTag(etag);
+    for (auto candidate : utils::splitStringView(ifNoneMatch, ","))
+    {
+        if (candidate == "*" || opaqueTag(candidate) == tag)
+            return true;
+    }
+    return false;
+}
+
+namespace
+{
+struct ChunkingParams
+{
+    using DataCallback = std::function<std::size_t(char *, std::size_t)>;
+
+    explicit ChunkingParams(DataCallback cb) : dataCallback(std::move(cb))
+    {
+    }
+
+    DataCallback dataCallback;
+    bool bFinished{false};
+#ifndef NDEBUG  // defined by CMake for release build
+    std::size_t nDataReturned{0};
+#endif
+};
+
+std::size_t chunkingCallback(
+    const std::shared_ptr<ChunkingParams> &cbParams,
+    char *pBuffer,
+    std::size_t nSize)
+{
+    if (!cbParams)
+        return 0;
+    // Cleanup
+    if (pBuffer == nullptr)
+    {
+        LOG_TRACE << "Chunking callback cleanup";
+        if (cbParams && cbParams->dataCallback)
+        {
+            cbParams->dataCallback(pBuffer, nSize);
+            cbParams->dataCallback = {};
+        }
+        return 0;
+    }
+    // Terminal chunk already returned
+    if (cbParams->bFinished)
+    {
+        LOG_TRACE << "Chunking callback has no more data";
+#ifndef NDEBUG  // defined by CMake for release build
+        LOG_TRACE << "Chunking callback: total data returned: "
+                  << cbParams->nDataReturned << " bytes";
+#endif
+        return 0;
+    }
+
+    // Reserve size to prepend the chunk size & append cr/lf, and get data
+    struct
+    {
+        std::size_t operator()(std::size_t n)
+        {
+            return n == 0 ? 0 : 1 + (*this)(n >> 4);
+        }
+    } neededDigits;
+
+    auto nHeaderSize = neededDigits(nSize) + 2;
+    auto nDataSize =
+        cbParams->dataCallback(pBuffer + nHeaderSize, nSize - nHeaderSize - 2);
+    if (nDataSize == 0)
+    {
+        // Terminal chunk + cr/lf
+        cbParams->bFinished = true;
+#ifdef _WIN32
+        memcpy_s(pBuffer, nSize, "0\r\n\r\n", 5);
+#else
+        memcpy(pBuffer, "0\r\n\r\n", 5);
+#endif
+        LOG_TRACE << "Chunking callback: no more data, return last chunk of "
+                     "size 0 & end of message";
+        return 5;
+    }
+    // Non-terminal chunks
+    pBuffer[nHeaderSize + nDataSize] = '\r';
+    pBuffer[nHeaderSize + nDataSize + 1] = '\n';
+    // The spec does not say if the chunk size is allowed tohave leading zeroes
+    // Use a fixed size header with leading zeroes
+    // (tested to work with Chrome, Firefox, Safari, Edge, wget, curl and VLC)
+#ifdef _WIN32
+    char pszFormat[]{"%04llx\r"};
+#else
+    char pszFormat[]{"%04lx\r"};
+#endif
+    pszFormat[2] = '0' + char(nHeaderSize - 2);
+    snprintf(pBuffer, nHeaderSize, pszFormat, nDataSize);
+    pBuffer[nHeaderSize - 1] = '\n';
+    LOG_TRACE << "Chunking callback: return chunk of size " << nDataSize;
+#ifndef NDEBUG  // defined by CMake for release build
+    cbParams->nDataReturned += nDataSize;
+#endif
+    return nHeaderSize + nDataSize + 2;
+    // Alternative code if there are client software that do not support chunk
+    // size with leading zeroes
+    //    auto nHeaderLen =
+    // #ifdef _WIN32
+    //    sprintf_s(pBuffer,
+    //    nHeaderSize, "%llx\r",
+    //    nDataSize);
+    // #else
+    //    sprintf(pBuffer, "%lx\r",
+    //    nDataSize);
+    // #endif
+    //    pBuffer[nHeaderLen++] = '\n';
+    //    if (nHeaderLen < nHeaderSize)  // smaller that what was reserved ->
+    //    move data
+    // #ifdef _WIN32
+    //    memmove_s(pBuffer +
+    //    nHeaderLen,
+    //              nSize - nHeaderLen,
+    //              pBuffer +
+    //              nHeaderSize,
+    //              nDataSize + 2);
+    // #else
+    //    memmove(pBuffer + nHeaderLen,
+    //            pBuffer + nHeaderSize,
+    //            nDataSize + 2);
+    // #endif
+    //    return nHeaderLen + nDataSize + 2;
+}
+}  // namespace
+
+std::function<std::size_t(char *, std::size_t)> chunkedStreamCallback(
+    std::function<std::size_t(char *, std::size_t)> dataCallback)
+{
+    return [ctx = std::make_shared<ChunkingParams>(std::move(dataCallback))](
+               char *buffer, size_t len) {
+        return chunkingCallback(ctx, buffer, len);
+    };
+}
 }  // namespace drogon
@@ -16,6 +16,7 @@
 
 #include <trantor/utils/MsgBuffer.h>
 #include <drogon/HttpTypes.h>
+#include <functional>
 #include <string>
 #include <string_view>
 
@@ -43,6 +44,24 @@ inline std::string_view getFileExtension(const std::string &fileName)
 
 const std::vector<std::string_view> &getFileExtensions(ContentType contentType);
 
+/**
+ * @brief Return the weak entity tag of a body, e.g. W/"2f6a9c7e04b1d835".
+ *
+ * The tag is a 64-bit hash of the body, it is the same across processes and
+ * doesn't depend on the content encoding applied later.
+ */
+std::string bodyETag(std::string_view body);
+
+/// Check if the If-None-Match header matches an entity tag, using the weak
+/// comparison of RFC 9110 section 13.1.2.
+bool etagMatches(std::string_view ifNoneMatch, std::string_view etag);
+
+/// Wrap the callback of a stream body (see HttpResponse::newStreamResponse())
+/// to send its data as the chunks of the chunked transfer encoding, ended by
+/// the last chunk when the callback returns 0.
+std::function<std::size_t(char *, std::size_t)> chunkedStreamCallback(
+    std::function<std::size_t(char *, std::size_t)> dataCallback);
+
 inline const std::vector<std::string_view> &getFileExtensions(
     const std::string_view &contentType)
 {
@@ -13,35 +13,58 @@
  */
 
 #include <drogon/HttpViewData.h>
+#include "CharScan.h"
 
 using namespace drogon;
 
 std::string HttpViewData::htmlTranslate(const char *str, size_t length)
 {
     std::string ret;
-    ret.reserve(length + 64);
     auto end = str + length;
-    while (str != end)
+    auto special = drogon::internal::findHtmlSpecial(str, end);
+    if (special == end)
     {
-        switch (*str)
+        ret.assign(str, length);
+        return ret;
+    }
+    ret.reserve(length + 64);
+    appendHtmlTranslation(ret, std::string_view(str, length));
+    return ret;
+}
+
+void HttpViewData::appendHtmlTranslation(std::string &output,
+                                         const std::string_view &str)
+{
+    auto begin = str.data();
+    auto end = str.data() + str.length();
+    for (;;)
+    {
+        // Copy the runs without special characters at once.
+        auto special = drogon::internal::findHtmlSpecial(begin, end);
+        output.append(begin, special);
+        if (special == end)
+            return;
+        switch (*special)
         {
             case '"':
-                ret.append("&quot;", 6);
+                output.append("&quot;", 6);
                 break;
             case '&':
-                ret.append("&amp;", 5);
+                output.append("&amp;", 5);
                 break;
             case '<':
-                ret.append("&lt;", 4);
-                break;
-            case '>':
-                ret.append("&gt;", 4);
+                output.append("&lt;", 4);
                 break;
             default:
-                ret.push_back(*str);
+                output.append("&gt;", 4);
                 break;
         }
-        ++str;
+        begin = special + 1;
     }
-    return ret;
+}
+
+bool HttpViewData::needTranslation(const std::string_view &str)
+{
+    auto end = str.data() + str.length();
+    return drogon::internal::findHtmlSpecial(str.data(), end) != end;
 }
@@ -0,0 +1,75 @@
+/**
+ *
+ *  @file JsonEngine.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/JsonEngine.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/utils/JsonWriter.h>
+#include <json/reader.h>
+#include <mutex>
+
+using namespace drogon;
+
+namespace
+{
+class DefaultJsonEngine : public JsonEngine
+{
+  public:
+    bool parse(std::string_view text,
+               Json::Value &value,
+               std::string &errors) override
+    {
+        init();
+        std::unique_ptr<Json::CharReader> reader(builder_.newCharReader());
+        JSONCPP_STRING errs;
+        if (!reader->parse(text.data(),
+                           text.data() + text.length(),
+                           &value,
+                           &errs))
+        {
+            errors = std::move(errs);
+            return false;
+        }
+        return true;
+    }
+
+    void serialize(const Json::Value &value, std::string &output) override
+    {
+        init();
+        JsonWriter writer(output, writerOptions_);
+        writer.value(value);
+    }
+
+  private:
+    void init()
+    {
+        // The options of the application are read on the first use, after
+        // the configuration is loaded.
+        std::call_once(once_, [this]() {
+            builder_["collectComments"] = false;
+            builder_["stackLimit"] =
+                static_cast<Json::UInt>(app().getJsonParserStackLimit());
+            writerOptions_ = JsonWriter::appOptions();
+        });
+    }
+
+    std::once_flag once_;
+    Json::CharReaderBuilder builder_;
+    JsonWriter::Options writerOptions_;
+};
+}  // namespace
+
+std::shared_ptr<JsonEngine> JsonEngine::newDefaultEngine()
+{
+    return std::make_shared<DefaultJsonEngine>();
+}
@@ -0,0 +1,499 @@
+/**
+ *
+ *  @file JsonReader.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/utils/JsonReader.h>
+#include <drogon/HttpAppFramework.h>
+#include "CharScan.h"
+#include <cmath>
+#include <cstdint>
+#include <locale>
+#include <sstream>
+
+using namespace drogon;
+
+size_t JsonReader::appStackLimit()
+{
+    return app().getJsonParserStackLimit();
+}
+
+bool JsonReader::fail(std::string_view message)
+{
+    if (error_.empty())
+    {
+        error_.assign(message.data(), message.length());
+        error_.append(" at offset ").append(std::to_string(pos_));
+    }
+    return false;
+}
+
+JsonReader::Token JsonReader::peek()
+{
+    if (!good())
+        return Token::kInvalid;
+    skipWhitespace();
+    if (pos_ >= text_.length())
+        return Token::kInvalid;
+    switch (text_[pos_])
+    {
+        case 'n':
+            return Token::kNull;
+        case 't':
+        case 'f':
+            return Token::kBool;
+        case '"':
+            return Token::kString;
+        case '[':
+            return Token::kArray;
+        case '{':
+            return Token::kObject;
+        case '-':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+            return Token::kNumber;
+        default:
+            return Token::kInvalid;
+    }
+}
+
+bool JsonReader::readLiteral(std::string_view literal)
+{
+    if (text_.substr(pos_, literal.length()) != literal)
+        return fail("invalid literal");
+    pos_ += literal.length();
+    return true;
+}
+
+bool JsonReader::readNull()
+{
+    if (peek() != Token::kNull)
+        return fail("expected null");
+    return readLiteral("null");
+}
+
+bool JsonReader::readBool(bool &value)
+{
+    if (peek() != Token::kBool)
+        return fail("expected a boolean");
+    value = text_[pos_] == 't';
+    return readLiteral(value ? "true" : "false");
+}
+
+bool JsonReader::readNumber(std::string_view &number, bool &isInteger)
+{
+    if (peek() != Token::kNumber)
+        return fail("expected a number");
+    auto isDigit = [this](size_t pos) {
+        return pos < text_.length() && text_[pos] >= '0' && text_[pos] <= '9';
+    };
+    size_t pos = pos_;
+    if (text_[pos] == '-')
+        ++pos;
+    if (!isDigit(pos))
+        return fail("invalid number");
+    if (text_[pos] == '0')
+        ++pos;
+    else
+    {
+        while (isDigit(pos))
+            ++pos;
+    }
+    isInteger = true;
+    if (pos < text_.length() && text_[pos] == '.')
+    {
+        isInteger = false;
+        if (!isDigit(++pos))
+            return fail("invalid number");
+        while (isDigit(pos))
+            ++pos;
+    }
+    if (pos < text_.length() && (text_[pos] == 'e' || text_[pos] == 'E'))
+    {
+        isInteger = false;
+        ++pos;
+        if (pos < text_.length() && (text_[pos] == '+' || text_[pos] == '-'))
+            ++pos;
+        if (!isDigit(pos))
+            return fail("invalid number");
+        while (isDigit(pos))
+            ++pos;
+    }
+    number = text_.substr(pos_, pos - pos_);
+    pos_ = pos;
+    return true;
+}
+
+bool JsonReader::readDouble(double &value)
+{
+    std::string_view number;
+    bool isInteger;
+    if (!readNumber(number, isInteger))
+        return false;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto result =
+        std::from_chars(number.data(), number.data() + number.length(), value);
+    if (result.ec == std::errc::result_out_of_range)
+    {
+        // Like jsoncpp, the numbers too large become the infinities.
+        value = number[0] == '-' ? -HUGE_VAL : HUGE_VAL;
+        return true;
+    }
+    if (result.ec != std::errc())
+        return fail("invalid number");
+#else
+    std::istringstream stream{std::string(number)};
+    stream.imbue(std::locale::classic());
+    stream >> value;
+    if (stream.fail())
+        return fail("invalid number");
+#endif
+    return true;
+}
+
+static void appendUtf8(std::string &output, uint32_t codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        output.push_back(static_cast<char>(codePoint));
+    }
+    else if (codePoint < 0x800)
+    {
+        output.push_back(static_cast<char>(0xc0 | (codePoint >> 6)));
+        output.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+    }
+    else if (codePoint < 0x10000)
+    {
+        output.push_back(static_cast<char>(0xe0 | (codePoint >> 12)));
+        output.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+        output.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+    }
+    else
+    {
+        output.push_back(static_cast<char>(0xf0 | (codePoint >> 18)));
+        output.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f)));
+        output.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+        output.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+    }
+}
+
+bool JsonReader::readString(std::string &value)
+{
+    if (peek() != Token::kString)
+        return fail("expected a string");
+    value.clear();
+    const char *begin = text_.data();
+    const char *end = text_.data() + text_.length();
+    ++pos_;
+    for (;;)
+    {
+        // Copy the runs without escapes at once.
+        const char *stop =
+            drogon::internal::findEither(begin + pos_, end, '"', '\\');
+        value.append(begin + pos_, stop);
+        pos_ = stop - begin;
+        if (stop == end)
+            return fail("missing '\"'");
+        ++pos_;
+        if (*stop == '"')
+            return true;
+        if (pos_ >= text_.length())
+            return fail("invalid escape");
+        char c = text_[pos_++];
+        switch (c)
+        {
+            case '"':
+            case '\\':
+            case '/':
+                value.push_back(c);
+                break;
+            case 'b':
+                value.push_back('\b');
+                break;
+            case 'f':
+                value.push_back('\f');
+                break;
+            case 'n':
+                value.push_back('\n');
+                break;
+            case 'r':
+                value.push_back('\r');
+                break;
+            case 't':
+                value.push_back('\t');
+                break;
+            case 'u':
+            {
+                auto readHex = [this](uint32_t &unit) {
+                    if (pos_ + 4 > text_.length())
+                        return false;
+                    auto result = std::from_chars(text_.data() + pos_,
+                                                  text_.data() + pos_ + 4,
+                                                  unit,
+                                                  16);
+                    if (result.ptr != text_.data() + pos_ + 4)
+                        return false;
+                    pos_ += 4;
+                    return true;
+                };
+                uint32_t codePoint;
+                if (!readHex(codePoint))
+                    return fail("invalid unicode escape");
+                if (codePoint >= 0xd800 && codePoint <= 0xdbff)
+                {
+                    // A surrogate pair
+                    uint32_t low;
+                    if (text_.substr(pos_, 2) != "\\u")
+                        return fail("missing the low surrogate");
+                    pos_ += 2;
+                    if (!readHex(low) || low < 0xdc00 || low > 0xdfff)
+                        return fail("invalid low surrogate");
+                    codePoint =
+                        0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                }
+                appendUtf8(value, codePoint);
+                break;
+            }
+            default:
+                return fail("invalid escape");
+        }
+    }
+}
+
+bool JsonReader::startObject()
+{
+    if (peek() != Token::kObject)
+        return fail("expected an object");
+    if (++depth_ > stackLimit_)
+        return fail("exceeded the stack limit");
+    ++pos_;
+    first_ = true;
+    return true;
+}
+
+bool JsonReader::closeContainer(char close)
+{
+    skipWhitespace();
+    if (pos_ < text_.length() && text_[pos_] == close)
+    {
+        ++pos_;
+        --depth_;
+        // The enclosing container has at least this element.
+        first_ = false;
+        return true;
+    }
+    return false;
+}
+
+bool JsonReader::nextMember(std::string &key)
+{
+    if (!good() || closeContainer('}'))
+        return false;
+    if (pos_ >= text_.length())
+        return fail("missing '}'");
+    if (!first_)
+    {
+        if (text_[pos_] != ',')
+            return fail("expected ',' or '}'");
+        ++pos_;
+    }
+    first_ = false;
+    if (!readString(key))
+        return false;
+    skipWhitespace();
+    if (pos_ >= text_.length() || text_[pos_] != ':')
+        return fail("expected ':'");
+    ++pos_;
+    return true;
+}
+
+bool JsonReader::startArray()
+{
+    if (peek() != Token::kArray)
+        return fail("expected an array");
+    if (++depth_ > stackLimit_)
+        return fail("exceeded the stack limit");
+    ++pos_;
+    first_ = true;
+    return true;
+}
+
+bool JsonReader::nextElement()
+{
+    if (!good() || closeContainer(']'))
+        return false;
+    if (pos_ >= text_.length())
+        return fail("missing ']'");
+    if (!first_)
+    {
+        if (text_[pos_] != ',')
+            return fail("expected ',' or ']'");
+        ++pos_;
+    }
+    first_ = false;
+    return true;
+}
+
+bool JsonReader::readValue(Json::Value &value)
+{
+    switch (peek())
+    {
+        case Token::kNull:
+            value = Json::Value();
+            return readNull();
+        case Token::kBool:
+        {
+            bool b;
+            if (!readBool(b))
+                return false;
+            value = b;
+            return true;
+        }
+        case Token::kNumber:
+        {
+            // The types chosen by jsoncpp, the integers which don't fit in
+            // 64 bits become doubles.
+            std::string_view number;
+            bool isInteger;
+            size_t start = pos_;
+            if (!readNumber(number, isInteger))
+                return false;
+            const char *numberEnd = number.data() + number.length();
+            if (isInteger)
+            {
+                Json::Int64 i;
+                auto result = std::from_chars(number.data(), numberEnd, i);
+                if (result.ec == std::errc() && result.ptr == numberEnd)
+                {
+                    value = i;
+                    return true;
+                }
+                Json::UInt64 u;
+                result = std::from_chars(number.data(), numberEnd, u);
+                if (result.ec == std::errc() && result.ptr == numberEnd)
+                {
+                    value = u;
+                    return true;
+                }
+            }
+            pos_ = start;
+            double d;
+            if (!readDouble(d))
+                return false;
+            value = d;
+            return true;
+        }
+        case Token::kString:
+        {
+            std::string str;
+            if (!readString(str))
+                return false;
+            value = std::move(str);
+            return true;
+        }
+        case Token::kArray:
+        {
+            value = Json::Value(Json::arrayValue);
+            if (!startArray())
+                return false;
+            while (nextElement())
+            {
+                if (!readValue(value.append(Json::Value())))
+                    return false;
+            }
+            return good();
+        }
+        case Token::kObject:
+        {
+            value = Json::Value(Json::objectValue);
+            if (!startObject())
+                return false;
+            std::string key;
+            while (nextMember(key))
+            {
+                if (!readValue(value[key]))
+                    return false;
+            }
+            return good();
+        }
+        default:
+            return fail("expected a value");
+    }
+}
+
+bool JsonReader::skipValue()
+{
+    switch (peek())
+    {
+        case Token::kNull:
+            return readNull();
+        case Token::kBool:
+        {
+            bool b;
+            return readBool(b);
+        }
+        case Token::kNumber:
+        {
+            std::string_view number;
+            bool isInteger;
+            return readNumber(number, isInteger);
+        }
+        case Token::kString:
+        {
+            std::string str;
+            return readString(str);
+        }
+        case Token::kArray:
+        {
+            if (!startArray())
+                return false;
+            while (nextElement())
+            {
+                if (!skipValue())
+                    return false;
+            }
+            return good();
+        }
+        case Token::kObject:
+        {
+            if (!startObject())
+                return false;
+            std::string key;
+            while (nextMember(key))
+            {
+                if (!skipValue())
+                    return false;
+            }
+            return good();
+        }
+        default:
+            return fail("expected a value");
+    }
+}
+
+bool JsonReader::finish()
+{
+    if (!good())
+        return false;
+    skipWhitespace();
+    if (pos_ != text_.length())
+        return fail("unexpected characters after the document");
+    return true;
+}
@@ -0,0 +1,204 @@
+/**
+ *
+ *  @file JsonWriter.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/utils/JsonWriter.h>
+#include <drogon/HttpAppFramework.h>
+#include <json/version.h>
+#include <json/writer.h>
+#include <cmath>
+#include <stdio.h>
+
+using namespace drogon;
+
+JsonWriter::Options JsonWriter::appOptions()
+{
+    Options options;
+    options.escapeUnicode = app().isUnicodeEscapingUsedInJson();
+    auto &precision = app().getFloatPrecisionInJson();
+    options.precision = precision.first;
+    options.decimalPrecision = precision.second == "decimal";
+    return options;
+}
+
+void JsonWriter::value(double number)
+{
+    separate();
+    // The formatting of jsoncpp, with ".0" appended to the integers and the
+    // same output for the infinities and NaN.
+#if JSONCPP_VERSION_HEXA >= 0x01090000
+    if (options_.precision != 0)
+    {
+        auto type = options_.decimalPrecision
+                        ? Json::PrecisionType::decimalPlaces
+                        : Json::PrecisionType::significantDigits;
+        output_.append(Json::valueToString(number, options_.precision, type));
+        needComma_ = true;
+        return;
+    }
+#endif
+    if (!std::isfinite(number))
+    {
+        output_.append(Json::valueToString(number));
+        needComma_ = true;
+        return;
+    }
+    // What Json::valueToString() does, without its temporary strings.
+    char buffer[32];
+#ifdef __cpp_lib_to_chars
+    auto result = std::to_chars(buffer,
+                                buffer + sizeof(buffer),
+                                number,
+                                std::chars_format::general,
+                                17);
+    int length = static_cast<int>(result.ptr - buffer);
+#else
+    int length = snprintf(buffer, sizeof(buffer), "%.17g", number);
+#endif
+    bool isInteger = true;
+    for (int i = 0; i < length; ++i)
+    {
+        if (buffer[i] == ',')
+            buffer[i] = '.';  // The separator of some locales
+        if (buffer[i] == '.' || buffer[i] == 'e')
+            isInteger = false;
+    }
+    output_.append(buffer, length);
+    if (isInteger)
+        output_.append(".0", 2);
+    needComma_ = true;
+}
+
+void JsonWriter::writeString(std::string_view str)
+{
+    static constexpr char hexDigits[] = "0123456789abcdef";
+    output_.reserve(output_.size() + str.length() + 2);
+    output_.push_back('"');
+    const char *run = str.data();
+    const char *end = str.data() + str.length();
+    for (const char *p = run; p < end; ++p)
+    {
+        auto c = static_cast<unsigned char>(*p);
+        if (c >= 0x80 && options_.escapeUnicode)
+        {
+            // Let jsoncpp escape the code points, this is rarely needed by
+            // the documents of the APIs.
+            output_.append(run, p);
+            std::string rest(p, end);
+            if (rest.find('\0') == std::string::npos)
+            {
+                auto quoted = Json::valueToQuotedString(rest.c_str());
+                output_.append(quoted, 1, quoted.length() - 1);
+            }
+            else
+            {
+                Json::StreamWriterBuilder builder;
+                builder["indentation"] = "";
+                auto quoted = Json::writeString(builder, Json::Value(rest));
+                output_.append(quoted, 1, quoted.length() - 1);
+            }
+            return;
+        }
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        output_.append(run, p);
+        run = p + 1;
+        switch (c)
+        {
+            case '"':
+                output_.append("\\\"", 2);
+                break;
+            case '\\':
+                output_.append("\\\\", 2);
+                break;
+            case '\b':
+                output_.append("\\b", 2);
+                break;
+            case '\f':
+                output_.append("\\f", 2);
+                break;
+            case '\n':
+                output_.append("\\n", 2);
+                break;
+            case '\r':
+                output_.append("\\r", 2);
+                break;
+            case '\t':
+                output_.append("\\t", 2);
+                break;
+            default:
+            {
+                char escaped[6] = {
+                    '\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 0xf]};
+                output_.append(escaped, 6);
+                break;
+            }
+        }
+    }
+    output_.append(run, end);
+    output_.push_back('"');
+}
+
+void JsonWriter::value(const Json::Value &json)
+{
+    switch (json.type())
+    {
+        case Json::nullValue:
+            null();
+            break;
+        case Json::intValue:
+            value(json.asLargestInt());
+            break;
+        case Json::uintValue:
+            value(json.asLargestUInt());
+            break;
+        case Json::realValue:
+            value(json.asDouble());
+            break;
+        case Json::stringValue:
+        {
+            const char *begin;
+            const char *end;
+            if (json.getString(&begin, &end))
+                value(std::string_view(begin, end - begin));
+            else
+                value(std::string_view());
+            break;
+        }
+        case Json::booleanValue:
+            value(json.asBool());
+            break;
+        case Json::arrayValue:
+        {
+            startArray();
+            for (Json::ArrayIndex i = 0; i < json.size(); ++i)
+                value(json[i]);
+            endArray();
+            break;
+        }
+        case Json::objectValue:
+        {
+            startObject();
+            // The members are sorted by name like in the jsoncpp writers.
+            for (auto iter = json.begin(); iter != json.end(); ++iter)
+            {
+                const char *nameEnd;
+                const char *name = iter.memberName(&nameEnd);
+                key(std::string_view(name, nameEnd - name));
+                value(*iter);
+            }
+            endObject();
+            break;
+        }
+    }
+}
@@ -16,12 +16,22 @@
 #include <drogon/config.h>
 #include <fcntl.h>
 #include <trantor/utils/Logger.h>
+#include <future>
+#include "ConnectionBalancer.h"
 #include "HttpAppFrameworkImpl.h"
 #include "HttpServer.h"
 #ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <unistd.h>
 #endif
+#include <atomic>
+#include <cerrno>
+#include <cstring>
 
 namespace drogon
 {
@@ -65,6 +75,153 @@ void ListenerManager::addListener(
         ip, port, useSSL, certFile, keyFile, useOldTLS, sslConfCmds);
 }
 
+void ListenerManager::addUnixListener(const std::string &path, int mode)
+{
+#ifdef _WIN32
+    (void)mode;
+    LOG_ERROR << "Unix domain socket listeners aren't supported on Windows, "
+              << path << " isn't listened";
+#else
+    unixListeners_.push_back({path, mode});
+#endif
+}
+
+#ifndef _WIN32
+// The acceptors of trantor only bind IP addresses, so the IP socket of a unix
+// listener is replaced by a unix socket bound to the path before it listens.
+static void replaceWithUnixSocket(int fd, const std::string &path, int mode)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    {
+        LOG_FATAL << "Invalid unix socket path '" << path << "'";
+        abort();
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.data(), path.size());
+    int unixFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (unixFd < 0)
+    {
+        LOG_SYSERR << "Failed to create the unix socket " << path;
+        abort();
+    }
+    // The file left by a previous run which wasn't stopped would make the
+    // bind fail, other files are never removed.
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        ::unlink(path.c_str());
+    if (::bind(unixFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) !=
+        0)
+    {
+        LOG_FATAL << "Failed to bind the unix socket " << path << ": "
+                  << strerror(errno);
+        abort();
+    }
+    if (chmod(path.c_str(), static_cast<mode_t>(mode)) != 0)
+    {
+        LOG_SYSERR << "Failed to set the mode of the unix socket " << path;
+    }
+    // The acceptor watches the descriptor of its own socket, which now refers
+    // to the unix socket. The flags of the descriptor aren't duplicated.
+    if (::dup2(unixFd, fd) < 0)
+    {
+        LOG_SYSERR << "Failed to replace the socket of " << path;
+        abort();
+    }
+    ::close(unixFd);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+#endif
+
+void ListenerManager::createUnixListeners(
+    const std::vector<trantor::EventLoop *> &ioLoops)
+{
+#ifndef _WIN32
+    // A unix socket can't be shared by the loops with SO_REUSEPORT, the
+    // connections are accepted by one thread and handed to the loops.
+    for (auto const &listener : unixListeners_)
+    {
+        if (!listeningThread_)
+        {
+            listeningThread_ =
+                std::make_unique<EventLoopThread>("DrogonListeningLoop");
+            listeningThread_->run();
+        }
+        auto serverPtr =
+            std::make_shared<HttpServer>(listeningThread_->getLoop(),
+                                         InetAddress("127.0.0.1", 0),
+                                         "drogon");
+        serverPtr->setBeforeListenSockOptCallback(
+            [path = listener.path_,
+             mode = listener.mode_,
+             cb = beforeListenSetSockOptCallback_](int fd) {
+                replaceWithUnixSocket(fd, path, mode);
+                if (cb)
+                    cb(fd);
+            });
+        // The TCP options of the low latency listeners don't apply.
+        if (afterAcceptSetSockOptCallback_)
+        {
+            serverPtr->setAfterAcceptSockOptCallback(
+                afterAcceptSetSockOptCallback_);
+        }
+        if (connectionCallback_)
+        {
+            serverPtr->setConnectionCallback(connectionCallback_);
+        }
+        serverPtr->setIoLoops(ioLoops);
+        unixServers_.push_back(serverPtr);
+    }
+#else
+    (void)ioLoops;
+#endif
+}
+
+// See HttpAppFramework::enableLowLatency().
+static void setLowLatencyOptions(int fd, size_t busyPollMicroseconds)
+{
+#ifndef _WIN32
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+#ifdef TCP_QUICKACK
+    setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+#endif
+#ifdef SO_BUSY_POLL
+    if (busyPollMicroseconds > 0)
+    {
+        int usecs = static_cast<int>(busyPollMicroseconds);
+        if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) !=
+            0)
+        {
+            static std::atomic_bool warned{false};
+            if (!warned.exchange(true))
+                LOG_WARN << "Failed to set SO_BUSY_POLL, it may require "
+                            "CAP_NET_ADMIN";
+        }
+    }
+#endif
+#else
+    (void)fd;
+    (void)busyPollMicroseconds;
+#endif
+}
+
+std::function<void(int)> ListenerManager::afterAcceptCallback(
+    const ListenerInfo &listener) const
+{
+    auto iter = lowLatencyPorts_.find(listener.port_);
+    if (iter == lowLatencyPorts_.end())
+        return afterAcceptSetSockOptCallback_;
+    return [busyPoll = iter->second,
+            cb = afterAcceptSetSockOptCallback_](int fd) {
+        setLowLatencyOptions(fd, busyPoll);
+        if (cb)
+            cb(fd);
+    };
+}
+
 std::vector<trantor::InetAddress> ListenerManager::getListeners() const
 {
     std::vector<trantor::InetAddress> listeners;
@@ -82,21 +239,61 @@ void ListenerManager::createListeners(
     const std::vector<trantor::EventLoop *> &ioLoops)
 {
     LOG_TRACE << "thread num=" << ioLoops.size();
+    auto &balancer = ConnectionBalancer::instance();
+    balancer.init(app().getConnectionBalancing(), ioLoops);
 #ifdef __linux__
+    // The https listeners sharing their TLS sessions accept the connections
+    // of all the loops on one socket.
+    auto sharesTlsSessions = [](const ListenerInfo &listener) {
+        return listener.useSSL_ && utils::supportsTls() &&
+               app().isTlsSessionSharingEnabled();
+    };
+    auto parseAddress = [](const ListenerInfo &listener) {
+        auto const &ip = listener.ip_;
+        bool isIpv6 = (ip.find(':') != std::string::npos);
+        InetAddress listenAddress(ip, listener.port_, isIpv6);
+        if (listenAddress.isUnspecified())
+        {
+            LOG_FATAL << "Failed to parse IP address '" << ip
+                      << "'. (Note: FQDN/domain names/hostnames are not "
+                         "supported. Including 'localhost')";
+            abort();
+        }
+        return listenAddress;
+    };
+    auto tlsPolicy = [&globalCertFile, &globalKeyFile, &sslConfCmds](
+                         const ListenerInfo &listener) {
+        auto cert = listener.certFile_;
+        auto key = listener.keyFile_;
+        if (cert.empty())
+            cert = globalCertFile;
+        if (key.empty())
+            key = globalKeyFile;
+        if (cert.empty() || key.empty())
+        {
+            std::cerr << "You can't use https without cert file or key file"
+                      << std::endl;
+            exit(1);
+        }
+        auto cmds = sslConfCmds;
+        std::copy(listener.sslConfCmds_.begin(),
+                  listener.sslConfCmds_.end(),
+                  std::back_inserter(cmds));
+        auto policy = trantor::TLSPolicy::defaultServerPolicy(cert, key);
+        policy->setConfCmds(cmds).setUseOldTLS(listener.useOldTLS_);
+        if (HttpAppFrameworkImpl::instance().isHttp2Enabled())
+        {
+            policy->setAlpnProtocols({"h2", "http/1.1"});
+        }
+        return policy;
+    };
     for (size_t i = 0; i < ioLoops.size(); ++i)
     {
         for (auto const &listener : listeners_)
         {
-            auto const &ip = listener.ip_;
-            bool isIpv6 = (ip.find(':') != std::string::npos);
-            InetAddress listenAddress(ip, listener.port_, isIpv6);
-            if (listenAddress.isUnspecified())
-            {
-                LOG_FATAL << "Failed to parse IP address '" << ip
-                          << "'. (Note: FQDN/domain names/hostnames are not "
-                             "supported. Including 'localhost')";
-                abort();
-            }
+            if (sharesTlsSessions(listener))
+                continue;
+            auto listenAddress = parseAddress(listener);
             if (i == 0 && !app().reusePort())
             {
                 DrogonFileLocker lock;
@@ -111,15 +308,26 @@ void ListenerManager::createListeners(
                 std::make_shared<HttpServer>(ioLoops[i],
                                              listenAddress,
                                              "drogon");
-            if (beforeListenSetSockOptCallback_)
+            if (i == 0 && balancer.enabled())
+            {
+                // The program of the balancer is attached to the reuseport
+                // group through the socket of the first loop.
+                serverPtr->setBeforeListenSockOptCallback(
+                    [cb = beforeListenSetSockOptCallback_](int fd) {
+                        ConnectionBalancer::instance().addListenSocket(fd);
+                        if (cb)
+                            cb(fd);
+                    });
+            }
+            else if (beforeListenSetSockOptCallback_)
             {
                 serverPtr->setBeforeListenSockOptCallback(
                     beforeListenSetSockOptCallback_);
             }
-            if (afterAcceptSetSockOptCallback_)
+            if (auto afterAccept = afterAcceptCallback(listener))
             {
                 serverPtr->setAfterAcceptSockOptCallback(
-                    afterAcceptSetSockOptCallback_);
+                    std::move(afterAccept));
             }
             if (connectionCallback_)
             {
@@ -128,31 +336,43 @@ void ListenerManager::createListeners(
 
             if (listener.useSSL_ && utils::supportsTls())
             {
-                auto cert = listener.certFile_;
-                auto key = listener.keyFile_;
-                if (cert.empty())
-                    cert = globalCertFile;
-                if (key.empty())
-                    key = globalKeyFile;
-                if (cert.empty() || key.empty())
-                {
-                    std::cerr
-                        << "You can't use https without cert file or key file"
-                        << std::endl;
-                    exit(1);
-                }
-                auto cmds = sslConfCmds;
-                std::copy(listener.sslConfCmds_.begin(),
-                          listener.sslConfCmds_.end(),
-                          std::back_inserter(cmds));
-                auto policy =
-                    trantor::TLSPolicy::defaultServerPolicy(cert, key);
-                policy->setConfCmds(cmds).setUseOldTLS(listener.useOldTLS_);
-                serverPtr->enableSSL(std::move(policy));
+                serverPtr->enableSSL(tlsPolicy(listener));
             }
             servers_.push_back(serverPtr);
         }
     }
+    for (auto const &listener : listeners_)
+    {
+        if (!sharesTlsSessions(listener))
+            continue;
+        if (!listeningThread_)
+        {
+            listeningThread_ =
+                std::make_unique<EventLoopThread>("DrogonListeningLoop");
+            listeningThread_->run();
+        }
+        auto serverPtr =
+            std::make_shared<HttpServer>(listeningThread_->getLoop(),
+                                         parseAddress(listener),
+                                         "drogon");
+        if (beforeListenSetSockOptCallback_)
+        {
+            serverPtr->setBeforeListenSockOptCallback(
+                beforeListenSetSockOptCallback_);
+        }
+        if (auto afterAccept = afterAcceptCallback(listener))
+        {
+            serverPtr->setAfterAcceptSockOptCallback(std::move(afterAccept));
+        }
+        if (connectionCallback_)
+        {
+            serverPtr->setConnectionCallback(connectionCallback_);
+        }
+        // One TLS context for all the loops.
+        serverPtr->enableSSL(tlsPolicy(listener));
+        serverPtr->setIoLoops(ioLoops);
+        servers_.push_back(serverPtr);
+    }
 #else
 
     if (!listeners_.empty())
@@ -187,29 +407,65 @@ void ListenerManager::createListeners(
                 auto policy =
                     trantor::TLSPolicy::defaultServerPolicy(cert, key);
                 policy->setConfCmds(cmds).setUseOldTLS(listener.useOldTLS_);
+                if (HttpAppFrameworkImpl::instance().isHttp2Enabled())
+                {
+                    policy->setAlpnProtocols({"h2", "http/1.1"});
+                }
                 serverPtr->enableSSL(std::move(policy));
             }
+            if (auto afterAccept = afterAcceptCallback(listener))
+            {
+                serverPtr->setAfterAcceptSockOptCallback(
+                    std::move(afterAccept));
+            }
             serverPtr->setIoLoops(ioLoops);
             servers_.push_back(serverPtr);
         }
     }
 #endif
+    createUnixListeners(ioLoops);
 }
 
 void ListenerManager::startListening()
 {
+    auto &balancer = ConnectionBalancer::instance();
     for (auto &server : servers_)
     {
         server->start();
+        if (balancer.enabled())
+        {
+            // The sockets join their reuseport groups when they listen, the
+            // balancer needs them in the order of the loops.
+            std::promise<void> listening;
+            server->getLoop()->queueInLoop(
+                [&listening]() { listening.set_value(); });
+            listening.get_future().wait();
+        }
     }
+    for (auto &server : unixServers_)
+    {
+        server->start();
+    }
+    balancer.start(HttpAppFrameworkImpl::instance().getLoop());
 }
 
 void ListenerManager::stopListening()
 {
+    ConnectionBalancer::instance().stop();
     for (auto &serverPtr : servers_)
     {
         serverPtr->stop();
     }
+    for (auto &serverPtr : unixServers_)
+    {
+        serverPtr->stop();
+    }
+#ifndef _WIN32
+    for (auto const &listener : unixListeners_)
+    {
+        ::unlink(listener.path_.c_str());
+    }
+#endif
     if (listeningThread_)
     {
         auto loop = listeningThread_->getLoop();
@@ -17,8 +17,10 @@
 #include <trantor/net/EventLoopThreadPool.h>
 #include <trantor/net/callbacks.h>
 #include <trantor/utils/NonCopyable.h>
+#include <functional>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include "impl_forwards.h"
@@ -42,6 +44,7 @@ class ListenerManager : public trantor::NonCopyable
                      bool useOldTLS = false,
                      const std::vector<std::pair<std::string, std::string>>
                          &sslConfCmds = {});
+    void addUnixListener(const std::string &path, int mode);
     std::vector<trantor::InetAddress> getListeners() const;
     void createListeners(
         const std::string &globalCertFile,
@@ -67,6 +70,11 @@ class ListenerManager : public trantor::NonCopyable
         connectionCallback_ = std::move(cb);
     }
 
+    void enableLowLatency(uint16_t port, size_t busyPollMicroseconds)
+    {
+        lowLatencyPorts_[port] = busyPollMicroseconds;
+    }
+
     void reloadSSLFiles();
 
   private:
@@ -99,15 +107,33 @@ class ListenerManager : public trantor::NonCopyable
         std::vector<std::pair<std::string, std::string>> sslConfCmds_;
     };
 
+    struct UnixListenerInfo
+    {
+        std::string path_;
+        int mode_;
+    };
+
+    // The after accept callback of the listener, nullptr if none
+    std::function<void(int)> afterAcceptCallback(
+        const ListenerInfo &listener) const;
+    void createUnixListeners(const std::vector<trantor::EventLoop *> &ioLoops);
+
     std::vector<ListenerInfo> listeners_;
+    std::vector<UnixListenerInfo> unixListeners_;
     std::vector<std::shared_ptr<HttpServer>> servers_;
+    // The servers of the unix listeners, not in servers_ because their
+    // addresses aren't the ones of the sockets.
+    std::vector<std::shared_ptr<HttpServer>> unixServers_;
 
     // should have value when and only when on OS that one port can only be
-    // listened by one thread
+    // listened by one thread, or for the https listeners sharing their TLS
+    // sessions and the unix listeners
     std::unique_ptr<trantor::EventLoopThread> listeningThread_;
     std::function<void(int)> beforeListenSetSockOptCallback_;
     std::function<void(int)> afterAcceptSetSockOptCallback_;
     std::function<void(const trantor::TcpConnectionPtr &)> connectionCallback_;
+    // The busy poll times of the low latency ports
+    std::unordered_map<uint16_t, size_t> lowLatencyPorts_;
 };
 
 }  // namespace drogon
@@ -0,0 +1,120 @@
+#include <drogon/plugins/LoopWatchdog.h>
+#include <drogon/plugins/PromExporter.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/utils/monitoring/Collector.h>
+#include <chrono>
+#include "BuiltinMetrics.h"
+
+using namespace drogon;
+using namespace drogon::monitoring;
+using namespace drogon::plugin;
+
+static int64_t steadyNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void LoopWatchdog::initAndStart(const Json::Value &config)
+{
+    interval_ = config.get("interval", interval_).asDouble();
+    stallThreshold_ = config.get("stall_threshold", stallThreshold_).asDouble();
+    BuiltinMetrics::instance().slowHandlerThreshold =
+        config.get("slow_handler_threshold", 0.1).asDouble();
+
+    std::shared_ptr<Collector<ExponentialHistogram>> delayCollector;
+    std::shared_ptr<Collector<Counter>> stallsCollector;
+    if (config.get("export_metrics", false).asBool())
+    {
+        auto exporter = app().getPlugin<PromExporter>();
+        if (!exporter)
+        {
+            throw std::runtime_error(
+                "LoopWatchdog: the PromExporter plugin must be a dependency "
+                "to export the metrics");
+        }
+        delayCollector = std::make_shared<Collector<ExponentialHistogram>>(
+            "drogon_event_loop_delay_seconds",
+            "The time the probes of the watchdog waited in the IO loops",
+            std::vector<std::string>{"loop"});
+        exporter->registerCollector(delayCollector);
+        stallsCollector = std::make_shared<Collector<Counter>>(
+            "drogon_event_loop_stalls_total",
+            "The number of times an IO loop was blocked",
+            std::vector<std::string>{"loop"});
+        exporter->registerCollector(stallsCollector);
+    }
+
+    for (size_t i = 0; i < app().getThreadNum(); ++i)
+    {
+        auto state = std::make_shared<LoopState>();
+        state->loop = app().getIOLoop(i);
+        state->index = i;
+        if (delayCollector)
+        {
+            state->delay =
+                delayCollector->metric({std::to_string(i)}, 3, 1e-6, 100.0);
+            state->stalls = stallsCollector->metric({std::to_string(i)});
+        }
+        loops_.emplace_back(std::move(state));
+    }
+
+    threadPtr_ = std::make_unique<trantor::EventLoopThread>("LoopWatchdog");
+    threadPtr_->run();
+    timerId_ =
+        threadPtr_->getLoop()->runEvery(interval_, [this]() { check(); });
+}
+
+void LoopWatchdog::shutdown()
+{
+    if (threadPtr_)
+    {
+        threadPtr_->getLoop()->invalidateTimer(timerId_);
+        threadPtr_.reset();
+    }
+    loops_.clear();
+}
+
+void LoopWatchdog::check()
+{
+    auto now = steadyNow();
+    for (auto &state : loops_)
+    {
+        auto probeTime = state->probeTime.load(std::memory_order_acquire);
+        if (probeTime != 0)
+        {
+            // The previous probe hasn't run yet.
+            double blocked = (double)(now - probeTime) / 1e9;
+            if (blocked > stallThreshold_ && !state->stallReported)
+            {
+                state->stallReported = true;
+                LOG_WARN << "IO loop " << state->index
+                         << " has been blocked for " << blocked * 1000
+                         << "ms";
+                if (state->stalls)
+                    state->stalls->increment();
+            }
+            continue;
+        }
+        state->stallReported = false;
+        state->probeTime.store(now, std::memory_order_release);
+        std::weak_ptr<LoopState> weakPtr = state;
+        state->loop->queueInLoop([weakPtr, threshold = stallThreshold_]() {
+            auto statePtr = weakPtr.lock();
+            if (!statePtr)
+                return;
+            auto probeTime =
+                statePtr->probeTime.load(std::memory_order_acquire);
+            double delay = (double)(steadyNow() - probeTime) / 1e9;
+            if (statePtr->delay)
+                statePtr->delay->observe(delay);
+            if (delay > threshold)
+            {
+                LOG_WARN << "A task waited " << delay * 1000
+                         << "ms in the queue of IO loop " << statePtr->index;
+            }
+            statePtr->probeTime.store(0, std::memory_order_release);
+        });
+    }
+}
@@ -0,0 +1,70 @@
+/**
+ *
+ *  MappedFile.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "MappedFile.h"
+#include <drogon/utils/Utilities.h>
+#include <trantor/utils/Logger.h>
+#include <stdio.h>
+#ifdef _WIN32
+#include <mman.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace drogon;
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string &path)
+{
+    auto nativePath = utils::toNativePath(path);
+    std::error_code err;
+    auto size = std::filesystem::file_size(nativePath, err);
+    if (err || size == 0)
+        return nullptr;
+    auto modifiedTime = std::filesystem::last_write_time(nativePath, err);
+    if (err)
+        return nullptr;
+    FILE *file{nullptr};
+#ifndef _MSC_VER
+    file = fopen(nativePath.c_str(), "rb");
+#else
+    if (_wfopen_s(&file, nativePath.c_str(), L"rb") != 0)
+    {
+        file = nullptr;
+    }
+#endif
+    if (!file)
+    {
+        LOG_SYSERR << "MappedFile fopen:";
+        return nullptr;
+    }
+#ifdef _WIN32
+    auto fd = _fileno(file);
+#else
+    auto fd = fileno(file);
+#endif
+    auto data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the file is closed
+    fclose(file);
+    if (data == MAP_FAILED)
+    {
+        LOG_SYSERR << "MappedFile mmap:";
+        return nullptr;
+    }
+    return std::shared_ptr<MappedFile>(
+        new MappedFile(static_cast<char *>(data), size, modifiedTime));
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(data_, size_);
+}
@@ -0,0 +1,72 @@
+/**
+ *
+ *  MappedFile.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/utils/NonCopyable.h>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace drogon
+{
+/**
+ * @brief A read-only memory mapping of a whole file. The pages are shared with
+ * the page cache of the OS, so serving a mapped file doesn't copy it to the
+ * heap.
+ *
+ * @note Truncating a mapped file in place makes reading the truncated pages
+ * crash the process, files should be replaced by renaming a new file.
+ */
+class MappedFile : public trantor::NonCopyable
+{
+  public:
+    /**
+     * @brief Map the file, return nullptr if the file can't be mapped, for
+     * example when it is empty.
+     */
+    static std::shared_ptr<MappedFile> open(const std::string &path);
+
+    ~MappedFile();
+
+    std::string_view data() const
+    {
+        return std::string_view(data_, size_);
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    /// Return true if the file on disk is not the mapped one any more
+    bool isStale(size_t size,
+                 std::filesystem::file_time_type modifiedTime) const
+    {
+        return size != size_ || modifiedTime != modifiedTime_;
+    }
+
+  private:
+    MappedFile(char *data,
+               size_t size,
+               std::filesystem::file_time_type modifiedTime)
+        : data_(data), size_(size), modifiedTime_(modifiedTime)
+    {
+    }
+
+    char *data_;
+    size_t size_;
+    std::filesystem::file_time_type modifiedTime_;
+};
+}  // namespace drogon
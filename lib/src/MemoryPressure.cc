@@ -0,0 +1,43 @@
+/**
+ *
+ *  @file MemoryPressure.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "MemoryPressure.h"
+#include <trantor/utils/Logger.h>
+
+using namespace drogon;
+
+void MemoryPressure::add(size_t bytes)
+{
+    if (softLimit_ == 0 || bytes == 0)
+        return;
+    auto previous = usage_.fetch_add(bytes, std::memory_order_relaxed);
+    if (previous < softLimit_ && previous + bytes >= softLimit_)
+    {
+        LOG_WARN << "The memory of the connections reached the soft limit of "
+                 << softLimit_
+                 << " bytes, reading and accepting are paused";
+    }
+}
+
+void MemoryPressure::release(size_t bytes)
+{
+    if (softLimit_ == 0 || bytes == 0)
+        return;
+    auto previous = usage_.fetch_sub(bytes, std::memory_order_relaxed);
+    if (previous >= softLimit_ && previous - bytes < softLimit_)
+    {
+        LOG_INFO << "The memory of the connections is below the soft limit, "
+                    "reading and accepting are resumed";
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ *
+ *  @file MemoryPressure.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace drogon
+{
+/**
+ * @brief The memory held by the HTTP connections of the process, the request
+ * bodies stored in memory, the input waiting to be parsed and the output
+ * queued in the sockets, see HttpAppFramework::setMemorySoftLimit().
+ */
+class MemoryPressure
+{
+  public:
+    static MemoryPressure &instance()
+    {
+        static MemoryPressure inst;
+        return inst;
+    }
+
+    // don't set after start, 0 for no limit
+    void setSoftLimit(size_t limit)
+    {
+        softLimit_ = limit;
+    }
+
+    size_t softLimit() const
+    {
+        return softLimit_;
+    }
+
+    bool enabled() const
+    {
+        return softLimit_ > 0;
+    }
+
+    size_t usage() const
+    {
+        return usage_.load(std::memory_order_relaxed);
+    }
+
+    bool underPressure() const
+    {
+        return softLimit_ > 0 && usage() >= softLimit_;
+    }
+
+    void add(size_t bytes);
+    void release(size_t bytes);
+
+  private:
+    size_t softLimit_{0};
+    std::atomic<size_t> usage_{0};
+};
+}  // namespace drogon
@@ -16,14 +16,19 @@
 #include "HttpUtils.h"
 #include "HttpAppFrameworkImpl.h"
 #include "HttpFileImpl.h"
+#include "MultipartStreamParser.h"
+#include "StreamDigest.h"
 #include <drogon/MultiPart.h>
 #include <drogon/utils/Utilities.h>
 #include "utils/ParsingUtils.h"
 #include <drogon/config.h>
 #include <algorithm>
+#include <cstdio>
 #include <fcntl.h>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <sys/stat.h>
 #ifndef _WIN32
 #include <unistd.h>
@@ -234,3 +239,215 @@ int MultiPartParser::parse(const HttpRequestPtr &req,
     }
     return 0;
 }
+
+namespace drogon
+{
+/**
+ * Parse the multipart body while it is received, writing the files straight
+ * to temporary files.
+ */
+class MultiPartStreamReader : public RequestStreamReader
+{
+  public:
+    MultiPartStreamReader(const HttpRequestPtr &req,
+                          MultiPartParser::StreamCallback callback,
+                          int digests)
+        : parser_(req->getHeader("content-type")),
+          callback_(std::move(callback)),
+          digests_(digests)
+    {
+        headerCb_ = [this](MultipartHeader header) {
+            onHeader(std::move(header));
+        };
+        dataCb_ = [this](const char *data, size_t length) {
+            onData(data, length);
+        };
+    }
+
+    ~MultiPartStreamReader() override
+    {
+        closeFile(true);
+    }
+
+    void onStreamData(const char *data, size_t length) override
+    {
+        if (finished_ || !parser_.isValid() || parser_.isFinished())
+            return;
+        parser_.parse(data, length, headerCb_, dataCb_);
+        if (finished_)
+            return;
+        if (!parser_.isValid())
+        {
+            finish(std::make_exception_ptr(
+                std::runtime_error("invalid multipart data")));
+        }
+        else if (parser_.isFinished())
+        {
+            finish({});
+        }
+    }
+
+    void onStreamFinish(std::exception_ptr ex) override
+    {
+        if (finished_)
+            return;
+        if (!ex)
+        {
+            ex = std::make_exception_ptr(
+                std::runtime_error("incomplete multipart data"));
+        }
+        finish(std::move(ex));
+    }
+
+  private:
+    void onHeader(MultipartHeader &&header)
+    {
+        if (finished_)
+            return;
+        if (header.filename.empty())
+        {
+            paramName_ = std::move(header.name);
+            paramValue_.clear();
+            return;
+        }
+        auto tmpfile = HttpAppFrameworkImpl::instance().getUploadPath();
+        auto fileName = utils::getUuidV4(false);
+        tmpfile.append("/tmp/")
+            .append(1, fileName[0])
+            .append(1, fileName[1])
+            .append("/")
+            .append(fileName);
+#ifndef _MSC_VER
+        fp_ = fopen(tmpfile.c_str(), "wb");
+#else
+        auto wPath{utils::toNativePath(tmpfile)};
+        if (_wfopen_s(&fp_, wPath.c_str(), L"wb") != 0)
+            fp_ = nullptr;
+#endif
+        if (!fp_)
+        {
+            LOG_SYSERR << "Can't create the file of the upload " << tmpfile;
+            finish(std::make_exception_ptr(
+                std::runtime_error("failed to create the uploaded file")));
+            return;
+        }
+        file_ = std::make_shared<HttpFileImpl>();
+        file_->setItemName(std::move(header.name));
+        file_->setFileName(std::move(header.filename));
+        file_->setContentType(parseContentType(header.contentType));
+        filePath_ = std::move(tmpfile);
+        fileLength_ = 0;
+        if (digests_ & MultiPartParser::kDigestMd5)
+            md5_.emplace();
+        if (digests_ & MultiPartParser::kDigestSha256)
+            sha256_.emplace();
+        if (digests_ & MultiPartParser::kDigestSha3)
+            sha3_.emplace();
+    }
+
+    void onData(const char *data, size_t length)
+    {
+        if (finished_)
+            return;
+        if (length == 0)
+        {
+            // The end of the part
+            if (file_)
+            {
+                closeFile(false);
+            }
+            else
+            {
+                result_.parameters_.emplace(std::move(paramName_),
+                                            std::move(paramValue_));
+                paramName_.clear();
+                paramValue_.clear();
+            }
+            return;
+        }
+        if (!file_)
+        {
+            paramValue_.append(data, length);
+            return;
+        }
+        if (fwrite(data, 1, length, fp_) != length)
+        {
+            LOG_SYSERR << "Can't write the file of the upload " << filePath_;
+            finish(std::make_exception_ptr(
+                std::runtime_error("failed to write the uploaded file")));
+            return;
+        }
+        fileLength_ += length;
+        if (md5_)
+            md5_->update(data, length);
+        if (sha256_)
+            sha256_->update(data, length);
+        if (sha3_)
+            sha3_->update(data, length);
+    }
+
+    // Keep the file received, or remove it on errors.
+    void closeFile(bool remove)
+    {
+        if (!file_)
+            return;
+        fclose(fp_);
+        fp_ = nullptr;
+        if (remove)
+        {
+            std::error_code err;
+            std::filesystem::remove(utils::toNativePath(filePath_), err);
+        }
+        else
+        {
+            file_->setTmpFile(std::move(filePath_), fileLength_);
+            file_->setDigests(md5_ ? md5_->finish() : std::string(),
+                              sha256_ ? sha256_->finish() : std::string(),
+                              sha3_ ? sha3_->finish() : std::string());
+            result_.files_.emplace_back(std::move(file_));
+        }
+        file_.reset();
+        md5_.reset();
+        sha256_.reset();
+        sha3_.reset();
+    }
+
+    void finish(std::exception_ptr ex)
+    {
+        finished_ = true;
+        closeFile(true);
+        auto callback = std::move(callback_);
+        if (ex)
+            result_ = MultiPartParser();
+        callback(std::move(result_), std::move(ex));
+    }
+
+    MultipartStreamParser parser_;
+    MultiPartParser::StreamCallback callback_;
+    MultipartHeaderCallback headerCb_;
+    StreamDataCallback dataCb_;
+    MultiPartParser result_;
+    int digests_;
+    bool finished_{false};
+    // The part being received
+    std::string paramName_;
+    std::string paramValue_;
+    std::shared_ptr<HttpFileImpl> file_;
+    FILE *fp_{nullptr};
+    std::string filePath_;
+    size_t fileLength_{0};
+    std::optional<internal::Md5Digest> md5_;
+    std::optional<internal::Sha256Digest> sha256_;
+    std::optional<internal::Sha3Digest> sha3_;
+};
+}  // namespace drogon
+
+RequestStreamReaderPtr MultiPartParser::newStreamReader(
+    const HttpRequestPtr &req,
+    StreamCallback callback,
+    int digests)
+{
+    return std::make_shared<MultiPartStreamReader>(req,
+                                                   std::move(callback),
+                                                   digests);
+}
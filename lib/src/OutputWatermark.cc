@@ -0,0 +1,44 @@
+/**
+ *
+ *  @file OutputWatermark.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "OutputWatermark.h"
+#include <trantor/utils/Logger.h>
+
+using namespace drogon;
+using namespace drogon::internal;
+
+void OutputWatermark::onQueued(const trantor::TcpConnectionPtr &conn,
+                               size_t bytes)
+{
+    if (bytes <= highWaterMark_ || !writable())
+        return;
+    writable_.store(false, std::memory_order_release);
+    if (policy_ == BackpressurePolicy::Close)
+    {
+        LOG_DEBUG << "The output queued for " << conn->peerAddr().toIpPort()
+                  << " reached " << bytes << " bytes, connection closed";
+        conn->forceClose();
+    }
+    if (callback_)
+        callback_(false);
+}
+
+void OutputWatermark::onDrained()
+{
+    if (writable())
+        return;
+    writable_.store(true, std::memory_order_release);
+    if (callback_)
+        callback_(true);
+}
@@ -0,0 +1,74 @@
+/**
+ *
+ *  @file OutputWatermark.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/HttpTypes.h>
+#include <trantor/net/TcpConnection.h>
+#include <atomic>
+#include <functional>
+
+namespace drogon
+{
+namespace internal
+{
+/**
+ * @brief The high water mark of the output queued in a connection, set by a
+ * WebSocket connection or a response stream.
+ *
+ * trantor reports the size of the queue when a send makes it exceed the mark
+ * and when it is empty again, so the low water mark is the empty queue.
+ */
+class OutputWatermark
+{
+  public:
+    using Callback = std::function<void(bool writable)>;
+
+    OutputWatermark(size_t highWaterMark,
+                    BackpressurePolicy policy,
+                    Callback callback)
+        : highWaterMark_(highWaterMark),
+          policy_(policy),
+          callback_(std::move(callback))
+    {
+    }
+
+    size_t highWaterMark() const
+    {
+        return highWaterMark_;
+    }
+
+    BackpressurePolicy policy() const
+    {
+        return policy_;
+    }
+
+    // Can be called in any thread.
+    bool writable() const
+    {
+        return writable_.load(std::memory_order_acquire);
+    }
+
+    // Called in the loop of the connection with the size of the queue.
+    void onQueued(const trantor::TcpConnectionPtr &conn, size_t bytes);
+    void onDrained();
+
+  private:
+    size_t highWaterMark_;
+    BackpressurePolicy policy_;
+    Callback callback_;
+    std::atomic<bool> writable_{true};
+};
+}  // namespace internal
+}  // namespace drogon
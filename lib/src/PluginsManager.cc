@@ -14,6 +14,8 @@
 
 #include "PluginsManager.h"
 #include <trantor/utils/Logger.h>
+#include <future>
+#include <unordered_set>
 
 using namespace drogon;
 
@@ -34,6 +36,8 @@ void PluginsManager::initializeAllPlugins(
 {
     assert(configs.isArray());
     std::vector<PluginBase *> plugins;
+    // The plugins whose initAndStart() can run in another thread
+    std::unordered_set<PluginBase *> parallelPlugins;
     for (auto &config : configs)
     {
         auto name = config.get("name", "").asString();
@@ -75,15 +79,78 @@ void PluginsManager::initializeAllPlugins(
         }
         pluginPtr->setInitializedCallback([this](PluginBase *p) {
             LOG_TRACE << "Plugin " << p->className() << " initialized!";
+            std::lock_guard<std::mutex> lock(initializedPluginsMutex_);
             initializedPlugins_.push_back(p);
         });
+        if (config.get("parallel_init", false).asBool())
+            parallelPlugins.insert(pluginPtr);
         plugins.push_back(pluginPtr);
     }
-    // Initialize them, Depth first
-    for (auto plugin : plugins)
+    if (parallelPlugins.empty())
     {
-        plugin->initialize();
-        forEachCallback(plugin);
+        // Initialize them, Depth first
+        for (auto plugin : plugins)
+        {
+            plugin->initialize();
+            forEachCallback(plugin);
+        }
+        return;
+    }
+    // Initialize them in rounds, a plugin is ready when its dependencies are
+    // initialized. The parallel ones of a round run in their own threads
+    // while the other ones run in this thread, in the order of the
+    // configuration.
+    while (!plugins.empty())
+    {
+        std::vector<PluginBase *> ready;
+        std::vector<PluginBase *> waiting;
+        for (auto plugin : plugins)
+        {
+            bool isReady = true;
+            for (auto dependency : plugin->dependencies_)
+            {
+                if (dependency->status_ != PluginStatus::Initialized)
+                {
+                    isReady = false;
+                    break;
+                }
+            }
+            if (isReady)
+                ready.push_back(plugin);
+            else
+                waiting.push_back(plugin);
+        }
+        if (ready.empty())
+        {
+            LOG_FATAL << "There are a circular dependency within plugins.";
+            abort();
+        }
+        std::vector<std::future<void>> results;
+        for (auto plugin : ready)
+        {
+            if (parallelPlugins.count(plugin) > 0)
+            {
+                results.push_back(std::async(std::launch::async,
+                                             [plugin]() {
+                                                 plugin->initialize();
+                                             }));
+            }
+        }
+        for (auto plugin : ready)
+        {
+            if (parallelPlugins.count(plugin) == 0)
+                plugin->initialize();
+        }
+        // Rethrow the exceptions of the parallel plugins
+        for (auto &result : results)
+        {
+            result.get();
+        }
+        for (auto plugin : ready)
+        {
+            forEachCallback(plugin);
+        }
+        plugins.swap(waiting);
     }
 }
 
@@ -15,6 +15,7 @@
 #pragma once
 #include <drogon/plugins/Plugin.h>
 #include <map>
+#include <mutex>
 
 namespace drogon
 {
@@ -37,6 +38,7 @@ class PluginsManager : trantor::NonCopyable
     void createPlugin(const std::string &pluginName);
     std::map<std::string, PluginBasePtr> pluginsMap_;
     std::vector<PluginBase *> initializedPlugins_;
+    std::mutex initializedPluginsMutex_;
 };
 
 }  // namespace drogon
@@ -0,0 +1,114 @@
+/**
+ *
+ *  @file PrefixTrie.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace drogon
+{
+namespace internal
+{
+/**
+ * @brief A trie of string prefixes, each with an index (e.g. the order in
+ * which they were added). match() finds the smallest index of the prefixes
+ * a string starts with, in one walk along the string instead of comparing it
+ * with every prefix.
+ *
+ * The trie is built once and then only read, it can be shared by threads.
+ */
+class PrefixTrie
+{
+  public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    PrefixTrie() : nodes_(1)
+    {
+    }
+
+    /// Add the prefix, the smallest index is kept for a duplicate prefix.
+    void insert(std::string_view prefix, size_t index)
+    {
+        uint32_t node = 0;
+        for (auto c : prefix)
+        {
+            auto &children = nodes_[node].children;
+            auto iter = std::lower_bound(children.begin(),
+                                         children.end(),
+                                         c,
+                                         [](const auto &child, char key) {
+                                             return child.first < key;
+                                         });
+            if (iter != children.end() && iter->first == c)
+            {
+                node = iter->second;
+                continue;
+            }
+            auto next = static_cast<uint32_t>(nodes_.size());
+            children.insert(iter, {c, next});
+            // The reference to the children is invalidated here.
+            nodes_.emplace_back();
+            node = next;
+        }
+        auto &nodeIndex = nodes_[node].index;
+        nodeIndex = (std::min)(nodeIndex, index);
+        ++size_;
+    }
+
+    /// Return the smallest index of the prefixes of the string, npos if it
+    /// starts with none of them.
+    size_t match(std::string_view str) const
+    {
+        size_t best = nodes_[0].index;
+        uint32_t node = 0;
+        for (auto c : str)
+        {
+            auto &children = nodes_[node].children;
+            auto iter = std::lower_bound(children.begin(),
+                                         children.end(),
+                                         c,
+                                         [](const auto &child, char key) {
+                                             return child.first < key;
+                                         });
+            if (iter == children.end() || iter->first != c)
+                break;
+            node = iter->second;
+            best = (std::min)(best, nodes_[node].index);
+        }
+        return best;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+  private:
+    struct Node
+    {
+        // Sorted by the character
+        std::vector<std::pair<char, uint32_t>> children;
+        size_t index{npos};
+    };
+
+    std::vector<Node> nodes_;
+    size_t size_{0};
+};
+}  // namespace internal
+}  // namespace drogon
@@ -0,0 +1,36 @@
+/**
+ *
+ *  @file Probes.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "Probes.h"
+
+#if DROGON_USDT
+// The tracers find the semaphores in the .probes section and increment them
+// while attached.
+#define DROGON_PROBE_SEMAPHORE(name)                   \
+    __attribute__((section(".probes"))) unsigned short \
+        drogon_##name##_semaphore = 0
+
+extern "C"
+{
+    DROGON_PROBE_SEMAPHORE(request__parsed);
+    DROGON_PROBE_SEMAPHORE(route__matched);
+    DROGON_PROBE_SEMAPHORE(handler__start);
+    DROGON_PROBE_SEMAPHORE(handler__end);
+    DROGON_PROBE_SEMAPHORE(response__send);
+    DROGON_PROBE_SEMAPHORE(db__query__start);
+    DROGON_PROBE_SEMAPHORE(db__query__end);
+    DROGON_PROBE_SEMAPHORE(redis__command__start);
+    DROGON_PROBE_SEMAPHORE(redis__command__end);
+}
+#endif
@@ -0,0 +1,79 @@
+/**
+ *
+ *  @file Probes.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+/**
+ * The USDT probes (statically defined tracepoints) on the hot paths, built
+ * with the USE_USDT cmake option. A probe is a nop until a tracer such as
+ * bpftrace attaches to it, e.g. the latencies of the handlers:
+ * @code
+   bpftrace -e '
+     usdt:./app:drogon:handler__start { @start[arg0] = nsecs; }
+     usdt:./app:drogon:handler__end /@start[arg0]/ {
+         @us[str(arg2, arg3)] = hist((nsecs - @start[arg0]) / 1000);
+         delete(@start[arg0]);
+     }'
+   @endcode
+ * The first argument identifies the request or the connection, it is the
+ * address of the object.
+ *
+ * - request__parsed(req, method, path): the request is received.
+ * - route__matched(req, pattern, patternLength): the handler is found.
+ * - handler__start(req, pattern, patternLength)
+ * - handler__end(req, status, pattern, patternLength): the handler (or an
+ *   advice or a middleware) calls back with the response.
+ * - response__send(req, status, bodyLength): the response is sent.
+ * - db__query__start(conn, sql, sqlLength), db__query__end(conn, ok): a sql
+ *   command on a database connection.
+ * - redis__command__start(conn, command, commandLength),
+ *   redis__command__end(conn, ok): a redis command on a connection, the
+ *   replies of a connection come in the order of the commands.
+ *
+ * Without the option, the macros expand to nothing and their arguments are
+ * not evaluated.
+ */
+#if DROGON_USDT
+// The counters which tell whether a tracer is attached, see
+// DROGON_PROBE_ENABLED().
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+extern "C"
+{
+    extern unsigned short drogon_request__parsed_semaphore;
+    extern unsigned short drogon_route__matched_semaphore;
+    extern unsigned short drogon_handler__start_semaphore;
+    extern unsigned short drogon_handler__end_semaphore;
+    extern unsigned short drogon_response__send_semaphore;
+    extern unsigned short drogon_db__query__start_semaphore;
+    extern unsigned short drogon_db__query__end_semaphore;
+    extern unsigned short drogon_redis__command__start_semaphore;
+    extern unsigned short drogon_redis__command__end_semaphore;
+}
+
+#define DROGON_PROBE_ENABLED(name) \
+    __builtin_expect(drogon_##name##_semaphore != 0, 0)
+#define DROGON_PROBE1(name, a) DTRACE_PROBE1(drogon, name, a)
+#define DROGON_PROBE2(name, a, b) DTRACE_PROBE2(drogon, name, a, b)
+#define DROGON_PROBE3(name, a, b, c) DTRACE_PROBE3(drogon, name, a, b, c)
+#define DROGON_PROBE4(name, a, b, c, d) \
+    DTRACE_PROBE4(drogon, name, a, b, c, d)
+#else
+#define DROGON_PROBE_ENABLED(name) false
+#define DROGON_PROBE1(name, a)
+#define DROGON_PROBE2(name, a, b)
+#define DROGON_PROBE3(name, a, b, c)
+#define DROGON_PROBE4(name, a, b, c, d)
+#endif
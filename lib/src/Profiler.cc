@@ -0,0 +1,235 @@
+#include <drogon/plugins/Profiler.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/utils/Utilities.h>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include "CpuProfiler.h"
+
+using namespace drogon;
+using namespace drogon::plugin;
+
+#ifdef __linux__
+// Declared weak, so it is only found if the application is linked with
+// jemalloc.
+extern "C" int mallctl(const char *name,
+                       void *oldp,
+                       size_t *oldlenp,
+                       void *newp,
+                       size_t newlen) __attribute__((weak));
+#endif
+
+static HttpResponsePtr textResponse(HttpStatusCode code,
+                                    const std::string &text)
+{
+    auto resp = HttpResponse::newHttpResponse(code, CT_TEXT_PLAIN);
+    resp->setBody(text);
+    return resp;
+}
+
+static HttpResponsePtr profileResponse(std::string &&profile,
+                                       const char *fileName)
+{
+    auto resp =
+        HttpResponse::newHttpResponse(k200OK, CT_APPLICATION_OCTET_STREAM);
+    resp->addHeader("Content-Disposition",
+                    std::string("attachment; filename=\"") + fileName + "\"");
+    resp->setBody(std::move(profile));
+    return resp;
+}
+
+void Profiler::initAndStart(const Json::Value &config)
+{
+    path_ = config.get("path", path_).asString();
+    while (path_.length() > 1 && path_.back() == '/')
+    {
+        path_.pop_back();
+    }
+    frequency_ = config.get("frequency", frequency_).asInt();
+    maxSeconds_ = config.get("max_seconds", maxSeconds_).asInt();
+    if (frequency_ <= 0 || frequency_ > 1000)
+    {
+        throw std::runtime_error(
+            "Profiler: frequency should be between 1 and 1000");
+    }
+    if (maxSeconds_ <= 0)
+    {
+        throw std::runtime_error("Profiler: max_seconds should be positive");
+    }
+    const Json::Value &allowIps = config["allow_ips"];
+    if (allowIps.isNull())
+    {
+        allowIps_.add("127.0.0.1");
+        allowIps_.add("::1");
+    }
+    else if (!allowIps.isArray())
+    {
+        throw std::runtime_error("Profiler: allow_ips should be an array");
+    }
+    for (const auto &ipOrCidr : allowIps)
+    {
+        allowIps_.add(ipOrCidr.asString());
+    }
+
+    std::weak_ptr<Profiler> weakPtr = shared_from_this();
+    app().registerHandler(
+        path_ + "/profile",
+        [weakPtr](const HttpRequestPtr &req,
+                  std::function<void(const HttpResponsePtr &)> &&callback) {
+            auto thisPtr = weakPtr.lock();
+            if (!thisPtr)
+            {
+                callback(HttpResponse::newNotFoundResponse(req));
+                return;
+            }
+            thisPtr->handleProfile(req, std::move(callback));
+        },
+        {Get},
+        "Profiler");
+    app().registerHandler(
+        path_ + "/heap",
+        [weakPtr](const HttpRequestPtr &req,
+                  std::function<void(const HttpResponsePtr &)> &&callback) {
+            auto thisPtr = weakPtr.lock();
+            if (!thisPtr)
+            {
+                callback(HttpResponse::newNotFoundResponse(req));
+                return;
+            }
+            thisPtr->handleHeap(req, std::move(callback));
+        },
+        {Get},
+        "Profiler");
+}
+
+void Profiler::shutdown()
+{
+    auto &profiler = internal::CpuProfiler::instance();
+    if (profiler.running())
+    {
+        (void)profiler.stop();
+    }
+}
+
+void Profiler::handleProfile(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    if (!allowIps_.contains(req->peerAddr()))
+    {
+        callback(HttpResponse::newHttpResponse(k403Forbidden, CT_NONE));
+        return;
+    }
+    int seconds = 30;
+    auto &secondsParameter = req->getParameter("seconds");
+    if (!secondsParameter.empty())
+    {
+        try
+        {
+            seconds = std::stoi(secondsParameter);
+        }
+        catch (...)
+        {
+            callback(textResponse(k400BadRequest, "Invalid seconds\n"));
+            return;
+        }
+    }
+    if (seconds <= 0 || seconds > maxSeconds_)
+    {
+        callback(textResponse(k400BadRequest,
+                              "The seconds should be between 1 and " +
+                                  std::to_string(maxSeconds_) + "\n"));
+        return;
+    }
+
+    std::vector<trantor::EventLoop *> loops;
+    for (size_t i = 0; i < app().getThreadNum(); ++i)
+    {
+        loops.push_back(app().getIOLoop(i));
+    }
+    // Enough for all the threads busy all along, the samples beyond the
+    // bound are dropped.
+    auto maxSamples = std::min<size_t>(
+        (size_t)frequency_ * seconds * loops.size() + 1024, 1 << 17);
+    auto &profiler = internal::CpuProfiler::instance();
+    if (!profiler.start(loops, frequency_, maxSamples))
+    {
+        if (profiler.running())
+        {
+            callback(textResponse(k409Conflict,
+                                  "A cpu profile is being taken\n"));
+        }
+        else
+        {
+            callback(textResponse(
+                k501NotImplemented,
+                "The cpu profiles are not supported on this platform\n"));
+        }
+        return;
+    }
+    LOG_INFO << "Profiler: taking a cpu profile for " << seconds
+             << " seconds";
+    req->getLoop()->runAfter(seconds, [callback = std::move(callback)]() {
+        auto &profiler = internal::CpuProfiler::instance();
+        if (!profiler.running())
+        {
+            // Stopped by the shutdown of the plugin
+            callback(HttpResponse::newHttpResponse(k503ServiceUnavailable,
+                                                   CT_NONE));
+            return;
+        }
+        callback(profileResponse(profiler.stop(), "profile"));
+    });
+}
+
+void Profiler::handleHeap(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    if (!allowIps_.contains(req->peerAddr()))
+    {
+        callback(HttpResponse::newHttpResponse(k403Forbidden, CT_NONE));
+        return;
+    }
+#ifdef __linux__
+    bool enabled = false;
+    size_t length = sizeof(enabled);
+    if (mallctl == nullptr ||
+        mallctl("opt.prof", &enabled, &length, nullptr, 0) != 0 || !enabled)
+    {
+        callback(textResponse(
+            k501NotImplemented,
+            "The heap profile needs jemalloc built with --enable-prof and "
+            "MALLOC_CONF=prof:true\n"));
+        return;
+    }
+    std::error_code ec;
+    auto fileName = (std::filesystem::temp_directory_path(ec) /
+                     ("drogon-heap-" + utils::getUuid() + ".prof"))
+                        .string();
+    const char *fileNamePtr = fileName.c_str();
+    if (mallctl("prof.dump",
+                nullptr,
+                nullptr,
+                &fileNamePtr,
+                sizeof(fileNamePtr)) != 0)
+    {
+        callback(textResponse(k500InternalServerError,
+                              "Failed to dump the heap profile\n"));
+        return;
+    }
+    std::string profile;
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        profile.assign(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+    }
+    std::remove(fileName.c_str());
+    callback(profileResponse(std::move(profile), "heap"));
+#else
+    callback(textResponse(k501NotImplemented,
+                          "The heap profile needs jemalloc on Linux\n"));
+#endif
+}
@@ -3,7 +3,9 @@
 #include <drogon/utils/monitoring/Counter.h>
 #include <drogon/utils/monitoring/Gauge.h>
 #include <drogon/utils/monitoring/Histogram.h>
+#include <drogon/utils/monitoring/ExponentialHistogram.h>
 #include <drogon/utils/monitoring/Collector.h>
+#include "BuiltinMetrics.h"
 
 using namespace drogon;
 using namespace drogon::monitoring;
@@ -87,6 +89,15 @@ void PromExporter::initAndStart(const Json::Value &config)
                             collectors_.insert(
                                 std::make_pair(name, histogramCollector));
                         }
+                        else if (type == "exponential_histogram")
+                        {
+                            auto histogramCollector = std::make_shared<
+                                Collector<ExponentialHistogram>>(name,
+                                                                 help,
+                                                                 labelNames);
+                            collectors_.insert(
+                                std::make_pair(name, histogramCollector));
+                        }
                         else
                         {
                             LOG_ERROR << "Unknown collector type: " << type;
@@ -108,6 +119,266 @@ void PromExporter::initAndStart(const Json::Value &config)
             LOG_ERROR << "collectors must be an array!";
         }
     }
+    if (config.isMember("builtin_metrics"))
+    {
+        enableBuiltinMetrics(config["builtin_metrics"]);
+    }
+}
+
+void PromExporter::shutdown()
+{
+    if (lagTimerId_ != trantor::InvalidTimerId)
+    {
+        drogon::app().getLoop()->invalidateTimer(lagTimerId_);
+        lagTimerId_ = trantor::InvalidTimerId;
+    }
+}
+
+void PromExporter::enableBuiltinMetrics(const Json::Value &config)
+{
+    auto &app = drogon::app();
+    if (config.get("http", true).asBool())
+    {
+        auto &metrics = BuiltinMetrics::instance();
+        auto inFlight = std::make_shared<Collector<Gauge>>(
+            "drogon_http_requests_in_flight",
+            "The number of requests being handled",
+            std::vector<std::string>{});
+        registerCollector(inFlight);
+        metrics.inFlightRequests = inFlight->metric({});
+        auto parseErrors = std::make_shared<Collector<Counter>>(
+            "drogon_http_parse_errors_total",
+            "The number of requests which can't be parsed",
+            std::vector<std::string>{});
+        registerCollector(parseErrors);
+        metrics.parseErrors = parseErrors->metric({});
+        auto pipelineDepth = std::make_shared<Collector<Histogram>>(
+            "drogon_http_pipeline_depth",
+            "The number of requests waiting in the pipeline of a connection "
+            "when a request is pipelined",
+            std::vector<std::string>{});
+        registerCollector(pipelineDepth);
+        metrics.pipelineDepth =
+            pipelineDepth->metric({},
+                                  std::vector<double>{1, 2, 4, 8, 16, 32, 64},
+                                  std::chrono::seconds(0),
+                                  0,
+                                  app.getLoop());
+        metrics.connections = std::make_shared<Collector<Gauge>>(
+            "drogon_http_connections",
+            "The number of HTTP connections of an IO loop",
+            std::vector<std::string>{"loop"});
+        registerCollector(metrics.connections);
+        metrics.connectionMemory = std::make_shared<Collector<Gauge>>(
+            "drogon_http_connection_memory_bytes",
+            "The memory held by the parsers and the buffers of the HTTP "
+            "connections of an IO loop",
+            std::vector<std::string>{"loop"});
+        registerCollector(metrics.connectionMemory);
+        auto trimmed = std::make_shared<Collector<Counter>>(
+            "drogon_http_connection_trims_total",
+            "The number of times the memory of an idle connection was "
+            "released",
+            std::vector<std::string>{});
+        registerCollector(trimmed);
+        metrics.trimmedConnections = trimmed->metric({});
+
+        auto requests = std::make_shared<Collector<Counter>>(
+            "drogon_http_requests_total",
+            "The number of responses by method, route and status code",
+            std::vector<std::string>{"method", "route", "status"});
+        registerCollector(requests);
+        auto latency = std::make_shared<Collector<ExponentialHistogram>>(
+            "drogon_http_request_duration_seconds",
+            "The time from receiving a request to sending its response",
+            std::vector<std::string>{"method", "route"});
+        registerCollector(latency);
+        app.registerPreSendingAdvice(
+            [requests, latency](const HttpRequestPtr &req,
+                                const HttpResponsePtr &resp) {
+                // Route patterns keep the number of label values bounded,
+                // unlike the paths.
+                std::string route{req->matchedPathPattern()};
+                if (route.empty())
+                    route = "none";
+                std::string method{req->methodString()};
+                requests
+                    ->metric({method,
+                              route,
+                              std::to_string((int)resp->statusCode())})
+                    ->increment();
+                auto elapsed =
+                    trantor::Date::now().microSecondsSinceEpoch() -
+                    req->creationDate().microSecondsSinceEpoch();
+                // From 10us to 100s with about 9% wide buckets.
+                latency->metric({method, route}, 3, 1e-5, 100.0)
+                    ->observe((double)elapsed / 1000000.0);
+            });
+    }
+
+    auto lagInterval = config.get("event_loop_lag_interval", 5).asDouble();
+    if (lagInterval > 0)
+    {
+        auto lag = std::make_shared<Collector<Gauge>>(
+            "drogon_event_loop_lag_seconds",
+            "The time a task waited in the queue of an IO loop",
+            std::vector<std::string>{"loop"});
+        registerCollector(lag);
+        lagTimerId_ = app.getLoop()->runEvery(lagInterval, [lag]() {
+            auto &app = drogon::app();
+            for (size_t i = 0; i < app.getThreadNum(); ++i)
+            {
+                auto gauge = lag->metric({std::to_string(i)});
+                auto start = std::chrono::steady_clock::now();
+                app.getIOLoop(i)->queueInLoop([gauge, start]() {
+                    std::chrono::duration<double> elapsed =
+                        std::chrono::steady_clock::now() - start;
+                    gauge->set(elapsed.count());
+                });
+            }
+        });
+    }
+
+    if (config.get("db_statements", false).asBool())
+    {
+        auto &metrics = BuiltinMetrics::instance();
+        metrics.sqlDuration =
+            std::make_shared<Collector<ExponentialHistogram>>(
+                "drogon_db_statement_duration_seconds",
+                "The time from sending a SQL command to its result by "
+                "database system and normalized statement",
+                std::vector<std::string>{"system", "statement"});
+        registerCollector(metrics.sqlDuration);
+        metrics.sqlRows = std::make_shared<Collector<Counter>>(
+            "drogon_db_statement_rows_total",
+            "The number of rows returned or affected by the SQL commands",
+            std::vector<std::string>{"system", "statement"});
+        registerCollector(metrics.sqlRows);
+        metrics.sqlErrors = std::make_shared<Collector<Counter>>(
+            "drogon_db_statement_errors_total",
+            "The number of SQL commands which failed",
+            std::vector<std::string>{"system", "statement"});
+        registerCollector(metrics.sqlErrors);
+    }
+
+    if (config.get("route_costs", false).asBool())
+    {
+        auto &metrics = BuiltinMetrics::instance();
+        metrics.routeCpuTime = std::make_shared<Collector<Counter>>(
+            "drogon_http_route_cpu_seconds_total",
+            "The cpu time of the handlers and the sending of their responses "
+            "by route",
+            std::vector<std::string>{"route"});
+        registerCollector(metrics.routeCpuTime);
+        metrics.routeAllocations = std::make_shared<Collector<Counter>>(
+            "drogon_http_route_allocations_total",
+            "The number of allocations of the handlers and the sending of "
+            "their responses by route",
+            std::vector<std::string>{"route"});
+        registerCollector(metrics.routeAllocations);
+        metrics.routeAllocatedBytes = std::make_shared<Collector<Counter>>(
+            "drogon_http_route_allocated_bytes_total",
+            "The bytes allocated by the handlers and the sending of their "
+            "responses by route",
+            std::vector<std::string>{"route"});
+        registerCollector(metrics.routeAllocatedBytes);
+    }
+
+    for (auto &name : config["db_clients"])
+        dbClientNames_.push_back(name.asString());
+    for (auto &name : config["redis_clients"])
+        redisClientNames_.push_back(name.asString());
+    if (!dbClientNames_.empty())
+    {
+        registerCollector(std::make_shared<Collector<Gauge>>(
+            "drogon_db_client_connections",
+            "The number of connections of a database client by state",
+            std::vector<std::string>{"client", "state"}));
+        registerCollector(std::make_shared<Collector<Gauge>>(
+            "drogon_db_client_pending_commands",
+            "The number of SQL commands waiting for a connection",
+            std::vector<std::string>{"client"}));
+        registerCollector(std::make_shared<Collector<Gauge>>(
+            "drogon_db_client_queue_wait_seconds_total",
+            "The total time SQL commands waited for a connection",
+            std::vector<std::string>{"client"}));
+        registerCollector(std::make_shared<Collector<Gauge>>(
+            "drogon_db_client_queued_commands_total",
+            "The number of SQL commands which waited for a connection",
+            std::vector<std::string>{"client"}));
+        registerCollector(std::make_shared<Collector<Gauge>>(
+            "drogon_db_client_prepared_statements",
+            "The lookups of the prepared statements of a PostgreSQL client "
+            "by result and the statements evicted from the cache",
+            std::vector<std::string>{"client", "event"}));
+    }
+    if (!redisClientNames_.empty())
+    {
+        registerCollector(std::make_shared<Collector<Gauge>>(
+            "drogon_redis_client_connections",
+            "The number of connections of a redis client by state",
+            std::vector<std::string>{"client", "state"}));
+        registerCollector(std::make_shared<Collector<Gauge>>(
+            "drogon_redis_client_pending_commands",
+            "The number of redis commands waiting for a connection",
+            std::vector<std::string>{"client"}));
+    }
+}
+
+// The connection metrics are read when they are scraped.
+void PromExporter::updateClientMetrics()
+{
+    auto &app = drogon::app();
+    if (!dbClientNames_.empty())
+    {
+        auto connections =
+            getCollector<Gauge>("drogon_db_client_connections");
+        auto pending = getCollector<Gauge>("drogon_db_client_pending_commands");
+        auto queueWaitTime =
+            getCollector<Gauge>("drogon_db_client_queue_wait_seconds_total");
+        auto queuedCommands =
+            getCollector<Gauge>("drogon_db_client_queued_commands_total");
+        auto statements =
+            getCollector<Gauge>("drogon_db_client_prepared_statements");
+        for (auto &name : dbClientNames_)
+        {
+            auto client = app.getDbClient(name);
+            if (!client)
+                continue;
+            auto stats = client->connectionStats();
+            connections->metric({name, "busy"})->set((double)stats.busy);
+            connections->metric({name, "idle"})->set((double)stats.idle);
+            pending->metric({name})->set((double)stats.pending);
+            queueWaitTime->metric({name})->set(stats.queueWaitTime);
+            queuedCommands->metric({name})->set((double)stats.queuedCommands);
+            if (client->type() != orm::ClientType::PostgreSQL)
+                continue;
+            statements->metric({name, "hit"})
+                ->set((double)stats.preparedStatementHits);
+            statements->metric({name, "miss"})
+                ->set((double)stats.preparedStatementMisses);
+            statements->metric({name, "eviction"})
+                ->set((double)stats.preparedStatementEvictions);
+        }
+    }
+    if (!redisClientNames_.empty())
+    {
+        auto connections =
+            getCollector<Gauge>("drogon_redis_client_connections");
+        auto pending =
+            getCollector<Gauge>("drogon_redis_client_pending_commands");
+        for (auto &name : redisClientNames_)
+        {
+            auto client = app.getRedisClient(name);
+            if (!client)
+                continue;
+            auto stats = client->connectionStats();
+            connections->metric({name, "connected"})
+                ->set((double)stats.connected);
+            connections->metric({name, "total"})->set((double)stats.total);
+            pending->metric({name})->set((double)stats.pending);
+        }
+    }
 }
 
 static std::string exportCollector(
@@ -171,6 +442,7 @@ static std::string exportCollector(
 
 std::string PromExporter::exportMetrics()
 {
+    updateClientMetrics();
     std::lock_guard<std::mutex> guard(mutex_);
     std::string result;
     for (auto const &collector : collectors_)
@@ -102,7 +102,7 @@ void RealIpResolver::initAndStart(const Json::Value &config)
     }
     for (const auto &ipOrCidr : trustIps)
     {
-        trustCIDRs_.emplace_back(ipOrCidr.asString());
+        trustCIDRs_.add(ipOrCidr.asString());
     }
 
     drogon::app().registerPreRoutingAdvice([this](const HttpRequestPtr &req) {
@@ -177,50 +177,7 @@ const trantor::InetAddress &RealIpResolver::getRealAddr(
 }
 
 bool RealIpResolver::matchCidr(const trantor::InetAddress &addr,
-                               const CIDRs &trustCIDRs)
+                               const CidrSet &trustCIDRs)
 {
-    for (const auto &cidr : trustCIDRs)
-    {
-        if ((addr.ipNetEndian() & cidr.mask_) == cidr.addr_)
-        {
-            return true;
-        }
-    }
-    return false;
-}
-
-RealIpResolver::CIDR::CIDR(const std::string &ipOrCidr)
-{
-    // Find CIDR slash
-    auto pos = ipOrCidr.find('/');
-    std::string ipv4;
-    if (pos != std::string::npos)
-    {
-        // parameter is a CIDR block
-        std::string prefixLen = ipOrCidr.substr(pos + 1);
-        ipv4 = ipOrCidr.substr(0, pos);
-        uint16_t prefix = std::stoi(prefixLen);
-        if (prefix > 32)
-        {
-            throw std::runtime_error("Bad CIDR block: " + ipOrCidr);
-        }
-        mask_ = htonl(0xffffffffu << (32 - prefix));
-    }
-    else
-    {
-        // parameter is an IP
-        ipv4 = ipOrCidr;
-        mask_ = 0xffffffffu;
-    }
-
-    trantor::InetAddress addr(ipv4, 0);
-    if (addr.isIpV6())
-    {
-        throw std::runtime_error("Ipv6 is not supported by RealIpResolver.");
-    }
-    if (addr.isUnspecified())
-    {
-        throw std::runtime_error("Bad ipv4 address: " + ipv4);
-    }
-    addr_ = addr.ipNetEndian() & mask_;
+    return trustCIDRs.contains(addr);
 }
@@ -21,6 +21,7 @@
 #include <trantor/net/EventLoop.h>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace drogon
 {
@@ -55,6 +56,16 @@ class RedisClientManager : public trantor::NonCopyable
                            unsigned int db);
     // bool areAllRedisClientsAvailable() const noexcept;
 
+    // The names of the clients which are not fast ones.
+    std::vector<std::string> redisClientNames() const
+    {
+        std::vector<std::string> names;
+        names.reserve(redisClientsMap_.size());
+        for (auto &item : redisClientsMap_)
+            names.push_back(item.first);
+        return names;
+    }
+
     ~RedisClientManager();
 
   private:
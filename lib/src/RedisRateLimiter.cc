@@ -0,0 +1,160 @@
+/**
+ *
+ *  @file RedisRateLimiter.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/RedisRateLimiter.h>
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+
+using namespace drogon;
+using namespace drogon::nosql;
+
+namespace
+{
+// KEYS[1]: the bucket, ARGV[1]: the capacity, ARGV[2]: the time unit in
+// milliseconds, ARGV[3]: the number of requested tokens. The server time is
+// used so that the clocks of the nodes don't matter. Returns the number of
+// granted tokens.
+const char *leaseScript =
+    "redis.replicate_commands() "
+    "local capacity = tonumber(ARGV[1]) "
+    "local unit = tonumber(ARGV[2]) "
+    "local requested = tonumber(ARGV[3]) "
+    "local t = redis.call('TIME') "
+    "local now = tonumber(t[1]) * 1000 + math.floor(tonumber(t[2]) / 1000) "
+    "local state = redis.call('HMGET', KEYS[1], 'tokens', 'ts') "
+    "local tokens = tonumber(state[1]) or capacity "
+    "local ts = tonumber(state[2]) or now "
+    "if now > ts then "
+    "  tokens = math.min(capacity, tokens + (now - ts) * capacity / unit) "
+    "end "
+    "local granted = math.min(requested, math.floor(tokens)) "
+    "tokens = tokens - granted "
+    "redis.call('HSET', KEYS[1], 'tokens', tostring(tokens), 'ts', now) "
+    "redis.call('PEXPIRE', KEYS[1], unit * 2) "
+    "return granted";
+}  // namespace
+
+RedisRateLimiter::RedisRateLimiter(RedisClientPtr client,
+                                   std::string key,
+                                   size_t capacity,
+                                   std::chrono::duration<double> timeUnit,
+                                   size_t leaseSize)
+    : client_(std::move(client)),
+      key_(std::move(key)),
+      capacity_(capacity),
+      timeUnit_(timeUnit),
+      leaseSize_(leaseSize > 0 ? (std::min)(leaseSize, capacity)
+                               : (std::max)(capacity / 10, size_t(1))),
+      tokens_((int64_t)leaseSize_),
+      credit_((int64_t)leaseSize_),
+      nextLeaseTime_(std::chrono::steady_clock::now()),
+      fallbackLimiter_(
+          RateLimiter::newRateLimiter(RateLimiterType::kTokenBucket,
+                                      capacity,
+                                      timeUnit))
+{
+}
+
+bool RedisRateLimiter::isAllowed()
+{
+    bool allowed{false};
+    bool needLease{false};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (redisFailed_)
+        {
+            allowed = fallbackLimiter_->isAllowed();
+        }
+        else if (tokens_ > 0)
+        {
+            --tokens_;
+            allowed = true;
+        }
+        if (!leasing_ && (redisFailed_ || tokens_ <= (int64_t)leaseSize_ / 2))
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= nextLeaseTime_)
+            {
+                leasing_ = true;
+                needLease = true;
+            }
+        }
+    }
+    // The client may call back in this thread, so the lock must be released.
+    if (needLease)
+        lease();
+    return allowed;
+}
+
+void RedisRateLimiter::lease()
+{
+    std::weak_ptr<RedisRateLimiter> weakPtr = shared_from_this();
+    auto unitMs = (unsigned long long)(std::max)(
+        std::chrono::duration_cast<std::chrono::milliseconds>(timeUnit_)
+            .count(),
+        std::chrono::milliseconds::rep(1));
+    client_->execCommandAsync(
+        [weakPtr](const RedisResult &result) {
+            auto thisPtr = weakPtr.lock();
+            if (!thisPtr)
+                return;
+            if (result.type() != RedisResultType::kInteger)
+            {
+                thisPtr->onLeaseFailed();
+                return;
+            }
+            thisPtr->onLeased(result.asInteger());
+        },
+        [weakPtr](const RedisException &err) {
+            LOG_ERROR << "Failed to lease tokens from redis: " << err.what();
+            auto thisPtr = weakPtr.lock();
+            if (thisPtr)
+                thisPtr->onLeaseFailed();
+        },
+        "eval %s 1 %b %llu %llu %llu",
+        leaseScript,
+        key_.data(),
+        key_.size(),
+        (unsigned long long)capacity_,
+        unitMs,
+        (unsigned long long)leaseSize_);
+}
+
+void RedisRateLimiter::onLeased(int64_t granted)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    leasing_ = false;
+    redisFailed_ = false;
+    tokens_ += granted - credit_;
+    credit_ = 0;
+    if (granted < (int64_t)leaseSize_)
+    {
+        // The shared bucket is drained, don't ask again before it has been
+        // refilled with the missing tokens.
+        auto delay = timeUnit_ * (double)((int64_t)leaseSize_ - granted) /
+                     (double)capacity_;
+        nextLeaseTime_ =
+            std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                delay);
+    }
+}
+
+void RedisRateLimiter::onLeaseFailed()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    leasing_ = false;
+    redisFailed_ = true;
+    nextLeaseTime_ = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+}
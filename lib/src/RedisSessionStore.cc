@@ -0,0 +1,238 @@
+/**
+ *
+ *  @file RedisSessionStore.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/RedisSessionStore.h>
+#include <json/json.h>
+#include <trantor/utils/Logger.h>
+#include <cstdint>
+#include <memory>
+#include <typeinfo>
+
+using namespace drogon;
+using namespace drogon::nosql;
+
+RedisSessionStore::RedisSessionStore(RedisClientPtr client,
+                                     std::string keyPrefix,
+                                     Encoder encoder,
+                                     Decoder decoder)
+    : client_(std::move(client)),
+      keyPrefix_(std::move(keyPrefix)),
+      encoder_(std::move(encoder)),
+      decoder_(std::move(decoder))
+{
+}
+
+void RedisSessionStore::load(const std::string &sessionId,
+                             LoadCallback &&callback)
+{
+    auto key = keyPrefix_ + sessionId;
+    auto sharedCallback = std::make_shared<LoadCallback>(std::move(callback));
+    client_->execCommandAsync(
+        [sharedCallback, decoder = decoder_](const RedisResult &result) {
+            Session::SessionMap data;
+            if (result.isNil())
+            {
+                (*sharedCallback)(false, std::move(data));
+                return;
+            }
+            if (!decoder(result.asString(), data))
+            {
+                LOG_ERROR << "Invalid session data in redis";
+                data.clear();
+                (*sharedCallback)(false, std::move(data));
+                return;
+            }
+            (*sharedCallback)(true, std::move(data));
+        },
+        [sharedCallback](const RedisException &err) {
+            LOG_ERROR << "Failed to load the session from redis: "
+                      << err.what();
+            (*sharedCallback)(false, Session::SessionMap());
+        },
+        "get %b",
+        key.data(),
+        key.size());
+}
+
+void RedisSessionStore::save(std::vector<SessionData> &&sessions,
+                             size_t timeout)
+{
+    for (auto &session : sessions)
+    {
+        auto key = keyPrefix_ + session.first;
+        auto value = encoder_(session.second);
+        auto onError = [](const RedisException &err) {
+            LOG_ERROR << "Failed to save the session to redis: " << err.what();
+        };
+        if (timeout > 0)
+        {
+            client_->execCommandAsync([](const RedisResult &) {},
+                                      std::move(onError),
+                                      "set %b %b ex %llu",
+                                      key.data(),
+                                      key.size(),
+                                      value.data(),
+                                      value.size(),
+                                      (unsigned long long)timeout);
+        }
+        else
+        {
+            client_->execCommandAsync([](const RedisResult &) {},
+                                      std::move(onError),
+                                      "set %b %b",
+                                      key.data(),
+                                      key.size(),
+                                      value.data(),
+                                      value.size());
+        }
+    }
+}
+
+void RedisSessionStore::touch(std::vector<std::string> &&sessionIds,
+                              size_t timeout)
+{
+    for (auto &sessionId : sessionIds)
+    {
+        auto key = keyPrefix_ + sessionId;
+        client_->execCommandAsync(
+            [](const RedisResult &) {},
+            [](const RedisException &err) {
+                LOG_ERROR << "Failed to touch the session in redis: "
+                          << err.what();
+            },
+            "expire %b %llu",
+            key.data(),
+            key.size(),
+            (unsigned long long)timeout);
+    }
+}
+
+void RedisSessionStore::erase(const std::string &sessionId)
+{
+    auto key = keyPrefix_ + sessionId;
+    client_->execCommandAsync(
+        [](const RedisResult &) {},
+        [](const RedisException &err) {
+            LOG_ERROR << "Failed to erase the session from redis: "
+                      << err.what();
+        },
+        "del %b",
+        key.data(),
+        key.size());
+}
+
+// Every value is stored as an array of its type name and the value, so it can
+// be restored with the same type.
+std::string RedisSessionStore::defaultEncoder(const Session::SessionMap &data)
+{
+    Json::Value root(Json::objectValue);
+    for (auto &item : data)
+    {
+        auto &value = item.second;
+        Json::Value pair(Json::arrayValue);
+        if (value.type() == typeid(std::string))
+        {
+            pair.append("string");
+            pair.append(std::any_cast<const std::string &>(value));
+        }
+        else if (value.type() == typeid(bool))
+        {
+            pair.append("bool");
+            pair.append(std::any_cast<bool>(value));
+        }
+        else if (value.type() == typeid(int))
+        {
+            pair.append("int");
+            pair.append(std::any_cast<int>(value));
+        }
+        else if (value.type() == typeid(unsigned int))
+        {
+            pair.append("uint");
+            pair.append(std::any_cast<unsigned int>(value));
+        }
+        else if (value.type() == typeid(int64_t))
+        {
+            pair.append("int64");
+            pair.append(Json::Int64(std::any_cast<int64_t>(value)));
+        }
+        else if (value.type() == typeid(uint64_t))
+        {
+            pair.append("uint64");
+            pair.append(Json::UInt64(std::any_cast<uint64_t>(value)));
+        }
+        else if (value.type() == typeid(double))
+        {
+            pair.append("double");
+            pair.append(std::any_cast<double>(value));
+        }
+        else if (value.type() == typeid(Json::Value))
+        {
+            pair.append("json");
+            pair.append(std::any_cast<const Json::Value &>(value));
+        }
+        else
+        {
+            LOG_WARN << "The session value of " << item.first
+                     << " can't be serialized by the default encoder";
+            continue;
+        }
+        root[item.first] = std::move(pair);
+    }
+    static const Json::StreamWriterBuilder builder = []() {
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        return builder;
+    }();
+    return Json::writeString(builder, root);
+}
+
+bool RedisSessionStore::defaultDecoder(const std::string &str,
+                                       Session::SessionMap &data)
+{
+    static const Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    Json::Value root;
+    std::string errs;
+    if (!reader->parse(str.data(), str.data() + str.size(), &root, &errs) ||
+        !root.isObject())
+        return false;
+    for (auto iter = root.begin(); iter != root.end(); ++iter)
+    {
+        auto &pair = *iter;
+        if (!pair.isArray() || pair.size() != 2 || !pair[0].isString())
+            return false;
+        auto type = pair[0].asString();
+        auto &value = pair[1];
+        auto key = iter.name();
+        if (type == "string" && value.isString())
+            data[key] = value.asString();
+        else if (type == "bool" && value.isBool())
+            data[key] = value.asBool();
+        else if (type == "int" && value.isInt())
+            data[key] = value.asInt();
+        else if (type == "uint" && value.isUInt())
+            data[key] = value.asUInt();
+        else if (type == "int64" && value.isInt64())
+            data[key] = int64_t(value.asInt64());
+        else if (type == "uint64" && value.isUInt64())
+            data[key] = uint64_t(value.asUInt64());
+        else if (type == "double" && value.isNumeric())
+            data[key] = value.asDouble();
+        else if (type == "json")
+            data[key] = value;
+        else
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,218 @@
+/**
+ *  @file RequestBatcher.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/plugins/RequestBatcher.h>
+#include <drogon/HttpAppFramework.h>
+#include "HttpRequestImpl.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace drogon;
+using namespace drogon::plugin;
+
+void RequestBatcher::initAndStart(const Json::Value &config)
+{
+    path_ = config.get("path", path_).asString();
+    maxRequests_ = config.get("max_requests", 20).asUInt64();
+    if (config.isMember("forward_headers"))
+    {
+        forwardHeaders_.clear();
+        for (auto const &header : config["forward_headers"])
+        {
+            auto field = header.asString();
+            std::transform(field.begin(),
+                           field.end(),
+                           field.begin(),
+                           [](unsigned char c) { return tolower(c); });
+            forwardHeaders_.push_back(std::move(field));
+        }
+    }
+    forwardCookies_ = config.get("forward_cookies", true).asBool();
+    app().registerHandler(
+        path_,
+        [this](const HttpRequestPtr &req,
+               std::function<void(const HttpResponsePtr &)> &&callback) {
+            handleBatch(req, std::move(callback));
+        },
+        {Post},
+        "RequestBatcher");
+}
+
+void RequestBatcher::shutdown()
+{
+}
+
+static HttpResponsePtr newBadRequestResponse(const std::string &message)
+{
+    Json::Value body;
+    body["error"] = message;
+    auto resp = HttpResponse::newHttpJsonResponse(std::move(body));
+    resp->setStatusCode(k400BadRequest);
+    return resp;
+}
+
+void RequestBatcher::handleBatch(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    auto &json = req->jsonObject();
+    if (!json)
+    {
+        callback(newBadRequestResponse("The body must be a json object"));
+        return;
+    }
+    auto &items = json->isArray() ? *json : (*json)["requests"];
+    if (!items.isArray() || items.empty())
+    {
+        callback(newBadRequestResponse("No requests"));
+        return;
+    }
+    if (items.size() > maxRequests_)
+    {
+        callback(newBadRequestResponse("Too many requests, the maximum is " +
+                                       std::to_string(maxRequests_)));
+        return;
+    }
+
+    // Each response is set by one sub-request, the last one to finish sends
+    // the batch response.
+    struct Batch
+    {
+        std::vector<Json::Value> responses;
+        std::atomic<size_t> pending{0};
+        std::function<void(const HttpResponsePtr &)> callback;
+    };
+
+    auto batch = std::make_shared<Batch>();
+    batch->responses.resize(items.size());
+    batch->pending.store(items.size(), std::memory_order_relaxed);
+    batch->callback = std::move(callback);
+    auto done = [batch]() {
+        if (batch->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        Json::Value body;
+        auto &responses = body["responses"];
+        responses = Json::Value(Json::arrayValue);
+        for (auto &response : batch->responses)
+        {
+            responses.append(std::move(response));
+        }
+        batch->callback(HttpResponse::newHttpJsonResponse(std::move(body)));
+    };
+    for (Json::ArrayIndex i = 0; i < items.size(); ++i)
+    {
+        std::string error;
+        auto subReq = makeSubRequest(req, items[i], error);
+        if (!subReq)
+        {
+            auto &response = batch->responses[i];
+            response["status"] = static_cast<int>(k400BadRequest);
+            response["error"] = error;
+            done();
+            continue;
+        }
+        app().forward(subReq, [batch, i, done](const HttpResponsePtr &resp) {
+            batch->responses[i] = toJson(resp);
+            done();
+        });
+    }
+}
+
+HttpRequestPtr RequestBatcher::makeSubRequest(const HttpRequestPtr &batchReq,
+                                              const Json::Value &item,
+                                              std::string &error) const
+{
+    if (!item.isObject() || !item["path"].isString())
+    {
+        error = "A request must be an object with a path";
+        return nullptr;
+    }
+    auto target = item["path"].asString();
+    auto pos = target.find('?');
+    auto path = target.substr(0, pos);
+    if (path.empty() || path[0] != '/')
+    {
+        error = "Bad path " + target;
+        return nullptr;
+    }
+    if (path == path_)
+    {
+        error = "Batch requests can't be nested";
+        return nullptr;
+    }
+    auto batchReqImpl = static_cast<HttpRequestImpl *>(batchReq.get());
+    auto subReq = std::make_shared<HttpRequestImpl>(batchReqImpl->getLoop());
+    auto method = item.get("method", "GET").asString();
+    if (!subReq->setMethod(method.data(), method.data() + method.length()))
+    {
+        error = "Bad method " + method;
+        return nullptr;
+    }
+    subReq->setVersion(batchReq->version());
+    subReq->setPath(std::move(path));
+    if (pos != std::string::npos)
+        subReq->setQuery(target.substr(pos + 1));
+    subReq->setPeerAddr(batchReq->peerAddr());
+    subReq->setLocalAddr(batchReq->localAddr());
+    subReq->setSecure(batchReq->isOnSecureConnection());
+    auto &headers = item["headers"];
+    if (headers.isObject())
+    {
+        for (auto field : headers.getMemberNames())
+        {
+            auto value = headers[field].asString();
+            std::transform(field.begin(),
+                           field.end(),
+                           field.begin(),
+                           [](unsigned char c) { return tolower(c); });
+            if (field == "content-type")
+                subReq->setContentTypeString(value);
+            else
+                subReq->addHeader(std::move(field), std::move(value));
+        }
+    }
+    for (auto const &field : forwardHeaders_)
+    {
+        auto &value = batchReq->getHeader(field);
+        if (!value.empty() && subReq->getHeader(field).empty())
+            subReq->addHeader(field, value);
+    }
+    if (forwardCookies_)
+    {
+        for (auto const &cookie : batchReq->cookies())
+        {
+            subReq->addCookie(cookie.first, cookie.second);
+        }
+    }
+    if (item.isMember("body"))
+        subReq->setBody(item["body"].asString());
+    return subReq;
+}
+
+Json::Value RequestBatcher::toJson(const HttpResponsePtr &resp)
+{
+    Json::Value response;
+    response["status"] = static_cast<int>(resp->statusCode());
+    auto &headers = response["headers"];
+    headers = Json::Value(Json::objectValue);
+    auto contentType = resp->contentTypeString();
+    if (!contentType.empty())
+        headers["content-type"] = contentType;
+    for (auto const &header : resp->headers())
+    {
+        headers[header.first] = header.second;
+    }
+    response["body"] = std::string(resp->body());
+    return response;
+}
@@ -0,0 +1,71 @@
+/**
+ *
+ *  @file RequestDeadline.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/RequestDeadline.h>
+#include <drogon/HttpRequest.h>
+
+using namespace drogon;
+
+static thread_local trantor::Date currentDeadline;
+static thread_local std::weak_ptr<HttpRequest> currentRequest_;
+
+RequestDeadline::Scope::Scope(const trantor::Date &deadline,
+                              std::weak_ptr<HttpRequest> request)
+    : previousDeadline_(currentDeadline),
+      previousRequest_(std::move(currentRequest_))
+{
+    currentDeadline = deadline;
+    currentRequest_ = std::move(request);
+}
+
+RequestDeadline::Scope::~Scope()
+{
+    currentDeadline = previousDeadline_;
+    currentRequest_ = std::move(previousRequest_);
+}
+
+const trantor::Date &RequestDeadline::current()
+{
+    return currentDeadline;
+}
+
+std::weak_ptr<HttpRequest> RequestDeadline::currentRequest()
+{
+    return currentRequest_;
+}
+
+bool RequestDeadline::hasCurrent()
+{
+    return currentDeadline.microSecondsSinceEpoch() > 0 ||
+           !currentRequest_.expired();
+}
+
+bool RequestDeadline::cancelled()
+{
+    auto req = currentRequest_.lock();
+    return req && req->isCancelled();
+}
+
+double RequestDeadline::clampTimeout(double timeout)
+{
+    if (currentDeadline.microSecondsSinceEpoch() <= 0)
+        return timeout > 0.0 ? timeout : 0.0;
+    auto left = static_cast<double>(
+                    currentDeadline.microSecondsSinceEpoch() -
+                    trantor::Date::now().microSecondsSinceEpoch()) /
+                1000000.0;
+    if (left <= 0.0)
+        return -1.0;
+    return timeout > 0.0 && timeout < left ? timeout : left;
+}
@@ -0,0 +1,172 @@
+/**
+ *
+ *  @file RequestTrace.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/RequestTrace.h>
+#include <chrono>
+#include <random>
+
+using namespace drogon;
+
+static thread_local std::shared_ptr<RequestTrace> currentTrace;
+
+static std::mt19937_64 &generator()
+{
+    static thread_local std::mt19937_64 gen{std::random_device{}()};
+    return gen;
+}
+
+static std::string randomId(size_t bytes)
+{
+    static const char hex[] = "0123456789abcdef";
+    std::string id(bytes * 2, '0');
+    // An id made of zeros is invalid.
+    while (id.find_first_not_of('0') == std::string::npos)
+    {
+        for (size_t i = 0; i < id.size(); i += 16)
+        {
+            auto value = generator()();
+            for (size_t j = 0; j < 16 && i + j < id.size(); ++j)
+            {
+                id[i + j] = hex[value & 0xf];
+                value >>= 4;
+            }
+        }
+    }
+    return id;
+}
+
+static bool isValidId(std::string_view id)
+{
+    bool nonZero{false};
+    for (auto c : id)
+    {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+            return false;
+        nonZero = nonZero || c != '0';
+    }
+    return nonZero;
+}
+
+RequestTrace::Scope::Scope(std::shared_ptr<RequestTrace> trace)
+    : previous_(std::move(currentTrace))
+{
+    currentTrace = std::move(trace);
+}
+
+RequestTrace::Scope::~Scope()
+{
+    currentTrace = std::move(previous_);
+}
+
+std::shared_ptr<RequestTrace> RequestTrace::sample(std::string_view traceParent,
+                                                   double sampleRatio)
+{
+    // version "-" trace-id "-" parent-id "-" trace-flags, e.g.
+    // 00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01
+    if (traceParent.size() >= 55 && traceParent.substr(0, 2) != "ff" &&
+        traceParent[2] == '-' && traceParent[35] == '-' &&
+        traceParent[52] == '-' && isValidId(traceParent.substr(3, 32)) &&
+        isValidId(traceParent.substr(36, 16)))
+    {
+        // The lowest bit of the flags is the sampled flag.
+        auto flag = traceParent[54];
+        int bits = flag >= 'a' ? flag - 'a' + 10 : flag - '0';
+        if ((bits & 1) == 0)
+        {
+            // Not sampled by the caller.
+            return nullptr;
+        }
+        auto trace = std::make_shared<RequestTrace>();
+        trace->traceId_ = std::string(traceParent.substr(3, 32));
+        trace->parentSpanId_ = std::string(traceParent.substr(36, 16));
+        trace->spanId_ = randomId(8);
+        trace->mark(Stage::Received);
+        return trace;
+    }
+    if (sampleRatio <= 0)
+        return nullptr;
+    if (sampleRatio < 1 &&
+        std::uniform_real_distribution<double>(0, 1)(generator()) >=
+            sampleRatio)
+    {
+        return nullptr;
+    }
+    auto trace = std::make_shared<RequestTrace>();
+    trace->traceId_ = randomId(16);
+    trace->spanId_ = randomId(8);
+    trace->mark(Stage::Received);
+    return trace;
+}
+
+const std::shared_ptr<RequestTrace> &RequestTrace::current()
+{
+    return currentTrace;
+}
+
+std::string RequestTrace::traceParent() const
+{
+    return "00-" + traceId_ + "-" + spanId_ + "-01";
+}
+
+const char *RequestTrace::stageName(Stage stage)
+{
+    switch (stage)
+    {
+        case Stage::Received:
+            return "pre_routing";
+        case Stage::Routing:
+            return "routing";
+        case Stage::PostRouting:
+            return "post_routing";
+        case Stage::Middlewares:
+            return "middlewares";
+        case Stage::PreHandling:
+            return "pre_handling";
+        case Stage::Handling:
+            return "handler";
+        case Stage::Response:
+            return "response";
+        default:
+            return "sent";
+    }
+}
+
+RequestTrace::Span RequestTrace::startSpan(std::string name) const
+{
+    Span span;
+    span.name = std::move(name);
+    span.spanId = randomId(8);
+    span.start = now();
+    return span;
+}
+
+void RequestTrace::endSpan(Span &&span)
+{
+    span.end = now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    spans_.emplace_back(std::move(span));
+}
+
+std::vector<RequestTrace::Span> RequestTrace::spans() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return spans_;
+}
+
+int64_t RequestTrace::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
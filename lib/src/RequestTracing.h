@@ -0,0 +1,45 @@
+/**
+ *
+ *  @file RequestTracing.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <drogon/RequestTrace.h>
+#include <functional>
+
+namespace drogon
+{
+/**
+ * @brief The tracing of the requests by the framework.
+ *
+ * It is set by the TraceExporter plugin before the listeners start and is
+ * never changed afterwards, requests aren't traced while there is no exporter.
+ */
+struct RequestTracing
+{
+    double sampleRatio{0};
+    // Called with every sampled request once its response is rendered.
+    std::function<void(const HttpRequestPtr &,
+                       const HttpResponsePtr &,
+                       const RequestTrace &)>
+        exporter;
+
+    static RequestTracing &instance()
+    {
+        static RequestTracing tracing;
+        return tracing;
+    }
+};
+}  // namespace drogon
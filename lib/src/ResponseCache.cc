@@ -0,0 +1,281 @@
+/**
+ *
+ *  @file ResponseCache.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "HttpResponseImpl.h"
+#include <drogon/ResponseCache.h>
+#include <drogon/utils/Utilities.h>
+#include <trantor/utils/Date.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+using namespace drogon;
+
+namespace
+{
+double now()
+{
+    return static_cast<double>(
+               trantor::Date::now().microSecondsSinceEpoch()) /
+           1000000.0;
+}
+
+std::string lowerCase(std::string_view str)
+{
+    std::string lower{str};
+    std::transform(lower.begin(),
+                   lower.end(),
+                   lower.begin(),
+                   [](unsigned char c) { return tolower(c); });
+    return lower;
+}
+
+// The statuses cacheable by default, see RFC 9110 section 15.1.
+bool isCacheableStatus(HttpStatusCode code)
+{
+    switch (code)
+    {
+        case k200OK:
+        case k203NonAuthoritativeInformation:
+        case k204NoContent:
+        case k300MultipleChoices:
+        case k301MovedPermanently:
+        case k308PermanentRedirect:
+        case k404NotFound:
+        case k405MethodNotAllowed:
+        case k410Gone:
+        case k414RequestURITooLarge:
+        case k501NotImplemented:
+            return true;
+        default:
+            return false;
+    }
+}
+
+struct CacheControl
+{
+    double maxAge{-1.0};
+    double staleWhileRevalidate{0.0};
+    // Set by no-store, no-cache or private.
+    bool noCache{false};
+};
+
+CacheControl parseCacheControl(const std::string &header)
+{
+    CacheControl cacheControl;
+    double maxAge = -1.0;
+    double sharedMaxAge = -1.0;
+    for (auto directive : utils::splitStringView(header, ","))
+    {
+        auto pos = directive.find('=');
+        auto name = lowerCase(utils::trim(directive.substr(0, pos)));
+        double value = 0.0;
+        if (pos != std::string_view::npos)
+        {
+            std::string arg{utils::trim(directive.substr(pos + 1))};
+            value = atof(arg.c_str());
+        }
+        if (name == "no-store" || name == "no-cache" || name == "private")
+            cacheControl.noCache = true;
+        else if (name == "max-age")
+            maxAge = value;
+        else if (name == "s-maxage")
+            sharedMaxAge = value;
+        else if (name == "stale-while-revalidate")
+            cacheControl.staleWhileRevalidate = value;
+    }
+    cacheControl.maxAge = sharedMaxAge >= 0.0 ? sharedMaxAge : maxAge;
+    return cacheControl;
+}
+}  // namespace
+
+std::string ResponseCache::makeKey(
+    const HttpRequestPtr &req,
+    const std::vector<std::string> &varyHeaders) const
+{
+    std::string key{req->methodString()};
+    key.append(1, ' ').append(req->path());
+    key.append(1, '?').append(req->query());
+    for (auto &name : varyHeaders)
+    {
+        key.append(1, '\n').append(name).append(1, ':');
+        key.append(req->getHeader(name));
+    }
+    return key;
+}
+
+void ResponseCache::invoke(const HttpRequestPtr &req,
+                           MiddlewareNextCallback &&nextCb,
+                           MiddlewareCallback &&mcb)
+{
+    if (req->method() != Get && req->method() != Head)
+    {
+        nextCb(std::move(mcb));
+        return;
+    }
+    auto storeCallback = [this, req](const HttpResponsePtr &resp) {
+        store(req, resp);
+    };
+    if (parseCacheControl(req->getHeader("cache-control")).noCache)
+    {
+        nextCb([storeCallback, mcb = std::move(mcb)](
+                   const HttpResponsePtr &resp) {
+            storeCallback(resp);
+            mcb(resp);
+        });
+        return;
+    }
+    HttpResponsePtr cachedResp;
+    double age = 0.0;
+    bool refresh = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto baseKey = makeKey(req, {});
+        auto varyIter = varyHeaders_.find(baseKey);
+        auto key = varyIter == varyHeaders_.end() || varyIter->second.empty()
+                       ? std::move(baseKey)
+                       : makeKey(req, varyIter->second);
+        auto iter = entriesMap_.find(key);
+        if (iter != entriesMap_.end())
+        {
+            auto entry = iter->second;
+            age = now() - entry->storedAt;
+            if (age < entry->maxAge + entry->staleWhileRevalidate)
+            {
+                if (age >= entry->maxAge && !entry->refreshing)
+                {
+                    entry->refreshing = true;
+                    refresh = true;
+                }
+                cachedResp = entry->response;
+                entries_.splice(entries_.begin(), entries_, entry);
+            }
+            else
+            {
+                entriesMap_.erase(iter);
+                entries_.erase(entry);
+            }
+        }
+    }
+    if (!cachedResp)
+    {
+        nextCb([storeCallback, mcb = std::move(mcb)](
+                   const HttpResponsePtr &resp) {
+            storeCallback(resp);
+            mcb(resp);
+        });
+        return;
+    }
+    // Every request gets its own response object sharing the body, the
+    // cached one is never modified.
+    auto resp = std::make_shared<HttpResponseImpl>(
+        *static_cast<HttpResponseImpl *>(cachedResp.get()));
+    resp->addHeader("age", std::to_string(static_cast<int64_t>(age)));
+    mcb(resp);
+    if (refresh)
+    {
+        // The response of the handler is only stored.
+        nextCb(std::move(storeCallback));
+    }
+}
+
+void ResponseCache::store(const HttpRequestPtr &req,
+                          const HttpResponsePtr &resp)
+{
+    if (!resp)
+        return;
+    auto respImpl = static_cast<HttpResponseImpl *>(resp.get());
+    auto cacheControl = parseCacheControl(resp->getHeader("cache-control"));
+    std::vector<std::string> varyHeaders;
+    for (auto name : utils::splitStringView(resp->getHeader("vary"), ","))
+    {
+        if (name == "*")
+        {
+            cacheControl.maxAge = -1.0;
+            break;
+        }
+        varyHeaders.emplace_back(lowerCase(name));
+    }
+    std::sort(varyHeaders.begin(), varyHeaders.end());
+    auto baseKey = makeKey(req, {});
+    auto key = makeKey(req, varyHeaders);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = entriesMap_.find(key);
+    if (iter != entriesMap_.end())
+    {
+        auto entry = iter->second;
+        entriesMap_.erase(iter);
+        entries_.erase(entry);
+    }
+    if (cacheControl.noCache || cacheControl.maxAge <= 0.0 ||
+        maxEntries_ == 0 || !isCacheableStatus(resp->statusCode()) ||
+        !resp->getHeader("set-cookie").empty() ||
+        !resp->cookies().empty() || respImpl->streamCallback() ||
+        respImpl->asyncStreamCallback() || !respImpl->sendfileName().empty() ||
+        resp->body().length() > maxBodySize_)
+        return;
+    varyHeaders_[std::move(baseKey)] = std::move(varyHeaders);
+    entries_.push_front(
+        Entry{std::move(key),
+              std::make_shared<HttpResponseImpl>(*respImpl),
+              now(),
+              cacheControl.maxAge,
+              cacheControl.staleWhileRevalidate});
+    auto &entry = entries_.front();
+    entriesMap_.emplace(entry.key, entries_.begin());
+    while (entries_.size() > maxEntries_)
+    {
+        entriesMap_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+}
+
+void ResponseCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entriesMap_.clear();
+    entries_.clear();
+    varyHeaders_.clear();
+}
+
+void ResponseCache::erase(std::string_view path)
+{
+    // The keys are "method path?query" followed by the varying headers.
+    auto matches = [path](const std::string &key) {
+        auto pos = key.find(' ');
+        return key.compare(pos + 1, path.length(), path) == 0 &&
+               key.length() > pos + 1 + path.length() &&
+               key[pos + 1 + path.length()] == '?';
+    };
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto iter = entries_.begin(); iter != entries_.end();)
+    {
+        if (matches(iter->key))
+        {
+            entriesMap_.erase(iter->key);
+            iter = entries_.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+    for (auto iter = varyHeaders_.begin(); iter != varyHeaders_.end();)
+    {
+        if (matches(iter->first))
+            iter = varyHeaders_.erase(iter);
+        else
+            ++iter;
+    }
+}
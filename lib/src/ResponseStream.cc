@@ -0,0 +1,292 @@
+/**
+ *
+ *  ResponseStream.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "HttpRequestParser.h"
+#include "OutputWatermark.h"
+#include "StreamCompressor.h"
+#include <drogon/HttpResponse.h>
+#include <trantor/net/TcpConnection.h>
+#include <trantor/utils/Logger.h>
+#include <cassert>
+#include <cstdio>
+
+using namespace drogon;
+
+ResponseStream::ResponseStream(trantor::AsyncStreamPtr asyncStream)
+    : asyncStream_(std::move(asyncStream))
+{
+}
+
+ResponseStream::ResponseStream(trantor::AsyncStreamPtr asyncStream,
+                               std::weak_ptr<trantor::TcpConnection> connection)
+    : asyncStream_(std::move(asyncStream)), connection_(std::move(connection))
+{
+}
+
+ResponseStream::~ResponseStream()
+{
+    close();
+}
+
+bool ResponseStream::send(const std::string &data)
+{
+    return send(data.data(), data.length());
+}
+
+bool ResponseStream::send(const char *data, size_t length)
+{
+    if (!asyncStream_)
+    {
+        return false;
+    }
+    if (watermark_ && watermark_->policy() == BackpressurePolicy::Drop &&
+        !watermark_->writable())
+    {
+        return false;
+    }
+    if (!compressor_)
+    {
+        return sendChunk(data, length);
+    }
+    // An empty chunk would end the stream
+    if (length == 0)
+    {
+        return true;
+    }
+    std::string compressed;
+    if (!compressor_->compress(data, length, true, compressed))
+    {
+        return false;
+    }
+    return sendChunk(compressed.data(), compressed.length());
+}
+
+bool ResponseStream::sendChunk(const char *data, size_t length)
+{
+    return asyncStream_->send(frameChunk(data, length));
+}
+
+std::string ResponseStream::frameChunk(const char *data, size_t length)
+{
+    // The chunk is framed in a single buffer, so it's copied only once before
+    // it's written to the connection.
+    char head[32];
+    auto headLength = snprintf(head, sizeof(head), "%zx\r\n", length);
+    std::string chunk;
+    chunk.reserve(headLength + length + 2);
+    chunk.append(head, headLength).append(data, length).append("\r\n");
+    return chunk;
+}
+
+bool ResponseStream::sendFramedChunk(const std::string &chunk)
+{
+    if (!asyncStream_)
+    {
+        return false;
+    }
+    if (compressor_)
+    {
+        auto pos = chunk.find("\r\n");
+        assert(pos != std::string::npos && chunk.length() >= pos + 4);
+        return send(chunk.data() + pos + 2, chunk.length() - pos - 4);
+    }
+    if (watermark_ && watermark_->policy() == BackpressurePolicy::Drop &&
+        !watermark_->writable())
+    {
+        return false;
+    }
+    return asyncStream_->send(chunk);
+}
+
+void ResponseStream::close()
+{
+    if (asyncStream_)
+    {
+        if (compressor_)
+        {
+            std::string tail;
+            if (compressor_->finish(tail) && !tail.empty())
+                sendChunk(tail.data(), tail.length());
+            compressor_.reset();
+        }
+        static std::string closeStream{"0\r\n\r\n"};
+        asyncStream_->send(closeStream);
+        asyncStream_->close();
+        asyncStream_.reset();
+    }
+}
+
+void ResponseStream::setBackpressure(
+    size_t highWaterMark,
+    BackpressurePolicy policy,
+    std::function<void(bool writable)> callback)
+{
+    auto conn = connection_.lock();
+    if (!conn)
+    {
+        LOG_WARN << "The backpressure of the stream isn't supported";
+        return;
+    }
+    auto watermark = std::make_shared<internal::OutputWatermark>(
+        highWaterMark, policy, std::move(callback));
+    watermark_ = watermark;
+    conn->getLoop()->runInLoop([conn, watermark]() {
+        auto requestParser = conn->getContext<HttpRequestParser>();
+        if (requestParser)
+            requestParser->addOutputWatermark(conn, watermark);
+    });
+}
+
+bool ResponseStream::writable() const
+{
+    return !watermark_ || watermark_->writable();
+}
+
+JsonArrayStream::JsonArrayStream(ResponseStreamPtr stream, size_t flushSize)
+    : stream_(std::move(stream)),
+      writer_(buffer_, JsonWriter::appOptions()),
+      flushSize_(flushSize)
+{
+    buffer_.reserve(flushSize_ + flushSize_ / 4);
+    writer_.startArray();
+}
+
+JsonArrayStream::~JsonArrayStream()
+{
+    close();
+}
+
+bool JsonArrayStream::flush()
+{
+    if (!good_)
+        return false;
+    if (buffer_.empty())
+        return true;
+    good_ = stream_ && stream_->send(buffer_);
+    buffer_.clear();
+    return good_;
+}
+
+void JsonArrayStream::close()
+{
+    if (!stream_)
+        return;
+    if (good_)
+    {
+        writer_.endArray();
+        flush();
+    }
+    stream_->close();
+    stream_.reset();
+    good_ = false;
+}
+
+SseStream::SseStream(ResponseStreamPtr stream) : stream_(std::move(stream))
+{
+}
+
+SseStream::~SseStream()
+{
+    close();
+}
+
+std::string SseStream::formatEvent(std::string_view data,
+                                   std::string_view event,
+                                   std::string_view id)
+{
+    std::string text;
+    text.reserve(data.length() + event.length() + id.length() + 24);
+    auto appendField = [&text](std::string_view name, std::string_view value) {
+        text.append(name).append(": ");
+        for (auto c : value)
+        {
+            if (c != '\r' && c != '\n')
+                text += c;
+        }
+        text += '\n';
+    };
+    if (!id.empty())
+        appendField("id", id);
+    if (!event.empty())
+        appendField("event", event);
+    // Every line of the data is a data field, the lines may end with CRLF,
+    // LF or CR.
+    size_t start = 0;
+    while (true)
+    {
+        auto pos = data.find_first_of("\r\n", start);
+        text.append("data: ");
+        if (pos == std::string_view::npos)
+        {
+            text.append(data.substr(start)).append("\n");
+            break;
+        }
+        text.append(data.substr(start, pos - start)).append("\n");
+        if (data[pos] == '\r' && pos + 1 < data.length() &&
+            data[pos + 1] == '\n')
+            ++pos;
+        start = pos + 1;
+        if (start == data.length())
+            break;
+    }
+    text += '\n';
+    return text;
+}
+
+bool SseStream::send(std::string_view data,
+                     std::string_view event,
+                     std::string_view id)
+{
+    return sendText(formatEvent(data, event, id));
+}
+
+bool SseStream::sendComment(std::string_view comment)
+{
+    std::string text{":"};
+    for (auto c : comment)
+    {
+        if (c != '\r' && c != '\n')
+            text += c;
+    }
+    text.append("\n\n");
+    return sendText(text);
+}
+
+bool SseStream::sendRetry(size_t milliseconds)
+{
+    return sendText("retry: " + std::to_string(milliseconds) + "\n\n");
+}
+
+void SseStream::close()
+{
+    if (stream_)
+    {
+        stream_->close();
+        stream_.reset();
+    }
+}
+
+bool SseStream::sendText(const std::string &text)
+{
+    return stream_ && stream_->send(text);
+}
+
+bool SseStream::sendFramedChunk(const std::string &chunk)
+{
+    return stream_ && stream_->sendFramedChunk(chunk);
+}
+
+std::string SseStream::frameChunk(const std::string &text)
+{
+    return ResponseStream::frameChunk(text.data(), text.length());
+}
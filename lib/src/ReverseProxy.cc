@@ -0,0 +1,549 @@
+/**
+ *  @file ReverseProxy.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/plugins/ReverseProxy.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/RequestStream.h>
+#include <trantor/net/TcpConnection.h>
+#include "HttpAppFrameworkImpl.h"
+#include "HttpRequestImpl.h"
+#include <stdexcept>
+
+using namespace drogon;
+using namespace drogon::plugin;
+
+namespace
+{
+// The headers which only concern one connection, RFC 9110 section 7.6.1.
+bool isHopByHopHeader(const std::string &field)
+{
+    return field == "connection" || field == "keep-alive" ||
+           field == "proxy-connection" || field == "te" ||
+           field == "trailer" || field == "transfer-encoding" ||
+           field == "upgrade";
+}
+
+void removeHopByHopHeaders(const HttpResponsePtr &resp)
+{
+    for (auto field : {"connection",
+                       "keep-alive",
+                       "proxy-connection",
+                       "te",
+                       "trailer",
+                       "transfer-encoding",
+                       "upgrade"})
+    {
+        resp->removeHeader(field);
+    }
+}
+
+// The body of a streamed response, received before the server is ready to
+// send it when the response waits behind the previous ones of its
+// connection.
+struct DownstreamBody
+{
+    ResponseStreamPtr stream;
+    std::string pending;
+    bool started{false};
+    bool ended{false};
+    bool failed{false};
+};
+
+// Close the connection so that the client sees the body is cut short, the
+// last chunk would make it look complete.
+void abortBody(DownstreamBody &body,
+               const std::weak_ptr<trantor::TcpConnection> &weakConn)
+{
+    body.failed = true;
+    if (auto conn = weakConn.lock())
+        conn->forceClose();
+    body.stream.reset();
+}
+
+// The response with the status and the headers of the upstream one, its body
+// is sent from the stream if it has one.
+HttpResponsePtr newDownstreamResponse(
+    const HttpResponsePtr &upstreamResp,
+    const std::shared_ptr<DownstreamBody> &body)
+{
+    HttpResponsePtr resp;
+    if (body)
+    {
+        resp = HttpResponse::newAsyncStreamResponse(
+            [body](ResponseStreamPtr stream) {
+                body->started = true;
+                if (!body->pending.empty())
+                {
+                    stream->send(body->pending.data(), body->pending.length());
+                    std::string().swap(body->pending);
+                }
+                if (body->failed)
+                    return;
+                if (body->ended)
+                {
+                    stream->close();
+                    return;
+                }
+                body->stream = std::move(stream);
+            },
+            true);
+        // The body is relayed as it is, usually already compressed.
+        resp->setAllowCompression(false);
+    }
+    else
+    {
+        resp = HttpResponse::newHttpResponse();
+    }
+    resp->setStatusCode(upstreamResp->statusCode());
+    auto &framework = HttpAppFrameworkImpl::instance();
+    const auto &contentType = upstreamResp->getHeader("content-type");
+    if (contentType.empty())
+        resp->setContentTypeCode(CT_NONE);
+    else
+        resp->setContentTypeString(contentType);
+    for (auto &[field, value] : upstreamResp->headers())
+    {
+        // The server writes its own framing and the headers it adds itself.
+        if (isHopByHopHeader(field) || field == "content-length" ||
+            field == "content-type" ||
+            (field == "date" && framework.sendDateHeader()) ||
+            (field == "server" && framework.sendServerHeader()))
+            continue;
+        resp->addHeader(field, value);
+    }
+    for (auto &[name, cookie] : upstreamResp->cookies())
+    {
+        (void)name;
+        resp->addCookie(cookie);
+    }
+    return resp;
+}
+
+bool hasBody(HttpStatusCode code)
+{
+    return code >= 200 && code != k204NoContent && code != k304NotModified;
+}
+
+HttpResponsePtr errorResponse(ReqResult result, const HttpRequestPtr &req)
+{
+    return app().getCustomErrorHandler()(result == ReqResult::Timeout
+                                             ? k504GatewayTimeout
+                                             : k502BadGateway,
+                                         req);
+}
+}  // namespace
+
+void ReverseProxy::initAndStart(const Json::Value &config)
+{
+    for (auto &upstream : config["upstreams"])
+    {
+        upstreams_.emplace_back(
+            std::make_unique<Upstream>(upstream.asString()));
+    }
+    if (upstreams_.empty())
+    {
+        throw std::runtime_error(
+            "ReverseProxy: at least one upstream server must be set");
+    }
+    pathPrefix_ = config.get("path_prefix", "").asString();
+    stripPrefix_ = config.get("strip_prefix", false).asBool();
+    connectionsPerUpstream_ =
+        (std::max)(config.get("connections_per_upstream", 4).asUInt(), 1u);
+    pipeliningDepth_ = config.get("pipelining", 0).asUInt();
+    sameClientToSameBackend_ =
+        config.get("same_client_to_same_backend", false).asBool();
+    timeout_ = config.get("timeout", timeout_).asDouble();
+    retries_ = config.get("retries", 1).asUInt();
+    maxFails_ = (std::max)(config.get("max_fails", 1).asUInt(), 1u);
+    failTimeout_ = config.get("fail_timeout", failTimeout_).asDouble();
+    xForwardedFor_ = config.get("x_forwarded_for", true).asBool();
+    auto &healthCheck = config["health_check"];
+    if (healthCheck.isObject())
+    {
+        healthCheckPath_ = healthCheck.get("path", "").asString();
+        healthCheckInterval_ =
+            healthCheck.get("interval", healthCheckInterval_).asDouble();
+        healthCheckTimeout_ =
+            healthCheck.get("timeout", healthCheckTimeout_).asDouble();
+    }
+
+    loopData_ = std::make_unique<IOThreadStorage<LoopData>>();
+    loopData_->init([this](LoopData &data, size_t) {
+        data.clients.resize(upstreams_.size());
+    });
+    if (!healthCheckPath_.empty() && healthCheckInterval_ > 0)
+    {
+        healthCheckTimer_ = app().getLoop()->runEvery(
+            healthCheckInterval_, [this]() { checkHealth(); });
+    }
+    app().registerPreRoutingAdvice([this](const HttpRequestPtr &req,
+                                          AdviceCallback &&callback,
+                                          AdviceChainCallback &&pass) {
+        preRouting(req, std::move(callback), std::move(pass));
+    });
+}
+
+void ReverseProxy::shutdown()
+{
+    if (healthCheckTimer_ != trantor::InvalidTimerId)
+    {
+        app().getLoop()->invalidateTimer(healthCheckTimer_);
+        healthCheckTimer_ = trantor::InvalidTimerId;
+    }
+}
+
+void ReverseProxy::preRouting(const HttpRequestPtr &req,
+                              AdviceCallback &&callback,
+                              AdviceChainCallback &&pass)
+{
+    if (!pathPrefix_.empty() &&
+        req->path().compare(0, pathPrefix_.length(), pathPrefix_) != 0)
+    {
+        pass();
+        return;
+    }
+    prepareRequest(req);
+    auto reqImpl = static_cast<HttpRequestImpl *>(req.get());
+    if (reqImpl->isStreamMode())
+    {
+        switch (reqImpl->streamStatus())
+        {
+            case ReqStreamStatus::Open:
+                forwardStreamedBody(req, std::move(callback));
+                return;
+            case ReqStreamStatus::Finish:
+                // The whole body is already received.
+                reqImpl->quitStreamMode();
+                break;
+            default:
+                callback(app().getCustomErrorHandler()(k400BadRequest, req));
+                return;
+        }
+        // The chunks are only decoded into a body with a content-length in
+        // the non-stream mode.
+        if (!req->getHeader("transfer-encoding").empty())
+        {
+            req->removeHeader("transfer-encoding");
+            req->addHeader("content-length",
+                           std::to_string(req->body().length()));
+        }
+    }
+    forward(req, std::move(callback), 0);
+}
+
+void ReverseProxy::prepareRequest(const HttpRequestPtr &req) const
+{
+    if (stripPrefix_ && !pathPrefix_.empty())
+    {
+        auto path = req->path().substr(pathPrefix_.length());
+        if (path.empty() || path[0] != '/')
+            path.insert(0, 1, '/');
+        req->setPath(std::move(path));
+    }
+    for (auto field : {"connection",
+                       "keep-alive",
+                       "proxy-connection",
+                       "te",
+                       "trailer",
+                       "upgrade"})
+    {
+        req->removeHeader(field);
+    }
+    if (xForwardedFor_)
+    {
+        auto forwardedFor = req->getHeader("x-forwarded-for");
+        if (!forwardedFor.empty())
+            forwardedFor.append(", ");
+        forwardedFor.append(req->getPeerAddr().toIp());
+        req->addHeader("x-forwarded-for", std::move(forwardedFor));
+    }
+}
+
+void ReverseProxy::forward(const HttpRequestPtr &req,
+                           AdviceCallback &&callback,
+                           size_t attempt)
+{
+    auto upstream = selectUpstream(req, attempt);
+    if (upstream < 0)
+    {
+        callback(app().getCustomErrorHandler()(k503ServiceUnavailable, req));
+        return;
+    }
+    auto client = selectClient(upstream);
+    // The request is sent as it was received, with its headers and body.
+    req->setPassThrough(true);
+    // The responses without a body, or to HTTP/1.0 clients which can't
+    // receive chunks, are relayed in whole.
+    if (req->method() == Head || req->version() == Version::kHttp10)
+    {
+        client->sendRequest(
+            req,
+            [this, req, upstream, attempt, callback = std::move(callback)](
+                ReqResult result, const HttpResponsePtr &resp) mutable {
+                reportResult(upstream, result);
+                if (result == ReqResult::Ok)
+                {
+                    removeHopByHopHeaders(resp);
+                    resp->setPassThrough(true);
+                    callback(resp);
+                }
+                else if (shouldRetry(req, attempt, result))
+                {
+                    forward(req, std::move(callback), attempt + 1);
+                }
+                else
+                {
+                    callback(errorResponse(result, req));
+                }
+            },
+            timeout_);
+        return;
+    }
+    auto body = std::make_shared<DownstreamBody>();
+    auto weakConn =
+        static_cast<HttpRequestImpl *>(req.get())->getConnectionPtr();
+    client->sendRequestForStream(
+        req,
+        [this, req, upstream, attempt, body, callback = std::move(callback)](
+            ReqResult result, const HttpResponsePtr &resp) mutable {
+            if (result != ReqResult::Ok)
+            {
+                reportResult(upstream, result);
+                if (shouldRetry(req, attempt, result))
+                    forward(req, std::move(callback), attempt + 1);
+                else
+                    callback(errorResponse(result, req));
+                return;
+            }
+            if (!hasBody(resp->statusCode()))
+            {
+                body->failed = true;
+                callback(newDownstreamResponse(resp, nullptr));
+                return;
+            }
+            callback(newDownstreamResponse(resp, body));
+        },
+        [body](const char *data, size_t length) {
+            if (body->failed)
+                return;
+            if (body->stream)
+            {
+                // The client is gone, the rest of the body is dropped.
+                if (!body->stream->send(data, length))
+                    body->failed = true;
+            }
+            else if (!body->started)
+            {
+                body->pending.append(data, length);
+            }
+        },
+        [this, upstream, body, weakConn](ReqResult result) {
+            reportResult(upstream, result);
+            body->ended = true;
+            if (result != ReqResult::Ok)
+            {
+                if (!body->failed)
+                    abortBody(*body, weakConn);
+                return;
+            }
+            if (body->stream)
+            {
+                body->stream->close();
+                body->stream.reset();
+            }
+        },
+        timeout_);
+}
+
+void ReverseProxy::forwardStreamedBody(const HttpRequestPtr &req,
+                                       AdviceCallback &&callback)
+{
+    auto upstream = selectUpstream(req, 0);
+    if (upstream < 0)
+    {
+        callback(app().getCustomErrorHandler()(k503ServiceUnavailable, req));
+        return;
+    }
+    auto client = selectClient(upstream);
+    // The body is sent in chunks which the client frames itself, so the
+    // request is rebuilt without the framing headers of the downstream one.
+    auto upstreamReq = HttpRequest::newHttpRequest();
+    upstreamReq->setMethod(req->method());
+    upstreamReq->setPath(req->path());
+    static_cast<HttpRequestImpl *>(upstreamReq.get())->setQuery(req->query());
+    const auto &contentType = req->getHeader("content-type");
+    if (!contentType.empty())
+        upstreamReq->setContentTypeString(contentType.data(),
+                                          contentType.length());
+    for (auto &[field, value] : req->headers())
+    {
+        if (isHopByHopHeader(field) || field == "content-length" ||
+            field == "content-type")
+            continue;
+        upstreamReq->addHeader(field, value);
+    }
+    for (auto &[name, value] : req->cookies())
+    {
+        upstreamReq->addCookie(name, value);
+    }
+    // The upstream requests aren't retried, their bodies are gone.
+    auto bodyStream = client->sendStreamRequest(
+        upstreamReq,
+        [this, req, upstream, callback = std::move(callback)](
+            ReqResult result, const HttpResponsePtr &resp) {
+            reportResult(upstream, result);
+            if (result != ReqResult::Ok)
+            {
+                callback(errorResponse(result, req));
+                return;
+            }
+            removeHopByHopHeaders(resp);
+            resp->setPassThrough(true);
+            callback(resp);
+        },
+        timeout_);
+    auto stream = internal::createRequestStream(req);
+    stream->setStreamReader(RequestBodyStream::newForwardReader(bodyStream));
+}
+
+bool ReverseProxy::isAvailable(const Upstream &upstream) const
+{
+    return upstream.healthy.load(std::memory_order_relaxed) &&
+           upstream.downUntil.load(std::memory_order_relaxed) <=
+               trantor::Date::now().microSecondsSinceEpoch();
+}
+
+int ReverseProxy::selectUpstream(const HttpRequestPtr &req, size_t attempt)
+{
+    auto &data = **loopData_;
+    auto upstreamsNum = upstreams_.size();
+    size_t start;
+    if (sameClientToSameBackend_)
+    {
+        start = std::hash<uint32_t>{}(req->getPeerAddr().ipNetEndian()) +
+                attempt;
+    }
+    else
+    {
+        start = data.next++;
+    }
+    for (size_t i = 0; i < upstreamsNum; ++i)
+    {
+        auto index = (start + i) % upstreamsNum;
+        if (isAvailable(*upstreams_[index]))
+            return static_cast<int>(index);
+    }
+    return -1;
+}
+
+HttpClientPtr ReverseProxy::selectClient(size_t upstream)
+{
+    auto &clients = (**loopData_).clients[upstream];
+    HttpClientPtr best;
+    size_t bestLoad{0};
+    for (auto &client : clients)
+    {
+        auto load = client->outstandingRequests();
+        if (!best || load < bestLoad)
+        {
+            best = client;
+            bestLoad = load;
+        }
+    }
+    // All the connections are busy, open a new one if it is allowed.
+    if (!best || (bestLoad > 0 && clients.size() < connectionsPerUpstream_))
+    {
+        best = HttpClient::newHttpClient(
+            upstreams_[upstream]->address,
+            trantor::EventLoop::getEventLoopOfCurrentThread());
+        best->setPipeliningDepth(pipeliningDepth_);
+        clients.push_back(best);
+    }
+    return best;
+}
+
+bool ReverseProxy::shouldRetry(const HttpRequestPtr &req,
+                               size_t attempt,
+                               ReqResult result) const
+{
+    if (attempt >= retries_ || result == ReqResult::BadServerAddress)
+        return false;
+    // The other ones may have been processed by the upstream server.
+    switch (req->method())
+    {
+        case Get:
+        case Head:
+        case Options:
+        case Put:
+        case Delete:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void ReverseProxy::reportResult(size_t upstream, ReqResult result)
+{
+    auto &state = *upstreams_[upstream];
+    // Cancelled by the framework, not a failure of the server.
+    if (result == ReqResult::Cancelled)
+        return;
+    if (result == ReqResult::Ok)
+    {
+        state.fails.store(0, std::memory_order_relaxed);
+        return;
+    }
+    if (state.fails.fetch_add(1, std::memory_order_relaxed) + 1 < maxFails_)
+        return;
+    state.fails.store(0, std::memory_order_relaxed);
+    state.downUntil.store(trantor::Date::now()
+                              .after(failTimeout_)
+                              .microSecondsSinceEpoch(),
+                          std::memory_order_relaxed);
+    LOG_WARN << "The upstream server " << state.address << " failed ("
+             << result << "), it isn't used for " << failTimeout_
+             << " seconds";
+}
+
+void ReverseProxy::checkHealth()
+{
+    for (auto &upstream : upstreams_)
+    {
+        auto state = upstream.get();
+        if (!state->checker)
+        {
+            state->checker =
+                HttpClient::newHttpClient(state->address, app().getLoop());
+        }
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath(healthCheckPath_);
+        state->checker->sendRequest(
+            req,
+            [state](ReqResult result, const HttpResponsePtr &resp) {
+                bool healthy = result == ReqResult::Ok &&
+                               resp->statusCode() >= 200 &&
+                               resp->statusCode() < 400;
+                if (state->healthy.exchange(healthy,
+                                            std::memory_order_relaxed) ==
+                    healthy)
+                    return;
+                if (healthy)
+                    LOG_INFO << "The upstream server " << state->address
+                             << " is healthy again";
+                else
+                    LOG_WARN << "The upstream server " << state->address
+                             << " failed the health check";
+            },
+            healthCheckTimeout_);
+    }
+}
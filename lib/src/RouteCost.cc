@@ -0,0 +1,61 @@
+/**
+ *
+ *  @file RouteCost.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "RouteCost.h"
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace drogon;
+
+double RouteCostScope::threadCpuTime()
+{
+#ifdef _WIN32
+    // In units of 100ns, updated at the ticks of the scheduler.
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+    auto toTicks = [](const FILETIME &time) {
+        return ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime;
+    };
+    return (double)(toTicks(kernel) + toTicks(user)) / 1e7;
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+void RouteCostScope::finish()
+{
+    auto cpuTime = threadCpuTime() - cpuStart_;
+    auto allocations = AllocationCounter::current();
+    accounting() = false;
+    // The allocations made below are not counted
+    std::string route{route_};
+    if (route.empty())
+        route = "none";
+    auto &metrics = BuiltinMetrics::instance();
+    metrics.routeCpuTime->metric({route})->increment(cpuTime);
+    if (allocations.allocations == allocationsStart_.allocations)
+        return;
+    metrics.routeAllocations->metric({route})->increment(
+        (double)(allocations.allocations - allocationsStart_.allocations));
+    metrics.routeAllocatedBytes->metric({route})->increment(
+        (double)(allocations.bytes - allocationsStart_.bytes));
+}
@@ -0,0 +1,72 @@
+/**
+ *
+ *  @file RouteCost.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/utils/AllocationCounter.h>
+#include <string_view>
+#include "BuiltinMetrics.h"
+
+namespace drogon
+{
+/**
+ * @brief Add the cpu time and the allocations of the calling thread while
+ * the scope lives to the route costs of the built-in metrics, if they are
+ * enabled.
+ *
+ * The scopes opened while another one is open on the thread, e.g. for a
+ * response sent synchronously by its handler, are accounted by the outer
+ * one.
+ */
+class RouteCostScope
+{
+  public:
+    explicit RouteCostScope(std::string_view route)
+    {
+        if (!BuiltinMetrics::instance().routeCpuTime || accounting())
+            return;
+        accounting() = true;
+        active_ = true;
+        route_ = route;
+        cpuStart_ = threadCpuTime();
+        allocationsStart_ = AllocationCounter::current();
+    }
+
+    ~RouteCostScope()
+    {
+        if (active_)
+            finish();
+    }
+
+    RouteCostScope(const RouteCostScope &) = delete;
+    RouteCostScope &operator=(const RouteCostScope &) = delete;
+
+    // The cpu time of the calling thread in seconds.
+    static double threadCpuTime();
+
+  private:
+    void finish();
+
+    static bool &accounting()
+    {
+        static thread_local bool accounting{false};
+        return accounting;
+    }
+
+    bool active_{false};
+    std::string_view route_;
+    double cpuStart_{0};
+    AllocationCounter::Counts allocationsStart_;
+};
+}  // namespace drogon
@@ -0,0 +1,145 @@
+#include <drogon/plugins/RuntimeStats.h>
+#include <drogon/HttpAppFramework.h>
+#include <chrono>
+#include <mutex>
+#include "HttpAppFrameworkImpl.h"
+#include "HttpServer.h"
+
+using namespace drogon;
+using namespace drogon::plugin;
+
+namespace
+{
+// The stats being collected from the IO loops for a request
+struct Collection
+{
+    std::mutex mutex;
+    Json::Value loops{Json::arrayValue};
+    size_t remaining{0};
+    std::function<void(const HttpResponsePtr &)> callback;
+};
+}  // namespace
+
+static Json::Value loopStatsToJson(const HttpServer::LoopStats &stats)
+{
+    Json::Value json;
+    json["connections"] = (Json::UInt64)stats.connections;
+    json["http2_connections"] = (Json::UInt64)stats.http2Connections;
+    json["websocket_connections"] = (Json::UInt64)stats.webSocketConnections;
+    json["pipelined_requests"] = (Json::UInt64)stats.pipelinedRequests;
+    json["pooled_requests"] = (Json::UInt64)stats.pooledRequests;
+    json["buffered_bytes"] = (Json::UInt64)stats.bufferedBytes;
+    json["memory_usage"] = (Json::UInt64)stats.memoryUsage;
+    return json;
+}
+
+static Json::Value clientStats()
+{
+    auto &app = HttpAppFrameworkImpl::instance();
+    Json::Value json;
+    json["db_clients"] = Json::objectValue;
+    for (auto &name : app.getDbClientNames())
+    {
+        auto client = app.getDbClient(name);
+        if (!client)
+            continue;
+        auto stats = client->connectionStats();
+        auto &item = json["db_clients"][name];
+        item["busy"] = (Json::UInt64)stats.busy;
+        item["idle"] = (Json::UInt64)stats.idle;
+        item["pending"] = (Json::UInt64)stats.pending;
+    }
+    json["redis_clients"] = Json::objectValue;
+    for (auto &name : app.getRedisClientNames())
+    {
+        auto client = app.getRedisClient(name);
+        if (!client)
+            continue;
+        auto stats = client->connectionStats();
+        auto &item = json["redis_clients"][name];
+        item["connected"] = (Json::UInt64)stats.connected;
+        item["total"] = (Json::UInt64)stats.total;
+        item["pending"] = (Json::UInt64)stats.pending;
+    }
+    return json;
+}
+
+void RuntimeStats::initAndStart(const Json::Value &config)
+{
+    path_ = config.get("path", path_).asString();
+    const Json::Value &allowIps = config["allow_ips"];
+    if (allowIps.isNull())
+    {
+        allowIps_.add("127.0.0.1");
+        allowIps_.add("::1");
+    }
+    else if (!allowIps.isArray())
+    {
+        throw std::runtime_error("RuntimeStats: allow_ips should be an array");
+    }
+    for (const auto &ipOrCidr : allowIps)
+    {
+        allowIps_.add(ipOrCidr.asString());
+    }
+
+    std::weak_ptr<RuntimeStats> weakPtr = shared_from_this();
+    app().registerHandler(
+        path_,
+        [weakPtr](const HttpRequestPtr &req,
+                  std::function<void(const HttpResponsePtr &)> &&callback) {
+            auto thisPtr = weakPtr.lock();
+            if (!thisPtr)
+            {
+                callback(HttpResponse::newNotFoundResponse(req));
+                return;
+            }
+            thisPtr->handleStats(req, std::move(callback));
+        },
+        {Get},
+        "RuntimeStats");
+}
+
+void RuntimeStats::shutdown()
+{
+}
+
+void RuntimeStats::handleStats(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    if (!allowIps_.contains(req->peerAddr()))
+    {
+        callback(HttpResponse::newHttpResponse(k403Forbidden, CT_NONE));
+        return;
+    }
+    auto &app = drogon::app();
+    auto collection = std::make_shared<Collection>();
+    collection->remaining = app.getThreadNum();
+    collection->loops.resize((Json::ArrayIndex)collection->remaining);
+    collection->callback = std::move(callback);
+    for (size_t i = 0; i < app.getThreadNum(); ++i)
+    {
+        auto queued = std::chrono::steady_clock::now();
+        app.getIOLoop(i)->queueInLoop([collection, i, queued]() {
+            auto item = loopStatsToJson(HttpServer::loopStats());
+            item["loop"] = (Json::UInt64)i;
+            item["queue_delay"] =
+                std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - queued)
+                    .count();
+            {
+                std::lock_guard<std::mutex> lock(collection->mutex);
+                collection->loops[(Json::ArrayIndex)i] = std::move(item);
+                if (--collection->remaining > 0)
+                    return;
+            }
+            // The last loop responds
+            auto json = clientStats();
+            json["connections"] =
+                (Json::Int64)drogon::app().getConnectionCount();
+            json["loops"] = std::move(collection->loops);
+            collection->callback(
+                HttpResponse::newHttpJsonResponse(std::move(json)));
+        });
+    }
+}
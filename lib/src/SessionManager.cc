@@ -21,24 +21,59 @@ SessionManager::SessionManager(
     size_t timeout,
     const std::vector<AdviceStartSessionCallback> &startAdvices,
     const std::vector<AdviceDestroySessionCallback> &destroyAdvices,
-    IdGeneratorCallback idGeneratorCallback)
+    IdGeneratorCallback idGeneratorCallback,
+    SessionStorePtr store,
+    size_t localCacheTimeout,
+    double writeBehindInterval)
     : loop_(loop),
       timeout_(timeout),
+      cacheTimeout_(timeout),
+      store_(std::move(store)),
       sessionStartAdvices_(startAdvices),
       sessionDestroyAdvices_(destroyAdvices),
       idGeneratorCallback_(idGeneratorCallback)
 {
-    if (timeout_ > 0)
+    std::function<void(const std::string &)> onInsert =
+        [this](const std::string &key) {
+            for (auto &advice : sessionStartAdvices_)
+            {
+                advice(key);
+            }
+        };
+    std::function<void(const std::string &)> onErase =
+        [this](const std::string &key) {
+            for (auto &advice : sessionDestroyAdvices_)
+            {
+                advice(key);
+            }
+        };
+    if (store_)
+    {
+        // The sessions are only cached locally for a short time since they
+        // may be changed by other nodes. They are started and destroyed in
+        // the store, not in the cache.
+        if (localCacheTimeout == 0)
+            localCacheTimeout = 1;
+        if (timeout_ == 0 || localCacheTimeout < timeout_)
+            cacheTimeout_ = localCacheTimeout;
+        onInsert = nullptr;
+        onErase = nullptr;
+        if (writeBehindInterval <= 0)
+            writeBehindInterval = 0.5;
+        flushTimerId_ =
+            loop_->runEvery(writeBehindInterval, [this]() { flush(); });
+    }
+    if (cacheTimeout_ > 0)
     {
         size_t wheelNum = 1;
         size_t bucketNum = 0;
-        if (timeout_ < 500)
+        if (cacheTimeout_ < 500)
         {
-            bucketNum = timeout_ + 1;
+            bucketNum = cacheTimeout_ + 1;
         }
         else
         {
-            auto tmpTimeout = timeout_;
+            auto tmpTimeout = cacheTimeout_;
             bucketNum = 100;
             while (tmpTimeout > 100)
             {
@@ -47,48 +82,30 @@ SessionManager::SessionManager(
             }
         }
 
-        sessionMapPtr_ = std::unique_ptr<CacheMap<std::string, SessionPtr>>(
-            new CacheMap<std::string, SessionPtr>(
+        sessionMapPtr_ =
+            std::make_unique<ShardedCacheMap<std::string, SessionPtr>>(
                 loop_,
                 1.0,
                 wheelNum,
                 bucketNum,
-                [this](const std::string &key) {
-                    for (auto &advice : sessionStartAdvices_)
-                    {
-                        advice(key);
-                    }
-                },
-                [this](const std::string &key) {
-                    for (auto &advice : sessionDestroyAdvices_)
-                    {
-                        advice(key);
-                    }
-                }));
+                std::move(onInsert),
+                std::move(onErase));
     }
-    else if (timeout_ == 0)
+    else
     {
-        sessionMapPtr_ = std::unique_ptr<CacheMap<std::string, SessionPtr>>(
-            new CacheMap<std::string, SessionPtr>(
-                loop_,
-                0,
-                0,
-                0,
-                [this](const std::string &key) {
-                    for (auto &advice : sessionStartAdvices_)
-                    {
-                        advice(key);
-                    }
-                },
-                [this](const std::string &key) {
-                    for (auto &advice : sessionDestroyAdvices_)
-                    {
-                        advice(key);
-                    }
-                }));
+        sessionMapPtr_ =
+            std::make_unique<ShardedCacheMap<std::string, SessionPtr>>(
+                loop_, 0, 0, 0, std::move(onInsert), std::move(onErase));
     }
 }
 
+SessionManager::~SessionManager()
+{
+    if (store_)
+        loop_->invalidateTimer(flushTimerId_);
+    sessionMapPtr_.reset();
+}
+
 SessionPtr SessionManager::getSession(const std::string &sessionID,
                                       bool needToSet)
 {
@@ -108,21 +125,138 @@ SessionPtr SessionManager::getSession(const std::string &sessionID,
                 sessionInCache = sessionPtr;
             }
         },
-        timeout_);
+        cacheTimeout_);
 
     return sessionPtr;
 }
 
+SessionPtr SessionManager::findSession(const std::string &sessionID,
+                                       bool needToSet)
+{
+    // A new session ID is generated for the request, so the session can't be
+    // in the store.
+    if (!store_ || needToSet)
+    {
+        auto sessionPtr = getSession(sessionID, needToSet);
+        if (store_ && needToSet)
+        {
+            for (auto &advice : sessionStartAdvices_)
+            {
+                advice(sessionID);
+            }
+        }
+        return sessionPtr;
+    }
+    SessionPtr sessionPtr;
+    if (sessionMapPtr_->findAndFetch(sessionID, sessionPtr))
+        return sessionPtr;
+    return nullptr;
+}
+
+void SessionManager::loadSession(
+    const std::string &sessionID,
+    std::function<void(const SessionPtr &)> &&callback)
+{
+    assert(store_);
+    auto loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    assert(loop);
+    store_->load(
+        sessionID,
+        [this, loop, sessionID, callback = std::move(callback)](
+            bool found, Session::SessionMap &&data) mutable {
+            loop->runInLoop([this,
+                             found,
+                             data = std::move(data),
+                             sessionID = std::move(sessionID),
+                             callback = std::move(callback)]() mutable {
+                SessionPtr sessionPtr;
+                bool created{false};
+                // The session may be loaded by another request meanwhile
+                sessionMapPtr_->modify(
+                    sessionID,
+                    [&](SessionPtr &sessionInCache) {
+                        if (!sessionInCache)
+                        {
+                            sessionInCache = std::shared_ptr<Session>(
+                                new Session(sessionID, false));
+                            sessionInCache->sessionMap_ = std::move(data);
+                            created = !found;
+                        }
+                        sessionPtr = sessionInCache;
+                    },
+                    cacheTimeout_);
+                if (created)
+                {
+                    for (auto &advice : sessionStartAdvices_)
+                    {
+                        advice(sessionID);
+                    }
+                }
+                callback(sessionPtr);
+            });
+        });
+}
+
+void SessionManager::sessionAccessed(const SessionPtr &sessionPtr)
+{
+    if (!store_)
+        return;
+    std::lock_guard<std::mutex> lock(accessedSessionsMutex_);
+    accessedSessions_.insert(sessionPtr);
+}
+
+void SessionManager::flush()
+{
+    std::unordered_set<SessionPtr> sessions;
+    {
+        std::lock_guard<std::mutex> lock(accessedSessionsMutex_);
+        sessions.swap(accessedSessions_);
+    }
+    if (sessions.empty())
+        return;
+    std::vector<SessionStore::SessionData> changedSessions;
+    std::vector<std::string> unchangedSessions;
+    for (auto &sessionPtr : sessions)
+    {
+        std::lock_guard<std::mutex> lock(sessionPtr->mutex_);
+        if (sessionPtr->dirty_)
+        {
+            sessionPtr->dirty_ = false;
+            changedSessions.emplace_back(sessionPtr->sessionId_,
+                                         sessionPtr->sessionMap_);
+        }
+        else
+        {
+            unchangedSessions.push_back(sessionPtr->sessionId_);
+        }
+    }
+    if (!changedSessions.empty())
+        store_->save(std::move(changedSessions), timeout_);
+    if (!unchangedSessions.empty() && timeout_ > 0)
+        store_->touch(std::move(unchangedSessions), timeout_);
+}
+
 void SessionManager::changeSessionId(const SessionPtr &sessionPtr)
 {
     auto oldId = sessionPtr->sessionId();
     auto newId = idGeneratorCallback_();
     sessionPtr->setSessionId(newId);
-    sessionMapPtr_->insert(newId, sessionPtr, timeout_);
+    sessionMapPtr_->insert(newId, sessionPtr, cacheTimeout_);
+    if (store_)
+    {
+        // Save the session with the new ID
+        {
+            std::lock_guard<std::mutex> lock(sessionPtr->mutex_);
+            sessionPtr->dirty_ = true;
+        }
+        sessionAccessed(sessionPtr);
+    }
     // For requests sent before setting the new session ID to the client, we
     // reserve the old session slot for a period of time.
     sessionMapPtr_->runAfter(10, [this, oldId = std::move(oldId)]() {
         LOG_TRACE << "remove the old slot of the session";
         sessionMapPtr_->erase(oldId);
+        if (store_)
+            store_->erase(oldId);
     });
 }
@@ -16,13 +16,15 @@
 
 #include <drogon/Session.h>
 #include <drogon/drogon_callbacks.h>
-#include <drogon/CacheMap.h>
+#include <drogon/ShardedCacheMap.h>
+#include <drogon/SessionStore.h>
 #include <trantor/utils/NonCopyable.h>
 #include <trantor/net/EventLoop.h>
 #include <functional>
 #include <memory>
 #include <string>
 #include <mutex>
+#include <unordered_set>
 #include <vector>
 
 namespace drogon
@@ -37,20 +39,56 @@ class SessionManager : public trantor::NonCopyable
         size_t timeout,
         const std::vector<AdviceStartSessionCallback> &startAdvices,
         const std::vector<AdviceDestroySessionCallback> &destroyAdvices,
-        IdGeneratorCallback idGeneratorCallback);
+        IdGeneratorCallback idGeneratorCallback,
+        SessionStorePtr store = nullptr,
+        size_t localCacheTimeout = 0,
+        double writeBehindInterval = 0);
 
-    ~SessionManager()
-    {
-        sessionMapPtr_.reset();
-    }
+    ~SessionManager();
 
     SessionPtr getSession(const std::string &sessionID, bool needToSet);
+
+    /**
+     * @brief Find the session in the local cache, return nullptr if a session
+     * store is used and the session must be loaded from the store.
+     */
+    SessionPtr findSession(const std::string &sessionID, bool needToSet);
+
+    /**
+     * @brief Load the session from the session store, the callback is called
+     * in the current loop.
+     */
+    void loadSession(const std::string &sessionID,
+                     std::function<void(const SessionPtr &)> &&callback);
+
+    /**
+     * @brief Mark the session as accessed, it's written back to the session
+     * store later if it's changed.
+     */
+    void sessionAccessed(const SessionPtr &sessionPtr);
+
     void changeSessionId(const SessionPtr &sessionPtr);
 
+    /// Write the changed sessions back to the session store.
+    void flush();
+
+    bool hasStore() const
+    {
+        return store_ != nullptr;
+    }
+
   private:
-    std::unique_ptr<CacheMap<std::string, SessionPtr>> sessionMapPtr_;
+
+    std::unique_ptr<ShardedCacheMap<std::string, SessionPtr>> sessionMapPtr_;
     trantor::EventLoop *loop_;
     size_t timeout_;
+    // The timeout of the sessions in sessionMapPtr_
+    size_t cacheTimeout_;
+    SessionStorePtr store_;
+    trantor::TimerId flushTimerId_{0};
+    // The sessions accessed since the last flush
+    std::unordered_set<SessionPtr> accessedSessions_;
+    std::mutex accessedSessionsMutex_;
     const std::vector<AdviceStartSessionCallback> &sessionStartAdvices_;
     const std::vector<AdviceDestroySessionCallback> &sessionDestroyAdvices_;
     IdGeneratorCallback idGeneratorCallback_;
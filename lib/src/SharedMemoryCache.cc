@@ -0,0 +1,623 @@
+/**
+ *
+ *  @file SharedMemoryCache.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/SharedMemoryCache.h>
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace drogon;
+
+namespace
+{
+constexpr uint64_t kMagic = 0x3145484341435244;  // "DRCACHE1"
+constexpr size_t kWays = 8;
+constexpr size_t kEntrySize = 64;
+constexpr size_t kMinChunkSize = 64;
+constexpr uint32_t kMaxSizeClasses = 32;
+// A lookup gives up after so many tries while the entry is being changed,
+// e.g. if its writer died.
+constexpr int kMaxReadTries = 1000;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The atomics in the shared memory must be lock-free");
+
+uint64_t hashOf(std::string_view key)
+{
+    // FNV-1a, the same in all the processes, never 0 which marks the empty
+    // entries.
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : key)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+int64_t now()
+{
+    // The steady clock is the one of the host, the same in all the processes.
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+uint64_t processId()
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint64_t>(getpid());
+#endif
+}
+
+bool isDeadProcess(uint64_t pid)
+{
+#ifdef _WIN32
+    (void)pid;
+    return false;
+#else
+    return kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH;
+#endif
+}
+
+#ifndef _WIN32
+std::runtime_error systemError(const std::string &what,
+                               const std::string &name)
+{
+    return std::runtime_error("SharedMemoryCache " + name + ": " + what +
+                              ": " + strerror(errno));
+}
+#endif
+}  // namespace
+
+struct SharedMemoryCache::Header
+{
+    // Set last by the process creating the segment.
+    std::atomic<uint64_t> magic;
+    uint64_t bucketsNum;
+    uint64_t pageSize;
+    uint64_t pagesNum;
+    uint64_t entriesOffset;
+    uint64_t dataOffset;
+    // The pid of the process holding the lock, 0 if it's free.
+    std::atomic<uint64_t> writer;
+    std::atomic<uint64_t> entriesNum;
+    // The fields below are only used under the lock.
+    uint64_t nextPage;
+    uint64_t evictionHand;
+    // The offset + 1 of the first free chunk of each size class, 0 if there
+    // is none. A free chunk starts with the offset + 1 of the next one.
+    uint64_t freeChunks[kMaxSizeClasses];
+};
+
+struct SharedMemoryCache::Entry
+{
+    // Odd while the entry is changed.
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> keySize;
+    std::atomic<uint32_t> valueSize;
+    std::atomic<uint32_t> sizeClass;
+    // 0 if the entry is empty.
+    std::atomic<uint64_t> hash;
+    // The offset of the chunk of the key and the value.
+    std::atomic<uint64_t> offset;
+    // The time in microseconds of the steady clock, 0 if the value doesn't
+    // expire.
+    std::atomic<int64_t> expiry;
+};
+
+SharedMemoryCache::SharedMemoryCache(const std::string &name)
+    : SharedMemoryCache(name, Options{})
+{
+}
+
+SharedMemoryCache::SharedMemoryCache(const std::string &name,
+                                     const Options &options)
+{
+#ifdef _WIN32
+    (void)options;
+    throw std::runtime_error("SharedMemoryCache " + name +
+                             ": shared memory is not supported on Windows");
+#else
+    static_assert(sizeof(Entry) <= kEntrySize,
+                  "The entries must fit in a cache line");
+    size_t pageSize = kMinChunkSize;
+    uint32_t sizeClassesNum = 1;
+    while (pageSize < options.pageSize)
+    {
+        pageSize <<= 1;
+        ++sizeClassesNum;
+    }
+    if (sizeClassesNum > kMaxSizeClasses)
+        throw std::runtime_error("SharedMemoryCache " + name +
+                                 ": the page size is too large");
+    size_t bucketsNum = std::max<size_t>(1, (options.maxEntries + kWays - 1) /
+                                                kWays);
+    size_t pagesNum = std::max<size_t>(1, options.memorySize / pageSize);
+    size_t entriesOffset =
+        (sizeof(Header) + kEntrySize - 1) / kEntrySize * kEntrySize;
+    size_t dataOffset = entriesOffset + bucketsNum * kWays * kEntrySize;
+    size_t segmentSize = dataOffset + pagesNum * pageSize;
+
+    auto path = "/" + name;
+    bool created = true;
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST)
+    {
+        created = false;
+        fd = shm_open(path.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0)
+        throw systemError("shm_open", name);
+    if (created)
+    {
+        if (ftruncate(fd, static_cast<off_t>(segmentSize)) != 0)
+        {
+            auto error = systemError("ftruncate", name);
+            close(fd);
+            shm_unlink(path.c_str());
+            throw error;
+        }
+    }
+    else
+    {
+        // Wait for the size set by the process creating the segment.
+        struct stat st;
+        for (int i = 0;; ++i)
+        {
+            if (fstat(fd, &st) != 0)
+            {
+                auto error = systemError("fstat", name);
+                close(fd);
+                throw error;
+            }
+            if (st.st_size > 0)
+                break;
+            if (i == 1000)
+            {
+                close(fd);
+                throw std::runtime_error("SharedMemoryCache " + name +
+                                         ": the segment is empty");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        segmentSize = static_cast<size_t>(st.st_size);
+        if (segmentSize < sizeof(Header))
+        {
+            close(fd);
+            throw std::runtime_error("SharedMemoryCache " + name +
+                                     ": not a segment of the cache");
+        }
+    }
+    auto data = mmap(nullptr,
+                     segmentSize,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED,
+                     fd,
+                     0);
+    if (data == MAP_FAILED)
+    {
+        auto error = systemError("mmap", name);
+        close(fd);
+        if (created)
+            shm_unlink(path.c_str());
+        throw error;
+    }
+    close(fd);
+    segment_ = static_cast<char *>(data);
+    segmentSize_ = segmentSize;
+    if (created)
+    {
+        // The memory is zeroed: the entries are empty and the lock is free.
+        header_ = new (segment_) Header();
+        header_->bucketsNum = bucketsNum;
+        header_->pageSize = pageSize;
+        header_->pagesNum = pagesNum;
+        header_->entriesOffset = entriesOffset;
+        header_->dataOffset = dataOffset;
+        header_->magic.store(kMagic, std::memory_order_release);
+    }
+    else
+    {
+        header_ = reinterpret_cast<Header *>(segment_);
+        for (int i = 0;
+             header_->magic.load(std::memory_order_acquire) != kMagic;
+             ++i)
+        {
+            if (i == 1000)
+            {
+                munmap(segment_, segmentSize_);
+                throw std::runtime_error("SharedMemoryCache " + name +
+                                         ": not a segment of the cache");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (header_->dataOffset + header_->pagesNum * header_->pageSize !=
+            segmentSize_)
+        {
+            munmap(segment_, segmentSize_);
+            throw std::runtime_error("SharedMemoryCache " + name +
+                                     ": the segment is corrupted");
+        }
+    }
+    options_.pageSize = header_->pageSize;
+    options_.memorySize = header_->pagesNum * header_->pageSize;
+    options_.maxEntries = header_->bucketsNum * kWays;
+#endif
+}
+
+SharedMemoryCache::~SharedMemoryCache()
+{
+#ifndef _WIN32
+    if (segment_)
+        munmap(segment_, segmentSize_);
+#endif
+}
+
+void SharedMemoryCache::remove(const std::string &name)
+{
+#ifndef _WIN32
+    shm_unlink(("/" + name).c_str());
+#else
+    (void)name;
+#endif
+}
+
+SharedMemoryCache::Entry *SharedMemoryCache::entryAt(size_t index) const
+{
+    return reinterpret_cast<Entry *>(segment_ + header_->entriesOffset +
+                                     index * kEntrySize);
+}
+
+size_t SharedMemoryCache::bucketOf(uint64_t hash) const
+{
+    return static_cast<size_t>(hash % header_->bucketsNum);
+}
+
+bool SharedMemoryCache::readEntry(const Entry &entry,
+                                  uint64_t hash,
+                                  std::string_view key,
+                                  std::string *value) const
+{
+    const char *data = segment_ + header_->dataOffset;
+    const uint64_t dataSize = header_->pagesNum * header_->pageSize;
+    for (int i = 0; i < kMaxReadTries; ++i)
+    {
+        auto sequence = entry.sequence.load(std::memory_order_acquire);
+        if (sequence & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        bool found = false;
+        if (entry.hash.load(std::memory_order_relaxed) == hash &&
+            entry.keySize.load(std::memory_order_relaxed) == key.size())
+        {
+            auto offset = entry.offset.load(std::memory_order_relaxed);
+            auto valueSize = entry.valueSize.load(std::memory_order_relaxed);
+            auto expiry = entry.expiry.load(std::memory_order_relaxed);
+            // The fields may be torn while the entry is changed, they are
+            // checked before the memory is read.
+            if (offset <= dataSize &&
+                key.size() + valueSize <= dataSize - offset &&
+                memcmp(data + offset, key.data(), key.size()) == 0 &&
+                (expiry == 0 || expiry > now()))
+            {
+                found = true;
+                if (value)
+                    value->assign(data + offset + key.size(), valueSize);
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry.sequence.load(std::memory_order_relaxed) == sequence)
+            return found;
+    }
+    return false;
+}
+
+bool SharedMemoryCache::matchesKey(const Entry &entry,
+                                   uint64_t hash,
+                                   std::string_view key) const
+{
+    // Under the lock, the entry doesn't change.
+    return entry.hash.load(std::memory_order_relaxed) == hash &&
+           entry.keySize.load(std::memory_order_relaxed) == key.size() &&
+           memcmp(segment_ + header_->dataOffset +
+                      entry.offset.load(std::memory_order_relaxed),
+                  key.data(),
+                  key.size()) == 0;
+}
+
+bool SharedMemoryCache::findAndFetch(std::string_view key,
+                                     std::string &value) const
+{
+    auto hash = hashOf(key);
+    auto first = bucketOf(hash) * kWays;
+    std::string found;
+    for (size_t i = 0; i < kWays; ++i)
+    {
+        if (readEntry(*entryAt(first + i), hash, key, &found))
+        {
+            value = std::move(found);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<std::string> SharedMemoryCache::find(std::string_view key) const
+{
+    std::string value;
+    if (findAndFetch(key, value))
+        return value;
+    return std::nullopt;
+}
+
+size_t SharedMemoryCache::size() const
+{
+    return static_cast<size_t>(
+        header_->entriesNum.load(std::memory_order_relaxed));
+}
+
+bool SharedMemoryCache::insert(std::string_view key,
+                               std::string_view value,
+                               double timeout)
+{
+    auto size = key.size() + value.size();
+    if (size > header_->pageSize)
+        return false;
+    uint32_t sizeClass = 0;
+    while ((kMinChunkSize << sizeClass) < size)
+        ++sizeClass;
+    auto hash = hashOf(key);
+    auto expiry =
+        timeout > 0 ? now() + static_cast<int64_t>(timeout * 1000000) : 0;
+    auto first = bucketOf(hash) * kWays;
+    char *data = segment_ + header_->dataOffset;
+    lock();
+    // The entry of the key, else an empty one, else the one expiring first.
+    size_t target = first;
+    bool found = false;
+    bool empty = false;
+    int64_t firstExpiry = std::numeric_limits<int64_t>::max();
+    for (size_t i = first; i < first + kWays; ++i)
+    {
+        auto &entry = *entryAt(i);
+        auto entryHash = entry.hash.load(std::memory_order_relaxed);
+        if (entryHash == 0)
+        {
+            if (!empty)
+            {
+                target = i;
+                empty = true;
+            }
+            continue;
+        }
+        if (matchesKey(entry, hash, key))
+        {
+            target = i;
+            found = true;
+            break;
+        }
+        auto entryExpiry = entry.expiry.load(std::memory_order_relaxed);
+        if (!empty && entryExpiry != 0 && entryExpiry < firstExpiry)
+        {
+            target = i;
+            firstExpiry = entryExpiry;
+        }
+    }
+    auto &entry = *entryAt(target);
+    uint64_t offset;
+    if (!allocate(sizeClass, target, offset))
+    {
+        // The old value is not kept instead of the new one.
+        if (found)
+            clearEntry(entry);
+        unlock();
+        return false;
+    }
+    // The chunk may have been read through an entry cleared by allocate(),
+    // which must be seen changed before the chunk is.
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(data + offset, key.data(), key.size());
+    memcpy(data + offset + key.size(), value.data(), value.size());
+    bool replaced = entry.hash.load(std::memory_order_relaxed) != 0;
+    auto oldSizeClass = entry.sizeClass.load(std::memory_order_relaxed);
+    auto oldOffset = entry.offset.load(std::memory_order_relaxed);
+    auto sequence = entry.sequence.load(std::memory_order_relaxed);
+    entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.hash.store(hash, std::memory_order_relaxed);
+    entry.keySize.store(static_cast<uint32_t>(key.size()),
+                        std::memory_order_relaxed);
+    entry.valueSize.store(static_cast<uint32_t>(value.size()),
+                          std::memory_order_relaxed);
+    entry.sizeClass.store(sizeClass, std::memory_order_relaxed);
+    entry.offset.store(offset, std::memory_order_relaxed);
+    entry.expiry.store(expiry, std::memory_order_relaxed);
+    entry.sequence.store(sequence + 2, std::memory_order_release);
+    if (replaced)
+        freeChunk(oldSizeClass, oldOffset);
+    else
+        header_->entriesNum.fetch_add(1, std::memory_order_relaxed);
+    unlock();
+    return true;
+}
+
+bool SharedMemoryCache::erase(std::string_view key)
+{
+    auto hash = hashOf(key);
+    auto first = bucketOf(hash) * kWays;
+    lock();
+    for (size_t i = first; i < first + kWays; ++i)
+    {
+        auto &entry = *entryAt(i);
+        if (matchesKey(entry, hash, key))
+        {
+            clearEntry(entry);
+            unlock();
+            return true;
+        }
+    }
+    unlock();
+    return false;
+}
+
+void SharedMemoryCache::clear()
+{
+    lock();
+    for (size_t i = 0; i < header_->bucketsNum * kWays; ++i)
+    {
+        auto &entry = *entryAt(i);
+        if (entry.hash.load(std::memory_order_relaxed) != 0)
+            clearEntry(entry);
+    }
+    unlock();
+}
+
+void SharedMemoryCache::lock()
+{
+    auto self = processId();
+    for (size_t spins = 1;; ++spins)
+    {
+        uint64_t owner = 0;
+        if (header_->writer.compare_exchange_weak(owner,
+                                                  self,
+                                                  std::memory_order_acquire,
+                                                  std::memory_order_relaxed))
+            return;
+        if (spins % 1024 != 0)
+            continue;
+        if (owner != 0 && owner != self && isDeadProcess(owner) &&
+            header_->writer.compare_exchange_strong(owner,
+                                                    self,
+                                                    std::memory_order_acquire,
+                                                    std::memory_order_relaxed))
+        {
+            LOG_WARN << "SharedMemoryCache: the process " << owner
+                     << " died holding the lock";
+            recoverAfterDeadWriter();
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void SharedMemoryCache::unlock()
+{
+    header_->writer.store(0, std::memory_order_release);
+}
+
+void SharedMemoryCache::recoverAfterDeadWriter()
+{
+    // The entries left changing are emptied and the entries are counted
+    // again. The memory of the entries left changing is lost, as the one of
+    // the chunks being moved to and from the free lists.
+    uint64_t entriesNum = 0;
+    for (size_t i = 0; i < header_->bucketsNum * kWays; ++i)
+    {
+        auto &entry = *entryAt(i);
+        auto sequence = entry.sequence.load(std::memory_order_relaxed);
+        if (sequence & 1)
+        {
+            entry.hash.store(0, std::memory_order_relaxed);
+            entry.sequence.store(sequence + 1, std::memory_order_release);
+        }
+        else if (entry.hash.load(std::memory_order_relaxed) != 0)
+        {
+            ++entriesNum;
+        }
+    }
+    header_->entriesNum.store(entriesNum, std::memory_order_relaxed);
+}
+
+bool SharedMemoryCache::allocate(uint32_t sizeClass,
+                                 size_t keep,
+                                 uint64_t &offset)
+{
+    auto &head = header_->freeChunks[sizeClass];
+    if (head == 0)
+    {
+        if (header_->nextPage < header_->pagesNum)
+        {
+            // Divide a new page into chunks of the size class.
+            auto chunkSize = kMinChunkSize << sizeClass;
+            auto page = header_->nextPage++ * header_->pageSize;
+            for (auto chunk = page + header_->pageSize; chunk > page;)
+            {
+                chunk -= chunkSize;
+                freeChunk(sizeClass, chunk);
+            }
+        }
+        else
+        {
+            // Evict the next entry of the size class after the clock hand,
+            // the pages are not given to other size classes.
+            auto entriesNum = header_->bucketsNum * kWays;
+            for (size_t i = 0; i < entriesNum && head == 0; ++i)
+            {
+                auto index = header_->evictionHand;
+                header_->evictionHand = (index + 1) % entriesNum;
+                auto &entry = *entryAt(index);
+                if (index != keep &&
+                    entry.hash.load(std::memory_order_relaxed) != 0 &&
+                    entry.sizeClass.load(std::memory_order_relaxed) ==
+                        sizeClass)
+                    clearEntry(entry);
+            }
+            if (head == 0)
+                return false;
+        }
+    }
+    offset = head - 1;
+    memcpy(&head, segment_ + header_->dataOffset + offset, sizeof(head));
+    return true;
+}
+
+void SharedMemoryCache::freeChunk(uint32_t sizeClass, uint64_t offset)
+{
+    auto &head = header_->freeChunks[sizeClass];
+    memcpy(segment_ + header_->dataOffset + offset, &head, sizeof(head));
+    head = offset + 1;
+}
+
+void SharedMemoryCache::clearEntry(Entry &entry)
+{
+    auto sequence = entry.sequence.load(std::memory_order_relaxed);
+    entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.hash.store(0, std::memory_order_relaxed);
+    entry.sequence.store(sequence + 2, std::memory_order_release);
+    freeChunk(entry.sizeClass.load(std::memory_order_relaxed),
+              entry.offset.load(std::memory_order_relaxed));
+    header_->entriesNum.fetch_sub(1, std::memory_order_relaxed);
+}
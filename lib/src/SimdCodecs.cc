@@ -0,0 +1,314 @@
+/**
+ *
+ *  @file SimdCodecs.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "SimdCodecs.h"
+#include <atomic>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#define DROGON_SIMD_CODECS
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+// The kernels are compiled for SSSE3 whatever the flags of the build, they
+// are only called after checking the CPU.
+#if defined(__GNUC__) || defined(__clang__)
+#define DROGON_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define DROGON_TARGET_SSSE3
+#endif
+#endif
+
+namespace drogon
+{
+namespace utils
+{
+namespace internal
+{
+#ifdef DROGON_SIMD_CODECS
+static bool cpuSupportsSsse3()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+#else
+static bool cpuSupportsSsse3()
+{
+    return false;
+}
+#endif
+
+static std::atomic<bool> &enabledFlag()
+{
+    // A function local static, the codecs may be used by static initializers.
+    static std::atomic<bool> flag{cpuSupportsSsse3()};
+    return flag;
+}
+
+void setSimdCodecsEnabled(bool enabled)
+{
+    enabledFlag().store(enabled && cpuSupportsSsse3(),
+                        std::memory_order_relaxed);
+}
+
+bool simdCodecsEnabled()
+{
+    return enabledFlag().load(std::memory_order_relaxed);
+}
+
+#ifdef DROGON_SIMD_CODECS
+// The base64 kernels are the ones described by Wojciech Mula and Daniel
+// Lemire in "Faster Base64 Encoding and Decoding Using AVX2 Instructions",
+// on 128 bits registers.
+DROGON_TARGET_SSSE3
+static size_t base64EncodeSsse3(const unsigned char *in,
+                                size_t length,
+                                unsigned char *out,
+                                bool urlSafe)
+{
+    const __m128i shuffle =
+        _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m128i shifts = _mm_setr_epi8('a' - 26,
+                                         '0' - 52,
+                                         '0' - 52,
+                                         '0' - 52,
+                                         '0' - 52,
+                                         '0' - 52,
+                                         '0' - 52,
+                                         '0' - 52,
+                                         '0' - 52,
+                                         '0' - 52,
+                                         '0' - 52,
+                                         urlSafe ? '-' - 62 : '+' - 62,
+                                         urlSafe ? '_' - 63 : '/' - 63,
+                                         'A',
+                                         0,
+                                         0);
+    size_t pos = 0;
+    // 16 bytes are loaded for every 12 bytes encoded.
+    for (; length - pos >= 16; pos += 12, out += 16)
+    {
+        __m128i input =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + pos));
+        input = _mm_shuffle_epi8(input, shuffle);
+        // Split every 3 bytes into 4 indexes of 6 bits.
+        __m128i t0 = _mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00));
+        __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        __m128i t2 = _mm_and_si128(input, _mm_set1_epi32(0x003f03f0));
+        __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        __m128i indexes = _mm_or_si128(t1, t3);
+        // Map the index ranges to the offsets of their characters.
+        __m128i ranges = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+        __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indexes);
+        ranges = _mm_or_si128(ranges, _mm_and_si128(upper, _mm_set1_epi8(13)));
+        __m128i chars =
+            _mm_add_epi8(_mm_shuffle_epi8(shifts, ranges), indexes);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), chars);
+    }
+    return pos;
+}
+
+DROGON_TARGET_SSSE3
+static inline __m128i inRange(__m128i chars, char low, char high)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(low - 1)),
+                         _mm_cmplt_epi8(chars, _mm_set1_epi8(high + 1)));
+}
+
+DROGON_TARGET_SSSE3
+static size_t base64DecodeSsse3(const char *in,
+                                size_t length,
+                                unsigned char *out)
+{
+    const __m128i pack =
+        _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t pos = 0;
+    for (; length - pos >= 16; pos += 16, out += 12)
+    {
+        __m128i chars =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + pos));
+        // The characters above 0x7f are negative and match no range.
+        __m128i upper = inRange(chars, 'A', 'Z');
+        __m128i lower = inRange(chars, 'a', 'z');
+        __m128i digit = inRange(chars, '0', '9');
+        __m128i plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+        __m128i minus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('-'));
+        __m128i slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+        __m128i underscore = _mm_cmpeq_epi8(chars, _mm_set1_epi8('_'));
+        __m128i valid = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, plus)),
+            _mm_or_si128(_mm_or_si128(minus, slash), underscore));
+        if (_mm_movemask_epi8(valid) != 0xffff)
+            break;
+        __m128i offsets = _mm_or_si128(
+            _mm_or_si128(
+                _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                             _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+                _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                             _mm_and_si128(plus, _mm_set1_epi8(62 - '+')))),
+            _mm_or_si128(
+                _mm_or_si128(_mm_and_si128(minus, _mm_set1_epi8(62 - '-')),
+                             _mm_and_si128(slash, _mm_set1_epi8(63 - '/'))),
+                _mm_and_si128(underscore, _mm_set1_epi8(63 - '_'))));
+        __m128i values = _mm_add_epi8(chars, offsets);
+        // Join 4 values of 6 bits into 3 bytes.
+        __m128i pairs =
+            _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        __m128i bytes = _mm_shuffle_epi8(words, pack);
+        // Only 12 bytes are written as the output buffer may end there.
+        char block[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(block), bytes);
+        memcpy(out, block, 12);
+    }
+    return pos;
+}
+
+DROGON_TARGET_SSSE3
+static size_t binaryToHexSsse3(const char *in,
+                               size_t length,
+                               char *out,
+                               bool lowerCase)
+{
+    const __m128i digits =
+        lowerCase ? _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                  '8', '9', 'a', 'b', 'c', 'd', 'e', 'f')
+                  : _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                  '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    size_t pos = 0;
+    for (; length - pos >= 16; pos += 16, out += 32)
+    {
+        __m128i bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + pos));
+        __m128i high = _mm_shuffle_epi8(
+            digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), mask));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                         _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16),
+                         _mm_unpackhi_epi8(high, low));
+    }
+    return pos;
+}
+
+// The values of 16 hex digits, returns false if a character isn't one.
+DROGON_TARGET_SSSE3
+static inline bool hexValues(__m128i chars, __m128i &values)
+{
+    __m128i digit = inRange(chars, '0', '9');
+    // Only 'A' to 'F' become 'a' to 'f' when setting the lowercase bit.
+    __m128i lowered = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    __m128i letter = inRange(lowered, 'a', 'f');
+    if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xffff)
+        return false;
+    values = _mm_or_si128(
+        _mm_and_si128(digit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+        _mm_and_si128(letter,
+                      _mm_sub_epi8(lowered, _mm_set1_epi8('a' - 10))));
+    return true;
+}
+
+DROGON_TARGET_SSSE3
+static size_t hexToBinarySsse3(const char *in, size_t length, char *out)
+{
+    size_t pos = 0;
+    for (; length - pos >= 32; pos += 32, out += 16)
+    {
+        __m128i first, second;
+        if (!hexValues(_mm_loadu_si128(
+                           reinterpret_cast<const __m128i *>(in + pos)),
+                       first) ||
+            !hexValues(_mm_loadu_si128(
+                           reinterpret_cast<const __m128i *>(in + pos + 16)),
+                       second))
+            break;
+        // high * 16 + low for every pair of digits
+        const __m128i weights = _mm_set1_epi16(0x0110);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                         _mm_packus_epi16(_mm_maddubs_epi16(first, weights),
+                                          _mm_maddubs_epi16(second, weights)));
+    }
+    return pos;
+}
+#endif
+
+size_t simdBase64Encode(const unsigned char *in,
+                        size_t length,
+                        unsigned char *out,
+                        bool urlSafe)
+{
+#ifdef DROGON_SIMD_CODECS
+    if (simdCodecsEnabled())
+        return base64EncodeSsse3(in, length, out, urlSafe);
+#else
+    (void)in;
+    (void)length;
+    (void)out;
+    (void)urlSafe;
+#endif
+    return 0;
+}
+
+size_t simdBase64Decode(const char *in, size_t length, unsigned char *out)
+{
+#ifdef DROGON_SIMD_CODECS
+    if (simdCodecsEnabled())
+        return base64DecodeSsse3(in, length, out);
+#else
+    (void)in;
+    (void)length;
+    (void)out;
+#endif
+    return 0;
+}
+
+size_t simdBinaryToHex(const char *in,
+                       size_t length,
+                       char *out,
+                       bool lowerCase)
+{
+#ifdef DROGON_SIMD_CODECS
+    if (simdCodecsEnabled())
+        return binaryToHexSsse3(in, length, out, lowerCase);
+#else
+    (void)in;
+    (void)length;
+    (void)out;
+    (void)lowerCase;
+#endif
+    return 0;
+}
+
+size_t simdHexToBinary(const char *in, size_t length, char *out)
+{
+#ifdef DROGON_SIMD_CODECS
+    if (simdCodecsEnabled())
+        return hexToBinarySsse3(in, length, out);
+#else
+    (void)in;
+    (void)length;
+    (void)out;
+#endif
+    return 0;
+}
+}  // namespace internal
+}  // namespace utils
+}  // namespace drogon
@@ -0,0 +1,69 @@
+/**
+ *
+ *  @file SimdCodecs.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <cstddef>
+
+namespace drogon
+{
+namespace utils
+{
+namespace internal
+{
+/**
+ * @brief The SSSE3 kernels of the base64 and hex codecs, selected at runtime
+ * by checking the CPU. Each function converts the longest prefix made of
+ * whole blocks and returns the length of that prefix so the scalar codecs of
+ * Utilities.cc do the rest, or 0 if the CPU doesn't support SSSE3.
+ */
+
+/// Encode blocks of 12 bytes, returns the number of bytes encoded.
+DROGON_EXPORT size_t simdBase64Encode(const unsigned char *in,
+                                      size_t length,
+                                      unsigned char *out,
+                                      bool urlSafe);
+
+/**
+ * @brief Decode blocks of 16 characters of any of the two alphabets, stops at
+ * the first block with another character (including padding), returns the
+ * number of characters decoded.
+ */
+DROGON_EXPORT size_t simdBase64Decode(const char *in,
+                                      size_t length,
+                                      unsigned char *out);
+
+/// Encode blocks of 16 bytes, returns the number of bytes encoded.
+DROGON_EXPORT size_t simdBinaryToHex(const char *in,
+                                     size_t length,
+                                     char *out,
+                                     bool lowerCase);
+
+/**
+ * @brief Decode blocks of 32 hex digits, stops at the first block with
+ * another character, returns the number of characters decoded.
+ */
+DROGON_EXPORT size_t simdHexToBinary(const char *in, size_t length, char *out);
+
+/**
+ * @brief Enable or disable the kernels, for the tests and the benchmarks
+ * which compare them with the scalar codecs. They are enabled by default when
+ * the CPU supports them.
+ */
+DROGON_EXPORT void setSimdCodecsEnabled(bool enabled);
+DROGON_EXPORT bool simdCodecsEnabled();
+}  // namespace internal
+}  // namespace utils
+}  // namespace drogon
@@ -1,14 +1,15 @@
 #include "SlidingWindowRateLimiter.h"
-#include <assert.h>
+#include <algorithm>
 
 using namespace drogon;
 
+static constexpr uint64_t kCountMask = (1 << 24) - 1;
+
 SlidingWindowRateLimiter::SlidingWindowRateLimiter(
     size_t capacity,
     std::chrono::duration<double> timeUnit)
-    : capacity_(capacity),
-      unitStartTime_(std::chrono::steady_clock::now()),
-      lastTime_(unitStartTime_),
+    : capacity_((std::min)(capacity, size_t(kCountMask))),
+      startTime_(std::chrono::steady_clock::now()),
       timeUnit_(timeUnit)
 {
 }
@@ -17,43 +18,46 @@ SlidingWindowRateLimiter::SlidingWindowRateLimiter(
 bool SlidingWindowRateLimiter::isAllowed()
 {
     auto now = std::chrono::steady_clock::now();
-    unitStartTime_ =
-        unitStartTime_ +
-        std::chrono::duration_cast<decltype(unitStartTime_)::duration>(
-            std::chrono::duration<double>(
-                static_cast<double>(
-                    (uint64_t)(std::chrono::duration_cast<
-                                   std::chrono::duration<double>>(
-                                   now - unitStartTime_)
-                                   .count() /
-                               timeUnit_.count())) *
-                timeUnit_.count()));
-
-    if (unitStartTime_ > lastTime_)
+    auto units = std::chrono::duration_cast<std::chrono::duration<double>>(
+                     now - startTime_) /
+                 timeUnit_;
+    auto unitIndex = (uint64_t)units;
+    auto unit = (uint16_t)unitIndex;
+    auto coef = units - (double)unitIndex;
+    auto state = state_.load(std::memory_order_relaxed);
+    for (;;)
     {
-        auto duration =
-            std::chrono::duration_cast<std::chrono::duration<double>>(
-                unitStartTime_ - lastTime_);
-        if (duration >= timeUnit_)
+        auto stateUnit = (uint16_t)(state >> 48);
+        auto previousRequests = (state >> 24) & kCountMask;
+        auto currentRequests = state & kCountMask;
+        auto diff = (int16_t)(uint16_t)(unit - stateUnit);
+        if (diff < 0 && diff > -4)
         {
-            previousRequests_ = 0;
+            // Another thread has seen a later time, count this request in
+            // its unit.
+            unit = stateUnit;
+            coef = 0.0;
         }
-        else
+        else if (diff == 1)
         {
-            previousRequests_ = currentRequests_;
+            previousRequests = currentRequests;
+            currentRequests = 0;
         }
-        currentRequests_ = 0;
-    }
-    auto coef = std::chrono::duration_cast<std::chrono::duration<double>>(
-                    now - unitStartTime_) /
-                timeUnit_;
-    assert(coef <= 1.0);
-    auto count = previousRequests_ * (1.0 - coef) + currentRequests_;
-    if (count < capacity_)
-    {
-        currentRequests_++;
-        lastTime_ = now;
-        return true;
+        else if (diff != 0)
+        {
+            // More than one unit has passed, the index may have wrapped
+            // around after a long idle time.
+            previousRequests = 0;
+            currentRequests = 0;
+        }
+        auto count = previousRequests * (1.0 - coef) + currentRequests;
+        if (count >= capacity_)
+            return false;
+        auto newState = ((uint64_t)unit << 48) | (previousRequests << 24) |
+                        (currentRequests + 1);
+        if (state_.compare_exchange_weak(state,
+                                         newState,
+                                         std::memory_order_relaxed))
+            return true;
     }
-    return false;
 }
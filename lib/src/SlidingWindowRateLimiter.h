@@ -1,6 +1,8 @@
 #pragma once
 #include <drogon/RateLimiter.h>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 
 namespace drogon
 {
@@ -14,10 +16,11 @@ class SlidingWindowRateLimiter : public RateLimiter
 
   private:
     size_t capacity_;
-    size_t currentRequests_{0};
-    size_t previousRequests_{0};
-    std::chrono::steady_clock::time_point unitStartTime_;
-    std::chrono::steady_clock::time_point lastTime_;
+    std::chrono::steady_clock::time_point startTime_;
     std::chrono::duration<double> timeUnit_;
+    // The low 16 bits of the index of the current time unit, the number of
+    // requests in the previous unit and the number of requests in the current
+    // unit packed into 16, 24 and 24 bits, so they are updated by one CAS.
+    std::atomic<uint64_t> state_{0};
 };
 }  // namespace drogon
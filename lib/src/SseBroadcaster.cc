@@ -0,0 +1,269 @@
+/**
+ *
+ *  @file SseBroadcaster.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/SseBroadcaster.h>
+#include <drogon/HttpAppFramework.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+using namespace drogon;
+
+namespace
+{
+using ChunkPtr = std::shared_ptr<const std::string>;
+
+struct Subscriber
+{
+    SseStreamPtr stream;
+    // The sequence number of the last event sent to the stream, the events
+    // queued for the loop before the stream was added are skipped.
+    uint64_t lastSequence;
+};
+}  // namespace
+
+// The streams of the channel in one IO loop, only accessed in the loop
+struct SseBroadcaster::LoopStreams
+{
+    explicit LoopStreams(trantor::EventLoop *l) : loop(l)
+    {
+    }
+
+    // Send the chunk to the streams which haven't got it, and remove the
+    // streams which can't send it.
+    void send(uint64_t sequence, const ChunkPtr &chunk)
+    {
+        for (auto iter = subscribers.begin(); iter != subscribers.end();)
+        {
+            if (sequence > 0 && iter->lastSequence >= sequence)
+            {
+                ++iter;
+                continue;
+            }
+            if (!iter->stream->sendFramedChunk(*chunk))
+            {
+                iter = subscribers.erase(iter);
+                size.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (sequence > 0)
+                iter->lastSequence = sequence;
+            ++iter;
+        }
+    }
+
+    trantor::EventLoop *loop;
+    std::vector<Subscriber> subscribers;
+    std::atomic<size_t> size{0};
+};
+
+namespace
+{
+struct Event
+{
+    uint64_t sequence;
+    std::string id;
+    ChunkPtr chunk;
+};
+}  // namespace
+
+struct SseBroadcaster::State : public std::enable_shared_from_this<State>
+{
+    using LoopStreamsPtr = std::shared_ptr<LoopStreams>;
+
+    explicit State(const Options &opts) : options(opts)
+    {
+    }
+
+    // The stream is kept by the loop of the current thread, which should be
+    // the IO loop of its connection.
+    void add(SseStreamPtr stream, const std::string &lastEventId)
+    {
+        auto loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+        if (loop)
+        {
+            addInLoop(loop, std::move(stream), lastEventId);
+            return;
+        }
+        loop = app().getLoop();
+        auto streamPtr = std::make_shared<SseStreamPtr>(std::move(stream));
+        loop->queueInLoop(
+            [thisPtr = shared_from_this(), loop, streamPtr, lastEventId]() {
+                thisPtr->addInLoop(loop, std::move(*streamPtr), lastEventId);
+            });
+    }
+
+    void addInLoop(trantor::EventLoop *loop,
+                   SseStreamPtr stream,
+                   const std::string &lastEventId)
+    {
+        std::vector<Event> replay;
+        LoopStreamsPtr loopStreams;
+        uint64_t lastSequence;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &streams : loops)
+            {
+                if (streams->loop == loop)
+                {
+                    loopStreams = streams;
+                    break;
+                }
+            }
+            if (!loopStreams)
+            {
+                loopStreams = std::make_shared<LoopStreams>(loop);
+                loops.push_back(loopStreams);
+            }
+            if (!lastEventId.empty())
+            {
+                auto iter = events.end();
+                while (iter != events.begin())
+                {
+                    --iter;
+                    if (iter->id == lastEventId)
+                    {
+                        ++iter;
+                        break;
+                    }
+                }
+                // All the events are sent again if the last one isn't found.
+                replay.assign(iter, events.end());
+            }
+            lastSequence = sequence;
+        }
+        if (options.retry > 0 && !stream->sendRetry(options.retry))
+            return;
+        for (auto &event : replay)
+        {
+            if (!stream->sendFramedChunk(*event.chunk))
+                return;
+        }
+        loopStreams->subscribers.push_back({std::move(stream), lastSequence});
+        loopStreams->size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::vector<LoopStreamsPtr> snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return loops;
+    }
+
+    const Options options;
+    mutable std::mutex mutex;
+    uint64_t sequence{0};
+    std::deque<Event> events;
+    std::vector<LoopStreamsPtr> loops;
+};
+
+SseBroadcaster::SseBroadcaster() : SseBroadcaster(Options())
+{
+}
+
+SseBroadcaster::SseBroadcaster(const Options &options)
+    : options_(options), state_(std::make_shared<State>(options))
+{
+    if (options_.heartbeatInterval > 0)
+    {
+        auto heartbeat = std::make_shared<const std::string>(
+            SseStream::frameChunk(":\n\n"));
+        std::weak_ptr<State> weakState = state_;
+        heartbeatTimerId_ = app().getLoop()->runEvery(
+            options_.heartbeatInterval, [weakState, heartbeat]() {
+                auto state = weakState.lock();
+                if (!state)
+                    return;
+                // Sequence 0 is sent to all the streams, it also finds the
+                // streams whose client is gone.
+                for (auto &loopStreams : state->snapshot())
+                {
+                    loopStreams->loop->runInLoop([loopStreams, heartbeat]() {
+                        loopStreams->send(0, heartbeat);
+                    });
+                }
+            });
+    }
+}
+
+SseBroadcaster::~SseBroadcaster()
+{
+    if (heartbeatTimerId_ != trantor::InvalidTimerId)
+        app().getLoop()->invalidateTimer(heartbeatTimerId_);
+    // Close the streams in their own loops
+    for (auto &loopStreams : state_->snapshot())
+    {
+        loopStreams->loop->runInLoop([loopStreams]() {
+            loopStreams->subscribers.clear();
+            loopStreams->size.store(0, std::memory_order_relaxed);
+        });
+    }
+}
+
+HttpResponsePtr SseBroadcaster::newResponse(const HttpRequestPtr &req)
+{
+    return HttpResponse::newSseResponse(
+        [state = state_,
+         lastEventId = req->getHeader("last-event-id")](SseStreamPtr stream) {
+            state->add(std::move(stream), lastEventId);
+        });
+}
+
+void SseBroadcaster::add(SseStreamPtr stream, const std::string &lastEventId)
+{
+    state_->add(std::move(stream), lastEventId);
+}
+
+std::string SseBroadcaster::broadcast(std::string_view data,
+                                      std::string_view event,
+                                      std::string_view id)
+{
+    std::vector<State::LoopStreamsPtr> loops;
+    uint64_t sequence;
+    std::string eventId;
+    ChunkPtr chunk;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        sequence = ++state_->sequence;
+        eventId = id.empty() ? std::to_string(sequence) : std::string(id);
+        chunk = std::make_shared<const std::string>(SseStream::frameChunk(
+            SseStream::formatEvent(data, event, eventId)));
+        if (options_.replayEvents > 0)
+        {
+            state_->events.push_back({sequence, eventId, chunk});
+            if (state_->events.size() > options_.replayEvents)
+                state_->events.pop_front();
+        }
+        loops = state_->loops;
+    }
+    for (auto &loopStreams : loops)
+    {
+        loopStreams->loop->runInLoop([loopStreams, sequence, chunk]() {
+            loopStreams->send(sequence, chunk);
+        });
+    }
+    return eventId;
+}
+
+size_t SseBroadcaster::size() const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    size_t total{0};
+    for (auto &loopStreams : state_->loops)
+    {
+        total += loopStreams->size.load(std::memory_order_relaxed);
+    }
+    return total;
+}
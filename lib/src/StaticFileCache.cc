@@ -0,0 +1,117 @@
+/**
+ *
+ *  StaticFileCache.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "StaticFileCache.h"
+
+using namespace drogon;
+
+void StaticFileCache::setCapacity(size_t capacity)
+{
+    capacity_ = capacity;
+}
+
+StaticFileCache::Shard &StaticFileCache::shardOf(const std::string &key)
+{
+    return shards_[std::hash<std::string>{}(key) % kShardsNum];
+}
+
+void StaticFileCache::erase(Shard &shard, std::list<Entry>::iterator iter)
+{
+    shard.size -= iter->size;
+    shard.index.erase(iter->key);
+    shard.entries.erase(iter);
+}
+
+HttpResponsePtr StaticFileCache::find(const std::string &key)
+{
+    auto &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.index.find(key);
+    if (iter == shard.index.end())
+        return nullptr;
+    auto entryIter = iter->second;
+    if (entryIter->expiry != Clock::time_point::max() &&
+        entryIter->expiry <= Clock::now())
+    {
+        erase(shard, entryIter);
+        return nullptr;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, entryIter);
+    return entryIter->response;
+}
+
+void StaticFileCache::insert(const std::string &key,
+                             const HttpResponsePtr &resp,
+                             size_t size,
+                             int timeout)
+{
+    // Every shard takes an equal part of the capacity
+    auto shardCapacity = capacity_ / kShardsNum;
+    if (capacity_ > 0 && size > shardCapacity)
+        return;
+    auto expiry = timeout > 0 ? Clock::now() + std::chrono::seconds(timeout)
+                              : Clock::time_point::max();
+    auto &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.index.find(key);
+    if (iter != shard.index.end())
+    {
+        erase(shard, iter->second);
+    }
+    shard.entries.push_front({key, resp, size, expiry});
+    shard.index.emplace(key, shard.entries.begin());
+    shard.size += size;
+    auto now = Clock::now();
+    // The least recently used entries are the most likely ones to expire
+    while (shard.entries.back().expiry <= now)
+    {
+        erase(shard, std::prev(shard.entries.end()));
+    }
+    if (capacity_ == 0)
+        return;
+    // Drop the expired entries first, then the least recently used ones.
+    for (auto entryIter = shard.entries.begin();
+         shard.size > shardCapacity && entryIter != shard.entries.end();)
+    {
+        if (entryIter->expiry <= now)
+            erase(shard, entryIter++);
+        else
+            ++entryIter;
+    }
+    while (shard.size > shardCapacity)
+    {
+        erase(shard, std::prev(shard.entries.end()));
+    }
+}
+
+void StaticFileCache::clear()
+{
+    for (auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.clear();
+        shard.index.clear();
+        shard.size = 0;
+    }
+}
+
+size_t StaticFileCache::size() const
+{
+    size_t total{0};
+    for (auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.size;
+    }
+    return total;
+}
@@ -0,0 +1,93 @@
+/**
+ *
+ *  StaticFileCache.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/HttpResponse.h>
+#include <trantor/utils/NonCopyable.h>
+#include <array>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace drogon
+{
+/**
+ * @brief The cache of static file responses shared by all IO loops. Entries
+ * are evicted in LRU order when the total size of the cached bodies exceeds
+ * the capacity, and dropped when they expire.
+ *
+ * The cached responses must not be modified after they are inserted, they are
+ * sent by many threads at the same time.
+ */
+class StaticFileCache : public trantor::NonCopyable
+{
+  public:
+    /**
+     * @param capacity the maximum total size of the bodies in bytes, 0 means
+     * no limit.
+     */
+    void setCapacity(size_t capacity);
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    HttpResponsePtr find(const std::string &key);
+
+    /**
+     * @brief Insert a response of which the body takes the size.
+     *
+     * @param timeout in seconds, 0 means the entry never expires.
+     */
+    void insert(const std::string &key,
+                const HttpResponsePtr &resp,
+                size_t size,
+                int timeout);
+
+    void clear();
+
+    /// Return the total size of the cached bodies
+    size_t size() const;
+
+  private:
+    static constexpr size_t kShardsNum = 16;
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::string key;
+        HttpResponsePtr response;
+        size_t size;
+        Clock::time_point expiry;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        // The most recently used entry is at the front
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        size_t size{0};
+    };
+
+    Shard &shardOf(const std::string &key);
+    void erase(Shard &shard, std::list<Entry>::iterator iter);
+
+    size_t capacity_{0};
+    std::array<Shard, kShardsNum> shards_;
+};
+}  // namespace drogon
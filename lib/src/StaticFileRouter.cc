@@ -16,6 +16,7 @@
 #include "HttpAppFrameworkImpl.h"
 #include "HttpRequestImpl.h"
 #include "HttpResponseImpl.h"
+#include "PrefixTrie.h"
 #include "RangeParser.h"
 #include <fstream>
 #include <iostream>
@@ -51,6 +52,34 @@ void StaticFileRouter::init(const std::vector<trantor::EventLoop *> &ioLoops)
         });
     staticFilesCache_ = std::make_unique<
         IOThreadStorage<std::unordered_map<std::string, HttpResponsePtr>>>();
+    if (fileStatCacheTime_ > 0)
+    {
+        fileStatCache_ = std::make_unique<
+            IOThreadStorage<std::unordered_map<std::string, CachedFileStat>>>();
+    }
+    if (precompressStaticFlag_ && (gzipStaticFlag_ || brStaticFlag_))
+    {
+        precompressionThread_ =
+            std::make_unique<trantor::EventLoopThread>("Precompression");
+        precompressionThread_->run();
+    }
+    locationTrie_ = internal::PrefixTrie();
+    caseInsensitiveLocationTrie_ = internal::PrefixTrie();
+    for (size_t i = 0; i < locations_.size(); ++i)
+    {
+        auto &location = locations_[i];
+        if (location.isCaseSensitive_)
+        {
+            locationTrie_.insert(location.uriPrefix_, i);
+            continue;
+        }
+        auto prefix = location.uriPrefix_;
+        std::transform(prefix.begin(),
+                       prefix.end(),
+                       prefix.begin(),
+                       [](unsigned char c) { return tolower(c); });
+        caseInsensitiveLocationTrie_.insert(prefix, i);
+    }
     ioLocationsPtr_ =
         std::make_shared<IOThreadStorage<std::vector<Location>>>();
     for (auto *loop : ioLoops)
@@ -66,6 +95,17 @@ void StaticFileRouter::reset()
 {
     staticFilesCacheMap_.reset();
     staticFilesCache_.reset();
+    fileStatCache_.reset();
+    sharedCache_.clear();
+    precompressionThread_.reset();
+    {
+        std::lock_guard<std::mutex> lock(precompressedFilesMutex_);
+        precompressedFiles_.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mappedFilesMutex_);
+        mappedFiles_.clear();
+    }
     ioLocationsPtr_.reset();
     locations_.clear();
 }
@@ -105,8 +145,15 @@ void StaticFileRouter::route(
                    lPath.begin(),
                    [](unsigned char c) { return tolower(c); });
 
-    for (auto &location : **ioLocationsPtr_)
+    auto index = locationTrie_.match(path);
+    if (!caseInsensitiveLocationTrie_.empty())
+    {
+        index = (std::min)(index, caseInsensitiveLocationTrie_.match(lPath));
+    }
+    if (index != internal::PrefixTrie::npos)
     {
+        // The first location added whose prefix matches the path
+        auto &location = (**ioLocationsPtr_)[index];
         auto &URI = location.uriPrefix_;
         if (location.realLocation_.empty())
         {
@@ -134,107 +181,90 @@ void StaticFileRouter::route(
             {
                 location.realLocation_.append(1, '/');
             }
-            if (!location.isCaseSensitive_)
-            {
-                std::transform(URI.begin(),
-                               URI.end(),
-                               URI.begin(),
-                               [](unsigned char c) { return tolower(c); });
-            }
         }
-        auto &tmpPath = location.isCaseSensitive_ ? path : lPath;
-        if (tmpPath.length() >= URI.length() &&
-            std::equal(tmpPath.begin(),
-                       tmpPath.begin() + URI.length(),
-                       URI.begin()))
+        std::string_view restOfThePath{path.data() + URI.length(),
+                                       path.length() - URI.length()};
+        auto pos = restOfThePath.rfind('/');
+        if (pos != 0 && pos != std::string_view::npos && !location.isRecursive_)
         {
-            std::string_view restOfThePath{path.data() + URI.length(),
-                                           path.length() - URI.length()};
-            auto pos = restOfThePath.rfind('/');
-            if (pos != 0 && pos != std::string_view::npos &&
-                !location.isRecursive_)
+            callback(app().getCustomErrorHandler()(k403Forbidden, req));
+            return;
+        }
+        std::string filePath =
+            location.realLocation_ +
+            std::string{restOfThePath.data(), restOfThePath.length()};
+        std::filesystem::path fsFilePath(utils::toNativePath(filePath));
+        std::error_code err;
+        if (!std::filesystem::exists(fsFilePath, err))
+        {
+            defaultHandler_(req, std::move(callback));
+            return;
+        }
+        if (std::filesystem::is_directory(fsFilePath, err))
+        {
+            // Check if path is eligible for an implicit index.html
+            if (implicitPageEnable_)
             {
-                callback(app().getCustomErrorHandler()(k403Forbidden, req));
-                return;
+                filePath = filePath + "/" + implicitPage_;
             }
-            std::string filePath =
-                location.realLocation_ +
-                std::string{restOfThePath.data(), restOfThePath.length()};
-            std::filesystem::path fsFilePath(utils::toNativePath(filePath));
-            std::error_code err;
-            if (!std::filesystem::exists(fsFilePath, err))
+            else
             {
-                defaultHandler_(req, std::move(callback));
+                callback(app().getCustomErrorHandler()(k403Forbidden, req));
                 return;
             }
-            if (std::filesystem::is_directory(fsFilePath, err))
+        }
+        else
+        {
+            if (!location.allowAll_)
             {
-                // Check if path is eligible for an implicit index.html
-                if (implicitPageEnable_)
-                {
-                    filePath = filePath + "/" + implicitPage_;
-                }
-                else
+                pos = restOfThePath.rfind('.');
+                if (pos == std::string_view::npos)
                 {
                     callback(app().getCustomErrorHandler()(k403Forbidden, req));
                     return;
                 }
-            }
-            else
-            {
-                if (!location.allowAll_)
+                std::string extension{restOfThePath.data() + pos + 1,
+                                      restOfThePath.length() - pos - 1};
+                std::transform(extension.begin(),
+                               extension.end(),
+                               extension.begin(),
+                               [](unsigned char c) { return tolower(c); });
+                if (fileTypeSet_.find(extension) == fileTypeSet_.end())
                 {
-                    pos = restOfThePath.rfind('.');
-                    if (pos == std::string_view::npos)
-                    {
-                        callback(
-                            app().getCustomErrorHandler()(k403Forbidden, req));
-                        return;
-                    }
-                    std::string extension{restOfThePath.data() + pos + 1,
-                                          restOfThePath.length() - pos - 1};
-                    std::transform(extension.begin(),
-                                   extension.end(),
-                                   extension.begin(),
-                                   [](unsigned char c) { return tolower(c); });
-                    if (fileTypeSet_.find(extension) == fileTypeSet_.end())
-                    {
-                        callback(
-                            app().getCustomErrorHandler()(k403Forbidden, req));
-                        return;
-                    }
+                    callback(app().getCustomErrorHandler()(k403Forbidden, req));
+                    return;
                 }
             }
+        }
 
-            if (location.middlewares_.empty())
-            {
-                sendStaticFileResponse(filePath,
-                                       req,
-                                       std::move(callback),
-                                       std::string_view{
-                                           location.defaultContentType_});
-            }
-            else
-            {
-                middlewares_function::passMiddlewares(
-                    location.middlewares_,
-                    req,
-                    std::move(callback),
-                    [this,
-                     req,
-                     filePath = std::move(filePath),
-                     contentType =
-                         std::string_view{location.defaultContentType_}](
-                        std::function<void(const HttpResponsePtr &)>
-                            &&middlewarePostCb) mutable {
-                        sendStaticFileResponse(filePath,
-                                               req,
-                                               std::move(middlewarePostCb),
-                                               contentType);
-                    });
-            }
-            return;
+        if (location.middlewares_.empty())
+        {
+            sendStaticFileResponse(filePath,
+                                   req,
+                                   std::move(callback),
+                                   std::string_view{
+                                       location.defaultContentType_});
+        }
+        else
+        {
+            middlewares_function::passMiddlewares(
+                location.middlewares_,
+                req,
+                std::move(callback),
+                [this,
+                 req,
+                 filePath = std::move(filePath),
+                 contentType =
+                     std::string_view{location.defaultContentType_}](
+                    std::function<void(const HttpResponsePtr &)>
+                        &&middlewarePostCb) mutable {
+                    sendStaticFileResponse(filePath,
+                                           req,
+                                           std::move(middlewarePostCb),
+                                           contentType);
+                });
         }
+        return;
     }
     std::string directoryPath =
         HttpAppFrameworkImpl::instance().getDocumentRoot() + path;
@@ -279,18 +309,12 @@ void StaticFileRouter::route(
     defaultHandler_(req, std::move(callback));
 }
 
-// Expand this struct as you need, nothing to worry about
-struct FileStat
-{
-    size_t fileSize_;
-    struct tm modifiedTime_;
-    std::string modifiedTimeStr_;
-};
-
 // A wrapper to call stat()
 // std::filesystem::file_time_type::clock::to_time_t still not
 // implemented by M$, even in c++20, so keep calls to stat()
-static bool getFileStat(const std::string &filePath, FileStat &myStat)
+static bool statFile(const std::string &filePath,
+                     size_t &fileSize,
+                     std::string &modifiedTimeStr)
 {
 #if defined(_WIN32) && !defined(__MINGW32__)
     struct _stati64 fileStat;
@@ -301,26 +325,74 @@ static bool getFileStat(const std::string &filePath, FileStat &myStat)
         S_ISREG(fileStat.st_mode))
     {
         LOG_TRACE << "last modify time:" << fileStat.st_mtime;
+        struct tm modifiedTime;
 #ifdef _WIN32
-        gmtime_s(&myStat.modifiedTime_, &fileStat.st_mtime);
+        gmtime_s(&modifiedTime, &fileStat.st_mtime);
 #else
-        gmtime_r(&fileStat.st_mtime, &myStat.modifiedTime_);
+        gmtime_r(&fileStat.st_mtime, &modifiedTime);
 #endif
-        std::string &timeStr = myStat.modifiedTimeStr_;
+        std::string &timeStr = modifiedTimeStr;
         timeStr.resize(64);
         size_t len = strftime((char *)timeStr.data(),
                               timeStr.size(),
                               "%a, %d %b %Y %H:%M:%S GMT",
-                              &myStat.modifiedTime_);
+                              &modifiedTime);
         timeStr.resize(len);
 
-        myStat.fileSize_ = fileStat.st_size;
+        fileSize = fileStat.st_size;
         return true;
     }
 
     return false;
 }
 
+bool StaticFileRouter::getFileStat(const std::string &filePath,
+                                   FileStat &fileStat)
+{
+    if (fileStatCacheTime_ <= 0 || !fileStatCache_)
+    {
+        return statFile(filePath,
+                        fileStat.fileSize_,
+                        fileStat.modifiedTimeStr_);
+    }
+    // Bounded, the entries of the files not requested anymore go away
+    static constexpr size_t kMaxCachedFileStats = 10000;
+    auto &cache = fileStatCache_->getThreadData();
+    auto now = std::chrono::steady_clock::now();
+    auto iter = cache.find(filePath);
+    if (iter != cache.end() && iter->second.expiry > now)
+    {
+        if (iter->second.isFile)
+            fileStat = iter->second.stat;
+        return iter->second.isFile;
+    }
+    if (iter == cache.end() && cache.size() >= kMaxCachedFileStats)
+    {
+        for (auto it = cache.begin(); it != cache.end();)
+        {
+            if (it->second.expiry <= now)
+                it = cache.erase(it);
+            else
+                ++it;
+        }
+        if (cache.size() >= kMaxCachedFileStats)
+            cache.clear();
+    }
+    auto &entry = cache[filePath];
+    // The missing files are cached too
+    entry.isFile = statFile(filePath,
+                            entry.stat.fileSize_,
+                            entry.stat.modifiedTimeStr_);
+    std::chrono::duration<double> cacheTime(fileStatCacheTime_.load());
+    entry.expiry =
+        now +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            cacheTime);
+    if (entry.isFile)
+        fileStat = entry.stat;
+    return entry.isFile;
+}
+
 void StaticFileRouter::sendStaticFileResponse(
     const std::string &filePath,
     const HttpRequestImplPtr &req,
@@ -365,23 +437,41 @@ void StaticFileRouter::sendStaticFileResponse(
             std::vector<FileRange> ranges;
             switch (parseRangeHeader(rangeStr, fileStat.fileSize_, ranges))
             {
-                // TODO: support only single range now
-                // Contributions are welcomed.
                 case FileRangeParseResult::SinglePart:
                 case FileRangeParseResult::MultiPart:
                 {
-                    auto firstRange = ranges.front();
                     auto ct = fileNameToContentTypeAndMime(filePath);
-                    auto resp =
-                        HttpResponse::newFileResponse(filePath,
-                                                      firstRange.start,
-                                                      firstRange.end -
-                                                          firstRange.start,
-                                                      true,
-                                                      "",
-                                                      ct.first,
-                                                      std::string(ct.second),
-                                                      req);
+                    HttpResponsePtr resp;
+                    if (ranges.size() == 1)
+                    {
+                        auto firstRange = ranges.front();
+                        resp = newFileResponse(filePath,
+                                               firstRange.start,
+                                               firstRange.end -
+                                                   firstRange.start,
+                                               true,
+                                               ct.first,
+                                               std::string(ct.second),
+                                               req);
+                    }
+                    else
+                    {
+                        // The parts of the multipart/byteranges response are
+                        // sent from the file one after the other.
+                        std::vector<std::pair<size_t, size_t>> parts;
+                        parts.reserve(ranges.size());
+                        for (auto &range : ranges)
+                        {
+                            parts.emplace_back(range.start,
+                                               range.end - range.start);
+                        }
+                        resp = HttpResponse::newFileResponse(
+                            filePath,
+                            parts,
+                            ct.first,
+                            std::string(ct.second),
+                            req);
+                    }
                     if (!fileStat.modifiedTimeStr_.empty())
                     {
                         resp->addHeader("Last-Modified",
@@ -438,13 +528,30 @@ void StaticFileRouter::sendStaticFileResponse(
         }
     }
 
+    // The encodings the client accepts select the file to send, so they are
+    // part of the cache key.
+    auto &acceptEncoding = req->getHeaderBy("accept-encoding");
+    auto cacheKey = filePath;
+    cacheKey.push_back('\0');
+    if (brStaticFlag_ && acceptEncoding.find("br") != std::string::npos)
+        cacheKey.push_back('b');
+    if (gzipStaticFlag_ && acceptEncoding.find("gzip") != std::string::npos)
+        cacheKey.push_back('g');
+
     // find cached response
     HttpResponsePtr cachedResp;
-    auto &cacheMap = staticFilesCache_->getThreadData();
-    auto iter = cacheMap.find(filePath);
-    if (iter != cacheMap.end())
+    if (staticFilesCacheTime_ >= 0)
     {
-        cachedResp = iter->second;
+        cachedResp = sharedCache_.find(cacheKey);
+        if (!cachedResp)
+        {
+            auto &cacheMap = staticFilesCache_->getThreadData();
+            auto iter = cacheMap.find(cacheKey);
+            if (iter != cacheMap.end())
+            {
+                cachedResp = iter->second;
+            }
+        }
     }
 
     if (enableLastModify_)
@@ -488,37 +595,28 @@ void StaticFileRouter::sendStaticFileResponse(
     if (cachedResp)
     {
         LOG_TRACE << "Using file cache";
-        callback(cachedResp);
+        callback(responseForRequest(cachedResp, req));
         return;
     }
     // Check existence
-    if (!fileExists)
+    FileStat variantStat;
+    if (!fileExists && !getFileStat(filePath, variantStat))
     {
-        std::filesystem::path fsFilePath(utils::toNativePath(filePath));
-        std::error_code err;
-        if (!std::filesystem::exists(fsFilePath, err) ||
-            !std::filesystem::is_regular_file(fsFilePath, err))
-        {
-            defaultHandler_(req, std::move(callback));
-            return;
-        }
+        defaultHandler_(req, std::move(callback));
+        return;
     }
 
     HttpResponsePtr resp;
-    auto &acceptEncoding = req->getHeaderBy("accept-encoding");
 
     if (brStaticFlag_ && acceptEncoding.find("br") != std::string::npos)
     {
         // Find compressed file first.
         auto brFileName = filePath + ".br";
-        std::filesystem::path fsBrFile(utils::toNativePath(brFileName));
-        std::error_code err;
-        if (std::filesystem::exists(fsBrFile, err) &&
-            std::filesystem::is_regular_file(fsBrFile, err))
+        if (getFileStat(brFileName, variantStat))
         {
             auto ct = fileNameToContentTypeAndMime(filePath);
-            resp = HttpResponse::newFileResponse(
-                brFileName, "", ct.first, std::string(ct.second), req);
+            resp = newFileResponse(
+                brFileName, 0, 0, false, ct.first, std::string(ct.second), req);
             resp->addHeader("Content-Encoding", "br");
         }
     }
@@ -527,22 +625,24 @@ void StaticFileRouter::sendStaticFileResponse(
     {
         // Find compressed file first.
         auto gzipFileName = filePath + ".gz";
-        std::filesystem::path fsGzipFile(utils::toNativePath(gzipFileName));
-        std::error_code err;
-        if (std::filesystem::exists(fsGzipFile, err) &&
-            std::filesystem::is_regular_file(fsGzipFile, err))
+        if (getFileStat(gzipFileName, variantStat))
         {
             auto ct = fileNameToContentTypeAndMime(filePath);
-            resp = HttpResponse::newFileResponse(
-                gzipFileName, "", ct.first, std::string(ct.second), req);
+            resp = newFileResponse(gzipFileName,
+                                   0,
+                                   0,
+                                   false,
+                                   ct.first,
+                                   std::string(ct.second),
+                                   req);
             resp->addHeader("Content-Encoding", "gzip");
         }
     }
     if (!resp)
     {
         auto ct = fileNameToContentTypeAndMime(filePath);
-        resp = HttpResponse::newFileResponse(
-            filePath, "", ct.first, std::string(ct.second), req);
+        resp = newFileResponse(
+            filePath, 0, 0, false, ct.first, std::string(ct.second), req);
     }
     if (resp->statusCode() != k404NotFound)
     {
@@ -584,20 +684,40 @@ void StaticFileRouter::sendStaticFileResponse(
                 resp->addHeader(header.first, header.second);
             }
         }
+        // The uncompressed response is not cached while the compressed one is
+        // being made, it would be compressed for every request otherwise.
+        bool cacheable = true;
+        if (precompressionThread_)
+        {
+            cacheable = usePrecompressedBody(filePath, acceptEncoding, resp);
+        }
         // cache the response for 5 seconds by default
-        if (staticFilesCacheTime_ >= 0)
+        if (staticFilesCacheTime_ >= 0 && cacheable)
         {
             LOG_TRACE << "Save in cache for " << staticFilesCacheTime_
                       << " seconds";
             resp->setExpiredTime(staticFilesCacheTime_);
-            staticFilesCache_->getThreadData()[filePath] = resp;
-            staticFilesCacheMap_->getThreadData()->insert(
-                filePath, 0, staticFilesCacheTime_, [this, filePath]() {
-                    LOG_TRACE << "Erase cache";
-                    assert(staticFilesCache_->getThreadData().find(filePath) !=
-                           staticFilesCache_->getThreadData().end());
-                    staticFilesCache_->getThreadData().erase(filePath);
-                });
+            if (shareCachedBody(resp))
+            {
+                sharedCache_.insert(cacheKey,
+                                    resp,
+                                    resp->body().size(),
+                                    staticFilesCacheTime_);
+                callback(responseForRequest(resp, req));
+                return;
+            }
+            else
+            {
+                staticFilesCache_->getThreadData()[cacheKey] = resp;
+                staticFilesCacheMap_->getThreadData()->insert(
+                    cacheKey, 0, staticFilesCacheTime_, [this, cacheKey]() {
+                        LOG_TRACE << "Erase cache";
+                        assert(staticFilesCache_->getThreadData().find(
+                                   cacheKey) !=
+                               staticFilesCache_->getThreadData().end());
+                        staticFilesCache_->getThreadData().erase(cacheKey);
+                    });
+            }
         }
         callback(resp);
         return;
@@ -605,6 +725,196 @@ void StaticFileRouter::sendStaticFileResponse(
     callback(resp);
 }
 
+HttpResponsePtr StaticFileRouter::responseForRequest(
+    const HttpResponsePtr &resp,
+    const HttpRequestImplPtr &req)
+{
+    // The server sets the version and the connection state of the response
+    // before sending it, which must not be done on a response other threads
+    // are sending. The copy shares the body and the header with the cached
+    // one.
+    if (resp->version() == req->version() &&
+        resp->ifCloseConnection() == !req->keepAlive())
+        return resp;
+    auto newResp = std::make_shared<HttpResponseImpl>(
+        *static_cast<HttpResponseImpl *>(resp.get()));
+    newResp->setVersion(req->version());
+    newResp->setCloseConnection(!req->keepAlive());
+    newResp->setExpiredTime(-1);  // make it temporary
+    return newResp;
+}
+
+std::shared_ptr<const MappedFile> StaticFileRouter::mapFile(
+    const std::string &path)
+{
+    auto nativePath = utils::toNativePath(path);
+    std::error_code err;
+    auto size = std::filesystem::file_size(nativePath, err);
+    if (err || size == 0)
+        return nullptr;
+    // sendfile() doesn't copy big files either
+    if (HttpAppFrameworkImpl::instance().useSendfile() &&
+        size > HttpResponseImpl::kMinSendfileLength)
+        return nullptr;
+    auto modifiedTime = std::filesystem::last_write_time(nativePath, err);
+    if (err)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(mappedFilesMutex_);
+    auto &file = mappedFiles_[path];
+    if (!file || file->isStale(size, modifiedTime))
+    {
+        // Responses still holding the old mapping keep it alive
+        file = MappedFile::open(path);
+        if (!file)
+        {
+            mappedFiles_.erase(path);
+            return nullptr;
+        }
+    }
+    return file;
+}
+
+HttpResponsePtr StaticFileRouter::newFileResponse(
+    const std::string &path,
+    size_t offset,
+    size_t length,
+    bool setContentRange,
+    ContentType type,
+    const std::string &typeString,
+    const HttpRequestPtr &req)
+{
+    if (fileStatCacheTime_ > 0 &&
+        HttpAppFrameworkImpl::instance().useSendfile())
+    {
+        // The size is known from the stat cache, the file is only opened by
+        // sendfile then.
+        FileStat fileStat;
+        if (getFileStat(path, fileStat) && offset <= fileStat.fileSize_ &&
+            (length > 0 ? length : fileStat.fileSize_ - offset) >
+                HttpResponseImpl::kMinSendfileLength)
+        {
+            return HttpResponseImpl::newSendfileResponse(path,
+                                                         fileStat.fileSize_,
+                                                         offset,
+                                                         length,
+                                                         setContentRange,
+                                                         type,
+                                                         typeString);
+        }
+    }
+    if (mmapStaticFlag_)
+    {
+        if (auto file = mapFile(path))
+        {
+            return HttpResponseImpl::newMappedFileResponse(path,
+                                                           std::move(file),
+                                                           offset,
+                                                           length,
+                                                           setContentRange,
+                                                           type,
+                                                           typeString);
+        }
+    }
+    // Fall back to reading the file
+    return HttpResponse::newFileResponse(
+        path, offset, length, setContentRange, "", type, typeString, req);
+}
+
+bool StaticFileRouter::usePrecompressedBody(const std::string &filePath,
+                                            const std::string &acceptEncoding,
+                                            const HttpResponsePtr &resp)
+{
+    auto respImpl = static_cast<HttpResponseImpl *>(resp.get());
+    static const CompressionPolicy defaultPolicy;
+    if (resp->statusCode() != k200OK ||
+        !respImpl->shouldBeCompressed(defaultPolicy))
+        return true;
+    bool acceptBr = false;
+#ifdef USE_BROTLI
+    acceptBr = brStaticFlag_ && acceptEncoding.find("br") != std::string::npos;
+#endif
+    bool acceptGzip =
+        gzipStaticFlag_ && acceptEncoding.find("gzip") != std::string::npos;
+    if (!acceptBr && !acceptGzip)
+        return true;
+    std::error_code err;
+    auto modifiedTime =
+        std::filesystem::last_write_time(utils::toNativePath(filePath), err);
+    if (err)
+        return true;
+    auto size = resp->body().size();
+    std::lock_guard<std::mutex> lock(precompressedFilesMutex_);
+    auto &file = precompressedFiles_[filePath];
+    if (file.size == size && file.modifiedTime == modifiedTime)
+    {
+        if (file.pending)
+            return false;
+        if (acceptBr && file.br)
+        {
+            respImpl->setSharedBody(file.br);
+            resp->addHeader("Content-Encoding", "br");
+        }
+        else if (acceptGzip && file.gzip)
+        {
+            respImpl->setSharedBody(file.gzip);
+            resp->addHeader("Content-Encoding", "gzip");
+        }
+        return true;
+    }
+    // Compress the file in the background, with all encodings enabled, so
+    // that later requests of all clients are served without compressing.
+    file = {size, modifiedTime, nullptr, nullptr, true};
+    precompressionThread_->getLoop()->queueInLoop(
+        [this, filePath, modifiedTime, body = std::string(resp->body())]() {
+            std::shared_ptr<const std::string> br, gzip;
+#ifdef USE_BROTLI
+            if (brStaticFlag_)
+            {
+                auto str = utils::brotliCompress(body.data(), body.size(), 11);
+                if (!str.empty() && str.size() < body.size())
+                    br = std::make_shared<const std::string>(std::move(str));
+            }
+#endif
+            if (gzipStaticFlag_)
+            {
+                auto str = utils::gzipCompress(body.data(), body.size(), 9);
+                if (!str.empty() && str.size() < body.size())
+                    gzip = std::make_shared<const std::string>(std::move(str));
+            }
+            LOG_TRACE << "Precompressed " << filePath;
+            std::lock_guard<std::mutex> lock(precompressedFilesMutex_);
+            auto iter = precompressedFiles_.find(filePath);
+            // The file may have been changed during the compression
+            if (iter == precompressedFiles_.end() ||
+                iter->second.size != body.size() ||
+                iter->second.modifiedTime != modifiedTime)
+                return;
+            iter->second.br = std::move(br);
+            iter->second.gzip = std::move(gzip);
+            iter->second.pending = false;
+        });
+    return false;
+}
+
+bool StaticFileRouter::shareCachedBody(const HttpResponsePtr &resp)
+{
+    auto respImpl = static_cast<HttpResponseImpl *>(resp.get());
+    if (!respImpl->sendfileName().empty() || respImpl->streamCallback())
+        return false;
+    if (respImpl->hasSharedBody())
+    {
+        respImpl->makeHeaderString();
+        return true;
+    }
+    auto body = resp->body();
+    if (body.empty())
+        return false;
+    respImpl->setSharedBody(std::make_shared<const std::string>(body));
+    // Cache the header too, so a hit only renders the date header.
+    respImpl->makeHeaderString();
+    return true;
+}
+
 void StaticFileRouter::setFileTypes(const std::vector<std::string> &types)
 {
     fileTypeSet_.clear();
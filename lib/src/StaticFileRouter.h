@@ -16,12 +16,21 @@
 
 #include "impl_forwards.h"
 #include "MiddlewaresFunction.h"
+#include "MappedFile.h"
+#include "PrefixTrie.h"
+#include "StaticFileCache.h"
 #include <drogon/CacheMap.h>
 #include <drogon/IOThreadStorage.h>
+#include <trantor/net/EventLoopThread.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <functional>
+#include <mutex>
 #include <set>
 #include <string>
 #include <memory>
+#include <unordered_map>
 
 namespace drogon
 {
@@ -45,7 +54,17 @@ class StaticFileRouter
 
     int staticFilesCacheTime() const
     {
-        return staticFilesCacheTime_;
+        return staticFilesCacheTime_.load(std::memory_order_relaxed);
+    }
+
+    void setStaticFilesCacheCapacity(size_t capacity)
+    {
+        sharedCache_.setCapacity(capacity);
+    }
+
+    size_t staticFilesCacheCapacity() const
+    {
+        return sharedCache_.capacity();
     }
 
     void setGzipStatic(bool useGzipStatic)
@@ -58,6 +77,21 @@ class StaticFileRouter
         brStaticFlag_ = useBrStatic;
     }
 
+    void setMmapStatic(bool useMmapStatic)
+    {
+        mmapStaticFlag_ = useMmapStatic;
+    }
+
+    void setFileStatCacheTime(double cacheTime)
+    {
+        fileStatCacheTime_ = cacheTime;
+    }
+
+    void setPrecompressStatic(bool usePrecompressStatic)
+    {
+        precompressStaticFlag_ = usePrecompressStatic;
+    }
+
     void init(const std::vector<trantor::EventLoop *> &ioLoops);
     void reset();
 
@@ -120,6 +154,31 @@ class StaticFileRouter
         const HttpRequestPtr &req,
         std::function<void(const HttpResponsePtr &)> &&callback);
 
+    bool shareCachedBody(const HttpResponsePtr &resp);
+    static HttpResponsePtr responseForRequest(const HttpResponsePtr &resp,
+                                              const HttpRequestImplPtr &req);
+
+    struct FileStat
+    {
+        size_t fileSize_;
+        std::string modifiedTimeStr_;
+    };
+
+    // Return false if the path is not a regular file, the results are cached
+    // for the stat cache time.
+    bool getFileStat(const std::string &filePath, FileStat &fileStat);
+    std::shared_ptr<const MappedFile> mapFile(const std::string &path);
+    bool usePrecompressedBody(const std::string &filePath,
+                              const std::string &acceptEncoding,
+                              const HttpResponsePtr &resp);
+    HttpResponsePtr newFileResponse(const std::string &path,
+                                    size_t offset,
+                                    size_t length,
+                                    bool setContentRange,
+                                    ContentType type,
+                                    const std::string &typeString,
+                                    const HttpRequestPtr &req);
+
     std::set<std::string> fileTypeSet_{"html",
                                        "js",
                                        "css",
@@ -140,17 +199,53 @@ class StaticFileRouter
                                        "ico",
                                        "icns"};
 
-    int staticFilesCacheTime_{5};
+    // These two can be changed by a configuration reload while running.
+    std::atomic<int> staticFilesCacheTime_{5};
     bool enableLastModify_{true};
     bool enableRange_{true};
     bool gzipStaticFlag_{true};
     bool brStaticFlag_{true};
+    bool mmapStaticFlag_{false};
+    bool precompressStaticFlag_{false};
+    std::atomic<double> fileStatCacheTime_{0};
+
+    struct CachedFileStat
+    {
+        bool isFile{false};
+        FileStat stat;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    std::unique_ptr<
+        IOThreadStorage<std::unordered_map<std::string, CachedFileStat>>>
+        fileStatCache_;
     std::unique_ptr<
         IOThreadStorage<std::unique_ptr<CacheMap<std::string, char>>>>
         staticFilesCacheMap_;
+    // Responses without a body in memory (sent by sendfile), they are small
+    // so they are cached in each IO loop.
     std::unique_ptr<
         IOThreadStorage<std::unordered_map<std::string, HttpResponsePtr>>>
         staticFilesCache_;
+    // Responses with the file in memory, shared by all IO loops
+    StaticFileCache sharedCache_;
+    std::mutex mappedFilesMutex_;
+    std::unordered_map<std::string, std::shared_ptr<const MappedFile>>
+        mappedFiles_;
+
+    // The compressed variants of a static file, made in the background
+    struct PrecompressedFile
+    {
+        size_t size{0};
+        std::filesystem::file_time_type modifiedTime;
+        std::shared_ptr<const std::string> br;
+        std::shared_ptr<const std::string> gzip;
+        bool pending{false};
+    };
+
+    std::unique_ptr<trantor::EventLoopThread> precompressionThread_;
+    std::mutex precompressedFilesMutex_;
+    std::unordered_map<std::string, PrecompressedFile> precompressedFiles_;
     std::vector<std::pair<std::string, std::string>> headers_;
     bool implicitPageEnable_{true};
     std::string implicitPage_{"index.html"};
@@ -191,5 +286,9 @@ class StaticFileRouter
 
     std::shared_ptr<IOThreadStorage<std::vector<Location>>> ioLocationsPtr_;
     std::vector<Location> locations_;
+    // The prefixes of the locations, built by init(). The lower case prefixes
+    // of the case-insensitive locations are matched with the lower case path.
+    internal::PrefixTrie locationTrie_;
+    internal::PrefixTrie caseInsensitiveLocationTrie_;
 };
 }  // namespace drogon
@@ -0,0 +1,307 @@
+/**
+ *
+ *  StreamCompressor.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "StreamCompressor.h"
+#include <drogon/config.h>
+#include <trantor/utils/Logger.h>
+#ifdef USE_BROTLI
+#include <brotli/encode.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace drogon;
+
+namespace
+{
+class GzipCompressor : public StreamCompressor
+{
+  public:
+    explicit GzipCompressor(int level)
+    {
+        memset(&strm_, 0, sizeof(strm_));
+        ok_ = deflateInit2(&strm_,
+                           level,
+                           Z_DEFLATED,
+                           MAX_WBITS + 16,
+                           8,
+                           Z_DEFAULT_STRATEGY) == Z_OK;
+        if (!ok_)
+            LOG_ERROR << "deflateInit2 error!";
+    }
+
+    ~GzipCompressor() override
+    {
+        if (ok_)
+            (void)deflateEnd(&strm_);
+    }
+
+    bool valid() const
+    {
+        return ok_;
+    }
+
+    bool compress(const char *data,
+                  size_t length,
+                  bool flush,
+                  std::string &output) override
+    {
+        return deflateData(data,
+                           length,
+                           flush ? Z_SYNC_FLUSH : Z_NO_FLUSH,
+                           output);
+    }
+
+    bool finish(std::string &output) override
+    {
+        return deflateData(nullptr, 0, Z_FINISH, output);
+    }
+
+  private:
+    bool deflateData(const char *data,
+                     size_t length,
+                     int flush,
+                     std::string &output)
+    {
+        if (!ok_)
+            return false;
+        strm_.next_in = (Bytef *)data;
+        strm_.avail_in = static_cast<uInt>(length);
+        // deflate() is called until it leaves room in the output, so nothing
+        // is kept inside zlib for the requested flush mode.
+        do
+        {
+            auto offset = output.size();
+            auto room = (std::max)(
+                static_cast<size_t>(deflateBound(&strm_,
+                                                 static_cast<uLong>(length))),
+                size_t{64});
+            output.resize(offset + room);
+            strm_.next_out = (Bytef *)output.data() + offset;
+            strm_.avail_out = static_cast<uInt>(room);
+            auto ret = deflate(&strm_, flush);
+            output.resize(output.size() - strm_.avail_out);
+            if (ret == Z_STREAM_ERROR)
+            {
+                LOG_ERROR << "deflate error!";
+                ok_ = false;
+                return false;
+            }
+        } while (strm_.avail_out == 0);
+        return true;
+    }
+
+    z_stream strm_;
+    bool ok_{false};
+};
+
+#ifdef USE_BROTLI
+class BrotliCompressor : public StreamCompressor
+{
+  public:
+    explicit BrotliCompressor(int quality)
+        : state_(BrotliEncoderCreateInstance(nullptr, nullptr, nullptr))
+    {
+        if (state_)
+        {
+            BrotliEncoderSetParameter(state_,
+                                      BROTLI_PARAM_QUALITY,
+                                      static_cast<uint32_t>(quality));
+        }
+        else
+        {
+            LOG_ERROR << "BrotliEncoderCreateInstance error!";
+        }
+    }
+
+    ~BrotliCompressor() override
+    {
+        if (state_)
+            BrotliEncoderDestroyInstance(state_);
+    }
+
+    bool valid() const
+    {
+        return state_ != nullptr;
+    }
+
+    bool compress(const char *data,
+                  size_t length,
+                  bool flush,
+                  std::string &output) override
+    {
+        return encode(data,
+                      length,
+                      flush ? BROTLI_OPERATION_FLUSH : BROTLI_OPERATION_PROCESS,
+                      output);
+    }
+
+    bool finish(std::string &output) override
+    {
+        return encode(nullptr, 0, BROTLI_OPERATION_FINISH, output);
+    }
+
+  private:
+    bool encode(const char *data,
+                size_t length,
+                BrotliEncoderOperation op,
+                std::string &output)
+    {
+        if (!state_)
+            return false;
+        size_t availableIn = length;
+        auto nextIn = reinterpret_cast<const uint8_t *>(data);
+        while (true)
+        {
+            size_t availableOut = 0;
+            if (!BrotliEncoderCompressStream(state_,
+                                             op,
+                                             &availableIn,
+                                             &nextIn,
+                                             &availableOut,
+                                             nullptr,
+                                             nullptr))
+            {
+                LOG_ERROR << "BrotliEncoderCompressStream error!";
+                return false;
+            }
+            size_t size = 0;
+            auto out = BrotliEncoderTakeOutput(state_, &size);
+            output.append(reinterpret_cast<const char *>(out), size);
+            if (availableIn == 0 && !BrotliEncoderHasMoreOutput(state_) &&
+                (op != BROTLI_OPERATION_FINISH ||
+                 BrotliEncoderIsFinished(state_)))
+                return true;
+        }
+    }
+
+    BrotliEncoderState *state_;
+};
+#endif
+
+#ifdef USE_ZSTD
+class ZstdCompressor : public StreamCompressor
+{
+  public:
+    explicit ZstdCompressor(int level) : ctx_(ZSTD_createCCtx())
+    {
+        if (ctx_)
+        {
+            ZSTD_CCtx_setParameter(ctx_, ZSTD_c_compressionLevel, level);
+        }
+        else
+        {
+            LOG_ERROR << "ZSTD_createCCtx error!";
+        }
+    }
+
+    ~ZstdCompressor() override
+    {
+        if (ctx_)
+            ZSTD_freeCCtx(ctx_);
+    }
+
+    bool valid() const
+    {
+        return ctx_ != nullptr;
+    }
+
+    bool compress(const char *data,
+                  size_t length,
+                  bool flush,
+                  std::string &output) override
+    {
+        return encode(data,
+                      length,
+                      flush ? ZSTD_e_flush : ZSTD_e_continue,
+                      output);
+    }
+
+    bool finish(std::string &output) override
+    {
+        return encode(nullptr, 0, ZSTD_e_end, output);
+    }
+
+  private:
+    bool encode(const char *data,
+                size_t length,
+                ZSTD_EndDirective op,
+                std::string &output)
+    {
+        if (!ctx_)
+            return false;
+        ZSTD_inBuffer input{data, length, 0};
+        while (true)
+        {
+            auto offset = output.size();
+            output.resize(offset + ZSTD_CStreamOutSize());
+            ZSTD_outBuffer out{&output[offset], output.size() - offset, 0};
+            auto remaining = ZSTD_compressStream2(ctx_, &out, &input, op);
+            output.resize(offset + out.pos);
+            if (ZSTD_isError(remaining))
+            {
+                LOG_ERROR << "ZSTD_compressStream2 error: "
+                          << ZSTD_getErrorName(remaining);
+                return false;
+            }
+            // Flushing and ending are done when nothing remains, otherwise
+            // all input must be consumed.
+            if (op == ZSTD_e_continue ? input.pos == input.size
+                                      : remaining == 0)
+                return true;
+        }
+    }
+
+    ZSTD_CCtx *ctx_;
+};
+#endif
+}  // namespace
+
+std::unique_ptr<StreamCompressor> StreamCompressor::newCompressor(
+    CompressionEncoding encoding,
+    int level)
+{
+    switch (encoding)
+    {
+        case CompressionEncoding::kGzip:
+        {
+            auto compressor = std::make_unique<GzipCompressor>(level);
+            if (compressor->valid())
+                return compressor;
+            break;
+        }
+        case CompressionEncoding::kBrotli:
+        {
+#ifdef USE_BROTLI
+            auto compressor = std::make_unique<BrotliCompressor>(level);
+            if (compressor->valid())
+                return compressor;
+#endif
+            break;
+        }
+        case CompressionEncoding::kZstd:
+        {
+#ifdef USE_ZSTD
+            auto compressor = std::make_unique<ZstdCompressor>(level);
+            if (compressor->valid())
+                return compressor;
+#endif
+            break;
+        }
+    }
+    return nullptr;
+}
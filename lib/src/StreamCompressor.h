@@ -0,0 +1,57 @@
+/**
+ *
+ *  StreamCompressor.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/CompressionPolicy.h>
+#include <trantor/utils/NonCopyable.h>
+#include <memory>
+#include <string>
+
+namespace drogon
+{
+/**
+ * @brief An incremental encoder, used to compress stream responses of which
+ * the body is not known in advance.
+ */
+class StreamCompressor : public trantor::NonCopyable
+{
+  public:
+    /**
+     * @brief Create a compressor, return nullptr if the encoding is not
+     * supported.
+     *
+     * @param level the level of the encoding, see CompressionPolicy.
+     */
+    static std::unique_ptr<StreamCompressor> newCompressor(
+        CompressionEncoding encoding,
+        int level);
+
+    virtual ~StreamCompressor() = default;
+
+    /**
+     * @brief Compress the data and append the output to the string. If flush
+     * is true, all the data compressed so far is output, so the client can
+     * decode it without waiting for more data, at the cost of a worse ratio.
+     *
+     * @return false on errors.
+     */
+    virtual bool compress(const char *data,
+                          size_t length,
+                          bool flush,
+                          std::string &output) = 0;
+
+    /// Finish the stream and append the remaining output to the string.
+    virtual bool finish(std::string &output) = 0;
+};
+}  // namespace drogon
@@ -0,0 +1,197 @@
+/**
+ *
+ *  StreamDecompressor.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "StreamDecompressor.h"
+#include <drogon/config.h>
+#include <trantor/utils/Logger.h>
+#ifdef USE_BROTLI
+#include <brotli/decode.h>
+#endif
+#include <zlib.h>
+#include <cstring>
+
+using namespace drogon;
+
+namespace
+{
+class GzipDecompressor : public StreamDecompressor
+{
+  public:
+    GzipDecompressor()
+    {
+        memset(&strm_, 0, sizeof(strm_));
+        // The gzip and zlib formats are both accepted
+        initialized_ = inflateInit2(&strm_, MAX_WBITS + 32) == Z_OK;
+        if (!initialized_)
+            LOG_ERROR << "inflateInit2 error!";
+    }
+
+    ~GzipDecompressor() override
+    {
+        if (initialized_)
+            (void)inflateEnd(&strm_);
+    }
+
+    bool valid() const
+    {
+        return initialized_;
+    }
+
+    bool decompress(const char *data,
+                    size_t length,
+                    const OutputCallback &output) override
+    {
+        if (finished_)
+            return true;
+        if (!initialized_ || failed_)
+            return false;
+        strm_.next_in = (Bytef *)data;
+        strm_.avail_in = static_cast<uInt>(length);
+        do
+        {
+            strm_.next_out = (Bytef *)buffer_;
+            strm_.avail_out = static_cast<uInt>(kBufferSize);
+            auto ret = inflate(&strm_, Z_NO_FLUSH);
+            // Z_BUF_ERROR only means that no progress was possible
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+            {
+                failed_ = true;
+                return false;
+            }
+            auto outSize = kBufferSize - strm_.avail_out;
+            if (outSize > 0 && !output(buffer_, outSize))
+            {
+                failed_ = true;
+                return false;
+            }
+            if (ret == Z_STREAM_END)
+            {
+                finished_ = true;
+                break;
+            }
+        } while (strm_.avail_in > 0 || strm_.avail_out == 0);
+        strm_.next_in = nullptr;
+        strm_.next_out = nullptr;
+        return true;
+    }
+
+    bool finished() const override
+    {
+        return finished_;
+    }
+
+  private:
+    z_stream strm_;
+    bool initialized_{false};
+    bool failed_{false};
+    bool finished_{false};
+    char buffer_[kBufferSize];
+};
+
+#ifdef USE_BROTLI
+class BrotliDecompressor : public StreamDecompressor
+{
+  public:
+    BrotliDecompressor()
+        : state_(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr))
+    {
+        if (!state_)
+            LOG_ERROR << "BrotliDecoderCreateInstance error!";
+    }
+
+    ~BrotliDecompressor() override
+    {
+        if (state_)
+            BrotliDecoderDestroyInstance(state_);
+    }
+
+    bool valid() const
+    {
+        return state_ != nullptr;
+    }
+
+    bool decompress(const char *data,
+                    size_t length,
+                    const OutputCallback &output) override
+    {
+        if (finished_)
+            return true;
+        if (!state_ || failed_)
+            return false;
+        size_t availableIn = length;
+        auto nextIn = reinterpret_cast<const uint8_t *>(data);
+        while (true)
+        {
+            size_t availableOut = kBufferSize;
+            auto nextOut = buffer_;
+            auto result = BrotliDecoderDecompressStream(state_,
+                                                        &availableIn,
+                                                        &nextIn,
+                                                        &availableOut,
+                                                        &nextOut,
+                                                        nullptr);
+            if (result == BROTLI_DECODER_RESULT_ERROR)
+            {
+                failed_ = true;
+                return false;
+            }
+            auto outSize = kBufferSize - availableOut;
+            if (outSize > 0 &&
+                !output(reinterpret_cast<const char *>(buffer_), outSize))
+            {
+                failed_ = true;
+                return false;
+            }
+            if (result == BROTLI_DECODER_RESULT_SUCCESS)
+            {
+                finished_ = true;
+                return true;
+            }
+            if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT)
+                return true;
+        }
+    }
+
+    bool finished() const override
+    {
+        return finished_;
+    }
+
+  private:
+    BrotliDecoderState *state_;
+    bool failed_{false};
+    bool finished_{false};
+    uint8_t buffer_[kBufferSize];
+};
+#endif
+}  // namespace
+
+std::unique_ptr<StreamDecompressor> StreamDecompressor::newDecompressor(
+    std::string_view encoding)
+{
+    if (encoding == "gzip")
+    {
+        auto decompressor = std::make_unique<GzipDecompressor>();
+        if (decompressor->valid())
+            return decompressor;
+    }
+#ifdef USE_BROTLI
+    else if (encoding == "br")
+    {
+        auto decompressor = std::make_unique<BrotliDecompressor>();
+        if (decompressor->valid())
+            return decompressor;
+    }
+#endif
+    return nullptr;
+}
@@ -0,0 +1,61 @@
+/**
+ *
+ *  StreamDecompressor.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/utils/NonCopyable.h>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+namespace drogon
+{
+/**
+ * @brief An incremental decoder, used to decompress the bodies of stream
+ * requests as they are received, instead of keeping the whole compressed and
+ * decompressed bodies at once.
+ */
+class StreamDecompressor : public trantor::NonCopyable
+{
+  public:
+    /// Called with each piece of the output, return false to stop.
+    using OutputCallback = std::function<bool(const char *, size_t)>;
+
+    /**
+     * @brief Create a decompressor of the content encoding ("gzip", "br"),
+     * return nullptr if it is not supported.
+     */
+    static std::unique_ptr<StreamDecompressor> newDecompressor(
+        std::string_view encoding);
+
+    virtual ~StreamDecompressor() = default;
+
+    /**
+     * @brief Decompress the data, the output is passed to the callback in
+     * pieces of at most 16KB. The data after the end of the compressed stream
+     * is ignored.
+     *
+     * @return false if the data is corrupt or the callback returns false,
+     * the decompressor can't be used any more then.
+     */
+    virtual bool decompress(const char *data,
+                            size_t length,
+                            const OutputCallback &output) = 0;
+
+    /// True once the end of the compressed stream is decoded.
+    virtual bool finished() const = 0;
+
+  protected:
+    static constexpr size_t kBufferSize = 16 * 1024;
+};
+}  // namespace drogon
@@ -0,0 +1,355 @@
+/**
+ *
+ *  @file StreamDigest.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "StreamDigest.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace drogon::internal;
+
+namespace
+{
+std::string toHex(const unsigned char *data, size_t length)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    std::string hex;
+    hex.reserve(length * 2);
+    for (size_t i = 0; i < length; ++i)
+    {
+        hex.push_back(digits[data[i] >> 4]);
+        hex.push_back(digits[data[i] & 0x0f]);
+    }
+    return hex;
+}
+
+inline uint32_t rotl32(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+inline uint32_t rotr32(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+inline uint64_t rotl64(uint64_t x, int n)
+{
+    return n == 0 ? x : (x << n) | (x >> (64 - n));
+}
+
+// Feed the data to a digest with 64 bytes blocks.
+template <typename Transform>
+void updateBlocks(unsigned char *buffer,
+                  uint64_t &totalLength,
+                  const char *data,
+                  size_t length,
+                  Transform &&transform)
+{
+    auto in = reinterpret_cast<const unsigned char *>(data);
+    size_t used = static_cast<size_t>(totalLength % 64);
+    totalLength += length;
+    if (used > 0)
+    {
+        size_t n = std::min(length, 64 - used);
+        memcpy(buffer + used, in, n);
+        in += n;
+        length -= n;
+        if (used + n < 64)
+            return;
+        transform(buffer);
+    }
+    for (; length >= 64; in += 64, length -= 64)
+        transform(in);
+    if (length > 0)
+        memcpy(buffer, in, length);
+}
+}  // namespace
+
+Md5Digest::Md5Digest()
+    : state_{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476}
+{
+}
+
+void Md5Digest::transform(const unsigned char *block)
+{
+    static const uint32_t k[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf,
+        0x4787c62a, 0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af,
+        0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e,
+        0x49b40821, 0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+        0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8, 0x21e1cde6,
+        0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+        0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122,
+        0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039,
+        0xe6db99e5, 0x1fa27cf8, 0xc4ac5665, 0xf4292244, 0x432aff97,
+        0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d,
+        0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+        0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+    static const int shifts[16] =
+        {7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+    uint32_t m[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        m[i] = static_cast<uint32_t>(block[i * 4]) |
+               (static_cast<uint32_t>(block[i * 4 + 1]) << 8) |
+               (static_cast<uint32_t>(block[i * 4 + 2]) << 16) |
+               (static_cast<uint32_t>(block[i * 4 + 3]) << 24);
+    }
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    for (int i = 0; i < 64; ++i)
+    {
+        uint32_t f;
+        int g;
+        int round = i / 16;
+        if (round == 0)
+        {
+            f = (b & c) | (~b & d);
+            g = i;
+        }
+        else if (round == 1)
+        {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        }
+        else if (round == 2)
+        {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        }
+        else
+        {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+        uint32_t temp = d;
+        d = c;
+        c = b;
+        b += rotl32(a + f + k[i] + m[g], shifts[round * 4 + i % 4]);
+        a = temp;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+}
+
+void Md5Digest::update(const char *data, size_t length)
+{
+    updateBlocks(buffer_, length_, data, length, [this](auto block) {
+        transform(block);
+    });
+}
+
+std::string Md5Digest::finish()
+{
+    uint64_t bits = length_ * 8;
+    unsigned char padding[72] = {0x80};
+    size_t used = static_cast<size_t>(length_ % 64);
+    size_t padLength = used < 56 ? 56 - used : 120 - used;
+    for (int i = 0; i < 8; ++i)
+        padding[padLength + i] = static_cast<unsigned char>(bits >> (8 * i));
+    update(reinterpret_cast<const char *>(padding), padLength + 8);
+    unsigned char digest[16];
+    for (int i = 0; i < 16; ++i)
+        digest[i] = static_cast<unsigned char>(state_[i / 4] >> (8 * (i % 4)));
+    return toHex(digest, sizeof(digest));
+}
+
+Sha256Digest::Sha256Digest()
+    : state_{0x6a09e667,
+             0xbb67ae85,
+             0x3c6ef372,
+             0xa54ff53a,
+             0x510e527f,
+             0x9b05688c,
+             0x1f83d9ab,
+             0x5be0cd19}
+{
+}
+
+void Sha256Digest::transform(const unsigned char *block)
+{
+    static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
+        0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
+        0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+        0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+        0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
+        0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+        0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+        0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
+        0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+        0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+        0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i)
+    {
+        w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) |
+               (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+               (static_cast<uint32_t>(block[i * 4 + 2]) << 8) |
+               static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; ++i)
+    {
+        uint32_t s0 =
+            rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 =
+            rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t v[8];
+    memcpy(v, state_, sizeof(v));
+    for (int i = 0; i < 64; ++i)
+    {
+        uint32_t s1 = rotr32(v[4], 6) ^ rotr32(v[4], 11) ^ rotr32(v[4], 25);
+        uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+        uint32_t t1 = v[7] + s1 + ch + k[i] + w[i];
+        uint32_t s0 = rotr32(v[0], 2) ^ rotr32(v[0], 13) ^ rotr32(v[0], 22);
+        uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+        uint32_t t2 = s0 + maj;
+        v[7] = v[6];
+        v[6] = v[5];
+        v[5] = v[4];
+        v[4] = v[3] + t1;
+        v[3] = v[2];
+        v[2] = v[1];
+        v[1] = v[0];
+        v[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; ++i)
+        state_[i] += v[i];
+}
+
+void Sha256Digest::update(const char *data, size_t length)
+{
+    updateBlocks(buffer_, length_, data, length, [this](auto block) {
+        transform(block);
+    });
+}
+
+std::string Sha256Digest::finish()
+{
+    uint64_t bits = length_ * 8;
+    unsigned char padding[72] = {0x80};
+    size_t used = static_cast<size_t>(length_ % 64);
+    size_t padLength = used < 56 ? 56 - used : 120 - used;
+    for (int i = 0; i < 8; ++i)
+    {
+        padding[padLength + i] =
+            static_cast<unsigned char>(bits >> (8 * (7 - i)));
+    }
+    update(reinterpret_cast<const char *>(padding), padLength + 8);
+    unsigned char digest[32];
+    for (int i = 0; i < 32; ++i)
+    {
+        digest[i] =
+            static_cast<unsigned char>(state_[i / 4] >> (8 * (3 - i % 4)));
+    }
+    return toHex(digest, sizeof(digest));
+}
+
+Sha3Digest::Sha3Digest() : state_{}
+{
+}
+
+void Sha3Digest::absorb()
+{
+    static const uint64_t roundConstants[24] = {
+        0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+        0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+        0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+        0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+        0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+        0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+        0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+        0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+    static const int rotations[25] = {0,  1,  62, 28, 27, 36, 44, 6,  55,
+                                      20, 3,  10, 43, 25, 39, 41, 45, 15,
+                                      21, 8,  18, 2,  61, 56, 14};
+    for (size_t i = 0; i < kRate / 8; ++i)
+    {
+        uint64_t lane = 0;
+        for (int j = 0; j < 8; ++j)
+            lane |= static_cast<uint64_t>(buffer_[i * 8 + j]) << (8 * j);
+        state_[i] ^= lane;
+    }
+    // Keccak-f[1600], the lanes are indexed by x + 5 * y.
+    for (int round = 0; round < 24; ++round)
+    {
+        uint64_t c[5];
+        for (int x = 0; x < 5; ++x)
+        {
+            c[x] = state_[x] ^ state_[x + 5] ^ state_[x + 10] ^
+                   state_[x + 15] ^ state_[x + 20];
+        }
+        for (int x = 0; x < 5; ++x)
+        {
+            uint64_t d = c[(x + 4) % 5] ^ rotl64(c[(x + 1) % 5], 1);
+            for (int y = 0; y < 25; y += 5)
+                state_[x + y] ^= d;
+        }
+        uint64_t b[25];
+        for (int x = 0; x < 5; ++x)
+        {
+            for (int y = 0; y < 5; ++y)
+            {
+                b[y + 5 * ((2 * x + 3 * y) % 5)] =
+                    rotl64(state_[x + 5 * y], rotations[x + 5 * y]);
+            }
+        }
+        for (int x = 0; x < 5; ++x)
+        {
+            for (int y = 0; y < 25; y += 5)
+            {
+                state_[x + y] =
+                    b[x + y] ^ (~b[(x + 1) % 5 + y] & b[(x + 2) % 5 + y]);
+            }
+        }
+        state_[0] ^= roundConstants[round];
+    }
+}
+
+void Sha3Digest::update(const char *data, size_t length)
+{
+    auto in = reinterpret_cast<const unsigned char *>(data);
+    while (length > 0)
+    {
+        size_t n = std::min(length, kRate - used_);
+        memcpy(buffer_ + used_, in, n);
+        used_ += n;
+        in += n;
+        length -= n;
+        if (used_ == kRate)
+        {
+            absorb();
+            used_ = 0;
+        }
+    }
+}
+
+std::string Sha3Digest::finish()
+{
+    memset(buffer_ + used_, 0, kRate - used_);
+    buffer_[used_] ^= 0x06;
+    buffer_[kRate - 1] ^= 0x80;
+    absorb();
+    used_ = 0;
+    unsigned char digest[32];
+    for (int i = 0; i < 32; ++i)
+        digest[i] = static_cast<unsigned char>(state_[i / 8] >> (8 * (i % 8)));
+    return toHex(digest, sizeof(digest));
+}
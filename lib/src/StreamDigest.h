@@ -0,0 +1,79 @@
+/**
+ *
+ *  @file StreamDigest.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace drogon
+{
+namespace internal
+{
+/**
+ * @brief The incremental digests of the data received in pieces, e.g. the
+ * uploaded files. finish() returns the same upper case hex strings as
+ * utils::getMd5(), utils::getSha256() and utils::getSha3() of the whole data.
+ */
+class DROGON_EXPORT Md5Digest
+{
+  public:
+    Md5Digest();
+    void update(const char *data, size_t length);
+    std::string finish();
+
+  private:
+    void transform(const unsigned char *block);
+
+    uint32_t state_[4];
+    uint64_t length_{0};
+    unsigned char buffer_[64];
+};
+
+class DROGON_EXPORT Sha256Digest
+{
+  public:
+    Sha256Digest();
+    void update(const char *data, size_t length);
+    std::string finish();
+
+  private:
+    void transform(const unsigned char *block);
+
+    uint32_t state_[8];
+    uint64_t length_{0};
+    unsigned char buffer_[64];
+};
+
+/// SHA3-256
+class DROGON_EXPORT Sha3Digest
+{
+  public:
+    Sha3Digest();
+    void update(const char *data, size_t length);
+    std::string finish();
+
+  private:
+    static constexpr size_t kRate = 136;
+
+    void absorb();
+
+    uint64_t state_[25];
+    size_t used_{0};
+    unsigned char buffer_[kRate];
+};
+}  // namespace internal
+}  // namespace drogon
@@ -0,0 +1,256 @@
+/**
+ *
+ *  @file TieredCache.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/TieredCache.h>
+#include <drogon/HttpAppFramework.h>
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <random>
+
+using namespace drogon;
+
+TieredCache::TieredCache(nosql::RedisClientPtr client)
+    : TieredCache(std::move(client), Options())
+{
+}
+
+TieredCache::TieredCache(nosql::RedisClientPtr client, const Options &options)
+    : client_(std::move(client)), options_(options)
+{
+    if (options_.localTtl > 0)
+    {
+        // No timing wheels, the expired values are replaced when they are
+        // looked up or evicted.
+        local_ =
+            std::make_unique<ShardedCacheMap<std::string, LocalEntryPtr>>(
+                app().getLoop(),
+                0,
+                0,
+                0,
+                nullptr,
+                nullptr,
+                options_.maxLocalEntries,
+                options_.localShards);
+    }
+}
+
+std::string TieredCache::encode(const Value &value)
+{
+    if (!value)
+        return "n";
+    std::string str;
+    str.reserve(value->size() + 1);
+    str += 'v';
+    str += *value;
+    return str;
+}
+
+bool TieredCache::decode(const std::string &str, Value &value)
+{
+    if (str == "n")
+    {
+        value.reset();
+        return true;
+    }
+    if (str.empty() || str[0] != 'v')
+        return false;
+    value = str.substr(1);
+    return true;
+}
+
+void TieredCache::get(const std::string &key,
+                      Loader loader,
+                      ValueCallback callback,
+                      ExceptionCallback exceptionCallback)
+{
+    LocalEntryPtr entry;
+    if (local_ && local_->findAndFetch(key, entry) &&
+        entry->expiry > Clock::now())
+    {
+        callback(entry->value);
+        return;
+    }
+    flights_.run(
+        key,
+        [callback = std::move(callback),
+         exceptionCallback = std::move(exceptionCallback)](
+            ValuePtr value, std::exception_ptr exception) {
+            if (exception)
+                exceptionCallback(exception);
+            else
+                callback(*value);
+        },
+        [thisPtr = shared_from_this(), key, loader = std::move(loader)](
+            Flights::Callback &&done) mutable {
+            thisPtr->fetch(key, std::move(loader), std::move(done));
+        });
+}
+
+void TieredCache::fetch(const std::string &key,
+                        Loader &&loader,
+                        Flights::Callback &&done)
+{
+    if (!client_)
+    {
+        load(key, std::move(loader), std::move(done));
+        return;
+    }
+    // Only one of the callbacks is called.
+    auto loaderPtr = std::make_shared<Loader>(std::move(loader));
+    auto donePtr = std::make_shared<Flights::Callback>(std::move(done));
+    auto redisKey = options_.keyPrefix + key;
+    client_->execCommandAsync(
+        [thisPtr = shared_from_this(), key, loaderPtr, donePtr](
+            const nosql::RedisResult &result) {
+            Value value;
+            if (result.type() == nosql::RedisResultType::kString &&
+                decode(result.asString(), value))
+            {
+                thisPtr->storeLocal(key, value);
+                (*donePtr)(std::make_shared<const Value>(std::move(value)),
+                           nullptr);
+                return;
+            }
+            thisPtr->load(key, std::move(*loaderPtr), std::move(*donePtr));
+        },
+        [thisPtr = shared_from_this(), key, loaderPtr, donePtr](
+            const nosql::RedisException &e) {
+            LOG_DEBUG << "Failed to get " << key
+                      << " from redis, it's loaded instead: " << e.what();
+            thisPtr->load(key, std::move(*loaderPtr), std::move(*donePtr));
+        },
+        "GET %s",
+        redisKey.c_str());
+}
+
+void TieredCache::load(const std::string &key,
+                       Loader &&loader,
+                       Flights::Callback &&done)
+{
+    auto donePtr = std::make_shared<Flights::Callback>(std::move(done));
+    try
+    {
+        loader(
+            [thisPtr = shared_from_this(), key, donePtr](const Value &value) {
+                thisPtr->store(key, value);
+                (*donePtr)(std::make_shared<const Value>(value), nullptr);
+            },
+            [donePtr](const std::exception_ptr &exception) {
+                (*donePtr)(nullptr, exception);
+            });
+    }
+    catch (...)
+    {
+        (*donePtr)(nullptr, std::current_exception());
+    }
+}
+
+void TieredCache::set(const std::string &key, std::string value)
+{
+    store(key, Value(std::move(value)));
+}
+
+void TieredCache::erase(const std::string &key)
+{
+    eraseLocal(key);
+    if (!client_)
+        return;
+    auto redisKey = options_.keyPrefix + key;
+    client_->execCommandAsync(
+        [](const nosql::RedisResult &) {},
+        [key](const nosql::RedisException &e) {
+            LOG_ERROR << "Failed to erase " << key
+                      << " from redis: " << e.what();
+        },
+        "DEL %s",
+        redisKey.c_str());
+}
+
+void TieredCache::eraseLocal(const std::string &key)
+{
+    if (local_)
+        local_->erase(key);
+}
+
+void TieredCache::store(const std::string &key, const Value &value)
+{
+    storeLocal(key, value);
+    auto ttl = value ? options_.ttl : options_.negativeTtl;
+    if (!client_ || ttl <= 0)
+        return;
+    auto encoded = encode(value);
+    auto redisKey = options_.keyPrefix + key;
+    // At least one millisecond, PX doesn't accept 0.
+    auto milliseconds =
+        std::max(static_cast<long long>(jitter(ttl) * 1000), 1LL);
+    client_->execCommandAsync(
+        [](const nosql::RedisResult &) {},
+        [key](const nosql::RedisException &e) {
+            LOG_DEBUG << "Failed to store " << key << " in redis: " << e.what();
+        },
+        "SET %s %b PX %lld",
+        redisKey.c_str(),
+        encoded.data(),
+        encoded.size(),
+        milliseconds);
+}
+
+void TieredCache::storeLocal(const std::string &key, const Value &value)
+{
+    if (!local_)
+        return;
+    auto ttl = options_.localTtl;
+    if (!value)
+        ttl = std::min(ttl, options_.negativeTtl);
+    if (ttl <= 0)
+    {
+        // The old value mustn't be found instead.
+        local_->erase(key);
+        return;
+    }
+    auto entry = std::make_shared<LocalEntry>();
+    entry->value = value;
+    entry->expiry =
+        Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(jitter(ttl)));
+    local_->insert(key, LocalEntryPtr(std::move(entry)));
+}
+
+double TieredCache::jitter(double ttl) const
+{
+    if (options_.ttlJitter <= 0)
+        return ttl;
+    thread_local std::mt19937 generator{std::random_device{}()};
+    std::uniform_real_distribution<double> distribution(0.0,
+                                                        options_.ttlJitter);
+    return ttl * (1.0 + distribution(generator));
+}
+
+#ifdef __cpp_impl_coroutine
+void internal::TieredCacheAwaiter::await_suspend(
+    std::coroutine_handle<> handle)
+{
+    cache_->get(
+        key_,
+        std::move(loader_),
+        [this, handle](const TieredCache::Value &value) {
+            setValue(value);
+            handle.resume();
+        },
+        [this, handle](const std::exception_ptr &exception) {
+            setException(exception);
+            handle.resume();
+        });
+}
+#endif
@@ -1,4 +1,5 @@
 #include "TokenBucketRateLimiter.h"
+#include <algorithm>
 
 using namespace drogon;
 
@@ -6,26 +7,35 @@ TokenBucketRateLimiter::TokenBucketRateLimiter(
     size_t capacity,
     std::chrono::duration<double> timeUnit)
     : capacity_(capacity),
-      lastTime_(std::chrono::steady_clock::now()),
-      timeUnit_(timeUnit),
-      tokens_((double)capacity_)
+      startTime_(std::chrono::steady_clock::now()),
+      timeUnit_(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(timeUnit)
+              .count())
 {
+    interval_ = capacity_ > 0 ? (std::max)(timeUnit_ / (int64_t)capacity_,
+                                           int64_t(1))
+                              : timeUnit_;
 }
 
 // implementation of the token bucket algorithm
 bool TokenBucketRateLimiter::isAllowed()
 {
-    auto now = std::chrono::steady_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::duration<double>>(
-        now - lastTime_);
-    tokens_ += capacity_ * (duration / timeUnit_);
-    if (tokens_ > capacity_)
-        tokens_ = (double)capacity_;
-    lastTime_ = now;
-    if (tokens_ > 1.0)
+    if (capacity_ == 0)
+        return false;
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - startTime_)
+                      .count();
+    auto arrivalTime = arrivalTime_.load(std::memory_order_relaxed);
+    for (;;)
     {
-        tokens_ -= 1.0;
-        return true;
+        // The bucket is full when the arrival time is in the past, every
+        // request consumes one interval.
+        auto newArrivalTime = (std::max)(arrivalTime, now) + interval_;
+        if (newArrivalTime - now > timeUnit_)
+            return false;
+        if (arrivalTime_.compare_exchange_weak(arrivalTime,
+                                               newArrivalTime,
+                                               std::memory_order_relaxed))
+            return true;
     }
-    return false;
 }
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <drogon/RateLimiter.h>
+#include <atomic>
+#include <cstdint>
 
 namespace drogon
 {
+// The token bucket is kept as the theoretical arrival time of the next
+// request (GCRA), so a single atomic is enough and no lock is needed.
 class TokenBucketRateLimiter : public RateLimiter
 {
   public:
@@ -14,8 +18,10 @@ class TokenBucketRateLimiter : public RateLimiter
 
   private:
     size_t capacity_;
-    std::chrono::steady_clock::time_point lastTime_;
-    std::chrono::duration<double> timeUnit_;
-    double tokens_;
+    std::chrono::steady_clock::time_point startTime_;
+    // The time unit and the time needed to refill one token, in nanoseconds.
+    int64_t timeUnit_;
+    int64_t interval_;
+    std::atomic<int64_t> arrivalTime_{0};
 };
 }  // namespace drogon
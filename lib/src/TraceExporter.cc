@@ -0,0 +1,255 @@
+#include <drogon/plugins/TraceExporter.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <trantor/utils/Logger.h>
+#include <string>
+#include "RequestTracing.h"
+
+using namespace drogon;
+using namespace drogon::plugin;
+
+// The kinds and status codes of the spans in OTLP.
+static constexpr int kSpanKindInternal = 1;
+static constexpr int kSpanKindServer = 2;
+static constexpr int kSpanKindClient = 3;
+static constexpr int kStatusError = 2;
+
+static Json::Value stringAttribute(const std::string &key,
+                                   const std::string &value)
+{
+    Json::Value attribute;
+    attribute["key"] = key;
+    attribute["value"]["stringValue"] = value;
+    return attribute;
+}
+
+static Json::Value intAttribute(const std::string &key, int64_t value)
+{
+    Json::Value attribute;
+    attribute["key"] = key;
+    // 64-bit integers are strings in the json encoding of OTLP.
+    attribute["value"]["intValue"] = std::to_string(value);
+    return attribute;
+}
+
+static Json::Value newSpan(const RequestTrace &trace,
+                           const std::string &spanId,
+                           const std::string &parentSpanId,
+                           const std::string &name,
+                           int kind,
+                           int64_t start,
+                           int64_t end)
+{
+    Json::Value span;
+    span["traceId"] = trace.traceId();
+    span["spanId"] = spanId;
+    if (!parentSpanId.empty())
+        span["parentSpanId"] = parentSpanId;
+    span["name"] = name;
+    span["kind"] = kind;
+    span["startTimeUnixNano"] = std::to_string(start * 1000);
+    span["endTimeUnixNano"] = std::to_string(end * 1000);
+    span["attributes"] = Json::arrayValue;
+    return span;
+}
+
+void TraceExporter::initAndStart(const Json::Value &config)
+{
+    auto endpoint =
+        config.get("endpoint", "http://127.0.0.1:4318").asString();
+    path_ = config.get("path", path_).asString();
+    serviceName_ = config.get("service_name", serviceName_).asString();
+    timeout_ = config.get("timeout", timeout_).asDouble();
+    auto flushInterval = config.get("flush_interval", 5.0).asDouble();
+
+    state_ = std::make_shared<State>();
+    state_->batchSize =
+        config.get("batch_size", (Json::UInt64)state_->batchSize).asUInt64();
+    state_->maxQueueSize =
+        config.get("max_queue_size", (Json::UInt64)state_->maxQueueSize)
+            .asUInt64();
+    if (state_->batchSize == 0 || state_->maxQueueSize < state_->batchSize)
+    {
+        throw std::runtime_error(
+            "TraceExporter: the batch size must be positive and not greater "
+            "than the maximum queue size");
+    }
+
+    threadPtr_ = std::make_unique<trantor::EventLoopThread>("TraceExporter");
+    threadPtr_->run();
+    auto loop = threadPtr_->getLoop();
+    client_ = HttpClient::newHttpClient(endpoint, loop);
+    state_->loop = loop;
+    state_->flush = [this]() { flush(); };
+    timerId_ = loop->runEvery(flushInterval, [this]() { flush(); });
+
+    auto &tracing = RequestTracing::instance();
+    tracing.sampleRatio = config.get("sample_ratio", 0.01).asDouble();
+    tracing.exporter = [state = state_](const HttpRequestPtr &req,
+                                        const HttpResponsePtr &resp,
+                                        const RequestTrace &trace) {
+        record(state, req, resp, trace);
+    };
+}
+
+void TraceExporter::shutdown()
+{
+    if (!threadPtr_)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->stopped = true;
+    }
+    auto loop = threadPtr_->getLoop();
+    loop->invalidateTimer(timerId_);
+    // The spans still pending are sent if the collector replies before the
+    // thread quits.
+    loop->runInLoop([this]() { flush(); });
+    threadPtr_.reset();
+    client_.reset();
+}
+
+void TraceExporter::record(const std::shared_ptr<State> &state,
+                           const HttpRequestPtr &req,
+                           const HttpResponsePtr &resp,
+                           const RequestTrace &trace)
+{
+    using Stage = RequestTrace::Stage;
+    std::vector<Json::Value> spans;
+
+    auto route = std::string(req->matchedPathPattern());
+    auto name = std::string(req->methodString());
+    if (!route.empty())
+        name.append(" ").append(route);
+    auto root = newSpan(trace,
+                        trace.spanId(),
+                        trace.parentSpanId(),
+                        name,
+                        kSpanKindServer,
+                        trace.timestamp(Stage::Received),
+                        trace.timestamp(Stage::Sent));
+    auto &attributes = root["attributes"];
+    attributes.append(
+        stringAttribute("http.request.method", req->methodString()));
+    attributes.append(stringAttribute("url.path", req->path()));
+    if (!route.empty())
+        attributes.append(stringAttribute("http.route", route));
+    attributes.append(intAttribute("http.response.status_code",
+                                   (int64_t)resp->statusCode()));
+    attributes.append(
+        stringAttribute("client.address", req->peerAddr().toIp()));
+    if (resp->statusCode() >= 500)
+        root["status"]["code"] = kStatusError;
+    spans.emplace_back(std::move(root));
+
+    // A span from every stage the request reached to the next one.
+    for (size_t i = 0; i + 1 < (size_t)Stage::Count; ++i)
+    {
+        auto start = trace.timestamp((Stage)i);
+        if (start == 0)
+            continue;
+        for (size_t j = i + 1; j < (size_t)Stage::Count; ++j)
+        {
+            auto end = trace.timestamp((Stage)j);
+            if (end == 0)
+                continue;
+            auto stageName = RequestTrace::stageName((Stage)i);
+            spans.emplace_back(newSpan(trace,
+                                       trace.startSpan(stageName).spanId,
+                                       trace.spanId(),
+                                       stageName,
+                                       kSpanKindInternal,
+                                       start,
+                                       end));
+            break;
+        }
+    }
+
+    for (auto &clientSpan : trace.spans())
+    {
+        auto span = newSpan(trace,
+                            clientSpan.spanId,
+                            trace.spanId(),
+                            clientSpan.name,
+                            kSpanKindClient,
+                            clientSpan.start,
+                            clientSpan.end);
+        for (auto &[key, value] : clientSpan.attributes)
+        {
+            span["attributes"].append(stringAttribute(key, value));
+        }
+        if (clientSpan.error)
+            span["status"]["code"] = kStatusError;
+        spans.emplace_back(std::move(span));
+    }
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->stopped)
+        return;
+    if (state->spans.size() + spans.size() > state->maxQueueSize)
+    {
+        state->droppedSpans += spans.size();
+        return;
+    }
+    for (auto &span : spans)
+    {
+        state->spans.emplace_back(std::move(span));
+    }
+    if (state->spans.size() >= state->batchSize && !state->flushQueued)
+    {
+        state->flushQueued = true;
+        state->loop->queueInLoop(state->flush);
+    }
+}
+
+void TraceExporter::flush()
+{
+    std::vector<Json::Value> spans;
+    size_t droppedSpans;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        spans.swap(state_->spans);
+        droppedSpans = state_->droppedSpans;
+        state_->droppedSpans = 0;
+        state_->flushQueued = false;
+    }
+    if (droppedSpans > 0)
+    {
+        LOG_WARN << "TraceExporter: " << droppedSpans
+                 << " spans were dropped since the queue is full";
+    }
+    for (size_t pos = 0; pos < spans.size(); pos += state_->batchSize)
+    {
+        Json::Value body;
+        auto &resourceSpans = body["resourceSpans"][0];
+        resourceSpans["resource"]["attributes"].append(
+            stringAttribute("service.name", serviceName_));
+        auto &scopeSpans = resourceSpans["scopeSpans"][0];
+        scopeSpans["scope"]["name"] = "drogon";
+        auto &batch = scopeSpans["spans"];
+        for (size_t i = pos; i < spans.size() && i < pos + state_->batchSize;
+             ++i)
+        {
+            batch.append(std::move(spans[i]));
+        }
+        auto req = HttpRequest::newHttpJsonRequest(body);
+        req->setMethod(Post);
+        req->setPath(path_);
+        client_->sendRequest(
+            req,
+            [](ReqResult result, const HttpResponsePtr &resp) {
+                if (result != ReqResult::Ok)
+                {
+                    LOG_ERROR << "TraceExporter: failed to send the spans, "
+                              << to_string_view(result);
+                }
+                else if (resp->statusCode() >= 300)
+                {
+                    LOG_ERROR << "TraceExporter: the collector returned "
+                              << resp->statusCode();
+                }
+            },
+            timeout_);
+    }
+}
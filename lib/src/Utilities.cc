@@ -16,10 +16,16 @@
 #include <trantor/utils/Logger.h>
 #include <trantor/utils/Utilities.h>
 #include <drogon/config.h>
+#include "CharScan.h"
+#include "SimdCodecs.h"
+#include "ZlibStreams.h"
 #ifdef USE_BROTLI
 #include <brotli/decode.h>
 #include <brotli/encode.h>
 #endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
 #ifdef _WIN32
 #include <rpc.h>
 #include <direct.h>
@@ -28,6 +34,7 @@
 #else
 #include <uuid.h>
 #include <unistd.h>
+#include <pthread.h>
 #endif
 #include <zlib.h>
 #include <sstream>
@@ -36,6 +43,8 @@
 #include <random>
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <locale>
 #include <clocale>
 #include <cctype>
@@ -197,7 +206,9 @@ std::vector<char> hexToBinaryVector(const char *ptr, size_t length)
 {
     assert(length % 2 == 0);
     std::vector<char> ret(length / 2, '\0');
-    for (size_t i = 0; i < ret.size(); ++i)
+    for (size_t i = internal::simdHexToBinary(ptr, length, ret.data()) / 2;
+         i < ret.size();
+         ++i)
     {
         auto p = i * 2;
         char c1 = ptr[p];
@@ -247,7 +258,9 @@ std::string hexToBinaryString(const char *ptr, size_t length)
 {
     assert(length % 2 == 0);
     std::string ret(length / 2, '\0');
-    for (size_t i = 0; i < ret.length(); ++i)
+    for (size_t i = internal::simdHexToBinary(ptr, length, &ret[0]) / 2;
+         i < ret.length();
+         ++i)
     {
         auto p = i * 2;
         char c1 = ptr[p];
@@ -298,7 +311,9 @@ DROGON_EXPORT void binaryStringToHex(const char *ptr,
                                      char *out,
                                      bool lowerCase)
 {
-    for (size_t i = 0; i < length; ++i)
+    for (size_t i = internal::simdBinaryToHex(ptr, length, out, lowerCase);
+         i < length;
+         ++i)
     {
         int value = (ptr[i] & 0xf0) >> 4;
         if (value < 10)
@@ -456,7 +471,12 @@ void base64Encode(const unsigned char *bytesToEncode,
 
     const std::string_view charSet = urlSafe ? urlBase64Chars : base64Chars;
 
-    size_t a = 0;
+    // The SIMD kernel encodes the whole blocks, the loop below the rest.
+    auto encoded =
+        internal::simdBase64Encode(bytesToEncode, inLen, outputBuffer, urlSafe);
+    bytesToEncode += encoded;
+    inLen -= encoded;
+    size_t a = encoded / 3 * 4;
     while (inLen--)
     {
         charArray3[i++] = *(bytesToEncode++);
@@ -507,6 +527,13 @@ std::vector<char> base64DecodeToVector(std::string_view encodedString)
     char charArray4[4], charArray3[3];
     std::vector<char> ret;
     ret.reserve(base64DecodedLength(inLen));
+    ret.resize(inLen / 16 * 12);
+    in_ = static_cast<int>(internal::simdBase64Decode(
+        encodedString.data(),
+        inLen,
+        reinterpret_cast<unsigned char *>(ret.data())));
+    ret.resize(in_ / 4 * 3);
+    inLen -= in_;
 
     while (inLen-- && (encodedString[in_] != '='))
     {
@@ -568,7 +595,10 @@ size_t base64Decode(const char *encodedString,
     int in_{0};
     unsigned char charArray4[4], charArray3[3];
 
-    size_t a = 0;
+    size_t a = internal::simdBase64Decode(encodedString, inLen, outputBuffer);
+    in_ = static_cast<int>(a);
+    inLen -= a;
+    a = a / 4 * 3;
     while (inLen-- && (encodedString[in_] != '='))
     {
         if (!isBase64(encodedString[in_]))
@@ -620,25 +650,19 @@ size_t base64Decode(const char *encodedString,
     return a;
 }
 
-static std::string charToHex(char c)
+static inline void appendEscaped(std::string &result, char c)
 {
-    std::string result;
-    char first, second;
-
-    first = (c & 0xF0) / 16;
-    first += first > 9 ? 'A' - 10 : '0';
-    second = c & 0x0F;
-    second += second > 9 ? 'A' - 10 : '0';
-
-    result.append(1, first);
-    result.append(1, second);
-
-    return result;
+    static constexpr char hexDigits[] = "0123456789ABCDEF";
+    char escaped[3] = {'%',
+                       hexDigits[(static_cast<unsigned char>(c) >> 4)],
+                       hexDigits[c & 0x0F]};
+    result.append(escaped, 3);
 }
 
 std::string urlEncodeComponent(const std::string &src)
 {
     std::string result;
+    result.reserve(src.size());
     std::string::const_iterator iter;
 
     for (iter = src.begin(); iter != src.end(); ++iter)
@@ -724,8 +748,7 @@ std::string urlEncodeComponent(const std::string &src)
                 break;
             // escape
             default:
-                result.append(1, '%');
-                result.append(charToHex(*iter));
+                appendEscaped(result, *iter);
                 break;
         }
     }
@@ -736,6 +759,7 @@ std::string urlEncodeComponent(const std::string &src)
 std::string urlEncode(const std::string &src)
 {
     std::string result;
+    result.reserve(src.size());
     std::string::const_iterator iter;
 
     for (iter = src.begin(); iter != src.end(); ++iter)
@@ -827,8 +851,7 @@ std::string urlEncode(const std::string &src)
                 break;
             // escape
             default:
-                result.append(1, '%');
-                result.append(charToHex(*iter));
+                appendEscaped(result, *iter);
                 break;
         }
     }
@@ -838,9 +861,7 @@ std::string urlEncode(const std::string &src)
 
 bool needUrlDecoding(const char *begin, const char *end)
 {
-    return std::find_if(begin, end, [](const char c) {
-               return c == '+' || c == '%';
-           }) != end;
+    return drogon::internal::findEither(begin, end, '+', '%') != end;
 }
 
 std::string urlDecode(const char *begin, const char *end)
@@ -851,6 +872,12 @@ std::string urlDecode(const char *begin, const char *end)
     int hex = 0;
     for (size_t i = 0; i < len; ++i)
     {
+        // Copy the characters up to the next one to decode at once.
+        auto special = drogon::internal::findEither(begin + i, end, '+', '%');
+        result.append(begin + i, special);
+        i = special - begin;
+        if (i == len)
+            break;
         switch (begin[i])
         {
             case '+':
@@ -907,32 +934,18 @@ std::string urlDecode(const char *begin, const char *end)
 /* Compress gzip data */
 std::string gzipCompress(const char *data, const size_t ndata)
 {
-    z_stream strm = {nullptr,
-                     0,
-                     0,
-                     nullptr,
-                     0,
-                     0,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     0,
-                     0,
-                     0};
+    return gzipCompress(data, ndata, Z_DEFAULT_COMPRESSION);
+}
+
+std::string gzipCompress(const char *data, const size_t ndata, int level)
+{
     if (data && ndata > 0)
     {
-        if (deflateInit2(&strm,
-                         Z_DEFAULT_COMPRESSION,
-                         Z_DEFLATED,
-                         MAX_WBITS + 16,
-                         8,
-                         Z_DEFAULT_STRATEGY) != Z_OK)
-        {
-            LOG_ERROR << "deflateInit2 error!";
+        auto &streams = internal::ZlibStreams::instance();
+        auto strmPtr = streams.deflater(level);
+        if (!strmPtr)
             return std::string{};
-        }
+        auto &strm = *strmPtr;
         std::string outstr;
         outstr.resize(compressBound(static_cast<uLong>(ndata)));
         strm.next_in = (Bytef *)data;
@@ -950,15 +963,16 @@ std::string gzipCompress(const char *data, const size_t ndata)
             ret = deflate(&strm, Z_FINISH); /* no bad return value */
             if (ret == Z_STREAM_ERROR)
             {
-                (void)deflateEnd(&strm);
+                streams.discardDeflater();
                 return std::string{};
             }
         } while (strm.avail_out == 0);
         assert(strm.avail_in == 0);
         assert(ret == Z_STREAM_END); /* stream will be complete */
         outstr.resize(strm.total_out);
-        /* clean up and return */
-        (void)deflateEnd(&strm);
+        // The input isn't referred to by the stream kept for the thread.
+        strm.next_in = nullptr;
+        strm.next_out = nullptr;
         return outstr;
     }
     return std::string{};
@@ -974,30 +988,13 @@ std::string gzipDecompress(const char *data, const size_t ndata)
     auto decompressed = std::string(full_length * 2, 0);
     bool done = false;
 
-    z_stream strm = {nullptr,
-                     0,
-                     0,
-                     nullptr,
-                     0,
-                     0,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     nullptr,
-                     0,
-                     0,
-                     0};
+    auto &streams = internal::ZlibStreams::instance();
+    auto strmPtr = streams.inflater();
+    if (!strmPtr)
+        return std::string{};
+    auto &strm = *strmPtr;
     strm.next_in = (Bytef *)data;
     strm.avail_in = static_cast<uInt>(ndata);
-    strm.total_out = 0;
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    if (inflateInit2(&strm, (15 + 32)) != Z_OK)
-    {
-        LOG_ERROR << "inflateInit2 error!";
-        return std::string{};
-    }
     while (!done)
     {
         // Make sure we have enough room and reset the lengths.
@@ -1019,8 +1016,8 @@ std::string gzipDecompress(const char *data, const size_t ndata)
             break;
         }
     }
-    if (inflateEnd(&strm) != Z_OK)
-        return std::string{};
+    strm.next_in = nullptr;
+    strm.next_out = nullptr;
     // Set real length.
     if (done)
     {
@@ -1029,6 +1026,7 @@ std::string gzipDecompress(const char *data, const size_t ndata)
     }
     else
     {
+        streams.discardInflater();
         return std::string{};
     }
 }
@@ -1199,13 +1197,18 @@ int createPath(const std::string &path)
 }
 #ifdef USE_BROTLI
 std::string brotliCompress(const char *data, const size_t ndata)
+{
+    return brotliCompress(data, ndata, 5);
+}
+
+std::string brotliCompress(const char *data, const size_t ndata, int quality)
 {
     std::string ret;
     if (ndata == 0)
         return ret;
     ret.resize(BrotliEncoderMaxCompressedSize(ndata));
     size_t encodedSize{ret.size()};
-    auto r = BrotliEncoderCompress(5,
+    auto r = BrotliEncoderCompress(quality,
                                    BROTLI_DEFAULT_WINDOW,
                                    BROTLI_DEFAULT_MODE,
                                    ndata,
@@ -1265,6 +1268,15 @@ std::string brotliCompress(const char * /*data*/, const size_t /*ndata*/)
     abort();
 }
 
+std::string brotliCompress(const char * /*data*/,
+                           const size_t /*ndata*/,
+                           int /*quality*/)
+{
+    LOG_ERROR << "If you do not have the brotli package installed, you cannot "
+                 "use brotliCompress()";
+    abort();
+}
+
 std::string brotliDecompress(const char * /*data*/, const size_t /*ndata*/)
 {
     LOG_ERROR << "If you do not have the brotli package installed, you cannot "
@@ -1273,6 +1285,99 @@ std::string brotliDecompress(const char * /*data*/, const size_t /*ndata*/)
 }
 #endif
 
+#ifdef USE_ZSTD
+namespace
+{
+// The zstd contexts of the thread, reused by the calls like the zlib
+// streams.
+struct ZstdContexts
+{
+    ~ZstdContexts()
+    {
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+    }
+
+    static ZstdContexts &instance()
+    {
+        static thread_local ZstdContexts contexts;
+        return contexts;
+    }
+
+    ZSTD_CCtx *cctx{ZSTD_createCCtx()};
+    ZSTD_DCtx *dctx{ZSTD_createDCtx()};
+};
+}  // namespace
+
+std::string zstdCompress(const char *data, const size_t ndata, int level)
+{
+    std::string ret;
+    if (ndata == 0)
+        return ret;
+    auto cctx = ZstdContexts::instance().cctx;
+    if (!cctx)
+        return ret;
+    ret.resize(ZSTD_compressBound(ndata));
+    auto size =
+        ZSTD_compressCCtx(cctx, ret.data(), ret.size(), data, ndata, level);
+    if (ZSTD_isError(size))
+    {
+        LOG_ERROR << "zstd compression error: " << ZSTD_getErrorName(size);
+        ret.resize(0);
+    }
+    else
+    {
+        ret.resize(size);
+    }
+    return ret;
+}
+
+std::string zstdDecompress(const char *data, const size_t ndata)
+{
+    if (ndata == 0)
+        return std::string(data, ndata);
+    auto dctx = ZstdContexts::instance().dctx;
+    if (!dctx)
+        return std::string{};
+    ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+    std::string decompressed;
+    ZSTD_inBuffer input{data, ndata, 0};
+    std::string buffer(ZSTD_DStreamOutSize(), '\0');
+    size_t ret;
+    while (true)
+    {
+        ZSTD_outBuffer output{buffer.data(), buffer.size(), 0};
+        ret = ZSTD_decompressStream(dctx, &output, &input);
+        if (ZSTD_isError(ret))
+            break;
+        decompressed.append(buffer.data(), output.pos);
+        // All output is flushed if the output buffer is not full
+        if (input.pos == input.size && output.pos < output.size)
+            break;
+    }
+    // ret is not 0 on errors or if the frame is not complete
+    if (ret != 0)
+        decompressed.resize(0);
+    return decompressed;
+}
+#else
+std::string zstdCompress(const char * /*data*/,
+                         const size_t /*ndata*/,
+                         int /*level*/)
+{
+    LOG_ERROR << "If you do not have the zstd package installed, you cannot "
+                 "use zstdCompress()";
+    abort();
+}
+
+std::string zstdDecompress(const char * /*data*/, const size_t /*ndata*/)
+{
+    LOG_ERROR << "If you do not have the zstd package installed, you cannot "
+                 "use zstdDecompress()";
+    abort();
+}
+#endif
+
 std::string getMd5(const char *data, const size_t dataLen)
 {
     return trantor::utils::toHexString(trantor::utils::md5(data, dataLen));
@@ -1313,9 +1418,164 @@ bool supportsTls() noexcept
     return trantor::utils::tlsBackend() != "None";
 }
 
+namespace
+{
+#ifndef _WIN32
+// Bumped in the child processes, so the children don't share the keys of the
+// generators with their parent.
+std::atomic<uint64_t> forkGeneration{0};
+[[maybe_unused]] const int atForkRegistered =
+    pthread_atfork(nullptr, nullptr, []() {
+        forkGeneration.fetch_add(1, std::memory_order_relaxed);
+    });
+#endif
+
+inline uint32_t rotateLeft32(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+inline void quarterRound(uint32_t *x, int a, int b, int c, int d)
+{
+    x[a] += x[b];
+    x[d] = rotateLeft32(x[d] ^ x[a], 16);
+    x[c] += x[d];
+    x[b] = rotateLeft32(x[b] ^ x[c], 12);
+    x[a] += x[b];
+    x[d] = rotateLeft32(x[d] ^ x[a], 8);
+    x[c] += x[d];
+    x[b] = rotateLeft32(x[b] ^ x[c], 7);
+}
+
+// The ChaCha20 block function (rfc8439-2.3) with a zero nonce
+void chacha20Block(const uint32_t key[8], uint32_t counter, unsigned char *out)
+{
+    uint32_t input[16] = {0x61707865,
+                          0x3320646e,
+                          0x79622d32,
+                          0x6b206574,
+                          key[0],
+                          key[1],
+                          key[2],
+                          key[3],
+                          key[4],
+                          key[5],
+                          key[6],
+                          key[7],
+                          counter,
+                          0,
+                          0,
+                          0};
+    uint32_t x[16];
+    memcpy(x, input, sizeof(x));
+    for (int i = 0; i < 10; ++i)
+    {
+        quarterRound(x, 0, 4, 8, 12);
+        quarterRound(x, 1, 5, 9, 13);
+        quarterRound(x, 2, 6, 10, 14);
+        quarterRound(x, 3, 7, 11, 15);
+        quarterRound(x, 0, 5, 10, 15);
+        quarterRound(x, 1, 6, 11, 12);
+        quarterRound(x, 2, 7, 8, 13);
+        quarterRound(x, 3, 4, 9, 14);
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+        auto word = x[i] + input[i];
+        out[4 * i] = static_cast<unsigned char>(word);
+        out[4 * i + 1] = static_cast<unsigned char>(word >> 8);
+        out[4 * i + 2] = static_cast<unsigned char>(word >> 16);
+        out[4 * i + 3] = static_cast<unsigned char>(word >> 24);
+    }
+}
+
+/**
+ * A ChaCha20 generator with fast key erasure: each refill of the buffer
+ * takes the next key from the first 32 bytes of the keystream and erases
+ * them, and the returned bytes are erased too, so the state never reveals
+ * the bytes already returned. Each thread has its own generator, seeded from
+ * the OS and reseeded after every kReseedRefills refills (about 1MB).
+ */
+class ChaCha20Random
+{
+  public:
+    bool fill(void *ptr, size_t size)
+    {
+#ifndef _WIN32
+        // A forked child must not serve the rest of the keystream of its
+        // parent, the buffer is dropped before any byte is returned.
+        if (generation_ != forkGeneration.load(std::memory_order_relaxed))
+        {
+            memset(buffer_, 0, sizeof(buffer_));
+            pos_ = sizeof(buffer_);
+            refills_ = 0;
+        }
+#endif
+        auto out = static_cast<unsigned char *>(ptr);
+        while (size > 0)
+        {
+            if (pos_ == sizeof(buffer_) && !refill())
+                return false;
+            auto n = (std::min)(size, sizeof(buffer_) - pos_);
+            memcpy(out, buffer_ + pos_, n);
+            memset(buffer_ + pos_, 0, n);
+            pos_ += n;
+            out += n;
+            size -= n;
+        }
+        return true;
+    }
+
+  private:
+    bool needsSeed() const
+    {
+#ifndef _WIN32
+        if (generation_ != forkGeneration.load(std::memory_order_relaxed))
+            return true;
+#endif
+        return refills_ == 0 || refills_ >= kReseedRefills;
+    }
+
+    bool refill()
+    {
+        if (needsSeed())
+        {
+#ifndef _WIN32
+            generation_ = forkGeneration.load(std::memory_order_relaxed);
+#endif
+            if (!trantor::utils::secureRandomBytes(key_, sizeof(key_)))
+                return false;
+            refills_ = 0;
+        }
+        for (uint32_t i = 0; i < kBlocks; ++i)
+            chacha20Block(key_, i, buffer_ + 64 * i);
+        memcpy(key_, buffer_, sizeof(key_));
+        memset(buffer_, 0, sizeof(key_));
+        pos_ = sizeof(key_);
+        ++refills_;
+        return true;
+    }
+
+    static constexpr uint32_t kBlocks = 16;
+    static constexpr size_t kReseedRefills = 1024;
+    uint32_t key_[8]{};
+    unsigned char buffer_[kBlocks * 64]{};
+    size_t pos_{sizeof(buffer_)};
+    size_t refills_{0};
+#ifndef _WIN32
+    uint64_t generation_{0};
+#endif
+};
+}  // namespace
+
 bool secureRandomBytes(void *ptr, size_t size)
 {
-    return trantor::utils::secureRandomBytes(ptr, size);
+    // Big requests are rare, they go to the OS directly.
+    static constexpr size_t kMaxBufferedRequest = 256;
+    if (size > kMaxBufferedRequest)
+        return trantor::utils::secureRandomBytes(ptr, size);
+    thread_local ChaCha20Random random;
+    return random.fill(ptr, size);
 }
 
 std::string secureRandomString(size_t size)
@@ -1331,29 +1591,65 @@ std::string secureRandomString(size_t size)
         "+-";
     assert(chars.size() == 64);
 
-    // batch up to 32 bytes of random data for efficiency. Calling
-    // secureRandomBytes can be expensive.
-    auto randByte = []() {
-        thread_local trantor::utils::Hash256 hash;
-        thread_local size_t i = 0;
-        if (i == 0)
-        {
-            bool ok = trantor::utils::secureRandomBytes(&hash, sizeof(hash));
-            if (!ok)
-                throw std::runtime_error(
-                    "Failed to generate random bytes for secureRandomString");
-        }
-        unsigned char *hashBytes = reinterpret_cast<unsigned char *>(&hash);
-        auto ret = hashBytes[i];
-        i = (i + 1) % sizeof(hash);
-        return ret;
-    };
-
-    for (size_t i = 0; i < size; ++i)
-        ret[i] = chars[randByte() % 64];
+    // 64 characters, so each one takes 6 bits of a random byte.
+    unsigned char bytes[64];
+    for (size_t i = 0; i < size; i += sizeof(bytes))
+    {
+        auto n = (std::min)(size - i, sizeof(bytes));
+        if (!secureRandomBytes(bytes, n))
+            throw std::runtime_error(
+                "Failed to generate random bytes for secureRandomString");
+        for (size_t j = 0; j < n; ++j)
+            ret[i + j] = chars[bytes[j] % 64];
+    }
     return ret;
 }
 
+std::string getUuidV4(bool lowercase)
+{
+    unsigned char bytes[16];
+    if (!secureRandomBytes(bytes, sizeof(bytes)))
+        throw std::runtime_error("Failed to generate random bytes for UUID");
+    bytes[6] = (bytes[6] & 0x0f) | 0x40;
+    bytes[8] = (bytes[8] & 0x3f) | 0x80;
+    return createUuidString(reinterpret_cast<const char *>(bytes),
+                            sizeof(bytes),
+                            lowercase);
+}
+
+std::string getUuidV7(bool lowercase)
+{
+    // The unix time in milliseconds and a 12 bits counter in rand_a
+    // (rfc9562-6.2, method 1), shared by the threads. When the counter
+    // overflows or the clock goes back, the time is taken from the last UUID
+    // so the UUIDs are always increasing.
+    static std::atomic<uint64_t> lastTimeAndCounter{0};
+    auto now = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+    auto last = lastTimeAndCounter.load(std::memory_order_relaxed);
+    uint64_t next;
+    do
+    {
+        next = (std::max)(now << 12, last + 1);
+    } while (!lastTimeAndCounter.compare_exchange_weak(
+        last, next, std::memory_order_relaxed));
+
+    unsigned char bytes[16];
+    if (!secureRandomBytes(bytes + 8, 8))
+        throw std::runtime_error("Failed to generate random bytes for UUID");
+    auto milliseconds = next >> 12;
+    for (int i = 0; i < 6; ++i)
+        bytes[i] = static_cast<unsigned char>(milliseconds >> (40 - 8 * i));
+    bytes[6] = static_cast<unsigned char>(0x70 | ((next >> 8) & 0x0f));
+    bytes[7] = static_cast<unsigned char>(next);
+    bytes[8] = (bytes[8] & 0x3f) | 0x80;
+    return createUuidString(reinterpret_cast<const char *>(bytes),
+                            sizeof(bytes),
+                            lowercase);
+}
+
 namespace internal
 {
 const size_t fixedRandomNumber = []() {
@@ -0,0 +1,56 @@
+/**
+ *
+ *  @file ViewFragmentCache.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/ViewFragmentCache.h>
+
+using namespace drogon;
+
+bool ViewFragmentCache::appendTo(const std::string &key,
+                                 std::string &output) const
+{
+    std::shared_ptr<const std::string> fragment;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = entries_.find(key);
+        if (iter == entries_.end())
+            return false;
+        if (iter->second.expires && iter->second.expiry <= Clock::now())
+            return false;
+        fragment = iter->second.fragment;
+    }
+    // Copied out of the lock, the entry may be replaced meanwhile.
+    output.append(*fragment);
+    return true;
+}
+
+void ViewFragmentCache::store(std::string key, std::string fragment, double ttl)
+{
+    Entry entry;
+    entry.fragment = std::make_shared<const std::string>(std::move(fragment));
+    if (ttl > 0.0)
+    {
+        entry.expires = true;
+        entry.expiry = Clock::now() +
+                       std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(ttl));
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[std::move(key)] = std::move(entry);
+}
+
+void ViewFragmentCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
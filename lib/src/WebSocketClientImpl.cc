@@ -18,6 +18,7 @@
 #include "HttpResponseParser.h"
 #include "HttpUtils.h"
 #include "WebSocketConnectionImpl.h"
+#include "DnsCache.h"
 #include "HttpAppFrameworkImpl.h"
 #include <drogon/utils/Utilities.h>
 #include <drogon/config.h>
@@ -144,6 +145,11 @@ void WebSocketClientImpl::connectToServerInLoop()
     wsAccept_ = utils::base64Encode(accKey, 20);
 
     upgradeRequest_->addHeader("Sec-WebSocket-Key", wsKey_);
+    if (enableCompression_)
+    {
+        upgradeRequest_->addHeader("Sec-WebSocket-Extensions",
+                                   WebSocketDeflateParams::clientOffer());
+    }
     // upgradeRequest_->addHeader("Sec-WebSocket-Version","13");
 
     assert(!tcpClientPtr_);
@@ -165,34 +171,24 @@ void WebSocketClientImpl::connectToServerInLoop()
     if (serverAddr_.ipNetEndian() == 0 && !hasIpv6Address && !domain_.empty() &&
         serverAddr_.portNetEndian() != 0)
     {
-        if (!resolver_)
-        {
-            resolver_ = trantor::Resolver::newResolver(loop_);
-        }
-        resolver_->resolve(
+        internal::DnsCache::instance().resolve(
             domain_,
-            [thisPtr = shared_from_this(),
-             hasIpv6Address](const trantor::InetAddress &addr) {
-                thisPtr->loop_->runInLoop([thisPtr, addr, hasIpv6Address]() {
-                    auto port = thisPtr->serverAddr_.portNetEndian();
-                    thisPtr->serverAddr_ = addr;
-                    thisPtr->serverAddr_.setPortNetEndian(port);
-                    LOG_TRACE << "dns:domain=" << thisPtr->domain_
-                              << ";ip=" << thisPtr->serverAddr_.toIp();
-                    if ((thisPtr->serverAddr_.ipNetEndian() != 0 ||
-                         hasIpv6Address) &&
-                        thisPtr->serverAddr_.portNetEndian() != 0)
-                    {
-                        thisPtr->createTcpClient();
-                    }
-                    else
-                    {
-                        thisPtr->requestCallback_(ReqResult::BadServerAddress,
-                                                  nullptr,
-                                                  thisPtr);
-                        return;
-                    }
-                });
+            loop_,
+            [thisPtr = shared_from_this()](
+                const std::vector<trantor::InetAddress> &addresses) {
+                if (addresses.empty())
+                {
+                    thisPtr->requestCallback_(ReqResult::BadServerAddress,
+                                              nullptr,
+                                              thisPtr);
+                    return;
+                }
+                auto port = thisPtr->serverAddr_.portNetEndian();
+                thisPtr->serverAddr_ = addresses.front();
+                thisPtr->serverAddr_.setPortNetEndian(port);
+                LOG_TRACE << "dns:domain=" << thisPtr->domain_
+                          << ";ip=" << thisPtr->serverAddr_.toIp();
+                thisPtr->createTcpClient();
             });
         return;
     }
@@ -248,9 +244,15 @@ void WebSocketClientImpl::onRecvMessage(
         auto resp = responseParser->responseImpl();
         responseParser->reset();
         auto acceptStr = resp->getHeaderBy("sec-websocket-accept");
+        // The extension must be the one offered by the client
+        auto &extensions = resp->getHeaderBy("sec-websocket-extensions");
+        WebSocketDeflateParams deflateParams;
+        bool useDeflate = !extensions.empty();
 
         if (resp->statusCode() != k101SwitchingProtocols ||
-            acceptStr != wsAccept_)
+            acceptStr != wsAccept_ ||
+            (useDeflate &&
+             (!enableCompression_ || !deflateParams.parse(extensions))))
         {
             requestCallback_(ReqResult::BadResponse,
                              nullptr,
@@ -280,6 +282,8 @@ void WebSocketClientImpl::onRecvMessage(
         upgraded_ = true;
         websockConnPtr_ =
             std::make_shared<WebSocketConnectionImpl>(connPtr, false);
+        if (useDeflate)
+            websockConnPtr_->enableDeflate(deflateParams);
         websockConnPtr_->setPingMessage("", std::chrono::seconds{30});
         auto thisPtr = shared_from_this();
         std::weak_ptr<WebSocketClientImpl> weakPtr = thisPtr;
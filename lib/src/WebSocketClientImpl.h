@@ -56,6 +56,11 @@ class WebSocketClientImpl
     void addSSLConfigs(const std::vector<std::pair<std::string, std::string>>
                            &sslConfCmds) override;
 
+    void enableCompression(bool enable) override
+    {
+        enableCompression_ = enable;
+    }
+
     trantor::EventLoop *getLoop() override
     {
         return loop_;
@@ -86,6 +91,7 @@ class WebSocketClientImpl
     bool validateCert_{true};
     bool upgraded_{false};
     bool stop_{false};
+    bool enableCompression_{false};
     std::string wsKey_;
     std::string wsAccept_;
     std::string clientCertPath_;
@@ -111,7 +117,6 @@ class WebSocketClientImpl
                          trantor::MsgBuffer *);
     void reconnect();
     void createTcpClient();
-    std::shared_ptr<trantor::Resolver> resolver_;
 };
 
 }  // namespace drogon
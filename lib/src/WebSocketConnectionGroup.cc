@@ -0,0 +1,140 @@
+/**
+ *
+ *  @file WebSocketConnectionGroup.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by the MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/WebSocketConnectionGroup.h>
+#include "WebSocketConnectionImpl.h"
+#include <atomic>
+#include <unordered_set>
+
+using namespace drogon;
+
+// The connections of the group in one IO loop, only accessed in the loop
+struct WebSocketConnectionGroup::LoopConnections
+{
+    explicit LoopConnections(trantor::EventLoop *l) : loop(l)
+    {
+    }
+
+    trantor::EventLoop *loop;
+    std::unordered_set<WebSocketConnectionImplPtr> connections;
+    std::atomic<size_t> size{0};
+};
+
+WebSocketConnectionGroup::~WebSocketConnectionGroup()
+{
+    // Release the connections in their own loops
+    for (auto &loopConns : loops_)
+    {
+        loopConns->loop->runInLoop([loopConns]() {
+            loopConns->connections.clear();
+            loopConns->size.store(0, std::memory_order_relaxed);
+        });
+    }
+}
+
+std::shared_ptr<WebSocketConnectionGroup::LoopConnections>
+WebSocketConnectionGroup::loopConnections(trantor::EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &loopConns : loops_)
+    {
+        if (loopConns->loop == loop)
+            return loopConns;
+    }
+    loops_.push_back(std::make_shared<LoopConnections>(loop));
+    return loops_.back();
+}
+
+std::shared_ptr<WebSocketConnectionGroup::LoopConnections>
+WebSocketConnectionGroup::findLoopConnections(trantor::EventLoop *loop) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &loopConns : loops_)
+    {
+        if (loopConns->loop == loop)
+            return loopConns;
+    }
+    return nullptr;
+}
+
+void WebSocketConnectionGroup::add(const WebSocketConnectionPtr &conn)
+{
+    auto connImpl = std::static_pointer_cast<WebSocketConnectionImpl>(conn);
+    auto loopConns = loopConnections(connImpl->getLoop());
+    loopConns->loop->runInLoop([loopConns, connImpl = std::move(connImpl)]() {
+        if (connImpl->disconnected())
+            return;
+        if (loopConns->connections.insert(connImpl).second)
+            loopConns->size.fetch_add(1, std::memory_order_relaxed);
+    });
+}
+
+void WebSocketConnectionGroup::remove(const WebSocketConnectionPtr &conn)
+{
+    auto connImpl = std::static_pointer_cast<WebSocketConnectionImpl>(conn);
+    // No connection of the loop was ever added, so it isn't in the group.
+    auto loopConns = findLoopConnections(connImpl->getLoop());
+    if (!loopConns)
+        return;
+    loopConns->loop->runInLoop([loopConns, connImpl = std::move(connImpl)]() {
+        if (loopConns->connections.erase(connImpl) > 0)
+            loopConns->size.fetch_sub(1, std::memory_order_relaxed);
+    });
+}
+
+size_t WebSocketConnectionGroup::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t total{0};
+    for (auto &loopConns : loops_)
+    {
+        total += loopConns->size.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void WebSocketConnectionGroup::broadcast(std::string_view message,
+                                         WebSocketMessageType type)
+{
+    auto opcode = WebSocketConnectionImpl::opcodeOf(type, message.length());
+    size_t headerLength;
+    auto frame = WebSocketConnectionImpl::newServerFrame(message.data(),
+                                                         message.length(),
+                                                         opcode,
+                                                         headerLength);
+    std::vector<std::shared_ptr<LoopConnections>> loops;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loops = loops_;
+    }
+    for (auto &loopConns : loops)
+    {
+        loopConns->loop->runInLoop(
+            [loopConns, frame, headerLength, opcode]() {
+                auto &connections = loopConns->connections;
+                for (auto iter = connections.begin();
+                     iter != connections.end();)
+                {
+                    if ((*iter)->disconnected())
+                    {
+                        iter = connections.erase(iter);
+                        loopConns->size.fetch_sub(1,
+                                                  std::memory_order_relaxed);
+                        continue;
+                    }
+                    (*iter)->sendSharedFrame(frame, headerLength, opcode);
+                    ++iter;
+                }
+            });
+    }
+}
@@ -14,8 +14,12 @@
 
 #include "WebSocketConnectionImpl.h"
 #include "HttpAppFrameworkImpl.h"
+#include "HttpRequestParser.h"
+#include "WebSocketMask.h"
 #include <json/value.h>
 #include <json/writer.h>
+#include <algorithm>
+#include <cstring>
 #include <thread>
 #include <limits>
 
@@ -37,79 +41,150 @@ WebSocketConnectionImpl::~WebSocketConnectionImpl()
     shutdown();
 }
 
-void WebSocketConnectionImpl::send(const char *msg,
-                                   uint64_t len,
-                                   const WebSocketMessageType type)
+unsigned char WebSocketConnectionImpl::opcodeOf(WebSocketMessageType type,
+                                               uint64_t len)
 {
-    unsigned char opcode;
+    (void)len;
     if (type == WebSocketMessageType::Text)
-        opcode = 1;
+        return 1;
     else if (type == WebSocketMessageType::Binary)
-        opcode = 2;
+        return 2;
     else if (type == WebSocketMessageType::Close)
     {
         assert(len <= 125);
-        opcode = 8;
+        return 8;
     }
     else if (type == WebSocketMessageType::Ping)
     {
         assert(len <= 125);
-        opcode = 9;
+        return 9;
     }
     else if (type == WebSocketMessageType::Pong)
     {
         assert(len <= 125);
-        opcode = 10;
+        return 10;
     }
-    else
+    assert(0);
+    return 0;
+}
+
+size_t WebSocketConnectionImpl::formatFrameHeader(char *header,
+                                                  uint64_t len,
+                                                  unsigned char opcode,
+                                                  bool compressed)
+{
+    // The RSV1 bit marks the compressed messages
+    header[0] = char(0x80 | (compressed ? 0x40 : 0) | (opcode & 0x0f));
+    if (len <= 125)
     {
-        opcode = 0;
-        assert(0);
+        header[1] = static_cast<char>(len);
+        return 2;
     }
-    sendWsData(msg, len, opcode);
+    else if (len <= 65535)
+    {
+        header[1] = 126;
+        header[2] = ((len >> 8) & 255);
+        header[3] = ((len) & 255);
+        return 4;
+    }
+    header[1] = 127;
+    header[2] = ((len >> 56) & 255);
+    header[3] = ((len >> 48) & 255);
+    header[4] = ((len >> 40) & 255);
+    header[5] = ((len >> 32) & 255);
+    header[6] = ((len >> 24) & 255);
+    header[7] = ((len >> 16) & 255);
+    header[8] = ((len >> 8) & 255);
+    header[9] = ((len) & 255);
+    return 10;
+}
+
+std::shared_ptr<trantor::MsgBuffer> WebSocketConnectionImpl::newServerFrame(
+    const char *msg,
+    uint64_t len,
+    unsigned char opcode,
+    size_t &headerLength)
+{
+    char header[10];
+    headerLength = formatFrameHeader(header, len, opcode, false);
+    auto frame = std::make_shared<trantor::MsgBuffer>(headerLength + len);
+    frame->append(header, headerLength);
+    frame->append(msg, len);
+    return frame;
+}
+
+void WebSocketConnectionImpl::send(const char *msg,
+                                   uint64_t len,
+                                   const WebSocketMessageType type)
+{
+    sendWsData(msg, len, opcodeOf(type, len));
+}
+
+void WebSocketConnectionImpl::sendSharedFrame(
+    const std::shared_ptr<trantor::MsgBuffer> &frame,
+    size_t headerLength,
+    unsigned char opcode)
+{
+    // Clients mask their frames and compressed connections have their own
+    // context, so the frame can't be shared by them.
+    if (!isServer_ || deflate_)
+    {
+        sendWsData(frame->peek() + headerLength,
+                   frame->readableBytes() - headerLength,
+                   opcode);
+        return;
+    }
+    if (dropped(opcode))
+        return;
+    tcpConnectionPtr_->send(frame);
+}
+
+void WebSocketConnectionImpl::enableDeflate(
+    const WebSocketDeflateParams &params)
+{
+    auto deflate = std::make_unique<WebSocketDeflate>(params, isServer_);
+    if (deflate->valid())
+        deflate_ = std::move(deflate);
 }
 
 void WebSocketConnectionImpl::sendWsData(const char *msg,
                                          uint64_t len,
                                          unsigned char opcode)
+{
+    if (dropped(opcode))
+    {
+        LOG_TRACE << "drop " << len << " bytes for a slow peer";
+        return;
+    }
+    // Control frames are never compressed
+    if (deflate_ && (opcode == 1 || opcode == 2))
+    {
+        std::lock_guard<std::mutex> lock(deflateMutex_);
+        std::string compressed;
+        if (!deflate_->compress(msg, len, compressed))
+        {
+            forceClose();
+            return;
+        }
+        sendFrame(compressed.data(), compressed.length(), opcode, true);
+        return;
+    }
+    sendFrame(msg, len, opcode, false);
+}
+
+void WebSocketConnectionImpl::sendFrame(const char *msg,
+                                        uint64_t len,
+                                        unsigned char opcode,
+                                        bool compressed)
 {
     LOG_TRACE << "send " << len << " bytes";
 
     // Format the frame
     std::string bytesFormatted;
     bytesFormatted.resize(len + 10);
-    bytesFormatted[0] = char(0x80 | (opcode & 0x0f));
-
-    int indexStartRawData = -1;
+    auto indexStartRawData =
+        formatFrameHeader(&bytesFormatted[0], len, opcode, compressed);
 
-    if (len <= 125)
-    {
-        bytesFormatted[1] = static_cast<char>(len);
-        indexStartRawData = 2;
-    }
-    else if (len <= 65535)
-    {
-        bytesFormatted[1] = 126;
-        bytesFormatted[2] = ((len >> 8) & 255);
-        bytesFormatted[3] = ((len) & 255);
-        LOG_TRACE << "bytes[2]=" << (size_t)bytesFormatted[2];
-        LOG_TRACE << "bytes[3]=" << (size_t)bytesFormatted[3];
-        indexStartRawData = 4;
-    }
-    else
-    {
-        bytesFormatted[1] = 127;
-        bytesFormatted[2] = ((len >> 56) & 255);
-        bytesFormatted[3] = ((len >> 48) & 255);
-        bytesFormatted[4] = ((len >> 40) & 255);
-        bytesFormatted[5] = ((len >> 32) & 255);
-        bytesFormatted[6] = ((len >> 24) & 255);
-        bytesFormatted[7] = ((len >> 16) & 255);
-        bytesFormatted[8] = ((len >> 8) & 255);
-        bytesFormatted[9] = ((len) & 255);
-
-        indexStartRawData = 10;
-    }
     if (!isServer_)
     {
         int random;
@@ -148,11 +223,10 @@ void WebSocketConnectionImpl::sendWsData(const char *msg,
         bytesFormatted[1] = (bytesFormatted[1] | 0x80);
         bytesFormatted.resize(indexStartRawData + 4 + len);
         memcpy(&bytesFormatted[indexStartRawData], &random, sizeof(random));
-        for (size_t i = 0; i < len; ++i)
-        {
-            bytesFormatted[indexStartRawData + 4 + i] =
-                (msg[i] ^ bytesFormatted[indexStartRawData + (i % 4)]);
-        }
+        internal::maskWebSocketPayload(&bytesFormatted[indexStartRawData + 4],
+                                       msg,
+                                       len,
+                                       &bytesFormatted[indexStartRawData]);
     }
     else
     {
@@ -171,23 +245,8 @@ void WebSocketConnectionImpl::send(const std::string_view msg,
 void WebSocketConnectionImpl::sendJson(const Json::Value &json,
                                        const WebSocketMessageType type)
 {
-    static std::once_flag once;
-    static Json::StreamWriterBuilder builder;
-    std::call_once(once, []() {
-        builder["commentStyle"] = "None";
-        builder["indentation"] = "";
-        if (!app().isUnicodeEscapingUsedInJson())
-        {
-            builder["emitUTF8"] = true;
-        }
-        auto &precision = app().getFloatPrecisionInJson();
-        if (precision.first != 0)
-        {
-            builder["precision"] = precision.first;
-            builder["precisionType"] = precision.second;
-        }
-    });
-    auto msg = writeString(builder, json);
+    std::string msg;
+    app().getJsonEngine()->serialize(json, msg);
     send(msg.data(), msg.length(), type);
 }
 
@@ -251,6 +310,36 @@ void WebSocketConnectionImpl::setPingMessage(
     }
 }
 
+void WebSocketConnectionImpl::setBackpressure(
+    size_t highWaterMark,
+    BackpressurePolicy policy,
+    std::function<void(bool writable)> callback)
+{
+    auto watermark = std::make_shared<internal::OutputWatermark>(
+        highWaterMark, policy, std::move(callback));
+    watermark_ = watermark;
+    auto conn = tcpConnectionPtr_;
+    conn->getLoop()->runInLoop([conn, watermark, isServer = isServer_]() {
+        if (isServer)
+        {
+            // The callbacks of the connection are shared with the memory
+            // accounting of the server.
+            auto requestParser = conn->getContext<HttpRequestParser>();
+            if (requestParser)
+                requestParser->addOutputWatermark(conn, watermark);
+            return;
+        }
+        conn->setHighWaterMarkCallback(
+            [watermark](const trantor::TcpConnectionPtr &connPtr,
+                        size_t bytes) { watermark->onQueued(connPtr, bytes); },
+            watermark->highWaterMark());
+        conn->setWriteCompleteCallback(
+            [watermark](const trantor::TcpConnectionPtr &) {
+                watermark->onDrained();
+            });
+    });
+}
+
 void WebSocketConnectionImpl::disablePing()
 {
     auto loop = tcpConnectionPtr_->getLoop();
@@ -265,35 +354,81 @@ void WebSocketConnectionImpl::disablePing()
     }
 }
 
+void WebSocketMessageParser::unmask(char *data,
+                                    size_t length,
+                                    const char *mask,
+                                    size_t offset)
+{
+    internal::maskWebSocketPayload(data, data, length, mask, offset);
+}
+
 bool WebSocketMessageParser::parse(trantor::MsgBuffer *buffer)
 {
     // According to the rfc6455
-    gotAll_ = false;
-    while (buffer->readableBytes() >= 2)
+    if (gotAll_)
+    {
+        gotAll_ = false;
+        // A control message may come between the frames of a data message.
+        if (isControl(type_))
+            control_.clear();
+        else
+            message_.clear();
+        if (inPlaceLength_ > 0)
+        {
+            // The message given by the last call was read in place.
+            buffer->retrieve(inPlaceLength_);
+            inPlaceLength_ = 0;
+            view_ = {};
+        }
+    }
+    while (true)
     {
+        if (streaming_)
+        {
+            auto length = static_cast<size_t>((std::min)(
+                static_cast<uint64_t>(buffer->readableBytes()),
+                streamRemaining_));
+            if (length == 0)
+                return true;
+            auto data = const_cast<char *>(buffer->peek());
+            if (streamMasked_)
+                unmask(data, length, streamMask_, streamOffset_);
+            streamOffset_ += length;
+            streamRemaining_ -= length;
+            streaming_ = streamRemaining_ > 0;
+            pieceCallback_(std::string_view(data, length),
+                           dataType_,
+                           !streaming_ && streamFin_);
+            buffer->retrieve(length);
+            continue;
+        }
+        if (buffer->readableBytes() < 2)
+            return true;
         unsigned char opcode = (*buffer)[0] & 0x0f;
+        bool isRsv1 = (((*buffer)[0] & 0x40) == 0x40);
         bool isControlFrame = false;
+        WebSocketMessageType controlType{WebSocketMessageType::Unknown};
         switch (opcode)
         {
             case 0:
                 LOG_TRACE << "continuation frame";
                 break;
             case 1:
-                type_ = WebSocketMessageType::Text;
+                dataType_ = WebSocketMessageType::Text;
                 break;
             case 2:
-                type_ = WebSocketMessageType::Binary;
+                dataType_ = WebSocketMessageType::Binary;
                 break;
             case 8:
-                type_ = WebSocketMessageType::Close;
+                controlType = WebSocketMessageType::Close;
                 isControlFrame = true;
                 break;
             case 9:
-                type_ = WebSocketMessageType::Ping;
+                controlType = WebSocketMessageType::Ping;
                 isControlFrame = true;
                 break;
             case 10:
-                type_ = WebSocketMessageType::Pong;
+                controlType = WebSocketMessageType::Pong;
                 isControlFrame = true;
                 break;
             default:
@@ -309,6 +444,15 @@ bool WebSocketMessageParser::parse(trantor::MsgBuffer *buffer)
             LOG_ERROR << "Bad frame: all control frames MUST NOT be fragmented";
             return false;
         }
+        if (isRsv1 && (isControlFrame || opcode == 0))
+        {
+            // rfc7692-6.1
+            LOG_ERROR << "Bad frame: the RSV1 bit is set on a control frame or "
+                         "a continuation frame";
+            return false;
+        }
+        if (opcode == 1 || opcode == 2)
+            compressed_ = isRsv1;
         auto secondByte = (*buffer)[1];
         size_t length = secondByte & 127;
         int isMasked = (secondByte & 0x80);
@@ -368,61 +512,82 @@ bool WebSocketMessageParser::parse(trantor::MsgBuffer *buffer)
                 return false;
             }
         }
+        auto indexFirstDataByte = indexFirstMask + (isMasked != 0 ? 4 : 0);
+        if (pieceCallback_ && !isControlFrame && !compressed_ &&
+            (opcode != 0 || message_.empty()))
+        {
+            // The payload is streamed, it isn't limited.
+            if (buffer->readableBytes() < indexFirstDataByte)
+            {
+                // Not enough data yet, wait for more.
+                return true;
+            }
+            streamMasked_ = isMasked != 0;
+            if (streamMasked_)
+                memcpy(streamMask_, buffer->peek() + indexFirstMask, 4);
+            streamFin_ = isFin;
+            streamRemaining_ = length;
+            streamOffset_ = 0;
+            buffer->retrieve(indexFirstDataByte);
+            streaming_ = length > 0;
+            if (!streaming_ && isFin)
+                pieceCallback_({}, dataType_, true);
+            continue;
+        }
         if (isMasked != 0)
         {
-            // The message is sent by the client, check the length
-            if (length > HttpAppFrameworkImpl::instance()
-                             .getClientMaxWebSocketMessageSize())
+            // The message is sent by the client, check the length of the
+            // message assembled so far
+            auto maxSize = HttpAppFrameworkImpl::instance()
+                               .getClientMaxWebSocketMessageSize();
+            if (length > maxSize ||
+                (!isControlFrame && message_.length() > maxSize - length))
             {
                 LOG_ERROR << "The size of the WebSocket message is too large!";
                 buffer->retrieveAll();
                 return false;
             }
-            if (buffer->readableBytes() >= (indexFirstMask + 4 + length))
-            {
-                auto masks = buffer->peek() + indexFirstMask;
-                auto indexFirstDataByte = indexFirstMask + 4;
-                auto rawData = buffer->peek() + indexFirstDataByte;
-                auto oldLen = message_.length();
-                message_.resize(oldLen + length);
-                for (size_t i = 0; i < length; ++i)
-                {
-                    message_[oldLen + i] = (rawData[i] ^ masks[i % 4]);
-                }
-                buffer->retrieve(indexFirstMask + 4 + length);
-                if (isFin)
-                {
-                    gotAll_ = true;
-                    return true;
-                }
-            }
-            else
-            {
-                // Not enough data yet, wait for more.
-                return true;
-            }
         }
-        else
+        if (buffer->readableBytes() < indexFirstDataByte + length)
+        {
+            // Not enough data yet, wait for more.
+            return true;
+        }
+        auto rawData = buffer->peek() + indexFirstDataByte;
+        if (isControlFrame ||
+            (isFin && opcode != 0 && inPlace_ && !compressed_))
         {
-            if (buffer->readableBytes() >= (indexFirstMask + length))
+            // The whole message is in the frame, unmask it in the buffer.
+            auto data = const_cast<char *>(rawData);
+            if (isMasked != 0)
+                unmask(data, length, rawData - 4, 0);
+            if (isControlFrame)
             {
-                auto rawData = buffer->peek() + indexFirstMask;
-                message_.append(rawData, length);
-                buffer->retrieve(indexFirstMask + length);
-                if (isFin)
-                {
-                    gotAll_ = true;
-                    return true;
-                }
+                control_.assign(data, length);
+                buffer->retrieve(indexFirstDataByte + length);
+                type_ = controlType;
             }
             else
             {
-                // Not enough data yet, wait for more.
-                return true;
+                view_ = std::string_view(data, length);
+                inPlaceLength_ = indexFirstDataByte + length;
+                type_ = dataType_;
             }
+            gotAll_ = true;
+            return true;
+        }
+        auto oldLen = message_.length();
+        message_.append(rawData, length);
+        if (isMasked != 0)
+            unmask(&message_[oldLen], length, rawData - 4, 0);
+        buffer->retrieve(indexFirstDataByte + length);
+        if (isFin)
+        {
+            type_ = dataType_;
+            gotAll_ = true;
+            return true;
         }
     }
-    return true;
 }
 
 void WebSocketConnectionImpl::onNewMessage(
@@ -437,8 +602,54 @@ void WebSocketConnectionImpl::onNewMessage(
         {
             std::string message;
             WebSocketMessageType type;
+            std::string_view view;
+            if ((pieceHandler_ || viewHandler_) && parser_.gotAll(view, type) &&
+                (type == WebSocketMessageType::Text ||
+                 type == WebSocketMessageType::Binary))
+            {
+                if (parser_.compressed())
+                {
+                    size_t maxSize = std::string::npos;
+                    if (isServer_)
+                        maxSize = HttpAppFrameworkImpl::instance()
+                                      .getClientMaxWebSocketMessageSize();
+                    // The compressed messages aren't read in place.
+                    std::string compressed;
+                    parser_.gotAll(compressed, type);
+                    if (!deflate_ ||
+                        !deflate_->decompress(compressed, message, maxSize))
+                    {
+                        connPtr->shutdown();
+                        return;
+                    }
+                    view = message;
+                }
+                if (pieceHandler_)
+                    pieceHandler_(view, self, type, true);
+                else
+                    viewHandler_(view, self, type);
+                continue;
+            }
             if (parser_.gotAll(message, type))
             {
+                if ((type == WebSocketMessageType::Text ||
+                     type == WebSocketMessageType::Binary) &&
+                    parser_.compressed())
+                {
+                    // The size of messages from servers is not limited
+                    size_t maxSize = std::string::npos;
+                    if (isServer_)
+                        maxSize = HttpAppFrameworkImpl::instance()
+                                      .getClientMaxWebSocketMessageSize();
+                    std::string decompressed;
+                    if (!deflate_ ||
+                        !deflate_->decompress(message, decompressed, maxSize))
+                    {
+                        connPtr->shutdown();
+                        return;
+                    }
+                    message.swap(decompressed);
+                }
                 if (type == WebSocketMessageType::Ping)
                 {
                     // ping
@@ -472,6 +683,28 @@ void WebSocketConnectionImpl::onNewMessage(
     return;
 }
 
+void WebSocketConnectionImpl::setMessageViewHandler(MessageViewHandler handler)
+{
+    viewHandler_ = std::move(handler);
+    parser_.setInPlace(static_cast<bool>(viewHandler_));
+}
+
+void WebSocketConnectionImpl::setMessagePieceHandler(
+    MessagePieceHandler handler)
+{
+    pieceHandler_ = std::move(handler);
+    if (!pieceHandler_)
+    {
+        parser_.setPieceCallback(nullptr);
+        return;
+    }
+    // The parser is a member, the connection outlives the callback.
+    parser_.setPieceCallback(
+        [this](std::string_view piece, WebSocketMessageType type, bool isLast) {
+            pieceHandler_(piece, shared_from_this(), type, isLast);
+        });
+}
+
 void WebSocketConnectionImpl::disablePingInLoop()
 {
     if (pingTimerId_ != trantor::InvalidTimerId)
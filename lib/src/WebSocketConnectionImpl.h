@@ -15,8 +15,12 @@
 #pragma once
 
 #include "impl_forwards.h"
+#include "OutputWatermark.h"
+#include "WebSocketDeflate.h"
 #include <drogon/WebSocketConnection.h>
 #include <json/value.h>
+#include <functional>
+#include <mutex>
 #include <string_view>
 #include <trantor/utils/NonCopyable.h>
 #include <trantor/net/TcpConnection.h>
@@ -29,6 +33,14 @@ using WebSocketConnectionImplPtr = std::shared_ptr<WebSocketConnectionImpl>;
 class WebSocketMessageParser
 {
   public:
+    using PieceCallback = std::function<
+        void(std::string_view piece, WebSocketMessageType type, bool isLast)>;
+
+    /**
+     * @brief Parse the frames in the buffer until a message is complete. The
+     * bytes of a message found by gotAll() in place are consumed by the next
+     * call.
+     */
     bool parse(trantor::MsgBuffer *buffer);
 
     bool gotAll(std::string &message, WebSocketMessageType &type)
@@ -36,15 +48,87 @@ class WebSocketMessageParser
         assert(message.empty());
         if (!gotAll_)
             return false;
-        message.swap(message_);
         type = type_;
+        if (isControl(type_))
+            message.swap(control_);
+        else if (inPlaceLength_ > 0)
+            message.assign(view_);
+        else
+            message.swap(message_);
+        return true;
+    }
+
+    /// The message is valid until the next call of parse().
+    bool gotAll(std::string_view &message, WebSocketMessageType &type)
+    {
+        if (!gotAll_)
+            return false;
+        type = type_;
+        if (isControl(type_))
+            message = control_;
+        else if (inPlaceLength_ > 0)
+            message = view_;
+        else
+            message = message_;
         return true;
     }
 
+    /// Return true if the RSV1 bit of the message is set
+    bool compressed() const
+    {
+        return compressed_;
+    }
+
+    /// Unmask the messages of one uncompressed frame in the buffer instead of
+    /// copying them, see gotAll().
+    void setInPlace(bool inPlace)
+    {
+        inPlace_ = inPlace;
+    }
+
+    /**
+     * @brief Give the payload of the uncompressed data frames to the callback
+     * as it arrives, instead of assembling the messages. The callback is
+     * called in parse(), the piece is unmasked in the buffer.
+     */
+    void setPieceCallback(PieceCallback callback)
+    {
+        pieceCallback_ = std::move(callback);
+    }
+
+    /// XOR the data with the mask, starting at the offset of the mask.
+    static void unmask(char *data,
+                       size_t length,
+                       const char *mask,
+                       size_t offset);
+
   private:
+    static bool isControl(WebSocketMessageType type)
+    {
+        return type == WebSocketMessageType::Close ||
+               type == WebSocketMessageType::Ping ||
+               type == WebSocketMessageType::Pong;
+    }
+
     std::string message_;
+    // Control frames may come between the frames of a message
+    std::string control_;
     WebSocketMessageType type_;
+    WebSocketMessageType dataType_{WebSocketMessageType::Unknown};
     bool gotAll_{false};
+    bool compressed_{false};
+    bool inPlace_{false};
+    std::string_view view_;
+    size_t inPlaceLength_{0};
+
+    // The frame whose payload is being streamed
+    PieceCallback pieceCallback_;
+    bool streaming_{false};
+    bool streamFin_{false};
+    bool streamMasked_{false};
+    char streamMask_[4];
+    uint64_t streamRemaining_{0};
+    size_t streamOffset_{0};
 };
 
 class WebSocketConnectionImpl final
@@ -83,6 +167,15 @@ class WebSocketConnectionImpl final
 
     void disablePing() override;
 
+    void setBackpressure(size_t highWaterMark,
+                         BackpressurePolicy policy,
+                         std::function<void(bool writable)> callback) override;
+
+    bool writable() const override
+    {
+        return !watermark_ || watermark_->writable();
+    }
+
     void setMessageCallback(
         const std::function<void(std::string &&,
                                  const WebSocketConnectionImplPtr &,
@@ -91,6 +184,9 @@ class WebSocketConnectionImpl final
         messageCallback_ = callback;
     }
 
+    void setMessageViewHandler(MessageViewHandler handler) override;
+    void setMessagePieceHandler(MessagePieceHandler handler) override;
+
     void setCloseCallback(
         const std::function<void(const WebSocketConnectionImplPtr &)> &callback)
     {
@@ -100,6 +196,35 @@ class WebSocketConnectionImpl final
     void onNewMessage(const trantor::TcpConnectionPtr &connPtr,
                       trantor::MsgBuffer *buffer);
 
+    /// Compress the messages with the agreed permessage-deflate parameters
+    void enableDeflate(const WebSocketDeflateParams &params);
+
+    trantor::EventLoop *getLoop() const
+    {
+        return tcpConnectionPtr_->getLoop();
+    }
+
+    static unsigned char opcodeOf(WebSocketMessageType type, uint64_t len);
+
+    /**
+     * @brief Create an unmasked and uncompressed frame which can be shared by
+     * many connections of the server, see sendSharedFrame().
+     */
+    static std::shared_ptr<trantor::MsgBuffer> newServerFrame(
+        const char *msg,
+        uint64_t len,
+        unsigned char opcode,
+        size_t &headerLength);
+
+    /**
+     * @brief Send the frame created by newServerFrame() without copying it.
+     * The payload is framed again if the connection can't send the frame as it
+     * is.
+     */
+    void sendSharedFrame(const std::shared_ptr<trantor::MsgBuffer> &frame,
+                         size_t headerLength,
+                         unsigned char opcode);
+
     void onClose()
     {
         if (pingTimerId_ != trantor::InvalidTimerId)
@@ -116,6 +241,10 @@ class WebSocketConnectionImpl final
     trantor::TimerId pingTimerId_{trantor::InvalidTimerId};
     std::vector<uint32_t> masks_;
     std::atomic<bool> usingMask_;
+    std::unique_ptr<WebSocketDeflate> deflate_;
+    std::shared_ptr<internal::OutputWatermark> watermark_;
+    // Messages must be sent in the order in which they are compressed
+    std::mutex deflateMutex_;
 
     std::function<void(std::string &&,
                        const WebSocketConnectionImplPtr &,
@@ -125,7 +254,25 @@ class WebSocketConnectionImpl final
                               const WebSocketMessageType &) {};
     std::function<void(const WebSocketConnectionImplPtr &)> closeCallback_ =
         [](const WebSocketConnectionImplPtr &) {};
+    MessageViewHandler viewHandler_;
+    MessagePieceHandler pieceHandler_;
     void sendWsData(const char *msg, uint64_t len, unsigned char opcode);
+    // Whether the data frame is dropped by the backpressure policy.
+    bool dropped(unsigned char opcode) const
+    {
+        return watermark_ && opcode < 8 &&
+               watermark_->policy() == BackpressurePolicy::Drop &&
+               !watermark_->writable();
+    }
+    void sendFrame(const char *msg,
+                   uint64_t len,
+                   unsigned char opcode,
+                   bool compressed);
+    /// Write at most 10 bytes and return the length of the header
+    static size_t formatFrameHeader(char *header,
+                                    uint64_t len,
+                                    unsigned char opcode,
+                                    bool compressed);
     void disablePingInLoop();
     void setPingMessageInLoop(std::string &&message,
                               const std::chrono::duration<double> &interval);
@@ -0,0 +1,278 @@
+/**
+ *
+ *  @file WebSocketDeflate.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "WebSocketDeflate.h"
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+using namespace drogon;
+
+namespace
+{
+std::string_view trim(std::string_view str)
+{
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+        str.remove_prefix(1);
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+        str.remove_suffix(1);
+    return str;
+}
+
+std::vector<std::string_view> split(std::string_view str, char separator)
+{
+    std::vector<std::string_view> result;
+    while (true)
+    {
+        auto pos = str.find(separator);
+        result.push_back(trim(str.substr(0, pos)));
+        if (pos == std::string_view::npos)
+            return result;
+        str.remove_prefix(pos + 1);
+    }
+}
+
+// Return -1 if the value is not a valid number of window bits
+int windowBits(std::string_view value)
+{
+    // The value may be a quoted string
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+        value = value.substr(1, value.size() - 2);
+    if (value.size() == 1 && value[0] >= '8' && value[0] <= '9')
+        return value[0] - '0';
+    if (value.size() == 2 && value[0] == '1' && value[1] >= '0' &&
+        value[1] <= '5')
+        return 10 + value[1] - '0';
+    return -1;
+}
+
+/**
+ * Parse the parameters of one extension, isOffer is true for the offers of
+ * clients. Window bits of 8 are refused because zlib doesn't support them for
+ * raw deflate streams.
+ */
+bool parseExtension(std::string_view extension,
+                    bool isOffer,
+                    WebSocketDeflateParams &params,
+                    bool &hasServerMaxWindowBits)
+{
+    auto items = split(extension, ';');
+    if (items[0] != "permessage-deflate")
+        return false;
+    hasServerMaxWindowBits = false;
+    bool hasClientMaxWindowBits = false;
+    for (size_t i = 1; i < items.size(); ++i)
+    {
+        auto item = items[i];
+        auto pos = item.find('=');
+        auto name = trim(item.substr(0, pos));
+        std::string_view value;
+        if (pos != std::string_view::npos)
+            value = trim(item.substr(pos + 1));
+        // Every parameter can be given only once
+        if (name == "server_no_context_takeover")
+        {
+            if (params.serverNoContextTakeover || !value.empty())
+                return false;
+            params.serverNoContextTakeover = true;
+        }
+        else if (name == "client_no_context_takeover")
+        {
+            if (params.clientNoContextTakeover || !value.empty())
+                return false;
+            params.clientNoContextTakeover = true;
+        }
+        else if (name == "server_max_window_bits")
+        {
+            auto bits = windowBits(value);
+            if (hasServerMaxWindowBits || bits < 9)
+                return false;
+            hasServerMaxWindowBits = true;
+            params.serverMaxWindowBits = bits;
+        }
+        else if (name == "client_max_window_bits")
+        {
+            if (hasClientMaxWindowBits)
+                return false;
+            hasClientMaxWindowBits = true;
+            // Clients may offer it without a value
+            if (isOffer && pos == std::string_view::npos)
+                continue;
+            auto bits = windowBits(value);
+            if (bits < 0 || (!isOffer && bits < 9))
+                return false;
+            params.clientMaxWindowBits = bits;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+}  // namespace
+
+bool WebSocketDeflateParams::negotiate(const std::string &offers,
+                                       std::string &response)
+{
+    for (auto offer : split(offers, ','))
+    {
+        WebSocketDeflateParams params;
+        bool hasServerMaxWindowBits;
+        if (!parseExtension(offer, true, params, hasServerMaxWindowBits))
+            continue;
+        *this = params;
+        // The window of the client is limited by the client itself, so only
+        // the parameters requested by the client are confirmed.
+        response = "permessage-deflate";
+        if (serverNoContextTakeover)
+            response.append("; server_no_context_takeover");
+        if (clientNoContextTakeover)
+            response.append("; client_no_context_takeover");
+        if (hasServerMaxWindowBits)
+        {
+            response.append("; server_max_window_bits=");
+            response.append(std::to_string(serverMaxWindowBits));
+        }
+        return true;
+    }
+    return false;
+}
+
+bool WebSocketDeflateParams::parse(const std::string &response)
+{
+    // Only one extension is offered by clients
+    if (response.find(',') != std::string::npos)
+        return false;
+    WebSocketDeflateParams params;
+    bool hasServerMaxWindowBits;
+    if (!parseExtension(response, false, params, hasServerMaxWindowBits))
+        return false;
+    *this = params;
+    return true;
+}
+
+WebSocketDeflate::WebSocketDeflate(const WebSocketDeflateParams &params,
+                                   bool isServer)
+    : deflateNoContextTakeover_(isServer ? params.serverNoContextTakeover
+                                         : params.clientNoContextTakeover)
+{
+    memset(&deflateStream_, 0, sizeof(deflateStream_));
+    memset(&inflateStream_, 0, sizeof(inflateStream_));
+    auto bits =
+        isServer ? params.serverMaxWindowBits : params.clientMaxWindowBits;
+    // Negative window bits mean raw deflate data without the zlib header
+    deflateOk_ = deflateInit2(&deflateStream_,
+                              Z_DEFAULT_COMPRESSION,
+                              Z_DEFLATED,
+                              -bits,
+                              8,
+                              Z_DEFAULT_STRATEGY) == Z_OK;
+    // The window of the peer is never bigger than 15 bits
+    inflateOk_ = inflateInit2(&inflateStream_, -15) == Z_OK;
+    if (!deflateOk_ || !inflateOk_)
+    {
+        LOG_ERROR << "Failed to initialize zlib for permessage-deflate";
+    }
+}
+
+WebSocketDeflate::~WebSocketDeflate()
+{
+    if (deflateOk_)
+        deflateEnd(&deflateStream_);
+    if (inflateOk_)
+        inflateEnd(&inflateStream_);
+}
+
+bool WebSocketDeflate::compress(const char *data,
+                                size_t length,
+                                std::string &output)
+{
+    output.clear();
+    if (!deflateOk_)
+        return false;
+    deflateStream_.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    deflateStream_.avail_in = static_cast<uInt>(length);
+    do
+    {
+        auto offset = output.size();
+        output.resize(offset + (std::max)(length / 2, size_t{64}) + 16);
+        deflateStream_.next_out = reinterpret_cast<Bytef *>(&output[offset]);
+        deflateStream_.avail_out = static_cast<uInt>(output.size() - offset);
+        if (deflate(&deflateStream_, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+        {
+            LOG_ERROR << "deflate error!";
+            return false;
+        }
+        output.resize(output.size() - deflateStream_.avail_out);
+    } while (deflateStream_.avail_out == 0);
+    // RFC 7692 7.2.1, remove the empty block at the end of the sync flush
+    if (output.size() < 4 ||
+        memcmp(output.data() + output.size() - 4, "\x00\x00\xff\xff", 4) != 0)
+    {
+        LOG_ERROR << "Unexpected end of the deflate output";
+        return false;
+    }
+    output.resize(output.size() - 4);
+    if (deflateNoContextTakeover_)
+        deflateReset(&deflateStream_);
+    return true;
+}
+
+bool WebSocketDeflate::decompress(const std::string &data,
+                                  std::string &output,
+                                  size_t maxSize)
+{
+    output.clear();
+    if (!inflateOk_)
+        return false;
+    static const char tail[] = {'\x00', '\x00', '\xff', '\xff'};
+    for (auto input : {std::string_view(data), std::string_view(tail, 4)})
+    {
+        inflateStream_.next_in =
+            reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+        inflateStream_.avail_in = static_cast<uInt>(input.size());
+        do
+        {
+            auto offset = output.size();
+            output.resize(offset + (std::max)(input.size() * 2, size_t{1024}));
+            inflateStream_.next_out =
+                reinterpret_cast<Bytef *>(&output[offset]);
+            inflateStream_.avail_out =
+                static_cast<uInt>(output.size() - offset);
+            auto ret = inflate(&inflateStream_, Z_SYNC_FLUSH);
+            output.resize(output.size() - inflateStream_.avail_out);
+            if (output.size() > maxSize)
+            {
+                LOG_ERROR << "The size of the WebSocket message is too large!";
+                return false;
+            }
+            if (ret == Z_STREAM_END)
+            {
+                // The peer ended the deflate stream, the next message starts
+                // a new one.
+                inflateReset(&inflateStream_);
+                return true;
+            }
+            if (ret != Z_OK && ret != Z_BUF_ERROR)
+            {
+                LOG_ERROR << "inflate error: " << ret;
+                return false;
+            }
+        } while (inflateStream_.avail_in > 0 || inflateStream_.avail_out == 0);
+    }
+    return true;
+}
@@ -0,0 +1,95 @@
+/**
+ *
+ *  @file WebSocketDeflate.h
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/utils/NonCopyable.h>
+#include <zlib.h>
+#include <string>
+
+namespace drogon
+{
+/**
+ * @brief The parameters of the permessage-deflate extension (RFC 7692)
+ * agreed by the handshake.
+ */
+struct WebSocketDeflateParams
+{
+    bool serverNoContextTakeover{false};
+    bool clientNoContextTakeover{false};
+    int serverMaxWindowBits{15};
+    int clientMaxWindowBits{15};
+
+    /**
+     * @brief Accept the first offer in the Sec-WebSocket-Extensions header of
+     * the client which can be supported.
+     *
+     * @param response the value of the Sec-WebSocket-Extensions header of the
+     * response.
+     * @return false if there is no such offer.
+     */
+    bool negotiate(const std::string &offers, std::string &response);
+
+    /**
+     * @brief Parse the Sec-WebSocket-Extensions header of the response.
+     *
+     * @return false if the extension is not agreed or the parameters are
+     * invalid.
+     */
+    bool parse(const std::string &response);
+
+    /// The value of the Sec-WebSocket-Extensions header sent by clients
+    static const char *clientOffer()
+    {
+        return "permessage-deflate; client_max_window_bits";
+    }
+};
+
+/**
+ * @brief Compresses the messages sent by and decompresses the messages
+ * received by one side of a WebSocket connection.
+ *
+ * @note This class is not thread safe.
+ */
+class WebSocketDeflate : public trantor::NonCopyable
+{
+  public:
+    WebSocketDeflate(const WebSocketDeflateParams &params, bool isServer);
+    ~WebSocketDeflate();
+
+    /// Return false if zlib failed to initialize
+    bool valid() const
+    {
+        return deflateOk_ && inflateOk_;
+    }
+
+    /// Compress the payload of a message, return false on errors.
+    bool compress(const char *data, size_t length, std::string &output);
+
+    /**
+     * @brief Decompress the payload of a message, return false on errors or
+     * if the message is longer than maxSize. The connection must be closed
+     * after a failure, because the decompression context is lost.
+     */
+    bool decompress(const std::string &data,
+                    std::string &output,
+                    size_t maxSize);
+
+  private:
+    z_stream deflateStream_;
+    z_stream inflateStream_;
+    bool deflateOk_{false};
+    bool inflateOk_{false};
+    bool deflateNoContextTakeover_;
+};
+}  // namespace drogon
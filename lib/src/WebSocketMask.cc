@@ -0,0 +1,137 @@
+/**
+ *
+ *  @file WebSocketMask.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "WebSocketMask.h"
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DROGON_MASK_SSE2
+#if defined(__GNUC__) || defined(__clang__)
+// The AVX2 kernel is compiled whatever the flags of the build, it's only
+// called after checking the CPU.
+#include <immintrin.h>
+#define DROGON_MASK_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define DROGON_MASK_NEON
+#endif
+
+using namespace drogon;
+
+namespace
+{
+// The mask repeated from the offset, to XOR blocks of up to 32 bytes.
+struct MaskPattern
+{
+    MaskPattern(const char *mask, size_t offset)
+    {
+        for (size_t i = 0; i < sizeof(bytes); ++i)
+            bytes[i] = mask[(offset + i) % 4];
+    }
+
+    char bytes[32];
+};
+
+#ifdef DROGON_MASK_AVX2
+__attribute__((target("avx2"))) size_t maskAvx2(char *dst,
+                                                const char *src,
+                                                size_t length,
+                                                const MaskPattern &pattern)
+{
+    const __m256i mask =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pattern.bytes));
+    size_t pos = 0;
+    for (; length - pos >= 32; pos += 32)
+    {
+        auto data =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + pos));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + pos),
+                            _mm256_xor_si256(data, mask));
+    }
+    return pos;
+}
+
+bool cpuSupportsAvx2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+}  // namespace
+
+void internal::maskWebSocketPayloadScalar(char *dst,
+                                          const char *src,
+                                          size_t length,
+                                          const char *mask,
+                                          size_t offset)
+{
+    MaskPattern pattern(mask, offset);
+    uint64_t maskWord;
+    memcpy(&maskWord, pattern.bytes, 8);
+    size_t pos = 0;
+    for (; length - pos >= 8; pos += 8)
+    {
+        uint64_t word;
+        memcpy(&word, src + pos, 8);
+        word ^= maskWord;
+        memcpy(dst + pos, &word, 8);
+    }
+    // The blocks are multiples of 4 bytes, the tail starts at the offset.
+    for (; pos < length; ++pos)
+        dst[pos] = src[pos] ^ pattern.bytes[pos % 4];
+}
+
+void internal::maskWebSocketPayload(char *dst,
+                                    const char *src,
+                                    size_t length,
+                                    const char *mask,
+                                    size_t offset)
+{
+    if (length < 16)
+    {
+        maskWebSocketPayloadScalar(dst, src, length, mask, offset);
+        return;
+    }
+    MaskPattern pattern(mask, offset);
+    size_t pos = 0;
+#ifdef DROGON_MASK_AVX2
+    if (length >= 64 && cpuSupportsAvx2())
+        pos = maskAvx2(dst, src, length, pattern);
+#endif
+#if defined(DROGON_MASK_SSE2)
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(pattern.bytes));
+    for (; length - pos >= 16; pos += 16)
+    {
+        auto data =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + pos));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + pos),
+                         _mm_xor_si128(data, block));
+    }
+#elif defined(DROGON_MASK_NEON)
+    const uint8x16_t block =
+        vld1q_u8(reinterpret_cast<const uint8_t *>(pattern.bytes));
+    for (; length - pos >= 16; pos += 16)
+    {
+        auto data = vld1q_u8(reinterpret_cast<const uint8_t *>(src + pos));
+        vst1q_u8(reinterpret_cast<uint8_t *>(dst + pos),
+                 veorq_u8(data, block));
+    }
+#endif
+    maskWebSocketPayloadScalar(
+        dst + pos, src + pos, length - pos, pattern.bytes, 0);
+}
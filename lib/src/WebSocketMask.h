@@ -0,0 +1,47 @@
+/**
+ *
+ *  @file WebSocketMask.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <cstddef>
+
+namespace drogon
+{
+namespace internal
+{
+/**
+ * @brief XOR the payload of a WebSocket frame with the 4 bytes of the mask
+ * (rfc6455-5.3), starting at the offset of the mask, into dst, which may be
+ * src to (un)mask in place.
+ *
+ * The payload is processed 32 bytes at a time with AVX2 if the CPU supports
+ * it, or 16 bytes at a time with SSE2 or NEON, which are always available on
+ * x86-64 and arm64.
+ */
+DROGON_EXPORT void maskWebSocketPayload(char *dst,
+                                        const char *src,
+                                        size_t length,
+                                        const char *mask,
+                                        size_t offset = 0);
+
+/// The version processing 8 bytes at a time, for the CPUs without SIMD
+/// instructions and the benchmarks.
+DROGON_EXPORT void maskWebSocketPayloadScalar(char *dst,
+                                              const char *src,
+                                              size_t length,
+                                              const char *mask,
+                                              size_t offset = 0);
+}  // namespace internal
+}  // namespace drogon
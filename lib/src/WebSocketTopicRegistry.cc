@@ -0,0 +1,189 @@
+/**
+ *
+ *  @file WebSocketTopicRegistry.cc
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by the MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/WebSocketTopicRegistry.h>
+#include <drogon/HttpAppFramework.h>
+#include "WebSocketConnectionImpl.h"
+#include <atomic>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace drogon;
+
+struct WebSocketTopicRegistry::Shard
+{
+    // Set by the first subscription, read by publishers in other threads
+    std::atomic<trantor::EventLoop *> loop{nullptr};
+    std::atomic<size_t> size{0};
+
+    // The members below are only accessed in the loop
+    std::unordered_map<std::string,
+                       std::unordered_set<WebSocketConnectionImplPtr>>
+        topics;
+    std::unordered_map<WebSocketConnectionImplPtr,
+                       std::unordered_set<std::string>>
+        topicsOfConnections;
+
+    void erase(const std::string &topic, const WebSocketConnectionImplPtr &conn)
+    {
+        auto iter = topics.find(topic);
+        if (iter == topics.end() || iter->second.erase(conn) == 0)
+            return;
+        if (iter->second.empty())
+            topics.erase(iter);
+        auto connIter = topicsOfConnections.find(conn);
+        if (connIter != topicsOfConnections.end())
+        {
+            connIter->second.erase(topic);
+            if (connIter->second.empty())
+                topicsOfConnections.erase(connIter);
+        }
+        size.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+WebSocketTopicRegistry::WebSocketTopicRegistry()
+{
+    auto shardsNum = app().getThreadNum() + 1;
+    shards_.reserve(shardsNum);
+    for (size_t i = 0; i < shardsNum; ++i)
+    {
+        shards_.push_back(std::make_shared<Shard>());
+    }
+}
+
+WebSocketTopicRegistry::~WebSocketTopicRegistry()
+{
+    // Release the connections in their own loops
+    for (auto &shard : shards_)
+    {
+        auto loop = shard->loop.load(std::memory_order_acquire);
+        if (!loop)
+            continue;
+        loop->runInLoop([shard]() {
+            shard->topics.clear();
+            shard->topicsOfConnections.clear();
+            shard->size.store(0, std::memory_order_relaxed);
+        });
+    }
+}
+
+std::shared_ptr<WebSocketTopicRegistry::Shard> WebSocketTopicRegistry::shardOf(
+    const WebSocketConnectionPtr &conn)
+{
+    auto loop = static_cast<WebSocketConnectionImpl *>(conn.get())->getLoop();
+    auto index = loop->index();
+    if (index >= shards_.size())
+    {
+        // The index of loops out of the framework is not set
+        throw std::invalid_argument(
+            "The connection doesn't belong to an event loop of the app");
+    }
+    auto &shard = shards_[index];
+    if (!shard->loop.load(std::memory_order_acquire))
+        shard->loop.store(loop, std::memory_order_release);
+    return shard;
+}
+
+void WebSocketTopicRegistry::subscribe(const std::string &topic,
+                                       const WebSocketConnectionPtr &conn)
+{
+    auto shard = shardOf(conn);
+    auto connImpl = std::static_pointer_cast<WebSocketConnectionImpl>(conn);
+    connImpl->getLoop()->runInLoop(
+        [shard = std::move(shard),
+         topic,
+         connImpl = std::move(connImpl)]() {
+            if (connImpl->disconnected())
+                return;
+            if (!shard->topics[topic].insert(connImpl).second)
+                return;
+            shard->topicsOfConnections[connImpl].insert(topic);
+            shard->size.fetch_add(1, std::memory_order_relaxed);
+        });
+}
+
+void WebSocketTopicRegistry::unsubscribe(const std::string &topic,
+                                         const WebSocketConnectionPtr &conn)
+{
+    auto shard = shardOf(conn);
+    auto connImpl = std::static_pointer_cast<WebSocketConnectionImpl>(conn);
+    connImpl->getLoop()->runInLoop(
+        [shard = std::move(shard),
+         topic,
+         connImpl = std::move(connImpl)]() { shard->erase(topic, connImpl); });
+}
+
+void WebSocketTopicRegistry::unsubscribeAll(const WebSocketConnectionPtr &conn)
+{
+    auto shard = shardOf(conn);
+    auto connImpl = std::static_pointer_cast<WebSocketConnectionImpl>(conn);
+    connImpl->getLoop()->runInLoop(
+        [shard = std::move(shard),
+         connImpl = std::move(connImpl)]() {
+            auto iter = shard->topicsOfConnections.find(connImpl);
+            if (iter == shard->topicsOfConnections.end())
+                return;
+            auto topics = std::move(iter->second);
+            for (auto &topic : topics)
+            {
+                shard->erase(topic, connImpl);
+            }
+        });
+}
+
+void WebSocketTopicRegistry::publish(const std::string &topic,
+                                     std::string_view message,
+                                     WebSocketMessageType type)
+{
+    auto opcode = WebSocketConnectionImpl::opcodeOf(type, message.length());
+    size_t headerLength;
+    auto frame = WebSocketConnectionImpl::newServerFrame(message.data(),
+                                                         message.length(),
+                                                         opcode,
+                                                         headerLength);
+    for (auto &shard : shards_)
+    {
+        if (shard->size.load(std::memory_order_relaxed) == 0)
+            continue;
+        auto loop = shard->loop.load(std::memory_order_acquire);
+        loop->runInLoop([shard, topic, frame, headerLength, opcode]() {
+            auto iter = shard->topics.find(topic);
+            if (iter == shard->topics.end())
+                return;
+            std::vector<WebSocketConnectionImplPtr> closed;
+            for (auto &conn : iter->second)
+            {
+                if (conn->disconnected())
+                    closed.push_back(conn);
+                else
+                    conn->sendSharedFrame(frame, headerLength, opcode);
+            }
+            for (auto &conn : closed)
+            {
+                shard->erase(topic, conn);
+            }
+        });
+    }
+}
+
+size_t WebSocketTopicRegistry::size() const
+{
+    size_t total{0};
+    for (auto &shard : shards_)
+    {
+        total += shard->size.load(std::memory_order_relaxed);
+    }
+    return total;
+}
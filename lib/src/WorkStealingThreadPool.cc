@@ -0,0 +1,130 @@
+/**
+ *
+ *  @file WorkStealingThreadPool.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "WorkStealingThreadPool.h"
+#include <trantor/utils/Logger.h>
+#include <exception>
+
+using namespace drogon;
+
+// The pool and the index of the current thread, for the tasks queued by the
+// tasks.
+static thread_local const WorkStealingThreadPool *currentPool{nullptr};
+static thread_local size_t currentIndex{0};
+
+WorkStealingThreadPool::WorkStealingThreadPool(size_t threadNum)
+{
+    if (threadNum == 0)
+        threadNum = 1;
+    workers_.reserve(threadNum);
+    for (size_t i = 0; i < threadNum; ++i)
+    {
+        workers_.emplace_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < threadNum; ++i)
+    {
+        workers_[i]->thread_ = std::thread([this, i]() { run(i); });
+    }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stop_ = true;
+    }
+    sleepCond_.notify_all();
+    for (auto &worker : workers_)
+    {
+        if (worker->thread_.joinable())
+            worker->thread_.join();
+    }
+}
+
+void WorkStealingThreadPool::runTask(std::function<void()> &&task)
+{
+    size_t index;
+    if (currentPool == this)
+        index = currentIndex;
+    else
+        index = nextWorker_.fetch_add(1, std::memory_order_relaxed) %
+                workers_.size();
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex_);
+        workers_[index]->tasks_.push_back(std::move(task));
+    }
+    {
+        // Counted under the lock so that no thread misses the wakeup.
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        pending_.fetch_add(1, std::memory_order_relaxed);
+    }
+    sleepCond_.notify_one();
+}
+
+bool WorkStealingThreadPool::takeTask(size_t index, std::function<void()> &task)
+{
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        auto &worker = *workers_[(index + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex_);
+        if (worker.tasks_.empty())
+            continue;
+        if (i == 0)
+        {
+            task = std::move(worker.tasks_.front());
+            worker.tasks_.pop_front();
+        }
+        else
+        {
+            // Steal from the other end, the task its owner would run last.
+            task = std::move(worker.tasks_.back());
+            worker.tasks_.pop_back();
+        }
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingThreadPool::run(size_t index)
+{
+    currentPool = this;
+    currentIndex = index;
+    for (;;)
+    {
+        std::function<void()> task;
+        if (takeTask(index, task))
+        {
+            try
+            {
+                task();
+            }
+            catch (const std::exception &e)
+            {
+                LOG_ERROR << "Exception in a worker thread: " << e.what();
+            }
+            catch (...)
+            {
+                LOG_ERROR << "Exception not derived from std::exception";
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleepCond_.wait(lock, [this]() {
+            return stop_ || pending_.load(std::memory_order_relaxed) > 0;
+        });
+        if (stop_ && pending_.load(std::memory_order_relaxed) == 0)
+            return;
+    }
+}
@@ -0,0 +1,73 @@
+/**
+ *
+ *  @file WorkStealingThreadPool.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/utils/NonCopyable.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief A pool of threads with a queue of tasks per thread. The tasks are
+ * spread over the queues, a thread whose queue is empty takes the tasks of
+ * the others, so one long task doesn't delay the ones queued after it while
+ * other threads are idle.
+ */
+class WorkStealingThreadPool : public trantor::NonCopyable
+{
+  public:
+    explicit WorkStealingThreadPool(size_t threadNum);
+
+    /// Run the remaining tasks and join the threads
+    ~WorkStealingThreadPool();
+
+    /**
+     * @brief Run the task in one of the threads. A task run by a thread of
+     * the pool goes to the queue of this thread.
+     */
+    void runTask(std::function<void()> &&task);
+
+    size_t threadNum() const
+    {
+        return workers_.size();
+    }
+
+  private:
+    struct Worker
+    {
+        std::mutex mutex_;
+        std::deque<std::function<void()>> tasks_;
+        std::thread thread_;
+    };
+
+    bool takeTask(size_t index, std::function<void()> &task);
+    void run(size_t index);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> nextWorker_{0};
+    // The number of queued tasks, the threads sleep while it's 0.
+    std::atomic<size_t> pending_{0};
+    std::mutex sleepMutex_;
+    std::condition_variable sleepCond_;
+    bool stop_{false};
+};
+}  // namespace drogon
@@ -0,0 +1,77 @@
+/**
+ *
+ *  @file ZlibStreams.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "ZlibStreams.h"
+#include <trantor/utils/Logger.h>
+
+using namespace drogon::utils::internal;
+
+ZlibStreams::~ZlibStreams()
+{
+    discardDeflater();
+    discardInflater();
+}
+
+z_stream *ZlibStreams::deflater(int level)
+{
+    if (deflateLevel_ == level && deflateReset(&deflateStream_) == Z_OK)
+        return &deflateStream_;
+    discardDeflater();
+    deflateStream_ = z_stream{};
+    if (deflateInit2(&deflateStream_,
+                     level,
+                     Z_DEFLATED,
+                     MAX_WBITS + 16,
+                     8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        LOG_ERROR << "deflateInit2 error!";
+        return nullptr;
+    }
+    deflateLevel_ = level;
+    return &deflateStream_;
+}
+
+z_stream *ZlibStreams::inflater()
+{
+    if (inflateInitialized_ && inflateReset(&inflateStream_) == Z_OK)
+        return &inflateStream_;
+    discardInflater();
+    inflateStream_ = z_stream{};
+    if (inflateInit2(&inflateStream_, (15 + 32)) != Z_OK)
+    {
+        LOG_ERROR << "inflateInit2 error!";
+        return nullptr;
+    }
+    inflateInitialized_ = true;
+    return &inflateStream_;
+}
+
+void ZlibStreams::discardDeflater()
+{
+    if (deflateLevel_ != kNone)
+    {
+        (void)deflateEnd(&deflateStream_);
+        deflateLevel_ = kNone;
+    }
+}
+
+void ZlibStreams::discardInflater()
+{
+    if (inflateInitialized_)
+    {
+        (void)inflateEnd(&inflateStream_);
+        inflateInitialized_ = false;
+    }
+}
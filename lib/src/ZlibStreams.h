@@ -0,0 +1,68 @@
+/**
+ *
+ *  @file ZlibStreams.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/utils/NonCopyable.h>
+#include <zlib.h>
+
+namespace drogon
+{
+namespace utils
+{
+namespace internal
+{
+/**
+ * @brief The gzip streams of the thread, reset for every compression or
+ * decompression instead of being initialized and ended each time, which
+ * allocates the window and the hash tables of the stream (more than 256KB
+ * for the compressor).
+ *
+ * The input and output pointers of a stream must not be used after the call
+ * which gets it returns.
+ */
+class ZlibStreams : public trantor::NonCopyable
+{
+  public:
+    ~ZlibStreams();
+
+    static ZlibStreams &instance()
+    {
+        static thread_local ZlibStreams streams;
+        return streams;
+    }
+
+    /// Return the reset compressor of the level, nullptr on errors.
+    z_stream *deflater(int level);
+    /// Return the reset decompressor of the gzip and zlib formats, nullptr
+    /// on errors.
+    z_stream *inflater();
+
+    /// Called after an error, the stream is initialized again next time.
+    void discardDeflater();
+    void discardInflater();
+
+  private:
+    ZlibStreams() = default;
+
+    // Out of the range of the zlib levels
+    static constexpr int kNone = -100;
+    z_stream deflateStream_{};
+    int deflateLevel_{kNone};
+    z_stream inflateStream_{};
+    bool inflateInitialized_{false};
+};
+}  // namespace internal
+}  // namespace utils
+}  // namespace drogon
@@ -1,8 +1,14 @@
 #include <drogon/drogon_test.h>
+#include <drogon/utils/AllocationCounter.h>
+#include <trantor/net/EventLoopThread.h>
 
+#include <algorithm>
+#include <chrono>
 #include <set>
 #include <future>
 #include <condition_variable>
+#include <stdexcept>
+#include <vector>
 
 namespace drogon
 {
@@ -54,6 +60,321 @@ std::string prettifyString(const std::string_view sv, size_t maxLength)
     return "\"" + escapeString(sv.substr(0, maxLength)) + msg;
 }
 
+namespace
+{
+struct Measurement
+{
+    double nanoseconds{0};
+    uint64_t allocations{0};
+    uint64_t bytes{0};
+};
+
+class Stopwatch
+{
+  public:
+    Stopwatch()
+        : start_(std::chrono::steady_clock::now()),
+          allocations_(AllocationCounter::current())
+    {
+    }
+
+    Measurement elapsed() const
+    {
+        auto allocations = AllocationCounter::current();
+        Measurement measurement;
+        measurement.nanoseconds =
+            std::chrono::duration<double, std::nano>(
+                std::chrono::steady_clock::now() - start_)
+                .count();
+        measurement.allocations =
+            allocations.allocations - allocations_.allocations;
+        measurement.bytes = allocations.bytes - allocations_.bytes;
+        return measurement;
+    }
+
+  private:
+    std::chrono::steady_clock::time_point start_;
+    AllocationCounter::Counts allocations_;
+};
+
+// The loop of the options or a loop started for the benchmark
+class BenchmarkLoop
+{
+  public:
+    explicit BenchmarkLoop(trantor::EventLoop *loop) : loop_(loop)
+    {
+        if (!loop_)
+        {
+            thread_ = std::make_unique<trantor::EventLoopThread>("Benchmark");
+            thread_->run();
+            loop_ = thread_->getLoop();
+        }
+        else if (loop_->isInLoopThread())
+        {
+            throw std::logic_error(
+                "A benchmark can't run in the loop of the calling thread");
+        }
+    }
+
+    trantor::EventLoop *get() const
+    {
+        return loop_;
+    }
+
+  private:
+    trantor::EventLoop *loop_;
+    std::unique_ptr<trantor::EventLoopThread> thread_;
+};
+
+// Runs the iterations of an asynchronous body one after the other in the
+// loop, the iterations done synchronously don't grow the stack.
+class AsyncIterations : public std::enable_shared_from_this<AsyncIterations>
+{
+  public:
+    AsyncIterations(trantor::EventLoop *loop,
+                    const std::function<void(BenchmarkDone)> &body,
+                    size_t iterations)
+        : loop_(loop), body_(body), remaining_(iterations)
+    {
+    }
+
+    Measurement run()
+    {
+        auto future = promise_.get_future();
+        loop_->queueInLoop([thisPtr = shared_from_this()]() {
+            thisPtr->stopwatch_ = Stopwatch();
+            thisPtr->next();
+        });
+        return future.get();
+    }
+
+  private:
+    void next()
+    {
+        while (remaining_ > 0)
+        {
+            --remaining_;
+            auto iteration = ++iteration_;
+            inBody_ = true;
+            doneInBody_ = false;
+            try
+            {
+                body_([thisPtr = shared_from_this(),
+                       iteration](std::exception_ptr exception) {
+                    thisPtr->onDone(iteration, std::move(exception));
+                });
+            }
+            catch (...)
+            {
+                inBody_ = false;
+                finish(std::current_exception());
+                return;
+            }
+            inBody_ = false;
+            if (!doneInBody_)
+                return;
+            if (exception_)
+            {
+                finish(exception_);
+                return;
+            }
+        }
+        finish(nullptr);
+    }
+
+    void onDone(size_t iteration, std::exception_ptr exception)
+    {
+        if (!loop_->isInLoopThread())
+        {
+            loop_->queueInLoop(
+                [thisPtr = shared_from_this(), iteration, exception]() {
+                    thisPtr->onDone(iteration, exception);
+                });
+            return;
+        }
+        // Called more than once
+        if (iteration != iteration_ || finished_)
+            return;
+        if (inBody_)
+        {
+            doneInBody_ = true;
+            exception_ = std::move(exception);
+            return;
+        }
+        if (exception)
+        {
+            finish(std::move(exception));
+            return;
+        }
+        next();
+    }
+
+    void finish(std::exception_ptr exception)
+    {
+        finished_ = true;
+        if (exception)
+            promise_.set_exception(std::move(exception));
+        else
+            promise_.set_value(stopwatch_.elapsed());
+    }
+
+    trantor::EventLoop *loop_;
+    const std::function<void(BenchmarkDone)> &body_;
+    size_t remaining_;
+    size_t iteration_{0};
+    bool inBody_{false};
+    bool doneInBody_{false};
+    bool finished_{false};
+    std::exception_ptr exception_;
+    Stopwatch stopwatch_;
+    std::promise<Measurement> promise_;
+};
+
+BenchmarkResult makeResult(std::string name,
+                           const BenchmarkOptions &options,
+                           std::vector<Measurement> &measurements)
+{
+    BenchmarkResult result;
+    result.name = std::move(name);
+    result.options = options;
+    if (measurements.empty() || options.iterations == 0)
+        return result;
+    std::sort(measurements.begin(),
+              measurements.end(),
+              [](const Measurement &lhs, const Measurement &rhs) {
+                  return lhs.nanoseconds < rhs.nanoseconds;
+              });
+    auto &median = measurements[measurements.size() / 2];
+    auto iterations = (double)options.iterations;
+    result.nsPerOp = median.nanoseconds / iterations;
+    result.allocsPerOp = (double)median.allocations / iterations;
+    result.bytesPerOp = (double)median.bytes / iterations;
+    return result;
+}
+}  // namespace
+
+BenchmarkResult runSyncBenchmark(std::string name,
+                                 const BenchmarkOptions &options,
+                                 const std::function<void()> &body)
+{
+    BenchmarkLoop loop(options.loop);
+    std::vector<Measurement> measurements;
+    std::exception_ptr exception;
+    std::promise<void> done;
+    // All the repetitions run in one task of the loop.
+    loop.get()->queueInLoop([&]() {
+        try
+        {
+            for (size_t i = 0; i < options.warmup; ++i)
+                body();
+            for (size_t r = 0; r < options.repetitions; ++r)
+            {
+                Stopwatch stopwatch;
+                for (size_t i = 0; i < options.iterations; ++i)
+                    body();
+                measurements.push_back(stopwatch.elapsed());
+            }
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        done.set_value();
+    });
+    done.get_future().get();
+    auto result = makeResult(std::move(name), options, measurements);
+    result.exception = std::move(exception);
+    return result;
+}
+
+BenchmarkResult runAsyncBenchmark(
+    std::string name,
+    const BenchmarkOptions &options,
+    const std::function<void(BenchmarkDone)> &body)
+{
+    BenchmarkLoop loop(options.loop);
+    std::vector<Measurement> measurements;
+    std::exception_ptr exception;
+    try
+    {
+        std::make_shared<AsyncIterations>(loop.get(), body, options.warmup)
+            ->run();
+        for (size_t r = 0; r < options.repetitions; ++r)
+        {
+            measurements.push_back(
+                std::make_shared<AsyncIterations>(loop.get(),
+                                                  body,
+                                                  options.iterations)
+                    ->run());
+        }
+    }
+    catch (...)
+    {
+        exception = std::current_exception();
+    }
+    auto result = makeResult(std::move(name), options, measurements);
+    result.exception = std::move(exception);
+    return result;
+}
+
+void reportBenchmark(const std::shared_ptr<Case> &ctx,
+                     const BenchmarkResult &result,
+                     const char *file,
+                     int line)
+{
+    numAssertions++;
+    std::string reason;
+    if (result.exception)
+    {
+        try
+        {
+            std::rethrow_exception(result.exception);
+        }
+        catch (const std::exception &e)
+        {
+            reason = std::string("An exception is thrown. what(): ") +
+                     e.what();
+        }
+        catch (...)
+        {
+            reason = "An unknown exception is thrown.";
+        }
+    }
+    else if (result.options.maxNsPerOp > 0 &&
+             result.nsPerOp > result.options.maxNsPerOp)
+    {
+        reason = "Slower than " + std::to_string(result.options.maxNsPerOp) +
+                 " ns/op";
+    }
+    else if (result.options.maxAllocsPerOp >= 0 &&
+             result.allocsPerOp > result.options.maxAllocsPerOp)
+    {
+        reason = "More allocations than " +
+                 std::to_string(result.options.maxAllocsPerOp) + " /op";
+    }
+    if (!result.exception)
+    {
+        print() << "\x1B[1;37mBenchmark " << ctx->fullname() << "."
+                << result.name << "\x1B[0m: " << result.nsPerOp
+                << " ns/op, " << result.allocsPerOp << " allocs/op, "
+                << result.bytesPerOp << " B/op ("
+                << result.options.repetitions << " x "
+                << result.options.iterations << " iterations)\n";
+    }
+    if (reason.empty())
+    {
+        numCorrectAssertions++;
+        return;
+    }
+    ctx->setFailed();
+    printErr() << "\x1B[1;37mIn test case " << ctx->fullname() << "\n"
+               << "\x1B[0;37m↳ " << file << ":" << line
+               << " \x1B[0;31m FAILED:\x1B[0m\n"
+               << "  \033[0;34mBENCHMARK(" << prettifyString(result.name)
+               << ")\x1B[0m\n"
+               << "  \033[0;33m" << reason << "\x1B[0m\n\n";
+}
+
 }  // namespace internal
 
 static void printHelp(std::string_view argv0)
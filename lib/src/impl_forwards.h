@@ -27,12 +27,17 @@ class HttpResponseImpl;
 using HttpResponseImplPtr = std::shared_ptr<HttpResponseImpl>;
 class WebSocketConnectionImpl;
 using WebSocketConnectionImplPtr = std::shared_ptr<WebSocketConnectionImpl>;
+class Http2ServerConnection;
+using Http2ServerConnectionPtr = std::shared_ptr<Http2ServerConnection>;
+class Http2ClientConnection;
+using Http2ClientConnectionPtr = std::shared_ptr<Http2ClientConnection>;
 class HttpRequestParser;
 class PluginsManager;
 class ListenerManager;
 class SharedLibManager;
 class SessionManager;
 class HttpServer;
+class WorkStealingThreadPool;
 
 namespace orm
 {
@@ -0,0 +1,186 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <drogon/utils/Utilities.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static std::filesystem::path logPath;
+
+// The json lines of the access log with the path, in the order of the log.
+static std::vector<Json::Value> loggedRequests(const std::string &path)
+{
+    std::vector<Json::Value> requests;
+    std::ifstream file(logPath / "access.log");
+    std::unique_ptr<Json::CharReader> reader(
+        Json::CharReaderBuilder().newCharReader());
+    std::string line;
+    while (std::getline(file, line))
+    {
+        // The last line may be being written.
+        Json::Value json;
+        if (!reader->parse(line.data(),
+                           line.data() + line.size(),
+                           &json,
+                           nullptr))
+            continue;
+        if (json["path"].asString() == path)
+            requests.push_back(std::move(json));
+    }
+    return requests;
+}
+
+// The records are written in batches by the thread of the plugin, then by
+// the file logger.
+static std::vector<Json::Value> waitForLogged(const std::string &path,
+                                              size_t count)
+{
+    std::vector<Json::Value> requests;
+    for (int i = 0; i < 100; ++i)
+    {
+        requests = loggedRequests(path);
+        if (requests.size() >= count)
+            break;
+        std::this_thread::sleep_for(50ms);
+    }
+    return requests;
+}
+
+static HttpClientPtr newClient()
+{
+    return HttpClient::newHttpClient("http://127.0.0.1:8029");
+}
+
+static ReqResult get(const HttpClientPtr &client, const std::string &path)
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath(path);
+    req->addHeader("user-agent", "a \"quoted\"\tagent");
+    return client->sendRequest(req, 5).first;
+}
+
+DROGON_TEST(AccessLoggerAsyncJsonLines)
+{
+    auto client = newClient();
+    auto before = loggedRequests("/logged").size();
+    for (int i = 0; i < 50; ++i)
+    {
+        CHECK(get(client, "/logged?n=" + std::to_string(i)) == ReqResult::Ok);
+    }
+    auto requests = waitForLogged("/logged", before + 50);
+    REQUIRE(requests.size() == before + 50);
+    for (int i = 0; i < 50; ++i)
+    {
+        auto &json = requests[before + i];
+        CHECK(json["method"].asString() == "GET");
+        CHECK(json["query"].asString() == "n=" + std::to_string(i));
+        // The numbers are not quoted, the strings are escaped.
+        CHECK(json["status_code"].isIntegral());
+        CHECK(json["status_code"].asInt() == 200);
+        CHECK(json["http_user-agent"].asString() == "a \"quoted\"\tagent");
+    }
+}
+
+DROGON_TEST(AccessLoggerSampling)
+{
+    auto client = newClient();
+    for (int i = 0; i < 20; ++i)
+    {
+        CHECK(get(client, "/sampled") == ReqResult::Ok);
+    }
+    // Always logged, whatever the ratio of their route is
+    CHECK(get(client, "/failing") == ReqResult::Ok);
+    CHECK(get(client, "/slow") == ReqResult::Ok);
+    // Not routed, its ratio is the one of its path.
+    CHECK(get(client, "/unrouted") == ReqResult::Ok);
+    // The records are written in order, the ones before it are there once
+    // it is.
+    CHECK(get(client, "/logged?n=last") == ReqResult::Ok);
+    auto last = waitForLogged("/logged", 1);
+    REQUIRE(!last.empty());
+    REQUIRE(last.back()["query"].asString() == "n=last");
+
+    CHECK(loggedRequests("/sampled").empty());
+    auto failing = loggedRequests("/failing");
+    REQUIRE(failing.size() == 1);
+    CHECK(failing[0]["status_code"].asInt() == 500);
+    CHECK(loggedRequests("/slow").size() == 1);
+    auto unrouted = loggedRequests("/unrouted");
+    REQUIRE(unrouted.size() == 1);
+    CHECK(unrouted[0]["status_code"].asInt() == 404);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    logPath = std::filesystem::temp_directory_path() /
+              ("drogon_access_logger_test_" + utils::getUuid());
+    std::filesystem::create_directories(logPath);
+
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        Json::Value config;
+        config["log_path"] = logPath.string() + "/";
+        // Not mixed with the log of the application
+        config["log_index"] = 1;
+        config["log_format"] =
+            "$method $path $query $status_code $http_user-agent";
+        config["json_lines"] = true;
+        config["async"] = true;
+        config["async_flush_interval"] = 0.05;
+        // Only the errors, the slow requests and the routes with a ratio
+        config["sample_ratio"] = 0.0;
+        config["route_sample_ratios"]["/logged"] = 1.0;
+        config["route_sample_ratios"]["/unrouted"] = 1.0;
+        config["always_log_slower_than"] = 0.2;
+        app()
+            .registerHandler("/logged",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 callback(HttpResponse::newHttpResponse());
+                             })
+            .registerHandler("/sampled",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 callback(HttpResponse::newHttpResponse());
+                             })
+            .registerHandler("/failing",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 callback(HttpResponse::newHttpResponse(
+                                     k500InternalServerError, CT_TEXT_PLAIN));
+                             })
+            .registerHandler(
+                "/slow",
+                [](const HttpRequestPtr &, Callback &&callback) {
+                    app().getLoop()->runAfter(
+                        0.3, [callback = std::move(callback)]() {
+                            callback(HttpResponse::newHttpResponse());
+                        });
+                })
+            .addListener("127.0.0.1", 8029);
+        app().addPlugin("drogon::plugin::AccessLogger", {}, config);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    std::filesystem::remove_all(logPath);
+    return testStatus;
+}
@@ -0,0 +1,75 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RawExchange.h"
+
+using namespace drogon;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static const std::string head =
+    "POST /echo HTTP/1.1\r\nhost: 127.0.0.1\r\ntransfer-encoding: "
+    "chunked\r\nconnection: close\r\n\r\n";
+
+static bool endsWith(const std::string &data, const std::string &suffix)
+{
+    return data.size() >= suffix.size() &&
+           data.compare(data.size() - suffix.size(), suffix.size(), suffix) ==
+               0;
+}
+
+DROGON_TEST(ChunkedRequestPieces)
+{
+    // Split in the chunk sizes, in the data and between the CR and the LF
+    // after the chunks
+    std::vector<std::string> pieces{head,
+                                    "27",
+                                    "10\r\n",
+                                    std::string(5000, 'a'),
+                                    std::string(5000, 'a') + "\r",
+                                    "\n3\r\nb",
+                                    "bb\r",
+                                    "\n0\r\n",
+                                    "\r\n"};
+    auto data = rawExchange(8038, pieces, 0.02);
+    CHECK(data.find("HTTP/1.1 200 OK\r\n") == 0);
+    CHECK(endsWith(data, "\r\n\r\n" + std::string(10000, 'a') + "bbb"));
+
+    // A chunk not followed by a CRLF, received after the chunk
+    data = rawExchange(8038, {head, "3\r\nabc", "xy", "0\r\n\r\n"}, 0.02);
+    CHECK(data.find("HTTP/1.1 400 Bad Request\r\n") == 0);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler(
+                "/echo",
+                [](const HttpRequestPtr &req, Callback &&callback) {
+                    auto resp = HttpResponse::newHttpResponse();
+                    resp->setBody(std::string(req->body()));
+                    callback(resp);
+                },
+                {Post})
+            .addListener("127.0.0.1", 8038);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
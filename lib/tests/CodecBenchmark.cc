@@ -0,0 +1,67 @@
+#include <drogon/utils/Utilities.h>
+#include "../src/SimdCodecs.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+
+using namespace drogon;
+
+// Compares the SIMD kernels of the base64 and hex codecs with the scalar
+// codecs, on a payload the size of a large JWT or of a small upload.
+template <typename Codec>
+static double run(Codec codec, size_t bytes, size_t iterations)
+{
+    size_t result = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+        result += codec();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    // Printed so the loop can't be optimized away.
+    if (result == 0)
+        std::cout << "empty result\n";
+    return (double)(bytes * iterations) / elapsed.count() / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 10000;
+    size_t size = argc > 2 ? std::stoul(argv[2]) : 64 * 1024;
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i)
+        data[i] = char(i * 131 + (i >> 8));
+    auto base64 = utils::base64Encode(data);
+    auto hex = utils::binaryStringToHex(
+        reinterpret_cast<const unsigned char *>(data.data()), data.size());
+
+    std::cout << "codec\tscalar (MB/s)\tsimd (MB/s)\n";
+    const std::pair<const char *, std::function<size_t()>> codecs[] = {
+        {"base64Encode", [&]() { return utils::base64Encode(data).size(); }},
+        {"base64Decode", [&]() { return utils::base64Decode(base64).size(); }},
+        {"binaryStringToHex",
+         [&]() {
+             return utils::binaryStringToHex(
+                        reinterpret_cast<const unsigned char *>(data.data()),
+                        data.size())
+                 .size();
+         }},
+        {"hexToBinaryString",
+         [&]() {
+             return utils::hexToBinaryString(hex.data(), hex.size()).size();
+         }}};
+    for (auto &codec : codecs)
+    {
+        double speeds[2];
+        for (bool simd : {false, true})
+        {
+            utils::internal::setSimdCodecsEnabled(simd);
+            speeds[simd] = run(codec.second, size, iterations);
+        }
+        std::cout << codec.first << "\t" << speeds[0] << "\t" << speeds[1]
+                  << "\n";
+    }
+    if (!utils::internal::simdCodecsEnabled())
+        std::cout << "The CPU doesn't support the SIMD codecs\n";
+    return 0;
+}
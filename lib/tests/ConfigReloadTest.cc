@@ -0,0 +1,157 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <drogon/utils/Utilities.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static std::filesystem::path root;
+// Set by the reload callback in the main loop.
+static std::mutex greetingMutex;
+static std::string greeting;
+
+static Json::Value makeConfig(const std::string &greeting,
+                              int staticFilesCacheTime,
+                              const std::string &logLevel)
+{
+    Json::Value config;
+    config["listeners"][0]["address"] = "127.0.0.1";
+    config["listeners"][0]["port"] = 8034;
+    config["app"]["document_root"] = root.string();
+    config["app"]["static_files_cache_time"] = staticFilesCacheTime;
+    config["app"]["config_reload_interval"] = 0.1;
+    config["app"]["log"]["log_level"] = logLevel;
+    config["custom_config"]["greeting"] = greeting;
+    return config;
+}
+
+static void writeFile(const std::string &name, const std::string &content)
+{
+    std::ofstream file(root / name, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+// Replace the configuration file, with a modification time which always
+// changes.
+static void writeConfig(const std::string &content)
+{
+    static int version = 0;
+    auto path = root / "config.json";
+    writeFile("config.json.tmp", content);
+    std::filesystem::rename(root / "config.json.tmp", path);
+    std::filesystem::last_write_time(
+        path,
+        std::filesystem::file_time_type::clock::now() +
+            std::chrono::seconds(++version));
+}
+
+static void writeConfig(const Json::Value &config)
+{
+    writeConfig(config.toStyledString());
+}
+
+static std::string get(const std::string &path)
+{
+    auto client = HttpClient::newHttpClient("http://127.0.0.1:8034");
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath(path);
+    auto [result, resp] = client->sendRequest(req, 2);
+    if (result != ReqResult::Ok || resp->statusCode() != k200OK)
+        return {};
+    return std::string(resp->body());
+}
+
+static bool waitFor(const std::function<bool()> &condition)
+{
+    for (int i = 0; i < 200; ++i)
+    {
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(10ms);
+    }
+    return condition();
+}
+
+DROGON_TEST(ConfigReload)
+{
+    CHECK(get("/greeting") == "hello");
+    writeFile("cached.txt", "v1");
+    CHECK(get("/cached.txt") == "v1");
+    writeFile("cached.txt", "v2");
+    CHECK(get("/cached.txt") == "v1");
+
+    // The changed file is reloaded by the timer.
+    writeConfig(makeConfig("bye", -1, "WARN"));
+    REQUIRE(waitFor([]() { return get("/greeting") == "bye"; }));
+    CHECK(trantor::Logger::logLevel() == trantor::Logger::kWarn);
+    // The startup configuration is kept.
+    CHECK(app().getCustomConfig()["greeting"].asString() == "hello");
+    // The new responses aren't cached any more.
+    writeFile("uncached.txt", "v1");
+    CHECK(get("/uncached.txt") == "v1");
+    writeFile("uncached.txt", "v2");
+    CHECK(get("/uncached.txt") == "v2");
+
+    // A broken file is ignored, the current options are kept.
+    writeConfig("{\"app\": ");
+    std::this_thread::sleep_for(300ms);
+    CHECK(get("/greeting") == "bye");
+    CHECK(trantor::Logger::logLevel() == trantor::Logger::kWarn);
+
+    // Until it is fixed
+    writeConfig(makeConfig("again", -1, "INFO"));
+    CHECK(waitFor([]() { return get("/greeting") == "again"; }));
+    CHECK(trantor::Logger::logLevel() == trantor::Logger::kInfo);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    root = std::filesystem::temp_directory_path() /
+           ("drogon_config_reload_test_" + utils::getUuid());
+    std::filesystem::create_directories(root);
+    writeConfig(makeConfig("hello", 10, "INFO"));
+
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .loadConfigFile((root / "config.json").string())
+            .registerHandler("/greeting",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 std::lock_guard<std::mutex> lock(
+                                     greetingMutex);
+                                 auto resp = HttpResponse::newHttpResponse();
+                                 resp->setBody(greeting);
+                                 callback(resp);
+                             })
+            .registerConfigReloadCallback([](const Json::Value &config) {
+                std::lock_guard<std::mutex> lock(greetingMutex);
+                greeting = config["custom_config"]["greeting"].asString();
+            });
+        greeting = app().getCustomConfig()["greeting"].asString();
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    std::filesystem::remove_all(root);
+    return testStatus;
+}
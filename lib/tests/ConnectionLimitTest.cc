@@ -0,0 +1,93 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+// The clients keep their connections open after the request.
+static ReqResult ping(const HttpClientPtr &client)
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/ping");
+    return client->sendRequest(req, 2).first;
+}
+
+static HttpClientPtr newClient()
+{
+    return HttpClient::newHttpClient("http://127.0.0.1:8033");
+}
+
+DROGON_TEST(ConnectionLimitPerIP)
+{
+    auto first = newClient();
+    auto second = newClient();
+    CHECK(ping(first) == ReqResult::Ok);
+    CHECK(ping(second) == ReqResult::Ok);
+    // Over the limit of the IP
+    CHECK(ping(newClient()) != ReqResult::Ok);
+    // Still served on their connections
+    CHECK(ping(first) == ReqResult::Ok);
+
+    // A closed connection is no longer counted, once it is released in its
+    // shard.
+    first.reset();
+    bool accepted = false;
+    for (int i = 0; i < 50 && !accepted; ++i)
+    {
+        auto client = newClient();
+        accepted = ping(client) == ReqResult::Ok;
+        if (!accepted)
+            std::this_thread::sleep_for(20ms);
+        else
+            first = client;
+    }
+    CHECK(accepted);
+    CHECK(ping(newClient()) != ReqResult::Ok);
+
+    // All released, the count of the IP starts again from zero.
+    first.reset();
+    second.reset();
+    std::this_thread::sleep_for(200ms);
+    auto third = newClient();
+    auto fourth = newClient();
+    CHECK(ping(third) == ReqResult::Ok);
+    CHECK(ping(fourth) == ReqResult::Ok);
+    CHECK(ping(newClient()) != ReqResult::Ok);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler("/ping",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 callback(HttpResponse::newHttpResponse());
+                             })
+            .setMaxConnectionNumPerIP(2)
+            // The connections are accepted and closed in different loops.
+            .setThreadNum(4)
+            .addListener("127.0.0.1", 8033);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
@@ -0,0 +1,123 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <future>
+#include <string>
+#include <thread>
+#include "RawExchange.h"
+
+using namespace drogon;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static HttpResponsePtr textResponse(const std::string &text)
+{
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setBody(text);
+    return resp;
+}
+
+static std::string request(const std::string &method,
+                           const std::string &path,
+                           bool close = false)
+{
+    return method + " " + path + " HTTP/1.1\r\nhost: 127.0.0.1\r\n" +
+           (close ? "connection: close\r\n" : "") + "\r\n";
+}
+
+static size_t count(const std::string &data, const std::string &part)
+{
+    size_t n = 0;
+    for (auto pos = data.find(part); pos != std::string::npos;
+         pos = data.find(part, pos + part.size()))
+        ++n;
+    return n;
+}
+
+DROGON_TEST(DispatchState)
+{
+    // Pipelined on one connection, the requests of the second batch reuse
+    // the pooled requests of the first one.
+    std::string batch = request("HEAD", "/text") + request("GET", "/async") +
+                        request("GET", "/twice");
+    auto data = rawExchange(8043,
+                            {batch, batch + request("GET", "/text", true)},
+                            0.3);
+    REQUIRE(count(data, "HTTP/1.1 200 OK\r\n") == 7);
+
+    size_t pos = 0;
+    for (int i = 0; i < 2; ++i)
+    {
+        // No body is sent for the HEAD request.
+        auto headEnd = data.find("\r\n\r\n", pos);
+        REQUIRE(headEnd != std::string::npos);
+        CHECK(data.find("HTTP/1.1 200", headEnd) == headEnd + 4);
+
+        // The responses keep the order of the requests, the second response
+        // of a request is ignored.
+        auto async = data.find("\r\n\r\nasync", headEnd);
+        REQUIRE(async != std::string::npos);
+        auto first = data.find("\r\n\r\nfirst", async);
+        REQUIRE(first != std::string::npos);
+        pos = first + 4;
+    }
+    CHECK(data.find("\r\n\r\ntext", pos) != std::string::npos);
+    CHECK(data.find("second") == std::string::npos);
+
+    // Every request answered is no longer in flight, but the one for the
+    // metrics.
+    auto client = HttpClient::newHttpClient("http://127.0.0.1:8043");
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/metrics");
+    auto [result, resp] = client->sendRequest(req, 5);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(std::string(resp->body())
+              .find("\ndrogon_http_requests_in_flight 1.000000") !=
+          std::string::npos);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        Json::Value config;
+        config["builtin_metrics"]["http"] = true;
+        app()
+            .registerHandler("/text",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 callback(textResponse("text"));
+                             })
+            .registerHandler("/async",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 // Answered from another thread later
+                                 std::thread([callback =
+                                                  std::move(callback)]() {
+                                     std::this_thread::sleep_for(
+                                         std::chrono::milliseconds(100));
+                                     callback(textResponse("async"));
+                                 }).detach();
+                             })
+            .registerHandler("/twice",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 callback(textResponse("first"));
+                                 callback(textResponse("second"));
+                             })
+            .setThreadNum(1)
+            .addListener("127.0.0.1", 8043);
+        app().addPlugin("drogon::plugin::PromExporter", {}, config);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
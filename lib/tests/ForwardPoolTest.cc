@@ -0,0 +1,120 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <chrono>
+#include <future>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static HttpClientPtr newClient()
+{
+    return HttpClient::newHttpClient("http://127.0.0.1:8035");
+}
+
+static HttpRequestPtr proxyRequest()
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/proxy");
+    return req;
+}
+
+// The port of the connection the request was forwarded over, empty on
+// failure.
+static std::string forwardedPort(const HttpClientPtr &client)
+{
+    auto [result, resp] = client->sendRequest(proxyRequest(), 5);
+    if (result != ReqResult::Ok || resp->statusCode() != k200OK)
+        return {};
+    return std::string(resp->body());
+}
+
+DROGON_TEST(ForwardPoolReuse)
+{
+    // The requests one after another reuse the same connection.
+    auto client = newClient();
+    std::set<std::string> ports;
+    for (int i = 0; i < 5; ++i)
+    {
+        auto port = forwardedPort(client);
+        CHECK(!port.empty());
+        ports.insert(port);
+    }
+    CHECK(ports.size() == 1);
+
+    // The concurrent requests are spread over at most two connections.
+    std::vector<HttpClientPtr> clients;
+    std::vector<std::future<std::string>> futures;
+    for (int i = 0; i < 10; ++i)
+    {
+        clients.push_back(newClient());
+        futures.push_back(std::async(std::launch::async,
+                                     forwardedPort,
+                                     clients.back()));
+    }
+    for (auto &future : futures)
+    {
+        auto port = future.get();
+        CHECK(!port.empty());
+        ports.insert(port);
+    }
+    CHECK(ports.size() <= 2);
+
+    // The idle connections are closed, a new one is opened.
+    std::this_thread::sleep_for(2500ms);
+    auto port = forwardedPort(client);
+    CHECK(!port.empty());
+    CHECK(ports.find(port) == ports.end());
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler("/proxy",
+                             [](const HttpRequestPtr &req,
+                                Callback &&callback) {
+                                 req->setPath("/peer");
+                                 app().forward(req,
+                                               std::move(callback),
+                                               "http://127.0.0.1:8036");
+                             })
+            .registerHandler(
+                "/peer",
+                [](const HttpRequestPtr &req, Callback &&callback) {
+                    auto port = std::to_string(req->getPeerAddr().toPort());
+                    // Long enough for the concurrent requests to overlap
+                    trantor::EventLoop::getEventLoopOfCurrentThread()->runAfter(
+                        0.1, [callback = std::move(callback), port]() {
+                            auto resp = HttpResponse::newHttpResponse();
+                            resp->setBody(port);
+                            callback(resp);
+                        });
+                })
+            .setForwardPoolOptions(2, 0.5)
+            .setThreadNum(1)
+            .addListener("127.0.0.1", 8035)
+            .addListener("127.0.0.1", 8036);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
@@ -0,0 +1,136 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <trantor/net/EventLoopThread.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static std::atomic<bool> warm{false};
+
+static HttpResponsePtr textResponse(const std::string &text)
+{
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setBody(text);
+    return resp;
+}
+
+// Wait until the condition is true, the state changes in the main loop.
+static bool waitFor(const std::function<bool()> &condition)
+{
+    for (int i = 0; i < 300; ++i)
+    {
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(10ms);
+    }
+    return condition();
+}
+
+DROGON_TEST(GracefulShutdown)
+{
+    // The clients don't run in the main loop, which quits in the test.
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto newClient = [&loopThread]() {
+        return HttpClient::newHttpClient("http://127.0.0.1:8031",
+                                         loopThread.getLoop());
+    };
+    auto newRequest = [](const std::string &path) {
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath(path);
+        return req;
+    };
+
+    // Nothing is accepted before the warmup task is done.
+    auto client = newClient();
+    std::pair<ReqResult, HttpResponsePtr> result{ReqResult::BadServerAddress,
+                                                 nullptr};
+    for (int i = 0; i < 50 && result.first != ReqResult::Ok; ++i)
+    {
+        result = client->sendRequest(newRequest("/state"), 2);
+        if (result.first != ReqResult::Ok)
+            std::this_thread::sleep_for(50ms);
+    }
+    REQUIRE(result.first == ReqResult::Ok);
+    CHECK(result.second->body() == "warm");
+
+    // A request in flight when quitting is answered, and its connection
+    // is closed after it.
+    std::promise<std::pair<ReqResult, HttpResponsePtr>> slow;
+    client->sendRequest(newRequest("/slow"),
+                        [&slow](ReqResult result, const HttpResponsePtr &resp) {
+                            slow.set_value({result, resp});
+                        });
+    std::this_thread::sleep_for(100ms);
+    app().quit();
+    REQUIRE(waitFor([]() { return app().isDraining(); }));
+
+    // The new connections are still served, once.
+    auto [pingResult, ping] = newClient()->sendRequest(newRequest("/state"), 2);
+    REQUIRE(pingResult == ReqResult::Ok);
+    CHECK(ping->body() == "draining");
+    CHECK(ping->getHeader("connection") == "close");
+
+    auto [slowResult, slowResp] = slow.get_future().get();
+    REQUIRE(slowResult == ReqResult::Ok);
+    CHECK(slowResp->body() == "slow");
+    CHECK(slowResp->getHeader("connection") == "close");
+
+    // It quits once the connections are closed, before the timeout.
+    CHECK(waitFor([]() { return !app().getLoop()->isRunning(); }));
+    CHECK(!app().isDraining());
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler("/state",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 if (app().isDraining())
+                                     callback(textResponse("draining"));
+                                 else
+                                     callback(textResponse(
+                                         warm ? "warm" : "cold"));
+                             })
+            .registerHandler(
+                "/slow",
+                [](const HttpRequestPtr &, Callback &&callback) {
+                    trantor::EventLoop::getEventLoopOfCurrentThread()->runAfter(
+                        0.5, [callback = std::move(callback)]() {
+                            callback(textResponse("slow"));
+                        });
+                })
+            .registerWarmupTask([](std::function<void()> &&done) {
+                app().getLoop()->runAfter(0.3, [done = std::move(done)]() {
+                    warm = true;
+                    done();
+                });
+            })
+            .setGracefulShutdownTimeout(5)
+            .addListener("127.0.0.1", 8031);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    int testStatus = test::run(argc, argv);
+    // The app is already stopped when the test quit it.
+    app().quit();
+    thr.join();
+    return testStatus;
+}
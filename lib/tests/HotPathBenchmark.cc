@@ -0,0 +1,589 @@
+/**
+ *
+ *  @file HotPathBenchmark.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "../../lib/src/HttpControllersRouter.h"
+#include "../../lib/src/HttpRequestImpl.h"
+#include "../../lib/src/HttpRequestParser.h"
+#include "../../lib/src/HttpResponseImpl.h"
+#include "../../lib/src/WebSocketConnectionImpl.h"
+#include "../../lib/src/WebSocketMask.h"
+#include "../../orm_lib/src/ResultImpl.h"
+#include <drogon/CacheMap.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/orm/Field.h>
+#include <drogon/orm/Result.h>
+#include <drogon/orm/Row.h>
+#include <drogon/utils/Utilities.h>
+#include <drogon/version.h>
+#include <json/json.h>
+#include <trantor/net/EventLoopThread.h>
+#include <trantor/net/TcpClient.h>
+#include <trantor/net/TcpServer.h>
+#include <trantor/utils/MsgBuffer.h>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Measures the hot paths of the framework: the request parser, the rendering
+// of the responses, the routing, the cache map, the codecs, the compressions,
+// the WebSocket frames and the conversions of the ORM fields.
+//
+// Usage: hot_path_benchmark [--json] [--filter=<substring>] [--min_time=<s>]
+//
+// With --json, the results are printed in the JSON format of Google Benchmark,
+// so that two runs can be compared with its tools/compare.py script.
+
+using namespace drogon;
+
+namespace
+{
+struct BenchmarkResult
+{
+    std::string name;
+    size_t iterations;
+    double realTime;  // in nanoseconds per iteration
+    double cpuTime;   // in nanoseconds per iteration
+};
+
+class BenchmarkRunner
+{
+  public:
+    BenchmarkRunner(std::string filter, double minTime)
+        : filter_(std::move(filter)), minTime_(minTime)
+    {
+    }
+
+    /// Run the body in batches growing until a batch lasts the minimum time,
+    /// the last batch is reported.
+    void run(const std::string &name, const std::function<size_t()> &body)
+    {
+        if (!filter_.empty() && name.find(filter_) == std::string::npos)
+            return;
+        size_t iterations = 1;
+        while (true)
+        {
+            size_t sink = 0;
+            auto cpuStart = std::clock();
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; ++i)
+                sink += body();
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            double cpuElapsed =
+                double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+            // Printed so the loop can't be optimized away.
+            if (sink == 0)
+                std::cerr << name << ": empty result\n";
+            if (elapsed.count() >= minTime_ || iterations >= (1ULL << 32))
+            {
+                results_.push_back({name,
+                                    iterations,
+                                    elapsed.count() * 1e9 / iterations,
+                                    cpuElapsed * 1e9 / iterations});
+                return;
+            }
+            // Aim over the minimum time so the batch sizes don't creep up.
+            double scale = elapsed.count() > 0.0
+                               ? minTime_ * 1.4 / elapsed.count()
+                               : 10.0;
+            if (scale > 10.0)
+                scale = 10.0;
+            if (scale < 2.0)
+                scale = 2.0;
+            iterations = size_t(iterations * scale);
+        }
+    }
+
+    /// Same as run(), in the thread of the loop.
+    void runInLoop(trantor::EventLoop *loop,
+                   const std::string &name,
+                   const std::function<size_t()> &body)
+    {
+        std::promise<void> done;
+        loop->runInLoop([&]() {
+            run(name, body);
+            done.set_value();
+        });
+        done.get_future().get();
+    }
+
+    void printText() const
+    {
+        std::cout << "benchmark\titerations\tns/op\n";
+        for (auto &result : results_)
+        {
+            std::cout << result.name << "\t" << result.iterations << "\t"
+                      << result.realTime << "\n";
+        }
+    }
+
+    void printJson() const
+    {
+        Json::Value root;
+        auto &context = root["context"];
+        context["date"] = trantor::Date::now().toFormattedStringLocal(false);
+        context["executable"] = "hot_path_benchmark";
+        context["library_version"] = DROGON_VERSION;
+        context["num_cpus"] = std::thread::hardware_concurrency();
+#ifdef NDEBUG
+        context["library_build_type"] = "release";
+#else
+        context["library_build_type"] = "debug";
+#endif
+        auto &benchmarks = root["benchmarks"];
+        benchmarks = Json::arrayValue;
+        for (auto &result : results_)
+        {
+            Json::Value item;
+            item["name"] = result.name;
+            item["run_name"] = result.name;
+            item["run_type"] = "iteration";
+            item["iterations"] = Json::UInt64(result.iterations);
+            item["real_time"] = result.realTime;
+            item["cpu_time"] = result.cpuTime;
+            item["time_unit"] = "ns";
+            benchmarks.append(item);
+        }
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "  ";
+        std::cout << Json::writeString(builder, root) << "\n";
+    }
+
+  private:
+    std::string filter_;
+    double minTime_;
+    std::vector<BenchmarkResult> results_;
+};
+
+// The result of a query with one row, the ORM fields are read from memory.
+class BenchmarkResultImpl : public orm::ResultImpl
+{
+  public:
+    SizeType size() const noexcept override
+    {
+        return 1;
+    }
+
+    RowSizeType columns() const noexcept override
+    {
+        return RowSizeType(values_.size());
+    }
+
+    const char *columnName(RowSizeType number) const override
+    {
+        return kNames[number];
+    }
+
+    SizeType affectedRows() const noexcept override
+    {
+        return 0;
+    }
+
+    RowSizeType columnNumber(const char colName[]) const override
+    {
+        for (RowSizeType i = 0; i < columns(); ++i)
+        {
+            if (std::string_view(kNames[i]) == colName)
+                return i;
+        }
+        throw std::out_of_range("no column");
+    }
+
+    const char *getValue(SizeType, RowSizeType column) const override
+    {
+        return values_[column].data();
+    }
+
+    bool isNull(SizeType, RowSizeType) const override
+    {
+        return false;
+    }
+
+    FieldSizeType getLength(SizeType, RowSizeType column) const override
+    {
+        return FieldSizeType(values_[column].length());
+    }
+
+  private:
+    static constexpr const char *kNames[] = {"id", "score", "name"};
+    const std::vector<std::string> values_{"1234567890",
+                                           "3.14159265",
+                                           "drogon benchmark"};
+};
+
+const std::string kGetRequest =
+    "GET /api/v1/users/42/items7?page=3&sort=name HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "Cookie: JSESSIONID=a1b2c3d4e5f6; theme=dark\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+std::string postRequest(const std::string &body)
+{
+    return "POST /api/v1/resource7 HTTP/1.1\r\n"
+           "Host: localhost:8080\r\n"
+           "Content-Type: application/json\r\n"
+           "Content-Length: " +
+           std::to_string(body.length()) +
+           "\r\n"
+           "Connection: keep-alive\r\n"
+           "\r\n" +
+           body;
+}
+
+std::string makeText(size_t length)
+{
+    std::string text;
+    size_t i = 0;
+    while (text.length() < length)
+    {
+        text += "{\"id\":" + std::to_string(i) +
+                ",\"name\":\"item\",\"tags\":[\"a\",\"b\"]},";
+        ++i;
+    }
+    text.resize(length);
+    return text;
+}
+
+// A server side connection over the loopback interface, the request parser
+// can't be created without one.
+trantor::TcpConnectionPtr connect(trantor::EventLoop *loop,
+                                  std::unique_ptr<trantor::TcpServer> &server,
+                                  std::shared_ptr<trantor::TcpClient> &client)
+{
+    std::promise<trantor::TcpConnectionPtr> connected;
+    loop->runInLoop([&]() {
+        server = std::make_unique<trantor::TcpServer>(
+            loop, trantor::InetAddress("127.0.0.1", 0), "benchmark");
+        server->setRecvMessageCallback(
+            [](const trantor::TcpConnectionPtr &, trantor::MsgBuffer *buf) {
+                buf->retrieveAll();
+            });
+        server->setConnectionCallback(
+            [&connected](const trantor::TcpConnectionPtr &conn) {
+                if (conn->connected())
+                    connected.set_value(conn);
+            });
+        server->start();
+        client = std::make_shared<trantor::TcpClient>(loop,
+                                                      server->address(),
+                                                      "benchmark");
+        client->setMessageCallback(
+            [](const trantor::TcpConnectionPtr &, trantor::MsgBuffer *buf) {
+                buf->retrieveAll();
+            });
+        client->connect();
+    });
+    return connected.get_future().get();
+}
+
+void benchmarkParser(BenchmarkRunner &runner,
+                     trantor::EventLoop *loop,
+                     const trantor::TcpConnectionPtr &conn)
+{
+    std::shared_ptr<HttpRequestParser> parser;
+    std::promise<void> created;
+    loop->runInLoop([&]() {
+        parser = std::make_shared<HttpRequestParser>(conn);
+        parser->reset();
+        created.set_value();
+    });
+    created.get_future().get();
+    auto parse = [&parser](const std::string &request) {
+        return [&parser, request]() -> size_t {
+            trantor::MsgBuffer buffer;
+            buffer.append(request);
+            int result = parser->parseRequest(&buffer);
+            size_t length = parser->requestImpl()->path().length();
+            parser->reset();
+            return size_t(result) + length;
+        };
+    };
+    runner.runInLoop(loop,
+                     "HttpRequestParser/parseRequest/get",
+                     parse(kGetRequest));
+    runner.runInLoop(loop,
+                     "HttpRequestParser/parseRequest/post_1k",
+                     parse(postRequest(makeText(1024))));
+    std::promise<void> destroyed;
+    loop->runInLoop([&]() {
+        parser.reset();
+        destroyed.set_value();
+    });
+    destroyed.get_future().get();
+}
+
+void benchmarkResponse(BenchmarkRunner &runner)
+{
+    auto small = std::static_pointer_cast<HttpResponseImpl>(
+        HttpResponse::newHttpResponse());
+    small->setBody("Hello, World!");
+    small->setContentTypeCode(CT_TEXT_PLAIN);
+    small->addHeader("x-request-id", "3f2b9c1e");
+    runner.run("HttpResponseImpl/renderToBuffer/small", [&small]() {
+        trantor::MsgBuffer buffer;
+        small->renderToBuffer(buffer);
+        return buffer.readableBytes();
+    });
+
+    Json::Value json;
+    json["message"] = "Hello, World!";
+    json["items"] = Json::arrayValue;
+    for (int i = 0; i < 16; ++i)
+        json["items"].append(i);
+    runner.run("HttpResponseImpl/renderToBuffer/json", [&json]() {
+        auto resp = std::static_pointer_cast<HttpResponseImpl>(
+            HttpResponse::newHttpJsonResponse(json));
+        trantor::MsgBuffer buffer;
+        resp->renderToBuffer(buffer);
+        return buffer.readableBytes();
+    });
+}
+
+void benchmarkRouter(BenchmarkRunner &runner, trantor::EventLoop *loop)
+{
+    auto handler = [](const HttpRequestPtr &,
+                      std::function<void(const HttpResponsePtr &)> &&) {};
+    auto paramHandler = [](const HttpRequestPtr &,
+                           std::function<void(const HttpResponsePtr &)> &&,
+                           const std::string &) {};
+    for (int i = 0; i < 100; ++i)
+    {
+        app().registerHandler("/api/v1/resource" + std::to_string(i),
+                              handler,
+                              {Get, Post});
+    }
+    for (int i = 0; i < 20; ++i)
+    {
+        app().registerHandler("/api/v1/users/{id}/items" + std::to_string(i),
+                              paramHandler,
+                              {Get});
+    }
+    app().registerHandlerViaRegex("/api/v2/files/([0-9]+)\\.json",
+                                  paramHandler,
+                                  {Get});
+    auto &router = HttpControllersRouter::instance();
+    router.init({loop});
+
+    auto route = [&router, loop](const std::string &path) {
+        auto req = std::make_shared<HttpRequestImpl>(loop);
+        req->setMethod(Get);
+        req->setPath(path);
+        return [&router, req]() -> size_t {
+            auto result = router.route(req);
+            return size_t(result.result) + (result.binderPtr ? 1 : 2);
+        };
+    };
+    runner.run("HttpControllersRouter/route/exact",
+               route("/api/v1/resource57"));
+    runner.run("HttpControllersRouter/route/placeholder",
+               route("/api/v1/users/42/items7"));
+    runner.run("HttpControllersRouter/route/regex",
+               route("/api/v2/files/1234.json"));
+    runner.run("HttpControllersRouter/route/not_found",
+               route("/api/v3/nothing/here"));
+}
+
+void benchmarkCacheMap(BenchmarkRunner &runner, trantor::EventLoop *loop)
+{
+    CacheMap<std::string, std::string> cache(loop, 1.0f, 4, 60);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1024; ++i)
+        keys.push_back("session:" + std::to_string(i));
+    size_t next = 0;
+    runner.run("CacheMap/insert", [&]() -> size_t {
+        cache.insert(keys[next++ % keys.size()], "value", 60);
+        return 1;
+    });
+    runner.run("CacheMap/find", [&]() -> size_t {
+        return cache.find(keys[next++ % keys.size()]) ? 1 : 2;
+    });
+}
+
+void benchmarkCodecs(BenchmarkRunner &runner)
+{
+    auto data = makeText(1024);
+    auto base64 = utils::base64Encode(data);
+    auto url = utils::urlEncodeComponent(data);
+    auto hex = utils::binaryStringToHex(
+        reinterpret_cast<const unsigned char *>(data.data()), data.size());
+    runner.run("utils/base64Encode/1k",
+               [&]() { return utils::base64Encode(data).size(); });
+    runner.run("utils/base64Decode/1k",
+               [&]() { return utils::base64Decode(base64).size(); });
+    runner.run("utils/urlEncodeComponent/1k",
+               [&]() { return utils::urlEncodeComponent(data).size(); });
+    runner.run("utils/urlDecode/1k",
+               [&]() { return utils::urlDecode(url).size(); });
+    runner.run("utils/binaryStringToHex/1k", [&]() {
+        return utils::binaryStringToHex(
+                   reinterpret_cast<const unsigned char *>(data.data()),
+                   data.size())
+            .size();
+    });
+    runner.run("utils/hexToBinaryString/1k", [&]() {
+        return utils::hexToBinaryString(hex.data(), hex.size()).size();
+    });
+}
+
+void benchmarkCompression(BenchmarkRunner &runner)
+{
+    auto data = makeText(16 * 1024);
+    auto gzip = utils::gzipCompress(data.data(), data.length());
+    runner.run("utils/gzipCompress/16k", [&]() {
+        return utils::gzipCompress(data.data(), data.length()).size();
+    });
+    runner.run("utils/gzipDecompress/16k", [&]() {
+        return utils::gzipDecompress(gzip.data(), gzip.length()).size();
+    });
+#ifdef USE_BROTLI
+    auto brotli = utils::brotliCompress(data.data(), data.length());
+    runner.run("utils/brotliCompress/16k", [&]() {
+        return utils::brotliCompress(data.data(), data.length()).size();
+    });
+    runner.run("utils/brotliDecompress/16k", [&]() {
+        return utils::brotliDecompress(brotli.data(), brotli.length()).size();
+    });
+#endif
+}
+
+void benchmarkWebSocket(BenchmarkRunner &runner)
+{
+    auto message = makeText(256);
+    auto opcode = WebSocketConnectionImpl::opcodeOf(WebSocketMessageType::Text,
+                                                    message.length());
+    runner.run("WebSocket/newServerFrame/256", [&]() {
+        size_t headerLength;
+        auto frame = WebSocketConnectionImpl::newServerFrame(message.data(),
+                                                             message.length(),
+                                                             opcode,
+                                                             headerLength);
+        return frame->readableBytes();
+    });
+
+    size_t headerLength;
+    auto frame = WebSocketConnectionImpl::newServerFrame(message.data(),
+                                                         message.length(),
+                                                         opcode,
+                                                         headerLength);
+    std::string frameBytes(frame->peek(), frame->readableBytes());
+    runner.run("WebSocket/parse/256", [&]() -> size_t {
+        WebSocketMessageParser parser;
+        trantor::MsgBuffer buffer;
+        buffer.append(frameBytes);
+        std::string received;
+        WebSocketMessageType type;
+        if (!parser.parse(&buffer) || !parser.gotAll(received, type))
+            return 0;
+        return received.length();
+    });
+
+    // The clients mask their frames and the servers unmask them.
+    std::string payload(1024 * 1024, 'x');
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    runner.run("WebSocket/mask/1M", [&]() {
+        internal::maskWebSocketPayload(
+            payload.data(), payload.data(), payload.length(), mask);
+        return payload.length();
+    });
+    runner.run("WebSocket/maskScalar/1M", [&]() {
+        internal::maskWebSocketPayloadScalar(
+            payload.data(), payload.data(), payload.length(), mask);
+        return payload.length();
+    });
+}
+
+void benchmarkOrmField(BenchmarkRunner &runner)
+{
+    orm::Result result(std::make_shared<BenchmarkResultImpl>());
+    auto row = result[0];
+    runner.run("orm::Field/as<int64_t>", [&]() {
+        return size_t(row["id"].as<int64_t>());
+    });
+    runner.run("orm::Field/as<double>", [&]() {
+        return size_t(row[1].as<double>());
+    });
+    runner.run("orm::Field/as<std::string>", [&]() {
+        return row[2].as<std::string>().length();
+    });
+}
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    bool json{false};
+    std::string filter;
+    double minTime{0.5};
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--json")
+            json = true;
+        else if (arg.compare(0, 9, "--filter=") == 0)
+            filter = arg.substr(9);
+        else if (arg.compare(0, 11, "--min_time=") == 0)
+            minTime = std::stod(arg.substr(11));
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--json] [--filter=<substring>] [--min_time=<s>]\n";
+            return 1;
+        }
+    }
+    trantor::Logger::setLogLevel(trantor::Logger::kWarn);
+
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+    std::unique_ptr<trantor::TcpServer> server;
+    std::shared_ptr<trantor::TcpClient> client;
+    auto conn = connect(loop, server, client);
+
+    BenchmarkRunner runner(filter, minTime);
+    benchmarkParser(runner, loop, conn);
+    benchmarkResponse(runner);
+    benchmarkRouter(runner, loop);
+    benchmarkCacheMap(runner, loop);
+    benchmarkCodecs(runner);
+    benchmarkCompression(runner);
+    benchmarkWebSocket(runner);
+    benchmarkOrmField(runner);
+
+    if (json)
+        runner.printJson();
+    else
+        runner.printText();
+
+    std::promise<void> closed;
+    loop->runInLoop([&]() {
+        conn->forceClose();
+        client.reset();
+        server.reset();
+        closed.set_value();
+    });
+    closed.get_future().get();
+    return 0;
+}
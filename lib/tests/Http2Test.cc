@@ -0,0 +1,175 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <drogon/HttpController.h>
+#include <atomic>
+#include <future>
+#include <string>
+
+using namespace drogon;
+
+class Http2Controller : public HttpController<Http2Controller>
+{
+  public:
+    METHOD_LIST_BEGIN
+    METHOD_ADD(Http2Controller::echo, "/echo", Post);
+    METHOD_ADD(Http2Controller::slow, "/slow", Get);
+    METHOD_ADD(Http2Controller::large, "/large", Get);
+    METHOD_LIST_END
+
+    void echo(const HttpRequestPtr &req,
+              std::function<void(const HttpResponsePtr &)> &&callback)
+    {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->addHeader("x-header", req->getHeader("x-header"));
+        resp->setBody(std::string(req->body()));
+        callback(resp);
+    }
+
+    void slow(const HttpRequestPtr &,
+              std::function<void(const HttpResponsePtr &)> &&callback)
+    {
+        app().getLoop()->runAfter(1.0, [callback = std::move(callback)]() {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setBody("slow");
+            callback(resp);
+        });
+    }
+
+    void large(const HttpRequestPtr &,
+               std::function<void(const HttpResponsePtr &)> &&callback)
+    {
+        auto resp = HttpResponse::newHttpResponse();
+        // Larger than the default flow control windows, with a header block
+        // larger than a frame.
+        resp->addHeader("x-large", std::string(20000, 'h'));
+        resp->setBody(std::string(3 * 1024 * 1024, 'b'));
+        callback(resp);
+    }
+};
+
+static HttpClientPtr newHttp2Client()
+{
+    auto client = HttpClient::newHttpClient("http://127.0.0.1:8020");
+    client->enableHttp2(true, true);
+    return client;
+}
+
+DROGON_TEST(Http2Multiplexing)
+{
+    auto client = newHttp2Client();
+    // The fast request is answered first on the same connection, it would
+    // wait for the slow one with HTTP/1.1.
+    std::atomic<int> order{0};
+    std::promise<void> slowDone, fastDone;
+    auto slowReq = HttpRequest::newHttpRequest();
+    slowReq->setPath("/Http2Controller/slow");
+    client->sendRequest(
+        slowReq,
+        [TEST_CTX, &order, &slowDone](ReqResult result,
+                                      const HttpResponsePtr &resp) {
+            CHECK(result == ReqResult::Ok);
+            CHECK((resp && resp->body() == "slow"));
+            CHECK(order++ == 1);
+            slowDone.set_value();
+        });
+    auto fastReq = HttpRequest::newHttpRequest();
+    fastReq->setPath("/Http2Controller/echo");
+    fastReq->setMethod(Post);
+    fastReq->setBody("fast");
+    client->sendRequest(
+        fastReq,
+        [TEST_CTX, &order, &fastDone](ReqResult result,
+                                      const HttpResponsePtr &resp) {
+            CHECK(result == ReqResult::Ok);
+            CHECK((resp && resp->body() == "fast"));
+            CHECK(order++ == 0);
+            fastDone.set_value();
+        });
+    fastDone.get_future().wait();
+    slowDone.get_future().wait();
+}
+
+DROGON_TEST(Http2LargeBodies)
+{
+    auto client = newHttp2Client();
+    // Both bodies are sent with several window updates.
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/Http2Controller/echo");
+    req->setMethod(Post);
+    req->addHeader("x-header", std::string(20000, 'r'));
+    std::string body;
+    for (int i = 0; body.length() < 2 * 1024 * 1024; ++i)
+        body.append(std::to_string(i)).push_back(',');
+    req->setBody(body);
+    auto [result, resp] = client->sendRequest(req, 10);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->getStatusCode() == k200OK);
+    CHECK(resp->body() == body);
+    CHECK(resp->getHeader("x-header") == std::string(20000, 'r'));
+
+    req = HttpRequest::newHttpRequest();
+    req->setPath("/Http2Controller/large");
+    std::tie(result, resp) = client->sendRequest(req, 10);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->body().length() == 3 * 1024 * 1024);
+    CHECK(resp->getHeader("x-large").length() == 20000);
+
+    // The dynamic tables of HPACK stay in sync over many requests.
+    for (int i = 0; i < 200; ++i)
+    {
+        req = HttpRequest::newHttpRequest();
+        req->setPath("/Http2Controller/echo");
+        req->setMethod(Post);
+        req->addHeader("x-header", "value-" + std::to_string(i % 50));
+        req->setBody(std::to_string(i));
+        std::tie(result, resp) = client->sendRequest(req, 10);
+        REQUIRE(result == ReqResult::Ok);
+        CHECK(resp->getHeader("x-header") ==
+              "value-" + std::to_string(i % 50));
+        CHECK(resp->body() == std::to_string(i));
+    }
+}
+
+DROGON_TEST(Http2Timeout)
+{
+    auto client = newHttp2Client();
+    // The timeout resets the stream of the request only.
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/Http2Controller/slow");
+    auto [result, resp] = client->sendRequest(req, 0.2);
+    CHECK(result == ReqResult::Timeout);
+
+    req = HttpRequest::newHttpRequest();
+    req->setPath("/Http2Controller/echo");
+    req->setMethod(Post);
+    req->setBody("after timeout");
+    std::tie(result, resp) = client->sendRequest(req, 5);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->body() == "after timeout");
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .addListener("127.0.0.1", 8020)
+            .setClientMaxBodySize(8 * 1024 * 1024)
+            .enableHttp2(true);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
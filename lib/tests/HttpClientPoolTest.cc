@@ -0,0 +1,188 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClientPool.h>
+#include <trantor/net/EventLoopThread.h>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+// The body names the host and the connection the request came by.
+static HttpResponsePtr connectionResponse(const HttpRequestPtr &req)
+{
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setBody(std::to_string(req->localAddr().toPort()) + ":" +
+                  std::to_string(req->peerAddr().toPort()));
+    return resp;
+}
+
+static HttpClientPoolPtr newPool(std::vector<std::string> hosts,
+                                 size_t connectionsPerHost,
+                                 trantor::EventLoop *loop)
+{
+    HttpClientPoolConfig config;
+    config.hosts = std::move(hosts);
+    config.connectionsPerHost = connectionsPerHost;
+    return HttpClientPool::newHttpClientPool(config, {loop});
+}
+
+static HttpRequestPtr newRequest(const std::string &path)
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath(path);
+    return req;
+}
+
+// Send the slow requests at once and return the bodies of the responses.
+static std::vector<std::string> sendConcurrently(const HttpClientPoolPtr &pool,
+                                                 size_t count)
+{
+    std::mutex mutex;
+    std::vector<std::string> bodies;
+    std::promise<void> done;
+    for (size_t i = 0; i < count; ++i)
+    {
+        pool->sendRequest(
+            newRequest("/slow"),
+            [&, count](ReqResult result, const HttpResponsePtr &resp) {
+                std::lock_guard<std::mutex> lock(mutex);
+                bodies.push_back(result == ReqResult::Ok
+                                     ? std::string(resp->body())
+                                     : std::string("error"));
+                if (bodies.size() == count)
+                    done.set_value();
+            },
+            5);
+    }
+    done.get_future().wait();
+    return bodies;
+}
+
+static std::string host(const std::string &body)
+{
+    return body.substr(0, body.find(':'));
+}
+
+DROGON_TEST(HttpClientPoolReuse)
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto pool = newPool({"http://127.0.0.1:8023"}, 4, loopThread.getLoop());
+    // An idle connection is reused rather than a new one opened.
+    std::set<std::string> connections;
+    for (int i = 0; i < 10; ++i)
+    {
+        auto [result, resp] = pool->sendRequest(newRequest("/fast"), 5);
+        REQUIRE(result == ReqResult::Ok);
+        connections.insert(std::string(resp->body()));
+    }
+    CHECK(connections.size() == 1);
+    CHECK(pool->outstandingRequests() == 0);
+}
+
+DROGON_TEST(HttpClientPoolLimit)
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto pool = newPool({"http://127.0.0.1:8023"}, 2, loopThread.getLoop());
+    // The busy connections make new ones, up to the limit, then the
+    // requests wait on the least busy ones.
+    auto bodies = sendConcurrently(pool, 6);
+    std::map<std::string, int> connections;
+    for (auto &body : bodies)
+    {
+        CHECK(body != "error");
+        ++connections[body];
+    }
+    CHECK(connections.size() == 2);
+    for (auto &[connection, requests] : connections)
+    {
+        (void)connection;
+        CHECK(requests == 3);
+    }
+    CHECK(pool->outstandingRequests() == 0);
+}
+
+DROGON_TEST(HttpClientPoolBalancing)
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto pool = newPool({"http://127.0.0.1:8023", "http://127.0.0.1:8024"},
+                        1,
+                        loopThread.getLoop());
+    // A busy host makes the next request open a connection to the other.
+    auto bodies = sendConcurrently(pool, 4);
+    std::map<std::string, int> hosts;
+    for (auto &body : bodies)
+    {
+        CHECK(body != "error");
+        ++hosts[host(body)];
+    }
+    CHECK(hosts.size() == 2);
+    CHECK(hosts["8023"] == 2);
+    CHECK(hosts["8024"] == 2);
+
+    // The idle connections are used in turn.
+    hosts.clear();
+    for (int i = 0; i < 6; ++i)
+    {
+        auto [result, resp] = pool->sendRequest(newRequest("/fast"), 5);
+        REQUIRE(result == ReqResult::Ok);
+        ++hosts[host(std::string(resp->body()))];
+    }
+    CHECK(hosts["8023"] == 3);
+    CHECK(hosts["8024"] == 3);
+}
+
+DROGON_TEST(HttpClientPoolBadHost)
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto pool = newPool({}, 1, loopThread.getLoop());
+    auto [result, resp] = pool->sendRequest(newRequest("/fast"), 5);
+    CHECK(result == ReqResult::BadServerAddress);
+    CHECK(resp == nullptr);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler("/fast",
+                             [](const HttpRequestPtr &req,
+                                Callback &&callback) {
+                                 callback(connectionResponse(req));
+                             })
+            .registerHandler(
+                "/slow",
+                [](const HttpRequestPtr &req, Callback &&callback) {
+                    app().getLoop()->runAfter(
+                        0.2, [req, callback = std::move(callback)]() {
+                            callback(connectionResponse(req));
+                        });
+                })
+            .addListener("127.0.0.1", 8023)
+            .addListener("127.0.0.1", 8024);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
@@ -0,0 +1,86 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static std::string get(const HttpClientPtr &client, const std::string &path)
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath(path);
+    auto [result, resp] = client->sendRequest(req, 5);
+    if (result != ReqResult::Ok || resp->statusCode() != k200OK)
+        return {};
+    return std::string(resp->body());
+}
+
+// The value of a sample with its labels, -1 if it isn't found.
+static double sampleValue(const std::string &metrics, const std::string &name)
+{
+    auto pos = metrics.find("\n" + name + " ");
+    if (pos == std::string::npos)
+        return -1;
+    return std::stod(metrics.substr(pos + name.size() + 2));
+}
+
+DROGON_TEST(IdleMemoryTrim)
+{
+    // A keep-alive connection left idle longer than the timeout
+    auto client = HttpClient::newHttpClient("http://127.0.0.1:8042");
+    CHECK(get(client, "/echo?text=first") == "first");
+    std::this_thread::sleep_for(2500ms);
+
+    // Its buffers are allocated again for the next requests.
+    CHECK(get(client, "/echo?text=second") == "second");
+    CHECK(get(client, "/echo?text=third") == "third");
+
+    auto metrics =
+        get(HttpClient::newHttpClient("http://127.0.0.1:8042"), "/metrics");
+    REQUIRE(!metrics.empty());
+    CHECK(sampleValue(metrics, "drogon_http_connection_trims_total") >= 1);
+    CHECK(sampleValue(metrics, "drogon_http_connections{loop=\"0\"}") >= 1);
+    CHECK(sampleValue(metrics,
+                      "drogon_http_connection_memory_bytes{loop=\"0\"}") > 0);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        Json::Value config;
+        config["builtin_metrics"]["http"] = true;
+        app()
+            .registerHandler("/echo",
+                             [](const HttpRequestPtr &req,
+                                Callback &&callback) {
+                                 auto resp = HttpResponse::newHttpResponse();
+                                 resp->setBody(req->getParameter("text"));
+                                 callback(resp);
+                             })
+            .setIdleMemoryTrimTimeout(1)
+            .setThreadNum(1)
+            .addListener("127.0.0.1", 8042);
+        app().addPlugin("drogon::plugin::PromExporter", {}, config);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
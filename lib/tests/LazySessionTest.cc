@@ -0,0 +1,165 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <drogon/HttpController.h>
+#include <drogon/SessionStore.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+
+using namespace drogon;
+
+// A session store in memory which counts the sessions loaded from it.
+class MemorySessionStore : public SessionStore
+{
+  public:
+    void load(const std::string &sessionId, LoadCallback &&callback) override
+    {
+        ++loads;
+        Session::SessionMap data;
+        bool found{false};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto iter = sessions_.find(sessionId);
+            if (iter != sessions_.end())
+            {
+                data = iter->second;
+                found = true;
+            }
+        }
+        callback(found, std::move(data));
+    }
+
+    void save(std::vector<SessionData> &&sessions, size_t) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &session : sessions)
+        {
+            sessions_[session.first] = std::move(session.second);
+        }
+    }
+
+    void touch(std::vector<std::string> &&, size_t) override
+    {
+    }
+
+    void erase(const std::string &sessionId) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_.erase(sessionId);
+    }
+
+    std::atomic<int> loads{0};
+
+  private:
+    std::mutex mutex_;
+    std::map<std::string, Session::SessionMap> sessions_;
+};
+
+auto store = std::make_shared<MemorySessionStore>();
+
+class LazySessionController : public HttpController<LazySessionController>
+{
+  public:
+    METHOD_LIST_BEGIN
+    METHOD_ADD(LazySessionController::count, "/count", Get);
+    METHOD_ADD(LazySessionController::untouched, "/untouched", Get);
+    METHOD_LIST_END
+
+    void count(const HttpRequestPtr &req,
+               std::function<void(const HttpResponsePtr &)> &&callback)
+    {
+        auto &session = req->session();
+        auto count = session->getOptional<int>("count").value_or(0) + 1;
+        session->insert("count", count);
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setBody(std::to_string(count));
+        callback(resp);
+    }
+
+    void untouched(const HttpRequestPtr &,
+                   std::function<void(const HttpResponsePtr &)> &&callback)
+    {
+        callback(HttpResponse::newHttpResponse());
+    }
+};
+
+DROGON_TEST(LazySession)
+{
+    auto client =
+        HttpClient::newHttpClient("http://127.0.0.1:8019",
+                                  HttpAppFramework::instance().getLoop());
+    auto get = [client](const std::string &path,
+                        const std::string &sessionId = {}) {
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath("/LazySessionController" + path);
+        if (!sessionId.empty())
+            req->addCookie("JSESSIONID", sessionId);
+        return client->sendRequest(req, 5);
+    };
+
+    // 1. No cookie, the session is never accessed
+    auto [result, resp] = get("/untouched");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->getStatusCode() == k200OK);
+    CHECK(resp->getCookie("JSESSIONID").value().empty());
+
+    // 2. No cookie, a new session is created when it's accessed
+    std::tie(result, resp) = get("/count");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->body() == "1");
+    auto sessionId = resp->getCookie("JSESSIONID").value();
+    REQUIRE(!sessionId.empty());
+    CHECK(store->loads == 0);
+
+    // 3. Cookie with a session in the local cache, found without the store
+    std::tie(result, resp) = get("/count", sessionId);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->body() == "2");
+    CHECK(resp->getCookie("JSESSIONID").value().empty());
+    std::tie(result, resp) = get("/untouched", sessionId);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->getCookie("JSESSIONID").value().empty());
+    CHECK(store->loads == 0);
+
+    // 4. Cookie with a session only in the store, loaded before routing
+    store->save({{"stored-session", {{"count", std::any(41)}}}}, 0);
+    std::tie(result, resp) = get("/count", "stored-session");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->body() == "42");
+    CHECK(resp->getCookie("JSESSIONID").value().empty());
+    CHECK(store->loads == 1);
+
+    // 5. Cookie with a session in the store which is never accessed
+    store->save({{"untouched-session", {{"count", std::any(1)}}}}, 0);
+    std::tie(result, resp) = get("/untouched", "untouched-session");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->getStatusCode() == k200OK);
+    CHECK(resp->getCookie("JSESSIONID").value().empty());
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .addListener("127.0.0.1", 8019)
+            .enableSession(60)
+            .enableLazySession()
+            .setSessionStore(store, 60);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
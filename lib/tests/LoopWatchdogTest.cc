@@ -0,0 +1,95 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static std::string get(const std::string &path)
+{
+    auto client = HttpClient::newHttpClient("http://127.0.0.1:8040");
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath(path);
+    auto [result, resp] = client->sendRequest(req, 5);
+    if (result != ReqResult::Ok || resp->statusCode() != k200OK)
+        return {};
+    return std::string(resp->body());
+}
+
+// The value of a sample with its labels, -1 if it isn't found.
+static double sampleValue(const std::string &metrics, const std::string &name)
+{
+    auto pos = metrics.find("\n" + name + " ");
+    if (pos == std::string::npos)
+        return -1;
+    return std::stod(metrics.substr(pos + name.size() + 2));
+}
+
+DROGON_TEST(LoopWatchdogStall)
+{
+    // The only IO loop is blocked by the handler, the probes queued in the
+    // meantime wait until it returns.
+    CHECK(get("/block") == "done");
+    std::this_thread::sleep_for(200ms);
+
+    // Fetched once, the metrics are cached for a few seconds.
+    auto metrics = get("/metrics");
+    REQUIRE(!metrics.empty());
+    // The stall is reported once while it lasts.
+    CHECK(sampleValue(metrics, "drogon_event_loop_stalls_total{loop=\"0\"}") ==
+          1);
+    CHECK(sampleValue(metrics,
+                      "drogon_event_loop_delay_seconds_count{loop=\"0\"}") >=
+          1);
+    // The probe queued first waited most of the blocking time.
+    CHECK(sampleValue(metrics,
+                      "drogon_event_loop_delay_seconds_sum{loop=\"0\"}") >=
+          0.25);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler("/block",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 std::this_thread::sleep_for(400ms);
+                                 auto resp = HttpResponse::newHttpResponse();
+                                 resp->setBody("done");
+                                 callback(resp);
+                             })
+            .setThreadNum(1)
+            .addListener("127.0.0.1", 8040);
+        Json::Value exporterConfig;
+        exporterConfig["collectors"] = Json::arrayValue;
+        app().addPlugin("drogon::plugin::PromExporter", {}, exporterConfig);
+        Json::Value config;
+        config["interval"] = 0.05;
+        config["stall_threshold"] = 0.1;
+        config["export_metrics"] = true;
+        app().addPlugin("drogon::plugin::LoopWatchdog",
+                        {"drogon::plugin::PromExporter"},
+                        config);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
@@ -0,0 +1,103 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <algorithm>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RawExchange.h"
+
+using namespace drogon;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+// The handlers in the order they were called
+static std::mutex calledMutex;
+static std::vector<std::string> called;
+
+static void handle(const std::string &name, Callback &&callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(calledMutex);
+        called.push_back(name);
+    }
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setBody(name);
+    callback(resp);
+}
+
+static std::string request(const std::string &path, bool close = false)
+{
+    return "GET " + path + " HTTP/1.1\r\nhost: 127.0.0.1\r\n" +
+           (close ? "connection: close\r\n" : "") + "\r\n";
+}
+
+DROGON_TEST(LowPriorityHandlers)
+{
+    // Parsed in the same round of IO events, more than the low priority
+    // handlers run in one round
+    std::string requests;
+    for (int i = 0; i < 6; ++i)
+        requests += request("/low/" + std::to_string(i));
+    requests += request("/high/0");
+    requests += request("/high/1", true);
+    auto data = rawExchange(8037, requests);
+
+    // The responses are still sent in the order of the requests.
+    std::vector<std::string> expected{
+        "low0", "low1", "low2", "low3", "low4", "low5", "high0", "high1"};
+    size_t pos = 0;
+    for (auto &name : expected)
+    {
+        auto found = data.find("\r\n\r\n" + name, pos);
+        CHECK(found != std::string::npos);
+        pos = found == std::string::npos ? pos : found;
+    }
+
+    // The other handlers are called first, the low priority ones keep their
+    // order.
+    std::lock_guard<std::mutex> lock(calledMutex);
+    REQUIRE(called.size() == expected.size());
+    CHECK(called[0] == "high0");
+    CHECK(called[1] == "high1");
+    CHECK(std::equal(called.begin() + 2, called.end(), expected.begin()));
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler(
+                "/low/{n}",
+                [](const HttpRequestPtr &,
+                   Callback &&callback,
+                   const std::string &n) {
+                    handle("low" + n, std::move(callback));
+                },
+                {Get, LowPriority})
+            .registerHandler("/high/{n}",
+                             [](const HttpRequestPtr &,
+                                Callback &&callback,
+                                const std::string &n) {
+                                 handle("high" + n, std::move(callback));
+                             })
+            .setThreadNum(1)
+            .addListener("127.0.0.1", 8037);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
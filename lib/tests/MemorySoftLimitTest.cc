@@ -0,0 +1,137 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+// The requests not answered yet, their bodies are counted until they are
+// released.
+static std::mutex heldMutex;
+static std::vector<std::pair<HttpRequestPtr, Callback>> held;
+
+static size_t heldCount()
+{
+    std::lock_guard<std::mutex> lock(heldMutex);
+    return held.size();
+}
+
+static HttpClientPtr newClient()
+{
+    return HttpClient::newHttpClient("http://127.0.0.1:8032");
+}
+
+static bool waitFor(const std::function<bool()> &condition)
+{
+    for (int i = 0; i < 200; ++i)
+    {
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(10ms);
+    }
+    return condition();
+}
+
+// Answer the held requests, which releases their bodies.
+static void answerHeld()
+{
+    std::lock_guard<std::mutex> lock(heldMutex);
+    for (auto &[req, callback] : held)
+    {
+        (void)req;
+        callback(HttpResponse::newHttpResponse());
+    }
+    held.clear();
+}
+
+static std::shared_ptr<std::promise<ReqResult>> post(
+    const HttpClientPtr &client)
+{
+    auto result = std::make_shared<std::promise<ReqResult>>();
+    auto req = HttpRequest::newHttpRequest();
+    req->setMethod(Post);
+    req->setPath("/hold");
+    req->setBody(std::string(300 * 1024, 'x'));
+    client->sendRequest(req,
+                        [result](ReqResult r, const HttpResponsePtr &) {
+                            result->set_value(r);
+                        },
+                        10);
+    return result;
+}
+
+DROGON_TEST(MemorySoftLimit)
+{
+    auto first = newClient();
+    auto firstResult = post(first);
+    REQUIRE(waitFor([]() { return heldCount() == 1; }));
+
+    // The two bodies of 300KB are over the limit of 512KB, the input of the
+    // second one is held without being parsed.
+    auto second = newClient();
+    auto secondResult = post(second);
+    std::this_thread::sleep_for(300ms);
+    CHECK(heldCount() == 1);
+
+    // The new connections are closed right away.
+    auto ping = HttpRequest::newHttpRequest();
+    ping->setPath("/ping");
+    CHECK(newClient()->sendRequest(ping, 2).first != ReqResult::Ok);
+
+    // Once the first body is released, the held input is parsed.
+    answerHeld();
+    CHECK(firstResult->get_future().get() == ReqResult::Ok);
+    CHECK(waitFor([]() { return heldCount() == 1; }));
+    answerHeld();
+    CHECK(secondResult->get_future().get() == ReqResult::Ok);
+    CHECK(waitFor([&ping]() {
+        return newClient()->sendRequest(ping, 2).first == ReqResult::Ok;
+    }));
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler("/ping",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 callback(HttpResponse::newHttpResponse());
+                             })
+            .registerHandler(
+                "/hold",
+                [](const HttpRequestPtr &req, Callback &&callback) {
+                    std::lock_guard<std::mutex> lock(heldMutex);
+                    held.emplace_back(req, std::move(callback));
+                },
+                {Post})
+            // The bodies are kept in memory, not in temporary files.
+            .setClientMaxMemoryBodySize(1024 * 1024)
+            .setMemorySoftLimit(512 * 1024)
+            .addListener("127.0.0.1", 8032);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
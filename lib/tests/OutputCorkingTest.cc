@@ -0,0 +1,151 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <future>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "RawExchange.h"
+
+using namespace drogon;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static HttpResponsePtr textResponse(const std::string &text)
+{
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setBody(text);
+    return resp;
+}
+
+struct RawResponse
+{
+    std::string head;
+    std::string body;
+};
+
+// Split the responses, the ones of the HEAD requests have no body.
+static std::vector<RawResponse> splitResponses(std::string_view data,
+                                               const std::vector<bool> &heads)
+{
+    std::vector<RawResponse> responses;
+    for (bool head : heads)
+    {
+        auto end = data.find("\r\n\r\n");
+        if (end == std::string_view::npos)
+            break;
+        RawResponse resp;
+        resp.head = std::string(data.substr(0, end + 4));
+        data.remove_prefix(end + 4);
+        size_t length = 0;
+        auto pos = resp.head.find("content-length: ");
+        if (!head && pos != std::string::npos)
+            length = std::stoul(resp.head.substr(pos + 16));
+        if (length > data.length())
+            break;
+        resp.body = std::string(data.substr(0, length));
+        data.remove_prefix(length);
+        responses.push_back(std::move(resp));
+    }
+    return responses;
+}
+
+static std::string request(const std::string &method,
+                           const std::string &path,
+                           bool close = false)
+{
+    return method + " " + path + " HTTP/1.1\r\nhost: 127.0.0.1\r\n" +
+           (close ? "connection: close\r\n" : "") + "\r\n";
+}
+
+DROGON_TEST(OutputCorkingPipelined)
+{
+    // The corked responses are sent before the big body, the slow response
+    // and the one closing the connection, in the order of the requests.
+    std::string requests;
+    std::vector<bool> heads;
+    for (int i = 0; i < 5; ++i)
+    {
+        requests += request("GET", "/small/" + std::to_string(i));
+        heads.push_back(false);
+    }
+    requests += request("GET", "/big");
+    heads.push_back(false);
+    requests += request("HEAD", "/small/6");
+    heads.push_back(true);
+    requests += request("GET", "/slow/7");
+    heads.push_back(false);
+    requests += request("GET", "/small/8", true);
+    heads.push_back(false);
+
+    auto data = rawExchange(8030, requests);
+    auto responses = splitResponses(data, heads);
+    REQUIRE(responses.size() == heads.size());
+    for (auto &resp : responses)
+    {
+        CHECK(resp.head.find("HTTP/1.1 200 OK\r\n") == 0);
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        CHECK(responses[i].body == std::to_string(i));
+    }
+    CHECK(responses[5].body == std::string(100 * 1024, 'x'));
+    CHECK(responses[6].body.empty());
+    CHECK(responses[7].body == "7");
+    CHECK(responses[8].body == "8");
+    CHECK(responses[8].head.find("connection: close\r\n") !=
+          std::string::npos);
+
+    // Nothing is left after the last response.
+    size_t total = 0;
+    for (auto &resp : responses)
+        total += resp.head.length() + resp.body.length();
+    CHECK(total == data.length());
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler("/small/{n}",
+                             [](const HttpRequestPtr &,
+                                Callback &&callback,
+                                const std::string &n) {
+                                 callback(textResponse(n));
+                             })
+            .registerHandler("/big",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 // Corked along with the small responses
+                                 callback(textResponse(
+                                     std::string(100 * 1024, 'x')));
+                             })
+            .registerHandler(
+                "/slow/{n}",
+                [](const HttpRequestPtr &,
+                   Callback &&callback,
+                   const std::string &n) {
+                    // Answered after the next requests are handled
+                    trantor::EventLoop::getEventLoopOfCurrentThread()->runAfter(
+                        0.1, [callback = std::move(callback), n]() {
+                            callback(textResponse(n));
+                        });
+                })
+            .enableOutputCorking()
+            .addListener("127.0.0.1", 8030);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
@@ -0,0 +1,134 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/plugins/Plugin.h>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Clock = std::chrono::steady_clock;
+
+// When and where a plugin was initialized
+struct InitRecord
+{
+    Clock::time_point start;
+    Clock::time_point end;
+    std::thread::id thread;
+};
+
+static InitRecord record(std::chrono::milliseconds duration)
+{
+    InitRecord rec;
+    rec.start = Clock::now();
+    rec.thread = std::this_thread::get_id();
+    std::this_thread::sleep_for(duration);
+    rec.end = Clock::now();
+    return rec;
+}
+
+class SlowPluginA : public Plugin<SlowPluginA>
+{
+  public:
+    void initAndStart(const Json::Value &) override
+    {
+        record_ = record(300ms);
+    }
+
+    void shutdown() override
+    {
+    }
+
+    InitRecord record_;
+};
+
+class SlowPluginB : public Plugin<SlowPluginB>
+{
+  public:
+    void initAndStart(const Json::Value &) override
+    {
+        record_ = record(300ms);
+    }
+
+    void shutdown() override
+    {
+    }
+
+    InitRecord record_;
+};
+
+class DependentPlugin : public Plugin<DependentPlugin>
+{
+  public:
+    void initAndStart(const Json::Value &) override
+    {
+        record_ = record(0ms);
+    }
+
+    void shutdown() override
+    {
+    }
+
+    InitRecord record_;
+};
+
+static std::thread::id appThread;
+
+DROGON_TEST(ParallelPluginInit)
+{
+    auto a = app().getPlugin<SlowPluginA>();
+    auto b = app().getPlugin<SlowPluginB>();
+    auto dependent = app().getPlugin<DependentPlugin>();
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    REQUIRE(dependent != nullptr);
+
+    // The parallel plugins ran at the same time, in threads of their own.
+    CHECK(a->record_.thread != appThread);
+    CHECK(b->record_.thread != appThread);
+    CHECK(a->record_.thread != b->record_.thread);
+    CHECK(a->record_.start < b->record_.end);
+    CHECK(b->record_.start < a->record_.end);
+
+    // The other plugin ran in the main thread once its dependencies were
+    // initialized.
+    CHECK(dependent->record_.thread == appThread);
+    CHECK(dependent->record_.start >= a->record_.end);
+    CHECK(dependent->record_.start >= b->record_.end);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        appThread = std::this_thread::get_id();
+        Json::Value plugins(Json::arrayValue);
+        Json::Value plugin;
+        plugin["name"] = "SlowPluginA";
+        plugin["parallel_init"] = true;
+        plugins.append(plugin);
+        plugin["name"] = "SlowPluginB";
+        plugins.append(plugin);
+        plugin["name"] = "DependentPlugin";
+        plugin["parallel_init"] = false;
+        plugin["dependencies"].append("SlowPluginA");
+        plugin["dependencies"].append("SlowPluginB");
+        plugins.append(plugin);
+        app().setThreadNum(1).addPlugins(plugins);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
@@ -0,0 +1,130 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <chrono>
+#include <future>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RawExchange.h"
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static std::string get(const std::string &path)
+{
+    auto client = HttpClient::newHttpClient("http://127.0.0.1:8039");
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath(path);
+    auto [result, resp] = client->sendRequest(req, 2);
+    if (result != ReqResult::Ok || resp->statusCode() != k200OK)
+        return {};
+    return std::string(resp->body());
+}
+
+// The lines of the metrics containing all the parts.
+static std::vector<std::string> findMetrics(
+    const std::string &metrics,
+    const std::vector<std::string> &parts)
+{
+    std::vector<std::string> lines;
+    std::istringstream stream(metrics);
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        bool found = true;
+        for (auto &part : parts)
+        {
+            if (line.find(part) == std::string::npos)
+            {
+                found = false;
+                break;
+            }
+        }
+        if (found)
+            lines.push_back(line);
+    }
+    return lines;
+}
+
+DROGON_TEST(PromExporterBuiltinMetrics)
+{
+    CHECK(get("/users/1") == "1");
+    CHECK(get("/users/2") == "2");
+    CHECK(get("/missing").empty());
+    auto data = rawExchange(8039, "GARBAGE\r\n\r\n");
+    CHECK(data.find("HTTP/1.1 400") == 0);
+    // Long enough for a measurement of the lag of the loops
+    std::this_thread::sleep_for(300ms);
+
+    auto metrics = get("/metrics");
+    REQUIRE(!metrics.empty());
+    // The requests are counted by route pattern, not by path.
+    auto lines = findMetrics(metrics,
+                             {"drogon_http_requests_total{",
+                              "method=\"GET\"",
+                              "/users/",
+                              "status=\"200\""});
+    REQUIRE(lines.size() == 1);
+    CHECK(lines[0].find("} 2.000000") != std::string::npos);
+    lines = findMetrics(metrics,
+                        {"drogon_http_requests_total{",
+                         "route=\"none\"",
+                         "status=\"404\""});
+    REQUIRE(lines.size() == 1);
+    CHECK(lines[0].find("} 1.000000") != std::string::npos);
+    CHECK(!findMetrics(metrics,
+                       {"drogon_http_request_duration_seconds",
+                        "/users/"})
+               .empty());
+    lines = findMetrics(metrics, {"drogon_http_parse_errors_total "});
+    REQUIRE(lines.size() == 1);
+    CHECK(lines[0] == "drogon_http_parse_errors_total 1.000000");
+    // The request for the metrics is in flight.
+    lines = findMetrics(metrics, {"drogon_http_requests_in_flight "});
+    REQUIRE(lines.size() == 1);
+    CHECK(lines[0] == "drogon_http_requests_in_flight 1.000000");
+    CHECK(findMetrics(metrics, {"drogon_event_loop_lag_seconds{loop=\"0\"}"})
+              .size() == 1);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        Json::Value config;
+        config["builtin_metrics"]["http"] = true;
+        config["builtin_metrics"]["event_loop_lag_interval"] = 0.1;
+        app()
+            .registerHandler("/users/{id}",
+                             [](const HttpRequestPtr &,
+                                Callback &&callback,
+                                const std::string &id) {
+                                 auto resp = HttpResponse::newHttpResponse();
+                                 resp->setBody(id);
+                                 callback(resp);
+                             })
+            .setThreadNum(1)
+            .addListener("127.0.0.1", 8039);
+        app().addPlugin("drogon::plugin::PromExporter", {}, config);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <trantor/net/EventLoopThread.h>
+#include <trantor/net/TcpClient.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Send the raw data on one connection to the local port and return the bytes
+// received until the server closes it, or an empty string after ten seconds.
+// With an interval, the pieces are sent one after another with a pause, so
+// they are received apart, otherwise they are sent at once.
+inline std::string rawExchange(uint16_t port,
+                               const std::vector<std::string> &pieces,
+                               double interval = 0)
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+    auto received = std::make_shared<std::string>();
+    auto closed = std::make_shared<std::promise<void>>();
+    auto future = closed->get_future();
+    std::shared_ptr<trantor::TcpClient> client;
+    loop->runInLoop([&]() {
+        client = std::make_shared<trantor::TcpClient>(
+            loop, trantor::InetAddress("127.0.0.1", port), "raw");
+        client->setConnectionCallback(
+            [loop, pieces, interval, closed](
+                const trantor::TcpConnectionPtr &conn) {
+                if (!conn->connected())
+                {
+                    closed->set_value();
+                    return;
+                }
+                if (interval <= 0)
+                {
+                    for (auto &piece : pieces)
+                        conn->send(piece);
+                    return;
+                }
+                std::weak_ptr<trantor::TcpConnection> weakConn = conn;
+                for (size_t i = 0; i < pieces.size(); ++i)
+                {
+                    loop->runAfter(interval * i,
+                                   [weakConn, piece = pieces[i]]() {
+                                       if (auto conn = weakConn.lock())
+                                           conn->send(piece);
+                                   });
+                }
+            });
+        client->setMessageCallback(
+            [received](const trantor::TcpConnectionPtr &,
+                       trantor::MsgBuffer *buffer) {
+                received->append(buffer->peek(), buffer->readableBytes());
+                buffer->retrieveAll();
+            });
+        client->connect();
+    });
+    auto status = future.wait_for(std::chrono::seconds(10));
+    std::promise<std::string> result;
+    loop->runInLoop([&]() {
+        client.reset();
+        result.set_value(status == std::future_status::ready
+                             ? *received
+                             : std::string());
+    });
+    return result.get_future().get();
+}
+
+inline std::string rawExchange(uint16_t port, const std::string &data)
+{
+    return rawExchange(port, std::vector<std::string>{data});
+}
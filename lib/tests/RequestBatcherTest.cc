@@ -0,0 +1,131 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <drogon/plugins/RequestBatcher.h>
+#include <drogon/drogon.h>
+#include <drogon/HttpTypes.h>
+
+using namespace drogon;
+
+DROGON_TEST(RequestBatcher)
+{
+    auto client =
+        HttpClient::newHttpClient("http://127.0.0.1:8018",
+                                  HttpAppFramework::instance().getLoop());
+
+    auto newRequest = [](const Json::Value &body) {
+        auto req = HttpRequest::newHttpJsonRequest(body);
+        req->setMethod(Post);
+        req->setPath("/batch");
+        req->addHeader("authorization", "Bearer token");
+        return req;
+    };
+
+    // 1. The responses are in the order of the requests
+    {
+        Json::Value body;
+        auto &requests = body["requests"];
+        requests[0]["path"] = "/BatchController/echo?name=a";
+        requests[1]["method"] = "POST";
+        requests[1]["path"] = "/BatchController/echo";
+        requests[1]["headers"]["content-type"] = "text/plain";
+        requests[1]["body"] = "b";
+        requests[2]["path"] = "/BatchController/missing";
+        requests[3]["path"] = "/batch";
+        client->sendRequest(
+            newRequest(body),
+            [TEST_CTX](ReqResult res, const HttpResponsePtr &resp) {
+                REQUIRE(res == ReqResult::Ok);
+                CHECK(resp->getStatusCode() == k200OK);
+                auto json = resp->getJsonObject();
+                REQUIRE(json != nullptr);
+                auto &responses = (*json)["responses"];
+                REQUIRE(responses.size() == 4);
+                CHECK(responses[0]["status"].asInt() == 200);
+                CHECK(responses[0]["body"].asString() ==
+                      "GET a Bearer token");
+                CHECK(responses[1]["status"].asInt() == 200);
+                CHECK(responses[1]["body"].asString() ==
+                      "POST b Bearer token");
+                CHECK(responses[2]["status"].asInt() == 404);
+                // Nested batches are rejected
+                CHECK(responses[3]["status"].asInt() == 400);
+            });
+    }
+    // 2. Too many requests
+    {
+        Json::Value body;
+        for (Json::ArrayIndex i = 0; i < 3; ++i)
+            body["requests"][i]["path"] = "/BatchController/echo";
+        client->sendRequest(
+            newRequest(body),
+            [TEST_CTX](ReqResult res, const HttpResponsePtr &resp) {
+                REQUIRE(res == ReqResult::Ok);
+                CHECK(resp->getStatusCode() == k400BadRequest);
+            });
+    }
+}
+
+class BatchController : public drogon::HttpController<BatchController>
+{
+  public:
+    METHOD_LIST_BEGIN
+    METHOD_ADD(BatchController::echo, "/echo", Get, Post);
+    METHOD_LIST_END
+
+    void echo(const HttpRequestPtr &req,
+              std::function<void(const HttpResponsePtr &)> &&callback)
+    {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setContentTypeCode(drogon::CT_TEXT_PLAIN);
+        auto value = req->method() == Get ? req->getParameter("name")
+                                          : std::string(req->body());
+        resp->setBody(std::string(req->methodString()) + " " + value + " " +
+                      req->getHeader("authorization"));
+        callback(resp);
+    }
+};
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::stringstream ss;
+    ss << R"({
+    "listeners": [
+        {
+            "address": "0.0.0.0",
+            "port": 8018
+        }
+    ],
+    "plugins": [
+        {
+            "name": "drogon::plugin::RequestBatcher",
+            "config": {
+                "max_requests": 4
+            }
+        }
+    ]
+})";
+    Json::Value config;
+    ss >> config;
+
+    std::thread thr([&]() {
+        app().loadConfigJson(config);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
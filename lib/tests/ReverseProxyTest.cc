@@ -0,0 +1,188 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <drogon/HttpController.h>
+#include <drogon/plugins/ReverseProxy.h>
+#include <trantor/net/TcpConnection.h>
+#include "../src/HttpRequestImpl.h"
+#include <future>
+#include <string>
+#include <thread>
+
+using namespace drogon;
+
+// The upstream server, reached through the proxy on the same listener. Its
+// paths don't start with the prefix of the proxy.
+class ReverseProxyUpstream : public HttpController<ReverseProxyUpstream>
+{
+  public:
+    METHOD_LIST_BEGIN
+    METHOD_ADD(ReverseProxyUpstream::headers, "/headers", Get);
+    METHOD_ADD(ReverseProxyUpstream::echo, "/echo", Post);
+    METHOD_ADD(ReverseProxyUpstream::drop, "/drop", Post);
+    METHOD_LIST_END
+
+    void headers(const HttpRequestPtr &req,
+                 std::function<void(const HttpResponsePtr &)> &&callback)
+    {
+        Json::Value json;
+        for (auto &[field, value] : req->headers())
+        {
+            json[field] = value;
+        }
+        auto resp = HttpResponse::newHttpJsonResponse(json);
+        resp->addHeader("keep-alive", "timeout=5");
+        resp->addHeader("proxy-connection", "keep-alive");
+        resp->addHeader("te", "trailers");
+        resp->addHeader("upgrade", "example");
+        resp->addHeader("x-custom", "upstream");
+        callback(resp);
+    }
+
+    void echo(const HttpRequestPtr &req,
+              std::function<void(const HttpResponsePtr &)> &&callback)
+    {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setBody(std::string(req->body()));
+        callback(resp);
+    }
+
+    void drop(const HttpRequestPtr &req,
+              std::function<void(const HttpResponsePtr &)> &&callback)
+    {
+        // The connection is closed before the response is written.
+        auto reqImpl = static_cast<HttpRequestImpl *>(req.get());
+        if (auto conn = reqImpl->getConnectionPtr().lock())
+            conn->forceClose();
+        callback(HttpResponse::newHttpResponse());
+    }
+};
+
+static HttpClientPtr newClient()
+{
+    return HttpClient::newHttpClient("http://127.0.0.1:8021");
+}
+
+DROGON_TEST(ReverseProxyHeaders)
+{
+    auto client = newClient();
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/proxy/ReverseProxyUpstream/headers");
+    req->addHeader("keep-alive", "timeout=5");
+    req->addHeader("proxy-connection", "keep-alive");
+    req->addHeader("te", "trailers");
+    req->addHeader("trailer", "x-checksum");
+    req->addHeader("x-custom", "downstream");
+    req->addHeader("x-forwarded-for", "10.0.0.1");
+    auto [result, resp] = client->sendRequest(req, 5);
+    REQUIRE(result == ReqResult::Ok);
+    REQUIRE(resp->getStatusCode() == k200OK);
+    auto json = resp->getJsonObject();
+    REQUIRE(json != nullptr);
+
+    // The headers of the downstream connection don't reach the upstream.
+    CHECK(!json->isMember("keep-alive"));
+    CHECK(!json->isMember("proxy-connection"));
+    CHECK(!json->isMember("te"));
+    CHECK(!json->isMember("trailer"));
+    CHECK((*json)["x-custom"].asString() == "downstream");
+    // The address of the client is appended to the received one.
+    CHECK((*json)["x-forwarded-for"].asString() == "10.0.0.1, 127.0.0.1");
+
+    // The headers of the upstream connection don't reach the client.
+    CHECK(resp->getHeader("keep-alive").empty());
+    CHECK(resp->getHeader("proxy-connection").empty());
+    CHECK(resp->getHeader("te").empty());
+    CHECK(resp->getHeader("upgrade").empty());
+    CHECK(resp->getHeader("x-custom") == "upstream");
+    CHECK(resp->getContentType() == CT_APPLICATION_JSON);
+
+    // Without a received header, the address of the client is the only one.
+    req = HttpRequest::newHttpRequest();
+    req->setPath("/proxy/ReverseProxyUpstream/headers");
+    std::tie(result, resp) = client->sendRequest(req, 5);
+    REQUIRE(result == ReqResult::Ok);
+    json = resp->getJsonObject();
+    REQUIRE(json != nullptr);
+    CHECK((*json)["x-forwarded-for"].asString() == "127.0.0.1");
+}
+
+DROGON_TEST(ReverseProxyUpstreamFailure)
+{
+    auto client = newClient();
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/proxy/ReverseProxyUpstream/drop");
+    req->setMethod(Post);
+    req->setBody("dropped");
+    auto [result, resp] = client->sendRequest(req, 5);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->getStatusCode() == k502BadGateway);
+
+    // The upstream isn't marked down by one failure.
+    req = HttpRequest::newHttpRequest();
+    req->setPath("/proxy/ReverseProxyUpstream/echo");
+    req->setMethod(Post);
+    req->setBody("after failure");
+    std::tie(result, resp) = client->sendRequest(req, 5);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->getStatusCode() == k200OK);
+    CHECK(resp->body() == "after failure");
+}
+
+DROGON_TEST(ReverseProxyStreamedBody)
+{
+    auto client = newClient();
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/proxy/ReverseProxyUpstream/echo");
+    req->setMethod(Post);
+    std::promise<std::pair<ReqResult, HttpResponsePtr>> promise;
+    auto body = client->sendStreamRequest(
+        req, [&promise](ReqResult result, const HttpResponsePtr &resp) {
+            promise.set_value({result, resp});
+        });
+    // The pieces are sent apart, so the proxy forwards the body before it
+    // is received in whole.
+    std::string sent;
+    for (int i = 0; i < 8; ++i)
+    {
+        std::string piece(64 * 1024, static_cast<char>('a' + i));
+        CHECK(body->send(piece));
+        sent.append(piece);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    body->close();
+    auto [result, resp] = promise.get_future().get();
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->getStatusCode() == k200OK);
+    CHECK(resp->body().length() == sent.length());
+    CHECK(resp->body() == sent);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        Json::Value config;
+        config["upstreams"].append("http://127.0.0.1:8021");
+        config["path_prefix"] = "/proxy";
+        config["strip_prefix"] = true;
+        config["retries"] = 0;
+        config["max_fails"] = 100;
+        app().addListener("127.0.0.1", 8021).enableRequestStream();
+        app().addPlugin("drogon::plugin::ReverseProxy", {}, config);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
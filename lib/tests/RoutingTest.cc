@@ -0,0 +1,189 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <future>
+#include <string>
+
+using namespace drogon;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static HttpResponsePtr textResponse(const std::string &text)
+{
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setBody(text);
+    return resp;
+}
+
+// The routes are registered in this order, the first registered matching
+// route wins among the ones which are not static.
+static void registerRoutes()
+{
+    app()
+        .registerHandler(
+            "/items/{id}",
+            [](const HttpRequestPtr &, Callback &&callback, std::string id) {
+                callback(textResponse("item:" + id));
+            },
+            {Get})
+        .registerHandler(
+            "/items/new",
+            [](const HttpRequestPtr &, Callback &&callback) {
+                callback(textResponse("new"));
+            },
+            {Get})
+        .registerHandler(
+            "/items/{id}/parts/{part}",
+            [](const HttpRequestPtr &,
+               Callback &&callback,
+               std::string id,
+               std::string part) {
+                callback(textResponse("part:" + id + "/" + part));
+            },
+            {Get})
+        .registerHandler(
+            "/items/{id}/parts/first",
+            [](const HttpRequestPtr &, Callback &&callback, std::string id) {
+                callback(textResponse("first:" + id));
+            },
+            {Get})
+        .registerHandler(
+            "/orders/{2}/{1}",
+            [](const HttpRequestPtr &,
+               Callback &&callback,
+               std::string second,
+               std::string first) {
+                callback(textResponse("order:" + first + "," + second));
+            },
+            {Get})
+        .registerHandlerViaRegex(
+            "/files/([a-z]+)\\.txt",
+            [](const HttpRequestPtr &, Callback &&callback, std::string name) {
+                callback(textResponse("regex-file:" + name));
+            },
+            {Get})
+        .registerHandler(
+            "/files/{name}",
+            [](const HttpRequestPtr &, Callback &&callback, std::string name) {
+                callback(textResponse("file:" + name));
+            },
+            {Get})
+        .registerHandler(
+            "/docs/{name}",
+            [](const HttpRequestPtr &, Callback &&callback, std::string name) {
+                callback(textResponse("doc:" + name));
+            },
+            {Get})
+        .registerHandlerViaRegex(
+            "/docs/(.*)",
+            [](const HttpRequestPtr &, Callback &&callback, std::string path) {
+                callback(textResponse("regex-doc:" + path));
+            },
+            {Get});
+}
+
+static std::pair<ReqResult, HttpResponsePtr> request(
+    const std::string &path,
+    HttpMethod method = Get)
+{
+    static auto client = HttpClient::newHttpClient("http://127.0.0.1:8022");
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath(path);
+    req->setMethod(method);
+    return client->sendRequest(req, 5);
+}
+
+static std::string body(const std::string &path)
+{
+    auto [result, resp] = request(path);
+    if (result != ReqResult::Ok || resp->statusCode() != k200OK)
+        return "status:" + std::to_string(resp ? resp->statusCode() : 0);
+    return std::string(resp->body());
+}
+
+DROGON_TEST(RoutingStaticAndParameters)
+{
+    // The static path wins over the parameter, though registered later.
+    CHECK(body("/items/new") == "new");
+    CHECK(body("/items/42") == "item:42");
+    // The paths are matched without case, the parameters keep theirs.
+    CHECK(body("/ITEMS/New") == "new");
+    CHECK(body("/Items/AbC") == "item:AbC");
+
+    // The first registered of the parameterized routes wins, the literal
+    // segment registered later doesn't.
+    CHECK(body("/items/7/parts/first") == "part:7/first");
+    CHECK(body("/items/7/parts/wheel") == "part:7/wheel");
+
+    // The numbered placeholders are bound to their parameters.
+    CHECK(body("/orders/b/a") == "order:a,b");
+}
+
+DROGON_TEST(RoutingTrailingSlashes)
+{
+    // An empty segment is an empty parameter, as with the regex.
+    CHECK(body("/items/") == "item:");
+    // The trailing slash is one more segment, no route has it.
+    CHECK(body("/items/42/") == "status:404");
+    CHECK(body("/items/42/parts/") == "part:42/");
+    CHECK(body("/items/42/parts/x/") == "status:404");
+}
+
+DROGON_TEST(RoutingRegexFallback)
+{
+    // The regex registered before the parameter wins for the paths both
+    // match.
+    CHECK(body("/files/readme.txt") == "regex-file:readme");
+    CHECK(body("/files/readme.md") == "file:readme.md");
+    CHECK(body("/files/a/b.txt") == "status:404");
+
+    // The parameter registered before the regex wins, the regex gets the
+    // paths which the trie doesn't match.
+    CHECK(body("/docs/intro") == "doc:intro");
+    CHECK(body("/docs/guide/intro") == "regex-doc:guide/intro");
+    CHECK(body("/docs/") == "doc:");
+}
+
+DROGON_TEST(RoutingMethodNotAllowed)
+{
+    // A static path with another method is not allowed.
+    auto [result, resp] = request("/items/new", Post);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k405MethodNotAllowed);
+
+    // The parameterized and the regex routes only match with their methods,
+    // as with the former linear search.
+    std::tie(result, resp) = request("/items/42", Post);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k404NotFound);
+    std::tie(result, resp) = request("/docs/guide/intro", Delete);
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k404NotFound);
+
+    std::tie(result, resp) = request("/nothing/here");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k404NotFound);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        registerRoutes();
+        app().addListener("127.0.0.1", 8022);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
@@ -0,0 +1,107 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+DROGON_TEST(RuntimeStats)
+{
+    // A keep-alive connection and a request waiting for its response
+    auto idleClient = HttpClient::newHttpClient("http://127.0.0.1:8044");
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/hello");
+    auto [result, resp] = idleClient->sendRequest(req, 5);
+    REQUIRE(result == ReqResult::Ok);
+
+    auto slowClient = HttpClient::newHttpClient("http://127.0.0.1:8044");
+    auto slowResult = std::make_shared<std::promise<ReqResult>>();
+    auto slowFuture = slowResult->get_future();
+    req = HttpRequest::newHttpRequest();
+    req->setPath("/slow");
+    slowClient->sendRequest(req,
+                            [slowResult](ReqResult result,
+                                         const HttpResponsePtr &) {
+                                slowResult->set_value(result);
+                            });
+    std::this_thread::sleep_for(200ms);
+
+    auto statsClient = HttpClient::newHttpClient("http://127.0.0.1:8044");
+    req = HttpRequest::newHttpRequest();
+    req->setPath("/debug/stats");
+    std::tie(result, resp) = statsClient->sendRequest(req, 5);
+    REQUIRE(result == ReqResult::Ok);
+    REQUIRE(resp->statusCode() == k200OK);
+    auto json = resp->getJsonObject();
+    REQUIRE(json != nullptr);
+
+    // Every loop reports its stats in its own item.
+    auto &loops = (*json)["loops"];
+    REQUIRE(loops.isArray());
+    REQUIRE(loops.size() == 2);
+    Json::UInt64 connections = 0;
+    Json::UInt64 pipelined = 0;
+    for (Json::ArrayIndex i = 0; i < loops.size(); ++i)
+    {
+        CHECK(loops[i]["loop"].asUInt64() == i);
+        CHECK(loops[i]["queue_delay"].asDouble() >= 0);
+        CHECK(loops[i]["http2_connections"].asUInt64() == 0);
+        CHECK(loops[i]["websocket_connections"].asUInt64() == 0);
+        connections += loops[i]["connections"].asUInt64();
+        pipelined += loops[i]["pipelined_requests"].asUInt64();
+    }
+    CHECK(connections == 3);
+    CHECK((*json)["connections"].asInt64() == 3);
+    // At least the slow request
+    CHECK(pipelined >= 1);
+    CHECK((*json)["db_clients"].isObject());
+    CHECK((*json)["redis_clients"].isObject());
+
+    CHECK(slowFuture.get() == ReqResult::Ok);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler("/hello",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 auto resp = HttpResponse::newHttpResponse();
+                                 resp->setBody("hello");
+                                 callback(resp);
+                             })
+            .registerHandler(
+                "/slow",
+                [](const HttpRequestPtr &, Callback &&callback) {
+                    trantor::EventLoop::getEventLoopOfCurrentThread()
+                        ->runAfter(1.0, [callback = std::move(callback)]() {
+                            callback(HttpResponse::newHttpResponse());
+                        });
+                })
+            .setThreadNum(2)
+            .addListener("127.0.0.1", 8044);
+        app().addPlugin("drogon::plugin::RuntimeStats", {}, Json::Value());
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
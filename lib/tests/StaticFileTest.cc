@@ -0,0 +1,158 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <drogon/utils/Utilities.h>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <string>
+#include <thread>
+
+using namespace drogon;
+
+static std::filesystem::path documentRoot;
+
+// Replace the file by renaming a new one, as the mapped files should be.
+static void writeFile(const std::string &name, const std::string &content)
+{
+    auto tmpPath = documentRoot / (name + ".tmp");
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file << content;
+    }
+    std::filesystem::rename(tmpPath, documentRoot / name);
+}
+
+static std::string pattern(size_t length, char first)
+{
+    std::string content(length, '\0');
+    for (size_t i = 0; i < length; ++i)
+        content[i] = static_cast<char>(first + i % 26);
+    return content;
+}
+
+static std::pair<ReqResult, HttpResponsePtr> get(const HttpClientPtr &client,
+                                                 const std::string &path,
+                                                 const std::string &range = {})
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath(path);
+    if (!range.empty())
+        req->addHeader("range", range);
+    return client->sendRequest(req, 5);
+}
+
+static HttpClientPtr newClient()
+{
+    return HttpClient::newHttpClient("http://127.0.0.1:8028");
+}
+
+DROGON_TEST(StaticFileMmap)
+{
+    auto client = newClient();
+    auto content = pattern(10000, 'a');
+    writeFile("mapped.txt", content);
+    auto [result, resp] = get(client, "/mapped.txt");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k200OK);
+    CHECK(resp->getContentType() == CT_TEXT_PLAIN);
+    CHECK(resp->body() == content);
+
+    // A range is a slice of the mapping.
+    std::tie(result, resp) = get(client, "/mapped.txt", "bytes=100-199");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k206PartialContent);
+    CHECK(resp->body() == content.substr(100, 100));
+    CHECK(resp->getHeader("content-range") == "bytes 100-199/10000");
+
+    // A replaced file is mapped again.
+    content = pattern(5000, 'A');
+    writeFile("mapped.txt", content);
+    std::tie(result, resp) = get(client, "/mapped.txt");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k200OK);
+    CHECK(resp->body() == content);
+
+    // The empty files can't be mapped, they are read.
+    writeFile("empty.txt", "");
+    std::tie(result, resp) = get(client, "/empty.txt");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k200OK);
+    CHECK(resp->body().empty());
+
+    // The big files are still sent by sendfile.
+    content = pattern(300 * 1024, 'a');
+    writeFile("big.txt", content);
+    std::tie(result, resp) = get(client, "/big.txt");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k200OK);
+    CHECK(resp->body().length() == content.length());
+    CHECK(resp->body() == content);
+}
+
+DROGON_TEST(StaticFileStatCache)
+{
+    auto client = newClient();
+    // The missing files are cached too, until the entries expire.
+    auto [result, resp] = get(client, "/later.txt");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k404NotFound);
+    writeFile("later.txt", "here now");
+    std::tie(result, resp) = get(client, "/later.txt");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k404NotFound);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    std::tie(result, resp) = get(client, "/later.txt");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k200OK);
+    CHECK(resp->body() == "here now");
+
+    // The big files are sent with the cached size, which is stat()ed again
+    // once its entry expired.
+    auto content = pattern(300 * 1024, 'a');
+    writeFile("growing.txt", content);
+    std::tie(result, resp) = get(client, "/growing.txt");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->body() == content);
+    content = pattern(400 * 1024, 'A');
+    writeFile("growing.txt", content);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    std::tie(result, resp) = get(client, "/growing.txt");
+    REQUIRE(result == ReqResult::Ok);
+    CHECK(resp->statusCode() == k200OK);
+    CHECK(resp->body().length() == content.length());
+    CHECK(resp->body() == content);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    documentRoot = std::filesystem::temp_directory_path() /
+                   ("drogon_static_file_test_" + utils::getUuid());
+    std::filesystem::create_directories(documentRoot);
+
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .setDocumentRoot(documentRoot.string())
+            .setMmapStatic(true)
+            // Every request is served from the file, not from the cache.
+            .setStaticFilesCacheTime(-1)
+            .setStaticFileStatCacheTime(1)
+            .addListener("127.0.0.1", 8028);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    std::filesystem::remove_all(documentRoot);
+    return testStatus;
+}
@@ -0,0 +1,68 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <chrono>
+#include <future>
+#include <set>
+#include <string>
+#include <thread>
+
+using namespace drogon;
+
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+DROGON_TEST(TlsSessionSharing)
+{
+    if (!utils::supportsTls())
+        return;
+    // Every client opens a connection of its own, the connections accepted
+    // by the listening thread are spread over all the IO loops.
+    std::set<std::string> loops;
+    for (int i = 0; i < 8; ++i)
+    {
+        auto client = HttpClient::newHttpClient("https://127.0.0.1:8041",
+                                                nullptr,
+                                                false,
+                                                false);
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath("/loop");
+        auto [result, resp] = client->sendRequest(req, 5);
+        REQUIRE(result == ReqResult::Ok);
+        CHECK(resp->statusCode() == k200OK);
+        loops.insert(std::string(resp->body()));
+    }
+    CHECK(loops.size() == 4);
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler("/loop",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 auto resp = HttpResponse::newHttpResponse();
+                                 resp->setBody(std::to_string(
+                                     app().getCurrentThreadIndex()));
+                                 callback(resp);
+                             })
+            .setThreadNum(4)
+            .enableTlsSessionSharing()
+            .setSSLFiles("server.crt", "server.key")
+            .addListener("127.0.0.1", 8041, true);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
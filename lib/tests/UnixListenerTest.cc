@@ -0,0 +1,131 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <future>
+#include <string>
+#include <thread>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+using namespace drogon;
+
+#ifndef _WIN32
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+static const std::string socketPath =
+    "/tmp/drogon_unix_listener_test_" + std::to_string(getpid()) + ".sock";
+
+static bool fillAddress(sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path))
+        return false;
+    memcpy(addr.sun_path, socketPath.data(), socketPath.size());
+    return true;
+}
+
+// Send the data on a connection to the socket and return the bytes received
+// until the server closes it, or an empty string on errors.
+static std::string unixExchange(const std::string &data)
+{
+    sockaddr_un addr;
+    if (!fillAddress(addr))
+        return {};
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return {};
+    timeval timeout{5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::string received;
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ==
+            0 &&
+        ::write(fd, data.data(), data.size()) == (ssize_t)data.size())
+    {
+        char buffer[4096];
+        ssize_t n;
+        while ((n = ::read(fd, buffer, sizeof(buffer))) > 0)
+            received.append(buffer, n);
+        if (n < 0)
+            received.clear();
+    }
+    ::close(fd);
+    return received;
+}
+
+// The file left by a process which didn't remove its socket
+static void makeStaleSocket()
+{
+    sockaddr_un addr;
+    if (!fillAddress(addr))
+        return;
+    ::unlink(socketPath.c_str());
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ::close(fd);
+}
+
+DROGON_TEST(UnixListener)
+{
+    // The stale socket file was replaced with the mode given.
+    struct stat st;
+    REQUIRE(stat(socketPath.c_str(), &st) == 0);
+    CHECK(S_ISSOCK(st.st_mode));
+    CHECK((st.st_mode & 0777) == 0600);
+
+    auto data = unixExchange(
+        "GET /hello HTTP/1.1\r\nhost: localhost\r\n\r\n"
+        "GET /hello HTTP/1.1\r\nhost: localhost\r\nconnection: close\r\n\r\n");
+    CHECK(data.find("HTTP/1.1 200 OK\r\n") == 0);
+    auto second = data.find("HTTP/1.1 200 OK\r\n", 1);
+    REQUIRE(second != std::string::npos);
+    CHECK(data.find("\r\n\r\nhello") < second);
+    CHECK(data.find("\r\n\r\nhello", second) != std::string::npos);
+}
+#endif
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+#ifndef _WIN32
+    makeStaleSocket();
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app()
+            .registerHandler("/hello",
+                             [](const HttpRequestPtr &, Callback &&callback) {
+                                 auto resp = HttpResponse::newHttpResponse();
+                                 resp->setBody("hello");
+                                 callback(resp);
+                             })
+            .setThreadNum(2)
+            .addUnixListener(socketPath, 0600);
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    // The socket file is removed with the listener.
+    if (access(socketPath.c_str(), F_OK) == 0)
+    {
+        LOG_ERROR << socketPath << " wasn't removed";
+        testStatus = 1;
+    }
+    return testStatus;
+#else
+    return test::run(argc, argv);
+#endif
+}
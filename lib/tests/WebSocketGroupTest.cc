@@ -0,0 +1,308 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/WebSocketClient.h>
+#include <drogon/WebSocketConnectionGroup.h>
+#include <drogon/WebSocketController.h>
+#include <drogon/WebSocketTopicRegistry.h>
+#include <drogon/utils/Utilities.h>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+// Released in the tests, while the IO loops still run.
+auto group = std::make_shared<WebSocketConnectionGroup>();
+// Created once the number of IO threads is set.
+std::shared_ptr<WebSocketTopicRegistry> registry;
+// The server side of the connections, by the name of their clients
+std::mutex connectionsMutex;
+std::map<std::string, WebSocketConnectionPtr> connections;
+
+class GroupController : public WebSocketController<GroupController>
+{
+  public:
+    WS_PATH_LIST_BEGIN
+    WS_PATH_ADD("/group");
+    WS_PATH_LIST_END
+
+    void handleNewMessage(const WebSocketConnectionPtr &,
+                          std::string &&,
+                          const WebSocketMessageType &) override
+    {
+    }
+
+    void handleNewConnection(const HttpRequestPtr &req,
+                             const WebSocketConnectionPtr &conn) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            connections[req->getParameter("name")] = conn;
+        }
+        group->add(conn);
+    }
+
+    void handleConnectionClosed(const WebSocketConnectionPtr &) override
+    {
+    }
+};
+
+class TopicController : public WebSocketController<TopicController>
+{
+  public:
+    WS_PATH_LIST_BEGIN
+    WS_PATH_ADD("/topics");
+    WS_PATH_LIST_END
+
+    void handleNewMessage(const WebSocketConnectionPtr &,
+                          std::string &&,
+                          const WebSocketMessageType &) override
+    {
+    }
+
+    void handleNewConnection(const HttpRequestPtr &req,
+                             const WebSocketConnectionPtr &conn) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            connections[req->getParameter("name")] = conn;
+        }
+        for (auto &topic : utils::splitString(req->getParameter("topics"), ","))
+        {
+            registry->subscribe(topic, conn);
+        }
+    }
+
+    void handleConnectionClosed(const WebSocketConnectionPtr &) override
+    {
+    }
+};
+
+// A client recording the messages it receives
+struct Client
+{
+    WebSocketClientPtr client;
+    std::mutex mutex;
+    std::vector<std::string> messages;
+
+    std::vector<std::string> received()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return messages;
+    }
+};
+
+static std::shared_ptr<Client> connect(const std::string &name,
+                                       const std::string &topics = {})
+{
+    auto client = std::make_shared<Client>();
+    client->client = WebSocketClient::newWebSocketClient("127.0.0.1", 8025);
+    std::weak_ptr<Client> weakClient = client;
+    client->client->setMessageHandler(
+        [weakClient](std::string &&message,
+                     const WebSocketClientPtr &,
+                     const WebSocketMessageType &type) {
+            auto client = weakClient.lock();
+            if (!client || type != WebSocketMessageType::Text)
+                return;
+            std::lock_guard<std::mutex> lock(client->mutex);
+            client->messages.push_back(std::move(message));
+        });
+    auto req = HttpRequest::newHttpRequest();
+    if (topics.empty())
+    {
+        req->setPath("/group");
+    }
+    else
+    {
+        req->setPath("/topics");
+        req->setParameter("topics", topics);
+    }
+    req->setParameter("name", name);
+    std::promise<ReqResult> connected;
+    client->client->connectToServer(
+        req,
+        [&connected](ReqResult result,
+                     const HttpResponsePtr &,
+                     const WebSocketClientPtr &) {
+            connected.set_value(result);
+        });
+    if (connected.get_future().get() != ReqResult::Ok)
+        return nullptr;
+    return client;
+}
+
+// Wait until the condition is true, the group is updated in the IO loops.
+static bool waitFor(const std::function<bool()> &condition)
+{
+    for (int i = 0; i < 200; ++i)
+    {
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(10ms);
+    }
+    return condition();
+}
+
+static WebSocketConnectionPtr serverConnection(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    auto iter = connections.find(name);
+    return iter == connections.end() ? nullptr : iter->second;
+}
+
+DROGON_TEST(WebSocketConnectionGroup)
+{
+    auto first = connect("first");
+    auto second = connect("second");
+    auto third = connect("third");
+    REQUIRE(first != nullptr);
+    REQUIRE(second != nullptr);
+    REQUIRE(third != nullptr);
+    REQUIRE(waitFor([]() { return group->size() == 3; }));
+
+    // A message reaches all the connections, in every IO loop.
+    group->broadcast("hello");
+    for (auto &client : {first, second, third})
+    {
+        CHECK(waitFor([&client]() { return client->received().size() == 1; }));
+        CHECK(client->received().front() == "hello");
+    }
+
+    // A closed connection is still counted until the next broadcast.
+    first->client->stop();
+    REQUIRE(waitFor([]() {
+        auto conn = serverConnection("first");
+        return conn && conn->disconnected();
+    }));
+    CHECK(group->size() == 3);
+    group->broadcast("again");
+    CHECK(waitFor([]() { return group->size() == 2; }));
+    for (auto &client : {second, third})
+    {
+        CHECK(waitFor([&client]() { return client->received().size() == 2; }));
+        CHECK(client->received().back() == "again");
+    }
+    CHECK(first->received().size() == 1);
+
+    // A removed connection stays open but gets no more messages.
+    group->remove(serverConnection("second"));
+    CHECK(waitFor([]() { return group->size() == 1; }));
+    group->broadcast("last");
+    CHECK(waitFor([&third]() { return third->received().size() == 3; }));
+    // Leave the time for a message to the second one to arrive.
+    std::this_thread::sleep_for(100ms);
+    CHECK(second->received().size() == 2);
+    CHECK(serverConnection("second")->connected());
+
+    // Removing twice, or from a group the connection isn't in, does nothing.
+    group->remove(serverConnection("second"));
+    WebSocketConnectionGroup other;
+    other.remove(serverConnection("third"));
+    CHECK(other.size() == 0);
+    std::this_thread::sleep_for(50ms);
+    CHECK(group->size() == 1);
+
+    second->client->stop();
+    third->client->stop();
+    group.reset();
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    connections.clear();
+}
+
+DROGON_TEST(WebSocketTopicRegistry)
+{
+    // The connections are spread over the two IO loops, so every topic has
+    // subscribers in both shards.
+    auto a = connect("a", "news,sports");
+    auto b = connect("b", "news");
+    auto c = connect("c", "sports");
+    auto d = connect("d", "news");
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    REQUIRE(c != nullptr);
+    REQUIRE(d != nullptr);
+    REQUIRE(waitFor([]() { return registry->size() == 5; }));
+
+    auto received = [](const std::shared_ptr<Client> &client, size_t count) {
+        return waitFor([&client, count]() {
+            return client->received().size() == count;
+        });
+    };
+    registry->publish("news", "n1");
+    CHECK(received(a, 1));
+    CHECK(received(b, 1));
+    CHECK(received(d, 1));
+    registry->publish("sports", "s1");
+    CHECK(received(a, 2));
+    CHECK(received(c, 1));
+    CHECK((a->received() == std::vector<std::string>{"n1", "s1"}));
+    CHECK(b->received() == std::vector<std::string>{"n1"});
+    CHECK(c->received() == std::vector<std::string>{"s1"});
+    // Nobody subscribes to the topic.
+    registry->publish("weather", "w1");
+
+    // Out of all its topics at once
+    registry->unsubscribeAll(serverConnection("a"));
+    CHECK(waitFor([]() { return registry->size() == 3; }));
+    registry->unsubscribe("news", serverConnection("d"));
+    // Not subscribed to the topic
+    registry->unsubscribe("sports", serverConnection("d"));
+    CHECK(waitFor([]() { return registry->size() == 2; }));
+    registry->publish("news", "n2");
+    registry->publish("sports", "s2");
+    CHECK(received(b, 2));
+    CHECK(received(c, 2));
+    std::this_thread::sleep_for(100ms);
+    CHECK(a->received().size() == 2);
+    CHECK(d->received().size() == 1);
+
+    // A closed subscriber is removed when its topic is published to.
+    b->client->stop();
+    REQUIRE(waitFor([]() {
+        auto conn = serverConnection("b");
+        return conn && conn->disconnected();
+    }));
+    CHECK(registry->size() == 2);
+    registry->publish("sports", "s3");
+    CHECK(received(c, 3));
+    CHECK(registry->size() == 2);
+    registry->publish("news", "n3");
+    CHECK(waitFor([]() { return registry->size() == 1; }));
+
+    for (auto &client : {a, c, d})
+        client->client->stop();
+    registry.reset();
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    connections.clear();
+}
+
+// -- main
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+
+    std::thread thr([&]() {
+        app().addListener("127.0.0.1", 8025).setThreadNum(2);
+        registry = std::make_shared<WebSocketTopicRegistry>();
+        app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
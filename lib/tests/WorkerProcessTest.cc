@@ -0,0 +1,183 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <drogon/utils/Utilities.h>
+#include <trantor/net/EventLoopThread.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+#ifndef _WIN32
+using Callback = std::function<void(const HttpResponsePtr &)>;
+
+// Made in the main thread of each worker, the one which forked it.
+static std::string workerUuid;
+
+// Fork the process running the application in two workers, it returns when
+// the workers exited.
+static pid_t startSupervisor(uint16_t port)
+{
+    auto pid = fork();
+    if (pid != 0)
+        return pid;
+    // The workers inherit the random bytes buffered in this thread.
+    utils::getUuidV4();
+    app()
+        .registerBeginningAdvice([]() { workerUuid = utils::getUuidV4(); })
+        .registerHandler("/info",
+                         [](const HttpRequestPtr &, Callback &&callback) {
+                             Json::Value json;
+                             json["index"] = static_cast<Json::UInt64>(
+                                 app().getWorkerIndex());
+                             json["pid"] = static_cast<Json::Int64>(getpid());
+                             json["uuid"] = workerUuid;
+                             callback(HttpResponse::newHttpJsonResponse(json));
+                         })
+        .registerHandler("/crash",
+                         [](const HttpRequestPtr &, Callback &&) {
+                             kill(getpid(), SIGKILL);
+                         })
+        .addListener("127.0.0.1", port)
+        .setWorkerProcessNum(2);
+    app().run();
+    _exit(0);
+}
+
+struct WorkerInfo
+{
+    pid_t pid;
+    std::string uuid;
+};
+
+// Ask the workers by new connections until both answered, the kernel
+// spreads the connections over them.
+static std::map<size_t, WorkerInfo> collectWorkers(uint16_t port,
+                                                   trantor::EventLoop *loop)
+{
+    std::map<size_t, WorkerInfo> workers;
+    for (int i = 0; i < 400 && workers.size() < 2; ++i)
+    {
+        auto client = HttpClient::newHttpClient(
+            "http://127.0.0.1:" + std::to_string(port), loop);
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath("/info");
+        auto [result, resp] = client->sendRequest(req, 2);
+        if (result != ReqResult::Ok || !resp->getJsonObject())
+        {
+            // Not listening yet, or a worker is being restarted
+            std::this_thread::sleep_for(50ms);
+            continue;
+        }
+        auto &json = *resp->getJsonObject();
+        workers[json["index"].asUInt64()] = {
+            static_cast<pid_t>(json["pid"].asInt64()),
+            json["uuid"].asString()};
+    }
+    return workers;
+}
+
+// Send SIGTERM to the supervisor and return its exit status, -1 if it
+// doesn't exit in time.
+static int stopSupervisor(pid_t pid)
+{
+    kill(pid, SIGTERM);
+    for (int i = 0; i < 200; ++i)
+    {
+        int status = 0;
+        if (waitpid(pid, &status, WNOHANG) == pid)
+            return status;
+        std::this_thread::sleep_for(50ms);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    return -1;
+}
+
+DROGON_TEST(WorkerProcessesRespawn)
+{
+    // Forked before the loop thread is started
+    auto supervisor = startSupervisor(8026);
+    REQUIRE(supervisor > 0);
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto workers = collectWorkers(8026, loopThread.getLoop());
+    if (workers.size() < 2)
+        stopSupervisor(supervisor);
+    REQUIRE(workers.size() == 2);
+    CHECK(workers[0].pid != workers[1].pid);
+    // The workers don't serve the bytes buffered by the supervisor.
+    CHECK(workers[0].uuid.size() == 36);
+    CHECK(workers[0].uuid != workers[1].uuid);
+
+    // A crashed worker is forked again with the same index.
+    auto client = HttpClient::newHttpClient("http://127.0.0.1:8026",
+                                            loopThread.getLoop());
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/crash");
+    CHECK(client->sendRequest(req, 2).first != ReqResult::Ok);
+    bool respawned = false;
+    for (int i = 0; i < 50 && !respawned; ++i)
+    {
+        auto current = collectWorkers(8026, loopThread.getLoop());
+        if (current.size() < 2)
+        {
+            // The supervisor waits a second before forking it.
+            std::this_thread::sleep_for(100ms);
+            continue;
+        }
+        for (auto &[index, worker] : current)
+        {
+            if (worker.pid == workers[index].pid)
+                continue;
+            respawned = true;
+            CHECK(worker.uuid != workers[index].uuid);
+            CHECK(worker.uuid != current[1 - index].uuid);
+        }
+    }
+    CHECK(respawned);
+
+    auto status = stopSupervisor(supervisor);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+}
+
+DROGON_TEST(WorkerProcessesSigterm)
+{
+    // Forked before the loop thread is started
+    auto supervisor = startSupervisor(8027);
+    REQUIRE(supervisor > 0);
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto workers = collectWorkers(8027, loopThread.getLoop());
+    if (workers.size() < 2)
+        stopSupervisor(supervisor);
+    REQUIRE(workers.size() == 2);
+
+    // The signal is forwarded to the workers, the supervisor exits once
+    // they all quit and are reaped.
+    auto status = stopSupervisor(supervisor);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+    for (auto &[index, worker] : workers)
+    {
+        (void)index;
+        CHECK(kill(worker.pid, 0) == -1);
+    }
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    trantor::Logger::setLogLevel(trantor::Logger::kInfo);
+    return test::run(argc, argv);
+}
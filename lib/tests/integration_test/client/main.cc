@@ -630,6 +630,55 @@ void doTest(const HttpClientPtr &client, std::shared_ptr<test::Case> TEST_CTX)
                             REQUIRE(result == ReqResult::Ok);
                             CHECK(resp->getBody() == "Hello, World!");
                         });
+    /// Test views rendering their sub-views into the same body, the second
+    /// rendering is shorter than the first one.
+    req = HttpRequest::newHttpRequest();
+    req->setPath("/listpara");
+    req->setParameter("name", "a long parameter value");
+    client->sendRequest(
+        req, [req, TEST_CTX](ReqResult result, const HttpResponsePtr &resp) {
+            REQUIRE(result == ReqResult::Ok);
+            auto body = resp->getBody();
+            CHECK(body.find("<title>list parameters</title>") !=
+                  std::string_view::npos);
+            CHECK(body.find("drogon-white.jpg") != std::string_view::npos);
+            CHECK(body.find("a long parameter value") !=
+                  std::string_view::npos);
+            CHECK(body.find("</html>") != std::string_view::npos);
+        });
+    req = HttpRequest::newHttpRequest();
+    req->setPath("/listpara");
+    client->sendRequest(
+        req, [req, TEST_CTX](ReqResult result, const HttpResponsePtr &resp) {
+            REQUIRE(result == ReqResult::Ok);
+            auto body = resp->getBody();
+            CHECK(body.find("drogon-white.jpg") != std::string_view::npos);
+            CHECK(body.find("<H1>no parameter</H1>") !=
+                  std::string_view::npos);
+            CHECK(body.find("a long parameter value") ==
+                  std::string_view::npos);
+        });
+    /// Test the typed views, rendered by name and directly
+    for (bool direct : {false, true})
+    {
+        req = HttpRequest::newHttpRequest();
+        req->setPath("/typedview");
+        if (direct)
+            req->setParameter("direct", "1");
+        client->sendRequest(req,
+                            [req, TEST_CTX](ReqResult result,
+                                            const HttpResponsePtr &resp) {
+                                REQUIRE(result == ReqResult::Ok);
+                                auto body = resp->getBody();
+                                CHECK(body.find("<title>TypedView</title>") !=
+                                      std::string_view::npos);
+                                auto first = body.find("<li>first</li>");
+                                auto second = body.find("<li>second</li>");
+                                CHECK(first != std::string_view::npos);
+                                CHECK(second != std::string_view::npos);
+                                CHECK(first < second);
+                            });
+    }
     /// Test form post
     req = HttpRequest::newHttpFormPostRequest();
     req->setPath("/api/v1/apitest/form");
@@ -846,6 +895,31 @@ void doTest(const HttpClientPtr &client, std::shared_ptr<test::Case> TEST_CTX)
                             CHECK(resp->getBody() == "01234567890123456789");
                         });
 
+    // Several ranges are sent as the parts of a multipart/byteranges body
+    req = HttpRequest::newHttpRequest();
+    req->setPath("/range-test.txt");
+    req->addHeader("range", "bytes=0-9, 999990-");
+    client->sendRequest(
+        req, [req, TEST_CTX](ReqResult result, const HttpResponsePtr &resp) {
+            REQUIRE(result == ReqResult::Ok);
+            CHECK(resp->getStatusCode() == k206PartialContent);
+            auto &type = resp->getHeader("content-type");
+            auto pos = type.find("boundary=");
+            REQUIRE(type.rfind("multipart/byteranges", 0) == 0);
+            REQUIRE(pos != std::string::npos);
+            auto boundary = type.substr(pos + 9);
+            auto body = std::string(resp->getBody());
+            CHECK(body == "--" + boundary +
+                              "\r\nContent-Type: text/plain; charset=utf-8"
+                              "\r\nContent-Range: bytes 0-9/1000000\r\n\r\n"
+                              "0123456789\r\n--" +
+                              boundary +
+                              "\r\nContent-Type: text/plain; charset=utf-8"
+                              "\r\nContent-Range: bytes 999990-999999/1000000"
+                              "\r\n\r\n0123456789\r\n--" +
+                              boundary + "--\r\n");
+        });
+
     // Using .. to access a upper directory should be permitted as long as
     // it never leaves the document root
     req = HttpRequest::newHttpRequest();
@@ -3,6 +3,7 @@
 #include "CustomCtrl.h"
 #include "CustomHeaderFilter.h"
 #include "DigestAuthFilter.h"
+#include "TypedView.h"
 
 #include <drogon/drogon.h>
 #include <iostream>
@@ -238,6 +239,24 @@ int main()
                        int)>
         func = std::bind(&A::handle, &tmp, _1, _2, _3, _4, _5, _6);
     app().registerHandler("/api/v1/handle4/{4:p4}/{3:p3}/{1:p1}", func);
+    // Typed view example, rendered by name with the parameters in the view
+    // data or directly.
+    app().registerHandler(
+        "/typedview",
+        [](const HttpRequestPtr &req,
+           std::function<void(const HttpResponsePtr &)> &&callback) {
+            TypedView::Params params{"TypedView", {"first", "second"}};
+            if (req->getParameter("direct") == "1")
+            {
+                auto res = HttpResponse::newHttpResponse();
+                res->setBody(TypedView().genText(params));
+                callback(res);
+                return;
+            }
+            HttpViewData data;
+            data.insert("params", params);
+            callback(HttpResponse::newHttpViewResponse("TypedView", data));
+        });
     app().registerHandler(
         "/api/v1/this_will_fail",
         [](const HttpRequestPtr &req,
@@ -1,5 +1,6 @@
 #include <drogon/utils/Utilities.h>
 #include <drogon/drogon_test.h>
+#include "../../lib/src/SimdCodecs.h"
 #include <string>
 
 DROGON_TEST(Base64)
@@ -104,4 +105,33 @@ DROGON_TEST(Base64)
         auto encoded = "ZHJvZ29uIGZyYW1ld29ya=";
         CHECK(!drogon::utils::isBase64(encoded));
     }
+
+    SUBSECTION(SimdMatchesScalar)
+    {
+        // Every length around the blocks of the SIMD kernels, with a
+        // character outside the alphabet in the middle of a block.
+        std::string in;
+        for (int i = 0; i < 100; ++i)
+        {
+            in.append(1, char(i * 37));
+            std::string results[2];
+            for (bool simd : {false, true})
+            {
+                drogon::utils::internal::setSimdCodecsEnabled(simd);
+                auto encoded = drogon::utils::base64Encode(in, i % 2 == 0);
+                auto hex = drogon::utils::binaryStringToHex(
+                    reinterpret_cast<const unsigned char *>(in.data()),
+                    in.size(),
+                    i % 3 == 0);
+                CHECK(drogon::utils::hexToBinaryString(hex.data(),
+                                                       hex.size()) == in);
+                CHECK(drogon::utils::base64Decode(encoded) == in);
+                encoded.insert(encoded.size() / 2, 1, '*');
+                CHECK(drogon::utils::base64Decode(encoded) == in);
+                results[simd] = encoded + hex;
+            }
+            CHECK(results[0] == results[1]);
+        }
+        drogon::utils::internal::setSimdCodecsEnabled(true);
+    }
 }
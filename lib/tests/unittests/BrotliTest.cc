@@ -1,5 +1,6 @@
 #include <drogon/utils/Utilities.h>
 #include <drogon/drogon_test.h>
+#include "../../lib/src/StreamDecompressor.h"
 #include <string>
 #include <iostream>
 using namespace drogon::utils;
@@ -28,3 +29,33 @@ DROGON_TEST(BrotliTest)
         CHECK(source == decompressed);
     }
 }
+
+DROGON_TEST(BrotliStreamDecompression)
+{
+    std::string source;
+    for (size_t i = 0; i < 100000; i++)
+    {
+        source.append(std::to_string(i));
+    }
+    auto compressed = brotliCompress(source.data(), source.length());
+    auto decompressor = drogon::StreamDecompressor::newDecompressor("br");
+    REQUIRE(decompressor != nullptr);
+    std::string output;
+    auto append = [&output](const char *data, size_t length) {
+        output.append(data, length);
+        return true;
+    };
+    for (size_t pos = 0; pos < compressed.size(); pos += 1000)
+    {
+        auto length = (std::min)(size_t{1000}, compressed.size() - pos);
+        CHECK(
+            decompressor->decompress(compressed.data() + pos, length, append));
+    }
+    CHECK(decompressor->finished());
+    CHECK(output == source);
+
+    decompressor = drogon::StreamDecompressor::newDecompressor("br");
+    std::string garbage(100, 'x');
+    CHECK(decompressor->decompress(garbage.data(), garbage.size(), append) ==
+          false);
+}
@@ -4,6 +4,8 @@
 #include <trantor/net/EventLoopThread.h>
 
 #include <chrono>
+#include <memory>
+#include <vector>
 
 using namespace drogon;
 using namespace std::chrono_literals;
@@ -37,3 +39,33 @@ DROGON_TEST(CacheMapTest)
     cache.findAndFetch("zzz", content);
     CHECK(content == "-");
 }
+
+DROGON_TEST(CacheMapSharedTickerTest)
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+    {
+        // The caches of a loop with the same tick interval share a ticker.
+        std::vector<std::unique_ptr<CacheMap<std::string, int>>> caches;
+        for (int i = 0; i < 100; ++i)
+            caches.emplace_back(
+                std::make_unique<CacheMap<std::string, int>>(loop, 0.1f));
+        auto ticker = CacheMapTicker::get(loop, 0.1f);
+        CHECK(ticker->size() == 100);
+        CHECK(CacheMapTicker::get(loop, 0.2f) != ticker);
+
+        for (auto &cache : caches)
+            cache->insert("a", 1, 1);
+        caches[0]->insert("b", 2);
+        std::this_thread::sleep_for(2s);
+        for (auto &cache : caches)
+            CHECK(cache->find("a") == false);
+        CHECK(caches[0]->find("b") == true);
+
+        caches.resize(10);
+        CHECK(ticker->size() == 10);
+    }
+    // The ticker is released with the last cache.
+    CHECK(CacheMapTicker::get(loop, 0.1f)->size() == 0);
+}
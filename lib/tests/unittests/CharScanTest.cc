@@ -0,0 +1,47 @@
+#include "../../lib/src/CharScan.h"
+#include <drogon/drogon_test.h>
+#include <string>
+
+using namespace drogon::internal;
+
+DROGON_TEST(CharScanTest)
+{
+    // Every length and every position of the delimiter, to cover the SIMD
+    // blocks as well as the scalar tails.
+    for (size_t length = 0; length < 70; ++length)
+    {
+        std::string text(length, 'a');
+        const char *begin = text.data();
+        const char *end = begin + length;
+        CHECK(findEither(begin, end, ':', '\r') == end);
+        CHECK(findChar(begin, end, ' ') == end);
+        CHECK(findCRLF(begin, end) == nullptr);
+        for (size_t pos = 0; pos < length; ++pos)
+        {
+            text[pos] = ':';
+            CHECK(findEither(begin, end, ':', '\r') == begin + pos);
+            if (pos + 1 < length)
+            {
+                text[pos + 1] = '\r';
+                CHECK(findEither(begin + pos + 1, end, ':', '\r') ==
+                      begin + pos + 1);
+                text[pos + 1] = 'a';
+            }
+            text[pos] = ' ';
+            CHECK(findChar(begin, end, ' ') == begin + pos);
+            text[pos] = 'a';
+        }
+    }
+
+    std::string line = "Host: a\rb\r\n";
+    const char *begin = line.data();
+    const char *end = begin + line.size();
+    CHECK(findCRLF(begin, end) == begin + 9);
+    CHECK(findCRLF(begin, end - 1) == nullptr);
+    CHECK(findEither(begin, end, '\r', '\n') == begin + 7);
+    // Bytes above 0x7f don't match the signed comparisons by mistake.
+    std::string high(40, '\xff');
+    high[33] = '\x80';
+    CHECK(findEither(high.data(), high.data() + high.size(), '\x80', ':') ==
+          high.data() + 33);
+}
@@ -0,0 +1,69 @@
+#include <drogon/utils/CidrSet.h>
+#include <drogon/drogon_test.h>
+#include <stdexcept>
+
+using namespace drogon;
+
+static bool contains(const CidrSet &set, const std::string &ip)
+{
+    return set.contains(
+        trantor::InetAddress(ip, 0, ip.find(':') != std::string::npos));
+}
+
+DROGON_TEST(CidrSetTest)
+{
+    CidrSet set;
+    CHECK(set.empty());
+    CHECK(!contains(set, "10.0.0.1"));
+
+    set.add("10.0.0.0/8");
+    set.add("172.16.0.0/12");
+    set.add("192.168.1.1");
+    set.add("2001:db8::/32");
+    set.add("::1");
+    CHECK(set.size() == 5);
+
+    CHECK(contains(set, "10.255.0.1"));
+    CHECK(!contains(set, "11.0.0.1"));
+    CHECK(contains(set, "172.31.255.255"));
+    CHECK(!contains(set, "172.32.0.0"));
+    CHECK(contains(set, "192.168.1.1"));
+    CHECK(!contains(set, "192.168.1.2"));
+    CHECK(contains(set, "2001:db8:1::5"));
+    CHECK(!contains(set, "2001:db9::"));
+    CHECK(contains(set, "::1"));
+    CHECK(!contains(set, "::2"));
+    // The IPv4-mapped addresses match the IPv4 blocks
+    CHECK(contains(set, "::ffff:10.1.2.3"));
+    CHECK(!contains(set, "::ffff:11.1.2.3"));
+
+    SUBSECTION(Covered)
+    {
+        CidrSet blocks;
+        blocks.add("10.1.2.0/24");
+        blocks.add("10.1.3.0/24");
+        CHECK(!contains(blocks, "10.1.4.1"));
+        blocks.add("10.1.0.0/16");
+        CHECK(contains(blocks, "10.1.4.1"));
+        CHECK(contains(blocks, "10.1.2.1"));
+        blocks.add("10.1.5.0/24");
+        CHECK(contains(blocks, "10.1.5.1"));
+        CHECK(!contains(blocks, "10.2.0.1"));
+
+        CidrSet all;
+        all.add("0.0.0.0/0");
+        CHECK(contains(all, "8.8.8.8"));
+        CHECK(!contains(all, "2001:db8::1"));
+    }
+
+    SUBSECTION(BadBlocks)
+    {
+        CidrSet blocks;
+        CHECK_THROWS_AS(blocks.add("10.0.0.0/33"), std::runtime_error);
+        CHECK_THROWS_AS(blocks.add("::/129"), std::runtime_error);
+        CHECK_THROWS_AS(blocks.add("10.0.0.0/"), std::runtime_error);
+        CHECK_THROWS_AS(blocks.add("10.0.0.0/8a"), std::runtime_error);
+        CHECK_THROWS_AS(blocks.add("localhost"), std::runtime_error);
+        CHECK(blocks.empty());
+    }
+}
@@ -0,0 +1,52 @@
+#include <drogon/CircuitBreaker.h>
+#include <drogon/drogon_test.h>
+#include <chrono>
+#include <thread>
+
+using namespace drogon;
+
+DROGON_TEST(CircuitBreakerTest)
+{
+    CircuitBreaker::Options options;
+    options.minimumCalls = 4;
+    options.slowCallThreshold = 1.0;
+    options.openDuration = 0.05;
+    options.halfOpenProbes = 2;
+    CircuitBreaker breaker(options);
+
+    // Not opened before the minimum number of calls
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK(breaker.allow());
+        breaker.record(false, 0.0);
+    }
+    CHECK(breaker.state() == CircuitBreaker::State::Closed);
+    // A slow call counts as failed
+    breaker.record(true, 2.0);
+    CHECK(breaker.state() == CircuitBreaker::State::Open);
+    CHECK(!breaker.allow());
+
+    // Only the probes are allowed when the circuit is half-open, a failed
+    // probe opens it again.
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    CHECK(breaker.state() == CircuitBreaker::State::HalfOpen);
+    CHECK(breaker.allow());
+    CHECK(breaker.allow());
+    CHECK(!breaker.allow());
+    breaker.record(true, 0.0);
+    breaker.record(false, 0.0);
+    CHECK(breaker.state() == CircuitBreaker::State::Open);
+
+    // The circuit closes when all the probes succeed
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    CHECK(breaker.allow());
+    CHECK(breaker.allow());
+    breaker.record(true, 0.0);
+    breaker.record(true, 0.0);
+    CHECK(breaker.state() == CircuitBreaker::State::Closed);
+
+    // Under the failure rate
+    for (int i = 0; i < 8; ++i)
+        breaker.record(i % 3 != 0, 0.0);
+    CHECK(breaker.state() == CircuitBreaker::State::Closed);
+}
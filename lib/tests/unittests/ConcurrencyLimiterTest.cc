@@ -0,0 +1,80 @@
+#include "../../lib/src/HttpRequestImpl.h"
+#include <drogon/ConcurrencyLimiter.h>
+#include <drogon/drogon_test.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace drogon;
+
+DROGON_TEST(ConcurrencyLimiterTest)
+{
+    ConcurrencyLimiter limiter;
+    ConcurrencyLimiter::Options options;
+    options.maxInflight = 1;
+    options.maxQueue = 1;
+    options.maxQueueTime = 60.0;
+    limiter.setDefaultOptions(options);
+
+    std::vector<MiddlewareCallback> pending;
+    std::vector<HttpStatusCode> statuses;
+    auto send = [&]() {
+        limiter.invoke(
+            HttpRequest::newHttpRequest(),
+            [&](MiddlewareCallback &&mcb) {
+                pending.push_back(std::move(mcb));
+            },
+            [&](const HttpResponsePtr &resp) {
+                statuses.push_back(resp->statusCode());
+            });
+    };
+
+    send();
+    send();
+    CHECK(pending.size() == 1);
+    CHECK(limiter.inflight("") == 1);
+    CHECK(limiter.queued("") == 1);
+    // The queue is full
+    send();
+    REQUIRE(statuses.size() == 1);
+    CHECK(statuses[0] == k503ServiceUnavailable);
+
+    // The waiting request runs when the first one completes
+    pending[0](HttpResponse::newHttpResponse());
+    CHECK(pending.size() == 2);
+    CHECK(limiter.queued("") == 0);
+    pending[1](HttpResponse::newHttpResponse());
+    CHECK(statuses.size() == 3);
+    CHECK(statuses[1] == k200OK);
+    CHECK(limiter.inflight("") == 0);
+
+    SUBSECTION(Adaptive)
+    {
+        ConcurrencyLimiter adaptive;
+        ConcurrencyLimiter::Options adaptiveOptions;
+        adaptiveOptions.maxInflight = 100;
+        adaptiveOptions.adaptive = true;
+        adaptive.setOptions("/slow", adaptiveOptions);
+        auto req = HttpRequest::newHttpRequest();
+        static_cast<HttpRequestImpl *>(req.get())->setMatchedPathPattern(
+            "/slow");
+        auto call = [&](std::chrono::milliseconds latency) {
+            adaptive.invoke(
+                req,
+                [latency](MiddlewareCallback &&mcb) {
+                    std::this_thread::sleep_for(latency);
+                    mcb(HttpResponse::newHttpResponse());
+                },
+                [](const HttpResponsePtr &) {});
+        };
+        for (int i = 0; i < 20; ++i)
+            call(std::chrono::milliseconds(0));
+        CHECK(adaptive.limit("/slow") == 100);
+        // The limit goes down when the latency rises
+        for (int i = 0; i < 5; ++i)
+            call(std::chrono::milliseconds(10));
+        CHECK(adaptive.limit("/slow") < 100);
+        CHECK(adaptive.limit("/slow") >= 1);
+        CHECK(adaptive.inflight("/slow") == 0);
+    }
+}
@@ -0,0 +1,28 @@
+#include "../../lib/src/ConnectionBalancer.h"
+#include <drogon/drogon_test.h>
+#include <vector>
+
+using namespace drogon;
+
+DROGON_TEST(ConnectionBalancer)
+{
+    using Bounds = std::vector<uint32_t>;
+    CHECK(ConnectionBalancer::computeBounds({0, 0, 0, 0}) ==
+          Bounds({256, 512, 768, 1024}));
+    CHECK(ConnectionBalancer::computeBounds({7}) == Bounds({1024}));
+    CHECK(ConnectionBalancer::computeBounds({}).empty());
+
+    // The busy loop gets a quarter of the new connections.
+    CHECK(ConnectionBalancer::computeBounds({100, 0}) == Bounds({258, 1024}));
+    // Close loads are almost evenly balanced.
+    auto bounds = ConnectionBalancer::computeBounds({1000, 1001});
+    CHECK(bounds[0] >= 511);
+    CHECK(bounds[0] <= 513);
+
+    // The loops pinned to the CPUs 1 and 3, the CPUs 0 and 2 go by modulo.
+    CHECK(ConnectionBalancer::computeCpuLoops({1, 3}) == Bounds({0, 0, 0, 1}));
+    // The first loop of a CPU receives its connections.
+    CHECK(ConnectionBalancer::computeCpuLoops({0, 1, 0, 1}) ==
+          Bounds({0, 1}));
+    CHECK(ConnectionBalancer::computeCpuLoops({}).empty());
+}
@@ -60,4 +60,17 @@ DROGON_TEST(CookieTest)
     CHECK(
         cookie9.cookieString() ==
         "Set-Cookie: test=9; SameSite=Lax; Secure; HttpOnly; Partitioned\r\n");
+
+    // The frozen attributes are shared by the copies with other values
+    drogon::Cookie frozen("session", "");
+    frozen.setPath("/");
+    frozen.setMaxAge(600);
+    frozen.freezeAttributes();
+    auto copy = frozen;
+    copy.setValue("10");
+    CHECK(copy.cookieString() ==
+          "Set-Cookie: session=10; Max-Age=600; Path=/; HttpOnly\r\n");
+    copy.setHttpOnly(false);
+    CHECK(copy.cookieString() ==
+          "Set-Cookie: session=10; Max-Age=600; Path=/\r\n");
 }
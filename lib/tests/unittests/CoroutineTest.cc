@@ -11,6 +11,7 @@
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <thread>
 #include <type_traits>
 
 using namespace drogon;
@@ -328,3 +329,159 @@ DROGON_TEST(WhenAll)
         CHECK(counter == 1);
     }(TEST_CTX);
 }
+
+DROGON_TEST(WhenAny)
+{
+    using TestCtx = std::shared_ptr<drogon::test::Case>;
+    auto delayed = [](double delay, int value, bool fail) -> Task<int> {
+        co_await drogon::sleepCoro(app().getLoop(), delay);
+        if (fail)
+            throw std::runtime_error("Test exception");
+        co_return value;
+    };
+
+    [](TestCtx TEST_CTX, auto delayed) -> AsyncTask {
+        auto cancelled = std::make_shared<std::atomic<bool>>(false);
+        std::vector<Task<int>> tasks;
+        tasks.emplace_back(delayed(0.2, 1, false));
+        tasks.emplace_back(delayed(0.1, 2, false));
+        auto [index, value] = co_await when_any(std::move(tasks), cancelled);
+        CHECK(index == 1);
+        CHECK(value == 2);
+        CHECK(cancelled->load());
+    }(TEST_CTX, delayed);
+
+    [](TestCtx TEST_CTX, auto delayed) -> AsyncTask {
+        // The failures are ignored while a task may still succeed
+        std::vector<Task<int>> tasks;
+        tasks.emplace_back(delayed(0.1, 1, true));
+        tasks.emplace_back(delayed(0.2, 2, false));
+        auto result = co_await when_any(std::move(tasks));
+        CHECK(result.first == 1);
+        CHECK(result.second == 2);
+
+        tasks.clear();
+        tasks.emplace_back(delayed(0.1, 1, true));
+        tasks.emplace_back(delayed(0.2, 2, true));
+        CO_REQUIRE_THROWS(co_await when_any(std::move(tasks)));
+    }(TEST_CTX, delayed);
+
+    [](TestCtx TEST_CTX, auto delayed) -> AsyncTask {
+        auto value =
+            co_await timeoutCoro(app().getLoop(), 1.0, delayed(0.1, 3, false));
+        CHECK(value == 3);
+        CO_REQUIRE_THROWS_AS(co_await timeoutCoro(app().getLoop(),
+                                                  0.1,
+                                                  delayed(1.0, 3, false)),
+                             TimeoutException);
+    }(TEST_CTX, delayed);
+}
+
+DROGON_TEST(TaskGroup)
+{
+    using TestCtx = std::shared_ptr<drogon::test::Case>;
+    [](TestCtx TEST_CTX) -> AsyncTask {
+        TaskGroup group(2);
+        size_t running = 0;
+        size_t maxRunning = 0;
+        size_t done = 0;
+        for (int i = 0; i < 5; ++i)
+        {
+            group.spawn([](size_t *running,
+                           size_t *maxRunning,
+                           size_t *done) -> Task<> {
+                *maxRunning = (std::max)(*maxRunning, ++*running);
+                co_await drogon::sleepCoro(app().getLoop(), 0.05);
+                --*running;
+                ++*done;
+            }(&running, &maxRunning, &done));
+        }
+        co_await group.wait();
+        CHECK(done == 5);
+        CHECK(maxRunning == 2);
+
+        group.spawn([]() -> Task<> {
+            co_await drogon::sleepCoro(app().getLoop(), 0.05);
+            throw std::runtime_error("Test exception");
+        }());
+        CO_REQUIRE_THROWS(co_await group.wait());
+    }(TEST_CTX);
+
+    Semaphore semaphore(1);
+    CHECK(semaphore.try_acquire());
+    CHECK(semaphore.try_acquire() == false);
+    semaphore.release();
+    CHECK(semaphore.available() == 1);
+}
+
+namespace
+{
+// Resumes at once, after recording the frame of the coroutine.
+struct FrameAddress
+{
+    void *&address;
+
+    bool await_ready() noexcept
+    {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+        address = handle.address();
+        return false;
+    }
+
+    void await_resume() noexcept
+    {
+    }
+};
+
+Task<> recordFrame(void *&address)
+{
+    co_await FrameAddress{address};
+}
+}  // namespace
+
+DROGON_TEST(CoroFramePoolReuse)
+{
+    using drogon::internal::CoroFramePool;
+    if (!CoroFramePool::enabled())
+    {
+        // Built with AddressSanitizer
+        CHECK(CoroFramePool::enabled() == false);
+        return;
+    }
+    // The last block freed in a size class is the next one allocated in it.
+    auto first = CoroFramePool::allocate(100);
+    CoroFramePool::deallocate(first, 100);
+    auto second = CoroFramePool::allocate(128);
+    CHECK(second == first);
+    auto third = CoroFramePool::allocate(100);
+    CHECK(third != second);
+    CoroFramePool::deallocate(second, 128);
+    CoroFramePool::deallocate(third, 100);
+    // Another size class doesn't get them.
+    auto other = CoroFramePool::allocate(200);
+    CHECK(other != second);
+    CHECK(other != third);
+    CoroFramePool::deallocate(other, 200);
+    // The lists belong to the thread.
+    std::thread([TEST_CTX, second, third]() {
+        auto block = CoroFramePool::allocate(100);
+        CHECK(block != second);
+        CHECK(block != third);
+        CoroFramePool::deallocate(block, 100);
+    }).join();
+    CHECK(CoroFramePool::allocate(100) == third);
+    CoroFramePool::deallocate(third, 100);
+
+    // A task awaited after another one of the same size gets its frame.
+    void *firstFrame{nullptr}, *secondFrame{nullptr};
+    [&firstFrame, &secondFrame]() -> AsyncTask {
+        co_await recordFrame(firstFrame);
+        co_await recordFrame(secondFrame);
+    }();
+    CHECK(firstFrame != nullptr);
+    CHECK(firstFrame == secondFrame);
+}
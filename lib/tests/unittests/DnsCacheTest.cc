@@ -0,0 +1,39 @@
+#include "../../lib/src/DnsCache.h"
+#include <drogon/drogon_test.h>
+#include <string>
+#include <vector>
+
+using namespace drogon::internal;
+using trantor::InetAddress;
+
+static std::vector<std::string> ips(const std::vector<InetAddress> &addresses)
+{
+    std::vector<std::string> result;
+    for (auto &addr : addresses)
+        result.push_back(addr.toIp());
+    return result;
+}
+
+DROGON_TEST(DnsCacheSortForConnection)
+{
+    // The families alternate from the one preferred by the resolver
+    std::vector<InetAddress> addresses{InetAddress("2001:db8::1", 0, true),
+                                       InetAddress("2001:db8::2", 0, true),
+                                       InetAddress("2001:db8::3", 0, true),
+                                       InetAddress("192.0.2.1", 0),
+                                       InetAddress("192.0.2.2", 0)};
+    std::vector<std::string> expected{"2001:db8::1",
+                                      "192.0.2.1",
+                                      "2001:db8::2",
+                                      "192.0.2.2",
+                                      "2001:db8::3"};
+    CHECK(ips(DnsCache::sortForConnection(addresses)) == expected);
+
+    addresses = {InetAddress("192.0.2.1", 0),
+                 InetAddress("192.0.2.2", 0),
+                 InetAddress("2001:db8::1", 0, true)};
+    expected = {"192.0.2.1", "2001:db8::1", "192.0.2.2"};
+    CHECK(ips(DnsCache::sortForConnection(addresses)) == expected);
+
+    CHECK(DnsCache::sortForConnection({}).empty());
+}
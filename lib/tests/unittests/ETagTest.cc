@@ -0,0 +1,25 @@
+#include "../../lib/src/HttpUtils.h"
+#include <drogon/drogon_test.h>
+#include <string>
+
+using namespace drogon;
+
+DROGON_TEST(ETagTest)
+{
+    auto etag = bodyETag("hello world");
+    CHECK(etag.length() == 20);
+    CHECK(etag.compare(0, 3, "W/\"") == 0);
+    CHECK(etag.back() == '"');
+    CHECK(etag == bodyETag(std::string("hello world")));
+    CHECK(etag != bodyETag("hello worle"));
+    CHECK(bodyETag("") != bodyETag(std::string(1, '\0')));
+
+    CHECK(etagMatches(etag, etag));
+    CHECK(etagMatches("\"a\", " + etag, etag));
+    CHECK(etagMatches("*", etag));
+    // Weak comparison
+    CHECK(etagMatches("W/\"a\"", "\"a\""));
+    CHECK(etagMatches("\"a\"", "W/\"a\""));
+    CHECK(!etagMatches("\"a\", \"b\"", "\"c\""));
+    CHECK(!etagMatches("\"ab\"", "\"a\""));
+}
@@ -91,6 +91,19 @@ DROGON_TEST(FileTypeTest)
         CHECK(parseFileType("mp4") == FT_MEDIA);
         CHECK(parseFileType("csp") == FT_CUSTOM);
         CHECK(parseFileType("html") == FT_DOCUMENT);
+        CHECK(parseFileType("JPG") == FT_IMAGE);
+        CHECK(getContentType("/www/Index.HTML") == CT_TEXT_HTML);
+        CHECK(getContentType("/www/index.htmlx") ==
+              CT_APPLICATION_OCTET_STREAM);
+    }
+
+    SUBSECTION(custom)
+    {
+        registerCustomExtensionMime("Drogonext", "application/x-drogon");
+        auto ct = fileNameToContentTypeAndMime("a.drogonEXT");
+        CHECK(ct.first == CT_CUSTOM);
+        CHECK(ct.second == "application/x-drogon");
+        CHECK(fileNameToMime("a.jpg") == contentTypeToMime(CT_IMAGE_JPG));
     }
 
     SUBSECTION(negative)
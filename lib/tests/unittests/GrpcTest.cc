@@ -0,0 +1,53 @@
+#include <drogon/drogon_test.h>
+#include <drogon/Grpc.h>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+DROGON_TEST(GrpcTest)
+{
+    SUBSECTION(framing)
+    {
+        std::string body;
+        grpc::appendMessage(body, "hello");
+        grpc::appendMessage(body, "");
+        CHECK(body.size() == 15);
+        CHECK(body.compare(0, 5, std::string("\0\0\0\0\5", 5)) == 0);
+
+        std::vector<std::string_view> messages;
+        REQUIRE(grpc::parseMessages(body, messages));
+        REQUIRE(messages.size() == 2);
+        CHECK(messages[0] == "hello");
+        CHECK(messages[1].empty());
+
+        // Truncated, then compressed
+        messages.clear();
+        CHECK(!grpc::parseMessages(std::string_view(body).substr(0, 8),
+                                   messages));
+        body[0] = 1;
+        CHECK(!grpc::parseMessages(body, messages));
+    }
+
+    SUBSECTION(status)
+    {
+        CHECK(grpc::encodeStatusMessage("50% off\n") == "50%25 off%0A");
+        CHECK(grpc::decodeStatusMessage("50%25 off%0A%zz") ==
+              "50% off\n%zz");
+
+        auto resp = grpc::newErrorResponse(
+            {grpc::StatusCode::NotFound, "No such user"});
+        CHECK(resp->getTrailer("grpc-status") == "5");
+        auto status = grpc::statusOf(resp);
+        CHECK(status.code == grpc::StatusCode::NotFound);
+        CHECK(status.message == "No such user");
+
+        CHECK(grpc::statusOf(grpc::newResponse({})).ok());
+
+        resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(k503ServiceUnavailable);
+        CHECK(grpc::statusOf(resp).code == grpc::StatusCode::Unavailable);
+        resp->setStatusCode(k200OK);
+        CHECK(grpc::statusOf(resp).code == grpc::StatusCode::Unknown);
+    }
+}
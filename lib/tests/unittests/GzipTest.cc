@@ -1,5 +1,7 @@
 #include <drogon/drogon_test.h>
 #include <drogon/utils/Utilities.h>
+#include "../../lib/src/StreamCompressor.h"
+#include "../../lib/src/StreamDecompressor.h"
 
 using namespace drogon;
 
@@ -317,3 +319,113 @@ DROGON_TEST(Gzip)
     auto decompressStr = utils::gzipDecompress(ret.data(), ret.length());
     CHECK(inStr == decompressStr);
 }
+
+DROGON_TEST(GzipBestCompression)
+{
+    std::string inStr(1024 * 16, 'a');
+    for (size_t i = 0; i < inStr.size(); i += 7)
+        inStr[i] = static_cast<char>('a' + i % 26);
+    auto best = utils::gzipCompress(inStr.data(), inStr.length(), 9);
+    auto fast = utils::gzipCompress(inStr.data(), inStr.length(), 1);
+    REQUIRE(best.empty() == false);
+    CHECK(best.length() <= fast.length());
+    CHECK(utils::gzipDecompress(best.data(), best.length()) == inStr);
+}
+
+DROGON_TEST(GzipStreamCompression)
+{
+    auto compressor =
+        StreamCompressor::newCompressor(CompressionEncoding::kGzip, -1);
+    REQUIRE(compressor != nullptr);
+    std::string source;
+    std::string compressed;
+    for (int i = 0; i < 10000; ++i)
+    {
+        auto line = "row," + std::to_string(i) + ",value\n";
+        source.append(line);
+        // Flushing outputs all the data compressed so far
+        auto size = compressed.size();
+        CHECK(compressor->compress(line.data(),
+                                   line.size(),
+                                   i % 1000 == 0,
+                                   compressed));
+        if (i % 1000 == 0)
+            CHECK(compressed.size() > size);
+    }
+    CHECK(compressor->finish(compressed));
+    CHECK(compressed.size() < source.size());
+    CHECK(utils::gzipDecompress(compressed.data(), compressed.size()) ==
+          source);
+}
+
+DROGON_TEST(GzipStreamReuse)
+{
+    // The streams of the thread are reset between the calls, also after an
+    // error
+    std::string first(1000, 'a');
+    std::string second(2000, 'b');
+    auto a = utils::gzipCompress(first.data(), first.length());
+    auto b = utils::gzipCompress(second.data(), second.length(), 9);
+    auto c = utils::gzipCompress(first.data(), first.length());
+    CHECK(a == c);
+    std::string garbage(100, 'x');
+    CHECK(utils::gzipDecompress(garbage.data(), garbage.length()).empty());
+    CHECK(utils::gzipDecompress(a.data(), a.length()) == first);
+    CHECK(utils::gzipDecompress(b.data(), b.length()) == second);
+    CHECK(utils::gzipDecompress(a.data(), a.length()) == first);
+}
+
+DROGON_TEST(GzipStreamDecompression)
+{
+    std::string source;
+    for (int i = 0; i < 20000; ++i)
+        source.append("row," + std::to_string(i) + ",value\n");
+    auto compressed = utils::gzipCompress(source.data(), source.size());
+    REQUIRE(compressed.empty() == false);
+
+    // The pieces don't line up with the blocks of the stream
+    auto decompressor = StreamDecompressor::newDecompressor("gzip");
+    REQUIRE(decompressor != nullptr);
+    std::string output;
+    size_t maxPiece = 0;
+    auto append = [&output, &maxPiece](const char *data, size_t length) {
+        output.append(data, length);
+        maxPiece = (std::max)(maxPiece, length);
+        return true;
+    };
+    size_t step = 1;
+    for (size_t pos = 0; pos < compressed.size(); pos += step)
+    {
+        step = (std::min)(step * 3 % 997, compressed.size() - pos);
+        CHECK(decompressor->decompress(compressed.data() + pos, step, append));
+    }
+    CHECK(decompressor->finished());
+    CHECK(output == source);
+    CHECK(maxPiece <= 16 * 1024);
+
+    // Truncated
+    decompressor = StreamDecompressor::newDecompressor("gzip");
+    output.clear();
+    CHECK(decompressor->decompress(compressed.data(),
+                                   compressed.size() - 10,
+                                   append));
+    CHECK(decompressor->finished() == false);
+
+    // Corrupt
+    decompressor = StreamDecompressor::newDecompressor("gzip");
+    std::string garbage(100, 'x');
+    CHECK(decompressor->decompress(garbage.data(), garbage.size(), append) ==
+          false);
+
+    // Stopped by the output, e.g. when the body is too large
+    decompressor = StreamDecompressor::newDecompressor("gzip");
+    size_t calls = 0;
+    CHECK(decompressor->decompress(compressed.data(),
+                                   compressed.size(),
+                                   [&calls](const char *, size_t) {
+                                       return ++calls < 2;
+                                   }) == false);
+    CHECK(calls == 2);
+
+    CHECK(StreamDecompressor::newDecompressor("compress") == nullptr);
+}
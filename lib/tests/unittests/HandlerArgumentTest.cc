@@ -0,0 +1,56 @@
+#include <drogon/drogon_test.h>
+#include <drogon/HttpBinder.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace drogon::internal;
+
+DROGON_TEST(HandlerArgumentInteger)
+{
+    CHECK(getHandlerArgumentValue<int>(std::string_view("42")) == 42);
+    CHECK(getHandlerArgumentValue<int>(std::string_view("-7")) == -7);
+    CHECK(getHandlerArgumentValue<int>(std::string_view("+7")) == 7);
+    // The characters after the number are ignored like std::stoi()
+    CHECK(getHandlerArgumentValue<long>(std::string_view("12abc")) == 12);
+    CHECK(getHandlerArgumentValue<unsigned long long>(
+              std::string_view("18446744073709551615")) ==
+          18446744073709551615ULL);
+    CHECK_THROWS_AS(getHandlerArgumentValue<int>(std::string_view("abc")),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(getHandlerArgumentValue<int>(
+                        std::string_view("99999999999999999999")),
+                    std::out_of_range);
+    // The leading whitespaces are skipped like std::stoi()
+    CHECK(getHandlerArgumentValue<int>(std::string_view(" \t42")) == 42);
+    CHECK(getHandlerArgumentValue<int>(std::string_view("  +42")) == 42);
+    CHECK_THROWS_AS(getHandlerArgumentValue<int>(std::string_view("+-4")),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(getHandlerArgumentValue<int>(std::string_view(" ")),
+                    std::invalid_argument);
+    // Unlike std::stoul(), a negative number doesn't wrap around
+    CHECK_THROWS_AS(
+        getHandlerArgumentValue<unsigned long>(std::string_view("-1")),
+        std::invalid_argument);
+}
+
+DROGON_TEST(HandlerArgumentFloatingPoint)
+{
+    CHECK(getHandlerArgumentValue<double>(std::string_view("1.5")) == 1.5);
+    CHECK(getHandlerArgumentValue<float>(std::string_view("-0.25")) == -0.25f);
+    CHECK(getHandlerArgumentValue<double>(std::string_view(" +2.5")) == 2.5);
+    CHECK_THROWS_AS(getHandlerArgumentValue<double>(std::string_view("x")),
+                    std::invalid_argument);
+}
+
+DROGON_TEST(HandlerArgumentString)
+{
+    std::string param{"drogon"};
+    auto view = getHandlerArgumentValue<std::string_view>(param);
+    CHECK(view == "drogon");
+    CHECK(view.data() == param.data());
+    CHECK(getHandlerArgumentValue<std::string>(std::string_view(param)) ==
+          "drogon");
+    // The other types are still converted by the stream
+    CHECK(getHandlerArgumentValue<short>(std::string_view("12")) == 12);
+}
@@ -0,0 +1,142 @@
+#include <drogon/drogon_test.h>
+#include "../../lib/src/Hpack.h"
+#include <string>
+
+using namespace drogon;
+
+static std::string fromHex(std::string_view hex)
+{
+    std::string ret;
+    for (size_t i = 0; i + 1 < hex.length(); i += 2)
+    {
+        ret.push_back(
+            static_cast<char>(std::stoi(std::string(hex.substr(i, 2)),
+                                        nullptr,
+                                        16)));
+    }
+    return ret;
+}
+
+static bool decode(HpackDecoder &decoder,
+                   const std::string &block,
+                   HpackHeaders &headers)
+{
+    headers.clear();
+    return decoder.decode(reinterpret_cast<const uint8_t *>(block.data()),
+                          block.length(),
+                          headers);
+}
+
+DROGON_TEST(HpackDecodeWithoutHuffman)
+{
+    // rfc7541 C.3.1
+    HpackDecoder decoder;
+    HpackHeaders headers;
+    REQUIRE(decode(decoder,
+                   fromHex("828684410f7777772e6578616d706c652e636f6d"),
+                   headers));
+    REQUIRE(headers.size() == 4);
+    CHECK(headers[0].first == ":method");
+    CHECK(headers[0].second == "GET");
+    CHECK(headers[1].second == "http");
+    CHECK(headers[2].second == "/");
+    CHECK(headers[3].first == ":authority");
+    CHECK(headers[3].second == "www.example.com");
+}
+
+DROGON_TEST(HpackDecodeWithHuffman)
+{
+    // rfc7541 C.4, the requests share the dynamic table
+    HpackDecoder decoder;
+    HpackHeaders headers;
+    REQUIRE(decode(decoder,
+                   fromHex("828684418cf1e3c2e5f23a6ba0ab90f4ff"),
+                   headers));
+    REQUIRE(headers.size() == 4);
+    CHECK(headers[3].second == "www.example.com");
+
+    REQUIRE(decode(decoder, fromHex("828684be5886a8eb10649cbf"), headers));
+    REQUIRE(headers.size() == 5);
+    CHECK(headers[3].first == ":authority");
+    CHECK(headers[3].second == "www.example.com");
+    CHECK(headers[4].first == "cache-control");
+    CHECK(headers[4].second == "no-cache");
+
+    REQUIRE(decode(decoder,
+                   fromHex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"),
+                   headers));
+    REQUIRE(headers.size() == 5);
+    CHECK(headers[1].second == "https");
+    CHECK(headers[2].second == "/index.html");
+    CHECK(headers[3].second == "www.example.com");
+    CHECK(headers[4].first == "custom-key");
+    CHECK(headers[4].second == "custom-value");
+}
+
+DROGON_TEST(HpackDecodeMalformed)
+{
+    HpackDecoder decoder;
+    HpackHeaders headers;
+    // index 0 is not allowed
+    CHECK(decode(decoder, fromHex("80"), headers) == false);
+    // index out of the tables
+    HpackDecoder decoder2;
+    CHECK(decode(decoder2, fromHex("be"), headers) == false);
+    // truncated string literal
+    HpackDecoder decoder3;
+    CHECK(decode(decoder3, fromHex("410f7777"), headers) == false);
+}
+
+DROGON_TEST(HpackRoundTrip)
+{
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    HpackHeaders fields{{":status", "200"},
+                        {"content-type", "application/json; charset=utf-8"},
+                        {"x-custom", "hello world"},
+                        {"set-cookie", "JSESSIONID=abc; Path=/"},
+                        {"x-custom", "hello world"}};
+    std::string block;
+    for (auto &[name, value] : fields)
+        encoder.encode(name, value, block);
+    HpackHeaders headers;
+    REQUIRE(decode(decoder, block, headers));
+    CHECK(headers == fields);
+
+    // The second block is encoded with the dynamic table
+    std::string block2;
+    for (auto &[name, value] : fields)
+        encoder.encode(name, value, block2);
+    CHECK(block2.length() < block.length());
+    REQUIRE(decode(decoder, block2, headers));
+    CHECK(headers == fields);
+
+    // Table size update emitted by the encoder
+    encoder.setMaxTableSize(0);
+    std::string block3;
+    encoder.encode("x-custom", "hello world", block3);
+    REQUIRE(decode(decoder, block3, headers));
+    REQUIRE(headers.size() == 1);
+    CHECK(headers[0].second == "hello world");
+}
+
+DROGON_TEST(HpackHuffman)
+{
+    std::string all;
+    for (int i = 0; i < 256; ++i)
+        all.push_back(static_cast<char>(i));
+    std::string encoded;
+    hpack::huffmanEncode(all, encoded);
+    CHECK(encoded.length() == hpack::huffmanEncodedLength(all));
+    std::string decoded;
+    REQUIRE(hpack::huffmanDecode(reinterpret_cast<const uint8_t *>(
+                                     encoded.data()),
+                                 encoded.length(),
+                                 decoded));
+    CHECK(decoded == all);
+
+    // rfc7541 C.4.1
+    encoded.clear();
+    hpack::huffmanEncode("www.example.com", encoded);
+    CHECK(encoded == fromHex("f1e3c2e5f23a6ba0ab90f4ff"));
+}
@@ -0,0 +1,413 @@
+#include <drogon/drogon_test.h>
+#include <drogon/HttpRequest.h>
+#include "../../lib/src/Http2ClientConnection.h"
+#include "../../lib/src/HttpResponseImpl.h"
+#include <string>
+#include <vector>
+
+using namespace drogon;
+using namespace drogon::http2;
+
+namespace
+{
+// The server side of a connection, which writes the frames read by the
+// client. The client has no TCP connection, so what it sends is dropped.
+struct Http2Peer
+{
+    HpackEncoder encoder;
+    trantor::MsgBuffer buffer;
+
+    void headers(uint32_t streamId,
+                 const HpackHeaders &fields,
+                 bool endStream,
+                 uint32_t maxFrameSize = kDefaultMaxFrameSize)
+    {
+        std::string block;
+        for (auto &[name, value] : fields)
+            encoder.encode(name, value, block);
+        appendHeaderBlock(buffer, streamId, block, endStream, maxFrameSize);
+    }
+
+    void data(uint32_t streamId,
+              std::string_view body,
+              bool endStream,
+              uint8_t padding = 0)
+    {
+        uint8_t frameFlags = endStream ? flags::kEndStream : 0;
+        uint32_t length = static_cast<uint32_t>(body.length());
+        if (padding > 0)
+        {
+            frameFlags |= flags::kPadded;
+            length += 1 + padding;
+        }
+        appendFrameHeader(
+            buffer, length, FrameType::Data, frameFlags, streamId);
+        if (padding > 0)
+            buffer.append(reinterpret_cast<const char *>(&padding), 1);
+        buffer.append(body.data(), body.length());
+        buffer.append(std::string(padding, '\0'));
+    }
+};
+
+struct Outcome
+{
+    bool called{false};
+    ReqResult result{ReqResult::Ok};
+    HttpResponseImplPtr response;
+};
+
+std::shared_ptr<Http2ClientConnection> newConnection()
+{
+    auto conn = std::make_shared<Http2ClientConnection>(nullptr);
+    conn->start();
+    return conn;
+}
+
+void send(Http2ClientConnection &conn,
+          Outcome &outcome,
+          HttpMethod method = Get,
+          const std::string &body = {})
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setMethod(method);
+    req->setPath("/h2");
+    req->addHeader("host", "localhost");
+    if (!body.empty())
+        req->setBody(body);
+    conn.sendRequest(req,
+                     false,
+                     [&outcome](ReqResult result,
+                                const HttpResponseImplPtr &resp) {
+                         outcome.called = true;
+                         outcome.result = result;
+                         outcome.response = resp;
+                     });
+}
+}  // namespace
+
+DROGON_TEST(Http2FrameHeader)
+{
+    char bytes[kFrameHeaderLength];
+    writeFrameHeader(
+        bytes, 0x123456, FrameType::Headers, flags::kEndHeaders, 0x7fffffff);
+    auto header = parseFrameHeader(bytes);
+    CHECK(header.length == 0x123456);
+    CHECK(header.type == FrameType::Headers);
+    CHECK(header.flags == flags::kEndHeaders);
+    CHECK(header.streamId == 0x7fffffff);
+
+    // The reserved bit of the stream id is ignored
+    bytes[5] = static_cast<char>(0xff);
+    CHECK(parseFrameHeader(bytes).streamId == 0x7fffffff);
+
+    trantor::MsgBuffer buffer;
+    appendGoAway(buffer, 7, ErrorCode::EnhanceYourCalm);
+    REQUIRE(buffer.readableBytes() == kFrameHeaderLength + 8);
+    header = parseFrameHeader(buffer.peek());
+    CHECK(header.type == FrameType::GoAway);
+    CHECK(header.length == 8);
+    CHECK(readUint32(buffer.peek() + kFrameHeaderLength) == 7);
+    CHECK(readUint32(buffer.peek() + kFrameHeaderLength + 4) ==
+          static_cast<uint32_t>(ErrorCode::EnhanceYourCalm));
+}
+
+DROGON_TEST(Http2HeaderBlockContinuation)
+{
+    // A block larger than the frame size is split into CONTINUATION frames,
+    // only the first one has END_STREAM and only the last END_HEADERS.
+    trantor::MsgBuffer buffer;
+    std::string block(40000, 'x');
+    appendHeaderBlock(buffer, 5, block, true, kDefaultMaxFrameSize);
+    std::vector<FrameHeader> frames;
+    std::string payload;
+    while (buffer.readableBytes() >= kFrameHeaderLength)
+    {
+        auto header = parseFrameHeader(buffer.peek());
+        buffer.retrieve(kFrameHeaderLength);
+        payload.append(buffer.peek(), header.length);
+        buffer.retrieve(header.length);
+        frames.push_back(header);
+    }
+    REQUIRE(frames.size() == 3);
+    CHECK(frames[0].type == FrameType::Headers);
+    CHECK(frames[0].flags == flags::kEndStream);
+    CHECK(frames[1].type == FrameType::Continuation);
+    CHECK(frames[1].flags == 0);
+    CHECK(frames[2].type == FrameType::Continuation);
+    CHECK(frames[2].flags == flags::kEndHeaders);
+    CHECK(frames[2].length == 40000 - 2 * kDefaultMaxFrameSize);
+    CHECK(frames[2].streamId == 5);
+    CHECK(payload == block);
+}
+
+DROGON_TEST(Http2ClientResponse)
+{
+    auto conn = newConnection();
+    Outcome outcome;
+    send(*conn, outcome);
+    CHECK(conn->numberOfStreams() == 1);
+
+    // Headers split into CONTINUATION frames and a padded body, fed one byte
+    // at a time.
+    Http2Peer peer;
+    peer.headers(1,
+                 {{":status", "201"},
+                  {"content-type", "text/plain"},
+                  {"x-large", std::string(20000, 'a')}},
+                 false);
+    peer.data(1, "hello ", false, 3);
+    peer.data(1, "world", true);
+    std::string frames(peer.buffer.peek(), peer.buffer.readableBytes());
+    trantor::MsgBuffer input;
+    for (size_t i = 0; i + 1 < frames.length(); ++i)
+    {
+        input.append(&frames[i], 1);
+        conn->onMessage(&input);
+    }
+    CHECK(!outcome.called);
+    input.append(&frames.back(), 1);
+    conn->onMessage(&input);
+    REQUIRE(outcome.called);
+    CHECK(outcome.result == ReqResult::Ok);
+    REQUIRE(outcome.response != nullptr);
+    CHECK(outcome.response->statusCode() == k201Created);
+    CHECK(outcome.response->getHeader("x-large").length() == 20000);
+    CHECK(outcome.response->body() == "hello world");
+    CHECK(conn->numberOfStreams() == 0);
+}
+
+DROGON_TEST(Http2ClientMultiplexing)
+{
+    auto conn = newConnection();
+    Outcome first, second;
+    send(*conn, first);
+    send(*conn, second, Post, "body");
+    CHECK(conn->numberOfStreams() == 2);
+
+    // The second stream is answered first, with an informational response
+    // before the final one, and the first one has trailers. The dynamic
+    // table of the encoder is shared by both streams.
+    Http2Peer peer;
+    peer.headers(3, {{":status", "100"}}, false);
+    peer.headers(3, {{":status", "200"}, {"x-stream", "3"}}, false);
+    peer.headers(1, {{":status", "200"}, {"x-stream", "1"}}, false);
+    peer.data(3, "second", true);
+    conn->onMessage(&peer.buffer);
+    CHECK(!first.called);
+    REQUIRE(second.called);
+    CHECK(second.result == ReqResult::Ok);
+    CHECK(second.response->getHeader("x-stream") == "3");
+    CHECK(second.response->body() == "second");
+
+    peer.data(1, "first", false);
+    peer.headers(1, {{"x-checksum", "abc"}}, true);
+    conn->onMessage(&peer.buffer);
+    REQUIRE(first.called);
+    CHECK(first.result == ReqResult::Ok);
+    CHECK(first.response->getHeader("x-stream") == "1");
+    CHECK(first.response->body() == "first");
+    CHECK(first.response->getTrailer("x-checksum") == "abc");
+}
+
+DROGON_TEST(Http2ClientHeadResponse)
+{
+    auto conn = newConnection();
+    Outcome outcome;
+    send(*conn, outcome, Head);
+    Http2Peer peer;
+    peer.headers(1, {{":status", "200"}, {"content-length", "5"}}, false);
+    peer.data(1, "", true);
+    conn->onMessage(&peer.buffer);
+    REQUIRE(outcome.called);
+    CHECK(outcome.result == ReqResult::Ok);
+    CHECK(outcome.response->body().empty());
+}
+
+DROGON_TEST(Http2ClientStreamErrors)
+{
+    auto conn = newConnection();
+    Outcome reset, malformed, ok;
+    send(*conn, reset);
+    send(*conn, malformed);
+    send(*conn, ok);
+
+    // RST_STREAM fails its stream only
+    Http2Peer peer;
+    appendRstStream(peer.buffer, 1, ErrorCode::RefusedStream);
+    conn->onMessage(&peer.buffer);
+    REQUIRE(reset.called);
+    CHECK(reset.result == ReqResult::BadResponse);
+    CHECK(!malformed.called);
+
+    // DATA before HEADERS resets the stream
+    peer.data(3, "early", true);
+    conn->onMessage(&peer.buffer);
+    REQUIRE(malformed.called);
+    CHECK(malformed.result == ReqResult::BadResponse);
+
+    // Frames of unknown or finished streams are ignored
+    peer.data(1, "late", true);
+    peer.headers(7, {{":status", "204"}}, true);
+    peer.headers(5, {{":status", "204"}}, true);
+    conn->onMessage(&peer.buffer);
+    REQUIRE(ok.called);
+    CHECK(ok.result == ReqResult::Ok);
+    CHECK(ok.response->statusCode() == k204NoContent);
+    CHECK(conn->numberOfStreams() == 0);
+    CHECK(!conn->isGoingAway());
+}
+
+DROGON_TEST(Http2ClientCancel)
+{
+    auto conn = newConnection();
+    Outcome cancelled, other;
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/slow");
+    req->addHeader("host", "localhost");
+    conn->sendRequest(req,
+                      false,
+                      [&cancelled](ReqResult result,
+                                   const HttpResponseImplPtr &resp) {
+                          cancelled.called = true;
+                          cancelled.result = result;
+                          cancelled.response = resp;
+                      });
+    send(*conn, other);
+    conn->cancelRequest(req);
+    REQUIRE(cancelled.called);
+    CHECK(cancelled.result == ReqResult::Timeout);
+
+    // The late response of the cancelled stream still updates the decoder,
+    // so the other stream is decoded correctly.
+    Http2Peer peer;
+    peer.headers(1, {{":status", "200"}, {"x-shared", "value"}}, true);
+    peer.headers(3, {{":status", "200"}, {"x-shared", "value"}}, true);
+    conn->onMessage(&peer.buffer);
+    REQUIRE(other.called);
+    CHECK(other.result == ReqResult::Ok);
+    CHECK(other.response->getHeader("x-shared") == "value");
+}
+
+DROGON_TEST(Http2ClientGoAway)
+{
+    auto conn = newConnection();
+    Outcome accepted, refused;
+    send(*conn, accepted);
+    send(*conn, refused);
+    CHECK(conn->canSendRequest());
+
+    // The streams above the last stream id fail at once, the others are
+    // still answered.
+    Http2Peer peer;
+    appendGoAway(peer.buffer, 1, ErrorCode::NoError);
+    conn->onMessage(&peer.buffer);
+    CHECK(conn->isGoingAway());
+    CHECK(!conn->canSendRequest());
+    REQUIRE(refused.called);
+    CHECK(refused.result == ReqResult::NetworkFailure);
+    CHECK(!accepted.called);
+
+    peer.headers(1, {{":status", "200"}}, true);
+    conn->onMessage(&peer.buffer);
+    REQUIRE(accepted.called);
+    CHECK(accepted.result == ReqResult::Ok);
+}
+
+DROGON_TEST(Http2ClientSettings)
+{
+    auto conn = newConnection();
+    Outcome first, second;
+    Http2Peer peer;
+    appendFrameHeader(peer.buffer, 6, FrameType::Settings, 0, 0);
+    appendSetting(peer.buffer, SettingsId::MaxConcurrentStreams, 1);
+    conn->onMessage(&peer.buffer);
+    send(*conn, first);
+    CHECK(!conn->canSendRequest());
+
+    peer.headers(1, {{":status", "200"}}, true);
+    conn->onMessage(&peer.buffer);
+    REQUIRE(first.called);
+    CHECK(conn->canSendRequest());
+
+    // A request body is sent within the flow control windows
+    appendFrameHeader(peer.buffer, 6, FrameType::Settings, 0, 0);
+    appendSetting(peer.buffer, SettingsId::InitialWindowSize, 10);
+    conn->onMessage(&peer.buffer);
+    send(*conn, second, Post, std::string(100, 'b'));
+    appendWindowUpdate(peer.buffer, 3, 100);
+    conn->onMessage(&peer.buffer);
+    peer.headers(3, {{":status", "200"}}, true);
+    conn->onMessage(&peer.buffer);
+    REQUIRE(second.called);
+    CHECK(second.result == ReqResult::Ok);
+}
+
+DROGON_TEST(Http2ClientConnectionErrors)
+{
+    // A frame larger than the advertised maximum size
+    {
+        auto conn = newConnection();
+        Outcome outcome;
+        send(*conn, outcome);
+        trantor::MsgBuffer buffer;
+        appendFrameHeader(
+            buffer, kDefaultMaxFrameSize + 1, FrameType::Data, 0, 1);
+        conn->onMessage(&buffer);
+        REQUIRE(outcome.called);
+        CHECK(outcome.result == ReqResult::BadResponse);
+        CHECK(conn->isGoingAway());
+    }
+    // PUSH_PROMISE while push is disabled
+    {
+        auto conn = newConnection();
+        Outcome outcome;
+        send(*conn, outcome);
+        trantor::MsgBuffer buffer;
+        appendFrameHeader(buffer, 4, FrameType::PushPromise, 0, 1);
+        appendUint32(buffer, 2);
+        conn->onMessage(&buffer);
+        REQUIRE(outcome.called);
+        CHECK(outcome.result == ReqResult::BadResponse);
+    }
+    // A header block which can't be decoded
+    {
+        auto conn = newConnection();
+        Outcome outcome;
+        send(*conn, outcome);
+        trantor::MsgBuffer buffer;
+        appendFrameHeader(buffer,
+                          1,
+                          FrameType::Headers,
+                          flags::kEndHeaders | flags::kEndStream,
+                          1);
+        buffer.append("\x80", 1);
+        conn->onMessage(&buffer);
+        REQUIRE(outcome.called);
+        CHECK(outcome.result == ReqResult::BadResponse);
+        CHECK(conn->isGoingAway());
+    }
+    // A frame of another stream between HEADERS and CONTINUATION
+    {
+        auto conn = newConnection();
+        Outcome outcome;
+        send(*conn, outcome);
+        trantor::MsgBuffer buffer;
+        appendFrameHeader(buffer, 100, FrameType::Headers, 0, 1);
+        buffer.append(std::string(100, 'x'));
+        appendWindowUpdate(buffer, 0, 1);
+        conn->onMessage(&buffer);
+        REQUIRE(outcome.called);
+        CHECK(outcome.result == ReqResult::BadResponse);
+    }
+    // The pending streams fail when the connection is closed
+    {
+        auto conn = newConnection();
+        Outcome first, second;
+        send(*conn, first);
+        send(*conn, second);
+        conn->onClose(ReqResult::NetworkFailure);
+        CHECK(first.result == ReqResult::NetworkFailure);
+        CHECK(second.result == ReqResult::NetworkFailure);
+        CHECK(!conn->canSendRequest());
+    }
+}
@@ -1,6 +1,7 @@
 #include "../../lib/src/HttpFileImpl.h"
 #include <drogon/drogon_test.h>
 #include <filesystem>
+#include <fstream>
 
 using namespace drogon;
 using namespace std;
@@ -48,6 +49,42 @@ DROGON_TEST(HttpFile)
         filesystem::remove_all(uploadPath.string());
     }
 
+    SUBSECTION(TmpFileIsMoved)
+    {
+        auto tmpPath = filesystem::current_path() / "test_tmp_upload";
+        {
+            std::ofstream tmp(tmpPath, std::ios::binary);
+            tmp << "streamed";
+        }
+        auto uploadPath = filesystem::current_path() / "test_uploads_dir";
+        {
+            HttpFileImpl file;
+            file.setFileName("test_file_name");
+            file.setTmpFile(tmpPath.string(), 8);
+            CHECK(file.fileLength() == 8);
+            CHECK(file.fileContent() == "streamed");
+            CHECK(file.getMd5() == "2CB638EEDB2A1C0E53E7F73B81CE030E");
+            CHECK(file.save(uploadPath.string()) == 0);
+            CHECK(!filesystem::exists(tmpPath));
+            CHECK(file.saveAs((uploadPath / "copy").string()) == 0);
+        }
+        CHECK(filesystem::file_size(uploadPath / "test_file_name") == 8);
+        CHECK(filesystem::file_size(uploadPath / "copy") == 8);
+        filesystem::remove_all(uploadPath);
+
+        {
+            std::ofstream tmp(tmpPath, std::ios::binary);
+            tmp << "dropped";
+        }
+        {
+            HttpFileImpl file;
+            file.setFileName("test_file_name");
+            file.setTmpFile(tmpPath.string(), 7);
+        }
+        // Removed with the file never saved
+        CHECK(!filesystem::exists(tmpPath));
+    }
+
     SUBSECTION(FileNameWithRelativePath)
     {
         auto uploadPath = filesystem::current_path() / "test_uploads_dir";
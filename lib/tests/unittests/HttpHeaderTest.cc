@@ -1,7 +1,9 @@
 #include <drogon/drogon_test.h>
 #include <drogon/HttpRequest.h>
 #include <drogon/HttpResponse.h>
+#include "../../lib/src/HttpRequestImpl.h"
 #include "../../lib/src/HttpResponseImpl.h"
+#include <cstring>
 
 using namespace drogon;
 
@@ -16,6 +18,47 @@ DROGON_TEST(HttpHeaderRequest)
     CHECK(req->getHeader("abc") == "");
 }
 
+DROGON_TEST(HttpHeaderKnownSlots)
+{
+    CHECK(HttpRequestImpl::knownHeaderIndex("content-length") ==
+          static_cast<int>(KnownHeader::kContentLength));
+    CHECK(HttpRequestImpl::knownHeaderIndex("if-modified-since") ==
+          static_cast<int>(KnownHeader::kIfModifiedSince));
+    CHECK(HttpRequestImpl::knownHeaderIndex("content-lengtx") == -1);
+    CHECK(HttpRequestImpl::knownHeaderIndex("abc") == -1);
+
+    HttpRequestImpl req(nullptr);
+    for (bool views : {false, true})
+    {
+        req.reset();
+        req.useHeaderViews(views);
+        std::string lines = "Content-Length: 12\r\nHost: a\r\nHost: b\r\n";
+        const char *start = lines.data();
+        while (start < lines.data() + lines.size())
+        {
+            auto end = strstr(start, "\r\n");
+            req.addHeader(start, strchr(start, ':'), end);
+            start = end + 2;
+        }
+        CHECK(req.getKnownHeader(KnownHeader::kContentLength) == "12");
+        CHECK(req.getHeader("Host") == "a");
+        CHECK(req.getHeaderView("host") == "a");
+
+        // The whole map still holds the well-known headers
+        CHECK(req.headers().size() == 2UL);
+        CHECK(req.headers().at("content-length") == "12");
+        CHECK(req.getKnownHeader(KnownHeader::kHost) == "a");
+        req.removeHeader("host");
+        CHECK(req.getKnownHeader(KnownHeader::kHost).empty());
+    }
+
+    req.reset();
+    req.addHeader("Connection", "close");
+    CHECK(req.getKnownHeader(KnownHeader::kConnection) == "close");
+    req.removeHeader("connection");
+    CHECK(req.getHeader("connection").empty());
+}
+
 DROGON_TEST(HttpHeaderResponse)
 {
     auto resp = std::dynamic_pointer_cast<HttpResponseImpl>(
@@ -37,6 +80,94 @@ DROGON_TEST(HttpHeaderResponse)
     CHECK(resp->getHeader("abc") == "");
 }
 
+DROGON_TEST(HttpResponseTemplate)
+{
+    auto templateResp =
+        HttpResponse::newHttpResponse(k201Created, CT_APPLICATION_JSON);
+    templateResp->addHeader("X-Api", "v1");
+    templateResp->freezeAsTemplate();
+
+    auto render = [](const HttpResponsePtr &resp) {
+        auto buffer =
+            static_cast<HttpResponseImpl *>(resp.get())->renderToBuffer();
+        return std::string{buffer->peek(), buffer->readableBytes()};
+    };
+    auto resp = HttpResponse::newHttpResponse(templateResp, "{\"id\":1}");
+    CHECK(resp->statusCode() == k201Created);
+    CHECK(resp->getHeader("x-api") == "v1");
+    CHECK(resp->contentType() == CT_APPLICATION_JSON);
+    auto str = render(resp);
+    CHECK(str.find("HTTP/1.1 201 ") == 0);
+    CHECK(str.find("x-api: v1\r\n") != std::string::npos);
+    CHECK(str.find("content-type: application/json") != std::string::npos);
+    CHECK(str.find("content-length: 8\r\n") != std::string::npos);
+    CHECK(str.find("\r\n\r\n{\"id\":1}") != std::string::npos);
+
+    // The content-length is the one of each body
+    resp = HttpResponse::newHttpResponse(templateResp, "{\"id\":100}");
+    CHECK(render(resp).find("content-length: 10\r\n") != std::string::npos);
+
+    // Changing the headers of a response doesn't change the template
+    resp->addHeader("X-Extra", "1");
+    CHECK(render(resp).find("x-extra: 1\r\n") != std::string::npos);
+    resp = HttpResponse::newHttpResponse(templateResp, "");
+    str = render(resp);
+    CHECK(str.find("x-extra") == std::string::npos);
+    CHECK(str.find("content-length: 0\r\n") != std::string::npos);
+}
+
+DROGON_TEST(HttpResponseImmutable)
+{
+    auto resp = std::make_shared<HttpResponseImpl>(k404NotFound, CT_TEXT_HTML);
+    resp->setBody("<html>not found</html>");
+    resp->setImmutable();
+    CHECK(resp->isImmutable());
+    CHECK(resp->expiredTime() == 0);
+
+    // The same bytes are sent every time
+    auto buffer = resp->renderToBuffer();
+    CHECK(resp->renderToBuffer().get() == buffer.get());
+    auto str = std::string{buffer->peek(), buffer->readableBytes()};
+    CHECK(str.find("HTTP/1.1 404 ") == 0);
+    CHECK(str.find("\r\n\r\n<html>not found</html>") != std::string::npos);
+
+    // A copy which is changed is rendered again
+    auto copy = std::make_shared<HttpResponseImpl>(*resp);
+    copy->setExpiredTime(-1);
+    CHECK(!copy->isImmutable());
+    copy->addHeader("X-Copy", "1");
+    buffer = copy->renderToBuffer();
+    str = std::string{buffer->peek(), buffer->readableBytes()};
+    CHECK(str.find("x-copy: 1\r\n") != std::string::npos);
+}
+
+DROGON_TEST(HttpResponseRecycle)
+{
+    auto resp = std::make_shared<HttpResponseImpl>(k404NotFound,
+                                                   CT_APPLICATION_JSON);
+    resp->addHeader("Abc", "abc");
+    resp->setCloseConnection(true);
+    resp->setBody("body");
+    auto buffer = resp->renderToBuffer();
+    auto first = buffer.get();
+    auto length = buffer->readableBytes();
+    buffer.reset();
+
+    // The released render buffer is reused
+    buffer = resp->renderToBuffer();
+    CHECK(buffer.get() == first);
+    CHECK(buffer->readableBytes() == length);
+    buffer.reset();
+
+    resp->recycle();
+    auto fresh = std::make_shared<HttpResponseImpl>();
+    CHECK(resp->statusCode() == fresh->statusCode());
+    CHECK(resp->getHeader("abc") == "");
+    CHECK(!resp->ifCloseConnection());
+    CHECK(resp->body().empty());
+    CHECK(resp->contentTypeString() == fresh->contentTypeString());
+}
+
 DROGON_TEST(ResponseSetCustomContentTypeString)
 {
     auto resp = HttpResponse::newHttpResponse();
@@ -258,3 +389,66 @@ DROGON_TEST(ClearHeaders)
     // verify path unchanged
     CHECK(req->path() == "/api/test");
 }
+
+DROGON_TEST(ZeroCopyRequestHeaders)
+{
+    auto req = std::make_shared<HttpRequestImpl>(nullptr);
+    req->setVersion(Version::kHttp11);
+    req->useHeaderViews(true);
+    auto add = [&req](const char *line) {
+        auto end = line + strlen(line);
+        req->addHeader(line, strchr(line, ':'), end);
+    };
+    add("Host: example.com ");
+    add("X-Dup: first");
+    add("X-Dup: second");
+    add("Cookie: a=1; b=2");
+    add("Connection: close");
+
+    CHECK(req->getHeaderView("host") == "example.com");
+    CHECK(req->getHeaderView("x-dup") == "first");
+    CHECK(req->getHeaderView("cookie").empty());
+    CHECK(req->getCookie("b") == "2");
+    CHECK(!req->keepAlive());
+    CHECK(req->getHeader("Host") == "example.com");
+    CHECK(req->getHeader("X-Missing") == "");
+
+    CHECK(req->headers().size() == 3);
+    CHECK(req->headers().at("x-dup") == "first");
+
+    req->addHeader("X-Added", "added");
+    req->removeHeader("Host");
+    CHECK(req->getHeaderView("x-added") == "added");
+    CHECK(req->getHeader("host") == "");
+    CHECK(req->headers().size() == 3);
+
+    req->reset();
+    req->useHeaderViews(true);
+    add("Host: another.com");
+    CHECK(req->getHeader("host") == "another.com");
+    CHECK(req->headers().size() == 1);
+}
+
+DROGON_TEST(LazyRequestCookies)
+{
+    HttpRequestImpl req(nullptr);
+    for (const char *line : {"Cookie: a=1; b= 2", "Cookie: c=3;"})
+    {
+        auto end = line + strlen(line);
+        req.addHeader(line, strchr(line, ':'), end);
+    }
+    CHECK(req.getHeader("cookie").empty());
+    CHECK(req.getCookie("a") == "1");
+    CHECK(req.getCookie("b") == "2");
+    CHECK(req.getCookie("c") == "3");
+    CHECK(req.cookies().size() == 3);
+
+    // Added after the lookup
+    const char *line = "Cookie: d=4";
+    req.addHeader(line, strchr(line, ':'), line + strlen(line));
+    CHECK(req.getCookie("d") == "4");
+    CHECK(req.cookies().size() == 4);
+
+    req.reset();
+    CHECK(req.cookies().empty());
+}
@@ -0,0 +1,36 @@
+#include <drogon/drogon_test.h>
+#include "../../lib/src/HttpRequestImpl.h"
+
+using namespace drogon;
+
+DROGON_TEST(HttpParameterLookup)
+{
+    HttpRequestImpl req(nullptr);
+    req.setQuery("?a=1&b=x%20y&c&d=q&%61%62=2&d=last");
+    req.setBody("e=body+value&a=from-body&");
+
+    auto a = req.getParameterView("a");
+    REQUIRE(a.has_value());
+    // The body comes after the query and the last value wins
+    CHECK(*a == "from-body");
+    // Not decoded, the view points into the body
+    CHECK(a->data() >= req.contentView().data());
+    CHECK(a->data() < req.contentView().data() + req.contentView().size());
+
+    CHECK(req.getParameterView("b") == std::string_view("x y"));
+    CHECK(req.getParameterView("c") == std::string_view(""));
+    CHECK(req.getParameterView("d") == std::string_view("last"));
+    CHECK(req.getParameterView("ab") == std::string_view("2"));
+    CHECK(req.getParameterView("e") == std::string_view("body value"));
+    CHECK(!req.getParameterView("f").has_value());
+    CHECK(req.getParameter("b") == "x y");
+    CHECK(req.getParameter("f").empty());
+    CHECK(req.getOptionalParameter<int>("ab") == 2);
+
+    // The same values once all of them are parsed
+    auto &parameters = req.parameters();
+    CHECK(parameters.size() == 6UL);
+    CHECK(parameters.at("a") == "from-body");
+    CHECK(parameters.at("b") == "x y");
+    CHECK(req.getParameterView("d") == std::string_view("last"));
+}
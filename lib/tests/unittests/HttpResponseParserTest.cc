@@ -0,0 +1,93 @@
+#include "../../lib/src/HttpResponseImpl.h"
+#include "../../lib/src/HttpResponseParser.h"
+#include <drogon/drogon_test.h>
+#include <trantor/utils/MsgBuffer.h>
+#include <string>
+
+using namespace drogon;
+
+static const std::string kChunkedResponse =
+    "HTTP/1.1 200 OK\r\n"
+    "transfer-encoding: chunked\r\n"
+    "\r\n"
+    "5\r\nhello\r\n"
+    "7\r\n, world\r\n"
+    "0\r\n\r\n";
+
+DROGON_TEST(HttpResponseParser)
+{
+    HttpResponseParser parser(nullptr);
+    trantor::MsgBuffer buffer;
+    buffer.append(kChunkedResponse);
+    CHECK(parser.parseResponse(&buffer));
+    REQUIRE(parser.gotAll());
+    CHECK(parser.responseImpl()->body() == "hello, world");
+
+    SUBSECTION(StreamedChunks)
+    {
+        // Fed one byte at a time, the chunks are passed on as they come
+        HttpResponseParser streamParser(nullptr);
+        std::string body;
+        size_t pieces{0};
+        streamParser.setBodyCallback([&](const char *data, size_t length) {
+            body.append(data, length);
+            ++pieces;
+        });
+        trantor::MsgBuffer input;
+        bool headers{false};
+        for (char c : kChunkedResponse)
+        {
+            input.append(&c, 1);
+            CHECK(streamParser.parseResponse(&input));
+            if (streamParser.headersComplete() && !headers)
+            {
+                headers = true;
+                CHECK(body.empty());
+                CHECK(streamParser.responseImpl()->statusCode() == k200OK);
+            }
+        }
+        CHECK(streamParser.gotAll());
+        CHECK(body == "hello, world");
+        CHECK(pieces == 12);
+        CHECK(streamParser.responseImpl()->body().empty());
+    }
+
+    SUBSECTION(StreamedContentLength)
+    {
+        HttpResponseParser streamParser(nullptr);
+        std::string body;
+        streamParser.setBodyCallback([&](const char *data, size_t length) {
+            body.append(data, length);
+        });
+        trantor::MsgBuffer input;
+        input.append("HTTP/1.1 200 OK\r\ncontent-length: 6\r\n\r\nabc");
+        // Stops after the headers
+        CHECK(streamParser.parseResponse(&input));
+        CHECK(streamParser.headersComplete());
+        CHECK(body.empty());
+        CHECK(streamParser.parseResponse(&input));
+        CHECK(body == "abc");
+        CHECK(!streamParser.gotAll());
+        input.append("def");
+        CHECK(streamParser.parseResponse(&input));
+        CHECK(streamParser.gotAll());
+        CHECK(body == "abcdef");
+    }
+
+    SUBSECTION(EarlyHints)
+    {
+        // The informational responses before the final one are skipped
+        HttpResponseParser hintsParser(nullptr);
+        trantor::MsgBuffer input;
+        input.append(
+            "HTTP/1.1 103 Early Hints\r\n"
+            "link: </style.css>; rel=preload; as=style\r\n"
+            "\r\n"
+            "HTTP/1.1 200 OK\r\ncontent-length: 2\r\n\r\nok");
+        CHECK(hintsParser.parseResponse(&input));
+        REQUIRE(hintsParser.gotAll());
+        CHECK(hintsParser.responseImpl()->statusCode() == k200OK);
+        CHECK(hintsParser.responseImpl()->getHeader("link").empty());
+        CHECK(hintsParser.responseImpl()->body() == "ok");
+    }
+}
@@ -37,5 +37,19 @@ DROGON_TEST(HttpViewData)
         CHECK(HttpViewData::htmlTranslate("#include <iostream>") ==
               "#include &lt;iostream&gt;");
         CHECK(HttpViewData::htmlTranslate("&gt;") == "&amp;gt;");
+
+        // The special characters around and across the 16 bytes blocks
+        std::string text(40, 'a');
+        CHECK(HttpViewData::needTranslation(text) == false);
+        text[15] = '"';
+        text[16] = '<';
+        text[39] = '>';
+        CHECK(HttpViewData::needTranslation(text) == true);
+        std::string expected = std::string(15, 'a') + "&quot;&lt;" +
+                               std::string(22, 'a') + "&gt;";
+        CHECK(HttpViewData::htmlTranslate(text) == expected);
+        std::string output = "x";
+        HttpViewData::appendHtmlTranslation(output, text);
+        CHECK(output == "x" + expected);
     }
 }
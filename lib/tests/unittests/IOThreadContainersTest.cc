@@ -0,0 +1,29 @@
+#include <drogon/drogon_test.h>
+#include <drogon/IOThreadContainers.h>
+
+#include <memory>
+#include <string>
+
+using namespace drogon;
+
+DROGON_TEST(IOThreadContainersTest)
+{
+    // The values of the loops are on cache lines of their own.
+    auto storage = std::make_shared<IOThreadStorage<int>>(0);
+    CHECK(storage->size() == app().getThreadNum() + 1);
+    CHECK((char *)&storage->at(1) - (char *)&storage->at(0) >= 64);
+
+    auto counter = std::make_shared<IOThreadCounter>();
+    auto pool = std::make_shared<IOThreadObjectPool<std::string>>(1);
+    app().getLoop()->queueInLoop([TEST_CTX, counter, pool]() {
+        counter->add(2);
+        counter->increment();
+        CHECK(counter->value() == 3);
+
+        // An object released in its loop is reused.
+        auto object = pool->acquire();
+        auto *raw = object.get();
+        object.reset();
+        CHECK(pool->acquire().get() == raw);
+    });
+}
@@ -0,0 +1,141 @@
+#include <drogon/utils/JsonReflect.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <drogon/drogon_test.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace reflect_test
+{
+enum class Role
+{
+    kAdmin = 1,
+    kUser = 2
+};
+
+struct Address
+{
+    std::string city;
+    int zip{0};
+};
+DROGON_REFLECT(Address, city, zip)
+
+struct User
+{
+    int64_t id{0};
+    std::string name;
+    std::vector<std::string> tags;
+    std::optional<double> score;
+    Role role{Role::kUser};
+    std::map<std::string, int> counts;
+    std::shared_ptr<Address> address;
+    std::set<int> ids;
+    Json::Value extra;
+};
+DROGON_REFLECT(User, id, name, tags, score, role, counts, address, ids, extra)
+
+// The way the ORM models write themselves
+struct Model
+{
+    int x{0};
+
+    void writeJson(drogon::JsonWriter &writer) const
+    {
+        writer.startObject();
+        writer.member("x", x);
+        writer.endObject();
+    }
+};
+}  // namespace reflect_test
+
+using namespace drogon;
+using namespace reflect_test;
+
+DROGON_TEST(JsonReflect)
+{
+    User user;
+    user.id = 7;
+    user.name = "a\"b";
+    user.tags = {"x", "y"};
+    user.role = Role::kAdmin;
+    user.counts = {{"k", 1}};
+    user.address = std::make_shared<Address>(Address{"Paris", 75});
+    user.ids = {3, 1};
+    user.extra["q"] = 1;
+    const std::string text =
+        R"({"id":7,"name":"a\"b","tags":["x","y"],"score":null,"role":1,)"
+        R"("counts":{"k":1},"address":{"city":"Paris","zip":75},)"
+        R"("ids":[1,3],"extra":{"q":1}})";
+    CHECK(toJsonString(user) == text);
+
+    User copy;
+    std::string errors;
+    CHECK(fromJsonString(text, copy, &errors));
+    CHECK(toJsonString(copy) == text);
+
+    SUBSECTION(UnknownAndMissingMembers)
+    {
+        User parsed;
+        CHECK(fromJsonString(
+            R"( {"other":[1,{"a":[]},"\ud83d\ude00"],)"
+            R"( "name":"\u00e9\n", "score":2.5, "address":{}} )",
+            parsed));
+        CHECK(parsed.name == "\xc3\xa9\n");
+        CHECK(parsed.score == 2.5);
+        CHECK(parsed.id == 0);
+        REQUIRE(parsed.address != nullptr);
+        CHECK(parsed.address->city.empty());
+    }
+
+    SUBSECTION(Errors)
+    {
+        User parsed;
+        CHECK(!fromJsonString(R"({"id":1.5})", parsed, &errors));
+        CHECK(errors == "expected an integer at offset 9");
+        CHECK(!fromJsonString(R"({"id":1,})", parsed));
+        CHECK(!fromJsonString(R"({"name":1})", parsed));
+        CHECK(!fromJsonString(R"({"id":1} x)", parsed));
+        CHECK(!fromJsonString(R"({"id":99999999999999999999})", parsed));
+        JsonReader reader(std::string(2000, '[') + std::string(2000, ']'));
+        CHECK(!reader.skipValue());
+    }
+
+    SUBSECTION(JsonValue)
+    {
+        Json::Value value;
+        JsonReader reader(
+            R"([1,-2,18446744073709551615,2.5,"s",{"b":[null]}])");
+        CHECK(reader.readValue(value));
+        CHECK(reader.finish());
+        CHECK(value[0].isInt());
+        CHECK(value[2].isUInt64());
+        CHECK(value[3].asDouble() == 2.5);
+        CHECK(value[5]["b"][0].isNull());
+    }
+
+    SUBSECTION(Models)
+    {
+        std::vector<Model> models{{1}, {2}};
+        CHECK(toJsonString(models) == R"([{"x":1},{"x":2}])");
+    }
+
+    SUBSECTION(Http)
+    {
+        auto resp = HttpResponse::newHttpJsonResponse(user);
+        CHECK(resp->contentType() == CT_APPLICATION_JSON);
+        CHECK(resp->body() == text);
+
+        Json::Value json;
+        json["id"] = 3;
+        json["name"] = "drogon";
+        auto req = HttpRequest::newHttpJsonRequest(json);
+        auto parsed = req->as<User>();
+        CHECK(parsed.id == 3);
+        CHECK(parsed.name == "drogon");
+
+        auto form = HttpRequest::newHttpFormPostRequest();
+        CHECK_THROWS(form->as<User>());
+    }
+}
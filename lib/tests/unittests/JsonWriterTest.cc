@@ -0,0 +1,143 @@
+#include <drogon/utils/JsonWriter.h>
+#include <drogon/JsonEngine.h>
+#include <drogon/HttpResponse.h>
+#include <drogon/drogon_test.h>
+#include <json/json.h>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+static std::string jsoncppWrite(const Json::Value &json, bool emitUTF8 = false)
+{
+    Json::StreamWriterBuilder builder;
+    builder["commentStyle"] = "None";
+    builder["indentation"] = "";
+    if (emitUTF8)
+        builder["emitUTF8"] = true;
+    return Json::writeString(builder, json);
+}
+
+static std::string write(const Json::Value &json, bool escapeUnicode = true)
+{
+    std::string output;
+    JsonWriter::Options options;
+    options.escapeUnicode = escapeUnicode;
+    JsonWriter writer(output, options);
+    writer.value(json);
+    return output;
+}
+
+DROGON_TEST(JsonWriter)
+{
+    std::string output;
+    JsonWriter writer(output);
+    writer.startObject();
+    writer.member("id", 42);
+    writer.member("name", "drogon");
+    writer.member("ratio", 0.5);
+    writer.key("tags");
+    writer.startArray();
+    writer.value(true);
+    writer.value(nullptr);
+    writer.startObject();
+    writer.endObject();
+    writer.raw("[1,2]");
+    writer.endArray();
+    writer.endObject();
+    CHECK(output == R"({"id":42,"name":"drogon","ratio":0.5,)"
+                    R"("tags":[true,null,{},[1,2]]})");
+
+    SUBSECTION(MatchesJsoncpp)
+    {
+        Json::Value json;
+        json["int"] = Json::Int64(-123456789012LL);
+        json["uint"] = Json::UInt64(18446744073709551615ULL);
+        json["double"] = 3.14159265358979;
+        json["integral double"] = 2.0;
+        json["small"] = 1e-300;
+        json["escapes"] = "\"quoted\"\\\b\f\n\r\t\x01\x1f/";
+        json["empty"] = Json::Value(Json::objectValue);
+        json["array"].append(Json::Value());
+        json["array"].append(false);
+        json["array"].append(Json::Value(Json::arrayValue));
+        json["nested"]["a"]["b"] = "c";
+        CHECK(write(json) == jsoncppWrite(json));
+    }
+
+    SUBSECTION(Unicode)
+    {
+        Json::Value json;
+        json["text"] = "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80";
+        CHECK(write(json) == jsoncppWrite(json));
+        CHECK(write(json, false) == jsoncppWrite(json, true));
+    }
+
+    SUBSECTION(EngineRoundTrip)
+    {
+        auto engine = JsonEngine::newDefaultEngine();
+        Json::Value json;
+        std::string errors;
+        CHECK(engine->parse(R"({"a":[1,2.5,"x"],"b":null})", json, errors));
+        std::string text;
+        engine->serialize(json, text);
+        CHECK(text == R"({"a":[1,2.5,"x"],"b":null})");
+        CHECK(!engine->parse("{\"a\":", json, errors));
+        CHECK(!errors.empty());
+    }
+}
+
+namespace
+{
+class RecordingAsyncStream : public trantor::AsyncStream
+{
+  public:
+    explicit RecordingAsyncStream(std::vector<std::string> &chunks)
+        : chunks_(chunks)
+    {
+    }
+
+    using trantor::AsyncStream::send;
+
+    bool send(const char *data, size_t len) override
+    {
+        chunks_.emplace_back(data, len);
+        return true;
+    }
+
+    void close() override
+    {
+    }
+
+  private:
+    std::vector<std::string> &chunks_;
+};
+}  // namespace
+
+DROGON_TEST(JsonArrayStream)
+{
+    std::vector<std::string> chunks;
+    auto stream = std::make_unique<JsonArrayStream>(
+        std::make_unique<ResponseStream>(
+            std::make_unique<RecordingAsyncStream>(chunks)),
+        8);
+    for (int i = 0; i < 5; ++i)
+        CHECK(stream->append(i * 1000));
+    // The elements are sent whenever 8 bytes are buffered
+    CHECK(chunks.size() == 2);
+    Json::Value json;
+    json["a"] = "b";
+    CHECK(stream->append(json));
+    stream->close();
+    CHECK(!stream->append(1));
+
+    std::string body;
+    for (auto &chunk : chunks)
+    {
+        auto pos = chunk.find("\r\n");
+        auto length = std::stoul(chunk.substr(0, pos), nullptr, 16);
+        body.append(chunk, pos + 2, length);
+    }
+    CHECK(body == R"([0,1000,2000,3000,4000,{"a":"b"}])");
+    CHECK(chunks.back() == "0\r\n\r\n");
+}
@@ -0,0 +1,132 @@
+#include <drogon/drogon_test.h>
+#include <drogon/utils/monitoring/Counter.h>
+#include <drogon/utils/monitoring/ExponentialHistogram.h>
+#include <drogon/utils/monitoring/Gauge.h>
+#include <drogon/utils/monitoring/Histogram.h>
+#include <drogon/utils/monitoring/Collector.h>
+#include "../../lib/src/RouteCost.h"
+
+#include <thread>
+#include <vector>
+
+using namespace drogon::monitoring;
+
+DROGON_TEST(MetricsTest)
+{
+    auto counter = std::make_shared<Counter>("requests",
+                                             std::vector<std::string>{},
+                                             std::vector<std::string>{});
+    auto gauge = std::make_shared<Gauge>("in_flight",
+                                         std::vector<std::string>{},
+                                         std::vector<std::string>{});
+    auto histogram =
+        std::make_shared<Histogram>("latency",
+                                    std::vector<std::string>{},
+                                    std::vector<std::string>{},
+                                    std::vector<double>{1, 10},
+                                    std::chrono::seconds(0),
+                                    0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 1000; ++j)
+            {
+                counter->increment();
+                counter->increment(0.5);
+                gauge->increment();
+                gauge->decrement(0.5);
+                histogram->observe(j % 20);
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    CHECK(counter->collect()[0].value == 12000);
+    CHECK(gauge->collect()[0].value == 4000);
+    gauge->set(3);
+    CHECK(gauge->collect()[0].value == 3);
+
+    auto samples = histogram->collect();
+    REQUIRE(samples.size() == 5);
+    CHECK(samples[0].value == 8 * 100);   // le 1
+    CHECK(samples[1].value == 8 * 550);   // le 10
+    CHECK(samples[2].value == 8 * 1000);  // +Inf
+    CHECK(samples[4].value == 8 * 1000);  // count
+}
+
+DROGON_TEST(ExponentialHistogramTest)
+{
+    auto histogram = std::make_shared<ExponentialHistogram>(
+        "latency", std::vector<std::string>{}, std::vector<std::string>{});
+    CHECK(histogram->quantile(0.5) == 0);
+    // 1ms to 1s
+    for (int i = 1; i <= 1000; ++i)
+        histogram->observe(i / 1000.0);
+    histogram->observe(1e4);
+
+    // The bounds are at most about 9% above the exact values.
+    auto p50 = histogram->quantile(0.5);
+    CHECK(p50 >= 0.5);
+    CHECK(p50 < 0.5 * 1.1);
+    auto p99 = histogram->quantile(0.99);
+    CHECK(p99 >= 0.99);
+    CHECK(p99 < 0.99 * 1.1);
+
+    auto samples = histogram->collect();
+    REQUIRE(samples.size() >= 3);
+    auto &inf = samples[samples.size() - 3];
+    CHECK(inf.exLabels[0].second == "+Inf");
+    CHECK(inf.value == 1001);
+    CHECK(samples[samples.size() - 4].value == 1000);
+    CHECK(samples.back().value == 1001);
+}
+
+DROGON_TEST(RouteCostTest)
+{
+    using drogon::AllocationCounter;
+    using drogon::BuiltinMetrics;
+    using drogon::RouteCostScope;
+    auto &metrics = BuiltinMetrics::instance();
+    auto labels = std::vector<std::string>{"route"};
+    metrics.routeCpuTime =
+        std::make_shared<Collector<Counter>>("cpu", "", labels);
+    metrics.routeAllocations =
+        std::make_shared<Collector<Counter>>("allocations", "", labels);
+    metrics.routeAllocatedBytes =
+        std::make_shared<Collector<Counter>>("bytes", "", labels);
+
+    auto before = AllocationCounter::current();
+    AllocationCounter::record(100);
+    CHECK(AllocationCounter::current().allocations == before.allocations + 1);
+    CHECK(AllocationCounter::current().bytes == before.bytes + 100);
+
+    {
+        RouteCostScope scope("/users/{id}");
+        {
+            // Accounted by the outer scope
+            RouteCostScope inner("/users/{id}");
+            AllocationCounter::record(10);
+        }
+        AllocationCounter::record(30);
+        auto start = RouteCostScope::threadCpuTime();
+        while (RouteCostScope::threadCpuTime() - start < 0.01)
+        {
+        }
+    }
+    auto value = [](const auto &collector) {
+        return collector->metric({"/users/{id}"})->collect()[0].value;
+    };
+    CHECK(value(metrics.routeCpuTime) >= 0.01);
+    CHECK(value(metrics.routeAllocations) == 2);
+    CHECK(value(metrics.routeAllocatedBytes) == 40);
+
+    metrics.routeCpuTime.reset();
+    metrics.routeAllocations.reset();
+    metrics.routeAllocatedBytes.reset();
+    {
+        // Disabled
+        RouteCostScope scope("/users/{id}");
+    }
+}
@@ -0,0 +1,83 @@
+#include <drogon/HttpMiddleware.h>
+#include <drogon/drogon_test.h>
+#include <string>
+
+using namespace drogon;
+
+namespace
+{
+std::string trace;
+}
+
+class FirstMiddleware : public HttpMiddleware<FirstMiddleware>
+{
+  public:
+    void invoke(const HttpRequestPtr &,
+                MiddlewareNextCallback &&nextCb,
+                MiddlewareCallback &&mcb) override
+    {
+        trace += "1";
+        nextCb([mcb = std::move(mcb)](const HttpResponsePtr &resp) {
+            trace += "-1";
+            mcb(resp);
+        });
+    }
+};
+
+class SecondMiddleware : public HttpMiddleware<SecondMiddleware>
+{
+  public:
+    void invoke(const HttpRequestPtr &req,
+                MiddlewareNextCallback &&nextCb,
+                MiddlewareCallback &&mcb) override
+    {
+        trace += "2";
+        if (req->path() == "/denied")
+        {
+            mcb(HttpResponse::newHttpResponse(k403Forbidden, CT_TEXT_PLAIN));
+            return;
+        }
+        nextCb([mcb = std::move(mcb)](const HttpResponsePtr &resp) {
+            trace += "-2";
+            mcb(resp);
+        });
+    }
+};
+
+class TestChain
+    : public HttpMiddlewareChain<TestChain, FirstMiddleware, SecondMiddleware>
+{
+};
+
+DROGON_TEST(MiddlewareChain)
+{
+    TestChain chain;
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/allowed");
+    HttpResponsePtr result;
+    chain.invoke(
+        req,
+        [](MiddlewareCallback &&mcb) {
+            trace += "h";
+            mcb(HttpResponse::newHttpResponse());
+        },
+        [&result](const HttpResponsePtr &resp) { result = resp; });
+    CHECK(trace == "12h-2-1");
+    REQUIRE(result != nullptr);
+    CHECK(result->statusCode() == k200OK);
+
+    trace.clear();
+    result.reset();
+    req->setPath("/denied");
+    chain.invoke(
+        req,
+        [](MiddlewareCallback &&mcb) {
+            trace += "h";
+            mcb(HttpResponse::newHttpResponse());
+        },
+        [&result](const HttpResponsePtr &resp) { result = resp; });
+    // The handler isn't called, the first middleware still sees the response.
+    CHECK(trace == "12-1");
+    REQUIRE(result != nullptr);
+    CHECK(result->statusCode() == k403Forbidden);
+}
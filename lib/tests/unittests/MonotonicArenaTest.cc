@@ -0,0 +1,53 @@
+#include <drogon/utils/MonotonicArena.h>
+#include <drogon/drogon_test.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+DROGON_TEST(MonotonicArenaTest)
+{
+    MonotonicArena arena(64);
+    auto p1 = arena.allocate(10, 1);
+    auto p2 = arena.allocate(8, 8);
+    CHECK(reinterpret_cast<uintptr_t>(p2) % 8 == 0);
+    CHECK(static_cast<char *>(p2) >= static_cast<char *>(p1) + 10);
+    CHECK(arena.bytesAllocated() == 18);
+
+    // Larger than the block size
+    auto big = static_cast<char *>(arena.allocate(1000));
+    memset(big, 'a', 1000);
+    auto sv = arena.copy("hello");
+    CHECK(sv == "hello");
+
+    struct Point
+    {
+        int x;
+        int y;
+    };
+    auto pt = arena.create<Point>(Point{1, 2});
+    CHECK(pt->x == 1);
+    CHECK(pt->y == 2);
+
+    arena.reset();
+    CHECK(arena.bytesAllocated() == 0);
+    // The largest block is reused
+    auto p3 = static_cast<char *>(arena.allocate(900));
+    memset(p3, 'b', 900);
+    CHECK(arena.bytesAllocated() == 900);
+
+    {
+        std::vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>(arena)};
+        for (int i = 0; i < 100; ++i)
+            v.push_back(i);
+        CHECK(v.size() == 100);
+        CHECK(v[99] == 99);
+        using ArenaString = std::
+            basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+        ArenaString s("a string longer than the small string buffer",
+                      ArenaAllocator<char>(arena));
+        CHECK(s.size() == 44);
+    }
+    arena.reset();
+}
@@ -0,0 +1,37 @@
+#include "../../lib/src/OutputWatermark.h"
+#include <drogon/drogon_test.h>
+#include <vector>
+
+using namespace drogon;
+using namespace drogon::internal;
+
+DROGON_TEST(OutputWatermark)
+{
+    std::vector<bool> calls;
+    OutputWatermark watermark(1024,
+                              BackpressurePolicy::Pause,
+                              [&calls](bool writable) {
+                                  calls.push_back(writable);
+                              });
+    CHECK(watermark.writable());
+    watermark.onQueued(nullptr, 1024);
+    CHECK(watermark.writable());
+    CHECK(calls.empty());
+
+    // Told once when the mark is exceeded, once when the queue is sent.
+    watermark.onQueued(nullptr, 1025);
+    watermark.onQueued(nullptr, 4096);
+    CHECK(!watermark.writable());
+    CHECK(calls == std::vector<bool>{false});
+    watermark.onDrained();
+    watermark.onDrained();
+    CHECK(watermark.writable());
+    CHECK((calls == std::vector<bool>{false, true}));
+
+    OutputWatermark dropping(16, BackpressurePolicy::Drop, nullptr);
+    dropping.onQueued(nullptr, 17);
+    CHECK(!dropping.writable());
+    CHECK(dropping.policy() == BackpressurePolicy::Drop);
+    dropping.onDrained();
+    CHECK(dropping.writable());
+}
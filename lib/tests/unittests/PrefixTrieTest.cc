@@ -0,0 +1,31 @@
+#include "../../lib/src/PrefixTrie.h"
+#include <drogon/drogon_test.h>
+
+using namespace drogon::internal;
+
+DROGON_TEST(PrefixTrieTest)
+{
+    PrefixTrie trie;
+    CHECK(trie.empty());
+    CHECK(trie.match("/a") == PrefixTrie::npos);
+
+    trie.insert("/tenant/a/", 2);
+    trie.insert("/tenant/", 1);
+    trie.insert("/tenant/ab/", 0);
+    trie.insert("/tenant/", 3);
+    CHECK(!trie.empty());
+
+    // The smallest index wins, not the longest prefix
+    CHECK(trie.match("/tenant/a/x.js") == 1);
+    CHECK(trie.match("/tenant/ab/x.js") == 0);
+    CHECK(trie.match("/tenant/") == 1);
+    CHECK(trie.match("/tenant") == PrefixTrie::npos);
+    CHECK(trie.match("/other/x.js") == PrefixTrie::npos);
+    CHECK(trie.match("") == PrefixTrie::npos);
+
+    PrefixTrie root;
+    root.insert("", 5);
+    root.insert("/b", 4);
+    CHECK(root.match("/a") == 5);
+    CHECK(root.match("/b/c") == 4);
+}
@@ -0,0 +1,283 @@
+#include <drogon/drogon_test.h>
+#include <drogon/utils/Utilities.h>
+#include <trantor/net/EventLoopThread.h>
+#include "../../lib/src/CpuProfiler.h"
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace drogon;
+using namespace drogon::internal;
+
+namespace
+{
+// The fields of a protocol buffers message, by field number. The varints
+// are stored as their values, the length-delimited fields as their bytes.
+using ProtoFields = std::multimap<int, std::string>;
+
+bool readVarint(std::string_view &data, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (data.empty())
+            return false;
+        auto byte = static_cast<uint8_t>(data[0]);
+        data.remove_prefix(1);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool parseProto(std::string_view data, ProtoFields &fields)
+{
+    while (!data.empty())
+    {
+        uint64_t key, value;
+        if (!readVarint(data, key))
+            return false;
+        auto field = static_cast<int>(key >> 3);
+        switch (key & 7)
+        {
+            case 0:
+                if (!readVarint(data, value))
+                    return false;
+                fields.emplace(field, std::to_string(value));
+                break;
+            case 2:
+                if (!readVarint(data, value) || value > data.length())
+                    return false;
+                fields.emplace(field, std::string(data.substr(0, value)));
+                data.remove_prefix(value);
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+std::vector<uint64_t> unpack(std::string_view data)
+{
+    std::vector<uint64_t> values;
+    uint64_t value;
+    while (!data.empty() && readVarint(data, value))
+        values.push_back(value);
+    return values;
+}
+
+struct DecodedSample
+{
+    std::vector<uint64_t> locations;
+    std::vector<uint64_t> values;
+    std::map<std::string, std::string> labels;
+};
+
+struct DecodedProfile
+{
+    std::vector<std::string> strings;
+    std::vector<std::pair<std::string, std::string>> sampleTypes;
+    std::vector<DecodedSample> samples;
+    std::set<uint64_t> locationIds;
+    size_t mappings{0};
+    uint64_t period{0};
+};
+
+bool decodeProfile(const std::string &gzipped, DecodedProfile &profile)
+{
+    auto data = utils::gzipDecompress(gzipped.data(), gzipped.length());
+    ProtoFields fields;
+    if (data.empty() || !parseProto(data, fields))
+        return false;
+    for (auto [iter, end] = fields.equal_range(6); iter != end; ++iter)
+        profile.strings.push_back(iter->second);
+    auto stringAt = [&profile](const std::string &index) {
+        auto i = std::stoull(index);
+        return i < profile.strings.size() ? profile.strings[i] : "?";
+    };
+    for (auto &[field, value] : fields)
+    {
+        ProtoFields message;
+        switch (field)
+        {
+            case 1:
+                if (!parseProto(value, message))
+                    return false;
+                profile.sampleTypes.emplace_back(
+                    stringAt(message.find(1)->second),
+                    stringAt(message.find(2)->second));
+                break;
+            case 2:
+            {
+                if (!parseProto(value, message))
+                    return false;
+                DecodedSample sample;
+                sample.locations = unpack(message.find(1)->second);
+                sample.values = unpack(message.find(2)->second);
+                for (auto [iter, end] = message.equal_range(3); iter != end;
+                     ++iter)
+                {
+                    ProtoFields label;
+                    if (!parseProto(iter->second, label))
+                        return false;
+                    sample.labels[stringAt(label.find(1)->second)] =
+                        stringAt(label.find(2)->second);
+                }
+                profile.samples.push_back(std::move(sample));
+                break;
+            }
+            case 3:
+                ++profile.mappings;
+                break;
+            case 4:
+                if (!parseProto(value, message))
+                    return false;
+                profile.locationIds.insert(
+                    std::stoull(message.find(1)->second));
+                break;
+            case 12:
+                profile.period = std::stoull(value);
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+// Spin on the cpu for the given time, so that the thread is sampled.
+void burnCpu(std::chrono::milliseconds duration)
+{
+    volatile uint64_t sum = 0;
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        for (int i = 0; i < 1000; ++i)
+            sum = sum + i;
+    }
+}
+}  // namespace
+
+#ifdef __linux__
+DROGON_TEST(CpuProfilerStartStop)
+{
+    auto &profiler = CpuProfiler::instance();
+    CHECK(profiler.running() == false);
+    CHECK(profiler.stop().empty());
+
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    std::vector<trantor::EventLoop *> loops{loopThread.getLoop()};
+    CHECK(profiler.start(loops, 0, 16) == false);
+    CHECK(profiler.start(loops, 1001, 16) == false);
+    CHECK(profiler.running() == false);
+
+    REQUIRE(profiler.start(loops, 100, 16));
+    CHECK(profiler.running());
+    // Only one profile at a time
+    CHECK(profiler.start(loops, 100, 16) == false);
+    auto profile = profiler.stop();
+    CHECK(profiler.running() == false);
+
+    // An empty profile is still a valid one.
+    DecodedProfile decoded;
+    REQUIRE(decodeProfile(profile, decoded));
+    CHECK(decoded.period == 10000000);
+    CHECK(decoded.strings.size() > 0);
+    CHECK(decoded.strings[0].empty());
+}
+
+DROGON_TEST(CpuProfilerSampling)
+{
+    auto &profiler = CpuProfiler::instance();
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+    REQUIRE(profiler.start({loop}, 1000, 4096));
+
+    std::promise<void> done;
+    loop->queueInLoop([&done]() {
+        {
+            CpuProfiler::RouteScope scope("/busy/{id}");
+            burnCpu(std::chrono::milliseconds(300));
+        }
+        // The samples taken out of the scope have no route.
+        burnCpu(std::chrono::milliseconds(100));
+        done.set_value();
+    });
+    done.get_future().wait();
+    auto profile = profiler.stop();
+
+    DecodedProfile decoded;
+    REQUIRE(decodeProfile(profile, decoded));
+    REQUIRE(decoded.sampleTypes.size() == 2);
+    CHECK(decoded.sampleTypes[0].first == "samples");
+    CHECK(decoded.sampleTypes[0].second == "count");
+    CHECK(decoded.sampleTypes[1].first == "cpu");
+    CHECK(decoded.sampleTypes[1].second == "nanoseconds");
+    CHECK(decoded.period == 1000000);
+    CHECK(decoded.mappings > 0);
+    REQUIRE(!decoded.samples.empty());
+
+    uint64_t hits{0}, routeHits{0};
+    std::set<std::pair<std::vector<uint64_t>, std::string>> stacks;
+    for (auto &sample : decoded.samples)
+    {
+        REQUIRE(sample.values.size() == 2);
+        CHECK(sample.values[0] > 0);
+        // The cpu time is the hits times the period.
+        CHECK(sample.values[1] == sample.values[0] * decoded.period);
+        CHECK(sample.labels["thread"] == "io-0");
+        CHECK(!sample.locations.empty());
+        for (auto id : sample.locations)
+            CHECK(decoded.locationIds.count(id) == 1);
+        hits += sample.values[0];
+        auto route = sample.labels.find("route");
+        if (route != sample.labels.end())
+        {
+            CHECK(route->second == "/busy/{id}");
+            routeHits += sample.values[0];
+        }
+        // The identical stacks of a route are merged into one sample.
+        auto key = std::make_pair(
+            sample.locations,
+            route == sample.labels.end() ? std::string() : route->second);
+        CHECK(stacks.insert(std::move(key)).second);
+    }
+    // About 400 ms of cpu time at 1000 Hz, the bounds leave room for a
+    // loaded machine.
+    CHECK(hits >= 40);
+    CHECK(hits <= 1000);
+    CHECK(routeHits > 0);
+    CHECK(routeHits < hits);
+}
+
+DROGON_TEST(CpuProfilerMaxSamples)
+{
+    auto &profiler = CpuProfiler::instance();
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+    REQUIRE(profiler.start({loop}, 1000, 8));
+
+    std::promise<void> done;
+    loop->queueInLoop([&done]() {
+        burnCpu(std::chrono::milliseconds(200));
+        done.set_value();
+    });
+    done.get_future().wait();
+
+    DecodedProfile decoded;
+    REQUIRE(decodeProfile(profiler.stop(), decoded));
+    // The samples beyond the bound are dropped.
+    CHECK(decoded.samples.size() <= 8);
+    CHECK(!decoded.samples.empty());
+}
+#endif
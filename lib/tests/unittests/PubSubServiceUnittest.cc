@@ -1,5 +1,7 @@
 #include <drogon/PubSubService.h>
 #include <drogon/drogon_test.h>
+#include <trantor/net/EventLoopThread.h>
+#include <future>
 
 DROGON_TEST(PubSubServiceTest)
 {
@@ -16,3 +18,59 @@ DROGON_TEST(PubSubServiceTest)
     service.unsubscribe("topic1", id);
     CHECK(service.size() == 0UL);
 }
+
+DROGON_TEST(PubSubServiceReentrancyTest)
+{
+    drogon::PubSubService<int> service;
+    int received{0};
+    drogon::SubscriberID id;
+    // Handlers are not invoked under the lock, so they can change the
+    // subscriptions of the topic they are subscribed to
+    id = service.subscribe("topic", [&](const std::string &, const int &) {
+        ++received;
+        service.unsubscribe("topic", id);
+    });
+    service.subscribe("topic", [&](const std::string &, const int &) {
+        ++received;
+    });
+    service.publish("topic", 1);
+    CHECK(received == 2);
+    service.publish("topic", 2);
+    CHECK(received == 3);
+    CHECK(service.size() == 1UL);
+    service.clear();
+    CHECK(service.isTopicEmpty("topic"));
+}
+
+DROGON_TEST(PubSubServiceLoopTest)
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+    drogon::PubSubService<int> service;
+    int sum{0};
+    bool inLoop{true};
+    for (int i = 0; i < 2; ++i)
+    {
+        service.subscribe("topic",
+                          loop,
+                          [&sum, &inLoop, loop](const std::string &,
+                                                const int &message) {
+                              inLoop = inLoop && loop->isInLoopThread();
+                              sum += message;
+                          });
+    }
+    int direct{0};
+    service.subscribe("topic", [&direct](const std::string &, const int &m) {
+        direct += m;
+    });
+    service.publish("topic", 1);
+    service.publish("topic", 2);
+    CHECK(direct == 3);
+    // The tasks of the loop run in order
+    std::promise<void> done;
+    loop->queueInLoop([&done]() { done.set_value(); });
+    done.get_future().wait();
+    CHECK(sum == 6);
+    CHECK(inLoop);
+}
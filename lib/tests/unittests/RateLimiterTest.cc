@@ -0,0 +1,48 @@
+#include <drogon/drogon_test.h>
+#include <drogon/RateLimiter.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+static size_t countAllowed(const RateLimiterPtr &limiter, size_t requests)
+{
+    std::atomic<size_t> allowed{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&]() {
+            for (size_t j = 0; j < requests; ++j)
+            {
+                if (limiter->isAllowed())
+                    ++allowed;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    return allowed;
+}
+
+DROGON_TEST(RateLimiterTest)
+{
+    const RateLimiterType types[] = {RateLimiterType::kFixedWindow,
+                                     RateLimiterType::kSlidingWindow,
+                                     RateLimiterType::kTokenBucket};
+    for (auto type : types)
+    {
+        // No request is lost or allowed twice by concurrent threads.
+        auto limiter = RateLimiter::newRateLimiter(type, 1000, 1h);
+        CHECK(countAllowed(limiter, 1000) == 1000);
+        CHECK(limiter->isAllowed() == false);
+
+        limiter = RateLimiter::newRateLimiter(type, 10, 100ms);
+        CHECK(countAllowed(limiter, 10) == 10);
+        std::this_thread::sleep_for(250ms);
+        CHECK(limiter->isAllowed() == true);
+    }
+}
@@ -0,0 +1,37 @@
+#include <drogon/drogon_test.h>
+#include <drogon/RedisSessionStore.h>
+#include <json/json.h>
+
+using namespace drogon;
+
+DROGON_TEST(RedisSessionStoreCodecTest)
+{
+    Session::SessionMap data;
+    data["name"] = std::string("drogon");
+    data["logged in"] = true;
+    data["count"] = 3;
+    data["id"] = int64_t(1) << 40;
+    data["score"] = 0.5;
+    Json::Value json;
+    json["a"] = 1;
+    data["json"] = json;
+    // Not supported by the default codec
+    data["vector"] = std::vector<int>{1, 2};
+
+    auto str = RedisSessionStore::defaultEncoder(data);
+    Session::SessionMap decoded;
+    REQUIRE(RedisSessionStore::defaultDecoder(str, decoded));
+    CHECK(decoded.size() == 6UL);
+    CHECK(std::any_cast<std::string>(decoded["name"]) == "drogon");
+    CHECK(std::any_cast<bool>(decoded["logged in"]) == true);
+    CHECK(std::any_cast<int>(decoded["count"]) == 3);
+    CHECK(std::any_cast<int64_t>(decoded["id"]) == (int64_t(1) << 40));
+    CHECK(std::any_cast<double>(decoded["score"]) == 0.5);
+    CHECK(std::any_cast<Json::Value>(decoded["json"])["a"].asInt() == 1);
+    CHECK(decoded.find("vector") == decoded.end());
+
+    Session::SessionMap invalid;
+    CHECK(RedisSessionStore::defaultDecoder("[1,2]", invalid) == false);
+    CHECK(RedisSessionStore::defaultDecoder("{\"a\":[\"int\",\"x\"]}",
+                                            invalid) == false);
+}
@@ -0,0 +1,129 @@
+#include "../../lib/src/HttpClientImpl.h"
+#include "../../lib/src/HttpRequestImpl.h"
+#include <drogon/HttpClient.h>
+#include <drogon/drogon_test.h>
+#include <trantor/utils/MsgBuffer.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace drogon;
+
+namespace
+{
+std::string renderHeader(const HttpRequestPtr &req)
+{
+    trantor::MsgBuffer buffer;
+    static_cast<HttpRequestImpl *>(req.get())->appendToBuffer(&buffer);
+    return std::string(buffer.peek(), buffer.readableBytes());
+}
+
+class RecordingBodyStream : public RequestBodyStream
+{
+  public:
+    bool send(const char *data, size_t length) override
+    {
+        body.append(data, length);
+        return true;
+    }
+
+    void close() override
+    {
+        closed = true;
+    }
+
+    void abort() override
+    {
+        aborted = true;
+    }
+
+    size_t bufferedBytes() const override
+    {
+        return body.length();
+    }
+
+    void setDrainCallback(std::function<void()>) override
+    {
+    }
+
+    std::string body;
+    bool closed{false};
+    bool aborted{false};
+};
+}  // namespace
+
+DROGON_TEST(RequestBodyStream)
+{
+    auto req = std::make_shared<HttpRequestImpl>(nullptr);
+    req->setMethod(Put);
+    req->setPath("/bucket/key");
+    // The body isn't written, only the headers are checked
+    req->setBodyStream(std::make_shared<internal::ClientBodyStream>(
+        nullptr, std::weak_ptr<HttpClientImpl>()));
+    auto head = renderHeader(req);
+    CHECK(head.find("transfer-encoding: chunked\r\n") != std::string::npos);
+    CHECK(head.find("content-length") == std::string::npos);
+
+    SUBSECTION(Forward)
+    {
+        auto body = std::make_shared<RecordingBodyStream>();
+        auto reader = RequestBodyStream::newForwardReader(body, 8);
+        reader->onStreamData("abcd", 4);
+        reader->onStreamData("ef", 2);
+        reader->onStreamFinish({});
+        CHECK(body->body == "abcdef");
+        CHECK(body->closed);
+        CHECK(!body->aborted);
+    }
+
+    SUBSECTION(SlowUpstream)
+    {
+        auto body = std::make_shared<RecordingBodyStream>();
+        auto reader = RequestBodyStream::newForwardReader(body, 8);
+        reader->onStreamData("abcdef", 6);
+        reader->onStreamData("ghi", 3);
+        reader->onStreamData("j", 1);
+        reader->onStreamFinish({});
+        CHECK(body->body == "abcdef");
+        CHECK(body->aborted);
+        CHECK(!body->closed);
+    }
+
+    SUBSECTION(FileBody)
+    {
+        auto path = std::filesystem::temp_directory_path() /
+                    "drogon_request_body_test.txt";
+        std::ofstream(path, std::ios::binary) << "0123456789";
+        auto fileReq = HttpRequest::newFileRequest(path.string(), 2);
+        auto fileHead = renderHeader(fileReq);
+        CHECK(fileHead.find("content-length: 8\r\n") != std::string::npos);
+        CHECK(fileHead.find("content-type: text/plain") != std::string::npos);
+        CHECK(static_cast<HttpRequestImpl *>(fileReq.get())->sendfileRange() ==
+              std::make_pair<size_t, size_t>(2, 8));
+        std::filesystem::remove(path);
+    }
+
+    SUBSECTION(StreamBody)
+    {
+        bool sent{false};
+        auto streamReq = HttpRequest::newStreamRequest(
+            [&sent](char *buffer, size_t length) -> size_t {
+                if (!buffer || sent || length < 5)
+                    return 0;
+                sent = true;
+                memcpy(buffer, "hello", 5);
+                return 5;
+            });
+        CHECK(renderHeader(streamReq).find("transfer-encoding: chunked\r\n") !=
+              std::string::npos);
+        auto chunked = chunkedStreamCallback(
+            static_cast<HttpRequestImpl *>(streamReq.get())->streamCallback());
+        char buffer[16];
+        auto length = chunked(buffer, sizeof(buffer));
+        CHECK(std::string(buffer, length) == "05\r\nhello\r\n");
+        length = chunked(buffer, sizeof(buffer));
+        CHECK(std::string(buffer, length) == "0\r\n\r\n");
+        CHECK(chunked(buffer, sizeof(buffer)) == 0);
+    }
+}
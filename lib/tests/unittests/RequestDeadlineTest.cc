@@ -0,0 +1,62 @@
+#include "../../lib/src/HttpRequestImpl.h"
+#include <drogon/RequestDeadline.h>
+#include <drogon/drogon_test.h>
+#include <functional>
+
+using namespace drogon;
+
+DROGON_TEST(RequestDeadlineTest)
+{
+    CHECK(!RequestDeadline::hasCurrent());
+    CHECK(RequestDeadline::clampTimeout(0.0) == 0.0);
+    CHECK(RequestDeadline::clampTimeout(2.0) == 2.0);
+    {
+        RequestDeadline::Scope scope(trantor::Date::now().after(10.0));
+        CHECK(RequestDeadline::hasCurrent());
+        CHECK(RequestDeadline::clampTimeout(2.0) == 2.0);
+        auto timeout = RequestDeadline::clampTimeout(0.0);
+        CHECK(timeout > 9.0);
+        CHECK(timeout <= 10.0);
+        CHECK(RequestDeadline::clampTimeout(60.0) <= 10.0);
+        {
+            RequestDeadline::Scope expired(trantor::Date::now().after(-1.0));
+            CHECK(RequestDeadline::clampTimeout(2.0) < 0.0);
+        }
+        CHECK(RequestDeadline::clampTimeout(0.0) > 9.0);
+
+        // The deadline is current again in the callbacks
+        bool hadDeadline{false};
+        std::function<void(int)> callback = [&hadDeadline](int) {
+            hadDeadline = RequestDeadline::hasCurrent();
+        };
+        std::function<void()> empty;
+        RequestDeadline::propagate(callback, empty);
+        CHECK(!empty);
+        {
+            RequestDeadline::Scope cleared{trantor::Date()};
+            CHECK(!RequestDeadline::hasCurrent());
+            callback(1);
+            CHECK(!RequestDeadline::hasCurrent());
+        }
+        CHECK(hadDeadline);
+    }
+    CHECK(!RequestDeadline::hasCurrent());
+
+    SUBSECTION(Cancellation)
+    {
+        auto req = std::make_shared<HttpRequestImpl>(nullptr);
+        int calls{0};
+        req->onCancel([&calls]() { ++calls; });
+        RequestDeadline::Scope scope(trantor::Date(), req);
+        CHECK(RequestDeadline::hasCurrent());
+        CHECK(!RequestDeadline::cancelled());
+        CHECK(RequestDeadline::clampTimeout(2.0) == 2.0);
+        req->cancel();
+        req->cancel();
+        CHECK(calls == 1);
+        CHECK(req->isCancelled());
+        CHECK(RequestDeadline::cancelled());
+        req->onCancel([&calls]() { ++calls; });
+        CHECK(calls == 2);
+    }
+}
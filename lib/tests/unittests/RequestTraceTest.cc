@@ -0,0 +1,59 @@
+#include <drogon/drogon_test.h>
+#include <drogon/RequestTrace.h>
+
+#include <functional>
+#include <string>
+
+using namespace drogon;
+
+DROGON_TEST(RequestTraceTest)
+{
+    // Requests are sampled by the ratio without a traceparent header.
+    CHECK(RequestTrace::sample("", 0.0) == nullptr);
+    auto trace = RequestTrace::sample("", 1.0);
+    REQUIRE(trace != nullptr);
+    CHECK(trace->traceId().size() == 32);
+    CHECK(trace->spanId().size() == 16);
+    CHECK(trace->parentSpanId().empty());
+    CHECK(trace->timestamp(RequestTrace::Stage::Received) > 0);
+    CHECK(trace->timestamp(RequestTrace::Stage::Sent) == 0);
+    CHECK(trace->traceParent() ==
+          "00-" + trace->traceId() + "-" + trace->spanId() + "-01");
+
+    // The caller decides the sampling.
+    trace = RequestTrace::sample(
+        "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01", 0.0);
+    REQUIRE(trace != nullptr);
+    CHECK(trace->traceId() == "4bf92f3577b34da6a3ce929d0e0e4736");
+    CHECK(trace->parentSpanId() == "00f067aa0ba902b7");
+    CHECK(trace->spanId() != "00f067aa0ba902b7");
+    CHECK(RequestTrace::sample(
+              "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00",
+              1.0) == nullptr);
+    // An invalid header is ignored.
+    auto other = RequestTrace::sample(
+        "00-00000000000000000000000000000000-00f067aa0ba902b7-01", 1.0);
+    REQUIRE(other != nullptr);
+    CHECK(other->parentSpanId().empty());
+
+    // The calls made in a scope are recorded when they finish.
+    CHECK(RequestTrace::current() == nullptr);
+    {
+        RequestTrace::Scope scope(trace);
+        CHECK(RequestTrace::current() == trace);
+    }
+    CHECK(RequestTrace::current() == nullptr);
+    std::function<void(const std::string &)> resultCallback =
+        [](const std::string &) {};
+    std::function<void(const int &)> exceptionCallback = [](const int &) {};
+    auto span = trace->startSpan("db.query");
+    span.attributes.emplace_back("db.statement", "select 1");
+    trace->traceCallbacks(std::move(span), resultCallback, exceptionCallback);
+    CHECK(trace->spans().empty());
+    exceptionCallback(1);
+    auto spans = trace->spans();
+    REQUIRE(spans.size() == 1);
+    CHECK(spans[0].name == "db.query");
+    CHECK(spans[0].error);
+    CHECK(spans[0].end >= spans[0].start);
+}
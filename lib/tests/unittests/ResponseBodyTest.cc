@@ -0,0 +1,71 @@
+#include <drogon/drogon_test.h>
+#include <drogon/HttpResponse.h>
+#include "../../lib/src/HttpResponseImpl.h"
+#include <memory>
+#include <string>
+
+using namespace drogon;
+
+static std::string toString(const trantor::MsgBuffer &buffer)
+{
+    return std::string(buffer.peek(), buffer.readableBytes());
+}
+
+DROGON_TEST(ResponseBigBodyTest)
+{
+    // A big body owned by the response is rendered right after its header.
+    auto resp = std::static_pointer_cast<HttpResponseImpl>(
+        HttpResponse::newHttpResponse());
+    std::string body(100 * 1024, 'x');
+    resp->setBody(body);
+    CHECK(resp->bodyToSendSeparately().empty());
+
+    trantor::MsgBuffer header;
+    resp->renderHeaderToBuffer(header);
+    auto headerString = toString(header);
+    CHECK(headerString.find("HTTP/1.1 200 OK\r\n") == 0);
+    CHECK(headerString.find("content-length: 102400\r\n") !=
+          std::string::npos);
+    CHECK(headerString.find("\r\n\r\n") == headerString.size() - 4);
+
+    trantor::MsgBuffer buffer;
+    resp->renderToBuffer(buffer);
+    auto rendered = toString(buffer);
+    REQUIRE(rendered.size() == headerString.size() + body.size());
+    CHECK(rendered.compare(headerString.size(), body.size(), body) == 0);
+}
+
+DROGON_TEST(ResponseSharedBodyTest)
+{
+    // The responses sharing a body send it from the shared string.
+    auto body = std::make_shared<const std::string>(std::string(1000, 'y'));
+    auto first = std::static_pointer_cast<HttpResponseImpl>(
+        HttpResponse::newHttpResponse());
+    auto second = std::static_pointer_cast<HttpResponseImpl>(
+        HttpResponse::newHttpResponse());
+    first->setSharedBody(body);
+    second->setSharedBody(body);
+    CHECK(body.use_count() == 3);
+    CHECK(first->hasSharedBody());
+    CHECK(first->bodyToSendSeparately().data() == body->data());
+    CHECK(second->bodyToSendSeparately().data() == body->data());
+    CHECK(second->bodyToSendSeparately().size() == body->size());
+
+    // Even when the response is cached with its header
+    first->setExpiredTime(10);
+    first->makeHeaderString();
+    CHECK(first->bodyToSendSeparately().data() == body->data());
+    auto header = toString(*first->renderHeaderForHeadMethod());
+    CHECK(header.find("content-length: 1000\r\n") != std::string::npos);
+    CHECK(header.find("\r\n\r\n") == header.size() - 4);
+
+    // No body is sent with a 204 response.
+    second->setStatusCode(k204NoContent);
+    CHECK(second->bodyToSendSeparately().empty());
+
+    // An owned body isn't shared any more.
+    first->setBody(std::string("z"));
+    CHECK(!first->hasSharedBody());
+    CHECK(first->bodyToSendSeparately().empty());
+    CHECK(body.use_count() == 2);
+}
@@ -0,0 +1,65 @@
+#include <drogon/ResponseCache.h>
+#include <drogon/drogon_test.h>
+#include <string>
+
+using namespace drogon;
+
+DROGON_TEST(ResponseCacheTest)
+{
+    ResponseCache cache;
+    int calls = 0;
+    std::string cacheControl = "max-age=60";
+    auto get = [&](const std::string &path, const std::string &lang = "") {
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath(path);
+        if (!lang.empty())
+            req->addHeader("accept-language", lang);
+        HttpResponsePtr result;
+        cache.invoke(
+            req,
+            [&](MiddlewareCallback &&mcb) {
+                ++calls;
+                auto resp = HttpResponse::newHttpResponse();
+                resp->setBody(path + lang + std::to_string(calls));
+                resp->addHeader("cache-control", cacheControl);
+                resp->addHeader("vary", "Accept-Language");
+                mcb(resp);
+            },
+            [&result](const HttpResponsePtr &resp) { result = resp; });
+        return result;
+    };
+
+    CHECK(get("/a")->body() == "/a1");
+    auto resp = get("/a");
+    CHECK(resp->body() == "/a1");
+    CHECK(resp->getHeader("age") == "0");
+    CHECK(calls == 1);
+    // Keyed by the path and the headers named by Vary
+    CHECK(get("/b")->body() == "/b2");
+    CHECK(get("/a", "fr")->body() == "/afr3");
+    CHECK(get("/a", "fr")->body() == "/afr3");
+    CHECK(calls == 3);
+    CHECK(cache.size() == 3);
+
+    cacheControl = "no-store";
+    cache.clear();
+    CHECK(get("/c")->body() == "/c4");
+    CHECK(get("/c")->body() == "/c5");
+    CHECK(cache.size() == 0);
+
+    // Served stale while the handler refreshes it
+    cacheControl = "max-age=0.000001, stale-while-revalidate=60";
+    CHECK(get("/d")->body() == "/d6");
+    CHECK(get("/d")->body() == "/d6");
+    CHECK(calls == 7);
+    CHECK(get("/d")->body() == "/d7");
+
+    // Erased for all the varying headers, not for the other paths
+    cacheControl = "max-age=60";
+    CHECK(get("/e")->body() == "/e8");
+    CHECK(get("/e", "fr")->body() == "/efr9");
+    CHECK(cache.size() == 3);
+    cache.erase("/e");
+    CHECK(cache.size() == 1);
+    CHECK(get("/e")->body() == "/e10");
+}
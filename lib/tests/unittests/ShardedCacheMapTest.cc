@@ -0,0 +1,75 @@
+#include <drogon/drogon_test.h>
+#include <drogon/ShardedCacheMap.h>
+#include <trantor/net/EventLoopThread.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+DROGON_TEST(ShardedCacheMapTest)
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    ShardedCacheMap<std::string, std::string> cache(loopThread.getLoop(),
+                                                    0.1f,
+                                                    4,
+                                                    30);
+
+    for (size_t i = 1; i < 40; i++)
+        cache.insert(std::to_string(i), "a", i);
+    cache.insert("bla", "");
+    cache.insert("zzz", "-");
+    std::this_thread::sleep_for(3s);
+    CHECK(cache.find("0") == false);  // doesn't exist
+    CHECK(cache.find("1") == false);  // timeout
+    CHECK(cache.find("15") == true);
+    CHECK(cache.find("bla") == true);
+
+    cache.erase("30");
+    CHECK(cache.find("30") == false);
+
+    cache.modify("bla", [](std::string &s) { s = "asd"; });
+    CHECK(cache["bla"] == "asd");
+
+    std::string content;
+    CHECK(cache.findAndFetch("zzz", content));
+    CHECK(content == "-");
+
+    cache.insert("zzz", "+");
+    CHECK(cache["zzz"] == "+");
+}
+
+DROGON_TEST(ShardedCacheMapLruTest)
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    std::vector<std::string> erasedKeys;
+    // One shard to make the eviction order deterministic
+    ShardedCacheMap<std::string, int> cache(
+        loopThread.getLoop(),
+        0,
+        0,
+        0,
+        nullptr,
+        [&erasedKeys](const std::string &key) { erasedKeys.push_back(key); },
+        3,
+        1);
+    cache.insert("a", 1);
+    cache.insert("b", 2);
+    cache.insert("c", 3);
+    // "a" becomes the most recently used one
+    CHECK(cache.find("a"));
+    cache.insert("d", 4);
+    CHECK(cache.size() == 3UL);
+    CHECK(cache.find("b") == false);
+    REQUIRE(erasedKeys.size() == 1UL);
+    CHECK(erasedKeys[0] == "b");
+
+    cache.modify("e", [](int &value) { value = 5; });
+    CHECK(cache.find("c") == false);
+    CHECK(cache["e"] == 5);
+    CHECK(cache["a"] == 1);
+    CHECK(cache.size() == 3UL);
+}
@@ -0,0 +1,63 @@
+#include <drogon/drogon_test.h>
+#include <drogon/SharedMemoryCache.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace drogon;
+using namespace std::chrono_literals;
+
+#ifndef _WIN32
+DROGON_TEST(SharedMemoryCacheTest)
+{
+    auto name = "drogon_test_cache_" + std::to_string(getpid());
+    SharedMemoryCache::remove(name);
+    SharedMemoryCache::Options options;
+    options.memorySize = 64 * 1024;
+    options.maxEntries = 64;
+    options.pageSize = 4096;
+    SharedMemoryCache cache(name, options);
+    CHECK(cache.options().pageSize == 4096);
+
+    CHECK(cache.insert("a", "1"));
+    CHECK(cache.insert("b", "2", 0.1));
+    CHECK(cache.find("a") == "1");
+    CHECK(cache.find("b") == "2");
+    CHECK(cache.find("c") == std::nullopt);
+    CHECK(cache.size() == 2);
+
+    // Another object of the segment, as in another process.
+    SharedMemoryCache other(name);
+    CHECK(other.options().memorySize == 64 * 1024);
+    CHECK(other.find("a") == "1");
+    CHECK(other.insert("a", "11"));
+    CHECK(cache.find("a") == "11");
+    CHECK(cache.size() == 2);
+
+    std::this_thread::sleep_for(200ms);
+    CHECK(cache.find("b") == std::nullopt);
+
+    CHECK(cache.erase("a"));
+    CHECK(!cache.erase("a"));
+    std::string value;
+    CHECK(!other.findAndFetch("a", value));
+
+    // Too large for a page.
+    CHECK(!cache.insert("big", std::string(5000, 'x')));
+
+    // More values than the memory holds, the older ones are evicted.
+    for (int i = 0; i < 100; ++i)
+        CHECK(cache.insert("k" + std::to_string(i), std::string(1000, 'v')));
+    CHECK(cache.size() <= 64);
+    CHECK(cache.find("k99") == std::string(1000, 'v'));
+
+    cache.clear();
+    CHECK(cache.size() == 0);
+    CHECK(other.find("k99") == std::nullopt);
+    SharedMemoryCache::remove(name);
+}
+#endif
@@ -0,0 +1,38 @@
+#include <drogon/utils/SingleFlight.h>
+#include <drogon/drogon_test.h>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+DROGON_TEST(SingleFlightTest)
+{
+    SingleFlight<int, const std::string &> flights;
+    std::vector<SingleFlight<int, const std::string &>::Callback> pending;
+    std::vector<std::string> results;
+    auto start = [&pending](auto &&done) { pending.push_back(done); };
+    auto callback = [&results](int n, const std::string &s) {
+        results.push_back(std::to_string(n) + s);
+    };
+
+    CHECK(flights.run("a", callback, start) == true);
+    CHECK(flights.run("a", callback, start) == false);
+    CHECK(flights.run("b", callback, start) == true);
+    CHECK(pending.size() == 2);
+    CHECK(flights.size() == 2);
+
+    pending[0](1, "a");
+    CHECK(results == std::vector<std::string>{"1a", "1a"});
+    CHECK(flights.size() == 1);
+    // Only called once
+    pending[0](2, "a");
+    CHECK(results.size() == 2);
+
+    // A new execution after the previous one is done
+    CHECK(flights.run("a", callback, start) == true);
+    CHECK(pending.size() == 3);
+    pending[1](3, "b");
+    pending[2](4, "a");
+    CHECK(results == std::vector<std::string>{"1a", "1a", "3b", "4a"});
+    CHECK(flights.size() == 0);
+}
@@ -0,0 +1,22 @@
+#include "../../orm_lib/src/SqlStats.h"
+#include <drogon/drogon_test.h>
+
+using namespace drogon::orm;
+
+DROGON_TEST(SqlStatsTest)
+{
+    CHECK(normalizeSql("select * from users where id = $1 and "
+                       "name = 'O''Brien'") ==
+          "select * from users where id = ? and name = ?");
+    // The lists of values are reduced to one, the comments removed and the
+    // blanks collapsed.
+    CHECK(normalizeSql("SELECT  a,b\n FROM t1 WHERE x IN (1, 2, 3) -- c\n"
+                       " AND y = ?") ==
+          "SELECT a,b FROM t1 WHERE x IN (?) AND y = ?");
+    CHECK(normalizeSql("insert into t (a, b) values (?,?) /* x */ "
+                       "returning id") ==
+          "insert into t (a, b) values (?) returning id");
+    // Quoted identifiers are kept
+    CHECK(normalizeSql("update \"T2\" set v = 1.5e3 where k = ?1") ==
+          "update \"T2\" set v = ? where k = ?");
+}
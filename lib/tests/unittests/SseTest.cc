@@ -0,0 +1,22 @@
+#include <drogon/drogon_test.h>
+#include <drogon/HttpResponse.h>
+
+using namespace drogon;
+
+DROGON_TEST(SseFormatEvent)
+{
+    CHECK(SseStream::formatEvent("hello") == "data: hello\n\n");
+    CHECK(SseStream::formatEvent("") == "data: \n\n");
+    CHECK(SseStream::formatEvent("{}", "update", "42") ==
+          "id: 42\nevent: update\ndata: {}\n\n");
+
+    // Every line of the data is a field, whatever its line break
+    CHECK(SseStream::formatEvent("a\nb\r\nc\rd") ==
+          "data: a\ndata: b\ndata: c\ndata: d\n\n");
+    CHECK(SseStream::formatEvent("a\n\nb") == "data: a\ndata: \ndata: b\n\n");
+    CHECK(SseStream::formatEvent("a\n") == "data: a\n\n");
+
+    // The line breaks of the other fields would start new fields
+    CHECK(SseStream::formatEvent("x", "ev\nil", "1\r\n2") ==
+          "id: 12\nevent: evil\ndata: x\n\n");
+}
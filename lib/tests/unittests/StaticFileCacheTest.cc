@@ -0,0 +1,37 @@
+#include <drogon/drogon_test.h>
+#include <drogon/HttpResponse.h>
+#include "../../lib/src/StaticFileCache.h"
+#include <string>
+
+using namespace drogon;
+
+DROGON_TEST(StaticFileCacheTest)
+{
+    StaticFileCache cache;
+    auto resp = HttpResponse::newHttpResponse();
+    cache.insert("a", resp, 100, 0);
+    CHECK(cache.find("a") == resp);
+    CHECK(cache.find("b") == nullptr);
+    CHECK(cache.size() == 100);
+
+    // Replacing an entry doesn't count its size twice
+    cache.insert("a", resp, 50, 0);
+    CHECK(cache.size() == 50);
+    cache.clear();
+    CHECK(cache.size() == 0);
+    CHECK(cache.find("a") == nullptr);
+
+    // Every shard takes 1/16 of the capacity
+    cache.setCapacity(16 * 100);
+    cache.insert("big", resp, 101, 0);
+    CHECK(cache.find("big") == nullptr);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        cache.insert(std::to_string(i), resp, 10, 0);
+    }
+    CHECK(cache.size() <= 16 * 100);
+    // The recently inserted entries survive
+    CHECK(cache.find("999") == resp);
+    CHECK(cache.find("0") == nullptr);
+}
@@ -0,0 +1,41 @@
+#include "../../lib/src/StreamDigest.h"
+#include <drogon/utils/Utilities.h>
+#include <drogon/drogon_test.h>
+#include <algorithm>
+#include <string>
+
+using namespace drogon;
+
+template <typename Digest>
+static std::string digestInPieces(const std::string &data, size_t step)
+{
+    Digest digest;
+    for (size_t pos = 0; pos < data.length(); pos += step)
+        digest.update(data.data() + pos, std::min(step, data.length() - pos));
+    return digest.finish();
+}
+
+DROGON_TEST(StreamDigest)
+{
+    CHECK(internal::Md5Digest().finish() == utils::getMd5(""));
+    CHECK(internal::Sha256Digest().finish() == utils::getSha256(""));
+    CHECK(internal::Sha3Digest().finish() == utils::getSha3(""));
+
+    std::string data;
+    for (size_t i = 0; i < 1000; ++i)
+        data.push_back(static_cast<char>(i * 7 + i / 13));
+    // Sizes around the 64 bytes blocks and the 136 bytes rate of SHA3-256
+    for (size_t length : {1, 55, 56, 64, 65, 135, 136, 137, 1000})
+    {
+        auto piece = data.substr(0, length);
+        for (size_t step : {1, 7, 64, 1000})
+        {
+            CHECK(digestInPieces<internal::Md5Digest>(piece, step) ==
+                  utils::getMd5(piece));
+            CHECK(digestInPieces<internal::Sha256Digest>(piece, step) ==
+                  utils::getSha256(piece));
+            CHECK(digestInPieces<internal::Sha3Digest>(piece, step) ==
+                  utils::getSha3(piece));
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#include <drogon/TieredCache.h>
+#include <drogon/drogon_test.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+DROGON_TEST(TieredCacheCodecTest)
+{
+    TieredCache::Value value;
+    CHECK(TieredCache::decode(TieredCache::encode("abc"), value));
+    CHECK(value == std::string("abc"));
+    CHECK(TieredCache::decode(TieredCache::encode(std::string()), value));
+    CHECK(value == std::string());
+    CHECK(TieredCache::decode(TieredCache::encode(std::nullopt), value));
+    CHECK(!value.has_value());
+    CHECK(TieredCache::decode("", value) == false);
+    CHECK(TieredCache::decode("x", value) == false);
+}
+
+DROGON_TEST(TieredCacheLocalTest)
+{
+    auto cache = std::make_shared<TieredCache>(nullptr);
+    std::vector<TieredCache::ValueCallback> pending;
+    size_t loads{0};
+    auto loader = [&pending, &loads](auto &&done, auto &&) {
+        ++loads;
+        pending.push_back(done);
+    };
+    std::vector<TieredCache::Value> results;
+    auto callback = [&results](const TieredCache::Value &value) {
+        results.push_back(value);
+    };
+    size_t errors{0};
+    auto onError = [&errors](const std::exception_ptr &) { ++errors; };
+
+    // The concurrent lookups share one load
+    cache->get("a", loader, callback, onError);
+    cache->get("a", loader, callback, onError);
+    CHECK(loads == 1UL);
+    REQUIRE(pending.size() == 1UL);
+    pending[0]("1");
+    REQUIRE(results.size() == 2UL);
+    CHECK(results[0] == std::string("1"));
+    CHECK(results[1] == std::string("1"));
+
+    // Found in the local tier
+    cache->get("a", loader, callback, onError);
+    CHECK(loads == 1UL);
+    CHECK(results.back() == std::string("1"));
+
+    // The missing values are cached too
+    cache->get("b", loader, callback, onError);
+    REQUIRE(pending.size() == 2UL);
+    pending[1](std::nullopt);
+    cache->get("b", loader, callback, onError);
+    CHECK(loads == 2UL);
+    CHECK(results.size() == 5UL);
+    CHECK(!results.back().has_value());
+
+    // The errors aren't
+    auto failing = [&loads](auto &&, auto &&fail) {
+        ++loads;
+        fail(std::make_exception_ptr(std::runtime_error("failed")));
+    };
+    cache->get("c", failing, callback, onError);
+    cache->get("c", failing, callback, onError);
+    CHECK(errors == 2UL);
+    CHECK(loads == 4UL);
+
+    cache->set("c", "3");
+    cache->get("c", failing, callback, onError);
+    CHECK(loads == 4UL);
+    CHECK(results.back() == std::string("3"));
+    cache->erase("a");
+    cache->get("a", loader, callback, onError);
+    CHECK(loads == 5UL);
+    CHECK(cache->localSize() == 2UL);
+}
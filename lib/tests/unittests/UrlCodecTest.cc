@@ -11,4 +11,12 @@ DROGON_TEST(URLCodec)
 
     CHECK(encoded == "k1=1&k2=%E5%AE%89");
     CHECK(input == decoded);
+
+    // Long runs copied at once around the characters to decode
+    std::string text = std::string(40, 'a') + "%20" + std::string(20, 'b') +
+                       "+" + std::string(17, 'c') + "%4";
+    CHECK(drogon::utils::urlDecode(text) == std::string(40, 'a') + " " +
+                                                std::string(20, 'b') + " " +
+                                                std::string(17, 'c') + "%4");
+    CHECK(drogon::utils::urlEncodeComponent("a b/c") == "a+b%2Fc");
 }
@@ -1,7 +1,12 @@
+#include <cstring>
 #include <string_view>
 #include <drogon/utils/Utilities.h>
 #include <iostream>
 #include <drogon/drogon_test.h>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 DROGON_TEST(UuidTest)
 {
@@ -15,3 +20,62 @@ DROGON_TEST(UuidTest)
     CHECK(uuid[23] == '-');
     CHECK(uuid.size() == 36);
 }
+
+DROGON_TEST(UuidV4Test)
+{
+    auto uuid = drogon::utils::getUuidV4();
+    CHECK(uuid.size() == 36);
+    CHECK(uuid[14] == '4');
+    CHECK(std::string_view("89ab").find(uuid[19]) != std::string_view::npos);
+    CHECK(uuid != drogon::utils::getUuidV4());
+    CHECK(drogon::utils::getUuidV4(false).find_first_of("abcdef") ==
+          std::string::npos);
+}
+
+DROGON_TEST(UuidV7Test)
+{
+    std::string last;
+    for (int i = 0; i < 10000; ++i)
+    {
+        auto uuid = drogon::utils::getUuidV7();
+        CHECK(uuid.size() == 36);
+        CHECK(uuid[14] == '7');
+        CHECK(std::string_view("89ab").find(uuid[19]) !=
+              std::string_view::npos);
+        // Strictly increasing, even in the same millisecond
+        CHECK(uuid > last);
+        last = std::move(uuid);
+    }
+}
+
+#ifndef _WIN32
+DROGON_TEST(SecureRandomAfterFork)
+{
+    // Leave most of the buffered keystream of this thread unused.
+    unsigned char byte;
+    REQUIRE(drogon::utils::secureRandomBytes(&byte, 1));
+
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    auto pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0)
+    {
+        unsigned char bytes[64];
+        auto ok = drogon::utils::secureRandomBytes(bytes, sizeof(bytes)) &&
+                  write(fds[1], bytes, sizeof(bytes)) == sizeof(bytes);
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    unsigned char parentBytes[64];
+    unsigned char childBytes[64];
+    CHECK(drogon::utils::secureRandomBytes(parentBytes, sizeof(parentBytes)));
+    CHECK(read(fds[0], childBytes, sizeof(childBytes)) == sizeof(childBytes));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+    CHECK(memcmp(parentBytes, childBytes, sizeof(parentBytes)) != 0);
+}
+#endif
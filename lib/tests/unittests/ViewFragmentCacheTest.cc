@@ -0,0 +1,25 @@
+#include <drogon/ViewFragmentCache.h>
+#include <drogon/drogon_test.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace drogon;
+
+DROGON_TEST(ViewFragmentCache)
+{
+    ViewFragmentCache cache;
+    std::string output{"<html>"};
+    CHECK(!cache.appendTo("nav", output));
+    cache.store("nav", "<nav></nav>", 0.0);
+    cache.store("footer", "<footer></footer>", 0.01);
+    CHECK(cache.appendTo("nav", output));
+    CHECK(cache.appendTo("footer", output));
+    CHECK(output == "<html><nav></nav><footer></footer>");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(!cache.appendTo("footer", output));
+    CHECK(cache.appendTo("nav", output));
+    cache.clear();
+    CHECK(!cache.appendTo("nav", output));
+}
@@ -0,0 +1,75 @@
+#include <drogon/drogon_test.h>
+#include "../../lib/src/WebSocketDeflate.h"
+#include <string>
+
+using namespace drogon;
+
+DROGON_TEST(WebSocketDeflateTest)
+{
+    SUBSECTION(negotiation)
+    {
+        WebSocketDeflateParams serverParams;
+        std::string agreed;
+        // Window bits of 8 can't be supported, the next offer is accepted
+        CHECK(serverParams.negotiate(
+            "x-unknown, permessage-deflate; server_max_window_bits=8, "
+            "permessage-deflate; client_max_window_bits; "
+            "server_no_context_takeover",
+            agreed));
+        CHECK(agreed == "permessage-deflate; server_no_context_takeover");
+        CHECK(serverParams.serverNoContextTakeover);
+
+        CHECK(!serverParams.negotiate("permessage-deflate; unknown", agreed));
+        CHECK(serverParams.negotiate(
+            "permessage-deflate; server_max_window_bits=\"10\"", agreed));
+        CHECK(agreed == "permessage-deflate; server_max_window_bits=10");
+
+        WebSocketDeflateParams clientParams;
+        CHECK(clientParams.parse(agreed));
+        CHECK(clientParams.serverMaxWindowBits == 10);
+        // The server must give the value of client_max_window_bits
+        CHECK(
+            !clientParams.parse("permessage-deflate; client_max_window_bits"));
+        CHECK(!clientParams.parse("permessage-deflate, permessage-deflate"));
+    }
+
+    SUBSECTION(compression)
+    {
+        WebSocketDeflateParams params;
+        WebSocketDeflate server(params, true);
+        WebSocketDeflate client(params, false);
+        REQUIRE(server.valid());
+        REQUIRE(client.valid());
+        std::string source;
+        for (size_t i = 0; i < 10000; i++)
+        {
+            source.append("{\"id\":").append(std::to_string(i)).append("}");
+        }
+        size_t lastSize = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            std::string compressed;
+            std::string decompressed;
+            CHECK(server.compress(source.data(), source.size(), compressed));
+            CHECK(compressed.size() < source.size());
+            // The context is taken over by the next message
+            if (i > 0)
+                CHECK(compressed.size() <= lastSize);
+            lastSize = compressed.size();
+            CHECK(client.decompress(compressed, decompressed, 1024 * 1024));
+            CHECK(decompressed == source);
+        }
+
+        std::string compressed;
+        std::string decompressed;
+        CHECK(client.compress("", 0, compressed));
+        CHECK(server.decompress(compressed, decompressed, 1024));
+        CHECK(decompressed.empty());
+
+        // Messages longer than the limit are refused
+        WebSocketDeflate sender(params, true);
+        WebSocketDeflate receiver(params, false);
+        CHECK(sender.compress(source.data(), source.size(), compressed));
+        CHECK(!receiver.decompress(compressed, decompressed, 1024));
+    }
+}
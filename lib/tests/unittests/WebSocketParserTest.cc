@@ -0,0 +1,112 @@
+#include <drogon/drogon_test.h>
+#include "../../lib/src/WebSocketConnectionImpl.h"
+#include "../../lib/src/WebSocketMask.h"
+#include <trantor/utils/MsgBuffer.h>
+#include <string>
+#include <string_view>
+
+using namespace drogon;
+
+static std::string maskedFrame(unsigned char firstByte,
+                               const std::string &payload)
+{
+    // Payloads shorter than 126 bytes
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    std::string frame;
+    frame += static_cast<char>(firstByte);
+    frame += static_cast<char>(0x80 | payload.length());
+    frame.append(mask, 4);
+    for (size_t i = 0; i < payload.length(); ++i)
+        frame += static_cast<char>(payload[i] ^ mask[i % 4]);
+    return frame;
+}
+
+DROGON_TEST(WebSocketParserTest)
+{
+    SUBSECTION(unmask)
+    {
+        const char mask[4] = {1, 2, 3, 4};
+        std::string data(37, '\0');
+        WebSocketMessageParser::unmask(data.data(), data.length(), mask, 2);
+        bool unmasked = true;
+        for (size_t i = 0; i < data.length(); ++i)
+            unmasked = unmasked && data[i] == mask[(i + 2) % 4];
+        CHECK(unmasked);
+
+        // The SIMD blocks and the tails, in place or not
+        std::string payload(300, '\0');
+        for (size_t i = 0; i < payload.length(); ++i)
+            payload[i] = static_cast<char>(i * 7);
+        bool same = true;
+        for (size_t length : {15, 16, 63, 64, 65, 300})
+        {
+            std::string simd(length, '\0');
+            std::string scalar(length, '\0');
+            internal::maskWebSocketPayload(
+                simd.data(), payload.data(), length, mask, 3);
+            internal::maskWebSocketPayloadScalar(
+                scalar.data(), payload.data(), length, mask, 3);
+            std::string inPlace = payload.substr(0, length);
+            internal::maskWebSocketPayload(
+                inPlace.data(), inPlace.data(), length, mask, 3);
+            same = same && simd == scalar && inPlace == scalar &&
+                   scalar[length - 1] ==
+                       static_cast<char>(payload[length - 1] ^
+                                         mask[(length + 2) % 4]);
+        }
+        CHECK(same);
+    }
+
+    SUBSECTION(inPlace)
+    {
+        WebSocketMessageParser parser;
+        parser.setInPlace(true);
+        trantor::MsgBuffer buffer;
+        auto frames = maskedFrame(0x82, "binary message") +
+                      maskedFrame(0x01, "frag") + maskedFrame(0x89, "ping") +
+                      maskedFrame(0x80, "mented");
+        buffer.append(frames.data(), frames.length());
+
+        std::string_view message;
+        WebSocketMessageType type;
+        REQUIRE(parser.parse(&buffer));
+        REQUIRE(parser.gotAll(message, type));
+        CHECK(type == WebSocketMessageType::Binary);
+        CHECK(message == "binary message");
+        // The ping comes between the frames of the text message
+        REQUIRE(parser.parse(&buffer));
+        REQUIRE(parser.gotAll(message, type));
+        CHECK(type == WebSocketMessageType::Ping);
+        CHECK(message == "ping");
+        REQUIRE(parser.parse(&buffer));
+        REQUIRE(parser.gotAll(message, type));
+        CHECK(type == WebSocketMessageType::Text);
+        CHECK(message == "fragmented");
+        CHECK(buffer.readableBytes() == 0);
+    }
+
+    SUBSECTION(pieces)
+    {
+        WebSocketMessageParser parser;
+        std::string received;
+        int lastPieces = 0;
+        parser.setPieceCallback(
+            [&](std::string_view piece, WebSocketMessageType type, bool last) {
+                CHECK(type == WebSocketMessageType::Binary);
+                received.append(piece);
+                lastPieces += last ? 1 : 0;
+            });
+        auto frames = maskedFrame(0x02, "streamed ") +
+                      maskedFrame(0x80, "byte by byte");
+        // The pieces are given as they arrive
+        trantor::MsgBuffer buffer;
+        for (auto c : frames)
+        {
+            buffer.append(&c, 1);
+            CHECK(parser.parse(&buffer));
+        }
+        CHECK(received == "streamed byte by byte");
+        CHECK(lastPieces == 1);
+        CHECK(buffer.readableBytes() == 0);
+    }
+}
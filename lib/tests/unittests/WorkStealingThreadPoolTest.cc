@@ -0,0 +1,48 @@
+#include "../../lib/src/WorkStealingThreadPool.h"
+#include <drogon/drogon_test.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+
+using namespace drogon;
+
+DROGON_TEST(WorkStealingThreadPool)
+{
+    std::atomic<int> done{0};
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    {
+        WorkStealingThreadPool pool(2);
+        CHECK(pool.threadNum() == 2);
+        // Blocks one of the two threads.
+        pool.runTask([released]() { released.wait(); });
+
+        // Half of these are queued to the blocked thread and must be
+        // stolen by the other one.
+        std::promise<void> allDone;
+        for (int i = 0; i < 10; ++i)
+        {
+            pool.runTask([&done, &allDone]() {
+                if (++done == 10)
+                    allDone.set_value();
+            });
+        }
+        CHECK(allDone.get_future().wait_for(std::chrono::seconds(5)) ==
+              std::future_status::ready);
+
+        // The tasks queued by a task
+        std::promise<void> nested;
+        pool.runTask([&pool, &nested]() {
+            pool.runTask([&nested]() { nested.set_value(); });
+        });
+        CHECK(nested.get_future().wait_for(std::chrono::seconds(5)) ==
+              std::future_status::ready);
+
+        pool.runTask([]() { throw std::runtime_error("ignored"); });
+        pool.runTask([&done]() { ++done; });
+        release.set_value();
+    }
+    // The destructor runs the remaining tasks.
+    CHECK(done == 11);
+}
@@ -0,0 +1,54 @@
+#include <drogon/utils/Utilities.h>
+#include <drogon/drogon_test.h>
+#include "../../lib/src/StreamCompressor.h"
+#include <string>
+
+using namespace drogon;
+
+DROGON_TEST(ZstdTest)
+{
+    SUBSECTION(shortText)
+    {
+        std::string source{"123中文顶替要枯械"};
+        auto compressed = utils::zstdCompress(source.data(), source.length());
+        auto decompressed =
+            utils::zstdDecompress(compressed.data(), compressed.length());
+        CHECK(source == decompressed);
+    }
+
+    SUBSECTION(longText)
+    {
+        std::string source;
+        for (size_t i = 0; i < 100000; i++)
+        {
+            source.append(std::to_string(i));
+        }
+        auto compressed =
+            utils::zstdCompress(source.data(), source.length(), 19);
+        CHECK(compressed.length() < source.length());
+        auto decompressed =
+            utils::zstdDecompress(compressed.data(), compressed.length());
+        CHECK(source == decompressed);
+    }
+
+    SUBSECTION(stream)
+    {
+        auto compressor =
+            StreamCompressor::newCompressor(CompressionEncoding::kZstd, 3);
+        REQUIRE(compressor != nullptr);
+        std::string source;
+        std::string compressed;
+        for (size_t i = 0; i < 1000; i++)
+        {
+            auto line = "line " + std::to_string(i) + "\n";
+            source.append(line);
+            CHECK(compressor->compress(line.data(),
+                                       line.length(),
+                                       i % 100 == 0,
+                                       compressed));
+        }
+        CHECK(compressor->finish(compressed));
+        CHECK(utils::zstdDecompress(compressed.data(), compressed.length()) ==
+              source);
+    }
+}
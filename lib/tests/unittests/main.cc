@@ -34,6 +34,32 @@ DROGON_TEST(TestFrameworkSelfTest)
     }
 }
 
+DROGON_TEST(BenchmarkSelfTest)
+{
+    test::BenchmarkOptions options;
+    options.warmup = 1;
+    options.iterations = 10;
+    options.repetitions = 3;
+    int count = 0;
+    BENCHMARK("Sync", options, [&]() { ++count; });
+    CHECK(count == 31);
+
+    // The iterations of an asynchronous body run one after the other.
+    count = 0;
+    BENCHMARK("Async", options, [&](std::function<void()> done) {
+        app().getLoop()->queueInLoop([&count, done = std::move(done)]() {
+            ++count;
+            done();
+        });
+    });
+    CHECK(count == 31);
+
+    auto result = test::runBenchmark("Throw", options, []() {
+        throw std::runtime_error("benchmark error");
+    });
+    CHECK(result.exception != nullptr);
+}
+
 int main(int argc, char **argv)
 {
     std::promise<void> p1;
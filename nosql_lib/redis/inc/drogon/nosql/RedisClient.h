@@ -14,6 +14,7 @@
 #pragma once
 
 #include <drogon/exports.h>
+#include <drogon/CircuitBreaker.h>
 #include <drogon/nosql/RedisResult.h>
 #include <drogon/nosql/RedisException.h>
 #include <drogon/nosql/RedisSubscriber.h>
@@ -23,6 +24,7 @@
 #include <memory>
 #include <functional>
 #include <future>
+#include <vector>
 #ifdef __cpp_impl_coroutine
 #include <drogon/utils/coroutine.h>
 #endif
@@ -31,6 +33,61 @@ namespace drogon
 {
 namespace nosql
 {
+/**
+ * @brief A batch of commands sent together on one connection, whose replies
+ * are returned all at once. Unlike a transaction, the commands aren't atomic
+ * and may be interleaved with the commands of other callers.
+ * For example:
+ * @code
+   RedisBatch batch;
+   for (auto &key : keys)
+       batch.add("get %s", key.c_str());
+   auto results = co_await redisClient->execBatchCoro(std::move(batch));
+   @endcode
+ */
+class DROGON_EXPORT RedisBatch
+{
+  public:
+    /**
+     * @brief Add a command, with the same placeholders as the ones of
+     * RedisClient::execCommandAsync().
+     *
+     * @throw RedisException if the command can't be formatted.
+     */
+    RedisBatch &add(std::string_view command, ...) noexcept(false);
+
+    size_t size() const noexcept
+    {
+        return commands_.size();
+    }
+
+    bool empty() const noexcept
+    {
+        return commands_.empty();
+    }
+
+    /// The commands formatted in the RESP protocol.
+    const std::vector<std::string> &commands() const noexcept
+    {
+        return commands_;
+    }
+
+    std::vector<std::string> releaseCommands() noexcept
+    {
+        return std::move(commands_);
+    }
+
+  private:
+    std::vector<std::string> commands_;
+};
+
+/**
+ * The retained results of the commands of a batch, in the order of the
+ * commands.
+ */
+using RedisBatchCallback =
+    std::function<void(const std::vector<RedisResult> &results)>;
+
 #ifdef __cpp_impl_coroutine
 class RedisClient;
 class RedisTransaction;
@@ -77,6 +134,21 @@ struct [[nodiscard]] RedisTransactionAwaiter
   private:
     RedisClient *client_;
 };
+
+struct [[nodiscard]] RedisBatchAwaiter
+    : public CallbackAwaiter<std::vector<RedisResult>>
+{
+    RedisBatchAwaiter(RedisClient *client, RedisBatch &&batch)
+        : client_(client), batch_(std::move(batch))
+    {
+    }
+
+    void await_suspend(std::coroutine_handle<> handle);
+
+  private:
+    RedisClient *client_;
+    RedisBatch batch_;
+};
 }  // namespace internal
 #endif
 
@@ -105,6 +177,73 @@ class DROGON_EXPORT RedisClient
         const std::string &password = "",
         unsigned int db = 0,
         const std::string &username = "");
+
+    /**
+     * @brief Create a new redis client connecting to the unix domain socket
+     * of a redis server on the same host, which saves the work of the TCP
+     * stack. The parameters are the same as the ones of newRedisClient().
+     *
+     * @param path The path of the socket file, the unixsocket option of the
+     * server.
+     */
+    static std::shared_ptr<RedisClient> newUnixRedisClient(
+        const std::string &path,
+        size_t numberOfConnections = 1,
+        const std::string &password = "",
+        unsigned int db = 0,
+        const std::string &username = "");
+
+    /**
+     * @brief Create a new client of a Redis Cluster.
+     *
+     * The slots of the cluster are fetched from the first reachable seed
+     * node, and every command is sent to the primary node serving the slot
+     * of its first key, with a pool of connections per node. The MOVED and
+     * ASK redirections are followed, and the slots are fetched again when
+     * they have moved. The commands without key are sent to any node, and
+     * transactions are not supported.
+     *
+     * @param seedAddresses The addresses of some nodes of the cluster.
+     * @param connectionsPerNode The number of connections to each node.
+     * @param password The password to authenticate if necessary.
+     * @param username The username to authenticate if necessary.
+     * @return std::shared_ptr<RedisClient>
+     */
+    static std::shared_ptr<RedisClient> newRedisClusterClient(
+        const std::vector<trantor::InetAddress> &seedAddresses,
+        size_t connectionsPerNode = 1,
+        const std::string &password = "",
+        const std::string &username = "");
+
+    /**
+     * @brief Create a new client of the primary of a group monitored by Redis
+     * Sentinel.
+     *
+     * The address of the primary is asked to the sentinels, and the client
+     * follows the failovers announced by the +switch-master messages of the
+     * sentinel, or detected by a broken connection or a READONLY error. The
+     * sentinels are expected to accept the connections without
+     * authentication.
+     *
+     * @param sentinelAddresses The addresses of the sentinels, tried in turn.
+     * @param masterName The name of the group monitored by the sentinels.
+     * @param numberOfConnections The number of connections to each node.
+     * @param readFromReplicas If true, the read-only commands (GET, HGETALL,
+     * ZRANGE...) are sent to the replica with the lowest latency. The replies
+     * may then lag behind the writes.
+     * @param password The password to authenticate if necessary.
+     * @param db The database of the primary and the replicas.
+     * @param username The username to authenticate if necessary.
+     * @return std::shared_ptr<RedisClient>
+     */
+    static std::shared_ptr<RedisClient> newRedisSentinelClient(
+        const std::vector<trantor::InetAddress> &sentinelAddresses,
+        const std::string &masterName,
+        size_t numberOfConnections = 1,
+        bool readFromReplicas = false,
+        const std::string &password = "",
+        unsigned int db = 0,
+        const std::string &username = "");
     /**
      * @brief Execute a redis command
      *
@@ -241,6 +380,87 @@ class DROGON_EXPORT RedisClient
      */
     virtual void setTimeout(double timeout) = 0;
 
+    /**
+     * @brief Enable the client side caching of the GET commands.
+     *
+     * The connections switch to RESP3 and enable CLIENT TRACKING (Redis 6 or
+     * later, hiredis 1.0 or later), the values read by GET are kept in memory
+     * and the next GET commands of the same keys are answered from memory,
+     * until the server pushes the invalidation of the key after it's
+     * modified by any client. The whole cache is dropped when a connection
+     * is lost.
+     *
+     * @param maxEntries The maximum number of cached keys, the least recently
+     * used ones are evicted first.
+     * @note The cached replies are passed to the result callback in the
+     * calling thread, before the command function returns. A value modified
+     * by this client may still be read from the cache until its invalidation
+     * is received.
+     */
+    virtual void enableClientSideCaching(size_t maxEntries = 10000)
+    {
+        (void)maxEntries;
+        LOG_ERROR << "The client side caching is not supported by this client";
+    }
+
+    /**
+     * @brief Fail the commands fast while the server is down, instead of
+     * queuing them until a connection is available or they time out.
+     *
+     * @param breaker The commands failing with a kConnectionBroken,
+     * kNoConnectionAvailable or kTimeout error are recorded as failed by the
+     * circuit breaker, those getting an error reply as successful. While it
+     * is open, the commands fail at once with a kNoConnectionAvailable error.
+     * The transactions and the subscribers aren't checked. It should be set
+     * before the client is used, nullptr removes it.
+     */
+    virtual void setCircuitBreaker(CircuitBreakerPtr breaker)
+    {
+        (void)breaker;
+        LOG_ERROR << "The circuit breaker is not supported by this client";
+    }
+
+    /**
+     * @brief Send all the commands of a batch on one connection, in a single
+     * write when possible.
+     *
+     * @param batch The commands.
+     * @param resultCallback Called with the results of all the commands when
+     * they have all been received. The results are retained, so they can be
+     * kept after the callback returns.
+     * @param exceptionCallback Called with the first error if any of the
+     * commands fails, once all the replies have been received.
+     */
+    virtual void execBatchAsync(RedisBatch &&batch,
+                                RedisBatchCallback &&resultCallback,
+                                RedisExceptionCallback &&exceptionCallback)
+    {
+        (void)batch;
+        (void)resultCallback;
+        exceptionCallback(
+            RedisException(RedisErrorCode::kInternalError,
+                           "Batches are not supported by this client"));
+    }
+
+    struct ConnectionStats
+    {
+        size_t connected{0};
+        size_t total{0};
+        // The number of commands waiting for a connection.
+        size_t pending{0};
+    };
+
+    /**
+     * @brief Get the number of established connections and the length of the
+     * queue of the client, used by the built-in metrics of PromExporter.
+     *
+     * @note Fast clients return zeros.
+     */
+    virtual ConnectionStats connectionStats() noexcept
+    {
+        return {};
+    }
+
     virtual ~RedisClient() = default;
 
     /**
@@ -309,6 +529,18 @@ class DROGON_EXPORT RedisClient
     {
         return internal::RedisTransactionAwaiter(this);
     }
+
+    /**
+     * @brief Send the commands of a batch and await all their results in a
+     * coroutine, see execBatchAsync().
+     *
+     * @return internal::RedisBatchAwaiter that can be awaited in a coroutine.
+     * The first error of the commands is thrown if any.
+     */
+    internal::RedisBatchAwaiter execBatchCoro(RedisBatch batch)
+    {
+        return internal::RedisBatchAwaiter(this, std::move(batch));
+    }
 #endif
 };
 
@@ -373,6 +605,22 @@ inline void internal::RedisTransactionAwaiter::await_suspend(
             handle.resume();
         });
 }
+
+inline void internal::RedisBatchAwaiter::await_suspend(
+    std::coroutine_handle<> handle)
+{
+    assert(client_ != nullptr);
+    client_->execBatchAsync(
+        std::move(batch_),
+        [this, handle](const std::vector<RedisResult> &results) {
+            setValue(results);
+            handle.resume();
+        },
+        [this, handle](const RedisException &e) {
+            setException(std::make_exception_ptr(e));
+            handle.resume();
+        });
+}
 #endif
 }  // namespace nosql
 }  // namespace drogon
@@ -0,0 +1,189 @@
+/**
+ *
+ *  @file RedisPubSubService.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+
+#include <drogon/PubSubService.h>
+#include <drogon/nosql/RedisClient.h>
+#include <trantor/utils/Logger.h>
+#include <trantor/utils/NonCopyable.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+namespace drogon
+{
+namespace nosql
+{
+/**
+ * @brief A publish-subscribe service whose topics are shared by all the
+ * processes connected to the same redis server.
+ *
+ * It has the same interface as PubSubService<std::string>. All the topics of
+ * the service are subscribed through one redis subscriber, i.e. one redis
+ * connection, and a topic is subscribed in redis only once no matter how many
+ * local subscribers it has. Messages received from redis are dispatched to
+ * the local subscribers by a PubSubService.
+ *
+ * For example:
+ * @code
+   auto service = std::make_shared<RedisPubSubService>(
+       app().getRedisClient(), "chat:");
+   service->subscribe("room1",
+                      [](const std::string &topic,
+                         const std::string &message) {
+                          // Messages published by any node
+                      });
+   service->publish("room1", "hello");
+   @endcode
+ *
+ * @note Messages are published through redis, so local subscribers receive
+ * them asynchronously, in the thread of the redis subscriber connection.
+ */
+class RedisPubSubService : public trantor::NonCopyable
+{
+  public:
+    using MessageHandler = PubSubService<std::string>::MessageHandler;
+
+    /**
+     * @brief Construct a new service.
+     *
+     * @param client The redis client used to publish messages and to create
+     * the subscriber.
+     * @param channelPrefix The prefix prepended to the topic names to get the
+     * names of the redis channels.
+     */
+    explicit RedisPubSubService(RedisClientPtr client,
+                                std::string channelPrefix = "")
+        : client_(std::move(client)),
+          subscriber_(client_->newSubscriber()),
+          channelPrefix_(std::move(channelPrefix)),
+          localService_(std::make_shared<PubSubService<std::string>>())
+    {
+    }
+
+    ~RedisPubSubService()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &topicName : subscribedTopics_)
+        {
+            subscriber_->unsubscribe(channelPrefix_ + topicName);
+        }
+    }
+
+    /**
+     * @brief Publish a message to a topic, every subscriber of the topic on
+     * all the nodes will receive the message.
+     */
+    void publish(const std::string &topicName,
+                 const std::string &message) const
+    {
+        auto channel = channelPrefix_ + topicName;
+        client_->execCommandAsync(
+            [](const RedisResult &) {},
+            [channel](const RedisException &err) {
+                LOG_ERROR << "Failed to publish a message to the redis "
+                             "channel "
+                          << channel << ": " << err.what();
+            },
+            "publish %b %b",
+            channel.data(),
+            channel.size(),
+            message.data(),
+            message.size());
+    }
+
+    /**
+     * @brief Subscribe to a topic. When a message is published to the topic,
+     * the handler is invoked by passing the topic and message as parameters.
+     * @return The subscriber ID.
+     */
+    SubscriberID subscribe(const std::string &topicName,
+                           const MessageHandler &handler)
+    {
+        return subscribe(topicName, MessageHandler(handler));
+    }
+
+    SubscriberID subscribe(const std::string &topicName,
+                           MessageHandler &&handler)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto id = localService_->subscribe(topicName, std::move(handler));
+        if (subscribedTopics_.insert(topicName).second)
+        {
+            std::weak_ptr<PubSubService<std::string>> weakService =
+                localService_;
+            subscriber_->subscribe(
+                channelPrefix_ + topicName,
+                [weakService, topicName](const std::string &,
+                                         const std::string &message) {
+                    auto service = weakService.lock();
+                    if (service)
+                        service->publish(topicName, message);
+                });
+        }
+        return id;
+    }
+
+    /**
+     * @brief Unsubscribe from a topic. The topic is unsubscribed in redis
+     * when its last local subscriber is removed.
+     *
+     * @param topicName Topic name.
+     * @param id The subscriber ID returned from the subscribe method.
+     */
+    void unsubscribe(const std::string &topicName, SubscriberID id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = subscribedTopics_.find(topicName);
+        if (iter == subscribedTopics_.end())
+            return;
+        localService_->unsubscribe(topicName, id);
+        if (!localService_->isTopicEmpty(topicName))
+            return;
+        subscribedTopics_.erase(iter);
+        subscriber_->unsubscribe(channelPrefix_ + topicName);
+    }
+
+    /**
+     * @brief Return the number of topics with local subscribers.
+     */
+    size_t size() const
+    {
+        return localService_->size();
+    }
+
+    /**
+     * @brief Check if a topic has no local subscribers.
+     */
+    bool isTopicEmpty(const std::string &topicName) const
+    {
+        return localService_->isTopicEmpty(topicName);
+    }
+
+  private:
+    RedisClientPtr client_;
+    std::shared_ptr<RedisSubscriber> subscriber_;
+    std::string channelPrefix_;
+    // Referenced weakly by the callbacks of the subscriber, which may be
+    // called in the redis thread after this object is destroyed
+    std::shared_ptr<PubSubService<std::string>> localService_;
+    // Serializes the subscription changes to keep them in the same order in
+    // redis
+    std::mutex mutex_;
+    // The topics subscribed in redis
+    std::unordered_set<std::string> subscribedTopics_;
+};
+}  // namespace nosql
+}  // namespace drogon
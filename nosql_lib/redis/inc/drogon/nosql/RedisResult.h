@@ -17,8 +17,10 @@
 #include <drogon/exports.h>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <functional>
+#include <utility>
 
 struct redisReply;
 
@@ -26,6 +28,20 @@ namespace drogon
 {
 namespace nosql
 {
+namespace internal
+{
+/**
+ * @brief The reply of a command being handled by the result callback. The
+ * connection frees the reply when the callback returns, unless its memory is
+ * shared by RedisResult::shareString().
+ */
+struct RedisReplyOwner
+{
+    redisReply *reply;
+    std::shared_ptr<const void> shared;
+};
+}  // namespace internal
+
 enum class RedisResultType
 {
     kInteger = 0,
@@ -40,12 +56,15 @@ enum class RedisResultType
  * @brief This class represents a redis reply with no error.
  * @note Limited by the hiredis library, the RedisResult object is only
  * available in the context of the result callback, one can't hold or copy or
- * move a RedisResult object for later use after the callback is returned.
+ * move a RedisResult object for later use after the callback is returned,
+ * unless it is returned by retain().
  */
 class DROGON_EXPORT RedisResult
 {
   public:
-    explicit RedisResult(redisReply *result) : result_(result)
+    explicit RedisResult(redisReply *result,
+                         internal::RedisReplyOwner *owner = nullptr)
+        : result_(result), owner_(owner)
     {
     }
 
@@ -67,6 +86,46 @@ class DROGON_EXPORT RedisResult
      */
     std::string asString() const noexcept(false);
 
+    /**
+     * @brief Get a view of the string value of the result, without copying
+     * it.
+     *
+     * @return std::string_view
+     * @note The view is only valid in the context of the result callback.
+     * Calling the method of a result object whose type is not kString,
+     * kStatus or kError throws a runtime exception.
+     */
+    std::string_view asStringView() const noexcept(false);
+
+    /**
+     * @brief Get the string value of the result with an object keeping its
+     * memory alive after the result callback returns.
+     *
+     * When the reply was received by a connection of this library, the
+     * memory of the reply is shared without copying, which allows to send a
+     * large value (e.g. a cached page) as the body of a response without
+     * any copy:
+     * @code
+       auto [owner, body] = result.shareString();
+       resp->setSharedBody(std::move(owner), body);
+       @endcode
+     * Otherwise the string is copied once.
+     * @note The view must not be used after the owner is released. Calling
+     * the method of a result object whose type is not kString, kStatus or
+     * kError throws a runtime exception.
+     */
+    std::pair<std::shared_ptr<const void>, std::string_view> shareString()
+        const noexcept(false);
+
+    /**
+     * @brief Get a copy of the result which stays valid after the result
+     * callback returns, as well as the elements of its array.
+     *
+     * The reply received by a connection of this library is kept alive
+     * without copying it, otherwise it is copied.
+     */
+    RedisResult retain() const;
+
     /**
      * @brief Get the array value of the result.
      *
@@ -122,6 +181,9 @@ class DROGON_EXPORT RedisResult
 
   private:
     redisReply *result_;
+    internal::RedisReplyOwner *owner_;
+    // Set for the retained results, keeps the whole reply alive.
+    std::shared_ptr<const void> keeper_;
 };
 
 using RedisResultCallback = std::function<void(const RedisResult &)>;
@@ -0,0 +1,37 @@
+/**
+ *
+ *  @file RedisBatch.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "RedisConnection.h"
+#include <drogon/nosql/RedisClient.h>
+#include <cstdarg>
+
+using namespace drogon::nosql;
+
+RedisBatch &RedisBatch::add(std::string_view command, ...) noexcept(false)
+{
+    va_list args;
+    va_start(args, command);
+    try
+    {
+        commands_.emplace_back(
+            RedisConnection::getFormattedCommand(command, args));
+    }
+    catch (...)
+    {
+        va_end(args);
+        throw;
+    }
+    va_end(args);
+    return *this;
+}
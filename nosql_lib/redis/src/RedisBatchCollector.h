@@ -0,0 +1,92 @@
+/**
+ *
+ *  @file RedisBatchCollector.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/nosql/RedisClient.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace drogon
+{
+namespace nosql
+{
+/**
+ * @brief Collects the replies of the commands of a batch, which may be
+ * received by several connections, and calls the callback of the batch after
+ * the last one.
+ */
+class RedisBatchCollector
+    : public std::enable_shared_from_this<RedisBatchCollector>
+{
+  public:
+    RedisBatchCollector(size_t count,
+                        RedisBatchCallback &&resultCallback,
+                        RedisExceptionCallback &&exceptionCallback)
+        : results_(count, RedisResult(nullptr)),
+          remaining_(count),
+          resultCallback_(std::move(resultCallback)),
+          exceptionCallback_(std::move(exceptionCallback))
+    {
+    }
+
+    RedisResultCallback resultCallback(size_t index)
+    {
+        return [thisPtr = shared_from_this(),
+                index](const RedisResult &result) {
+            {
+                std::lock_guard<std::mutex> lock(thisPtr->mutex_);
+                thisPtr->results_[index] = result.retain();
+            }
+            thisPtr->done();
+        };
+    }
+
+    RedisExceptionCallback exceptionCallback()
+    {
+        return [thisPtr = shared_from_this()](const RedisException &err) {
+            {
+                std::lock_guard<std::mutex> lock(thisPtr->mutex_);
+                if (!thisPtr->error_)
+                    thisPtr->error_ = err;
+            }
+            thisPtr->done();
+        };
+    }
+
+  private:
+    void done()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--remaining_ > 0)
+                return;
+        }
+        if (error_)
+            exceptionCallback_(*error_);
+        else
+            resultCallback_(results_);
+    }
+
+    std::mutex mutex_;
+    std::vector<RedisResult> results_;
+    size_t remaining_;
+    std::optional<RedisException> error_;
+    RedisBatchCallback resultCallback_;
+    RedisExceptionCallback exceptionCallback_;
+};
+}  // namespace nosql
+}  // namespace drogon
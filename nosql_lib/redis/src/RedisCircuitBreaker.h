@@ -0,0 +1,73 @@
+/**
+ *
+ *  @file RedisCircuitBreaker.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/CircuitBreaker.h>
+#include <drogon/nosql/RedisClient.h>
+#include <chrono>
+
+namespace drogon
+{
+namespace nosql
+{
+/**
+ * @brief Fail the command at once while the circuit of the breaker is open,
+ * and record its outcome otherwise by wrapping its callbacks.
+ *
+ * @return false if the circuit is open, the exception callback is then
+ * called.
+ */
+inline bool applyCircuitBreaker(const CircuitBreakerPtr &breaker,
+                                RedisResultCallback &resultCallback,
+                                RedisExceptionCallback &exceptionCallback)
+{
+    if (!breaker)
+        return true;
+    if (!breaker->allow())
+    {
+        exceptionCallback(
+            RedisException(RedisErrorCode::kNoConnectionAvailable,
+                           "The circuit breaker of the client is open"));
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [start]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+            .count();
+    };
+    resultCallback = [breaker,
+                      elapsed,
+                      resultCallback = std::move(resultCallback)](
+                         const RedisResult &result) {
+        breaker->record(true, elapsed());
+        resultCallback(result);
+    };
+    exceptionCallback = [breaker,
+                         elapsed,
+                         exceptionCallback = std::move(exceptionCallback)](
+                            const RedisException &err) {
+        // The error replies of the server don't count.
+        auto code = err.code();
+        breaker->record(code != RedisErrorCode::kConnectionBroken &&
+                            code != RedisErrorCode::kNoConnectionAvailable &&
+                            code != RedisErrorCode::kTimeout,
+                        elapsed());
+        exceptionCallback(err);
+    };
+    return true;
+}
+}  // namespace nosql
+}  // namespace drogon
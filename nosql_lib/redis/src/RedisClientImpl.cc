@@ -13,10 +13,14 @@
  */
 
 #include "RedisConnection.h"
+#include "RedisCircuitBreaker.h"
 #include "RedisClientImpl.h"
+#include "RedisBatchCollector.h"
 #include "RedisSubscriberImpl.h"
 #include "RedisTransactionImpl.h"
 #include "../../lib/src/TaskTimeoutFlag.h"
+#include <drogon/RequestDeadline.h>
+#include <drogon/RequestTrace.h>
 
 using namespace drogon::nosql;
 
@@ -33,16 +37,35 @@ std::shared_ptr<RedisClient> RedisClient::newRedisClient(
     return client;
 }
 
+std::shared_ptr<RedisClient> RedisClient::newUnixRedisClient(
+    const std::string &path,
+    size_t connectionNumber,
+    const std::string &password,
+    unsigned int db,
+    const std::string &username)
+{
+    auto client = std::make_shared<RedisClientImpl>(trantor::InetAddress(),
+                                                    connectionNumber,
+                                                    username,
+                                                    password,
+                                                    db,
+                                                    path);
+    client->init();
+    return client;
+}
+
 RedisClientImpl::RedisClientImpl(const trantor::InetAddress &serverAddress,
                                  size_t numberOfConnections,
                                  std::string username,
                                  std::string password,
-                                 unsigned int db)
+                                 unsigned int db,
+                                 std::string unixSocket)
     : loops_(numberOfConnections < std::thread::hardware_concurrency()
                  ? numberOfConnections
                  : std::thread::hardware_concurrency(),
              "RedisLoop"),
       serverAddr_(serverAddress),
+      unixSocket_(std::move(unixSocket)),
       username_(std::move(username)),
       password_(std::move(password)),
       db_(db),
@@ -66,7 +89,7 @@ void RedisClientImpl::init()
 RedisConnectionPtr RedisClientImpl::newConnection(trantor::EventLoop *loop)
 {
     auto conn = std::make_shared<RedisConnection>(
-        serverAddr_, username_, password_, db_, loop);
+        serverAddr_, username_, password_, db_, loop, unixSocket_);
     std::weak_ptr<RedisClientImpl> thisWeakPtr = shared_from_this();
     conn->setConnectCallback([thisWeakPtr](RedisConnectionPtr &&conn) {
         auto thisPtr = thisWeakPtr.lock();
@@ -74,6 +97,8 @@ RedisConnectionPtr RedisClientImpl::newConnection(trantor::EventLoop *loop)
         {
             {
                 std::lock_guard<std::mutex> lock(thisPtr->connectionsMutex_);
+                if (thisPtr->nearCache_)
+                    conn->enableTracking(thisPtr->nearCache_);
                 thisPtr->readyConnections_.push_back(conn);
             }
             thisPtr->handleNextTask(conn);
@@ -119,7 +144,7 @@ RedisConnectionPtr RedisClientImpl::newSubscribeConnection(
     const std::shared_ptr<RedisSubscriberImpl> &subscriber)
 {
     auto conn = std::make_shared<RedisConnection>(
-        serverAddr_, username_, password_, db_, loop);
+        serverAddr_, username_, password_, db_, loop, unixSocket_);
     std::weak_ptr<RedisClientImpl> weakThis = shared_from_this();
     std::weak_ptr<RedisSubscriberImpl> weakSub(subscriber);
     conn->setConnectCallback([weakThis, weakSub](RedisConnectionPtr &&conn) {
@@ -177,15 +202,100 @@ void RedisClientImpl::execCommandAsync(
     std::string_view command,
     ...) noexcept
 {
-    if (timeout_ > 0.0)
+    if (auto &trace = drogon::RequestTrace::current())
+    {
+        // The format of the command is recorded without the arguments.
+        auto span = trace->startSpan("redis.command");
+        span.attributes.emplace_back("db.system", "redis");
+        span.attributes.emplace_back("db.statement", std::string(command));
+        trace->traceCallbacks(std::move(span),
+                              resultCallback,
+                              exceptionCallback);
+    }
+    LOG_TRACE << "redis command: " << command;
+    std::string formattedCmd;
+    va_list args;
+    va_start(args, command);
+    try
+    {
+        formattedCmd = RedisConnection::getFormattedCommand(command, args);
+    }
+    catch (const RedisException &err)
+    {
+        va_end(args);
+        exceptionCallback(err);
+        return;
+    }
+    va_end(args);
+    execFormattedCommandAsync(std::move(formattedCmd),
+                              std::move(resultCallback),
+                              std::move(exceptionCallback));
+}
+
+static void sendToConnection(const RedisConnectionPtr &connPtr,
+                             std::string &&command,
+                             RedisResultCallback &&resultCallback,
+                             RedisExceptionCallback &&exceptionCallback,
+                             bool asking)
+{
+    if (asking)
+    {
+        // Sent on the same connection just before the command, the reply is
+        // ignored.
+        connPtr->sendFormattedCommand(
+            "*1\r\n$6\r\nASKING\r\n",
+            [](const RedisResult & /*result*/) {},
+            [](const RedisException & /*err*/) {});
+    }
+    connPtr->sendFormattedCommand(std::move(command),
+                                  std::move(resultCallback),
+                                  std::move(exceptionCallback));
+}
+
+void RedisClientImpl::execFormattedCommandAsync(
+    std::string &&command,
+    RedisResultCallback &&resultCallback,
+    RedisExceptionCallback &&exceptionCallback,
+    bool asking) noexcept
+{
+    if (auto cache = nearCachePtr_.load(std::memory_order_acquire))
+    {
+        auto key = RedisNearCache::cachedKey(command);
+        if (key && !asking && cache->get(*key, resultCallback))
+            return;
+    }
+    double timeout = timeout_;
+    if (drogon::RequestDeadline::hasCurrent())
+    {
+        // Bounded by the deadline of the request being handled.
+        timeout = drogon::RequestDeadline::clampTimeout(timeout);
+        if (drogon::RequestDeadline::cancelled())
+        {
+            exceptionCallback(
+                RedisException(RedisErrorCode::kTimeout,
+                               "The request was cancelled by the client"));
+            return;
+        }
+        if (timeout < 0.0)
+        {
+            exceptionCallback(
+                RedisException(RedisErrorCode::kTimeout,
+                               "The deadline of the request has passed"));
+            return;
+        }
+        drogon::RequestDeadline::propagate(resultCallback, exceptionCallback);
+    }
+    if (!applyCircuitBreaker(circuitBreakerPtr_,
+                             resultCallback,
+                             exceptionCallback))
+        return;
+    if (timeout > 0.0)
     {
-        va_list args;
-        va_start(args, command);
-        execCommandAsyncWithTimeout(command,
+        execCommandAsyncWithTimeout(std::move(command),
                                     std::move(resultCallback),
                                     std::move(exceptionCallback),
-                                    args);
-        va_end(args);
+                                    asking,
+                                    timeout);
         return;
     }
     RedisConnectionPtr connPtr;
@@ -206,35 +316,75 @@ void RedisClientImpl::execCommandAsync(
     }
     if (connPtr)
     {
-        va_list args;
-        va_start(args, command);
-        connPtr->sendvCommand(command,
-                              std::move(resultCallback),
-                              std::move(exceptionCallback),
-                              args);
-        va_end(args);
+        sendToConnection(connPtr,
+                         std::move(command),
+                         std::move(resultCallback),
+                         std::move(exceptionCallback),
+                         asking);
     }
     else
     {
         LOG_TRACE << "no connection available, push command to buffer";
-        va_list args;
-        va_start(args, command);
-        auto formattedCmd = RedisConnection::getFormattedCommand(command, args);
-        va_end(args);
         std::lock_guard<std::mutex> lock(connectionsMutex_);
         tasks_.emplace_back(
             std::make_shared<std::function<void(const RedisConnectionPtr &)>>(
                 [resultCallback = std::move(resultCallback),
                  exceptionCallback = std::move(exceptionCallback),
-                 formattedCmd = std::move(formattedCmd)](
-                    const RedisConnectionPtr &connPtr) mutable {
-                    connPtr->sendFormattedCommand(std::move(formattedCmd),
-                                                  std::move(resultCallback),
-                                                  std::move(exceptionCallback));
+                 command = std::move(command),
+                 asking](const RedisConnectionPtr &connPtr) mutable {
+                    sendToConnection(connPtr,
+                                     std::move(command),
+                                     std::move(resultCallback),
+                                     std::move(exceptionCallback),
+                                     asking);
                 }));
     }
 }
 
+void RedisClientImpl::execBatchAsync(
+    RedisBatch &&batch,
+    RedisBatchCallback &&resultCallback,
+    RedisExceptionCallback &&exceptionCallback)
+{
+    if (batch.empty())
+    {
+        resultCallback({});
+        return;
+    }
+    auto collector =
+        std::make_shared<RedisBatchCollector>(batch.size(),
+                                              std::move(resultCallback),
+                                              std::move(exceptionCallback));
+    RedisConnectionPtr connPtr;
+    if (timeout_ <= 0.0)
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        if (!readyConnections_.empty())
+        {
+            connPtr = readyConnections_[connectionPos_++ %
+                                        readyConnections_.size()];
+        }
+    }
+    auto commands = batch.releaseCommands();
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        // All the commands are handed to the same connection before its
+        // socket becomes writable, so they leave in a single write.
+        if (connPtr)
+        {
+            connPtr->sendFormattedCommand(std::move(commands[i]),
+                                          collector->resultCallback(i),
+                                          collector->exceptionCallback());
+        }
+        else
+        {
+            execFormattedCommandAsync(std::move(commands[i]),
+                                      collector->resultCallback(i),
+                                      collector->exceptionCallback());
+        }
+    }
+}
+
 RedisClientImpl::~RedisClientImpl()
 {
     closeAll();
@@ -251,6 +401,30 @@ void RedisClientImpl::closeAll()
     connections_.clear();
 }
 
+void RedisClientImpl::enableClientSideCaching(size_t maxEntries)
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    if (nearCache_)
+        return;
+    nearCache_ = std::make_shared<RedisNearCache>(maxEntries);
+    nearCachePtr_.store(nearCache_.get(), std::memory_order_release);
+    // The connections of transactions enable it when they are given back.
+    for (auto &conn : readyConnections_)
+    {
+        conn->enableTracking(nearCache_);
+    }
+}
+
+RedisClient::ConnectionStats RedisClientImpl::connectionStats() noexcept
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    ConnectionStats stats;
+    stats.connected = readyConnections_.size();
+    stats.total = numberOfConnections_;
+    stats.pending = tasks_.size();
+    return stats;
+}
+
 void RedisClientImpl::newTransactionAsync(
     const std::function<void(const std::shared_ptr<RedisTransaction> &)>
         &callback)
@@ -352,6 +526,8 @@ std::shared_ptr<RedisTransaction> RedisClientImpl::makeTransaction(
                 {
                     std::lock_guard<std::mutex> lock(
                         thisPtr->connectionsMutex_);
+                    if (thisPtr->nearCache_)
+                        connPtr->enableTracking(thisPtr->nearCache_);
                     thisPtr->readyConnections_.push_back(connPtr);
                 }
                 thisPtr->handleNextTask(connPtr);
@@ -379,10 +555,11 @@ void RedisClientImpl::handleNextTask(const RedisConnectionPtr &connPtr)
 }
 
 void RedisClientImpl::execCommandAsyncWithTimeout(
-    std::string_view command,
+    std::string &&command,
     RedisResultCallback &&resultCallback,
     RedisExceptionCallback &&exceptionCallback,
-    va_list ap)
+    bool asking,
+    double timeout)
 {
     auto expCbPtr =
         std::make_shared<RedisExceptionCallback>(std::move(exceptionCallback));
@@ -390,7 +567,7 @@ void RedisClientImpl::execCommandAsyncWithTimeout(
         std::weak_ptr<std::function<void(const RedisConnectionPtr &)>>>();
     auto timeoutFlagPtr = std::make_shared<TaskTimeoutFlag>(
         loops_.getNextLoop(),
-        std::chrono::duration<double>(timeout_),
+        std::chrono::duration<double>(timeout),
         [expCbPtr, bufferCbPtr, this]() {
             auto bfCbPtr = (*bufferCbPtr).lock();
             if (bfCbPtr)
@@ -451,24 +628,26 @@ void RedisClientImpl::execCommandAsyncWithTimeout(
     }
     if (connPtr)
     {
-        connPtr->sendvCommand(command,
-                              std::move(newResultCallback),
-                              std::move(newExceptionCallback),
-                              ap);
+        sendToConnection(connPtr,
+                         std::move(command),
+                         std::move(newResultCallback),
+                         std::move(newExceptionCallback),
+                         asking);
     }
     else
     {
         LOG_TRACE << "no connection available, push command to buffer";
-        auto formattedCmd = RedisConnection::getFormattedCommand(command, ap);
         auto bfCbPtr =
             std::make_shared<std::function<void(const RedisConnectionPtr &)>>(
                 [resultCallback = std::move(newResultCallback),
                  exceptionCallback = std::move(newExceptionCallback),
-                 formattedCmd = std::move(formattedCmd)](
-                    const RedisConnectionPtr &connPtr) mutable {
-                    connPtr->sendFormattedCommand(std::move(formattedCmd),
-                                                  std::move(resultCallback),
-                                                  std::move(exceptionCallback));
+                 command = std::move(command),
+                 asking](const RedisConnectionPtr &connPtr) mutable {
+                    sendToConnection(connPtr,
+                                     std::move(command),
+                                     std::move(resultCallback),
+                                     std::move(exceptionCallback),
+                                     asking);
                 });
         (*bufferCbPtr) = bfCbPtr;
         std::lock_guard<std::mutex> lock(connectionsMutex_);
@@ -19,6 +19,7 @@
 #include <drogon/nosql/RedisClient.h>
 #include <trantor/utils/NonCopyable.h>
 #include <trantor/net/EventLoopThreadPool.h>
+#include <atomic>
 #include <vector>
 #include <unordered_set>
 #include <list>
@@ -41,11 +42,21 @@ class RedisClientImpl final
                     size_t numberOfConnections,
                     std::string username = "",
                     std::string password = "",
-                    unsigned int db = 0);
+                    unsigned int db = 0,
+                    std::string unixSocket = "");
     void execCommandAsync(RedisResultCallback &&resultCallback,
                           RedisExceptionCallback &&exceptionCallback,
                           std::string_view command,
                           ...) noexcept override;
+    // Execute a command formatted in the RESP protocol, preceded by ASKING on
+    // the same connection if asking is true.
+    void execFormattedCommandAsync(std::string &&command,
+                                   RedisResultCallback &&resultCallback,
+                                   RedisExceptionCallback &&exceptionCallback,
+                                   bool asking = false) noexcept;
+    void execBatchAsync(RedisBatch &&batch,
+                        RedisBatchCallback &&resultCallback,
+                        RedisExceptionCallback &&exceptionCallback) override;
     ~RedisClientImpl() override;
     std::shared_ptr<RedisSubscriber> newSubscriber() noexcept override;
 
@@ -75,8 +86,16 @@ class RedisClientImpl final
         timeout_ = timeout;
     }
 
+    void setCircuitBreaker(CircuitBreakerPtr breaker) override
+    {
+        circuitBreakerPtr_ = std::move(breaker);
+    }
+
+    void enableClientSideCaching(size_t maxEntries) override;
+
     void init();
     void closeAll() override;
+    ConnectionStats connectionStats() noexcept override;
 
   private:
     trantor::EventLoopThreadPool loops_;
@@ -85,13 +104,20 @@ class RedisClientImpl final
     std::vector<RedisConnectionPtr> readyConnections_;
     size_t connectionPos_{0};
     const trantor::InetAddress serverAddr_;
+    // Connect to the unix socket instead of serverAddr_ if not empty
+    const std::string unixSocket_;
     const std::string username_;
     const std::string password_;
     const unsigned int db_;
     const size_t numberOfConnections_;
     double timeout_{-1.0};
+    CircuitBreakerPtr circuitBreakerPtr_;
     std::list<std::shared_ptr<std::function<void(const RedisConnectionPtr &)>>>
         tasks_;
+    // Set once by enableClientSideCaching(), nearCachePtr_ is read without
+    // the lock.
+    std::shared_ptr<RedisNearCache> nearCache_;
+    std::atomic<RedisNearCache *> nearCachePtr_{nullptr};
 
     RedisConnectionPtr newConnection(trantor::EventLoop *loop);
     RedisConnectionPtr newSubscribeConnection(
@@ -101,10 +127,11 @@ class RedisClientImpl final
     std::shared_ptr<RedisTransaction> makeTransaction(
         const RedisConnectionPtr &connPtr);
     void handleNextTask(const RedisConnectionPtr &connPtr);
-    void execCommandAsyncWithTimeout(std::string_view command,
+    void execCommandAsyncWithTimeout(std::string &&command,
                                      RedisResultCallback &&resultCallback,
                                      RedisExceptionCallback &&exceptionCallback,
-                                     va_list ap);
+                                     bool asking,
+                                     double timeout);
 };
 }  // namespace nosql
 }  // namespace drogon
@@ -13,10 +13,13 @@
  */
 
 #include "RedisConnection.h"
+#include "RedisCircuitBreaker.h"
 #include "RedisClientLockFree.h"
 #include "RedisSubscriberImpl.h"
 #include "RedisTransactionImpl.h"
 #include "../../lib/src/TaskTimeoutFlag.h"
+#include <drogon/RequestDeadline.h>
+#include <drogon/RequestTrace.h>
 using namespace drogon::nosql;
 
 RedisClientLockFree::RedisClientLockFree(
@@ -25,9 +28,11 @@ RedisClientLockFree::RedisClientLockFree(
     trantor::EventLoop *loop,
     std::string username,
     std::string password,
-    unsigned int db)
+    unsigned int db,
+    std::string unixSocket)
     : loop_(loop),
       serverAddr_(serverAddress),
+      unixSocket_(std::move(unixSocket)),
       username_(std::move(username)),
       password_(std::move(password)),
       db_(db),
@@ -44,7 +49,7 @@ RedisConnectionPtr RedisClientLockFree::newConnection()
 {
     loop_->assertInLoopThread();
     auto conn = std::make_shared<RedisConnection>(
-        serverAddr_, username_, password_, db_, loop_);
+        serverAddr_, username_, password_, db_, loop_, unixSocket_);
     std::weak_ptr<RedisClientLockFree> thisWeakPtr = shared_from_this();
     conn->setConnectCallback([thisWeakPtr](RedisConnectionPtr &&conn) {
         auto thisPtr = thisWeakPtr.lock();
@@ -90,7 +95,7 @@ RedisConnectionPtr RedisClientLockFree::newSubscribeConnection(
 {
     loop_->assertInLoopThread();
     auto conn = std::make_shared<RedisConnection>(
-        serverAddr_, username_, password_, db_, loop_);
+        serverAddr_, username_, password_, db_, loop_, unixSocket_);
     std::weak_ptr<RedisClientLockFree> weakThis = shared_from_this();
     std::weak_ptr<RedisSubscriberImpl> weakSub(subscriber);
     conn->setConnectCallback([weakThis, weakSub](RedisConnectionPtr &&conn) {
@@ -146,13 +151,49 @@ void RedisClientLockFree::execCommandAsync(
     ...) noexcept
 {
     loop_->assertInLoopThread();
-    if (timeout_ > 0.0)
+    if (auto &trace = drogon::RequestTrace::current())
+    {
+        // The format of the command is recorded without the arguments.
+        auto span = trace->startSpan("redis.command");
+        span.attributes.emplace_back("db.system", "redis");
+        span.attributes.emplace_back("db.statement", std::string(command));
+        trace->traceCallbacks(std::move(span),
+                              resultCallback,
+                              exceptionCallback);
+    }
+    double timeout = timeout_;
+    if (drogon::RequestDeadline::hasCurrent())
+    {
+        // Bounded by the deadline of the request being handled.
+        timeout = drogon::RequestDeadline::clampTimeout(timeout);
+        if (drogon::RequestDeadline::cancelled())
+        {
+            exceptionCallback(
+                RedisException(RedisErrorCode::kTimeout,
+                               "The request was cancelled by the client"));
+            return;
+        }
+        if (timeout < 0.0)
+        {
+            exceptionCallback(
+                RedisException(RedisErrorCode::kTimeout,
+                               "The deadline of the request has passed"));
+            return;
+        }
+        drogon::RequestDeadline::propagate(resultCallback, exceptionCallback);
+    }
+    if (!applyCircuitBreaker(circuitBreakerPtr_,
+                             resultCallback,
+                             exceptionCallback))
+        return;
+    if (timeout > 0.0)
     {
         va_list args;
         va_start(args, command);
         execCommandAsyncWithTimeout(command,
                                     std::move(resultCallback),
                                     std::move(exceptionCallback),
+                                    timeout,
                                     args);
         va_end(args);
         return;
@@ -342,6 +383,7 @@ void RedisClientLockFree::execCommandAsyncWithTimeout(
     std::string_view command,
     RedisResultCallback &&resultCallback,
     RedisExceptionCallback &&exceptionCallback,
+    double timeout,
     va_list ap)
 {
     auto expCbPtr =
@@ -350,7 +392,7 @@ void RedisClientLockFree::execCommandAsyncWithTimeout(
         std::weak_ptr<std::function<void(const RedisConnectionPtr &)>>>();
     auto timeoutFlagPtr = std::make_shared<TaskTimeoutFlag>(
         loop_,
-        std::chrono::duration<double>(timeout_),
+        std::chrono::duration<double>(timeout),
         [expCbPtr, bufferCbPtr, this]() {
             auto bfCbPtr = (*bufferCbPtr).lock();
             if (bfCbPtr)
@@ -41,7 +41,8 @@ class RedisClientLockFree final
                         trantor::EventLoop *loop,
                         std::string username = "",
                         std::string password = "",
-                        unsigned int db = 0);
+                        unsigned int db = 0,
+                        std::string unixSocket = "");
     void execCommandAsync(RedisResultCallback &&resultCallback,
                           RedisExceptionCallback &&exceptionCallback,
                           std::string_view command,
@@ -68,6 +69,11 @@ class RedisClientLockFree final
         timeout_ = timeout;
     }
 
+    void setCircuitBreaker(CircuitBreakerPtr breaker) override
+    {
+        circuitBreakerPtr_ = std::move(breaker);
+    }
+
     void closeAll() override;
 
   private:
@@ -76,6 +82,8 @@ class RedisClientLockFree final
     std::vector<RedisConnectionPtr> readyConnections_;
     size_t connectionPos_{0};
     const trantor::InetAddress serverAddr_;
+    // Connect to the unix socket instead of serverAddr_ if not empty
+    const std::string unixSocket_;
     const std::string username_;
     const std::string password_;
     const unsigned int db_;
@@ -83,6 +91,7 @@ class RedisClientLockFree final
     std::list<std::shared_ptr<std::function<void(const RedisConnectionPtr &)>>>
         tasks_;
     double timeout_{-1.0};
+    CircuitBreakerPtr circuitBreakerPtr_;
 
     RedisConnectionPtr newConnection();
     RedisConnectionPtr newSubscribeConnection(
@@ -93,6 +102,7 @@ class RedisClientLockFree final
     void execCommandAsyncWithTimeout(std::string_view command,
                                      RedisResultCallback &&resultCallback,
                                      RedisExceptionCallback &&exceptionCallback,
+                                     double timeout,
                                      va_list ap);
 };
 }  // namespace nosql
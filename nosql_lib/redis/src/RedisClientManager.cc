@@ -21,6 +21,14 @@
 using namespace drogon::nosql;
 using namespace drogon;
 
+// A host with the "unix:" prefix is the path of the unix socket of the server
+static std::string unixSocketPath(const std::string &host)
+{
+    if (host.compare(0, 5, "unix:") == 0)
+        return host.substr(5);
+    return {};
+}
+
 void RedisClientManager::createRedisClients(
     const std::vector<trantor::EventLoop *> &ioLoops)
 {
@@ -28,6 +36,11 @@ void RedisClientManager::createRedisClients(
     assert(redisFastClientsMap_.empty());
     for (auto &redisInfo : redisInfos_)
     {
+        auto unixSocket = unixSocketPath(redisInfo.addr_);
+        auto serverAddress =
+            unixSocket.empty()
+                ? trantor::InetAddress(redisInfo.addr_, redisInfo.port_)
+                : trantor::InetAddress();
         if (redisInfo.isFast_)
         {
             redisFastClientsMap_[redisInfo.name_] =
@@ -37,12 +50,13 @@ void RedisClientManager::createRedisClients(
                 assert(idx == ioLoops[idx]->index());
                 LOG_TRACE << "create fast redis client for the thread " << idx;
                 c = std::make_shared<RedisClientLockFree>(
-                    trantor::InetAddress(redisInfo.addr_, redisInfo.port_),
+                    serverAddress,
                     redisInfo.connectionNumber_,
                     ioLoops[idx],
                     redisInfo.username_,
                     redisInfo.password_,
-                    redisInfo.db_);
+                    redisInfo.db_,
+                    unixSocket);
                 if (redisInfo.timeout_ > 0.0)
                 {
                     c->setTimeout(redisInfo.timeout_);
@@ -51,12 +65,13 @@ void RedisClientManager::createRedisClients(
         }
         else
         {
-            auto clientPtr = std::make_shared<RedisClientImpl>(
-                trantor::InetAddress(redisInfo.addr_, redisInfo.port_),
-                redisInfo.connectionNumber_,
-                redisInfo.username_,
-                redisInfo.password_,
-                redisInfo.db_);
+            auto clientPtr =
+                std::make_shared<RedisClientImpl>(serverAddress,
+                                                  redisInfo.connectionNumber_,
+                                                  redisInfo.username_,
+                                                  redisInfo.password_,
+                                                  redisInfo.db_,
+                                                  unixSocket);
             if (redisInfo.timeout_ > 0.0)
             {
                 clientPtr->setTimeout(redisInfo.timeout_);
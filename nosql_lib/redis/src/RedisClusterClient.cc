@@ -0,0 +1,525 @@
+/**
+ *
+ *  @file RedisClusterClient.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "RedisClusterClient.h"
+#include "RedisBatchCollector.h"
+#include "RedisClientImpl.h"
+#include "RedisConnection.h"
+#include <drogon/RequestTrace.h>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cctype>
+#include <cstdarg>
+#include <cstdlib>
+#include <unordered_set>
+
+using namespace drogon::nosql;
+
+// The redirections followed by a command before failing.
+static constexpr int kMaxRedirections = 5;
+
+std::shared_ptr<RedisClient> RedisClient::newRedisClusterClient(
+    const std::vector<trantor::InetAddress> &seedAddresses,
+    size_t connectionsPerNode,
+    const std::string &password,
+    const std::string &username)
+{
+    auto client = std::make_shared<RedisClusterClient>(seedAddresses,
+                                                       connectionsPerNode,
+                                                       username,
+                                                       password);
+    client->init();
+    return client;
+}
+
+RedisClusterClient::RedisClusterClient(
+    std::vector<trantor::InetAddress> seedAddresses,
+    size_t connectionsPerNode,
+    std::string username,
+    std::string password)
+    : seedAddresses_(std::move(seedAddresses)),
+      connectionsPerNode_(connectionsPerNode),
+      username_(std::move(username)),
+      password_(std::move(password)),
+      slots_(kSlotCount)
+{
+    assert(!seedAddresses_.empty());
+}
+
+RedisClusterClient::~RedisClusterClient()
+{
+    closeAll();
+}
+
+void RedisClusterClient::init()
+{
+    refreshSlots();
+}
+
+size_t RedisClusterClient::keySlot(std::string_view key) noexcept
+{
+    // CRC16-CCITT (XMODEM) as specified by the cluster.
+    static const auto table = []() {
+        std::array<uint16_t, 256> table{};
+        for (uint16_t i = 0; i < 256; ++i)
+        {
+            uint16_t crc = static_cast<uint16_t>(i << 8);
+            for (int bit = 0; bit < 8; ++bit)
+                crc = static_cast<uint16_t>(
+                    (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+            table[i] = crc;
+        }
+        return table;
+    }();
+    auto open = key.find('{');
+    if (open != std::string_view::npos)
+    {
+        auto close = key.find('}', open + 1);
+        if (close != std::string_view::npos && close > open + 1)
+            key = key.substr(open + 1, close - open - 1);
+    }
+    uint16_t crc = 0;
+    for (unsigned char c : key)
+        crc = static_cast<uint16_t>((crc << 8) ^ table[(crc >> 8) ^ c]);
+    return crc & (kSlotCount - 1);
+}
+
+std::vector<std::string_view> RedisClusterClient::commandArguments(
+    std::string_view command)
+{
+    std::vector<std::string_view> arguments;
+    auto readNumber = [&command](char prefix, size_t &number) {
+        if (command.empty() || command[0] != prefix)
+            return false;
+        auto end = command.find("\r\n");
+        if (end == std::string_view::npos)
+            return false;
+        number = strtoul(std::string(command.substr(1, end - 1)).c_str(),
+                         nullptr,
+                         10);
+        command.remove_prefix(end + 2);
+        return true;
+    };
+    size_t count;
+    if (!readNumber('*', count))
+        return arguments;
+    arguments.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t length;
+        if (!readNumber('$', length) || command.size() < length + 2)
+            break;
+        arguments.push_back(command.substr(0, length));
+        command.remove_prefix(length + 2);
+    }
+    return arguments;
+}
+
+std::optional<std::string_view> RedisClusterClient::commandKey(
+    const std::vector<std::string_view> &arguments)
+{
+    if (arguments.size() < 2)
+        return std::nullopt;
+    std::string name{arguments[0]};
+    std::transform(name.begin(),
+                   name.end(),
+                   name.begin(),
+                   [](unsigned char c) { return tolower(c); });
+    static const std::unordered_set<std::string_view> keylessCommands{
+        "auth",     "bgrewriteaof", "bgsave",   "client",   "cluster",
+        "command",  "config",       "dbsize",   "echo",     "flushall",
+        "flushdb",  "function",     "hello",    "info",     "keys",
+        "lastsave", "latency",      "ping",     "publish",  "randomkey",
+        "role",     "save",         "scan",     "script",   "select",
+        "slowlog",  "time",         "wait"};
+    if (keylessCommands.count(name))
+        return std::nullopt;
+    if (name == "eval" || name == "evalsha" || name == "eval_ro" ||
+        name == "evalsha_ro" || name == "fcall" || name == "fcall_ro")
+    {
+        // EVAL script numkeys key...
+        if (arguments.size() < 4 || std::string(arguments[2]) == "0")
+            return std::nullopt;
+        return arguments[3];
+    }
+    if (name == "xread" || name == "xreadgroup")
+    {
+        for (size_t i = 1; i + 1 < arguments.size(); ++i)
+        {
+            std::string token{arguments[i]};
+            std::transform(token.begin(),
+                           token.end(),
+                           token.begin(),
+                           [](unsigned char c) { return tolower(c); });
+            if (token == "streams")
+                return arguments[i + 1];
+        }
+        return std::nullopt;
+    }
+    if (name == "bitop" || name == "object" || name == "memory")
+    {
+        // BITOP op destkey key..., OBJECT ENCODING key, MEMORY USAGE key
+        if (arguments.size() < 3)
+            return std::nullopt;
+        return arguments[2];
+    }
+    return arguments[1];
+}
+
+void RedisClusterClient::execCommandAsync(
+    RedisResultCallback &&resultCallback,
+    RedisExceptionCallback &&exceptionCallback,
+    std::string_view command,
+    ...) noexcept
+{
+    if (auto &trace = drogon::RequestTrace::current())
+    {
+        // The format of the command is recorded without the arguments.
+        auto span = trace->startSpan("redis.command");
+        span.attributes.emplace_back("db.system", "redis");
+        span.attributes.emplace_back("db.statement", std::string(command));
+        trace->traceCallbacks(std::move(span),
+                              resultCallback,
+                              exceptionCallback);
+    }
+    auto cmd = std::make_shared<Command>();
+    va_list args;
+    va_start(args, command);
+    try
+    {
+        cmd->command = RedisConnection::getFormattedCommand(command, args);
+    }
+    catch (const RedisException &err)
+    {
+        va_end(args);
+        exceptionCallback(err);
+        return;
+    }
+    va_end(args);
+    auto key = commandKey(commandArguments(cmd->command));
+    cmd->slot = key ? static_cast<long>(keySlot(*key)) : -1;
+    cmd->resultCallback = std::move(resultCallback);
+    cmd->exceptionCallback = std::move(exceptionCallback);
+    send(cmd);
+}
+
+void RedisClusterClient::execBatchAsync(
+    RedisBatch &&batch,
+    RedisBatchCallback &&resultCallback,
+    RedisExceptionCallback &&exceptionCallback)
+{
+    if (batch.empty())
+    {
+        resultCallback({});
+        return;
+    }
+    auto collector =
+        std::make_shared<RedisBatchCollector>(batch.size(),
+                                              std::move(resultCallback),
+                                              std::move(exceptionCallback));
+    auto commands = batch.releaseCommands();
+    // Each command goes to the node of its own slot.
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        auto cmd = std::make_shared<Command>();
+        cmd->command = std::move(commands[i]);
+        auto key = commandKey(commandArguments(cmd->command));
+        cmd->slot = key ? static_cast<long>(keySlot(*key)) : -1;
+        cmd->resultCallback = collector->resultCallback(i);
+        cmd->exceptionCallback = collector->exceptionCallback();
+        send(cmd);
+    }
+}
+
+void RedisClusterClient::send(const CommandPtr &command,
+                              const std::string &address,
+                              bool asking)
+{
+    std::shared_ptr<RedisClientImpl> node;
+    if (address.empty())
+    {
+        std::string nodeAddress;
+        node = nodeOfSlot(command->slot, nodeAddress);
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        node = nodeLocked(address);
+    }
+    if (!node)
+    {
+        command->exceptionCallback(
+            RedisException(RedisErrorCode::kNoConnectionAvailable,
+                           "No node of the cluster is available"));
+        return;
+    }
+    std::weak_ptr<RedisClusterClient> weakThis = shared_from_this();
+    // The command is kept for the redirections.
+    node->execFormattedCommandAsync(
+        std::string(command->command),
+        [command](const RedisResult &result) {
+            command->resultCallback(result);
+        },
+        [weakThis, command](const RedisException &err) {
+            auto thisPtr = weakThis.lock();
+            if (thisPtr)
+                thisPtr->handleError(command, err);
+            else
+                command->exceptionCallback(err);
+        },
+        asking);
+}
+
+void RedisClusterClient::handleError(const CommandPtr &command,
+                                     const RedisException &err)
+{
+    std::string_view message{err.what()};
+    bool moved = message.substr(0, 6) == "MOVED ";
+    bool ask = message.substr(0, 4) == "ASK ";
+    if (err.code() == RedisErrorCode::kRedisError && (moved || ask) &&
+        command->redirections < kMaxRedirections)
+    {
+        // MOVED <slot> <ip>:<port>
+        auto slotPos = message.find(' ') + 1;
+        auto addressPos = message.find(' ', slotPos);
+        if (addressPos != std::string_view::npos)
+        {
+            auto slot = strtoul(
+                std::string(message.substr(slotPos, addressPos - slotPos))
+                    .c_str(),
+                nullptr,
+                10);
+            std::string address{message.substr(addressPos + 1)};
+            ++command->redirections;
+            if (moved)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (slot < kSlotCount)
+                        slots_[slot] = address;
+                }
+                // Several slots have likely moved, e.g. after a failover.
+                refreshSlots();
+            }
+            send(command, address, ask);
+            return;
+        }
+    }
+    if (err.code() == RedisErrorCode::kConnectionBroken)
+        refreshSlots();
+    command->exceptionCallback(err);
+}
+
+std::shared_ptr<RedisClientImpl> RedisClusterClient::nodeLocked(
+    const std::string &address)
+{
+    auto iter = nodes_.find(address);
+    if (iter != nodes_.end())
+        return iter->second;
+    auto pos = address.rfind(':');
+    if (pos == std::string::npos)
+        return nullptr;
+    auto ip = address.substr(0, pos);
+    auto port = static_cast<uint16_t>(atoi(address.c_str() + pos + 1));
+    auto node = std::make_shared<RedisClientImpl>(
+        trantor::InetAddress(ip, port, ip.find(':') != std::string::npos),
+        connectionsPerNode_,
+        username_,
+        password_,
+        0);
+    if (timeout_ > 0.0)
+        node->setTimeout(timeout_);
+    if (cacheEntries_ > 0)
+        node->enableClientSideCaching(cacheEntries_);
+    node->init();
+    nodes_.emplace(address, node);
+    return node;
+}
+
+std::shared_ptr<RedisClientImpl> RedisClusterClient::nodeOfSlot(
+    long slot,
+    std::string &address)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slot >= 0 && !slots_[slot].empty())
+    {
+        address = slots_[slot];
+        return nodeLocked(address);
+    }
+    if (!nodes_.empty())
+    {
+        // Any node replies with a redirection if it doesn't serve the slot.
+        auto iter = nodes_.begin();
+        address = iter->first;
+        return iter->second;
+    }
+    // All the nodes are gone, start again from the seeds.
+    address = seedAddresses_[nextSeed_++ % seedAddresses_.size()].toIpPort();
+    return nodeLocked(address);
+}
+
+void RedisClusterClient::refreshSlots()
+{
+    if (refreshing_.exchange(true))
+        return;
+    std::string address;
+    auto node = nodeOfSlot(-1, address);
+    if (!node)
+    {
+        refreshing_ = false;
+        return;
+    }
+    std::weak_ptr<RedisClusterClient> weakThis = shared_from_this();
+    node->execFormattedCommandAsync(
+        "*2\r\n$7\r\nCLUSTER\r\n$5\r\nSLOTS\r\n",
+        [weakThis, address](const RedisResult &result) {
+            auto thisPtr = weakThis.lock();
+            if (!thisPtr)
+                return;
+            thisPtr->updateSlots(result, address);
+            thisPtr->refreshing_ = false;
+        },
+        [weakThis, address](const RedisException &err) {
+            LOG_ERROR << "Failed to get the slots of the cluster from "
+                      << address << ": " << err.what();
+            auto thisPtr = weakThis.lock();
+            if (!thisPtr)
+                return;
+            {
+                // Try another node next time.
+                std::lock_guard<std::mutex> lock(thisPtr->mutex_);
+                auto iter = thisPtr->nodes_.find(address);
+                if (iter != thisPtr->nodes_.end())
+                {
+                    iter->second->closeAll();
+                    thisPtr->nodes_.erase(iter);
+                }
+            }
+            thisPtr->refreshing_ = false;
+        });
+}
+
+void RedisClusterClient::updateSlots(const RedisResult &result,
+                                     const std::string &address)
+{
+    std::vector<std::string> slots(kSlotCount);
+    try
+    {
+        // Each range is [start, end, [ip, port, id], replicas...]
+        for (auto &range : result.asArray())
+        {
+            auto fields = range.asArray();
+            if (fields.size() < 3)
+                continue;
+            auto start = fields[0].asInteger();
+            auto end = fields[1].asInteger();
+            auto primary = fields[2].asArray();
+            if (primary.size() < 2 || start < 0 ||
+                end >= static_cast<long long>(kSlotCount))
+                continue;
+            auto ip = primary[0].asString();
+            if (ip.empty())
+            {
+                // The node which replied
+                ip = address.substr(0, address.rfind(':'));
+            }
+            auto nodeAddress =
+                ip + ":" + std::to_string(primary[1].asInteger());
+            for (auto slot = start; slot <= end; ++slot)
+                slots[slot] = nodeAddress;
+        }
+    }
+    catch (const RedisException &err)
+    {
+        LOG_ERROR << "Bad reply of CLUSTER SLOTS: " << err.what();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_ = std::move(slots);
+    // The nodes no longer serving any slot, e.g. failed primaries, are
+    // dropped.
+    std::unordered_set<std::string_view> addresses(slots_.begin(),
+                                                   slots_.end());
+    for (auto iter = nodes_.begin(); iter != nodes_.end();)
+    {
+        if (addresses.count(iter->first) == 0 && addresses.size() > 1)
+        {
+            iter->second->closeAll();
+            iter = nodes_.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+std::shared_ptr<RedisSubscriber> RedisClusterClient::newSubscriber() noexcept
+{
+    // The messages are propagated to all the nodes of the cluster.
+    std::string address;
+    return nodeOfSlot(-1, address)->newSubscriber();
+}
+
+RedisTransactionPtr RedisClusterClient::newTransaction() noexcept(false)
+{
+    throw RedisException(RedisErrorCode::kInternalError,
+                         "Transactions are not supported in cluster mode");
+}
+
+void RedisClusterClient::newTransactionAsync(
+    const std::function<void(const RedisTransactionPtr &)> &callback)
+{
+    LOG_ERROR << "Transactions are not supported in cluster mode";
+    callback(nullptr);
+}
+
+void RedisClusterClient::setTimeout(double timeout)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeout_ = timeout;
+    for (auto &node : nodes_)
+        node.second->setTimeout(timeout);
+}
+
+void RedisClusterClient::enableClientSideCaching(size_t maxEntries)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cacheEntries_ = maxEntries;
+    for (auto &node : nodes_)
+        node.second->enableClientSideCaching(maxEntries);
+}
+
+void RedisClusterClient::closeAll()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &node : nodes_)
+        node.second->closeAll();
+    nodes_.clear();
+}
+
+RedisClient::ConnectionStats RedisClusterClient::connectionStats() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ConnectionStats stats;
+    for (auto &node : nodes_)
+    {
+        auto nodeStats = node.second->connectionStats();
+        stats.connected += nodeStats.connected;
+        stats.total += nodeStats.total;
+        stats.pending += nodeStats.pending;
+    }
+    return stats;
+}
@@ -0,0 +1,122 @@
+/**
+ *
+ *  @file RedisClusterClient.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+
+#include <drogon/nosql/RedisClient.h>
+#include <trantor/utils/NonCopyable.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace drogon
+{
+namespace nosql
+{
+class RedisClientImpl;
+
+/**
+ * @brief A client of a Redis Cluster, routing the commands by the slot of
+ * their key to a RedisClientImpl per primary node.
+ */
+class RedisClusterClient final
+    : public RedisClient,
+      public trantor::NonCopyable,
+      public std::enable_shared_from_this<RedisClusterClient>
+{
+  public:
+    static constexpr size_t kSlotCount = 16384;
+
+    RedisClusterClient(std::vector<trantor::InetAddress> seedAddresses,
+                       size_t connectionsPerNode,
+                       std::string username,
+                       std::string password);
+    ~RedisClusterClient() override;
+
+    void execCommandAsync(RedisResultCallback &&resultCallback,
+                          RedisExceptionCallback &&exceptionCallback,
+                          std::string_view command,
+                          ...) noexcept override;
+    void execBatchAsync(RedisBatch &&batch,
+                        RedisBatchCallback &&resultCallback,
+                        RedisExceptionCallback &&exceptionCallback) override;
+    std::shared_ptr<RedisSubscriber> newSubscriber() noexcept override;
+    RedisTransactionPtr newTransaction() noexcept(false) override;
+    void newTransactionAsync(
+        const std::function<void(const RedisTransactionPtr &)> &callback)
+        override;
+    void setTimeout(double timeout) override;
+    void enableClientSideCaching(size_t maxEntries) override;
+    void closeAll() override;
+    ConnectionStats connectionStats() noexcept override;
+
+    void init();
+
+    // The hash slot of a key, only the part between the first { and the next
+    // } is hashed if it isn't empty.
+    static size_t keySlot(std::string_view key) noexcept;
+
+    // The arguments of a command formatted in the RESP protocol.
+    static std::vector<std::string_view> commandArguments(
+        std::string_view command);
+
+    // The key routing a command, the first one of the command, nullopt if
+    // the command has no key and can be sent to any node.
+    static std::optional<std::string_view> commandKey(
+        const std::vector<std::string_view> &arguments);
+
+  private:
+    struct Command
+    {
+        std::string command;
+        // -1 for the commands without key.
+        long slot;
+        int redirections{0};
+        RedisResultCallback resultCallback;
+        RedisExceptionCallback exceptionCallback;
+    };
+    using CommandPtr = std::shared_ptr<Command>;
+
+    void send(const CommandPtr &command,
+              const std::string &address = "",
+              bool asking = false);
+    void handleError(const CommandPtr &command, const RedisException &err);
+    void refreshSlots();
+    void updateSlots(const RedisResult &result, const std::string &address);
+    // Return the client of a node, created if needed. mutex_ must be held.
+    std::shared_ptr<RedisClientImpl> nodeLocked(const std::string &address);
+    // The node serving a slot, or any node if it's unknown.
+    std::shared_ptr<RedisClientImpl> nodeOfSlot(long slot,
+                                                std::string &address);
+
+    const std::vector<trantor::InetAddress> seedAddresses_;
+    const size_t connectionsPerNode_;
+    const std::string username_;
+    const std::string password_;
+    std::mutex mutex_;
+    double timeout_{-1.0};
+    // The size of the cache of each node, 0 if the caching is disabled.
+    size_t cacheEntries_{0};
+    // The address (ip:port) of the primary serving each slot.
+    std::vector<std::string> slots_;
+    std::unordered_map<std::string, std::shared_ptr<RedisClientImpl>> nodes_;
+    size_t nextSeed_{0};
+    std::atomic<bool> refreshing_{false};
+};
+}  // namespace nosql
+}  // namespace drogon
@@ -13,6 +13,7 @@
  */
 
 #include "RedisConnection.h"
+#include "../../../lib/src/Probes.h"
 #include <drogon/nosql/RedisResult.h>
 #include <future>
 #include <string.h>
@@ -23,12 +24,50 @@
 
 using namespace drogon::nosql;
 
+namespace
+{
+/**
+ * Frees the reply handed to a callback when it returns, unless its memory is
+ * shared by RedisResult::shareString(). With the versions of hiredis freeing
+ * the replies themselves, the results are copied when they are shared.
+ */
+class ReplyGuard
+{
+  public:
+    explicit ReplyGuard(redisReply *reply) : owner_{reply, nullptr}
+    {
+    }
+
+    ~ReplyGuard()
+    {
+#ifdef REDIS_NO_AUTO_FREE_REPLIES
+        if (owner_.reply && !owner_.shared)
+            freeReplyObject(owner_.reply);
+#endif
+    }
+
+    drogon::nosql::internal::RedisReplyOwner *owner()
+    {
+#ifdef REDIS_NO_AUTO_FREE_REPLIES
+        return &owner_;
+#else
+        return nullptr;
+#endif
+    }
+
+  private:
+    drogon::nosql::internal::RedisReplyOwner owner_;
+};
+}  // namespace
+
 RedisConnection::RedisConnection(const trantor::InetAddress &serverAddress,
                                  const std::string &username,
                                  const std::string &password,
                                  unsigned int db,
-                                 trantor::EventLoop *loop)
+                                 trantor::EventLoop *loop,
+                                 std::string unixSocket)
     : serverAddr_(serverAddress),
+      unixSocket_(std::move(unixSocket)),
       username_(username),
       password_(password),
       db_(db),
@@ -43,8 +82,15 @@ void RedisConnection::startConnectionInLoop()
     loop_->assertInLoopThread();
     assert(!redisContext_);
 
-    redisContext_ =
-        ::redisAsyncConnect(serverAddr_.toIp().c_str(), serverAddr_.toPort());
+    if (unixSocket_.empty())
+    {
+        redisContext_ = ::redisAsyncConnect(serverAddr_.toIp().c_str(),
+                                            serverAddr_.toPort());
+    }
+    else
+    {
+        redisContext_ = ::redisAsyncConnectUnix(unixSocket_.c_str());
+    }
     status_ = ConnectStatus::kConnecting;
     if (redisContext_->err)
     {
@@ -63,6 +109,11 @@ void RedisConnection::startConnectionInLoop()
         return;
     }
 
+#ifdef REDIS_NO_AUTO_FREE_REPLIES
+    // The replies are freed by ReplyGuard, so that they can outlive the
+    // callbacks.
+    redisContext_->c.flags |= REDIS_NO_AUTO_FREE_REPLIES;
+#endif
     redisContext_->ev.addWrite = addWrite;
     redisContext_->ev.delWrite = delWrite;
     redisContext_->ev.addRead = addRead;
@@ -78,9 +129,8 @@ void RedisConnection::startConnectionInLoop()
             auto thisPtr = static_cast<RedisConnection *>(context->ev.data);
             if (status != REDIS_OK)
             {
-                LOG_ERROR << "Failed to connect to "
-                          << thisPtr->serverAddr_.toIpPort() << "! "
-                          << context->errstr;
+                LOG_ERROR << "Failed to connect to " << thisPtr->serverName()
+                          << "! " << context->errstr;
                 thisPtr->handleDisconnect();
                 if (thisPtr->disconnectCallback_)
                 {
@@ -90,7 +140,7 @@ void RedisConnection::startConnectionInLoop()
             else
             {
                 LOG_TRACE << "Connected successfully to "
-                          << thisPtr->serverAddr_.toIpPort();
+                          << thisPtr->serverName();
                 if (thisPtr->password_.empty())
                 {
                     if (thisPtr->db_ == 0)
@@ -233,8 +283,7 @@ void RedisConnection::startConnectionInLoop()
                 thisPtr->disconnectCallback_(thisPtr->shared_from_this());
             }
 
-            LOG_TRACE << "Disconnected from "
-                      << thisPtr->serverAddr_.toIpPort();
+            LOG_TRACE << "Disconnected from " << thisPtr->serverName();
         });
 }
 
@@ -244,6 +293,7 @@ void RedisConnection::handleDisconnect()
     loop_->assertInLoopThread();
     while ((!resultCallbacks_.empty()) && (!exceptionCallbacks_.empty()))
     {
+        DROGON_PROBE2(redis__command__end, this, 0);
         if (exceptionCallbacks_.front())
         {
             exceptionCallbacks_.front()(
@@ -254,6 +304,12 @@ void RedisConnection::handleDisconnect()
         exceptionCallbacks_.pop();
     }
     status_ = ConnectStatus::kEnd;
+    if (nearCache_)
+    {
+        // The invalidations sent until we reconnect would be missed.
+        tracking_ = false;
+        nearCache_->clear();
+    }
     channel_->disableAll();
     channel_->remove();
     redisContext_->ev.addWrite = nullptr;
@@ -318,9 +374,35 @@ void RedisConnection::sendCommandInLoop(
     RedisResultCallback &&resultCallback,
     RedisExceptionCallback &&exceptionCallback)
 {
+    if (tracking_)
+    {
+        if (auto key = RedisNearCache::cachedKey(command))
+        {
+            // The server tracks the key for this connection from now on, so
+            // an invalidation of the value always follows its reply.
+            resultCallback = [cache = nearCache_,
+                              key = std::string(*key),
+                              callback = std::move(resultCallback)](
+                                 const RedisResult &result) {
+                if (result.type() == RedisResultType::kString)
+                {
+                    cache->set(key,
+                               std::make_shared<const std::string>(
+                                   result.asStringView()));
+                }
+                else if (result.isNil())
+                {
+                    cache->set(key, nullptr);
+                }
+                callback(result);
+            };
+        }
+    }
     resultCallbacks_.emplace(std::move(resultCallback));
     exceptionCallbacks_.emplace(std::move(exceptionCallback));
 
+    DROGON_PROBE3(
+        redis__command__start, this, command.c_str(), command.length());
     redisAsyncFormattedCommand(
         redisContext_,
         [](redisAsyncContext *context, void *r, void * /*userData*/) {
@@ -332,15 +414,115 @@ void RedisConnection::sendCommandInLoop(
         command.length());
 }
 
+void RedisConnection::enableTracking(
+    const std::shared_ptr<RedisNearCache> &cache)
+{
+    if (loop_->isInLoopThread())
+    {
+        enableTrackingInLoop(cache);
+    }
+    else
+    {
+        loop_->queueInLoop(
+            [thisPtr = shared_from_this(), cache]() {
+                thisPtr->enableTrackingInLoop(cache);
+            });
+    }
+}
+
+void RedisConnection::enableTrackingInLoop(
+    const std::shared_ptr<RedisNearCache> &cache)
+{
+    if (tracking_ || status_ == ConnectStatus::kEnd)
+        return;
+#ifdef REDIS_REPLY_PUSH
+    nearCache_ = cache;
+    // The invalidations are pushed on this connection, which needs RESP3.
+    redisAsyncSetPushCallback(redisContext_,
+                              [](redisAsyncContext *context, void *r) {
+                                  auto thisPtr = static_cast<RedisConnection *>(
+                                      context->ev.data);
+                                  if (thisPtr)
+                                      thisPtr->handlePush(
+                                          static_cast<redisReply *>(r));
+                              });
+    std::weak_ptr<RedisConnection> weakThisPtr = shared_from_this();
+    auto onError = [weakThisPtr](const RedisException &err) {
+        LOG_ERROR << "Failed to enable the client side caching: "
+                  << err.what();
+        auto thisPtr = weakThisPtr.lock();
+        if (!thisPtr)
+            return;
+        thisPtr->tracking_ = false;
+        thisPtr->nearCache_->clear();
+    };
+    sendCommandInLoop("*2\r\n$5\r\nHELLO\r\n$1\r\n3\r\n",
+                      [](const RedisResult & /*result*/) {},
+                      RedisExceptionCallback(onError));
+    sendCommandInLoop(
+        "*3\r\n$6\r\nCLIENT\r\n$8\r\nTRACKING\r\n$2\r\nON\r\n",
+        [](const RedisResult & /*result*/) {},
+        std::move(onError));
+    // The commands are executed in order, the GET commands sent from now on
+    // are tracked.
+    tracking_ = true;
+#else
+    (void)cache;
+    LOG_ERROR << "The client side caching requires hiredis 1.0 or later";
+#endif
+}
+
+void RedisConnection::handlePush(redisReply *reply)
+{
+    // ["invalidate", [key, ...]] or ["invalidate", nil] when the server
+    // flushes its database or can't track the keys anymore.
+    if (!nearCache_ || !reply || reply->elements < 2 ||
+        reply->element[0]->type != REDIS_REPLY_STRING ||
+        strcasecmp(reply->element[0]->str, "invalidate") != 0)
+        return;
+    auto keys = reply->element[1];
+    if (keys->type == REDIS_REPLY_NIL)
+    {
+        nearCache_->clear();
+        return;
+    }
+    for (size_t i = 0; i < keys->elements; ++i)
+    {
+        nearCache_->invalidate(
+            std::string_view(keys->element[i]->str, keys->element[i]->len));
+    }
+}
+
+void RedisConnection::sendPendingCommands()
+{
+    std::vector<PendingCommand> commands;
+    {
+        std::lock_guard<std::mutex> lock(pendingCommandsMutex_);
+        commands.swap(pendingCommands_);
+    }
+    // All the commands are appended to the output buffer of hiredis before
+    // the socket becomes writable.
+    for (auto &cmd : commands)
+    {
+        sendCommandInLoop(cmd.command,
+                          std::move(cmd.resultCallback),
+                          std::move(cmd.exceptionCallback));
+    }
+}
+
 void RedisConnection::handleResult(redisReply *result)
 {
+    ReplyGuard guard(result);
     auto commandCallback = std::move(resultCallbacks_.front());
     resultCallbacks_.pop();
     auto exceptionCallback = std::move(exceptionCallbacks_.front());
     exceptionCallbacks_.pop();
+    DROGON_PROBE2(redis__command__end,
+                  this,
+                  result && result->type != REDIS_REPLY_ERROR ? 1 : 0);
     if (result && result->type != REDIS_REPLY_ERROR)
     {
-        commandCallback(RedisResult(result));
+        commandCallback(RedisResult(result, guard.owner()));
     }
     else
     {
@@ -446,6 +628,7 @@ void RedisConnection::sendUnsubscribeInLoop(
 void RedisConnection::handleSubscribeResult(redisReply *result,
                                             SubscribeContext *subCtx)
 {
+    ReplyGuard guard(result);
     if (result && result->type == REDIS_REPLY_ARRAY && result->elements >= 3 &&
         result->element[0]->type == REDIS_REPLY_STRING)
     {
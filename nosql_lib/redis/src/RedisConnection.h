@@ -24,8 +24,11 @@
 #include <hiredis/async.h>
 #include <hiredis/hiredis.h>
 #include <memory>
+#include <mutex>
 #include <queue>
+#include <vector>
 
+#include "RedisNearCache.h"
 #include "SubscribeContext.h"
 
 namespace drogon
@@ -44,11 +47,14 @@ class RedisConnection : public trantor::NonCopyable,
                         public std::enable_shared_from_this<RedisConnection>
 {
   public:
+    /// Connect to the unix socket at the path instead of the address if the
+    /// path isn't empty.
     RedisConnection(const trantor::InetAddress &serverAddress,
                     const std::string &username,
                     const std::string &password,
                     unsigned int db,
-                    trantor::EventLoop *loop);
+                    trantor::EventLoop *loop,
+                    std::string unixSocket = "");
 
     void setConnectCallback(
         const std::function<void(std::shared_ptr<RedisConnection> &&)>
@@ -96,27 +102,36 @@ class RedisConnection : public trantor::NonCopyable,
         return fullCommand;
     }
 
+    /**
+     * Commands sent from other threads are pipelined: the ones sent before
+     * the event loop of the connection wakes up are all written in a single
+     * write, their replies being matched in order.
+     */
     void sendFormattedCommand(std::string &&command,
                               RedisResultCallback &&resultCallback,
                               RedisExceptionCallback &&exceptionCallback)
     {
         if (loop_->isInLoopThread())
         {
+            // hiredis buffers the command until the socket is writable, so
+            // the commands of one loop iteration are already written
+            // together.
             sendCommandInLoop(command,
                               std::move(resultCallback),
                               std::move(exceptionCallback));
+            return;
         }
-        else
+        bool needWakeup;
         {
-            loop_->queueInLoop(
-                [this,
-                 callback = std::move(resultCallback),
-                 exceptionCallback = std::move(exceptionCallback),
-                 command = std::move(command)]() mutable {
-                    sendCommandInLoop(command,
-                                      std::move(callback),
-                                      std::move(exceptionCallback));
-                });
+            std::lock_guard<std::mutex> lock(pendingCommandsMutex_);
+            needWakeup = pendingCommands_.empty();
+            pendingCommands_.push_back({std::move(command),
+                                        std::move(resultCallback),
+                                        std::move(exceptionCallback)});
+        }
+        if (needWakeup)
+        {
+            loop_->queueInLoop([this]() { sendPendingCommands(); });
         }
     }
 
@@ -128,25 +143,9 @@ class RedisConnection : public trantor::NonCopyable,
         LOG_TRACE << "redis command: " << command;
         try
         {
-            auto fullCommand = getFormattedCommand(command, ap);
-            if (loop_->isInLoopThread())
-            {
-                sendCommandInLoop(fullCommand,
-                                  std::move(resultCallback),
-                                  std::move(exceptionCallback));
-            }
-            else
-            {
-                loop_->queueInLoop(
-                    [this,
-                     callback = std::move(resultCallback),
-                     exceptionCallback = std::move(exceptionCallback),
-                     fullCommand = std::move(fullCommand)]() mutable {
-                        sendCommandInLoop(fullCommand,
-                                          std::move(callback),
-                                          std::move(exceptionCallback));
-                    });
-            }
+            sendFormattedCommand(getFormattedCommand(command, ap),
+                                 std::move(resultCallback),
+                                 std::move(exceptionCallback));
         }
         catch (const RedisException &err)
         {
@@ -154,6 +153,13 @@ class RedisConnection : public trantor::NonCopyable,
         }
     }
 
+    /**
+     * @brief Switch the connection to RESP3 and enable CLIENT TRACKING, the
+     * replies of the GET commands sent after this call are stored in the
+     * cache, and removed from it when the server invalidates them.
+     */
+    void enableTracking(const std::shared_ptr<RedisNearCache> &cache);
+
     void sendSubscribe(const std::shared_ptr<SubscribeContext> &subCtx);
     void sendUnsubscribe(const std::shared_ptr<SubscribeContext> &subCtx);
 
@@ -186,8 +192,14 @@ class RedisConnection : public trantor::NonCopyable,
     }
 
   private:
+    std::string serverName() const
+    {
+        return unixSocket_.empty() ? serverAddr_.toIpPort() : unixSocket_;
+    }
+
     redisAsyncContext *redisContext_{nullptr};
     const trantor::InetAddress serverAddr_;
+    const std::string unixSocket_;
     const std::string username_;
     const std::string password_;
     const unsigned int db_;
@@ -201,6 +213,19 @@ class RedisConnection : public trantor::NonCopyable,
     std::queue<RedisExceptionCallback> exceptionCallbacks_;
     ConnectStatus status_{ConnectStatus::kNone};
 
+    struct PendingCommand
+    {
+        std::string command;
+        RedisResultCallback resultCallback;
+        RedisExceptionCallback exceptionCallback;
+    };
+    // The commands sent from other threads and not yet handed to hiredis.
+    std::mutex pendingCommandsMutex_;
+    std::vector<PendingCommand> pendingCommands_;
+
+    std::shared_ptr<RedisNearCache> nearCache_;
+    bool tracking_{false};
+
     // used to keep the lifetime of context object
     std::unordered_map<unsigned long long, std::shared_ptr<SubscribeContext>>
         subContexts_;
@@ -217,6 +242,9 @@ class RedisConnection : public trantor::NonCopyable,
     void sendCommandInLoop(const std::string &command,
                            RedisResultCallback &&resultCallback,
                            RedisExceptionCallback &&exceptionCallback);
+    void sendPendingCommands();
+    void enableTrackingInLoop(const std::shared_ptr<RedisNearCache> &cache);
+    void handlePush(redisReply *reply);
     void sendSubscribeInLoop(const std::shared_ptr<SubscribeContext> &subCtx);
     void sendUnsubscribeInLoop(const std::shared_ptr<SubscribeContext> &subCtx);
     void handleSubscribeResult(redisReply *result, SubscribeContext *subCtx);
@@ -0,0 +1,140 @@
+/**
+ *
+ *  @file RedisNearCache.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "RedisNearCache.h"
+#include <hiredis/hiredis.h>
+#include <cctype>
+#include <cstdlib>
+
+using namespace drogon::nosql;
+
+RedisNearCache::RedisNearCache(size_t maxEntries)
+    : maxEntriesPerShard_(maxEntries / kShardCount > 0
+                              ? maxEntries / kShardCount
+                              : 1)
+{
+}
+
+bool RedisNearCache::get(std::string_view key,
+                         const RedisResultCallback &callback)
+{
+    std::shared_ptr<const std::string> value;
+    {
+        auto &shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto iter = shard.entriesMap.find(key);
+        if (iter == shard.entriesMap.end())
+            return false;
+        shard.entries.splice(shard.entries.begin(),
+                             shard.entries,
+                             iter->second);
+        value = iter->second->value;
+    }
+    // A reply built on the stack, as RedisResult only wraps hiredis replies.
+    redisReply reply{};
+    if (value)
+    {
+        reply.type = REDIS_REPLY_STRING;
+        reply.str = const_cast<char *>(value->data());
+        reply.len = value->length();
+    }
+    else
+    {
+        reply.type = REDIS_REPLY_NIL;
+    }
+    callback(RedisResult(&reply));
+    return true;
+}
+
+void RedisNearCache::set(std::string_view key,
+                         std::shared_ptr<const std::string> value)
+{
+    auto &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.entriesMap.find(key);
+    if (iter != shard.entriesMap.end())
+    {
+        iter->second->value = std::move(value);
+        shard.entries.splice(shard.entries.begin(),
+                             shard.entries,
+                             iter->second);
+        return;
+    }
+    shard.entries.push_front(Entry{std::string(key), std::move(value)});
+    shard.entriesMap.emplace(shard.entries.front().key, shard.entries.begin());
+    while (shard.entries.size() > maxEntriesPerShard_)
+    {
+        shard.entriesMap.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+}
+
+void RedisNearCache::invalidate(std::string_view key)
+{
+    auto &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.entriesMap.find(key);
+    if (iter == shard.entriesMap.end())
+        return;
+    auto entry = iter->second;
+    shard.entriesMap.erase(iter);
+    shard.entries.erase(entry);
+}
+
+void RedisNearCache::clear()
+{
+    for (auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entriesMap.clear();
+        shard.entries.clear();
+    }
+}
+
+size_t RedisNearCache::size()
+{
+    size_t size = 0;
+    for (auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        size += shard.entries.size();
+    }
+    return size;
+}
+
+std::optional<std::string_view> RedisNearCache::cachedKey(
+    std::string_view command)
+{
+    // *2\r\n$3\r\nGET\r\n$<length>\r\n<key>\r\n
+    constexpr std::string_view prefix{"*2\r\n$3\r\n"};
+    if (command.size() < prefix.size() + 8 ||
+        command.substr(0, prefix.size()) != prefix)
+        return std::nullopt;
+    command.remove_prefix(prefix.size());
+    if (toupper(static_cast<unsigned char>(command[0])) != 'G' ||
+        toupper(static_cast<unsigned char>(command[1])) != 'E' ||
+        toupper(static_cast<unsigned char>(command[2])) != 'T' ||
+        command.substr(3, 3) != "\r\n$")
+        return std::nullopt;
+    command.remove_prefix(6);
+    auto end = command.find("\r\n");
+    if (end == std::string_view::npos)
+        return std::nullopt;
+    auto length =
+        strtoul(std::string(command.substr(0, end)).c_str(), nullptr, 10);
+    command.remove_prefix(end + 2);
+    if (command.size() != length + 2)
+        return std::nullopt;
+    return command.substr(0, length);
+}
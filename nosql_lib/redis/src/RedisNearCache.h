@@ -0,0 +1,89 @@
+/**
+ *
+ *  @file RedisNearCache.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/nosql/RedisResult.h>
+#include <trantor/utils/NonCopyable.h>
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace drogon
+{
+namespace nosql
+{
+/**
+ * @brief The values of the keys read by GET, kept in memory until the server
+ * invalidates them through the CLIENT TRACKING pushes of the connections.
+ *
+ * The entries are sharded by the hash of their key, each shard having its own
+ * lock and evicting its least recently used entries beyond its share of the
+ * size bound.
+ */
+class RedisNearCache : public trantor::NonCopyable
+{
+  public:
+    explicit RedisNearCache(size_t maxEntries);
+
+    /**
+     * @brief Call the callback with the cached reply of the key, returns
+     * false if the key isn't cached.
+     */
+    bool get(std::string_view key, const RedisResultCallback &callback);
+
+    /// Store a string reply, or a nil reply if value is nullptr.
+    void set(std::string_view key, std::shared_ptr<const std::string> value);
+
+    void invalidate(std::string_view key);
+    void clear();
+    size_t size();
+
+    /**
+     * @brief The key of a command formatted in the RESP protocol if it is a
+     * GET command, whose reply can be cached.
+     */
+    static std::optional<std::string_view> cachedKey(std::string_view command);
+
+  private:
+    static constexpr size_t kShardCount = 16;
+    struct Entry
+    {
+        std::string key;
+        std::shared_ptr<const std::string> value;
+    };
+    using EntryList = std::list<Entry>;
+    struct Shard
+    {
+        std::mutex mutex;
+        // The most recently used entries first.
+        EntryList entries;
+        std::unordered_map<std::string_view, EntryList::iterator> entriesMap;
+    };
+
+    Shard &shardOf(std::string_view key)
+    {
+        return shards_[std::hash<std::string_view>{}(key) % kShardCount];
+    }
+
+    const size_t maxEntriesPerShard_;
+    std::array<Shard, kShardCount> shards_;
+};
+}  // namespace nosql
+}  // namespace drogon
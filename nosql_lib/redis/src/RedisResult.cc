@@ -15,9 +15,58 @@
 #include <drogon/nosql/RedisResult.h>
 #include <drogon/nosql/RedisClient.h>
 #include <hiredis/hiredis.h>
+#include <string.h>
 
 using namespace drogon::nosql;
 
+namespace
+{
+// The replies copied by retain() when they can't be shared, they are
+// allocated by us and not by hiredis.
+redisReply *copyReply(const redisReply *reply)
+{
+    auto copy = new redisReply(*reply);
+    if (reply->str)
+    {
+        copy->str = new char[reply->len + 1];
+        memcpy(copy->str, reply->str, reply->len);
+        copy->str[reply->len] = '\0';
+    }
+    if (reply->element)
+    {
+        copy->element = new redisReply *[reply->elements];
+        for (size_t i = 0; i < reply->elements; ++i)
+            copy->element[i] = copyReply(reply->element[i]);
+    }
+    return copy;
+}
+
+void deleteReply(redisReply *reply)
+{
+    delete[] reply->str;
+    if (reply->element)
+    {
+        for (size_t i = 0; i < reply->elements; ++i)
+            deleteReply(reply->element[i]);
+        delete[] reply->element;
+    }
+    delete reply;
+}
+
+// The connection doesn't free the reply once it is shared, it is freed with
+// the last owner.
+const std::shared_ptr<const void> &sharedReply(
+    drogon::nosql::internal::RedisReplyOwner *owner)
+{
+    if (!owner->shared)
+    {
+        owner->shared = std::shared_ptr<const void>(
+            owner->reply, [](redisReply *reply) { freeReplyObject(reply); });
+    }
+    return owner->shared;
+}
+}  // namespace
+
 std::string RedisResult::getStringForDisplaying() const noexcept
 {
     return getStringForDisplayingWithIndent(0);
@@ -26,7 +75,28 @@ std::string RedisResult::getStringForDisplaying() const noexcept
 std::string RedisResult::getStringForDisplayingWithIndent(
     size_t indent) const noexcept
 {
-    switch (result_->type)
+    int replyType = result_->type;
+#ifdef REDIS_REPLY_MAP
+    switch (replyType)
+    {
+        case REDIS_REPLY_MAP:
+        case REDIS_REPLY_SET:
+        case REDIS_REPLY_PUSH:
+            replyType = REDIS_REPLY_ARRAY;
+            break;
+        case REDIS_REPLY_DOUBLE:
+        case REDIS_REPLY_BIGNUM:
+        case REDIS_REPLY_VERB:
+            replyType = REDIS_REPLY_STRING;
+            break;
+        case REDIS_REPLY_BOOL:
+            replyType = REDIS_REPLY_INTEGER;
+            break;
+        default:
+            break;
+    }
+#endif
+    switch (replyType)
     {
         case REDIS_REPLY_STRING:
             return "\"" + std::string{result_->str, result_->len} + "\"";
@@ -81,6 +151,48 @@ std::string RedisResult::asString() const noexcept(false)
     }
 }
 
+std::string_view RedisResult::asStringView() const noexcept(false)
+{
+    auto rtype = type();
+    if (rtype == RedisResultType::kString ||
+        rtype == RedisResultType::kStatus || rtype == RedisResultType::kError)
+    {
+        return std::string_view(result_->str, result_->len);
+    }
+    throw RedisException(RedisErrorCode::kBadType, "bad type");
+}
+
+std::pair<std::shared_ptr<const void>, std::string_view>
+RedisResult::shareString() const noexcept(false)
+{
+    auto view = asStringView();
+    if (keeper_)
+        return {keeper_, view};
+    if (!owner_)
+    {
+        auto str = std::make_shared<const std::string>(view);
+        return {str, *str};
+    }
+    return {sharedReply(owner_), view};
+}
+
+RedisResult RedisResult::retain() const
+{
+    if (keeper_)
+        return *this;
+    RedisResult result(result_);
+    if (owner_)
+    {
+        // An element keeps the whole reply alive.
+        result.keeper_ = sharedReply(owner_);
+        return result;
+    }
+    auto copy = copyReply(result_);
+    result.result_ = copy;
+    result.keeper_ = std::shared_ptr<const void>(copy, deleteReply);
+    return result;
+}
+
 RedisResultType RedisResult::type() const noexcept
 {
     switch (result_->type)
@@ -95,6 +207,19 @@ RedisResultType RedisResult::type() const noexcept
             return RedisResultType::kNil;
         case REDIS_REPLY_STATUS:
             return RedisResultType::kStatus;
+#ifdef REDIS_REPLY_MAP
+        // The RESP3 types, used by the connections with client side caching.
+        case REDIS_REPLY_MAP:
+        case REDIS_REPLY_SET:
+        case REDIS_REPLY_PUSH:
+            return RedisResultType::kArray;
+        case REDIS_REPLY_DOUBLE:
+        case REDIS_REPLY_BIGNUM:
+        case REDIS_REPLY_VERB:
+            return RedisResultType::kString;
+        case REDIS_REPLY_BOOL:
+            return RedisResultType::kInteger;
+#endif
         case REDIS_REPLY_ERROR:
         default:
             return RedisResultType::kError;
@@ -109,7 +234,8 @@ std::vector<RedisResult> RedisResult::asArray() const noexcept(false)
         std::vector<RedisResult> array;
         for (size_t i = 0; i < result_->elements; ++i)
         {
-            array.emplace_back(result_->element[i]);
+            array.emplace_back(result_->element[i], owner_);
+            array.back().keeper_ = keeper_;
         }
         return array;
     }
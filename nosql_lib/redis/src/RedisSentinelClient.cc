@@ -0,0 +1,635 @@
+/**
+ *
+ *  @file RedisSentinelClient.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "RedisSentinelClient.h"
+#include "RedisBatchCollector.h"
+#include "RedisClientImpl.h"
+#include "RedisClusterClient.h"
+#include "RedisConnection.h"
+#include <drogon/RequestTrace.h>
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdarg>
+#include <cstdlib>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace drogon::nosql;
+
+// The timeout of the commands sent to the sentinels, after which the next
+// sentinel is tried.
+static constexpr double kSentinelTimeout = 3.0;
+// One read out of kProbeInterval goes to the next replica regardless of its
+// latency, to keep the latencies of all the replicas up to date.
+static constexpr size_t kProbeInterval = 16;
+
+std::shared_ptr<RedisClient> RedisClient::newRedisSentinelClient(
+    const std::vector<trantor::InetAddress> &sentinelAddresses,
+    const std::string &masterName,
+    size_t numberOfConnections,
+    bool readFromReplicas,
+    const std::string &password,
+    unsigned int db,
+    const std::string &username)
+{
+    auto client = std::make_shared<RedisSentinelClient>(sentinelAddresses,
+                                                        masterName,
+                                                        numberOfConnections,
+                                                        readFromReplicas,
+                                                        username,
+                                                        password,
+                                                        db);
+    client->init();
+    return client;
+}
+
+RedisSentinelClient::RedisSentinelClient(
+    std::vector<trantor::InetAddress> sentinelAddresses,
+    std::string masterName,
+    size_t numberOfConnections,
+    bool readFromReplicas,
+    std::string username,
+    std::string password,
+    unsigned int db)
+    : sentinelAddresses_(std::move(sentinelAddresses)),
+      masterName_(std::move(masterName)),
+      numberOfConnections_(numberOfConnections),
+      readFromReplicas_(readFromReplicas),
+      username_(std::move(username)),
+      password_(std::move(password)),
+      db_(db)
+{
+    assert(!sentinelAddresses_.empty());
+}
+
+RedisSentinelClient::~RedisSentinelClient()
+{
+    closeAll();
+}
+
+void RedisSentinelClient::init()
+{
+    switchSentinel();
+    queryPrimary();
+}
+
+bool RedisSentinelClient::isReadOnlyCommand(std::string_view name)
+{
+    static const std::unordered_set<std::string_view> readOnlyCommands{
+        "bitcount", "bitpos", "exists", "geodist", "geohash", "geopos", "get",
+        "getbit", "getrange", "hexists", "hget", "hgetall", "hkeys", "hlen",
+        "hmget", "hrandfield", "hscan", "hstrlen", "hvals", "lindex", "llen",
+        "lpos", "lrange", "mget", "pfcount", "pttl", "scard", "sismember",
+        "smembers", "smismember", "srandmember", "sscan", "strlen", "ttl",
+        "type", "xlen", "xrange", "xrevrange", "zcard", "zcount", "zmscore",
+        "zrange", "zrangebyscore", "zrank", "zrevrange", "zrevrangebyscore",
+        "zrevrank", "zscan", "zscore"};
+    std::string lowerName{name};
+    std::transform(lowerName.begin(),
+                   lowerName.end(),
+                   lowerName.begin(),
+                   [](unsigned char c) { return tolower(c); });
+    return readOnlyCommands.count(lowerName) > 0;
+}
+
+void RedisSentinelClient::execCommandAsync(
+    RedisResultCallback &&resultCallback,
+    RedisExceptionCallback &&exceptionCallback,
+    std::string_view command,
+    ...) noexcept
+{
+    if (auto &trace = drogon::RequestTrace::current())
+    {
+        // The format of the command is recorded without the arguments.
+        auto span = trace->startSpan("redis.command");
+        span.attributes.emplace_back("db.system", "redis");
+        span.attributes.emplace_back("db.statement", std::string(command));
+        trace->traceCallbacks(std::move(span),
+                              resultCallback,
+                              exceptionCallback);
+    }
+    std::string formattedCmd;
+    va_list args;
+    va_start(args, command);
+    try
+    {
+        formattedCmd = RedisConnection::getFormattedCommand(command, args);
+    }
+    catch (const RedisException &err)
+    {
+        va_end(args);
+        exceptionCallback(err);
+        return;
+    }
+    va_end(args);
+    if (readFromReplicas_)
+    {
+        auto arguments = RedisClusterClient::commandArguments(formattedCmd);
+        Replica replica;
+        if (!arguments.empty() && isReadOnlyCommand(arguments[0]) &&
+            pickReplica(replica))
+        {
+            sendToReplica(replica,
+                          std::move(formattedCmd),
+                          std::move(resultCallback),
+                          std::move(exceptionCallback));
+            return;
+        }
+    }
+    sendToPrimary(std::move(formattedCmd),
+                  std::move(resultCallback),
+                  std::move(exceptionCallback));
+}
+
+void RedisSentinelClient::execBatchAsync(
+    RedisBatch &&batch,
+    RedisBatchCallback &&resultCallback,
+    RedisExceptionCallback &&exceptionCallback)
+{
+    if (batch.empty())
+    {
+        resultCallback({});
+        return;
+    }
+    std::shared_ptr<RedisClientImpl> primary;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        primary = primary_;
+    }
+    if (primary)
+    {
+        primary->execBatchAsync(std::move(batch),
+                                std::move(resultCallback),
+                                std::move(exceptionCallback));
+        return;
+    }
+    // Queued with the other commands until the primary is known.
+    auto collector =
+        std::make_shared<RedisBatchCollector>(batch.size(),
+                                              std::move(resultCallback),
+                                              std::move(exceptionCallback));
+    auto commands = batch.releaseCommands();
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        sendToPrimary(std::move(commands[i]),
+                      collector->resultCallback(i),
+                      collector->exceptionCallback());
+    }
+}
+
+void RedisSentinelClient::sendToPrimary(
+    std::string &&command,
+    RedisResultCallback &&resultCallback,
+    RedisExceptionCallback &&exceptionCallback)
+{
+    std::shared_ptr<RedisClientImpl> primary;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!primary_)
+        {
+            pendingCommands_.push_back({std::move(command),
+                                        std::move(resultCallback),
+                                        std::move(exceptionCallback)});
+            return;
+        }
+        primary = primary_;
+    }
+    std::weak_ptr<RedisSentinelClient> weakThis = shared_from_this();
+    primary->execFormattedCommandAsync(
+        std::move(command),
+        std::move(resultCallback),
+        [weakThis, exceptionCallback = std::move(exceptionCallback)](
+            const RedisException &err) {
+            // A demoted primary replies READONLY to the writes.
+            std::string_view message{err.what()};
+            if (err.code() == RedisErrorCode::kConnectionBroken ||
+                (err.code() == RedisErrorCode::kRedisError &&
+                 message.substr(0, 9) == "READONLY "))
+            {
+                if (auto thisPtr = weakThis.lock())
+                    thisPtr->queryPrimary();
+            }
+            exceptionCallback(err);
+        });
+}
+
+void RedisSentinelClient::sendToReplica(
+    const Replica &replica,
+    std::string &&command,
+    RedisResultCallback &&resultCallback,
+    RedisExceptionCallback &&exceptionCallback)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto latency = replica.latency;
+    std::weak_ptr<RedisSentinelClient> weakThis = shared_from_this();
+    replica.client->execFormattedCommandAsync(
+        std::move(command),
+        [start, latency, resultCallback = std::move(resultCallback)](
+            const RedisResult &result) {
+            int64_t sample =
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+            // An exponentially weighted moving average of the samples.
+            auto average = latency->load(std::memory_order_relaxed);
+            if (average == 0 || average == INT64_MAX)
+                average = sample;
+            latency->store((average * 7 + sample) / 8,
+                           std::memory_order_relaxed);
+            resultCallback(result);
+        },
+        [weakThis, latency, exceptionCallback = std::move(exceptionCallback)](
+            const RedisException &err) {
+            if (err.code() == RedisErrorCode::kConnectionBroken ||
+                err.code() == RedisErrorCode::kTimeout)
+            {
+                // Avoided until the list of the replicas is refreshed.
+                latency->store(INT64_MAX, std::memory_order_relaxed);
+                if (auto thisPtr = weakThis.lock())
+                    thisPtr->queryReplicas();
+            }
+            exceptionCallback(err);
+        });
+}
+
+bool RedisSentinelClient::pickReplica(Replica &replica)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (replicas_.empty())
+        return false;
+    auto count = readCount_.fetch_add(1, std::memory_order_relaxed);
+    if (count % kProbeInterval == 0)
+    {
+        auto &next = replicas_[(count / kProbeInterval) % replicas_.size()];
+        if (next.latency->load() != INT64_MAX)
+        {
+            replica = next;
+            return true;
+        }
+    }
+    auto best = std::min_element(replicas_.begin(),
+                                 replicas_.end(),
+                                 [](const Replica &a, const Replica &b) {
+                                     return a.latency->load() <
+                                            b.latency->load();
+                                 });
+    if (best->latency->load() == INT64_MAX)
+        return false;
+    replica = *best;
+    return true;
+}
+
+void RedisSentinelClient::switchSentinel()
+{
+    std::shared_ptr<RedisClientImpl> oldSentinel;
+    std::shared_ptr<RedisSubscriber> oldSubscriber;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        oldSentinel = std::move(sentinel_);
+        oldSubscriber = std::move(subscriber_);
+        auto &address =
+            sentinelAddresses_[nextSentinel_++ % sentinelAddresses_.size()];
+        // The sentinels are expected to accept the connections without
+        // authentication.
+        sentinel_ = std::make_shared<RedisClientImpl>(address, 1);
+        sentinel_->setTimeout(kSentinelTimeout);
+        sentinel_->init();
+    }
+    oldSubscriber.reset();
+    if (oldSentinel)
+        oldSentinel->closeAll();
+    subscribeSwitches();
+}
+
+void RedisSentinelClient::subscribeSwitches()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscriber_ = sentinel_->newSubscriber();
+    std::weak_ptr<RedisSentinelClient> weakThis = shared_from_this();
+    subscriber_->subscribe(
+        "+switch-master",
+        [weakThis](const std::string & /*channel*/,
+                   const std::string &message) {
+            // <master name> <old ip> <old port> <new ip> <new port>
+            auto thisPtr = weakThis.lock();
+            if (!thisPtr)
+                return;
+            auto fields = drogon::utils::splitString(message, " ");
+            if (fields.size() != 5 || fields[0] != thisPtr->masterName_)
+                return;
+            thisPtr->setPrimary(fields[3],
+                                static_cast<uint16_t>(atoi(fields[4].c_str())));
+        });
+}
+
+void RedisSentinelClient::queryPrimary()
+{
+    if (resolving_.exchange(true))
+        return;
+    std::shared_ptr<RedisClientImpl> sentinel;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sentinel = sentinel_;
+    }
+    if (!sentinel)
+    {
+        resolving_ = false;
+        return;
+    }
+    std::weak_ptr<RedisSentinelClient> weakThis = shared_from_this();
+    sentinel->execCommandAsync(
+        [weakThis](const RedisResult &result) {
+            auto thisPtr = weakThis.lock();
+            if (!thisPtr)
+                return;
+            thisPtr->resolving_ = false;
+            std::string ip;
+            uint16_t port = 0;
+            try
+            {
+                auto address = result.asArray();
+                if (address.size() == 2)
+                {
+                    ip = address[0].asString();
+                    port = static_cast<uint16_t>(
+                        atoi(address[1].asString().c_str()));
+                }
+            }
+            catch (const RedisException &)
+            {
+            }
+            if (ip.empty())
+            {
+                LOG_ERROR << "The sentinels don't know the master "
+                          << thisPtr->masterName_;
+                thisPtr->failPendingCommands(
+                    RedisException(RedisErrorCode::kNoConnectionAvailable,
+                                   "Unknown master " + thisPtr->masterName_));
+                return;
+            }
+            thisPtr->setPrimary(ip, port);
+        },
+        [weakThis](const RedisException &err) {
+            auto thisPtr = weakThis.lock();
+            if (!thisPtr)
+                return;
+            LOG_ERROR << "Failed to query the sentinel: " << err.what();
+            thisPtr->resolving_ = false;
+            if (err.code() != RedisErrorCode::kTimeout &&
+                err.code() != RedisErrorCode::kConnectionBroken)
+            {
+                thisPtr->failPendingCommands(err);
+                return;
+            }
+            // Try the next sentinel.
+            thisPtr->switchSentinel();
+            thisPtr->queryPrimary();
+        },
+        "SENTINEL get-master-addr-by-name %s",
+        masterName_.c_str());
+}
+
+void RedisSentinelClient::queryReplicas()
+{
+    std::shared_ptr<RedisClientImpl> sentinel;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sentinel = sentinel_;
+    }
+    if (!sentinel)
+        return;
+    std::weak_ptr<RedisSentinelClient> weakThis = shared_from_this();
+    sentinel->execCommandAsync(
+        [weakThis](const RedisResult &result) {
+            auto thisPtr = weakThis.lock();
+            if (!thisPtr)
+                return;
+            // Each replica is a flat list of names and values.
+            std::vector<std::pair<std::string, uint16_t>> addresses;
+            try
+            {
+                for (auto &replica : result.asArray())
+                {
+                    std::unordered_map<std::string, std::string> fields;
+                    auto values = replica.asArray();
+                    for (size_t i = 0; i + 1 < values.size(); i += 2)
+                        fields[values[i].asString()] =
+                            values[i + 1].asString();
+                    auto &flags = fields["flags"];
+                    if (flags.find("s_down") != std::string::npos ||
+                        flags.find("o_down") != std::string::npos ||
+                        flags.find("disconnected") != std::string::npos ||
+                        fields["master-link-status"] != "ok")
+                        continue;
+                    addresses.emplace_back(
+                        fields["ip"],
+                        static_cast<uint16_t>(atoi(fields["port"].c_str())));
+                }
+            }
+            catch (const RedisException &err)
+            {
+                LOG_ERROR << "Bad reply of SENTINEL REPLICAS: " << err.what();
+                return;
+            }
+            std::vector<Replica> replicas;
+            std::vector<std::shared_ptr<RedisClientImpl>> removed;
+            {
+                std::lock_guard<std::mutex> lock(thisPtr->mutex_);
+                for (auto &[ip, port] : addresses)
+                {
+                    auto address = ip + ":" + std::to_string(port);
+                    auto iter =
+                        std::find_if(thisPtr->replicas_.begin(),
+                                     thisPtr->replicas_.end(),
+                                     [&address](const Replica &replica) {
+                                         return replica.address == address;
+                                     });
+                    if (iter != thisPtr->replicas_.end())
+                    {
+                        replicas.push_back(*iter);
+                        // Tried again after a failure.
+                        if (iter->latency->load() == INT64_MAX)
+                            iter->latency->store(0);
+                        continue;
+                    }
+                    replicas.push_back(
+                        {address,
+                         thisPtr->newNode(ip, port),
+                         std::make_shared<std::atomic<int64_t>>(0)});
+                }
+                for (auto &replica : thisPtr->replicas_)
+                {
+                    if (std::none_of(replicas.begin(),
+                                     replicas.end(),
+                                     [&replica](const Replica &r) {
+                                         return r.address == replica.address;
+                                     }))
+                        removed.push_back(replica.client);
+                }
+                thisPtr->replicas_ = std::move(replicas);
+            }
+            for (auto &client : removed)
+                client->closeAll();
+        },
+        [](const RedisException &err) {
+            LOG_ERROR << "Failed to get the replicas from the sentinel: "
+                      << err.what();
+        },
+        "SENTINEL replicas %s",
+        masterName_.c_str());
+}
+
+void RedisSentinelClient::setPrimary(const std::string &ip, uint16_t port)
+{
+    auto address = ip + ":" + std::to_string(port);
+    std::shared_ptr<RedisClientImpl> oldPrimary;
+    std::vector<PendingCommand> pendingCommands;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (address != primaryAddress_ || !primary_)
+        {
+            oldPrimary = std::move(primary_);
+            primary_ = newNode(ip, port);
+            primaryAddress_ = address;
+        }
+        pendingCommands.swap(pendingCommands_);
+    }
+    if (oldPrimary)
+    {
+        LOG_INFO << "The primary of " << masterName_ << " is now " << address;
+        oldPrimary->closeAll();
+    }
+    for (auto &cmd : pendingCommands)
+    {
+        sendToPrimary(std::move(cmd.command),
+                      std::move(cmd.resultCallback),
+                      std::move(cmd.exceptionCallback));
+    }
+    if (readFromReplicas_)
+        queryReplicas();
+}
+
+void RedisSentinelClient::failPendingCommands(const RedisException &err)
+{
+    std::vector<PendingCommand> pendingCommands;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pendingCommands.swap(pendingCommands_);
+    }
+    for (auto &cmd : pendingCommands)
+        cmd.exceptionCallback(err);
+}
+
+std::shared_ptr<RedisClientImpl> RedisSentinelClient::newNode(
+    const std::string &ip,
+    uint16_t port)
+{
+    auto node = std::make_shared<RedisClientImpl>(
+        trantor::InetAddress(ip, port, ip.find(':') != std::string::npos),
+        numberOfConnections_,
+        username_,
+        password_,
+        db_);
+    if (timeout_ > 0.0)
+        node->setTimeout(timeout_);
+    node->init();
+    return node;
+}
+
+std::shared_ptr<RedisSubscriber> RedisSentinelClient::newSubscriber() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!primary_)
+    {
+        LOG_ERROR << "The primary of " << masterName_ << " is not known yet";
+        return nullptr;
+    }
+    return primary_->newSubscriber();
+}
+
+RedisTransactionPtr RedisSentinelClient::newTransaction() noexcept(false)
+{
+    std::shared_ptr<RedisClientImpl> primary;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        primary = primary_;
+    }
+    if (!primary)
+    {
+        throw RedisException(RedisErrorCode::kNoConnectionAvailable,
+                             "The primary is not known yet");
+    }
+    return primary->newTransaction();
+}
+
+void RedisSentinelClient::newTransactionAsync(
+    const std::function<void(const RedisTransactionPtr &)> &callback)
+{
+    std::shared_ptr<RedisClientImpl> primary;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        primary = primary_;
+    }
+    if (!primary)
+    {
+        callback(nullptr);
+        return;
+    }
+    primary->newTransactionAsync(callback);
+}
+
+void RedisSentinelClient::setTimeout(double timeout)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeout_ = timeout;
+    if (primary_)
+        primary_->setTimeout(timeout);
+    for (auto &replica : replicas_)
+        replica.client->setTimeout(timeout);
+}
+
+void RedisSentinelClient::closeAll()
+{
+    std::shared_ptr<RedisSubscriber> subscriber;
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscriber = std::move(subscriber_);
+    if (sentinel_)
+        sentinel_->closeAll();
+    if (primary_)
+        primary_->closeAll();
+    for (auto &replica : replicas_)
+        replica.client->closeAll();
+    replicas_.clear();
+}
+
+RedisClient::ConnectionStats RedisSentinelClient::connectionStats() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ConnectionStats stats;
+    auto add = [&stats](const std::shared_ptr<RedisClientImpl> &client) {
+        auto clientStats = client->connectionStats();
+        stats.connected += clientStats.connected;
+        stats.total += clientStats.total;
+        stats.pending += clientStats.pending;
+    };
+    if (primary_)
+        add(primary_);
+    for (auto &replica : replicas_)
+        add(replica.client);
+    stats.pending += pendingCommands_.size();
+    return stats;
+}
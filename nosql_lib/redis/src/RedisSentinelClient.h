@@ -0,0 +1,127 @@
+/**
+ *
+ *  @file RedisSentinelClient.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+
+#include <drogon/nosql/RedisClient.h>
+#include <trantor/utils/NonCopyable.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace drogon
+{
+namespace nosql
+{
+class RedisClientImpl;
+
+/**
+ * @brief A client of the primary of a group monitored by Redis Sentinel,
+ * following its failovers, which optionally sends the read-only commands to
+ * the replica with the lowest latency.
+ */
+class RedisSentinelClient final
+    : public RedisClient,
+      public trantor::NonCopyable,
+      public std::enable_shared_from_this<RedisSentinelClient>
+{
+  public:
+    RedisSentinelClient(std::vector<trantor::InetAddress> sentinelAddresses,
+                        std::string masterName,
+                        size_t numberOfConnections,
+                        bool readFromReplicas,
+                        std::string username,
+                        std::string password,
+                        unsigned int db);
+    ~RedisSentinelClient() override;
+
+    void execCommandAsync(RedisResultCallback &&resultCallback,
+                          RedisExceptionCallback &&exceptionCallback,
+                          std::string_view command,
+                          ...) noexcept override;
+    void execBatchAsync(RedisBatch &&batch,
+                        RedisBatchCallback &&resultCallback,
+                        RedisExceptionCallback &&exceptionCallback) override;
+    std::shared_ptr<RedisSubscriber> newSubscriber() noexcept override;
+    RedisTransactionPtr newTransaction() noexcept(false) override;
+    void newTransactionAsync(
+        const std::function<void(const RedisTransactionPtr &)> &callback)
+        override;
+    void setTimeout(double timeout) override;
+    void closeAll() override;
+    ConnectionStats connectionStats() noexcept override;
+
+    void init();
+
+    // True for the commands which can be sent to a replica.
+    static bool isReadOnlyCommand(std::string_view name);
+
+  private:
+    struct Replica
+    {
+        std::string address;
+        std::shared_ptr<RedisClientImpl> client;
+        // The smoothed latency of the commands in microseconds.
+        std::shared_ptr<std::atomic<int64_t>> latency;
+    };
+
+    void sendToPrimary(std::string &&command,
+                       RedisResultCallback &&resultCallback,
+                       RedisExceptionCallback &&exceptionCallback);
+    void sendToReplica(const Replica &replica,
+                       std::string &&command,
+                       RedisResultCallback &&resultCallback,
+                       RedisExceptionCallback &&exceptionCallback);
+    // Pick the replica with the lowest latency, returns false if none.
+    bool pickReplica(Replica &replica);
+    void switchSentinel();
+    void subscribeSwitches();
+    void queryPrimary();
+    void queryReplicas();
+    void setPrimary(const std::string &ip, uint16_t port);
+    void failPendingCommands(const RedisException &err);
+    std::shared_ptr<RedisClientImpl> newNode(const std::string &ip,
+                                             uint16_t port);
+
+    const std::vector<trantor::InetAddress> sentinelAddresses_;
+    const std::string masterName_;
+    const size_t numberOfConnections_;
+    const bool readFromReplicas_;
+    const std::string username_;
+    const std::string password_;
+    const unsigned int db_;
+    std::mutex mutex_;
+    double timeout_{-1.0};
+    size_t nextSentinel_{0};
+    std::shared_ptr<RedisClientImpl> sentinel_;
+    std::shared_ptr<RedisSubscriber> subscriber_;
+    std::string primaryAddress_;
+    std::shared_ptr<RedisClientImpl> primary_;
+    std::vector<Replica> replicas_;
+    struct PendingCommand
+    {
+        std::string command;
+        RedisResultCallback resultCallback;
+        RedisExceptionCallback exceptionCallback;
+    };
+    // The commands sent before the primary is known.
+    std::vector<PendingCommand> pendingCommands_;
+    std::atomic<bool> resolving_{false};
+    std::atomic<size_t> readCount_{0};
+};
+}  // namespace nosql
+}  // namespace drogon
@@ -1,5 +1,6 @@
 #define DROGON_TEST_MAIN
 #include <drogon/nosql/RedisClient.h>
+#include <drogon/nosql/RedisPubSubService.h>
 #include <drogon/drogon_test.h>
 #include <drogon/drogon.h>
 #include <iostream>
@@ -95,6 +96,40 @@ DROGON_TEST(RedisSubscriberTest)
     MANDATE(nPmsgRecv == 11);
 }
 
+DROGON_TEST(RedisPubSubServiceTest)
+{
+    auto client = drogon::nosql::RedisClient::newRedisClient(
+        trantor::InetAddress("127.0.0.1", 6379), 1);
+    REQUIRE(client != nullptr);
+    drogon::nosql::RedisPubSubService service(client, "pubsub_test:");
+    std::atomic_int nRecv{0};
+    auto handler = [&nRecv](const std::string &topic,
+                            const std::string &message) {
+        if (topic == "topic1" && message == "hello")
+            ++nRecv;
+    };
+    auto id1 = service.subscribe("topic1", handler);
+    auto id2 = service.subscribe("topic1", handler);
+    std::this_thread::sleep_for(1s);
+    CHECK(service.size() == 1UL);
+
+    // One redis message is dispatched to both local subscribers
+    service.publish("topic1", "hello");
+    std::this_thread::sleep_for(1s);
+    MANDATE(nRecv == 2);
+
+    service.unsubscribe("topic1", id1);
+    service.publish("topic1", "hello");
+    std::this_thread::sleep_for(1s);
+    MANDATE(nRecv == 3);
+
+    service.unsubscribe("topic1", id2);
+    CHECK(service.isTopicEmpty("topic1"));
+    service.publish("topic1", "hello");
+    std::this_thread::sleep_for(1s);
+    MANDATE(nRecv == 3);
+}
+
 int main(int argc, char **argv)
 {
 #ifndef USE_REDIS
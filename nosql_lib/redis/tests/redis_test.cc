@@ -1,15 +1,74 @@
 #define DROGON_TEST_MAIN
+#include "../src/RedisClusterClient.h"
+#include "../src/RedisNearCache.h"
+#include "../src/RedisSentinelClient.h"
 #include <drogon/nosql/RedisClient.h>
+#include <drogon/RedisRateLimiter.h>
 #include <drogon/drogon_test.h>
 #include <drogon/drogon.h>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 using namespace std::chrono_literals;
 using namespace drogon::nosql;
 
 RedisClientPtr redisClient;
 
+DROGON_TEST(RedisClusterSlotTest)
+{
+    CHECK(RedisClusterClient::keySlot("123456789") == 12739);
+    CHECK(RedisClusterClient::keySlot("foo") == 12182);
+    CHECK(RedisClusterClient::keySlot("{user1000}.following") ==
+          RedisClusterClient::keySlot("user1000"));
+
+    std::string command = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$1\r\n1\r\n";
+    auto arguments = RedisClusterClient::commandArguments(command);
+    REQUIRE(arguments.size() == 3);
+    CHECK(arguments[2] == "1");
+    CHECK(RedisClusterClient::commandKey(arguments).value_or("") == "key");
+    CHECK(!RedisClusterClient::commandKey({"PING"}));
+    CHECK(!RedisClusterClient::commandKey({"EVAL", "return 1", "0"}));
+    CHECK(RedisClusterClient::commandKey({"XREAD", "STREAMS", "s", "0"})
+              .value_or("") == "s");
+}
+
+DROGON_TEST(RedisNearCacheTest)
+{
+    CHECK(RedisNearCache::cachedKey("*2\r\n$3\r\nget\r\n$3\r\nfoo\r\n")
+              .value_or("") == "foo");
+    CHECK(!RedisNearCache::cachedKey(
+        "*3\r\n$3\r\nSET\r\n$3\r\nfoo\r\n$1\r\n1\r\n"));
+
+    RedisNearCache cache(32);
+    std::string value;
+    auto callback = [&value](const RedisResult &result) {
+        value = result.isNil() ? "(nil)" : result.asString();
+    };
+    CHECK(!cache.get("foo", callback));
+    cache.set("foo", std::make_shared<const std::string>("bar"));
+    cache.set("missing", nullptr);
+    CHECK(cache.get("foo", callback));
+    CHECK(value == "bar");
+    CHECK(cache.get("missing", callback));
+    CHECK(value == "(nil)");
+    cache.invalidate("foo");
+    CHECK(!cache.get("foo", callback));
+    for (int i = 0; i < 1000; ++i)
+        cache.set(std::to_string(i), nullptr);
+    CHECK(cache.size() <= 32);
+}
+
+DROGON_TEST(RedisSentinelRoutingTest)
+{
+    CHECK(RedisSentinelClient::isReadOnlyCommand("GET"));
+    CHECK(RedisSentinelClient::isReadOnlyCommand("hgetall"));
+    CHECK(!RedisSentinelClient::isReadOnlyCommand("SET"));
+    CHECK(!RedisSentinelClient::isReadOnlyCommand("eval"));
+}
+
 DROGON_TEST(RedisTest)
 {
     redisClient = drogon::nosql::RedisClient::newRedisClient(
@@ -47,6 +106,10 @@ DROGON_TEST(RedisTest)
     redisClient->execCommandAsync(
         [TEST_CTX](const drogon::nosql::RedisResult &r) {
             MANDATE(r.asString() == "hello");
+            MANDATE(r.asStringView() == "hello");
+            auto [owner, value] = r.shareString();
+            MANDATE(owner != nullptr);
+            MANDATE(value == "hello");
         },
         [TEST_CTX](const RedisException &err) { MANDATE(err.what()); },
         "echo %s",
@@ -78,6 +141,23 @@ DROGON_TEST(RedisTest)
         {
             FAULT(err.what());
         }
+        // 8.1 batch
+        try
+        {
+            RedisBatch batch;
+            batch.add("set %s %s", "batch_key", "batch_value")
+                .add("get %s", "batch_key")
+                .add("get %s", "haha");
+            auto results =
+                co_await redisClient->execBatchCoro(std::move(batch));
+            MANDATE(results.size() == 3UL);
+            MANDATE(results[1].asString() == "batch_value");
+            MANDATE(results[2].isNil());
+        }
+        catch (const RedisException &err)
+        {
+            FAULT(err.what());
+        }
     };
     drogon::sync_wait(coro_test());
 #endif
@@ -183,6 +263,220 @@ DROGON_TEST(RedisTest)
     }
 }
 
+namespace
+{
+// The replies of the commands, in the order of their callbacks.
+class ReplyRecorder
+{
+  public:
+    struct Reply
+    {
+        int index;
+        // -1 for an error
+        long long value;
+        RedisErrorCode error;
+    };
+
+    template <typename... Arguments>
+    void send(const RedisClientPtr &client,
+              int index,
+              std::string_view command,
+              Arguments... arguments)
+    {
+        client->execCommandAsync(
+            [this, index](const RedisResult &result) {
+                add({index, result.asInteger(), RedisErrorCode::kNone});
+            },
+            [this, index](const RedisException &err) {
+                add({index, -1, err.code()});
+            },
+            command,
+            arguments...);
+    }
+
+    std::vector<Reply> wait(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait_for(lock, 15s, [this, count]() {
+            return replies_.size() >= count;
+        });
+        auto replies = std::move(replies_);
+        replies_.clear();
+        return replies;
+    }
+
+  private:
+    void add(Reply &&reply)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        replies_.push_back(std::move(reply));
+        cond_.notify_all();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<Reply> replies_;
+};
+}  // namespace
+
+DROGON_TEST(RedisPipelineTest)
+{
+    // One connection, the commands sent from this thread are pipelined on it.
+    auto client = drogon::nosql::RedisClient::newRedisClient(
+        trantor::InetAddress("127.0.0.1", 6379), 1);
+    auto killer = drogon::nosql::RedisClient::newRedisClient(
+        trantor::InetAddress("127.0.0.1", 6379), 1);
+    auto integer = [](const RedisResult &r) { return r.asInteger(); };
+    client->execCommandSync(
+        integer, "del %s %s", "pipeline_counter", "pipeline_list");
+
+    // The replies, the errors included, are matched in order.
+    ReplyRecorder recorder;
+    constexpr int kCommands = 1000;
+    for (int i = 0; i < kCommands; ++i)
+    {
+        if (i % 10 == 9)
+            recorder.send(client, i, "lpush %s x", "pipeline_counter");
+        else
+            recorder.send(client, i, "incr %s", "pipeline_counter");
+    }
+    auto replies = recorder.wait(kCommands);
+    REQUIRE(replies.size() == kCommands);
+    long long counter = 0;
+    for (int i = 0; i < kCommands; ++i)
+    {
+        CHECK(replies[i].index == i);
+        if (i % 10 == 9)
+        {
+            CHECK(replies[i].error == RedisErrorCode::kRedisError);
+        }
+        else
+        {
+            CHECK(replies[i].value == ++counter);
+        }
+    }
+
+    // The commands waiting for their replies fail in order when the
+    // connection is lost.
+    auto id = client->execCommandSync(integer, "client id");
+    recorder.send(client, 0, "blpop %s 10", "pipeline_list");
+    for (int i = 1; i < 5; ++i)
+        recorder.send(client, i, "incr %s", "pipeline_counter");
+    std::this_thread::sleep_for(200ms);
+    CHECK(killer->execCommandSync(integer, "client kill id %lld", id) == 1);
+    replies = recorder.wait(5);
+    REQUIRE(replies.size() == 5);
+    for (int i = 0; i < 5; ++i)
+    {
+        CHECK(replies[i].index == i);
+        CHECK(replies[i].error == RedisErrorCode::kConnectionBroken);
+    }
+
+    // The commands sent until the connection is made again are sent then,
+    // in order.
+    std::this_thread::sleep_for(200ms);
+    for (int i = 0; i < 100; ++i)
+        recorder.send(client, i, "incr %s", "pipeline_counter");
+    replies = recorder.wait(100);
+    REQUIRE(replies.size() == 100);
+    for (int i = 0; i < 100; ++i)
+    {
+        CHECK(replies[i].index == i);
+        CHECK(replies[i].value == counter + 1 + i);
+    }
+    client->execCommandSync(
+        integer, "del %s %s", "pipeline_counter", "pipeline_list");
+}
+
+DROGON_TEST(RedisRateLimiterTest)
+{
+    auto client = drogon::nosql::RedisClient::newRedisClient(
+        trantor::InetAddress("127.0.0.1", 6379), 1);
+    auto integer = [](const RedisResult &r) { return r.asInteger(); };
+    client->execCommandSync(integer, "del %s", "rate_limiter_test");
+
+    // Two nodes share a capacity of 20 requests a minute, leasing 4 tokens
+    // at a time.
+    constexpr size_t kCapacity = 20;
+    constexpr size_t kLeaseSize = 4;
+    auto first = std::make_shared<drogon::RedisRateLimiter>(
+        client, "rate_limiter_test", kCapacity, 60s, kLeaseSize);
+    auto second = std::make_shared<drogon::RedisRateLimiter>(
+        client, "rate_limiter_test", kCapacity, 60s, kLeaseSize);
+    size_t allowed = 0;
+    for (int i = 0; i < 200; ++i)
+    {
+        if ((i % 2 == 0 ? first : second)->isAllowed())
+            ++allowed;
+        std::this_thread::sleep_for(1ms);
+    }
+    // The whole bucket is used, at most the batches taken on credit before
+    // the first leases are answered are allowed beyond it.
+    CHECK(allowed >= kCapacity);
+    CHECK(allowed <= kCapacity + 2 * kLeaseSize);
+    // The shared bucket is drained.
+    CHECK(!first->isAllowed());
+    CHECK(!second->isAllowed());
+    client->execCommandSync(integer, "del %s", "rate_limiter_test");
+}
+
+DROGON_TEST(RedisUnixSocketTest)
+{
+    // Nothing listens on the path, the commands time out.
+    auto missing = drogon::nosql::RedisClient::newUnixRedisClient(
+        "/tmp/drogon_redis_test_missing.sock", 1);
+    missing->setTimeout(0.5);
+    CHECK_THROWS_AS(missing->execCommandSync<std::string>(
+                        [](const RedisResult &r) { return r.asString(); },
+                        "ping"),
+                    RedisException);
+
+    auto client = drogon::nosql::RedisClient::newRedisClient(
+        trantor::InetAddress("127.0.0.1", 6379), 1);
+    auto config = client->execCommandSync<std::vector<RedisResult>>(
+        [](const RedisResult &r) { return r.asArray(); },
+        "config get unixsocket");
+    std::string path;
+    if (config.size() == 2)
+        path = config[1].asString();
+    if (path.empty())
+    {
+        LOG_INFO << "The redis server has no unix socket, skip the test of "
+                    "the unix socket clients";
+        return;
+    }
+
+    auto unixClient = drogon::nosql::RedisClient::newUnixRedisClient(path, 1);
+    auto string = [](const RedisResult &r) { return r.asString(); };
+    unixClient->execCommandSync(string, "set %s %s", "unix_socket_test", "1");
+    CHECK(client->execCommandSync(string, "get %s", "unix_socket_test") ==
+          "1");
+    client->execCommandSync(string, "set %s %s", "unix_socket_test", "2");
+    CHECK(unixClient->execCommandSync(string, "get %s", "unix_socket_test") ==
+          "2");
+    client->execCommandSync([](const RedisResult &r) { return r.asInteger(); },
+                            "del %s",
+                            "unix_socket_test");
+
+    // The subscribers connect to the socket too.
+    std::promise<std::string> received;
+    auto future = received.get_future();
+    auto subscriber = unixClient->newSubscriber();
+    subscriber->subscribe("unix_socket_channel",
+                          [&received](const std::string &,
+                                      const std::string &message) {
+                              received.set_value(message);
+                          });
+    std::this_thread::sleep_for(200ms);
+    client->execCommandSync([](const RedisResult &r) { return r.asInteger(); },
+                            "publish %s %s",
+                            "unix_socket_channel",
+                            "hello");
+    REQUIRE(future.wait_for(2s) == std::future_status::ready);
+    CHECK(future.get() == "hello");
+    subscriber->unsubscribe("unix_socket_channel");
+}
+
 int main(int argc, char **argv)
 {
 #ifndef USE_REDIS
@@ -0,0 +1,115 @@
+/**
+ *
+ *  @file CacheInvalidator.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/CacheMap.h>
+#include <drogon/ResponseCache.h>
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/DbListener.h>
+#include <trantor/utils/NonCopyable.h>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace drogon
+{
+namespace orm
+{
+/**
+ * @brief Drop the entries of the caches of the process when notifications
+ * arrive on the channels of a database listener.
+ *
+ * Every node of a deployment listens to the same channels, and the node
+ * writing the data calls notify() in the transaction or after it, so the
+ * caches of all the nodes are invalidated, its own included. The payload of a
+ * notification names what to drop in the cache of the channel, an empty
+ * payload drops the whole cache. For example:
+ * @code
+   auto invalidator = std::make_shared<orm::CacheInvalidator>(
+       orm::DbListener::newPgListener(connInfo));
+   invalidator->invalidateQueries("tables_changed", cachedClient);
+   invalidator->invalidateResponses("pages_changed");
+   // On any node, after the users are modified:
+   orm::CacheInvalidator::notify(client, "tables_changed", "users");
+   @endcode
+ *
+ * @note The caches are invalidated in the loop of the listener. The
+ * notifications sent while a listener reconnects are lost, so the caches
+ * should still expire.
+ */
+class DROGON_EXPORT CacheInvalidator : public trantor::NonCopyable
+{
+  public:
+    using Handler = std::function<void(const std::string &payload)>;
+
+    explicit CacheInvalidator(DbListenerPtr listener)
+        : listener_(std::move(listener))
+    {
+    }
+
+    /// Call the handler with the payload of every notification of the
+    /// channel.
+    void onNotification(const std::string &channel, Handler handler);
+
+    /**
+     * @brief Drop the results cached by the client (see
+     * DbClient::newCachedClient()) of the queries reading the table named by
+     * the payload.
+     */
+    void invalidateQueries(const std::string &channel, DbClientPtr client);
+
+    /**
+     * @brief Drop the responses cached for the path in the payload, the
+     * cache is the one of the ResponseCache middleware if none is given.
+     */
+    void invalidateResponses(const std::string &channel,
+                             std::shared_ptr<ResponseCache> cache = nullptr);
+
+    /**
+     * @brief Erase the key in the payload from the cache map. The map isn't
+     * kept alive.
+     *
+     * @note A CacheMap has no bulk removal, the ones of the notifications
+     * without payload are ignored.
+     */
+    template <typename T>
+    void invalidateCacheMap(
+        const std::string &channel,
+        const std::shared_ptr<CacheMap<std::string, T>> &map)
+    {
+        onNotification(channel,
+                       [weakMap = std::weak_ptr<CacheMap<std::string, T>>(
+                            map)](const std::string &payload) {
+                           auto map = weakMap.lock();
+                           if (map && !payload.empty())
+                               map->erase(payload);
+                       });
+    }
+
+    /**
+     * @brief Send a notification to the listeners of the channel, through
+     * the client, with the PostgreSQL pg_notify() function. When the client
+     * is a transaction, the notification is only sent if it commits.
+     */
+    static void notify(const DbClientPtr &client,
+                       const std::string &channel,
+                       const std::string &payload = "");
+
+  private:
+    DbListenerPtr listener_;
+};
+}  // namespace orm
+}  // namespace drogon
@@ -0,0 +1,64 @@
+/**
+ *
+ *  @file CopyWriter.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace drogon
+{
+namespace orm
+{
+/**
+ * @brief The writer of the data of a COPY ... FROM STDIN command of
+ * PostgreSQL, see DbClient::copyIn().
+ *
+ * The data is in the format given in the command (text, csv or binary) and
+ * may be written in parts of any size, from any thread. Releasing the writer
+ * without calling finish() aborts the command.
+ */
+class DROGON_EXPORT CopyWriter
+{
+  public:
+    virtual ~CopyWriter() = default;
+
+    /// Send a part of the data.
+    virtual void write(std::string data) = 0;
+
+    /// End the data, the command completes once the server processed it.
+    virtual void finish() = 0;
+
+    /// Abort the command, which fails with the message.
+    virtual void abort(const std::string &message) = 0;
+
+    /// The number of bytes written but not yet passed to the connection.
+    virtual size_t pendingBytes() const = 0;
+
+    /**
+     * @brief Set the callback called in the loop of the connection every time
+     * all the data written so far is passed to the connection, which lets the
+     * producer pause while pendingBytes() is high.
+     */
+    virtual void setDrainCallback(std::function<void()> &&callback) = 0;
+};
+
+using CopyWriterPtr = std::shared_ptr<CopyWriter>;
+using CopyWriterCallback = std::function<void(const CopyWriterPtr &)>;
+using CopyDataCallback = std::function<void(std::string_view data)>;
+}  // namespace orm
+}  // namespace drogon
@@ -99,7 +99,7 @@ class CoroMapper : public Mapper<T>
                     sql += " for update";
                 }
                 this->clear();
-                auto binder = *(this->client_) << std::move(sql);
+                auto binder = this->makeBinder(std::move(sql));
                 this->outputPrimaryKeyToBinder(key, binder);
 
                 binder >> [callback = std::move(callback),
@@ -200,6 +200,18 @@ class CoroMapper : public Mapper<T>
         return *this;
     }
 
+    /**
+     * @brief Set the keyset (seek) pagination, see Mapper::paginateAfter().
+     *
+     * @return CoroMapper<T>& The CoroMapper itself.
+     */
+    template <typename... Values>
+    CoroMapper<T> &paginateAfter(size_t perPage, Values &&...lastValues)
+    {
+        Mapper<T>::paginateAfter(perPage, std::forward<Values>(lastValues)...);
+        return *this;
+    }
+
     /**
      * @brief Lock the result for updating.
      *
@@ -277,13 +289,12 @@ class CoroMapper : public Mapper<T>
             if (criteria)
             {
                 sql += " where ";
-                sql += criteria.criteriaString();
-                sql = this->replaceSqlPlaceHolder(sql, "$?");
+                sql += criteria.criteriaString(this->client_->type());
             }
             this->clear();
-            auto binder = *(this->client_) << std::move(sql);
+            auto binder = this->makeBinder(std::move(sql));
             if (criteria)
-                criteria.outputArgs(binder);
+                criteria.outputArgs(binder, this->client_->type());
             binder >> [callback = std::move(callback)](const Result &r) {
                 assert(r.size() == 1);
                 callback(r[0][(Row::SizeType)0].as<size_t>());
@@ -300,33 +311,27 @@ class CoroMapper : public Mapper<T>
             std::string sql = "select * from ";
             sql += T::tableName;
             sql += this->joinString_;
-            bool hasParameters = false;
             if (criteria)
             {
                 sql += " where ";
-                sql += criteria.criteriaString();
-                hasParameters = true;
+                sql += criteria.criteriaString(this->client_->type());
             }
             sql.append(this->orderByString_);
             if (this->limit_ > 0)
             {
-                hasParameters = true;
                 sql.append(" limit $?");
             }
             if (this->offset_ > 0)
             {
-                hasParameters = true;
                 sql.append(" offset $?");
             }
-            if (hasParameters)
-                sql = this->replaceSqlPlaceHolder(sql, "$?");
             if (this->forUpdate_)
             {
                 sql += " for update";
             }
-            auto binder = *(this->client_) << std::move(sql);
+            auto binder = this->makeBinder(std::move(sql));
             if (criteria)
-                criteria.outputArgs(binder);
+                criteria.outputArgs(binder, this->client_->type());
             if (this->limit_ > 0)
                 binder << this->limit_;
             if (this->offset_)
@@ -357,38 +362,34 @@ class CoroMapper : public Mapper<T>
     inline internal::MapperAwaiter<std::vector<T>> findBy(
         const Criteria &criteria)
     {
+        if (!this->seekValues_.empty())
+            return findBy(criteria && this->takeSeekCriteria());
         auto lb = [this, criteria](MultipleRowsCallback &&callback,
                                    ExceptPtrCallback &&errCallback) {
             std::string sql = "select * from ";
             sql += T::tableName;
             sql += this->joinString_;
-            bool hasParameters = false;
             if (criteria)
             {
-                hasParameters = true;
                 sql += " where ";
-                sql += criteria.criteriaString();
+                sql += criteria.criteriaString(this->client_->type());
             }
             sql.append(this->orderByString_);
             if (this->limit_ > 0)
             {
-                hasParameters = true;
                 sql.append(" limit $?");
             }
             if (this->offset_ > 0)
             {
-                hasParameters = true;
                 sql.append(" offset $?");
             }
-            if (hasParameters)
-                sql = this->replaceSqlPlaceHolder(sql, "$?");
             if (this->forUpdate_)
             {
                 sql += " for update";
             }
-            auto binder = *(this->client_) << std::move(sql);
+            auto binder = this->makeBinder(std::move(sql));
             if (criteria)
-                criteria.outputArgs(binder);
+                criteria.outputArgs(binder, this->client_->type());
             if (this->limit_ > 0)
                 binder << this->limit_;
             if (this->offset_)
@@ -462,6 +463,60 @@ class CoroMapper : public Mapper<T>
         return internal::MapperAwaiter<T>(std::move(lb));
     }
 
+    inline internal::MapperAwaiter<std::vector<T>> insertBatch(
+        const std::vector<T> &objs,
+        size_t maxParameters = 0)
+    {
+        auto lb = [this, objs, maxParameters](
+                      MultipleRowsCallback &&callback,
+                      ExceptPtrCallback &&errCallback) {
+            this->insertBatchAsync(objs,
+                                   std::move(callback),
+                                   std::move(errCallback),
+                                   maxParameters);
+        };
+        return internal::MapperAwaiter<std::vector<T>>(std::move(lb));
+    }
+
+    inline internal::MapperAwaiter<size_t> upsert(
+        const T &obj,
+        const std::vector<std::string> &conflictColumns = {})
+    {
+        return upsertBatch(std::vector<T>{obj}, conflictColumns);
+    }
+
+    inline internal::MapperAwaiter<size_t> upsertBatch(
+        const std::vector<T> &objs,
+        const std::vector<std::string> &conflictColumns = {},
+        size_t maxParameters = 0)
+    {
+        auto lb = [this, objs, conflictColumns, maxParameters](
+                      CountCallback &&callback,
+                      ExceptPtrCallback &&errCallback) {
+            this->upsertBatchAsync(objs,
+                                   conflictColumns,
+                                   maxParameters,
+                                   std::move(callback),
+                                   std::move(errCallback));
+        };
+        return internal::MapperAwaiter<size_t>(std::move(lb));
+    }
+
+    inline internal::MapperAwaiter<size_t> updateBatch(
+        const std::vector<T> &objs,
+        size_t maxParameters = 0)
+    {
+        auto lb = [this, objs, maxParameters](
+                      CountCallback &&callback,
+                      ExceptPtrCallback &&errCallback) {
+            this->updateBatchAsync(objs,
+                                   maxParameters,
+                                   std::move(callback),
+                                   std::move(errCallback));
+        };
+        return internal::MapperAwaiter<size_t>(std::move(lb));
+    }
+
     inline internal::MapperAwaiter<size_t> update(const T &obj)
     {
         auto lb = [this, obj](CountCallback &&callback,
@@ -487,8 +542,7 @@ class CoroMapper : public Mapper<T>
 
             this->makePrimaryKeyCriteria(sql);
 
-            sql = this->replaceSqlPlaceHolder(sql, "$?");
-            auto binder = *(this->client_) << std::move(sql);
+            auto binder = this->makeBinder(std::move(sql));
             obj.updateArgs(binder);
             this->outputPrimaryKeyToBinder(obj.getPrimaryKey(), binder);
             binder >> [callback = std::move(callback)](const Result &r) {
@@ -598,14 +652,13 @@ class CoroMapper : public Mapper<T>
             if (criteria)
             {
                 sql += " where ";
-                sql += criteria.criteriaString();
+                sql += criteria.criteriaString(this->client_->type());
             }
 
-            sql = this->replaceSqlPlaceHolder(sql, "$?");
-            auto binder = *(this->client_) << std::move(sql);
+            auto binder = this->makeBinder(std::move(sql));
             (void)std::initializer_list<int>{(binder << args, 0)...};
             if (criteria)
-                criteria.outputArgs(binder);
+                criteria.outputArgs(binder, this->client_->type());
             binder >> [callback = std::move(callback)](const Result &r) {
                 callback(r.affectedRows());
             };
@@ -628,8 +681,7 @@ class CoroMapper : public Mapper<T>
 
             this->makePrimaryKeyCriteria(sql);
 
-            sql = this->replaceSqlPlaceHolder(sql, "$?");
-            auto binder = *(this->client_) << std::move(sql);
+            auto binder = this->makeBinder(std::move(sql));
             this->outputPrimaryKeyToBinder(obj.getPrimaryKey(), binder);
             binder >> [callback = std::move(callback)](const Result &r) {
                 callback(r.affectedRows());
@@ -652,14 +704,13 @@ class CoroMapper : public Mapper<T>
             if (criteria)
             {
                 sql += " where ";
-                sql += criteria.criteriaString();
-                sql = this->replaceSqlPlaceHolder(sql, "$?");
+                sql += criteria.criteriaString(this->client_->type());
             }
 
-            auto binder = *(this->client_) << std::move(sql);
+            auto binder = this->makeBinder(std::move(sql));
             if (criteria)
             {
-                criteria.outputArgs(binder);
+                criteria.outputArgs(binder, this->client_->type());
             }
             binder >> [callback = std::move(callback)](const Result &r) {
                 callback(r.affectedRows());
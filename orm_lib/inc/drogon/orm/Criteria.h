@@ -21,6 +21,7 @@
 #include <string>
 #include <tuple>
 #include <type_traits>
+#include <vector>
 
 namespace Json
 {
@@ -67,6 +68,45 @@ inline CustomSql operator""_sql(const char *str, size_t)
     return CustomSql(str);
 }
 
+namespace internal
+{
+// The types of the values of the in lists bound as one array on PostgreSQL.
+template <typename T>
+constexpr bool isArrayElement =
+    (std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+     !std::is_same_v<T, char>) ||
+    std::is_same_v<T, std::string>;
+
+// Return the text of the PostgreSQL array of the values.
+template <typename T>
+std::string arrayLiteral(const std::vector<T> &values)
+{
+    std::string literal(1, '{');
+    for (auto const &value : values)
+    {
+        if (literal.length() > 1)
+            literal += ',';
+        if constexpr (std::is_same_v<T, std::string>)
+        {
+            literal += '"';
+            for (auto c : value)
+            {
+                if (c == '"' || c == '\\')
+                    literal += '\\';
+                literal += c;
+            }
+            literal += '"';
+        }
+        else
+        {
+            literal += std::to_string(value);
+        }
+    }
+    literal += '}';
+    return literal;
+}
+}  // namespace internal
+
 /**
  * @brief this class represents a comparison condition.
  */
@@ -94,6 +134,21 @@ class DROGON_EXPORT Criteria
         return conditionString_;
     }
 
+    /**
+     * @brief return the condition string in SQL for the type of the client.
+     *
+     * @note On PostgreSQL, the in lists of integers or strings are one array
+     * parameter (e.g. 'id = any($1)'), so the statement is the same for all
+     * the lengths of the lists and its plan can be reused. The arguments must
+     * be output by outputArgs() with the same type.
+     */
+    std::string criteriaString(ClientType type) const
+    {
+        if (type == ClientType::PostgreSQL && outputArrayArgumentsFunc_)
+            return arrayConditionString_;
+        return conditionString_;
+    }
+
     /**
      * @brief Construct a new custom Criteria object
      *
@@ -224,6 +279,10 @@ class DROGON_EXPORT Criteria
                 binder << arg;
             }
         };
+        if constexpr (internal::isArrayElement<T>)
+        {
+            setArrayArgument(colName, opera, internal::arrayLiteral(args));
+        }
     }
 
     template <typename T>
@@ -251,6 +310,10 @@ class DROGON_EXPORT Criteria
                 conditionString_.append("$?");
         }
         conditionString_.append(")");
+        if constexpr (internal::isArrayElement<T>)
+        {
+            setArrayArgument(colName, opera, internal::arrayLiteral(args));
+        }
         outputArgumentsFunc_ =
             [args = std::move(args)](internal::SqlBinder &binder) {
                 for (auto &arg : args)
@@ -349,7 +412,34 @@ class DROGON_EXPORT Criteria
             outputArgumentsFunc_(binder);
     }
 
+    /**
+     * @brief Output arguments to the SQL binder object, for the condition
+     * string returned by criteriaString(type).
+     */
+    void outputArgs(internal::SqlBinder &binder, ClientType type) const
+    {
+        if (type == ClientType::PostgreSQL && outputArrayArgumentsFunc_)
+            outputArrayArgumentsFunc_(binder);
+        else
+            outputArgs(binder);
+    }
+
   private:
+    void setArrayArgument(const std::string &colName,
+                          const CompareOperator &opera,
+                          std::string array)
+    {
+        arrayConditionString_ = colName;
+        if (opera == CompareOperator::In)
+            arrayConditionString_ += " = any($?)";
+        else
+            arrayConditionString_ += " <> all($?)";
+        outputArrayArgumentsFunc_ =
+            [array = std::move(array)](internal::SqlBinder &binder) {
+                binder << array;
+            };
+    }
+
     friend DROGON_EXPORT const Criteria operator&&(Criteria cond1,
                                                    Criteria cond2);
 
@@ -357,6 +447,10 @@ class DROGON_EXPORT Criteria
                                                    Criteria cond2);
     std::string conditionString_;
     std::function<void(internal::SqlBinder &)> outputArgumentsFunc_;
+    // The condition with the in lists bound as arrays on PostgreSQL, only
+    // set when there are such lists.
+    std::string arrayConditionString_;
+    std::function<void(internal::SqlBinder &)> outputArrayArgumentsFunc_;
 };  // namespace orm
 
 DROGON_EXPORT const Criteria operator&&(Criteria cond1, Criteria cond2);
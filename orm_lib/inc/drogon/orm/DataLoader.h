@@ -0,0 +1,258 @@
+/**
+ *
+ *  @file DataLoader.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+#pragma once
+
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/Exception.h>
+#include <drogon/orm/Result.h>
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/NonCopyable.h>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#ifdef __cpp_impl_coroutine
+#include <drogon/orm/CoroMapper.h>
+#endif
+
+namespace drogon
+{
+namespace orm
+{
+/**
+ * @brief This template batches the lookups of objects by their primary keys.
+ * The keys looked up in an event loop while it handles the current events are
+ * read with one query when it is done with them, and every object found is
+ * given to all the callbacks waiting for it.
+ *
+ * A loader is usually shared by the requests handled in all the IO loops,
+ * e.g. as a member of a controller, the lookups of every loop are batched
+ * separately. For example:
+ * @code
+   static orm::DataLoader<Users> usersLoader(app().getDbClient());
+   usersLoader.findByPrimaryKey(
+       id,
+       [callback](Users user) { ... },
+       [callback](const orm::DrogonDbException &e) { ... });
+   @endcode
+ *
+ * @tparam T The type of the model, whose primary key must be one column.
+ * @note The lookups made outside of event loops are not batched. The
+ * callbacks are called in the loops of the database client, like those of the
+ * Mapper.
+ */
+template <typename T>
+class DataLoader : public trantor::NonCopyable
+{
+  public:
+    using PrimaryKeyType = typename T::PrimaryKeyType;
+    using SingleRowCallback = std::function<void(T)>;
+    using ExceptPtrCallback = std::function<void(const std::exception_ptr &)>;
+
+    /**
+     * @brief Construct a new DataLoader object
+     *
+     * @param client The database client the queries are sent to.
+     * @param maxBatchSize The maximum number of keys in one query, the
+     * batches with more keys are split.
+     */
+    explicit DataLoader(DbClientPtr client, size_t maxBatchSize = 100)
+        : statePtr_(std::make_shared<State>())
+    {
+        static_assert(!std::is_same_v<PrimaryKeyType, void>,
+                      "No primary key in the table!");
+        static_assert(
+            std::is_same_v<decltype(T::primaryKeyName), const std::string>,
+            "Only the primary keys of one column are supported");
+        statePtr_->client = std::move(client);
+        statePtr_->maxBatchSize = maxBatchSize > 0 ? maxBatchSize : 1;
+    }
+
+    /**
+     * @brief Find the object by its primary key. The exception callback is
+     * called with an UnexpectedRows exception if there is no such object.
+     */
+    void findByPrimaryKey(const PrimaryKeyType &key,
+                          SingleRowCallback rcb,
+                          ExceptionCallback ecb)
+    {
+        load(key,
+             std::move(rcb),
+             [ecb = std::move(ecb)](const std::exception_ptr &exception) {
+                 try
+                 {
+                     std::rethrow_exception(exception);
+                 }
+                 catch (const DrogonDbException &e)
+                 {
+                     ecb(e);
+                 }
+             });
+    }
+
+    /// The same as findByPrimaryKey() with the exception in a pointer.
+    void load(const PrimaryKeyType &key,
+              SingleRowCallback rcb,
+              ExceptPtrCallback ecb)
+    {
+        auto loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+        if (!loop)
+        {
+            Batch batch;
+            batch[key].push_back({std::move(rcb), std::move(ecb)});
+            query(statePtr_, std::move(batch));
+            return;
+        }
+        bool isFirst{false};
+        {
+            std::lock_guard<std::mutex> lock(statePtr_->mutex);
+            auto &batch = statePtr_->pendingBatches[loop];
+            isFirst = batch.empty();
+            batch[key].push_back({std::move(rcb), std::move(ecb)});
+        }
+        if (isFirst)
+        {
+            // Run after the events being handled, which may look up more
+            // keys.
+            loop->queueInLoop(
+                [statePtr = statePtr_, loop]() { flush(statePtr, loop); });
+        }
+    }
+
+#ifdef __cpp_impl_coroutine
+    internal::MapperAwaiter<T> findByPrimaryKeyCoro(const PrimaryKeyType &key)
+    {
+        return internal::MapperAwaiter<T>(
+            [this, key](SingleRowCallback &&rcb, ExceptPtrCallback &&ecb) {
+                load(key, std::move(rcb), std::move(ecb));
+            });
+    }
+#endif
+
+  private:
+    struct Waiter
+    {
+        SingleRowCallback rcb;
+        ExceptPtrCallback ecb;
+    };
+
+    // The waiters by key
+    using Batch = std::map<PrimaryKeyType, std::vector<Waiter>>;
+
+    struct State
+    {
+        DbClientPtr client;
+        size_t maxBatchSize{100};
+        std::mutex mutex;
+        std::unordered_map<trantor::EventLoop *, Batch> pendingBatches;
+    };
+
+    static void flush(const std::shared_ptr<State> &statePtr,
+                      trantor::EventLoop *loop)
+    {
+        Batch batch;
+        {
+            std::lock_guard<std::mutex> lock(statePtr->mutex);
+            auto iter = statePtr->pendingBatches.find(loop);
+            if (iter == statePtr->pendingBatches.end())
+                return;
+            batch = std::move(iter->second);
+            statePtr->pendingBatches.erase(iter);
+        }
+        while (batch.size() > statePtr->maxBatchSize)
+        {
+            Batch part;
+            auto end = batch.begin();
+            std::advance(end, statePtr->maxBatchSize);
+            part.insert(std::make_move_iterator(batch.begin()),
+                        std::make_move_iterator(end));
+            batch.erase(batch.begin(), end);
+            query(statePtr, std::move(part));
+        }
+        query(statePtr, std::move(batch));
+    }
+
+    static void query(const std::shared_ptr<State> &statePtr, Batch &&batch)
+    {
+        std::string sql = "select * from ";
+        sql += T::tableName;
+        sql += " where ";
+        sql += T::primaryKeyName;
+        sql += " in (";
+        bool isPostgreSQL =
+            statePtr->client->type() == ClientType::PostgreSQL;
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            if (i > 0)
+                sql += ",";
+            if (isPostgreSQL)
+            {
+                sql += "$";
+                sql += std::to_string(i + 1);
+            }
+            else
+            {
+                sql += "?";
+            }
+        }
+        sql += ")";
+        auto batchPtr = std::make_shared<Batch>(std::move(batch));
+        auto binder = *statePtr->client << std::move(sql);
+        for (auto &item : *batchPtr)
+        {
+            binder << item.first;
+        }
+        binder >> [batchPtr](const Result &r) {
+            for (auto const &row : r)
+            {
+                T obj(row);
+                auto iter = batchPtr->find(obj.getPrimaryKey());
+                if (iter == batchPtr->end())
+                    continue;
+                for (auto &waiter : iter->second)
+                {
+                    waiter.rcb(obj);
+                }
+                batchPtr->erase(iter);
+            }
+            for (auto &item : *batchPtr)
+            {
+                for (auto &waiter : item.second)
+                {
+                    waiter.ecb(std::make_exception_ptr(
+                        UnexpectedRows("0 rows found")));
+                }
+            }
+        };
+        binder >> [batchPtr](const std::exception_ptr &exception) {
+            for (auto &item : *batchPtr)
+            {
+                for (auto &waiter : item.second)
+                {
+                    waiter.ecb(exception);
+                }
+            }
+        };
+    }
+
+    std::shared_ptr<State> statePtr_;
+};
+}  // namespace orm
+}  // namespace drogon
@@ -15,17 +15,21 @@
 #pragma once
 
 #include <drogon/exports.h>
+#include <drogon/CircuitBreaker.h>
+#include <drogon/orm/CopyWriter.h>
 #include <drogon/orm/Exception.h>
 #include <drogon/orm/Field.h>
 #include <drogon/orm/Result.h>
 #include <drogon/orm/ResultIterator.h>
 #include <drogon/orm/Row.h>
 #include <drogon/orm/RowIterator.h>
+#include <drogon/orm/RowStream.h>
 #include <drogon/orm/SqlBinder.h>
 #include <exception>
 #include <functional>
 #include <future>
 #include <string>
+#include <tuple>
 #include <trantor/utils/Logger.h>
 #include <trantor/utils/NonCopyable.h>
 
@@ -42,6 +46,7 @@ using ExceptionCallback = std::function<void(const DrogonDbException &)>;
 
 class Transaction;
 class DbClient;
+struct CopyCmd;
 
 /// Transaction locking mode.
 enum class TransactionType
@@ -64,19 +69,23 @@ struct [[nodiscard]] SqlAwaiter : public CallbackAwaiter<Result>
 
     void await_suspend(std::coroutine_handle<> handle)
     {
-        binder_ >> [handle, this](const drogon::orm::Result &result) {
-            setValue(result);
-            handle.resume();
-        };
-        binder_ >> [handle, this](const std::exception_ptr &e) {
-            setException(e);
-            handle.resume();
-        };
-        binder_.exec();
+        handle_ = handle;
+        // The callbacks only capture this so that std::function stores them
+        // in place, the binder in the coroutine frame keeps the parameters.
+        binder_.execDirect(
+            [this](const drogon::orm::Result &result) {
+                setValue(result);
+                handle_.resume();
+            },
+            [this](const std::exception_ptr &e) {
+                setException(e);
+                handle_.resume();
+            });
     }
 
   private:
     internal::SqlBinder binder_;
+    std::coroutine_handle<> handle_;
 };
 
 struct [[nodiscard]] TransactionAwaiter
@@ -126,20 +135,146 @@ class DROGON_EXPORT DbClient : public trantor::NonCopyable
      * - client_encoding: The character set to be used on database connections.
      *
      * For other key words on PostgreSQL, see the PostgreSQL documentation.
-     * Only a pair of key values is valid for Sqlite3, and its keyword is
-     * 'filename'.
+     * The other keywords of MySQL are:
+     * - prepared_statements: If 1 or true, the queries are executed as
+     * server-side prepared statements and their results are received in the
+     * binary format. The ones which the server can't prepare, the CALL
+     * statements and the ones with default values are sent as text.
+     * - max_prepared_statements: The maximum number of prepared statements
+     * kept by each connection, see the parameter of newPgClient().
+     * - prepare_threshold: The number of executions of a query on a
+     * connection after which it is prepared, see the parameter of
+     * newPgClient().
+     * The keywords of Sqlite3 are:
+     * - filename: The database file.
+     * - journal_mode: The journal mode set when the database is opened. In
+     * the 'wal' mode, the readers don't wait for the writers and the commits
+     * are only synced to the disk by the checkpoints.
+     * - busy_timeout: The time in milliseconds to wait for a lock which is
+     * held by another process.
+     * - mmap_size, cache_size, synchronous, temp_store: The pragmas set when
+     * the database is opened, see the fields of Sqlite3Config.
+     * - immutable: 1 to open the database read-only without any lock, for
+     * the files which are never modified while they are open.
+     * - max_prepared_statements: The maximum number of prepared statements
+     * kept by each connection, 0 by default for no limit. The statements
+     * without parameters are only kept when there is a limit.
      *
      * @param connNum: The number of connections to database server;
+     * @param autoBatch: Send the sql commands in the pipeline mode, see the
+     * wiki for more details. With MySQL, the commands waiting for a
+     * connection are sent together as a multi-statement query instead.
+     * @param binaryResults: Receive the results in the binary format, see the
+     * comment of Field for more details.
+     * @param maxPreparedStatements: The maximum number of prepared statements
+     * kept by each connection, the least recently used ones are deallocated
+     * beyond it. 0 means no limit.
+     * @param prepareThreshold: The number of executions of a query on a
+     * connection after which it is prepared, the previous ones don't use a
+     * prepared statement. A large value keeps one-off queries from filling
+     * the cache.
+     * @param warmupStatements: The statements prepared by each connection,
+     * including the ones opened again after a failure, once it is
+     * established and before it executes any query, so the first queries
+     * after a deploy or a failover don't wait for them to be prepared. The
+     * statements are written as in the queries executed later, e.g. with
+     * $1, $2... or with question marks on MySQL, where they are only
+     * prepared with the prepared_statements keyword. The ones which can't be
+     * prepared are skipped with a warning.
      */
-    static std::shared_ptr<DbClient> newPgClient(const std::string &connInfo,
-                                                 size_t connNum,
-                                                 bool autoBatch = false);
-    static std::shared_ptr<DbClient> newMysqlClient(const std::string &connInfo,
-                                                    size_t connNum);
+    static std::shared_ptr<DbClient> newPgClient(
+        const std::string &connInfo,
+        size_t connNum,
+        bool autoBatch = false,
+        bool binaryResults = false,
+        size_t maxPreparedStatements = 0,
+        unsigned int prepareThreshold = 1,
+        std::vector<std::string> warmupStatements = {});
+    static std::shared_ptr<DbClient> newMysqlClient(
+        const std::string &connInfo,
+        size_t connNum,
+        bool autoBatch = false,
+        std::vector<std::string> warmupStatements = {});
     static std::shared_ptr<DbClient> newSqlite3Client(
         const std::string &connInfo,
         size_t connNum);
 
+    /**
+     * @brief Create a client which sends the queries to a primary server and
+     * balances the read-only queries among its replicas.
+     *
+     * @param primary: The client of the primary server, which executes the
+     * transactions and all the queries that may change the database.
+     * @param replicas: The clients of the read replicas. The queries starting
+     * with SELECT outside of a transaction and all the queries sent through
+     * readOnly() are executed by the least loaded replica, which has the
+     * lowest average response time weighted by the number of queries in
+     * progress.
+     * @param maxReplicaLag: If positive, the lag of each PostgreSQL or MySQL
+     * replica is checked every second when it is used, and the replicas
+     * lagging behind the primary server by more than this number of seconds
+     * aren't used. The queries are executed by the primary if no replica is
+     * available.
+     */
+    static std::shared_ptr<DbClient> newReplicatedClient(
+        std::shared_ptr<DbClient> primary,
+        std::vector<std::shared_ptr<DbClient>> replicas,
+        double maxReplicaLag = -1.0);
+
+    /**
+     * @brief Create a client which caches the results of the read-only queries
+     * of another client.
+     *
+     * @param client: The client which executes the queries.
+     * @param maxEntries: The maximum number of results in the cache, the least
+     * recently used ones are dropped first.
+     * @param ttl: The number of seconds a result is kept in the cache.
+     * @note The results are keyed by the SQL and its parameters, and only the
+     * queries starting with SELECT outside of a transaction are cached (see
+     * newReplicatedClient()). When any other query of this client is done,
+     * the results of the queries reading the tables it names are dropped, or
+     * the whole cache if no table is found in it. The changes made by
+     * transactions or by other clients are only seen once the results expire
+     * or invalidateCache() is called. The queries sent through primary() are
+     * never cached.
+     * The identical queries sent while one of them is in progress wait for its
+     * result instead of being executed too, which still applies without
+     * caching when maxEntries is zero.
+     */
+    static std::shared_ptr<DbClient> newCachedClient(
+        std::shared_ptr<DbClient> client,
+        size_t maxEntries = 10000,
+        double ttl = 1.0);
+
+    /**
+     * @brief Drop the cached results of the queries reading a table, or the
+     * whole cache if the name is empty, see newCachedClient(). Clients without
+     * cache do nothing.
+     */
+    virtual void invalidateCache(const std::string &table)
+    {
+        (void)table;
+    }
+
+    /**
+     * @brief Get the client which executes all the queries by the replicas,
+     * see newReplicatedClient(). Other clients return themselves.
+     */
+    virtual DbClient &readOnly()
+    {
+        return *this;
+    }
+
+    /**
+     * @brief Get the client which executes all the queries by the primary
+     * server, for the reads which must see the latest writes. Clients without
+     * replicas return themselves.
+     */
+    virtual DbClient &primary()
+    {
+        return *this;
+    }
+
     /// Async and nonblocking method
     /**
      * @param sql is the SQL statement to be executed;
@@ -217,6 +352,86 @@ class DROGON_EXPORT DbClient : public trantor::NonCopyable
         return r;
     }
 
+    /// Async method delivering the rows of a query in batches
+    /**
+     * @param sql is the SQL query, usually a select statement;
+     * @param batchSize is the maximum number of rows in a batch;
+     * @param rowsCallback is called with every batch, see RowsCallback;
+     * @param exceptCallback is called if the query fails, the rows callback
+     * isn't called any more;
+     * @param args are parameters that are bound to placeholders in the sql
+     * parameter;
+     *
+     * @note On PostgreSQL, the query is read through a cursor in a
+     * transaction, which is a new one unless this client is a transaction.
+     * Only one query can be streamed at a time in a transaction.
+     * Only PostgreSQL bounds the memory used by the query. The MySQL and
+     * Sqlite3 connections store the whole result before the first batch is
+     * delivered, so the memory grows with the size of the result as with
+     * execSqlAsync().
+     */
+    template <typename... Arguments>
+    void execSqlStream(const std::string &sql,
+                       size_t batchSize,
+                       RowsCallback rowsCallback,
+                       ExceptionCallback exceptCallback,
+                       Arguments &&...args) noexcept
+    {
+        startSqlStream(
+            sql,
+            batchSize,
+            [parameters = std::make_tuple(std::decay_t<Arguments>(
+                 std::forward<Arguments>(args))...)](
+                internal::SqlBinder &binder) {
+                std::apply(
+                    [&binder](const auto &...parameter) {
+                        (void)std::initializer_list<int>{
+                            (binder << parameter, 0)...};
+                    },
+                    parameters);
+            },
+            std::move(rowsCallback),
+            std::move(exceptCallback));
+    }
+
+    /// Async method sending data to a COPY ... FROM STDIN command
+    /**
+     * @param sql is the COPY command, e.g.
+     *   copy users (id, name) from stdin with (format csv)
+     * @param writerCallback is called with the writer of the data once the
+     * server is ready to receive it;
+     * @param resultCallback is called when the command completes, the
+     * affectedRows() of the result is the number of rows copied;
+     * @param exceptCallback is called if the command fails or is aborted;
+     *
+     * @note The command runs in a transaction, which is a new one committed
+     * before the result callback is called unless this client is a
+     * transaction. The data of a request body can be copied by writing the
+     * chunks read by a RequestStreamReader.
+     * @note Only PostgreSQL supports this method and the timeout of the client
+     * doesn't apply to it.
+     */
+    void copyIn(const std::string &sql,
+                CopyWriterCallback writerCallback,
+                ResultCallback resultCallback,
+                ExceptionCallback exceptCallback) noexcept;
+
+    /// Async method receiving the data of a COPY ... TO STDOUT command
+    /**
+     * @param sql is the COPY command, e.g.
+     *   copy (select * from users) to stdout with (format csv)
+     * @param dataCallback is called in the loop of the connection with every
+     * part of the data, usually a row, as it is received;
+     * @param resultCallback is called after the last part of the data;
+     * @param exceptCallback is called if the command fails;
+     *
+     * @note The same notes as copyIn() apply.
+     */
+    void copyOut(const std::string &sql,
+                 CopyDataCallback dataCallback,
+                 ResultCallback resultCallback,
+                 ExceptionCallback exceptCallback) noexcept;
+
 #ifdef __cpp_impl_coroutine
     template <typename... Arguments>
     internal::SqlAwaiter execSqlCoro(const std::string &sql,
@@ -228,6 +443,17 @@ class DROGON_EXPORT DbClient : public trantor::NonCopyable
         return internal::SqlAwaiter(std::move(binder));
     }
 
+    /// The SQL literals are not copied.
+    template <int N, typename... Arguments>
+    internal::SqlAwaiter execSqlCoro(const char (&sql)[N],
+                                     Arguments &&...args) noexcept
+    {
+        auto binder = *this << sql;
+        (void)std::initializer_list<int>{
+            (binder << std::forward<Arguments>(args), 0)...};
+        return internal::SqlAwaiter(std::move(binder));
+    }
+
     /**
      * @brief Execute a SQL query asynchronously using coroutine support.
      *        This overload accepts a vector of arguments to bind to the query.
@@ -249,6 +475,18 @@ class DROGON_EXPORT DbClient : public trantor::NonCopyable
         }
         return internal::SqlAwaiter(std::move(binder));
     }
+
+    template <int N, typename T>
+    internal::SqlAwaiter execSqlCoro(const char (&sql)[N],
+                                     const std::vector<T> &args) noexcept
+    {
+        auto binder = *this << sql;
+        for (const auto &arg : args)
+        {
+            binder << arg;
+        }
+        return internal::SqlAwaiter(std::move(binder));
+    }
 #endif
 
     /// Streaming-like method for sql execution. For more information, see the
@@ -329,6 +567,35 @@ class DROGON_EXPORT DbClient : public trantor::NonCopyable
      */
     virtual bool hasAvailableConnections() const noexcept = 0;
 
+    struct ConnectionStats
+    {
+        size_t busy{0};
+        size_t idle{0};
+        // The number of SQL commands waiting for an idle connection.
+        size_t pending{0};
+        // The lookups of the prepared statements of PostgreSQL connections
+        // and the statements deallocated to respect the limit of the cache.
+        size_t preparedStatementHits{0};
+        size_t preparedStatementMisses{0};
+        size_t preparedStatementEvictions{0};
+        // The total time in seconds the SQL commands waited for a connection
+        // and the number of these commands.
+        double queueWaitTime{0.0};
+        size_t queuedCommands{0};
+    };
+
+    /**
+     * @brief Get the number of busy and idle connections and the length of the
+     * queue of the client, used by the built-in metrics of PromExporter.
+     *
+     * @note Fast clients and clients that don't track these numbers return
+     * zeros.
+     */
+    virtual ConnectionStats connectionStats() const noexcept
+    {
+        return {};
+    }
+
     ClientType type() const
     {
         return type_;
@@ -350,6 +617,41 @@ class DROGON_EXPORT DbClient : public trantor::NonCopyable
      * is not called.
      */
     virtual void setTimeout(double timeout) = 0;
+
+    /**
+     * @brief Let the number of connections follow the load, which is only
+     * supported by the PostgreSQL and MySQL clients that aren't fast.
+     *
+     * @param maxConnections: The maximum number of connections. A new
+     * connection is opened for every SQL command or transaction waiting for
+     * a connection until the maximum is reached. The number of connections
+     * given when the client is created is the minimum.
+     * @param idleTimeout: The connections beyond the minimum are closed after
+     * being idle for this number of seconds.
+     */
+    virtual void enableAdaptivePool(size_t maxConnections,
+                                    double idleTimeout = 60.0)
+    {
+        (void)maxConnections;
+        (void)idleTimeout;
+    }
+
+    /**
+     * @brief Fail the SQL commands fast while the database server is down,
+     * instead of queuing them until they time out.
+     *
+     * @param breaker The commands failing with a BrokenConnection or a
+     * TimeoutError exception are recorded as failed by the circuit breaker,
+     * the SQL errors as successful. While it is open, the commands fail at
+     * once with a BrokenConnection exception. The transactions aren't
+     * checked. It should be set before the client is used, nullptr removes
+     * it.
+     */
+    virtual void setCircuitBreaker(CircuitBreakerPtr breaker)
+    {
+        (void)breaker;
+    }
+
     /**
      * @brief Close all connections in the client. usually used by Drogon in the
      * quit() method.
@@ -394,11 +696,20 @@ class DROGON_EXPORT DbClient : public trantor::NonCopyable
      * high-concurrency scenarios. The auto-batch mode can only be enabled
      * before the client is used, and enabling it during use will have uncertain
      * side effects. This feature can be enabled in the configuration file.
+     *
+     * With MySQL, the auto-batch mode sends the commands waiting for a
+     * connection as one multi-statement query, which saves the round trips
+     * between them. Every statement is still committed by itself, but the
+     * server stops at the first failed one, so the following commands of
+     * the batch fail too. The CALL statements, which return several results,
+     * are never batched.
      * */
     // virtual void enableAutoBatch() = 0;
 
   private:
     friend internal::SqlBinder;
+    friend class ReplicatedDbClient;
+    friend class CachedDbClient;
     virtual void execSql(
         const char *sql,
         size_t sqlLength,
@@ -408,6 +719,16 @@ class DROGON_EXPORT DbClient : public trantor::NonCopyable
         std::vector<int> &&format,
         ResultCallback &&rcb,
         std::function<void(const std::exception_ptr &)> &&exceptCallback) = 0;
+    void startSqlStream(
+        const std::string &sql,
+        size_t batchSize,
+        std::function<void(internal::SqlBinder &)> &&bindParameters,
+        RowsCallback &&rowsCallback,
+        ExceptionCallback &&exceptCallback) noexcept;
+    void startCopy(std::shared_ptr<CopyCmd> &&cmd,
+                   ResultCallback &&resultCallback,
+                   ExceptionCallback &&exceptCallback) noexcept;
+    virtual void execCopy(const std::shared_ptr<CopyCmd> &cmd);
 
   protected:
     ClientType type_;
@@ -14,12 +14,24 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 namespace drogon::orm
 {
+// A read replica, which has the database name and the credentials of the
+// primary server, see DbClient::newReplicatedClient().
+struct ReplicaConfig
+{
+    std::string host;
+    // 0 for the port of the primary server.
+    unsigned short port{0};
+};
+
 struct PostgresConfig
 {
     std::string host;
@@ -34,6 +46,24 @@ struct PostgresConfig
     double timeout;
     bool autoBatch;
     std::unordered_map<std::string, std::string> connectOptions;
+    // Receive the results in the binary format, see the comment of Field.
+    bool binaryResults{false};
+    // The maximum number of prepared statements per connection, 0 for no
+    // limit, and the number of executions after which a query is prepared.
+    size_t maxPreparedStatements{0};
+    unsigned int prepareThreshold{1};
+    // The read replicas, which are ignored by fast clients, and the maximum
+    // lag in seconds of the replicas in use, non-positive for no check.
+    std::vector<ReplicaConfig> replicas;
+    double maxReplicaLag{-1.0};
+    // The maximum number of connections of a client which isn't fast, see
+    // DbClient::enableAdaptivePool(), and the idle time after which the
+    // connections beyond connectionNumber are closed.
+    size_t maxConnectionNumber{0};
+    double idleConnectionTimeout{60.0};
+    // The statements prepared by each connection before it's used, see
+    // DbClient::newPgClient().
+    std::vector<std::string> warmupStatements;
 };
 
 struct MysqlConfig
@@ -48,6 +78,26 @@ struct MysqlConfig
     bool isFast;
     std::string characterSet;
     double timeout;
+    // The read replicas, which are ignored by fast clients, and the maximum
+    // lag in seconds of the replicas in use, non-positive for no check.
+    std::vector<ReplicaConfig> replicas;
+    double maxReplicaLag{-1.0};
+    // The maximum number of connections of a client which isn't fast, see
+    // DbClient::enableAdaptivePool(), and the idle time after which the
+    // connections beyond connectionNumber are closed.
+    size_t maxConnectionNumber{0};
+    double idleConnectionTimeout{60.0};
+    // Send the commands waiting for a connection as one multi-statement
+    // query, see the comment of auto-batch mode in DbClient.
+    bool autoBatch{false};
+    // Execute the queries as server-side prepared statements, see the
+    // prepared_statements keyword of the connection string in DbClient.
+    bool preparedStatements{false};
+    size_t maxPreparedStatements{0};
+    unsigned int prepareThreshold{1};
+    // The statements prepared by each connection before it's used, if the
+    // prepared statements are enabled, see DbClient::newPgClient().
+    std::vector<std::string> warmupStatements;
 };
 
 struct Sqlite3Config
@@ -56,6 +106,29 @@ struct Sqlite3Config
     std::string filename;
     std::string name;
     double timeout;
+    // The journal mode set when the database is opened, e.g. "wal", empty to
+    // keep the one of the database.
+    std::string journalMode;
+    // The time in milliseconds to wait for a lock held by another process, 0
+    // to fail at once.
+    unsigned int busyTimeout{0};
+    // The pragmas set when the database is opened, see
+    // https://www.sqlite.org/pragma.html. The default values keep the ones of
+    // SQLite: the maximum number of bytes of the database mapped in memory,
+    // the size of the page cache in pages, or in KiB if it's negative, the
+    // synchronous mode, e.g. "normal", and the storage of the temporary
+    // tables, e.g. "memory".
+    uint64_t mmapSize{0};
+    int cacheSize{0};
+    std::string synchronous;
+    std::string tempStore;
+    // Open the database read-only without any lock nor any check of changes,
+    // for the files which are never modified while they are open.
+    bool immutable{false};
+    // The maximum number of prepared statements kept by each connection, 0
+    // for no limit. The statements without parameters are only kept when
+    // there is a limit.
+    size_t maxPreparedStatements{0};
 };
 
 using DbConfig = std::variant<PostgresConfig, MysqlConfig, Sqlite3Config>;
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <drogon/exports.h>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <memory>
@@ -50,6 +51,20 @@ class DROGON_EXPORT DbListener
     static DbListenerPtr newPgListener(const std::string &connInfo,
                                        trantor::EventLoop *loop = nullptr);
 
+    /// Get the postgresql notification listener shared by the process
+    /**
+     * @param connInfo: Connection string, the same as DbClient::newPgClient()
+     * @return DbListenerPtr The listener of the connection string, created
+     * with its own thread if there is none in use.
+     * @return nullptr if postgresql is not supported.
+     *
+     * @note All the channels of a shared listener are multiplexed over its
+     * single connection, the modules sharing it should use subscribe() and
+     * unsubscribe() rather than unlisten(), which cancels the callbacks of
+     * the other modules too.
+     */
+    static DbListenerPtr sharedPgListener(const std::string &connInfo);
+
     /// Listen to a channel
     /**
      * @param channel channel name to listen
@@ -74,6 +89,27 @@ class DROGON_EXPORT DbListener
      * @param channel channel to stop listening
      */
     virtual void unlisten(const std::string &channel) noexcept = 0;
+
+    /// Listen to a channel with a subscription which can be cancelled alone
+    /**
+     * @param channel channel name to listen
+     * @param messageCallback callback when notification arrives on channel
+     * @param loop: The event loop the callback is called in, e.g. an IO loop
+     * of the application. If empty, the callback is called in the loop of
+     * the listener.
+     * @return The id of the subscription, for unsubscribe().
+     *
+     * @note The channel is listened to by the database once, however many
+     * subscriptions it has.
+     */
+    virtual uint64_t subscribe(const std::string &channel,
+                               MessageCallback messageCallback,
+                               trantor::EventLoop *loop = nullptr) noexcept = 0;
+
+    /// Cancel a subscription, the channel is unlistened after its last
+    /// subscription is cancelled.
+    virtual void unsubscribe(const std::string &channel,
+                             uint64_t subscriptionId) noexcept = 0;
 };
 
 }  // namespace orm
@@ -39,6 +39,17 @@ namespace orm
 /**
  * A field represents one entry in a row.  It represents an actual value
  * in the result set, and can be converted to various types.
+ *
+ * When a PostgreSQL client is created with the binary results option, the
+ * values of the queries with parameters are received in the binary format of
+ * their types, once a previous result of the same query showed that all its
+ * columns are of the bool, integer, float, numeric, uuid, date, time,
+ * timestamp, json or text types. The others, e.g. the arrays, timestamptz
+ * or interval, keep the whole result in text. The as() functions decode the
+ * binary values directly, the numeric, uuid, date and time ones are
+ * converted to strings in the text format of the server. The bytea values are
+ * returned without any decoding. c_str(), length() and
+ * as<std::string_view>() give the raw bytes of the value.
  */
 class DROGON_EXPORT Field
 {
@@ -73,29 +84,13 @@ class DROGON_EXPORT Field
         if (isNull())
             return T();
         auto data_ = result_.getValue(row_, column_);
-        // auto dataLength_ = result_.getLength(row_, column_);
-        // For binary format!
-        // if (dataLength_ == 1)
-        // {
-        //     return *data_;
-        // }
-        // else if (dataLength_ == 4)
-        // {
-        //     const int32_t *n = (int32_t *)data_;
-        //     return ntohl(*n);
-        // }
-        // else if (dataLength_ == 8)
-        // {
-        //     const int64_t *n = (int64_t *)data_;
-        //     return ntohll(*n);
-        // }
-        // return 0;
         T value = T();
         if (data_)
         {
             try
             {
-                std::stringstream ss(data_);
+                std::stringstream ss(
+                    result_.isBinary(column_) ? binaryToText() : data_);
                 ss >> value;
             }
             catch (...)
@@ -106,6 +101,14 @@ class DROGON_EXPORT Field
         return value;
     }
 
+    /// Read the raw value without copying it
+    /**
+     * Same as as<std::string_view>(). The view points into the result set, it
+     * stays valid as long as a Result, Row or Field object of this result set
+     * is alive. A null value gives an empty view.
+     */
+    std::string_view asView() const;
+
     /// Parse the field as an SQL array.
     /**
      * Call the parser to retrieve values (and structure) from the array.
@@ -159,6 +162,11 @@ class DROGON_EXPORT Field
 
   private:
     const Result result_;
+
+    // Decode a value in the binary format
+    int64_t binaryInteger() const;
+    double binaryFloat() const;
+    std::string binaryToText() const;
 };
 
 template <>
@@ -178,11 +186,18 @@ inline std::string_view Field::as<std::string_view>() const
     return {first, length};
 }
 
+inline std::string_view Field::asView() const
+{
+    return as<std::string_view>();
+}
+
 template <>
 inline float Field::as<float>() const
 {
     if (isNull())
         return 0.0;
+    if (result_.isBinary(column_))
+        return static_cast<float>(binaryFloat());
     return std::stof(result_.getValue(row_, column_));
 }
 
@@ -191,6 +206,8 @@ inline double Field::as<double>() const
 {
     if (isNull())
         return 0.0;
+    if (result_.isBinary(column_))
+        return binaryFloat();
     return std::stod(result_.getValue(row_, column_));
 }
 
@@ -202,6 +219,8 @@ inline bool Field::as<bool>() const
         return false;
     }
     auto value = result_.getValue(row_, column_);
+    if (result_.isBinary(column_))
+        return *value != 0;
     if (*value == 't' || *value == '1')
         return true;
     return false;
@@ -212,6 +231,8 @@ inline int Field::as<int>() const
 {
     if (isNull())
         return 0;
+    if (result_.isBinary(column_))
+        return static_cast<int>(binaryInteger());
     return std::stoi(result_.getValue(row_, column_));
 }
 
@@ -220,6 +241,8 @@ inline long Field::as<long>() const
 {
     if (isNull())
         return 0;
+    if (result_.isBinary(column_))
+        return static_cast<long>(binaryInteger());
     return std::stol(result_.getValue(row_, column_));
 }
 
@@ -228,6 +251,8 @@ inline int8_t Field::as<int8_t>() const
 {
     if (isNull())
         return 0;
+    if (result_.isBinary(column_))
+        return static_cast<int8_t>(binaryInteger());
     return static_cast<int8_t>(atoi(result_.getValue(row_, column_)));
 }
 
@@ -236,6 +261,8 @@ inline long long Field::as<long long>() const
 {
     if (isNull())
         return 0;
+    if (result_.isBinary(column_))
+        return static_cast<long long>(binaryInteger());
     return atoll(result_.getValue(row_, column_));
 }
 
@@ -244,6 +271,8 @@ inline unsigned int Field::as<unsigned int>() const
 {
     if (isNull())
         return 0;
+    if (result_.isBinary(column_))
+        return static_cast<unsigned int>(binaryInteger());
     return static_cast<unsigned int>(
         std::stoul(result_.getValue(row_, column_)));
 }
@@ -253,6 +282,8 @@ inline unsigned long Field::as<unsigned long>() const
 {
     if (isNull())
         return 0;
+    if (result_.isBinary(column_))
+        return static_cast<unsigned long>(binaryInteger());
     return std::stoul(result_.getValue(row_, column_));
 }
 
@@ -261,6 +292,8 @@ inline uint8_t Field::as<uint8_t>() const
 {
     if (isNull())
         return 0;
+    if (result_.isBinary(column_))
+        return static_cast<uint8_t>(binaryInteger());
     return static_cast<uint8_t>(atoi(result_.getValue(row_, column_)));
 }
 
@@ -269,6 +302,8 @@ inline unsigned long long Field::as<unsigned long long>() const
 {
     if (isNull())
         return 0;
+    if (result_.isBinary(column_))
+        return static_cast<unsigned long long>(binaryInteger());
     return std::stoull(result_.getValue(row_, column_));
 }
 
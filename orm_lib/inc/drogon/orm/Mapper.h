@@ -17,8 +17,13 @@
 #include <drogon/orm/BaseBuilder.h>
 #include <drogon/orm/DbClient.h>
 #include <drogon/utils/Utilities.h>
+#include <algorithm>
+#include <functional>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #ifdef _WIN32
@@ -172,6 +177,48 @@ class Mapper
      */
     Mapper<T> &paginate(size_t page, size_t perPage);
 
+    /**
+     * @brief Set the keyset (seek) pagination: the findBy() and findAll()
+     * methods return the perPage rows following the row whose values of the
+     * columns set by orderBy() are lastValues, in the same order, instead of
+     * skipping the rows of the previous pages with an offset. Without values,
+     * the first page is returned.
+     * This method overrides limit() and offset().
+     *
+     * @param perPage The number of rows per page
+     * @param lastValues The values of the order columns of the last row of
+     * the previous page, as many as the order columns.
+     * @return Mapper<T>& The Mapper itself.
+     *
+     * @note The order columns must not be null, and the last one unique,
+     * e.g. the primary key, so that no row is skipped or repeated.
+     */
+    template <typename... Values,
+              typename = std::enable_if_t<
+                  !(std::is_same_v<std::decay_t<Values>,
+                                   std::vector<std::string>> ||
+                    ...)>>
+    Mapper<T> &paginateAfter(size_t perPage, Values &&...lastValues)
+    {
+        seekValues_.clear();
+        (seekValues_.emplace_back(
+             [value = std::decay_t<Values>(std::forward<Values>(lastValues))](
+                 const std::string &colName, CompareOperator opera) {
+                 return Criteria(colName, opera, value);
+             }),
+         ...);
+        limit(perPage);
+        offset_ = 0;
+        return *this;
+    }
+
+    /**
+     * @brief Set the keyset (seek) pagination with the values in text, e.g.
+     * decoded from a cursor sent by a client.
+     */
+    Mapper<T> &paginateAfter(size_t perPage,
+                             const std::vector<std::string> &lastValues);
+
     /**
      * @brief Lock the result for updating.
      *
@@ -179,6 +226,17 @@ class Mapper
      */
     Mapper<T> &forUpdate();
 
+    /**
+     * @brief Select only the given columns in the find methods, e.g. to read
+     * the fields requested by a client instead of the whole rows of a wide
+     * table. The members of the models found for the other columns are null.
+     * All the columns are selected by default.
+     *
+     * @param colNames The names of the columns of the table.
+     * @return Mapper<T>& The Mapper itself.
+     */
+    Mapper<T> &columns(const std::vector<std::string> &colNames);
+
     /**
      * @brief Add an INNER JOIN clause to the query.
      *
@@ -279,7 +337,7 @@ class Mapper
                 "make sure that the model class is generated by the latest "
                 "version of drogon_ctl");
             // return findOne(Criteria(T::primaryKeyName, key));
-            std::string sql = T::sqlForFindingByPrimaryKey();
+            std::string sql = sqlForFindingByPrimaryKey();
             if (forUpdate_)
             {
                 sql += " for update";
@@ -287,7 +345,7 @@ class Mapper
             clear();
             Result r(nullptr);
             {
-                auto binder = *client_ << std::move(sql);
+                auto binder = makeBinder(std::move(sql));
                 outputPrimaryKeyToBinder(key, binder);
                 binder << Mode::Blocking;
                 binder >> [&r](const Result &result) { r = result; };
@@ -333,13 +391,13 @@ class Mapper
                 "make sure that the model class is generated by the latest "
                 "version of drogon_ctl");
             // findOne(Criteria(T::primaryKeyName, key), rcb, ecb);
-            std::string sql = T::sqlForFindingByPrimaryKey();
+            std::string sql = sqlForFindingByPrimaryKey();
             if (forUpdate_)
             {
                 sql += " for update";
             }
             clear();
-            auto binder = *client_ << std::move(sql);
+            auto binder = makeBinder(std::move(sql));
             outputPrimaryKeyToBinder(key, binder);
             binder >> [ecb, rcb](const Result &r) {
                 if (r.size() == 0)
@@ -387,13 +445,13 @@ class Mapper
                 "make sure that the model class is generated by the latest "
                 "version of drogon_ctl");
             // return findFutureOne(Criteria(T::primaryKeyName, key));
-            std::string sql = T::sqlForFindingByPrimaryKey();
+            std::string sql = sqlForFindingByPrimaryKey();
             if (forUpdate_)
             {
                 sql += " for update";
             }
             clear();
-            auto binder = *client_ << std::move(sql);
+            auto binder = makeBinder(std::move(sql));
             outputPrimaryKeyToBinder(key, binder);
 
             std::shared_ptr<std::promise<T>> prom =
@@ -571,6 +629,114 @@ class Mapper
      */
     std::future<T> insertFuture(const T &) noexcept;
 
+    /**
+     * @brief Insert rows into the table with multi-row insert statements.
+     *
+     * @param objs The objects to be inserted.
+     * @param maxParameters The maximum number of parameters of a statement,
+     * zero for the limit of the database.
+     * @note Consecutive objects with the same columns to be inserted share a
+     * statement, which is executed in the order of the objects. The
+     * statements aren't in a transaction unless the client of the mapper is
+     * one.
+     * @note The auto-increased primary keys (if they exist) are set to the
+     * objects after the method returns. On PostgreSQL the rows returned by
+     * the server replace the objects. On MySQL and Sqlite3 the keys of the
+     * rows of a statement are assumed consecutive, which holds unless the
+     * keys are given or, on MySQL, the innodb_autoinc_lock_mode is 2, and
+     * the columns filled by the server aren't read back.
+     */
+    void insertBatch(std::vector<T> &objs,
+                     size_t maxParameters = 0) noexcept(false);
+
+    /**
+     * @brief Asynchronously insert rows into the table with multi-row insert
+     * statements.
+     *
+     * @param objs The objects to be inserted.
+     * @param rcb is called with the inserted objects, see the synchronous
+     * version.
+     * @param ecb is called when an error occurs, the statements after the
+     * failed one aren't executed.
+     * @param maxParameters The maximum number of parameters of a statement,
+     * zero for the limit of the database.
+     */
+    void insertBatch(const std::vector<T> &objs,
+                     const MultipleRowsCallback &rcb,
+                     const ExceptionCallback &ecb,
+                     size_t maxParameters = 0) noexcept;
+
+    /**
+     * @brief Insert a row into the table, or update the row conflicting with
+     * it, in one statement.
+     *
+     * @param obj The object to be inserted.
+     * @param conflictColumns The columns of the unique constraint the row may
+     * conflict with, empty for the primary key. Ignored on MySQL, where any
+     * unique key is checked.
+     * @return size_t The number of affected rows. On MySQL an updated row
+     * counts as 2, and an unchanged one as 0.
+     * @note The columns the object would insert are updated, except those of
+     * the constraint and those filled by the server (e.g. the auto-increased
+     * ones). Such columns aren't part of the conflict, so a model whose
+     * primary key is auto-increased should give other conflict columns. The
+     * object isn't read back.
+     */
+    size_t upsert(
+        const T &obj,
+        const std::vector<std::string> &conflictColumns = {}) noexcept(false);
+
+    /**
+     * @brief Asynchronously insert or update a row in one statement.
+     *
+     * @param obj The object to be inserted.
+     * @param rcb is called with the number of affected rows, see the
+     * synchronous version.
+     * @param ecb is called when an error occurs.
+     * @param conflictColumns The columns of the unique constraint, empty for
+     * the primary key.
+     */
+    void upsert(const T &obj,
+                const CountCallback &rcb,
+                const ExceptionCallback &ecb,
+                const std::vector<std::string> &conflictColumns = {}) noexcept;
+
+    /**
+     * @brief Insert or update rows with multi-row statements, like
+     * upsert() for each object.
+     *
+     * @param objs The objects to be inserted.
+     * @param conflictColumns The columns of the unique constraint, empty for
+     * the primary key.
+     * @param maxParameters The maximum number of parameters of a statement,
+     * zero for the limit of the database.
+     * @return size_t The number of affected rows.
+     * @note The objects are grouped in statements like in insertBatch(). Two
+     * objects of a statement must not conflict with each other on
+     * PostgreSQL.
+     */
+    size_t upsertBatch(const std::vector<T> &objs,
+                       const std::vector<std::string> &conflictColumns = {},
+                       size_t maxParameters = 0) noexcept(false);
+
+    /**
+     * @brief Asynchronously insert or update rows with multi-row statements.
+     *
+     * @param objs The objects to be inserted.
+     * @param rcb is called with the number of affected rows.
+     * @param ecb is called when an error occurs, the statements after the
+     * failed one aren't executed.
+     * @param conflictColumns The columns of the unique constraint, empty for
+     * the primary key.
+     * @param maxParameters The maximum number of parameters of a statement,
+     * zero for the limit of the database.
+     */
+    void upsertBatch(const std::vector<T> &objs,
+                     const CountCallback &rcb,
+                     const ExceptionCallback &ecb,
+                     const std::vector<std::string> &conflictColumns = {},
+                     size_t maxParameters = 0) noexcept;
+
     /**
      * @brief Update a record.
      *
@@ -602,6 +768,38 @@ class Mapper
      */
     std::future<size_t> updateFuture(const T &obj) noexcept;
 
+    /**
+     * @brief Update records by their primary keys with multi-row update
+     * statements.
+     *
+     * @param objs The records.
+     * @param maxParameters The maximum number of parameters of a statement,
+     * zero for the limit of the database.
+     * @return size_t The number of updated records.
+     * @note The table must have a primary key, which must not be modified.
+     * Consecutive objects updating the same columns share a statement, the
+     * objects without modified columns are skipped. The statements aren't in
+     * a transaction unless the client of the mapper is one. On MySQL, the
+     * records whose values don't change aren't counted.
+     */
+    size_t updateBatch(const std::vector<T> &objs,
+                       size_t maxParameters = 0) noexcept(false);
+
+    /**
+     * @brief Asynchronously update records with multi-row update statements.
+     *
+     * @param objs The records.
+     * @param rcb is called with the number of updated records.
+     * @param ecb is called when an error occurs, the statements after the
+     * failed one aren't executed.
+     * @param maxParameters The maximum number of parameters of a statement,
+     * zero for the limit of the database.
+     */
+    void updateBatch(const std::vector<T> &objs,
+                     const CountCallback &rcb,
+                     const ExceptionCallback &ecb,
+                     size_t maxParameters = 0) noexcept;
+
     /**
      * @brief Update a record that match both the primary key and the given
      * criteria.
@@ -793,17 +991,72 @@ class Mapper
     size_t offset_{0};
     std::string orderByString_;
     std::string joinString_;
+    std::string columnsString_;
     bool forUpdate_{false};
+    std::vector<std::pair<std::string, SortOrder>> orderColumns_;
+    // Make the comparisons of the order columns to the values set by
+    // paginateAfter().
+    std::vector<
+        std::function<Criteria(const std::string &, CompareOperator)>>
+        seekValues_;
 
     void clear()
     {
         limit_ = 0;
         offset_ = 0;
         orderByString_.clear();
+        orderColumns_.clear();
+        seekValues_.clear();
         joinString_.clear();
+        columnsString_.clear();
         forUpdate_ = false;
     }
 
+    /// The "select ... from " of the columns set by columns().
+    std::string selectClause() const
+    {
+        if (columnsString_.empty())
+            return "select * from ";
+        return "select " + columnsString_ + " from ";
+    }
+
+    /// The query of the model by the primary key, with the columns set by
+    /// columns().
+    std::string sqlForFindingByPrimaryKey() const
+    {
+        const std::string &sql = T::sqlForFindingByPrimaryKey();
+        constexpr std::string_view selectAll = "select * from ";
+        if (columnsString_.empty() ||
+            sql.compare(0, selectAll.length(), selectAll) != 0)
+            return sql;
+        return selectClause() + sql.substr(selectAll.length());
+    }
+
+    /**
+     * @brief Make the criteria of the rows after the values set by
+     * paginateAfter(), which are cleared:
+     * (c1 > v1) or (c1 = v1 and c2 > v2) or ..., with < for the columns in
+     * descending order.
+     */
+    Criteria takeSeekCriteria()
+    {
+        assert(seekValues_.size() == orderColumns_.size());
+        Criteria ret;
+        Criteria equal;
+        for (size_t i = 0; i < seekValues_.size(); ++i)
+        {
+            auto &column = orderColumns_[i];
+            auto after = seekValues_[i](column.first,
+                                        column.second == SortOrder::DESC
+                                            ? CompareOperator::LT
+                                            : CompareOperator::GT);
+            ret = ret || (equal && after);
+            equal = equal && seekValues_[i](column.first, CompareOperator::EQ);
+        }
+        seekValues_.clear();
+        return ret;
+    }
+
     template <typename PKType = decltype(T::primaryKeyName)>
     void makePrimaryKeyCriteria(std::string &sql)
     {
@@ -830,8 +1083,8 @@ class Mapper
     }
 
     template <typename PKType = decltype(T::primaryKeyName)>
-    void outputPrimaryKeyToBinder(const TraitsPKType &pk,
-                                  internal::SqlBinder &binder)
+    static void outputPrimaryKeyToBinder(const TraitsPKType &pk,
+                                         internal::SqlBinder &binder)
     {
         if constexpr (std::is_same_v<const std::string, PKType>)
         {
@@ -845,7 +1098,7 @@ class Mapper
     }
 
     template <typename TP, ssize_t N = std::tuple_size<TP>::value>
-    void tupleToBinder(const TP &t, internal::SqlBinder &binder)
+    static void tupleToBinder(const TP &t, internal::SqlBinder &binder)
     {
         if constexpr (N > 1)
         {
@@ -860,43 +1113,122 @@ class Mapper
 
     std::string replaceSqlPlaceHolder(const std::string &sqlStr,
                                       const std::string &holderStr) const;
+
+    /**
+     * @brief Return a binder of the SQL statement whose placeholders are $?.
+     * The statements converted for the type of the client are cached by all
+     * the mappers of the model, a statement is converted at most once and
+     * then bound without being copied.
+     */
+    internal::SqlBinder makeBinder(std::string &&sql) const;
+
+    // Also the statements of upsertBatch() and updateBatch().
+    struct InsertStatement
+    {
+        std::string sql;
+        // The range of the objects inserted by the statement.
+        size_t begin;
+        size_t end;
+        bool needSelection;
+    };
+
+    struct InsertBatchState
+    {
+        std::vector<T> objs;
+        std::vector<InsertStatement> statements;
+        size_t next{0};
+        MultipleRowsCallback callback;
+        ExceptPtrCallback exceptCallback;
+    };
+
+    // The statements of upsertBatch() and updateBatch(), which return the
+    // numbers of affected rows.
+    struct CountBatchState
+    {
+        std::vector<T> objs;
+        std::vector<InsertStatement> statements;
+        bool isUpdate{false};
+        size_t next{0};
+        size_t count{0};
+        CountCallback callback;
+        ExceptPtrCallback exceptCallback;
+    };
+
+    // The statements upsert the rows when the conflict columns are given.
+    std::vector<InsertStatement> makeInsertStatements(
+        const std::vector<T> &objs,
+        size_t maxParameters,
+        const std::vector<std::string> *conflictColumns = nullptr) const;
+    std::string makeUpsertClause(
+        std::string_view columns,
+        std::string_view values,
+        const std::vector<std::string> &conflictColumns) const;
+    std::vector<InsertStatement> makeUpdateStatements(
+        const std::vector<T> &objs,
+        size_t maxParameters) const;
+    std::string makeUpdateSql(const std::vector<std::string> &keys,
+                              const std::vector<std::string> &columns,
+                              size_t rowsCount) const;
+    static std::vector<std::string> primaryKeyColumns();
+    static void outputBatchArgs(const std::vector<T> &objs,
+                                const InsertStatement &statement,
+                                bool isUpdate,
+                                internal::SqlBinder &binder);
+    size_t execCountStatements(const std::vector<T> &objs,
+                               std::vector<InsertStatement> &statements,
+                               bool isUpdate);
+    void upsertBatchAsync(const std::vector<T> &objs,
+                          const std::vector<std::string> &conflictColumns,
+                          size_t maxParameters,
+                          CountCallback &&rcb,
+                          ExceptPtrCallback &&ecb) noexcept;
+    void updateBatchAsync(const std::vector<T> &objs,
+                          size_t maxParameters,
+                          CountCallback &&rcb,
+                          ExceptPtrCallback &&ecb) noexcept;
+    static void execNextCount(const DbClientPtr &client,
+                              const std::shared_ptr<CountBatchState> &state);
+    static void updateInsertedObjects(ClientType type,
+                                      std::vector<T> &objs,
+                                      const InsertStatement &statement,
+                                      const Result &r);
+    void insertBatchAsync(const std::vector<T> &objs,
+                          MultipleRowsCallback &&rcb,
+                          ExceptPtrCallback &&ecb,
+                          size_t maxParameters) noexcept;
+    static void execNextInsert(const DbClientPtr &client,
+                               const std::shared_ptr<InsertBatchState> &state);
 };
 
 template <typename T>
 inline T Mapper<T>::findOne(const Criteria &criteria) noexcept(false)
 {
-    std::string sql = "select * from ";
+    std::string sql = selectClause();
     sql += T::tableName;
     sql += joinString_;
-    bool hasParameters = false;
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
-        hasParameters = true;
+        sql += criteria.criteriaString(client_->type());
     }
     sql.append(orderByString_);
     if (limit_ > 0)
     {
-        hasParameters = true;
         sql.append(" limit $?");
     }
     if (offset_ > 0)
     {
-        hasParameters = true;
         sql.append(" offset $?");
     }
-    if (hasParameters)
-        sql = replaceSqlPlaceHolder(sql, "$?");
     if (forUpdate_)
     {
         sql += " for update";
     }
     Result r(nullptr);
     {
-        auto binder = *client_ << std::move(sql);
+        auto binder = makeBinder(std::move(sql));
         if (criteria)
-            criteria.outputArgs(binder);
+            criteria.outputArgs(binder, client_->type());
         if (limit_ > 0)
             binder << limit_;
         if (offset_)
@@ -923,36 +1255,30 @@ inline void Mapper<T>::findOne(const Criteria &criteria,
                                const SingleRowCallback &rcb,
                                const ExceptionCallback &ecb) noexcept
 {
-    std::string sql = "select * from ";
+    std::string sql = selectClause();
     sql += T::tableName;
     sql += joinString_;
-    bool hasParameters = false;
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
-        hasParameters = true;
+        sql += criteria.criteriaString(client_->type());
     }
     sql.append(orderByString_);
     if (limit_ > 0)
     {
-        hasParameters = true;
         sql.append(" limit $?");
     }
     if (offset_ > 0)
     {
-        hasParameters = true;
         sql.append(" offset $?");
     }
-    if (hasParameters)
-        sql = replaceSqlPlaceHolder(sql, "$?");
     if (forUpdate_)
     {
         sql += " for update";
     }
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     if (criteria)
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
     if (limit_ > 0)
         binder << limit_;
     if (offset_)
@@ -979,36 +1305,30 @@ template <typename T>
 inline std::future<T> Mapper<T>::findFutureOne(
     const Criteria &criteria) noexcept
 {
-    std::string sql = "select * from ";
+    std::string sql = selectClause();
     sql += T::tableName;
     sql += joinString_;
-    bool hasParameters = false;
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
-        hasParameters = true;
+        sql += criteria.criteriaString(client_->type());
     }
     sql.append(orderByString_);
     if (limit_ > 0)
     {
-        hasParameters = true;
         sql.append(" limit $?");
     }
     if (offset_ > 0)
     {
-        hasParameters = true;
         sql.append(" offset $?");
     }
-    if (hasParameters)
-        sql = replaceSqlPlaceHolder(sql, "$?");
     if (forUpdate_)
     {
         sql += " for update";
     }
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     if (criteria)
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
     if (limit_ > 0)
         binder << limit_;
     if (offset_)
@@ -1040,38 +1360,34 @@ template <typename T>
 inline std::vector<T> Mapper<T>::findBy(const Criteria &criteria) noexcept(
     false)
 {
-    std::string sql = "select * from ";
+    if (!seekValues_.empty())
+        return findBy(criteria && takeSeekCriteria());
+    std::string sql = selectClause();
     sql += T::tableName;
     sql += joinString_;
-    bool hasParameters = false;
     if (criteria)
     {
-        hasParameters = true;
         sql += " where ";
-        sql += criteria.criteriaString();
+        sql += criteria.criteriaString(client_->type());
     }
     sql.append(orderByString_);
     if (limit_ > 0)
     {
-        hasParameters = true;
         sql.append(" limit $?");
     }
     if (offset_ > 0)
     {
-        hasParameters = true;
         sql.append(" offset $?");
     }
-    if (hasParameters)
-        sql = replaceSqlPlaceHolder(sql, "$?");
     if (forUpdate_)
     {
         sql += " for update";
     }
     Result r(nullptr);
     {
-        auto binder = *client_ << std::move(sql);
+        auto binder = makeBinder(std::move(sql));
         if (criteria)
-            criteria.outputArgs(binder);
+            criteria.outputArgs(binder, client_->type());
         if (limit_ > 0)
             binder << limit_;
         if (offset_)
@@ -1095,36 +1411,35 @@ inline void Mapper<T>::findBy(const Criteria &criteria,
                               const MultipleRowsCallback &rcb,
                               const ExceptionCallback &ecb) noexcept
 {
-    std::string sql = "select * from ";
+    if (!seekValues_.empty())
+    {
+        findBy(criteria && takeSeekCriteria(), rcb, ecb);
+        return;
+    }
+    std::string sql = selectClause();
     sql += T::tableName;
     sql += joinString_;
-    bool hasParameters = false;
     if (criteria)
     {
-        hasParameters = true;
         sql += " where ";
-        sql += criteria.criteriaString();
+        sql += criteria.criteriaString(client_->type());
     }
     sql.append(orderByString_);
     if (limit_ > 0)
     {
-        hasParameters = true;
         sql.append(" limit $?");
     }
     if (offset_ > 0)
     {
-        hasParameters = true;
         sql.append(" offset $?");
     }
-    if (hasParameters)
-        sql = replaceSqlPlaceHolder(sql, "$?");
     if (forUpdate_)
     {
         sql += " for update";
     }
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     if (criteria)
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
     if (limit_ > 0)
         binder << limit_;
     if (offset_)
@@ -1146,36 +1461,32 @@ template <typename T>
 inline std::future<std::vector<T>> Mapper<T>::findFutureBy(
     const Criteria &criteria) noexcept
 {
-    std::string sql = "select * from ";
+    if (!seekValues_.empty())
+        return findFutureBy(criteria && takeSeekCriteria());
+    std::string sql = selectClause();
     sql += T::tableName;
     sql += joinString_;
-    bool hasParameters = false;
     if (criteria)
     {
-        hasParameters = true;
         sql += " where ";
-        sql += criteria.criteriaString();
+        sql += criteria.criteriaString(client_->type());
     }
     sql.append(orderByString_);
     if (limit_ > 0)
     {
-        hasParameters = true;
         sql.append(" limit $?");
     }
     if (offset_ > 0)
     {
-        hasParameters = true;
         sql.append(" offset $?");
     }
-    if (hasParameters)
-        sql = replaceSqlPlaceHolder(sql, "$?");
     if (forUpdate_)
     {
         sql += " for update";
     }
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     if (criteria)
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
     if (limit_ > 0)
         binder << limit_;
     if (offset_)
@@ -1225,15 +1536,14 @@ inline size_t Mapper<T>::count(const Criteria &criteria) noexcept(false)
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
-        sql = replaceSqlPlaceHolder(sql, "$?");
+        sql += criteria.criteriaString(client_->type());
     }
     clear();
     Result r(nullptr);
     {
-        auto binder = *client_ << std::move(sql);
+        auto binder = makeBinder(std::move(sql));
         if (criteria)
-            criteria.outputArgs(binder);
+            criteria.outputArgs(binder, client_->type());
         binder << Mode::Blocking;
         binder >> [&r](const Result &result) { r = result; };
         binder.exec();  // exec may be throw exception;
@@ -1253,13 +1563,12 @@ inline void Mapper<T>::count(const Criteria &criteria,
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
-        sql = replaceSqlPlaceHolder(sql, "$?");
+        sql += criteria.criteriaString(client_->type());
     }
     clear();
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     if (criteria)
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
     binder >> [rcb](const Result &r) {
         assert(r.size() == 1);
         rcb(r[0][(Row::SizeType)0].as<size_t>());
@@ -1277,13 +1586,12 @@ inline std::future<size_t> Mapper<T>::countFuture(
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
-        sql = replaceSqlPlaceHolder(sql, "$?");
+        sql += criteria.criteriaString(client_->type());
     }
     clear();
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     if (criteria)
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
 
     std::shared_ptr<std::promise<size_t>> prom =
         std::make_shared<std::promise<size_t>>();
@@ -1423,6 +1731,634 @@ inline std::future<T> Mapper<T>::insertFuture(const T &obj) noexcept
     return prom->get_future();
 }
 
+template <typename T>
+inline void Mapper<T>::insertBatch(std::vector<T> &objs,
+                                   size_t maxParameters) noexcept(false)
+{
+    clear();
+    auto statements = makeInsertStatements(objs, maxParameters);
+    for (auto &statement : statements)
+    {
+        Result r(nullptr);
+        {
+            auto binder = *client_ << std::move(statement.sql);
+            for (size_t i = statement.begin; i < statement.end; ++i)
+            {
+                objs[i].outputArgs(binder);
+            }
+            binder << Mode::Blocking;
+            binder >> [&r](const Result &result) { r = result; };
+            binder.exec();  // Maybe throw exception;
+        }
+        updateInsertedObjects(client_->type(), objs, statement, r);
+    }
+}
+
+template <typename T>
+inline void Mapper<T>::insertBatch(const std::vector<T> &objs,
+                                   const MultipleRowsCallback &rcb,
+                                   const ExceptionCallback &ecb,
+                                   size_t maxParameters) noexcept
+{
+    insertBatchAsync(
+        objs,
+        MultipleRowsCallback(rcb),
+        [ecb](const std::exception_ptr &ePtr) {
+            try
+            {
+                std::rethrow_exception(ePtr);
+            }
+            catch (const DrogonDbException &e)
+            {
+                ecb(e);
+            }
+        },
+        maxParameters);
+}
+
+template <typename T>
+inline std::vector<typename Mapper<T>::InsertStatement>
+Mapper<T>::makeInsertStatements(
+    const std::vector<T> &objs,
+    size_t maxParameters,
+    const std::vector<std::string> *conflictColumns) const
+{
+    auto type = client_->type();
+    if (maxParameters == 0)
+    {
+        maxParameters = type == ClientType::Sqlite3 ? 999 : 65535;
+    }
+    auto placeholder = type == ClientType::PostgreSQL ? '$' : '?';
+    std::vector<InsertStatement> statements;
+    std::string head;
+    std::string tail;
+    size_t parametersCount = 0;
+    for (size_t i = 0; i < objs.size(); ++i)
+    {
+        // The sql is "insert into table (columns) values (placeholders)",
+        // followed by " returning *" on PostgreSQL if needed.
+        bool needSelection = false;
+        auto sql = objs[i].sqlForInserting(needSelection);
+        auto valuesPos = sql.find(" values (");
+        assert(valuesPos != std::string::npos);
+        auto tuplePos = valuesPos + 8;
+        auto tupleEnd = sql.rfind(')') + 1;
+        std::string_view tuple(sql.data() + tuplePos, tupleEnd - tuplePos);
+        // Rows without parameters count as one to bound their number.
+        auto count = (std::max)(
+            (size_t)std::count(tuple.begin(), tuple.end(), placeholder),
+            (size_t)1);
+        std::string ending;
+        if (conflictColumns)
+        {
+            // The conflict clause replaces the returning clause, the upserted
+            // rows aren't read back.
+            auto columnsPos = sql.find('(', 12 + T::tableName.length()) + 1;
+            ending = makeUpsertClause(
+                std::string_view(sql.data() + columnsPos,
+                                 valuesPos - 1 - columnsPos),
+                tuple.substr(1, tuple.length() - 2),
+                *conflictColumns);
+            needSelection = false;
+        }
+        else
+        {
+            ending = sql.substr(tupleEnd);
+        }
+        if (statements.empty() || sql.compare(0, tuplePos, head) != 0 ||
+            ending != tail || parametersCount + count > maxParameters)
+        {
+            if (!statements.empty())
+            {
+                statements.back().sql.append(tail);
+            }
+            head = sql.substr(0, tuplePos);
+            tail = std::move(ending);
+            statements.push_back({head, i, i, needSelection});
+            parametersCount = 0;
+        }
+        else
+        {
+            statements.back().sql.append(1, ',');
+        }
+        auto &statementSql = statements.back().sql;
+        if (type == ClientType::PostgreSQL && parametersCount > 0)
+        {
+            // Renumber the placeholders after those of the previous rows.
+            for (size_t j = 0; j < tuple.length(); ++j)
+            {
+                statementSql.append(1, tuple[j]);
+                if (tuple[j] != '$')
+                    continue;
+                size_t number = 0;
+                while (j + 1 < tuple.length() && tuple[j + 1] >= '0' &&
+                       tuple[j + 1] <= '9')
+                {
+                    number = number * 10 + (tuple[++j] - '0');
+                }
+                statementSql.append(std::to_string(number + parametersCount));
+            }
+        }
+        else
+        {
+            statementSql.append(tuple);
+        }
+        parametersCount += count;
+        statements.back().end = i + 1;
+    }
+    if (!statements.empty())
+    {
+        statements.back().sql.append(tail);
+    }
+    return statements;
+}
+
+template <typename T>
+inline void Mapper<T>::updateInsertedObjects(ClientType type,
+                                             std::vector<T> &objs,
+                                             const InsertStatement &statement,
+                                             const Result &r)
+{
+    auto rowsCount = statement.end - statement.begin;
+    assert(r.affectedRows() == rowsCount);
+    if (type == ClientType::PostgreSQL)
+    {
+        if (statement.needSelection)
+        {
+            assert(r.size() == rowsCount);
+            for (size_t i = 0; i < rowsCount; ++i)
+            {
+                objs[statement.begin + i] = T(r[i]);
+            }
+        }
+        return;
+    }
+    // Mysql returns the first id of the statement, Sqlite3 the last one.
+    auto id = r.insertId();
+    if (type == ClientType::Sqlite3)
+    {
+        id -= rowsCount - 1;
+    }
+    for (size_t i = 0; i < rowsCount; ++i)
+    {
+        objs[statement.begin + i].updateId(id + i);
+    }
+}
+
+template <typename T>
+inline void Mapper<T>::insertBatchAsync(const std::vector<T> &objs,
+                                        MultipleRowsCallback &&rcb,
+                                        ExceptPtrCallback &&ecb,
+                                        size_t maxParameters) noexcept
+{
+    clear();
+    auto state = std::make_shared<InsertBatchState>();
+    state->objs = objs;
+    state->statements = makeInsertStatements(objs, maxParameters);
+    state->callback = std::move(rcb);
+    state->exceptCallback = std::move(ecb);
+    execNextInsert(client_, state);
+}
+
+template <typename T>
+inline void Mapper<T>::execNextInsert(
+    const DbClientPtr &client,
+    const std::shared_ptr<InsertBatchState> &state)
+{
+    if (state->next == state->statements.size())
+    {
+        state->callback(std::move(state->objs));
+        return;
+    }
+    auto index = state->next++;
+    auto &statement = state->statements[index];
+    auto binder = *client << std::move(statement.sql);
+    for (size_t i = statement.begin; i < statement.end; ++i)
+    {
+        state->objs[i].outputArgs(binder);
+    }
+    binder >> [client, state, index](const Result &r) {
+        updateInsertedObjects(client->type(),
+                              state->objs,
+                              state->statements[index],
+                              r);
+        execNextInsert(client, state);
+    };
+    binder >> [state](const std::exception_ptr &ePtr) {
+        state->exceptCallback(ePtr);
+    };
+}
+
+template <typename T>
+inline std::string Mapper<T>::makeUpsertClause(
+    std::string_view columns,
+    std::string_view values,
+    const std::vector<std::string> &conflictColumns) const
+{
+    auto keys =
+        conflictColumns.empty() ? primaryKeyColumns() : conflictColumns;
+    assert(!keys.empty());
+    auto isMysql = client_->type() == ClientType::Mysql;
+    std::string clause;
+    while (!columns.empty())
+    {
+        auto columnEnd = (std::min)(columns.find(','), columns.length());
+        auto valueEnd = (std::min)(values.find(','), values.length());
+        auto column = columns.substr(0, columnEnd);
+        auto value = values.substr(0, valueEnd);
+        columns.remove_prefix((std::min)(columnEnd + 1, columns.length()));
+        values.remove_prefix((std::min)(valueEnd + 1, values.length()));
+        // The columns filled by the server and those of the conflict are
+        // kept.
+        if (value == "default" ||
+            std::find(keys.begin(), keys.end(), column) != keys.end())
+            continue;
+        if (!clause.empty())
+            clause += ',';
+        else if (isMysql)
+            clause = " on duplicate key update ";
+        else
+            clause = " do update set ";
+        clause.append(column);
+        if (isMysql)
+        {
+            clause += " = values(";
+            clause.append(column);
+            clause += ')';
+        }
+        else
+        {
+            clause += " = excluded.";
+            clause.append(column);
+        }
+    }
+    if (isMysql)
+    {
+        if (clause.empty())
+        {
+            // Nothing to update, the row is kept as it is.
+            clause = " on duplicate key update ";
+            clause += keys[0];
+            clause += " = ";
+            clause += keys[0];
+        }
+        return clause;
+    }
+    std::string target = " on conflict (";
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (i > 0)
+            target += ',';
+        target += keys[i];
+    }
+    target += ')';
+    target += clause.empty() ? " do nothing" : clause;
+    return target;
+}
+
+template <typename T>
+inline std::vector<typename Mapper<T>::InsertStatement>
+Mapper<T>::makeUpdateStatements(const std::vector<T> &objs,
+                                size_t maxParameters) const
+{
+    static_assert(!std::is_same_v<typename T::PrimaryKeyType, void>,
+                  "No primary key in the table!");
+    if (maxParameters == 0)
+    {
+        maxParameters = client_->type() == ClientType::Sqlite3 ? 999 : 65535;
+    }
+    auto keys = primaryKeyColumns();
+    std::vector<InsertStatement> statements;
+    size_t begin = 0;
+    while (begin < objs.size())
+    {
+        auto columns = objs[begin].updateColumns();
+        if (columns.empty())
+        {
+            ++begin;
+            continue;
+        }
+        auto rowParameters = keys.size() + columns.size();
+        auto end = begin + 1;
+        while (end < objs.size() &&
+               (end - begin + 1) * rowParameters <= maxParameters &&
+               objs[end].updateColumns() == columns)
+        {
+            ++end;
+        }
+        statements.push_back(
+            {makeUpdateSql(keys, columns, end - begin), begin, end, false});
+        begin = end;
+    }
+    return statements;
+}
+
+template <typename T>
+inline std::string Mapper<T>::makeUpdateSql(
+    const std::vector<std::string> &keys,
+    const std::vector<std::string> &columns,
+    size_t rowsCount) const
+{
+    // The parameters of every row are its primary key and then the values of
+    // the columns.
+    auto rowParameters = keys.size() + columns.size();
+    std::string sql = "update ";
+    sql += T::tableName;
+    if (client_->type() == ClientType::Mysql)
+    {
+        // update table join (select ? as k, ? as c union all select ?, ?) as
+        // batch_values on table.k = batch_values.k set table.c =
+        // batch_values.c
+        sql += " join (";
+        for (size_t row = 0; row < rowsCount; ++row)
+        {
+            sql += row == 0 ? "select " : " union all select ";
+            for (size_t i = 0; i < rowParameters; ++i)
+            {
+                if (i > 0)
+                    sql += ',';
+                sql += '?';
+                if (row == 0)
+                {
+                    sql += " as ";
+                    sql += i < keys.size() ? keys[i]
+                                           : columns[i - keys.size()];
+                }
+            }
+        }
+        sql += ") as batch_values on ";
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            if (i > 0)
+                sql += " and ";
+            sql += T::tableName;
+            sql += '.';
+            sql += keys[i];
+            sql += " = batch_values.";
+            sql += keys[i];
+        }
+        sql += " set ";
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            if (i > 0)
+                sql += ',';
+            sql += T::tableName;
+            sql += '.';
+            sql += columns[i];
+            sql += " = batch_values.";
+            sql += columns[i];
+        }
+        return sql;
+    }
+    // update table set c = case when k = $1 then $2 when k = $3 then $4 else
+    // c end where (k = $1) or (k = $3)
+    // The else branch gives its type to the parameters on PostgreSQL, the
+    // parameters are numbered to be used in the order of the rows.
+    auto prefix = client_->type() == ClientType::PostgreSQL ? '$' : '?';
+    auto appendKeyCondition = [&sql, &keys, prefix, rowParameters](
+                                  size_t row) {
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            if (i > 0)
+                sql += " and ";
+            sql += keys[i];
+            sql += " = ";
+            sql += prefix;
+            sql += std::to_string(row * rowParameters + i + 1);
+        }
+    };
+    sql += " set ";
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        if (i > 0)
+            sql += ',';
+        sql += columns[i];
+        sql += " = case";
+        for (size_t row = 0; row < rowsCount; ++row)
+        {
+            sql += " when ";
+            appendKeyCondition(row);
+            sql += " then ";
+            sql += prefix;
+            sql += std::to_string(row * rowParameters + keys.size() + i + 1);
+        }
+        sql += " else ";
+        sql += columns[i];
+        sql += " end";
+    }
+    sql += " where ";
+    for (size_t row = 0; row < rowsCount; ++row)
+    {
+        if (row > 0)
+            sql += " or ";
+        sql += '(';
+        appendKeyCondition(row);
+        sql += ')';
+    }
+    return sql;
+}
+
+template <typename T>
+inline std::vector<std::string> Mapper<T>::primaryKeyColumns()
+{
+    if constexpr (std::is_same_v<typename T::PrimaryKeyType, void>)
+    {
+        return {};
+    }
+    else if constexpr (std::is_same_v<decltype(T::primaryKeyName),
+                                      const std::string>)
+    {
+        return {T::primaryKeyName};
+    }
+    else
+    {
+        return T::primaryKeyName;
+    }
+}
+
+template <typename T>
+inline void Mapper<T>::outputBatchArgs(const std::vector<T> &objs,
+                                       const InsertStatement &statement,
+                                       bool isUpdate,
+                                       internal::SqlBinder &binder)
+{
+    for (size_t i = statement.begin; i < statement.end; ++i)
+    {
+        if constexpr (!std::is_same_v<typename T::PrimaryKeyType, void>)
+        {
+            if (isUpdate)
+            {
+                outputPrimaryKeyToBinder(objs[i].getPrimaryKey(), binder);
+                objs[i].updateArgs(binder);
+                continue;
+            }
+        }
+        objs[i].outputArgs(binder);
+    }
+}
+
+template <typename T>
+inline size_t Mapper<T>::execCountStatements(
+    const std::vector<T> &objs,
+    std::vector<InsertStatement> &statements,
+    bool isUpdate)
+{
+    size_t count = 0;
+    for (auto &statement : statements)
+    {
+        Result r(nullptr);
+        {
+            auto binder = *client_ << std::move(statement.sql);
+            outputBatchArgs(objs, statement, isUpdate, binder);
+            binder << Mode::Blocking;
+            binder >> [&r](const Result &result) { r = result; };
+            binder.exec();  // Maybe throw exception;
+        }
+        count += r.affectedRows();
+    }
+    return count;
+}
+
+template <typename T>
+inline void Mapper<T>::execNextCount(
+    const DbClientPtr &client,
+    const std::shared_ptr<CountBatchState> &state)
+{
+    if (state->next == state->statements.size())
+    {
+        state->callback(state->count);
+        return;
+    }
+    auto &statement = state->statements[state->next++];
+    auto binder = *client << std::move(statement.sql);
+    outputBatchArgs(state->objs, statement, state->isUpdate, binder);
+    binder >> [client, state](const Result &r) {
+        state->count += r.affectedRows();
+        execNextCount(client, state);
+    };
+    binder >> [state](const std::exception_ptr &ePtr) {
+        state->exceptCallback(ePtr);
+    };
+}
+
+template <typename T>
+inline size_t Mapper<T>::upsert(
+    const T &obj,
+    const std::vector<std::string> &conflictColumns) noexcept(false)
+{
+    return upsertBatch(std::vector<T>{obj}, conflictColumns);
+}
+
+template <typename T>
+inline void Mapper<T>::upsert(
+    const T &obj,
+    const CountCallback &rcb,
+    const ExceptionCallback &ecb,
+    const std::vector<std::string> &conflictColumns) noexcept
+{
+    upsertBatch(std::vector<T>{obj}, rcb, ecb, conflictColumns);
+}
+
+template <typename T>
+inline size_t Mapper<T>::upsertBatch(
+    const std::vector<T> &objs,
+    const std::vector<std::string> &conflictColumns,
+    size_t maxParameters) noexcept(false)
+{
+    clear();
+    auto statements =
+        makeInsertStatements(objs, maxParameters, &conflictColumns);
+    return execCountStatements(objs, statements, false);
+}
+
+template <typename T>
+inline void Mapper<T>::upsertBatch(
+    const std::vector<T> &objs,
+    const CountCallback &rcb,
+    const ExceptionCallback &ecb,
+    const std::vector<std::string> &conflictColumns,
+    size_t maxParameters) noexcept
+{
+    upsertBatchAsync(objs,
+                     conflictColumns,
+                     maxParameters,
+                     CountCallback(rcb),
+                     [ecb](const std::exception_ptr &ePtr) {
+                         try
+                         {
+                             std::rethrow_exception(ePtr);
+                         }
+                         catch (const DrogonDbException &e)
+                         {
+                             ecb(e);
+                         }
+                     });
+}
+
+template <typename T>
+inline void Mapper<T>::upsertBatchAsync(
+    const std::vector<T> &objs,
+    const std::vector<std::string> &conflictColumns,
+    size_t maxParameters,
+    CountCallback &&rcb,
+    ExceptPtrCallback &&ecb) noexcept
+{
+    clear();
+    auto state = std::make_shared<CountBatchState>();
+    state->objs = objs;
+    state->statements =
+        makeInsertStatements(objs, maxParameters, &conflictColumns);
+    state->callback = std::move(rcb);
+    state->exceptCallback = std::move(ecb);
+    execNextCount(client_, state);
+}
+
+template <typename T>
+inline size_t Mapper<T>::updateBatch(const std::vector<T> &objs,
+                                     size_t maxParameters) noexcept(false)
+{
+    clear();
+    auto statements = makeUpdateStatements(objs, maxParameters);
+    return execCountStatements(objs, statements, true);
+}
+
+template <typename T>
+inline void Mapper<T>::updateBatch(const std::vector<T> &objs,
+                                   const CountCallback &rcb,
+                                   const ExceptionCallback &ecb,
+                                   size_t maxParameters) noexcept
+{
+    updateBatchAsync(objs,
+                     maxParameters,
+                     CountCallback(rcb),
+                     [ecb](const std::exception_ptr &ePtr) {
+                         try
+                         {
+                             std::rethrow_exception(ePtr);
+                         }
+                         catch (const DrogonDbException &e)
+                         {
+                             ecb(e);
+                         }
+                     });
+}
+
+template <typename T>
+inline void Mapper<T>::updateBatchAsync(const std::vector<T> &objs,
+                                        size_t maxParameters,
+                                        CountCallback &&rcb,
+                                        ExceptPtrCallback &&ecb) noexcept
+{
+    clear();
+    auto state = std::make_shared<CountBatchState>();
+    state->objs = objs;
+    state->statements = makeUpdateStatements(objs, maxParameters);
+    state->isUpdate = true;
+    state->callback = std::move(rcb);
+    state->exceptCallback = std::move(ecb);
+    execNextCount(client_, state);
+}
+
 template <typename T>
 inline size_t Mapper<T>::update(const T &obj) noexcept(false)
 {
@@ -1446,10 +2382,9 @@ inline size_t Mapper<T>::update(const T &obj) noexcept(false)
 
     makePrimaryKeyCriteria(sql);
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
     Result r(nullptr);
     {
-        auto binder = *client_ << std::move(sql);
+        auto binder = makeBinder(std::move(sql));
         obj.updateArgs(binder);
         outputPrimaryKeyToBinder(obj.getPrimaryKey(), binder);
         binder << Mode::Blocking;
@@ -1481,17 +2416,16 @@ size_t Mapper<T>::updateBy(const std::vector<std::string> &colNames,
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
+        sql += criteria.criteriaString(client_->type());
     }
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
     Result r(nullptr);
     {
-        auto binder = *client_ << std::move(sql);
+        auto binder = makeBinder(std::move(sql));
         (void)std::initializer_list<int>{
             (binder << std::forward<Arguments>(args), 0)...};
         if (criteria)
-            criteria.outputArgs(binder);
+            criteria.outputArgs(binder, client_->type());
         binder << Mode::Blocking;
         binder >> [&r](const Result &result) { r = result; };
         binder.exec();  // Maybe throw exception;
@@ -1526,8 +2460,7 @@ inline void Mapper<T>::update(const T &obj,
 
     makePrimaryKeyCriteria(sql);
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     obj.updateArgs(binder);
     outputPrimaryKeyToBinder(obj.getPrimaryKey(), binder);
     binder >> [rcb](const Result &r) { rcb(r.affectedRows()); };
@@ -1558,15 +2491,14 @@ void Mapper<T>::updateBy(const std::vector<std::string> &colNames,
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
+        sql += criteria.criteriaString(client_->type());
     }
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     (void)std::initializer_list<int>{
         (binder << std::forward<Arguments>(args), 0)...};
     if (criteria)
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
     binder >> [rcb](const Result &r) { rcb(r.affectedRows()); };
     binder >> ecb;
 }
@@ -1597,8 +2529,7 @@ inline std::future<size_t> Mapper<T>::updateFuture(const T &obj) noexcept
 
     makePrimaryKeyCriteria(sql);
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     obj.updateArgs(binder);
     outputPrimaryKeyToBinder(obj.getPrimaryKey(), binder);
 
@@ -1633,15 +2564,14 @@ inline std::future<size_t> Mapper<T>::updateFutureBy(
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
+        sql += criteria.criteriaString(client_->type());
     }
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     (void)std::initializer_list<int>{
         (binder << std::forward<Arguments>(args), 0)...};
     if (criteria)
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
 
     std::shared_ptr<std::promise<size_t>> prom =
         std::make_shared<std::promise<size_t>>();
@@ -1685,17 +2615,16 @@ inline size_t Mapper<T>::increment(const std::vector<std::string> &colNames,
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
+        sql += criteria.criteriaString(client_->type());
     }
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
     Result r(nullptr);
     {
-        auto binder = *client_ << std::move(sql);
+        auto binder = makeBinder(std::move(sql));
         (void)std::initializer_list<int>{
             (binder << std::forward<Arguments>(args), 0)...};
         if (criteria)
-            criteria.outputArgs(binder);
+            criteria.outputArgs(binder, client_->type());
         binder << Mode::Blocking;
         binder >> [&r](const Result &result) { r = result; };
         binder.exec();  // Maybe throw exception;
@@ -1739,15 +2668,14 @@ inline void Mapper<T>::increment(const std::vector<std::string> &colNames,
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
+        sql += criteria.criteriaString(client_->type());
     }
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     (void)std::initializer_list<int>{
         (binder << std::forward<Arguments>(args), 0)...};
     if (criteria)
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
     binder >> [rcb](const Result &r) { rcb(r.affectedRows()); };
     binder >> ecb;
 }
@@ -1787,15 +2715,14 @@ inline std::future<size_t> Mapper<T>::incrementFuture(
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
+        sql += criteria.criteriaString(client_->type());
     }
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     (void)std::initializer_list<int>{
         (binder << std::forward<Arguments>(args), 0)...};
     if (criteria)
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
 
     std::shared_ptr<std::promise<size_t>> prom =
         std::make_shared<std::promise<size_t>>();
@@ -1818,10 +2745,9 @@ inline size_t Mapper<T>::deleteOne(const T &obj) noexcept(false)
 
     makePrimaryKeyCriteria(sql);
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
     Result r(nullptr);
     {
-        auto binder = *client_ << std::move(sql);
+        auto binder = makeBinder(std::move(sql));
         outputPrimaryKeyToBinder(obj.getPrimaryKey(), binder);
         binder << Mode::Blocking;
         binder >> [&r](const Result &result) { r = result; };
@@ -1844,8 +2770,7 @@ inline void Mapper<T>::deleteOne(const T &obj,
 
     makePrimaryKeyCriteria(sql);
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     outputPrimaryKeyToBinder(obj.getPrimaryKey(), binder);
     binder >> [rcb](const Result &r) { rcb(r.affectedRows()); };
     binder >> ecb;
@@ -1863,8 +2788,7 @@ inline std::future<size_t> Mapper<T>::deleteFutureOne(const T &obj) noexcept
 
     makePrimaryKeyCriteria(sql);
 
-    sql = replaceSqlPlaceHolder(sql, "$?");
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     outputPrimaryKeyToBinder(obj.getPrimaryKey(), binder);
 
     std::shared_ptr<std::promise<size_t>> prom =
@@ -1887,16 +2811,15 @@ inline size_t Mapper<T>::deleteBy(const Criteria &criteria) noexcept(false)
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
-        sql = replaceSqlPlaceHolder(sql, "$?");
+        sql += criteria.criteriaString(client_->type());
     }
 
     Result r(nullptr);
     {
-        auto binder = *client_ << std::move(sql);
+        auto binder = makeBinder(std::move(sql));
         if (criteria)
         {
-            criteria.outputArgs(binder);
+            criteria.outputArgs(binder, client_->type());
         }
         binder << Mode::Blocking;
         binder >> [&r](const Result &result) { r = result; };
@@ -1919,14 +2842,13 @@ inline void Mapper<T>::deleteBy(const Criteria &criteria,
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
-        sql = replaceSqlPlaceHolder(sql, "$?");
+        sql += criteria.criteriaString(client_->type());
     }
 
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     if (criteria)
     {
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
     }
     binder >> [rcb](const Result &r) { rcb(r.affectedRows()); };
     binder >> ecb;
@@ -1944,13 +2866,12 @@ inline std::future<size_t> Mapper<T>::deleteFutureBy(
     if (criteria)
     {
         sql += " where ";
-        sql += criteria.criteriaString();
-        sql = replaceSqlPlaceHolder(sql, "$?");
+        sql += criteria.criteriaString(client_->type());
     }
-    auto binder = *client_ << std::move(sql);
+    auto binder = makeBinder(std::move(sql));
     if (criteria)
     {
-        criteria.outputArgs(binder);
+        criteria.outputArgs(binder, client_->type());
     }
 
     std::shared_ptr<std::promise<size_t>> prom =
@@ -1980,6 +2901,7 @@ template <typename T>
 inline Mapper<T> &Mapper<T>::orderBy(const std::string &colName,
                                      const SortOrder &order)
 {
+    orderColumns_.emplace_back(colName, order);
     if (orderByString_.empty())
     {
         orderByString_ =
@@ -2016,6 +2938,24 @@ inline Mapper<T> &Mapper<T>::paginate(size_t page, size_t perPage)
     return limit(perPage).offset((page - 1) * perPage);
 }
 
+template <typename T>
+inline Mapper<T> &Mapper<T>::paginateAfter(
+    size_t perPage,
+    const std::vector<std::string> &lastValues)
+{
+    seekValues_.clear();
+    for (auto &value : lastValues)
+    {
+        seekValues_.emplace_back(
+            [value](const std::string &colName, CompareOperator opera) {
+                return Criteria(colName, opera, value);
+            });
+    }
+    limit(perPage);
+    offset_ = 0;
+    return *this;
+}
+
 template <typename T>
 inline Mapper<T> &Mapper<T>::forUpdate()
 {
@@ -2023,56 +2963,91 @@ inline Mapper<T> &Mapper<T>::forUpdate()
     return *this;
 }
 
+template <typename T>
+inline Mapper<T> &Mapper<T>::columns(const std::vector<std::string> &colNames)
+{
+    columnsString_.clear();
+    for (auto &colName : colNames)
+    {
+        assert(isValidSqlIdentifier(colName));
+        if (!columnsString_.empty())
+            columnsString_ += ",";
+        // Qualified, so that the columns of the joined tables are not
+        // ambiguous.
+        columnsString_ += T::tableName;
+        columnsString_ += ".";
+        columnsString_ += colName;
+    }
+    return *this;
+}
+
 template <typename T>
 inline std::string Mapper<T>::replaceSqlPlaceHolder(
     const std::string &sqlStr,
     const std::string &holderStr) const
 {
-    if (client_->type() == ClientType::PostgreSQL)
-    {
-        std::string::size_type startPos = 0;
-        std::string::size_type pos;
-        std::stringstream ret;
-        size_t phCount = 1;
-        do
+    auto type = client_->type();
+    if (type != ClientType::PostgreSQL && type != ClientType::Mysql &&
+        type != ClientType::Sqlite3)
+        return sqlStr;
+    std::string ret;
+    ret.reserve(sqlStr.length() + 16);
+    std::string::size_type startPos = 0;
+    size_t phCount = 1;
+    while (true)
+    {
+        auto pos = sqlStr.find(holderStr, startPos);
+        if (pos == std::string::npos)
         {
-            pos = sqlStr.find(holderStr, startPos);
-            if (pos == std::string::npos)
-            {
-                ret << sqlStr.substr(startPos);
-                return ret.str();
-            }
-            ret << sqlStr.substr(startPos, pos - startPos);
-            ret << "$";
-            ret << phCount++;
-            startPos = pos + holderStr.length();
-        } while (1);
-    }
-    else if (client_->type() == ClientType::Mysql ||
-             client_->type() == ClientType::Sqlite3)
-    {
-        std::string::size_type startPos = 0;
-        std::string::size_type pos;
-        std::stringstream ret;
-        do
+            ret.append(sqlStr, startPos, std::string::npos);
+            return ret;
+        }
+        ret.append(sqlStr, startPos, pos - startPos);
+        if (type == ClientType::PostgreSQL)
         {
-            pos = sqlStr.find(holderStr, startPos);
-            if (pos == std::string::npos)
-            {
-                ret << sqlStr.substr(startPos);
-                return ret.str();
-            }
-            ret << sqlStr.substr(startPos, pos - startPos);
-            ret << "?";
-            startPos = pos + holderStr.length();
-        } while (1);
-    }
-    else
-    {
-        return sqlStr;
+            ret += '$';
+            ret += std::to_string(phCount++);
+        }
+        else
+        {
+            ret += '?';
+        }
+        startPos = pos + holderStr.length();
     }
 }
 
+template <typename T>
+inline internal::SqlBinder Mapper<T>::makeBinder(std::string &&sql) const
+{
+    // The statements of a model are a few shapes built from its columns and
+    // the criteria, the number of the cached ones is limited in case the
+    // criteria are built from values (e.g. the in lists of various lengths).
+    static constexpr size_t maxCachedStatements = 1024;
+    struct Cache
+    {
+        std::shared_mutex mutex;
+        // The key is the type of the client followed by the statement, the
+        // entries are never erased, so the views of them stay valid.
+        std::unordered_map<std::string, std::string> statements;
+    };
+    static Cache cache;
+    sql.insert(sql.begin(), static_cast<char>('0' + (int)client_->type()));
+    {
+        std::shared_lock<std::shared_mutex> lock(cache.mutex);
+        auto iter = cache.statements.find(sql);
+        if (iter != cache.statements.end())
+            return *client_ << std::string_view(iter->second);
+    }
+    auto converted = replaceSqlPlaceHolder(sql.substr(1), "$?");
+    std::unique_lock<std::shared_mutex> lock(cache.mutex);
+    if (cache.statements.size() >= maxCachedStatements)
+        return *client_ << std::move(converted);
+    auto &cached =
+        cache.statements.emplace(std::move(sql), std::move(converted))
+            .first->second;
+    return *client_ << std::string_view(cached);
+}
+
 template <typename T>
 inline size_t Mapper<T>::deleteByPrimaryKey(
     const typename Mapper<T>::TraitsPKType &key) noexcept(false)
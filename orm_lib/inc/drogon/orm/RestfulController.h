@@ -19,8 +19,11 @@
 #include <drogon/orm/DbClient.h>
 #include <drogon/orm/Mapper.h>
 #include <trantor/utils/NonCopyable.h>
+#include <algorithm>
 #include <string>
 #include <functional>
+#include <memory>
+#include <tuple>
 #include <vector>
 
 namespace drogon
@@ -145,6 +148,184 @@ class DROGON_EXPORT RestfulController : trantor::NonCopyable
         }
     }
 
+    /**
+     * @brief Create the JSON response of an object or a vector of objects,
+     * with the same members as makeJson() but written straight into the body
+     * by the writeJson() methods of the models.
+     */
+    template <typename T>
+    HttpResponsePtr makeJsonResponse(const HttpRequestPtr &req, const T &obj)
+    {
+        std::vector<std::string> fields;
+        bool masqueraded = selectFields(req, fields);
+        std::string body;
+        JsonWriter writer(body, JsonWriter::appOptions());
+        writeObject(writer, obj, masqueraded, fields);
+        auto resp = HttpResponse::newHttpResponse(k200OK, CT_APPLICATION_JSON);
+        resp->setBody(std::move(body));
+        return resp;
+    }
+
+    template <typename T>
+    HttpResponsePtr makeJsonResponse(const HttpRequestPtr &req,
+                                     const std::vector<T> &objects)
+    {
+        std::vector<std::string> fields;
+        bool masqueraded = selectFields(req, fields);
+        std::string body;
+        JsonWriter writer(body, JsonWriter::appOptions());
+        writer.startArray();
+        for (auto &obj : objects)
+        {
+            writeObject(writer, obj, masqueraded, fields);
+        }
+        writer.endArray();
+        auto resp = HttpResponse::newHttpResponse(k200OK, CT_APPLICATION_JSON);
+        resp->setBody(std::move(body));
+        return resp;
+    }
+
+    /**
+     * @brief Create a response streaming the objects of a query as a JSON
+     * array, with the same members as makeJsonResponse(). The rows are read
+     * in batches by DbClient::execSqlStream() and every batch is written
+     * and sent before the next one is fetched.
+     *
+     * @param sql The query, which must select the columns of the model T.
+     * @param batchSize The number of rows of a batch.
+     * @param args The parameters bound to the placeholders of the query.
+     * @note An error of the query after the response has started can only
+     * end the array early, it is logged.
+     * @note The memory used by the query is bounded on PostgreSQL only. With
+     * MySQL and Sqlite3, the whole result is loaded before the response
+     * starts, only the JSON body is still written batch by batch.
+     */
+    template <typename T, typename... Arguments>
+    HttpResponsePtr makeJsonStreamResponse(const HttpRequestPtr &req,
+                                           const orm::DbClientPtr &client,
+                                           const std::string &sql,
+                                           size_t batchSize,
+                                           Arguments &&...args)
+    {
+        auto fields = std::make_shared<std::vector<std::string>>();
+        bool masqueraded = selectFields(req, *fields);
+        auto parameters = std::make_tuple(
+            std::decay_t<Arguments>(std::forward<Arguments>(args))...);
+        return HttpResponse::newJsonArrayStreamResponse(
+            [client, sql, batchSize, masqueraded, fields, parameters](
+                JsonArrayStreamPtr stream) {
+                std::shared_ptr<JsonArrayStream> arrayStream =
+                    std::move(stream);
+                auto rowsCallback = [arrayStream, masqueraded, fields](
+                                        const orm::Result &rows,
+                                        const orm::RowStreamPtr &rowStream) {
+                    for (auto const &row : rows)
+                    {
+                        T obj(row);
+                        if (!arrayStream->appendWith(
+                                [&obj, masqueraded, &fields](
+                                    JsonWriter &writer) {
+                                    writeObject(writer,
+                                                obj,
+                                                masqueraded,
+                                                *fields);
+                                }))
+                        {
+                            if (rowStream)
+                                rowStream->cancel();
+                            arrayStream->close();
+                            return;
+                        }
+                    }
+                    if (rowStream)
+                        rowStream->next();
+                    else
+                        arrayStream->close();
+                };
+                auto exceptCallback =
+                    [arrayStream](const orm::DrogonDbException &e) {
+                        LOG_ERROR << e.base().what();
+                        arrayStream->close();
+                    };
+                std::apply(
+                    [&](const auto &...parameter) {
+                        client->execSqlStream(sql,
+                                              batchSize,
+                                              std::move(rowsCallback),
+                                              std::move(exceptCallback),
+                                              parameter...);
+                    },
+                    parameters);
+            });
+    }
+
+    /**
+     * @brief The columns of the fields selected by the "fields" parameter of
+     * the request, for Mapper::columns(), so that only the fields returned by
+     * makeJson() and makeJsonResponse() are read from the database. Empty if
+     * the request selects all the fields.
+     *
+     * @param requiredColumns The columns read anyway, e.g. the columns of the
+     * cursor.
+     */
+    std::vector<std::string> selectedColumns(
+        const HttpRequestPtr &req,
+        const std::vector<std::string> &requiredColumns = {})
+    {
+        std::vector<std::string> fields;
+        if (req->parameters().count("fields") == 0 ||
+            !selectFields(req, fields))
+            return {};
+        std::vector<std::string> columns;
+        for (size_t i = 0; i < fields.size() && i < columnsVector_.size(); ++i)
+        {
+            if (!fields[i].empty())
+                columns.push_back(columnsVector_[i]);
+        }
+        if (columns.empty())
+            return {};
+        for (auto &column : requiredColumns)
+        {
+            if (std::find(columns.begin(), columns.end(), column) ==
+                    columns.end() &&
+                std::find(columnsVector_.begin(),
+                          columnsVector_.end(),
+                          column) != columnsVector_.end())
+                columns.push_back(column);
+        }
+        return columns;
+    }
+
+    /**
+     * @brief Make the cursor of the page following the object, an opaque
+     * token carrying the values of the columns the objects are sorted by,
+     * which is decoded by decodeCursor() for Mapper::paginateAfter().
+     *
+     * @param obj The last object of the page.
+     * @param sortColumns The columns the objects are sorted by.
+     */
+    template <typename T>
+    static std::string makeCursor(const T &obj,
+                                  const std::vector<std::string> &sortColumns)
+    {
+        auto json = obj.toJson();
+        Json::Value values(Json::arrayValue);
+        for (auto &column : sortColumns)
+        {
+            values.append(json[column]);
+        }
+        return encodeCursor(values);
+    }
+
+    static std::string encodeCursor(const Json::Value &values);
+
+    /**
+     * @brief Decode the values of a cursor made by makeCursor(). Returns
+     * false if the cursor is malformed.
+     */
+    static bool decodeCursor(const std::string &cursor,
+                             std::vector<std::string> &values);
+
     bool doCustomValidations(const Json::Value &pJson, std::string &err)
     {
         for (auto &validator : validators_)
@@ -171,6 +352,49 @@ class DROGON_EXPORT RestfulController : trantor::NonCopyable
     }
 
   private:
+    /**
+     * @brief Select the masquerading vector of the request like makeJson(),
+     * once for all the objects of a response. Returns false if the objects
+     * are written without masquerading.
+     */
+    bool selectFields(const HttpRequestPtr &req,
+                      std::vector<std::string> &fields)
+    {
+        auto &queryParams = req->parameters();
+        auto iter = queryParams.find("fields");
+        if (masquerading_)
+        {
+            if (iter != queryParams.end())
+            {
+                fields =
+                    fieldsSelector(utils::splitStringToSet(iter->second, ","));
+            }
+            else
+            {
+                fields = masqueradingVector_;
+            }
+            return true;
+        }
+        if (iter != queryParams.end())
+        {
+            fields = utils::splitString(iter->second, ",");
+            return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    static void writeObject(JsonWriter &writer,
+                            const T &obj,
+                            bool masqueraded,
+                            const std::vector<std::string> &fields)
+    {
+        if (masqueraded)
+            obj.writeMasqueradedJson(writer, fields);
+        else
+            obj.writeJson(writer);
+    }
+
     bool masquerading_{true};
     std::vector<std::string> masqueradingVector_;
     std::vector<
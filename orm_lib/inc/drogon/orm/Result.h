@@ -20,7 +20,9 @@
 #include <drogon/exports.h>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <future>
+#include <vector>
 #include <algorithm>
 #include <assert.h>
 
@@ -122,6 +124,16 @@ class DROGON_EXPORT Result
     /// Name of column with this number (throws exception if it doesn't exist)
     const char *columnName(RowSizeType number) const;
 
+    /// Numbers of the given columns, -1 for the columns that don't exist
+    /**
+     * The numbers are looked up once for each vector of names and then
+     * returned from a cache, so the vector must outlive the result, e.g. a
+     * static vector of the columns of a model. The rows can then be read by
+     * positions instead of comparing the names of all the columns.
+     */
+    const std::vector<long> &columnNumbers(
+        const std::vector<std::string> &names) const;
+
     /// If command was @c INSERT, @c UPDATE, or @c DELETE: number of affected
     /// rows
     /**
@@ -139,6 +151,34 @@ class DROGON_EXPORT Result
      */
     unsigned long long insertId() const noexcept;
 
+    /// The values of a column, which are valid while the result is alive.
+    /**
+     * The data() of a null value is a null pointer. The values in the binary
+     * format are their raw bytes, see Field.
+     */
+    std::vector<std::string_view> columnValues(RowSizeType column) const;
+
+    std::vector<std::string_view> columnValues(const std::string &name) const
+    {
+        return columnValues(columnNumber(name));
+    }
+
+    /// Decode all the values of a column, a null value is decoded as T().
+    /**
+     * It's much faster than calling Field::as<T>() for every row of a large
+     * result. T can be int, long, long long, their unsigned types, float,
+     * double, std::string or std::string_view, whose values are valid while
+     * the result is alive.
+     */
+    template <typename T>
+    std::vector<T> columnAs(RowSizeType column) const;
+
+    template <typename T>
+    std::vector<T> columnAs(const std::string &name) const
+    {
+        return columnAs<T>(columnNumber(name));
+    }
+
 #ifdef _MSC_VER
     Result() noexcept = default;
 #endif
@@ -160,6 +200,10 @@ class DROGON_EXPORT Result
     /// Get the column oid, for postgresql database
     int oid(RowSizeType column) const noexcept;
 
+    /// Whether the values of the column are in the binary format, for
+    /// postgresql database
+    bool isBinary(RowSizeType column) const noexcept;
+
     const char *getValue(SizeType row, RowSizeType column) const;
     bool isNull(SizeType row, RowSizeType column) const;
     FieldSizeType getLength(SizeType row, RowSizeType column) const;
@@ -65,6 +65,13 @@ class DROGON_EXPORT Row
 
     SizeType size() const;
 
+    /// See Result::columnNumbers()
+    const std::vector<long> &columnNumbers(
+        const std::vector<std::string> &names) const
+    {
+        return result_.columnNumbers(names);
+    }
+
     SizeType capacity() const noexcept
     {
         return size();
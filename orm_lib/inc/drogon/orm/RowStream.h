@@ -0,0 +1,60 @@
+/**
+ *
+ *  @file RowStream.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/orm/Result.h>
+#include <functional>
+#include <memory>
+
+namespace drogon
+{
+namespace orm
+{
+class RowStream;
+using RowStreamPtr = std::shared_ptr<RowStream>;
+
+/**
+ * @brief The callback receiving the batches of rows of a query executed by
+ * DbClient::execSqlStream().
+ *
+ * The stream is null in the last call, whose batch may be empty. Otherwise
+ * the next batch is delivered only after RowStream::next() is called. On
+ * PostgreSQL, it is fetched only then, which bounds the memory used by the
+ * query whatever the size of its result. The other databases store the whole
+ * result first, see DbClient::execSqlStream().
+ */
+using RowsCallback =
+    std::function<void(const Result &rows, const RowStreamPtr &stream)>;
+
+/**
+ * @brief The handle on a batch of rows of a streamed query.
+ *
+ * Either next() or cancel() should be called once for every batch, from any
+ * thread. Releasing the handle without calling them cancels the query.
+ */
+class DROGON_EXPORT RowStream
+{
+  public:
+    virtual ~RowStream() = default;
+
+    /// Fetch the next batch of rows, the callback is called again with it.
+    virtual void next() = 0;
+
+    /// Stop the query, the callback isn't called any more.
+    virtual void cancel() = 0;
+};
+}  // namespace orm
+}  // namespace drogon
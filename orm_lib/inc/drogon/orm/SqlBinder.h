@@ -598,6 +598,17 @@ class DROGON_EXPORT SqlBinder : public trantor::NonCopyable
 
     void exec() noexcept(false);
 
+    /**
+     * @brief Execute the SQL in the non-blocking mode, passing the callbacks
+     * to the client as they are.
+     *
+     * The callbacks set by the >> operators are ignored. The SQL and the
+     * parameters stay owned by the binder, which must outlive the execution.
+     * This saves the allocations of the wrapping callbacks in the coroutine
+     * awaiters, which live until the coroutine is resumed.
+     */
+    void execDirect(QueryCallback &&rcb, ExceptPtrCallback &&exceptCb);
+
   private:
     static int getMysqlTypeBySize(size_t size);
 
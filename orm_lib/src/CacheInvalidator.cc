@@ -0,0 +1,76 @@
+/**
+ *
+ *  @file CacheInvalidator.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/orm/CacheInvalidator.h>
+#include <drogon/DrClassMap.h>
+#include <trantor/utils/Logger.h>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+void CacheInvalidator::onNotification(const std::string &channel,
+                                      Handler handler)
+{
+    if (!listener_)
+    {
+        LOG_ERROR << "No listener, the notifications of " << channel
+                  << " are not received";
+        return;
+    }
+    listener_->listen(channel,
+                      [handler = std::move(handler)](std::string,
+                                                     std::string payload) {
+                          handler(payload);
+                      });
+}
+
+void CacheInvalidator::invalidateQueries(const std::string &channel,
+                                         DbClientPtr client)
+{
+    onNotification(channel,
+                   [client = std::move(client)](const std::string &payload) {
+                       client->invalidateCache(payload);
+                   });
+}
+
+void CacheInvalidator::invalidateResponses(const std::string &channel,
+                                           std::shared_ptr<ResponseCache> cache)
+{
+    if (!cache)
+    {
+        cache = DrClassMap::getSingleInstance<ResponseCache>();
+    }
+    onNotification(channel,
+                   [cache = std::move(cache)](const std::string &payload) {
+                       if (payload.empty())
+                           cache->clear();
+                       else
+                           cache->erase(payload);
+                   });
+}
+
+void CacheInvalidator::notify(const DbClientPtr &client,
+                              const std::string &channel,
+                              const std::string &payload)
+{
+    client->execSqlAsync(
+        "select pg_notify($1, $2)",
+        [](const Result &) {},
+        [channel](const DrogonDbException &e) {
+            LOG_ERROR << "Failed to notify " << channel << ": "
+                      << e.base().what();
+        },
+        channel,
+        payload);
+}
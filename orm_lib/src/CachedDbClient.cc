@@ -0,0 +1,446 @@
+/**
+ *
+ *  CachedDbClient.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "CachedDbClient.h"
+#include "ReplicatedDbClient.h"
+#include <drogon/orm/DbTypes.h>
+#include <drogon/orm/SqlBinder.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+using namespace drogon::orm;
+
+namespace
+{
+int64_t steadyNow()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// The key words which can follow the name of a table in a list of tables.
+bool isKeyword(const std::string &word)
+{
+    static const char *const keywords[] = {
+        "as",        "cross",   "except",  "fetch",     "for",
+        "full",      "group",   "having",  "inner",     "intersect",
+        "join",      "lateral", "left",    "limit",     "natural",
+        "offset",    "on",      "order",   "outer",     "returning",
+        "right",     "select",  "set",     "union",     "using",
+        "values",    "where",   "window",  "straight_join"};
+    return std::find_if(std::begin(keywords),
+                        std::end(keywords),
+                        [&word](const char *keyword) {
+                            return word == keyword;
+                        }) != std::end(keywords);
+}
+
+bool isName(const std::string &word)
+{
+    return !word.empty() &&
+           (isalpha(static_cast<unsigned char>(word[0])) || word[0] == '_') &&
+           !isKeyword(word);
+}
+
+// Split a query into lower case words, without the string literals and the
+// quotes of the identifiers, and punctuation characters.
+std::vector<std::string> splitSql(std::string_view sql)
+{
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    while (i < sql.length())
+    {
+        auto c = static_cast<unsigned char>(sql[i]);
+        if (isspace(c))
+        {
+            ++i;
+            continue;
+        }
+        if (c == '\'')
+        {
+            // '' is an escaped quote, which is skipped as two literals.
+            auto end = sql.find('\'', i + 1);
+            i = end == std::string_view::npos ? sql.length() : end + 1;
+            tokens.emplace_back("'");
+            continue;
+        }
+        if (!isalnum(c) && c != '_' && c != '"' && c != '`')
+        {
+            tokens.emplace_back(1, static_cast<char>(c));
+            ++i;
+            continue;
+        }
+        std::string word;
+        while (i < sql.length())
+        {
+            c = static_cast<unsigned char>(sql[i]);
+            if (c == '"' || c == '`')
+            {
+                auto end = sql.find(static_cast<char>(c), i + 1);
+                if (end == std::string_view::npos)
+                    end = sql.length();
+                for (auto ch : sql.substr(i + 1, end - i - 1))
+                    word += static_cast<char>(
+                        tolower(static_cast<unsigned char>(ch)));
+                i = std::min(end + 1, sql.length());
+            }
+            else if (isalnum(c) || c == '_' || c == '$' || c == '.')
+            {
+                word += static_cast<char>(tolower(c));
+                ++i;
+            }
+            else
+            {
+                break;
+            }
+        }
+        tokens.emplace_back(std::move(word));
+    }
+    return tokens;
+}
+
+// The size of a parameter given by its format for the clients which don't
+// set the length of the numbers, -1 if it's unknown.
+int parameterSize(ClientType type, int format, int length)
+{
+    if (type == ClientType::PostgreSQL || length > 0)
+        return length;
+    if (type == ClientType::Mysql)
+    {
+        switch (format)
+        {
+            case internal::MySqlTiny:
+            case internal::MySqlUTiny:
+                return 1;
+            case internal::MySqlShort:
+            case internal::MySqlUShort:
+                return 2;
+            case internal::MySqlLong:
+            case internal::MySqlULong:
+                return 4;
+            case internal::MySqlLongLong:
+            case internal::MySqlULongLong:
+                return 8;
+            case internal::MySqlString:
+            case internal::MySqlNull:
+            case internal::DrogonDefaultValue:
+                return 0;
+            default:
+                return -1;
+        }
+    }
+    switch (format)
+    {
+        case Sqlite3TypeChar:
+            return 1;
+        case Sqlite3TypeShort:
+            return 2;
+        case Sqlite3TypeInt:
+            return 4;
+        case Sqlite3TypeInt64:
+        case Sqlite3TypeDouble:
+            return 8;
+        case Sqlite3TypeText:
+        case Sqlite3TypeBlob:
+        case Sqlite3TypeNull:
+            return 0;
+        default:
+            return -1;
+    }
+}
+}  // namespace
+
+std::shared_ptr<DbClient> DbClient::newCachedClient(
+    std::shared_ptr<DbClient> client,
+    size_t maxEntries,
+    double ttl)
+{
+    assert(client);
+    return std::make_shared<CachedDbClient>(std::move(client),
+                                            maxEntries,
+                                            ttl);
+}
+
+CachedDbClient::CachedDbClient(DbClientPtr client,
+                               size_t maxEntries,
+                               double ttl)
+    : client_(std::move(client)), maxEntries_(maxEntries), ttl_(ttl)
+{
+    type_ = client_->type();
+    connectionInfo_ = client_->connectionInfo();
+}
+
+std::vector<std::string> CachedDbClient::tableNames(std::string_view sql,
+                                                    bool readOnly)
+{
+    auto tokens = splitSql(sql);
+    std::vector<std::string> names;
+    auto addName = [&names](const std::string &token) {
+        auto pos = token.rfind('.');
+        auto name = pos == std::string::npos ? token : token.substr(pos + 1);
+        if (!name.empty() &&
+            std::find(names.begin(), names.end(), name) == names.end())
+            names.emplace_back(std::move(name));
+    };
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        auto &token = tokens[i];
+        if (token != "from" && token != "join" &&
+            (readOnly || (token != "into" && token != "update" &&
+                          token != "table" && token != "truncate")))
+            continue;
+        auto k = i + 1;
+        while (k < tokens.size() &&
+               (tokens[k] == "only" || tokens[k] == "if" ||
+                tokens[k] == "not" || tokens[k] == "exists" ||
+                tokens[k] == "table"))
+            ++k;
+        if (k >= tokens.size() || !isName(tokens[k]))
+            continue;
+        addName(tokens[k]);
+        if (token != "from")
+            continue;
+        // A list of tables with their aliases.
+        for (++k; k < tokens.size();)
+        {
+            if (tokens[k] == "as")
+                ++k;
+            if (k < tokens.size() && isName(tokens[k]))
+                ++k;
+            if (k + 1 >= tokens.size() || tokens[k] != "," ||
+                !isName(tokens[k + 1]))
+                break;
+            addName(tokens[k + 1]);
+            k += 2;
+        }
+    }
+    return names;
+}
+
+bool CachedDbClient::makeKey(std::string_view sql,
+                             const std::vector<const char *> &parameters,
+                             const std::vector<int> &length,
+                             const std::vector<int> &format,
+                             std::string &key) const
+{
+    key.reserve(sql.length() + 16 * parameters.size());
+    key.append(sql);
+    for (size_t i = 0; i < parameters.size(); ++i)
+    {
+        // The parameters are prefixed by their format and size, which
+        // separates them unambiguously.
+        int size = 0;
+        if (parameters[i])
+        {
+            size = parameterSize(type_, format[i], length[i]);
+            if (size < 0)
+                return false;
+        }
+        key.append(1, '\0');
+        key.append(std::to_string(format[i]));
+        key.append(1, parameters[i] ? ':' : 'N');
+        key.append(std::to_string(size));
+        key.append(1, ':');
+        if (parameters[i])
+            key.append(parameters[i], size);
+    }
+    return true;
+}
+
+void CachedDbClient::execSql(
+    const char *sql,
+    size_t sqlLength,
+    size_t paraNum,
+    std::vector<const char *> &&parameters,
+    std::vector<int> &&length,
+    std::vector<int> &&format,
+    ResultCallback &&rcb,
+    std::function<void(const std::exception_ptr &)> &&exceptCallback)
+{
+    std::string_view sqlView{sql, sqlLength};
+    std::string key;
+    if (!ReplicatedDbClient::isReadOnlySql(sqlView))
+    {
+        // The results are dropped once the query is done, even if it failed
+        // because it may have changed the database before, and the results
+        // of the queries sent in the meantime aren't stored.
+        auto invalidate = [weakPtr = weak_from_this(),
+                           tables = tableNames(sqlView, false)]() {
+            auto thisPtr = weakPtr.lock();
+            if (!thisPtr)
+                return;
+            if (tables.empty())
+            {
+                thisPtr->invalidateCache("");
+                return;
+            }
+            for (auto &table : tables)
+                thisPtr->invalidateCache(table);
+        };
+        client_->execSql(
+            sql,
+            sqlLength,
+            paraNum,
+            std::move(parameters),
+            std::move(length),
+            std::move(format),
+            [invalidate, rcb = std::move(rcb)](const Result &r) {
+                invalidate();
+                rcb(r);
+            },
+            [invalidate, exceptCallback = std::move(exceptCallback)](
+                const std::exception_ptr &e) {
+                invalidate();
+                exceptCallback(e);
+            });
+        return;
+    }
+    if (!makeKey(sqlView, parameters, length, format, key))
+    {
+        client_->execSql(sql,
+                         sqlLength,
+                         paraNum,
+                         std::move(parameters),
+                         std::move(length),
+                         std::move(format),
+                         std::move(rcb),
+                         std::move(exceptCallback));
+        return;
+    }
+    uint64_t generation;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto iter = entriesMap_.find(key);
+        if (iter != entriesMap_.end())
+        {
+            auto entry = iter->second;
+            if (entry->expiry > steadyNow())
+            {
+                entries_.splice(entries_.begin(), entries_, entry);
+                auto result = entry->result;
+                lock.unlock();
+                rcb(result);
+                return;
+            }
+            eraseEntry(entry);
+        }
+        generation = generation_;
+    }
+    // The concurrent misses of a key share one query, the ones after an
+    // invalidation don't wait for a query sent before it.
+    auto flightKey = std::to_string(generation);
+    flightKey.append(1, ':').append(key);
+    flights_.run(
+        flightKey,
+        [rcb = std::move(rcb), exceptCallback = std::move(exceptCallback)](
+            const Result *r, const std::exception_ptr &e) {
+            if (r)
+                rcb(*r);
+            else
+                exceptCallback(e);
+        },
+        [&, this](Flights::Callback &&done) {
+            client_->execSql(
+                sql,
+                sqlLength,
+                paraNum,
+                std::move(parameters),
+                std::move(length),
+                std::move(format),
+                [weakPtr = weak_from_this(),
+                 key = std::move(key),
+                 sql = std::string{sqlView},
+                 generation,
+                 done](const Result &r) mutable {
+                    if (auto thisPtr = weakPtr.lock())
+                        thisPtr->store(std::move(key), sql, r, generation);
+                    done(&r, nullptr);
+                },
+                [done](const std::exception_ptr &e) { done(nullptr, e); });
+        });
+}
+
+void CachedDbClient::store(std::string &&key,
+                           std::string_view sql,
+                           const Result &result,
+                           uint64_t generation)
+{
+    auto tables = tableNames(sql, true);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (generation != generation_)
+        return;
+    auto iter = entriesMap_.find(key);
+    if (iter != entriesMap_.end())
+        eraseEntry(iter->second);
+    entries_.push_front(Entry{std::move(key),
+                              result,
+                              steadyNow() +
+                                  static_cast<int64_t>(ttl_ * 1000000),
+                              std::move(tables)});
+    auto &entry = entries_.front();
+    entriesMap_.emplace(entry.key, entries_.begin());
+    for (auto &table : entry.tables)
+        tablesMap_[table].insert(&entry);
+    while (entries_.size() > maxEntries_)
+        eraseEntry(std::prev(entries_.end()));
+}
+
+void CachedDbClient::eraseEntry(EntryList::iterator iter)
+{
+    for (auto &table : iter->tables)
+    {
+        auto tableIter = tablesMap_.find(table);
+        if (tableIter == tablesMap_.end())
+            continue;
+        tableIter->second.erase(&*iter);
+        if (tableIter->second.empty())
+            tablesMap_.erase(tableIter);
+    }
+    entriesMap_.erase(iter->key);
+    entries_.erase(iter);
+}
+
+void CachedDbClient::invalidateCache(const std::string &table)
+{
+    std::string name{table};
+    std::transform(name.begin(),
+                   name.end(),
+                   name.begin(),
+                   [](unsigned char c) { return tolower(c); });
+    auto pos = name.rfind('.');
+    if (pos != std::string::npos)
+        name = name.substr(pos + 1);
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    if (name.empty())
+    {
+        entries_.clear();
+        entriesMap_.clear();
+        tablesMap_.clear();
+        return;
+    }
+    auto tableIter = tablesMap_.find(name);
+    if (tableIter == tablesMap_.end())
+        return;
+    auto entries = std::move(tableIter->second);
+    tablesMap_.erase(tableIter);
+    for (auto entry : entries)
+    {
+        auto iter = entriesMap_.find(entry->key);
+        if (iter != entriesMap_.end())
+            eraseEntry(iter->second);
+    }
+}
@@ -0,0 +1,149 @@
+/**
+ *
+ *  @file CachedDbClient.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/orm/DbClient.h>
+#include <drogon/utils/SingleFlight.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace drogon
+{
+namespace orm
+{
+class CachedDbClient : public DbClient,
+                       public std::enable_shared_from_this<CachedDbClient>
+{
+  public:
+    CachedDbClient(DbClientPtr client, size_t maxEntries, double ttl);
+
+    std::shared_ptr<Transaction> newTransaction(
+        const std::function<void(bool)> &commitCallback,
+        TransactionType transType) noexcept(false) override
+    {
+        return client_->newTransaction(commitCallback, transType);
+    }
+
+    void newTransactionAsync(
+        const std::function<void(const std::shared_ptr<Transaction> &)>
+            &callback,
+        TransactionType transType) override
+    {
+        client_->newTransactionAsync(callback, transType);
+    }
+
+    bool hasAvailableConnections() const noexcept override
+    {
+        return client_->hasAvailableConnections();
+    }
+
+    ConnectionStats connectionStats() const noexcept override
+    {
+        return client_->connectionStats();
+    }
+
+    void setTimeout(double timeout) override
+    {
+        client_->setTimeout(timeout);
+    }
+
+    void setCircuitBreaker(CircuitBreakerPtr breaker) override
+    {
+        client_->setCircuitBreaker(std::move(breaker));
+    }
+
+    void enableAdaptivePool(size_t maxConnections,
+                            double idleTimeout) override
+    {
+        client_->enableAdaptivePool(maxConnections, idleTimeout);
+    }
+
+    void closeAll() override
+    {
+        client_->closeAll();
+    }
+
+    // The reads which must see the latest writes bypass the cache.
+    DbClient &primary() override
+    {
+        return client_->primary();
+    }
+
+    void invalidateCache(const std::string &table) override;
+
+    // The names of the tables in a query, in lower case and without their
+    // schema. The names after FROM and JOIN for the read-only queries, and
+    // also after INTO, UPDATE and TABLE for the others.
+    static std::vector<std::string> tableNames(std::string_view sql,
+                                               bool readOnly);
+
+  private:
+    void execSql(
+        const char *sql,
+        size_t sqlLength,
+        size_t paraNum,
+        std::vector<const char *> &&parameters,
+        std::vector<int> &&length,
+        std::vector<int> &&format,
+        ResultCallback &&rcb,
+        std::function<void(const std::exception_ptr &)> &&exceptCallback)
+        override;
+
+    // Build the key of a query, returns false if the size of a parameter
+    // isn't known.
+    bool makeKey(std::string_view sql,
+                 const std::vector<const char *> &parameters,
+                 const std::vector<int> &length,
+                 const std::vector<int> &format,
+                 std::string &key) const;
+    void store(std::string &&key,
+               std::string_view sql,
+               const Result &result,
+               uint64_t generation);
+
+    struct Entry
+    {
+        std::string key;
+        Result result;
+        int64_t expiry;
+        std::vector<std::string> tables;
+    };
+    using EntryList = std::list<Entry>;
+
+    void eraseEntry(EntryList::iterator iter);
+
+    DbClientPtr client_;
+    size_t maxEntries_;
+    double ttl_;
+    std::mutex mutex_;
+    // The most recently used entries first.
+    EntryList entries_;
+    std::unordered_map<std::string_view, EntryList::iterator> entriesMap_;
+    std::unordered_map<std::string, std::unordered_set<const Entry *>>
+        tablesMap_;
+    using Flights = SingleFlight<const Result *, const std::exception_ptr &>;
+    Flights flights_;
+    // Incremented by every invalidation, the results of the queries sent
+    // before are not stored.
+    uint64_t generation_{0};
+};
+}  // namespace orm
+}  // namespace drogon
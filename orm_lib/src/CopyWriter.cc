@@ -0,0 +1,192 @@
+/**
+ *
+ *  CopyWriter.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "DbConnection.h"
+#include <drogon/orm/CopyWriter.h>
+#include <drogon/orm/DbClient.h>
+#include <optional>
+
+using namespace drogon::orm;
+
+namespace
+{
+class CopyWriterImpl : public CopyWriter
+{
+  public:
+    explicit CopyWriterImpl(std::shared_ptr<CopyCmd> cmd) : cmd_(std::move(cmd))
+    {
+    }
+
+    ~CopyWriterImpl() override
+    {
+        abort("The writer was released before the end of the data");
+    }
+
+    void write(std::string data) override
+    {
+        if (data.empty())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(cmd_->mutex_);
+            if (cmd_->finished_ || cmd_->aborted_)
+                return;
+            cmd_->pendingBytes_ += data.size();
+            cmd_->buffer_.emplace_back(std::move(data));
+            if (!queueSend())
+                return;
+        }
+        send();
+    }
+
+    void finish() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(cmd_->mutex_);
+            if (cmd_->finished_ || cmd_->aborted_)
+                return;
+            cmd_->finished_ = true;
+            if (!queueSend())
+                return;
+        }
+        send();
+    }
+
+    void abort(const std::string &message) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(cmd_->mutex_);
+            if (cmd_->finished_ || cmd_->aborted_)
+                return;
+            cmd_->aborted_ = true;
+            cmd_->errorMessage_ = message;
+            if (!queueSend())
+                return;
+        }
+        send();
+    }
+
+    size_t pendingBytes() const override
+    {
+        std::lock_guard<std::mutex> lock(cmd_->mutex_);
+        return cmd_->pendingBytes_;
+    }
+
+    void setDrainCallback(std::function<void()> &&callback) override
+    {
+        std::lock_guard<std::mutex> lock(cmd_->mutex_);
+        cmd_->drainCallback_ = std::move(callback);
+    }
+
+  private:
+    // Successive writes are passed to the connection by a single task.
+    bool queueSend()
+    {
+        if (cmd_->sendQueued_)
+            return false;
+        cmd_->sendQueued_ = true;
+        return true;
+    }
+
+    void send()
+    {
+        cmd_->loop_->runInLoop(cmd_->sendCallback_);
+    }
+
+    std::shared_ptr<CopyCmd> cmd_;
+};
+}  // namespace
+
+void DbClient::copyIn(const std::string &sql,
+                      CopyWriterCallback writerCallback,
+                      ResultCallback resultCallback,
+                      ExceptionCallback exceptCallback) noexcept
+{
+    auto cmd = std::make_shared<CopyCmd>();
+    cmd->sql_ = sql;
+    cmd->readyCallback_ = [writerCallback = std::move(writerCallback)](
+                              const std::shared_ptr<CopyCmd> &cmd) {
+        writerCallback(std::make_shared<CopyWriterImpl>(cmd));
+    };
+    startCopy(std::move(cmd),
+              std::move(resultCallback),
+              std::move(exceptCallback));
+}
+
+void DbClient::copyOut(const std::string &sql,
+                       CopyDataCallback dataCallback,
+                       ResultCallback resultCallback,
+                       ExceptionCallback exceptCallback) noexcept
+{
+    auto cmd = std::make_shared<CopyCmd>();
+    cmd->sql_ = sql;
+    cmd->dataCallback_ = std::move(dataCallback);
+    startCopy(std::move(cmd),
+              std::move(resultCallback),
+              std::move(exceptCallback));
+}
+
+void DbClient::startCopy(std::shared_ptr<CopyCmd> &&cmd,
+                         ResultCallback &&resultCallback,
+                         ExceptionCallback &&exceptCallback) noexcept
+{
+    if (type_ != ClientType::PostgreSQL)
+    {
+        exceptCallback(Failure("COPY is only supported by PostgreSQL"));
+        return;
+    }
+    cmd->callback_ = std::move(resultCallback);
+    cmd->exceptionCallback_ = [exceptCallback = std::move(exceptCallback)](
+                                  const std::exception_ptr &ePtr) {
+        try
+        {
+            std::rethrow_exception(ePtr);
+        }
+        catch (const DrogonDbException &e)
+        {
+            exceptCallback(e);
+        }
+    };
+    execCopy(cmd);
+}
+
+void DbClient::execCopy(const std::shared_ptr<CopyCmd> &cmd)
+{
+    newTransactionAsync([cmd](const std::shared_ptr<Transaction> &transaction) {
+        if (!transaction)
+        {
+            cmd->exceptionCallback_(std::make_exception_ptr(TimeoutError(
+                "Timeout, no connection available for transaction")));
+            return;
+        }
+        // The result is delivered once the transaction is committed, which
+        // is when the command releases it.
+        auto result = std::make_shared<std::optional<Result>>();
+        transaction->setCommitCallback(
+            [result,
+             callback = std::move(cmd->callback_),
+             exceptionCallback = cmd->exceptionCallback_](bool committed) {
+                if (committed)
+                {
+                    callback(**result);
+                    return;
+                }
+                exceptionCallback(std::make_exception_ptr(
+                    Failure("Failed to commit the COPY command")));
+            });
+        cmd->callback_ = [result, transaction](const Result &r) {
+            *result = r;
+        };
+        transaction->execCopy(cmd);
+    });
+}
@@ -50,6 +50,22 @@ const Criteria operator&&(Criteria cond1, Criteria cond2)
             cond2Ptr->outputArgumentsFunc_(binder);
         }
     };
+    if (cond1Ptr->outputArrayArgumentsFunc_ ||
+        cond2Ptr->outputArrayArgumentsFunc_)
+    {
+        cond.arrayConditionString_ = "( ";
+        cond.arrayConditionString_ +=
+            cond1Ptr->criteriaString(ClientType::PostgreSQL);
+        cond.arrayConditionString_ += " ) and ( ";
+        cond.arrayConditionString_ +=
+            cond2Ptr->criteriaString(ClientType::PostgreSQL);
+        cond.arrayConditionString_ += " )";
+        cond.outputArrayArgumentsFunc_ =
+            [cond1Ptr, cond2Ptr](internal::SqlBinder &binder) {
+                cond1Ptr->outputArgs(binder, ClientType::PostgreSQL);
+                cond2Ptr->outputArgs(binder, ClientType::PostgreSQL);
+            };
+    }
     return cond;
 }
 
@@ -84,6 +100,22 @@ const Criteria operator||(Criteria cond1, Criteria cond2)
             cond2Ptr->outputArgumentsFunc_(binder);
         }
     };
+    if (cond1Ptr->outputArrayArgumentsFunc_ ||
+        cond2Ptr->outputArrayArgumentsFunc_)
+    {
+        cond.arrayConditionString_ = "( ";
+        cond.arrayConditionString_ +=
+            cond1Ptr->criteriaString(ClientType::PostgreSQL);
+        cond.arrayConditionString_ += " ) or ( ";
+        cond.arrayConditionString_ +=
+            cond2Ptr->criteriaString(ClientType::PostgreSQL);
+        cond.arrayConditionString_ += " )";
+        cond.outputArrayArgumentsFunc_ =
+            [cond1Ptr, cond2Ptr](internal::SqlBinder &binder) {
+                cond1Ptr->outputArgs(binder, ClientType::PostgreSQL);
+                cond2Ptr->outputArgs(binder, ClientType::PostgreSQL);
+            };
+    }
     return cond;
 }
 
@@ -152,6 +184,15 @@ Criteria::Criteria(const Json::Value &json) noexcept(false)
                 binder << arg.asString();
             }
         };
+        std::vector<std::string> values;
+        values.reserve(json[2].size());
+        for (auto &arg : json[2])
+        {
+            values.push_back(arg.asString());
+        }
+        setArrayArgument(json[0].asString(),
+                         CompareOperator::In,
+                         internal::arrayLiteral(values));
     }
 }
 
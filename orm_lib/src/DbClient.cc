@@ -30,19 +30,27 @@ orm::internal::SqlBinder DbClient::operator<<(std::string &&sql)
     return orm::internal::SqlBinder(std::move(sql), *this, type_);
 }
 
-std::shared_ptr<DbClient> DbClient::newPgClient(const std::string &connInfo,
-                                                size_t connNum,
-                                                bool autoBatch)
+std::shared_ptr<DbClient> DbClient::newPgClient(
+    const std::string &connInfo,
+    size_t connNum,
+    bool autoBatch,
+    bool binaryResults,
+    size_t maxPreparedStatements,
+    unsigned int prepareThreshold,
+    std::vector<std::string> warmupStatements)
 {
 #if USE_POSTGRESQL
+    PgConnectionOptions options;
+    options.binaryResults = binaryResults;
+    options.maxPreparedStatements = maxPreparedStatements;
+    options.prepareThreshold = prepareThreshold;
+    options.stats = std::make_shared<PreparedStatementStats>();
     auto client = std::make_shared<DbClientImpl>(connInfo,
                                                  connNum,
-#if LIBPQ_SUPPORTS_BATCH_MODE
                                                  ClientType::PostgreSQL,
-                                                 autoBatch);
-#else
-                                                 ClientType::PostgreSQL);
-#endif
+                                                 autoBatch,
+                                                 std::move(options),
+                                                 std::move(warmupStatements));
     client->init();
     return client;
 #else
@@ -53,18 +61,19 @@ std::shared_ptr<DbClient> DbClient::newPgClient(const std::string &connInfo,
 #endif
 }
 
-std::shared_ptr<DbClient> DbClient::newMysqlClient(const std::string &connInfo,
-                                                   size_t connNum)
+std::shared_ptr<DbClient> DbClient::newMysqlClient(
+    const std::string &connInfo,
+    size_t connNum,
+    bool autoBatch,
+    std::vector<std::string> warmupStatements)
 {
 #if USE_MYSQL
     auto client = std::make_shared<DbClientImpl>(connInfo,
                                                  connNum,
-#if LIBPQ_SUPPORTS_BATCH_MODE
                                                  ClientType::Mysql,
-                                                 false);
-#else
-                                                 ClientType::Mysql);
-#endif
+                                                 autoBatch,
+                                                 PgConnectionOptions{},
+                                                 std::move(warmupStatements));
     client->init();
     return client;
 #else
@@ -72,6 +81,7 @@ std::shared_ptr<DbClient> DbClient::newMysqlClient(const std::string &connInfo,
     exit(1);
     (void)(connInfo);
     (void)(connNum);
+    (void)(autoBatch);
 #endif
 }
 
@@ -82,12 +92,8 @@ std::shared_ptr<DbClient> DbClient::newSqlite3Client(
 #if USE_SQLITE3
     auto client = std::make_shared<DbClientImpl>(connInfo,
                                                  connNum,
-#if LIBPQ_SUPPORTS_BATCH_MODE
                                                  ClientType::Sqlite3,
                                                  false);
-#else
-                                                 ClientType::Sqlite3);
-#endif
     client->init();
     return client;
 #else
@@ -14,6 +14,8 @@
 
 #include "DbClientImpl.h"
 #include "DbConnection.h"
+#include "SqlStats.h"
+#include "SqlTrace.h"
 #include "../../lib/src/TaskTimeoutFlag.h"
 #include <drogon/config.h>
 #include <string_view>
@@ -49,27 +51,29 @@ using namespace drogon::orm;
 
 DbClientImpl::DbClientImpl(const std::string &connInfo,
                            size_t connNum,
-#if LIBPQ_SUPPORTS_BATCH_MODE
                            ClientType type,
-                           bool autoBatch)
-#else
-                           ClientType type)
-#endif
+                           bool autoBatch,
+                           PgConnectionOptions pgOptions,
+                           std::vector<std::string> warmupStatements)
     : numberOfConnections_(connNum),
-#if LIBPQ_SUPPORTS_BATCH_MODE
-      autoBatch_(autoBatch),
-#endif
       loops_(type == ClientType::Sqlite3
                  ? 1
                  : (connNum < std::thread::hardware_concurrency()
                         ? connNum
                         : std::thread::hardware_concurrency()),
-             "DbLoop")
+             "DbLoop"),
+      autoBatch_(autoBatch),
+      pgOptions_(std::move(pgOptions))
 {
     type_ = type;
     connectionInfo_ = connInfo;
     LOG_TRACE << "type=" << (int)type;
     assert(connNum > 0);
+    if (!warmupStatements.empty())
+    {
+        warmupStatements_ = std::make_shared<const std::vector<std::string>>(
+            std::move(warmupStatements));
+    }
 }
 
 void DbClientImpl::init()
@@ -109,6 +113,7 @@ void DbClientImpl::closeAll()
         connections.swap(connections_);
         readyConnections_.clear();
         busyConnections_.clear();
+        idleSince_.clear();
     }
     for (auto const &conn : connections)
     {
@@ -130,7 +135,13 @@ void DbClientImpl::execSql(
     assert(paraNum == length.size());
     assert(paraNum == format.size());
     assert(rcb);
-    if (timeout_ > 0.0)
+    traceSql(type_, sql, sqlLength, rcb, exceptCallback);
+    recordSqlStats(type_, sql, sqlLength, paraNum, rcb, exceptCallback);
+    double timeout = timeout_;
+    if (!applyDeadline(timeout, rcb, exceptCallback) ||
+        !applyCircuitBreaker(circuitBreakerPtr_, rcb, exceptCallback))
+        return;
+    if (timeout > 0.0)
     {
         execSqlWithTimeout(sql,
                            sqlLength,
@@ -138,12 +149,14 @@ void DbClientImpl::execSql(
                            std::move(parameters),
                            std::move(length),
                            std::move(format),
+                           timeout,
                            std::move(rcb),
                            std::move(exceptCallback));
         return;
     }
     DbConnectionPtr conn;
     bool busy = false;
+    bool grow = false;
     {
         std::lock_guard<std::mutex> guard(connectionsMutex_);
 
@@ -165,7 +178,9 @@ void DbClientImpl::execSql(
                                              std::move(format),
                                              std::move(rcb),
                                              std::move(exceptCallback));
+                cmd->queuedAt_ = std::chrono::steady_clock::now();
                 sqlCmdBuffer_.push_back(std::move(cmd));
+                grow = needMoreConnections();
             }
         }
         else
@@ -194,6 +209,8 @@ void DbClientImpl::execSql(
         exceptCallback(exceptPtr);
         return;
     }
+    if (grow)
+        addConnection();
 }
 
 void DbClientImpl::newTransactionAsync(
@@ -201,6 +218,7 @@ void DbClientImpl::newTransactionAsync(
     TransactionType transType)
 {
     DbConnectionPtr conn;
+    bool grow = false;
     {
         std::lock_guard<std::mutex> lock(connectionsMutex_);
         if (!readyConnections_.empty())
@@ -253,6 +271,7 @@ void DbClientImpl::newTransactionAsync(
                 timeoutFlagPtr->runTimer();
             }
             transCallbacks_.push_back({callbackPtr, transType});
+            grow = needMoreConnections();
         }
     }
     if (conn)
@@ -262,6 +281,10 @@ void DbClientImpl::newTransactionAsync(
                       callback),
                   transType);
     }
+    else if (grow)
+    {
+        addConnection();
+    }
 }
 
 void DbClientImpl::makeTrans(
@@ -347,7 +370,8 @@ void DbClientImpl::handleNewTask(const DbConnectionPtr &connPtr)
 {
     std::function<void(const std::shared_ptr<Transaction> &)> transCallback;
     TransactionType transType{TransactionType::Deferred};
-    std::shared_ptr<SqlCmd> cmd;
+    std::deque<std::shared_ptr<SqlCmd>> cmds;
+    double idleTimeout = 0.0;
     {
         std::lock_guard<std::mutex> guard(connectionsMutex_);
         if (!transCallbacks_.empty())
@@ -359,23 +383,65 @@ void DbClientImpl::handleNewTask(const DbConnectionPtr &connPtr)
         }
         else if (!sqlCmdBuffer_.empty())
         {
-            cmd = std::move(sqlCmdBuffer_.front());
-            sqlCmdBuffer_.pop_front();
+#if USE_MYSQL
+            if (type_ == ClientType::Mysql && autoBatch_)
+            {
+                cmds = MysqlConnection::takeBatch(sqlCmdBuffer_);
+            }
+            else
+#endif
+            {
+                cmds.push_back(std::move(sqlCmdBuffer_.front()));
+                sqlCmdBuffer_.pop_front();
+            }
+            auto now = std::chrono::steady_clock::now();
+            for (auto const &cmd : cmds)
+            {
+                std::chrono::duration<double> waitTime = now - cmd->queuedAt_;
+                queueWaitTime_ += waitTime.count();
+                ++queuedCommands_;
+            }
         }
         else
         {
             // Connection is idle, put it into the readyConnections_ set;
             busyConnections_.erase(connPtr);
             readyConnections_.insert(connPtr);
+            if (maxConnections_ > numberOfConnections_)
+            {
+                idleSince_[connPtr] = std::chrono::steady_clock::now();
+                idleTimeout = idleTimeout_;
+            }
         }
     }
+    if (idleTimeout > 0.0)
+    {
+        std::weak_ptr<DbClientImpl> weakPtr = shared_from_this();
+        std::weak_ptr<DbConnection> weakConn = connPtr;
+        connPtr->loop()->runAfter(idleTimeout, [weakPtr, weakConn]() {
+            auto thisPtr = weakPtr.lock();
+            if (!thisPtr)
+                return;
+            auto connPtr = weakConn.lock();
+            if (!connPtr)
+                return;
+            thisPtr->closeIdleConnection(connPtr);
+        });
+        return;
+    }
     if (transCallback)
     {
         makeTrans(connPtr, std::move(transCallback), transType);
         return;
     }
-    if (cmd)
+    if (cmds.size() > 1)
+    {
+        connPtr->batchSql(std::move(cmds));
+        return;
+    }
+    if (!cmds.empty())
     {
+        auto &cmd = cmds.front();
         connPtr->execSql(std::move(cmd->sql_),
                          cmd->parametersNumber_,
                          std::move(cmd->parameters_),
@@ -394,10 +460,15 @@ DbConnectionPtr DbClientImpl::newConnection(trantor::EventLoop *loop)
     {
 #if USE_POSTGRESQL
 #if LIBPQ_SUPPORTS_BATCH_MODE
-        connPtr =
-            std::make_shared<PgConnection>(loop, connectionInfo_, autoBatch_);
+        connPtr = std::make_shared<PgConnection>(loop,
+                                                 connectionInfo_,
+                                                 autoBatch_,
+                                                 pgOptions_);
 #else
-        connPtr = std::make_shared<PgConnection>(loop, connectionInfo_, false);
+        connPtr = std::make_shared<PgConnection>(loop,
+                                                 connectionInfo_,
+                                                 false,
+                                                 pgOptions_);
 #endif
 #else
         return nullptr;
@@ -406,7 +477,9 @@ DbConnectionPtr DbClientImpl::newConnection(trantor::EventLoop *loop)
     else if (type_ == ClientType::Mysql)
     {
 #if USE_MYSQL
-        connPtr = std::make_shared<MysqlConnection>(loop, connectionInfo_);
+        connPtr = std::make_shared<MysqlConnection>(loop,
+                                                    connectionInfo_,
+                                                    autoBatch_);
 #else
         return nullptr;
 #endif
@@ -426,24 +499,34 @@ DbConnectionPtr DbClientImpl::newConnection(trantor::EventLoop *loop)
         return nullptr;
         (void)(loop);
     }
+    connPtr->setWarmupStatements(warmupStatements_);
     std::weak_ptr<DbClientImpl> weakPtr = shared_from_this();
     connPtr->setCloseCallback([weakPtr](const DbConnectionPtr &closeConnPtr) {
         // Erase the connection
         auto thisPtr = weakPtr.lock();
         if (!thisPtr)
             return;
+        bool reconnect;
         {
             std::lock_guard<std::mutex> guard(thisPtr->connectionsMutex_);
             thisPtr->readyConnections_.erase(closeConnPtr);
             thisPtr->busyConnections_.erase(closeConnPtr);
+            thisPtr->idleSince_.erase(closeConnPtr);
             assert(thisPtr->connections_.find(closeConnPtr) !=
                    thisPtr->connections_.end());
             thisPtr->connections_.erase(closeConnPtr);
+            // The connections opened for the load aren't restored, new ones
+            // are opened if the commands wait again.
+            reconnect = thisPtr->connections_.size() +
+                            thisPtr->growingConnections_ <
+                        thisPtr->numberOfConnections_;
         }
-        // Reconnect after 1 second
         auto loop = closeConnPtr->loop();
         // closeConnPtr may be not valid. Close the connection file descriptor.
         closeConnPtr->disconnect();
+        if (!reconnect)
+            return;
+        // Reconnect after 1 second
         loop->runAfter(1, [weakPtr, loop, closeConnPtr] {
             auto thisPtr = weakPtr.lock();
             if (!thisPtr)
@@ -495,6 +578,24 @@ bool DbClientImpl::hasAvailableConnections() const noexcept
     return (!readyConnections_.empty()) || (!busyConnections_.empty());
 }
 
+DbClient::ConnectionStats DbClientImpl::connectionStats() const noexcept
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    ConnectionStats stats;
+    stats.busy = busyConnections_.size();
+    stats.idle = readyConnections_.size();
+    stats.pending = sqlCmdBuffer_.size();
+    stats.queueWaitTime = queueWaitTime_;
+    stats.queuedCommands = queuedCommands_;
+    if (pgOptions_.stats)
+    {
+        stats.preparedStatementHits = pgOptions_.stats->hits;
+        stats.preparedStatementMisses = pgOptions_.stats->misses;
+        stats.preparedStatementEvictions = pgOptions_.stats->evictions;
+    }
+    return stats;
+}
+
 void DbClientImpl::execSqlWithTimeout(
     const char *sql,
     size_t sqlLength,
@@ -502,19 +603,21 @@ void DbClientImpl::execSqlWithTimeout(
     std::vector<const char *> &&parameters,
     std::vector<int> &&length,
     std::vector<int> &&format,
+    double timeout,
     ResultCallback &&rcb,
     std::function<void(const std::exception_ptr &)> &&ecb)
 {
     DbConnectionPtr conn;
-    assert(timeout_ > 0.0);
+    assert(timeout > 0.0);
     auto cmd = std::make_shared<std::weak_ptr<SqlCmd>>();
     bool busy = false;
+    bool grow = false;
     auto ecpPtr =
         std::make_shared<std::function<void(const std::exception_ptr &)>>(
             std::move(ecb));
     auto timeoutFlagPtr = std::make_shared<drogon::TaskTimeoutFlag>(
         loops_.getNextLoop(),
-        std::chrono::duration<double>(timeout_),
+        std::chrono::duration<double>(timeout),
         [cmd, ecpPtr, thisPtr = shared_from_this()]() {
             auto cbPtr = (*cmd).lock();
             if (cbPtr)
@@ -569,8 +672,10 @@ void DbClientImpl::execSqlWithTimeout(
                                              std::move(format),
                                              std::move(resultCallback),
                                              std::move(exceptionCallback));
+                command->queuedAt_ = std::chrono::steady_clock::now();
                 sqlCmdBuffer_.emplace_back(command);
                 *cmd = command;
+                grow = needMoreConnections();
             }
         }
         else
@@ -600,6 +705,74 @@ void DbClientImpl::execSqlWithTimeout(
             std::make_exception_ptr(Failure("Too many queries in buffer")));
         return;
     }
+    if (grow)
+        addConnection();
 
     timeoutFlagPtr->runTimer();
 }
+
+void DbClientImpl::enableAdaptivePool(size_t maxConnections, double idleTimeout)
+{
+    if (type_ == ClientType::Sqlite3)
+    {
+        LOG_WARN << "The pool of a sqlite3 client has a fixed size";
+        return;
+    }
+    std::lock_guard<std::mutex> guard(connectionsMutex_);
+    maxConnections_ = maxConnections;
+    idleTimeout_ = idleTimeout;
+}
+
+// Called with connectionsMutex_ locked, a true result reserves a connection
+// which is opened by addConnection() once the mutex is unlocked.
+bool DbClientImpl::needMoreConnections()
+{
+    auto total = connections_.size() + growingConnections_;
+    if (total >= maxConnections_)
+        return false;
+    // The connections being established take the first waiting tasks.
+    auto connecting =
+        total - readyConnections_.size() - busyConnections_.size();
+    if (connecting >= sqlCmdBuffer_.size() + transCallbacks_.size())
+        return false;
+    ++growingConnections_;
+    return true;
+}
+
+void DbClientImpl::addConnection()
+{
+    auto loop = loops_.getNextLoop();
+    std::weak_ptr<DbClientImpl> weakPtr = shared_from_this();
+    loop->runInLoop([weakPtr, loop]() {
+        auto thisPtr = weakPtr.lock();
+        if (!thisPtr)
+            return;
+        thisPtr->newConnection(loop);
+        std::lock_guard<std::mutex> guard(thisPtr->connectionsMutex_);
+        --thisPtr->growingConnections_;
+    });
+}
+
+void DbClientImpl::closeIdleConnection(const DbConnectionPtr &conn)
+{
+    {
+        std::lock_guard<std::mutex> guard(connectionsMutex_);
+        if (connections_.size() <= numberOfConnections_ ||
+            readyConnections_.find(conn) == readyConnections_.end())
+            return;
+        auto iter = idleSince_.find(conn);
+        if (iter == idleSince_.end())
+            return;
+        // The connection was busy in the meantime, the timer set when it was
+        // idle again closes it.
+        std::chrono::duration<double> idleTime =
+            std::chrono::steady_clock::now() - iter->second;
+        if (idleTime.count() < idleTimeout_ * 0.99)
+            return;
+        idleSince_.erase(iter);
+        readyConnections_.erase(conn);
+        connections_.erase(conn);
+    }
+    LOG_TRACE << "close an idle connection";
+    conn->disconnect();
+}
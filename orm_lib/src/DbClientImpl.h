@@ -17,11 +17,13 @@
 #include "DbConnection.h"
 #include <drogon/orm/DbClient.h>
 #include <trantor/net/EventLoopThreadPool.h>
+#include <chrono>
 #include <functional>
 #include <list>
 #include <memory>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace drogon
@@ -34,12 +36,10 @@ class DbClientImpl : public DbClient,
   public:
     DbClientImpl(const std::string &connInfo,
                  size_t connNum,
-#if LIBPQ_SUPPORTS_BATCH_MODE
                  ClientType type,
-                 bool autoBatch);
-#else
-                 ClientType type);
-#endif
+                 bool autoBatch,
+                 PgConnectionOptions pgOptions = {},
+                 std::vector<std::string> warmupStatements = {});
     ~DbClientImpl() noexcept override;
     void execSql(const char *sql,
                  size_t sqlLength,
@@ -60,12 +60,21 @@ class DbClientImpl : public DbClient,
             &callback,
         TransactionType transType = TransactionType::Deferred) override;
     bool hasAvailableConnections() const noexcept override;
+    ConnectionStats connectionStats() const noexcept override;
 
     void setTimeout(double timeout) override
     {
         timeout_ = timeout;
     }
 
+    void setCircuitBreaker(CircuitBreakerPtr breaker) override
+    {
+        circuitBreakerPtr_ = std::move(breaker);
+    }
+
+    void enableAdaptivePool(size_t maxConnections,
+                            double idleTimeout) override;
+
     void init();
     void closeAll() override;
 
@@ -74,11 +83,28 @@ class DbClientImpl : public DbClient,
     trantor::EventLoopThreadPool loops_;
     std::shared_ptr<SharedMutex> sharedMutexPtr_;
     double timeout_{-1.0};
-#if LIBPQ_SUPPORTS_BATCH_MODE
+    CircuitBreakerPtr circuitBreakerPtr_;
     bool autoBatch_{false};
-#endif
+    PgConnectionOptions pgOptions_;
+    // The statements prepared by every connection before it's used.
+    std::shared_ptr<const std::vector<std::string>> warmupStatements_;
     DbConnectionPtr newConnection(trantor::EventLoop *loop);
 
+    // The connections beyond numberOfConnections_ are opened when commands
+    // wait for a connection, up to maxConnections_, and closed after being
+    // idle for idleTimeout_ seconds. All guarded by connectionsMutex_.
+    size_t maxConnections_{0};
+    double idleTimeout_{60.0};
+    size_t growingConnections_{0};
+    std::unordered_map<DbConnectionPtr, std::chrono::steady_clock::time_point>
+        idleSince_;
+    bool needMoreConnections();
+    void addConnection();
+    void closeIdleConnection(const DbConnectionPtr &conn);
+
+    double queueWaitTime_{0.0};
+    size_t queuedCommands_{0};
+
     void makeTrans(
         const DbConnectionPtr &conn,
         std::function<void(const std::shared_ptr<Transaction> &)> &&callback,
@@ -105,6 +131,7 @@ class DbClientImpl : public DbClient,
         std::vector<const char *> &&parameters,
         std::vector<int> &&length,
         std::vector<int> &&format,
+        double timeout,
         ResultCallback &&rcb,
         std::function<void(const std::exception_ptr &)> &&exceptCallback);
 };
@@ -14,6 +14,8 @@
 
 #include "DbClientLockFree.h"
 #include "DbConnection.h"
+#include "SqlStats.h"
+#include "SqlTrace.h"
 #include "TransactionImpl.h"
 #include "../../lib/src/TaskTimeoutFlag.h"
 #include <drogon/config.h>
@@ -44,21 +46,23 @@ using namespace drogon::orm;
 DbClientLockFree::DbClientLockFree(const std::string &connInfo,
                                    trantor::EventLoop *loop,
                                    ClientType type,
-#if LIBPQ_SUPPORTS_BATCH_MODE
                                    size_t connectionNumberPerLoop,
-                                   bool autoBatch)
-#else
-                                   size_t connectionNumberPerLoop)
-#endif
+                                   bool autoBatch,
+                                   PgConnectionOptions pgOptions,
+                                   std::vector<std::string> warmupStatements)
     : connectionInfo_(connInfo),
       loop_(loop),
-#if LIBPQ_SUPPORTS_BATCH_MODE
+      numberOfConnections_(connectionNumberPerLoop),
       autoBatch_(autoBatch),
-#endif
-      numberOfConnections_(connectionNumberPerLoop)
+      pgOptions_(std::move(pgOptions))
 {
     type_ = type;
     LOG_TRACE << "type=" << (int)type;
+    if (!warmupStatements.empty())
+    {
+        warmupStatements_ = std::make_shared<const std::vector<std::string>>(
+            std::move(warmupStatements));
+    }
     if (type == ClientType::PostgreSQL || type == ClientType::Mysql)
     {
         loop_->queueInLoop([this]() {
@@ -101,7 +105,13 @@ void DbClientLockFree::execSql(
     assert(paraNum == format.size());
     assert(rcb);
     loop_->assertInLoopThread();
-    if (timeout_ > 0.0)
+    traceSql(type_, sql, sqlLength, rcb, exceptCallback);
+    recordSqlStats(type_, sql, sqlLength, paraNum, rcb, exceptCallback);
+    double timeout = timeout_;
+    if (!applyDeadline(timeout, rcb, exceptCallback) ||
+        !applyCircuitBreaker(circuitBreakerPtr_, rcb, exceptCallback))
+        return;
+    if (timeout > 0.0)
     {
         execSqlWithTimeout(sql,
                            sqlLength,
@@ -109,6 +119,7 @@ void DbClientLockFree::execSql(
                            std::move(parameters),
                            std::move(length),
                            std::move(format),
+                           timeout,
                            std::move(rcb),
                            std::move(exceptCallback));
         return;
@@ -140,6 +151,7 @@ void DbClientLockFree::execSql(
                         }
                     },
                     std::move(exceptCallback));
+                updateIdleConnections();
                 return;
             }
         }
@@ -170,6 +182,7 @@ void DbClientLockFree::execSql(
                             }
                         },
                         std::move(exceptCallback));
+                    updateIdleConnections();
                     return;
                 }
             }
@@ -192,6 +205,7 @@ void DbClientLockFree::execSql(
                                   std::move(format),
                                   std::move(rcb),
                                   std::move(exceptCallback));
+                    updateIdleConnections();
                     return;
                 }
             }
@@ -210,7 +224,7 @@ void DbClientLockFree::execSql(
     }
 
     // LOG_TRACE << "Push query to buffer";
-    sqlCmdBuffer_.emplace_back(std::make_shared<SqlCmd>(
+    auto cmdPtr = std::make_shared<SqlCmd>(
         std::string_view{sql, sqlLength},
         paraNum,
         std::move(parameters),
@@ -226,7 +240,11 @@ void DbClientLockFree::execSql(
                 loop_->queueInLoop([rcb = std::move(rcb), r]() { rcb(r); });
             }
         },
-        std::move(exceptCallback)));
+        std::move(exceptCallback));
+    if (handOverToSibling(cmdPtr))
+        return;
+    sqlCmdBuffer_.emplace_back(std::move(cmdPtr));
+    updateIdleConnections();
 }
 
 std::shared_ptr<Transaction> DbClientLockFree::newTransaction(
@@ -296,6 +314,7 @@ void DbClientLockFree::newTransactionAsync(
         timeoutFlagPtr->runTimer();
     }
     transCallbacks_.push_back({callbackPtr, transType});
+    updateIdleConnections();
 }
 
 void DbClientLockFree::makeTrans(
@@ -354,6 +373,7 @@ void DbClientLockFree::makeTrans(
         },
         transType);
     transSet_.insert(conn);
+    updateIdleConnections();
     trans->doBegin();
     if (timeout_ > 0.0)
     {
@@ -381,26 +401,24 @@ void DbClientLockFree::handleNewTask(const DbConnectionPtr &conn)
     if (!sqlCmdBuffer_.empty())
     {
 #if LIBPQ_SUPPORTS_BATCH_MODE
-        if (type_ != ClientType::PostgreSQL)
-        {
-            std::shared_ptr<SqlCmd> cmd = std::move(sqlCmdBuffer_.front());
-            sqlCmdBuffer_.pop_front();
-            conn->execSql(std::move(cmd->sql_),
-                          cmd->parametersNumber_,
-                          std::move(cmd->parameters_),
-                          std::move(cmd->lengths_),
-                          std::move(cmd->formats_),
-                          std::move(cmd->callback_),
-                          std::move(cmd->exceptionCallback_));
-        }
-        else
+        if (type_ == ClientType::PostgreSQL)
         {
             std::deque<std::shared_ptr<SqlCmd>> cmds;
             using std::swap;
             swap(cmds, sqlCmdBuffer_);
             conn->batchSql(std::move(cmds));
+            updateIdleConnections();
+            return;
         }
-#else
+#endif
+#if USE_MYSQL
+        if (type_ == ClientType::Mysql && autoBatch_)
+        {
+            conn->batchSql(MysqlConnection::takeBatch(sqlCmdBuffer_));
+            updateIdleConnections();
+            return;
+        }
+#endif
         std::shared_ptr<SqlCmd> cmd = std::move(sqlCmdBuffer_.front());
         sqlCmdBuffer_.pop_front();
         conn->execSql(std::move(cmd->sql_),
@@ -410,9 +428,10 @@ void DbClientLockFree::handleNewTask(const DbConnectionPtr &conn)
                       std::move(cmd->formats_),
                       std::move(cmd->callback_),
                       std::move(cmd->exceptionCallback_));
-#endif
+        updateIdleConnections();
         return;
     }
+    updateIdleConnections();
 }
 
 DbConnectionPtr DbClientLockFree::newConnection()
@@ -422,10 +441,15 @@ DbConnectionPtr DbClientLockFree::newConnection()
     {
 #if USE_POSTGRESQL
 #if LIBPQ_SUPPORTS_BATCH_MODE
-        connPtr =
-            std::make_shared<PgConnection>(loop_, connectionInfo_, autoBatch_);
+        connPtr = std::make_shared<PgConnection>(loop_,
+                                                 connectionInfo_,
+                                                 autoBatch_,
+                                                 pgOptions_);
 #else
-        connPtr = std::make_shared<PgConnection>(loop_, connectionInfo_, false);
+        connPtr = std::make_shared<PgConnection>(loop_,
+                                                 connectionInfo_,
+                                                 false,
+                                                 pgOptions_);
 #endif
 #else
         return nullptr;
@@ -434,7 +458,9 @@ DbConnectionPtr DbClientLockFree::newConnection()
     else if (type_ == ClientType::Mysql)
     {
 #if USE_MYSQL
-        connPtr = std::make_shared<MysqlConnection>(loop_, connectionInfo_);
+        connPtr = std::make_shared<MysqlConnection>(loop_,
+                                                    connectionInfo_,
+                                                    autoBatch_);
 #else
         return nullptr;
 #endif
@@ -443,6 +469,7 @@ DbConnectionPtr DbClientLockFree::newConnection()
     {
         return nullptr;
     }
+    connPtr->setWarmupStatements(warmupStatements_);
 
     std::weak_ptr<DbClientLockFree> weakPtr = shared_from_this();
     connPtr->setCloseCallback([weakPtr](const DbConnectionPtr &closeConnPtr) {
@@ -464,6 +491,7 @@ DbConnectionPtr DbClientLockFree::newConnection()
             thisPtr->connectionHolders_.erase(iter);
 
         thisPtr->transSet_.erase(closeConnPtr);
+        thisPtr->updateIdleConnections();
         // Reconnect after 1 second
         thisPtr->loop_->runAfter(1, [weakPtr, closeConnPtr] {
             auto thisPtr = weakPtr.lock();
@@ -501,6 +529,92 @@ DbConnectionPtr DbClientLockFree::newConnection()
     return connPtr;
 }
 
+void DbClientLockFree::setSiblings(
+    std::vector<std::weak_ptr<DbClientLockFree>> siblings)
+{
+    loop_->queueInLoop([this, siblings = std::move(siblings)]() mutable {
+        siblings_ = std::move(siblings);
+    });
+}
+
+void DbClientLockFree::updateIdleConnections()
+{
+    size_t idle = 0;
+    if (sqlCmdBuffer_.empty() && transCallbacks_.empty())
+    {
+        for (auto &conn : connections_)
+        {
+            if (!conn->isWorking() && transSet_.find(conn) == transSet_.end())
+                ++idle;
+        }
+    }
+    idleConnections_.store(idle, std::memory_order_relaxed);
+}
+
+bool DbClientLockFree::handOverToSibling(const std::shared_ptr<SqlCmd> &cmd)
+{
+    for (size_t i = 0; i < siblings_.size(); ++i)
+    {
+        auto sibling = siblings_[siblingPos_++].lock();
+        if (siblingPos_ >= siblings_.size())
+            siblingPos_ = 0;
+        if (!sibling)
+            continue;
+        // Reserve one of the idle connections so that the other loops don't
+        // all pick the same sibling.
+        auto idle = sibling->idleConnections_.load(std::memory_order_relaxed);
+        while (idle > 0 && !sibling->idleConnections_.compare_exchange_weak(
+                               idle, idle - 1, std::memory_order_relaxed))
+        {
+        }
+        if (idle == 0)
+            continue;
+
+        // The callbacks are wrapped to run in the loop of this client.
+        cmd->callback_ = [loop = loop_, cb = std::move(cmd->callback_)](
+                             const Result &r) {
+            loop->queueInLoop([cb, r]() { cb(r); });
+        };
+        cmd->exceptionCallback_ =
+            [loop = loop_, ecb = std::move(cmd->exceptionCallback_)](
+                const std::exception_ptr &e) {
+                loop->queueInLoop([ecb, e]() { ecb(e); });
+            };
+        sibling->loop_->queueInLoop([sibling, cmd]() mutable {
+            sibling->execSiblingCommand(std::move(cmd));
+        });
+        return true;
+    }
+    return false;
+}
+
+void DbClientLockFree::execSiblingCommand(std::shared_ptr<SqlCmd> &&cmd)
+{
+    loop_->assertInLoopThread();
+    if (sqlCmdBuffer_.empty() && transCallbacks_.empty())
+    {
+        for (auto &conn : connections_)
+        {
+            if (!conn->isWorking() && transSet_.find(conn) == transSet_.end())
+            {
+                conn->execSql(std::move(cmd->sql_),
+                              cmd->parametersNumber_,
+                              std::move(cmd->parameters_),
+                              std::move(cmd->lengths_),
+                              std::move(cmd->formats_),
+                              std::move(cmd->callback_),
+                              std::move(cmd->exceptionCallback_));
+                updateIdleConnections();
+                return;
+            }
+        }
+    }
+    // The connection was taken in the meantime, the query waits here and is
+    // never handed over again.
+    sqlCmdBuffer_.emplace_back(std::move(cmd));
+    updateIdleConnections();
+}
+
 bool DbClientLockFree::hasAvailableConnections() const noexcept
 {
     return !connections_.empty();
@@ -513,6 +627,7 @@ void DbClientLockFree::execSqlWithTimeout(
     std::vector<const char *> &&parameters,
     std::vector<int> &&length,
     std::vector<int> &&format,
+    double timeout,
     ResultCallback &&rcb,
     std::function<void(const std::exception_ptr &)> &&ecb)
 {
@@ -522,7 +637,7 @@ void DbClientLockFree::execSqlWithTimeout(
             std::move(ecb));
     auto timeoutFlagPtr = std::make_shared<drogon::TaskTimeoutFlag>(
         loop_,
-        std::chrono::duration<double>(timeout_),
+        std::chrono::duration<double>(timeout),
         [commandPtr, ecpPtr, thisPtr = shared_from_this()]() {
             auto cbPtr = (*commandPtr).lock();
             if (cbPtr)
@@ -584,6 +699,7 @@ void DbClientLockFree::execSqlWithTimeout(
                     },
                     std::move(exceptionCallback));
                 timeoutFlagPtr->runTimer();
+                updateIdleConnections();
                 return;
             }
         }
@@ -617,6 +733,7 @@ void DbClientLockFree::execSqlWithTimeout(
                         },
                         std::move(exceptionCallback));
                     timeoutFlagPtr->runTimer();
+                    updateIdleConnections();
                     return;
                 }
             }
@@ -640,6 +757,7 @@ void DbClientLockFree::execSqlWithTimeout(
                                   std::move(resultCallback),
                                   std::move(exceptionCallback));
                     timeoutFlagPtr->runTimer();
+                    updateIdleConnections();
                     return;
                 }
             }
@@ -675,7 +793,10 @@ void DbClientLockFree::execSqlWithTimeout(
             }
         },
         std::move(exceptionCallback));
-    sqlCmdBuffer_.emplace_back(cmdPtr);
     *commandPtr = cmdPtr;
     timeoutFlagPtr->runTimer();
+    if (handOverToSibling(cmdPtr))
+        return;
+    sqlCmdBuffer_.emplace_back(std::move(cmdPtr));
+    updateIdleConnections();
 }
@@ -17,6 +17,7 @@
 #include "DbConnection.h"
 #include <drogon/orm/DbClient.h>
 #include <trantor/net/EventLoopThreadPool.h>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <queue>
@@ -36,12 +37,10 @@ class DbClientLockFree : public DbClient,
     DbClientLockFree(const std::string &connInfo,
                      trantor::EventLoop *loop,
                      ClientType type,
-#if LIBPQ_SUPPORTS_BATCH_MODE
                      size_t connectionNumberPerLoop,
-                     bool autoBatch);
-#else
-                     size_t connectionNumberPerLoop);
-#endif
+                     bool autoBatch,
+                     PgConnectionOptions pgOptions = {},
+                     std::vector<std::string> warmupStatements = {});
 
     ~DbClientLockFree() noexcept override;
     void execSql(const char *sql,
@@ -69,8 +68,20 @@ class DbClientLockFree : public DbClient,
         timeout_ = timeout;
     }
 
+    void setCircuitBreaker(CircuitBreakerPtr breaker) override
+    {
+        circuitBreakerPtr_ = std::move(breaker);
+    }
+
     void closeAll() override;
 
+    /**
+     * @brief Set the clients of the other IO loops, a query which would wait
+     * for a connection of this loop is handed over to one of them which has
+     * an idle connection. The results are still delivered in this loop.
+     */
+    void setSiblings(std::vector<std::weak_ptr<DbClientLockFree>> siblings);
+
   private:
     std::string connectionInfo_;
     trantor::EventLoop *loop_;
@@ -88,6 +99,7 @@ class DbClientLockFree : public DbClient,
     std::list<TransCallbackEntry> transCallbacks_;
 
     double timeout_{-1.0};
+    CircuitBreakerPtr circuitBreakerPtr_;
 
     void makeTrans(
         const DbConnectionPtr &conn,
@@ -100,13 +112,29 @@ class DbClientLockFree : public DbClient,
         std::vector<const char *> &&parameters,
         std::vector<int> &&length,
         std::vector<int> &&format,
+        double timeout,
         ResultCallback &&rcb,
         std::function<void(const std::exception_ptr &)> &&ecb);
     void handleNewTask(const DbConnectionPtr &conn);
+
+    // Publish the number of connections ready for a new query, read by the
+    // siblings from their loops.
+    void updateIdleConnections();
+    // Called in the loop of this client, returns false if no sibling has an
+    // idle connection.
+    bool handOverToSibling(const std::shared_ptr<SqlCmd> &cmd);
+    // Called in the loop of this client for a query of a sibling.
+    void execSiblingCommand(std::shared_ptr<SqlCmd> &&cmd);
+    std::vector<std::weak_ptr<DbClientLockFree>> siblings_;
+    size_t siblingPos_{0};
+    std::atomic<size_t> idleConnections_{0};
 #if LIBPQ_SUPPORTS_BATCH_MODE
     size_t connectionPos_{0};  // Used for pg batch mode.
-    bool autoBatch_{false};
 #endif
+    bool autoBatch_{false};
+    PgConnectionOptions pgOptions_;
+    // The statements prepared by every connection before it's used.
+    std::shared_ptr<const std::vector<std::string>> warmupStatements_;
 };
 
 }  // namespace orm
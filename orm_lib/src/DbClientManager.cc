@@ -48,26 +48,70 @@ static void initFastDbClients(IOThreadStorage<orm::DbClientPtr> &storage,
                               ClientType dbType,
                               size_t connNum,
                               bool autoBatch,
+                              const orm::PgConnectionOptions &pgOptions,
+                              const std::vector<std::string> &warmupStatements,
                               double timeout)
 {
+    std::vector<std::shared_ptr<orm::DbClientLockFree>> clients;
     storage.init([&](orm::DbClientPtr &c, size_t idx) {
         assert(idx == ioLoops[idx]->index());
         LOG_TRACE << "create fast database client for the thread " << idx;
-        c = std::shared_ptr<orm::DbClient>(
-            new drogon::orm::DbClientLockFree(connInfo,
-                                              ioLoops[idx],
-                                              dbType,
-#if LIBPQ_SUPPORTS_BATCH_MODE  // Bad code
-                                              connNum,
-                                              autoBatch));
-#else
-                                              connNum));
-#endif
+        auto client =
+            std::make_shared<orm::DbClientLockFree>(connInfo,
+                                                    ioLoops[idx],
+                                                    dbType,
+                                                    connNum,
+                                                    autoBatch,
+                                                    pgOptions,
+                                                    warmupStatements);
         if (timeout > 0.0)
         {
-            c->setTimeout(timeout);
+            client->setTimeout(timeout);
         }
+        clients.push_back(client);
+        c = std::move(client);
     });
+    // The queries of a loop whose connections are all busy are handed over
+    // to the idle connections of the other loops.
+    for (auto &client : clients)
+    {
+        std::vector<std::weak_ptr<orm::DbClientLockFree>> siblings;
+        for (auto &other : clients)
+        {
+            if (other != client)
+                siblings.push_back(other);
+        }
+        client->setSiblings(std::move(siblings));
+    }
+}
+
+// The clients of the replicas have the configuration of the primary one.
+static DbClientPtr addReplicas(
+    DbClientPtr primary,
+    const std::vector<std::string> &replicaConnInfos,
+    double maxReplicaLag,
+    const std::function<DbClientPtr(const std::string &)> &newClient)
+{
+    if (replicaConnInfos.empty())
+        return primary;
+    std::vector<DbClientPtr> replicas;
+    for (auto const &connInfo : replicaConnInfos)
+    {
+        replicas.push_back(newClient(connInfo));
+    }
+    return DbClient::newReplicatedClient(std::move(primary),
+                                         std::move(replicas),
+                                         maxReplicaLag);
+}
+
+static void warnFastReplicas(const std::string &name,
+                             const std::vector<std::string> &replicaConnInfos)
+{
+    if (!replicaConnInfos.empty())
+    {
+        LOG_WARN << "The replicas of the fast database client " << name
+                 << " are ignored";
+    }
 }
 
 void DbClientManager::createDbClients(
@@ -82,22 +126,46 @@ void DbClientManager::createDbClients(
             auto &cfg = std::get<PostgresConfig>(dbInfo.config_);
             if (cfg.isFast)
             {
+                warnFastReplicas(cfg.name, dbInfo.replicaConnectionInfos_);
                 dbFastClientsMap_[cfg.name] =
                     IOThreadStorage<orm::DbClientPtr>();
+                orm::PgConnectionOptions options;
+                options.binaryResults = cfg.binaryResults;
+                options.maxPreparedStatements = cfg.maxPreparedStatements;
+                options.prepareThreshold = cfg.prepareThreshold;
                 initFastDbClients(dbFastClientsMap_[cfg.name],
                                   ioLoops,
                                   dbInfo.connectionInfo_,
                                   ClientType::PostgreSQL,
                                   cfg.connectionNumber,
                                   cfg.autoBatch,
+                                  options,
+                                  cfg.warmupStatements,
                                   cfg.timeout);
             }
             else
             {
+                auto newClient = [&cfg](const std::string &connInfo) {
+                    auto client = drogon::orm::DbClient::newPgClient(
+                        connInfo,
+                        cfg.connectionNumber,
+                        cfg.autoBatch,
+                        cfg.binaryResults,
+                        cfg.maxPreparedStatements,
+                        cfg.prepareThreshold,
+                        cfg.warmupStatements);
+                    if (cfg.maxConnectionNumber > cfg.connectionNumber)
+                    {
+                        client->enableAdaptivePool(cfg.maxConnectionNumber,
+                                                   cfg.idleConnectionTimeout);
+                    }
+                    return client;
+                };
                 dbClientsMap_[cfg.name] =
-                    drogon::orm::DbClient::newPgClient(dbInfo.connectionInfo_,
-                                                       cfg.connectionNumber,
-                                                       cfg.autoBatch);
+                    addReplicas(newClient(dbInfo.connectionInfo_),
+                                dbInfo.replicaConnectionInfos_,
+                                cfg.maxReplicaLag,
+                                newClient);
                 if (cfg.timeout > 0.0)
                 {
                     dbClientsMap_[cfg.name]->setTimeout(cfg.timeout);
@@ -110,6 +178,7 @@ void DbClientManager::createDbClients(
 
             if (cfg.isFast)
             {
+                warnFastReplicas(cfg.name, dbInfo.replicaConnectionInfos_);
                 dbFastClientsMap_[cfg.name] =
                     IOThreadStorage<orm::DbClientPtr>();
                 initFastDbClients(dbFastClientsMap_[cfg.name],
@@ -117,13 +186,31 @@ void DbClientManager::createDbClients(
                                   dbInfo.connectionInfo_,
                                   ClientType::Mysql,
                                   cfg.connectionNumber,
-                                  false,
+                                  cfg.autoBatch,
+                                  {},
+                                  cfg.warmupStatements,
                                   cfg.timeout);
             }
             else
             {
-                dbClientsMap_[cfg.name] = drogon::orm::DbClient::newMysqlClient(
-                    dbInfo.connectionInfo_, cfg.connectionNumber);
+                auto newClient = [&cfg](const std::string &connInfo) {
+                    auto client = drogon::orm::DbClient::newMysqlClient(
+                        connInfo,
+                        cfg.connectionNumber,
+                        cfg.autoBatch,
+                        cfg.warmupStatements);
+                    if (cfg.maxConnectionNumber > cfg.connectionNumber)
+                    {
+                        client->enableAdaptivePool(cfg.maxConnectionNumber,
+                                                   cfg.idleConnectionTimeout);
+                    }
+                    return client;
+                };
+                dbClientsMap_[cfg.name] =
+                    addReplicas(newClient(dbInfo.connectionInfo_),
+                                dbInfo.replicaConnectionInfos_,
+                                cfg.maxReplicaLag,
+                                newClient);
                 if (cfg.timeout > 0.0)
                 {
                     dbClientsMap_[cfg.name]->setTimeout(cfg.timeout);
@@ -176,28 +263,38 @@ void DbClientManager::addDbClient(const DbConfig &config)
     {
 #if USE_POSTGRESQL
         auto &cfg = std::get<PostgresConfig>(config);
-        auto connStr = buildConnStr(cfg.host,
-                                    cfg.port,
-                                    cfg.databaseName,
-                                    cfg.username,
-                                    cfg.password,
-                                    cfg.characterSet);
-        // For valid connection options, see:
-        // https://www.postgresql.org/docs/16/libpq-connect.html#LIBPQ-CONNECT-OPTIONS
-        if (!cfg.connectOptions.empty())
-        {
-            std::string optionStr = " options='";
-            for (auto const &[key, value] : cfg.connectOptions)
+        auto makeConnStr = [&cfg](const std::string &host,
+                                  unsigned short port) {
+            auto connStr = buildConnStr(host,
+                                        port,
+                                        cfg.databaseName,
+                                        cfg.username,
+                                        cfg.password,
+                                        cfg.characterSet);
+            // For valid connection options, see:
+            // https://www.postgresql.org/docs/16/libpq-connect.html#LIBPQ-CONNECT-OPTIONS
+            if (!cfg.connectOptions.empty())
             {
-                optionStr += " -c ";
-                optionStr += escapeConnString(key);
-                optionStr += "=";
-                optionStr += escapeConnString(value);
+                std::string optionStr = " options='";
+                for (auto const &[key, value] : cfg.connectOptions)
+                {
+                    optionStr += " -c ";
+                    optionStr += escapeConnString(key);
+                    optionStr += "=";
+                    optionStr += escapeConnString(value);
+                }
+                optionStr += "'";
+                connStr += optionStr;
             }
-            optionStr += "'";
-            connStr += optionStr;
+            return connStr;
+        };
+        DbInfo info{makeConnStr(cfg.host, cfg.port), config};
+        for (auto const &replica : cfg.replicas)
+        {
+            info.replicaConnectionInfos_.push_back(makeConnStr(
+                replica.host, replica.port ? replica.port : cfg.port));
         }
-        dbInfos_.emplace_back(DbInfo{connStr, config});
+        dbInfos_.emplace_back(std::move(info));
 #else
         std::cout << "The PostgreSQL is not supported in current drogon build, "
                      "please install the development library first."
@@ -209,13 +306,31 @@ void DbClientManager::addDbClient(const DbConfig &config)
     {
 #if USE_MYSQL
         auto cfg = std::get<MysqlConfig>(config);
-        auto connStr = buildConnStr(cfg.host,
-                                    cfg.port,
-                                    cfg.databaseName,
-                                    cfg.username,
-                                    cfg.password,
-                                    cfg.characterSet);
-        dbInfos_.emplace_back(DbInfo{connStr, config});
+        auto makeConnStr = [&cfg](const std::string &host,
+                                  unsigned short port) {
+            auto connStr = buildConnStr(host,
+                                        port,
+                                        cfg.databaseName,
+                                        cfg.username,
+                                        cfg.password,
+                                        cfg.characterSet);
+            if (cfg.preparedStatements)
+            {
+                connStr += utils::formattedString(
+                    " prepared_statements=1 max_prepared_statements=%zu "
+                    "prepare_threshold=%u",
+                    cfg.maxPreparedStatements,
+                    cfg.prepareThreshold);
+            }
+            return connStr;
+        };
+        DbInfo info{makeConnStr(cfg.host, cfg.port), config};
+        for (auto const &replica : cfg.replicas)
+        {
+            info.replicaConnectionInfos_.push_back(makeConnStr(
+                replica.host, replica.port ? replica.port : cfg.port));
+        }
+        dbInfos_.emplace_back(std::move(info));
 #else
         std::cout << "The Mysql is not supported in current drogon build, "
                      "please install the development library first."
@@ -228,6 +343,39 @@ void DbClientManager::addDbClient(const DbConfig &config)
 #if USE_SQLITE3
         auto cfg = std::get<Sqlite3Config>(config);
         std::string connStr = "filename=" + cfg.filename;
+        if (!cfg.journalMode.empty())
+        {
+            connStr += " journal_mode=" + cfg.journalMode;
+        }
+        if (cfg.busyTimeout > 0)
+        {
+            connStr += " busy_timeout=" + std::to_string(cfg.busyTimeout);
+        }
+        if (cfg.mmapSize > 0)
+        {
+            connStr += " mmap_size=" + std::to_string(cfg.mmapSize);
+        }
+        if (cfg.cacheSize != 0)
+        {
+            connStr += " cache_size=" + std::to_string(cfg.cacheSize);
+        }
+        if (!cfg.synchronous.empty())
+        {
+            connStr += " synchronous=" + cfg.synchronous;
+        }
+        if (!cfg.tempStore.empty())
+        {
+            connStr += " temp_store=" + cfg.tempStore;
+        }
+        if (cfg.immutable)
+        {
+            connStr += " immutable=1";
+        }
+        if (cfg.maxPreparedStatements > 0)
+        {
+            connStr += " max_prepared_statements=" +
+                       std::to_string(cfg.maxPreparedStatements);
+        }
         dbInfos_.emplace_back(DbInfo{connStr, config});
 #else
         std::cout << "The Sqlite3 is not supported in current drogon build, "
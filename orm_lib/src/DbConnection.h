@@ -16,15 +16,20 @@
 
 #include <drogon/config.h>
 #include <drogon/orm/DbClient.h>
+#include "../../lib/src/Probes.h"
 #include <string_view>
 #include <trantor/net/EventLoop.h>
 #include <trantor/utils/NonCopyable.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <string>
+#include <vector>
 
 namespace drogon
 {
@@ -41,10 +46,31 @@ enum class ConnectStatus
     None = 0,
     Connecting,
     SettingCharacterSet,
+    PreparingStatements,
     Ok,
     Bad
 };
 
+// The counters of the prepared statements of the connections of a client.
+struct PreparedStatementStats
+{
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+    std::atomic<size_t> evictions{0};
+};
+
+// The options of the PostgreSQL connections of a client.
+struct PgConnectionOptions
+{
+    // Receive the results in the binary format, see the comment of Field.
+    bool binaryResults{false};
+    // The maximum number of statements a connection keeps, 0 for no limit.
+    size_t maxPreparedStatements{0};
+    // The number of executions of a query after which it is prepared.
+    unsigned int prepareThreshold{1};
+    std::shared_ptr<PreparedStatementStats> stats;
+};
+
 struct SqlCmd
 {
     std::string_view sql_;
@@ -58,6 +84,8 @@ struct SqlCmd
 #if LIBPQ_SUPPORTS_BATCH_MODE
     bool isChanging_{false};
 #endif
+    // The time the command was queued by the client, for the metrics.
+    std::chrono::steady_clock::time_point queuedAt_;
     SqlCmd(std::string_view &&sql,
            size_t paraNum,
            std::vector<const char *> &&parameters,
@@ -76,6 +104,32 @@ struct SqlCmd
     }
 };
 
+struct CopyCmd
+{
+    std::string sql_;
+    // Called in the loop of the connection when the server waits for the
+    // data of a COPY FROM STDIN command. It's empty for COPY TO STDOUT.
+    std::function<void(const std::shared_ptr<CopyCmd> &)> readyCallback_;
+    CopyDataCallback dataCallback_;
+    QueryCallback callback_;
+    ExceptPtrCallback exceptionCallback_;
+
+    // Set by the connection before the ready callback is called, the send
+    // callback passes the buffered data to the connection in its loop.
+    trantor::EventLoop *loop_{nullptr};
+    std::function<void()> sendCallback_;
+
+    // The data written by the writer, guarded by the mutex.
+    std::mutex mutex_;
+    std::deque<std::string> buffer_;
+    size_t pendingBytes_{0};
+    bool sendQueued_{false};
+    bool finished_{false};
+    bool aborted_{false};
+    std::string errorMessage_;
+    std::function<void()> drainCallback_;
+};
+
 class DbConnection;
 using DbConnectionPtr = std::shared_ptr<DbConnection>;
 
@@ -105,6 +159,15 @@ class DbConnection : public trantor::NonCopyable
         idleCb_ = cb;
     }
 
+    // The statements prepared once the connection is established, before
+    // the ok callback is called, shared by the connections of a client. It
+    // must be set before init().
+    void setWarmupStatements(
+        std::shared_ptr<const std::vector<std::string>> statements)
+    {
+        warmupStatements_ = std::move(statements);
+    }
+
     virtual void execSql(
         std::string_view &&sql,
         size_t paraNum,
@@ -115,6 +178,18 @@ class DbConnection : public trantor::NonCopyable
         std::function<void(const std::exception_ptr &)> &&exceptCallback) = 0;
     virtual void batchSql(
         std::deque<std::shared_ptr<SqlCmd>> &&sqlCommands) = 0;
+    // Whether the commands can be sent before the results of the previous
+    // ones are received, which keeps their order.
+    virtual bool supportsPipelining() const
+    {
+        return false;
+    }
+
+    virtual void execCopy(const std::shared_ptr<CopyCmd> &cmd)
+    {
+        cmd->exceptionCallback_(std::make_exception_ptr(
+            Failure("COPY is not supported by this connection")));
+    }
 
     virtual ~DbConnection()
     {
@@ -139,6 +214,30 @@ class DbConnection : public trantor::NonCopyable
     }
 
   protected:
+    // Fire the db__query__start probe, and wrap the callbacks to fire the
+    // db__query__end one only while a tracer is attached to it.
+    void probeQuery(
+        [[maybe_unused]] std::string_view sql,
+        [[maybe_unused]] ResultCallback &rcb,
+        [[maybe_unused]] std::function<void(const std::exception_ptr &)>
+            &except)
+    {
+#if DROGON_USDT
+        DROGON_PROBE3(db__query__start, this, sql.data(), sql.length());
+        if (!DROGON_PROBE_ENABLED(db__query__end))
+            return;
+        rcb = [conn = this, rcb = std::move(rcb)](const Result &r) {
+            DROGON_PROBE2(db__query__end, conn, 1);
+            rcb(r);
+        };
+        except = [conn = this, except = std::move(except)](
+                     const std::exception_ptr &exception) {
+            DROGON_PROBE2(db__query__end, conn, 0);
+            except(exception);
+        };
+#endif
+    }
+
     QueryCallback callback_;
     trantor::EventLoop *loop_;
     std::function<void()> idleCb_;
@@ -147,6 +246,7 @@ class DbConnection : public trantor::NonCopyable
     DbConnectionCallback okCallback_{[](const DbConnectionPtr &) {}};
     std::function<void(const std::exception_ptr &)> exceptionCallback_;
     bool isWorking_{false};
+    std::shared_ptr<const std::vector<std::string>> warmupStatements_;
 
     static std::map<std::string, std::string> parseConnString(
         const std::string &);
@@ -16,6 +16,7 @@
 #include <drogon/orm/DbListener.h>
 #include <trantor/utils/Logger.h>
 #include <mutex>
+#include <unordered_map>
 
 #if USE_POSTGRESQL
 #include "postgresql_impl/PgListener.h"
@@ -40,3 +41,25 @@ std::shared_ptr<DbListener> DbListener::newPgListener(
     return nullptr;
 #endif
 }
+
+std::shared_ptr<DbListener> DbListener::sharedPgListener(
+    const std::string &connInfo)
+{
+#if USE_POSTGRESQL
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::weak_ptr<DbListener>>
+        listeners;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &weakListener = listeners[connInfo];
+    auto listener = weakListener.lock();
+    if (!listener)
+    {
+        listener = newPgListener(connInfo);
+        weakListener = listener;
+    }
+    return listener;
+#else
+    LOG_ERROR << "Postgresql is not supported by current drogon build";
+    return nullptr;
+#endif
+}
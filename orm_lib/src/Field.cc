@@ -15,10 +15,192 @@
 #include <drogon/orm/Field.h>
 #include <drogon/utils/Utilities.h>
 #include <trantor/utils/Logger.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <stdlib.h>
 
 using namespace drogon::orm;
 
+// The oids of the PostgreSQL types decoded from the binary format.
+static constexpr int kBoolOid = 16;
+static constexpr int kByteaOid = 17;
+static constexpr int kInt8Oid = 20;
+static constexpr int kInt2Oid = 21;
+static constexpr int kInt4Oid = 23;
+static constexpr int kOidOid = 26;
+static constexpr int kFloat4Oid = 700;
+static constexpr int kFloat8Oid = 701;
+static constexpr int kDateOid = 1082;
+static constexpr int kTimeOid = 1083;
+static constexpr int kTimestampOid = 1114;
+static constexpr int kNumericOid = 1700;
+static constexpr int kUuidOid = 2950;
+static constexpr int kJsonbOid = 3802;
+
+// The dates and times of PostgreSQL count from 2000-01-01, which is 10957
+// days after the unix epoch.
+static constexpr int64_t kPgEpochDays = 10957;
+static constexpr int64_t kMicrosecondsPerDay = 86400LL * 1000000;
+
+static uint64_t readBigEndian(const char *data, size_t length)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        value = (value << 8) | (unsigned char)data[i];
+    }
+    return value;
+}
+
+static std::string floatToText(double value, int minPrecision, int maxPrecision)
+{
+    if (std::isnan(value))
+        return "NaN";
+    if (std::isinf(value))
+        return value > 0 ? "Infinity" : "-Infinity";
+    // The shortest text read back as the same value, like the server does.
+    char buf[32];
+    for (int precision = minPrecision;; ++precision)
+    {
+        snprintf(buf, sizeof(buf), "%.*g", precision, value);
+        if (precision >= maxPrecision ||
+            (maxPrecision > 9 ? strtod(buf, nullptr) == value
+                              : strtof(buf, nullptr) == (float)value))
+            return buf;
+    }
+}
+
+static void appendDate(std::string &text, int64_t days)
+{
+    // The civil date from the days since the unix epoch, see
+    // http://howardhinnant.github.io/date_algorithms.html
+    days += 719468;
+    auto era = (days >= 0 ? days : days - 146096) / 146097;
+    auto dayOfEra = days - era * 146097;
+    auto yearOfEra =
+        (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) /
+        365;
+    auto dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 -
+                                 yearOfEra / 100);
+    auto mp = (5 * dayOfYear + 2) / 153;
+    auto day = dayOfYear - (153 * mp + 2) / 5 + 1;
+    auto month = mp < 10 ? mp + 3 : mp - 9;
+    auto year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+    char buf[32];
+    snprintf(buf,
+             sizeof(buf),
+             "%04lld-%02d-%02d",
+             (long long)(year > 0 ? year : 1 - year),
+             (int)month,
+             (int)day);
+    text.append(buf);
+    if (year <= 0)
+        text.append(" BC");
+}
+
+static void appendTime(std::string &text, int64_t microseconds)
+{
+    char buf[32];
+    auto seconds = microseconds / 1000000;
+    snprintf(buf,
+             sizeof(buf),
+             "%02d:%02d:%02d",
+             (int)(seconds / 3600),
+             (int)(seconds / 60 % 60),
+             (int)(seconds % 60));
+    text.append(buf);
+    auto fraction = microseconds % 1000000;
+    if (fraction != 0)
+    {
+        snprintf(buf, sizeof(buf), ".%06d", (int)fraction);
+        auto length = strlen(buf);
+        while (buf[length - 1] == '0')
+            --length;
+        text.append(buf, length);
+    }
+}
+
+static std::string timestampToText(int64_t microseconds)
+{
+    if (microseconds == INT64_MAX)
+        return "infinity";
+    if (microseconds == INT64_MIN)
+        return "-infinity";
+    auto days = microseconds / kMicrosecondsPerDay;
+    auto timeOfDay = microseconds % kMicrosecondsPerDay;
+    if (timeOfDay < 0)
+    {
+        --days;
+        timeOfDay += kMicrosecondsPerDay;
+    }
+    std::string text;
+    appendDate(text, days + kPgEpochDays);
+    // Keep the era suffix at the end, as the server does.
+    std::string era;
+    if (text.size() > 3 && text.compare(text.size() - 3, 3, " BC") == 0)
+    {
+        era = " BC";
+        text.resize(text.size() - 3);
+    }
+    text.push_back(' ');
+    appendTime(text, timeOfDay);
+    text.append(era);
+    return text;
+}
+
+static std::string numericToText(const char *data, size_t length)
+{
+    if (length < 8)
+        return std::string();
+    auto ndigits = (int16_t)readBigEndian(data, 2);
+    auto weight = (int16_t)readBigEndian(data + 2, 2);
+    auto sign = (uint16_t)readBigEndian(data + 4, 2);
+    auto dscale = (int16_t)readBigEndian(data + 6, 2);
+    if (sign == 0xC000)
+        return "NaN";
+    if (sign == 0xD000)
+        return "Infinity";
+    if (sign == 0xF000)
+        return "-Infinity";
+    if (ndigits < 0 || length < 8 + 2 * (size_t)ndigits)
+        return std::string();
+    // The digits are in base 10000, the first one has the given weight.
+    auto digit = [data, ndigits](int i) -> int {
+        return i >= 0 && i < ndigits ? (int16_t)readBigEndian(data + 8 + 2 * i,
+                                                              2)
+                                     : 0;
+    };
+    std::string text;
+    if (sign == 0x4000)
+        text.push_back('-');
+    char buf[8];
+    if (weight < 0)
+    {
+        text.push_back('0');
+    }
+    else
+    {
+        for (int i = 0; i <= weight; ++i)
+        {
+            snprintf(buf, sizeof(buf), i == 0 ? "%d" : "%04d", digit(i));
+            text.append(buf);
+        }
+    }
+    if (dscale > 0)
+    {
+        text.push_back('.');
+        auto pos = text.size();
+        for (int i = weight + 1; (int)(text.size() - pos) < dscale; ++i)
+        {
+            snprintf(buf, sizeof(buf), "%04d", digit(i));
+            text.append(buf);
+        }
+        text.resize(pos + dscale);
+    }
+    return text;
+}
+
 Field::Field(const Row &row, Row::SizeType columnNum) noexcept
     : row_(Result::SizeType(row.index_)),
       column_((long)columnNum),
@@ -39,7 +221,14 @@ bool Field::isNull() const
 template <>
 std::string Field::as<std::string>() const
 {
-    if (result_.oid(column_) != 17)
+    if (result_.isBinary(column_))
+    {
+        if (result_.oid(column_) == kByteaOid)
+            return std::string(result_.getValue(row_, column_),
+                               result_.getLength(row_, column_));
+        return binaryToText();
+    }
+    if (result_.oid(column_) != kByteaOid)
     {
         auto data_ = result_.getValue(row_, column_);
         auto dataLength_ = result_.getLength(row_, column_);
@@ -73,7 +262,18 @@ char *Field::as<char *>() const
 template <>
 std::vector<char> Field::as<std::vector<char>>() const
 {
-    if (result_.oid(column_) != 17)
+    if (result_.isBinary(column_))
+    {
+        if (result_.oid(column_) == kByteaOid)
+        {
+            char *first = (char *)result_.getValue(row_, column_);
+            char *last = first + result_.getLength(row_, column_);
+            return std::vector<char>(first, last);
+        }
+        auto text = binaryToText();
+        return std::vector<char>(text.begin(), text.end());
+    }
+    if (result_.oid(column_) != kByteaOid)
     {
         char *first = (char *)result_.getValue(row_, column_);
         char *last = first + result_.getLength(row_, column_);
@@ -94,6 +294,142 @@ const char *Field::c_str() const
     return as<const char *>();
 }
 
+int64_t Field::binaryInteger() const
+{
+    auto data = result_.getValue(row_, column_);
+    auto length = result_.getLength(row_, column_);
+    switch (result_.oid(column_))
+    {
+        case kBoolOid:
+        case kInt2Oid:
+        case kInt4Oid:
+        case kInt8Oid:
+        {
+            auto value = readBigEndian(data, length);
+            switch (length)
+            {
+                case 1:
+                    return (int8_t)value;
+                case 2:
+                    return (int16_t)value;
+                case 4:
+                    return (int32_t)value;
+                default:
+                    return (int64_t)value;
+            }
+        }
+        case kOidOid:
+            return (uint32_t)readBigEndian(data, length);
+        case kFloat4Oid:
+        case kFloat8Oid:
+            return (int64_t)binaryFloat();
+        default:
+            return std::stoll(binaryToText());
+    }
+}
+
+double Field::binaryFloat() const
+{
+    auto data = result_.getValue(row_, column_);
+    auto length = result_.getLength(row_, column_);
+    switch (result_.oid(column_))
+    {
+        case kFloat4Oid:
+        {
+            auto bits = (uint32_t)readBigEndian(data, length);
+            float value;
+            static_assert(sizeof(value) == sizeof(bits));
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        case kFloat8Oid:
+        {
+            auto bits = readBigEndian(data, length);
+            double value;
+            static_assert(sizeof(value) == sizeof(bits));
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        case kBoolOid:
+        case kInt2Oid:
+        case kInt4Oid:
+        case kInt8Oid:
+        case kOidOid:
+            return (double)binaryInteger();
+        default:
+            return std::stod(binaryToText());
+    }
+}
+
+std::string Field::binaryToText() const
+{
+    auto data = result_.getValue(row_, column_);
+    auto length = result_.getLength(row_, column_);
+    switch (result_.oid(column_))
+    {
+        case kBoolOid:
+            return binaryInteger() != 0 ? "t" : "f";
+        case kInt2Oid:
+        case kInt4Oid:
+        case kInt8Oid:
+        case kOidOid:
+            return std::to_string(binaryInteger());
+        case kFloat4Oid:
+            return floatToText(binaryFloat(), 6, 9);
+        case kFloat8Oid:
+            return floatToText(binaryFloat(), 15, 17);
+        case kNumericOid:
+            return numericToText(data, length);
+        case kByteaOid:
+            return "\\x" +
+                   utils::binaryStringToHex((const unsigned char *)data,
+                                            length,
+                                            true);
+        case kUuidOid:
+        {
+            if (length != 16)
+                break;
+            auto hex = utils::binaryStringToHex((const unsigned char *)data,
+                                                length,
+                                                true);
+            for (size_t pos : {8, 13, 18, 23})
+            {
+                hex.insert(pos, 1, '-');
+            }
+            return hex;
+        }
+        case kDateOid:
+        {
+            auto days = (int32_t)readBigEndian(data, length);
+            if (days == INT32_MAX)
+                return "infinity";
+            if (days == INT32_MIN)
+                return "-infinity";
+            std::string text;
+            appendDate(text, days + kPgEpochDays);
+            return text;
+        }
+        case kTimeOid:
+        {
+            std::string text;
+            appendTime(text, (int64_t)readBigEndian(data, length));
+            return text;
+        }
+        case kTimestampOid:
+            return timestampToText((int64_t)readBigEndian(data, length));
+        case kJsonbOid:
+            // The text is preceded by the version of the format.
+            if (length > 0)
+                return std::string(data + 1, length - 1);
+            break;
+        default:
+            break;
+    }
+    // The binary format of the text types is the text itself, the columns of
+    // the other types are received in text, see PgConnection::resultFormat().
+    return std::string(data, length);
+}
+
 // template <>
 // std::vector<short> Field::as<std::vector<short>>() const
 // {
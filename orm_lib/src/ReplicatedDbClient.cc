@@ -0,0 +1,368 @@
+/**
+ *
+ *  ReplicatedDbClient.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "ReplicatedDbClient.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <limits>
+
+using namespace drogon::orm;
+
+namespace
+{
+constexpr double kLagCheckInterval = 1.0;
+// The weight of a new response time in the average.
+constexpr double kLatencyWeight = 0.2;
+// The replicas without any measured response time yet are compared by their
+// number of queries.
+constexpr double kMinLatency = 0.0001;
+
+// https://www.postgresql.org/docs/current/functions-admin.html
+constexpr char kPgLagSql[] =
+    "select coalesce(case when pg_last_wal_receive_lsn() <> "
+    "pg_last_wal_replay_lsn() then extract(epoch from now() - "
+    "pg_last_xact_replay_timestamp()) end, 0)::float8";
+constexpr char kMysqlLagSql[] = "show replica status";
+
+int64_t steadyNow()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+double mysqlLag(const Result &r)
+{
+    // Not a replica.
+    if (r.empty())
+        return 0.0;
+    for (Result::RowSizeType i = 0; i < r.columns(); ++i)
+    {
+        std::string_view name = r.columnName(i);
+        if (name == "Seconds_Behind_Source" || name == "Seconds_Behind_Master")
+        {
+            // The replication is stopped.
+            if (r[0][i].isNull())
+                return std::numeric_limits<double>::infinity();
+            return r[0][i].as<double>();
+        }
+    }
+    return 0.0;
+}
+}  // namespace
+
+std::shared_ptr<DbClient> DbClient::newReplicatedClient(
+    std::shared_ptr<DbClient> primary,
+    std::vector<std::shared_ptr<DbClient>> replicas,
+    double maxReplicaLag)
+{
+    assert(primary);
+    return std::make_shared<ReplicatedDbClient>(std::move(primary),
+                                                std::move(replicas),
+                                                maxReplicaLag);
+}
+
+ReplicatedDbClient::ReplicatedDbClient(DbClientPtr primary,
+                                       std::vector<DbClientPtr> replicas,
+                                       double maxReplicaLag)
+    : primary_(std::move(primary)),
+      maxReplicaLag_(maxReplicaLag),
+      readOnlyClient_(*this)
+{
+    type_ = primary_->type();
+    connectionInfo_ = primary_->connectionInfo();
+    for (auto &client : replicas)
+    {
+        auto replica = std::make_shared<Replica>();
+        replica->client = std::move(client);
+        replicas_.emplace_back(std::move(replica));
+    }
+}
+
+bool ReplicatedDbClient::isReadOnlySql(std::string_view sql)
+{
+    auto pos = sql.find_first_not_of(" \t\r\n(");
+    if (pos == std::string_view::npos || sql.length() - pos < 6)
+        return false;
+    std::string lowerSql{sql.substr(pos)};
+    std::transform(lowerSql.begin(),
+                   lowerSql.end(),
+                   lowerSql.begin(),
+                   [](unsigned char c) { return tolower(c); });
+    if (lowerSql.compare(0, 6, "select") != 0)
+        return false;
+    return (lowerSql.find("for update") == std::string::npos &&
+            lowerSql.find("for no key update") == std::string::npos &&
+            lowerSql.find("for share") == std::string::npos &&
+            lowerSql.find("for key share") == std::string::npos &&
+            lowerSql.find("into") == std::string::npos &&
+            lowerSql.find("nextval") == std::string::npos &&
+            lowerSql.find("setval") == std::string::npos &&
+            lowerSql.find("advisory") == std::string::npos);
+}
+
+void ReplicatedDbClient::execSql(
+    const char *sql,
+    size_t sqlLength,
+    size_t paraNum,
+    std::vector<const char *> &&parameters,
+    std::vector<int> &&length,
+    std::vector<int> &&format,
+    ResultCallback &&rcb,
+    std::function<void(const std::exception_ptr &)> &&exceptCallback)
+{
+    if (!replicas_.empty() && isReadOnlySql(std::string_view{sql, sqlLength}))
+    {
+        execSqlOnReplica(sql,
+                         sqlLength,
+                         paraNum,
+                         std::move(parameters),
+                         std::move(length),
+                         std::move(format),
+                         std::move(rcb),
+                         std::move(exceptCallback));
+        return;
+    }
+    primary_->execSql(sql,
+                      sqlLength,
+                      paraNum,
+                      std::move(parameters),
+                      std::move(length),
+                      std::move(format),
+                      std::move(rcb),
+                      std::move(exceptCallback));
+}
+
+void ReplicatedDbClient::execSqlOnReplica(
+    const char *sql,
+    size_t sqlLength,
+    size_t paraNum,
+    std::vector<const char *> &&parameters,
+    std::vector<int> &&length,
+    std::vector<int> &&format,
+    ResultCallback &&rcb,
+    std::function<void(const std::exception_ptr &)> &&exceptCallback)
+{
+    auto replica = selectReplica();
+    if (!replica)
+    {
+        primary_->execSql(sql,
+                          sqlLength,
+                          paraNum,
+                          std::move(parameters),
+                          std::move(length),
+                          std::move(format),
+                          std::move(rcb),
+                          std::move(exceptCallback));
+        return;
+    }
+    ++replica->queriesInProgress;
+    auto done = [replica, start = steadyNow()]() {
+        --replica->queriesInProgress;
+        // Concurrent updates may be lost, which doesn't matter for an
+        // average.
+        double elapsed = (steadyNow() - start) / 1000000.0;
+        auto latency = replica->latency.load();
+        replica->latency =
+            latency == 0.0 ? elapsed
+                           : latency + kLatencyWeight * (elapsed - latency);
+    };
+    replica->client->execSql(
+        sql,
+        sqlLength,
+        paraNum,
+        std::move(parameters),
+        std::move(length),
+        std::move(format),
+        [done, rcb = std::move(rcb)](const Result &r) {
+            done();
+            rcb(r);
+        },
+        [done, exceptCallback = std::move(exceptCallback)](
+            const std::exception_ptr &e) {
+            done();
+            exceptCallback(e);
+        });
+}
+
+ReplicatedDbClient::ReplicaPtr ReplicatedDbClient::selectReplica()
+{
+    ReplicaPtr selected;
+    double minLoad = 0.0;
+    auto start = nextReplica_++;
+    for (size_t i = 0; i < replicas_.size(); ++i)
+    {
+        auto &replica = replicas_[(start + i) % replicas_.size()];
+        if (maxReplicaLag_ > 0.0)
+        {
+            checkLag(replica);
+            if (replica->lag > maxReplicaLag_)
+                continue;
+        }
+        if (!replica->client->hasAvailableConnections())
+            continue;
+        // The expected time of a new query behind the ones in progress.
+        auto load = std::max(replica->latency.load(), kMinLatency) *
+                    (replica->queriesInProgress + 1);
+        if (!selected || load < minLoad)
+        {
+            selected = replica;
+            minLoad = load;
+        }
+    }
+    return selected;
+}
+
+void ReplicatedDbClient::checkLag(const ReplicaPtr &replica)
+{
+    auto now = steadyNow();
+    if (now - replica->lastLagCheck < kLagCheckInterval * 1000000 ||
+        replica->checkingLag.exchange(true))
+        return;
+    replica->lastLagCheck = now;
+    auto &client = replica->client;
+    auto failed = [replica](const DrogonDbException &e) {
+        LOG_WARN << "Failed to check the lag of the replica "
+                 << replica->client->connectionInfo() << ": "
+                 << e.base().what();
+        replica->lag = std::numeric_limits<double>::infinity();
+        replica->checkingLag = false;
+    };
+    if (client->type() == ClientType::PostgreSQL)
+    {
+        client->execSqlAsync(
+            kPgLagSql,
+            [replica](const Result &r) {
+                replica->lag = r[0][0].as<double>();
+                replica->checkingLag = false;
+            },
+            std::move(failed));
+    }
+    else if (client->type() == ClientType::Mysql)
+    {
+        client->execSqlAsync(
+            kMysqlLagSql,
+            [replica](const Result &r) {
+                replica->lag = mysqlLag(r);
+                replica->checkingLag = false;
+            },
+            std::move(failed));
+    }
+    else
+    {
+        replica->checkingLag = false;
+    }
+}
+
+DbClient::ConnectionStats ReplicatedDbClient::connectionStats() const noexcept
+{
+    auto stats = primary_->connectionStats();
+    for (auto &replica : replicas_)
+    {
+        auto replicaStats = replica->client->connectionStats();
+        stats.busy += replicaStats.busy;
+        stats.idle += replicaStats.idle;
+        stats.pending += replicaStats.pending;
+        stats.preparedStatementHits += replicaStats.preparedStatementHits;
+        stats.preparedStatementMisses += replicaStats.preparedStatementMisses;
+        stats.preparedStatementEvictions +=
+            replicaStats.preparedStatementEvictions;
+        stats.queueWaitTime += replicaStats.queueWaitTime;
+        stats.queuedCommands += replicaStats.queuedCommands;
+    }
+    return stats;
+}
+
+void ReplicatedDbClient::setTimeout(double timeout)
+{
+    primary_->setTimeout(timeout);
+    for (auto &replica : replicas_)
+        replica->client->setTimeout(timeout);
+}
+
+void ReplicatedDbClient::setCircuitBreaker(CircuitBreakerPtr breaker)
+{
+    // Every server has a breaker of its own with the same options, so that
+    // the replicas stay in use while the primary is down.
+    for (auto &replica : replicas_)
+    {
+        replica->client->setCircuitBreaker(
+            breaker ? std::make_shared<CircuitBreaker>(breaker->options())
+                    : nullptr);
+    }
+    primary_->setCircuitBreaker(std::move(breaker));
+}
+
+void ReplicatedDbClient::enableAdaptivePool(size_t maxConnections,
+                                            double idleTimeout)
+{
+    primary_->enableAdaptivePool(maxConnections, idleTimeout);
+    for (auto &replica : replicas_)
+        replica->client->enableAdaptivePool(maxConnections, idleTimeout);
+}
+
+void ReplicatedDbClient::closeAll()
+{
+    primary_->closeAll();
+    for (auto &replica : replicas_)
+        replica->client->closeAll();
+}
+
+ReplicatedDbClient::ReadOnlyClient::ReadOnlyClient(ReplicatedDbClient &parent)
+    : parent_(parent)
+{
+    type_ = parent_.primary_->type();
+    connectionInfo_ = parent_.primary_->connectionInfo();
+}
+
+// The read-only transactions are executed by a replica too, for consistent
+// reads across several queries.
+std::shared_ptr<Transaction> ReplicatedDbClient::ReadOnlyClient::newTransaction(
+    const std::function<void(bool)> &commitCallback,
+    TransactionType transType) noexcept(false)
+{
+    auto replica = parent_.selectReplica();
+    auto &client = replica ? replica->client : parent_.primary_;
+    return client->newTransaction(commitCallback, transType);
+}
+
+void ReplicatedDbClient::ReadOnlyClient::newTransactionAsync(
+    const std::function<void(const std::shared_ptr<Transaction> &)> &callback,
+    TransactionType transType)
+{
+    auto replica = parent_.selectReplica();
+    auto &client = replica ? replica->client : parent_.primary_;
+    client->newTransactionAsync(callback, transType);
+}
+
+void ReplicatedDbClient::ReadOnlyClient::execSql(
+    const char *sql,
+    size_t sqlLength,
+    size_t paraNum,
+    std::vector<const char *> &&parameters,
+    std::vector<int> &&length,
+    std::vector<int> &&format,
+    ResultCallback &&rcb,
+    std::function<void(const std::exception_ptr &)> &&exceptCallback)
+{
+    parent_.execSqlOnReplica(sql,
+                             sqlLength,
+                             paraNum,
+                             std::move(parameters),
+                             std::move(length),
+                             std::move(format),
+                             std::move(rcb),
+                             std::move(exceptCallback));
+}
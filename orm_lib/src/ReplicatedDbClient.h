@@ -0,0 +1,174 @@
+/**
+ *
+ *  @file ReplicatedDbClient.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/orm/DbClient.h>
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace drogon
+{
+namespace orm
+{
+class ReplicatedDbClient : public DbClient
+{
+  public:
+    ReplicatedDbClient(DbClientPtr primary,
+                       std::vector<DbClientPtr> replicas,
+                       double maxReplicaLag);
+
+    std::shared_ptr<Transaction> newTransaction(
+        const std::function<void(bool)> &commitCallback,
+        TransactionType transType) noexcept(false) override
+    {
+        return primary_->newTransaction(commitCallback, transType);
+    }
+
+    void newTransactionAsync(
+        const std::function<void(const std::shared_ptr<Transaction> &)>
+            &callback,
+        TransactionType transType) override
+    {
+        primary_->newTransactionAsync(callback, transType);
+    }
+
+    bool hasAvailableConnections() const noexcept override
+    {
+        return primary_->hasAvailableConnections();
+    }
+
+    ConnectionStats connectionStats() const noexcept override;
+    void setTimeout(double timeout) override;
+    void setCircuitBreaker(CircuitBreakerPtr breaker) override;
+    void enableAdaptivePool(size_t maxConnections,
+                            double idleTimeout) override;
+    void closeAll() override;
+
+    DbClient &readOnly() override
+    {
+        return readOnlyClient_;
+    }
+
+    DbClient &primary() override
+    {
+        return *primary_;
+    }
+
+    // Check if a query can be executed by a replica, which is only the case
+    // of the SELECT queries without any key word that may change the data.
+    static bool isReadOnlySql(std::string_view sql);
+
+  private:
+    void execSql(
+        const char *sql,
+        size_t sqlLength,
+        size_t paraNum,
+        std::vector<const char *> &&parameters,
+        std::vector<int> &&length,
+        std::vector<int> &&format,
+        ResultCallback &&rcb,
+        std::function<void(const std::exception_ptr &)> &&exceptCallback)
+        override;
+    void execSqlOnReplica(
+        const char *sql,
+        size_t sqlLength,
+        size_t paraNum,
+        std::vector<const char *> &&parameters,
+        std::vector<int> &&length,
+        std::vector<int> &&format,
+        ResultCallback &&rcb,
+        std::function<void(const std::exception_ptr &)> &&exceptCallback);
+
+    struct Replica
+    {
+        DbClientPtr client;
+        // The average response time in seconds.
+        std::atomic<double> latency{0.0};
+        std::atomic<size_t> queriesInProgress{0};
+        // The lag in seconds, updated every second when it's checked.
+        std::atomic<double> lag{0.0};
+        std::atomic<int64_t> lastLagCheck{0};
+        std::atomic<bool> checkingLag{false};
+    };
+    using ReplicaPtr = std::shared_ptr<Replica>;
+
+    ReplicaPtr selectReplica();
+    void checkLag(const ReplicaPtr &replica);
+
+    // The client returned by readOnly().
+    class ReadOnlyClient : public DbClient
+    {
+      public:
+        explicit ReadOnlyClient(ReplicatedDbClient &parent);
+
+        std::shared_ptr<Transaction> newTransaction(
+            const std::function<void(bool)> &commitCallback,
+            TransactionType transType) noexcept(false) override;
+        void newTransactionAsync(
+            const std::function<void(const std::shared_ptr<Transaction> &)>
+                &callback,
+            TransactionType transType) override;
+
+        bool hasAvailableConnections() const noexcept override
+        {
+            return parent_.hasAvailableConnections();
+        }
+
+        void setTimeout(double timeout) override
+        {
+            parent_.setTimeout(timeout);
+        }
+
+        void setCircuitBreaker(CircuitBreakerPtr breaker) override
+        {
+            parent_.setCircuitBreaker(std::move(breaker));
+        }
+
+        void closeAll() override
+        {
+        }
+
+        DbClient &primary() override
+        {
+            return parent_.primary();
+        }
+
+      private:
+        void execSql(
+            const char *sql,
+            size_t sqlLength,
+            size_t paraNum,
+            std::vector<const char *> &&parameters,
+            std::vector<int> &&length,
+            std::vector<int> &&format,
+            ResultCallback &&rcb,
+            std::function<void(const std::exception_ptr &)> &&exceptCallback)
+            override;
+
+        ReplicatedDbClient &parent_;
+    };
+
+    DbClientPtr primary_;
+    std::vector<ReplicaPtr> replicas_;
+    double maxReplicaLag_;
+    // Rotates the order in which the replicas are compared, which spreads
+    // the queries while the replicas have the same load.
+    std::atomic<size_t> nextReplica_{0};
+    ReadOnlyClient readOnlyClient_;
+};
+}  // namespace orm
+}  // namespace drogon
@@ -81,3 +81,38 @@ orm::Criteria RestfulController::makeCriteria(
     }
     return ret;
 }
+
+std::string RestfulController::encodeCursor(const Json::Value &values)
+{
+    static const Json::StreamWriterBuilder builder = []() {
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        return builder;
+    }();
+    return utils::base64EncodeUnpadded(Json::writeString(builder, values),
+                                       true);
+}
+
+bool RestfulController::decodeCursor(const std::string &cursor,
+                                     std::vector<std::string> &values)
+{
+    if (cursor.empty() || !utils::isBase64(cursor))
+        return false;
+    auto str = utils::base64Decode(cursor);
+    static const Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    Json::Value root;
+    std::string errs;
+    if (!reader->parse(str.data(), str.data() + str.size(), &root, &errs) ||
+        !root.isArray() || root.empty())
+        return false;
+    values.clear();
+    for (auto &value : root)
+    {
+        // The order columns can't be null, see Mapper::paginateAfter().
+        if (value.isNull() || value.isArray() || value.isObject())
+            return false;
+        values.emplace_back(value.asString());
+    }
+    return true;
+}
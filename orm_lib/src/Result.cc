@@ -14,13 +14,36 @@
 
 #include "ResultImpl.h"
 #include <cassert>
+#include <charconv>
+#include <cstdlib>
+#include <type_traits>
 #include <drogon/orm/Result.h>
 #include <drogon/orm/ResultIterator.h>
 #include <drogon/orm/Row.h>
+#include <drogon/orm/Field.h>
 #include <drogon/orm/Exception.h>
 
 using namespace drogon::orm;
 
+namespace
+{
+template <typename T>
+T parseText(std::string_view value)
+{
+    T result{};
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        // The values are terminated by a null character.
+        result = static_cast<T>(strtod(value.data(), nullptr));
+    }
+    else
+    {
+        std::from_chars(value.data(), value.data() + value.length(), result);
+    }
+    return result;
+}
+}  // namespace
+
 Result::ConstIterator Result::begin() const noexcept
 {
     return ConstIterator(*this, (SizeType)0);
@@ -143,11 +166,101 @@ Result::SizeType Result::affectedRows() const noexcept
     return resultPtr_->affectedRows();
 }
 
+std::vector<std::string_view> Result::columnValues(RowSizeType column) const
+{
+    std::vector<std::string_view> values;
+    if (size() == 0)
+        return values;
+    if (column >= columns())
+        throw RangeError("Column number is out of range");
+    resultPtr_->getColumn(column, values);
+    return values;
+}
+
+template <typename T>
+std::vector<T> Result::columnAs(RowSizeType column) const
+{
+    auto values = columnValues(column);
+    std::vector<T> result;
+    result.reserve(values.size());
+    if (!values.empty() && isBinary(column))
+    {
+        // The decoding of the binary format depends on the type of the
+        // column, which isn't worth another implementation.
+        for (SizeType row = 0; row < values.size(); ++row)
+        {
+            result.push_back(Row(*this, row)[column].as<T>());
+        }
+        return result;
+    }
+    for (auto value : values)
+    {
+        if (!value.data())
+            result.emplace_back();
+        else if constexpr (std::is_arithmetic_v<T>)
+            result.push_back(parseText<T>(value));
+        else
+            result.emplace_back(value);
+    }
+    return result;
+}
+
+namespace drogon
+{
+namespace orm
+{
+template std::vector<int> Result::columnAs<int>(RowSizeType) const;
+template std::vector<long> Result::columnAs<long>(RowSizeType) const;
+template std::vector<long long> Result::columnAs<long long>(RowSizeType) const;
+template std::vector<unsigned int> Result::columnAs<unsigned int>(
+    RowSizeType) const;
+template std::vector<unsigned long> Result::columnAs<unsigned long>(
+    RowSizeType) const;
+template std::vector<unsigned long long> Result::columnAs<unsigned long long>(
+    RowSizeType) const;
+template std::vector<float> Result::columnAs<float>(RowSizeType) const;
+template std::vector<double> Result::columnAs<double>(RowSizeType) const;
+template std::vector<std::string> Result::columnAs<std::string>(
+    RowSizeType) const;
+template std::vector<std::string_view> Result::columnAs<std::string_view>(
+    RowSizeType) const;
+}  // namespace orm
+}  // namespace drogon
+
 Result::RowSizeType Result::columnNumber(const char colName[]) const
 {
     return resultPtr_->columnNumber(colName);
 }
 
+const std::vector<long> &Result::columnNumbers(
+    const std::vector<std::string> &names) const
+{
+    std::lock_guard<std::mutex> lock(resultPtr_->columnNumbersMutex_);
+    auto iter = resultPtr_->columnNumbersCache_.find(&names);
+    if (iter != resultPtr_->columnNumbersCache_.end())
+        return iter->second;
+    std::vector<long> numbers;
+    numbers.reserve(names.size());
+    auto columnsNum = columns();
+    for (auto &name : names)
+    {
+        long number = -1;
+        try
+        {
+            auto n = resultPtr_->columnNumber(name.c_str());
+            if (n < columnsNum)
+                number = static_cast<long>(n);
+        }
+        catch (const RangeError &)
+        {
+        }
+        numbers.push_back(number);
+    }
+    return resultPtr_->columnNumbersCache_
+        .emplace(&names, std::move(numbers))
+        .first->second;
+}
+
 const char *Result::getValue(Result::SizeType row,
                              Result::RowSizeType column) const
 {
@@ -175,6 +288,11 @@ int Result::oid(RowSizeType column) const noexcept
     return resultPtr_->oid(column);
 }
 
+bool Result::isBinary(RowSizeType column) const noexcept
+{
+    return resultPtr_->isBinary(column);
+}
+
 Result &Result::operator=(const Result &r) noexcept
 {
     resultPtr_ = r.resultPtr_;
@@ -16,6 +16,10 @@
 
 #include <drogon/orm/Result.h>
 #include <trantor/utils/NonCopyable.h>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <vector>
 
 namespace drogon
 {
@@ -37,6 +41,23 @@ class ResultImpl : public trantor::NonCopyable
     virtual bool isNull(SizeType row, RowSizeType column) const = 0;
     virtual FieldSizeType getLength(SizeType row, RowSizeType column) const = 0;
 
+    // Appends the values of a column, a null value is a view of a null
+    // pointer. The implementations read their rows directly.
+    virtual void getColumn(RowSizeType column,
+                           std::vector<std::string_view> &values) const
+    {
+        auto rows = size();
+        values.reserve(values.size() + rows);
+        for (SizeType row = 0; row < rows; ++row)
+        {
+            if (isNull(row, column))
+                values.emplace_back();
+            else
+                values.emplace_back(getValue(row, column),
+                                    getLength(row, column));
+        }
+    }
+
     virtual unsigned long long insertId() const noexcept
     {
         return 0;
@@ -48,9 +69,20 @@ class ResultImpl : public trantor::NonCopyable
         return 0;
     }
 
+    virtual bool isBinary(RowSizeType column) const noexcept
+    {
+        (void)column;
+        return false;
+    }
+
     virtual ~ResultImpl()
     {
     }
+
+    // The cache of Result::columnNumbers(), keyed by the vectors of names.
+    std::mutex columnNumbersMutex_;
+    std::map<const std::vector<std::string> *, std::vector<long>>
+        columnNumbersCache_;
 };
 
 }  // namespace orm
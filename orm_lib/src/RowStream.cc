@@ -0,0 +1,151 @@
+/**
+ *
+ *  RowStream.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/RowStream.h>
+#include <cassert>
+
+using namespace drogon::orm;
+
+namespace
+{
+// Only one query is streamed at a time in a transaction, so the cursor has a
+// fixed name and the fetches reuse the same prepared statement.
+constexpr char kDeclareCursor[] =
+    "DECLARE drogon_row_stream NO SCROLL CURSOR FOR ";
+constexpr char kCloseCursor[] = "CLOSE drogon_row_stream";
+
+struct StreamState : public std::enable_shared_from_this<StreamState>
+{
+    std::shared_ptr<Transaction> transaction;
+    std::string fetchSql;
+    size_t batchSize{0};
+    RowsCallback rowsCallback;
+    ExceptionCallback exceptCallback;
+
+    void fetch();
+    void close();
+    void fail(const DrogonDbException &e);
+};
+
+class RowStreamImpl : public RowStream
+{
+  public:
+    explicit RowStreamImpl(std::shared_ptr<StreamState> state)
+        : state_(std::move(state))
+    {
+    }
+
+    ~RowStreamImpl() override
+    {
+        if (state_)
+            state_->close();
+    }
+
+    void next() override
+    {
+        if (auto state = std::move(state_))
+            state->fetch();
+    }
+
+    void cancel() override
+    {
+        if (auto state = std::move(state_))
+            state->close();
+    }
+
+  private:
+    std::shared_ptr<StreamState> state_;
+};
+
+void StreamState::fetch()
+{
+    transaction->execSqlAsync(
+        fetchSql,
+        [thisPtr = shared_from_this()](const Result &r) {
+            if (r.size() < thisPtr->batchSize)
+            {
+                thisPtr->close();
+                thisPtr->rowsCallback(r, nullptr);
+                return;
+            }
+            thisPtr->rowsCallback(r, std::make_shared<RowStreamImpl>(thisPtr));
+        },
+        [thisPtr = shared_from_this()](const DrogonDbException &e) {
+            thisPtr->fail(e);
+        });
+}
+
+void StreamState::close()
+{
+    // The transaction ends after the cursor is closed if the stream owns it.
+    transaction->execSqlAsync(
+        kCloseCursor,
+        [](const Result &) {},
+        [](const DrogonDbException &e) {
+            LOG_ERROR << "Failed to close the cursor: " << e.base().what();
+        });
+    transaction.reset();
+}
+
+void StreamState::fail(const DrogonDbException &e)
+{
+    transaction.reset();
+    exceptCallback(e);
+}
+}  // namespace
+
+void DbClient::startSqlStream(
+    const std::string &sql,
+    size_t batchSize,
+    std::function<void(internal::SqlBinder &)> &&bindParameters,
+    RowsCallback &&rowsCallback,
+    ExceptionCallback &&exceptCallback) noexcept
+{
+    assert(batchSize > 0);
+    if (type_ != ClientType::PostgreSQL)
+    {
+        auto binder = *this << sql;
+        bindParameters(binder);
+        binder >> [rowsCallback = std::move(rowsCallback)](const Result &r) {
+            rowsCallback(r, nullptr);
+        };
+        binder >> std::move(exceptCallback);
+        binder.exec();
+        return;
+    }
+
+    auto state = std::make_shared<StreamState>();
+    state->fetchSql =
+        "FETCH FORWARD " + std::to_string(batchSize) + " FROM drogon_row_stream";
+    state->batchSize = batchSize;
+    state->rowsCallback = std::move(rowsCallback);
+    state->exceptCallback = std::move(exceptCallback);
+    newTransactionAsync(
+        [state, sql, bindParameters = std::move(bindParameters)](
+            const std::shared_ptr<Transaction> &transaction) {
+            if (!transaction)
+            {
+                state->exceptCallback(TimeoutError(
+                    "Timeout, no connection available for transaction"));
+                return;
+            }
+            state->transaction = transaction;
+            auto binder = *transaction << (kDeclareCursor + sql);
+            bindParameters(binder);
+            binder >> [state](const Result &) { state->fetch(); };
+            binder >> [state](const DrogonDbException &e) { state->fail(e); };
+            binder.exec();
+        });
+}
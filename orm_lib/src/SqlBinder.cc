@@ -128,6 +128,19 @@ void SqlBinder::exec()
     }
 }
 
+void SqlBinder::execDirect(QueryCallback &&rcb, ExceptPtrCallback &&exceptCb)
+{
+    execed_ = true;
+    client_.execSql(sqlViewPtr_,
+                    sqlViewLength_,
+                    parametersNumber_,
+                    std::move(parameters_),
+                    std::move(lengths_),
+                    std::move(formats_),
+                    std::move(rcb),
+                    std::move(exceptCb));
+}
+
 SqlBinder::~SqlBinder()
 {
     destructed_ = true;
@@ -0,0 +1,224 @@
+/**
+ *
+ *  @file SqlStats.cc
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "SqlStats.h"
+#include "../../lib/src/BuiltinMetrics.h"
+#include <drogon/HttpRequest.h>
+#include <drogon/RequestDeadline.h>
+#include <trantor/utils/Logger.h>
+#include <cctype>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+// The statements are truncated, and the ones seen after the maximum number
+// of statements are counted as "other" to bound the number of label values.
+static const size_t kMaxStatementLength{512};
+static const size_t kMaxStatements{1000};
+
+static bool isIdentifierChar(char c)
+{
+    return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+static void appendPlaceholder(std::string &out)
+{
+    // A list of values is reduced to one.
+    auto pos = out.find_last_not_of(' ');
+    if (pos != std::string::npos && pos > 0 && out[pos] == ',')
+    {
+        auto prev = out.find_last_not_of(' ', pos - 1);
+        if (prev != std::string::npos && out[prev] == '?')
+        {
+            out.resize(prev + 1);
+            return;
+        }
+    }
+    out += '?';
+}
+
+std::string drogon::orm::normalizeSql(std::string_view sql)
+{
+    std::string out;
+    out.reserve(sql.length());
+    size_t i = 0;
+    const size_t n = sql.length();
+    while (i < n && out.length() < kMaxStatementLength)
+    {
+        char c = sql[i];
+        if (isspace(static_cast<unsigned char>(c)))
+        {
+            while (i < n && isspace(static_cast<unsigned char>(sql[i])))
+                ++i;
+            if (!out.empty() && out.back() != ' ')
+                out += ' ';
+            continue;
+        }
+        if (c == '-' && i + 1 < n && sql[i + 1] == '-')
+        {
+            while (i < n && sql[i] != '\n')
+                ++i;
+            continue;
+        }
+        if (c == '/' && i + 1 < n && sql[i + 1] == '*')
+        {
+            auto end = sql.find("*/", i + 2);
+            i = end == std::string_view::npos ? n : end + 2;
+            continue;
+        }
+        if (c == '\'')
+        {
+            // The quotes are escaped by doubling them or by a backslash
+            // (MySQL).
+            ++i;
+            while (i < n)
+            {
+                if (sql[i] == '\\' && i + 1 < n)
+                    i += 2;
+                else if (sql[i] == '\'' && i + 1 < n && sql[i + 1] == '\'')
+                    i += 2;
+                else if (sql[i++] == '\'')
+                    break;
+            }
+            appendPlaceholder(out);
+            continue;
+        }
+        if (c == '"' || c == '`')
+        {
+            // Quoted identifiers are kept.
+            auto end = sql.find(c, i + 1);
+            end = end == std::string_view::npos ? n : end + 1;
+            out.append(sql.data() + i, end - i);
+            i = end;
+            continue;
+        }
+        bool afterIdentifier = i > 0 && isIdentifierChar(sql[i - 1]);
+        if (!afterIdentifier &&
+            (isdigit(static_cast<unsigned char>(c)) ||
+             ((c == '$' || c == '?') && i + 1 < n &&
+              isdigit(static_cast<unsigned char>(sql[i + 1])))))
+        {
+            // Numbers and the numbered placeholders
+            ++i;
+            while (i < n && (isalnum(static_cast<unsigned char>(sql[i])) ||
+                             sql[i] == '.'))
+                ++i;
+            appendPlaceholder(out);
+            continue;
+        }
+        if (c == '?')
+        {
+            ++i;
+            appendPlaceholder(out);
+            continue;
+        }
+        out += c;
+        ++i;
+    }
+    while (!out.empty() && out.back() == ' ')
+        out.pop_back();
+    return out;
+}
+
+static std::string statementLabel(std::string_view sql)
+{
+    static std::mutex mutex;
+    static std::unordered_set<std::string> statements;
+    auto statement = normalizeSql(sql);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (statements.size() >= kMaxStatements && !statements.count(statement))
+        return "other";
+    statements.insert(statement);
+    return statement;
+}
+
+namespace
+{
+struct SqlCall
+{
+    std::string system;
+    std::string statement;
+    std::string route;
+    size_t paraNum{0};
+    std::chrono::steady_clock::time_point start;
+
+    void finish(const Result *result)
+    {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        auto &metrics = BuiltinMetrics::instance();
+        if (metrics.sqlDuration)
+        {
+            // From 10us to 100s with about 9% wide buckets.
+            metrics.sqlDuration->metric({system, statement}, 3, 1e-5, 100.0)
+                ->observe(elapsed.count());
+            if (result)
+            {
+                auto rows = result->size() > 0 ? result->size()
+                                               : result->affectedRows();
+                metrics.sqlRows->metric({system, statement})
+                    ->increment(static_cast<double>(rows));
+            }
+            else
+            {
+                metrics.sqlErrors->metric({system, statement})->increment();
+            }
+        }
+        if (metrics.slowQueryThreshold > 0 &&
+            elapsed.count() >= metrics.slowQueryThreshold)
+        {
+            // The values of the parameters are never logged.
+            LOG_WARN << "Slow query (" << elapsed.count() << "s"
+                     << (result ? "" : ", failed") << ", route "
+                     << (route.empty() ? "none" : route) << ", " << paraNum
+                     << " parameters redacted): " << statement;
+        }
+    }
+};
+}  // namespace
+
+void drogon::orm::recordSqlStats(
+    ClientType type,
+    const char *sql,
+    size_t sqlLength,
+    size_t paraNum,
+    ResultCallback &rcb,
+    std::function<void(const std::exception_ptr &)> &exceptCallback)
+{
+    auto &metrics = BuiltinMetrics::instance();
+    if (!metrics.sqlDuration && metrics.slowQueryThreshold <= 0)
+        return;
+    auto call = std::make_shared<SqlCall>();
+    call->system = type == ClientType::PostgreSQL ? "postgresql"
+                   : type == ClientType::Mysql    ? "mysql"
+                                                  : "sqlite";
+    call->statement = statementLabel(std::string_view(sql, sqlLength));
+    if (auto req = RequestDeadline::currentRequest().lock())
+        call->route = req->matchedPathPattern();
+    call->paraNum = paraNum;
+    call->start = std::chrono::steady_clock::now();
+    rcb = [call, rcb = std::move(rcb)](const Result &r) {
+        call->finish(&r);
+        rcb(r);
+    };
+    exceptCallback = [call, exceptCallback = std::move(exceptCallback)](
+                         const std::exception_ptr &exception) {
+        call->finish(nullptr);
+        exceptCallback(exception);
+    };
+}
@@ -0,0 +1,50 @@
+/**
+ *
+ *  @file SqlStats.h
+ *  @author An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/exports.h>
+#include <drogon/orm/DbClient.h>
+#include <exception>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace drogon
+{
+namespace orm
+{
+/**
+ * @brief Normalize the sql command for the statistics: the literals and the
+ * placeholders are replaced by ?, the lists of them by one, the comments are
+ * removed and the blanks collapsed, so the commands which only differ by
+ * their values have the same statement, and the values aren't disclosed.
+ */
+DROGON_EXPORT std::string normalizeSql(std::string_view sql);
+
+/**
+ * @brief Record the latency, the rows and the errors of the sql command by
+ * its normalized statement in the built-in metrics of the framework, and log
+ * it when it's slower than the threshold set by
+ * HttpAppFramework::setSlowQueryThreshold(), by wrapping its callbacks.
+ */
+void recordSqlStats(
+    ClientType type,
+    const char *sql,
+    size_t sqlLength,
+    size_t paraNum,
+    ResultCallback &rcb,
+    std::function<void(const std::exception_ptr &)> &exceptCallback);
+}  // namespace orm
+}  // namespace drogon
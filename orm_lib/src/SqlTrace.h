@@ -0,0 +1,145 @@
+/**
+ *
+ *  @file SqlTrace.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/CircuitBreaker.h>
+#include <drogon/RequestDeadline.h>
+#include <drogon/RequestTrace.h>
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/Exception.h>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <string>
+
+namespace drogon
+{
+namespace orm
+{
+/**
+ * @brief Record the sql command in the current trace of the thread, if any,
+ * by wrapping its callbacks.
+ */
+inline void traceSql(
+    ClientType type,
+    const char *sql,
+    size_t sqlLength,
+    ResultCallback &rcb,
+    std::function<void(const std::exception_ptr &)> &exceptCallback)
+{
+    auto &trace = RequestTrace::current();
+    if (!trace)
+        return;
+    auto span = trace->startSpan("db.query");
+    span.attributes.emplace_back("db.system",
+                                 type == ClientType::PostgreSQL ? "postgresql"
+                                 : type == ClientType::Mysql    ? "mysql"
+                                                                : "sqlite");
+    // The parameters aren't recorded and long statements are truncated.
+    span.attributes.emplace_back(
+        "db.statement", std::string(sql, std::min<size_t>(sqlLength, 1024)));
+    trace->traceCallbacks(std::move(span), rcb, exceptCallback);
+}
+
+/**
+ * @brief Bound the timeout of the sql command by the current deadline of the
+ * thread, if any, and keep the deadline current in its callbacks.
+ *
+ * @return false if the deadline has passed or the request is cancelled, the
+ * exception callback is then called.
+ */
+inline bool applyDeadline(
+    double &timeout,
+    ResultCallback &rcb,
+    std::function<void(const std::exception_ptr &)> &exceptCallback)
+{
+    if (!RequestDeadline::hasCurrent())
+        return true;
+    if (RequestDeadline::cancelled())
+    {
+        exceptCallback(std::make_exception_ptr(
+            Failure("The request was cancelled by the client")));
+        return false;
+    }
+    timeout = RequestDeadline::clampTimeout(timeout);
+    if (timeout < 0.0)
+    {
+        exceptCallback(std::make_exception_ptr(
+            TimeoutError("The deadline of the request has passed")));
+        return false;
+    }
+    RequestDeadline::propagate(rcb, exceptCallback);
+    return true;
+}
+
+/**
+ * @brief Fail the sql command at once while the circuit of the breaker is
+ * open, and record its outcome otherwise by wrapping its callbacks.
+ *
+ * @return false if the circuit is open, the exception callback is then
+ * called.
+ */
+inline bool applyCircuitBreaker(
+    const CircuitBreakerPtr &breaker,
+    ResultCallback &rcb,
+    std::function<void(const std::exception_ptr &)> &exceptCallback)
+{
+    if (!breaker)
+        return true;
+    if (!breaker->allow())
+    {
+        exceptCallback(std::make_exception_ptr(
+            BrokenConnection("The circuit breaker of the client is open")));
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [start]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+            .count();
+    };
+    rcb = [breaker, elapsed, rcb = std::move(rcb)](const Result &r) {
+        breaker->record(true, elapsed());
+        rcb(r);
+    };
+    exceptCallback = [breaker,
+                      elapsed,
+                      exceptCallback = std::move(exceptCallback)](
+                         const std::exception_ptr &exception) {
+        // Only the errors of the connections count, not those of the SQL.
+        bool success{true};
+        try
+        {
+            std::rethrow_exception(exception);
+        }
+        catch (const BrokenConnection &)
+        {
+            success = false;
+        }
+        catch (const TimeoutError &)
+        {
+            success = false;
+        }
+        catch (...)
+        {
+        }
+        breaker->record(success, elapsed());
+        exceptCallback(exception);
+    };
+    return true;
+}
+}  // namespace orm
+}  // namespace drogon
@@ -111,7 +111,7 @@ void TransactionImpl::execSqlInLoop(
             return;
         }
         auto thisPtr = shared_from_this();
-        if (!isWorking_)
+        if (canSendNow())
         {
             isWorking_ = true;
             thisPtr_ = thisPtr;
@@ -152,13 +152,67 @@ void TransactionImpl::execSqlInLoop(
     }
 }
 
+void TransactionImpl::execCopy(const std::shared_ptr<CopyCmd> &cmd)
+{
+    if (loop_->isInLoopThread())
+    {
+        execCopyInLoop(cmd);
+    }
+    else
+    {
+        loop_->queueInLoop([thisPtr = shared_from_this(), cmd]() {
+            thisPtr->execCopyInLoop(cmd);
+        });
+    }
+}
+
+void TransactionImpl::execCopyInLoop(const std::shared_ptr<CopyCmd> &cmd)
+{
+    loop_->assertInLoopThread();
+    if (isCommitedOrRolledback_)
+    {
+        cmd->exceptionCallback_(std::make_exception_ptr(
+            TransactionRollback("The transaction has been rolled back")));
+        return;
+    }
+    auto thisPtr = shared_from_this();
+    if (!isWorking_)
+    {
+        isWorking_ = true;
+        thisPtr_ = thisPtr;
+        dispatchCopy(cmd);
+    }
+    else
+    {
+        auto cmdPtr = std::make_shared<SqlCmd>();
+        cmdPtr->copyCmd_ = cmd;
+        cmdPtr->exceptionCallback_ = cmd->exceptionCallback_;
+        cmdPtr->thisPtr_ = thisPtr;
+        sqlCmdBuffer_.push_back(std::move(cmdPtr));
+    }
+}
+
+void TransactionImpl::dispatchCopy(const std::shared_ptr<CopyCmd> &cmd)
+{
+    // A failed COPY aborts the transaction like any other failed command.
+    cmd->exceptionCallback_ =
+        [exceptCallback = std::move(cmd->exceptionCallback_),
+         thisPtr = shared_from_this()](const std::exception_ptr &ePtr) {
+            thisPtr->rollback();
+            if (exceptCallback)
+                exceptCallback(ePtr);
+        };
+    connectionPtr_->execCopy(cmd);
+}
+
 void TransactionImpl::rollback()
 {
     auto thisPtr = shared_from_this();
 
     loop_->runInLoop([thisPtr]() {
-        if (thisPtr->isCommitedOrRolledback_)
+        if (thisPtr->isCommitedOrRolledback_ || thisPtr->rollbackRequested_)
             return;
+        thisPtr->rollbackRequested_ = true;
         if (thisPtr->isWorking_)
         {
             // push sql cmd to buffer;
@@ -215,6 +269,11 @@ void TransactionImpl::execNewTask()
         {
             auto cmd = std::move(sqlCmdBuffer_.front());
             sqlCmdBuffer_.pop_front();
+            if (cmd->copyCmd_)
+            {
+                dispatchCopy(cmd->copyCmd_);
+                return;
+            }
             auto conn = connectionPtr_;
             conn->execSql(
                 std::move(cmd->sql_),
@@ -384,7 +443,7 @@ void TransactionImpl::execSqlInLoopWithTimeout(
             return;
         rcb(result);
     };
-    if (!isWorking_)
+    if (canSendNow())
     {
         isWorking_ = true;
         thisPtr_ = thisPtr;
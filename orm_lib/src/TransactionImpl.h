@@ -113,6 +113,10 @@ class TransactionImpl : public Transaction,
         ResultCallback &&rcb,
         std::function<void(const std::exception_ptr &)> &&exceptCallback);
 
+    void execCopy(const std::shared_ptr<CopyCmd> &cmd) override;
+    void execCopyInLoop(const std::shared_ptr<CopyCmd> &cmd);
+    void dispatchCopy(const std::shared_ptr<CopyCmd> &cmd);
+
     std::shared_ptr<Transaction> newTransaction(
         const std::function<void(bool)> &,
         TransactionType) noexcept(false) override
@@ -131,6 +135,18 @@ class TransactionImpl : public Transaction,
     std::function<void()> usedUpCallback_;
     bool isCommitedOrRolledback_{false};
     bool isWorking_{false};
+    // The commands after a rollback wait for its result, they fail then.
+    bool rollbackRequested_{false};
+    // On a pipelining connection, the statements are sent without waiting
+    // for the results of the previous ones, right after the begin command.
+    // A failed statement aborts the transaction on the server, so the ones
+    // sent after it fail too, before the rollback.
+    bool canSendNow() const
+    {
+        return !isWorking_ ||
+               (!rollbackRequested_ && sqlCmdBuffer_.empty() &&
+                connectionPtr_->supportsPipelining());
+    }
     void execNewTask();
     void releaseConnection();
     void failBufferedCommands(const std::exception_ptr &ePtr);
@@ -145,6 +161,8 @@ class TransactionImpl : public Transaction,
         QueryCallback callback_;
         ExceptPtrCallback exceptionCallback_;
         bool isRollbackCmd_{false};
+        // Set for a COPY command, the other fields are unused then.
+        std::shared_ptr<CopyCmd> copyCmd_;
         std::shared_ptr<TransactionImpl> thisPtr_;
     };
 
@@ -20,6 +20,7 @@
 #include <drogon/utils/Utilities.h>
 #include <string_view>
 #include <errmsg.h>
+#include <mysqld_error.h>
 #ifndef _WIN32
 #include <poll.h>
 #else
@@ -49,12 +50,14 @@ Result makeResult(std::shared_ptr<MYSQL_RES> &&r = nullptr,
 }  // namespace drogon
 
 MysqlConnection::MysqlConnection(trantor::EventLoop *loop,
-                                 const std::string &connInfo)
+                                 const std::string &connInfo,
+                                 bool autoBatch)
     : DbConnection(loop),
       mysqlPtr_(std::shared_ptr<MYSQL>(new MYSQL, [](MYSQL *p) {
           mysql_close(p);
           delete p;
-      }))
+      })),
+      autoBatch_(autoBatch)
 {
     static MysqlEnv env;
     static thread_local MysqlThreadEnv threadEnv;
@@ -100,9 +103,39 @@ MysqlConnection::MysqlConnection(trantor::EventLoop *loop,
         {
             characterSet_ = value;
         }
+        else if (key == "prepared_statements")
+        {
+            preparedStatements_ = value == "1" || value == "true";
+        }
+        else if (key == "max_prepared_statements")
+        {
+            maxPreparedStatements_ = std::stoul(value);
+        }
+        else if (key == "prepare_threshold")
+        {
+            prepareThreshold_ =
+                static_cast<unsigned int>(std::stoul(value));
+        }
     }
 }
 
+// A CALL statement returns several results, which couldn't be told apart
+// from the ones of the next statements of a batch, nor fetched from a
+// prepared statement.
+static bool isCallStatement(std::string_view sql)
+{
+    auto pos = sql.find_first_not_of(" \t\r\n");
+    if (pos == std::string_view::npos || sql.length() - pos <= 4 ||
+        !isspace((unsigned char)sql[pos + 4]))
+        return false;
+    std::string keyword{sql.substr(pos, 4)};
+    std::transform(keyword.begin(),
+                   keyword.end(),
+                   keyword.begin(),
+                   [](unsigned char c) { return tolower(c); });
+    return keyword == "call";
+}
+
 void MysqlConnection::init()
 {
     loop_->queueInLoop([this]() {
@@ -119,7 +152,7 @@ void MysqlConnection::init()
                                                      : dbname_.c_str(),
                                      port_.empty() ? 3306 : atol(port_.c_str()),
                                      nullptr,
-                                     0);
+                                     autoBatch_ ? CLIENT_MULTI_STATEMENTS : 0);
         // LOG_DEBUG << ret;
         auto fd = mysql_get_socket(mysqlPtr_.get());
         if (fd < 0)
@@ -213,12 +246,7 @@ void MysqlConnection::handleTimeout()
             // I don't think the programe can run to here.
             if (characterSet_.empty())
             {
-                status_ = ConnectStatus::Ok;
-                if (okCallback_)
-                {
-                    auto thisPtr = shared_from_this();
-                    okCallback_(thisPtr);
-                }
+                handleConnected();
             }
             else
             {
@@ -232,6 +260,10 @@ void MysqlConnection::handleTimeout()
     {
         continueSetCharacterSet(status);
     }
+    else if (status_ == ConnectStatus::PreparingStatements)
+    {
+        continueWarmup(status);
+    }
     else if (status_ == ConnectStatus::Ok)
     {
     }
@@ -298,6 +330,36 @@ void MysqlConnection::handleCmd(int status)
             setChannel();
             break;
         }
+        case ExecStatus::StmtPrepare:
+        {
+            int err = 0;
+            waitStatus_ =
+                mysql_stmt_prepare_cont(&err, statement_->stmt, status);
+            if (waitStatus_ == 0)
+                onStmtPrepared(err, false);
+            setChannel();
+            break;
+        }
+        case ExecStatus::StmtExecute:
+        {
+            int err = 0;
+            waitStatus_ =
+                mysql_stmt_execute_cont(&err, statement_->stmt, status);
+            if (waitStatus_ == 0)
+                onStmtExecuted(err, false);
+            setChannel();
+            break;
+        }
+        case ExecStatus::StmtStoreResult:
+        {
+            int err = 0;
+            waitStatus_ =
+                mysql_stmt_store_result_cont(&err, statement_->stmt, status);
+            if (waitStatus_ == 0)
+                onStmtStored(err, false);
+            setChannel();
+            break;
+        }
         case ExecStatus::None:
         {
             // Connection closed!
@@ -338,12 +400,7 @@ void MysqlConnection::handleEvent()
             }
             if (characterSet_.empty())
             {
-                status_ = ConnectStatus::Ok;
-                if (okCallback_)
-                {
-                    auto thisPtr = shared_from_this();
-                    okCallback_(thisPtr);
-                }
+                handleConnected();
             }
             else
             {
@@ -361,6 +418,10 @@ void MysqlConnection::handleEvent()
     {
         continueSetCharacterSet(status);
     }
+    else if (status_ == ConnectStatus::PreparingStatements)
+    {
+        continueWarmup(status);
+    }
 }
 
 void MysqlConnection::continueSetCharacterSet(int status)
@@ -377,12 +438,7 @@ void MysqlConnection::continueSetCharacterSet(int status)
             handleClosed();
             return;
         }
-        status_ = ConnectStatus::Ok;
-        if (okCallback_)
-        {
-            auto thisPtr = shared_from_this();
-            okCallback_(thisPtr);
-        }
+        handleConnected();
     }
     setChannel();
 }
@@ -403,12 +459,7 @@ void MysqlConnection::startSetCharacterSet()
             handleClosed();
             return;
         }
-        status_ = ConnectStatus::Ok;
-        if (okCallback_)
-        {
-            auto thisPtr = shared_from_this();
-            okCallback_(thisPtr);
-        }
+        handleConnected();
     }
     else
     {
@@ -417,6 +468,90 @@ void MysqlConnection::startSetCharacterSet()
     setChannel();
 }
 
+void MysqlConnection::handleConnected()
+{
+    if (preparedStatements_ && warmupStatements_ &&
+        !warmupStatements_->empty())
+    {
+        status_ = ConnectStatus::PreparingStatements;
+        warmupIndex_ = 0;
+        prepareWarmupStatements();
+        return;
+    }
+    status_ = ConnectStatus::Ok;
+    if (okCallback_)
+    {
+        auto thisPtr = shared_from_this();
+        okCallback_(thisPtr);
+    }
+}
+
+void MysqlConnection::prepareWarmupStatements()
+{
+    while (warmupIndex_ < warmupStatements_->size())
+    {
+        auto &statement = useStatement((*warmupStatements_)[warmupIndex_]);
+        if (statement.stmt || statement.unsupported)
+        {
+            ++warmupIndex_;
+            continue;
+        }
+        statement.stmt = mysql_stmt_init(mysqlPtr_.get());
+        if (!statement.stmt)
+        {
+            ++warmupIndex_;
+            continue;
+        }
+        statement_ = &statement;
+        int err = 0;
+        waitStatus_ = mysql_stmt_prepare_start(&err,
+                                               statement.stmt,
+                                               statement.sql.data(),
+                                               statement.sql.length());
+        if (waitStatus_ != 0)
+            return;
+        onWarmupStatementPrepared(err);
+    }
+    status_ = ConnectStatus::Ok;
+    if (okCallback_)
+    {
+        auto thisPtr = shared_from_this();
+        okCallback_(thisPtr);
+    }
+}
+
+void MysqlConnection::continueWarmup(int status)
+{
+    int err = 0;
+    waitStatus_ = mysql_stmt_prepare_cont(&err, statement_->stmt, status);
+    if (waitStatus_ == 0)
+    {
+        onWarmupStatementPrepared(err);
+        prepareWarmupStatements();
+    }
+    setChannel();
+}
+
+void MysqlConnection::onWarmupStatementPrepared(int err)
+{
+    if (err)
+    {
+        if (mysql_stmt_errno(statement_->stmt) == ER_UNSUPPORTED_PS)
+        {
+            statement_->unsupported = true;
+        }
+        else
+        {
+            LOG_WARN << "Failed to prepare the warmup statement "
+                     << statement_->sql << ": "
+                     << mysql_stmt_error(statement_->stmt);
+        }
+        closeStatement(*statement_);
+    }
+    statement_ = nullptr;
+    ++warmupIndex_;
+}
+
 void MysqlConnection::execSqlInLoop(
     std::string_view &&sql,
     size_t paraNum,
@@ -427,6 +562,7 @@ void MysqlConnection::execSqlInLoop(
     std::function<void(const std::exception_ptr &)> &&exceptCallback)
 {
     LOG_TRACE << sql;
+    probeQuery(sql, rcb, exceptCallback);
     assert(paraNum == parameters.size());
     assert(paraNum == length.size());
     assert(paraNum == format.size());
@@ -444,7 +580,155 @@ void MysqlConnection::execSqlInLoop(
     callback_ = std::move(rcb);
     isWorking_ = true;
     exceptionCallback_ = std::move(exceptCallback);
+    // The default keyword can't be bound to a parameter.
+    if (preparedStatements_ && !isCallStatement(sql) &&
+        std::find(format.begin(),
+                  format.end(),
+                  internal::DrogonDefaultValue) == format.end())
+    {
+        auto &statement = useStatement(sql);
+        if (!statement.unsupported &&
+            (statement.stmt || ++statement.executions >= prepareThreshold_))
+        {
+            statement_ = &statement;
+            stmtParameters_ = std::move(parameters);
+            stmtLengths_ = std::move(length);
+            stmtFormats_ = std::move(format);
+            sql_ = statement.sql;
+            query_ = sql_;
+            startStatement(true);
+            setChannel();
+            return;
+        }
+    }
     sql_.clear();
+    appendSql(sql, paraNum, parameters, length, format);
+    query_ = sql_;
+    startQuery();
+    setChannel();
+}
+
+void MysqlConnection::batchSqlInLoop(
+    std::deque<std::shared_ptr<SqlCmd>> &&sqlCommands)
+{
+    assert(!sqlCommands.empty());
+    assert(!isWorking_);
+    if (sqlCommands.size() == 1)
+    {
+        auto &cmd = sqlCommands.front();
+        execSqlInLoop(std::move(cmd->sql_),
+                      cmd->parametersNumber_,
+                      std::move(cmd->parameters_),
+                      std::move(cmd->lengths_),
+                      std::move(cmd->formats_),
+                      std::move(cmd->callback_),
+                      std::move(cmd->exceptionCallback_));
+        return;
+    }
+    // The multi-statement queries are only enabled in the auto-batch mode.
+    assert(autoBatch_);
+    if (status_ != ConnectStatus::Ok)
+    {
+        LOG_ERROR << "Connection is not ready";
+        auto exceptPtr =
+            std::make_exception_ptr(drogon::orm::BrokenConnection());
+        for (auto &cmd : sqlCommands)
+            cmd->exceptionCallback_(exceptPtr);
+        return;
+    }
+    sql_.clear();
+    std::vector<std::pair<size_t, size_t>> ranges;
+    ranges.reserve(sqlCommands.size());
+    for (auto &cmd : sqlCommands)
+    {
+        LOG_TRACE << cmd->sql_;
+        if (!sql_.empty())
+            sql_.append(";\n");
+        auto pos = sql_.length();
+        appendSql(cmd->sql_,
+                  cmd->parametersNumber_,
+                  cmd->parameters_,
+                  cmd->lengths_,
+                  cmd->formats_);
+        // An empty statement would be a syntax error in the middle of the
+        // query.
+        while (sql_.length() > pos &&
+               (sql_.back() == ';' || isspace((unsigned char)sql_.back())))
+            sql_.pop_back();
+        ranges.emplace_back(pos, sql_.length() - pos);
+    }
+    // The views are taken once sql_ won't be reallocated anymore.
+    for (size_t i = 0; i < sqlCommands.size(); ++i)
+    {
+        batchCommands_.emplace_back(
+            std::move(sqlCommands[i]),
+            std::string_view{sql_}.substr(ranges[i].first, ranges[i].second));
+    }
+    isWorking_ = true;
+    nextBatchCommand();
+    startQuery();
+    setChannel();
+}
+
+void MysqlConnection::nextBatchCommand()
+{
+    auto &cmd = batchCommands_.front();
+    callback_ = std::move(cmd.first->callback_);
+    exceptionCallback_ = std::move(cmd.first->exceptionCallback_);
+    query_ = cmd.second;
+    batchCommands_.pop_front();
+}
+
+// The server doesn't execute the statements after a failed one.
+void MysqlConnection::failBatchCommands()
+{
+    if (batchCommands_.empty())
+        return;
+    auto commands = std::move(batchCommands_);
+    batchCommands_.clear();
+    for (auto &cmd : commands)
+    {
+        cmd.first->exceptionCallback_(std::make_exception_ptr(
+            SqlError("Not executed because of the failure of a previous "
+                     "statement in the batch",
+                     std::string{cmd.second})));
+    }
+}
+
+std::deque<std::shared_ptr<SqlCmd>> MysqlConnection::takeBatch(
+    std::deque<std::shared_ptr<SqlCmd>> &buffer)
+{
+    // The limits keep the query far below the max_allowed_packet of the
+    // server and the failure of a statement from affecting too many others.
+    constexpr size_t maxBatchCount = 64;
+    constexpr size_t maxBatchLength = 256 * 1024;
+    std::deque<std::shared_ptr<SqlCmd>> cmds;
+    size_t length = 0;
+    while (!buffer.empty() && cmds.size() < maxBatchCount)
+    {
+        auto &cmd = buffer.front();
+        auto sql = cmd->sql_;
+        bool isCall = isCallStatement(sql);
+        if (!cmds.empty() &&
+            (isCall || length + sql.length() > maxBatchLength))
+            break;
+        length += sql.length();
+        for (auto len : cmd->lengths_)
+            length += len;
+        cmds.push_back(std::move(cmd));
+        buffer.pop_front();
+        if (isCall)
+            break;
+    }
+    return cmds;
+}
+
+void MysqlConnection::appendSql(std::string_view sql,
+                                size_t paraNum,
+                                const std::vector<const char *> &parameters,
+                                const std::vector<int> &length,
+                                const std::vector<int> &format)
+{
     if (paraNum > 0)
     {
         std::string::size_type pos = 0;
@@ -531,26 +815,33 @@ void MysqlConnection::execSqlInLoop(
     }
     else
     {
-        sql_ = std::string(sql.data(), sql.length());
+        sql_.append(sql.data(), sql.length());
     }
-    startQuery();
-    setChannel();
 }
 
 void MysqlConnection::outputError()
+{
+    outputError(mysql_errno(mysqlPtr_.get()),
+                mysql_sqlstate(mysqlPtr_.get()),
+                mysql_error(mysqlPtr_.get()));
+}
+
+void MysqlConnection::outputError(unsigned int errorNo,
+                                  const std::string &sqlState,
+                                  const std::string &message)
 {
     channelPtr_->disableAll();
-    auto errorNo = mysql_errno(mysqlPtr_.get());
-    LOG_ERROR << "Error(" << errorNo << ") [" << mysql_sqlstate(mysqlPtr_.get())
-              << "] \"" << mysql_error(mysqlPtr_.get()) << "\"";
+    LOG_ERROR << "Error(" << errorNo << ") [" << sqlState << "] \""
+              << message << "\"";
     LOG_ERROR << "sql:" << sql_;
     if (isWorking_)
     {
         // TODO: exception type
         auto exceptPtr = std::make_exception_ptr(
-            SqlError(mysql_error(mysqlPtr_.get()), sql_, errorNo, 0));
+            SqlError(message, std::string{query_}, errorNo, 0));
         exceptionCallback_(exceptPtr);
         exceptionCallback_ = nullptr;
+        failBatchCommands();
 
         callback_ = nullptr;
         isWorking_ = false;
@@ -639,11 +930,15 @@ void MysqlConnection::getResult(MYSQL_RES *res)
         {
             callback_ = nullptr;
             exceptionCallback_ = nullptr;
+            failBatchCommands();
             isWorking_ = false;
             idleCb_();
         }
         else
         {
+            // Every statement of a batch returns one result.
+            if (!batchCommands_.empty())
+                nextBatchCommand();
             execStatus_ = ExecStatus::NextResult;
             int err;
             waitStatus_ = mysql_next_result_start(&err, mysqlPtr_.get());
@@ -661,3 +956,347 @@ void MysqlConnection::getResult(MYSQL_RES *res)
         }
     }
 }
+
+MysqlConnection::Statement &MysqlConnection::useStatement(std::string_view sql)
+{
+    auto iter = statementsMap_.find(sql);
+    if (iter != statementsMap_.end())
+    {
+        statements_.splice(statements_.begin(), statements_, iter->second);
+        return statements_.front();
+    }
+    statements_.emplace_front();
+    auto &statement = statements_.front();
+    statement.sql = std::string{sql};
+    statementsMap_.emplace(std::string_view{statement.sql},
+                           statements_.begin());
+    while (maxPreparedStatements_ > 0 &&
+           statements_.size() > maxPreparedStatements_)
+    {
+        auto &last = statements_.back();
+        closeStatement(last);
+        statementsMap_.erase(last.sql);
+        statements_.pop_back();
+    }
+    return statement;
+}
+
+void MysqlConnection::closeStatement(Statement &statement)
+{
+    if (statement.stmt)
+    {
+        // Only used when the connection is idle, the server doesn't reply
+        // to the COM_STMT_CLOSE command.
+        mysql_stmt_close(statement.stmt);
+        statement.stmt = nullptr;
+    }
+}
+
+void MysqlConnection::closeStatements()
+{
+    for (auto &statement : statements_)
+    {
+        closeStatement(statement);
+    }
+    statementsMap_.clear();
+    statements_.clear();
+}
+
+void MysqlConnection::startStatement(bool queueInLoop)
+{
+    auto &statement = *statement_;
+    if (statement.stmt)
+    {
+        // A warmup statement is prepared before its parameters are known.
+        if (mysql_stmt_param_count(statement.stmt) != stmtFormats_.size())
+        {
+            LOG_DEBUG << "The statement is sent as text: " << statement.sql;
+            statement.unsupported = true;
+            closeStatement(statement);
+            startStmtAsText();
+            return;
+        }
+        startStmtExecute(queueInLoop);
+        return;
+    }
+    statement.stmt = mysql_stmt_init(mysqlPtr_.get());
+    if (!statement.stmt)
+    {
+        outputStmtError(false, queueInLoop);
+        return;
+    }
+    execStatus_ = ExecStatus::StmtPrepare;
+    int err = 0;
+    waitStatus_ = mysql_stmt_prepare_start(&err,
+                                           statement.stmt,
+                                           statement.sql.data(),
+                                           statement.sql.length());
+    LOG_TRACE << "stmt_prepare:" << waitStatus_;
+    if (waitStatus_ == 0)
+        onStmtPrepared(err, queueInLoop);
+}
+
+void MysqlConnection::onStmtPrepared(int err, bool queueInLoop)
+{
+    auto stmt = statement_->stmt;
+    // The statements which can't be prepared are sent as before, also the
+    // ones whose placeholders aren't the parameters, e.g. the question marks
+    // in the string literals.
+    if ((err && mysql_stmt_errno(stmt) == ER_UNSUPPORTED_PS) ||
+        (!err && mysql_stmt_param_count(stmt) != stmtFormats_.size()))
+    {
+        LOG_DEBUG << "The statement is sent as text: " << statement_->sql;
+        statement_->unsupported = true;
+        closeStatement(*statement_);
+        startStmtAsText();
+        return;
+    }
+    if (err)
+    {
+        outputStmtError(true, queueInLoop);
+        return;
+    }
+    startStmtExecute(queueInLoop);
+}
+
+void MysqlConnection::startStmtExecute(bool queueInLoop)
+{
+    auto stmt = statement_->stmt;
+    stmtBinds_.assign(stmtFormats_.size(), MYSQL_BIND{});
+    for (size_t i = 0; i < stmtFormats_.size(); ++i)
+    {
+        auto &bind = stmtBinds_[i];
+        bind.buffer = const_cast<char *>(stmtParameters_[i]);
+        switch (stmtFormats_[i])
+        {
+            case internal::MySqlTiny:
+                bind.buffer_type = MYSQL_TYPE_TINY;
+                break;
+            case internal::MySqlShort:
+                bind.buffer_type = MYSQL_TYPE_SHORT;
+                break;
+            case internal::MySqlLong:
+                bind.buffer_type = MYSQL_TYPE_LONG;
+                break;
+            case internal::MySqlLongLong:
+                bind.buffer_type = MYSQL_TYPE_LONGLONG;
+                break;
+            case internal::MySqlUTiny:
+                bind.buffer_type = MYSQL_TYPE_TINY;
+                bind.is_unsigned = 1;
+                break;
+            case internal::MySqlUShort:
+                bind.buffer_type = MYSQL_TYPE_SHORT;
+                bind.is_unsigned = 1;
+                break;
+            case internal::MySqlULong:
+                bind.buffer_type = MYSQL_TYPE_LONG;
+                bind.is_unsigned = 1;
+                break;
+            case internal::MySqlULongLong:
+                bind.buffer_type = MYSQL_TYPE_LONGLONG;
+                bind.is_unsigned = 1;
+                break;
+            case internal::MySqlNull:
+                bind.buffer_type = MYSQL_TYPE_NULL;
+                bind.buffer = nullptr;
+                break;
+            case internal::MySqlString:
+                bind.buffer_type = MYSQL_TYPE_STRING;
+                bind.buffer_length =
+                    static_cast<unsigned long>(stmtLengths_[i]);
+                break;
+            default:
+                LOG_FATAL << "MySQL does not recognize the parameter type";
+                abort();
+                break;
+        }
+    }
+    if (!stmtBinds_.empty() && mysql_stmt_bind_param(stmt, stmtBinds_.data()))
+    {
+        outputStmtError(false, queueInLoop);
+        return;
+    }
+    execStatus_ = ExecStatus::StmtExecute;
+    int err = 0;
+    waitStatus_ = mysql_stmt_execute_start(&err, stmt);
+    LOG_TRACE << "stmt_execute:" << waitStatus_;
+    if (waitStatus_ == 0)
+        onStmtExecuted(err, queueInLoop);
+}
+
+void MysqlConnection::onStmtExecuted(int err, bool queueInLoop)
+{
+    if (err)
+    {
+        outputStmtError(false, queueInLoop);
+        return;
+    }
+    auto stmt = statement_->stmt;
+    auto metadata = mysql_stmt_result_metadata(stmt);
+    if (!metadata)
+    {
+        execStatus_ = ExecStatus::None;
+        finishStatement(makeResult(nullptr,
+                                   mysql_stmt_affected_rows(stmt),
+                                   mysql_stmt_insert_id(stmt)),
+                        queueInLoop);
+        return;
+    }
+    stmtMetadata_ = std::shared_ptr<MYSQL_RES>(metadata, [](MYSQL_RES *r) {
+        mysql_free_result(r);
+    });
+    execStatus_ = ExecStatus::StmtStoreResult;
+    waitStatus_ = mysql_stmt_store_result_start(&err, stmt);
+    LOG_TRACE << "stmt_store_result:" << waitStatus_;
+    if (waitStatus_ == 0)
+        onStmtStored(err, queueInLoop);
+}
+
+void MysqlConnection::onStmtStored(int err, bool queueInLoop)
+{
+    if (err)
+    {
+        stmtMetadata_.reset();
+        outputStmtError(false, queueInLoop);
+        return;
+    }
+    execStatus_ = ExecStatus::None;
+    finishStatement(fetchStmtResult(), queueInLoop);
+}
+
+Result MysqlConnection::fetchStmtResult()
+{
+    auto stmt = statement_->stmt;
+    auto columns = mysql_num_fields(stmtMetadata_.get());
+    // The values are converted to strings by the client library, like the
+    // ones of the text protocol. The lengths are fetched first, then each
+    // value into its place.
+    std::vector<MYSQL_BIND> binds(columns, MYSQL_BIND{});
+    std::vector<unsigned long> lengths(columns);
+    std::vector<my_bool> nulls(columns);
+    for (unsigned int i = 0; i < columns; ++i)
+    {
+        binds[i].buffer_type = MYSQL_TYPE_STRING;
+        binds[i].length = &lengths[i];
+        binds[i].is_null = &nulls[i];
+    }
+    std::string values;
+    std::vector<size_t> offsets;
+    std::vector<unsigned long> valueLengths;
+    Result::SizeType rows = 0;
+    if (columns > 0 && !mysql_stmt_bind_result(stmt, binds.data()))
+    {
+        offsets.reserve(mysql_stmt_num_rows(stmt) * columns);
+        valueLengths.reserve(offsets.capacity());
+        int ret;
+        while ((ret = mysql_stmt_fetch(stmt)) == 0 ||
+               ret == MYSQL_DATA_TRUNCATED)
+        {
+            ++rows;
+            for (unsigned int i = 0; i < columns; ++i)
+            {
+                if (nulls[i])
+                {
+                    offsets.push_back(std::string::npos);
+                    valueLengths.push_back(0);
+                    continue;
+                }
+                auto pos = values.size();
+                // Followed by a null character like the text values
+                values.resize(pos + lengths[i] + 1);
+                if (lengths[i] > 0)
+                {
+                    auto bind = binds[i];
+                    bind.buffer = &values[pos];
+                    bind.buffer_length = lengths[i];
+                    mysql_stmt_fetch_column(stmt, &bind, i, 0);
+                }
+                offsets.push_back(pos);
+                valueLengths.push_back(lengths[i]);
+            }
+        }
+    }
+    auto affectedRows = mysql_stmt_affected_rows(stmt);
+    auto insertId = mysql_stmt_insert_id(stmt);
+    mysql_stmt_free_result(stmt);
+    return Result{std::make_shared<MysqlResultImpl>(std::move(stmtMetadata_),
+                                                    rows,
+                                                    std::move(values),
+                                                    offsets,
+                                                    valueLengths,
+                                                    affectedRows,
+                                                    insertId)};
+}
+
+void MysqlConnection::finishStatement(const Result &result, bool queueInLoop)
+{
+    statement_ = nullptr;
+    stmtParameters_.clear();
+    if (queueInLoop)
+    {
+        loop_->queueInLoop([thisPtr = shared_from_this(), result] {
+            thisPtr->finishStatement(result, false);
+        });
+        return;
+    }
+    if (isWorking_)
+    {
+        callback_(result);
+        callback_ = nullptr;
+        exceptionCallback_ = nullptr;
+        isWorking_ = false;
+        idleCb_();
+    }
+}
+
+void MysqlConnection::startStmtAsText()
+{
+    sql_.clear();
+    appendSql(statement_->sql,
+              stmtFormats_.size(),
+              stmtParameters_,
+              stmtLengths_,
+              stmtFormats_);
+    query_ = sql_;
+    statement_ = nullptr;
+    stmtParameters_.clear();
+    startQuery();
+}
+
+void MysqlConnection::outputStmtError(bool discard, bool queueInLoop)
+{
+    execStatus_ = ExecStatus::None;
+    auto stmt = statement_->stmt;
+    unsigned int errorNo;
+    std::string sqlState;
+    std::string message;
+    if (stmt)
+    {
+        errorNo = mysql_stmt_errno(stmt);
+        sqlState = mysql_stmt_sqlstate(stmt);
+        message = mysql_stmt_error(stmt);
+    }
+    else
+    {
+        errorNo = mysql_errno(mysqlPtr_.get());
+        sqlState = mysql_sqlstate(mysqlPtr_.get());
+        message = mysql_error(mysqlPtr_.get());
+    }
+    // The statement which isn't prepared is prepared again next time.
+    if (discard)
+        closeStatement(*statement_);
+    statement_ = nullptr;
+    stmtParameters_.clear();
+    if (queueInLoop)
+    {
+        loop_->queueInLoop([thisPtr = shared_from_this(),
+                            errorNo,
+                            sqlState = std::move(sqlState),
+                            message = std::move(message)] {
+            thisPtr->outputError(errorNo, sqlState, message);
+        });
+        return;
+    }
+    outputError(errorNo, sqlState, message);
+}
@@ -19,11 +19,14 @@
 #include <trantor/net/EventLoop.h>
 #include <trantor/net/Channel.h>
 #include <trantor/utils/NonCopyable.h>
+#include <deque>
 #include <functional>
 #include <iostream>
+#include <list>
 #include <memory>
 #include <mysql.h>
 #include <string>
+#include <unordered_map>
 
 namespace drogon
 {
@@ -36,12 +39,15 @@ class MysqlConnection : public DbConnection,
                         public std::enable_shared_from_this<MysqlConnection>
 {
   public:
-    MysqlConnection(trantor::EventLoop *loop, const std::string &connInfo);
+    MysqlConnection(trantor::EventLoop *loop,
+                    const std::string &connInfo,
+                    bool autoBatch = false);
 
     void init() override;
 
     ~MysqlConnection()
     {
+        closeStatements();
     }
 
     void execSql(std::string_view &&sql,
@@ -86,14 +92,31 @@ class MysqlConnection : public DbConnection,
         }
     }
 
-    void batchSql(std::deque<std::shared_ptr<SqlCmd>> &&) override
+    // Sends the commands as one multi-statement query, which is only
+    // available in the auto-batch mode.
+    void batchSql(std::deque<std::shared_ptr<SqlCmd>> &&sqlCommands) override
     {
-        LOG_FATAL << "The mysql library does not support batch mode";
-        exit(1);
+        if (loop_->isInLoopThread())
+        {
+            batchSqlInLoop(std::move(sqlCommands));
+        }
+        else
+        {
+            auto thisPtr = shared_from_this();
+            loop_->queueInLoop(
+                [thisPtr, sqlCommands = std::move(sqlCommands)]() mutable {
+                    thisPtr->batchSqlInLoop(std::move(sqlCommands));
+                });
+        }
     }
 
     void disconnect() override;
 
+    // Moves the commands at the front of the buffer which can be sent in the
+    // same multi-statement query, at least one of them.
+    static std::deque<std::shared_ptr<SqlCmd>> takeBatch(
+        std::deque<std::shared_ptr<SqlCmd>> &buffer);
+
   private:
     class MysqlEnv
     {
@@ -131,6 +154,15 @@ class MysqlConnection : public DbConnection,
         std::vector<int> &&format,
         ResultCallback &&rcb,
         std::function<void(const std::exception_ptr &)> &&exceptCallback);
+    void batchSqlInLoop(std::deque<std::shared_ptr<SqlCmd>> &&sqlCommands);
+    // Appends the sql with its parameters replaced by their escaped values.
+    void appendSql(std::string_view sql,
+                   size_t paraNum,
+                   const std::vector<const char *> &parameters,
+                   const std::vector<int> &length,
+                   const std::vector<int> &format);
+    void nextBatchCommand();
+    void failBatchCommands();
     void startSetCharacterSet();
     void continueSetCharacterSet(int status);
     std::unique_ptr<trantor::Channel> channelPtr_;
@@ -151,13 +183,77 @@ class MysqlConnection : public DbConnection,
         None = 0,
         RealQuery,
         StoreResult,
-        NextResult
+        NextResult,
+        StmtPrepare,
+        StmtExecute,
+        StmtStoreResult
     };
     ExecStatus execStatus_{ExecStatus::None};
 
     void outputError();
+    void outputError(unsigned int errorNo,
+                     const std::string &sqlState,
+                     const std::string &message);
     std::string sql_;
+    // The part of sql_ executed for callback_.
+    std::string_view query_;
+    bool autoBatch_{false};
+    // The commands of the batch in progress after the one of callback_,
+    // with their parts of sql_.
+    std::deque<std::pair<std::shared_ptr<SqlCmd>, std::string_view>>
+        batchCommands_;
     std::string host_, user_, passwd_, dbname_, port_;
+
+    // The server-side prepared statements, enabled by the
+    // prepared_statements keyword of the connection string. The queries are
+    // executed with the binary protocol once they are prepared, the
+    // statements executed on the connection are kept, the most recently used
+    // first. Only the last ones are kept if the number is limited.
+    struct Statement
+    {
+        std::string sql;
+        // Null until the statement is prepared.
+        MYSQL_STMT *stmt{nullptr};
+        unsigned int executions{0};
+        // The server can't prepare the statement, it's sent as text.
+        bool unsupported{false};
+    };
+    bool preparedStatements_{false};
+    size_t maxPreparedStatements_{0};
+    unsigned int prepareThreshold_{1};
+    std::list<Statement> statements_;
+    std::unordered_map<std::string_view, std::list<Statement>::iterator>
+        statementsMap_;
+    // The statement executed for callback_ and its parameters.
+    Statement *statement_{nullptr};
+    std::vector<const char *> stmtParameters_;
+    std::vector<int> stmtLengths_;
+    std::vector<int> stmtFormats_;
+    std::vector<MYSQL_BIND> stmtBinds_;
+    std::shared_ptr<MYSQL_RES> stmtMetadata_;
+    Statement &useStatement(std::string_view sql);
+    void closeStatement(Statement &statement);
+    void closeStatements();
+    void startStatement(bool queueInLoop);
+    void onStmtPrepared(int err, bool queueInLoop);
+    void startStmtExecute(bool queueInLoop);
+    void onStmtExecuted(int err, bool queueInLoop);
+    void onStmtStored(int err, bool queueInLoop);
+    // Sends the statement as a text query, when it can't be prepared.
+    void startStmtAsText();
+    // Reports the error of the statement, which is closed if discard is
+    // true.
+    void outputStmtError(bool discard, bool queueInLoop);
+    void finishStatement(const Result &result, bool queueInLoop);
+    Result fetchStmtResult();
+    // The warmup statements are prepared one after the other once the
+    // connection is established, if the prepared statements are enabled,
+    // the ones which can't be prepared are skipped.
+    size_t warmupIndex_{0};
+    void handleConnected();
+    void prepareWarmupStatements();
+    void continueWarmup(int status);
+    void onWarmupStatementPrepared(int err);
 };
 
 }  // namespace orm
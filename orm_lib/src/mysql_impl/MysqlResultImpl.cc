@@ -19,6 +19,64 @@
 
 using namespace drogon::orm;
 
+MysqlResultImpl::MysqlResultImpl(std::shared_ptr<MYSQL_RES> metadata,
+                                 SizeType rows,
+                                 std::string &&values,
+                                 const std::vector<size_t> &offsets,
+                                 const std::vector<unsigned long> &lengths,
+                                 SizeType affectedRows,
+                                 unsigned long long insertId) noexcept
+    : result_(std::move(metadata)),
+      rowsNumber_(rows),
+      fieldArray_(result_ ? mysql_fetch_fields(result_.get()) : nullptr),
+      fieldsNumber_(result_ ? mysql_num_fields(result_.get()) : 0),
+      affectedRows_(affectedRows),
+      insertId_(insertId),
+      values_(std::move(values))
+{
+    initFieldsMap();
+    if (rowsNumber_ == 0 || fieldsNumber_ == 0)
+        return;
+    assert(offsets.size() == rowsNumber_ * fieldsNumber_);
+    assert(lengths.size() == offsets.size());
+    valuePointers_.resize(offsets.size());
+    for (size_t i = 0; i < offsets.size(); ++i)
+    {
+        valuePointers_[i] = offsets[i] == std::string::npos
+                                ? nullptr
+                                : values_.data() + offsets[i];
+    }
+    rowsPtr_ = std::make_shared<
+        std::vector<std::pair<char **, std::vector<unsigned long>>>>();
+    rowsPtr_->reserve(rowsNumber_);
+    for (SizeType row = 0; row < rowsNumber_; ++row)
+    {
+        auto first = row * fieldsNumber_;
+        rowsPtr_->emplace_back(
+            valuePointers_.data() + first,
+            std::vector<unsigned long>(lengths.begin() + first,
+                                       lengths.begin() + first +
+                                           fieldsNumber_));
+    }
+}
+
+void MysqlResultImpl::initFieldsMap()
+{
+    if (fieldsNumber_ == 0)
+        return;
+    fieldsMapPtr_ =
+        std::make_shared<std::unordered_map<std::string, RowSizeType>>();
+    for (RowSizeType i = 0; i < fieldsNumber_; ++i)
+    {
+        std::string fieldName = fieldArray_[i].name;
+        std::transform(fieldName.begin(),
+                       fieldName.end(),
+                       fieldName.begin(),
+                       [](unsigned char c) { return tolower(c); });
+        (*fieldsMapPtr_)[fieldName] = i;
+    }
+}
+
 Result::SizeType MysqlResultImpl::size() const noexcept
 {
     return rowsNumber_;
@@ -79,6 +137,22 @@ Result::FieldSizeType MysqlResultImpl::getLength(SizeType row,
     return (*rowsPtr_)[row].second[column];
 }
 
+void MysqlResultImpl::getColumn(RowSizeType column,
+                                std::vector<std::string_view> &values) const
+{
+    if (rowsNumber_ == 0 || fieldsNumber_ == 0)
+        return;
+    assert(column < fieldsNumber_);
+    values.reserve(values.size() + rowsNumber_);
+    for (auto const &row : *rowsPtr_)
+    {
+        if (row.first[column])
+            values.emplace_back(row.first[column], row.second[column]);
+        else
+            values.emplace_back();
+    }
+}
+
 unsigned long long MysqlResultImpl::insertId() const noexcept
 {
     return insertId_;
@@ -39,20 +39,7 @@ class MysqlResultImpl : public ResultImpl
           affectedRows_(affectedRows),
           insertId_(insertId)
     {
-        if (fieldsNumber_ > 0)
-        {
-            fieldsMapPtr_ = std::make_shared<
-                std::unordered_map<std::string, RowSizeType>>();
-            for (RowSizeType i = 0; i < fieldsNumber_; ++i)
-            {
-                std::string fieldName = fieldArray_[i].name;
-                std::transform(fieldName.begin(),
-                               fieldName.end(),
-                               fieldName.begin(),
-                               [](unsigned char c) { return tolower(c); });
-                (*fieldsMapPtr_)[fieldName] = i;
-            }
-        }
+        initFieldsMap();
         if (size() > 0)
         {
             rowsPtr_ = std::make_shared<
@@ -71,6 +58,25 @@ class MysqlResultImpl : public ResultImpl
         }
     }
 
+    /**
+     * @brief The result of a prepared statement, whose values were fetched
+     * as strings.
+     *
+     * @param metadata The result metadata of the statement.
+     * @param values The values of all the rows, one after another, each
+     * followed by a null character.
+     * @param offsets The offsets of the values in the values string, row by
+     * row, std::string::npos for the NULL values.
+     * @param lengths The lengths of the values, row by row.
+     */
+    MysqlResultImpl(std::shared_ptr<MYSQL_RES> metadata,
+                    SizeType rows,
+                    std::string &&values,
+                    const std::vector<size_t> &offsets,
+                    const std::vector<unsigned long> &lengths,
+                    SizeType affectedRows,
+                    unsigned long long insertId) noexcept;
+
     SizeType size() const noexcept override;
     RowSizeType columns() const noexcept override;
     const char *columnName(RowSizeType number) const override;
@@ -79,9 +85,13 @@ class MysqlResultImpl : public ResultImpl
     const char *getValue(SizeType row, RowSizeType column) const override;
     bool isNull(SizeType row, RowSizeType column) const override;
     FieldSizeType getLength(SizeType row, RowSizeType column) const override;
+    void getColumn(RowSizeType column,
+                   std::vector<std::string_view> &values) const override;
     unsigned long long insertId() const noexcept override;
 
   private:
+    void initFieldsMap();
+
     const std::shared_ptr<MYSQL_RES> result_;
     const Result::SizeType rowsNumber_;
     const MYSQL_FIELD *fieldArray_;
@@ -91,6 +101,10 @@ class MysqlResultImpl : public ResultImpl
     std::shared_ptr<std::unordered_map<std::string, RowSizeType>> fieldsMapPtr_;
     std::shared_ptr<std::vector<std::pair<char **, std::vector<unsigned long>>>>
         rowsPtr_;
+    // The values of the result of a prepared statement, which the rows
+    // point to.
+    std::string values_;
+    std::vector<char *> valuePointers_;
 };
 
 }  // namespace orm
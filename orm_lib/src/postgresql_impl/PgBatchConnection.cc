@@ -79,13 +79,15 @@ int PgConnection::flush()
 
 PgConnection::PgConnection(trantor::EventLoop *loop,
                            const std::string &connInfo,
-                           bool autoBatch)
+                           bool autoBatch,
+                           PgConnectionOptions options)
     : DbConnection(loop),
       autoBatch_(autoBatch),
       connectionPtr_(
           std::shared_ptr<PGconn>(PQconnectStart(connInfo.c_str()),
                                   [](PGconn *conn) { PQfinish(conn); })),
-      channel_(loop, PQsocket(connectionPtr_.get()))
+      channel_(loop, PQsocket(connectionPtr_.get())),
+      options_(std::move(options))
 {
     if (channel_.fd() < 0)
     {
@@ -113,7 +115,11 @@ void PgConnection::init()
         {
             return;
         }
-        if (status_ != ConnectStatus::Ok)
+        if (status_ == ConnectStatus::PreparingStatements)
+        {
+            handleWarmupRead();
+        }
+        else if (status_ != ConnectStatus::Ok)
         {
             pgPoll();
         }
@@ -128,6 +134,12 @@ void PgConnection::init()
             auto ret = PQflush(connectionPtr_.get());
             if (ret == 0)
             {
+                if (copyCmd_)
+                {
+                    channel_.disableWriting();
+                    sendCopyData();
+                    return;
+                }
                 sendBatchedSql();
                 return;
             }
@@ -139,6 +151,10 @@ void PgConnection::init()
                 return;
             }
         }
+        else if (status_ == ConnectStatus::PreparingStatements)
+        {
+            flush();
+        }
         else
         {
             pgPoll();
@@ -156,6 +172,7 @@ void PgConnection::handleClosed()
     if (status_ == ConnectStatus::Bad)
         return;
     status_ = ConnectStatus::Bad;
+    failCopy();
     channel_.disableAll();
     channel_.remove();
     assert(closeCallback_);
@@ -209,14 +226,12 @@ void PgConnection::pgPoll()
         case PGRES_POLLING_OK:
             if (status_ != ConnectStatus::Ok)
             {
-                status_ = ConnectStatus::Ok;
-                if (!PQenterPipelineMode(connectionPtr_.get()))
-                {
-                    handleClosed();
+                // The warmup statements are prepared before entering the
+                // pipeline mode.
+                if (startWarmup())
+                    return;
+                if (!onConnected())
                     return;
-                }
-                assert(okCallback_);
-                okCallback_(shared_from_this());
             }
             if (!channel_.isReading())
                 channel_.enableReading();
@@ -231,6 +246,19 @@ void PgConnection::pgPoll()
     }
 }
 
+bool PgConnection::onConnected()
+{
+    status_ = ConnectStatus::Ok;
+    if (!PQenterPipelineMode(connectionPtr_.get()))
+    {
+        handleClosed();
+        return false;
+    }
+    assert(okCallback_);
+    okCallback_(shared_from_this());
+    return true;
+}
+
 void PgConnection::execSqlInLoop(
     std::string_view &&sql,
     size_t paraNum,
@@ -241,6 +269,7 @@ void PgConnection::execSqlInLoop(
     std::function<void(const std::exception_ptr &)> &&exceptCallback)
 {
     LOG_TRACE << sql;
+    probeQuery(sql, rcb, exceptCallback);
     if (status_ != ConnectStatus::Ok)
     {
         LOG_ERROR << "Connection is not ready";
@@ -303,8 +332,17 @@ void PgConnection::sendBatchedSql()
         std::string statName;
         if (cmd->preparingStatement_.empty())
         {
-            auto iter = preparedStatementsMap_.find(cmd->sql_);
-            if (iter == preparedStatementsMap_.end())
+            bool prepare{false};
+            auto statement = preparedStatement(cmd->sql_, prepare);
+            if (statement)
+            {
+                statName = statement->name;
+                if (autoBatch_)
+                {
+                    cmd->isChanging_ = statement->isChanging;
+                }
+            }
+            else if (prepare)
             {
                 statName = newStmtName();
                 if (PQsendPrepare(connectionPtr_.get(),
@@ -331,13 +369,9 @@ void PgConnection::sendBatchedSql()
                     return;
                 }
             }
-            else
+            else if (autoBatch_)
             {
-                statName = iter->second.first;
-                if (autoBatch_)
-                {
-                    cmd->isChanging_ = iter->second.second;
-                }
+                cmd->isChanging_ = checkSql(cmd->sql_);
             }
         }
         else
@@ -359,13 +393,24 @@ void PgConnection::sendBatchedSql()
             }
             ++batchCount_;
         }
-        if (PQsendQueryPrepared(connectionPtr_.get(),
-                                statName.c_str(),
-                                cmd->parametersNumber_,
-                                cmd->parameters_.data(),
-                                cmd->lengths_.data(),
-                                cmd->formats_.data(),
-                                0) == 0)
+        // The query isn't prepared if it isn't executed often enough yet.
+        auto ret = statName.empty()
+                       ? PQsendQueryParams(connectionPtr_.get(),
+                                           cmd->sql_.data(),
+                                           cmd->parametersNumber_,
+                                           nullptr,
+                                           cmd->parameters_.data(),
+                                           cmd->lengths_.data(),
+                                           cmd->formats_.data(),
+                                           resultFormat(cmd->sql_))
+                       : PQsendQueryPrepared(connectionPtr_.get(),
+                                             statName.c_str(),
+                                             cmd->parametersNumber_,
+                                             cmd->parameters_.data(),
+                                             cmd->lengths_.data(),
+                                             cmd->formats_.data(),
+                                             resultFormat(cmd->sql_));
+        if (ret == 0)
         {
             isWorking_ = false;
             handleFatalError(true);
@@ -428,6 +473,11 @@ void PgConnection::handleRead()
         handleClosed();
         return;
     }
+    if (copyCmd_)
+    {
+        handleCopyRead();
+        return;
+    }
     if (PQisBusy(connectionPtr_.get()))
     {
         // need read more data from socket;
@@ -482,6 +532,10 @@ void PgConnection::handleRead()
             if (batchCommandsForWaitingResults_.empty() &&
                 batchSqlCommands_.empty())
             {
+                // The results of the deallocations are read like the
+                // others before the connection is idle.
+                if (sendDeallocations())
+                    return;
                 isWorking_ = false;
                 idleCb_();
                 return;
@@ -493,14 +547,13 @@ void PgConnection::handleRead()
             auto &cmd = batchCommandsForWaitingResults_.front();
             if (!cmd->preparingStatement_.empty())
             {
-                auto r = preparedStatements_.insert(
-                    std::string{cmd->sql_.data(), cmd->sql_.length()});
-                preparedStatementsMap_[std::string_view{r.first->c_str(),
-                                                        r.first->length()}] = {
-                    std::move(cmd->preparingStatement_), cmd->isChanging_};
+                setPreparedStatement(cmd->sql_,
+                                     std::move(cmd->preparingStatement_))
+                    .isChanging = cmd->isChanging_;
                 cmd->preparingStatement_.clear();
                 continue;
             }
+            setResultFormat(cmd->sql_, res.get());
             auto r = makeResult(std::move(res));
             cmd->callback_(r);
             batchCommandsForWaitingResults_.pop_front();
@@ -511,11 +564,9 @@ void PgConnection::handleRead()
         auto &cmd = batchSqlCommands_.front();
         if (!cmd->preparingStatement_.empty())
         {
-            auto r = preparedStatements_.insert(
-                std::string{cmd->sql_.data(), cmd->sql_.length()});
-            preparedStatementsMap_[std::string_view{r.first->c_str(),
-                                                    r.first->length()}] = {
-                std::move(cmd->preparingStatement_), cmd->isChanging_};
+            setPreparedStatement(cmd->sql_,
+                                 std::move(cmd->preparingStatement_))
+                .isChanging = cmd->isChanging_;
             cmd->preparingStatement_.clear();
             continue;
         }
@@ -526,6 +577,44 @@ void PgConnection::doAfterPreparing()
 {
 }
 
+bool PgConnection::sendDeallocations()
+{
+    if (deallocations_.empty())
+        return false;
+    for (auto &name : deallocations_)
+    {
+        auto sql = "deallocate \"" + name + "\"";
+        if (PQsendQueryParams(connectionPtr_.get(),
+                              sql.c_str(),
+                              0,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              0) == 0)
+        {
+            LOG_ERROR << "send query error: "
+                      << PQerrorMessage(connectionPtr_.get());
+            break;
+        }
+        batchCommandsForWaitingResults_.push_back(std::make_shared<SqlCmd>(
+            std::string_view{},
+            0,
+            std::vector<const char *>{},
+            std::vector<int>{},
+            std::vector<int>{},
+            [](const Result &) {},
+            [](const std::exception_ptr &) {}));
+    }
+    deallocations_.clear();
+    if (batchCommandsForWaitingResults_.empty())
+        return false;
+    // The connection is closed if the sync fails.
+    if (sendBatchEnd())
+        flush();
+    return true;
+}
+
 void PgConnection::handleFatalError(bool clearAll, bool isAbortPipeline)
 {
     std::string errmsg =
@@ -58,12 +58,14 @@ int PgConnection::flush()
 
 PgConnection::PgConnection(trantor::EventLoop *loop,
                            const std::string &connInfo,
-                           bool)
+                           bool,
+                           PgConnectionOptions options)
     : DbConnection(loop),
       connectionPtr_(
           std::shared_ptr<PGconn>(PQconnectStart(connInfo.c_str()),
                                   [](PGconn *conn) { PQfinish(conn); })),
-      channel_(loop, PQsocket(connectionPtr_.get()))
+      channel_(loop, PQsocket(connectionPtr_.get())),
+      options_(std::move(options))
 {
     if (channel_.fd() < 0)
     {
@@ -90,7 +92,11 @@ void PgConnection::init()
         {
             return;
         }
-        if (status_ != ConnectStatus::Ok)
+        if (status_ == ConnectStatus::PreparingStatements)
+        {
+            handleWarmupRead();
+        }
+        else if (status_ != ConnectStatus::Ok)
         {
             pgPoll();
         }
@@ -106,6 +112,8 @@ void PgConnection::init()
             if (ret == 0)
             {
                 channel_.disableWriting();
+                if (copyCmd_)
+                    sendCopyData();
                 return;
             }
             else if (ret < 0)
@@ -116,6 +124,10 @@ void PgConnection::init()
                 return;
             }
         }
+        else if (status_ == ConnectStatus::PreparingStatements)
+        {
+            flush();
+        }
         else
         {
             pgPoll();
@@ -133,6 +145,7 @@ void PgConnection::handleClosed()
     if (status_ == ConnectStatus::Bad)
         return;
     status_ = ConnectStatus::Bad;
+    failCopy();
 
     if (isWorking_)
     {
@@ -196,9 +209,9 @@ void PgConnection::pgPoll()
         case PGRES_POLLING_OK:
             if (status_ != ConnectStatus::Ok)
             {
-                status_ = ConnectStatus::Ok;
-                assert(okCallback_);
-                okCallback_(shared_from_this());
+                if (startWarmup())
+                    return;
+                onConnected();
             }
             if (!channel_.isReading())
                 channel_.enableReading();
@@ -213,6 +226,14 @@ void PgConnection::pgPoll()
     }
 }
 
+bool PgConnection::onConnected()
+{
+    status_ = ConnectStatus::Ok;
+    assert(okCallback_);
+    okCallback_(shared_from_this());
+    return true;
+}
+
 void PgConnection::execSqlInLoop(
     std::string_view &&sql,
     size_t paraNum,
@@ -223,6 +244,7 @@ void PgConnection::execSqlInLoop(
     std::function<void(const std::exception_ptr &)> &&exceptCallback)
 {
     LOG_TRACE << sql;
+    probeQuery(sql, rcb, exceptCallback);
     loop_->assertInLoopThread();
     assert(paraNum == parameters.size());
     assert(paraNum == length.size());
@@ -263,17 +285,18 @@ void PgConnection::execSqlInLoop(
     }
     else
     {
-        auto iter = preparedStatementsMap_.find(sql_);
-        if (iter != preparedStatementsMap_.end())
+        bool prepare{false};
+        auto statement = preparedStatement(sql_, prepare);
+        if (statement)
         {
             isPreparingStatement_ = false;
             if (PQsendQueryPrepared(connectionPtr_.get(),
-                                    iter->second.c_str(),
+                                    statement->name.c_str(),
                                     static_cast<int>(paraNum),
                                     parameters.data(),
                                     length.data(),
                                     format.data(),
-                                    0) == 0)
+                                    resultFormat(sql_)) == 0)
             {
                 LOG_ERROR << "send query error: "
                           << PQerrorMessage(connectionPtr_.get());
@@ -288,6 +311,31 @@ void PgConnection::execSqlInLoop(
                 return;
             }
         }
+        else if (!prepare)
+        {
+            // The query isn't executed often enough yet to be prepared.
+            isPreparingStatement_ = false;
+            if (PQsendQueryParams(connectionPtr_.get(),
+                                  sql_.data(),
+                                  static_cast<int>(paraNum),
+                                  nullptr,
+                                  parameters.data(),
+                                  length.data(),
+                                  format.data(),
+                                  resultFormat(sql_)) == 0)
+            {
+                LOG_ERROR << "send query error: "
+                          << PQerrorMessage(connectionPtr_.get());
+                if (isWorking_)
+                {
+                    isWorking_ = false;
+                    handleFatalError();
+                    callback_ = nullptr;
+                    idleCb_();
+                }
+                return;
+            }
+        }
         else
         {
             isPreparingStatement_ = true;
@@ -336,6 +384,11 @@ void PgConnection::handleRead()
         handleClosed();
         return;
     }
+    if (copyCmd_)
+    {
+        handleCopyRead();
+        return;
+    }
     if (PQisBusy(connectionPtr_.get()))
     {
         // need read more data from socket;
@@ -358,8 +411,10 @@ void PgConnection::handleRead()
         {
             if (isWorking_)
             {
-                if (!isPreparingStatement_)
+                // No callback waits for the deallocations.
+                if (!isPreparingStatement_ && callback_)
                 {
+                    setResultFormat(sql_, res.get());
                     auto r = makeResult(std::move(res));
                     callback_(r);
                     callback_ = nullptr;
@@ -374,7 +429,7 @@ void PgConnection::handleRead()
         {
             doAfterPreparing();
         }
-        else
+        else if (!sendDeallocations())
         {
             isWorking_ = false;
             isPreparingStatement_ = false;
@@ -395,17 +450,14 @@ void PgConnection::handleRead()
 void PgConnection::doAfterPreparing()
 {
     isPreparingStatement_ = false;
-    auto r = preparedStatements_.insert(std::string{sql_});
-    preparedStatementsMap_[std::string_view{r.first->data(),
-                                            r.first->length()}] =
-        statementName_;
+    setPreparedStatement(sql_, std::string{statementName_});
     if (PQsendQueryPrepared(connectionPtr_.get(),
                             statementName_.c_str(),
                             parametersNumber_,
                             parameters_.data(),
                             lengths_.data(),
                             formats_.data(),
-                            0) == 0)
+                            resultFormat(sql_)) == 0)
     {
         LOG_ERROR << "send query error: "
                   << PQerrorMessage(connectionPtr_.get());
@@ -437,3 +489,26 @@ void PgConnection::batchSql(std::deque<std::shared_ptr<SqlCmd>> &&)
 {
     assert(false);
 }
+
+bool PgConnection::sendDeallocations()
+{
+    if (deallocations_.empty())
+        return false;
+    std::string sql;
+    for (auto &name : deallocations_)
+    {
+        sql.append("deallocate \"").append(name).append("\";");
+    }
+    deallocations_.clear();
+    isPreparingStatement_ = false;
+    callback_ = nullptr;
+    exceptionCallback_ = nullptr;
+    if (PQsendQuery(connectionPtr_.get(), sql.c_str()) == 0)
+    {
+        LOG_ERROR << "send query error: "
+                  << PQerrorMessage(connectionPtr_.get());
+        return false;
+    }
+    flush();
+    return true;
+}
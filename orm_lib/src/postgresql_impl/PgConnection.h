@@ -26,7 +26,7 @@
 #include <functional>
 #include <iostream>
 #include <list>
-#include <set>
+#include <vector>
 
 namespace drogon
 {
@@ -43,7 +43,8 @@ class PgConnection : public DbConnection,
         std::function<void(const std::string &, const std::string &)>;
     PgConnection(trantor::EventLoop *loop,
                  const std::string &connInfo,
-                 bool autoBatch);
+                 bool autoBatch,
+                 PgConnectionOptions options = {});
 
     void init() override;
 
@@ -91,6 +92,15 @@ class PgConnection : public DbConnection,
 
     void batchSql(std::deque<std::shared_ptr<SqlCmd>> &&sqlCommands) override;
 
+    void execCopy(const std::shared_ptr<CopyCmd> &cmd) override;
+
+#if LIBPQ_SUPPORTS_BATCH_MODE
+    bool supportsPipelining() const override
+    {
+        return true;
+    }
+#endif
+
     void disconnect() override;
 
     const std::shared_ptr<PGconn> &pgConn() const
@@ -118,6 +128,9 @@ class PgConnection : public DbConnection,
     void handleRead();
     void pgPoll();
     void handleClosed();
+    // Called when the connection is established and the warmup statements
+    // are prepared, returns false if the connection is closed.
+    bool onConnected();
 
     void execSqlInLoop(
         std::string_view &&sql,
@@ -135,7 +148,6 @@ class PgConnection : public DbConnection,
     std::vector<int> formats_;
     int flush();
     void handleFatalError();
-    std::set<std::string> preparedStatements_;
     std::string_view sql_;
 #if LIBPQ_SUPPORTS_BATCH_MODE
     void handleFatalError(bool clearAll, bool isAbortPipeline = false);
@@ -146,11 +158,61 @@ class PgConnection : public DbConnection,
     bool sendBatchEnd_{false};
     bool autoBatch_{false};
     unsigned int batchCount_{0};
-    std::unordered_map<std::string_view, std::pair<std::string, bool>>
-        preparedStatementsMap_;
-#else
-    std::unordered_map<std::string_view, std::string> preparedStatementsMap_;
 #endif
+    // The statements executed on the connection, the most recently used
+    // first. Only the last ones are kept if the number is limited.
+    struct Statement
+    {
+        std::string sql;
+        // Empty until the statement is prepared.
+        std::string name;
+        unsigned int executions{0};
+        bool isChanging{false};
+        // The format of its results, binary once its last result had only
+        // columns of the types decoded by Field.
+        int resultFormat{0};
+    };
+    std::list<Statement> statements_;
+    std::unordered_map<std::string_view, std::list<Statement>::iterator>
+        statementsMap_;
+    // The names of the evicted statements, deallocated when the connection
+    // is not busy.
+    std::vector<std::string> deallocations_;
+    Statement &useStatement(std::string_view sql);
+    const Statement *preparedStatement(std::string_view sql, bool &prepare);
+    Statement &setPreparedStatement(std::string_view sql, std::string &&name);
+    bool sendDeallocations();
+    void setResultFormat(std::string_view sql, const PGresult *result);
+    // The warmup statements are prepared one after the other before the
+    // connection is ready, the ones which can't be prepared are skipped.
+    size_t warmupIndex_{0};
+    bool startWarmup();
+    void sendWarmupStatement();
+    void handleWarmupRead();
+    // The COPY command in progress, it has the connection to itself.
+    std::shared_ptr<CopyCmd> copyCmd_;
+    bool copyIn_{false};
+    bool copyOut_{false};
+    bool endSent_{false};
+    std::shared_ptr<PGresult> copyResult_;
+    std::string copyError_;
+    void execCopyInLoop(const std::shared_ptr<CopyCmd> &cmd);
+    void handleCopyRead();
+    void sendCopyData();
+    void finishCopy();
+    void failCopy();
+
+    PgConnectionOptions options_;
+
+    // The format of the results of a query requested from the server, 1 is
+    // binary. It's text until the types of the columns are known.
+    int resultFormat(std::string_view sql) const
+    {
+        if (!options_.binaryResults)
+            return 0;
+        auto iter = statementsMap_.find(sql);
+        return iter == statementsMap_.end() ? 0 : iter->second->resultFormat;
+    }
 
     MessageCallback messageCallback_;
 };
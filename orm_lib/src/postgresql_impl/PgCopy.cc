@@ -0,0 +1,283 @@
+/**
+ *
+ *  PgCopy.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "PgConnection.h"
+#include "PostgreSQLResultImpl.h"
+#include <drogon/orm/Exception.h>
+#include <trantor/utils/Logger.h>
+
+using namespace drogon::orm;
+
+// The COPY commands are shared by both implementations of the connection.
+// They use the simple query protocol, which the pipeline mode doesn't
+// allow, so the connection leaves this mode while a command is in progress.
+
+void PgConnection::execCopy(const std::shared_ptr<CopyCmd> &cmd)
+{
+    if (loop_->isInLoopThread())
+    {
+        execCopyInLoop(cmd);
+    }
+    else
+    {
+        loop_->queueInLoop([thisPtr = shared_from_this(), cmd]() {
+            thisPtr->execCopyInLoop(cmd);
+        });
+    }
+}
+
+void PgConnection::execCopyInLoop(const std::shared_ptr<CopyCmd> &cmd)
+{
+    loop_->assertInLoopThread();
+    LOG_TRACE << cmd->sql_;
+    if (status_ != ConnectStatus::Ok)
+    {
+        LOG_ERROR << "Connection is not ready";
+        cmd->exceptionCallback_(
+            std::make_exception_ptr(drogon::orm::BrokenConnection()));
+        return;
+    }
+    assert(!copyCmd_);
+    isWorking_ = true;
+    copyCmd_ = cmd;
+#if LIBPQ_SUPPORTS_BATCH_MODE
+    if (!PQexitPipelineMode(connectionPtr_.get()))
+    {
+        copyError_ = PQerrorMessage(connectionPtr_.get());
+        finishCopy();
+        return;
+    }
+#endif
+    if (!PQsendQuery(connectionPtr_.get(), cmd->sql_.c_str()))
+    {
+        copyError_ = PQerrorMessage(connectionPtr_.get());
+        finishCopy();
+        return;
+    }
+    flush();
+}
+
+void PgConnection::handleCopyRead()
+{
+    auto conn = connectionPtr_.get();
+    auto cmd = copyCmd_;
+    for (;;)
+    {
+        if (copyOut_)
+        {
+            char *data;
+            int len;
+            while ((len = PQgetCopyData(conn, &data, 1)) > 0)
+            {
+                if (cmd->dataCallback_)
+                    cmd->dataCallback_(std::string_view(data, len));
+                PQfreemem(data);
+            }
+            if (len == 0)
+            {
+                // need read more data from socket;
+                return;
+            }
+            // The data ended or failed, the result of the command follows.
+            copyOut_ = false;
+        }
+        if ((copyIn_ && !endSent_) || PQisBusy(conn))
+            return;
+        auto res = std::shared_ptr<PGresult>(PQgetResult(conn),
+                                             [](PGresult *p) { PQclear(p); });
+        if (!res)
+        {
+            finishCopy();
+            return;
+        }
+        auto type = PQresultStatus(res.get());
+        if (type == PGRES_COPY_IN)
+        {
+            copyIn_ = true;
+            cmd->loop_ = loop_;
+            cmd->sendCallback_ = [weakPtr = weak_from_this(),
+                                  weakCmd = std::weak_ptr<CopyCmd>(cmd)]() {
+                auto thisPtr = weakPtr.lock();
+                if (thisPtr && thisPtr->copyCmd_ &&
+                    thisPtr->copyCmd_ == weakCmd.lock())
+                    thisPtr->sendCopyData();
+            };
+            if (cmd->readyCallback_)
+            {
+                cmd->readyCallback_(cmd);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(cmd->mutex_);
+                cmd->aborted_ = true;
+                cmd->errorMessage_ = "COPY FROM STDIN requires copyIn()";
+            }
+            sendCopyData();
+            return;
+        }
+        if (type == PGRES_COPY_OUT)
+        {
+            copyOut_ = true;
+        }
+        else if (type == PGRES_BAD_RESPONSE || type == PGRES_FATAL_ERROR)
+        {
+            LOG_WARN << PQerrorMessage(conn);
+            copyError_ = PQresultErrorMessage(res.get());
+        }
+        else
+        {
+            copyResult_ = std::move(res);
+        }
+    }
+}
+
+void PgConnection::sendCopyData()
+{
+    loop_->assertInLoopThread();
+    if (!copyCmd_ || !copyIn_ || endSent_)
+        return;
+    auto conn = connectionPtr_.get();
+    auto &cmd = *copyCmd_;
+    bool blocked = false;
+    bool failed = false;
+    std::function<void()> drainCallback;
+    {
+        // Nothing calls back into the user code while the lock is held.
+        std::lock_guard<std::mutex> lock(cmd.mutex_);
+        cmd.sendQueued_ = false;
+        if (cmd.aborted_)
+        {
+            cmd.buffer_.clear();
+            cmd.pendingBytes_ = 0;
+        }
+        while (!cmd.buffer_.empty())
+        {
+            auto &data = cmd.buffer_.front();
+            auto ret = PQputCopyData(conn, data.data(), (int)data.size());
+            if (ret == 0)
+            {
+                blocked = true;
+                break;
+            }
+            if (ret < 0)
+            {
+                failed = true;
+                break;
+            }
+            cmd.pendingBytes_ -= data.size();
+            cmd.buffer_.pop_front();
+            // libpq buffers all the data it is given, the rest waits until
+            // the socket accepts what is already buffered.
+            ret = PQflush(conn);
+            if (ret != 0)
+            {
+                blocked = ret > 0;
+                failed = ret < 0;
+                break;
+            }
+        }
+        if (!blocked && !failed && cmd.buffer_.empty())
+        {
+            if (cmd.finished_ || cmd.aborted_)
+            {
+                auto ret = PQputCopyEnd(
+                    conn, cmd.aborted_ ? cmd.errorMessage_.c_str() : nullptr);
+                endSent_ = ret > 0;
+                blocked = ret == 0;
+                failed = ret < 0;
+            }
+            else
+            {
+                drainCallback = cmd.drainCallback_;
+            }
+        }
+    }
+    if (failed)
+    {
+        LOG_ERROR << "Failed to send the COPY data:" << PQerrorMessage(conn);
+        handleClosed();
+        return;
+    }
+    if (blocked)
+    {
+        if (!channel_.isWriting())
+            channel_.enableWriting();
+        return;
+    }
+    flush();
+    if (drainCallback)
+        drainCallback();
+    if (endSent_)
+    {
+        // The result may have arrived with the data read before.
+        handleCopyRead();
+    }
+}
+
+void PgConnection::finishCopy()
+{
+    auto cmd = std::move(copyCmd_);
+    copyIn_ = false;
+    copyOut_ = false;
+    endSent_ = false;
+    auto result = std::move(copyResult_);
+    auto error = std::move(copyError_);
+    copyError_.clear();
+    // The callbacks may hold the transaction, which is released after them.
+    auto callback = std::move(cmd->callback_);
+    auto exceptionCallback = std::move(cmd->exceptionCallback_);
+    cmd->readyCallback_ = nullptr;
+    cmd->dataCallback_ = nullptr;
+    isWorking_ = false;
+#if LIBPQ_SUPPORTS_BATCH_MODE
+    if (!PQenterPipelineMode(connectionPtr_.get()))
+    {
+        exceptionCallback(std::make_exception_ptr(
+            Failure(PQerrorMessage(connectionPtr_.get()))));
+        handleClosed();
+        return;
+    }
+#endif
+    if (error.empty() && !result)
+        error = "No result of the COPY command";
+    if (error.empty())
+    {
+        callback(
+            Result(std::make_shared<PostgreSQLResultImpl>(std::move(result))));
+    }
+    else
+    {
+        exceptionCallback(std::make_exception_ptr(Failure(error)));
+    }
+    idleCb_();
+}
+
+void PgConnection::failCopy()
+{
+    if (!copyCmd_)
+        return;
+    auto cmd = std::move(copyCmd_);
+    copyIn_ = false;
+    copyOut_ = false;
+    endSent_ = false;
+    copyResult_.reset();
+    copyError_.clear();
+    auto exceptionCallback = std::move(cmd->exceptionCallback_);
+    cmd->callback_ = nullptr;
+    cmd->readyCallback_ = nullptr;
+    cmd->dataCallback_ = nullptr;
+    isWorking_ = false;
+    exceptionCallback(
+        std::make_exception_ptr(drogon::orm::BrokenConnection()));
+}
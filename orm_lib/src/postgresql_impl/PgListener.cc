@@ -14,12 +14,14 @@
 
 #include "PgListener.h"
 #include "PgConnection.h"
+#include <algorithm>
 
 using namespace drogon;
 using namespace drogon::orm;
 
 #define MAX_UNLISTEN_RETRY 3
 #define MAX_LISTEN_RETRY 10
+#define MAX_LISTEN_BATCH 100
 
 PgListener::PgListener(std::string connInfo, trantor::EventLoop *loop)
     : connectionInfo_(std::move(connInfo)), loop_(loop)
@@ -59,25 +61,47 @@ void PgListener::listen(
     const std::string &channel,
     std::function<void(std::string, std::string)> messageCallback) noexcept
 {
+    subscribe(channel, std::move(messageCallback), nullptr);
+}
+
+uint64_t PgListener::subscribe(const std::string &channel,
+                               MessageCallback messageCallback,
+                               trantor::EventLoop *loop) noexcept
+{
+    Subscriber subscriber{nextSubscriptionId_++,
+                          std::move(messageCallback),
+                          loop == loop_ ? nullptr : loop};
+    auto id = subscriber.id;
     if (loop_->isInLoopThread())
     {
-        listenChannels_[channel].push_back(std::move(messageCallback));
-        listenInLoop(channel, true);
+        subscribeInLoop(channel, std::move(subscriber));
     }
     else
     {
         std::weak_ptr<PgListener> weakThis = shared_from_this();
         loop_->queueInLoop(
-            [weakThis, channel, cb = std::move(messageCallback)]() mutable {
+            [weakThis, channel, subscriber = std::move(subscriber)]() mutable {
                 auto thisPtr = weakThis.lock();
                 if (!thisPtr)
                 {
                     return;
                 }
-                thisPtr->listenChannels_[channel].push_back(std::move(cb));
-                thisPtr->listenInLoop(channel, true);
+                thisPtr->subscribeInLoop(channel, std::move(subscriber));
             });
     }
+    return id;
+}
+
+void PgListener::subscribeInLoop(const std::string &channel,
+                                 Subscriber &&subscriber)
+{
+    auto &subscribers = listenChannels_[channel];
+    subscribers.push_back(std::move(subscriber));
+    // The channel is already listened to for the other subscribers.
+    if (subscribers.size() == 1)
+    {
+        listenInLoop(channel, true);
+    }
 }
 
 void PgListener::unlisten(const std::string &channel) noexcept
@@ -102,6 +126,48 @@ void PgListener::unlisten(const std::string &channel) noexcept
     }
 }
 
+void PgListener::unsubscribe(const std::string &channel,
+                             uint64_t subscriptionId) noexcept
+{
+    if (loop_->isInLoopThread())
+    {
+        unsubscribeInLoop(channel, subscriptionId);
+    }
+    else
+    {
+        std::weak_ptr<PgListener> weakThis = shared_from_this();
+        loop_->queueInLoop([weakThis, channel, subscriptionId]() {
+            auto thisPtr = weakThis.lock();
+            if (!thisPtr)
+            {
+                return;
+            }
+            thisPtr->unsubscribeInLoop(channel, subscriptionId);
+        });
+    }
+}
+
+void PgListener::unsubscribeInLoop(const std::string &channel, uint64_t id)
+{
+    auto iter = listenChannels_.find(channel);
+    if (iter == listenChannels_.end())
+    {
+        return;
+    }
+    auto &subscribers = iter->second;
+    subscribers.erase(std::remove_if(subscribers.begin(),
+                                     subscribers.end(),
+                                     [id](const Subscriber &subscriber) {
+                                         return subscriber.id == id;
+                                     }),
+                      subscribers.end());
+    if (subscribers.empty())
+    {
+        listenChannels_.erase(iter);
+        listenInLoop(channel, false);
+    }
+}
+
 void PgListener::onMessage(const std::string &channel,
                            const std::string &message) const noexcept
 {
@@ -112,9 +178,19 @@ void PgListener::onMessage(const std::string &channel,
     {
         return;
     }
-    for (auto &cb : iter->second)
+    for (auto &subscriber : iter->second)
     {
-        cb(channel, message);
+        if (!subscriber.loop)
+        {
+            subscriber.callback(channel, message);
+            continue;
+        }
+        // Handed to the loop of the subscriber through its task queue, the
+        // callbacks don't share any state.
+        subscriber.loop->queueInLoop(
+            [callback = subscriber.callback, channel, message]() {
+                callback(channel, message);
+            });
     }
 }
 
@@ -138,11 +214,84 @@ void PgListener::listenNext() noexcept
     {
         return;
     }
+    if (listenTasks_.size() > 1)
+    {
+        listenBatch();
+        return;
+    }
     auto [listen, channel] = listenTasks_.front();
     listenTasks_.pop_front();
     listenInLoop(channel, listen);
 }
 
+void PgListener::listenBatch()
+{
+    if (!conn_ || conn_->isWorking())
+    {
+        return;
+    }
+    auto pgConn = std::dynamic_pointer_cast<PgConnection>(conn_);
+    // A DO block is one statement, which can be sent by the batch mode
+    // connections too.
+    auto sql = std::make_shared<std::string>("DO $drogon$BEGIN ");
+    std::vector<std::pair<bool, std::string>> tasks;
+    while (!listenTasks_.empty() && tasks.size() < MAX_LISTEN_BATCH)
+    {
+        auto task = std::move(listenTasks_.front());
+        listenTasks_.pop_front();
+        std::string escapedChannel = escapeIdentifier(pgConn,
+                                                      task.second.c_str(),
+                                                      task.second.size());
+        if (escapedChannel.empty() ||
+            escapedChannel.find("$drogon$") != std::string::npos)
+        {
+            LOG_ERROR << "Failed to escape pg identifier, stop listen";
+            continue;
+        }
+        sql->append(task.first ? "LISTEN " : "UNLISTEN ");
+        sql->append(escapedChannel);
+        sql->append("; ");
+        tasks.push_back(std::move(task));
+    }
+    if (tasks.empty())
+    {
+        listenNext();
+        return;
+    }
+    sql->append("END$drogon$");
+    std::weak_ptr<PgListener> weakThis = shared_from_this();
+    conn_->execSql(
+        *sql,
+        0,
+        {},
+        {},
+        {},
+        [sql, count = tasks.size()](const Result &) {
+            LOG_TRACE << "Listen or unlisten " << count << " channels";
+        },
+        [weakThis, sql, tasks](const std::exception_ptr &exception) {
+            try
+            {
+                std::rethrow_exception(exception);
+            }
+            catch (const DrogonDbException &ex)
+            {
+                LOG_ERROR << "Failed to listen or unlisten " << tasks.size()
+                          << " channels, error: " << ex.base().what();
+            }
+            auto thisPtr = weakThis.lock();
+            if (!thisPtr)
+            {
+                return;
+            }
+            // Retried one by one, so a bad channel doesn't fail the others.
+            for (auto &[listen, channel] : tasks)
+            {
+                thisPtr->listenInLoop(channel, listen);
+            }
+        });
+}
+
 void PgListener::listenInLoop(const std::string &channel,
                               bool listen,
                               std::shared_ptr<unsigned int> retryCnt)
@@ -16,6 +16,7 @@
 
 #include <drogon/orm/DbListener.h>
 #include <trantor/net/EventLoopThread.h>
+#include <atomic>
 #include <deque>
 #include <mutex>
 #include <string>
@@ -42,6 +43,11 @@ class PgListener : public DbListener,
     void listen(const std::string &channel,
                 MessageCallback messageCallback) noexcept override;
     void unlisten(const std::string &channel) noexcept override;
+    uint64_t subscribe(const std::string &channel,
+                       MessageCallback messageCallback,
+                       trantor::EventLoop *loop) noexcept override;
+    void unsubscribe(const std::string &channel,
+                     uint64_t subscriptionId) noexcept override;
 
     // methods below should be called in loop
 
@@ -71,9 +77,21 @@ class PgListener : public DbListener,
                                         const char *str,
                                         size_t length);
 
+    struct Subscriber
+    {
+        uint64_t id;
+        MessageCallback callback;
+        // Null for the loop of the listener
+        trantor::EventLoop *loop;
+    };
+
+    void subscribeInLoop(const std::string &channel, Subscriber &&subscriber);
+    void unsubscribeInLoop(const std::string &channel, uint64_t id);
     void listenInLoop(const std::string &channel,
                       bool listen,
                       std::shared_ptr<unsigned int> = nullptr);
+    // Send the queued LISTEN and UNLISTEN commands in one statement.
+    void listenBatch();
 
     PgConnectionPtr newConnection(std::shared_ptr<unsigned int> = nullptr);
 
@@ -83,8 +101,8 @@ class PgListener : public DbListener,
     DbConnectionPtr connHolder_;
     DbConnectionPtr conn_;
     std::deque<std::pair<bool, std::string>> listenTasks_;
-    std::unordered_map<std::string, std::vector<MessageCallback>>
-        listenChannels_;
+    std::unordered_map<std::string, std::vector<Subscriber>> listenChannels_;
+    std::atomic<uint64_t> nextSubscriptionId_{1};
 };
 
 }  // namespace orm
@@ -0,0 +1,206 @@
+/**
+ *
+ *  PgStatements.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "PgConnection.h"
+
+using namespace drogon::orm;
+
+// The cache of the statements is shared by both implementations of the
+// connection. The names of the evicted statements are sent back to the server
+// by each implementation once the connection is idle.
+
+PgConnection::Statement &PgConnection::useStatement(std::string_view sql)
+{
+    auto iter = statementsMap_.find(sql);
+    if (iter != statementsMap_.end())
+    {
+        statements_.splice(statements_.begin(), statements_, iter->second);
+        return statements_.front();
+    }
+    statements_.emplace_front();
+    auto &statement = statements_.front();
+    statement.sql = std::string{sql};
+    statementsMap_.emplace(std::string_view{statement.sql},
+                           statements_.begin());
+    auto maxStatements = options_.maxPreparedStatements;
+    while (maxStatements > 0 && statements_.size() > maxStatements)
+    {
+        auto &last = statements_.back();
+        if (!last.name.empty())
+        {
+            deallocations_.emplace_back(std::move(last.name));
+            if (options_.stats)
+                ++options_.stats->evictions;
+        }
+        statementsMap_.erase(last.sql);
+        statements_.pop_back();
+    }
+    return statement;
+}
+
+const PgConnection::Statement *PgConnection::preparedStatement(
+    std::string_view sql,
+    bool &prepare)
+{
+    auto &statement = useStatement(sql);
+    if (!statement.name.empty())
+    {
+        if (options_.stats)
+            ++options_.stats->hits;
+        prepare = false;
+        return &statement;
+    }
+    if (options_.stats)
+        ++options_.stats->misses;
+    prepare = ++statement.executions >= options_.prepareThreshold;
+    return nullptr;
+}
+
+PgConnection::Statement &PgConnection::setPreparedStatement(
+    std::string_view sql,
+    std::string &&name)
+{
+    auto &statement = useStatement(sql);
+    if (!statement.name.empty())
+    {
+        // The statement was prepared twice by queries in the same pipeline.
+        deallocations_.emplace_back(std::move(statement.name));
+    }
+    statement.name = std::move(name);
+    return statement;
+}
+
+// The types whose binary format is decoded by Field, the others are received
+// in text. timestamptz is one of them since its text follows the time zone of
+// the session.
+static bool hasBinaryDecoder(Oid type)
+{
+    switch (type)
+    {
+        case 16:    // bool
+        case 17:    // bytea
+        case 18:    // char
+        case 19:    // name
+        case 20:    // int8
+        case 21:    // int2
+        case 23:    // int4
+        case 25:    // text
+        case 26:    // oid
+        case 114:   // json
+        case 700:   // float4
+        case 701:   // float8
+        case 1042:  // bpchar
+        case 1043:  // varchar
+        case 1082:  // date
+        case 1083:  // time
+        case 1114:  // timestamp
+        case 1700:  // numeric
+        case 2950:  // uuid
+        case 3802:  // jsonb
+            return true;
+        default:
+            return false;
+    }
+}
+
+void PgConnection::setResultFormat(std::string_view sql,
+                                   const PGresult *result)
+{
+    if (!options_.binaryResults)
+        return;
+    auto iter = statementsMap_.find(sql);
+    if (iter == statementsMap_.end())
+        return;
+    // libpq requests the same format for all the columns, so the binary one
+    // is only used when all of them can be decoded.
+    int format = 1;
+    for (int i = 0; i < PQnfields(result); ++i)
+    {
+        if (!hasBinaryDecoder(PQftype(result, i)))
+        {
+            format = 0;
+            break;
+        }
+    }
+    iter->second->resultFormat = format;
+}
+
+bool PgConnection::startWarmup()
+{
+    if (!warmupStatements_ || warmupStatements_->empty())
+        return false;
+    status_ = ConnectStatus::PreparingStatements;
+    warmupIndex_ = 0;
+    sendWarmupStatement();
+    return true;
+}
+
+void PgConnection::sendWarmupStatement()
+{
+    if (warmupIndex_ == warmupStatements_->size())
+    {
+        if (onConnected())
+        {
+            if (!channel_.isReading())
+                channel_.enableReading();
+            if (channel_.isWriting())
+                channel_.disableWriting();
+        }
+        return;
+    }
+    auto &sql = (*warmupStatements_)[warmupIndex_];
+    statementName_ = newStmtName();
+    if (PQsendPrepare(connectionPtr_.get(),
+                      statementName_.c_str(),
+                      sql.c_str(),
+                      0,
+                      nullptr) == 0)
+    {
+        LOG_ERROR << "send query error: "
+                  << PQerrorMessage(connectionPtr_.get());
+        handleClosed();
+        return;
+    }
+    flush();
+}
+
+void PgConnection::handleWarmupRead()
+{
+    if (!PQconsumeInput(connectionPtr_.get()))
+    {
+        LOG_ERROR << "Failed to consume pg input:"
+                  << PQerrorMessage(connectionPtr_.get());
+        handleClosed();
+        return;
+    }
+    if (PQisBusy(connectionPtr_.get()))
+        return;
+    auto &sql = (*warmupStatements_)[warmupIndex_];
+    std::shared_ptr<PGresult> res;
+    while ((res = std::shared_ptr<PGresult>(PQgetResult(connectionPtr_.get()),
+                                            [](PGresult *p) { PQclear(p); })))
+    {
+        if (PQresultStatus(res.get()) == PGRES_COMMAND_OK)
+        {
+            setPreparedStatement(sql, std::move(statementName_));
+        }
+        else
+        {
+            LOG_WARN << "Failed to prepare the warmup statement " << sql
+                     << ": " << PQresultErrorMessage(res.get());
+        }
+    }
+    ++warmupIndex_;
+    sendWarmupStatement();
+}
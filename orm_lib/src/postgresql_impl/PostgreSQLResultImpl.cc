@@ -81,7 +81,29 @@ Result::FieldSizeType PostgreSQLResultImpl::getLength(SizeType row,
     return PQgetlength(result_.get(), int(row), int(column));
 }
 
+void PostgreSQLResultImpl::getColumn(
+    RowSizeType column,
+    std::vector<std::string_view> &values) const
+{
+    auto ptr = result_.get();
+    auto rows = size();
+    values.reserve(values.size() + rows);
+    for (int row = 0; row < (int)rows; ++row)
+    {
+        if (PQgetisnull(ptr, row, int(column)))
+            values.emplace_back();
+        else
+            values.emplace_back(PQgetvalue(ptr, row, int(column)),
+                                PQgetlength(ptr, row, int(column)));
+    }
+}
+
 int PostgreSQLResultImpl::oid(RowSizeType column) const
 {
     return PQftype(result_.get(), (int)column);
 }
+
+bool PostgreSQLResultImpl::isBinary(RowSizeType column) const noexcept
+{
+    return PQfformat(result_.get(), (int)column) == 1;
+}
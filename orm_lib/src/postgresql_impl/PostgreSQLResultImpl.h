@@ -40,7 +40,10 @@ class PostgreSQLResultImpl : public ResultImpl
     const char *getValue(SizeType row, RowSizeType column) const override;
     bool isNull(SizeType row, RowSizeType column) const override;
     FieldSizeType getLength(SizeType row, RowSizeType column) const override;
+    void getColumn(RowSizeType column,
+                   std::vector<std::string_view> &values) const override;
     int oid(RowSizeType column) const override;
+    bool isBinary(RowSizeType column) const noexcept override;
 
   private:
     std::shared_ptr<PGresult> result_;
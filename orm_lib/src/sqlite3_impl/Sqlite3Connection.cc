@@ -16,6 +16,9 @@
 #include "Sqlite3ResultImpl.h"
 #include <drogon/orm/Exception.h>
 #include <drogon/utils/Utilities.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -29,8 +32,44 @@ using namespace drogon::orm;
 
 namespace
 {
+// The file name in a URI filename, see https://www.sqlite.org/uri.html
+std::string fileUri(const std::string &filename)
+{
+    std::string uri{"file:"};
+    for (char c : filename)
+    {
+        if (c == '?' || c == '#' || c == '%')
+        {
+            char buf[4];
+            snprintf(buf, sizeof(buf), "%%%02X", (unsigned char)c);
+            uri += buf;
+        }
+        else
+        {
+            uri += c;
+        }
+    }
+    return uri;
+}
+
+bool isInteger(const std::string &value)
+{
+    size_t i = (!value.empty() && value[0] == '-') ? 1 : 0;
+    return i < value.size() &&
+           std::all_of(value.begin() + i, value.end(), [](unsigned char c) {
+               return isdigit(c);
+           });
+}
 
+std::string lowerCase(std::string value)
+{
+    std::transform(value.begin(),
+                   value.end(),
+                   value.begin(),
+                   [](unsigned char c) { return tolower(c); });
+    return value;
 }
+}  // namespace
 
 std::once_flag Sqlite3Connection::once_;
 
@@ -100,6 +139,8 @@ void Sqlite3Connection::init()
     // Get the key and value
     auto connParams = parseConnString(connInfo_);
     std::string filename;
+    std::string journalMode;
+    int busyTimeout = 0;
     for (auto const &kv : connParams)
     {
         auto key = kv.first;
@@ -112,10 +153,53 @@ void Sqlite3Connection::init()
         {
             filename = value;
         }
+        else if (key == "journal_mode")
+        {
+            journalMode = value;
+        }
+        else if (key == "busy_timeout")
+        {
+            busyTimeout = atoi(value.c_str());
+        }
+        else if (key == "mmap_size")
+        {
+            mmapSize_ = value;
+        }
+        else if (key == "cache_size")
+        {
+            cacheSize_ = value;
+        }
+        else if (key == "synchronous")
+        {
+            synchronous_ = lowerCase(value);
+        }
+        else if (key == "temp_store")
+        {
+            tempStore_ = lowerCase(value);
+        }
+        else if (key == "immutable")
+        {
+            immutable_ = value == "1" || lowerCase(value) == "true";
+        }
+        else if (key == "max_prepared_statements")
+        {
+            maxPreparedStatements_ = strtoull(value.c_str(), nullptr, 10);
+        }
     }
-    loop_->runInLoop([this, filename = std::move(filename)]() {
+    loop_->runInLoop([this,
+                      filename = std::move(filename),
+                      journalMode = std::move(journalMode),
+                      busyTimeout]() {
         sqlite3 *tmp = nullptr;
-        auto ret = sqlite3_open(filename.data(), &tmp);
+        // The immutable databases aren't locked nor checked for changes,
+        // they must not be modified while they are open.
+        auto ret =
+            immutable_
+                ? sqlite3_open_v2((fileUri(filename) + "?immutable=1").c_str(),
+                                  &tmp,
+                                  SQLITE_OPEN_READONLY | SQLITE_OPEN_URI,
+                                  nullptr)
+                : sqlite3_open(filename.data(), &tmp);
         connectionPtr_ = std::shared_ptr<sqlite3>(tmp, [](sqlite3 *ptr) {
             sqlite3_close(ptr);
         });
@@ -128,12 +212,159 @@ void Sqlite3Connection::init()
         else
         {
             sqlite3_extended_result_codes(tmp, true);
+            if (busyTimeout > 0)
+                sqlite3_busy_timeout(tmp, busyTimeout);
+            if (!setJournalMode(journalMode))
+            {
+                LOG_ERROR << "Failed to set the journal mode: "
+                          << sqlite3_errmsg(tmp);
+                closeCallback_(thisPtr);
+                return;
+            }
+            if (!setPragmas())
+            {
+                closeCallback_(thisPtr);
+                return;
+            }
             status_ = ConnectStatus::Ok;
             okCallback_(thisPtr);
         }
     });
 }
 
+bool Sqlite3Connection::setJournalMode(const std::string &journalMode)
+{
+    static const std::set<std::string> journalModes{
+        "delete", "truncate", "persist", "memory", "wal", "off"};
+    std::string sql = "pragma journal_mode";
+    if (!journalMode.empty())
+    {
+        std::string mode = journalMode;
+        std::transform(mode.begin(),
+                       mode.end(),
+                       mode.begin(),
+                       [](unsigned char c) { return tolower(c); });
+        if (journalModes.find(mode) == journalModes.end())
+        {
+            LOG_ERROR << "Unknown journal mode: " << journalMode;
+            return false;
+        }
+        sql += "=" + mode;
+    }
+    // The mode is returned, which is the one of the database if it's
+    // persistent or the database doesn't support the new one.
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(
+            connectionPtr_.get(), sql.c_str(), -1, &stmt, nullptr) !=
+        SQLITE_OK)
+        return false;
+    std::string mode;
+    auto ret = sqlite3_step(stmt);
+    if (ret == SQLITE_ROW)
+    {
+        mode = (const char *)sqlite3_column_text(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    if (ret != SQLITE_ROW)
+        return false;
+    walMode_ = mode == "wal";
+    if (walMode_)
+    {
+        // The commits don't wait for the WAL to be synced to the disk, the
+        // last ones may be lost by a power failure but the database stays
+        // consistent.
+        return sqlite3_exec(connectionPtr_.get(),
+                            "pragma synchronous=normal",
+                            nullptr,
+                            nullptr,
+                            nullptr) == SQLITE_OK;
+    }
+    return true;
+}
+
+bool Sqlite3Connection::setPragmas()
+{
+    static const std::set<std::string> synchronousValues{
+        "off", "normal", "full", "extra", "0", "1", "2", "3"};
+    static const std::set<std::string> tempStoreValues{
+        "default", "file", "memory", "0", "1", "2"};
+    std::string sql;
+    if (!mmapSize_.empty())
+    {
+        if (!isInteger(mmapSize_))
+        {
+            LOG_ERROR << "Invalid mmap_size: " << mmapSize_;
+            return false;
+        }
+        sql += "pragma mmap_size=" + mmapSize_ + ";";
+    }
+    if (!cacheSize_.empty())
+    {
+        if (!isInteger(cacheSize_))
+        {
+            LOG_ERROR << "Invalid cache_size: " << cacheSize_;
+            return false;
+        }
+        sql += "pragma cache_size=" + cacheSize_ + ";";
+    }
+    if (!synchronous_.empty())
+    {
+        // Overrides the normal mode set with the WAL mode.
+        if (synchronousValues.find(synchronous_) == synchronousValues.end())
+        {
+            LOG_ERROR << "Invalid synchronous mode: " << synchronous_;
+            return false;
+        }
+        sql += "pragma synchronous=" + synchronous_ + ";";
+    }
+    if (!tempStore_.empty())
+    {
+        if (tempStoreValues.find(tempStore_) == tempStoreValues.end())
+        {
+            LOG_ERROR << "Invalid temp_store: " << tempStore_;
+            return false;
+        }
+        sql += "pragma temp_store=" + tempStore_ + ";";
+    }
+    if (sql.empty())
+        return true;
+    if (sqlite3_exec(connectionPtr_.get(),
+                     sql.c_str(),
+                     nullptr,
+                     nullptr,
+                     nullptr) != SQLITE_OK)
+    {
+        LOG_ERROR << "Failed to set the pragmas: "
+                  << sqlite3_errmsg(connectionPtr_.get());
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<sqlite3_stmt> Sqlite3Connection::findStatement(
+    std::string_view sql)
+{
+    auto iter = stmtsMap_.find(sql);
+    if (iter == stmtsMap_.end())
+        return nullptr;
+    stmts_.splice(stmts_.begin(), stmts_, iter->second.lruPos);
+    return iter->second.stmtPtr;
+}
+
+void Sqlite3Connection::cacheStatement(
+    std::string_view sql,
+    const std::shared_ptr<sqlite3_stmt> &stmtPtr)
+{
+    stmts_.emplace_front(sql);
+    stmtsMap_[std::string_view{stmts_.front()}] = {stmtPtr, stmts_.begin()};
+    if (maxPreparedStatements_ > 0 && stmts_.size() > maxPreparedStatements_)
+    {
+        // The least recently used one
+        stmtsMap_.erase(std::string_view{stmts_.back()});
+        stmts_.pop_back();
+    }
+}
+
 void Sqlite3Connection::execSql(
     std::string_view &&sql,
     size_t paraNum,
@@ -143,6 +374,7 @@ void Sqlite3Connection::execSql(
     ResultCallback &&rcb,
     std::function<void(const std::exception_ptr &)> &&exceptCallback)
 {
+    probeQuery(sql, rcb, exceptCallback);
     auto thisPtr = shared_from_this();
     loopThread_.getLoop()->queueInLoop(
         [thisPtr,
@@ -178,21 +410,28 @@ void Sqlite3Connection::execSqlInQueue(
     }
     std::shared_ptr<sqlite3_stmt> stmtPtr;
     bool newStmt = false;
-    if (paraNum > 0)
+    bool cached = paraNum > 0 || maxPreparedStatements_ > 0;
+    if (cached)
     {
-        auto iter = stmtsMap_.find(sql);
-        if (iter != stmtsMap_.end())
-        {
-            stmtPtr = iter->second;
-        }
+        stmtPtr = findStatement(sql);
     }
     if (!stmtPtr)
     {
         sqlite3_stmt *stmt = nullptr;
         newStmt = true;
         const char *remaining;
+#if SQLITE_VERSION_NUMBER >= 3020000
+        // The cached statements are kept for long.
+        auto ret = sqlite3_prepare_v3(connectionPtr_.get(),
+                                      sql.data(),
+                                      -1,
+                                      cached ? SQLITE_PREPARE_PERSISTENT : 0,
+                                      &stmt,
+                                      &remaining);
+#else
         auto ret = sqlite3_prepare_v2(
             connectionPtr_.get(), sql.data(), -1, &stmt, &remaining);
+#endif
         stmtPtr = stmt ? std::shared_ptr<sqlite3_stmt>(stmt,
                                                        [](sqlite3_stmt *p) {
                                                            sqlite3_finalize(p);
@@ -282,7 +521,16 @@ void Sqlite3Connection::execSqlInQueue(
         resultPtr->columnNamesMap_.insert({name, i});
     }
 
-    if (sqlite3_stmt_readonly(stmt))
+    if (sqlite3_stmt_readonly(stmt) && (walMode_ || immutable_))
+    {
+        r = stmtStep(stmt, resultPtr, columnNum);
+        if (r != SQLITE_DONE)
+        {
+            er = sqlite3_extended_errcode(connectionPtr_.get());
+        }
+        sqlite3_reset(stmt);
+    }
+    else if (sqlite3_stmt_readonly(stmt))
     {
         // Readonly, hold read lock;
         std::shared_lock<SharedMutex> lock(*sharedMutexPtr_);
@@ -318,11 +566,9 @@ void Sqlite3Connection::execSqlInQueue(
         idleCb_();
         return;
     }
-    if (paraNum > 0 && newStmt)
+    if (cached && newStmt)
     {
-        auto r = stmts_.insert(std::string{sql});
-        stmtsMap_[std::string_view{r.first->data(), r.first->length()}] =
-            stmtPtr;
+        cacheStatement(sql, stmtPtr);
     }
     rcb(Result(std::move(resultPtr)));
     idleCb_();
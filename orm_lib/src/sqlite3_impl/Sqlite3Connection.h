@@ -23,6 +23,7 @@
 #include <sqlite3.h>
 #include <functional>
 #include <iostream>
+#include <list>
 #include <memory>
 #include <shared_mutex>
 #include <string>
@@ -80,13 +81,38 @@ class Sqlite3Connection : public DbConnection,
     int stmtStep(sqlite3_stmt *stmt,
                  const std::shared_ptr<Sqlite3ResultImpl> &resultPtr,
                  int columnNum);
+    bool setJournalMode(const std::string &journalMode);
+    bool setPragmas();
+    std::shared_ptr<sqlite3_stmt> findStatement(std::string_view sql);
+    void cacheStatement(std::string_view sql,
+                        const std::shared_ptr<sqlite3_stmt> &stmtPtr);
     trantor::EventLoopThread loopThread_;
     std::shared_ptr<sqlite3> connectionPtr_;
     std::shared_ptr<SharedMutex> sharedMutexPtr_;
-    std::unordered_map<std::string_view, std::shared_ptr<sqlite3_stmt>>
-        stmtsMap_;
-    std::set<std::string> stmts_;
+    struct CachedStatement
+    {
+        std::shared_ptr<sqlite3_stmt> stmtPtr;
+        std::list<std::string>::iterator lruPos;
+    };
+    // The statements by their sql, the most recently used ones first in the
+    // list.
+    std::unordered_map<std::string_view, CachedStatement> stmtsMap_;
+    std::list<std::string> stmts_;
+    // 0 for no limit, the statements without parameters are only cached
+    // when there is a limit.
+    size_t maxPreparedStatements_{0};
     std::string connInfo_;
+    // The pragmas set when the database is opened, empty to keep the
+    // defaults.
+    std::string mmapSize_;
+    std::string cacheSize_;
+    std::string synchronous_;
+    std::string tempStore_;
+    // In the WAL mode, the readers see a snapshot of the database and don't
+    // take the lock, which only serializes the writers of the client. An
+    // immutable database is opened read-only and never locked.
+    bool walMode_{false};
+    bool immutable_{false};
 };
 
 }  // namespace orm
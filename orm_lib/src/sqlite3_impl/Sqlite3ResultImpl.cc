@@ -72,6 +72,20 @@ Result::FieldSizeType Sqlite3ResultImpl::getLength(SizeType row,
     return col ? col->length() : 0;
 }
 
+void Sqlite3ResultImpl::getColumn(RowSizeType column,
+                                  std::vector<std::string_view> &values) const
+{
+    values.reserve(values.size() + result_.size());
+    for (auto const &row : result_)
+    {
+        auto &value = row[column];
+        if (value)
+            values.emplace_back(*value);
+        else
+            values.emplace_back();
+    }
+}
+
 unsigned long long Sqlite3ResultImpl::insertId() const noexcept
 {
     return insertId_;
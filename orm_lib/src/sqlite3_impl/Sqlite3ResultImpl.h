@@ -38,6 +38,8 @@ class Sqlite3ResultImpl : public ResultImpl
     const char *getValue(SizeType row, RowSizeType column) const override;
     bool isNull(SizeType row, RowSizeType column) const override;
     FieldSizeType getLength(SizeType row, RowSizeType column) const override;
+    void getColumn(RowSizeType column,
+                   std::vector<std::string_view> &values) const override;
     unsigned long long insertId() const noexcept override;
 
   private:
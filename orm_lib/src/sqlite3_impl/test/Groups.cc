@@ -1510,6 +1510,260 @@ Json::Value Groups::toMasqueradedJson(
     return ret;
 }
 
+void Groups::writeJson(drogon::JsonWriter &writer) const
+{
+    writer.startObject();
+    writer.key("group_id");
+    if (getGroupId())
+    {
+        writer.value(getValueOfGroupId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("group_name");
+    if (getGroupName())
+    {
+        writer.value(getValueOfGroupName());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("creater_id");
+    if (getCreaterId())
+    {
+        writer.value(getValueOfCreaterId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("create_time");
+    if (getCreateTime())
+    {
+        writer.value(getValueOfCreateTime());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("inviting");
+    if (getInviting())
+    {
+        writer.value(getValueOfInviting());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("inviting_user_id");
+    if (getInvitingUserId())
+    {
+        writer.value(getValueOfInvitingUserId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("avatar_id");
+    if (getAvatarId())
+    {
+        writer.value(getValueOfAvatarId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("uuu");
+    if (getUuu())
+    {
+        writer.value(getValueOfUuu());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("text");
+    if (getText())
+    {
+        writer.value(getValueOfText());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("avatar");
+    if (getAvatar())
+    {
+        writer.value(drogon::utils::base64Encode(
+            (const unsigned char *)getAvatar()->data(), getAvatar()->size()));
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("is_default");
+    if (getIsDefault())
+    {
+        writer.value(getValueOfIsDefault());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.endObject();
+}
+
+void Groups::writeMasqueradedJson(
+    drogon::JsonWriter &writer,
+    const std::vector<std::string> &pMasqueradingVector) const
+{
+    if (pMasqueradingVector.size() != 11)
+    {
+        LOG_ERROR << "Masquerade failed";
+        writeJson(writer);
+        return;
+    }
+    writer.startObject();
+    if (!pMasqueradingVector[0].empty())
+    {
+        writer.key(pMasqueradingVector[0]);
+        if (getGroupId())
+        {
+            writer.value(getValueOfGroupId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[1].empty())
+    {
+        writer.key(pMasqueradingVector[1]);
+        if (getGroupName())
+        {
+            writer.value(getValueOfGroupName());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[2].empty())
+    {
+        writer.key(pMasqueradingVector[2]);
+        if (getCreaterId())
+        {
+            writer.value(getValueOfCreaterId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[3].empty())
+    {
+        writer.key(pMasqueradingVector[3]);
+        if (getCreateTime())
+        {
+            writer.value(getValueOfCreateTime());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[4].empty())
+    {
+        writer.key(pMasqueradingVector[4]);
+        if (getInviting())
+        {
+            writer.value(getValueOfInviting());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[5].empty())
+    {
+        writer.key(pMasqueradingVector[5]);
+        if (getInvitingUserId())
+        {
+            writer.value(getValueOfInvitingUserId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[6].empty())
+    {
+        writer.key(pMasqueradingVector[6]);
+        if (getAvatarId())
+        {
+            writer.value(getValueOfAvatarId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[7].empty())
+    {
+        writer.key(pMasqueradingVector[7]);
+        if (getUuu())
+        {
+            writer.value(getValueOfUuu());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[8].empty())
+    {
+        writer.key(pMasqueradingVector[8]);
+        if (getText())
+        {
+            writer.value(getValueOfText());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[9].empty())
+    {
+        writer.key(pMasqueradingVector[9]);
+        if (getAvatar())
+        {
+            writer.value(drogon::utils::base64Encode(
+                (const unsigned char *)getAvatar()->data(),
+                getAvatar()->size()));
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[10].empty())
+    {
+        writer.key(pMasqueradingVector[10]);
+        if (getIsDefault())
+        {
+            writer.value(getValueOfIsDefault());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    writer.endObject();
+}
+
 bool Groups::validateJsonForCreation(const Json::Value &pJson, std::string &err)
 {
     if (pJson.isMember("group_id"))
@@ -11,6 +11,7 @@
 #include <drogon/orm/Field.h>
 #include <drogon/orm/SqlBinder.h>
 #include <drogon/orm/Mapper.h>
+#include <drogon/utils/JsonWriter.h>
 #include <trantor/utils/Date.h>
 #include <trantor/utils/Logger.h>
 #include <json/json.h>
@@ -244,6 +245,10 @@ class Groups
     Json::Value toJson() const;
     Json::Value toMasqueradedJson(
         const std::vector<std::string> &pMasqueradingVector) const;
+    void writeJson(drogon::JsonWriter &writer) const;
+    void writeMasqueradedJson(
+        drogon::JsonWriter &writer,
+        const std::vector<std::string> &pMasqueradingVector) const;
     /// Relationship interfaces
   private:
     friend Mapper<Groups>;
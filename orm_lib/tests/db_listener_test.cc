@@ -17,7 +17,10 @@
 #include <drogon/drogon_test.h>
 #include <drogon/HttpAppFramework.h>
 #include <drogon/config.h>
+#include <drogon/orm/CacheInvalidator.h>
 #include <drogon/orm/DbListener.h>
+#include <trantor/net/EventLoopThread.h>
+#include <atomic>
 #include <chrono>
 
 using namespace drogon;
@@ -81,6 +84,66 @@ DROGON_TEST(ListenNotifyTest)
     CHECK(numNotifications == 15);
     std::this_thread::sleep_for(1s);
 }
+
+DROGON_TEST(SharedListenerTest)
+{
+    auto clientPtr = postgreClient;
+    auto dbListener = DbListener::sharedPgListener(clientPtr->connectionInfo());
+    MANDATE(dbListener);
+    MANDATE(dbListener ==
+            DbListener::sharedPgListener(clientPtr->connectionInfo()));
+
+    trantor::EventLoopThread thread;
+    thread.run();
+    static std::atomic<int> numNotifications{0};
+    auto loop = thread.getLoop();
+    auto id = dbListener->subscribe(
+        "shared_test",
+        [TEST_CTX, loop](const std::string &, const std::string &) {
+            MANDATE(loop->isInLoopThread());
+            ++numNotifications;
+        },
+        loop);
+    dbListener->subscribe("shared_test",
+                          [](const std::string &, const std::string &) {
+                              ++numNotifications;
+                          });
+    auto notify = [clientPtr]() {
+        clientPtr->execSqlAsync(
+            "NOTIFY shared_test",
+            [](const orm::Result &) {},
+            [](const orm::DrogonDbException &ex) {
+                LOG_ERROR << "Failed to notify " << ex.base().what();
+            });
+    };
+    std::this_thread::sleep_for(1s);  // ensure listen success
+    notify();
+    std::this_thread::sleep_for(2s);
+    CHECK(numNotifications == 2);
+    // The other subscription is kept
+    dbListener->unsubscribe("shared_test", id);
+    std::this_thread::sleep_for(1s);
+    notify();
+    std::this_thread::sleep_for(2s);
+    CHECK(numNotifications == 3);
+}
+
+DROGON_TEST(CacheInvalidatorTest)
+{
+    auto clientPtr = postgreClient;
+    CacheInvalidator invalidator(
+        DbListener::newPgListener(clientPtr->connectionInfo()));
+    static std::atomic<int> numInvalidations{0};
+    invalidator.onNotification("invalidate_test",
+                               [TEST_CTX](const std::string &payload) {
+                                   MANDATE(payload == "users");
+                                   ++numInvalidations;
+                               });
+    std::this_thread::sleep_for(1s);  // ensure listen success
+    CacheInvalidator::notify(clientPtr, "invalidate_test", "users");
+    std::this_thread::sleep_for(2s);
+    CHECK(numInvalidations == 1);
+}
 #endif
 
 int main(int argc, char **argv)
@@ -17,6 +17,7 @@
 #include <drogon/config.h>
 #include <drogon/drogon_test.h>
 #include <drogon/orm/CoroMapper.h>
+#include <drogon/orm/DataLoader.h>
 #include <drogon/orm/DbClient.h>
 #include <drogon/orm/DbTypes.h>
 #include <string_view>
@@ -24,6 +25,7 @@
 #include <trantor/utils/Logger.h>
 
 #include <stdlib.h>
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <string>
@@ -50,6 +52,9 @@
 #include "sqlite3/Category.h"
 #include "sqlite3/BlogTag.h"
 #include "sqlite3/Tag.h"
+#if DROGON_USDT
+#include "../../lib/src/Probes.h"
+#endif
 
 using namespace std::chrono_literals;
 using namespace drogon::orm;
@@ -700,7 +705,16 @@ DROGON_TEST(PostgreTest)
     user.setOrgName("default");
     mapper.insert(
         user,
-        [TEST_CTX](Users ret) { MANDATE(ret.getPrimaryKey() == 1); },
+        [TEST_CTX](Users ret) {
+            MANDATE(ret.getPrimaryKey() == 1);
+            // The streamed JSON has the members of toJson()
+            std::string text;
+            drogon::JsonWriter writer(text);
+            ret.writeJson(writer);
+            Json::Value json;
+            MANDATE(drogon::fromJsonString(text, json));
+            MANDATE(json == ret.toJson());
+        },
         [TEST_CTX](const DrogonDbException &e) {
             FAULT("postgresql - ORM mapper asynchronous interface(0) what():",
                   e.base().what());
@@ -741,6 +755,19 @@ DROGON_TEST(PostgreTest)
             FAULT("postgresql - ORM mapper asynchronous interface(2) what():",
                   e.base().what());
         });
+    /// 6.3.1 select where in, the lists bound as arrays
+    mapper.findBy(
+        Criteria(Users::Cols::_id,
+                 CompareOperator::In,
+                 std::vector<int32_t>{2, 200, 300}) &&
+            Criteria(Users::Cols::_user_name,
+                     CompareOperator::NotIn,
+                     std::vector<std::string>{"a\"b", "c\\d"}),
+        [TEST_CTX](std::vector<Users> users) { MANDATE(users.size() == 1); },
+        [TEST_CTX](const DrogonDbException &e) {
+            FAULT("postgresql - ORM mapper asynchronous interface(2.1) what():",
+                  e.base().what());
+        });
     /// 6.3.5 count
     mapper.count(
         Criteria(Users::Cols::_id, CompareOperator::EQ, 2020),
@@ -764,6 +791,68 @@ DROGON_TEST(PostgreTest)
             FAULT("postgresql - ORM mapper asynchronous interface(5) what():",
                   e.base().what());
         });
+    /// 6.3.8 keyset pagination
+    try
+    {
+        auto firstPage =
+            mapper.orderBy(Users::Cols::_id).paginateAfter(1).findAll();
+        MANDATE(firstPage.size() == 1);
+        auto lastId = firstPage[0].getValueOfId();
+        auto page = mapper.orderBy(Users::Cols::_id)
+                        .paginateAfter(1, lastId)
+                        .findAll();
+        MANDATE(page.size() == 1);
+        MANDATE(page[0].getValueOfId() > lastId);
+        page = mapper.orderBy(Users::Cols::_id)
+                   .paginateAfter(1, std::vector<std::string>{
+                                         std::to_string(lastId)})
+                   .findAll();
+        MANDATE(page.size() == 1);
+        MANDATE(page[0].getValueOfId() > lastId);
+    }
+    catch (const DrogonDbException &e)
+    {
+        FAULT("postgresql - ORM mapper keyset pagination what():",
+              e.base().what());
+    }
+    /// 6.3.9 column projection
+    try
+    {
+        auto user = mapper.columns({Users::Cols::_id, Users::Cols::_user_name})
+                        .findByPrimaryKey(2);
+        MANDATE(user.getValueOfId() == 2);
+        MANDATE(user.getUserName() != nullptr);
+        MANDATE(user.getUserId() == nullptr);
+        auto users = mapper.columns({Users::Cols::_user_name}).findAll();
+        MANDATE(!users.empty());
+        MANDATE(users[0].getId() == nullptr);
+        // The projection is cleared by the query
+        users = mapper.findAll();
+        MANDATE(users[0].getUserId() != nullptr);
+    }
+    catch (const DrogonDbException &e)
+    {
+        FAULT("postgresql - ORM mapper column projection what():",
+              e.base().what());
+    }
+    /// 6.3.10 lookups by primary key through a data loader
+    {
+        auto loader = std::make_shared<DataLoader<Users>>(clientPtr);
+        loader->findByPrimaryKey(
+            2,
+            [TEST_CTX, loader](Users user) {
+                MANDATE(user.getValueOfId() == 2);
+            },
+            [TEST_CTX](const DrogonDbException &e) {
+                FAULT("postgresql - DataLoader what():", e.base().what());
+            });
+        loader->findByPrimaryKey(
+            20000,
+            [TEST_CTX](Users) { FAULT("postgresql - DataLoader"); },
+            [TEST_CTX](const DrogonDbException &e) {
+                MANDATE(std::string(e.base().what()) == "0 rows found");
+            });
+    }
     /// 6.4 find by primary key. blocking
     try
     {
@@ -977,6 +1066,344 @@ DROGON_TEST(PostgreTest)
         }
     }
 
+    /// Test the streaming of the rows of a query
+    {
+        auto count = std::make_shared<int64_t>(0);
+        clientPtr->execSqlStream(
+            "select generate_series(1, $1) as n",
+            10,
+            [TEST_CTX, count](const Result &r, const RowStreamPtr &stream) {
+                for (auto const &row : r)
+                {
+                    MANDATE(row["n"].as<int64_t>() == ++*count);
+                }
+                if (stream)
+                {
+                    MANDATE(r.size() == 10);
+                    stream->next();
+                    return;
+                }
+                MANDATE(*count == 25);
+            },
+            expFunction,
+            25);
+    }
+    /// Test the COPY commands
+    {
+        auto data = std::make_shared<std::string>();
+        clientPtr->copyOut(
+            "copy (select generate_series(1, 3)) to stdout",
+            [data](std::string_view part) { data->append(part); },
+            [TEST_CTX, data](const Result &r) {
+                MANDATE(*data == "1\n2\n3\n");
+                MANDATE(r.affectedRows() == 3);
+            },
+            expFunction);
+        clientPtr->newTransactionAsync(
+            [TEST_CTX](const std::shared_ptr<Transaction> &transaction) {
+                MANDATE(transaction);
+                *transaction << "create temp table copy_test (n int, s text)"
+                                " on commit drop" >>
+                    [](const Result &) {} >>
+                    [TEST_CTX](const DrogonDbException &e) {
+                        FAULT("postgresql - COPY FROM STDIN what():",
+                              e.base().what());
+                    };
+                transaction->copyIn(
+                    "copy copy_test from stdin with (format csv)",
+                    [](const CopyWriterPtr &writer) {
+                        writer->write("1,one\n2,");
+                        writer->write("two\n");
+                        writer->finish();
+                    },
+                    [TEST_CTX](const Result &r) {
+                        MANDATE(r.affectedRows() == 2);
+                    },
+                    [TEST_CTX](const DrogonDbException &e) {
+                        FAULT("postgresql - COPY FROM STDIN what():",
+                              e.base().what());
+                    });
+                *transaction << "select s from copy_test where n = 2" >>
+                    [TEST_CTX](const Result &r) {
+                        MANDATE(r.size() == 1);
+                        MANDATE(r[0]["s"].as<std::string>() == "two");
+                    } >>
+                    [TEST_CTX](const DrogonDbException &e) {
+                        FAULT("postgresql - COPY FROM STDIN what():",
+                              e.base().what());
+                    };
+            });
+    }
+    /// Test the statements sent without waiting in a transaction
+    {
+        clientPtr->newTransactionAsync(
+            [TEST_CTX](const std::shared_ptr<Transaction> &transaction) {
+                MANDATE(transaction);
+                auto count = std::make_shared<int>(0);
+                for (int i = 0; i < 3; ++i)
+                {
+                    *transaction << "select $1::int" << i >>
+                        [TEST_CTX, count, i](const Result &r) {
+                            MANDATE(r[0][0].as<int>() == i);
+                            MANDATE((*count)++ == i);
+                        } >>
+                        [TEST_CTX](const DrogonDbException &e) {
+                            FAULT("postgresql - Pipelined transaction what():",
+                                  e.base().what());
+                        };
+                }
+                // The statement after the failed one fails too.
+                *transaction << "select * from no_such_table" >>
+                    [TEST_CTX](const Result &) {
+                        FAULT("postgresql - Pipelined transaction");
+                    } >>
+                    [TEST_CTX, count](const DrogonDbException &) {
+                        MANDATE((*count)++ == 3);
+                    };
+                *transaction << "select 1" >>
+                    [TEST_CTX](const Result &) {
+                        FAULT("postgresql - Pipelined transaction");
+                    } >>
+                    [TEST_CTX, count](const DrogonDbException &) {
+                        MANDATE((*count)++ == 4);
+                    };
+            });
+    }
+    /// Test the cache of the prepared statements
+    {
+        auto client = DbClient::newPgClient(
+            clientPtr->connectionInfo(), 1, false, false, 2, 2);
+        try
+        {
+            // Both queries are prepared on their second execution.
+            for (int i = 0; i < 3; ++i)
+            {
+                for (int j = 0; j < 2; ++j)
+                {
+                    auto r = client->execSqlSync("select $1::int + " +
+                                                     std::to_string(j),
+                                                 i);
+                    MANDATE(r[0][0].as<int>() == i + j);
+                }
+            }
+            // The first query is deallocated to make room for this one.
+            auto r = client->execSqlSync("select $1::int + 2", 1);
+            MANDATE(r[0][0].as<int>() == 3);
+            auto stats = client->connectionStats();
+            MANDATE(stats.preparedStatementHits == 2);
+            MANDATE(stats.preparedStatementMisses == 5);
+            MANDATE(stats.preparedStatementEvictions == 1);
+            r = client->execSqlSync("select $1::int + 0", 1);
+            MANDATE(r[0][0].as<int>() == 1);
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("postgresql - Prepared statement cache what():",
+                  e.base().what());
+        }
+    }
+    /// Test the warmup statements
+    {
+        auto client =
+            DbClient::newPgClient(clientPtr->connectionInfo(),
+                                  1,
+                                  false,
+                                  false,
+                                  0,
+                                  2,
+                                  {"select $1::int + 10", "select from nowhere"});
+        try
+        {
+            // The statement is prepared before the first execution, the one
+            // which can't be prepared is skipped.
+            auto r = client->execSqlSync("select $1::int + 10", 1);
+            MANDATE(r[0][0].as<int>() == 11);
+            auto stats = client->connectionStats();
+            MANDATE(stats.preparedStatementHits == 1);
+            MANDATE(stats.preparedStatementMisses == 0);
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("postgresql - Warmup statements what():", e.base().what());
+        }
+    }
+    /// Test the binary results
+    {
+        auto client = DbClient::newPgClient(clientPtr->connectionInfo(),
+                                            1,
+                                            false,
+                                            true);
+        // Each value is read back in the binary format and compared with its
+        // text from the server. The ones unknown to the server version are
+        // skipped, e.g. the infinite numerics before PostgreSQL 14.
+        const std::vector<std::pair<std::string, std::string>> values{
+            {"bool", "true"},
+            {"bool", "false"},
+            {"int2", "-32768"},
+            {"int4", "2147483647"},
+            {"int8", "-9223372036854775808"},
+            {"oid", "4294967295"},
+            {"float4", "1.5e-07"},
+            {"float4", "-3.4028235e+38"},
+            {"float8", "0.1"},
+            {"float8", "-1.2345678901234567e-300"},
+            {"float8", "NaN"},
+            {"float8", "Infinity"},
+            {"float8", "-Infinity"},
+            {"numeric", "0"},
+            {"numeric", "-12345678.0001"},
+            {"numeric", "0.000012300"},
+            {"numeric", "10000"},
+            {"numeric", "1e20"},
+            {"numeric", "-0.5"},
+            {"numeric(5,2)", "1.5"},
+            {"numeric(5,-2)", "12345"},
+            {"numeric", "NaN"},
+            {"numeric", "Infinity"},
+            {"numeric", "-Infinity"},
+            {"uuid", "a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11"},
+            {"date", "2000-01-01"},
+            {"date", "1970-03-15"},
+            {"date", "1999-12-31"},
+            {"date", "0044-03-15 BC"},
+            {"date", "infinity"},
+            {"date", "-infinity"},
+            {"time", "00:00:00"},
+            {"time", "23:59:59.999999"},
+            {"time", "12:30:00.25"},
+            {"timestamp", "2000-01-01 00:00:00"},
+            {"timestamp", "1999-12-31 23:59:59.5"},
+            {"timestamp", "2038-01-19 03:14:08.000001"},
+            {"timestamp", "0001-01-01 00:00:00 BC"},
+            {"timestamp", "infinity"},
+            {"timestamp", "-infinity"},
+            {"jsonb", "{\"a\": [1, 2.5, null]}"},
+            {"json", "{\"a\": 1}"},
+            {"text", "drogon"},
+            {"varchar", "\u00e9t\u00e9"},
+            {"bytea", "\\x00ff10"},
+        };
+        for (auto &[type, value] : values)
+        {
+            auto sql = "select $1::" + type;
+            std::string text;
+            try
+            {
+                text = clientPtr->execSqlSync(sql, value)[0][0]
+                           .as<std::string>();
+            }
+            catch (const DrogonDbException &)
+            {
+                continue;
+            }
+            try
+            {
+                // The first result tells the types of the columns.
+                auto r = client->execSqlSync(sql, value);
+                MANDATE(!r.isBinary(0));
+                r = client->execSqlSync(sql, value);
+                MANDATE(r.isBinary(0));
+                CHECK(r[0][0].as<std::string>() == text);
+            }
+            catch (const DrogonDbException &e)
+            {
+                FAULT("postgresql - Binary results of " + sql + " what():",
+                      e.base().what());
+            }
+        }
+        try
+        {
+            // The integers are decoded directly.
+            auto r = client->execSqlSync("select $1::int8, $2::float8", 1, 2);
+            r = client->execSqlSync("select $1::int8, $2::float8", -7, 2.5);
+            MANDATE(r.isBinary(0));
+            MANDATE(r[0][0].as<int64_t>() == -7);
+            MANDATE(r[0][1].as<double>() == 2.5);
+            MANDATE(r[0][1].as<std::string>() == "2.5");
+            // The types without a decoder keep the whole result in text.
+            const std::string sql =
+                "select $1::int, array[$1::int], interval '1 day', now()";
+            client->execSqlSync(sql, 1);
+            r = client->execSqlSync(sql, 1);
+            MANDATE(!r.isBinary(0));
+            MANDATE(r[0][0].as<int>() == 1);
+            MANDATE(r[0][1].as<std::string>() == "{1}");
+            MANDATE(r[0][2].as<std::string>() == "1 day");
+            auto now = clientPtr->execSqlSync("select $1::timestamptz",
+                                              r[0][3].as<std::string>());
+            MANDATE(now[0][0].as<std::string>() == r[0][3].as<std::string>());
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("postgresql - Binary results what():", e.base().what());
+        }
+    }
+    /// Test the routing of the queries to the replicas
+    {
+        // The test server plays the part of its replica, which has no lag.
+        auto replica = DbClient::newPgClient(clientPtr->connectionInfo(), 1);
+        auto client =
+            DbClient::newReplicatedClient(clientPtr, {replica}, 10.0);
+        try
+        {
+            auto r = client->execSqlSync("select $1::int", 1);
+            MANDATE(r[0][0].as<int>() == 1);
+            r = client->readOnly().execSqlSync("show server_version");
+            MANDATE(r.size() == 1);
+            r = client->primary().execSqlSync("select 2");
+            MANDATE(r[0][0].as<int>() == 2);
+            auto transaction = client->newTransaction();
+            r = transaction->execSqlSync("select 3");
+            MANDATE(r[0][0].as<int>() == 3);
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("postgresql - Replicated client what():", e.base().what());
+        }
+    }
+    /// Test the decoding of columns
+    {
+        try
+        {
+            auto r = clientPtr->execSqlSync(
+                "select i, i::text as t from generate_series(1, 1000) i");
+            auto ids = r.columnAs<int>("i");
+            auto texts = r.columnAs<std::string_view>(1);
+            MANDATE(ids.size() == 1000);
+            MANDATE(ids[999] == 1000);
+            MANDATE(texts[499] == "500");
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("postgresql - Column decoding what():", e.base().what());
+        }
+    }
+    /// Test the growth of the pool of connections
+    {
+        auto client = DbClient::newPgClient(clientPtr->connectionInfo(), 1);
+        client->enableAdaptivePool(3);
+        try
+        {
+            std::vector<std::future<Result>> results;
+            for (int i = 0; i < 3; ++i)
+            {
+                results.push_back(
+                    client->execSqlAsyncFuture("select pg_sleep(0.2)"));
+            }
+            for (auto &result : results)
+            {
+                result.get();
+            }
+            auto stats = client->connectionStats();
+            MANDATE(stats.busy + stats.idle == 3);
+            MANDATE(stats.queuedCommands >= 1);
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("postgresql - Adaptive pool what():", e.base().what());
+        }
+    }
+
 #ifdef __cpp_impl_coroutine
     auto coro_test = [clientPtr, TEST_CTX]() -> drogon::Task<> {
         /// 7 Test coroutines.
@@ -1150,6 +1577,77 @@ DROGON_TEST(PostgreTest)
                   e.base().what());
         }
     }
+    /// insert in batches
+    {
+        auto newWallets = []() {
+            std::vector<Wallets> wallets(3);
+            for (size_t i = 0; i < wallets.size(); ++i)
+            {
+                wallets[i].setUserId("pg_batch" + std::to_string(i));
+                wallets[i].setAmount("10.00");
+            }
+            return wallets;
+        };
+        try
+        {
+            auto wallets = newWallets();
+            walletsMapper.insertBatch(wallets, 4);
+            MANDATE(wallets[0].getValueOfId() > 0);
+            MANDATE(wallets[1].getValueOfId() == wallets[0].getValueOfId() + 1);
+            MANDATE(wallets[2].getValueOfId() == wallets[0].getValueOfId() + 2);
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("postgresql - ORM mapper insert in batches what():",
+                  e.base().what());
+        }
+        walletsMapper.insertBatch(
+            newWallets(),
+            [TEST_CTX](std::vector<Wallets> wallets) {
+                MANDATE(wallets.size() == 3);
+                MANDATE(wallets[2].getValueOfUserId() == "pg_batch2");
+            },
+            [TEST_CTX](const DrogonDbException &e) {
+                FAULT("postgresql - ORM mapper insert in batches what():",
+                      e.base().what());
+            });
+    }
+    /// upsert and update in batches
+    try
+    {
+        Mapper<Users> usersMapper(clientPtr);
+        Users user;
+        user.setUserId("pg_upsert");
+        user.setOrgName("drogon");
+        user.setUserName("upsert0");
+        MANDATE(usersMapper.upsert(user, {"user_id", "org_name"}) == 1);
+        user.setUserName("upsert1");
+        MANDATE(usersMapper.upsert(user, {"user_id", "org_name"}) == 1);
+        auto users = usersMapper.findBy(
+            Criteria(Users::Cols::_user_id, CompareOperator::EQ, "pg_upsert"));
+        MANDATE(users.size() == 1);
+        MANDATE(users[0].getValueOfUserName() == "upsert1");
+
+        std::vector<Wallets> wallets(3);
+        for (auto &wallet : wallets)
+        {
+            wallet.setUserId("pg_update");
+        }
+        walletsMapper.insertBatch(wallets);
+        for (size_t i = 0; i < wallets.size(); ++i)
+        {
+            wallets[i].setAmount(std::to_string(i) + ".00");
+        }
+        MANDATE(walletsMapper.updateBatch(wallets, 4) == 3);
+        auto updated =
+            walletsMapper.findByPrimaryKey(wallets[2].getValueOfId());
+        MANDATE(updated.getValueOfAmount() == "2.00");
+    }
+    catch (const DrogonDbException &e)
+    {
+        FAULT("postgresql - ORM mapper upsert and update in batches what():",
+              e.base().what());
+    }
 
     /// users to wallets
     {
@@ -1439,6 +1937,26 @@ DROGON_TEST(PostgreTest)
                   e.base().what());
         }
     }
+    /// the blogs of several categories in one query
+    {
+        std::vector<Category> categories(3);
+        categories[0].setId(1);
+        categories[1].setId(2);
+        categories[2].setId(1);
+        try
+        {
+            auto r = Category::loadBlogs(clientPtr, categories);
+            MANDATE(r.size() == 3);
+            MANDATE(r[0].size() == 2);
+            MANDATE(r[1].empty());
+            MANDATE(r[2].size() == 2);
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("postgresql - ORM mapper related batch loading what():",
+                  e.base().what());
+        }
+    }
     /// blogs to categories
     {
         Blog blog;
@@ -2390,6 +2908,77 @@ DROGON_TEST(MySQLTest)
 
 #endif
 
+    /// Test the auto-batch mode
+    {
+        // The queries waiting for the connection are sent as one query, the
+        // ones after a failed statement aren't executed.
+        auto client =
+            DbClient::newMysqlClient(clientPtr->connectionInfo(), 1, true);
+        auto sleep = client->execSqlAsyncFuture("select sleep(0.2)");
+        std::vector<std::future<Result>> results;
+        for (int i = 0; i < 3; ++i)
+        {
+            results.push_back(client->execSqlAsyncFuture("select ?", i));
+        }
+        auto failed = client->execSqlAsyncFuture("select * from no_table");
+        auto skipped = client->execSqlAsyncFuture("select 1");
+        try
+        {
+            sleep.get();
+            for (int i = 0; i < 3; ++i)
+            {
+                MANDATE(results[i].get()[0][0].as<int>() == i);
+            }
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("mysql - Auto-batch mode what():", e.base().what());
+        }
+        CHECK_THROWS_AS(failed.get(), SqlError);
+        CHECK_THROWS_AS(skipped.get(), SqlError);
+    }
+
+    /// Test the prepared statements
+    {
+        // The values are received in the binary format and converted to the
+        // same strings as the ones of the text protocol.
+        auto client = DbClient::newMysqlClient(
+            clientPtr->connectionInfo() +
+                " prepared_statements=1 max_prepared_statements=2",
+            1);
+        try
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                auto r = client->execSqlSync(
+                    "select ? as n, ?, null, 1.5, cast('2024-01-02' as date)",
+                    i,
+                    "a?b");
+                MANDATE(r.size() == 1);
+                MANDATE(r[0]["n"].as<int>() == i);
+                MANDATE(r[0][1].as<std::string>() == "a?b");
+                MANDATE(r[0][2].isNull());
+                MANDATE(r[0][3].as<std::string>() == "1.5");
+                MANDATE(r[0][4].as<std::string>() == "2024-01-02");
+            }
+            // Evicts the first statement
+            client->execSqlSync("select 1");
+            client->execSqlSync("select 2");
+            auto r = client->execSqlSync("select ?", 3);
+            MANDATE(r[0][0].as<int>() == 3);
+            // A question mark which isn't a placeholder
+            r = client->execSqlSync("select '?'");
+            MANDATE(r[0][0].as<std::string>() == "?");
+            SUCCESS();
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("mysql - Prepared statements what():", e.base().what());
+        }
+        CHECK_THROWS_AS(client->execSqlSync("select * from no_table"),
+                        SqlError);
+    }
+
     /// 8 Test ORM related query
     /// 8.1 async
     /// 8.1.1 one-to-one
@@ -4252,6 +4841,399 @@ DROGON_TEST(SQLite3TransactionTypeLockingTest)
             "succeeded. This means BEGIN IMMEDIATE is not being sent.");
     }
 }
+
+DROGON_TEST(SQLite3ColumnDecodingTest)
+{
+    auto clientPtr = DbClient::newSqlite3Client("filename=:memory:", 1);
+    try
+    {
+        auto r = clientPtr->execSqlSync(
+            "select 1 as id, 'a' as name, 1.5 as value union all "
+            "select 2, null, -2.25 union all select 3, 'c', null");
+        MANDATE(r.columnAs<int64_t>("id") == std::vector<int64_t>{1, 2, 3});
+        MANDATE(r.columnAs<double>(2) == std::vector<double>{1.5, -2.25, 0});
+        auto names = r.columnValues("name");
+        MANDATE(names.size() == 3);
+        MANDATE(names[0] == "a");
+        MANDATE(names[1].data() == nullptr);
+        MANDATE(r.columnAs<std::string>(1)[2] == "c");
+        CHECK_THROWS_AS(r.columnValues(3), RangeError);
+
+        static const std::vector<std::string> columnNames{"value",
+                                                          "missing",
+                                                          "id"};
+        auto &numbers = r[0].columnNumbers(columnNames);
+        MANDATE(numbers == std::vector<long>{2, -1, 0});
+        MANDATE(&r[1].columnNumbers(columnNames) == &numbers);
+    }
+    catch (const DrogonDbException &e)
+    {
+        FAULT("sqlite3 - Column decoding what():", e.base().what());
+    }
+}
+
+DROGON_TEST(SQLite3CachedClientTest)
+{
+    auto clientPtr = DbClient::newSqlite3Client("filename=:memory:", 1);
+    auto cachedClient = DbClient::newCachedClient(clientPtr, 100, 60.0);
+    try
+    {
+        cachedClient->execSqlSync(
+            "create table cache_test (id integer primary key, value text)");
+        cachedClient->execSqlSync(
+            "insert into cache_test (value) values (?)", "a");
+        auto count = [&cachedClient](const std::string &value) {
+            return cachedClient
+                ->execSqlSync("select count(*) from cache_test where value = ?",
+                              value)[0][0]
+                .as<int>();
+        };
+        MANDATE(count("a") == 1);
+        // Not seen by the cache.
+        clientPtr->execSqlSync("insert into cache_test (value) values ('a')");
+        MANDATE(count("a") == 1);
+        MANDATE(count("b") == 0);
+        cachedClient->execSqlSync(
+            "update \"cache_test\" set value = 'b' where id = 1");
+        MANDATE(count("a") == 1);
+        MANDATE(count("b") == 1);
+        clientPtr->execSqlSync("delete from cache_test");
+        cachedClient->invalidateCache("main.CACHE_TEST");
+        MANDATE(count("b") == 0);
+    }
+    catch (const DrogonDbException &e)
+    {
+        FAULT("sqlite3 - Cached client what():", e.base().what());
+    }
+}
+
+DROGON_TEST(SQLite3WalModeTest)
+{
+    const auto nonce =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    const auto dbPath = "drogon_wal_test_" + std::to_string(nonce) + ".db";
+    std::remove(dbPath.c_str());
+    {
+        auto clientPtr = DbClient::newSqlite3Client(
+            "filename=" + dbPath + " journal_mode=wal busy_timeout=1000", 2);
+        try
+        {
+            auto r = clientPtr->execSqlSync("pragma journal_mode");
+            MANDATE(r[0][0].as<std::string>() == "wal");
+            r = clientPtr->execSqlSync("pragma synchronous");
+            MANDATE(r[0][0].as<int>() == 1);
+            clientPtr->execSqlSync(
+                "create table wal_test (id integer primary key, value text)");
+            std::vector<std::future<Result>> results;
+            for (int i = 0; i < 10; ++i)
+            {
+                results.push_back(clientPtr->execSqlAsyncFuture(
+                    "insert into wal_test (value) values (?)",
+                    std::to_string(i)));
+                results.push_back(clientPtr->execSqlAsyncFuture(
+                    "select count(*) from wal_test"));
+            }
+            for (auto &result : results)
+            {
+                result.get();
+            }
+            r = clientPtr->execSqlSync("select count(*) from wal_test");
+            MANDATE(r[0][0].as<int>() == 10);
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("sqlite3 - WAL mode what():", e.base().what());
+        }
+    }
+    std::remove(dbPath.c_str());
+    std::remove((dbPath + "-wal").c_str());
+    std::remove((dbPath + "-shm").c_str());
+}
+
+DROGON_TEST(SQLite3WalReadersTest)
+{
+    const auto nonce =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    const auto dbPath =
+        "drogon_wal_readers_test_" + std::to_string(nonce) + ".db";
+    std::remove(dbPath.c_str());
+    {
+        // No busy timeout, a reader waiting for the writer fails at once.
+        auto clientPtr = DbClient::newSqlite3Client(
+            "filename=" + dbPath + " journal_mode=wal busy_timeout=0", 4);
+        try
+        {
+            clientPtr->execSqlSync(
+                "create table wal_readers (id integer primary key, value "
+                "blob)");
+            clientPtr->execSqlSync(
+                "insert into wal_readers (value) values (randomblob(100))");
+
+            // The writer holds its transaction open with more data than the
+            // page cache, which would take the exclusive lock of the
+            // database in the rollback journal modes.
+            auto trans = clientPtr->newTransaction(TransactionType::Immediate);
+            trans->execSqlSync(
+                "insert into wal_readers (value) with recursive n(i) as "
+                "(select 1 union all select i + 1 from n where i < 5000) "
+                "select randomblob(1000) from n");
+
+            std::vector<std::future<Result>> results;
+            for (int i = 0; i < 6; ++i)
+            {
+                results.push_back(clientPtr->execSqlAsyncFuture(
+                    "select count(*) from wal_readers"));
+            }
+            for (auto &result : results)
+            {
+                // The readers see the last commit without waiting.
+                MANDATE(result.wait_for(std::chrono::seconds(2)) ==
+                        std::future_status::ready);
+                MANDATE(result.get()[0][0].as<int>() == 1);
+            }
+            trans.reset();
+
+            auto r = clientPtr->execSqlSync("select count(*) from wal_readers");
+            MANDATE(r[0][0].as<int>() == 5001);
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("sqlite3 - WAL readers what():", e.base().what());
+        }
+    }
+    std::remove(dbPath.c_str());
+    std::remove((dbPath + "-wal").c_str());
+    std::remove((dbPath + "-shm").c_str());
+}
+
+#ifdef __cpp_impl_coroutine
+DROGON_TEST(SQLite3CoroAwaiterTest)
+{
+    auto clientPtr = DbClient::newSqlite3Client("filename=:memory:", 1);
+    clientPtr->execSqlSync(
+        "create table coro_awaiter (id integer primary key, name text)");
+    auto coro_test = [clientPtr, TEST_CTX]() -> drogon::Task<> {
+        try
+        {
+            // The parameters are temporaries, they are kept by the awaiter
+            // until the coroutine is resumed.
+            for (int i = 0; i < 3; ++i)
+            {
+                co_await clientPtr->execSqlCoro(
+                    "insert into coro_awaiter (name) values (?)",
+                    "name" + std::to_string(i));
+            }
+            std::string sql = "select name from coro_awaiter where id = ?";
+            auto result = co_await clientPtr->execSqlCoro(sql, 2);
+            MANDATE(result.size() == 1UL);
+            MANDATE(result[0]["name"].as<std::string>() == "name1");
+            result = co_await clientPtr->execSqlCoro(
+                "select count(*) from coro_awaiter where id > ?",
+                std::vector<int>{1});
+            MANDATE(result[0][0].as<int>() == 2);
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("sqlite3 - Coroutine awaiter what():", e.base().what());
+        }
+        // The errors are thrown when the coroutine is resumed.
+        try
+        {
+            co_await clientPtr->execSqlCoro("select * from missing_table");
+            FAULT("sqlite3 - Coroutine awaiter: the query should fail");
+        }
+        catch (const DrogonDbException &e)
+        {
+            SUCCESS();
+        }
+    };
+    drogon::sync_wait(coro_test());
+}
+#endif
+
+DROGON_TEST(SQLite3ImmutableTest)
+{
+    const auto nonce =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    const auto dbPath =
+        "drogon_immutable_test_" + std::to_string(nonce) + ".db";
+    std::remove(dbPath.c_str());
+    {
+        auto setupClient = DbClient::newSqlite3Client("filename=" + dbPath, 1);
+        setupClient->execSqlSync("create table ref_data (id integer, v text)");
+        setupClient->execSqlSync("insert into ref_data values (1, 'a')");
+    }
+    {
+        auto clientPtr = DbClient::newSqlite3Client(
+            "filename=" + dbPath +
+                " immutable=1 mmap_size=1048576 cache_size=-2000 "
+                "temp_store=memory max_prepared_statements=2",
+            1);
+        try
+        {
+            auto r = clientPtr->execSqlSync("pragma cache_size");
+            MANDATE(r[0][0].as<int>() == -2000);
+            r = clientPtr->execSqlSync("pragma temp_store");
+            MANDATE(r[0][0].as<int>() == 2);
+            // The cached statements are evicted beyond the limit
+            for (int i = 0; i < 3; ++i)
+            {
+                r = clientPtr->execSqlSync(
+                    "select v from ref_data where id = ?", 1);
+                MANDATE(r[0][0].as<std::string>() == "a");
+                r = clientPtr->execSqlSync("select count(*) from ref_data");
+                MANDATE(r[0][0].as<int>() == 1);
+                r = clientPtr->execSqlSync("select " + std::to_string(i));
+                MANDATE(r[0][0].as<int>() == i);
+            }
+            CHECK_THROWS_AS(
+                clientPtr->execSqlSync("insert into ref_data values (2, 'b')"),
+                SqlError);
+        }
+        catch (const DrogonDbException &e)
+        {
+            FAULT("sqlite3 - immutable mode what():", e.base().what());
+        }
+    }
+    std::remove(dbPath.c_str());
+}
+
+DROGON_TEST(SQLite3MapperStatementCacheTest)
+{
+    auto clientPtr = DbClient::newSqlite3Client("filename=:memory:", 1);
+    using namespace drogon_model::sqlite3;
+    try
+    {
+        clientPtr->execSqlSync(
+            "CREATE TABLE users "
+            "("
+            "    id INTEGER PRIMARY KEY autoincrement,"
+            "    user_id varchar(32),"
+            "    user_name varchar(64),"
+            "    password varchar(64),"
+            "    org_name varchar(20),"
+            "    signature varchar(50),"
+            "    avatar_id varchar(32),"
+            "    salt character varchar(20),"
+            "    admin boolean DEFAULT false,"
+            "    create_time datetime,"
+            "    CONSTRAINT user_id_org UNIQUE(user_id, org_name)"
+            ")");
+        // The statements of the same shape are converted once and then
+        // bound from the cache, by every mapper of the model.
+        for (int i = 1; i <= 5; ++i)
+        {
+            Mapper<Users> mapper(clientPtr);
+            Users user;
+            user.setUserId("cache" + std::to_string(i));
+            user.setUserName("user" + std::to_string(i));
+            user.setOrgName("default");
+            mapper.insert(user);
+            MANDATE(user.getValueOfId() == i);
+        }
+        for (int i = 1; i <= 5; ++i)
+        {
+            Mapper<Users> mapper(clientPtr);
+            auto user = mapper.findByPrimaryKey(i);
+            MANDATE(user.getValueOfUserName() == "user" + std::to_string(i));
+            auto users = mapper.findBy(
+                Criteria(Users::Cols::_user_id,
+                         CompareOperator::EQ,
+                         "cache" + std::to_string(i)));
+            MANDATE(users.size() == 1);
+            MANDATE(users[0].getValueOfId() == i);
+            MANDATE(mapper.count(Criteria(Users::Cols::_id,
+                                          CompareOperator::LE,
+                                          i)) == (size_t)i);
+        }
+        // The same shape with other values for the limit and the offset
+        for (size_t offset = 0; offset < 3; ++offset)
+        {
+            Mapper<Users> mapper(clientPtr);
+            auto users = mapper.orderBy(Users::Cols::_id)
+                             .limit(2)
+                             .offset(offset + 1)
+                             .findAll();
+            MANDATE(users.size() == 2);
+            MANDATE(users[0].getValueOfId() == (int64_t)offset + 2);
+        }
+        // A new shape for each length of the in list
+        for (int length = 1; length <= 3; ++length)
+        {
+            Mapper<Users> mapper(clientPtr);
+            std::vector<int64_t> ids;
+            for (int i = 1; i <= length; ++i)
+                ids.push_back(i);
+            MANDATE(mapper.count(Criteria(Users::Cols::_id,
+                                          CompareOperator::In,
+                                          ids)) == (size_t)length);
+        }
+        Mapper<Users> mapper(clientPtr);
+        for (int i = 1; i <= 5; ++i)
+        {
+            auto user = mapper.findByPrimaryKey(i);
+            user.setSignature("signed");
+            MANDATE(mapper.update(user) == 1);
+        }
+        MANDATE(mapper.count(Criteria(Users::Cols::_signature,
+                                      CompareOperator::EQ,
+                                      "signed")) == 5);
+        MANDATE(mapper.deleteBy(Criteria(Users::Cols::_id,
+                                         CompareOperator::GT,
+                                         3)) == 2);
+        MANDATE(mapper.count() == 3);
+    }
+    catch (const DrogonDbException &e)
+    {
+        FAULT("sqlite3 - Mapper statement cache what():", e.base().what());
+    }
+}
+
+#if DROGON_USDT
+DROGON_TEST(SQLite3ProbedQueryTest)
+{
+    // As if a tracer was attached to the probe, the callbacks of the queries
+    // are wrapped to fire it.
+    ++drogon_db__query__end_semaphore;
+    auto clientPtr = DbClient::newSqlite3Client("filename=:memory:", 1);
+    auto results = std::make_shared<std::atomic<int>>(0);
+    auto errors = std::make_shared<std::atomic<int>>(0);
+    for (int i = 0; i < 10; ++i)
+    {
+        clientPtr->execSqlAsync(
+            "select ? + 1",
+            [results, i](const Result &r) {
+                if (r.size() == 1 && r[0][0].as<int>() == i + 1)
+                    ++*results;
+            },
+            [](const DrogonDbException &) {},
+            i);
+    }
+    clientPtr->execSqlAsync(
+        "select from nowhere",
+        [](const Result &) {},
+        [errors](const DrogonDbException &) { ++*errors; });
+    clientPtr->execSqlAsync(
+        "insert into missing_table values (1)",
+        [](const Result &) {},
+        [errors](const DrogonDbException &) { ++*errors; });
+    // Run after the other queries on the only connection
+    try
+    {
+        auto r = clientPtr->execSqlSync("select 42");
+        MANDATE(r[0][0].as<int>() == 42);
+    }
+    catch (const DrogonDbException &e)
+    {
+        FAULT("sqlite3 - Probed query what():", e.base().what());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Every callback is called once.
+    CHECK(results->load() == 10);
+    CHECK(errors->load() == 2);
+    --drogon_db__query__end_semaphore;
+}
+#endif
 #endif
 
 using namespace drogon;
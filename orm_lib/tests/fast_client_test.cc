@@ -0,0 +1,90 @@
+#define DROGON_TEST_MAIN
+#include <drogon/drogon_test.h>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/config.h>
+#include <chrono>
+#include <mutex>
+#include <set>
+
+using namespace drogon;
+using namespace trantor;
+
+#if USE_POSTGRESQL
+DROGON_TEST(FastClientSiblingTest)
+{
+    // Every IO loop has one connection, the second query of the first loop
+    // is executed on the idle connection of the other loop.
+    struct State
+    {
+        std::mutex mutex;
+        int results{0};
+        std::set<int> backends;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    auto state = std::make_shared<State>();
+    auto loop = app().getIOLoop(0);
+    loop->runInLoop([TEST_CTX, state, loop]() {
+        auto client = app().getFastDbClient("fast");
+        REQUIRE(client != nullptr);
+        state->start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 2; ++i)
+        {
+            client->execSqlAsync(
+                "select pg_backend_pid() from pg_sleep(1)",
+                [TEST_CTX, state, loop](const orm::Result &r) {
+                    // The results of the other loop are posted back.
+                    CHECK(loop->isInLoopThread());
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->backends.insert(r[0][0].as<int>());
+                    if (++state->results == 2)
+                    {
+                        // Both queries ran at the same time on two
+                        // connections.
+                        CHECK(state->backends.size() == 2);
+                        CHECK(std::chrono::steady_clock::now() - state->start <
+                              std::chrono::milliseconds(1800));
+                    }
+                },
+                [TEST_CTX](const orm::DrogonDbException &e) {
+                    FAULT("query failed: ", e.base().what());
+                });
+        }
+    });
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    std::promise<void> p1;
+    std::future<void> f1 = p1.get_future();
+    app().setThreadNum(2);
+#if USE_POSTGRESQL
+    app().addDbClient(orm::PostgresConfig{
+        "127.0.0.1",  // host
+        5432,         // port
+        "postgres",   // dbname
+        "postgres",   // username
+        "12345",      // password
+        1,            // connectionNum
+        "fast",       // name
+        true,         // isFast
+        "",           // charset
+        -1.0,         // timeout
+        false,        // autobatch
+        {}            // connectOptions
+    });
+#endif
+    std::thread thr([&]() {
+        app().getLoop()->queueInLoop([&]() { p1.set_value(); });
+        app().run();
+    });
+
+    f1.get();
+    // Let the fast clients connect.
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    int testStatus = test::run(argc, argv);
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+    return testStatus;
+}
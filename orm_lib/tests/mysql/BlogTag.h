@@ -12,6 +12,7 @@
 #include <drogon/orm/SqlBinder.h>
 #include <drogon/orm/Mapper.h>
 #include <drogon/orm/BaseBuilder.h>
+#include <drogon/utils/JsonWriter.h>
 #ifdef __cpp_impl_coroutine
 #include <drogon/orm/CoroMapper.h>
 #endif
@@ -136,6 +137,10 @@ class BlogTag
     Json::Value toJson() const;
     Json::Value toMasqueradedJson(
         const std::vector<std::string> &pMasqueradingVector) const;
+    void writeJson(drogon::JsonWriter &writer) const;
+    void writeMasqueradedJson(
+        drogon::JsonWriter &writer,
+        const std::vector<std::string> &pMasqueradingVector) const;
     /// Relationship interfaces
   private:
     friend drogon::orm::Mapper<BlogTag>;
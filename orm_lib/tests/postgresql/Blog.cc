@@ -10,6 +10,7 @@
 #include "Category.h"
 #include "Tag.h"
 #include <drogon/utils/Utilities.h>
+#include <map>
 #include <string>
 
 using namespace drogon;
@@ -473,6 +474,89 @@ Json::Value Blog::toMasqueradedJson(
     return ret;
 }
 
+void Blog::writeJson(drogon::JsonWriter &writer) const
+{
+    writer.startObject();
+    writer.key("id");
+    if (getId())
+    {
+        writer.value(getValueOfId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("title");
+    if (getTitle())
+    {
+        writer.value(getValueOfTitle());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("category_id");
+    if (getCategoryId())
+    {
+        writer.value(getValueOfCategoryId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.endObject();
+}
+
+void Blog::writeMasqueradedJson(
+    drogon::JsonWriter &writer,
+    const std::vector<std::string> &pMasqueradingVector) const
+{
+    if (pMasqueradingVector.size() != 3)
+    {
+        LOG_ERROR << "Masquerade failed";
+        writeJson(writer);
+        return;
+    }
+    writer.startObject();
+    if (!pMasqueradingVector[0].empty())
+    {
+        writer.key(pMasqueradingVector[0]);
+        if (getId())
+        {
+            writer.value(getValueOfId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[1].empty())
+    {
+        writer.key(pMasqueradingVector[1]);
+        if (getTitle())
+        {
+            writer.value(getValueOfTitle());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[2].empty())
+    {
+        writer.key(pMasqueradingVector[2]);
+        if (getCategoryId())
+        {
+            writer.value(getValueOfCategoryId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    writer.endObject();
+}
+
 bool Blog::validateJsonForCreation(const Json::Value &pJson, std::string &err)
 {
     if (pJson.isMember("id"))
@@ -785,3 +869,213 @@ void Blog::getTags(
         rcb(ret);
     } >> ecb;
 }
+
+namespace
+{
+// The placeholders of the keys in a query loading the related objects of
+// several objects.
+std::string keyPlaceholders(size_t count)
+{
+    std::string ret;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i > 0)
+            ret += ",";
+        ret += "$" + std::to_string(i + 1);
+    }
+    return ret;
+}
+
+// The indices of the objects by their non-null keys.
+template <typename Object, typename GetKey>
+auto indexByKey(const std::vector<Object> &objects, GetKey &&getKey)
+{
+    using Key = std::decay_t<decltype(*getKey(objects[0]))>;
+    std::map<Key, std::vector<size_t>> indices;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        auto &key = getKey(objects[i]);
+        if (key)
+            indices[*key].push_back(i);
+    }
+    return indices;
+}
+
+// Give the related object to the objects whose key is the key of the
+// related object.
+template <typename Key, typename Item, typename Value>
+void distribute(std::vector<std::vector<Item>> &groups,
+                const std::map<Key, std::vector<size_t>> &indices,
+                const std::shared_ptr<Value> &key,
+                const Item &item)
+{
+    if (!key)
+        return;
+    auto iter = indices.find(*key);
+    if (iter == indices.end())
+        return;
+    for (auto index : iter->second)
+    {
+        groups[index].push_back(item);
+    }
+}
+
+template <typename Key, typename Item, typename Value>
+void distribute(std::vector<std::shared_ptr<Item>> &objects,
+                const std::map<Key, std::vector<size_t>> &indices,
+                const std::shared_ptr<Value> &key,
+                const Item &item)
+{
+    if (!key)
+        return;
+    auto iter = indices.find(*key);
+    if (iter == indices.end())
+        return;
+    auto itemPtr = std::make_shared<Item>(item);
+    for (auto index : iter->second)
+    {
+        objects[index] = itemPtr;
+    }
+}
+}  // namespace
+
+std::vector<std::shared_ptr<Category>> Blog::loadCategory(
+    const DbClientPtr &clientPtr,
+    const std::vector<Blog> &objects)
+{
+    std::vector<std::shared_ptr<Category>> ret(objects.size());
+    auto indices = indexByKey(objects, [](const Blog &obj) -> auto & {
+        return obj.categoryId_;
+    });
+    if (indices.empty())
+        return ret;
+    std::string sql = "select * from category where id in (";
+    sql += keyPlaceholders(indices.size());
+    sql += ")";
+    Result r(nullptr);
+    {
+        auto binder = *clientPtr << std::move(sql);
+        for (auto &index : indices)
+        {
+            binder << index.first;
+        }
+        binder << Mode::Blocking >>
+            [&r](const Result &result) { r = result; };
+        binder.exec();
+    }
+    for (auto const &row : r)
+    {
+        Category item(row);
+        distribute(ret, indices, item.getId(), item);
+    }
+    return ret;
+}
+
+void Blog::loadCategory(
+    const DbClientPtr &clientPtr,
+    const std::vector<Blog> &objects,
+    const std::function<void(std::vector<std::shared_ptr<Category>>)> &rcb,
+    const ExceptionCallback &ecb)
+{
+    auto indices = indexByKey(objects, [](const Blog &obj) -> auto & {
+        return obj.categoryId_;
+    });
+    if (indices.empty())
+    {
+        rcb(std::vector<std::shared_ptr<Category>>(objects.size()));
+        return;
+    }
+    std::string sql = "select * from category where id in (";
+    sql += keyPlaceholders(indices.size());
+    sql += ")";
+    auto binder = *clientPtr << std::move(sql);
+    for (auto &index : indices)
+    {
+        binder << index.first;
+    }
+    binder >> [rcb, count = objects.size(), indices = std::move(indices)](
+                  const Result &r) {
+        std::vector<std::shared_ptr<Category>> ret(count);
+        for (auto const &row : r)
+        {
+            Category item(row);
+            distribute(ret, indices, item.getId(), item);
+        }
+        rcb(std::move(ret));
+    };
+    binder >> ecb;
+}
+
+std::vector<std::vector<std::pair<Tag, BlogTag>>> Blog::loadTags(
+    const DbClientPtr &clientPtr,
+    const std::vector<Blog> &objects)
+{
+    std::vector<std::vector<std::pair<Tag, BlogTag>>> ret(objects.size());
+    auto indices = indexByKey(objects, [](const Blog &obj) -> auto & {
+        return obj.id_;
+    });
+    if (indices.empty())
+        return ret;
+    std::string sql =
+        "select * from tag,blog_tag where blog_tag.tag_id = tag.id and "
+        "blog_tag.blog_id in (";
+    sql += keyPlaceholders(indices.size());
+    sql += ")";
+    Result r(nullptr);
+    {
+        auto binder = *clientPtr << std::move(sql);
+        for (auto &index : indices)
+        {
+            binder << index.first;
+        }
+        binder << Mode::Blocking >>
+            [&r](const Result &result) { r = result; };
+        binder.exec();
+    }
+    for (auto const &row : r)
+    {
+        std::pair<Tag, BlogTag> item(
+            Tag(row), BlogTag(row, Tag::getColumnNumber()));
+        distribute(ret, indices, item.second.getBlogId(), item);
+    }
+    return ret;
+}
+
+void Blog::loadTags(
+    const DbClientPtr &clientPtr,
+    const std::vector<Blog> &objects,
+    const std::function<void(
+        std::vector<std::vector<std::pair<Tag, BlogTag>>>)> &rcb,
+    const ExceptionCallback &ecb)
+{
+    auto indices = indexByKey(objects, [](const Blog &obj) -> auto & {
+        return obj.id_;
+    });
+    if (indices.empty())
+    {
+        rcb(std::vector<std::vector<std::pair<Tag, BlogTag>>>(objects.size()));
+        return;
+    }
+    std::string sql =
+        "select * from tag,blog_tag where blog_tag.tag_id = tag.id and "
+        "blog_tag.blog_id in (";
+    sql += keyPlaceholders(indices.size());
+    sql += ")";
+    auto binder = *clientPtr << std::move(sql);
+    for (auto &index : indices)
+    {
+        binder << index.first;
+    }
+    binder >> [rcb, count = objects.size(), indices = std::move(indices)](
+                  const Result &r) {
+        std::vector<std::vector<std::pair<Tag, BlogTag>>> ret(count);
+        for (auto const &row : r)
+        {
+            std::pair<Tag, BlogTag> item(
+                Tag(row), BlogTag(row, Tag::getColumnNumber()));
+            distribute(ret, indices, item.second.getBlogId(), item);
+        }
+        rcb(std::move(ret));
+    };
+    binder >> ecb;
+}
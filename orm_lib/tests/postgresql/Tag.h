@@ -12,6 +12,7 @@
 #include <drogon/orm/SqlBinder.h>
 #include <drogon/orm/Mapper.h>
 #include <drogon/orm/BaseBuilder.h>
+#include <drogon/utils/JsonWriter.h>
 #ifdef __cpp_impl_coroutine
 #include <drogon/orm/CoroMapper.h>
 #endif
@@ -139,6 +140,10 @@ class Tag
     Json::Value toJson() const;
     Json::Value toMasqueradedJson(
         const std::vector<std::string> &pMasqueradingVector) const;
+    void writeJson(drogon::JsonWriter &writer) const;
+    void writeMasqueradedJson(
+        drogon::JsonWriter &writer,
+        const std::vector<std::string> &pMasqueradingVector) const;
     /// Relationship interfaces
     std::vector<std::pair<Blog, BlogTag>> getBlogs(
         const drogon::orm::DbClientPtr &clientPtr) const;
@@ -146,6 +151,20 @@ class Tag
         const drogon::orm::DbClientPtr &clientPtr,
         const std::function<void(std::vector<std::pair<Blog, BlogTag>>)> &rcb,
         const drogon::orm::ExceptionCallback &ecb) const;
+    /**
+     * Batch loaders: the related objects of all the objects are read with one
+     * query and returned in the order of the objects, instead of one query
+     * for each object. The objects with a null key have no related objects.
+     */
+    static std::vector<std::vector<std::pair<Blog, BlogTag>>> loadBlogs(
+        const drogon::orm::DbClientPtr &clientPtr,
+        const std::vector<Tag> &objects);
+    static void loadBlogs(
+        const drogon::orm::DbClientPtr &clientPtr,
+        const std::vector<Tag> &objects,
+        const std::function<void(
+            std::vector<std::vector<std::pair<Blog, BlogTag>>>)> &rcb,
+        const drogon::orm::ExceptionCallback &ecb);
 
   private:
     friend drogon::orm::Mapper<Tag>;
@@ -8,6 +8,7 @@
 #include "Wallets.h"
 #include "Users.h"
 #include <drogon/utils/Utilities.h>
+#include <map>
 #include <string>
 
 using namespace drogon;
@@ -478,6 +479,89 @@ Json::Value Wallets::toMasqueradedJson(
     return ret;
 }
 
+void Wallets::writeJson(drogon::JsonWriter &writer) const
+{
+    writer.startObject();
+    writer.key("id");
+    if (getId())
+    {
+        writer.value(getValueOfId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("user_id");
+    if (getUserId())
+    {
+        writer.value(getValueOfUserId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("amount");
+    if (getAmount())
+    {
+        writer.value(getValueOfAmount());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.endObject();
+}
+
+void Wallets::writeMasqueradedJson(
+    drogon::JsonWriter &writer,
+    const std::vector<std::string> &pMasqueradingVector) const
+{
+    if (pMasqueradingVector.size() != 3)
+    {
+        LOG_ERROR << "Masquerade failed";
+        writeJson(writer);
+        return;
+    }
+    writer.startObject();
+    if (!pMasqueradingVector[0].empty())
+    {
+        writer.key(pMasqueradingVector[0]);
+        if (getId())
+        {
+            writer.value(getValueOfId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[1].empty())
+    {
+        writer.key(pMasqueradingVector[1]);
+        if (getUserId())
+        {
+            writer.value(getValueOfUserId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[2].empty())
+    {
+        writer.key(pMasqueradingVector[2]);
+        if (getAmount())
+        {
+            writer.value(getValueOfAmount());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    writer.endObject();
+}
+
 bool Wallets::validateJsonForCreation(const Json::Value &pJson,
                                       std::string &err)
 {
@@ -744,3 +828,139 @@ void Wallets::getUser(const DbClientPtr &clientPtr,
         }
     } >> ecb;
 }
+
+namespace
+{
+// The placeholders of the keys in a query loading the related objects of
+// several objects.
+std::string keyPlaceholders(size_t count)
+{
+    std::string ret;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i > 0)
+            ret += ",";
+        ret += "$" + std::to_string(i + 1);
+    }
+    return ret;
+}
+
+// The indices of the objects by their non-null keys.
+template <typename Object, typename GetKey>
+auto indexByKey(const std::vector<Object> &objects, GetKey &&getKey)
+{
+    using Key = std::decay_t<decltype(*getKey(objects[0]))>;
+    std::map<Key, std::vector<size_t>> indices;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        auto &key = getKey(objects[i]);
+        if (key)
+            indices[*key].push_back(i);
+    }
+    return indices;
+}
+
+// Give the related object to the objects whose key is the key of the
+// related object.
+template <typename Key, typename Item, typename Value>
+void distribute(std::vector<std::vector<Item>> &groups,
+                const std::map<Key, std::vector<size_t>> &indices,
+                const std::shared_ptr<Value> &key,
+                const Item &item)
+{
+    if (!key)
+        return;
+    auto iter = indices.find(*key);
+    if (iter == indices.end())
+        return;
+    for (auto index : iter->second)
+    {
+        groups[index].push_back(item);
+    }
+}
+
+template <typename Key, typename Item, typename Value>
+void distribute(std::vector<std::shared_ptr<Item>> &objects,
+                const std::map<Key, std::vector<size_t>> &indices,
+                const std::shared_ptr<Value> &key,
+                const Item &item)
+{
+    if (!key)
+        return;
+    auto iter = indices.find(*key);
+    if (iter == indices.end())
+        return;
+    auto itemPtr = std::make_shared<Item>(item);
+    for (auto index : iter->second)
+    {
+        objects[index] = itemPtr;
+    }
+}
+}  // namespace
+
+std::vector<std::shared_ptr<Users>> Wallets::loadUser(
+    const DbClientPtr &clientPtr,
+    const std::vector<Wallets> &objects)
+{
+    std::vector<std::shared_ptr<Users>> ret(objects.size());
+    auto indices = indexByKey(objects, [](const Wallets &obj) -> auto & {
+        return obj.userId_;
+    });
+    if (indices.empty())
+        return ret;
+    std::string sql = "select * from users where user_id in (";
+    sql += keyPlaceholders(indices.size());
+    sql += ")";
+    Result r(nullptr);
+    {
+        auto binder = *clientPtr << std::move(sql);
+        for (auto &index : indices)
+        {
+            binder << index.first;
+        }
+        binder << Mode::Blocking >>
+            [&r](const Result &result) { r = result; };
+        binder.exec();
+    }
+    for (auto const &row : r)
+    {
+        Users item(row);
+        distribute(ret, indices, item.getUserId(), item);
+    }
+    return ret;
+}
+
+void Wallets::loadUser(
+    const DbClientPtr &clientPtr,
+    const std::vector<Wallets> &objects,
+    const std::function<void(std::vector<std::shared_ptr<Users>>)> &rcb,
+    const ExceptionCallback &ecb)
+{
+    auto indices = indexByKey(objects, [](const Wallets &obj) -> auto & {
+        return obj.userId_;
+    });
+    if (indices.empty())
+    {
+        rcb(std::vector<std::shared_ptr<Users>>(objects.size()));
+        return;
+    }
+    std::string sql = "select * from users where user_id in (";
+    sql += keyPlaceholders(indices.size());
+    sql += ")";
+    auto binder = *clientPtr << std::move(sql);
+    for (auto &index : indices)
+    {
+        binder << index.first;
+    }
+    binder >> [rcb, count = objects.size(), indices = std::move(indices)](
+                  const Result &r) {
+        std::vector<std::shared_ptr<Users>> ret(count);
+        for (auto const &row : r)
+        {
+            Users item(row);
+            distribute(ret, indices, item.getUserId(), item);
+        }
+        rcb(std::move(ret));
+    };
+    binder >> ecb;
+}
@@ -12,6 +12,7 @@
 #include <drogon/orm/SqlBinder.h>
 #include <drogon/orm/Mapper.h>
 #include <drogon/orm/BaseBuilder.h>
+#include <drogon/utils/JsonWriter.h>
 #ifdef __cpp_impl_coroutine
 #include <drogon/orm/CoroMapper.h>
 #endif
@@ -153,6 +154,10 @@ class Blog
     Json::Value toJson() const;
     Json::Value toMasqueradedJson(
         const std::vector<std::string> &pMasqueradingVector) const;
+    void writeJson(drogon::JsonWriter &writer) const;
+    void writeMasqueradedJson(
+        drogon::JsonWriter &writer,
+        const std::vector<std::string> &pMasqueradingVector) const;
     /// Relationship interfaces
     Category getCategory(const drogon::orm::DbClientPtr &clientPtr) const;
     void getCategory(const drogon::orm::DbClientPtr &clientPtr,
@@ -164,6 +169,28 @@ class Blog
         const drogon::orm::DbClientPtr &clientPtr,
         const std::function<void(std::vector<std::pair<Tag, BlogTag>>)> &rcb,
         const drogon::orm::ExceptionCallback &ecb) const;
+    /**
+     * Batch loaders: the related objects of all the objects are read with one
+     * query and returned in the order of the objects, instead of one query
+     * for each object. The objects with a null key have no related objects.
+     */
+    static std::vector<std::shared_ptr<Category>> loadCategory(
+        const drogon::orm::DbClientPtr &clientPtr,
+        const std::vector<Blog> &objects);
+    static void loadCategory(
+        const drogon::orm::DbClientPtr &clientPtr,
+        const std::vector<Blog> &objects,
+        const std::function<void(std::vector<std::shared_ptr<Category>>)> &rcb,
+        const drogon::orm::ExceptionCallback &ecb);
+    static std::vector<std::vector<std::pair<Tag, BlogTag>>> loadTags(
+        const drogon::orm::DbClientPtr &clientPtr,
+        const std::vector<Blog> &objects);
+    static void loadTags(
+        const drogon::orm::DbClientPtr &clientPtr,
+        const std::vector<Blog> &objects,
+        const std::function<void(
+            std::vector<std::vector<std::pair<Tag, BlogTag>>>)> &rcb,
+        const drogon::orm::ExceptionCallback &ecb);
 
   private:
     friend drogon::orm::Mapper<Blog>;
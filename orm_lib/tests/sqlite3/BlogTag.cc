@@ -357,6 +357,68 @@ Json::Value BlogTag::toMasqueradedJson(
     return ret;
 }
 
+void BlogTag::writeJson(drogon::JsonWriter &writer) const
+{
+    writer.startObject();
+    writer.key("blog_id");
+    if (getBlogId())
+    {
+        writer.value(getValueOfBlogId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("tag_id");
+    if (getTagId())
+    {
+        writer.value(getValueOfTagId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.endObject();
+}
+
+void BlogTag::writeMasqueradedJson(
+    drogon::JsonWriter &writer,
+    const std::vector<std::string> &pMasqueradingVector) const
+{
+    if (pMasqueradingVector.size() != 2)
+    {
+        LOG_ERROR << "Masquerade failed";
+        writeJson(writer);
+        return;
+    }
+    writer.startObject();
+    if (!pMasqueradingVector[0].empty())
+    {
+        writer.key(pMasqueradingVector[0]);
+        if (getBlogId())
+        {
+            writer.value(getValueOfBlogId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[1].empty())
+    {
+        writer.key(pMasqueradingVector[1]);
+        if (getTagId())
+        {
+            writer.value(getValueOfTagId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    writer.endObject();
+}
+
 bool BlogTag::validateJsonForCreation(const Json::Value &pJson,
                                       std::string &err)
 {
@@ -8,6 +8,7 @@
 #include "Users.h"
 #include "Wallets.h"
 #include <drogon/utils/Utilities.h>
+#include <map>
 #include <string>
 
 using namespace drogon;
@@ -1537,6 +1538,236 @@ Json::Value Users::toMasqueradedJson(
     return ret;
 }
 
+void Users::writeJson(drogon::JsonWriter &writer) const
+{
+    writer.startObject();
+    writer.key("id");
+    if (getId())
+    {
+        writer.value(getValueOfId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("user_id");
+    if (getUserId())
+    {
+        writer.value(getValueOfUserId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("user_name");
+    if (getUserName())
+    {
+        writer.value(getValueOfUserName());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("password");
+    if (getPassword())
+    {
+        writer.value(getValueOfPassword());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("org_name");
+    if (getOrgName())
+    {
+        writer.value(getValueOfOrgName());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("signature");
+    if (getSignature())
+    {
+        writer.value(getValueOfSignature());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("avatar_id");
+    if (getAvatarId())
+    {
+        writer.value(getValueOfAvatarId());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("salt");
+    if (getSalt())
+    {
+        writer.value(getValueOfSalt());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("admin");
+    if (getAdmin())
+    {
+        writer.value(getValueOfAdmin());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.key("create_time");
+    if (getCreateTime())
+    {
+        writer.value(getCreateTime()->toDbStringLocal());
+    }
+    else
+    {
+        writer.null();
+    }
+    writer.endObject();
+}
+
+void Users::writeMasqueradedJson(
+    drogon::JsonWriter &writer,
+    const std::vector<std::string> &pMasqueradingVector) const
+{
+    if (pMasqueradingVector.size() != 10)
+    {
+        LOG_ERROR << "Masquerade failed";
+        writeJson(writer);
+        return;
+    }
+    writer.startObject();
+    if (!pMasqueradingVector[0].empty())
+    {
+        writer.key(pMasqueradingVector[0]);
+        if (getId())
+        {
+            writer.value(getValueOfId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[1].empty())
+    {
+        writer.key(pMasqueradingVector[1]);
+        if (getUserId())
+        {
+            writer.value(getValueOfUserId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[2].empty())
+    {
+        writer.key(pMasqueradingVector[2]);
+        if (getUserName())
+        {
+            writer.value(getValueOfUserName());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[3].empty())
+    {
+        writer.key(pMasqueradingVector[3]);
+        if (getPassword())
+        {
+            writer.value(getValueOfPassword());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[4].empty())
+    {
+        writer.key(pMasqueradingVector[4]);
+        if (getOrgName())
+        {
+            writer.value(getValueOfOrgName());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[5].empty())
+    {
+        writer.key(pMasqueradingVector[5]);
+        if (getSignature())
+        {
+            writer.value(getValueOfSignature());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[6].empty())
+    {
+        writer.key(pMasqueradingVector[6]);
+        if (getAvatarId())
+        {
+            writer.value(getValueOfAvatarId());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[7].empty())
+    {
+        writer.key(pMasqueradingVector[7]);
+        if (getSalt())
+        {
+            writer.value(getValueOfSalt());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[8].empty())
+    {
+        writer.key(pMasqueradingVector[8]);
+        if (getAdmin())
+        {
+            writer.value(getValueOfAdmin());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    if (!pMasqueradingVector[9].empty())
+    {
+        writer.key(pMasqueradingVector[9]);
+        if (getCreateTime())
+        {
+            writer.value(getCreateTime()->toDbStringLocal());
+        }
+        else
+        {
+            writer.null();
+        }
+    }
+    writer.endObject();
+}
+
 bool Users::validateJsonForCreation(const Json::Value &pJson, std::string &err)
 {
     if (pJson.isMember("id"))
@@ -2097,3 +2328,139 @@ void Users::getWallet(const DbClientPtr &clientPtr,
         }
     } >> ecb;
 }
+
+namespace
+{
+// The placeholders of the keys in a query loading the related objects of
+// several objects.
+std::string keyPlaceholders(size_t count)
+{
+    std::string ret;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i > 0)
+            ret += ",";
+        ret += "?";
+    }
+    return ret;
+}
+
+// The indices of the objects by their non-null keys.
+template <typename Object, typename GetKey>
+auto indexByKey(const std::vector<Object> &objects, GetKey &&getKey)
+{
+    using Key = std::decay_t<decltype(*getKey(objects[0]))>;
+    std::map<Key, std::vector<size_t>> indices;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        auto &key = getKey(objects[i]);
+        if (key)
+            indices[*key].push_back(i);
+    }
+    return indices;
+}
+
+// Give the related object to the objects whose key is the key of the
+// related object.
+template <typename Key, typename Item, typename Value>
+void distribute(std::vector<std::vector<Item>> &groups,
+                const std::map<Key, std::vector<size_t>> &indices,
+                const std::shared_ptr<Value> &key,
+                const Item &item)
+{
+    if (!key)
+        return;
+    auto iter = indices.find(*key);
+    if (iter == indices.end())
+        return;
+    for (auto index : iter->second)
+    {
+        groups[index].push_back(item);
+    }
+}
+
+template <typename Key, typename Item, typename Value>
+void distribute(std::vector<std::shared_ptr<Item>> &objects,
+                const std::map<Key, std::vector<size_t>> &indices,
+                const std::shared_ptr<Value> &key,
+                const Item &item)
+{
+    if (!key)
+        return;
+    auto iter = indices.find(*key);
+    if (iter == indices.end())
+        return;
+    auto itemPtr = std::make_shared<Item>(item);
+    for (auto index : iter->second)
+    {
+        objects[index] = itemPtr;
+    }
+}
+}  // namespace
+
+std::vector<std::shared_ptr<Wallets>> Users::loadWallet(
+    const DbClientPtr &clientPtr,
+    const std::vector<Users> &objects)
+{
+    std::vector<std::shared_ptr<Wallets>> ret(objects.size());
+    auto indices = indexByKey(objects, [](const Users &obj) -> auto & {
+        return obj.userId_;
+    });
+    if (indices.empty())
+        return ret;
+    std::string sql = "select * from wallets where user_id in (";
+    sql += keyPlaceholders(indices.size());
+    sql += ")";
+    Result r(nullptr);
+    {
+        auto binder = *clientPtr << std::move(sql);
+        for (auto &index : indices)
+        {
+            binder << index.first;
+        }
+        binder << Mode::Blocking >>
+            [&r](const Result &result) { r = result; };
+        binder.exec();
+    }
+    for (auto const &row : r)
+    {
+        Wallets item(row);
+        distribute(ret, indices, item.getUserId(), item);
+    }
+    return ret;
+}
+
+void Users::loadWallet(
+    const DbClientPtr &clientPtr,
+    const std::vector<Users> &objects,
+    const std::function<void(std::vector<std::shared_ptr<Wallets>>)> &rcb,
+    const ExceptionCallback &ecb)
+{
+    auto indices = indexByKey(objects, [](const Users &obj) -> auto & {
+        return obj.userId_;
+    });
+    if (indices.empty())
+    {
+        rcb(std::vector<std::shared_ptr<Wallets>>(objects.size()));
+        return;
+    }
+    std::string sql = "select * from wallets where user_id in (";
+    sql += keyPlaceholders(indices.size());
+    sql += ")";
+    auto binder = *clientPtr << std::move(sql);
+    for (auto &index : indices)
+    {
+        binder << index.first;
+    }
+    binder >> [rcb, count = objects.size(), indices = std::move(indices)](
+                  const Result &r) {
+        std::vector<std::shared_ptr<Wallets>> ret(count);
+        for (auto const &row : r)
+        {
+            Wallets item(row);
+            distribute(ret, indices, item.getUserId(), item);
+        }
+        rcb(std::move(ret));
+    };
+    binder >> ecb;
+}
@@ -12,6 +12,7 @@
 #include <drogon/orm/SqlBinder.h>
 #include <drogon/orm/Mapper.h>
 #include <drogon/orm/BaseBuilder.h>
+#include <drogon/utils/JsonWriter.h>
 #ifdef __cpp_impl_coroutine
 #include <drogon/orm/CoroMapper.h>
 #endif
@@ -242,11 +243,28 @@ class Users
     Json::Value toJson() const;
     Json::Value toMasqueradedJson(
         const std::vector<std::string> &pMasqueradingVector) const;
+    void writeJson(drogon::JsonWriter &writer) const;
+    void writeMasqueradedJson(
+        drogon::JsonWriter &writer,
+        const std::vector<std::string> &pMasqueradingVector) const;
     /// Relationship interfaces
     Wallets getWallet(const drogon::orm::DbClientPtr &clientPtr) const;
     void getWallet(const drogon::orm::DbClientPtr &clientPtr,
                    const std::function<void(Wallets)> &rcb,
                    const drogon::orm::ExceptionCallback &ecb) const;
+    /**
+     * Batch loaders: the related objects of all the objects are read with one
+     * query and returned in the order of the objects, instead of one query
+     * for each object. The objects with a null key have no related objects.
+     */
+    static std::vector<std::shared_ptr<Wallets>> loadWallet(
+        const drogon::orm::DbClientPtr &clientPtr,
+        const std::vector<Users> &objects);
+    static void loadWallet(
+        const drogon::orm::DbClientPtr &clientPtr,
+        const std::vector<Users> &objects,
+        const std::function<void(std::vector<std::shared_ptr<Wallets>>)> &rcb,
+        const drogon::orm::ExceptionCallback &ecb);
 
   private:
     friend drogon::orm::Mapper<Users>;
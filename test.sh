@@ -338,6 +338,14 @@ function do_db_test()
             exit -1
         fi
     fi
+    if [ -f "./orm_lib/tests/fast_client_test" ]; then
+        echo "Test fast database clients"
+        ./orm_lib/tests/fast_client_test -s
+        if [ $? -ne 0 ]; then
+            echo "Error in testing"
+            exit -1
+        fi
+    fi
     if [ -f "./nosql_lib/redis/tests/redis_test" ]; then
         echo "Test redis"
         ./nosql_lib/redis/tests/redis_test -s